@@ -74,11 +74,43 @@
 %
 %                Show the SpikeGLX console window.
 %
+%    res = DiskBench( myobj, secs, blkMB, sha1, direct )
+%
+%                Benchmark the data directories with the last-set
+%                params' write pattern (blocks for secs, default 10;
+%                later args optional). Returns per directory the
+%                needed, sustained and worst 1-second MB/s.
+%
 %    params = EnumDataDir( myobj )
 %
 %                Retrieve a listing of files in the data directory.
 %
-%    [daqData,headCt] = Fetch( myObj, streamID, start_scan, scan_ct, channel_subset, downsample_ratio )
+%    id = ErpStart( myobj, evStreamID, evChan, evBit, streamID, channels, pre_secs, post_secs, ... )
+%
+%                Start a server-side trial average of the stream's
+%                channels locked to rising edges of an event line
+%                (digital bit, or analog threshold), optionally
+%                with spike PSTHs. Returns id.
+%
+%    myobj = ErpStop( myobj, id )
+%
+%                Stop and discard trial average id.
+%
+%    id = ExportAdd( myobj, fmt, t0, t1, chans, filter, filename )
+%
+%                Queue a background export of bin file 'filename' and
+%                return its job id. fmt is one of {'bin','csv','zarr'}.
+%                [t0,t1] is the span in seconds (t1 < 0 is end of file).
+%                chans is a channel string like '0:383,768' or '*' for
+%                all. filter = 1 applies zero-phase 300 Hz highpass to
+%                spike channels.
+%
+%    myobj = ExportCancel( myobj, id )
+%
+%                Cancel queued or running export job id, or all
+%                jobs if id is 'all'.
+%
+%    [daqData,headCt,tEnq] = Fetch( myObj, streamID, start_scan, scan_ct, channel_subset, downsample_ratio, dwnsmp_fir, filt_hz, car )
 %
 %                Get MxN matrix of stream data.
 %                M = scan_ct = max samples to fetch.
@@ -89,10 +121,16 @@
 %                Data are int16 type.
 %
 %                downsample_ratio is an integer (default = 1).
+%                dwnsmp_fir: 0 = average each bin (default), 1 = anti-alias
+%                FIR lowpass at 0.4 of the output rate, then decimate.
+%
+%                filt_hz = [hipass_hz lopass_hz], 0 = off (default [0 0]),
+%                and car (0 = none, 1 = global mean, 2 = global median)
+%                are applied to neural channels before downsampling.
 %
 %                Also returns headCt = index of first timepoint in matrix.
 %
-%    [daqData,headCt] = FetchLatest( myObj, streamID, scan_ct, channel_subset, downsample_ratio )
+%    [daqData,headCt] = FetchLatest( myObj, streamID, scan_ct, channel_subset, downsample_ratio, dwnsmp_fir, filt_hz, car )
 %
 %                Get MxN matrix of the most recent stream data.
 %                M = scan_ct = max samples to fetch.
@@ -101,9 +139,22 @@
 %                    SpikeGLX save-channel subset.
 %
 %                downsample_ratio is an integer (default = 1).
+%                dwnsmp_fir: 0 = average each bin (default), 1 = anti-alias
+%                FIR lowpass at 0.4 of the output rate, then decimate.
+%
+%                filt_hz = [hipass_hz lopass_hz], 0 = off (default [0 0]),
+%                and car (0 = none, 1 = global mean, 2 = global median)
+%                are applied to neural channels before downsampling.
 %
 %                Also returns headCt = index of first timepoint in matrix.
 %
+%    [daqData,headCt] = FetchMulti( myObj, srcStreamID, start_scan, scan_ct, streamIDs, downsample_ratio )
+%
+%                Get the same absolute time window from several streams
+%                in one request; the source window is mapped to the others
+%                by sync edges. Returns cell array of int16 matrices and a
+%                vector of their first timepoints.
+%
 %    chanCounts = GetAcqChanCounts( myobj, streamID )
 %
 %                Returns a vector containing the counts of 16-bit
@@ -112,10 +163,34 @@
 %                streamID = -1: NI channels: {MN,MA,XA,DW}.
 %                streamID >= 0: IM channels: {AP,LF,SY}.
 %
+%    tlm = GetAudioTelemetry( myobj )
+%
+%                Get audio output telemetry since audio start as a struct
+%                of name/value pairs: callback, feeder block and lag time
+%                percentiles (ms), ring fill, and counts of starves,
+%                device underflows, misses, rejoins and restarts.
+%
+%    tlm = GetCmdTelemetry( myobj )
+%
+%                Returns struct of this connection's data reply timing:
+%                read, proc, send stages and enqueue-to-send latency,
+%                each as N, MsMean, MsP50, MsP90, MsP99, MsMax.
+%
 %    dir = GetDataDir( myobj )
 %
 %                Get global run data directory.
 %
+%    erp = GetErp( myobj, id, reset )
+%
+%                Get trial average id: event counts, per channel
+%                ERP means (uV) and PSTH rates (spikes/s). If
+%                reset is 1 the average starts over afterward.
+%
+%    status = GetExportStatus( myobj )
+%
+%                Returns a cell array with one line per export job:
+%                'id state percent filename'.
+%
 %    startCt = GetFileStartCount( myobj, streamID )
 %
 %                Returns index of first scan in latest file,
@@ -130,10 +205,24 @@
 %                Returns serial number string (SN) and integer type
 %                of selected IMEC probe.
 %
+%    tlm = GetImTelemetry( myobj, streamID )
+%
+%                Get acquisition telemetry for selected IMEC probe
+%                as a struct of name/value pairs: timestamp gaps,
+%                fetch cycle times, FIFO fill percentiles.
+%
 %    [Vmin,Vmax] = GetImVoltageRange( myobj, streamID )
 %
 %                Returns votlage range of selected IMEC probe.
 %
+%    [cols,data] = GetMetricsHist( myobj, lastSecs )
+%
+%                Get Metrics window history (1 s per row, kept after
+%                the run): column names and a matrix of samples:
+%                write buffer fill and rates, NI fetch depth and lag,
+%                and per IMEC probe FIFO, awake, fetch depth, consumer
+%                lag and error counts.
+%
 %    params = GetParams( myobj )
 %
 %                Get the most recently used run parameters.
@@ -158,11 +247,40 @@
 %                Returns number of scans since current run started
 %                or zero if not running.
 %
+%    rpt = GetScrubReport( myobj )
+%
+%                Get background data scrub state, counts and recent
+%                results (cell array of tab-separated time, OK|BAD,
+%                path and detail strings) as a struct.
+%
+%    statusStruct = GetStatus( myobj )
+%
+%                Returns run state and each enabled stream's sample
+%                rate, channel counts, saved channels, scan count and
+%                file start count in one query; fields are prefixed
+%                ni, im0, im1, ...
+%
+%    [binHz,P] = GetSpectrum( myobj, streamID, updtSecs )
+%
+%                Get latest live spectra (uV^2/Hz) of the selected
+%                stream's neural channels as a [nChans,nBins] matrix.
+%
+%    name = GetStreamShm( myobj, streamID )
+%
+%                Returns the native name of the selected stream's
+%                shared-memory ring (daq.ini strmMemShared=true).
+%
 %    time = GetTime( myobj )
 %
 %                Returns (double) number of seconds since SpikeGLX application
 %                was launched.
 %
+%    tlm = GetTrigTelemetry( myobj )
+%
+%                Get TTL trigger telemetry as a struct of name/value
+%                pairs: current state, per-state entries and seconds,
+%                transfer times and stream lag percentiles (ms).
+%
 %    version = GetVersion( myobj )
 %
 %                Get SpikeGLX version string.
@@ -230,6 +348,11 @@
 %                Set digital output on/off. Channel strings have form:
 %                'Dev6/port0/line2,Dev6/port0/line5'.
 %
+%    myobj = SetExportLimits( myobj, maxJobs, MBps )
+%
+%                Set count of export jobs run at once, and the read
+%                bandwidth (MB/s) they share. MBps = 0 is unlimited.
+%
 %    myobj = SetMetaData( myobj, metadata_struct )
 %
 %                If a run is in progress, set meta data to be added to the
@@ -294,6 +417,45 @@
 %                Unconditionally stop current run, close data files
 %                and return to idle state.
 %
+%    myobj = SpikeStream( myobj, streamID, channels, thresh_uV, refrac_ms, filt_hz, snip_pre, snip_post )
+%
+%                Turn this connection into a push session for threshold
+%                crossings detected by SpikeGLX on the given neural
+%                channels. Afterward, call only SpikeStreamRead() on it,
+%                then Close() it to end the session.
+%
+%    [evts,doneCt,snips,tEnq] = SpikeStreamRead( myObj )
+%
+%                Block for the next frame of a SpikeStream() session.
+%                Returns Nx3 double matrix [ct channel amplitude],
+%                doneCt = count searched through, and NxS int16
+%                snippets.
+%
+%    myobj = Subscribe( myobj, streamID, channel_subset, downsample_ratio,
+%                       queue_frames )
+%
+%                Turn this connection into a push session for the new
+%                data of one stream. Afterward, call only SubscribeRead()
+%                on it, then Close() it to end the session. Set
+%                queue_frames > 0 to receive frames in the background
+%                while you process earlier ones.
+%
+%    [daqData,headCt,seq,tEnq] = SubscribeRead( myObj )
+%
+%                Block for the next frame of a Subscribe() session.
+%                Returns int16 MxN matrix, headCt = index of first
+%                timepoint, seq = frame number from 0.
+%
+%    myobj = TraceStart( myobj )
+%
+%                Start recording trace events: acquisition, trigger and
+%                graphing zones and counters.
+%
+%    myobj = TraceStop( myobj, filename )
+%
+%                Stop recording and write events since TraceStart() to
+%                filename in Chrome trace JSON (Perfetto, chrome://tracing).
+%
 %    res = VerifySha1( myobj, filename )
 %
 %                Verifies the SHA1 sum of the file specified by filename.
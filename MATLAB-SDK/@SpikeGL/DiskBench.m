@@ -0,0 +1,37 @@
+% res = DiskBench( myobj, secs, blkMB, sha1, direct )
+%
+%     Benchmark the data directories with the write pattern of
+%     the last-set run params (not while running); blocks for
+%     secs (default 10). Optional blkMB (0 = each stream's own),
+%     sha1 (0/1) and direct (0/1) override the params. Returns
+%     a struct: secs, sha1, direct, nDirs, and per directory N
+%     dirN, dirN_nFiles, dirN_needMBps, dirN_MBpsAvg and
+%     dirN_MBpsMin1s (worst 1-second rate).
+%
+function ret = DiskBench( s, varargin )
+
+    cmd = 'DISKBENCH';
+
+    for i = 1:length( varargin )
+        cmd = sprintf( '%s %g', cmd, varargin{i} );
+    end
+
+    ret = struct();
+    res = DoGetResultsCmd( s, cmd );
+
+    for i = 1:length( res )
+
+        pair = ...
+        regexp( res{i}, ...
+        '^\s*(?<name>\w+)\s*=\s*(?<value>.*)\s*$', 'names' );
+
+        if( ~isempty( pair ) )
+            % directories are paths; all other values are numeric
+            val = str2num( pair.value );
+            if( isempty( val ) || ~isempty( regexp( pair.name, '^dir\d+$', 'once' ) ) )
+                val = pair.value;
+            end
+            ret.(pair.name) = val;
+        end
+    end
+end
@@ -1,6 +1,8 @@
 % params = EnumDataDir( myobj )
 %
 %     Retrieve a listing of files in the data directory.
+%     If recording is striped over several disks, all of the
+%     data directories are listed, main directory first.
 %
 function [ret] = EnumDataDir( s )
 
@@ -0,0 +1,40 @@
+% id = ErpStart( myobj, evStreamID, evChan, evBit, streamID, channels, pre_secs, post_secs, ... )
+%
+%     Start a server-side trial average (ERP) of the selected
+%     stream's channels, locked to rising edges of an event line
+%     on stream evStreamID: bit evBit of acquired word evChan,
+%     or if evBit is -1, analog channel evChan crossing
+%     ev_thresh_v. Returns an id for GetErp and ErpStop.
+%
+%     Optional name/value arguments:
+%     'bin_secs'      ERP bin width (default 0.001).
+%     'ev_thresh_v'   analog event threshold, volts (default 0).
+%     'inarow'        samples the level must hold (default 1).
+%     'spk_thresh_uV' negative threshold; adds PSTHs (neural
+%                     channels only).
+%     'psth_secs'     PSTH bin width (default 0.01).
+%     'refrac_ms'     spike dead time (default 1).
+%     'hipass'        spike filter corner, Hz (default 300).
+%
+function id = ErpStart( s, evStreamID, evChan, evBit, streamID, channels, pre_secs, post_secs, varargin )
+
+    opt = struct( 'bin_secs', 0.001, 'ev_thresh_v', 0, 'inarow', 1, ...
+                  'spk_thresh_uV', [], 'psth_secs', 0.01, ...
+                  'refrac_ms', 1, 'hipass', 300 );
+
+    for i = 1:2:length( varargin )
+        opt.(varargin{i}) = varargin{i+1};
+    end
+
+    cmd = sprintf( 'ERPSTART %d %d %d %g %d %d %s %g %g %g', ...
+            evStreamID, evChan, evBit, opt.ev_thresh_v, opt.inarow, ...
+            streamID, sprintf( '%d#', channels ), ...
+            pre_secs, post_secs, opt.bin_secs );
+
+    if( ~isempty( opt.spk_thresh_uV ) )
+        cmd = sprintf( '%s %g %g %g %g', cmd, opt.spk_thresh_uV, ...
+                opt.psth_secs, opt.refrac_ms, opt.hipass );
+    end
+
+    id = str2double( DoQueryCmd( s, cmd ) );
+end
@@ -0,0 +1,8 @@
+% myobj = ErpStop( myobj, id )
+%
+%     Stop and discard trial average id.
+%
+function [s] = ErpStop( s, id )
+
+    DoSimpleCmd( s, sprintf( 'ERPSTOP %d', id ) );
+end
@@ -0,0 +1,15 @@
+% id = ExportAdd( myobj, fmt, t0, t1, chans, filter, filename )
+%
+%     Queue a background export of bin file 'filename' and return
+%     its job id. fmt is one of {'bin','csv','zarr'}. [t0,t1] is
+%     the span in seconds (t1 < 0 is end of file). chans is a
+%     channel string like '0:383,768' or '*' for all. filter = 1
+%     applies zero-phase 300 Hz highpass to spike channels.
+%     If filename is relative, it is appended to the run dir.
+%
+function [ret] = ExportAdd( s, fmt, t0, t1, chans, filter, file )
+
+    ret = str2double( DoQueryCmd( s, ...
+            sprintf( 'EXPORTADD %s %g %g %s %d %s', ...
+                fmt, t0, t1, chans, filter, file ) ) );
+end
@@ -0,0 +1,13 @@
+% myobj = ExportCancel( myobj, id )
+%
+%     Cancel queued or running export job id, or all
+%     jobs if id is 'all'.
+%
+function [s] = ExportCancel( s, id )
+
+    if( ischar( id ) )
+        DoSimpleCmd( s, sprintf( 'EXPORTCANCEL %s', id ) );
+    else
+        DoSimpleCmd( s, sprintf( 'EXPORTCANCEL %d', id ) );
+    end
+end
@@ -1,4 +1,4 @@
-% [daqData,headCt] = Fetch( myObj, streamID, start_scan, scan_ct, channel_subset, downsample_ratio )
+% [daqData,headCt,tEnq] = Fetch( myObj, streamID, start_scan, scan_ct, channel_subset, downsample_ratio, dwnsmp_fir, filt_hz, car )
 %
 %     Get MxN matrix of stream data.
 %     M = scan_ct = max samples to fetch.
@@ -9,10 +9,22 @@
 %     Data are int16 type.
 %
 %     downsample_ratio is an integer (default = 1).
+%     dwnsmp_fir: 0 = average each bin (default), 1 = anti-alias
+%     FIR lowpass at 0.4 of the output rate, then decimate.
 %
-%     Also returns headCt = index of first timepoint in matrix.
+%     filt_hz = [hipass_hz lopass_hz]: causal filter the neural
+%     channels before downsampling; 0 turns a corner off (default
+%     [0 0]). car: 0 = none (default), 1 = subtract global mean,
+%     2 = subtract global median, per shank, from AP channels.
+%     Filter and FIR memory carry over while each fetch starts
+%     where the last ended, so consecutive fetches join without
+%     overlap; FIR replies may then hold fewer scans than asked.
 %
-function [mat,headCt] = Fetch( s, streamID, start_scan, scan_ct, varargin )
+%     Also returns headCt = index of first timepoint in matrix,
+%     and tEnq = time (as GetTime) its newest timepoint was
+%     enqueued.
+%
+function [mat,headCt,tEnq] = Fetch( s, streamID, start_scan, scan_ct, varargin )
 
     if( nargin < 4 )
         error( 'Fetch requires at least 4 arguments' );
@@ -46,9 +58,33 @@ function [mat,headCt] = Fetch( s, streamID, start_scan, scan_ct, varargin )
         end
     end
 
+    dwnfir = 0;
+
+    if( nargin >= 7 )
+        dwnfir = varargin{3};
+    end
+
+    filt = [0 0];
+
+    if( nargin >= 8 )
+
+        filt = varargin{4};
+
+        if( ~isnumeric( filt ) || length( filt ) ~= 2 )
+            error( 'filt_hz must be [hipass_hz lopass_hz]' );
+        end
+    end
+
+    car = 0;
+
+    if( nargin >= 9 )
+        car = varargin{5};
+    end
+
     ok = CalinsNetMex( 'sendString', s.handle, ...
-            sprintf( 'FETCH %d %ld %d %s %d\n', ...
-            streamID, start_scan, scan_ct, subset, dwnsmp ) );
+            sprintf( 'FETCH %d %ld %d %s %d %d %g %g %d\n', ...
+            streamID, start_scan, scan_ct, subset, dwnsmp, dwnfir, ...
+            filt(1), filt(2), car ) );
 
     line = CalinsNetMex( 'readLine', s.handle );
 
@@ -61,6 +97,7 @@ function [mat,headCt] = Fetch( s, streamID, start_scan, scan_ct, varargin )
     cells       = strread( line, '%s' );
     mat_dims	= [str2num(cells{2}) str2num(cells{3})];
     headCt      = str2num(cells{4});
+    tEnq        = str2double(cells{5});
 
     if( ~isnumeric( mat_dims ) || ~size( mat_dims, 2 ) )
         error( 'Invalid matrix dimensions.' );
@@ -1,4 +1,4 @@
-% [daqData,headCt] = FetchLatest( myObj, streamID, scan_ct, channel_subset, downsample_ratio )
+% [daqData,headCt] = FetchLatest( myObj, streamID, scan_ct, channel_subset, downsample_ratio, dwnsmp_fir, filt_hz, car )
 %
 %     Get MxN matrix of the most recent stream data.
 %     M = scan_ct = max samples to fetch.
@@ -7,6 +7,16 @@
 %         SpikeGLX save-channel subset.
 %
 %     downsample_ratio is an integer (default = 1).
+%     dwnsmp_fir: 0 = average each bin (default), 1 = anti-alias
+%     FIR lowpass at 0.4 of the output rate, then decimate.
+%
+%     filt_hz = [hipass_hz lopass_hz]: causal filter the neural
+%     channels before downsampling; 0 turns a corner off (default
+%     [0 0]). car: 0 = none (default), 1 = subtract global mean,
+%     2 = subtract global median, per shank, from AP channels.
+%     Filter and FIR memory carry over while each fetch starts
+%     where the last ended, so consecutive fetches join without
+%     overlap; FIR replies may then hold fewer scans than asked.
 %
 %     Also returns headCt = index of first timepoint in matrix.
 %
@@ -31,11 +41,29 @@ function [mat,headCt] = FetchLatest( s, streamID, scan_ct, varargin )
         end
     end
 
+    dwnfir = 0;
+
+    if( nargin >= 6 )
+        dwnfir = varargin{3};
+    end
+
+    filt = [0 0];
+
+    if( nargin >= 7 )
+        filt = varargin{4};
+    end
+
+    car = 0;
+
+    if( nargin >= 8 )
+        car = varargin{5};
+    end
+
     max_ct = GetScanCount( s, streamID );
 
     if( scan_ct > max_ct )
         scan_ct = max_ct;
     end
 
-    [mat,headCt] = Fetch( s, streamID, max_ct-scan_ct, scan_ct, subset, dwnsmp );
+    [mat,headCt] = Fetch( s, streamID, max_ct-scan_ct, scan_ct, subset, dwnsmp, dwnfir, filt, car );
 end
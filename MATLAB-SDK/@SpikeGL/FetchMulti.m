@@ -0,0 +1,60 @@
+% [daqData,headCt] = FetchMulti( myObj, srcStreamID, start_scan, scan_ct, streamIDs, downsample_ratio )
+%
+%     Get the same absolute time window from several streams
+%     in one request. The window is start_scan, scan_ct of the
+%     source stream, mapped to the others by sync edges.
+%
+%     daqData is a cell array with one MxN int16 matrix per
+%     stream (srcStreamID first, then the rest of streamIDs),
+%     N = that stream's save-channel subset.
+%     headCt is a vector of each matrix's first timepoint.
+%
+%     downsample_ratio is an integer (default = 1).
+%
+function [mat,headCt] = FetchMulti( s, srcStreamID, start_scan, scan_ct, streamIDs, varargin )
+
+    if( nargin < 5 )
+        error( 'FetchMulti requires at least 5 arguments' );
+    end
+
+    ChkConn( s );
+
+    dwnsmp = 1;
+
+    if( nargin >= 6 )
+        dwnsmp = varargin{1};
+    end
+
+    ok = CalinsNetMex( 'sendString', s.handle, ...
+            sprintf( 'FETCHMULTI %d %ld %d %s %d\n', ...
+            srcStreamID, start_scan, scan_ct, ...
+            sprintf( '%d#', streamIDs ), dwnsmp ) );
+
+    line = CalinsNetMex( 'readLine', s.handle );
+
+    if( strfind( line, 'ERROR' ) == 1 )
+        error( line );
+    end
+
+    cells   = strread( line, '%s' );
+    nS      = str2num(cells{2});
+    mat     = cell( 1, nS );
+    headCt  = zeros( 1, nS );
+
+    for i = 1:nS
+
+        % ip, nChans, headCt lo/hi, nScans, bySync
+        hdr         = CalinsNetMex( 'readMatrix', s.handle, 'uint32', [1 6] );
+        nChans      = double( hdr(2) );
+        nScans      = double( hdr(5) );
+        headCt(i)   = double( hdr(3) ) + double( hdr(4) ) * 2^32;
+
+        if( nScans > 0 )
+            mat{i} = CalinsNetMex( 'readMatrix', s.handle, 'int16', [nChans nScans] )';
+        else
+            mat{i} = zeros( 0, nChans, 'int16' );
+        end
+    end
+
+    ReceiveOK( s, 'FETCHMULTI' );
+end
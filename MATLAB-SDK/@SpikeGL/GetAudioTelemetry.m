@@ -0,0 +1,25 @@
+% tlm = GetAudioTelemetry( myobj )
+%
+%     Get audio output telemetry, accumulated since audio
+%     start, as a struct of name/value pairs: callback time,
+%     ring fill, feeder block time and lag percentiles (ms),
+%     and counts of starves (feeder late), devUnderflows
+%     (device late), misses (stream lapped feeder), rejoins
+%     and restarts.
+%
+function ret = GetAudioTelemetry( s )
+
+    ret = struct();
+    res = DoGetResultsCmd( s, 'GETAUDIOTELEMETRY' );
+
+    for i = 1:length( res )
+
+        pair = ...
+        regexp( res{i}, ...
+        '^\s*(?<name>\w+)\s*=\s*(?<value>.*)\s*$', 'names' );
+
+        if( ~isempty( pair ) )
+            ret.(pair.name) = str2num( pair.value );
+        end
+    end
+end
@@ -0,0 +1,24 @@
+% tlm = GetCmdTelemetry( myobj )
+%
+%     Get timing of this connection's data replies (Fetch),
+%     accumulated since it was opened, as a struct of name/value
+%     pairs: for stages read, proc, send, and lat (newest scan
+%     enqueued to reply sent), the count and mean, percentile
+%     and max times (ms).
+%
+function ret = GetCmdTelemetry( s )
+
+    ret = struct();
+    res = DoGetResultsCmd( s, 'GETCMDTELEMETRY' );
+
+    for i = 1:length( res )
+
+        pair = ...
+        regexp( res{i}, ...
+        '^\s*(?<name>\w+)\s*=\s*(?<value>.*)\s*$', 'names' );
+
+        if( ~isempty( pair ) )
+            ret.(pair.name) = str2num( pair.value );
+        end
+    end
+end
@@ -0,0 +1,39 @@
+% erp = GetErp( myobj, id, reset )
+%
+%     Get trial average id so far as a struct: nEvents,
+%     nDropped, binSecs, preSecs, erp [nChans,nBins] (uV) and,
+%     if PSTHs are on, psthSecs and psth [nChans,nPsth]
+%     (spikes/s). Bin k starts (k-1)*binSecs - preSecs from the
+%     event. If reset is 1 the average starts over afterward.
+%
+function ret = GetErp( s, id, reset )
+
+    if( nargin < 3 )
+        reset = 0;
+    end
+
+    res = DoGetResultsCmd( s, sprintf( 'GETERP %d %d', id, reset ) );
+    hdr = str2double( strsplit( res{1}, ',' ) );
+    nC  = hdr(3);
+
+    ret          = struct();
+    ret.nEvents  = hdr(1);
+    ret.nDropped = hdr(2);
+    ret.binSecs  = hdr(5);
+    ret.preSecs  = hdr(6);
+    ret.erp      = zeros( nC, hdr(4) );
+
+    for i = 1:nC
+        ret.erp(i,:) = str2double( strsplit( res{1+i}, ',' ) );
+    end
+
+    if( hdr(7) )
+
+        ret.psthSecs = hdr(8);
+        ret.psth     = zeros( nC, hdr(7) );
+
+        for i = 1:nC
+            ret.psth(i,:) = str2double( strsplit( res{1+nC+i}, ',' ) );
+        end
+    end
+end
@@ -0,0 +1,10 @@
+% status = GetExportStatus( myobj )
+%
+%     Returns a cell array with one line per export job:
+%     'id state percent filename', state one of {queued,
+%     running, done, failed, canceled}.
+%
+function [ret] = GetExportStatus( s )
+
+    ret = DoGetResultsCmd( s, 'GETEXPORTSTATUS' );
+end
@@ -0,0 +1,24 @@
+% tlm = GetImTelemetry( myobj, streamID )
+%
+%     Get acquisition telemetry for selected IMEC probe,
+%     accumulated since run start, as a struct of name/value
+%     pairs: timestamp gap counts and delta histogram, fetch
+%     cycle time percentiles (ms), FIFO fill percentiles (%).
+%
+function ret = GetImTelemetry( s, streamID )
+
+    ret = struct();
+    res = DoGetResultsCmd( s, sprintf( 'GETIMTELEMETRY %d', streamID ) );
+
+    for i = 1:length( res )
+
+        pair = ...
+        regexp( res{i}, ...
+        '^\s*(?<name>\w+)\s*=\s*(?<value>.*)\s*$', 'names' );
+
+        if( ~isempty( pair ) )
+            % all values are numeric; lists are comma-separated
+            ret.(pair.name) = str2num( pair.value );
+        end
+    end
+end
@@ -0,0 +1,24 @@
+% [cols,data] = GetMetricsHist( myobj, lastSecs )
+%
+%     Get the Metrics window history, sampled once a second
+%     and kept after the run ends. cols is a cell array of
+%     column names {t, imFull, niFull, wrMBps, reqMBps,
+%     niDepth, niLag, im0Fifo, im0Awake, im0Depth, im0Lag,
+%     im0Errs, ...};
+%     data is a matrix with one row per sample, oldest first.
+%     Optional lastSecs > 0 returns only that many seconds.
+%
+function [cols,data] = GetMetricsHist( s, lastSecs )
+
+    if( nargin < 2 )
+        lastSecs = 0;
+    end
+
+    res  = DoGetResultsCmd( s, sprintf( 'GETMETRICSHIST %g', lastSecs ) );
+    cols = strsplit( res{1}, ',' );
+    data = zeros( length( res ) - 1, length( cols ) );
+
+    for i = 2:length( res )
+        data(i-1,:) = str2double( strsplit( res{i}, ',' ) );
+    end
+end
@@ -0,0 +1,34 @@
+% rpt = GetScrubReport( myobj )
+%
+%     Get background data scrub status and recent results as
+%     a struct: state (off, resting, scanning, verifying),
+%     paused (holding off while a run writes), current file,
+%     nPass, lastPass, nChecked, nOK, nBad, and results, a
+%     cell array of 'time<tab>OK|BAD<tab>path<tab>detail'
+%     strings, newest last.
+%
+function ret = GetScrubReport( s )
+
+    ret = struct();
+    ret.results = {};
+    res = DoGetResultsCmd( s, 'GETSCRUBREPORT' );
+
+    for i = 1:length( res )
+
+        pair = ...
+        regexp( res{i}, ...
+        '^\s*(?<name>\w+)\s*=\s*(?<value>.*)\s*$', 'names' );
+
+        if( isempty( pair ) )
+            continue;
+        end
+
+        if( strcmp( pair.name, 'result' ) )
+            ret.results{end+1} = pair.value;
+        elseif( any( strcmp( pair.name, {'state','file','lastPass'} ) ) )
+            ret.(pair.name) = pair.value;
+        else
+            ret.(pair.name) = str2num( pair.value );
+        end
+    end
+end
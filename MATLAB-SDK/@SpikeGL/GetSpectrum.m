@@ -0,0 +1,23 @@
+% [binHz,P] = GetSpectrum( myobj, streamID, updtSecs )
+%
+%     Get latest live spectra (Welch PSD, uV^2/Hz) of the
+%     selected stream's neural channels (imec LF if separate,
+%     else AP). P is [nChans,nBins]; bin k is (k-1)*binHz.
+%     Optional updtSecs sets the update interval. The stage
+%     runs only while polled; if not ready yet, retry.
+%
+function [binHz,P] = GetSpectrum( s, streamID, updtSecs )
+
+    if( nargin < 3 )
+        updtSecs = 0;
+    end
+
+    res   = DoGetResultsCmd( s, sprintf( 'GETSPECTRUM %d %g', streamID, updtSecs ) );
+    hdr   = str2double( strsplit( res{1}, ',' ) );
+    binHz = hdr(1);
+    P     = zeros( hdr(3), hdr(2) );
+
+    for i = 2:length( res )
+        P(i-1,:) = str2double( strsplit( res{i}, ',' ) );
+    end
+end
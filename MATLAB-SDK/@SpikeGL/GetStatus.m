@@ -0,0 +1,26 @@
+% statusStruct = GetStatus( myobj )
+%
+%     Returns a struct of run state, audio state and output
+%     latency (ms), and, for each enabled stream, its sample
+%     rate, acquired channel counts, saved channels, scan count
+%     and file start count, in one query.
+%     Fields are prefixed by stream: ni, im0, im1, ...,
+%     e.g., im0srate, niscanCount.
+%
+function ret = GetStatus( s )
+
+    ret = struct();
+    res = DoGetResultsCmd( s, 'GETSTATUS' );
+
+    for i = 1:length( res )
+
+        pair = ...
+        regexp( res{i}, ...
+        '^\s*(?<name>\w+)\s*=\s*(?<value>.*)\s*$', 'names' );
+
+        if( ~isempty( pair ) )
+            % all values are numeric; lists are comma-separated
+            ret.(pair.name) = str2num( pair.value );
+        end
+    end
+end
@@ -0,0 +1,12 @@
+% name = GetStreamShm( myobj, streamID )
+%
+%     Returns the native name of the selected stream's
+%     shared-memory ring (daq.ini strmMemShared=true) so
+%     a local client can map it and read data in place.
+%     Layout: 64-byte header (see AIQ::ShmHdr), then the
+%     scan-interleaved int16 ring.
+%
+function [ret] = GetStreamShm( s, streamID )
+
+    ret = DoQueryCmd( s, sprintf( 'GETSTREAMSHM %d', streamID ) );
+end
@@ -0,0 +1,28 @@
+% tlm = GetTrigTelemetry( myobj )
+%
+%     Get TTL trigger telemetry, accumulated since trigger
+%     start, as a struct of name/value pairs: current state
+%     name, per-state entry counts and seconds, xferAll time
+%     percentiles (ms), tracked stream lag percentiles (ms).
+%
+function ret = GetTrigTelemetry( s )
+
+    ret = struct();
+    res = DoGetResultsCmd( s, 'GETTRIGTELEMETRY' );
+
+    for i = 1:length( res )
+
+        pair = ...
+        regexp( res{i}, ...
+        '^\s*(?<name>\w+)\s*=\s*(?<value>.*)\s*$', 'names' );
+
+        if( ~isempty( pair ) )
+            % state is a name; all other values are numeric
+            val = str2num( pair.value );
+            if( isempty( val ) )
+                val = pair.value;
+            end
+            ret.(pair.name) = val;
+        end
+    end
+end
@@ -0,0 +1,9 @@
+% myobj = SetExportLimits( myobj, maxJobs, MBps )
+%
+%     Set count of export jobs run at once, and the read
+%     bandwidth (MB/s) they share. MBps = 0 is unlimited.
+%
+function [s] = SetExportLimits( s, maxJobs, MBps )
+
+    DoSimpleCmd( s, sprintf( 'SETEXPORTLIMITS %d %g', maxJobs, MBps ) );
+end
@@ -29,6 +29,7 @@ function [s] = SpikeGL( varargin )
     s.in_chkconn	= 0;
     s.handle        = -1;
     s.ver           = '';
+    s.bgrecv        = 0;
 
     s = class( s, 'SpikeGL' );
     s = ChkConn( s );
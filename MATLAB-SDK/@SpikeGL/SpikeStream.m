@@ -0,0 +1,57 @@
+% myobj = SpikeStream( myobj, streamID, channels, thresh_uV, refrac_ms, filt_hz, snip_pre, snip_post )
+%
+%     Turn this connection into a push session for threshold
+%     crossings of one stream. Afterward, call only
+%     SpikeStreamRead() on it, then Close() it to end the
+%     session; use another SpikeGL object for other commands.
+%
+%     channels: vector of neural channel indices to search.
+%     thresh_uV: negative threshold in microvolts.
+%     refrac_ms: dead time per channel after an event (default 1).
+%     filt_hz = [hipass_hz lopass_hz], 0 = off (default [300 0]).
+%     snip_pre, snip_post: snippet samples before and from each
+%     crossing (default 0, no snippets).
+%
+function [s] = SpikeStream( s, streamID, channels, thresh_uV, varargin )
+
+    if( nargin < 4 )
+        error( 'SpikeStream requires at least 4 arguments' );
+    end
+
+    ChkConn( s );
+
+    refrac = 1;
+
+    if( nargin >= 5 )
+        refrac = varargin{1};
+    end
+
+    filt = [300 0];
+
+    if( nargin >= 6 )
+
+        filt = varargin{2};
+
+        if( ~isnumeric( filt ) || length( filt ) ~= 2 )
+            error( 'filt_hz must be [hipass_hz lopass_hz]' );
+        end
+    end
+
+    pre  = 0;
+    post = 0;
+
+    if( nargin >= 7 )
+        pre = varargin{3};
+    end
+
+    if( nargin >= 8 )
+        post = varargin{4};
+    end
+
+    ok = CalinsNetMex( 'sendString', s.handle, ...
+            sprintf( 'SPIKESTREAM %d %s %g %g %g %g %d %d\n', ...
+            streamID, sprintf( '%d#', channels ), thresh_uV, ...
+            refrac, filt(1), filt(2), pre, post ) );
+
+    ReceiveOK( s, 'SPIKESTREAM' );
+end
@@ -0,0 +1,48 @@
+% [evts,doneCt,snips,tEnq] = SpikeStreamRead( myObj )
+%
+%     Block for the next frame of a SpikeStream() session.
+%     Returns Nx3 double matrix evts with one row per event:
+%     [stream count, acquired channel, trough amplitude]; the
+%     amplitude is in filtered int16 counts.
+%
+%     Also returns doneCt = stream count searched through, and
+%     NxS int16 matrix snips of filtered samples around each
+%     event (empty if no snippets were requested), and tEnq =
+%     time (as GetTime) scan doneCt-1 was enqueued.
+%
+function [evts,doneCt,snips,tEnq] = SpikeStreamRead( s )
+
+    % magic, seq, doneCt lo/hi, nEvts, nPre|nPost<<16, tEnq
+    hdr = CalinsNetMex( 'readMatrix', s.handle, 'uint32', [1 8] );
+
+    if( hdr(1) ~= 1347176275 )
+        error( 'SpikeStreamRead: Bad frame header.' );
+    end
+
+    doneCt  = double( hdr(3) ) + double( hdr(4) ) * 2^32;
+    nEvts   = double( hdr(5) );
+    tEnq    = typecast( uint32( hdr(7:8) ), 'double' );
+    nSnip   = double( bitand( hdr(6), 65535 ) ) + double( bitshift( hdr(6), -16 ) );
+
+    evts  = zeros( nEvts, 3 );
+    snips = zeros( 0, nSnip, 'int16' );
+
+    if( nEvts > 0 )
+
+        % ct lo/hi, ic|amp<<16, rsv
+        rec = CalinsNetMex( 'readMatrix', s.handle, 'uint32', [4 nEvts] );
+        rec = double( rec );
+
+        amp = bitshift( rec(3,:), -16 );
+        amp(amp >= 32768) = amp(amp >= 32768) - 65536;
+
+        evts(:,1) = rec(1,:) + rec(2,:) * 2^32;
+        evts(:,2) = bitand( rec(3,:), 65535 );
+        evts(:,3) = amp;
+
+        if( nSnip > 0 )
+            snips = CalinsNetMex( 'readMatrix', s.handle, 'int16', [nSnip nEvts] );
+            snips = snips';
+        end
+    end
+end
@@ -0,0 +1,55 @@
+% myobj = Subscribe( myobj, streamID, channel_subset, downsample_ratio,
+%                    queue_frames )
+%
+%     Turn this connection into a push session for the new data
+%     of one stream. Afterward, call only SubscribeRead() on it,
+%     then Close() it to end the session; use another SpikeGL
+%     object for other commands.
+%
+%     If channel_subset is not specified, the current
+%     SpikeGLX save-channel subset is sent.
+%
+%     downsample_ratio is an integer (default = 1); bins are
+%     averaged.
+%
+%     queue_frames > 0 (default = 0) receives frames on a
+%     background thread into a queue of that many, so network
+%     transfer overlaps your processing; SubscribeRead() then
+%     returns a frame already received, if any. Keep the
+%     returned myobj. Needs a CalinsNetMex built from this SDK.
+%
+function [s] = Subscribe( s, streamID, varargin )
+
+    if( nargin < 2 )
+        error( 'Subscribe requires at least 2 arguments' );
+    end
+
+    ChkConn( s );
+
+    % subset has pattern id1#id2#...
+    if( nargin >= 3 )
+        subset = sprintf( '%d#', varargin{1} );
+    else
+        subset = sprintf( '%d#', GetSaveChans( s, streamID ) );
+    end
+
+    dwnsmp = 1;
+
+    if( nargin >= 4 )
+
+        dwnsmp = varargin{2};
+
+        if( ~isnumeric( dwnsmp ) || length( dwnsmp ) > 1 )
+            error( 'Downsample factor must be a single numeric value' );
+        end
+    end
+
+    ok = CalinsNetMex( 'sendString', s.handle, ...
+            sprintf( 'SUBSCRIBE %d %s %d\n', streamID, subset, dwnsmp ) );
+
+    ReceiveOK( s, 'SUBSCRIBE' );
+
+    if( nargin >= 5 && varargin{3} > 0 )
+        s.bgrecv = CalinsNetMex( 'startRecv', s.handle, varargin{3} );
+    end
+end
@@ -0,0 +1,46 @@
+% [daqData,headCt,seq,tEnq] = SubscribeRead( myObj )
+%
+%     Block for the next frame of a Subscribe() session.
+%     Get MxN matrix of int16 stream data, M = scans in
+%     frame, N = subscribed channel count.
+%
+%     Also returns headCt = index of first timepoint in matrix,
+%     and seq = frame number from 0. Consecutive frames abut
+%     unless the subscriber fell behind the stream buffer.
+%     tEnq = time (as GetTime) the newest scan was enqueued.
+%
+function [mat,headCt,seq,tEnq] = SubscribeRead( s )
+
+    if( s.bgrecv )
+
+        [hdr,mat] = CalinsNetMex( 'readFrame', s.handle );
+
+        if( isempty( hdr ) )
+            error( 'SubscribeRead: Timed out.' );
+        end
+
+        seq     = double( hdr(2) );
+        headCt  = double( hdr(3) ) + double( hdr(4) ) * 2^32;
+        tEnq    = typecast( uint32( hdr(7:8) ), 'double' );
+        mat     = mat';
+        return;
+    end
+
+    % magic, seq, fromCt lo/hi, nChans|dnsmp<<16, nScans, tEnq
+    hdr = CalinsNetMex( 'readMatrix', s.handle, 'uint32', [1 8] );
+
+    if( hdr(1) ~= 1397507923 )
+        error( 'SubscribeRead: Bad frame header.' );
+    end
+
+    seq     = double( hdr(2) );
+    headCt  = double( hdr(3) ) + double( hdr(4) ) * 2^32;
+    nChans  = double( bitand( hdr(5), 65535 ) );
+    nScans  = double( hdr(6) );
+    tEnq    = typecast( uint32( hdr(7:8) ), 'double' );
+
+    mat = CalinsNetMex( 'readMatrix', s.handle, 'int16', [nChans nScans] );
+
+    % transpose
+    mat = mat';
+end
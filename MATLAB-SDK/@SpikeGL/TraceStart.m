@@ -0,0 +1,10 @@
+% myobj = TraceStart( myobj )
+%
+%     Start recording trace events (acquisition, trigger and
+%     graphing zones and counters) in SpikeGLX. Call TraceStop()
+%     to write them to a file.
+%
+function [s] = TraceStart( s )
+
+    DoSimpleCmd( s, 'TRACESTART' );
+end
@@ -0,0 +1,14 @@
+% myobj = TraceStop( myobj, filename )
+%
+%     Stop recording trace events and write those recorded since
+%     TraceStart() to filename (on the SpikeGLX machine) in Chrome
+%     trace JSON format, viewable in Perfetto or chrome://tracing.
+%
+function [s] = TraceStop( s, filename )
+
+    if( ~ischar( filename ) )
+        error( 'TraceStop ''filename'' argument must be a string.' );
+    end
+
+    DoSimpleCmd( s, sprintf( 'TRACESTOP %s', filename ) );
+end
@@ -1,5 +1,6 @@
 
 #include "NetClient.h"
+#include "SubRecv.h"
 
 #include <algorithm>
 #include <map>
@@ -112,6 +113,7 @@ public:
 /* ---------------------------------------------------------------- */
 
 typedef map<int,NetClient*> NetClientMap;
+typedef map<int,SubRecv*>   SubRecvMap;
 
 /* ---------------------------------------------------------------- */
 /* Macros --------------------------------------------------------- */
@@ -133,12 +135,17 @@ typedef map<int,NetClient*> NetClientMap;
         return;                                                     \
     } while(0)
 
+// readFrame wait for the background queue, as NetClient's
+// default read timeout.
+#define FRAME_WAIT_MS   10000
+
 /* ---------------------------------------------------------------- */
 /* Statics -------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
 static SMF          smf;
 static NetClientMap clientMap;
+static SubRecvMap   recvMap;
 static int          handleId = 0;   // keeps getting incremented..
 
 /* ---------------------------------------------------------------- */
@@ -156,10 +163,26 @@ static NetClient *MapFind( int handle )
 }
 
 
+// Stop and delete handle's background receiver, if any.
+//
+static void RecvStop( int handle )
+{
+    SubRecvMap::iterator    it = recvMap.find( handle );
+
+    if( it != recvMap.end() ) {
+
+        delete it->second;
+        recvMap.erase( it );
+    }
+}
+
+
 static void MapPut( int handle, NetClient *client )
 {
     NetClient   *old = MapFind( handle );
 
+    RecvStop( handle );
+
     if( old )
         delete old;
 
@@ -171,6 +194,8 @@ static void MapDestroy( int handle )
 {
     NetClientMap::iterator  it = clientMap.find( handle );
 
+    RecvStop( handle );
+
     if( it != clientMap.end() ) {
 
         delete it->second;
@@ -320,6 +345,7 @@ void closeSocket(
 {
     NetClient   *nc = GetNetClient( nrhs, prhs );
 
+    RecvStop( GetHandle( nrhs, prhs ) );
     nc->tcpDisconnect();
 }
 
@@ -647,6 +673,108 @@ void readMatrix(
 }
 
 
+// ok = startRecv( handle, nBlocks )
+//
+// Begin background receipt of SUBSCRIBE frames into a
+// queue of nBlocks; read them with readFrame.
+//
+void startRecv(
+    int             nlhs,
+    mxArray         *plhs[],
+    int             nrhs,
+    const mxArray   *prhs[] )
+{
+    if( nlhs < 1 )
+        mexErrMsgTxt( "startRecv returns ok to LHS." );
+
+    if( nrhs != 2
+        || !mxIsDouble( prhs[1] )
+        || mxGetM( prhs[1] ) != 1
+        || mxGetN( prhs[1] ) != 1 ) {
+
+        mexErrMsgTxt( "startRecv requires RHS: handle, nBlocks." );
+    }
+
+    NetClient   *nc = GetNetClient( nrhs, prhs );
+    int         h   = GetHandle( nrhs, prhs );
+
+    RecvStop( h );
+    recvMap[h] = new SubRecv( *nc, static_cast<int>(*mxGetPr( prhs[1] )) );
+
+    RETURN( 1 );
+}
+
+
+// [hdr, matrix] = readFrame( handle )
+//
+// Next SUBSCRIBE frame: uint32 1x8 header, int16 [nChans nScans]
+// data. Taken from the queue if startRecv was called, else read
+// straight from the socket. Both empty on timeout.
+//
+void readFrame(
+    int             nlhs,
+    mxArray         *plhs[],
+    int             nrhs,
+    const mxArray   *prhs[] )
+{
+    if( nlhs < 2 )
+        mexErrMsgTxt( "readFrame returns header, matrix to LHS." );
+
+    NetClient           *nc = GetNetClient( nrhs, prhs );
+    SubRecvMap::iterator it = recvMap.find( GetHandle( nrhs, prhs ) );
+    vector<char>        frame;
+    uint                H[SubRecv::HDRBYTES / sizeof(uint)];
+
+    plhs[0] = mxCreateDoubleMatrix( 0, 0, mxREAL );
+    plhs[1] = mxCreateDoubleMatrix( 0, 0, mxREAL );
+
+    try {
+
+        if( it != recvMap.end() ) {
+
+            string  err;
+
+            if( !it->second->get( frame, err, FRAME_WAIT_MS ) ) {
+
+                if( err.length() )
+                    mexErrMsgTxt( err.c_str() );
+
+                return;
+            }
+
+            memcpy( H, &frame[0], SubRecv::HDRBYTES );
+        }
+        else if( nc->receiveData( H, SubRecv::HDRBYTES ) != SubRecv::HDRBYTES )
+            return;
+
+        if( H[0] != SubRecv::MAGIC )
+            mexErrMsgTxt( "readFrame: Bad frame header." );
+
+        mwSize  nC      = H[4] & 0xFFFF,
+                nS      = H[5];
+        uint    nBytes  = nC * nS * sizeof(short);
+
+        mxDestroyArray( plhs[1] );
+        plhs[1] = mxCreateNumericMatrix( nC, nS, mxINT16_CLASS, mxREAL );
+
+        if( frame.size() )
+            memcpy( mxGetData( plhs[1] ), &frame[SubRecv::HDRBYTES], nBytes );
+        else if( nc->receiveData( mxGetData( plhs[1] ), nBytes ) != nBytes )
+            mexErrMsgTxt( "readFrame: Short frame." );
+
+        mxDestroyArray( plhs[0] );
+        plhs[0] = mxCreateNumericMatrix( 1, 8, mxUINT32_CLASS, mxREAL );
+        memcpy( mxGetData( plhs[0] ), H, SubRecv::HDRBYTES );
+    }
+    catch( const SockErr &e ) {
+
+        const string &why = e.why();
+
+        mexErrMsgTxt( why.length() ? why.c_str() : "readFrame failed." );
+    }
+}
+
+
 // filename = fastGetFilename()
 //
 void fastGetFilename(
@@ -692,6 +820,8 @@ void mexFunction(
         cmd2fun["readline"]                     = readLine;
         cmd2fun["readlines"]                    = readLines;
         cmd2fun["readmatrix"]                   = readMatrix;
+        cmd2fun["startrecv"]                    = startRecv;
+        cmd2fun["readframe"]                    = readFrame;
         cmd2fun["getspikeglfilenamefromshm"]    = fastGetFilename;
     }
 
@@ -0,0 +1,171 @@
+
+#include "SubRecv.h"
+
+#include <string.h>
+
+#include <chrono>
+
+
+
+
+SubRecv::SubRecv( NetClient &nc, int nBlk )
+    :   nc(nc), blk(nBlk < 2 ? 2 : nBlk),
+        iPut(0), iGet(0), nFull(0), pleaseStop(false), ended(false)
+{
+    thd = thread( &SubRecv::run, this );
+}
+
+
+// Copy out the oldest frame and free its slot, waiting up to
+// waitMS for one. Return false on timeout (error empty) or if
+// the session has ended (error says why).
+//
+bool SubRecv::get(
+    vector<char>    &frame,
+    string          &error,
+    uint            waitMS )
+{
+    unique_lock<mutex>  lk( mtx );
+    chrono::steady_clock::time_point
+                        tLim = chrono::steady_clock::now()
+                                + chrono::milliseconds( waitMS );
+
+    while( !nFull && !ended ) {
+
+        if( condFull.wait_until( lk, tLim ) == cv_status::timeout )
+            break;
+    }
+
+    if( !nFull ) {
+        error = err;
+        return false;
+    }
+
+    Blk &B = blk[iGet];
+
+    frame.resize( B.nBytes );
+    memcpy( &frame[0], &B.data[0], B.nBytes );
+
+    iGet = (iGet + 1) % blk.size();
+    --nFull;
+
+    lk.unlock();
+    condFree.notify_one();
+
+    return true;
+}
+
+
+void SubRecv::stop()
+{
+    if( !thd.joinable() )
+        return;
+
+    {
+        lock_guard<mutex>   lk( mtx );
+        pleaseStop = true;
+    }
+
+    condFree.notify_one();
+    nc.tcpDisconnect();
+    thd.join();
+}
+
+
+// Fill slots in order; when all are full, wait for the
+// client, leaving further frames in the socket buffers.
+//
+void SubRecv::run()
+{
+    try {
+
+        for(;;) {
+
+            Blk *B;
+
+            {
+                unique_lock<mutex>  lk( mtx );
+
+                while( nFull >= (int)blk.size() && !pleaseStop )
+                    condFree.wait( lk );
+
+                if( pleaseStop )
+                    break;
+
+                B = &blk[iPut];
+            }
+
+            // Header: magic, seq, fromCt lo/hi,
+            // nChans|dnsmp<<16, nScans, tEnq
+
+            uint    H[HDRBYTES / sizeof(uint)];
+
+            if( !readAll( (char*)H, HDRBYTES ) )
+                break;
+
+            if( H[0] != MAGIC ) {
+                err = "SubscribeRead: Bad frame header.";
+                break;
+            }
+
+            uint    nBytes = HDRBYTES + (H[4] & 0xFFFF) * H[5] * sizeof(short);
+
+            if( B->data.size() < nBytes )
+                B->data.resize( nBytes );
+
+            memcpy( &B->data[0], H, HDRBYTES );
+
+            if( !readAll( &B->data[HDRBYTES], nBytes - HDRBYTES ) )
+                break;
+
+            B->nBytes = nBytes;
+
+            {
+                lock_guard<mutex>   lk( mtx );
+                iPut = (iPut + 1) % blk.size();
+                ++nFull;
+            }
+
+            condFull.notify_one();
+        }
+    }
+    catch( const SockErr &e ) {
+        err = e.why();
+    }
+
+    {
+        lock_guard<mutex>   lk( mtx );
+
+        if( !pleaseStop && err.empty() )
+            err = "Subscribe session ended.";
+
+        ended = true;
+    }
+
+    condFull.notify_all();
+}
+
+
+// Receive exactly bytes, riding out read timeouts (the stream
+// may be idle). Return false if asked to stop.
+//
+bool SubRecv::readAll( char *dst, uint bytes )
+{
+    uint    got = 0;
+
+    while( got < bytes ) {
+
+        {
+            lock_guard<mutex>   lk( mtx );
+
+            if( pleaseStop )
+                return false;
+        }
+
+        got += nc.receiveData( dst + got, bytes - got );
+    }
+
+    return true;
+}
+
+
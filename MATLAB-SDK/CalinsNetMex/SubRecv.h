@@ -0,0 +1,71 @@
+#ifndef SUBRECV_H
+#define SUBRECV_H
+
+/* ---------------------------------------------------------------- */
+/* Includes ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#include "NetClient.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/* ---------------------------------------------------------------- */
+/* SubRecv -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Background receiver for a SUBSCRIBE push session. A thread
+// reads whole frames (32-byte header + int16 payload) into a
+// ring of nBlk slots while MATLAB works on earlier frames, so
+// transfer and computation overlap. Slots grow to the largest
+// frame seen and are then reused without allocation.
+//
+// While running, the thread owns the socket; the client must
+// not issue other commands on it. stop() shuts the socket down
+// to wake the thread, so the session ends with it.
+//
+class SubRecv
+{
+private:
+    struct Blk {
+        vector<char>    data;
+        uint            nBytes;
+        Blk() : nBytes(0)   {}
+    };
+
+    NetClient               &nc;
+    vector<Blk>             blk;
+    mutex                   mtx;
+    condition_variable      condFull,
+                            condFree;
+    thread                  thd;
+    string                  err;
+    int                     iPut,
+                            iGet,
+                            nFull;
+    bool                    pleaseStop,
+                            ended;
+
+public:
+    enum { HDRBYTES = 32, MAGIC = 0x534C4753 };
+
+public:
+    SubRecv( NetClient &nc, int nBlk );
+    virtual ~SubRecv()  {stop();}
+
+    bool get(
+        vector<char>    &frame,
+        string          &error,
+        uint            waitMS );
+
+    void stop();
+
+private:
+    void run();
+    bool readAll( char *dst, uint bytes );
+};
+
+#endif  // SUBRECV_H
+
+
@@ -1,2 +1,2 @@
-"C:\Program Files\MATLAB\R2014b\bin\win32\mex" -DWIN32 -I. CalinsNetMex.cpp Socket.cpp NetClient.cpp wsock32.lib
+"C:\Program Files\MATLAB\R2014b\bin\win32\mex" -DWIN32 -I. CalinsNetMex.cpp Socket.cpp NetClient.cpp SubRecv.cpp wsock32.lib
 pause
@@ -0,0 +1,656 @@
+"""
+Talking live to SpikeGLX from Python.
+
+Speaks the SpikeGLX Remote Command Server protocol, as does the
+MATLAB-SDK. Binary replies are received straight into buffers
+that numpy arrays are built on (no intermediate copies):
+
+    from sglx import SpikeGL
+
+    sgl = SpikeGL( '127.0.0.1' )
+    srate = sgl.get_sample_rate( 0 )
+    data, head_ct = sgl.fetch_latest( 0, 3000 )   # int16 [nScans, nChans]
+
+Push sessions take over their connection; open a second SpikeGL
+for other commands while one runs:
+
+    sub = SpikeGL( '127.0.0.1' ).subscribe( 0, '0:31' )
+    for hdr, data in sub:
+        ...
+
+AsyncSpikeGL offers the same calls as asyncio coroutines, and
+StreamShm reads a stream ring placed in shared memory by a
+SpikeGLX on this machine (daq.ini strmMemShared=true; Windows).
+
+Requires numpy.
+"""
+
+import asyncio
+import mmap
+import socket
+import struct
+
+import numpy as np
+
+
+DEF_PORT        = 4142
+
+SUB_MAGIC       = 0x534C4753    # 'SGLS'
+SPIKEEVT_MAGIC  = 0x504C4753    # 'SGLP'
+SHM_MAGIC       = 0x514C4753    # 'SGLQ'
+
+# Wire headers, little-endian; see CmdServer.h, SpikeEvt.h, AIQ.h.
+SUB_HDR         = struct.Struct( '<IIQHHId' )   # magic seq fromCt nChans dnsmp nScans tEnq
+MULTI_HDR       = struct.Struct( '<iIQII' )     # ip nChans headCt nScans bySync
+SPIKEEVT_HDR    = struct.Struct( '<IIQIHHd' )   # magic seq doneCt nEvts nPre nPost tEnq
+SHM_HDR         = struct.Struct( '<IIiiddQQQ8x' )
+
+SPIKEEVT_REC    = np.dtype( [('ct', '<u8'), ('ic', '<u2'),
+                             ('amp', '<i2'), ('rsv', '<u4')] )
+
+
+class SpikeGLError( Exception ):
+    pass
+
+
+def chan_str( chans ):
+    """
+    Channel subset pattern for a command: '*' (saved set) if
+    chans is None, a string as given ('0:31,40'), else ids
+    joined as 'id1#id2#...'.
+    """
+    if chans is None:
+        return '*'
+    if isinstance( chans, str ):
+        return chans
+    return ''.join( '%d#' % c for c in chans )
+
+
+def parse_pairs( lines ):
+    """
+    Lines of form 'name = value' to dict of strings.
+    """
+    d = {}
+    for L in lines:
+        k, sep, v = L.partition( '=' )
+        if sep:
+            d[k.strip()] = v.strip()
+    return d
+
+
+# ----------------------------------------------------------------
+# Blocking client
+# ----------------------------------------------------------------
+
+class SpikeGL:
+    """
+    One connection to the Command Server. Method names follow
+    the MATLAB @SpikeGL functions.
+    """
+
+    def __init__( self, host = 'localhost', port = DEF_PORT, timeout = 10.0 ):
+        self.sock = socket.create_connection( (host, port), timeout )
+        self.sock.setsockopt( socket.IPPROTO_TCP, socket.TCP_NODELAY, 1 )
+        self.rbuf = bytearray()
+        self.ver  = self.query( 'GETVERSION' )
+        # App secs (as GETTIME) the last fetch's newest scan was
+        # enqueued, and its reply begun.
+        self.last_t_enq  = 0.0
+        self.last_t_send = 0.0
+
+    def close( self ):
+        if self.sock:
+            try:
+                self.sock.sendall( b'BYE\n' )
+            except OSError:
+                pass
+            self.sock.close()
+            self.sock = None
+
+    def __enter__( self ):
+        return self
+
+    def __exit__( self, *exc ):
+        self.close()
+
+    # ---------
+    # Transport
+    # ---------
+
+    def _send( self, line ):
+        self.sock.sendall( (line + '\n').encode() )
+
+    def _readline( self ):
+        while True:
+            i = self.rbuf.find( b'\n' )
+            if i >= 0:
+                line = bytes( self.rbuf[:i] )
+                del self.rbuf[:i+1]
+                return line.decode().rstrip( '\r' )
+            b = self.sock.recv( 65536 )
+            if not b:
+                raise SpikeGLError( 'Connection closed.' )
+            self.rbuf += b
+
+    def _recv_into( self, mv ):
+        # Drain line-buffered bytes first, then read in place.
+        n = min( len( self.rbuf ), len( mv ) )
+        if n:
+            mv[:n] = self.rbuf[:n]
+            del self.rbuf[:n]
+        while n < len( mv ):
+            k = self.sock.recv_into( mv[n:] )
+            if not k:
+                raise SpikeGLError( 'Connection closed.' )
+            n += k
+
+    def _recv_array( self, dtype, shape, out = None ):
+        """
+        Receive an array; if out (writable, C-contiguous, right
+        size) is given, data land in it, else in a new buffer.
+        """
+        dtype  = np.dtype( dtype )
+        nbytes = int( np.prod( shape ) ) * dtype.itemsize
+        if out is None:
+            out = np.empty( shape, dtype )
+        elif out.nbytes != nbytes or not out.flags.c_contiguous:
+            raise ValueError( 'out buffer has wrong size or layout' )
+        if nbytes:
+            self._recv_into( memoryview( out.reshape( -1 ).view( np.uint8 ) ) )
+        return out.reshape( shape )
+
+    def _recv_struct( self, S ):
+        b = bytearray( S.size )
+        self._recv_into( memoryview( b ) )
+        return S.unpack( b )
+
+    def _receive_ok( self, cmd ):
+        line = self._readline()
+        if line.startswith( 'ERROR' ):
+            raise SpikeGLError( '%s: %s' % (cmd, line) )
+        if line != 'OK':
+            raise SpikeGLError( "After cmd [%s] got [%s] but expected 'OK'." % (cmd, line) )
+
+    # --------
+    # Commands
+    # --------
+
+    def command( self, cmd ):
+        """Send cmd, expect OK."""
+        self._send( cmd )
+        self._receive_ok( cmd )
+
+    def results( self, cmd ):
+        """Send cmd, return reply lines up to OK."""
+        self._send( cmd )
+        lines = []
+        while True:
+            line = self._readline()
+            if line == 'OK':
+                return lines
+            if line.startswith( 'ERROR' ):
+                raise SpikeGLError( '%s: %s' % (cmd, line) )
+            if line:
+                lines.append( line )
+
+    def query( self, cmd ):
+        """Send cmd, return single reply line."""
+        lines = self.results( cmd )
+        return lines[0] if lines else ''
+
+    def get_params( self ):
+        return parse_pairs( self.results( 'GETPARAMS' ) )
+
+    def get_sample_rate( self, stream ):
+        return float( self.query( 'GETSAMPLERATE %d' % stream ) )
+
+    def get_scan_count( self, stream ):
+        return int( self.query( 'GETSCANCOUNT %d' % stream ) )
+
+    def get_save_chans( self, stream ):
+        return self.query( 'GETSAVECHANS %d' % stream )
+
+    def get_status( self ):
+        """
+        Run and audio state (audioLatencyMs) and all enabled
+        streams' rates, counts and channel lists in one query;
+        stream keys prefixed ni, im0, ...
+        """
+        return parse_pairs( self.results( 'GETSTATUS' ) )
+
+    def get_stream_shm( self, stream ):
+        return self.query( 'GETSTREAMSHM %d' % stream )
+
+    def get_spectrum( self, stream, updt_secs = 0 ):
+        """
+        Latest live spectra (uV^2/Hz) of the stream's neural
+        channels as (binHz, float array [nChans, nBins]).
+        The stage runs only while polled; retry if not ready.
+        """
+        lines = self.results( 'GETSPECTRUM %d %g' % (stream, updt_secs) )
+        hdr   = lines[0].split( ',' )
+        P     = [[float( v ) for v in L.split( ',' )] for L in lines[1:]]
+        return float( hdr[0] ), np.array( P, dtype = np.float64 ).reshape( int( hdr[2] ), int( hdr[1] ) )
+
+    def erp_start( self, ev_stream, ev_chan, ev_bit, stream, chans,
+                   pre_secs, post_secs, bin_secs = 0.001, ev_thresh_v = 0,
+                   inarow = 1, spk_thresh_uV = None, psth_secs = 0.01,
+                   refrac_ms = 1.0, hipass = 300 ):
+        """
+        Start a server-side trial average of stream's chans locked
+        to rising edges of ev_stream's line (bit ev_bit of word
+        ev_chan; ev_bit -1 = analog ev_chan through ev_thresh_v).
+        A (negative) spk_thresh_uV adds PSTHs. Return its id.
+        """
+        cmd = 'ERPSTART %d %d %d %g %d %d %s %g %g %g' % (
+                ev_stream, ev_chan, ev_bit, ev_thresh_v, inarow,
+                stream, chan_str( chans ), pre_secs, post_secs, bin_secs)
+        if spk_thresh_uV is not None:
+            cmd += ' %g %g %g %g' % (spk_thresh_uV, psth_secs, refrac_ms, hipass)
+        return int( self.query( cmd ) )
+
+    def get_erp( self, id, reset = False ):
+        """
+        Trial average id so far as dict: n_events, n_dropped,
+        bin_secs, pre_secs, erp (uV, [nChans, nBins]) and, if
+        PSTHs are on, psth_secs and psth (spikes/s). Bin k starts
+        k * bin_secs - pre_secs from the event. reset starts the
+        average over after reading.
+        """
+        lines = self.results( 'GETERP %d %d' % (id, 1 if reset else 0) )
+        hdr   = lines[0].split( ',' )
+        nC    = int( hdr[2] )
+        rows  = [[float( v ) for v in L.split( ',' )] for L in lines[1:]]
+        d = {'n_events':  int( hdr[0] ),
+             'n_dropped': int( hdr[1] ),
+             'bin_secs':  float( hdr[4] ),
+             'pre_secs':  float( hdr[5] ),
+             'erp':       np.array( rows[:nC], dtype = np.float64 ).reshape( nC, int( hdr[3] ) )}
+        if int( hdr[6] ):
+            d['psth_secs'] = float( hdr[7] )
+            d['psth']      = np.array( rows[nC:], dtype = np.float64 ).reshape( nC, int( hdr[6] ) )
+        return d
+
+    def erp_stop( self, id ):
+        self.command( 'ERPSTOP %d' % id )
+
+    def get_spec_band( self, stream, lo_hz, hi_hz ):
+        """Per channel power (uV^2) in [lo_hz, hi_hz]."""
+        lines = self.results( 'GETSPECBAND %d %g %g' % (stream, lo_hz, hi_hz) )
+        return np.array( [float( L ) for L in lines], dtype = np.float64 )
+
+    def get_im_telemetry( self, stream ):
+        return parse_pairs( self.results( 'GETIMTELEMETRY %d' % stream ) )
+
+    def get_cmd_telemetry( self ):
+        """This connection's reply timing: read, proc, send, lat."""
+        return parse_pairs( self.results( 'GETCMDTELEMETRY' ) )
+
+    def get_trig_telemetry( self ):
+        return parse_pairs( self.results( 'GETTRIGTELEMETRY' ) )
+
+    def get_audio_telemetry( self ):
+        return parse_pairs( self.results( 'GETAUDIOTELEMETRY' ) )
+
+    def get_metrics_hist( self, last_secs = 0 ):
+        """
+        Metrics history, 1 s per row, as (columns, float array
+        [nRows, nCols]); last_secs > 0 limits rows to that span.
+        """
+        lines = self.results( 'GETMETRICSHIST %g' % last_secs )
+        cols  = lines[0].split( ',' )
+        rows  = [[float( v ) for v in L.split( ',' )] for L in lines[1:]]
+        return cols, np.array( rows, dtype = np.float64 ).reshape( -1, len( cols ) )
+
+    def get_scrub_report( self ):
+        """
+        Background data scrub state and counts, with 'results' a
+        list of (time, OK|BAD, path, detail) tuples, newest last.
+        """
+        lines = self.results( 'GETSCRUBREPORT' )
+        d = parse_pairs( [L for L in lines if not L.startswith( 'result=' )] )
+        d['results'] = [tuple( L[7:].split( '\t' ) )
+                        for L in lines if L.startswith( 'result=' )]
+        return d
+
+    def disk_bench( self, secs = 10, blk_mb = 0, sha1 = 1, direct = None ):
+        """
+        Benchmark the data directories with the last-set params'
+        write pattern (blocks secs; not while running). blk_mb 0
+        keeps each stream's block size; direct None keeps the
+        params' setting. Returns dict of strings: per directory
+        dirN, dirN_needMBps, dirN_MBpsAvg, dirN_MBpsMin1s, ...
+        """
+        cmd = 'DISKBENCH %g %g %d' % (secs, blk_mb, sha1)
+        if direct is not None:
+            cmd += ' %d' % direct
+        tout = self.sock.gettimeout()
+        self.sock.settimeout( None if tout is None else tout + secs )
+        try:
+            return parse_pairs( self.results( cmd ) )
+        finally:
+            self.sock.settimeout( tout )
+
+    def is_running( self ):
+        return int( self.query( 'ISRUNNING' ) ) != 0
+
+    # -----
+    # Fetch
+    # -----
+
+    def fetch( self, stream, start, count, chans = None, dnsmp = 1,
+               fir = False, hipass = 0, lopass = 0, car = 0, out = None ):
+        """
+        Return (int16 [nScans, nChans], head_ct) starting at
+        stream count start. See Fetch.m for the options. Pass a
+        preallocated out array to receive into it directly.
+        """
+        cmd = 'FETCH %d %d %d %s %d %d %g %g %d' % (
+                stream, start, count, chan_str( chans ),
+                dnsmp, 1 if fir else 0, hipass, lopass, car)
+        self._send( cmd )
+        line = self._readline()
+        if line.startswith( 'ERROR' ):
+            raise SpikeGLError( line )
+        tok    = line.split()
+        nC, nS = int( tok[1] ), int( tok[2] )
+        headCt = int( tok[3][7:-1] )
+        if len( tok ) >= 6:
+            self.last_t_enq, self.last_t_send = float( tok[4] ), float( tok[5] )
+        if out is not None and out.size != nC * nS:
+            out = None
+        data = self._recv_array( np.int16, (nS, nC), out )
+        self._receive_ok( 'FETCH' )
+        return data, headCt
+
+    def fetch_latest( self, stream, count, **kw ):
+        end = self.get_scan_count( stream )
+        count = min( count, end )
+        return self.fetch( stream, end - count, count, **kw )
+
+    def fetch_multi( self, src, start, count, streams, dnsmp = 1 ):
+        """
+        Same time window from several streams, mapped by sync.
+        Return list of (ip, int16 [nScans, nChans], head_ct, bySync).
+        """
+        cmd = 'FETCHMULTI %d %d %d %s %d' % (
+                src, start, count, chan_str( streams ), dnsmp)
+        self._send( cmd )
+        line = self._readline()
+        if line.startswith( 'ERROR' ):
+            raise SpikeGLError( line )
+        res = []
+        for i in range( int( line.split()[1] ) ):
+            ip, nC, headCt, nS, bySync = self._recv_struct( MULTI_HDR )
+            res.append( (ip, self._recv_array( np.int16, (nS, nC) ),
+                         headCt, bySync != 0) )
+        self._receive_ok( 'FETCHMULTI' )
+        return res
+
+    # -------------
+    # Push sessions
+    # -------------
+
+    def subscribe( self, stream, chans = None, dnsmp = 1, from_ct = None ):
+        """
+        Turn this connection into a SUBSCRIBE session; return a
+        Subscription, iterable over (header dict, data) frames.
+        """
+        cmd = 'SUBSCRIBE %d %s %d' % (stream, chan_str( chans ), dnsmp)
+        if from_ct is not None:
+            cmd += ' %d' % from_ct
+        self.sock.settimeout( None )
+        self.command( cmd )
+        return Subscription( self )
+
+    def spike_stream( self, stream, chans, thresh_uV, refrac_ms = 1.0,
+                      hipass = 300, lopass = 0, snip_pre = 0, snip_post = 0 ):
+        """
+        Turn this connection into a SPIKESTREAM session; return a
+        SpikeStream, iterable over (header dict, events, snippets).
+        """
+        cmd = 'SPIKESTREAM %d %s %g %g %g %g %d %d' % (
+                stream, chan_str( chans ), thresh_uV, refrac_ms,
+                hipass, lopass, snip_pre, snip_post)
+        self.sock.settimeout( None )
+        self.command( cmd )
+        return SpikeStream( self )
+
+
+class Subscription:
+    """
+    Frames of a SUBSCRIBE session. With nbuf > 0, frames are
+    received into a rotating pool of nbuf buffers, so no memory
+    is allocated in steady state; an array is then valid until
+    nbuf further frames have been read.
+    """
+
+    def __init__( self, sgl, nbuf = 0 ):
+        self.sgl  = sgl
+        self.pool = [None] * nbuf
+        self.ipool = 0
+
+    def read( self ):
+        """Block for next frame: (header dict, int16 [nScans, nChans])."""
+        magic, seq, fromCt, nC, dnsmp, nS, tEnq = self.sgl._recv_struct( SUB_HDR )
+        if magic != SUB_MAGIC:
+            raise SpikeGLError( 'Subscription: bad frame header.' )
+        out = None
+        if self.pool:
+            b = self.pool[self.ipool]
+            if b is None or b.size < nS * nC:
+                b = self.pool[self.ipool] = np.empty( max( nS * nC, 1 ), np.int16 )
+            out = b[:nS * nC]
+            self.ipool = (self.ipool + 1) % len( self.pool )
+        data = self.sgl._recv_array( np.int16, (nS, nC), out )
+        return dict( seq = seq, from_ct = fromCt, dnsmp = dnsmp, t_enq = tEnq ), data
+
+    def __iter__( self ):
+        while True:
+            yield self.read()
+
+    def close( self ):
+        self.sgl.sock.close()
+
+
+class SpikeStream:
+    """Frames of a SPIKESTREAM session."""
+
+    def __init__( self, sgl ):
+        self.sgl = sgl
+
+    def read( self ):
+        """
+        Block for next frame: (header dict, SPIKEEVT_REC events,
+        int16 [nEvts, nPre + nPost] snippets).
+        """
+        magic, seq, doneCt, nE, nPre, nPost, tEnq = self.sgl._recv_struct( SPIKEEVT_HDR )
+        if magic != SPIKEEVT_MAGIC:
+            raise SpikeGLError( 'SpikeStream: bad frame header.' )
+        evts  = self.sgl._recv_array( SPIKEEVT_REC, (nE,) )
+        snips = self.sgl._recv_array( np.int16, (nE, nPre + nPost) )
+        return dict( seq = seq, done_ct = doneCt, n_pre = nPre, n_post = nPost,
+                     t_enq = tEnq ), evts, snips
+
+    def __iter__( self ):
+        while True:
+            yield self.read()
+
+    def close( self ):
+        self.sgl.sock.close()
+
+
+# ----------------------------------------------------------------
+# asyncio client
+# ----------------------------------------------------------------
+
+class AsyncSpikeGL:
+    """
+    asyncio flavor: await AsyncSpikeGL.connect( host ), then
+    await the same calls; push sessions are async iterators:
+
+        async for hdr, data in await sgl.subscribe( 0 ):
+            ...
+    """
+
+    def __init__( self, reader, writer ):
+        self.r   = reader
+        self.w   = writer
+        self.ver = ''
+
+    @classmethod
+    async def connect( cls, host = 'localhost', port = DEF_PORT ):
+        r, w = await asyncio.open_connection( host, port )
+        self = cls( r, w )
+        self.ver = await self.query( 'GETVERSION' )
+        return self
+
+    async def close( self ):
+        self.w.close()
+        await self.w.wait_closed()
+
+    async def _send( self, line ):
+        self.w.write( (line + '\n').encode() )
+        await self.w.drain()
+
+    async def _readline( self ):
+        b = await self.r.readline()
+        if not b:
+            raise SpikeGLError( 'Connection closed.' )
+        return b.decode().rstrip( '\r\n' )
+
+    async def _recv_array( self, dtype, shape ):
+        dtype  = np.dtype( dtype )
+        nbytes = int( np.prod( shape ) ) * dtype.itemsize
+        b = await self.r.readexactly( nbytes ) if nbytes else b''
+        return np.frombuffer( b, dtype ).reshape( shape )
+
+    async def _recv_struct( self, S ):
+        return S.unpack( await self.r.readexactly( S.size ) )
+
+    async def _receive_ok( self, cmd ):
+        line = await self._readline()
+        if line != 'OK':
+            raise SpikeGLError( '%s: %s' % (cmd, line) )
+
+    async def command( self, cmd ):
+        await self._send( cmd )
+        await self._receive_ok( cmd )
+
+    async def results( self, cmd ):
+        await self._send( cmd )
+        lines = []
+        while True:
+            line = await self._readline()
+            if line == 'OK':
+                return lines
+            if line.startswith( 'ERROR' ):
+                raise SpikeGLError( '%s: %s' % (cmd, line) )
+            if line:
+                lines.append( line )
+
+    async def query( self, cmd ):
+        lines = await self.results( cmd )
+        return lines[0] if lines else ''
+
+    async def get_sample_rate( self, stream ):
+        return float( await self.query( 'GETSAMPLERATE %d' % stream ) )
+
+    async def get_scan_count( self, stream ):
+        return int( await self.query( 'GETSCANCOUNT %d' % stream ) )
+
+    async def fetch( self, stream, start, count, chans = None, dnsmp = 1,
+                     fir = False, hipass = 0, lopass = 0, car = 0 ):
+        await self._send( 'FETCH %d %d %d %s %d %d %g %g %d' % (
+                stream, start, count, chan_str( chans ),
+                dnsmp, 1 if fir else 0, hipass, lopass, car) )
+        line = await self._readline()
+        if line.startswith( 'ERROR' ):
+            raise SpikeGLError( line )
+        tok  = line.split()
+        data = await self._recv_array( np.int16, (int( tok[2] ), int( tok[1] )) )
+        await self._receive_ok( 'FETCH' )
+        return data, int( tok[3][7:-1] )
+
+    async def subscribe( self, stream, chans = None, dnsmp = 1 ):
+        await self.command( 'SUBSCRIBE %d %s %d' % (stream, chan_str( chans ), dnsmp) )
+        return self._sub_frames()
+
+    async def _sub_frames( self ):
+        while True:
+            magic, seq, fromCt, nC, dnsmp, nS, tEnq = await self._recv_struct( SUB_HDR )
+            if magic != SUB_MAGIC:
+                raise SpikeGLError( 'Subscription: bad frame header.' )
+            data = await self._recv_array( np.int16, (nS, nC) )
+            yield dict( seq = seq, from_ct = fromCt, dnsmp = dnsmp, t_enq = tEnq ), data
+
+    async def spike_stream( self, stream, chans, thresh_uV, refrac_ms = 1.0,
+                            hipass = 300, lopass = 0, snip_pre = 0, snip_post = 0 ):
+        await self.command( 'SPIKESTREAM %d %s %g %g %g %g %d %d' % (
+                stream, chan_str( chans ), thresh_uV, refrac_ms,
+                hipass, lopass, snip_pre, snip_post) )
+        return self._spk_frames()
+
+    async def _spk_frames( self ):
+        while True:
+            magic, seq, doneCt, nE, nPre, nPost, tEnq = await self._recv_struct( SPIKEEVT_HDR )
+            if magic != SPIKEEVT_MAGIC:
+                raise SpikeGLError( 'SpikeStream: bad frame header.' )
+            evts  = await self._recv_array( SPIKEEVT_REC, (nE,) )
+            snips = await self._recv_array( np.int16, (nE, nPre + nPost) )
+            yield dict( seq = seq, done_ct = doneCt, t_enq = tEnq ), evts, snips
+
+
+# ----------------------------------------------------------------
+# Shared-memory ring
+# ----------------------------------------------------------------
+
+class StreamShm:
+    """
+    Zero-copy view of a stream ring in named shared memory;
+    name from SpikeGL.get_stream_shm(). ring is an int16
+    [bufmax, nchans] array over the mapping; scan ct lives in
+    row ct % bufmax. read() applies the AIQ::ShmHdr protocol.
+    """
+
+    def __init__( self, name ):
+        m = mmap.mmap( -1, SHM_HDR.size, tagname = name, access = mmap.ACCESS_READ )
+        magic, ver, nC, nB, srate, tzero, _, _, _ = SHM_HDR.unpack( m[:SHM_HDR.size] )
+        m.close()
+        if magic != SHM_MAGIC:
+            raise SpikeGLError( 'StreamShm: bad header.' )
+        self.nchans = nC
+        self.bufmax = nB
+        self.srate  = srate
+        self.tzero  = tzero
+        self.m      = mmap.mmap( -1, SHM_HDR.size + 2 * nC * nB,
+                                 tagname = name, access = mmap.ACCESS_READ )
+        self.hdr    = np.frombuffer( self.m, np.uint64, 3, 32 )    # endCt, wrCt, endUs
+        self.ring   = np.frombuffer( self.m, np.int16, nC * nB,
+                                     SHM_HDR.size ).reshape( nB, nC )
+
+    def end_ct( self ):
+        return int( self.hdr[0] )
+
+    def end_time( self ):
+        """App secs (as GETTIME) end_ct() was published."""
+        return 1e-6 * int( self.hdr[2] )
+
+    def read( self, from_ct, n ):
+        """
+        Copy scans [from_ct, from_ct + n) clipped to those
+        published; return (int16 [nScans, nchans], from_ct), or
+        (None, head) if from_ct was overwritten.
+        """
+        end = self.end_ct()
+        n   = max( 0, min( n, end - from_ct ) )
+        i0  = from_ct % self.bufmax
+        i1  = min( i0 + n, self.bufmax )
+        out = np.concatenate( (self.ring[i0:i1], self.ring[:n - (i1 - i0)]) )
+        if int( self.hdr[1] ) - from_ct > self.bufmax:
+            return None, max( 0, end - self.bufmax )
+        return out, from_ct
+
+    def close( self ):
+        del self.ring, self.hdr
+        self.m.close()
@@ -0,0 +1,250 @@
+"""
+Load test for the SpikeGLX Remote Command Server.
+
+Runs many concurrent clients against a running acquisition and
+reports what the server delivered, how long replies took, and
+what the load cost acquisition:
+
+    python sglx_load.py 127.0.0.1 --fetch 4 --latest 4 --sub 2 \
+        --stream 0 --chans 0:63 --dnsmp 1 --count 3000 --secs 30
+
+Client kinds (each its own connection and thread):
+
+- fetch:  FETCH of count scans, walking forward to keep up with
+          the stream (falling back to newest if lapped).
+- latest: GETSCANCOUNT + FETCH of the newest count scans.
+- sub:    SUBSCRIBE push session; the frame rate is the stream's.
+
+Reported:
+
+- Throughput: replies and MB/s over the load window, per kind.
+- Latency: request-to-reply ms (p50, p90, p99, max) per kind, as
+  seen by the client; sub reports gaps between frames instead.
+- Server: each request client's GETCMDTELEMETRY at the end, its
+  read/proc/send/lat split as timed by its CmdWorker (worst of
+  the clients).
+- Acquisition: GETMETRICSHIST means and peaks over the secs
+  before load (baseline) against the load window: FIFO %, queue
+  depth and lag per probe, nidq's, and write MB/s.
+
+Uses sglx.py (same folder or on the path). Threads suffice:
+sockets and numpy receives release the interpreter lock, so
+clients overlap on the wire as separate programs would.
+"""
+
+import argparse
+import threading
+import time
+
+import numpy as np
+
+from sglx import SpikeGL, SpikeGLError, Subscription
+
+
+def pctiles( v ):
+    """Milliseconds p50, p90, p99, max of seconds list v."""
+    if not v:
+        return (0, 0, 0, 0)
+    a = 1000 * np.asarray( v )
+    return tuple( np.percentile( a, [50, 90, 99] ) ) + (a.max(),)
+
+
+# ----------------------------------------------------------------
+# Clients
+# ----------------------------------------------------------------
+
+class Client( threading.Thread ):
+    """
+    One connection issuing kind requests until stop is set.
+    Latencies (s) and bytes are recorded only once go is set,
+    so connection setup stays out of the figures.
+    """
+
+    def __init__( self, kind, args, go, stop ):
+        threading.Thread.__init__( self, daemon = True )
+        self.kind  = kind
+        self.args  = args
+        self.go    = go
+        self.stop  = stop
+        self.lat   = []
+        self.nrep  = 0
+        self.nbyte = 0
+        self.tlm   = {}
+        self.err   = None
+
+    def run( self ):
+        try:
+            with SpikeGL( self.args.host, self.args.port ) as sgl:
+                if self.kind == 'sub':
+                    self.run_sub( sgl )
+                else:
+                    self.run_req( sgl )
+        except (OSError, SpikeGLError) as e:
+            if not self.stop.is_set():
+                self.err = str( e )
+
+    def pace( self, t0 ):
+        if self.args.rate > 0:
+            dt = 1.0 / self.args.rate - (time.perf_counter() - t0)
+            if dt > 0:
+                time.sleep( dt )
+
+    def run_req( self, sgl ):
+        A   = self.args
+        out = None
+        ct  = None
+        self.go.wait()
+        while not self.stop.is_set():
+            t0 = time.perf_counter()
+            if self.kind == 'latest':
+                data, head = sgl.fetch_latest(
+                                A.stream, A.count, chans = A.chans,
+                                dnsmp = A.dnsmp, out = out )
+            else:
+                end = sgl.get_scan_count( A.stream )
+                if ct is None or end - ct > 10 * A.count:   # start or lapped
+                    ct = max( end - A.count, 0 )
+                if ct + A.count > end:
+                    time.sleep( 0.001 )
+                    continue
+                data, head = sgl.fetch( A.stream, ct, A.count, chans = A.chans,
+                                        dnsmp = A.dnsmp, out = out )
+                ct += A.count
+            self.lat.append( time.perf_counter() - t0 )
+            self.nrep  += 1
+            self.nbyte += data.nbytes
+            out = data
+            self.pace( t0 )
+        self.tlm = sgl.get_cmd_telemetry()
+
+    def run_sub( self, sgl ):
+        A   = self.args
+        sgl.subscribe( A.stream, A.chans, A.dnsmp )
+        sub = Subscription( sgl, 4 )
+        sgl.sock.settimeout( 1.0 )
+        self.go.wait()
+        tLast = None
+        try:
+            while not self.stop.is_set():
+                hdr, data = sub.read()
+                t = time.perf_counter()
+                if tLast is not None:
+                    self.lat.append( t - tLast )
+                tLast = t
+                self.nrep  += 1
+                self.nbyte += data.nbytes
+        finally:
+            sub.close()
+
+
+# ----------------------------------------------------------------
+# Acquisition metrics
+# ----------------------------------------------------------------
+
+# Columns summarized, matched by suffix (im<ip>Fifo, ...).
+METRIC_COLS = ('Fifo', 'Depth', 'Lag', 'niDepth', 'niLag', 'imFull', 'niFull', 'wrMBps')
+
+
+def metrics( sgl, secs ):
+    """{column: (mean, max)} over the last secs of history."""
+    try:
+        cols, rows = sgl.get_metrics_hist( secs )
+    except SpikeGLError:
+        return {}
+    d = {}
+    for i, c in enumerate( cols ):
+        if rows.shape[0] and any( c.endswith( m ) for m in METRIC_COLS ):
+            d[c] = (rows[:, i].mean(), rows[:, i].max())
+    return d
+
+
+# ----------------------------------------------------------------
+# Main
+# ----------------------------------------------------------------
+
+def main():
+    ap = argparse.ArgumentParser( description = 'Command Server load test.' )
+    ap.add_argument( 'host', nargs = '?', default = 'localhost' )
+    ap.add_argument( '--port', type = int, default = 4142 )
+    ap.add_argument( '--fetch', type = int, default = 2, help = 'FETCH clients' )
+    ap.add_argument( '--latest', type = int, default = 2, help = 'newest-data clients' )
+    ap.add_argument( '--sub', type = int, default = 0, help = 'SUBSCRIBE clients' )
+    ap.add_argument( '--stream', type = int, default = 0, help = 'js/ip stream id' )
+    ap.add_argument( '--chans', default = None, help = "subset, e.g. '0:63' (saved set)" )
+    ap.add_argument( '--dnsmp', type = int, default = 1, help = 'downsample factor' )
+    ap.add_argument( '--count', type = int, default = 3000, help = 'scans per fetch' )
+    ap.add_argument( '--rate', type = float, default = 0,
+                     help = 'requests/s per client (0 = back to back)' )
+    ap.add_argument( '--secs', type = float, default = 30, help = 'load duration' )
+    ap.add_argument( '--base', type = float, default = 10,
+                     help = 'idle secs measured first as baseline' )
+    A = ap.parse_args()
+
+    mon = SpikeGL( A.host, A.port )
+    if not mon.is_running():
+        raise SystemExit( 'SpikeGLX is not running a stream.' )
+
+    print( 'Baseline %g s...' % A.base )
+    time.sleep( A.base )
+    base = metrics( mon, A.base )
+
+    go, stop = threading.Event(), threading.Event()
+    cl = ([Client( 'fetch', A, go, stop ) for i in range( A.fetch )]
+          + [Client( 'latest', A, go, stop ) for i in range( A.latest )]
+          + [Client( 'sub', A, go, stop ) for i in range( A.sub )])
+    for c in cl:
+        c.start()
+    time.sleep( 0.5 )   # connections up
+
+    print( 'Load %g s: %d fetch, %d latest, %d sub...' % (A.secs, A.fetch, A.latest, A.sub) )
+    t0 = time.perf_counter()
+    go.set()
+    time.sleep( A.secs )
+    run = metrics( mon, A.secs )
+    stop.set()
+    T = time.perf_counter() - t0
+    for c in cl:
+        c.join( 5.0 )
+    mon.close()
+
+    # Throughput and latency
+
+    print( '\n%-7s %4s %9s %9s %8s %8s %8s %8s' % (
+           'kind', 'n', 'replies/s', 'MB/s', 'p50 ms', 'p90 ms', 'p99 ms', 'max ms') )
+    for kind in ('fetch', 'latest', 'sub'):
+        K = [c for c in cl if c.kind == kind]
+        if not K:
+            continue
+        lat = sum( (c.lat for c in K), [] )
+        print( '%-7s %4d %9.1f %9.2f %8.2f %8.2f %8.2f %8.2f' % (
+               (kind, len( K ), sum( c.nrep for c in K ) / T,
+                sum( c.nbyte for c in K ) / T / 1e6) + pctiles( lat )) )
+    print( 'total   %4d %9.1f %9.2f' % (
+           len( cl ), sum( c.nrep for c in cl ) / T, sum( c.nbyte for c in cl ) / T / 1e6) )
+    print( '(sub latency columns are gaps between frames)' )
+
+    # Server-side timing, worst request client
+
+    R = [c.tlm for c in cl if c.tlm]
+    if R:
+        print( '\nServer (worst client) p50/p99/max ms:' )
+        for st in ('read', 'proc', 'send', 'lat'):
+            v = [[float( t.get( '%sMs%s' % (st, q), 0 ) ) for t in R]
+                 for q in ('P50', 'P99', 'Max')]
+            print( '  %-5s %8.3f %8.3f %8.3f' % (st, max( v[0] ), max( v[1] ), max( v[2] )) )
+
+    # Acquisition impact
+
+    if run:
+        print( '\n%-14s %9s %9s   %9s %9s' % ('metric', 'base avg', 'base max', 'load avg', 'load max') )
+        for k in sorted( run ):
+            b = base.get( k, (0, 0) )
+            print( '%-14s %9.1f %9.1f   %9.1f %9.1f' % ((k,) + b + run[k]) )
+
+    for c in cl:
+        if c.err:
+            print( '%s client error: %s' % (c.kind, c.err) )
+
+
+if __name__ == '__main__':
+    main()
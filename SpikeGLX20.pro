@@ -7,6 +7,9 @@
 DEFINES += HAVE_IMEC
 DEFINES += HAVE_NIDAQmx
 
+# Optional OpenCL offload of shared filter stages (needs SDK):
+#DEFINES += HAVE_OPENCL
+
 TEMPLATE = app
 
 contains(DEFINES, HAVE_NIDAQmx) {
@@ -121,6 +124,10 @@ win32 {
         LIBS += -lNIDAQmx
     }
 
+    contains(DEFINES, HAVE_OPENCL) {
+        LIBS += -lOpenCL
+    }
+
     CONFIG  += embed_manifest_exe
     LIBS    += -lWS2_32 -lUser32
     LIBS    += -lopengl32 -lglu32
@@ -152,8 +159,17 @@ unix {
 #   QMAKE_LFLAGS    += -pg
 }
 
+unix:!macx {
+    contains(DEFINES, HAVE_OPENCL) {
+        LIBS += -lOpenCL
+    }
+}
+
 macx {
     LIBS    += -framework CoreServices
+    contains(DEFINES, HAVE_OPENCL) {
+        LIBS += -framework OpenCL
+    }
     DEFINES += MACX
 }
 
@@ -10,11 +10,21 @@
 #include "SignalBlocker.h"
 #include "AODevRtAudio.h"
 #include "AODevSim.h"
+#include "AOTelemetry.h"
+#include "TaskPool.h"
+#include "samplerate.h"
 
 #include <QKeyEvent>
 #include <QMessageBox>
 #include <QSettings>
 
+#include <limits.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI    3.14159265358979323846
+#endif
+
 /* ---------------------------------------------------------------- */
 /* User ----------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -45,6 +55,10 @@ void AOCtl::User::loadSettings( int nImec, bool remote )
 
     settings.beginGroup( "AOCtl_All" );
     stream      = settings.value( "stream", "nidq" ).toString();
+    rateStr     = settings.value( "devRate", "Stream" ).toString();
+    qualStr     = settings.value( "srcQuality", "Medium" ).toString();
+    nbhdStr     = settings.value( "nbhd", "OFF" ).toString();
+    mixStr      = settings.value( "nbhdMix", "Sum" ).toString();
     autoStart   = settings.value( "autoStart", false ).toBool();
 }
 
@@ -71,6 +85,10 @@ void AOCtl::User::saveSettings( bool remote ) const
 
     settings.beginGroup( "AOCtl_All" );
     settings.setValue( "stream", stream );
+    settings.setValue( "devRate", rateStr );
+    settings.setValue( "srcQuality", qualStr );
+    settings.setValue( "nbhd", nbhdStr );
+    settings.setValue( "nbhdMix", mixStr );
     settings.setValue( "autoStart", autoStart );
 }
 
@@ -132,6 +150,27 @@ void AOCtl::Derived::usr2drv( AOCtl *aoC )
 #endif
     }
 
+// ----------
+// Resampling
+// ----------
+
+// Device rate 0 is resolved by the device at start;
+// any rate other than srate is converted by the feeder.
+
+    if( usr.rateStr == "Stream" )
+        devRate = srate;
+    else if( usr.rateStr == "Device" )
+        devRate = 0;
+    else
+        devRate = usr.rateStr.toDouble();
+
+    if( usr.qualStr == "Fastest" )
+        srcType = SRC_SINC_FASTEST;
+    else if( usr.qualStr == "Best" )
+        srcType = SRC_SINC_BEST_QUALITY;
+    else
+        srcType = SRC_SINC_MEDIUM_QUALITY;
+
 // --------
 // Channels
 // --------
@@ -141,6 +180,62 @@ void AOCtl::Derived::usr2drv( AOCtl *aoC )
     lChan = E.left;
     rChan = E.right;
 
+// ------------
+// Neighborhood
+// ------------
+
+// Used sites on Left channel's shank within nbhd rows of it,
+// panned by horizontal position (shank, column) across the
+// neighborhood, equal-power, scaled for unit noise gain.
+
+    nbChan.clear();
+    nbWL.clear();
+    nbWR.clear();
+    nbCAR = (usr.mixStr == "CAR");
+
+    if( usr.nbhdStr != "OFF" ) {
+
+        const ShankMap  &SM = (streamID >= 0 ?
+                                p.im.each[streamID].sns.shankMap :
+                                p.ni.sns.shankMap);
+        int             nS  = qMin( nNeural, int(SM.e.size()) ),
+                        R   = usr.nbhdStr.toInt(),
+                        xLo = INT_MAX,
+                        xHi = -1;
+
+        if( lChan < nS ) {
+
+            const ShankMapDesc  &C = SM.e[lChan];
+
+            for( int ic = 0; ic < nS; ++ic ) {
+
+                const ShankMapDesc  &D = SM.e[ic];
+
+                if( D.u && D.s == C.s && qAbs( int(D.r) - int(C.r) ) <= R ) {
+
+                    int x = D.s * SM.nc + D.c;
+
+                    nbChan.push_back( ic );
+                    xLo = qMin( xLo, x );
+                    xHi = qMax( xHi, x );
+                }
+            }
+        }
+
+        for( int i = 0, n = nbChan.size(); i < n; ++i ) {
+
+            const ShankMapDesc  &D = SM.e[nbChan[i]];
+
+            double  pan = (xHi > xLo ?
+                            double(D.s * SM.nc + D.c - xLo) / (xHi - xLo) :
+                            0.5),
+                    g   = sqrt( 2.0 / n );
+
+            nbWL.push_back( g * cos( 0.5 * M_PI * pan ) );
+            nbWR.push_back( g * sin( 0.5 * M_PI * pan ) );
+        }
+    }
+
 // ------
 // Filter
 // ------
@@ -177,7 +272,9 @@ void AOCtl::Derived::usr2drv( AOCtl *aoC )
     else
         lVol *= 0.5;
 
-    if( rChan < nNeural )
+    if( !nbChan.empty() )
+        rVol = lVol;
+    else if( rChan < nNeural )
         rVol *= 64;
     else
         rVol *= 0.5;
@@ -189,12 +286,40 @@ qint16 AOCtl::Derived::vol( qint16 val, double vol ) const
     return qBound( SHRT_MIN, int(val * vol), SHRT_MAX );
 }
 
+/* ---------------------------------------------------------------- */
+/* AOProbe -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Device enumeration can take a second or more on some hosts,
+// so the ctor's check runs as a Background pool task. Readers
+// of its results {ctorErr, nDevChans} call waitProbe() first.
+//
+class AOProbe : public PoolTask
+{
+private:
+    AOCtl   *aoC;
+
+public:
+    AOProbe( AOCtl *aoC ) : aoC(aoC)    {}
+
+    void run()
+    {
+        double  t0 = getTime();
+
+        aoC->ctorCheckAudioSupport();
+
+        Log() <<
+            QString("Startup: audio probe %1 ms (background)")
+            .arg( int(1000 * (getTime() - t0)) );
+    }
+};
+
 /* ---------------------------------------------------------------- */
 /* AOCtl ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
 AOCtl::AOCtl( const DAQ::Params &p, QWidget *parent )
-    :   QWidget(parent), p(p), dlgShown(false)
+    :   QWidget(parent), p(p), nDevChans(0), dlgShown(false)
 {
 #if 1
     aoDev = new AODevRtAudio( this, p );
@@ -202,7 +327,8 @@ AOCtl::AOCtl( const DAQ::Params &p, QWidget *parent )
     aoDev = new AODevSim( this, p );
 #endif
 
-    ctorCheckAudioSupport();
+    probe = new AOProbe( this );
+    TaskPool::submit( probe, TaskPool::Background, false );
 
     aoUI = new Ui::AOWindow;
     aoUI->setupUi( this );
@@ -212,6 +338,10 @@ AOCtl::AOCtl( const DAQ::Params &p, QWidget *parent )
     ConnectUI( aoUI->loCB, SIGNAL(currentIndexChanged(QString)), this, SLOT(loCBChanged(QString)) );
     ConnectUI( aoUI->hiCB, SIGNAL(currentIndexChanged(QString)), this, SLOT(hiCBChanged(QString)) );
     ConnectUI( aoUI->volSB, SIGNAL(valueChanged(double)), this, SLOT(volSBChanged(double)) );
+    ConnectUI( aoUI->rateCB, SIGNAL(currentIndexChanged(QString)), this, SLOT(rateCBChanged(QString)) );
+    ConnectUI( aoUI->qualCB, SIGNAL(currentIndexChanged(QString)), this, SLOT(qualCBChanged(QString)) );
+    ConnectUI( aoUI->nbhdCB, SIGNAL(currentIndexChanged(QString)), this, SLOT(nbhdCBChanged(QString)) );
+    ConnectUI( aoUI->mixCB, SIGNAL(currentIndexChanged(QString)), this, SLOT(mixCBChanged(QString)) );
     ConnectUI( aoUI->helpBut, SIGNAL(clicked()), this, SLOT(help()) );
     ConnectUI( aoUI->resetBut, SIGNAL(clicked()), this, SLOT(reset()) );
     ConnectUI( aoUI->stopBut, SIGNAL(clicked()), this, SLOT(stop()) );
@@ -223,6 +353,11 @@ AOCtl::AOCtl( const DAQ::Params &p, QWidget *parent )
 
 AOCtl::~AOCtl()
 {
+    waitProbe();
+
+    delete probe;
+    probe = 0;
+
     saveScreenState();
 
     if( aoDev ) {
@@ -266,14 +401,21 @@ bool AOCtl::uniqueAIs( std::vector<int> &vAI, int streamID ) const
 
     if( aoDev->readyForScans() ) {
 
+        waitProbe();
+
         aoMtx.lock();
 
             const EachStream    &E = usr.each[streamID+1];
 
-            vAI.push_back( E.left );
+            if( !drv.nbChan.empty() )
+                vAI = drv.nbChan;
+            else {
 
-            if( nDevChans > 1 && E.right != E.left )
-                vAI.push_back( E.right );
+                vAI.push_back( E.left );
+
+                if( nDevChans > 1 && E.right != E.left )
+                    vAI.push_back( E.right );
+            }
 
         aoMtx.unlock();
     }
@@ -284,6 +426,7 @@ bool AOCtl::uniqueAIs( std::vector<int> &vAI, int streamID ) const
 
 bool AOCtl::showDialog( QWidget *parent )
 {
+    waitProbe();
     ctorCheckAudioSupport();    // User may have corrected an issue
 
     if( !ctorErr.isEmpty() ) {
@@ -361,6 +504,7 @@ void AOCtl::restart()
         return;
 
     QMetaObject::invokeMethod( run, "aoStart", Qt::QueuedConnection );
+    AOTelemetry::addRestart();
 
     Debug() << QString("Audio restarted after %1 sec").arg( int(dt) );
 }
@@ -393,6 +537,44 @@ void AOCtl::reset( bool remote )
 
     aoUI->autoChk->setChecked( usr.autoStart );
 
+// ----------
+// Resampling
+// ----------
+
+    {
+        SignalBlocker   b0(aoUI->rateCB),
+                        b1(aoUI->qualCB);
+
+        // default Stream = first
+        int sel = aoUI->rateCB->findText( usr.rateStr );
+        aoUI->rateCB->setCurrentIndex( sel > -1 ? sel : 0 );
+
+        // default Medium
+        sel = aoUI->qualCB->findText( usr.qualStr );
+        aoUI->qualCB->setCurrentIndex( sel > -1 ? sel : 1 );
+
+        aoUI->qualCB->setEnabled( aoUI->rateCB->currentIndex() > 0 );
+    }
+
+// ------------
+// Neighborhood
+// ------------
+
+    {
+        SignalBlocker   b0(aoUI->nbhdCB),
+                        b1(aoUI->mixCB);
+
+        // default OFF = first
+        int sel = aoUI->nbhdCB->findText( usr.nbhdStr );
+        aoUI->nbhdCB->setCurrentIndex( sel > -1 ? sel : 0 );
+
+        // default Sum = first
+        sel = aoUI->mixCB->findText( usr.mixStr );
+        aoUI->mixCB->setCurrentIndex( sel > -1 ? sel : 0 );
+
+        aoUI->mixCB->setEnabled( aoUI->nbhdCB->currentIndex() > 0 );
+    }
+
 // --------------------
 // Observe dependencies
 // --------------------
@@ -410,6 +592,8 @@ QString AOCtl::cmdSrvSetsAOParamStr(
     const QString   &groupStr,
     const QString   &paramStr )
 {
+    waitProbe();
+
     QMutexLocker    ml( &aoMtx );
 
 // ----------
@@ -465,6 +649,30 @@ QString AOCtl::cmdSrvSetsAOParamStr(
                 .arg( usr.each[idx].hiCutStr );
     }
 
+    if( usr.rateStr != aoUI->rateCB->currentText() ) {
+
+        return QString("Device rate [%1] not supported.")
+                .arg( usr.rateStr );
+    }
+
+    if( usr.qualStr != aoUI->qualCB->currentText() ) {
+
+        return QString("Resampling quality [%1] not supported.")
+                .arg( usr.qualStr );
+    }
+
+    if( usr.nbhdStr != aoUI->nbhdCB->currentText() ) {
+
+        return QString("Neighborhood [%1] not supported.")
+                .arg( usr.nbhdStr );
+    }
+
+    if( usr.mixStr != aoUI->mixCB->currentText() ) {
+
+        return QString("Neighborhood mix [%1] not supported.")
+                .arg( usr.mixStr );
+    }
+
 // -------------------
 // Standard validation
 // -------------------
@@ -598,6 +806,42 @@ void AOCtl::volSBChanged( double val )
 }
 
 
+void AOCtl::rateCBChanged( const QString &str )
+{
+    usr.rateStr = str;
+
+    aoUI->qualCB->setEnabled( str != "Stream" );
+
+    liveChange();
+}
+
+
+void AOCtl::qualCBChanged( const QString &str )
+{
+    usr.qualStr = str;
+
+    liveChange();
+}
+
+
+void AOCtl::nbhdCBChanged( const QString &str )
+{
+    usr.nbhdStr = str;
+
+    aoUI->mixCB->setEnabled( str != "OFF" );
+
+    liveChange();
+}
+
+
+void AOCtl::mixCBChanged( const QString &str )
+{
+    usr.mixStr = str;
+
+    liveChange();
+}
+
+
 void AOCtl::help()
 {
     showHelp( "Audio_Help" );
@@ -651,15 +895,33 @@ void AOCtl::closeEvent( QCloseEvent *e )
 /* Private -------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
+// Callable from any thread; caller must not hold aoMtx.
+//
 void AOCtl::ctorCheckAudioSupport()
 {
-    nDevChans = aoDev->getOutChanCount( ctorErr );
+    QString err;
+    int     n = aoDev->getOutChanCount( err );
 
-    if( ctorErr.isEmpty() && nDevChans <= 0 )
-        ctorErr = "No audio output hardware found on this machine.";
+    if( err.isEmpty() && n <= 0 )
+        err = "No audio output hardware found on this machine.";
 
-    if( !ctorErr.isEmpty() )
-        Warning() << "Audio error: " << ctorErr;
+    if( !err.isEmpty() )
+        Warning() << "Audio error: " << err;
+
+    QMutexLocker    ml( &aoMtx );
+
+    ctorErr     = err;
+    nDevChans   = n;
+}
+
+
+// Block until the ctor's probe has stored its results;
+// if still queued it runs here. Caller must not hold aoMtx.
+//
+void AOCtl::waitProbe() const
+{
+    if( probe && !probe->isDone() )
+        probe->wait();
 }
 
 
@@ -695,6 +957,8 @@ void AOCtl::liveChange()
 
 bool AOCtl::valid( QString &err )
 {
+    waitProbe();
+
     if( !ctorErr.isEmpty() ) {
 
         err = ctorErr;
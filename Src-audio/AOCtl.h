@@ -15,6 +15,8 @@ namespace DAQ {
 struct Params;
 }
 
+class AOProbe;
+
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -24,6 +26,7 @@ class AOCtl : public QWidget
     Q_OBJECT
 
     friend class AODevRtAudio;
+    friend class AOProbe;
 
 private:
     struct EachStream {
@@ -36,7 +39,11 @@ private:
 
     struct User {
         std::vector<EachStream> each;
-        QString                 stream;
+        QString                 stream,
+                                rateStr,
+                                qualStr,
+                                nbhdStr,
+                                mixStr;
         bool                    autoStart;
 
         User() {loadSettings( 0, false );}
@@ -45,19 +52,25 @@ private:
     };
 
     struct Derived {
-        Biquad  hipass,
-                lopass;
-        double  srate,
-                loCut,
-                hiCut,
-                lVol,
-                rVol;
-        int     streamID,   // {-1=nidq,0,1,2,...}
-                lChan,
-                rChan,
-                nNeural,
-                maxInt,
-                maxLatency;
+        std::vector<int>    nbChan;     // neighborhood {empty=off}
+        std::vector<float>  nbWL,       // pan weights
+                            nbWR;
+        Biquad              hipass,
+                            lopass;
+        double              srate,
+                            devRate,    // {0=device preferred}
+                            loCut,
+                            hiCut,
+                            lVol,
+                            rVol;
+        int                 streamID,   // {-1=nidq,0,1,2,...}
+                            lChan,
+                            rChan,
+                            nNeural,
+                            maxInt,
+                            maxLatency,
+                            srcType;    // libsamplerate converter
+        bool                nbCAR;      // subtract neighborhood mean
 
         void usr2drv( AOCtl *aoC );
 
@@ -72,6 +85,7 @@ private:
     Derived             drv;
     AODevBase           *aoDev;
     mutable QMutex      aoMtx;      // guards {usr, aoDev}
+    AOProbe             *probe;     // startup device check
     int                 nDevChans;
     bool                dlgShown;
 
@@ -96,6 +110,7 @@ public:
     bool devStart( const QVector<AIQ*> &imQ, const AIQ *niQ )
                                 {return aoDev->devStart( imQ, niQ );}
     void devStop()              {aoDev->devStop();}
+    double latencyMs() const    {return aoDev->latencyMs();}
     void restart();
 
 signals:
@@ -114,6 +129,10 @@ private slots:
     void loCBChanged( const QString &str );
     void hiCBChanged( const QString &str );
     void volSBChanged( double val );
+    void rateCBChanged( const QString &str );
+    void qualCBChanged( const QString &str );
+    void nbhdCBChanged( const QString &str );
+    void mixCBChanged( const QString &str );
     void help();
     void stop();
     void apply();
@@ -124,6 +143,7 @@ protected:
 
 private:
     void ctorCheckAudioSupport();
+    void waitProbe() const;
     void str2RemoteIni( const QString &groupStr, const QString prmStr );
     void liveChange();
     bool valid( QString &err );
@@ -1,22 +1,170 @@
 
 #include "AOCtl.h"
 #include "AODevRtAudio.h"
+#include "AOTelemetry.h"
 #include "Util.h"
+#include "ThdPlace.h"
 
 #include <QThread>
 
+#include <limits.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AO_SSE2
+#endif
+
 /* ---------------------------------------------------------------- */
 /* Statics -------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
 static AODevRtAudio *ME;
 
+// Scans per feeder fetch; ring capacity in device frames.
+#define AO_FEEDBLK      64
+#define AO_RINGFRAMES   4096
+
+// Device buffer (sampPerCall) tuning range and the stable
+// seconds needed before each step down.
+#define AO_MINFRAMES    64
+#define AO_MAXFRAMES    2048
+#define AO_STEPSECS     10
+#define AO_SHRINKSECS   60
+
+
+// y += w * x over one feeder block.
+//
+static void axpy( float *y, const float *x, float w )
+{
+#ifdef AO_SSE2
+    __m128  W = _mm_set1_ps( w );
+
+    for( int t = 0; t < AO_FEEDBLK; t += 4 ) {
+        _mm_storeu_ps( y + t,
+            _mm_add_ps( _mm_loadu_ps( y + t ),
+                _mm_mul_ps( W, _mm_loadu_ps( x + t ) ) ) );
+    }
+#else
+    for( int t = 0; t < AO_FEEDBLK; ++t )
+        y[t] += w * x[t];
+#endif
+}
+
+/* ---------------------------------------------------------------- */
+/* AORing --------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void AORing::init( int nFrames, int nChans )
+{
+    int n = 1;
+
+    while( n < nFrames )
+        n *= 2;
+
+    buf.assign( n * nChans, 0 );
+    mask    = n - 1;
+    nC      = nChans;
+    head    = 0;
+    tail    = 0;
+}
+
+
+// Caller assures n <= capacity - fill().
+//
+void AORing::push( const qint16 *src, int n )
+{
+    quint64 h   = head.load( std::memory_order_relaxed );
+    int     i0  = int(h & mask),
+            n1  = qMin( n, mask + 1 - i0 );
+
+    memcpy( &buf[i0*nC], src, n1*nC*sizeof(qint16) );
+
+    if( n1 < n )
+        memcpy( &buf[0], src + n1*nC, (n - n1)*nC*sizeof(qint16) );
+
+    head.store( h + n, std::memory_order_release );
+}
+
+
+// Copy up to n frames to dst; return count copied.
+//
+int AORing::pop( qint16 *dst, int n )
+{
+    quint64 t   = tail.load( std::memory_order_relaxed ),
+            h   = head.load( std::memory_order_acquire );
+
+    n = qMin( n, int(h - t) );
+
+    if( n <= 0 )
+        return 0;
+
+    int i0  = int(t & mask),
+        n1  = qMin( n, mask + 1 - i0 );
+
+    memcpy( dst, &buf[i0*nC], n1*nC*sizeof(qint16) );
+
+    if( n1 < n )
+        memcpy( dst + n1*nC, &buf[0], (n - n1)*nC*sizeof(qint16) );
+
+    tail.store( t + n, std::memory_order_release );
+
+    return n;
+}
+
+/* ---------------------------------------------------------------- */
+/* AOFeedWorker --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void AOFeedWorker::run()
+{
+    ThdPlace::apply( ThdPlace::roleAudio );
+
+    while( !pleaseStop )
+        dev->feed();
+
+    emit finished();
+}
+
+/* ---------------------------------------------------------------- */
+/* AOFeedThread --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+AOFeedThread::AOFeedThread( AODevRtAudio *dev )
+{
+    thread  = new QThread;
+    worker  = new AOFeedWorker( dev );
+
+    worker->moveToThread( thread );
+
+    Connect( thread, SIGNAL(started()), worker, SLOT(run()) );
+    Connect( worker, SIGNAL(finished()), worker, SLOT(deleteLater()) );
+    Connect( worker, SIGNAL(destroyed()), thread, SLOT(quit()), Qt::DirectConnection );
+
+    thread->start( QThread::TimeCriticalPriority );
+}
+
+
+AOFeedThread::~AOFeedThread()
+{
+// worker object auto-deleted asynchronously
+// thread object manually deleted synchronously (so we can call wait())
+
+    if( thread->isRunning() ) {
+        worker->stop();
+        thread->wait();
+    }
+
+    delete thread;
+}
+
 /* ---------------------------------------------------------------- */
 /* AODevRtAudio --------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
 AODevRtAudio::AODevRtAudio( AOCtl *aoC, const DAQ::Params &p )
-    :   AODevBase( aoC, p ), rta(0), ready(false)
+    :   AODevBase( aoC, p ), rta(0), feedThd(0), srcSt(0),
+        nUnder(0), outLatUs(0), devFrames(256), devFloor(0),
+        rdrId(-1), ready(false)
 {
 }
 
@@ -370,6 +518,10 @@ bool AODevRtAudio::doAutoStart()
 // spc = 512    LH 150 ms (auto reset @ LM = 10)
 // spc = 1024   LH 260 ms
 //
+// The audio callback only copies frames the feeder thread has
+// already fetched, filtered and scaled. Latency is regulated by
+// the feeder rejoining the stream head, not by device restarts.
+//
 bool AODevRtAudio::devStart( const QVector<AIQ*> &imQ, const AIQ *niQ )
 {
 // Connect to driver
@@ -396,8 +548,20 @@ bool AODevRtAudio::devStart( const QVector<AIQ*> &imQ, const AIQ *niQ )
     ME          = this;
     this->aiQ   = (drv.streamID >= 0 ? imQ[drv.streamID] : niQ);
     fromCt      = 0;
+    tLastData   = getTime();
+    tTune       = tLastData;
     latSum      = 0.0;
+    lagMs       = 0.0;
     latCt       = 0;
+    nUnderSeen  = nUnder.load();
+    stableSecs  = 0;
+
+    aiQ->addTap( drv.lChan );
+
+    if( aoC->nDevChans == 2 )
+        aiQ->addTap( drv.rChan );
+
+    rdrId = aiQ->readerId( "audio" );
 
     RtAudio::StreamParameters   prm;
 
@@ -405,15 +569,84 @@ bool AODevRtAudio::devStart( const QVector<AIQ*> &imQ, const AIQ *niQ )
     prm.nChannels       = aoC->nDevChans;
     prm.firstChannel    = 0;
 
-    uint sampPerCall    = 256;
+    uint sampPerCall    = devFrames;
+
+// Device rate and converter
+
+    if( drv.devRate <= 0 ) {
+
+        try {
+            drv.devRate = rta->getDeviceInfo( prm.deviceId ).preferredSampleRate;
+        }
+        catch( RtAudioError &e ) {
+            Warning() << "Audio error: " << e.what();
+        }
+
+        if( drv.devRate <= 0 )
+            drv.devRate = 48000;
+    }
+
+    srcRatio    = drv.devRate / drv.srate;
+    outMax      = AO_FEEDBLK;
+
+    if( qAbs( srcRatio - 1.0 ) > 1e-9 ) {
+
+        int err;
 
-// Start audio stream
+        if( !src_is_valid_ratio( srcRatio ) ) {
+            Warning() << "Audio error: Unsupported device rate " << drv.devRate;
+            return false;
+        }
+
+        srcSt = src_new( drv.srcType, aoC->nDevChans, &err );
+
+        if( !srcSt ) {
+            Warning() << "Audio error: " << src_strerror( err );
+            return false;
+        }
+
+        outMax = int(AO_FEEDBLK * srcRatio) + 2;
+        srcIn.resize( AO_FEEDBLK * aoC->nDevChans );
+        srcOut.resize( outMax * aoC->nDevChans );
+        blkOut.resize( outMax * aoC->nDevChans );
+    }
+
+    ring.init( AO_RINGFRAMES, aoC->nDevChans );
+    blk.resize( AO_FEEDBLK * aoC->nDevChans );
+
+    if( !drv.nbChan.empty() ) {
+        nbBuf.reserve( AO_FEEDBLK * aiQ->nChans() );
+        mixL.resize( AO_FEEDBLK );
+        mixR.resize( AO_FEEDBLK );
+        mixM.resize( AO_FEEDBLK );
+        mixX.resize( AO_FEEDBLK );
+    }
+
+// Open audio stream; driver may adjust sampPerCall
 
     try {
         rta->openStream(
-                &prm, NULL, RTAUDIO_SINT16, drv.srate, &sampPerCall,
-                (prm.nChannels == 2 ? callbackStereo : callbackMono) );
+                &prm, NULL, RTAUDIO_SINT16, uint(drv.devRate), &sampPerCall,
+                callback );
+
+        devFrames       = sampPerCall;
+        devLatFrames    = rta->getStreamLatency();
+    }
+    catch( RtAudioError &e ) {
+        Warning() << "Audio error: " << e.what();
+        return false;
+    }
+
+// Start feeder, then stream
+
+    AOTelemetry::reset();
 
+    fillTarget = qBound( devFrames + outMax, 2 * devFrames, AO_RINGFRAMES / 2 );
+    tune();
+
+    feedThd = new AOFeedThread( this );
+
+    try {
         rta->startStream();
     }
     catch( RtAudioError &e ) {
@@ -450,12 +683,277 @@ void AODevRtAudio::devStop()
         delete rta;
         rta = 0;
     }
+
+    if( feedThd ) {
+        delete feedThd;
+        feedThd = 0;
+    }
+
+    if( srcSt )
+        srcSt = src_delete( srcSt );
 }
 
 /* ---------------------------------------------------------------- */
 /* Private -------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
+// Feeder thread step: fetch next block of the selected
+// channel(s), filter, apply volume, resample, push to ring.
+//
+// - Sleeps while the ring holds fillTarget frames.
+// - Rejoins the stream head if lapped or if latency() says
+//   we've drifted behind (audio clock slower than stream).
+//
+void AODevRtAudio::feed()
+{
+    const AOCtl::Derived    &drv = aoC->drv;
+    qint16                  *dst = &blk[0];
+    double                  t0;
+    int                     nC   = ring.nC;
+    qint64                  headCt;
+    bool                    nb   = !drv.nbChan.empty();
+
+    tune();
+
+    if( ring.fill() > fillTarget - outMax ) {
+        QThread::usleep( 500 );
+        return;
+    }
+
+// Fetch data from stream
+
+    if( !fromCt ) {
+
+        t0 = getTime();
+
+        if( nb )
+            headCt = fetchMix( dst, 0 );
+        else if( nC == 2 ) {
+            headCt = aiQ->getNewestNScansStereo(
+                        dst, AO_FEEDBLK, drv.lChan, drv.rChan );
+        }
+        else
+            headCt = aiQ->getNewestNScansMono( dst, AO_FEEDBLK, drv.lChan );
+    }
+    else {
+
+        aiQ->waitForCt( fromCt + AO_FEEDBLK, 10 );
+
+        t0 = getTime();
+
+        if( nb )
+            headCt = fetchMix( dst, fromCt );
+        else if( nC == 2 ) {
+            headCt = aiQ->getNScansFromCtStereo(
+                        dst, fromCt, AO_FEEDBLK, drv.lChan, drv.rChan );
+        }
+        else {
+            headCt = aiQ->getNScansFromCtMono(
+                        dst, fromCt, AO_FEEDBLK, drv.lChan );
+        }
+    }
+
+    if( headCt < 0 ) {
+
+        double  t = getTime();
+
+        if( fromCt && aiQ->endCount() >= fromCt + AO_FEEDBLK ) {
+            AOTelemetry::addMiss();
+            fromCt = 0;     // lapped
+        }
+        else if( t - tLastData > 0.1 ) {
+            Warning() << "Audio getting no samples.";
+            aoC->restart();
+            tLastData = t;
+        }
+        else if( !fromCt )
+            QThread::usleep( 1000 );
+
+        return;
+    }
+
+// Mark next fetch point
+
+    tLastData   = getTime();
+    fromCt      = headCt + AO_FEEDBLK;
+    aiQ->readerAt( rdrId, fromCt );
+
+    if( latency() ) {
+        AOTelemetry::addRejoin();
+        fromCt = 0;
+    }
+
+// Filter channels
+
+    if( drv.lChan < drv.nNeural )
+        filter( dst, AO_FEEDBLK, nC, 0 );
+
+    if( nC == 2 && (nb ? drv.lChan : drv.rChan) < drv.nNeural )
+        filter( dst, AO_FEEDBLK, 2, 1 );
+
+// Apply volume
+
+    if( nC == 2 ) {
+
+        for( int t = 0; t < AO_FEEDBLK; ++t ) {
+
+            int j = 2*t;
+
+            dst[j]      = drv.vol( dst[j], drv.lVol );
+            dst[j+1]    = drv.vol( dst[j+1], drv.rVol );
+        }
+    }
+    else {
+
+        for( int t = 0; t < AO_FEEDBLK; ++t )
+            dst[t] = drv.vol( dst[t], drv.lVol );
+    }
+
+    if( srcSt )
+        resample( dst );
+    else
+        ring.push( dst, AO_FEEDBLK );
+
+    AOTelemetry::addFeed( getTime() - t0 );
+}
+
+
+// Fetch a block of all channels at ct {0=newest} and mix the
+// neighborhood down to nC interleaved outputs: pan-weighted
+// sum, less the weighted neighborhood mean if nbCAR.
+//
+// Return headCt or -1 if failure.
+//
+qint64 AODevRtAudio::fetchMix( qint16 *dst, quint64 ct )
+{
+    const AOCtl::Derived    &drv = aoC->drv;
+    int                     nAll = aiQ->nChans(),
+                            nN   = drv.nbChan.size(),
+                            nC   = ring.nC;
+
+    if( !ct ) {
+
+        quint64 end = aiQ->endCount();
+
+        if( end <= AO_FEEDBLK )
+            return -1;
+
+        ct = end - AO_FEEDBLK;
+    }
+
+    nbBuf.clear();
+
+    if( aiQ->getNScansFromCt( nbBuf, ct, AO_FEEDBLK ) != 1
+        || int(nbBuf.size()) != AO_FEEDBLK * nAll ) {
+
+        return -1;
+    }
+
+// Mix
+
+    float   *L  = &mixL[0],
+            *R  = &mixR[0],
+            *M  = &mixM[0],
+            *X  = &mixX[0];
+    float   sL  = 0,
+            sR  = 0;
+
+    memset( L, 0, AO_FEEDBLK * sizeof(float) );
+    memset( R, 0, AO_FEEDBLK * sizeof(float) );
+    memset( M, 0, AO_FEEDBLK * sizeof(float) );
+
+    for( int i = 0; i < nN; ++i ) {
+
+        const qint16    *S  = &nbBuf[drv.nbChan[i]];
+        float           wL  = drv.nbWL[i],
+                        wR  = drv.nbWR[i];
+
+        for( int t = 0; t < AO_FEEDBLK; ++t, S += nAll )
+            X[t] = *S;
+
+        if( nC == 1 ) {
+            wL  = 0.70710678f * (wL + wR);
+            wR  = 0;
+        }
+
+        axpy( L, X, wL );
+        sL += wL;
+
+        if( nC == 2 ) {
+            axpy( R, X, wR );
+            sR += wR;
+        }
+
+        if( drv.nbCAR )
+            axpy( M, X, 1.0f / nN );
+    }
+
+    if( drv.nbCAR ) {
+
+        axpy( L, M, -sL );
+
+        if( nC == 2 )
+            axpy( R, M, -sR );
+    }
+
+// Out
+
+    if( nC == 2 ) {
+
+        for( int t = 0; t < AO_FEEDBLK; ++t ) {
+            dst[2*t]    = qBound( SHRT_MIN, qRound( L[t] ), SHRT_MAX );
+            dst[2*t+1]  = qBound( SHRT_MIN, qRound( R[t] ), SHRT_MAX );
+        }
+    }
+    else {
+
+        for( int t = 0; t < AO_FEEDBLK; ++t )
+            dst[t] = qBound( SHRT_MIN, qRound( L[t] ), SHRT_MAX );
+    }
+
+    return ct;
+}
+
+
+// Convert block to device rate and push it. The converter
+// keeps its filter history across calls, so output counts
+// vary by a frame or so from block to block.
+//
+void AODevRtAudio::resample( const qint16 *src )
+{
+    SRC_DATA    D;
+    int         nC = ring.nC;
+
+    src_short_to_float_array( src, &srcIn[0], AO_FEEDBLK * nC );
+
+    D.data_in       = &srcIn[0];
+    D.data_out      = &srcOut[0];
+    D.input_frames  = AO_FEEDBLK;
+    D.output_frames = outMax;
+    D.end_of_input  = 0;
+    D.src_ratio     = srcRatio;
+
+    while( D.input_frames > 0 ) {
+
+        if( src_process( srcSt, &D ) )
+            return;
+
+        if( D.output_frames_gen ) {
+
+            src_float_to_short_array(
+                &srcOut[0], &blkOut[0], D.output_frames_gen * nC );
+
+            ring.push( &blkOut[0], D.output_frames_gen );
+        }
+        else if( !D.input_frames_used )
+            return;
+
+        D.data_in       += D.input_frames_used * nC;
+        D.input_frames  -= D.input_frames_used;
+    }
+}
+
+
 // nChan is either {1,2}.
 // iChan is either {0,1}.
 //
@@ -482,112 +980,104 @@ void AODevRtAudio::filter(
 }
 
 
-void AODevRtAudio::latency()
+// Return true if the average lag of the fetch point behind
+// the stream head, over about 2 sec of blocks, has reached
+// maxLatency; caller then rejoins the head.
+//
+bool AODevRtAudio::latency()
 {
     const AOCtl::Derived    &drv = aoC->drv;
 
-    double L = qMax( 0.0, 1000 * (aiQ->endCount() - fromCt) / drv.srate );
+    quint64 end = aiQ->endCount();
+    double  L   = (end > fromCt ? 1000 * (end - fromCt) / drv.srate : 0.0);
+
+    AOTelemetry::addLag( 0.001 * L );
 
     latSum += L;
     ++latCt;
 
-// Average about 2 sec worth: 2 sec = N*256/30000; N ~ 200
-
-    if( latCt < 200 )
-        return;
+    if( latCt < 2 * drv.srate / AO_FEEDBLK )
+        return false;
 
     L       = latSum / latCt;
+    lagMs   = L;
     latSum  = 0.0;
     latCt   = 0;
 
-    if( L >= drv.maxLatency )
-        aoC->restart();
-
 //    Log() << L;
+
+    return L >= drv.maxLatency;
 }
 
 
-int AODevRtAudio::callbackMono(
-    void                *outputBuffer,
-    void                *inputBuffer,
-    uint                nBufferFrames,
-    double              streamTime,
-    RtAudioStreamStatus status,
-    void                *userData )
+// Once per second, and at start: tune buffering to the lowest
+// level that doesn't underrun, then update latencyMs().
+//
+// - Underrun: grow ring fill target by half a device buffer;
+//   if already at most, double the device buffer (restart).
+// - Stable AO_STEPSECS: shrink fill target by a feeder block
+//   toward one device buffer.
+// - Stable AO_SHRINKSECS at least fill: halve device buffer
+//   (restart), unless that size has underrun before.
+//
+// Reported latency is stream lag + ring fill + device latency.
+//
+void AODevRtAudio::tune()
 {
-    Q_UNUSED( inputBuffer )
-    Q_UNUSED( streamTime )
-    Q_UNUSED( userData )
+    double  t = getTime();
 
-    if( status )
-        Debug() << "Audio stream underflow detected.";
+    if( t - tTune >= 1.0 ) {
 
-    QMutexLocker    ml( &ME->aoC->aoMtx );
+        quint64 nu      = nUnder.load( std::memory_order_relaxed );
+        int     fillMin = devFrames + outMax,
+                fillMax = qMax( fillMin, qMin( 4 * devFrames, AO_RINGFRAMES / 2 ) );
 
-    const AOCtl::Derived    &drv = ME->aoC->drv;
-    qint16                  *dst = (qint16*)outputBuffer;
-    qint64                  headCt;
+        tTune = t;
 
-// Fetch data from stream
+        if( nu > nUnderSeen ) {
+
+            stableSecs = 0;
 
-    for( int tries = 0; tries < 100; ++tries ) {
+            if( fillTarget < fillMax )
+                fillTarget = qMin( fillTarget + devFrames / 2, fillMax );
+            else if( devFrames < AO_MAXFRAMES ) {
 
-        // Fetch
+                devFloor    = qMax( devFloor, devFrames );
+                devFrames   = 2 * devFrames;
 
-        if( !ME->fromCt ) {
-            headCt = ME->aiQ->getNewestNScansMono(
-                        dst, nBufferFrames, drv.lChan );
+                Debug() << "Audio buffer up to " << devFrames << " frames.";
+                aoC->restart();
+            }
         }
-        else {
-            headCt = ME->aiQ->getNScansFromCtMono(
-                        dst, ME->fromCt, nBufferFrames, drv.lChan );
+        else if( ++stableSecs % AO_STEPSECS == 0 && fillTarget > fillMin )
+            fillTarget = qMax( fillTarget - AO_FEEDBLK, fillMin );
+        else if( stableSecs >= AO_SHRINKSECS
+                && fillTarget <= fillMin
+                && devFrames / 2 >= AO_MINFRAMES
+                && devFrames / 2 > devFloor ) {
+
+            devFrames   = devFrames / 2;
+            stableSecs  = 0;
+
+            Debug() << "Audio buffer down to " << devFrames << " frames.";
+            aoC->restart();
         }
 
-        if( headCt >= 0 )
-            goto fetched;
-
-        QThread::usleep( 1000 );    // wait ~30 samples
+        nUnderSeen = nu;
     }
 
-// Fetch failed
-
-    Warning() << "Audio getting no samples.";
-
-#if 0
-    // Stopping from within callback crashes sometimes...
-    return 1;
-#else
-    // Stop from outside instead.
-    memset( dst, 0, nBufferFrames*sizeof(qint16) );
-    ME->aoC->restart();
-#endif
-
-// Mark next fetch point
-
-fetched:
-    ME->fromCt = headCt + nBufferFrames;
-
-// Latency
-
-    ME->latency();
-
-// Filter channels
-
-    if( drv.lChan < drv.nNeural )
-        ME->filter( dst, nBufferFrames, 1, 0 );
-
-// Apply volume
-
-    for( uint t = 0; t < nBufferFrames; ++t ) {
-
-        dst[t] = drv.vol( dst[t], drv.lVol );
-    }
-
-    return 0;
+    outLatUs.store(
+        int(1000 * lagMs
+            + 1e6 * (fillTarget + devLatFrames) / aoC->drv.devRate),
+        std::memory_order_relaxed );
 }
 
 
-int AODevRtAudio::callbackStereo(
+// Runs in the audio thread: copy what the feeder has ready,
+// pad any shortfall with silence and count it for tune().
+// Never locks or waits.
+//
+int AODevRtAudio::callback(
     void                *outputBuffer,
     void                *inputBuffer,
     uint                nBufferFrames,
@@ -599,76 +1089,36 @@ int AODevRtAudio::callbackStereo(
     Q_UNUSED( streamTime )
     Q_UNUSED( userData )
 
-    if( status )
-        Debug() << "Audio stream underflow detected.";
-
-    QMutexLocker    ml( &ME->aoC->aoMtx );
-
-    const AOCtl::Derived    &drv = ME->aoC->drv;
-    qint16                  *dst = (qint16*)outputBuffer;
-    qint64                  headCt;
-
-// Fetch data from stream
-
-    for( int tries = 0; tries < 100; ++tries ) {
-
-        // Fetch
-
-        if( !ME->fromCt ) {
-            headCt = ME->aiQ->getNewestNScansStereo(
-                        dst, nBufferFrames,
-                        drv.lChan, drv.rChan );
-        }
-        else {
-            headCt = ME->aiQ->getNScansFromCtStereo(
-                        dst, ME->fromCt, nBufferFrames,
-                        drv.lChan, drv.rChan );
-        }
-
-        if( headCt >= 0 )
-            goto fetched;
-
-        QThread::usleep( 1000 );    // wait ~30 samples
-    }
-
-// Fetch failed
-
-    Warning() << "Audio getting no samples.";
-
-#if 0
-    // Stopping from within callback crashes sometimes...
-    return 1;
-#else
-    // Stop from outside instead.
-    memset( dst, 0, 2*nBufferFrames*sizeof(qint16) );
-    ME->aoC->restart();
-#endif
-
-// Mark next fetch point
+    double  t0   = getTime();
+    qint16  *dst = (qint16*)outputBuffer;
+    int     nC   = ME->ring.nC,
+            fill = ME->ring.fill(),
+            n    = ME->ring.pop( dst, nBufferFrames );
 
-fetched:
-    ME->fromCt = headCt + nBufferFrames;
+    if( n < int(nBufferFrames) )
+        memset( dst + n*nC, 0, (nBufferFrames - n)*nC*sizeof(qint16) );
 
-// Latency
+    // Don't count the wait for the feeder's first block
 
-    ME->latency();
+    if( ME->ring.head.load( std::memory_order_relaxed ) ) {
 
-// Filter channels
+        bool    starve  = n < int(nBufferFrames),
+                devLate = status & RTAUDIO_OUTPUT_UNDERFLOW;
 
-    if( drv.lChan < drv.nNeural )
-        ME->filter( dst, nBufferFrames, 2, 0 );
+        if( starve )
+            AOTelemetry::addStarve();
 
-    if( drv.rChan < drv.nNeural )
-        ME->filter( dst, nBufferFrames, 2, 1 );
+        if( devLate )
+            AOTelemetry::addDevUnder();
 
-// Apply volume
-
-    for( uint t = 0; t < nBufferFrames; ++t ) {
-
-        int j = 2*t;
+        if( starve || devLate ) {
+            ME->nUnder.store(
+                ME->nUnder.load( std::memory_order_relaxed ) + 1,
+                std::memory_order_relaxed );
+        }
 
-        dst[j]      = drv.vol( dst[j], drv.lVol );
-        dst[j+1]    = drv.vol( dst[j+1], drv.rVol );
+        AOTelemetry::addCallback(
+            getTime() - t0, fill / ME->aoC->drv.devRate );
     }
 
     return 0;
@@ -4,21 +4,123 @@
 #include "AODevBase.h"
 #include "RtAudio.h"
 #include "AIQ.h"
+#include "samplerate.h"
+
+#include <QObject>
+
+#include <atomic>
+
+class AODevRtAudio;
+
+class QThread;
 
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
+// Single-producer/single-consumer ring of interleaved frames.
+// - Feeder is the only writer of head, callback of tail.
+// - Capacity is a power of two; frame ct lives in (ct & mask).
+// - Neither side locks or waits; callback copies what's there.
+//
+struct AORing
+{
+    vec_i16                 buf;
+    int                     mask,
+                            nC;
+    std::atomic<quint64>    head,
+                            tail;
+
+    AORing() : mask(0), nC(1), head(0), tail(0)    {}
+
+    void init( int nFrames, int nChans );
+    int fill() const
+        {return int(head.load( std::memory_order_acquire )
+                    - tail.load( std::memory_order_acquire ));}
+    void push( const qint16 *src, int n );
+    int pop( qint16 *dst, int n );
+};
+
+
+// Feeder pulls, filters and scales the selected channel(s),
+// or a mix of the Left channel's shank neighborhood, from the
+// stream, converts them to the device rate if that differs,
+// and keeps the ring topped up a few device buffers ahead of
+// the audio callback.
+//
+class AOFeedWorker : public QObject
+{
+    Q_OBJECT
+
+private:
+    AODevRtAudio        *dev;
+    std::atomic<bool>   pleaseStop;
+
+public:
+    AOFeedWorker( AODevRtAudio *dev )
+    :   QObject(0), dev(dev), pleaseStop(false) {}
+    virtual ~AOFeedWorker()                     {}
+
+    void stop()     {pleaseStop = true;}
+
+signals:
+    void finished();
+
+public slots:
+    void run();
+};
+
+
+class AOFeedThread
+{
+public:
+    QThread         *thread;
+    AOFeedWorker    *worker;
+
+public:
+    AOFeedThread( AODevRtAudio *dev );
+    virtual ~AOFeedThread();
+};
+
+
 // RtAudio-based audio output
 //
 class AODevRtAudio : public AODevBase
 {
+    friend class AOFeedWorker;
+
 private:
-    RtAudio     *rta;
-    quint64     fromCt;
-    double      latSum;
-    int         latCt;
-    bool        ready;
+    RtAudio                 *rta;
+    AOFeedThread            *feedThd;
+    SRC_STATE               *srcSt;
+    AORing                  ring;
+    vec_i16                 blk,
+                            blkOut,
+                            nbBuf;
+    std::vector<float>      srcIn,
+                            srcOut,
+                            mixL,
+                            mixR,
+                            mixM,
+                            mixX;
+    std::atomic<quint64>    nUnder;     // callback shortfalls
+    std::atomic<int>        outLatUs;
+    quint64                 fromCt,
+                            nUnderSeen;
+    double                  srcRatio,
+                            tLastData,
+                            tTune,
+                            latSum,
+                            lagMs;
+    int                     devFrames,  // tuned buffer, kept across starts
+                            devFloor,   // largest size that underran
+                            devLatFrames,
+                            fillTarget,
+                            stableSecs,
+                            outMax,
+                            latCt,
+                            rdrId;
+    bool                    ready;
 
 public:
     AODevRtAudio( AOCtl *aoC, const DAQ::Params &p );
@@ -35,25 +137,24 @@ public:
     virtual bool readyForScans() const  {return ready;}
     virtual bool devStart( const QVector<AIQ*> &imQ, const AIQ *niQ );
     virtual void devStop();
+    virtual double latencyMs() const
+        {return 1e-3 * outLatUs.load( std::memory_order_relaxed );}
 
 private:
+    void feed();
+    qint64 fetchMix( qint16 *dst, quint64 ct );
+    void resample( const qint16 *src );
+
     void filter(
         qint16  *data,
         int     ntpts,
         int     nChan,
         int     ichan );
 
-    void latency();
-
-    static int callbackMono(
-        void                *outputBuffer,
-        void                *inputBuffer,
-        uint                nBufferFrames,
-        double              streamTime,
-        RtAudioStreamStatus status,
-        void                *userData );
+    bool latency();
+    void tune();
 
-    static int callbackStereo(
+    static int callback(
         void                *outputBuffer,
         void                *inputBuffer,
         uint                nBufferFrames,
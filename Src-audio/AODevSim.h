@@ -32,6 +32,7 @@ public:
     virtual bool devStart( const QVector<AIQ*> &, const AIQ * )
                                         {return false;}
     virtual void devStop()              {}
+    virtual double latencyMs() const    {return 0;}
 };
 
 #endif  // AODEVSIM_H
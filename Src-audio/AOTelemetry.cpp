@@ -0,0 +1,209 @@
+
+#include "AOTelemetry.h"
+#include "Util.h"
+
+
+std::atomic<quint64>    AOTelemetry::cb[NCB];
+std::atomic<quint64>    AOTelemetry::fill[NFILL];
+std::atomic<quint64>    AOTelemetry::feed[NFEED];
+std::atomic<quint64>    AOTelemetry::lag[NLAG];
+std::atomic<quint64>    AOTelemetry::nStarve( 0 );
+std::atomic<quint64>    AOTelemetry::nDevUnder( 0 );
+std::atomic<quint64>    AOTelemetry::nMiss( 0 );
+std::atomic<quint64>    AOTelemetry::nRejoin( 0 );
+std::atomic<quint64>    AOTelemetry::nRestart( 0 );
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Counters restart with audio, so a difference against
+// a snapshot from before reset() saturates at zero.
+//
+static quint64 sub( quint64 now, quint64 was )
+{
+    return (now > was ? now - was : 0);
+}
+
+
+static quint64 total( const quint64 *H, int nBin )
+{
+    quint64 N = 0;
+
+    for( int i = 0; i < nBin; ++i )
+        N += H[i];
+
+    return N;
+}
+
+
+static void diffH( quint64 *D, const quint64 *now, const quint64 *was, int nBin )
+{
+    for( int i = 0; i < nBin; ++i )
+        D[i] = sub( now[i], was[i] );
+}
+
+
+static void loadH( quint64 *D, const std::atomic<quint64> *H, int nBin )
+{
+    for( int i = 0; i < nBin; ++i )
+        D[i] = H[i].load( std::memory_order_relaxed );
+}
+
+
+static void zeroH( std::atomic<quint64> *H, int nBin )
+{
+    for( int i = 0; i < nBin; ++i )
+        H[i].store( 0, std::memory_order_relaxed );
+}
+
+/* ---------------------------------------------------------------- */
+/* Snapshot ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void AOTelemetry::Snapshot::diff(
+    const Snapshot  &now,
+    const Snapshot  &was )
+{
+    diffH( cb, now.cb, was.cb, NCB );
+    diffH( fill, now.fill, was.fill, NFILL );
+    diffH( feed, now.feed, was.feed, NFEED );
+    diffH( lag, now.lag, was.lag, NLAG );
+
+    nStarve     = sub( now.nStarve, was.nStarve );
+    nDevUnder   = sub( now.nDevUnder, was.nDevUnder );
+    nMiss       = sub( now.nMiss, was.nMiss );
+    nRejoin     = sub( now.nRejoin, was.nRejoin );
+    nRestart    = sub( now.nRestart, was.nRestart );
+}
+
+
+quint64 AOTelemetry::Snapshot::nCB() const
+{
+    return total( cb, NCB );
+}
+
+
+quint64 AOTelemetry::Snapshot::nFeed() const
+{
+    return total( feed, NFEED );
+}
+
+
+double AOTelemetry::Snapshot::cbPctile( double pct ) const
+{
+    return qoctPctile( cb, NCB, 4e-6, pct );
+}
+
+
+double AOTelemetry::Snapshot::fillPctile( double pct ) const
+{
+    return qoctPctile( fill, NFILL, 0.25e-3, pct );
+}
+
+
+double AOTelemetry::Snapshot::feedPctile( double pct ) const
+{
+    return qoctPctile( feed, NFEED, 4e-6, pct );
+}
+
+
+double AOTelemetry::Snapshot::lagPctile( double pct ) const
+{
+    return qoctPctile( lag, NLAG, 0.25e-3, pct );
+}
+
+/* ---------------------------------------------------------------- */
+/* AOTelemetry ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Call before audio threads start. Restarts are kept,
+// since they span stop/start.
+//
+void AOTelemetry::reset()
+{
+    zeroH( cb, NCB );
+    zeroH( fill, NFILL );
+    zeroH( feed, NFEED );
+    zeroH( lag, NLAG );
+
+    nStarve.store( 0, std::memory_order_relaxed );
+    nDevUnder.store( 0, std::memory_order_relaxed );
+    nMiss.store( 0, std::memory_order_relaxed );
+    nRejoin.store( 0, std::memory_order_relaxed );
+}
+
+
+// Record one callback's time and the ring fill it found.
+//
+void AOTelemetry::addCallback( double secs, double fillSecs )
+{
+    bump( cb[qoctBin( secs, 4e-6, NCB )] );
+    bump( fill[qoctBin( fillSecs, 0.25e-3, NFILL )] );
+}
+
+
+// Record one feeder block's time, fetch through push.
+//
+void AOTelemetry::addFeed( double secs )
+{
+    bump( feed[qoctBin( secs, 4e-6, NFEED )] );
+}
+
+
+// Record feeder fetch point lag behind queue head.
+//
+void AOTelemetry::addLag( double secs )
+{
+    bump( lag[qoctBin( secs, 0.25e-3, NLAG )] );
+}
+
+
+void AOTelemetry::snapshot( Snapshot &S )
+{
+    loadH( S.cb, cb, NCB );
+    loadH( S.fill, fill, NFILL );
+    loadH( S.feed, feed, NFEED );
+    loadH( S.lag, lag, NLAG );
+
+    S.nStarve   = nStarve.load( std::memory_order_relaxed );
+    S.nDevUnder = nDevUnder.load( std::memory_order_relaxed );
+    S.nMiss     = nMiss.load( std::memory_order_relaxed );
+    S.nRejoin   = nRejoin.load( std::memory_order_relaxed );
+    S.nRestart  = nRestart.load( std::memory_order_relaxed );
+}
+
+
+// Totals since audio start as name=value lines
+// for GETAUDIOTELEMETRY.
+//
+QString AOTelemetry::remoteStr()
+{
+    Snapshot    S;
+    QString     s;
+
+    snapshot( S );
+
+    s  = QString("cbN=%1\n").arg( S.nCB() );
+    s += QString("cbMsP50=%1\n").arg( 1000*S.cbPctile( 50 ), 0, 'f', 3 );
+    s += QString("cbMsP99=%1\n").arg( 1000*S.cbPctile( 99 ), 0, 'f', 3 );
+    s += QString("cbMsMax=%1\n").arg( 1000*S.cbPctile( 100 ), 0, 'f', 3 );
+    s += QString("fillMsP1=%1\n").arg( 1000*S.fillPctile( 1 ), 0, 'f', 2 );
+    s += QString("fillMsP50=%1\n").arg( 1000*S.fillPctile( 50 ), 0, 'f', 2 );
+    s += QString("feedN=%1\n").arg( S.nFeed() );
+    s += QString("feedMsP50=%1\n").arg( 1000*S.feedPctile( 50 ), 0, 'f', 3 );
+    s += QString("feedMsP99=%1\n").arg( 1000*S.feedPctile( 99 ), 0, 'f', 3 );
+    s += QString("feedMsMax=%1\n").arg( 1000*S.feedPctile( 100 ), 0, 'f', 3 );
+    s += QString("lagMsP50=%1\n").arg( 1000*S.lagPctile( 50 ), 0, 'f', 2 );
+    s += QString("lagMsP99=%1\n").arg( 1000*S.lagPctile( 99 ), 0, 'f', 2 );
+    s += QString("lagMsMax=%1\n").arg( 1000*S.lagPctile( 100 ), 0, 'f', 2 );
+    s += QString("starves=%1\n").arg( S.nStarve );
+    s += QString("devUnderflows=%1\n").arg( S.nDevUnder );
+    s += QString("misses=%1\n").arg( S.nMiss );
+    s += QString("rejoins=%1\n").arg( S.nRejoin );
+    s += QString("restarts=%1\n").arg( S.nRestart );
+
+    return s;
+}
+
+
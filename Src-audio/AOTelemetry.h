@@ -0,0 +1,95 @@
+#ifndef AOTELEMETRY_H
+#define AOTELEMETRY_H
+
+#include <QString>
+
+#include <atomic>
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Always-on audio output telemetry, reset at each audio start.
+//
+// Each counter has one writer, so updates are plain relaxed
+// load/store; readers (MetricsWindow, CmdServer) take relaxed
+// snapshots anytime and difference two for recent figures.
+//
+// - Callback (audio thread): call time, ring fill on entry,
+//   starves (ring short: feeder late) and device underflows
+//   (driver reported: device late).
+// - Feeder: block time (fetch through push), lag of the fetch
+//   point behind the queue head, misses (data lapped while
+//   reading: AIQ contention) and rejoins (lag over maxLatency).
+// - Restarts (any thread).
+//
+class AOTelemetry
+{
+public:
+    enum {
+        NCB     = 48,   // quarter-octave bins from 4 us
+        NFILL   = 48,   // quarter-octave bins from 0.25 ms
+        NFEED   = 48,   // quarter-octave bins from 4 us
+        NLAG    = 48    // quarter-octave bins from 0.25 ms
+    };
+
+    struct Snapshot {
+        quint64 cb[NCB],
+                fill[NFILL],
+                feed[NFEED],
+                lag[NLAG],
+                nStarve,
+                nDevUnder,
+                nMiss,
+                nRejoin,
+                nRestart;
+
+        void diff( const Snapshot &now, const Snapshot &was );
+
+        quint64 nCB() const;
+        quint64 nFeed() const;
+        double cbPctile( double pct ) const;    // seconds
+        double fillPctile( double pct ) const;  // seconds
+        double feedPctile( double pct ) const;  // seconds
+        double lagPctile( double pct ) const;   // seconds
+    };
+
+private:
+    static std::atomic<quint64> cb[NCB],
+                                fill[NFILL],
+                                feed[NFEED],
+                                lag[NLAG],
+                                nStarve,
+                                nDevUnder,
+                                nMiss,
+                                nRejoin,
+                                nRestart;
+
+public:
+    static void reset();
+
+    // Audio callback
+    static void addCallback( double secs, double fillSecs );
+    static void addStarve()     {bump( nStarve );}
+    static void addDevUnder()   {bump( nDevUnder );}
+
+    // Feeder
+    static void addFeed( double secs );
+    static void addLag( double secs );
+    static void addMiss()       {bump( nMiss );}
+    static void addRejoin()     {bump( nRejoin );}
+
+    static void addRestart()    {nRestart.fetch_add( 1 );}
+
+    static void snapshot( Snapshot &S );
+    static QString remoteStr();
+
+private:
+    static inline void bump( std::atomic<quint64> &c, quint64 n = 1 )
+        {c.store( c.load( std::memory_order_relaxed ) + n,
+            std::memory_order_relaxed );}
+};
+
+#endif  // AOTELEMETRY_H
+
+
@@ -0,0 +1,414 @@
+
+#include "DFActivity.h"
+#include "DataFile.h"
+#include "DataFile_Helpers.h"
+#include "Biquad.h"
+#include "Util.h"
+
+#include <QBitArray>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegExp>
+
+#include <math.h>
+
+
+#define DFACT_MAGIC     0x414C4753  // 'SGLA'
+#define DFACT_VERSION   1
+
+// Highpass warm-up read before each slice's span.
+#define DFACT_WARMSECS  0.05
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+static bool writeAll( QFile &f, const void *src, qint64 bytes )
+{
+    return !bytes || f.write( (const char*)src, bytes ) == bytes;
+}
+
+
+static bool readAll( QFile &f, void *dst, qint64 bytes )
+{
+    return !bytes || f.read( (char*)dst, bytes ) == bytes;
+}
+
+/* ---------------------------------------------------------------- */
+/* DFActivitySlice ------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+// Fills the bins [ib0, ibLim) of the worker's table.
+//
+class DFActivitySlice : public PoolTask
+{
+private:
+    const DFActivityWorker  &W;
+    float                   *dst;
+    std::vector<qint64>     sum,
+                            sum2;
+    std::vector<int>        vmin,
+                            vmax,
+                            T,
+                            nBelow,
+                            cnt;
+    int                     ib0,
+                            ibLim;
+
+public:
+    bool                    ok;
+
+public:
+    DFActivitySlice(
+        const DFActivityWorker  &W,
+        float                   *dst,
+        int                     ib0,
+        int                     ibLim )
+    :   W(W), dst(dst), ib0(ib0), ibLim(ibLim), ok(false)  {}
+
+    virtual void run();
+
+private:
+    bool scan( DataFile *df );
+    void block( double *A, const qint16 *data, int ntpts );
+};
+
+
+void DFActivitySlice::run()
+{
+    QString     error;
+    DataFile    *df = DFOpenForRead( W.binName, error );
+
+    ok = df && scan( df );
+
+    if( df )
+        delete df;
+}
+
+
+bool DFActivitySlice::scan( DataFile *df )
+{
+    int         nN      = W.nN,
+                blk     = qMax( 1, W.binScans / 10 ),
+                maxInt  = df->maxInt();
+    quint64     s       = quint64(ib0) * W.binScans;
+    QBitArray   keep( df->numChans() );
+    Biquad      hp( bq_type_highpass, 300/W.sRate );
+    vec_i16     data;
+
+    keep.fill( true, 0, nN );
+
+    sum.resize( nN );
+    sum2.resize( nN );
+    vmin.resize( nN );
+    vmax.resize( nN );
+    T.resize( nN );
+    cnt.resize( nN );
+    nBelow.assign( nN, 0 );
+
+// Warm filter on scans before the span
+
+    if( W.hp300 && s > 0 ) {
+
+        int n = (int)qMin( s, quint64(DFACT_WARMSECS * W.sRate) );
+
+        if( df->readScans( data, s - n, n, keep ) != n )
+            return false;
+
+        hp.applyBlockwiseMem( &data[0], maxInt, n, nN, 0, nN );
+    }
+
+// Bins
+
+    std::vector<double> A( 3 * nN );
+    float               *D = dst;
+
+    for( int ib = ib0; ib < ibLim; ++ib, D += 3 * nN ) {
+
+        quint64 b0      = quint64(ib) * W.binScans,
+                bLim    = qMin( W.scanCt, b0 + W.binScans );
+        int     nBlk    = 0;
+
+        A.assign( 3 * nN, 0.0 );
+
+        for( quint64 s0 = b0; s0 < bLim; s0 += blk, ++nBlk ) {
+
+            if( W.pleaseStop )
+                return false;
+
+            int n = (int)qMin( quint64(blk), bLim - s0 );
+
+            if( df->readScans( data, s0, n, keep ) != n )
+                return false;
+
+            if( W.hp300 )
+                hp.applyBlockwiseMem( &data[0], maxInt, n, nN, 0, nN );
+
+            block( &A[0], &data[0], n );
+        }
+
+        for( int c = 0; c < nN; ++c ) {
+            D[3*c]      = float(A[3*c] / (bLim - b0));
+            D[3*c+1]    = float(A[3*c+1] / nBlk);
+            D[3*c+2]    = float(A[3*c+2]);
+        }
+    }
+
+    return true;
+}
+
+
+// Accumulate one block to A: var*ntpts, pkpk, spikes.
+// Inner loops run across channels, so they vectorize.
+//
+void DFActivitySlice::block( double *A, const qint16 *data, int ntpts )
+{
+    int             nN  = W.nN;
+    const qint16    *S  = data;
+
+    for( int c = 0; c < nN; ++c ) {
+        sum[c]  = 0;
+        sum2[c] = 0;
+        vmin[c] = vmax[c] = S[c];
+    }
+
+    for( int it = 0; it < ntpts; ++it, S += nN ) {
+
+        for( int c = 0; c < nN; ++c ) {
+
+            int v = S[c];
+
+            sum[c]  += v;
+            sum2[c] += v * v;
+            vmin[c]  = qMin( vmin[c], v );
+            vmax[c]  = qMax( vmax[c], v );
+        }
+    }
+
+    for( int c = 0; c < nN; ++c ) {
+
+        double  m   = double(sum[c]) / ntpts,
+                var = qMax( 0.0, double(sum2[c]) / ntpts - m * m );
+
+        A[3*c]     += var * ntpts;
+        A[3*c+1]   += vmax[c] - vmin[c];
+        T[c]        = int(m - DFACT_NSIGMA * sqrt( var ));
+        cnt[c]      = 0;
+    }
+
+    if( !W.hp300 )
+        return;
+
+// Spikes: DFACT_INAROW scans below threshold
+
+    S = data;
+
+    for( int it = 0; it < ntpts; ++it, S += nN ) {
+
+        for( int c = 0; c < nN; ++c ) {
+
+            nBelow[c]   = (S[c] < T[c]) * (nBelow[c] + 1);
+            cnt[c]     += (nBelow[c] == DFACT_INAROW);
+        }
+    }
+
+    for( int c = 0; c < nN; ++c )
+        A[3*c+2] += cnt[c];
+}
+
+/* ---------------------------------------------------------------- */
+/* DFActivityWorker ----------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Slices read through their own DataFiles, so df is unused.
+//
+bool DFActivityWorker::build( DataFile*, QFile &f )
+{
+    int     nBins   = int((scanCt + binScans - 1) / binScans),
+            nT      = qBound( 1, TaskPool::maxThreads(), qMax( nBins, 1 ) );
+    bool    ok      = nBins > 0 && nN > 0;
+
+    std::vector<float>  vB( qint64(nBins) * 3 * nN );
+
+// Slices
+
+    if( ok ) {
+
+        std::vector<DFActivitySlice*>   vS;
+
+        for( int k = 0; k < nT; ++k ) {
+
+            int ib0     = int(qint64(nBins) * k / nT),
+                ibLim   = int(qint64(nBins) * (k + 1) / nT);
+
+            DFActivitySlice *S =
+                new DFActivitySlice( *this, &vB[qint64(ib0) * 3 * nN], ib0, ibLim );
+
+            vS.push_back( S );
+            TaskPool::submit( S, TaskPool::Background, false );
+        }
+
+        for( int k = 0; k < nT; ++k ) {
+
+            vS[k]->wait();
+            ok = ok && vS[k]->ok;
+            delete vS[k];
+        }
+    }
+
+// Write
+
+    if( ok ) {
+
+        quint32 H[4]    = {DFACT_MAGIC, DFACT_VERSION,
+                            quint32(nN), quint32(binScans)},
+                F[2]    = {quint32(hp300), 0};
+        quint64 ct      = scanCt;
+
+        ok = writeAll( f, H, sizeof(H) )
+                && writeAll( f, &ct, sizeof(ct) )
+                && writeAll( f, F, sizeof(F) )
+                && writeAll( f, &vB[0], vB.size() * sizeof(float) );
+    }
+
+    return ok;
+}
+
+/* ---------------------------------------------------------------- */
+/* DFActivity ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+DFActivity::DFActivity( const DataFile &df, int nN, bool hp300 )
+    :   QObject(0), binName(df.binFileName()),
+        scanCt(df.scanCount()), sRate(df.samplingRateHz()),
+        worker(0), nN(nN), hp300(hp300), _isReady(false)
+{
+    QRegExp re("bin$");
+    re.setCaseSensitivity( Qt::CaseInsensitive );
+
+    actName     = QString(binName).replace( re, "act" );
+    binScans    = qMax( 1, int(DFACT_BINSECS * sRate) );
+
+    if( nN <= 0 )
+        return;
+
+    QFileInfo   fiB( binName ),
+                fiA( actName );
+
+    if( fiA.exists() && fiA.lastModified() >= fiB.lastModified() && load() )
+        return;
+
+    worker = new DFActivityWorker(
+                    binName, actName, scanCt, sRate,
+                    nN, binScans, hp300 );
+
+    DFSidecarWorker::start( worker, this );
+}
+
+
+DFActivity::~DFActivity()
+{
+    DFSidecarWorker::end( worker );
+}
+
+
+// Set v[nN] to the measure what over scans [s0, sLim),
+// snapped out to whole bins.
+//
+bool DFActivity::values(
+    std::vector<double> &v,
+    int                 what,
+    quint64             s0,
+    quint64             sLim ) const
+{
+    sLim = qMin( sLim, scanCt );
+
+    if( !_isReady || sLim <= s0 )
+        return false;
+
+    quint64 ib0     = s0 / binScans,
+            ibLim   = (sLim + binScans - 1) / binScans;
+    double  nTot    = 0;
+    int     k       = (what == Rate ? 2 : (what == PkPk ? 1 : 0));
+
+    v.assign( nN, 0.0 );
+
+    for( quint64 ib = ib0; ib < ibLim; ++ib ) {
+
+        const float *B = &vB[ib * 3 * nN];
+        double      w  = double(qMin( quint64(binScans), scanCt - ib * binScans ));
+
+        if( what == Rate ) {
+            for( int c = 0; c < nN; ++c )
+                v[c] += B[3*c+k];
+        }
+        else {
+            for( int c = 0; c < nN; ++c )
+                v[c] += w * B[3*c+k];
+        }
+
+        nTot += w;
+    }
+
+    for( int c = 0; c < nN; ++c ) {
+
+        if( what == Rate )
+            v[c] *= sRate / nTot;
+        else if( what == PkPk )
+            v[c] /= nTot;
+        else
+            v[c] = sqrt( v[c] / nTot );
+    }
+
+    return true;
+}
+
+
+void DFActivity::buildDone( bool ok )
+{
+    DFSidecarWorker::end( worker );
+
+    if( ok && load() )
+        emit ready();
+}
+
+
+// Read sidecar and check it matches the bin file and settings.
+//
+bool DFActivity::load()
+{
+    QFile   f( actName );
+
+    if( !f.open( QIODevice::ReadOnly ) )
+        return false;
+
+    quint32 H[4],
+            F[2];
+    quint64 ct,
+            nBins = (scanCt + binScans - 1) / binScans;
+
+    if( !readAll( f, H, sizeof(H) )
+        || !readAll( f, &ct, sizeof(ct) )
+        || !readAll( f, F, sizeof(F) )
+        || H[0] != DFACT_MAGIC
+        || H[1] != DFACT_VERSION
+        || int(H[2]) != nN
+        || int(H[3]) != binScans
+        || ct != scanCt
+        || bool(F[0]) != hp300 ) {
+
+        return false;
+    }
+
+    std::vector<float>  B( nBins * 3 * nN );
+
+    if( !readAll( f, &B[0], B.size() * sizeof(float) ) )
+        return false;
+
+    vB.swap( B );
+    _isReady = true;
+    return true;
+}
+
+
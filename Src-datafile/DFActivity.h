@@ -0,0 +1,125 @@
+#ifndef DFACTIVITY_H
+#define DFACTIVITY_H
+
+#include "SGLTypes.h"
+#include "DFSidecar.h"
+
+class DataFile;
+class DFActivity;
+
+// Bin length of the sidecar: the finest range selection.
+#define DFACT_BINSECS   1.0
+
+// Spike threshold: this many sd below a block's mean,
+// held for DFACT_INAROW scans.
+#define DFACT_NSIGMA    5.0
+#define DFACT_INAROW    3
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Worker builds the sidecar (see DFSidecarWorker), splitting the file into one contiguous span of bins per pool
+// thread. Each span is a DFActivitySlice with its own DataFile,
+// so reads go through the mapped subset path in parallel.
+//
+class DFActivityWorker : public DFSidecarWorker
+{
+    friend class DFActivitySlice;
+
+private:
+    quint64             scanCt;
+    double              sRate;
+    int                 nN,
+                        binScans;
+    bool                hp300;
+
+public:
+    DFActivityWorker(
+        const QString   &binName,
+        const QString   &actName,
+        quint64         scanCt,
+        double          sRate,
+        int             nN,
+        int             binScans,
+        bool            hp300 )
+    :   DFSidecarWorker( binName, actName, "Activity map", false ),
+        scanCt(scanCt), sRate(sRate), nN(nN),
+        binScans(binScans), hp300(hp300)    {}
+
+protected:
+    virtual bool build( DataFile *df, QFile &f );
+};
+
+
+// Per-site activity of the leading nN (neural) channels of a
+// bin file, for whole-file or selected-range shank maps.
+//
+// Sidecar file <name>.act beside the bin (little-endian):
+// - Header: 'SGLA', u32 version, u32 nN, u32 binScans,
+//           u64 scanCt, u32 hp300, u32 0.
+// - Per bin of binScans scans (last may be short), per channel:
+//   f32 var, f32 pkpk, f32 spikes.
+//
+// Bins are read in blocks of binScans/10. Within a block each
+// channel's mean, variance and min/max are taken in one pass;
+// a second pass counts spikes against that block's threshold
+// (hp300 files only). A bin holds scan-weighted mean variance,
+// mean block pk-pk, and spike count, all in ADC units. With
+// hp300 the channels are first highpassed at 300 Hz, each slice
+// warming its filter on the scans before its span.
+//
+// The sidecar is loaded if present, no older than the bin, and
+// for the same channels and filter. Otherwise it's built in the
+// background (to a temp name, then renamed) and ready() is
+// emitted when values() can be used.
+//
+class DFActivity : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum What {
+        Rate    = 0,    // spikes/s
+        PkPk    = 1,    // ADC counts
+        Rms     = 2     // ADC counts
+    };
+
+private:
+    std::vector<float>  vB;     // bin-major (var, pkpk, spikes)
+    QString             binName,
+                        actName;
+    quint64             scanCt;
+    double              sRate;
+    DFSidecarWorker     *worker;
+    int                 nN,
+                        binScans;
+    bool                hp300,
+                        _isReady;
+
+public:
+    DFActivity( const DataFile &df, int nN, bool hp300 );
+    virtual ~DFActivity();
+
+    bool isReady() const    {return _isReady;}
+    int nChans() const      {return nN;}
+
+    bool values(
+        std::vector<double> &v,
+        int                 what,
+        quint64             s0,
+        quint64             sLim ) const;
+
+signals:
+    void ready();
+
+private slots:
+    void buildDone( bool ok );
+
+private:
+    bool load();
+};
+
+#endif  // DFACTIVITY_H
+
+
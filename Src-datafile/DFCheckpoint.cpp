@@ -0,0 +1,204 @@
+
+#include "DFCheckpoint.h"
+#include "DFChunkSum.h"
+#include "DFDirIndex.h"
+#include "DFName.h"
+#include "KVParams.h"
+
+#include "SHA1.h"
+#undef TCHAR
+
+#include <QFile>
+#include <QFileInfo>
+#include <QRegExp>
+
+#include <vector>
+
+
+#define DFCKP_MAGIC     0x4B4C4753  // 'SGLK'
+#define DFCKP_VERSION   1
+
+// Read block size while finalizing.
+#define DFCKP_BLKBYTES  (4*1024*1024)
+
+/* ---------------------------------------------------------------- */
+/* DFCheckpoint --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Called with sha and csum at the same point in the data.
+//
+bool DFCheckpoint::save(
+    const QString       &binName,
+    const CSHA1         &sha,
+    const DFChunkSum    &csum,
+    quint32             flags )
+{
+    QString name    = sidecarName( binName ),
+            tmpName = name + ".tmp";
+    QFile   f( tmpName );
+    quint32 H[4]    = {DFCKP_MAGIC, DFCKP_VERSION, flags, 0};
+    quint64 done    = csum.dataBytes();
+    UINT_8  S[CSHA1::STATE_BYTES];
+
+    sha.GetState( S );
+
+    bool    ok = f.open( QIODevice::WriteOnly | QIODevice::Truncate )
+                && f.write( (const char*)H, sizeof(H) ) == sizeof(H)
+                && f.write( (const char*)&done, sizeof(done) ) == sizeof(done)
+                && f.write( (const char*)S, sizeof(S) ) == sizeof(S)
+                && csum.write( f );
+
+    f.close();
+
+    if( ok ) {
+        QFile::remove( name );
+        ok = QFile::rename( tmpName, name );
+    }
+
+    if( !ok )
+        QFile::remove( tmpName );
+
+    return ok;
+}
+
+
+// Complete the meta file of a bin file whose run crashed:
+// resume hashes at the checkpoint, hash the rest of the file,
+// then write fileSizeBytes, fileTimeSecs and fileSHA1,
+// and the chunk checksum sidecar. The bin is not modified: the
+// tallies cover its true length, trailing zero scans included
+// (they're data: gap fills, paused probes), so a later SHA1
+// check of the file agrees.
+//
+// On success the checkpoint is removed.
+//
+bool DFCheckpoint::finalize( QString &error, const QString &binName )
+{
+    QString     metaName    = DFName::forceMetaSuffix( binName ),
+                shortName   = QFileInfo( binName ).fileName();
+    KVParams    kvp;
+    CSHA1       sha;
+    DFChunkSum  csum;
+    quint32     flags;
+
+    if( !kvp.fromMetaFile( metaName ) ) {
+        error = QString("Can't read meta file for '%1'.").arg( shortName );
+        return false;
+    }
+
+    if( !load( sha, csum, flags, binName ) ) {
+        error = QString("No usable checkpoint for '%1'.").arg( shortName );
+        return false;
+    }
+
+    QFile   f( binName );
+    double  srate       = kvp[kvp.contains( "niSampRate" ) ?
+                            "niSampRate" : "imSampRate"].toDouble();
+    qint64  scanBytes   = kvp["nSavedChans"].toLongLong() * sizeof(qint16),
+            done        = csum.dataBytes(),
+            end;
+
+    if( scanBytes <= 0 || srate <= 0 || done % scanBytes ) {
+        error = QString("Bad meta data for '%1'.").arg( shortName );
+        return false;
+    }
+
+    if( !f.open( QIODevice::ReadOnly ) ) {
+        error = QString("Can't open '%1'.").arg( shortName );
+        return false;
+    }
+
+    end = f.size();
+
+    if( end < done ) {
+        error = QString("'%1' is shorter than its checkpoint.").arg( shortName );
+        return false;
+    }
+
+    std::vector<char>   buf( DFCKP_BLKBYTES );
+
+// Hash tail
+
+    if( !f.seek( done ) ) {
+        error = QString("Can't read '%1'.").arg( shortName );
+        return false;
+    }
+
+    for( qint64 pos = done; pos < end; ) {
+
+        qint64  n = qMin( qint64(buf.size()), end - pos );
+
+        if( f.read( &buf[0], n ) != n ) {
+            error = QString("Can't read '%1'.").arg( shortName );
+            return false;
+        }
+
+        sha.Update( (const UINT_8*)&buf[0], UINT_32(n) );
+        csum.update( &buf[0], n );
+        pos += n;
+    }
+
+    f.close();
+
+// Tallies
+
+    sha.Final();
+
+    std::basic_string<char> hStr;
+    sha.ReportHashStl( hStr, CSHA1::REPORT_HEX_SHORT );
+
+    kvp["fileSHA1"]         = hStr.c_str();
+    kvp["fileTimeSecs"]     = end / scanBytes / srate;
+    kvp["fileSizeBytes"]    = end;
+
+    if( !kvp.toMetaFile( metaName ) ) {
+        error = QString("Can't write meta file for '%1'.").arg( shortName );
+        return false;
+    }
+
+    DFDirIndex::forget( metaName );
+    csum.save( binName );
+    QFile::remove( sidecarName( binName ) );
+
+    return true;
+}
+
+
+QString DFCheckpoint::sidecarName( const QString &binName )
+{
+    QRegExp re("bin$");
+    re.setCaseSensitivity( Qt::CaseInsensitive );
+
+    return QString(binName).replace( re, "ckp" );
+}
+
+
+bool DFCheckpoint::load(
+    CSHA1               &sha,
+    DFChunkSum          &csum,
+    quint32             &flags,
+    const QString       &binName )
+{
+    QFile   f( sidecarName( binName ) );
+    quint32 H[4];
+    quint64 done;
+    UINT_8  S[CSHA1::STATE_BYTES];
+
+    if( !f.open( QIODevice::ReadOnly )
+        || f.read( (char*)H, sizeof(H) ) != sizeof(H)
+        || f.read( (char*)&done, sizeof(done) ) != sizeof(done)
+        || f.read( (char*)S, sizeof(S) ) != sizeof(S)
+        || H[0] != DFCKP_MAGIC
+        || H[1] != DFCKP_VERSION
+        || !csum.read( f )
+        || quint64(csum.dataBytes()) != done ) {
+
+        return false;
+    }
+
+    sha.SetState( S );
+    flags = H[2];
+    return true;
+}
+
+
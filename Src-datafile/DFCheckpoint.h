@@ -0,0 +1,55 @@
+#ifndef DFCHECKPOINT_H
+#define DFCHECKPOINT_H
+
+#include <QString>
+
+class CSHA1;
+class DFChunkSum;
+
+// File was written with direct I/O (informational: its tail is
+// padded only at close, so a file needing finalize() has none).
+#define DFCKP_PADDED    0x1
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Crash-recovery checkpoint of a bin file being written. If the
+// app or machine dies mid-run, the meta file lacks its size, time
+// and SHA1 tallies; finalize() supplies them by resuming the
+// hashes from the checkpoint, reading only the tail since.
+//
+// Sidecar file <name>.ckp beside the bin (little-endian):
+// - Header: 'SGLK', u32 version, u32 flags, u32 0, u64 dataBytes.
+// - SHA1 running state (CSHA1::STATE_BYTES).
+// - Chunk checksum state (DFChunkSum sidecar format).
+//
+// DataFile writes it from the hashing thread after the first
+// block and after each completed checksum chunk (to a temp name,
+// then renamed), and removes it when the file closes normally.
+// Compressed files get none.
+//
+class DFCheckpoint
+{
+public:
+    static bool save(
+        const QString       &binName,
+        const CSHA1         &sha,
+        const DFChunkSum    &csum,
+        quint32             flags );
+
+    static bool finalize( QString &error, const QString &binName );
+
+    static QString sidecarName( const QString &binName );
+
+private:
+    static bool load(
+        CSHA1               &sha,
+        DFChunkSum          &csum,
+        quint32             &flags,
+        const QString       &binName );
+};
+
+#endif  // DFCHECKPOINT_H
+
+
@@ -0,0 +1,276 @@
+
+#include "DFChunkSum.h"
+#include "Util.h"
+
+#include <QFile>
+#include <QRegExp>
+
+#include <string.h>
+
+
+#define DFCSUM_MAGIC    0x434C4753  // 'SGLC'
+#define DFCSUM_VERSION  1
+
+/* ---------------------------------------------------------------- */
+/* CRC32C --------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Castagnoli polynomial, reflected. The SSE4.2 crc32 instruction
+// computes the same CRC eight bytes at a time (~10x the table);
+// it's chosen once at startup if the CPU has it.
+
+#define DFCSUM_POLY     0x82F63B78
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define DFCSUM_X86
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define DFCSUM_SSE42_FN
+#else
+#define DFCSUM_SSE42_FN __attribute__((target("sse4.2")))
+#endif
+#endif
+
+typedef quint32 (*CRCFn)( quint32 c, const uchar *p, qint64 n );
+
+
+static quint32 crcTable[256];
+
+
+static bool initTable()
+{
+    for( int i = 0; i < 256; ++i ) {
+
+        quint32 c = i;
+
+        for( int k = 0; k < 8; ++k )
+            c = (c & 1 ? (c >> 1) ^ DFCSUM_POLY : c >> 1);
+
+        crcTable[i] = c;
+    }
+
+    return true;
+}
+
+
+static quint32 crc_table( quint32 c, const uchar *p, qint64 n )
+{
+    for( ; n > 0; --n )
+        c = crcTable[(c ^ *p++) & 0xFF] ^ (c >> 8);
+
+    return c;
+}
+
+
+#ifdef DFCSUM_X86
+
+DFCSUM_SSE42_FN
+static quint32 crc_sse42( quint32 c, const uchar *p, qint64 n )
+{
+    quint64 c64 = c;
+
+    for( ; n > 0 && (quintptr(p) & 7); --n )
+        c64 = _mm_crc32_u8( quint32(c64), *p++ );
+
+    for( ; n >= 8; n -= 8, p += 8 ) {
+
+        quint64 w;
+
+        memcpy( &w, p, 8 );
+        c64 = _mm_crc32_u64( c64, w );
+    }
+
+    for( ; n > 0; --n )
+        c64 = _mm_crc32_u8( quint32(c64), *p++ );
+
+    return quint32(c64);
+}
+
+#endif  // DFCSUM_X86
+
+
+static CRCFn pickCRC()
+{
+    initTable();
+
+#ifdef DFCSUM_X86
+    if( cpuHasSSE42() )
+        return crc_sse42;
+#endif
+
+    return crc_table;
+}
+
+
+static const CRCFn  crcFn = pickCRC();
+
+/* ---------------------------------------------------------------- */
+/* DFChunkSum ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void DFChunkSum::reset()
+{
+    sums.clear();
+    nBytes  = 0;
+    inChunk = 0;
+    crc     = 0;
+}
+
+
+// Bytes must arrive in file order.
+//
+void DFChunkSum::update( const void *src, qint64 bytes )
+{
+    const uchar *p = (const uchar*)src;
+
+    nBytes += bytes;
+
+    while( bytes > 0 ) {
+
+        qint64  n = qMin( bytes, chunkBytes - inChunk );
+
+        crc     = crc32c( crc, p, n );
+        inChunk += n;
+        p       += n;
+        bytes   -= n;
+
+        if( inChunk == chunkBytes ) {
+            sums.push_back( crc );
+            crc     = 0;
+            inChunk = 0;
+        }
+    }
+}
+
+
+// Compare chunks present in both: a short chunk matches only
+// as the last chunk of both. Fill bad with mismatched indices
+// and return count of chunks compared.
+//
+int DFChunkSum::compare( std::vector<int> &bad, const DFChunkSum &ref ) const
+{
+    bad.clear();
+
+    if( ref.chunkBytes != chunkBytes )
+        return 0;
+
+    int n = qMin( nComplete(), ref.nComplete() );
+
+    for( int i = 0; i < n; ++i ) {
+
+        if( sums[i] != ref.sums[i] )
+            bad.push_back( i );
+    }
+
+    if( nBytes == ref.nBytes && inChunk ) {
+
+        if( crc != ref.crc )
+            bad.push_back( n );
+
+        ++n;
+    }
+
+    return n;
+}
+
+
+bool DFChunkSum::save( const QString &binName ) const
+{
+    QFile   f( sidecarName( binName ) );
+
+    return f.open( QIODevice::WriteOnly | QIODevice::Truncate ) && write( f );
+}
+
+
+bool DFChunkSum::load( const QString &binName )
+{
+    QFile   f( sidecarName( binName ) );
+
+    reset();
+
+    return f.open( QIODevice::ReadOnly ) && read( f );
+}
+
+
+// Sidecar format, at f's position; DFCheckpoint embeds it.
+//
+bool DFChunkSum::write( QIODevice &f ) const
+{
+    quint32 H[4] = {DFCSUM_MAGIC, DFCSUM_VERSION, quint32(nChunks()), 0};
+    quint64 L[2] = {quint64(chunkBytes), quint64(nBytes)};
+
+    bool    ok = f.write( (const char*)H, sizeof(H) ) == sizeof(H)
+                && f.write( (const char*)L, sizeof(L) ) == sizeof(L);
+
+    if( ok && sums.size() ) {
+
+        qint64  bytes = sums.size() * sizeof(quint32);
+
+        ok = f.write( (const char*)&sums[0], bytes ) == bytes;
+    }
+
+    if( ok && inChunk )
+        ok = f.write( (const char*)&crc, sizeof(crc) ) == sizeof(crc);
+
+    return ok;
+}
+
+
+// Restores the running state too, so updates can continue.
+//
+bool DFChunkSum::read( QIODevice &f )
+{
+    quint32 H[4];
+    quint64 L[2];
+
+    reset();
+
+    if( f.read( (char*)H, sizeof(H) ) != sizeof(H)
+        || f.read( (char*)L, sizeof(L) ) != sizeof(L)
+        || H[0] != DFCSUM_MAGIC
+        || H[1] != DFCSUM_VERSION
+        || !L[0]
+        || H[2] != quint32((L[1] + L[0] - 1) / L[0]) ) {
+
+        return false;
+    }
+
+    std::vector<quint32>    S( H[2] );
+    qint64                  bytes = S.size() * sizeof(quint32);
+
+    if( bytes && f.read( (char*)&S[0], bytes ) != bytes )
+        return false;
+
+    chunkBytes  = L[0];
+    nBytes      = L[1];
+    inChunk     = nBytes % chunkBytes;
+
+    if( inChunk ) {
+        crc = S.back();
+        S.pop_back();
+    }
+
+    sums.swap( S );
+    return true;
+}
+
+
+QString DFChunkSum::sidecarName( const QString &binName )
+{
+    QRegExp re("bin$");
+    re.setCaseSensitivity( Qt::CaseInsensitive );
+
+    return QString(binName).replace( re, "crc" );
+}
+
+
+// Standard CRC32C of bytes, continuing from crc
+// (0 to start).
+//
+quint32 DFChunkSum::crc32c( quint32 crc, const void *src, qint64 bytes )
+{
+    return ~crcFn( ~crc, (const uchar*)src, bytes );
+}
+
+
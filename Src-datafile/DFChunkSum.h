@@ -0,0 +1,66 @@
+#ifndef DFCHUNKSUM_H
+#define DFCHUNKSUM_H
+
+#include <QString>
+
+#include <vector>
+
+class QIODevice;
+
+// Data bytes per checksum chunk.
+#define DFCSUM_CHUNKBYTES   (256LL*1024*1024)
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// CRC32C per chunk of a bin file's data: the same byte stream
+// fileSHA1 covers (decoded samples if the bin is compressed).
+// Unlike the whole-file SHA1, chunks can be checked separately
+// to find where a file is corrupt, or to check just the part of
+// a file copied so far.
+//
+// Sidecar file <name>.crc beside the bin (little-endian):
+// - Header: 'SGLC', u32 version, u32 nChunks, u32 0,
+//           u64 chunkBytes, u64 dataBytes.
+// - Per chunk: u32 CRC32C; last chunk may be short.
+//
+// DataFile writes the sidecar with the meta file at close.
+//
+class DFChunkSum
+{
+private:
+    std::vector<quint32>    sums;       // completed chunks
+    qint64                  chunkBytes,
+                            nBytes,     // data bytes so far
+                            inChunk;    // bytes in current chunk
+    quint32                 crc;        // current chunk, running
+
+public:
+    DFChunkSum( qint64 chunkBytes = DFCSUM_CHUNKBYTES )
+    :   chunkBytes(chunkBytes), nBytes(0), inChunk(0), crc(0)   {}
+
+    void reset();
+    void update( const void *src, qint64 bytes );
+
+    qint64 chunkSize() const    {return chunkBytes;}
+    qint64 dataBytes() const    {return nBytes;}
+    int nChunks() const         {return int(sums.size()) + (inChunk > 0);}
+    int nComplete() const       {return int(sums.size());}
+    quint32 sum( int i ) const
+        {return (i < int(sums.size()) ? sums[i] : crc);}
+
+    int compare( std::vector<int> &bad, const DFChunkSum &ref ) const;
+
+    bool save( const QString &binName ) const;
+    bool load( const QString &binName );
+    bool write( QIODevice &f ) const;
+    bool read( QIODevice &f );
+
+    static QString sidecarName( const QString &binName );
+    static quint32 crc32c( quint32 crc, const void *src, qint64 bytes );
+};
+
+#endif  // DFCHUNKSUM_H
+
+
@@ -0,0 +1,478 @@
+
+#include "DFCompress.h"
+
+#include <QFile>
+
+#include <string.h>
+
+
+#define DFCMP_MAGIC     0x5A4C4753  // 'SGLZ'
+#define DFCMP_VERSION   1
+
+// Unary quotients >= DFCMP_ESC are sent as DFCMP_RAWBITS raw.
+// Second differences of 16-bit data zigzag to < 2^18.
+#define DFCMP_ESC       24
+#define DFCMP_RAWBITS   18
+
+// Transpose tile height (scans).
+#define DFCMP_TILE      64
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// MSB-first packing into 32-bit words.
+//
+struct BitPut {
+    std::vector<quint32>    &W;
+    quint64                 acc;
+    int                     nb;
+
+    BitPut( std::vector<quint32> &W ) : W(W), acc(0), nb(0) {}
+
+    // Value v has at most n (<= 32) significant bits.
+    void put( quint32 v, int n )
+    {
+        acc = (acc << n) | v;
+
+        if( (nb += n) >= 32 ) {
+            nb -= 32;
+            W.push_back( quint32(acc >> nb) );
+        }
+    }
+
+    void flush()
+    {
+        if( nb ) {
+            W.push_back( quint32(acc << (32 - nb)) );
+            nb = 0;
+        }
+    }
+};
+
+
+// Reads past end return zeros, so corrupt data can't overrun.
+//
+struct BitGet {
+    const quint32   *w,
+                    *end;
+    quint64         acc;
+    int             nb;
+
+    BitGet( const quint32 *w, int nW ) : w(w), end(w + nW), acc(0), nb(0)  {}
+
+    void fill()
+    {
+        if( nb < 32 ) {
+            acc = (acc << 32) | (w < end ? *w++ : 0);
+            nb += 32;
+        }
+    }
+
+    quint32 get( int n )
+    {
+        fill();
+        nb -= n;
+        return quint32(acc >> nb) & quint32((1ULL << n) - 1);
+    }
+
+    // Count and consume leading zeros and the terminating one.
+    int zeros()
+    {
+        fill();
+
+        quint32 top = quint32(acc >> (nb - 32));
+        int     z   = 0;
+
+        while( z < DFCMP_ESC && !(top & 0x80000000) ) {
+            top <<= 1;
+            ++z;
+        }
+
+        nb -= z + 1;
+        return z;
+    }
+};
+
+
+static inline int residual( const qint16 *x, int t, int o )
+{
+    if( o == 0 )
+        return x[t];
+    else if( o == 1 )
+        return x[t] - x[t-1];
+
+    return x[t] - 2*x[t-1] + x[t-2];
+}
+
+
+// Code n samples x of one channel.
+//
+static void encodeChan( BitPut &B, const qint16 *x, int n )
+{
+// Pick order with least residual magnitude
+
+    qint64  s[3] = {0, 0, 0};
+    int     o    = 0;
+
+    if( n > 2 ) {
+
+        for( int t = 2; t < n; ++t ) {
+            s[0] += qAbs( residual( x, t, 0 ) );
+            s[1] += qAbs( residual( x, t, 1 ) );
+            s[2] += qAbs( residual( x, t, 2 ) );
+        }
+
+        if( s[1] < s[o] )
+            o = 1;
+
+        if( s[2] < s[o] )
+            o = 2;
+    }
+
+// Rice parameter ~ log2(mean zigzag value)
+
+    qint64  cnt = qMax( 1, n - 2 ),
+            sum = 2 * s[o];
+    int     k   = 0;
+
+    while( k < DFCMP_RAWBITS - 1 && (cnt << (k + 1)) <= sum )
+        ++k;
+
+    B.put( o, 2 );
+    B.put( k, 5 );
+
+    int t = 0;
+
+    for( ; t < o; ++t )
+        B.put( quint16(x[t]), 16 );
+
+    for( ; t < n; ++t ) {
+
+        int     r = residual( x, t, o );
+        quint32 u = (quint32(r) << 1) ^ quint32(r >> 31),
+                q = u >> k;
+
+        if( q < DFCMP_ESC ) {
+
+            B.put( 1, q + 1 );
+
+            if( k )
+                B.put( u & ((1U << k) - 1), k );
+        }
+        else {
+            B.put( 1, DFCMP_ESC + 1 );
+            B.put( u, DFCMP_RAWBITS );
+        }
+    }
+}
+
+
+static void decodeChan( BitGet &G, qint16 *x, int n )
+{
+    int o = qMin( int(G.get( 2 )), 2 ),
+        k = G.get( 5 ),
+        t = 0;
+
+    for( ; t < o && t < n; ++t )
+        x[t] = qint16(G.get( 16 ));
+
+    for( ; t < n; ++t ) {
+
+        int     z = G.zeros();
+        quint32 u = (z < DFCMP_ESC ?
+                        (quint32(z) << k) | G.get( k )
+                        : G.get( DFCMP_RAWBITS ));
+        int     r = int(u >> 1) ^ -int(u & 1);
+
+        if( o == 0 )
+            x[t] = qint16(r);
+        else if( o == 1 )
+            x[t] = qint16(x[t-1] + r);
+        else
+            x[t] = qint16(2*x[t-1] - x[t-2] + r);
+    }
+}
+
+/* ---------------------------------------------------------------- */
+/* DFCmpWriter ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+DFCmpWriter::DFCmpWriter( int nChans, int chunkScans )
+    :   nOut(0), nIn(0), nC(qMax( 1, nChans )),
+        chunkScans(qMax( 1, chunkScans ))
+{
+    pend.reserve( this->chunkScans * nC );
+}
+
+
+void DFCmpWriter::header( QByteArray &out )
+{
+    quint32 H[4] = {DFCMP_MAGIC, DFCMP_VERSION,
+                    quint32(nC), quint32(chunkScans)};
+
+    add( out, H, sizeof(H) );
+}
+
+
+// Append n16 words (any split, whole scans overall);
+// completed chunks are appended to out.
+//
+void DFCmpWriter::put( QByteArray &out, const qint16 *src, int n16 )
+{
+    int chunkWords = chunkScans * nC;
+
+    nIn += n16 * sizeof(qint16);
+
+    while( n16 > 0 ) {
+
+        if( pend.empty() && n16 >= chunkWords ) {
+
+            chunk( out, src, chunkScans );
+            src += chunkWords;
+            n16 -= chunkWords;
+            continue;
+        }
+
+        int n = qMin( n16, chunkWords - (int)pend.size() );
+
+        pend.insert( pend.end(), src, src + n );
+        src += n;
+        n16 -= n;
+
+        if( (int)pend.size() == chunkWords ) {
+            chunk( out, &pend[0], chunkScans );
+            pend.clear();
+        }
+    }
+}
+
+
+// Code the partial chunk, then index and trailer.
+//
+void DFCmpWriter::finish( QByteArray &out )
+{
+    int nScans = (int)pend.size() / nC;
+
+    if( nScans )
+        chunk( out, &pend[0], nScans );
+
+    pend.clear();
+
+    quint64 indexOff = nOut;
+    quint32 T[4]     = {quint32(indexOff), quint32(indexOff >> 32),
+                        quint32(index.size()), DFCMP_MAGIC};
+
+    if( index.size() )
+        add( out, &index[0], int(index.size() * sizeof(quint64)) );
+
+    add( out, T, sizeof(T) );
+}
+
+
+void DFCmpWriter::chunk( QByteArray &out, const qint16 *src, int nScans )
+{
+    index.push_back( nOut );
+
+// Channel-major copy, in runs of DFCMP_TILE scans to keep
+// both source rows and destination columns in cache
+
+    col.resize( nScans * nC );
+
+    for( int it0 = 0; it0 < nScans; it0 += DFCMP_TILE ) {
+
+        int itLim = qMin( it0 + DFCMP_TILE, nScans );
+
+        for( int ic = 0; ic < nC; ++ic ) {
+
+            const qint16    *S = &src[it0*nC + ic];
+            qint16          *D = &col[ic*nScans];
+
+            for( int it = it0; it < itLim; ++it, S += nC )
+                D[it] = *S;
+        }
+    }
+
+// Code
+
+    bits.clear();
+
+    BitPut  B( bits );
+
+    for( int ic = 0; ic < nC; ++ic )
+        encodeChan( B, &col[ic*nScans], nScans );
+
+    B.flush();
+
+    quint32 H[2] = {quint32(bits.size() * sizeof(quint32)), quint32(nScans)};
+
+    add( out, H, sizeof(H) );
+
+    if( bits.size() )
+        add( out, &bits[0], H[0] );
+}
+
+
+void DFCmpWriter::add( QByteArray &out, const void *src, int bytes )
+{
+    out.append( (const char*)src, bytes );
+    nOut += bytes;
+}
+
+/* ---------------------------------------------------------------- */
+/* DFCmpReader ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Read header, trailer and index of (open) file.
+//
+// Return true if format and channel count check.
+//
+bool DFCmpReader::open( QFile *file, int nChans )
+{
+    f       = file;
+    nC      = nChans;
+    iCache  = -1;
+    index.clear();
+    cache.clear();
+
+    quint32 H[4],
+            T[4];
+    qint64  size = f->size();
+
+    if( size < qint64(sizeof(H) + sizeof(T))
+        || !f->seek( 0 )
+        || f->read( (char*)H, sizeof(H) ) != sizeof(H)
+        || H[0] != DFCMP_MAGIC
+        || (H[1] & 0xFFFF) != DFCMP_VERSION
+        || int(H[2]) != nChans
+        || !H[3] ) {
+
+        return false;
+    }
+
+    chunkScans = H[3];
+
+    if( !f->seek( size - sizeof(T) )
+        || f->read( (char*)T, sizeof(T) ) != sizeof(T)
+        || T[3] != DFCMP_MAGIC ) {
+
+        return false;
+    }
+
+    quint64 indexOff = T[0] | (quint64(T[1]) << 32);
+    int     n        = T[2];
+
+    if( indexOff + n * sizeof(quint64) != quint64(size - sizeof(T)) )
+        return false;
+
+    index.resize( n );
+
+    if( n ) {
+
+        qint64  bytes = n * sizeof(quint64);
+
+        if( !f->seek( indexOff )
+            || f->read( (char*)&index[0], bytes ) != bytes ) {
+
+            index.clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// Decode chunk ic to dst (scan-major).
+//
+bool DFCmpReader::chunk( vec_i16 &dst, int ic )
+{
+    if( ic < 0 || ic >= nChunks() )
+        return false;
+
+    quint32 H[2];
+
+    if( !f->seek( index[ic] )
+        || f->read( (char*)H, sizeof(H) ) != sizeof(H)
+        || (H[0] & 3)
+        || !H[1]
+        || H[1] > quint32(chunkScans) ) {
+
+        return false;
+    }
+
+    int nW      = H[0] / sizeof(quint32),
+        nScans  = H[1];
+
+    bits.resize( nW + 1 );
+
+    if( nW && f->read( (char*)&bits[0], H[0] ) != qint64(H[0]) )
+        return false;
+
+    col.resize( nScans * nC );
+
+    BitGet  G( &bits[0], nW );
+
+    for( int c = 0; c < nC; ++c )
+        decodeChan( G, &col[c*nScans], nScans );
+
+    dst.resize( nScans * nC );
+
+    for( int it0 = 0; it0 < nScans; it0 += DFCMP_TILE ) {
+
+        int itLim = qMin( it0 + DFCMP_TILE, nScans );
+
+        for( int c = 0; c < nC; ++c ) {
+
+            const qint16    *S = &col[c*nScans];
+            qint16          *D = &dst[it0*nC + c];
+
+            for( int it = it0; it < itLim; ++it, D += nC )
+                *D = S[it];
+        }
+    }
+
+    return true;
+}
+
+
+// Return count of scans read to dst.
+//
+qint64 DFCmpReader::read( qint16 *dst, quint64 scan0, quint64 nScans )
+{
+    qint64  nGot = 0;
+
+    while( nScans ) {
+
+        int ic  = int(scan0 / chunkScans),
+            it0 = int(scan0 % chunkScans);
+
+        if( ic != iCache ) {
+
+            if( !chunk( cache, ic ) ) {
+                iCache = -1;
+                break;
+            }
+
+            iCache = ic;
+        }
+
+        int nHave = (int)cache.size() / nC - it0;
+
+        if( nHave <= 0 )
+            break;
+
+        int n = (int)qMin( quint64(nHave), nScans );
+
+        memcpy( dst, &cache[it0*nC], n * nC * sizeof(qint16) );
+
+        dst     += n * nC;
+        scan0   += n;
+        nScans  -= n;
+        nGot    += n;
+    }
+
+    return nGot;
+}
+
+
@@ -0,0 +1,93 @@
+#ifndef DFCOMPRESS_H
+#define DFCOMPRESS_H
+
+#include "SGLTypes.h"
+
+#include <QByteArray>
+
+#include <vector>
+
+class QFile;
+
+// Meta tag fileCompression value for this format.
+#define DFCMP_NAME          "rice1"
+
+// Scans per independently decodable chunk.
+#define DFCMP_CHUNKSCANS    4096
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Lossless chunked format for bin files (meta fileCompression=rice1,
+// fileSizeBytes = uncompressed size, fileCmpBytes = size on disk).
+//
+// Layout (little-endian):
+// - Header:  'SGLZ', u16 version, u16 0, u32 nChans, u32 chunkScans.
+// - Chunks:  u32 payloadBytes, u32 nScans, payload.
+// - Index:   u64 file offset of each chunk.
+// - Trailer: u64 index offset, u32 nChunks, 'SGLZ'.
+//
+// Payload codes each channel in turn: 2-bit predictor order o
+// (0-2, the fixed polynomial predictors of FLAC), 5-bit Rice
+// parameter k, o raw 16-bit warm-up samples, then Rice codes of
+// the zigzagged residuals. Order and k are picked per channel
+// per chunk from the residual sums, so 10/12-bit data in 16-bit
+// words costs only its actual entropy, roughly.
+//
+class DFCmpWriter
+{
+private:
+    std::vector<quint64>    index;
+    std::vector<quint32>    bits;
+    vec_i16                 pend,       // partial chunk
+                            col;        // channel-major chunk
+    qint64                  nOut,       // bytes emitted
+                            nIn;        // bytes accepted
+    int                     nC,
+                            chunkScans;
+
+public:
+    DFCmpWriter( int nChans, int chunkScans = DFCMP_CHUNKSCANS );
+
+    void header( QByteArray &out );
+    void put( QByteArray &out, const qint16 *src, int n16 );
+    void finish( QByteArray &out );
+
+    qint64 inBytes() const  {return nIn;}
+    qint64 outBytes() const {return nOut;}
+
+private:
+    void chunk( QByteArray &out, const qint16 *src, int nScans );
+    void add( QByteArray &out, const void *src, int bytes );
+};
+
+
+// Random access reader. The last decoded chunk is cached,
+// so sequential reads decode each chunk once.
+//
+class DFCmpReader
+{
+private:
+    std::vector<quint64>    index;
+    std::vector<quint32>    bits;
+    vec_i16                 cache,
+                            col;
+    QFile                   *f;
+    int                     nC,
+                            chunkScans,
+                            iCache;
+
+public:
+    DFCmpReader() : f(0), nC(0), chunkScans(0), iCache(-1)  {}
+
+    bool open( QFile *file, int nChans );
+
+    int nChunks() const     {return (int)index.size();}
+    bool chunk( vec_i16 &dst, int ic );
+    qint64 read( qint16 *dst, quint64 scan0, quint64 nScans );
+};
+
+#endif  // DFCOMPRESS_H
+
+
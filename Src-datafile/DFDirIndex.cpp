@@ -0,0 +1,186 @@
+
+#include "DFDirIndex.h"
+#include "KVParams.h"
+#include "Util.h"
+
+#include <QDir>
+#include <QMap>
+#include <QMutex>
+
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+struct DirRec {
+    QMap<QString,DFDirIndex::Stat>  stats;  // file name -> stat
+    double                          tList;
+};
+
+struct MetaRec {
+    DFDirIndex::Stat    S;
+    KVParams            kvp;
+};
+
+static QMutex                   idxMtx;
+static QMap<QString,DirRec>     dirs;   // abs dir path -> listing
+static QMap<QString,MetaRec>    metas;  // abs file path -> parsed
+
+
+// Return listing of dir, (re)reading it if stale, or 0 if
+// dir doesn't exist. Caller holds idxMtx.
+//
+static DirRec *listing( const QString &dir )
+{
+    double                          tNow    = getTime();
+    QMap<QString,DirRec>::iterator  it      = dirs.find( dir );
+
+    if( it != dirs.end() && tNow - it->tList < DFDI_TRUSTSECS )
+        return &it.value();
+
+    QDir    D( dir );
+
+    if( !D.exists() ) {
+
+        if( it != dirs.end() )
+            dirs.erase( it );
+
+        return 0;
+    }
+
+    DirRec  &R = dirs[dir];
+
+    R.stats.clear();
+    R.tList = tNow;
+
+    QFileInfoList   L = D.entryInfoList( QDir::Files | QDir::NoDotAndDotDot );
+
+    foreach( const QFileInfo &fi, L ) {
+
+        DFDirIndex::Stat    &S = R.stats[fi.fileName()];
+
+        S.mtime = fi.lastModified();
+        S.size  = fi.size();
+    }
+
+    return &R;
+}
+
+
+// Split absolute path into dir and file name.
+//
+static void split( QString &dir, QString &name, const QString &path )
+{
+    QFileInfo   fi( path );
+
+    dir     = fi.absolutePath();
+    name    = fi.fileName();
+}
+
+/* ---------------------------------------------------------------- */
+/* DFDirIndex ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Return true if path is a listed file, with its size and mtime.
+//
+bool DFDirIndex::stat( Stat &S, const QString &path )
+{
+    QString dir, name;
+
+    split( dir, name, path );
+
+    QMutexLocker    ml( &idxMtx );
+    DirRec          *R = listing( dir );
+
+    if( !R )
+        return false;
+
+    QMap<QString,Stat>::const_iterator  it = R->stats.find( name );
+
+    if( it == R->stats.end() )
+        return false;
+
+    S = it.value();
+    return true;
+}
+
+
+// Same contract as KVParams::fromMetaFile.
+//
+bool DFDirIndex::meta( KVParams &kvp, const QString &metaPath )
+{
+    QString key = QFileInfo( metaPath ).absoluteFilePath();
+    Stat    S;
+
+    if( !stat( S, key ) ) {
+        kvp.clear();
+        return kvp.fromMetaFile( metaPath );
+    }
+
+    idxMtx.lock();
+
+        QMap<QString,MetaRec>::const_iterator   it = metas.find( key );
+
+        if( it != metas.end()
+            && it->S.size == S.size
+            && it->S.mtime == S.mtime ) {
+
+            kvp = it->kvp;
+            idxMtx.unlock();
+            return true;
+        }
+
+    idxMtx.unlock();
+
+// Parse outside lock
+
+    if( !kvp.fromMetaFile( metaPath ) )
+        return false;
+
+    QMutexLocker    ml( &idxMtx );
+    MetaRec         &M = metas[key];
+
+    M.S     = S;
+    M.kvp   = kvp;
+
+    return true;
+}
+
+
+// Return absolute paths of the (non-directory) files in dir.
+//
+QStringList DFDirIndex::files( const QString &dir )
+{
+    QString         D   = QDir( dir ).absolutePath();
+    QStringList     L;
+    QMutexLocker    ml( &idxMtx );
+    DirRec          *R  = listing( D );
+
+    if( R ) {
+
+        QMap<QString,Stat>::const_iterator  it  = R->stats.begin(),
+                                            end = R->stats.end();
+
+        for( ; it != end; ++it )
+            L.append( D + "/" + it.key() );
+    }
+
+    return L;
+}
+
+
+// Drop cached state for path's directory and path itself.
+//
+void DFDirIndex::forget( const QString &path )
+{
+    QString dir, name;
+
+    split( dir, name, path );
+
+    QMutexLocker    ml( &idxMtx );
+
+    dirs.remove( dir );
+    metas.remove( dir + "/" + name );
+}
+
+
@@ -0,0 +1,47 @@
+#ifndef DFDIRINDEX_H
+#define DFDIRINDEX_H
+
+#include <QDateTime>
+#include <QStringList>
+
+class KVParams;
+
+// Listings younger than this are reused without a disk check.
+#define DFDI_TRUSTSECS  2.0
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Process-wide index of data directories and their parsed .meta
+// files, so validating and opening many files of a run folder
+// (link dialogs, catGT-style trigger sets) costs one directory
+// listing and one parse per meta, rather than several stats,
+// opens and parses per file.
+//
+// A directory is relisted when its listing is older than
+// DFDI_TRUSTSECS. A meta is reparsed when the listing shows
+// its size or mtime changed. Writers in this process call
+// forget() after rewriting a file.
+//
+// All methods are thread-safe.
+//
+class DFDirIndex
+{
+public:
+    struct Stat {
+        QDateTime   mtime;
+        qint64      size;
+        Stat() : size(-1)   {}
+    };
+
+public:
+    static bool stat( Stat &S, const QString &path );
+    static bool meta( KVParams &kvp, const QString &metaPath );
+    static QStringList files( const QString &dir );
+    static void forget( const QString &path );
+};
+
+#endif  // DFDIRINDEX_H
+
+
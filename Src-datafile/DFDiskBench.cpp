@@ -0,0 +1,426 @@
+
+#include "DFDiskBench.h"
+#include "DataFile_Helpers.h"
+#include "Util.h"
+#include "MainApp.h"
+#include "DAQ.h"
+
+#include "SHA1.h"
+#undef TCHAR
+
+#include <QDir>
+#include <QFile>
+#include <QSettings>
+#include <QThread>
+
+#include <vector>
+
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Stream's write block: its DFWriter coalescing size, else def.
+//
+static int blkOf( double MB, int def )
+{
+    int bytes = int(qBound( 0.0, MB, 256.0 ) * 1024*1024);
+
+    return (bytes > 0 ? bytes : def);
+}
+
+/* ---------------------------------------------------------------- */
+/* DFDiskBenchWorker ---------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Block is int16 noise (LCG); its first words count blocks
+// so no two written blocks are alike.
+//
+void DFDiskBenchWorker::run()
+{
+    std::vector<qint16> blk( qMax( 4, blkBytes / 2 ) );
+    QFile               f( path );
+    CSHA1               sha;
+    DFDirectIO          *dio    = 0;
+    quint32             x       = 12345;
+    qint64              nBytes  = 2 * qint64(blk.size());
+    quint64             nBlk    = 0;
+
+    for( int i = 0, n = blk.size(); i < n; ++i ) {
+        x       = 1664525 * x + 1013904223;
+        blk[i]  = qint16(x >> 16) >> 4;
+    }
+
+    ok = f.open( QIODevice::WriteOnly | QIODevice::Truncate );
+
+    if( ok && direct ) {
+
+        dio = new DFDirectIO;
+
+        if( !dio->open( path ) ) {
+
+            Warning()
+                << "DiskBench: Direct I/O unavailable for ["
+                << path << "]; using buffered writes.";
+
+            delete dio;
+            dio = 0;
+        }
+    }
+
+    while( ok && !pleaseStop ) {
+
+        memcpy( &blk[0], &nBlk, sizeof(nBlk) );
+        ++nBlk;
+
+        if( sha1 )
+            sha.Update( (const UINT_8*)&blk[0], UINT_32(nBytes) );
+
+        qint64  n = (dio ?
+                        dio->write( (const char*)&blk[0], nBytes ) :
+                        f.write( (const char*)&blk[0], nBytes ));
+
+        if( n != nBytes ) {
+            ok = false;
+            break;
+        }
+
+        tally->fetch_add( n, std::memory_order_relaxed );
+    }
+
+    if( dio ) {
+        dio->close();
+        delete dio;
+    }
+
+    f.close();
+    f.remove();
+
+    if( !ok )
+        Error() << "DiskBench: Write failed [" << path << "].";
+
+    emit finished();
+}
+
+/* ---------------------------------------------------------------- */
+/* Config --------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Files a run with these params would write, placed and sized
+// like DataFile::openForWrite and TrigBase::openFile do. No
+// saved streams: one file per directory.
+//
+void DFDiskBench::Config::fromParams( const DAQ::Params &p )
+{
+    dirs    = mainApp()->dataDirs();
+    direct  = p.sns.directIO;
+    sha1    = true;
+
+    files.clear();
+
+    int nd      = dirs.size(),
+        imBlk   = blkOf( p.sns.imWrBlkMB, DFDB_BLKBYTES ),
+        lfBlk   = blkOf( p.sns.imWrBlkMB, DFDB_BLKBYTES / 12 ),
+        niBlk   = blkOf( p.sns.niWrBlkMB, DFDB_BLKBYTES );
+
+    if( !nd )
+        return;
+
+    if( p.im.enabled ) {
+
+        for( int ip = 0, np = p.im.get_nProbes(); ip < np; ++ip ) {
+
+            const CimCfg::AttrEach  &E = p.im.each[ip];
+
+            int nAP = E.apSaveChanCount();
+
+            if( nAP )
+                files.push_back( File( ip % nd, imBlk, nAP * E.srate * 2 ) );
+
+            if( E.lfIsSaving() ) {
+                files.push_back( File( ip % nd, lfBlk,
+                    E.lfSaveChanCount() * E.srate/12 * 2 ) );
+            }
+        }
+    }
+
+    if( p.ni.enabled ) {
+
+        int nNI = p.ni.sns.saveBits.count( true );
+
+        if( nNI )
+            files.push_back( File( 0, niBlk, nNI * p.ni.srate * 2 ) );
+    }
+
+    if( files.isEmpty() ) {
+
+        for( int id = 0; id < nd; ++id )
+            files.push_back( File( id, DFDB_BLKBYTES, 0 ) );
+    }
+}
+
+
+// Override every file's block size (bytes > 0).
+//
+void DFDiskBench::Config::setBlkBytes( int bytes )
+{
+    if( bytes <= 0 )
+        return;
+
+    for( int i = 0, n = files.size(); i < n; ++i )
+        files[i].blkBytes = bytes;
+}
+
+/* ---------------------------------------------------------------- */
+/* DFDiskBench ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Blocking; call only while not running. Keeps the calling
+// thread's events moving while the writers go.
+//
+bool DFDiskBench::run( QVector<Result> &vR, QString &err, const Config &C )
+{
+    int     nd      = C.dirs.size(),
+            nf      = C.files.size();
+    double  secs    = qMax( C.secs, DFDB_RAMPSECS + 1.0 );
+
+    vR.clear();
+    err.clear();
+
+    if( !nd || !nf ) {
+        err = "DiskBench: No data directories to test.";
+        return false;
+    }
+
+    vR.resize( nd );
+
+    for( int id = 0; id < nd; ++id ) {
+
+        vR[id].dir = C.dirs[id];
+
+        if( !QDir( C.dirs[id] ).exists() ) {
+            err = QString("DiskBench: No directory [%1].").arg( C.dirs[id] );
+            return false;
+        }
+    }
+
+    for( int i = 0; i < nf; ++i ) {
+
+        Result  &R = vR[C.files[i].idir];
+
+        R.needMBps += C.files[i].Bps / (1024*1024);
+        ++R.nFiles;
+    }
+
+    Log() <<
+        QString("DiskBench: %1 files over %2 dirs, %3 s, SHA1 %4, direct %5.")
+        .arg( nf ).arg( nd ).arg( secs )
+        .arg( C.sha1 ? "on" : "off" ).arg( C.direct ? "on" : "off" );
+
+// Writers
+
+    std::atomic<qint64>         *tally = new std::atomic<qint64>[nd];
+    QVector<QThread*>           vT;
+    QVector<DFDiskBenchWorker*> vW;
+
+    for( int id = 0; id < nd; ++id )
+        tally[id] = 0;
+
+    for( int i = 0; i < nf; ++i ) {
+
+        const File  &F = C.files[i];
+
+        QThread             *T = new QThread;
+        DFDiskBenchWorker   *W = new DFDiskBenchWorker(
+                                    QString("%1/_diskbench_%2.bin")
+                                        .arg( C.dirs[F.idir] ).arg( i ),
+                                    &tally[F.idir],
+                                    F.blkBytes, C.sha1, C.direct );
+
+        W->moveToThread( T );
+        Connect( T, SIGNAL(started()), W, SLOT(run()) );
+        Connect( W, SIGNAL(finished()), T, SLOT(quit()), Qt::DirectConnection );
+
+        vT.push_back( T );
+        vW.push_back( W );
+    }
+
+    for( int i = 0; i < nf; ++i )
+        vT[i]->start();
+
+// Sample tallies each second; ramp seconds set the base
+
+    std::vector<qint64> last( nd, 0 ),
+                        base( nd, 0 );
+    std::vector<double> minBps( nd, -1 );
+    double              t0      = getTime(),
+                        tLast   = t0,
+                        tBase   = t0;
+    int                 tick    = 0;
+    bool                failed  = false;
+
+    while( !failed ) {
+
+        guiBreathe();
+        QThread::msleep( 20 );
+
+        for( int i = 0; i < nf; ++i ) {
+
+            if( vT[i]->isFinished() )
+                failed = true;
+        }
+
+        double  t = getTime();
+
+        if( t - tLast < 1.0 )
+            continue;
+
+        ++tick;
+
+        for( int id = 0; id < nd; ++id ) {
+
+            qint64  n = tally[id].load( std::memory_order_relaxed );
+
+            if( tick > DFDB_RAMPSECS ) {
+
+                double  bps = (n - last[id]) / (t - tLast);
+
+                if( minBps[id] < 0 || bps < minBps[id] )
+                    minBps[id] = bps;
+            }
+            else
+                base[id] = n;
+
+            last[id] = n;
+        }
+
+        if( tick <= DFDB_RAMPSECS )
+            tBase = t;
+
+        tLast = t;
+
+        if( t - t0 >= secs )
+            break;
+    }
+
+// Stop and collect
+
+    for( int i = 0; i < nf; ++i )
+        vW[i]->stop();
+
+    for( int i = 0; i < nf; ++i ) {
+
+        vT[i]->wait();
+
+        if( !vW[i]->isOK() )
+            vR[C.files[i].idir].ok = false;
+
+        delete vW[i];
+        delete vT[i];
+    }
+
+    delete [] tally;
+
+    for( int id = 0; id < nd; ++id ) {
+
+        Result  &R = vR[id];
+
+        if( tLast > tBase )
+            R.avgMBps = (last[id] - base[id]) / ((tLast - tBase) * 1024*1024);
+
+        R.minMBps = qMax( 0.0, minBps[id] ) / (1024*1024);
+
+        if( !R.ok && err.isEmpty() )
+            err = QString("DiskBench: Write failed in [%1].").arg( R.dir );
+    }
+
+    if( err.isEmpty() && failed )
+        err = "DiskBench: Stopped early.";
+
+    if( err.isEmpty() )
+        save( C, vR );
+
+    return err.isEmpty();
+}
+
+
+// Name=value lines for DISKBENCH, the log and microbench.ini.
+//
+QString DFDiskBench::remoteStr( const Config &C, const QVector<Result> &vR )
+{
+    QString s;
+    int     nd = vR.size();
+
+    s  = QString("secs=%1\n").arg( C.secs );
+    s += QString("sha1=%1\n").arg( C.sha1 );
+    s += QString("direct=%1\n").arg( C.direct );
+    s += QString("nDirs=%1\n").arg( nd );
+
+    for( int id = 0; id < nd; ++id ) {
+
+        const Result    &R = vR[id];
+
+        s += QString("dir%1=%2\n").arg( id ).arg( R.dir );
+        s += QString("dir%1_nFiles=%2\n").arg( id ).arg( R.nFiles );
+        s += QString("dir%1_needMBps=%2\n")
+                .arg( id ).arg( R.needMBps, 0, 'f', 1 );
+        s += QString("dir%1_MBpsAvg=%2\n")
+                .arg( id ).arg( R.avgMBps, 0, 'f', 1 );
+        s += QString("dir%1_MBpsMin1s=%2\n")
+                .arg( id ).arg( R.minMBps, 0, 'f', 1 );
+    }
+
+    return s;
+}
+
+
+// Last saved sustained and worst 1-second MB/s for dir.
+//
+bool DFDiskBench::lookup(
+    double          &avgMBps,
+    double          &minMBps,
+    const QString   &dir )
+{
+    STDSETTINGS( settings, "microbench" );
+    settings.beginGroup( "Disk" );
+
+    QString D = QDir( dir ).absolutePath();
+
+    for( int id = 0, nd = settings.value( "nDirs", 0 ).toInt(); id < nd; ++id ) {
+
+        QString key = QString("dir%1").arg( id );
+
+        if( QDir( settings.value( key ).toString() ).absolutePath() == D ) {
+
+            avgMBps = settings.value( key + "_MBpsAvg", 0 ).toDouble();
+            minMBps = settings.value( key + "_MBpsMin1s", 0 ).toDouble();
+            return avgMBps > 0;
+        }
+    }
+
+    return false;
+}
+
+
+// Replace group Disk with these results.
+//
+void DFDiskBench::save( const Config &C, const QVector<Result> &vR )
+{
+    STDSETTINGS( settings, "microbench" );
+
+    settings.remove( "Disk" );
+    settings.beginGroup( "Disk" );
+
+    foreach( const QString &line,
+        remoteStr( C, vR ).split( "\n", QString::SkipEmptyParts ) ) {
+
+        int i = line.indexOf( '=' );
+
+        if( i > 0 )
+            settings.setValue( line.left( i ), line.mid( i + 1 ) );
+    }
+
+    settings.endGroup();
+}
+
+
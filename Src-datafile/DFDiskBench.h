@@ -0,0 +1,127 @@
+#ifndef DFDISKBENCH_H
+#define DFDISKBENCH_H
+
+#include <QObject>
+#include <QStringList>
+#include <QVector>
+
+#include <atomic>
+
+namespace DAQ {
+struct Params;
+}
+
+// Default seconds written, seconds ignored at start while
+// writers and caches spin up, and write block when a stream
+// doesn't coalesce (typical trigger block).
+#define DFDB_SECS       10
+#define DFDB_RAMPSECS   1
+#define DFDB_BLKBYTES   (512*1024)
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Writes one scratch file as a DFWriter would: fixed blocks of
+// noise samples, hashed (inline, so a bit conservative) if sha1,
+// through DFDirectIO if direct, counting bytes to its directory's
+// tally. The file is removed when done.
+//
+class DFDiskBenchWorker : public QObject
+{
+    Q_OBJECT
+
+private:
+    QString                 path;
+    std::atomic<qint64>     *tally;
+    int                     blkBytes;
+    bool                    sha1,
+                            direct;
+    std::atomic<bool>       pleaseStop;
+    bool                    ok;
+
+public:
+    DFDiskBenchWorker(
+        const QString       &path,
+        std::atomic<qint64> *tally,
+        int                 blkBytes,
+        bool                sha1,
+        bool                direct )
+    :   QObject(0), path(path), tally(tally), blkBytes(blkBytes),
+        sha1(sha1), direct(direct), pleaseStop(false), ok(true)    {}
+
+    void stop()         {pleaseStop = true;}
+    bool isOK() const   {return ok;}
+
+signals:
+    void finished();
+
+public slots:
+    void run();
+};
+
+
+// Data directory write benchmark.
+//
+// Reproduces a run's write pattern: the files the run would
+// open in each data directory (nidq on the main dir, probes
+// striped as DataFile::openForWrite does, LF beside AP), each
+// written concurrently by its own thread with that stream's
+// DFWriter block size, SHA1 and direct I/O as set. Writers go
+// flat out, so the figures are capacity, compared against the
+// run's rate (requiredBps) per directory.
+//
+// Per directory: sustained (average after DFDB_RAMPSECS) and
+// worst 1-second MB/s. Buffered writes can look faster than
+// the volume for short tests while the OS cache absorbs them;
+// direct I/O or longer tests give truer figures.
+//
+// Results are kept in _Configs/microbench.ini (group Disk) for
+// the configuration's budget planner; see lookup().
+//
+class DFDiskBench
+{
+public:
+    struct File {
+        int     idir,
+                blkBytes;
+        double  Bps;
+        File() : idir(0), blkBytes(DFDB_BLKBYTES), Bps(0)   {}
+        File( int idir, int blkBytes, double Bps )
+        :   idir(idir), blkBytes(blkBytes), Bps(Bps)        {}
+    };
+
+    struct Config {
+        QStringList     dirs;
+        QVector<File>   files;
+        double          secs;
+        bool            sha1,
+                        direct;
+        Config() : secs(DFDB_SECS), sha1(true), direct(false)   {}
+        void fromParams( const DAQ::Params &p );
+        void setBlkBytes( int bytes );
+    };
+
+    struct Result {
+        QString dir;
+        double  needMBps,
+                avgMBps,
+                minMBps;
+        int     nFiles;
+        bool    ok;
+        Result()
+        :   needMBps(0), avgMBps(0), minMBps(0), nFiles(0), ok(true)  {}
+    };
+
+public:
+    static bool run( QVector<Result> &vR, QString &err, const Config &C );
+    static QString remoteStr( const Config &C, const QVector<Result> &vR );
+    static bool lookup( double &avgMBps, double &minMBps, const QString &dir );
+
+private:
+    static void save( const Config &C, const QVector<Result> &vR );
+};
+
+#endif  // DFDISKBENCH_H
+
+
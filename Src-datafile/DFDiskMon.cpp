@@ -0,0 +1,283 @@
+
+#include "DFDiskMon.h"
+#include "Util.h"
+#include "MainApp.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QStorageInfo>
+#include <QThread>
+#include <QTimer>
+
+
+// Weight of newest rate sample.
+#define DFDM_ALPHA  0.3
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+QMutex                  DFDiskMon::mtx;
+QMap<QString,qint64>    DFDiskMon::pend;
+QMap<QString,QString>   DFDiskMon::roots;
+QMap<QString,QString>   DFDiskMon::moved;
+QMap<QString,DFDiskMon::Vol>    DFDiskMon::vols;
+QThread                 *DFDiskMon::thread  = 0;
+DFDiskMonWorker         *DFDiskMon::worker  = 0;
+
+/* ---------------------------------------------------------------- */
+/* DFDiskMonWorker ------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+void DFDiskMonWorker::run()
+{
+    timer = new QTimer( this );
+    timer->setTimerType( Qt::CoarseTimer );
+    timer->setInterval( 1000 * DFDM_PERIODSECS );
+    Connect( timer, SIGNAL(timeout()), this, SLOT(check()) );
+    timer->start();
+
+    tLast = getTime();
+}
+
+
+void DFDiskMonWorker::check()
+{
+    double  tNow    = getTime(),
+            dt      = qMax( 1e-3, tNow - tLast );
+    QString spill   = rmvLastSlash( mainApp()->spillDir() );
+
+    tLast = tNow;
+
+// Bytes per volume since last check
+
+    QMap<QString,qint64>    P, B;
+
+    DFDiskMon::mtx.lock();
+        P.swap( DFDiskMon::pend );
+    DFDiskMon::mtx.unlock();
+
+    QMap<QString,qint64>::const_iterator    it, end = P.end();
+
+    for( it = P.begin(); it != end; ++it )
+        B[DFDiskMon::rootOf( it.key() )] += it.value();
+
+// Volumes of the current data directories
+
+    QMap<QString,QStringList>   dirsOn;
+
+    foreach( const QString &d, mainApp()->dataDirs() )
+        dirsOn[DFDiskMon::rootOf( d )].append( d );
+
+    foreach( const QString &r, B.keys() ) {
+        if( !dirsOn.contains( r ) )
+            dirsOn[r] = QStringList();
+    }
+
+// Forecast
+
+    QString spillRoot;
+    quint64 spillFree = 0;
+
+    if( !spill.isEmpty() && QDir( spill ).exists() ) {
+        spillRoot = DFDiskMon::rootOf( spill );
+        spillFree = availableDiskSpace( spill );
+    }
+
+    QMap<QString,QStringList>::const_iterator   iv, endv = dirsOn.end();
+
+    for( iv = dirsOn.begin(); iv != endv; ++iv ) {
+
+        const QString   &r = iv.key();
+
+        if( r.isEmpty() )
+            continue;
+
+        DFDiskMon::mtx.lock();
+            DFDiskMon::Vol  V = DFDiskMon::vols.value( r );
+        DFDiskMon::mtx.unlock();
+
+        QString probe = (iv.value().size() ? iv.value()[0] : r);
+
+        V.root  = r;
+        V.avail = availableDiskSpace( probe );
+        V.Bps   = DFDM_ALPHA * B.value( r, 0 ) / dt + (1 - DFDM_ALPHA) * V.Bps;
+
+        if( V.Bps < 1024 ) {
+            V.Bps       = 0;
+            V.minsLeft  = -1;
+        }
+        else
+            V.minsLeft = V.avail / V.Bps / 60;
+
+        if( V.minsLeft >= 0 && V.minsLeft <= DFDM_WARNMINS && !V.warned ) {
+
+            Warning() <<
+                QString("Disk %1 forecast full in ~%2 min at %3 MB/s"
+                " (%4 GB free).")
+                .arg( r )
+                .arg( V.minsLeft, 0, 'f', 0 )
+                .arg( V.Bps / (1024*1024), 0, 'f', 1 )
+                .arg( V.avail / (1024.0*1024*1024), 0, 'f', 1 );
+
+            V.warned = 1;
+        }
+        else if( V.warned && (V.minsLeft < 0 || V.minsLeft > 2 * DFDM_WARNMINS) )
+            V.warned = 0;
+
+        // Roll over to spill if it has more room
+
+        if( V.minsLeft >= 0 && V.minsLeft <= DFDM_ROLLMINS
+            && !spillRoot.isEmpty() && spillRoot != r
+            && spillFree > V.avail ) {
+
+            foreach( const QString &d, iv.value() ) {
+
+                if( d == spill )
+                    continue;
+
+                DFDiskMon::mtx.lock();
+                    DFDiskMon::moved[d] = spill;
+                DFDiskMon::mtx.unlock();
+
+                Warning() <<
+                    QString("Disk %1 nearly full: new files for [%2]"
+                    " now go to [%3].")
+                    .arg( r ).arg( d ).arg( spill );
+            }
+        }
+
+        DFDiskMon::mtx.lock();
+            DFDiskMon::vols[r] = V;
+        DFDiskMon::mtx.unlock();
+    }
+}
+
+/* ---------------------------------------------------------------- */
+/* DFDiskMon ------------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+void DFDiskMon::start()
+{
+    if( thread )
+        return;
+
+    thread  = new QThread;
+    worker  = new DFDiskMonWorker;
+
+    worker->moveToThread( thread );
+
+    Connect( thread, SIGNAL(started()), worker, SLOT(run()) );
+    Connect( worker, SIGNAL(destroyed()), thread, SLOT(quit()), Qt::DirectConnection );
+
+    thread->start( QThread::LowPriority );
+}
+
+
+// worker object auto-deleted asynchronously, in its thread
+// thread object manually deleted synchronously (so we can call wait())
+//
+void DFDiskMon::stop()
+{
+    if( !thread )
+        return;
+
+    worker->deleteLater();
+    thread->wait();
+
+    delete thread;
+    thread = 0;
+    worker = 0;
+}
+
+
+void DFDiskMon::reset()
+{
+    QMutexLocker    ml( &mtx );
+
+    moved.clear();
+    pend.clear();
+
+    QMap<QString,Vol>::iterator it, end = vols.end();
+
+    for( it = vols.begin(); it != end; ++it ) {
+        it->Bps         = 0;
+        it->minsLeft    = -1;
+        it->warned      = 0;
+    }
+}
+
+
+// Called by trigger threads with bytes written since last call.
+//
+void DFDiskMon::addWritten( const QString &binPath, qint64 bytes )
+{
+    if( bytes <= 0 )
+        return;
+
+    QString dir = QFileInfo( binPath ).absolutePath();
+
+    QMutexLocker    ml( &mtx );
+
+    pend[dir] += bytes;
+}
+
+
+// Directory new files should use in place of dir.
+//
+QString DFDiskMon::mapDir( const QString &dir )
+{
+    QMutexLocker    ml( &mtx );
+
+    return moved.value( dir, dir );
+}
+
+
+// One line per volume with a forecast, for display.
+//
+QStringList DFDiskMon::summary()
+{
+    QMutexLocker    ml( &mtx );
+    QStringList     L;
+
+    foreach( const Vol &V, vols ) {
+
+        if( V.minsLeft < 0 )
+            continue;
+
+        L.append(
+            QString("%1  %2 GB free, ~%3 min at %4 MB/s")
+            .arg( V.root )
+            .arg( V.avail / (1024.0*1024*1024), 0, 'f', 1 )
+            .arg( V.minsLeft, 0, 'f', 0 )
+            .arg( V.Bps / (1024*1024), 0, 'f', 1 ) );
+    }
+
+    QMap<QString,QString>::const_iterator   it, end = moved.end();
+
+    for( it = moved.begin(); it != end; ++it )
+        L.append( QString("%1  moved to  %2").arg( it.key() ).arg( it.value() ) );
+
+    return L;
+}
+
+
+// Volume root of dir, cached. Monitor thread only.
+//
+QString DFDiskMon::rootOf( const QString &dir )
+{
+    QMap<QString,QString>::const_iterator   it = roots.find( dir );
+
+    if( it != roots.end() )
+        return it.value();
+
+    QStorageInfo    si( dir );
+    QString         r = (si.isValid() ? si.rootPath() : QString());
+
+    if( !r.isEmpty() )
+        roots[dir] = r;
+
+    return r;
+}
+
+
@@ -0,0 +1,98 @@
+#ifndef DFDISKMON_H
+#define DFDISKMON_H
+
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+
+class QThread;
+class QTimer;
+
+// Seconds between checks, and forecast minutes at which we
+// warn and at which new files move to the spill directory.
+#define DFDM_PERIODSECS 5
+#define DFDM_WARNMINS   30
+#define DFDM_ROLLMINS   5
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+class DFDiskMonWorker : public QObject
+{
+    Q_OBJECT
+
+private:
+    QTimer  *timer;
+    double  tLast;
+
+public:
+    DFDiskMonWorker() : QObject(0), timer(0), tLast(0)  {}
+
+public slots:
+    void run();
+
+private slots:
+    void check();
+};
+
+
+// Free space forecasting for the recording volumes.
+//
+// Trigger threads report each file's bytes written at every
+// status pass (addWritten). A monitor thread, every
+// DFDM_PERIODSECS, groups those by volume with the volumes of
+// the current data directories, reads free space, smooths the
+// write rate, and forecasts minutes to full.
+//
+// - At DFDM_WARNMINS a volume gets one warning (again only after
+//   it recovers to twice that).
+// - At DFDM_ROLLMINS, if a spill directory is set (mainapp.ini
+//   MainApp/dataDirSpill) on another volume with more room, the
+//   data directories on the full volume are mapped to it. Files
+//   opened from then on (next trigger, next gate, LF following
+//   AP) go there; files already open finish where they are. The
+//   trigger threads never stop or wait for this.
+//
+// reset() at run start forgets the mapping.
+//
+class DFDiskMon
+{
+    friend class DFDiskMonWorker;
+
+public:
+    struct Vol {
+        QString root;
+        quint64 avail;
+        double  Bps,        // smoothed write rate
+                minsLeft;   // < 0 if not being written
+        int     warned;
+        Vol() : avail(0), Bps(0), minsLeft(-1), warned(0)  {}
+    };
+
+private:
+    static QMutex                   mtx;
+    static QMap<QString,qint64>     pend;   // file dir -> bytes
+    static QMap<QString,QString>    roots,  // dir -> volume root
+                                    moved;  // full dir -> spill dir
+    static QMap<QString,Vol>        vols;   // volume root -> state
+    static QThread                  *thread;
+    static DFDiskMonWorker          *worker;
+
+public:
+    static void start();
+    static void stop();
+    static void reset();
+
+    static void addWritten( const QString &binPath, qint64 bytes );
+    static QString mapDir( const QString &dir );
+    static QStringList summary();
+
+private:
+    static QString rootOf( const QString &dir );
+};
+
+#endif  // DFDISKMON_H
+
+
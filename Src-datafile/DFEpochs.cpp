@@ -0,0 +1,218 @@
+
+#include "DFEpochs.h"
+#include "Util.h"
+
+#include <QThread>
+
+
+#define DFEPO_MAGIC     0x504C4753  // 'SGLP'
+#define DFEPO_VERSION   2
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+static bool readAll( QFile &f, void *dst, qint64 bytes )
+{
+    return !bytes || f.read( (char*)dst, bytes ) == bytes;
+}
+
+/* ---------------------------------------------------------------- */
+/* DFEpochsWorker ------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void DFEpochsWorker::append( QByteArray rec )
+{
+    if( isBad || (!isOpen && !open()) )
+        return;
+
+    if( f.write( rec ) != rec.size() || !f.flush() ) {
+
+        Warning() << "Epoch index write failed [" << f.fileName() << "].";
+        isBad = true;
+    }
+}
+
+
+// Keep existing file if header matches our streams and
+// it holds whole records; else start over.
+//
+bool DFEpochsWorker::open()
+{
+    int     nS      = ips.size();
+    qint64  hdrB    = 4 * sizeof(quint32) + nS * sizeof(qint32),
+            recB    = 4 * sizeof(qint32) + nS * 5 * sizeof(quint64);
+    bool    keep    = false;
+
+    if( f.open( QIODevice::ReadWrite ) ) {
+
+        quint32         H[4];
+        QVector<qint32> I( nS );
+
+        keep = f.size() >= hdrB
+                && !((f.size() - hdrB) % recB)
+                && readAll( f, H, sizeof(H) )
+                && H[0] == DFEPO_MAGIC
+                && H[1] == DFEPO_VERSION
+                && int(H[2]) == nS
+                && readAll( f, I.data(), nS * sizeof(qint32) );
+
+        for( int is = 0; keep && is < nS; ++is )
+            keep = I[is] == ips[is];
+    }
+
+    if( keep )
+        isOpen = f.seek( f.size() );
+    else {
+
+        f.close();
+
+        quint32 H[4] = {DFEPO_MAGIC, DFEPO_VERSION, quint32(nS), 0};
+
+        isOpen = f.open( QIODevice::WriteOnly | QIODevice::Truncate )
+                    && f.write( (const char*)H, sizeof(H) ) == sizeof(H)
+                    && f.write( (const char*)ips.data(), nS * sizeof(qint32) )
+                        == qint64(nS * sizeof(qint32));
+    }
+
+    if( !isOpen ) {
+        Warning() << "Epoch index not opened [" << f.fileName() << "].";
+        isBad = true;
+    }
+
+    return isOpen;
+}
+
+/* ---------------------------------------------------------------- */
+/* DFEpochs ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+DFEpochs::DFEpochs( const QString &path, const QVector<int> &ips )
+    :   ips(ips)
+{
+    thread  = new QThread;
+    worker  = new DFEpochsWorker( path, ips );
+
+    worker->moveToThread( thread );
+
+    Connect( worker, SIGNAL(destroyed()), thread, SLOT(quit()), Qt::DirectConnection );
+
+    thread->start( QThread::LowPriority );
+}
+
+
+// Worker drains queued records, then deletes itself,
+// which quits the thread.
+//
+DFEpochs::~DFEpochs()
+{
+    worker->deleteLater();
+    thread->wait();
+    delete thread;
+}
+
+
+void DFEpochs::add( const DFEpochRec &R )
+{
+    int         nS = ips.size();
+    QByteArray  rec;
+    qint32      G[4] = {R.g, R.t, R.ep, 0};
+
+    rec.append( (const char*)G, sizeof(G) );
+
+    for( int is = 0; is < nS; ++is ) {
+
+        DFEpochSpan S = (is < R.S.size() ? R.S[is] : DFEpochSpan());
+
+        rec.append( (const char*)&S.firstCt, sizeof(quint64) );
+        rec.append( (const char*)&S.limCt, sizeof(quint64) );
+        rec.append( (const char*)&S.fileCt, sizeof(quint64) );
+        rec.append( (const char*)&S.tFirst, sizeof(double) );
+        rec.append( (const char*)&S.tLim, sizeof(double) );
+    }
+
+    QMetaObject::invokeMethod(
+        worker, "append",
+        Qt::QueuedConnection,
+        Q_ARG(QByteArray, rec) );
+}
+
+
+QString DFEpochs::epochsName(
+    const QString   &dataDir,
+    const QString   &runName )
+{
+    return QString("%1/%2.epochs").arg( dataDir ).arg( runName );
+}
+
+
+// Read whole index. Return false if unreadable or malformed;
+// a partial trailing record (writer cut off) is ignored.
+//
+bool DFEpochs::load(
+    QVector<int>        &ips,
+    QVector<DFEpochRec> &vR,
+    const QString       &path )
+{
+    QFile   f( path );
+    quint32 H[4];
+
+    ips.clear();
+    vR.clear();
+
+    if( !f.open( QIODevice::ReadOnly )
+        || !readAll( f, H, sizeof(H) )
+        || H[0] != DFEPO_MAGIC
+        || H[1] != DFEPO_VERSION ) {
+
+        return false;
+    }
+
+    int     nS      = H[2];
+    qint64  recB    = 4 * sizeof(qint32) + nS * 5 * sizeof(quint64);
+
+    if( nS < 0 || nS > 4096 )
+        return false;
+
+    QVector<qint32> I( nS );
+
+    if( !readAll( f, I.data(), nS * sizeof(qint32) ) )
+        return false;
+
+    for( int is = 0; is < nS; ++is )
+        ips.push_back( I[is] );
+
+    for( qint64 nR = (f.size() - f.pos()) / recB; nR > 0; --nR ) {
+
+        DFEpochRec  R;
+        qint32      G[4];
+
+        if( !readAll( f, G, sizeof(G) ) )
+            return false;
+
+        R.g     = G[0];
+        R.t     = G[1];
+        R.ep    = G[2];
+        R.S.resize( nS );
+
+        for( int is = 0; is < nS; ++is ) {
+
+            DFEpochSpan &S = R.S[is];
+
+            if( !readAll( f, &S.firstCt, sizeof(quint64) )
+                || !readAll( f, &S.limCt, sizeof(quint64) )
+                || !readAll( f, &S.fileCt, sizeof(quint64) )
+                || !readAll( f, &S.tFirst, sizeof(double) )
+                || !readAll( f, &S.tLim, sizeof(double) ) ) {
+
+                return false;
+            }
+        }
+
+        vR.push_back( R );
+    }
+
+    return true;
+}
+
+
@@ -0,0 +1,114 @@
+#ifndef DFEPOCHS_H
+#define DFEPOCHS_H
+
+#include <QFile>
+#include <QObject>
+#include <QVector>
+
+class QThread;
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// One stream's span in one epoch.
+//
+// Counts are stream samples since run start (imec at AP rate),
+// limCt one past the last. fileCt is the file sample where the
+// epoch begins: zero unless a file holds several epochs (timed
+// trigger, one file per gate). Times are the stream's own sync-
+// corrected times (AIQ::mapCt2TimeSync). All zero if the stream
+// wrote nothing this epoch.
+//
+struct DFEpochSpan {
+    quint64 firstCt,
+            limCt,
+            fileCt;
+    double  tFirst,
+            tLim;
+
+    DFEpochSpan()
+    :   firstCt(0), limCt(0), fileCt(0), tFirst(0), tLim(0)   {}
+};
+
+
+// An epoch: a high interval of the trigger, recorded in file
+// set _g<g>_t<t>; ep counts epochs within the gate.
+//
+struct DFEpochRec {
+    QVector<DFEpochSpan>    S;      // per stream, header order
+    int                     g,
+                            t,
+                            ep;
+
+    DFEpochRec() : g(-1), t(-1), ep(-1) {}
+};
+
+
+// Appends records to the index file on its own thread.
+//
+class DFEpochsWorker : public QObject
+{
+    Q_OBJECT
+
+private:
+    QFile           f;
+    QVector<int>    ips;
+    bool            isOpen,
+                    isBad;
+
+public:
+    DFEpochsWorker( const QString &path, const QVector<int> &ips )
+    :   QObject(0), f(path), ips(ips), isOpen(false), isBad(false) {}
+    virtual ~DFEpochsWorker()   {f.close();}
+
+public slots:
+    void append( QByteArray rec );
+
+private:
+    bool open();
+};
+
+
+// Epoch index of a run, so analysis tools and the viewer can
+// locate every trigger epoch without opening each meta file.
+//
+// File <dataDir>/<runName>.epochs (little-endian):
+// - Header:  'SGLP', u32 version, u32 nStreams, u32 0,
+//            then i32 ip per stream (-1 = nidq).
+// - Records: i32 g, i32 t, i32 ep, i32 0,
+//            then per stream: u64 firstCt, u64 limCt,
+//                             u64 fileCt, f64 tFirst, f64 tLim.
+//
+// Records are fixed size and appended in epoch order. A run
+// resumed under the same name keeps appending if it has the
+// same streams; otherwise the file is started over.
+//
+// add() only queues the record; file I/O is on a worker thread.
+//
+class DFEpochs
+{
+private:
+    QVector<int>    ips;
+    QThread         *thread;
+    DFEpochsWorker  *worker;
+
+public:
+    DFEpochs( const QString &path, const QVector<int> &ips );
+    virtual ~DFEpochs();
+
+    void add( const DFEpochRec &R );
+
+    static QString epochsName(
+        const QString   &dataDir,
+        const QString   &runName );
+
+    static bool load(
+        QVector<int>        &ips,
+        QVector<DFEpochRec> &vR,
+        const QString       &path );
+};
+
+#endif  // DFEPOCHS_H
+
+
@@ -0,0 +1,421 @@
+
+#include "DFEvents.h"
+#include "DataFile.h"
+#include "DataFile_Helpers.h"
+#include "AIQ.h"
+#include "Util.h"
+
+#include <QBitArray>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegExp>
+
+#include <algorithm>
+
+
+#define DFEVT_MAGIC     0x454C4753  // 'SGLE'
+#define DFEVT_VERSION   1
+
+// Scans read per block while indexing.
+#define DFEVT_BLKSCANS  (64*1024)
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Append ct0 + i for each set bit i of w.
+//
+static void addBits( std::vector<quint64> &v, quint64 w, quint64 ct0 )
+{
+    for( int i = 0; w; ++i, w >>= 1 ) {
+
+        if( w & 1 )
+            v.push_back( ct0 + i );
+    }
+}
+
+
+static bool writeAll( QFile &f, const void *src, qint64 bytes )
+{
+    return !bytes || f.write( (const char*)src, bytes ) == bytes;
+}
+
+
+static bool readAll( QFile &f, void *dst, qint64 bytes )
+{
+    return !bytes || f.read( (char*)dst, bytes ) == bytes;
+}
+
+/* ---------------------------------------------------------------- */
+/* DFEventsWorker ------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+bool DFEventsWorker::build( DataFile *df, QFile &f )
+{
+    std::vector<DFEvtEdges> vE;
+    bool                    ok = scan( vE, df );
+
+    if( ok ) {
+
+        quint64 scanCt = df->scanCount();
+        quint32 H[4]   = {DFEVT_MAGIC, DFEVT_VERSION, quint32(vE.size()), 0};
+
+        ok = writeAll( f, H, sizeof(H) )
+                && writeAll( f, &scanCt, sizeof(scanCt) );
+
+        for( int i = 0, n = vE.size(); ok && i < n; ++i ) {
+
+            const DFEvtEdges    &E = vE[i];
+            qint32              L[4] = {E.L.iword, E.L.bit, E.lvl0, 0};
+            quint64             N[2] = {E.rise.size(), E.fall.size()};
+
+            ok = writeAll( f, L, sizeof(L) ) && writeAll( f, N, sizeof(N) );
+        }
+
+        for( int i = 0, n = vE.size(); ok && i < n; ++i ) {
+
+            const DFEvtEdges    &E = vE[i];
+
+            ok = (E.rise.empty()
+                    || writeAll( f, &E.rise[0], E.rise.size() * sizeof(quint64) ))
+                && (E.fall.empty()
+                    || writeAll( f, &E.fall[0], E.fall.size() * sizeof(quint64) ));
+        }
+    }
+
+    return ok;
+}
+
+
+// Read just the lines' words, a block at a time. Each word
+// column is gathered to a tile and reduced to a bitmask by
+// the AIQ edge kernel; transitions are then mask ^ (mask<<1).
+//
+bool DFEventsWorker::scan( std::vector<DFEvtEdges> &vE, DataFile *df )
+{
+    int     nC      = df->numChans(),
+            nL      = lines.size();
+    quint64 scanCt  = df->scanCount();
+
+// Kept words and each line's column among them
+
+    QBitArray   keep( nC );
+
+    for( int i = 0; i < nL; ++i ) {
+
+        if( lines[i].iword < 0 || lines[i].iword >= nC )
+            return false;
+
+        keep.setBit( lines[i].iword );
+    }
+
+    std::vector<int>    col( nL );
+    int                 nK = 0;
+
+    for( int ic = 0; ic < nC; ++ic ) {
+
+        if( !keep.testBit( ic ) )
+            continue;
+
+        for( int i = 0; i < nL; ++i ) {
+
+            if( lines[i].iword == ic )
+                col[i] = nK;
+        }
+
+        ++nK;
+    }
+
+    vE.assign( nL, DFEvtEdges() );
+
+    for( int i = 0; i < nL; ++i )
+        vE[i].L = lines[i];
+
+// Scan
+
+    std::vector<int>    last( nL, -1 );     // level of previous scan
+    vec_i16             data;
+    qint16              tile[512];
+    quint64             bits[8];
+
+    for( quint64 s0 = 0; s0 < scanCt; s0 += DFEVT_BLKSCANS ) {
+
+        if( pleaseStop )
+            return false;
+
+        int n = (int)qMin( quint64(DFEVT_BLKSCANS), scanCt - s0 );
+
+        if( df->readScans( data, s0, n, keep ) != n )
+            return false;
+
+        for( int i = 0; i < nL; ++i ) {
+
+            DFEvtEdges  &E      = vE[i];
+            int         bit     = E.L.bit,
+                        c       = col[i];
+
+            if( last[i] < 0 )
+                E.lvl0 = last[i] = (data[c] >> bit) & 1;
+
+            for( int it0 = 0; it0 < n; it0 += 512 ) {
+
+                int nt = qMin( 512, n - it0 );
+
+                const qint16    *S = &data[it0*nK + c];
+
+                for( int it = 0; it < nt; ++it, S += nK )
+                    tile[it] = *S;
+
+                AIQ::bitMask512( bits, tile, nt, bit );
+
+                for( int iw = 0; iw * 64 < nt; ++iw ) {
+
+                    int     nb  = qMin( 64, nt - iw * 64 );
+                    quint64 w   = bits[iw],
+                            m   = (nb < 64 ? (quint64(1) << nb) - 1 : ~quint64(0)),
+                            t   = (w ^ ((w << 1) | quint64(last[i]))) & m,
+                            ct0 = s0 + it0 + iw * 64;
+
+                    if( t ) {
+                        addBits( E.rise, t & w, ct0 );
+                        addBits( E.fall, t & ~w, ct0 );
+                    }
+
+                    last[i] = int((w >> (nb - 1)) & 1);
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+/* ---------------------------------------------------------------- */
+/* DFEvents ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+DFEvents::DFEvents( const DataFile &df, const QVector<DFEvtLine> &lines )
+    :   QObject(0), lines(lines), binName(df.binFileName()),
+        scanCt(df.scanCount()), worker(0), _isReady(false)
+{
+    QRegExp re("bin$");
+    re.setCaseSensitivity( Qt::CaseInsensitive );
+
+    evtName = QString(binName).replace( re, "evt" );
+
+    if( lines.isEmpty() )
+        return;
+
+    QFileInfo   fiB( binName ),
+                fiE( evtName );
+
+    if( fiE.exists() && fiE.lastModified() >= fiB.lastModified() && load() )
+        return;
+
+    worker  = new DFEventsWorker( binName, evtName, lines );
+
+    DFSidecarWorker::start( worker, this );
+}
+
+
+DFEvents::~DFEvents()
+{
+    DFSidecarWorker::end( worker );
+}
+
+
+// First edge (any line, rising or falling) after scan from.
+//
+bool DFEvents::next( quint64 &ct, quint64 from ) const
+{
+    bool    found = false;
+
+    for( int i = 0, n = vE.size(); i < n; ++i ) {
+
+        const std::vector<quint64>  *V[2] = {&vE[i].rise, &vE[i].fall};
+
+        for( int k = 0; k < 2; ++k ) {
+
+            std::vector<quint64>::const_iterator
+                it = std::upper_bound( V[k]->begin(), V[k]->end(), from );
+
+            if( it != V[k]->end() && (!found || *it < ct) ) {
+                ct      = *it;
+                found   = true;
+            }
+        }
+    }
+
+    return found;
+}
+
+
+// Last edge (any line, rising or falling) before scan from.
+//
+bool DFEvents::prev( quint64 &ct, quint64 from ) const
+{
+    bool    found = false;
+
+    for( int i = 0, n = vE.size(); i < n; ++i ) {
+
+        const std::vector<quint64>  *V[2] = {&vE[i].rise, &vE[i].fall};
+
+        for( int k = 0; k < 2; ++k ) {
+
+            std::vector<quint64>::const_iterator
+                it = std::lower_bound( V[k]->begin(), V[k]->end(), from );
+
+            if( it != V[k]->begin() && (!found || *(it - 1) > ct) ) {
+                ct      = *(it - 1);
+                found   = true;
+            }
+        }
+    }
+
+    return found;
+}
+
+
+// Set v to (start, end) pairs of scans where line is high,
+// clipped to [s0, sLim). Spans less than minGap apart are
+// merged, so dense trains stay cheap to draw when zoomed out.
+//
+void DFEvents::highSpans(
+    std::vector<quint64>    &v,
+    int                     line,
+    quint64                 s0,
+    quint64                 sLim,
+    quint64                 minGap ) const
+{
+    v.clear();
+
+    if( line < 0 || line >= nLines() || sLim <= s0 )
+        return;
+
+    const std::vector<quint64>  &R = vE[line].rise,
+                                &F = vE[line].fall;
+
+// Level at s0: last transition at or before s0
+
+    std::vector<quint64>::const_iterator
+        ir = std::upper_bound( R.begin(), R.end(), s0 ),
+        jf = std::upper_bound( F.begin(), F.end(), s0 );
+
+    bool    hi;
+
+    if( ir == R.begin() && jf == F.begin() )
+        hi = vE[line].lvl0;
+    else if( jf == F.begin() )
+        hi = true;
+    else if( ir == R.begin() )
+        hi = false;
+    else
+        hi = *(ir - 1) > *(jf - 1);
+
+    quint64 start = s0;
+
+    for(;;) {
+
+        if( hi ) {
+
+            quint64 end = (jf != F.end() ? qMin( *jf, sLim ) : sLim);
+
+            if( !v.empty() && start - v.back() < minGap )
+                v.back() = end;
+            else {
+                v.push_back( start );
+                v.push_back( end );
+            }
+
+            if( end >= sLim )
+                break;
+
+            ir  = std::upper_bound( ir, R.end(), end );
+            ++jf;
+            hi  = false;
+        }
+        else {
+
+            if( ir == R.end() || *ir >= sLim )
+                break;
+
+            start   = *ir;
+            jf      = std::upper_bound( jf, F.end(), start );
+            ++ir;
+            hi      = true;
+        }
+    }
+}
+
+
+void DFEvents::buildDone( bool ok )
+{
+    DFSidecarWorker::end( worker );
+
+    if( ok && load() )
+        emit ready();
+}
+
+
+// Read sidecar and check it matches the bin file and lines.
+//
+bool DFEvents::load()
+{
+    QFile   f( evtName );
+
+    if( !f.open( QIODevice::ReadOnly ) )
+        return false;
+
+    quint32 H[4];
+    quint64 ct;
+
+    if( !readAll( f, H, sizeof(H) )
+        || !readAll( f, &ct, sizeof(ct) )
+        || H[0] != DFEVT_MAGIC
+        || H[1] != DFEVT_VERSION
+        || int(H[2]) != lines.size()
+        || ct != scanCt ) {
+
+        return false;
+    }
+
+    std::vector<DFEvtEdges> E( H[2] );
+
+    for( int i = 0, n = E.size(); i < n; ++i ) {
+
+        qint32  L[4];
+        quint64 N[2];
+
+        if( !readAll( f, L, sizeof(L) )
+            || !readAll( f, N, sizeof(N) )
+            || !(DFEvtLine( L[0], L[1] ) == lines[i])
+            || N[0] > scanCt
+            || N[1] > scanCt ) {
+
+            return false;
+        }
+
+        E[i].L      = lines[i];
+        E[i].lvl0   = L[2];
+        E[i].rise.resize( N[0] );
+        E[i].fall.resize( N[1] );
+    }
+
+    for( int i = 0, n = E.size(); i < n; ++i ) {
+
+        if( (E[i].rise.size()
+                && !readAll( f, &E[i].rise[0], E[i].rise.size() * sizeof(quint64) ))
+            || (E[i].fall.size()
+                && !readAll( f, &E[i].fall[0], E[i].fall.size() * sizeof(quint64) )) ) {
+
+            return false;
+        }
+    }
+
+    vE.swap( E );
+    _isReady = true;
+    return true;
+}
+
+
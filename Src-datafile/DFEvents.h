@@ -0,0 +1,122 @@
+#ifndef DFEVENTS_H
+#define DFEVENTS_H
+
+#include "SGLTypes.h"
+#include "DFSidecar.h"
+
+#include <QVector>
+
+class DataFile;
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// A digital line: bit of a saved word (file channel index).
+//
+struct DFEvtLine {
+    int iword,
+        bit;
+
+    DFEvtLine() : iword(0), bit(0)  {}
+    DFEvtLine( int iword, int bit ) : iword(iword), bit(bit)    {}
+    bool operator==( const DFEvtLine &rhs ) const
+        {return iword == rhs.iword && bit == rhs.bit;}
+};
+
+
+// Edges of one line: initial level and sorted scan indices
+// of rising and falling transitions.
+//
+struct DFEvtEdges {
+    DFEvtLine               L;
+    std::vector<quint64>    rise,
+                            fall;
+    int                     lvl0;
+
+    DFEvtEdges() : lvl0(0)  {}
+};
+
+
+// Worker builds the sidecar (see DFSidecarWorker).
+//
+class DFEventsWorker : public DFSidecarWorker
+{
+private:
+    QVector<DFEvtLine>  lines;
+
+public:
+    DFEventsWorker(
+        const QString               &binName,
+        const QString               &evtName,
+        const QVector<DFEvtLine>    &lines )
+    :   DFSidecarWorker( binName, evtName, "Event index", true ),
+        lines(lines)    {}
+
+protected:
+    virtual bool build( DataFile *df, QFile &f );
+
+private:
+    bool scan( std::vector<DFEvtEdges> &vE, DataFile *df );
+};
+
+
+// Edge index of digital lines of a bin file, for jumping
+// between TTL events and marking them at any zoom without
+// rescanning data.
+//
+// Sidecar file <name>.evt beside the bin (little-endian):
+// - Header: 'SGLE', u32 version, u32 nLines, u32 0, u64 scanCt.
+// - Per line: i32 iword, i32 bit, i32 lvl0, i32 0,
+//             u64 nRise, u64 nFall.
+// - Per line: u64 rise[nRise], u64 fall[nFall].
+//
+// The sidecar is loaded if present, no older than the bin, and
+// for the same lines. Otherwise it's built in the background
+// (to a temp name, then renamed) and ready() is emitted when it
+// can be used.
+//
+class DFEvents : public QObject
+{
+    Q_OBJECT
+
+private:
+    std::vector<DFEvtEdges> vE;
+    QVector<DFEvtLine>      lines;
+    QString                 binName,
+                            evtName;
+    quint64                 scanCt;
+    DFSidecarWorker         *worker;
+    bool                    _isReady;
+
+public:
+    DFEvents( const DataFile &df, const QVector<DFEvtLine> &lines );
+    virtual ~DFEvents();
+
+    bool isReady() const    {return _isReady;}
+    int nLines() const      {return (int)vE.size();}
+    const DFEvtEdges &edges( int i ) const  {return vE[i];}
+
+    bool next( quint64 &ct, quint64 from ) const;
+    bool prev( quint64 &ct, quint64 from ) const;
+
+    void highSpans(
+        std::vector<quint64>    &v,
+        int                     line,
+        quint64                 s0,
+        quint64                 sLim,
+        quint64                 minGap ) const;
+
+signals:
+    void ready();
+
+private slots:
+    void buildDone( bool ok );
+
+private:
+    bool load();
+};
+
+#endif  // DFEVENTS_H
+
+
@@ -1,5 +1,6 @@
 
 #include "DFName.h"
+#include "DFDirIndex.h"
 #include "KVParams.h"
 
 #include <QDir>
@@ -60,6 +61,46 @@ DFRunTag::DFRunTag( const QString &filePath )
             fldPerPrb   = false;
         }
     }
+
+// Striped run: if the file is still where it was recorded,
+// runDir is the main disk's, so all streams of the run compare
+// equal, and altDirs lists the others.
+
+    KVParams    kvp;
+
+    if( DFDirIndex::meta( kvp, DFName::forceMetaSuffix( filePath ) ) ) {
+
+        QStringList roots =
+                        kvp["runStripeDirs"].toString()
+                        .split( ";", QString::SkipEmptyParts ),
+                    dirs;
+
+        foreach( const QString &r, roots ) {
+            dirs.append(
+                QString("%1/%2_g%3/").arg( r ).arg( runName ).arg( g ) );
+        }
+
+        if( dirs.contains( runDir, Qt::CaseInsensitive ) ) {
+
+            runDir  = dirs.takeFirst();
+            altDirs = dirs;
+
+            if( !fldPerPrb ) {
+
+                foreach( const QString &d, dirs ) {
+
+                    if( QDir(
+                            QString("%1%2_g%3_imec0")
+                            .arg( d ).arg( runName ).arg( g )
+                        ).exists() ) {
+
+                        fldPerPrb = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
 }
 
 
@@ -91,25 +132,50 @@ QString DFRunTag::brevname( int ip, const QString &suffix ) const
 // ip = -1, suffix = {bin, meta}.
 // ip = 0+, suffix = {ap.bin, lf.meta, etc}.
 //
+// Striped runs: first of runDir, altDirs holding the file,
+// else the runDir name.
+//
 QString DFRunTag::filename( int ip, const QString &suffix ) const
+{
+    QString name = filenameIn( runDir, ip, suffix );
+
+    if( !altDirs.isEmpty() && !QFileInfo( name ).exists() ) {
+
+        foreach( const QString &d, altDirs ) {
+
+            QString alt = filenameIn( d, ip, suffix );
+
+            if( QFileInfo( alt ).exists() )
+                return alt;
+        }
+    }
+
+    return name;
+}
+
+
+QString DFRunTag::filenameIn(
+    const QString   &dir,
+    int             ip,
+    const QString   &suffix ) const
 {
     if( ip < 0 ) {
 
         return QString("%1%2_g%3_t%4.nidq.%5")
-                .arg( runDir )
+                .arg( dir )
                 .arg( runName ).arg( g ).arg( t )
                 .arg( suffix );
     }
     else if( fldPerPrb ) {
 
         return QString("%1%2_g%3_imec%5/%2_g%3_t%4.imec%5.%6")
-                .arg( runDir )
+                .arg( dir )
                 .arg( runName ).arg( g ).arg( t )
                 .arg( ip ).arg( suffix );
     }
     else {
         return QString("%1%2_g%3_t%4.imec%5.%6")
-                .arg( runDir )
+                .arg( dir )
                 .arg( runName ).arg( g ).arg( t )
                 .arg( ip ).arg( suffix );
     }
@@ -247,6 +313,9 @@ qint64 DFName::fileSize( const QFileInfo &fi, QString *error )
 }
 
 
+// Existence, sizes and meta data come from DFDirIndex,
+// so a folder of many files is listed once.
+//
 bool DFName::isValidInputFile(
     const QString   &name,
     QString         *error,
@@ -260,9 +329,10 @@ bool DFName::isValidInputFile(
     if( -1 == typeAndIP( ip, name, error ) )
         return false;
 
-    QString     bFile = name,
-                mFile;
-    QFileInfo   fi( bFile );
+    QString             bFile = name,
+                        mFile;
+    QFileInfo           fi( bFile );
+    DFDirIndex::Stat    S;
 
 // -------------------
 // Binary file exists?
@@ -277,7 +347,7 @@ bool DFName::isValidInputFile(
         fi.setFile( bFile );
     }
 
-    if( !fi.exists() ) {
+    if( !DFDirIndex::stat( S, bFile ) ) {
 
         if( error ) {
             *error =
@@ -292,7 +362,7 @@ bool DFName::isValidInputFile(
 // Binary file empty?
 // ------------------
 
-    qint64  binSize = fileSize( fi, error );
+    qint64  binSize = S.size;
 
     if( binSize <= 0 ) {
 
@@ -313,7 +383,7 @@ bool DFName::isValidInputFile(
 
     fi.setFile( mFile );
 
-    if( !fi.exists() ) {
+    if( !DFDirIndex::stat( S, mFile ) ) {
 
         if( error ) {
             *error =
@@ -324,20 +394,16 @@ bool DFName::isValidInputFile(
         return false;
     }
 
-// -------------------
-// Meta file readable?
-// -------------------
-
-    if( !isFileReadable( fi, error ) )
-        return false;
-
-// -------------------
-// Meta content valid?
-// -------------------
+// -----------------------------
+// Meta file readable and valid?
+// -----------------------------
 
     KVParams    kvp;
 
-    if( !kvp.fromMetaFile( mFile ) ) {
+    if( !DFDirIndex::meta( kvp, mFile ) ) {
+
+        if( !isFileReadable( fi, error ) )
+            return false;
 
         if( error ) {
             *error =
@@ -387,7 +453,12 @@ bool DFName::isValidInputFile(
         return false;
     }
 
-    if( kvp["fileSizeBytes"].toLongLong() != binSize ) {
+    // Compressed files: fileSizeBytes is the decoded size
+
+    key = (kvp.contains( "fileCompression" ) ?
+            "fileCmpBytes" : "fileSizeBytes");
+
+    if( kvp[key].toLongLong() != binSize ) {
 
         if( error ) {
             *error =
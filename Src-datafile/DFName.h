@@ -2,6 +2,7 @@
 #define DFNAME_H
 
 #include <QFileInfo>
+#include <QStringList>
 
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
@@ -10,11 +11,12 @@
 class DFRunTag
 {
 public:
-    QString runDir,         // path/run_gN/ (term slash)
-            runName,        // run          (undecorated)
-            t;              // numeral or 'cat'
-    int     g;
-    bool    fldPerPrb;
+    QString     runDir,     // path/run_gN/ (term slash)
+                runName,    // run          (undecorated)
+                t;          // numeral or 'cat'
+    QStringList altDirs;    // striped: other disks' path/run_gN/
+    int         g;
+    bool        fldPerPrb;
 public:
     DFRunTag() : g(-1), fldPerPrb(false)    {}
     DFRunTag( const QString &dataDir, const QString &runName );
@@ -22,6 +24,12 @@ public:
     QString run_g_t() const;
     QString brevname( int ip, const QString &suffix ) const;
     QString filename( int ip, const QString &suffix ) const;
+private:
+    QString filenameIn(
+        const QString   &dir,
+        int             ip,
+        const QString   &suffix ) const;
+public:
     bool operator==( const DFRunTag &rhs ) const
         {return t==rhs.t && runDir==rhs.runDir;}
 };
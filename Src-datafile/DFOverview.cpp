@@ -0,0 +1,316 @@
+
+#include "DFOverview.h"
+#include "DataFile.h"
+#include "DataFile_Helpers.h"
+#include "Util.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QRegExp>
+
+#include <string.h>
+
+
+#define DFOVW_MAGIC     0x4F4C4753  // 'SGLO'
+#define DFOVW_VERSION   1
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Fill level decimations and file offsets.
+//
+// Return total sidecar bytes.
+//
+static qint64 layout(
+    std::vector<quint64>    &off,
+    std::vector<int>        &dec,
+    int                     nC,
+    quint64                 scanCt )
+{
+    qint64  pos = 4*sizeof(quint32) + sizeof(quint64)
+                    + DFOVW_NLEVELS*sizeof(quint32);
+    int     d   = 1;
+
+    off.clear();
+    dec.clear();
+
+    for( int lev = 0; lev < DFOVW_NLEVELS; ++lev ) {
+
+        d *= DFOVW_STEP;
+
+        off.push_back( pos );
+        dec.push_back( d );
+
+        pos += qint64((scanCt + d - 1) / d) * 2 * nC * sizeof(qint16);
+    }
+
+    return pos;
+}
+
+
+// Reduce ntpts scans S to ceil(ntpts/dec) bins D.
+//
+static void binScans( qint16 *D, const qint16 *S, int ntpts, int nC, int dec )
+{
+    for( int it0 = 0; it0 < ntpts; it0 += dec, D += 2*nC ) {
+
+        int             itLim   = qMin( it0 + dec, ntpts );
+        const qint16    *s      = &S[it0*nC];
+
+        for( int ic = 0; ic < nC; ++ic )
+            D[2*ic] = D[2*ic+1] = s[ic];
+
+        for( int it = it0 + 1; it < itLim; ++it ) {
+
+            s += nC;
+
+            for( int ic = 0; ic < nC; ++ic ) {
+
+                qint16  v = s[ic];
+
+                if( v < D[2*ic] )
+                    D[2*ic] = v;
+
+                if( v > D[2*ic+1] )
+                    D[2*ic+1] = v;
+            }
+        }
+    }
+}
+
+
+// Reduce nb bins S to ceil(nb/step) bins D.
+//
+static void binBins( qint16 *D, const qint16 *S, int nb, int nC, int step )
+{
+    for( int ib0 = 0; ib0 < nb; ib0 += step, D += 2*nC ) {
+
+        int             ibLim   = qMin( ib0 + step, nb );
+        const qint16    *s      = &S[ib0*2*nC];
+
+        memcpy( D, s, 2*nC*sizeof(qint16) );
+
+        for( int ib = ib0 + 1; ib < ibLim; ++ib ) {
+
+            s += 2*nC;
+
+            for( int ic = 0; ic < nC; ++ic ) {
+
+                if( s[2*ic] < D[2*ic] )
+                    D[2*ic] = s[2*ic];
+
+                if( s[2*ic+1] > D[2*ic+1] )
+                    D[2*ic+1] = s[2*ic+1];
+            }
+        }
+    }
+}
+
+/* ---------------------------------------------------------------- */
+/* DFOverviewWorker ----------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Blocks span one top-level bin, so every level's bins
+// align with block boundaries.
+//
+bool DFOverviewWorker::build( DataFile *df, QFile &f )
+{
+    std::vector<quint64>    off;
+    std::vector<int>        dec;
+    int                     nC      = df->numChans();
+    quint64                 scanCt  = df->scanCount();
+    qint64                  size    = layout( off, dec, nC, scanCt );
+
+    if( !f.resize( size ) )
+        return false;
+
+    quint32 H[4]    = {DFOVW_MAGIC, DFOVW_VERSION,
+                        quint32(nC), DFOVW_NLEVELS};
+    quint64 ct      = scanCt;
+    quint32 D[DFOVW_NLEVELS];
+
+    for( int lev = 0; lev < DFOVW_NLEVELS; ++lev )
+        D[lev] = dec[lev];
+
+    if( f.write( (char*)H, sizeof(H) ) != sizeof(H)
+        || f.write( (char*)&ct, sizeof(ct) ) != sizeof(ct)
+        || f.write( (char*)D, sizeof(D) ) != sizeof(D) ) {
+
+        return false;
+    }
+
+    vec_i16 raw,
+            lvl[DFOVW_NLEVELS];
+    int     blk = dec[DFOVW_NLEVELS - 1];
+
+    for( quint64 s0 = 0; s0 < scanCt; s0 += blk ) {
+
+        if( pleaseStop )
+            return false;
+
+        int n = (int)qMin( quint64(blk), scanCt - s0 );
+
+        if( df->readScans( raw, s0, n, QBitArray() ) != n )
+            return false;
+
+        int nb = (n + dec[0] - 1) / dec[0];
+
+        lvl[0].resize( nb * 2 * nC );
+        binScans( &lvl[0][0], &raw[0], n, nC, dec[0] );
+
+        for( int lev = 0; lev < DFOVW_NLEVELS; ++lev ) {
+
+            if( lev ) {
+
+                int nIn = nb;
+
+                nb = (nIn + DFOVW_STEP - 1) / DFOVW_STEP;
+                lvl[lev].resize( nb * 2 * nC );
+                binBins( &lvl[lev][0], &lvl[lev-1][0], nIn, nC, DFOVW_STEP );
+            }
+
+            qint64  bytes = qint64(lvl[lev].size()) * sizeof(qint16);
+
+            if( !f.seek( off[lev] + (s0 / dec[lev]) * 2 * nC * sizeof(qint16) )
+                || f.write( (char*)&lvl[lev][0], bytes ) != bytes ) {
+
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/* ---------------------------------------------------------------- */
+/* DFOverview ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+DFOverview::DFOverview( const DataFile &df )
+    :   QObject(0), binName(df.binFileName()),
+        scanCt(df.scanCount()), worker(0),
+        nC(df.numChans()), _isReady(false)
+{
+    QRegExp re("bin$");
+    re.setCaseSensitivity( Qt::CaseInsensitive );
+
+    ovwName = QString(binName).replace( re, "ovw" );
+
+    QFileInfo   fiB( binName ),
+                fiO( ovwName );
+
+    if( fiO.exists() && fiO.lastModified() >= fiB.lastModified() && load() )
+        return;
+
+    worker  = new DFOverviewWorker( binName, ovwName );
+
+    DFSidecarWorker::start( worker, this );
+}
+
+
+DFOverview::~DFOverview()
+{
+    DFSidecarWorker::end( worker );
+}
+
+
+// Return deepest level whose bins fit in dwnSmp scans, else -1.
+//
+int DFOverview::level( int dwnSmp ) const
+{
+    if( !_isReady )
+        return -1;
+
+    for( int lev = nLevels() - 1; lev >= 0; --lev ) {
+
+        if( lvlDec[lev] <= dwnSmp )
+            return lev;
+    }
+
+    return -1;
+}
+
+
+// Read nBins bins from bin0 of level lev to dst,
+// nC (min, max) pairs each.
+//
+// Return count of bins read or -1 on failure.
+//
+qint64 DFOverview::read( vec_i16 &dst, int lev, quint64 bin0, quint64 nBins )
+{
+    if( !_isReady || lev < 0 || lev >= nLevels() )
+        return -1;
+
+    quint64 nb = (scanCt + lvlDec[lev] - 1) / lvlDec[lev];
+
+    if( bin0 >= nb )
+        return -1;
+
+    nBins = qMin( nBins, nb - bin0 );
+
+    qint64  binBytes = 2 * nC * sizeof(qint16);
+
+    dst.resize( nBins * 2 * nC );
+
+    if( !f.seek( lvlOff[lev] + bin0 * binBytes )
+        || f.read( (char*)&dst[0], nBins * binBytes ) != qint64(nBins) * binBytes ) {
+
+        dst.clear();
+        return -1;
+    }
+
+    return nBins;
+}
+
+
+void DFOverview::buildDone( bool ok )
+{
+    DFSidecarWorker::end( worker );
+
+    if( ok && load() )
+        emit ready();
+}
+
+
+// Open sidecar and check it matches the bin file.
+//
+bool DFOverview::load()
+{
+    f.setFileName( ovwName );
+
+    if( !f.open( QIODevice::ReadOnly ) )
+        return false;
+
+    quint32 H[4],
+            D[DFOVW_NLEVELS];
+    quint64 ct;
+    qint64  size = layout( lvlOff, lvlDec, nC, scanCt );
+
+    if( f.size() != size
+        || f.read( (char*)H, sizeof(H) ) != sizeof(H)
+        || f.read( (char*)&ct, sizeof(ct) ) != sizeof(ct)
+        || H[0] != DFOVW_MAGIC
+        || H[1] != DFOVW_VERSION
+        || int(H[2]) != nC
+        || H[3] != DFOVW_NLEVELS
+        || ct != scanCt
+        || f.read( (char*)D, sizeof(D) ) != sizeof(D) ) {
+
+        f.close();
+        return false;
+    }
+
+    for( int lev = 0; lev < DFOVW_NLEVELS; ++lev ) {
+
+        if( int(D[lev]) != lvlDec[lev] ) {
+            f.close();
+            return false;
+        }
+    }
+
+    _isReady = true;
+    return true;
+}
+
+
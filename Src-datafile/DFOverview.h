@@ -0,0 +1,86 @@
+#ifndef DFOVERVIEW_H
+#define DFOVERVIEW_H
+
+#include "SGLTypes.h"
+#include "DFSidecar.h"
+
+#include <QFile>
+
+class DataFile;
+
+// Levels decimate the file by DFOVW_STEP, DFOVW_STEP^2, ...
+#define DFOVW_STEP      32
+#define DFOVW_NLEVELS   3
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Worker builds the sidecar (see DFSidecarWorker).
+//
+class DFOverviewWorker : public DFSidecarWorker
+{
+public:
+    DFOverviewWorker( const QString &binName, const QString &ovwName )
+    :   DFSidecarWorker( binName, ovwName, "Overview", true )    {}
+
+protected:
+    virtual bool build( DataFile *df, QFile &f );
+};
+
+
+// Min/max overview pyramid of a bin file.
+//
+// Sidecar file <name>.ovw beside the bin holds, for each level
+// of decimation dec(lev) = DFOVW_STEP^(lev+1), and each bin of
+// dec scans, a (min, max) pair per channel, as qint16, channel
+// pairs of a bin adjacent (bin-major).
+//
+// Layout (little-endian):
+// - Header: 'SGLO', u32 version, u32 nChans, u32 nLevels,
+//           u64 scanCt, u32 dec[nLevels].
+// - Levels: ceil(scanCt/dec) bins each, in order.
+//
+// The sidecar is loaded if present and no older than the bin.
+// Otherwise it's built in the background (to a temp name, then
+// renamed) and ready() is emitted when it can be read.
+//
+class DFOverview : public QObject
+{
+    Q_OBJECT
+
+private:
+    QFile                   f;
+    std::vector<quint64>    lvlOff;
+    std::vector<int>        lvlDec;
+    QString                 binName,
+                            ovwName;
+    quint64                 scanCt;
+    DFSidecarWorker         *worker;
+    int                     nC;
+    bool                    _isReady;
+
+public:
+    DFOverview( const DataFile &df );
+    virtual ~DFOverview();
+
+    bool isReady() const    {return _isReady;}
+    int nLevels() const     {return (int)lvlDec.size();}
+    int dec( int lev ) const    {return lvlDec[lev];}
+    int level( int dwnSmp ) const;
+
+    qint64 read( vec_i16 &dst, int lev, quint64 bin0, quint64 nBins );
+
+signals:
+    void ready();
+
+private slots:
+    void buildDone( bool ok );
+
+private:
+    bool load();
+};
+
+#endif  // DFOVERVIEW_H
+
+
@@ -0,0 +1,355 @@
+
+#include "DFReadCache.h"
+#include "DataFile.h"
+#include "DataFile_Helpers.h"
+#include "DFSequence.h"
+#include "DFTranspose.h"
+#include "Subset.h"
+#include "Util.h"
+
+#include <QThread>
+
+#include <string.h>
+
+
+// Open caches, for sharing DFRC_MAXBYTES.
+static QMutex               regMtx;
+static QList<DFReadCache*>  regList;
+
+/* ---------------------------------------------------------------- */
+/* DFReadCacheWorker ---------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void DFReadCacheWorker::run()
+{
+    QString     error;
+    DataFile    *df = 0;
+    DFSeqReader *sr = 0;
+    vec_i16     D;
+
+    if( C->seq )
+        sr = new DFSeqReader( *C->seq );
+    else if( !(df = DFOpenForRead( C->binName, error )) )
+        Warning() << "File prefetch off: " << error;
+
+    for(;;) {
+
+        C->blkMtx.lock();
+
+            while( !C->pleaseStop && C->wanted.isEmpty() )
+                C->wantCond.wait( &C->blkMtx );
+
+            if( C->pleaseStop ) {
+                C->blkMtx.unlock();
+                break;
+            }
+
+            quint64 ib      = C->wanted.takeFirst();
+            bool    have    = C->blocks.contains( ib );
+
+        C->blkMtx.unlock();
+
+        if( have || !(df || sr) )
+            continue;
+
+        quint64 s0 = ib * C->blkScans;
+
+        if( (sr ? sr->readScans( D, s0, C->blkScans, QBitArray() )
+                : df->readScans( D, s0, C->blkScans, QBitArray() )) > 0 ) {
+
+            C->insert( ib, D );
+        }
+    }
+
+    if( df )
+        delete df;
+
+    if( sr )
+        delete sr;
+
+    emit finished();
+}
+
+/* ---------------------------------------------------------------- */
+/* DFReadCache ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+DFReadCache::DFReadCache( const DataFile *df, const DFSequence *seq )
+    :   rdf(0), seq(seq), rseq(0), binName(df->binFileName()),
+        scanCt(seq ? seq->vScans() : df->scanCount()),
+        tUse(0), nC(df->numChans()), maxBlocks(4), pleaseStop(false)
+{
+    QString error;
+    int     bytesPerScan = nC * sizeof(qint16);
+
+    if( seq )
+        rseq = new DFSeqReader( *seq );
+    else if( !(rdf = DFOpenForRead( binName, error )) )
+        Error() << "File cache: " << error;
+
+    blkScans    = qMax( 1, DFRC_BLKBYTES / bytesPerScan );
+    blkBytes    = qint64(blkScans) * bytesPerScan;
+
+    regMtx.lock();
+        regList.push_back( this );
+        rebudget();
+    regMtx.unlock();
+
+    thread = new QThread;
+
+    DFReadCacheWorker   *worker = new DFReadCacheWorker( this );
+
+    worker->moveToThread( thread );
+
+    Connect( thread, SIGNAL(started()), worker, SLOT(run()) );
+    Connect( worker, SIGNAL(finished()), worker, SLOT(deleteLater()) );
+    Connect( worker, SIGNAL(destroyed()), thread, SLOT(quit()), Qt::DirectConnection );
+
+    thread->start( QThread::LowPriority );
+}
+
+
+// worker object auto-deleted asynchronously
+// thread object manually deleted synchronously (so we can call wait())
+//
+DFReadCache::~DFReadCache()
+{
+    regMtx.lock();
+        regList.removeOne( this );
+        rebudget();
+    regMtx.unlock();
+
+    blkMtx.lock();
+        pleaseStop = true;
+        wantCond.wakeAll();
+    blkMtx.unlock();
+
+    thread->wait();
+    delete thread;
+
+    if( rdf )
+        delete rdf;
+
+    if( rseq )
+        delete rseq;
+
+    qDeleteAll( blocks );
+}
+
+
+// Same contract as DataFile::readScans.
+//
+qint64 DFReadCache::readScans(
+    vec_i16         &dst,
+    quint64         scan0,
+    quint64         num2read,
+    const QBitArray &keepBits )
+{
+    if( !(rdf || rseq) || scan0 >= scanCt )
+        return -1;
+
+    num2read = qMin( num2read, scanCt - scan0 );
+
+    QVector<uint>   runs;
+    vec_i16         D;
+    int             nKeep = nC;
+
+    if( keepBits.size() && keepBits.count( true ) < nC )
+        nKeep = Subset::bits2Runs( runs, keepBits );
+
+// Few channels read straight from channel-major sidecar
+
+    if( nKeep * DFTPS_FEWFRAC <= nC && rdf && rdf->hasTranspose() )
+        return rdf->readScans( dst, scan0, num2read, keepBits );
+
+    dst.resize( num2read * nKeep );
+
+    qint16  *out    = &dst[0];
+    quint64 nDone   = 0;
+
+    while( nDone < num2read ) {
+
+        quint64 s   = scan0 + nDone,
+                ib  = s / blkScans;
+        int     it0 = int(s - ib * blkScans);
+
+        for(;;) {
+
+            QMutexLocker    ml( &blkMtx );
+
+            QMap<quint64,Block*>::iterator  it = blocks.find( ib );
+
+            if( it != blocks.end() ) {
+
+                Block   *B      = it.value();
+                qint64  nHave   = qint64(B->D.size() / nC) - it0;
+
+                if( nHave <= 0 ) {
+                    dst.clear();
+                    return -1;
+                }
+
+                int n = (int)qMin( quint64(nHave), num2read - nDone );
+
+                const qint16    *S = &B->D[it0 * nC];
+
+                if( nKeep < nC )
+                    out = Subset::subsetRuns( out, S, n, runs, nC );
+                else {
+                    memcpy( out, S, n * nC * sizeof(qint16) );
+                    out += n * nC;
+                }
+
+                B->tUse = ++tUse;
+                nDone  += n;
+                break;
+            }
+
+            ml.unlock();
+
+            quint64 s0 = ib * blkScans;
+
+            if( (rseq ? rseq->readScans( D, s0, blkScans, QBitArray() )
+                    : rdf->readScans( D, s0, blkScans, QBitArray() )) <= 0 ) {
+                dst.clear();
+                return -1;
+            }
+
+            insert( ib, D );
+        }
+    }
+
+    return num2read;
+}
+
+
+// Use channel-major sidecar built since opening.
+// Call only while no readScans() is in progress.
+//
+bool DFReadCache::openTranspose()
+{
+    return rdf && rdf->openTranspose();
+}
+
+
+// View [pos, pos+span) was just shown, moving in direction
+// dir {-1, 0=unknown, +1}. Queue the next span that way
+// (forward if unknown), replacing any older requests.
+//
+void DFReadCache::prefetch( quint64 pos, quint64 span, int dir )
+{
+    if( !span || pos >= scanCt )
+        return;
+
+    quint64 s0, sLim;
+
+    if( dir < 0 ) {
+        s0      = (pos > span ? pos - span : 0);
+        sLim    = pos;
+    }
+    else {
+        s0      = qMin( pos + span, scanCt );
+        sLim    = qMin( pos + 2 * span, scanCt );
+    }
+
+    if( sLim <= s0 )
+        return;
+
+    QMutexLocker    ml( &blkMtx );
+
+    // Leave room for the current view
+
+    quint64 ib0     = s0 / blkScans,
+            ibLim   = qMin( (sLim + blkScans - 1) / blkScans,
+                        ib0 + maxBlocks / 2 );
+
+    wanted.clear();
+
+    if( dir < 0 ) {
+
+        for( quint64 ib = ibLim; ib > ib0; --ib ) {
+
+            if( !blocks.contains( ib - 1 ) )
+                wanted.push_back( ib - 1 );
+        }
+    }
+    else {
+
+        for( quint64 ib = ib0; ib < ibLim; ++ib ) {
+
+            if( !blocks.contains( ib ) )
+                wanted.push_back( ib );
+        }
+    }
+
+    if( !wanted.isEmpty() )
+        wantCond.wakeAll();
+}
+
+
+// Add block ib (D swapped out), evicting least recently used.
+//
+void DFReadCache::insert( quint64 ib, vec_i16 &D )
+{
+    QMutexLocker    ml( &blkMtx );
+
+    if( blocks.contains( ib ) )
+        return;
+
+    Block   *B = new Block;
+
+    B->D.swap( D );
+    B->tUse     = ++tUse;
+    blocks[ib]  = B;
+
+    trim( ib );
+}
+
+
+// Evict least recently used blocks, other than ibKeep,
+// down to maxBlocks. Caller holds blkMtx.
+//
+void DFReadCache::trim( quint64 ibKeep )
+{
+    while( blocks.size() > maxBlocks ) {
+
+        QMap<quint64,Block*>::iterator  it      = blocks.begin(),
+                                        end     = blocks.end(),
+                                        iOld    = end;
+
+        for( ; it != end; ++it ) {
+
+            if( it.key() != ibKeep
+                && (iOld == end || it.value()->tUse < iOld.value()->tUse) ) {
+
+                iOld = it;
+            }
+        }
+
+        if( iOld == end )
+            break;
+
+        delete iOld.value();
+        blocks.erase( iOld );
+    }
+}
+
+
+// Split DFRC_MAXBYTES over the open caches, shrinking any
+// now over budget. Caller holds regMtx.
+//
+void DFReadCache::rebudget()
+{
+    int n = regList.size();
+
+    for( int i = 0; i < n; ++i ) {
+
+        DFReadCache     *C = regList[i];
+        QMutexLocker    ml( &C->blkMtx );
+
+        C->maxBlocks = (int)qMax( qint64(4), DFRC_MAXBYTES / n / C->blkBytes );
+        C->trim( quint64(-1) );
+    }
+}
+
+
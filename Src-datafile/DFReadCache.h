@@ -0,0 +1,117 @@
+#ifndef DFREADCACHE_H
+#define DFREADCACHE_H
+
+#include "SGLTypes.h"
+
+#include <QObject>
+#include <QBitArray>
+#include <QMap>
+#include <QMutex>
+#include <QWaitCondition>
+
+class DataFile;
+class DFReadCache;
+class DFSequence;
+class DFSeqReader;
+
+class QThread;
+
+// Target block size, and capacity shared by all open caches.
+#define DFRC_BLKBYTES   (4*1024*1024)
+#define DFRC_MAXBYTES   (512LL*1024*1024)
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Prefetcher reads through its own DataFile, so it never moves
+// the file position of the caller's.
+//
+class DFReadCacheWorker : public QObject
+{
+    Q_OBJECT
+
+private:
+    DFReadCache *C;
+
+public:
+    DFReadCacheWorker( DFReadCache *C ) : QObject(0), C(C) {}
+
+signals:
+    void finished();
+
+public slots:
+    void run();
+};
+
+
+// LRU cache of whole-scan file blocks in front of readScans,
+// for interactive readers like the file viewer.
+//
+// readScans() serves from cached blocks, reading any that are
+// missing synchronously through a private DataFile, so it can
+// be called from any one thread, apart from the caller's uses
+// of its own file. prefetch()
+// tells a background reader what's been viewed; it then loads
+// the neighboring span in the direction of motion, so stepping
+// through a file costs render time rather than disk latency.
+//
+// DFRC_MAXBYTES is split evenly over the open caches (linked
+// AP/LF/NI viewers), so opening more files doesn't multiply
+// memory use.
+//
+// Given a sequence (the viewer's joined trigger files), scans
+// are those of the virtual file, read through DFSeqReaders;
+// the sequence must outlive the cache.
+//
+class DFReadCache
+{
+    friend class DFReadCacheWorker;
+
+private:
+    struct Block {
+        vec_i16 D;
+        quint64 tUse;
+    };
+
+    DataFile                *rdf;       // synchronous reads
+    const DFSequence        *seq;
+    DFSeqReader             *rseq;      // synchronous, if seq
+    QString                 binName;
+    QMap<quint64,Block*>    blocks;     // index -> data
+    QList<quint64>          wanted;     // prefetch queue
+    mutable QMutex          blkMtx;
+    QWaitCondition          wantCond;
+    QThread                 *thread;
+    quint64                 scanCt,
+                            tUse;
+    qint64                  blkBytes;
+    int                     nC,
+                            blkScans,
+                            maxBlocks;  // blkMtx
+    bool                    pleaseStop;
+
+public:
+    DFReadCache( const DataFile *df, const DFSequence *seq = 0 );
+    virtual ~DFReadCache();
+
+    qint64 readScans(
+        vec_i16         &dst,
+        quint64         scan0,
+        quint64         num2read,
+        const QBitArray &keepBits );
+
+    void prefetch( quint64 pos, quint64 span, int dir );
+
+    bool openTranspose();
+
+private:
+    void insert( quint64 ib, vec_i16 &D );
+    void trim( quint64 ibKeep );
+
+    static void rebudget();
+};
+
+#endif  // DFREADCACHE_H
+
+
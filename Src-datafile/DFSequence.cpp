@@ -0,0 +1,297 @@
+
+#include "DFSequence.h"
+#include "DFDirIndex.h"
+#include "DFEpochs.h"
+#include "DFName.h"
+#include "DataFile.h"
+#include "DataFile_Helpers.h"
+#include "KVParams.h"
+#include "Util.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QRegExp>
+
+#include <algorithm>
+#include <string.h>
+
+
+/* ---------------------------------------------------------------- */
+/* DFSequence ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Gather df's sibling trigger files from its directory listing
+// and lay them out. Return false if there are no siblings.
+//
+bool DFSequence::build( QString &error, const DataFile &df )
+{
+    vF.clear();
+    _vScans = 0;
+    nC      = df.numChans();
+
+    QFileInfo   fi( df.binFileName() );
+    QRegExp     re("^(.+_g\\d+_t)(\\d+)(\\..+)$");
+
+    re.setCaseSensitivity( Qt::CaseInsensitive );
+
+    if( !re.exactMatch( fi.fileName() ) ) {
+        error = QString("Not a numbered trigger file '%1'.").arg( fi.fileName() );
+        return false;
+    }
+
+    QRegExp sib(
+            QString("^%1(\\d+)%2$")
+            .arg( QRegExp::escape( re.cap(1) ) )
+            .arg( QRegExp::escape( re.cap(3) ) ) );
+
+    sib.setCaseSensitivity( Qt::CaseInsensitive );
+
+    QStringList L = DFDirIndex::files( fi.absolutePath() );
+
+    foreach( const QString &bin, L ) {
+
+        if( !sib.exactMatch( QFileInfo( bin ).fileName() ) )
+            continue;
+
+        KVParams    kvp;
+
+        if( !DFDirIndex::meta( kvp, DFName::forceMetaSuffix( bin ) ) )
+            continue;
+
+        KVParams::const_iterator    it = kvp.find( "fileSizeBytes" );
+
+        if( it == kvp.end() || kvp["nSavedChans"].toInt() != nC )
+            continue;
+
+        DFSeqFile   F;
+
+        F.binName   = bin;
+        F.nScans    = it.value().toULongLong() / (sizeof(qint16) * nC);
+        F.firstCt   = kvp["firstSample"].toULongLong();
+        F.t         = sib.cap(1).toInt();
+
+        if( F.nScans )
+            vF.push_back( F );
+    }
+
+    if( vF.size() < 2 ) {
+
+        error =
+            QString("No other trigger files beside '%1'.")
+            .arg( fi.fileName() );
+
+        vF.clear();
+        return false;
+    }
+
+    epochStarts( df );
+    std::sort( vF.begin(), vF.end() );
+
+// Lay out
+
+    quint64 maxGap  = quint64(DFSEQ_GAPSECS * df.samplingRateHz()),
+            endCt   = 0;
+
+    for( int i = 0, n = vF.size(); i < n; ++i ) {
+
+        DFSeqFile   &F = vF[i];
+
+        if( i ) {
+            F.vPos = _vScans
+                        + qMin( maxGap,
+                            F.firstCt > endCt ? F.firstCt - endCt : 0 );
+        }
+
+        endCt   = F.firstCt + F.nScans;
+        _vScans = F.vPos + F.nScans;
+    }
+
+    return true;
+}
+
+
+// Return index of last file starting at or before v;
+// v may lie in the gap after it.
+//
+int DFSequence::fileAt( quint64 v ) const
+{
+    int lo = 0,
+        hi = vF.size() - 1;
+
+    while( lo < hi ) {
+
+        int mid = (lo + hi + 1) / 2;
+
+        if( vF[mid].vPos <= v )
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    return lo;
+}
+
+
+// Take start counts from the run's epoch index, the earliest
+// epoch beginning at file sample zero for each file. The index
+// is in the main data directory: the run folder or its parent.
+// Index counts for imec are at AP rate; LF is 1/12 of that.
+//
+void DFSequence::epochStarts( const DataFile &df )
+{
+    DFRunTag    tag( df.binFileName() );
+    QDir        D( tag.runDir );
+    QString     path = DFEpochs::epochsName( D.absolutePath(), tag.runName );
+
+    if( !QFileInfo( path ).exists() && D.cdUp() )
+        path = DFEpochs::epochsName( D.absolutePath(), tag.runName );
+
+    QVector<int>        ips;
+    QVector<DFEpochRec> vR;
+
+    if( !DFEpochs::load( ips, vR, path ) )
+        return;
+
+    int ip,
+        type    = DFName::typeAndIP( ip, df.binFileName(), 0 ),
+        is      = ips.indexOf( type == 2 ? -1 : ip ),
+        div     = (type == 1 ? 12 : 1);
+
+    if( is < 0 )
+        return;
+
+    for( int i = 0, n = vF.size(); i < n; ++i ) {
+
+        quint64 ct      = 0;
+        bool    found   = false;
+
+        foreach( const DFEpochRec &R, vR ) {
+
+            if( R.g != tag.g || R.t != vF[i].t || is >= R.S.size() )
+                continue;
+
+            const DFEpochSpan   &E = R.S[is];
+
+            if( E.limCt > E.firstCt
+                && !E.fileCt
+                && (!found || E.firstCt < ct) ) {
+
+                ct      = E.firstCt;
+                found   = true;
+            }
+        }
+
+        if( found )
+            vF[i].firstCt = ct / div;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+/* DFSeqReader ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+DFSeqReader::~DFSeqReader()
+{
+    for( int i = 0, n = open.size(); i < n; ++i )
+        delete open[i].df;
+}
+
+
+// Same contract as DataFile::readScans; gap scans are zero.
+//
+qint64 DFSeqReader::readScans(
+    vec_i16         &dst,
+    quint64         scan0,
+    quint64         num2read,
+    const QBitArray &keepBits )
+{
+    if( scan0 >= S.vScans() )
+        return -1;
+
+    num2read = qMin( num2read, S.vScans() - scan0 );
+
+    int     nKeep   = (keepBits.size() ? keepBits.count( true ) : S.numChans());
+    quint64 nDone   = 0;
+
+    dst.assign( num2read * nKeep, 0 );
+
+    for( int i = S.fileAt( scan0 ), nF = S.nFiles();
+        i < nF && nDone < num2read; ++i ) {
+
+        const DFSeqFile &F = S.file( i );
+        quint64         v  = scan0 + nDone;
+
+        // Gap before F stays zero
+
+        if( v < F.vPos ) {
+
+            nDone = qMin( num2read, F.vPos - scan0 );
+
+            if( nDone >= num2read )
+                break;
+
+            v = F.vPos;
+        }
+
+        if( v >= F.vPos + F.nScans )
+            continue;
+
+        quint64     n   = qMin( num2read - nDone, F.vPos + F.nScans - v );
+        DataFile    *df = member( i );
+
+        if( !df || df->readScans( part, v - F.vPos, n, keepBits ) != qint64(n) ) {
+            dst.clear();
+            return -1;
+        }
+
+        memcpy( &dst[nDone * nKeep], &part[0], n * nKeep * sizeof(qint16) );
+        nDone += n;
+    }
+
+    return num2read;
+}
+
+
+// Return open file i, opening it in place of the least
+// recently used if DFSEQ_MAXOPEN are already open.
+//
+DataFile *DFSeqReader::member( int i )
+{
+    int iOld = -1;
+
+    for( int k = 0, n = open.size(); k < n; ++k ) {
+
+        if( open[k].i == i ) {
+            open[k].tUse = ++tUse;
+            return open[k].df;
+        }
+
+        if( iOld < 0 || open[k].tUse < open[iOld].tUse )
+            iOld = k;
+    }
+
+    QString     error;
+    DataFile    *df = DFOpenForRead( S.file( i ).binName, error );
+
+    if( !df ) {
+        Warning() << "Joined file read: " << error;
+        return 0;
+    }
+
+    Member  M;
+
+    M.df    = df;
+    M.tUse  = ++tUse;
+    M.i     = i;
+
+    if( (int)open.size() >= DFSEQ_MAXOPEN ) {
+        delete open[iOld].df;
+        open[iOld] = M;
+    }
+    else
+        open.push_back( M );
+
+    return df;
+}
+
+
@@ -0,0 +1,107 @@
+#ifndef DFSEQUENCE_H
+#define DFSEQUENCE_H
+
+#include "SGLTypes.h"
+
+#include <QBitArray>
+#include <QString>
+
+class DataFile;
+
+// Gaps between trigger files are shown up to this long.
+#define DFSEQ_GAPSECS   1.0
+
+// Member files a reader holds open at once.
+#define DFSEQ_MAXOPEN   3
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// One trigger file of a sequence, placed at vPos on the
+// virtual timeline. firstCt is its first sample since run
+// start, in the file's own sample rate.
+//
+struct DFSeqFile {
+    QString binName;
+    quint64 vPos,
+            nScans,
+            firstCt;
+    int     t;
+
+    DFSeqFile() : vPos(0), nScans(0), firstCt(0), t(-1)    {}
+    bool operator<( const DFSeqFile &rhs ) const
+        {return firstCt < rhs.firstCt;}
+};
+
+
+// The _t<N> files of one stream of a gate (run_g<g>), laid end
+// to end in start order as one virtual file. The gap before
+// each file is its distance from the previous file's end, up
+// to DFSEQ_GAPSECS; gap scans read as zeros.
+//
+// Start counts come from the run's epoch index if it can be
+// found, else from each file's firstSample meta item. Files
+// still being written (no fileSizeBytes) or with a different
+// channel count are left out.
+//
+class DFSequence
+{
+private:
+    std::vector<DFSeqFile>  vF;
+    quint64                 _vScans;
+    int                     nC;
+
+public:
+    DFSequence() : _vScans(0), nC(0)    {}
+
+    bool build( QString &error, const DataFile &df );
+
+    int nFiles() const                      {return (int)vF.size();}
+    const DFSeqFile &file( int i ) const    {return vF[i];}
+    quint64 vScans() const                  {return _vScans;}
+    int numChans() const                    {return nC;}
+
+    int fileAt( quint64 v ) const;
+
+private:
+    void epochStarts( const DataFile &df );
+};
+
+
+// Reads a sequence like DataFile::readScans, across file
+// boundaries, opening member files as needed and keeping the
+// DFSEQ_MAXOPEN most recently used. Not thread-safe; each
+// reading thread uses its own.
+//
+class DFSeqReader
+{
+private:
+    struct Member {
+        DataFile    *df;
+        quint64     tUse;
+        int         i;
+    };
+
+    const DFSequence    &S;
+    std::vector<Member> open;
+    vec_i16             part;
+    quint64             tUse;
+
+public:
+    DFSeqReader( const DFSequence &S ) : S(S), tUse(0)    {}
+    virtual ~DFSeqReader();
+
+    qint64 readScans(
+        vec_i16         &dst,
+        quint64         scan0,
+        quint64         num2read,
+        const QBitArray &keepBits );
+
+private:
+    DataFile *member( int i );
+};
+
+#endif  // DFSEQUENCE_H
+
+
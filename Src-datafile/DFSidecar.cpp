@@ -0,0 +1,73 @@
+
+#include "DFSidecar.h"
+#include "DataFile.h"
+#include "DataFile_Helpers.h"
+#include "Util.h"
+
+#include <QFile>
+
+
+/* ---------------------------------------------------------------- */
+/* DFSidecarWorker ------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+void DFSidecarWorker::start( DFSidecarWorker *worker, QObject *owner )
+{
+    Connect( worker, SIGNAL(finished(bool)), owner, SLOT(buildDone(bool)) );
+
+    TaskPool::submit( worker, TaskPool::Background, false );
+}
+
+
+// Task deleted here, after wait() (which runs it here if still
+// queued); stopped first so a pending build ends quickly.
+//
+void DFSidecarWorker::end( DFSidecarWorker* &worker )
+{
+    if( !worker )
+        return;
+
+    worker->stop();
+    worker->wait();
+
+    delete worker;
+    worker = 0;
+}
+
+
+void DFSidecarWorker::run()
+{
+    QString     tmpName = outName + ".tmp",
+                error;
+    DataFile    *df     = 0;
+
+    if( openBin )
+        df = DFOpenForRead( binName, error );
+
+    QFile   f( tmpName );
+    bool    ok = (df || !openBin)
+                && f.open( QIODevice::ReadWrite | QIODevice::Truncate )
+                && build( df, f );
+
+    f.close();
+
+    if( df )
+        delete df;
+
+    if( ok ) {
+        QFile::remove( outName );
+        ok = QFile::rename( tmpName, outName );
+    }
+
+    if( !ok ) {
+
+        QFile::remove( tmpName );
+
+        if( !pleaseStop )
+            Warning() << what << " not built for [" << binName << "].";
+    }
+
+    emit finished( ok );
+}
+
+
@@ -0,0 +1,67 @@
+#ifndef DFSIDECAR_H
+#define DFSIDECAR_H
+
+#include "TaskPool.h"
+
+#include <QObject>
+
+#include <atomic>
+
+class DataFile;
+class QFile;
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Base of the bin file sidecar builders (events, activity,
+// overview, channel-major). Each adds only build(), which fills
+// the open temp file <outName>.tmp; run() then renames it over
+// outName and emits finished().
+//
+// Runs as a TaskPool Background task. With openBin, build() reads
+// through its own DataFile so the viewer's file position isn't
+// shared; otherwise df is 0.
+//
+// Owners start() a worker, with buildDone(bool) as the slot, and
+// end() it from that slot and their dtor.
+//
+class DFSidecarWorker : public QObject, public PoolTask
+{
+    Q_OBJECT
+
+protected:
+    QString             binName,
+                        outName;
+    const char          *what;
+    std::atomic<bool>   pleaseStop;
+    bool                openBin;
+
+public:
+    DFSidecarWorker(
+        const QString   &binName,
+        const QString   &outName,
+        const char      *what,
+        bool            openBin )
+    :   QObject(0), binName(binName), outName(outName),
+        what(what), pleaseStop(false), openBin(openBin) {}
+    virtual ~DFSidecarWorker()  {}
+
+    void stop()     {pleaseStop = true;}
+
+    static void start( DFSidecarWorker *worker, QObject *owner );
+    static void end( DFSidecarWorker* &worker );
+
+signals:
+    void finished( bool ok );
+
+public slots:
+    void run();
+
+protected:
+    virtual bool build( DataFile *df, QFile &f ) = 0;
+};
+
+#endif  // DFSIDECAR_H
+
+
@@ -0,0 +1,100 @@
+
+#include "DFStamps.h"
+
+#include <QFile>
+#include <QRegExp>
+
+#include <math.h>
+
+
+#define DFSTAMP_MAGIC   0x544C4753  // 'SGLT'
+#define DFSTAMP_VERSION 1
+
+/* ---------------------------------------------------------------- */
+/* DFStamps ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void DFStamps::reset()
+{
+    R.clear();
+    lastScan    = 0;
+    perScan     = 0;
+    lastBrk     = false;
+}
+
+
+// Offer the stamp of a block starting at file scan; blocks
+// at or before one already offered are ignored.
+//
+// The tick rate is learned from the first two blocks and then
+// from each periodic record. Two breaks in a row relearn it,
+// so a bad first estimate costs a few records, not all.
+//
+void DFStamps::add( qint64 scan, quint32 hw, double t )
+{
+    if( !R.empty() && scan <= lastScan )
+        return;
+
+    lastScan = scan;
+
+    Rec N;
+    N.scan  = scan;
+    N.hw    = hw;
+    N.pad   = 0;
+    N.t     = t;
+
+    if( R.empty() ) {
+        R.push_back( N );
+        return;
+    }
+
+    const Rec   &K = R.back();
+
+    qint64  dS = scan - K.scan;
+    double  dT = quint32(hw - K.hw);    // modulo wrap
+
+    if( R.size() == 1 ) {
+        perScan = dT / dS;
+        R.push_back( N );
+        return;
+    }
+
+    bool    brk = fabs( dT - perScan * dS ) > DFSTAMP_TOLTICKS;
+
+    if( !brk && t - K.t < DFSTAMP_SECS )
+        return;
+
+    if( !brk || lastBrk )
+        perScan = dT / dS;
+
+    lastBrk = brk;
+    R.push_back( N );
+}
+
+
+bool DFStamps::save( const QString &binName ) const
+{
+    if( R.empty() )
+        return true;
+
+    QFile   f( sidecarName( binName ) );
+    quint32 H[4] = {DFSTAMP_MAGIC, DFSTAMP_VERSION, quint32(R.size()), 0};
+    qint64  bytes = R.size() * sizeof(Rec);
+
+    if( !f.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+        return false;
+
+    return f.write( (const char*)H, sizeof(H) ) == sizeof(H)
+            && f.write( (const char*)&R[0], bytes ) == bytes;
+}
+
+
+QString DFStamps::sidecarName( const QString &binName )
+{
+    QRegExp re("bin$");
+    re.setCaseSensitivity( Qt::CaseInsensitive );
+
+    return QString(binName).replace( re, "tsi" );
+}
+
+
@@ -0,0 +1,66 @@
+#ifndef DFSTAMPS_H
+#define DFSTAMPS_H
+
+#include <QString>
+
+#include <vector>
+
+// Hardware ticks a block's stamp may stray from the line
+// through the kept records before it's logged as a break.
+#define DFSTAMP_TOLTICKS    4
+
+// Most seconds (app time) between kept records.
+#define DFSTAMP_SECS        1.0
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Index of a bin file's fetch blocks against the hardware clock
+// that stamped them, for offline alignment and for finding
+// hardware gaps without rescanning data.
+//
+// Sidecar file <name>.tsi beside the bin (little-endian):
+// - Header: 'SGLT', u32 version, u32 nRecs, u32 0.
+// - Per record: i64 scan (file-relative; first may be < 0 if
+//               the block began before the file), u32 stamp,
+//               u32 0, f64 app time the block was enqueued.
+//
+// Only blocks that break the linear stamp progression of the
+// kept records, and one per DFSTAMP_SECS, are kept. Scans and
+// stamps between two records are linear unless the later one
+// is a break. A file with no records gets no sidecar.
+//
+// DataFile writes the sidecar with the meta file at close.
+//
+class DFStamps
+{
+private:
+    struct Rec {
+        qint64  scan;
+        quint32 hw,
+                pad;
+        double  t;
+    };
+
+    std::vector<Rec>    R;
+    qint64              lastScan;
+    double              perScan;    // ticks per scan, learned
+    bool                lastBrk;    // newest record is a break
+
+public:
+    DFStamps()  {reset();}
+
+    void reset();
+    void add( qint64 scan, quint32 hw, double t );
+
+    int nRecs() const   {return int(R.size());}
+
+    bool save( const QString &binName ) const;
+
+    static QString sidecarName( const QString &binName );
+};
+
+#endif  // DFSTAMPS_H
+
+
@@ -0,0 +1,326 @@
+
+#include "DFTranspose.h"
+#include "DataFile.h"
+#include "DataFile_Helpers.h"
+#include "Util.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QRegExp>
+
+
+#define DFTPS_MAGIC     0x544C4753  // 'SGLT'
+#define DFTPS_VERSION   1
+
+// Transpose run height (scans).
+#define DFTPS_RUN       64
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+static int tileScansFor( double srate )
+{
+    return qMax( 1, int(srate * DFTPS_TILESECS) );
+}
+
+
+// Fill tile offsets.
+//
+// Return total sidecar bytes.
+//
+static qint64 layout(
+    std::vector<quint64>    &index,
+    int                     nC,
+    int                     tileScans,
+    quint64                 scanCt )
+{
+    quint64 nT  = (scanCt + tileScans - 1) / tileScans;
+    int     nG  = (nC + DFTPS_GRPCHANS - 1) / DFTPS_GRPCHANS;
+    qint64  pos = 5*sizeof(quint32) + sizeof(quint64)
+                    + nT * nG * sizeof(quint64);
+
+    index.clear();
+
+    for( quint64 t = 0; t < nT; ++t ) {
+
+        qint64  nt = qMin( quint64(tileScans), scanCt - t * tileScans );
+
+        for( int g = 0; g < nG; ++g ) {
+
+            int nInG = qMin( DFTPS_GRPCHANS, nC - g * DFTPS_GRPCHANS );
+
+            index.push_back( pos );
+            pos += nInG * nt * sizeof(qint16);
+        }
+    }
+
+    return pos;
+}
+
+/* ---------------------------------------------------------------- */
+/* DFTpsWorker ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Tiles are written in file order, one time slice per read.
+//
+bool DFTpsWorker::build( DataFile *df, QFile &f )
+{
+    std::vector<quint64>    index;
+    int                     nC          = df->numChans(),
+                            tileScans   = tileScansFor( df->samplingRateHz() ),
+                            nG          = (nC + DFTPS_GRPCHANS - 1) / DFTPS_GRPCHANS;
+    quint64                 scanCt      = df->scanCount();
+    qint64                  size        = layout( index, nC, tileScans, scanCt );
+
+    if( !f.resize( size ) )
+        return false;
+
+    quint32 H[4]    = {DFTPS_MAGIC, DFTPS_VERSION,
+                        quint32(nC), quint32(tileScans)};
+    quint64 ct      = scanCt;
+    quint32 G       = DFTPS_GRPCHANS;
+    qint64  iBytes  = qint64(index.size()) * sizeof(quint64);
+
+    if( f.write( (char*)H, sizeof(H) ) != sizeof(H)
+        || f.write( (char*)&ct, sizeof(ct) ) != sizeof(ct)
+        || f.write( (char*)&G, sizeof(G) ) != sizeof(G)
+        || (iBytes && f.write( (char*)&index[0], iBytes ) != iBytes) ) {
+
+        return false;
+    }
+
+    vec_i16 raw,
+            col;
+
+    for( quint64 s0 = 0; s0 < scanCt; s0 += tileScans ) {
+
+        if( pleaseStop )
+            return false;
+
+        int nt = (int)qMin( quint64(tileScans), scanCt - s0 );
+
+        if( df->readScans( raw, s0, nt, QBitArray() ) != nt )
+            return false;
+
+        for( int g = 0; g < nG; ++g ) {
+
+            int c0      = g * DFTPS_GRPCHANS,
+                nInG    = qMin( DFTPS_GRPCHANS, nC - c0 );
+
+            // Channel-major copy, in runs of DFTPS_RUN scans to
+            // keep both source rows and destination columns in cache
+
+            col.resize( nInG * nt );
+
+            for( int it0 = 0; it0 < nt; it0 += DFTPS_RUN ) {
+
+                int itLim = qMin( it0 + DFTPS_RUN, nt );
+
+                for( int ic = 0; ic < nInG; ++ic ) {
+
+                    const qint16    *S = &raw[it0*nC + c0 + ic];
+                    qint16          *D = &col[ic*nt];
+
+                    for( int it = it0; it < itLim; ++it, S += nC )
+                        D[it] = *S;
+                }
+            }
+
+            qint64  bytes = qint64(col.size()) * sizeof(qint16);
+
+            if( f.write( (char*)&col[0], bytes ) != bytes )
+                return false;
+        }
+    }
+
+    return true;
+}
+
+/* ---------------------------------------------------------------- */
+/* DFTpsReader ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+QString DFTpsReader::tpsName( const QString &binName )
+{
+    QRegExp re("bin$");
+    re.setCaseSensitivity( Qt::CaseInsensitive );
+
+    return QString(binName).replace( re, "tps" );
+}
+
+
+// Open sidecar if present, no older than the bin,
+// and matching it.
+//
+bool DFTpsReader::open( const QString &binName, int nChans, quint64 scanCt )
+{
+    QString     name = tpsName( binName );
+    QFileInfo   fiB( binName ),
+                fiT( name );
+
+    f.close();
+    index.clear();
+
+    if( !fiT.exists() || fiT.lastModified() < fiB.lastModified() )
+        return false;
+
+    f.setFileName( name );
+
+    if( !f.open( QIODevice::ReadOnly ) )
+        return false;
+
+    quint32 H[4],
+            G;
+    quint64 ct;
+
+    if( f.read( (char*)H, sizeof(H) ) != sizeof(H)
+        || f.read( (char*)&ct, sizeof(ct) ) != sizeof(ct)
+        || f.read( (char*)&G, sizeof(G) ) != sizeof(G)
+        || H[0] != DFTPS_MAGIC
+        || H[1] != DFTPS_VERSION
+        || int(H[2]) != nChans
+        || !H[3]
+        || ct != scanCt
+        || G != DFTPS_GRPCHANS ) {
+
+        f.close();
+        return false;
+    }
+
+    std::vector<quint64>    I;
+    qint64                  size = layout( I, nChans, H[3], scanCt ),
+                            iBytes = qint64(I.size()) * sizeof(quint64);
+
+    index.resize( I.size() );
+
+    if( f.size() != size
+        || (iBytes && f.read( (char*)&index[0], iBytes ) != iBytes)
+        || index != I ) {
+
+        f.close();
+        index.clear();
+        return false;
+    }
+
+    this->scanCt    = scanCt;
+    nC              = nChans;
+    tileScans       = H[3];
+    nGrps           = (nC + DFTPS_GRPCHANS - 1) / DFTPS_GRPCHANS;
+
+    return true;
+}
+
+
+// Same contract as DataFile::readScans, given runs of kept
+// channels (see Subset::bits2Runs). Runs of a group are read
+// in one span when the skipped samples between channels are
+// no more than those kept, else one read per channel.
+//
+qint64 DFTpsReader::read(
+    vec_i16             &dst,
+    quint64             scan0,
+    quint64             num2read,
+    const QVector<uint> &runs,
+    int                 nKeep )
+{
+    if( !f.isOpen() || scan0 >= scanCt )
+        return -1;
+
+    num2read = qMin( num2read, scanCt - scan0 );
+
+    dst.resize( num2read * nKeep );
+
+    int nR = runs.size();
+
+    for( quint64 s = scan0, sLim = scan0 + num2read; s < sLim; ) {
+
+        quint64 t   = s / tileScans;
+        int     nt  = (int)qMin( quint64(tileScans), scanCt - t * tileScans ),
+                a   = int(s - t * tileScans),
+                n   = (int)qMin( quint64(nt - a), sLim - s ),
+                k   = 0;
+        qint16  *out = &dst[(s - scan0) * nKeep];
+
+        for( int ir = 0; ir < nR; ir += 2 ) {
+
+            int c       = runs[ir],
+                cLim    = c + runs[ir+1];
+
+            while( c < cLim ) {
+
+                // Piece of run within one group
+
+                int g       = c / DFTPS_GRPCHANS,
+                    cg      = c - g * DFTPS_GRPCHANS,
+                    nc      = qMin( cLim - c, DFTPS_GRPCHANS - cg ),
+                    nSpan   = (2 * n >= nt ? nc : 1);
+
+                quint64 off = index[t * nGrps + g]
+                                + (quint64(cg) * nt + a) * sizeof(qint16);
+
+                for( int ic = 0; ic < nc; ic += nSpan ) {
+
+                    int     m       = qMin( nSpan, nc - ic ),
+                            words   = (m - 1) * nt + n;
+                    qint64  bytes   = qint64(words) * sizeof(qint16);
+
+                    buf.resize( words );
+
+                    if( !f.seek( off + quint64(ic) * nt * sizeof(qint16) )
+                        || f.read( (char*)&buf[0], bytes ) != bytes ) {
+
+                        dst.clear();
+                        return -1;
+                    }
+
+                    for( int j = 0; j < m; ++j, ++k ) {
+
+                        const qint16    *S = &buf[j * nt];
+                        qint16          *D = out + k;
+
+                        for( int i = 0; i < n; ++i, D += nKeep )
+                            *D = S[i];
+                    }
+                }
+
+                c += nc;
+            }
+        }
+
+        s += n;
+    }
+
+    return num2read;
+}
+
+/* ---------------------------------------------------------------- */
+/* DFTranspose ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+DFTranspose::DFTranspose( const DataFile &df )
+    :   QObject(0), worker(0)
+{
+    QString binName = df.binFileName();
+
+    worker  = new DFTpsWorker( binName, DFTpsReader::tpsName( binName ) );
+
+    DFSidecarWorker::start( worker, this );
+}
+
+
+DFTranspose::~DFTranspose()
+{
+    DFSidecarWorker::end( worker );
+}
+
+
+void DFTranspose::buildDone( bool ok )
+{
+    DFSidecarWorker::end( worker );
+
+    if( ok )
+        emit ready();
+}
+
+
@@ -0,0 +1,103 @@
+#ifndef DFTRANSPOSE_H
+#define DFTRANSPOSE_H
+
+#include "SGLTypes.h"
+#include "DFSidecar.h"
+
+#include <QFile>
+
+class DataFile;
+
+// Tiles span DFTPS_GRPCHANS channels by DFTPS_TILESECS of scans.
+#define DFTPS_GRPCHANS  64
+#define DFTPS_TILESECS  1.0
+
+// Reads prefer the sidecar if they keep at most 1/DFTPS_FEWFRAC
+// of the channels.
+#define DFTPS_FEWFRAC   8
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Worker builds the sidecar (see DFSidecarWorker).
+//
+class DFTpsWorker : public DFSidecarWorker
+{
+public:
+    DFTpsWorker( const QString &binName, const QString &tpsName )
+    :   DFSidecarWorker( binName, tpsName, "Channel-major cache", true )    {}
+
+protected:
+    virtual bool build( DataFile *df, QFile &f );
+};
+
+
+// Channel-major sidecar of a bin file.
+//
+// Sidecar file <name>.tps beside the bin holds the same samples
+// as the bin, cut into tiles of DFTPS_GRPCHANS channels by
+// tileScans scans (last group and tile may be short). Within a
+// tile each channel's samples are contiguous, so reading a few
+// channels costs one short read per channel per tile instead
+// of reading every scan whole.
+//
+// Layout (little-endian):
+// - Header: 'SGLT', u32 version, u32 nChans, u32 tileScans,
+//           u64 scanCt, u32 grpChans.
+// - Index:  u64 file offset per tile, time-major
+//           (tile (t, g) at entry t*nGrps + g).
+// - Tiles:  qint16, in index order.
+//
+// DataFile opens the sidecar itself if present and no older
+// than the bin; DFTranspose builds one in the background (to a
+// temp name, then renamed) and emits ready() when done.
+//
+class DFTpsReader
+{
+private:
+    QFile                   f;
+    std::vector<quint64>    index;
+    vec_i16                 buf;
+    quint64                 scanCt;
+    int                     nC,
+                            tileScans,
+                            nGrps;
+
+public:
+    DFTpsReader() : scanCt(0), nC(0), tileScans(0), nGrps(0)    {}
+
+    static QString tpsName( const QString &binName );
+
+    bool open( const QString &binName, int nChans, quint64 scanCt );
+
+    qint64 read(
+        vec_i16             &dst,
+        quint64             scan0,
+        quint64             num2read,
+        const QVector<uint> &runs,
+        int                 nKeep );
+};
+
+
+class DFTranspose : public QObject
+{
+    Q_OBJECT
+
+private:
+    DFSidecarWorker *worker;
+
+public:
+    DFTranspose( const DataFile &df );
+    virtual ~DFTranspose();
+
+signals:
+    void ready();
+
+private slots:
+    void buildDone( bool ok );
+};
+
+#endif  // DFTRANSPOSE_H
+
+
@@ -1,14 +1,38 @@
 
 #include "DataFile.h"
 #include "DataFile_Helpers.h"
+#include "DFCheckpoint.h"
+#include "DFCompress.h"
+#include "DFDirIndex.h"
 #include "DFName.h"
+#include "DFTranspose.h"
+#include "Par2Stream.h"
 #include "Util.h"
 #include "MainApp.h"
 #include "Subset.h"
+#include "ThdPlace.h"
 #include "Version.h"
 
 #include <QDir>
 
+#include <string.h>
+
+
+// Preallocation: reserve in steps of the larger of
+// STEPSECS of data and MINBYTES; epoch reservations are
+// capped at MAXBYTES.
+#define DF_PREALLOC_STEPSECS    10.0
+#define DF_PREALLOC_MINBYTES    (64LL*1024*1024)
+#define DF_PREALLOC_MAXBYTES    (4LL*1024*1024*1024)
+
+// Mapped reads: window size and start granularity (the
+// Windows allocation granularity; harmless elsewhere).
+#define DF_MAP_WINBYTES         (256LL*1024*1024)
+#define DF_MAP_ALIGN            (64LL*1024)
+
+// Subset reads without mapping: staging block size.
+#define DF_RDBLK_BYTES          (8*1024*1024)
+
 
 /* ---------------------------------------------------------------- */
 /* DataFile ------------------------------------------------------- */
@@ -16,9 +40,13 @@
 
 DataFile::DataFile( int iProbe )
     :   scanCt(0), mode(Undefined),
-        trgStream("nidq"), trgChan(-1),
-        dfw(0), wrAsync(true), sRate(0),
-        iProbe(iProbe), nSavedChans(0)
+        trgStream("nidq"), cmpRd(0), tpsRd(0),
+        mapPtr(0), mapOff(0), mapLen(0),
+        trgChan(-1), mapOK(false),
+        dfw(0), dio(0), cmp(0), par2(0),
+        rawBytes(0), preAlloc(0), preStep(0),
+        wrBlkBytes(0), ckpChunks(-1), wrAsync(true), sRate(0),
+        iProbe(iProbe), nSavedChans(0), _maxInt(32768)
 {
 }
 
@@ -29,6 +57,31 @@ DataFile::~DataFile()
         delete dfw;
         dfw = 0;
     }
+
+    if( dio ) {
+        delete dio;
+        dio = 0;
+    }
+
+    if( cmp ) {
+        delete cmp;
+        cmp = 0;
+    }
+
+    if( par2 ) {
+        delete par2;
+        par2 = 0;
+    }
+
+    if( cmpRd ) {
+        delete cmpRd;
+        cmpRd = 0;
+    }
+
+    if( tpsRd ) {
+        delete tpsRd;
+        tpsRd = 0;
+    }
 }
 
 /* ---------------------------------------------------------------- */
@@ -63,13 +116,20 @@ bool DataFile::openForRead( const QString &filename, QString &error )
 // ----------
 
     binFile.setFileName( bFile );
-    binFile.open( QIODevice::ReadOnly );
+
+    if( !binFile.open( QIODevice::ReadOnly ) ) {
+        error = QString("openForRead error: Can't open '%1'.").arg( bFile );
+        Error() << error;
+        return false;
+    }
 
 // ---------
 // Load meta
 // ---------
 
-    kvp.fromMetaFile( metaName = DFName::forceMetaSuffix( filename ) );
+// Usually already parsed by isValidInputFile
+
+    DFDirIndex::meta( kvp, metaName = DFName::forceMetaSuffix( filename ) );
 
 // ----------
 // Parse meta
@@ -80,6 +140,35 @@ bool DataFile::openForRead( const QString &filename, QString &error )
     scanCt = kvp["fileSizeBytes"].toULongLong()
                 / (sizeof(qint16) * nSavedChans);
 
+// Compressed: fileSizeBytes is the decoded size
+
+    KVParams::const_iterator    it = kvp.find( "fileCompression" );
+
+    if( it != kvp.end() ) {
+
+        cmpRd = new DFCmpReader;
+
+        if( it->toString() != DFCMP_NAME
+            || !cmpRd->open( &binFile, nSavedChans ) ) {
+
+            error =
+            QString("openForRead error: Bad compressed format '%1'.")
+                .arg( filename );
+            Error() << error;
+            return false;
+        }
+    }
+    else {
+
+        // A bin shorter than its meta claims (e.g., truncated
+        // copy) must not be mapped; touching the missing pages
+        // faults. File reads report the short read instead.
+
+        mapOK = binFile.size() >= qint64(scanCt * sizeof(qint16) * nSavedChans);
+    }
+
+    openTranspose();
+
 // -----------
 // Channel ids
 // -----------
@@ -88,7 +177,7 @@ bool DataFile::openForRead( const QString &filename, QString &error )
 
 // Load subset string
 
-    KVParams::const_iterator    it = kvp.find( "snsSaveChanSubset" );
+    it = kvp.find( "snsSaveChanSubset" );
 
     if( it == kvp.end() ) {
         error =
@@ -153,6 +242,22 @@ bool DataFile::openForRead( const QString &filename, QString &error )
     return true;
 }
 
+
+// Return true if sidecar now in use.
+//
+bool DataFile::openTranspose()
+{
+    if( !tpsRd )
+        tpsRd = new DFTpsReader;
+
+    if( tpsRd->open( binFile.fileName(), nSavedChans, scanCt ) )
+        return true;
+
+    delete tpsRd;
+    tpsRd = 0;
+    return false;
+}
+
 /* ---------------------------------------------------------------- */
 /* openForWrite --------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -208,29 +313,38 @@ bool DataFile::openForWrite(
 // Open
 // ----
 
-    QString bName;
+// Striping: nidq stays on the main dataDir, probes are dealt
+// round-robin over all data dirs (LF follows its AP file).
+
+    QStringList roots   = mainApp()->dataDirs();
+    QString     bName,
+                root    = roots[0];
+
+    if( subtypeFromObj() != "nidq" )
+        root = roots[iProbe % roots.size()];
 
     if( !forceName.isEmpty() )
         bName = brevname;
     else if( !p.sns.fldPerPrb || subtypeFromObj() == "nidq" ) {
 
         bName = QString("%1/%2_g%3/%4")
-                .arg( mainApp()->dataDir() )
+                .arg( root )
                 .arg( p.sns.runName ).arg( ig )
                 .arg( brevname );
     }
     else {
 
         bName = QString("%1/%2_g%3/%2_g%3_%4")
-                .arg( mainApp()->dataDir() )
+                .arg( root )
                 .arg( p.sns.runName ).arg( ig )
                 .arg( streamFromObj() );
 
-        QDir().mkdir( bName );
-
         bName += "/" + brevname;
     }
 
+    if( forceName.isEmpty() )
+        QDir().mkpath( QFileInfo( bName ).absolutePath() );
+
     metaName = DFName::forceMetaSuffix( bName );
 
     Debug() << "Outfile: " << bName;
@@ -243,6 +357,67 @@ bool DataFile::openForWrite(
         return false;
     }
 
+// Direct mode writes through its own unbuffered handle;
+// binFile stays open for naming, sizing and final truncation.
+
+    if( p.sns.directIO ) {
+
+        dio = new DFDirectIO;
+
+        if( !dio->open( bName ) ) {
+
+            Warning()
+                << "openForWrite: Direct I/O unavailable for ["
+                << bName << "]; using buffered writes.";
+
+            delete dio;
+            dio = 0;
+        }
+    }
+
+// Compressed files open with the format header
+
+    if( p.sns.compress ) {
+
+        QByteArray  hdr;
+
+        cmp = new DFCmpWriter( nSaved );
+        cmp->header( hdr );
+
+        if( doRawWrite( hdr.constData(), hdr.size() ) != hdr.size() ) {
+
+            Error() << "openForWrite error: Can't write [" << bName << "]";
+            return false;
+        }
+    }
+
+// Parity alongside the hash, so it needs the bytes as stored
+
+    if( p.sns.par2MB > 0 ) {
+
+        if( p.sns.compress ) {
+            Warning()
+                << "openForWrite: PAR2 while writing needs uncompressed"
+                << " files; none for [" << bName << "].";
+        }
+        else {
+
+            int nRec = int(p.sns.par2MB * 1024 * 1024 / PAR2_SLICEBYTES);
+
+            par2 = new Par2Stream( PAR2_SLICEBYTES, qMax( nRec, 1 ) );
+
+            if( !par2->isOK() ) {
+
+                Warning()
+                    << "openForWrite: No memory for PAR2 parity for ["
+                    << bName << "].";
+
+                delete par2;
+                par2 = 0;
+            }
+        }
+    }
+
 // ---------
 // Meta data
 // ---------
@@ -290,6 +465,7 @@ bool DataFile::openForWrite(
 //    trgTimNH=3
 //    trgTimIsHInf=false
 //    trgTimIsNInf=false
+//    trgTimOneFile=false
 //    trgTTLThresh=1.1
 //    trgTTLMarginS=1
 //    trgTTLRefractS=0.5
@@ -310,6 +486,7 @@ bool DataFile::openForWrite(
 //    trgSpikeInarow=5
 //    trgSpikeNS=10
 //    trgSpikeIsNInf=false
+//    trgSpikeMerge=false
 //    gateMode=0
 //    trigMode=0
 //    manOvShowBut=false
@@ -317,6 +494,13 @@ bool DataFile::openForWrite(
 //    snsNotes=
 //    snsRunName=myRun
 //    snsReqMins=10
+//    snsDirectIO=false
+//    snsCompress=false
+//    snsImWrBlkMB=8
+//    snsNiWrBlkMB=1
+//    snsMaxCloses=2
+//    snsPar2MB=0
+//    snsWrShedLF=false
 //
 //  [DAQ_Imec_All]
 //    imTrgSource=0
@@ -349,6 +533,14 @@ bool DataFile::openForWrite(
     kvp["typeImEnabled"]    = p.im.get_nProbes();
     kvp["typeNiEnabled"]    = (p.ni.enabled ? 1 : 0);
 
+    if( roots.size() > 1 )
+        kvp["runStripeDirs"]    = roots.join( ";" );
+
+    QString place = ThdPlace::metaStr( p.strm.thdPlace );
+
+    if( !place.isEmpty() )
+        kvp["thdPlacement"]     = place;
+
     // All metadata are single lines of text
     QString noReturns = p.sns.notes;
     noReturns.replace( QRegExp("[\r\n]"), "\\n" );
@@ -367,6 +559,7 @@ bool DataFile::openForWrite(
         kvp["trgTimNH"]     = p.trgTim.nH;
         kvp["trgTimIsHInf"] = p.trgTim.isHInf;
         kvp["trgTimIsNInf"] = p.trgTim.isNInf;
+        kvp["trgTimOneFile"]= p.trgTim.oneFile;
     }
     else if( p.mode.mTrig == DAQ::eTrigTTL ) {
 
@@ -382,6 +575,8 @@ bool DataFile::openForWrite(
         kvp["trgTTLThresh"]     = p.trgTTL.T;
         kvp["trgTTLIsAnalog"]   = p.trgTTL.isAnalog;
         kvp["trgTTLIsNInf"]     = p.trgTTL.isNInf;
+        kvp["trgTTLLowLatency"] = p.trgTTL.lowLat;
+        kvp["trgTTLDOLine"]     = p.trgTTL.doLine;
     }
     else if( p.mode.mTrig == DAQ::eTrigSpike ) {
 
@@ -389,10 +584,12 @@ bool DataFile::openForWrite(
         kvp["trgSpikeRefractS"] = p.trgSpike.refractSecs;
         kvp["trgSpikeStream"]   = p.trgSpike.stream;
         kvp["trgSpikeAIChan"]   = p.trgSpike.aiChan;
+        kvp["trgSpikeChans"]    = p.trgSpike.chans;
         kvp["trgSpikeInarow"]   = p.trgSpike.inarow;
         kvp["trgSpikeNS"]       = p.trgSpike.nS;
         kvp["trgSpikeThresh"]   = p.trgSpike.T;
         kvp["trgSpikeIsNInf"]   = p.trgSpike.isNInf;
+        kvp["trgSpikeMerge"]    = p.trgSpike.merge;
     }
 
 // ----------
@@ -411,7 +608,11 @@ bool DataFile::openForWrite(
 
     kvp["appVersion"] = QString("%1").arg( VERSION, 0, 16 );
 
-    return kvp.toMetaFile( metaName );
+    bool    ok = kvp.toMetaFile( metaName );
+
+    DFDirIndex::forget( metaName );
+
+    return ok;
 }
 
 /* ---------------------------------------------------------------- */
@@ -423,11 +624,11 @@ bool DataFile::openForExport(
     const QString       &filename,
     const QVector<uint> &idxOtherChans )
 {
-    if( !other.isOpenForRead() ) {
+    if( !other.isOpen() ) {
         Error()
             << "INTERNAL ERROR: First parameter"
             " to DataFile::openForExport() needs"
-            " to be another DataFile that is opened for reading.";
+            " to be another DataFile that is open.";
         return false;
     }
 
@@ -529,17 +730,90 @@ bool DataFile::closeAndFinalize()
             dfw = 0;
         }
 
+        // Compressed tail chunk, index and trailer
+
+        if( cmp ) {
+
+            QByteArray  tail;
+
+            cmp->finish( tail );
+
+            if( doRawWrite( tail.constData(), tail.size() ) != tail.size() ) {
+                Error() << "File writing error: Compressed index.";
+                ok = false;
+            }
+        }
+
+        // Drop direct mode's tail padding
+
+        if( dio ) {
+
+            if( !dio->close() ) {
+                Error() << "File writing error: Direct I/O tail.";
+                ok = false;
+            }
+
+            binFile.resize( dio->size() );
+
+            delete dio;
+            dio = 0;
+        }
+        else if( preAlloc )
+            fileTrimAlloc( binFile );
+
+        bufPool.clear();
+
         sha.Final();
 
         std::basic_string<char> hStr;
         sha.ReportHashStl( hStr, CSHA1::REPORT_HEX_SHORT );
 
         kvp["fileSHA1"]         = hStr.c_str();
+
+        if( !csum.save( binFile.fileName() ) ) {
+            Warning()
+                << "Chunk checksums not written for ["
+                << binFile.fileName() << "].";
+        }
+
+        if( !stamps.save( binFile.fileName() ) ) {
+            Warning()
+                << "Timestamp index not written for ["
+                << binFile.fileName() << "].";
+        }
+
+        if( par2 ) {
+
+            QString err;
+
+            if( !par2->finish( err, binFile.fileName() ) )
+                Warning() << err;
+
+            delete par2;
+            par2 = 0;
+        }
+
         kvp["fileTimeSecs"]     = fileTimeSecs();
-        kvp["fileSizeBytes"]    = binFile.size();
+
+        if( cmp ) {
+            kvp["fileCompression"]  = DFCMP_NAME;
+            kvp["fileCmpBytes"]     = binFile.size();
+            kvp["fileSizeBytes"]    = cmp->inBytes();
+        }
+        else {
+            kvp.remove( "fileCompression" );
+            kvp.remove( "fileCmpBytes" );
+            kvp["fileSizeBytes"]    = binFile.size();
+        }
+
         kvp["appVersion"]       = QString("%1").arg( VERSION, 0, 16 );
 
-        ok = kvp.toMetaFile( metaName );
+        ok = kvp.toMetaFile( metaName ) && ok;
+
+        DFDirIndex::forget( metaName );
+
+        if( ok )
+            QFile::remove( DFCheckpoint::sidecarName( binFile.fileName() ) );
 
         Log() << ">> Completed " << binFile.fileName();
     }
@@ -548,19 +822,48 @@ bool DataFile::closeAndFinalize()
 // Reset
 // -----
 
+    unmapWindow();
     binFile.close();
     metaName.clear();
 
+    if( cmp ) {
+        delete cmp;
+        cmp = 0;
+    }
+
+    if( par2 ) {
+        delete par2;
+        par2 = 0;
+    }
+
+    if( cmpRd ) {
+        delete cmpRd;
+        cmpRd = 0;
+    }
+
+    if( tpsRd ) {
+        delete tpsRd;
+        tpsRd = 0;
+    }
+
     statsBytes.clear();
     kvp.clear();
     chanIds.clear();
     sha.Reset();
+    csum.reset();
+    stamps.reset();
 
     scanCt      = 0;
     mode        = Undefined;
     trgStream   = "nidq";
     trgChan     = -1;
+    mapOK       = false;
     dfw         = 0;
+    rawBytes    = 0;
+    preAlloc    = 0;
+    preStep     = 0;
+    wrBlkBytes  = 0;
+    ckpChunks   = -1;
     wrAsync     = true;
     sRate       = 0;
     nSavedChans = 0;
@@ -581,10 +884,143 @@ bool DataFile::closeAndFinalize()
 //
 DataFile *DataFile::closeAsync( const KeyValMap &kvm )
 {
+    if( dfw )
+        dfw->lowerPriority();
+
     DFCloseAsync( this, kvm );
     return 0;
 }
 
+
+// Limit closes in progress at once (queued beyond that).
+//
+void DataFile::setMaxAsyncCloses( int n )
+{
+    DFCloseAsyncSetLimit( n );
+}
+
+/* ---------------------------------------------------------------- */
+/* Open ahead ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Spawn the async writer now rather than at first write.
+//
+void DataFile::startWriter()
+{
+    if( isOpenForWrite() && wrAsync && !dfw )
+        dfw = new DFWriter( this, 4000 );
+}
+
+
+// A file opened ahead goes into use: its creation time is now,
+// so restamp and rewrite the preliminary meta data.
+//
+bool DataFile::commitOpen()
+{
+    if( !isOpenForWrite() )
+        return false;
+
+    kvp["fileCreateTime"] =
+        dateTime2Str( QDateTime::currentDateTime(), Qt::ISODate );
+
+    bool    ok = kvp.toMetaFile( metaName );
+
+    DFDirIndex::forget( metaName );
+
+    return ok;
+}
+
+
+// Close and delete an output file nothing was written to, and
+// its meta, without finalizing. Run and probe folders that
+// openForWrite made for it are removed if now empty.
+//
+void DataFile::discardWrite()
+{
+    if( !isOpenForWrite() )
+        return;
+
+    QString bName   = binFile.fileName(),
+            mName   = metaName,
+            dir     = QFileInfo( bName ).absolutePath();
+
+    if( dfw ) {
+        delete dfw;
+        dfw = 0;
+    }
+
+    if( dio ) {
+        delete dio;
+        dio = 0;
+    }
+
+    bufPool.clear();
+
+    mode = Undefined;   // close without finalizing
+    closeAndFinalize();
+
+    QFile::remove( bName );
+    QFile::remove( mName );
+    DFDirIndex::forget( mName );
+
+    QRegExp reRun( "_g\\d+$" ),
+            rePrb( QString("_g\\d+_%1$").arg( streamFromObj() ) );
+
+    if( QFileInfo( dir ).fileName().contains( rePrb ) ) {
+
+        if( !QDir().rmdir( dir ) )
+            return;
+
+        dir = QFileInfo( dir ).absolutePath();
+    }
+
+    if( QFileInfo( dir ).fileName().contains( reRun ) )
+        QDir().rmdir( dir );
+}
+
+/* ---------------------------------------------------------------- */
+/* setPreallocation ----------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Reserve the expected file size on disk up front, so the file
+// is laid out in few extents and grows without per-extent
+// metadata updates. epochSecs is the expected file duration,
+// 0 if open-ended. Writing past the reservation extends it in
+// DF_PREALLOC_STEPSECS increments. Compressed sizes aren't known
+// ahead, so those files use increments only.
+//
+// Call after openForWrite.
+//
+void DataFile::setPreallocation( double epochSecs )
+{
+    if( !isOpenForWrite() )
+        return;
+
+    preStep = qMax(
+                qint64(DF_PREALLOC_MINBYTES),
+                qint64(DF_PREALLOC_STEPSECS * requiredBps()) );
+
+    qint64  want = preStep;
+
+    if( epochSecs > 0 && !cmp ) {
+
+        want = qint64(epochSecs * requiredBps()) + rawBytes;
+        want = qMin( want, qint64(DF_PREALLOC_MAXBYTES) );
+    }
+
+    preAlloc = qMax( want, rawBytes + preStep );
+
+    if( !filePreallocate( binFile, preAlloc ) ) {
+
+        Debug()
+            << "Preallocation unavailable for ["
+            << binFile.fileName() << "].";
+
+        preAlloc    = 0;
+        preStep     = 0;
+    }
+}
+
 /* ---------------------------------------------------------------- */
 /* writeAndInvalScans --------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -629,7 +1065,7 @@ bool DataFile::writeAndInvalScans( vec_i16 &scans )
 
         dfw->worker->enqueue( scans );
 
-        if( dfw->worker->percentFull() >= 95.0 ) {
+        if( percentFull() >= 95.0 ) {
 
             Error() << "Datafile queue overflow; stopping run.";
             return false;
@@ -638,7 +1074,11 @@ bool DataFile::writeAndInvalScans( vec_i16 &scans )
         return true;
     }
 
-    return doFileWrite( scans );
+    if( !doFileWrite( &scans[0], (int)scans.size() ) )
+        return false;
+
+    doFileHash( scans );
+    return true;
 }
 
 /* ---------------------------------------------------------------- */
@@ -681,6 +1121,33 @@ qint64 DataFile::readScans(
 
     num2read = qMin( num2read, scanCt - scan0 );
 
+// Subsets are gathered from big blocks straight into dst,
+// one memcpy per run of consecutive kept channels.
+
+    QVector<uint>   runs;
+    int             nKeep = nSavedChans;
+
+    if( keepBits.size() && keepBits.count( true ) < nSavedChans )
+        nKeep = Subset::bits2Runs( runs, keepBits );
+
+// Few channels: read just those from the channel-major sidecar
+
+    if( tpsRd
+        && nKeep * DFTPS_FEWFRAC <= nSavedChans
+        && tpsRd->read( dst, scan0, num2read, runs, nKeep ) == qint64(num2read) ) {
+
+        return num2read;
+    }
+
+    if( cmpRd )
+        return readCmpScans( dst, scan0, num2read, keepBits );
+
+    if( mapOK && readMapScans( dst, scan0, num2read, runs, nKeep ) )
+        return num2read;
+
+    if( nKeep < nSavedChans )
+        return readSubsetScans( dst, scan0, num2read, runs, nKeep );
+
 // ----
 // Seek
 // ----
@@ -757,10 +1224,173 @@ qint64 DataFile::readScans(
         return -1;
     }
 
-// ------
-// Subset
-// ------
+    return num2read;
+}
+
+/* ---------------------------------------------------------------- */
+/* mapScans ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// The window is remapped whenever scan0 falls outside it,
+// so sequential readers remap once per DF_MAP_WINBYTES and
+// resident memory stays bounded however big the file.
+//
+qint64 DataFile::mapScans(
+    const qint16*   &span,
+    quint64         scan0,
+    quint64         num2read ) const
+{
+    if( !mapOK || scan0 >= scanCt )
+        return -1;
+
+    num2read = qMin( num2read, scanCt - scan0 );
+
+    qint64  bytesPerScan    = nSavedChans * sizeof(qint16),
+            pos             = scan0 * bytesPerScan;
+
+    if( !mapPtr || pos < mapOff || pos + bytesPerScan > mapOff + mapLen ) {
+
+        unmapWindow();
+
+        mapOff  = pos - pos % DF_MAP_ALIGN;
+        mapLen  = qMin( DF_MAP_WINBYTES,
+                    qint64(scanCt) * bytesPerScan - mapOff );
+        mapPtr  = ((QFile*)&binFile)->map( mapOff, mapLen );
+
+        if( !mapPtr ) {
+
+            Warning()
+                << "readScans: Mapping unavailable ["
+                << binFile.errorString()
+                << "], using file reads for ["
+                << binFile.fileName()
+                << "].";
+
+            mapOK = false;
+            return -1;
+        }
+    }
+
+    span = (const qint16*)(mapPtr + (pos - mapOff));
+
+    return qMin( num2read, quint64((mapOff + mapLen - pos) / bytesPerScan) );
+}
+
+/* ---------------------------------------------------------------- */
+/* readMapScans --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Copy scans (or gather bits2Runs() runs of nKeep channels)
+// through mapped windows; scan0, num2read already checked.
+//
+// Return false if mapping fails (caller falls back to read).
+//
+bool DataFile::readMapScans(
+    vec_i16             &dst,
+    quint64             scan0,
+    quint64             num2read,
+    const QVector<uint> &runs,
+    int                 nKeep ) const
+{
+    dst.resize( num2read * nKeep );
+
+    qint16  *D = &dst[0];
+
+    while( num2read ) {
+
+        const qint16    *S;
+        qint64          n = mapScans( S, scan0, num2read );
+
+        if( n <= 0 )
+            return false;
+
+        if( nKeep < nSavedChans )
+            D = Subset::subsetRuns( D, S, int(n), runs, nSavedChans );
+        else {
+            memcpy( D, S, n * nSavedChans * sizeof(qint16) );
+            D += n * nSavedChans;
+        }
+
+        scan0       += n;
+        num2read    -= n;
+    }
+
+    return true;
+}
+
+/* ---------------------------------------------------------------- */
+/* readSubsetScans ------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+// Unmapped subset read: stage DF_RDBLK_BYTES blocks and gather
+// the runs to dst, so dst never holds the unwanted channels.
+//
+qint64 DataFile::readSubsetScans(
+    vec_i16             &dst,
+    quint64             scan0,
+    quint64             num2read,
+    const QVector<uint> &runs,
+    int                 nKeep ) const
+{
+    int bytesPerScan = nSavedChans * sizeof(qint16);
+
+    if( !((QFile*)&binFile)->seek( scan0 * bytesPerScan ) ) {
+
+        Error()
+            << "readScans error: Failed seek to pos ["
+            << scan0 * bytesPerScan
+            << "] file size ["
+            << binFile.size()
+            << "].";
+        return -1;
+    }
+
+    int     blkScans = qMax( 1, DF_RDBLK_BYTES / bytesPerScan );
+    vec_i16 blk( qMin( num2read, quint64(blkScans) ) * nSavedChans );
+
+    dst.resize( num2read * nKeep );
+
+    qint16  *D      = &dst[0];
+    quint64 nDone   = 0;
+
+    while( nDone < num2read ) {
+
+        int     n   = int(qMin( num2read - nDone, quint64(blkScans) ));
+        qint64  nr  = ((QFile*)&binFile)->read(
+                        (char*)&blk[0], qint64(n) * bytesPerScan );
+
+        if( nr != qint64(n) * bytesPerScan ) {
+
+            Error()
+                << "readScans error: Failed file read: returned ["
+                << nr
+                << "] bytes ["
+                << qint64(n) * bytesPerScan
+                << "] pos ["
+                << (scan0 + nDone) * bytesPerScan
+                << "] file size ["
+                << binFile.size()
+                << "] msg ["
+                << binFile.errorString()
+                << "].";
+
+            dst.clear();
+            return -1;
+        }
+
+        D       = Subset::subsetRuns( D, &blk[0], n, runs, nSavedChans );
+        nDone  += n;
+    }
+
+    return num2read;
+}
+
+/* ---------------------------------------------------------------- */
+/* keepSubset ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
 
+void DataFile::keepSubset( vec_i16 &dst, const QBitArray &keepBits ) const
+{
     if( keepBits.size() && keepBits.count( true ) < nSavedChans ) {
 
         QVector<uint>   iKeep;
@@ -768,6 +1398,58 @@ qint64 DataFile::readScans(
         Subset::bits2Vec( iKeep, keepBits );
         Subset::subset( dst, dst, iKeep, nSavedChans );
     }
+}
+
+/* ---------------------------------------------------------------- */
+/* unmapWindow ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void DataFile::unmapWindow() const
+{
+    if( mapPtr ) {
+        ((QFile*)&binFile)->unmap( mapPtr );
+        mapPtr = 0;
+    }
+
+    mapOff = 0;
+    mapLen = 0;
+}
+
+/* ---------------------------------------------------------------- */
+/* readCmpScans --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Compressed file counterpart of readScans; scan0, num2read
+// already checked.
+//
+qint64 DataFile::readCmpScans(
+    vec_i16         &dst,
+    quint64         scan0,
+    quint64         num2read,
+    const QBitArray &keepBits ) const
+{
+    dst.resize( num2read * nSavedChans );
+
+    qint64  nr = cmpRd->read( &dst[0], scan0, num2read );
+
+    if( nr != (qint64)num2read ) {
+
+        Error()
+            << "readScans error: Failed decompress: returned ["
+            << nr
+            << "] scans ["
+            << num2read
+            << "] from ["
+            << scan0
+            << "] file ["
+            << binFile.fileName()
+            << "].";
+
+        dst.clear();
+        return -1;
+    }
+
+    keepSubset( dst, keepBits );
 
     return num2read;
 }
@@ -784,6 +1466,19 @@ void DataFile::setFirstSample( quint64 firstCt )
     kvp["firstSample"] = firstCt;
 }
 
+/* ---------------------------------------------------------------- */
+/* setSampleRate -------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// For derived (decimated) exports, after openForExport(),
+// or to apply a live sync calibration before closing.
+//
+void DataFile::setSampleRate( double srate )
+{
+    sRate = srate;
+    kvp[streamFromObj() == "nidq" ? "niSampRate" : "imSampRate"] = srate;
+}
+
 /* ---------------------------------------------------------------- */
 /* setParam ------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -872,7 +1567,43 @@ bool DataFile::verifySHA1( const QString &filename )
         return false;
     }
 
-    if( !sha1.HashFile( STR2CHR( filename ) ) ) {
+    // Compressed: hash decoded data
+
+    if( kvp.contains( "fileCompression" ) ) {
+
+        QFile       f( filename );
+        DFCmpReader R;
+        vec_i16     D;
+
+        if( !f.open( QIODevice::ReadOnly )
+            || !R.open( &f, kvp["nSavedChans"].toInt() ) ) {
+
+            Error()
+                << "verifySHA1 could not read file '"
+                << filename
+                << "'.";
+            return false;
+        }
+
+        for( int ic = 0, nc = R.nChunks(); ic < nc; ++ic ) {
+
+            if( !R.chunk( D, ic ) ) {
+
+                Error()
+                    << "verifySHA1 could not decode file '"
+                    << filename
+                    << "'.";
+                return false;
+            }
+
+            sha1.Update(
+                (const UINT_8*)&D[0],
+                UINT_32(D.size() * sizeof(qint16)) );
+        }
+
+        sha1.Final();
+    }
+    else if( !sha1.HashFile( STR2CHR( filename ) ) ) {
 
         Error()
             << "verifySHA1 could not read file '"
@@ -907,7 +1638,10 @@ bool DataFile::verifySHA1( const QString &filename )
 
 double DataFile::percentFull() const
 {
-    return (dfw ? dfw->worker->percentFull() : 0);
+    if( !dfw )
+        return 0;
+
+    return qMax( dfw->worker->percentFull(), dfw->hasher->percentFull() );
 }
 
 /* ---------------------------------------------------------------- */
@@ -936,12 +1670,28 @@ double DataFile::writtenBytes() const
 /* doFileWrite ---------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
-bool DataFile::doFileWrite( const vec_i16 &scans )
+// Stats count data bytes, before any compression.
+//
+bool DataFile::doFileWrite( const qint16 *src, int n16 )
 {
-    int n2Write = (int)scans.size() * sizeof(qint16);
+    int n2Write = n16 * sizeof(qint16);
+
+//    int nWrit = writeChunky( binFile, src, n2Write );
+    int nWrit;
+
+    if( cmp ) {
+
+        QByteArray  out;
 
-//    int nWrit = writeChunky( binFile, &scans[0], n2Write );
-    int nWrit = binFile.write( (char*)&scans[0], n2Write );
+        cmp->put( out, src, n16 );
+
+        if( doRawWrite( out.constData(), out.size() ) == out.size() )
+            nWrit = n2Write;
+        else
+            nWrit = -1;
+    }
+    else
+        nWrit = doRawWrite( (const char*)src, n2Write );
 
     statsMtx.lock();
         statsBytes.push_back( nWrit );
@@ -952,9 +1702,71 @@ bool DataFile::doFileWrite( const vec_i16 &scans )
         return false;
     }
 
-    sha.Update( (const UINT_8*)&scans[0], n2Write );
-
     return true;
 }
 
+/* ---------------------------------------------------------------- */
+/* doRawWrite ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Return bytes written, or -1 if error.
+//
+qint64 DataFile::doRawWrite( const char *src, qint64 bytes )
+{
+    if( !bytes )
+        return 0;
+
+    qint64  nWrit;
+
+    if( dio )
+        nWrit = dio->write( src, bytes );
+    else
+        nWrit = binFile.write( src, bytes );
+
+    if( nWrit > 0 )
+        rawBytes += nWrit;
+
+    // Extend reservation ahead of need
+
+    if( preStep && rawBytes + preStep / 4 >= preAlloc ) {
+
+        preAlloc = rawBytes + preStep;
+
+        if( !filePreallocate( binFile, preAlloc ) )
+            preStep = 0;
+    }
+
+    return nWrit;
+}
+
+/* ---------------------------------------------------------------- */
+/* doFileHash ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Blocks must arrive in file order; async mode calls this
+// from the DFHashWorker thread only.
+//
+// Crash checkpoint after first block and each finished chunk.
+//
+void DataFile::doFileHash( const vec_i16 &scans )
+{
+    sha.Update(
+        (const UINT_8*)&scans[0],
+        UINT_32(scans.size() * sizeof(qint16)) );
+
+    csum.update( &scans[0], scans.size() * sizeof(qint16) );
+
+    if( !cmp && csum.nComplete() > ckpChunks ) {
+
+        ckpChunks = csum.nComplete();
+
+        DFCheckpoint::save(
+            binFile.fileName(), sha, csum,
+            (dio ? DFCKP_PADDED : 0) );
+    }
+
+    if( par2 )
+        par2->update( &scans[0], scans.size() * sizeof(qint16) );
+}
+
 
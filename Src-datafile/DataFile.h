@@ -2,6 +2,8 @@
 #define DATAFILE_H
 
 #include "DAQ.h"
+#include "DFChunkSum.h"
+#include "DFStamps.h"
 #include "KVParams.h"
 
 #include "SHA1.h"
@@ -9,8 +11,15 @@
 
 #include <QFile>
 #include <QMutex>
+#include <QSharedPointer>
 
 class DFWriter;
+class DFDirectIO;
+class DFCmpWriter;
+class DFCmpReader;
+class Par2Stream;
+class DFTpsReader;
+class SampleBufPool;
 
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
@@ -21,6 +30,7 @@ class DFWriter;
 class DataFile
 {
     friend class DFWriterWorker;
+    friend class DFHashWorker;
     friend class DFCloseAsyncWorker;
 
 private:
@@ -38,14 +48,31 @@ private:
 
     // Input mode
     QString                 trgStream;
+    DFCmpReader             *cmpRd;     // compressed input, if any
+    DFTpsReader             *tpsRd;     // channel-major sidecar, if any
+    mutable uchar           *mapPtr;    // mapped window, if any
+    mutable qint64          mapOff,     // window file offset
+                            mapLen;     // window bytes
     int                     trgChan;    // neg if not using
+    mutable bool            mapOK;      // mapped reads enabled
 
     // Output mode only
     mutable QMutex          statsMtx;
     mutable QVector<uint>   statsBytes;
     CSHA1                   sha;
+    DFChunkSum              csum;
+    DFStamps                stamps;
     DFWriter                *dfw;
-    int                     nMeasMax;
+    DFDirectIO              *dio;       // direct I/O mode, if any
+    DFCmpWriter             *cmp;       // compressed output, if any
+    Par2Stream              *par2;      // parity while writing, if any
+    QSharedPointer<SampleBufPool>   bufPool;    // written blocks go here
+    qint64                  rawBytes,   // bytes sent to disk
+                            preAlloc,   // bytes reserved on disk
+                            preStep;    // reservation increment, 0=off
+    int                     nMeasMax,
+                            wrBlkBytes, // async coalescing, 0=off
+                            ckpChunks;  // csum chunks at checkpoint
     bool                    wrAsync;
 
 protected:
@@ -55,7 +82,8 @@ protected:
     VRange                  _vRange;
     double                  sRate;
     int                     iProbe,
-                            nSavedChans;
+                            nSavedChans,
+                            _maxInt;    // imMaxInt (>= 512), nidq 32768
 
 public:
     DataFile( int iProbe = 0 );
@@ -77,6 +105,7 @@ public:
     // 'idxOtherChans' are chanIds[] indices, not array elements.
     // For example, if other contains channels: {0,1,2,3,6,7,8},
     // export the last three by setting idxOtherChans = {4,5,6}.
+    // Other may also be open for write (its meta as of opening).
 
     bool openForExport(
         const DataFile      &other,
@@ -98,16 +127,33 @@ public:
     bool closeAndFinalize();
 
     DataFile *closeAsync( const KeyValMap &kvm );
+    static void setMaxAsyncCloses( int n );
 
     // ------
     // Output
     // ------
 
     void setAsyncWriting( bool async )  {wrAsync = async;}
+    void setWriteBlockBytes( int bytes )    {wrBlkBytes = bytes;}
+    void setPreallocation( double epochSecs );
+    void setBufPool( const QSharedPointer<SampleBufPool> &pool )
+        {bufPool = pool;}
+
+    // Files opened ahead of need (trigger pre-open): spawn the
+    // writer thread now, restamp and rewrite the meta when put
+    // to use, or delete the file if it never is.
+
+    void startWriter();
+    bool commitOpen();
+    void discardWrite();
 
     bool writeAndInvalScans( vec_i16 &scans );
     bool writeAndInvalSubset( const DAQ::Params &p, vec_i16 &scans );
 
+    // Hardware stamp of a fetch block starting at file scan.
+    void addStamp( qint64 scan, quint32 hw, double t )
+        {stamps.add( scan, hw, t );}
+
     // -----
     // Input
     // -----
@@ -122,11 +168,28 @@ public:
         quint64         num2read,
         const QBitArray &keepBits ) const;
 
+    // Prefer channel-major sidecar (DFTranspose), if present and
+    // current, for reads of few channels. openForRead() does this;
+    // call again after a build, while no reads are in progress.
+
+    bool openTranspose();
+    bool hasTranspose() const   {return tpsRd != 0;}
+
+    // Mapped read (uncompressed input): point span at scan0 and
+    // return count of contiguous scans there (<= num2read), or -1.
+    // Span is valid until the next read call.
+
+    qint64 mapScans(
+        const qint16*   &span,
+        quint64         scan0,
+        quint64         num2read ) const;
+
     // ---------
     // Meta data
     // ---------
 
     void setFirstSample( quint64 firstCt );
+    void setSampleRate( double srate );
     void setParam( const QString &name, const QVariant &value );
     void setRemoteParams( const KeyValMap &kvm );
 
@@ -136,6 +199,7 @@ public:
     double samplingRateHz() const           {return sRate;}
     double fileTimeSecs() const             {return scanCt/sRate;}
     const VRange &vRange() const            {return _vRange;}
+    int maxInt() const                      {return _maxInt;}
     int numChans() const                    {return nSavedChans;}
     const QVector<uint> &channelIDs() const {return chanIds;}
     bool isTrigChan( int acqChan ) const    {return acqChan == trgChan;}
@@ -180,7 +244,29 @@ protected:
         const QVector<uint> &idxOtherChans ) = 0;
 
 private:
-    bool doFileWrite( const vec_i16 &scans );
+    qint64 readCmpScans(
+        vec_i16         &dst,
+        quint64         scan0,
+        quint64         num2read,
+        const QBitArray &keepBits ) const;
+    bool readMapScans(
+        vec_i16             &dst,
+        quint64             scan0,
+        quint64             num2read,
+        const QVector<uint> &runs,
+        int                 nKeep ) const;
+    qint64 readSubsetScans(
+        vec_i16             &dst,
+        quint64             scan0,
+        quint64             num2read,
+        const QVector<uint> &runs,
+        int                 nKeep ) const;
+    void keepSubset( vec_i16 &dst, const QBitArray &keepBits ) const;
+    void unmapWindow() const;
+
+    qint64 doRawWrite( const char *src, qint64 bytes );
+    bool doFileWrite( const qint16 *src, int n16 );
+    void doFileHash( const vec_i16 &scans );
 };
 
 #endif  // DATAFILE_H
@@ -85,6 +85,7 @@ void DataFileIMAP::subclassParseMetaData()
     _vRange.rmax    = kvp["imAiRangeMax"].toDouble();
     sRate           = kvp["imSampRate"].toDouble();
     nSavedChans     = kvp["nSavedChans"].toUInt();
+    _maxInt         = qMax( kvp["imMaxInt"].toInt(), 512 );
 
 // subclass
     parseChanCounts();
@@ -121,7 +122,7 @@ void DataFileIMAP::subclassStoreMetaData( const DAQ::Params &p )
     kvp["imAiRangeMax"] = E.roTbl->maxVolts();
     kvp["imAiRangeMin"] = -E.roTbl->maxVolts();
     kvp["imLEDEnable"]  = E.LEDEnable;
-    kvp["imMaxInt"]     = E.roTbl->maxInt();
+    kvp["imMaxInt"]     = _maxInt = E.roTbl->maxInt();
     kvp["imRoFile"]     = E.imroFile;
     kvp["imStdby"]      = E.stdbyStr;
     kvp["~imroTbl"]     = E.roTbl->toString();
@@ -138,6 +138,10 @@ void DataFileNI::subclassStoreMetaData( const DAQ::Params &p )
         .arg( cum[CniCfg::niTypeXA] - cum[CniCfg::niTypeMA] )
         .arg( cum[CniCfg::niTypeXD] - cum[CniCfg::niTypeXA] );
 
+    memcpy( niCumTypCnt, cum, CniCfg::niNTypes*sizeof(int) );
+    mnGain  = p.ni.mnGain;
+    maGain  = p.ni.maGain;
+
     kvp["~snsShankMap"] =
         p.ni.sns.shankMap.toString( p.ni.sns.saveBits );
 
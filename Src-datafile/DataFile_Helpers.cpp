@@ -1,10 +1,183 @@
 
 #include "DataFile_Helpers.h"
 #include "DataFile.h"
+#include "DataFileIMAP.h"
+#include "DataFileIMLF.h"
+#include "DataFileNI.h"
+#include "DFName.h"
 #include "Util.h"
+#include "RunBench.h"
+#include "ThdPlace.h"
 
+#include <QFileInfo>
+#include <QMutex>
 #include <QThread>
 
+#include <string.h>
+
+
+// Direct I/O staging, a multiple of DIRECTIO_ALIGN.
+#define DIRECTIO_BUFBYTES   (4*1024*1024)
+
+// Coalesced writes are issued at least this often.
+#define WRBLK_MAXSECS       1.0
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+struct DFCloseJob {
+    DataFile    *df;
+    KeyValMap   kvm;
+};
+
+static QMutex               closeMtx;
+static QList<DFCloseJob>    closeQ;
+static int                  closeThreads    = 0,
+                            closeLimit      = 2;
+
+/* ---------------------------------------------------------------- */
+/* DFDirectIO ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+DFDirectIO::DFDirectIO()
+    :   buf(0), nBuf(0), nTot(0), h(-1), got(0)
+{
+}
+
+
+DFDirectIO::~DFDirectIO()
+{
+    close();
+}
+
+
+bool DFDirectIO::open( const QString &path )
+{
+    close();
+
+    buf = (char*)allocStreamMem( DIRECTIO_BUFBYTES, 0, got );
+
+    if( !buf )
+        return false;
+
+    h       = directFileOpen( path );
+    nBuf    = 0;
+    nTot    = 0;
+
+    if( h == -1 ) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+
+// Return bytes accepted, or -1 if error.
+//
+qint64 DFDirectIO::write( const char *src, qint64 bytes )
+{
+    if( h == -1 )
+        return -1;
+
+    qint64  nRem = bytes;
+
+// Buffer was made by the opener; move it to the writing
+// thread's NUMA node before first use.
+
+    if( !nTot && nRem > 0 ) {
+
+        int node = getCurrentThreadNumaNode();
+
+        if( node >= 0 )
+            moveStreamMem( buf, DIRECTIO_BUFBYTES, node, got );
+    }
+
+    while( nRem > 0 ) {
+
+        qint64  n = qMin( nRem, DIRECTIO_BUFBYTES - nBuf );
+
+        memcpy( buf + nBuf, src, n );
+        src  += n;
+        nRem -= n;
+        nBuf += n;
+
+        if( nBuf == DIRECTIO_BUFBYTES ) {
+
+            if( directFileWrite( h, buf, nBuf ) != nBuf )
+                return -1;
+
+            nBuf = 0;
+        }
+    }
+
+    nTot += bytes;
+    return bytes;
+}
+
+
+// Return true if tail written.
+//
+bool DFDirectIO::close()
+{
+    bool    ok = true;
+
+    if( h != -1 ) {
+
+        if( nBuf ) {
+
+            qint64  nPad =
+                ((nBuf + DIRECTIO_ALIGN - 1) / DIRECTIO_ALIGN) * DIRECTIO_ALIGN;
+
+            memset( buf + nBuf, 0, nPad - nBuf );
+            ok = (directFileWrite( h, buf, nPad ) == nPad);
+            nBuf = 0;
+        }
+
+        directFileClose( h );
+        h = -1;
+    }
+
+    if( buf ) {
+        freeStreamMem( buf, DIRECTIO_BUFBYTES, got );
+        buf = 0;
+    }
+
+    return ok;
+}
+
+
+/* ---------------------------------------------------------------- */
+/* DFHashWorker --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void DFHashWorker::run()
+{
+    for(;;) {
+
+        vec_i16 buf;
+
+        if( dequeue( buf, waitData() ) ) {
+
+            d->doFileHash( buf );
+
+            if( d->bufPool )
+                d->bufPool->put( buf );
+        }
+        else if( isStopped() )
+            break;
+    }
+
+    RunBench::addCPU( RunBench::stgWrite );
+    emit finished();
+}
+
+
+void DFHashWorker::overflowWarning()
+{
+    Error() << "Hash queue overflow [" << d->binFileName() << "].";
+}
 
 /* ---------------------------------------------------------------- */
 /* DFWriterWorker ------------------------------------------------- */
@@ -12,8 +185,15 @@
 
 void DFWriterWorker::run()
 {
+    ThdPlace::apply( ThdPlace::roleWrite );
+
     Debug() << "DFWriter started for " << d->binFileName();
 
+    blkWords = d->wrBlkBytes / sizeof(qint16);
+
+    if( blkWords )
+        pend.reserve( 2 * blkWords );
+
     for(;;) {
 
         vec_i16 buf;
@@ -22,20 +202,73 @@ void DFWriterWorker::run()
             write( buf );
         else if( isStopped() )
             break;
+        else if( pend.size() && getTime() - tPend >= WRBLK_MAXSECS )
+            flush( false );
     }
 
+    flush( true );
+
     Debug() << "DFWriter stopped for " << d->binFileName();
 
+    RunBench::addCPU( RunBench::stgWrite );
     emit finished();
 }
 
 
-bool DFWriterWorker::write( const vec_i16 &scans )
+// Written blocks are handed on to the hasher.
+//
+// Coalescing: blocks are appended to pend until it reaches
+// blkWords (or WRBLK_MAXSECS passes), then written in one call.
+// The hasher gets the original blocks, in the same order, which
+// yields the same digest as hashing what was written.
+//
+bool DFWriterWorker::write( vec_i16 &scans )
 {
     if( !d )
         return false;
 
-    return d->doFileWrite( scans );
+    if( !blkWords ) {
+
+        if( !d->doFileWrite( &scans[0], (int)scans.size() ) )
+            return false;
+
+        hasher->enqueue( scans );
+        return true;
+    }
+
+    if( !pend.size() )
+        tPend = getTime();
+
+    pend.insert( pend.end(), scans.begin(), scans.end() );
+    hasher->enqueue( scans );
+
+    if( pend.size() >= blkWords || getTime() - tPend >= WRBLK_MAXSECS )
+        return flush( false );
+
+    return true;
+}
+
+
+// Write pend: all of it if final, else the largest multiple of
+// DIRECTIO_ALIGN bytes, so every write but the last starts on an
+// aligned file offset. The remainder is carried forward.
+//
+bool DFWriterWorker::flush( bool final )
+{
+    int n = (int)pend.size();
+
+    if( !final )
+        n -= n % (DIRECTIO_ALIGN / sizeof(qint16));
+
+    if( n <= 0 )
+        return true;
+
+    bool    ok = d->doFileWrite( &pend[0], n );
+
+    pend.erase( pend.begin(), pend.begin() + n );
+    tPend = getTime();
+
+    return ok;
 }
 
 /* ---------------------------------------------------------------- */
@@ -44,8 +277,19 @@ bool DFWriterWorker::write( const vec_i16 &scans )
 
 DFWriter::DFWriter( DataFile *df, int maxQSize )
 {
+    hashThread  = new QThread;
+    hasher      = new DFHashWorker( df, maxQSize );
+
+    hasher->moveToThread( hashThread );
+
+    Connect( hashThread, SIGNAL(started()), hasher, SLOT(run()) );
+    Connect( hasher, SIGNAL(finished()), hasher, SLOT(deleteLater()) );
+    Connect( hasher, SIGNAL(destroyed()), hashThread, SLOT(quit()), Qt::DirectConnection );
+
+    hashThread->start();
+
     thread  = new QThread;
-    worker  = new DFWriterWorker( df, maxQSize );
+    worker  = new DFWriterWorker( df, hasher, maxQSize );
 
     worker->moveToThread( thread );
 
@@ -57,10 +301,12 @@ DFWriter::DFWriter( DataFile *df, int maxQSize )
 }
 
 
+// Writer drains first, since it feeds the hasher.
+//
 DFWriter::~DFWriter()
 {
-// worker object auto-deleted asynchronously
-// thread object manually deleted synchronously (so we can call wait())
+// worker objects auto-deleted asynchronously
+// thread objects manually deleted synchronously (so we can call wait())
 
     if( thread->isRunning() ) {
 
@@ -71,6 +317,25 @@ DFWriter::~DFWriter()
     }
 
     delete thread;
+
+    if( hashThread->isRunning() ) {
+
+        hasher->stayAwake();
+        hasher->wake();
+        hasher->stop();
+        hashThread->wait();
+    }
+
+    delete hashThread;
+}
+
+
+// Closing files drain behind those still being written.
+//
+void DFWriter::lowerPriority()
+{
+    thread->setPriority( QThread::LowPriority );
+    hashThread->setPriority( QThread::LowPriority );
 }
 
 /* ---------------------------------------------------------------- */
@@ -79,33 +344,89 @@ DFWriter::~DFWriter()
 
 void DFCloseAsyncWorker::run()
 {
-    if( d->mode == DataFile::Output ) {
+    for(;;) {
 
-        d->setRemoteParams( kvm );
-        d->closeAndFinalize();
-        delete d;
-    }
+        closeMtx.lock();
 
-    emit finished();
+        if( closeQ.isEmpty() ) {
+            --closeThreads;
+            closeMtx.unlock();
+            break;
+        }
+
+        DFCloseJob  J = closeQ.takeFirst();
+
+        closeMtx.unlock();
+
+        if( J.df->mode == DataFile::Output ) {
+
+            J.df->setRemoteParams( J.kvm );
+            J.df->closeAndFinalize();
+            delete J.df;
+        }
+    }
 }
 
 /* ---------------------------------------------------------------- */
 /* DFCloseAsync --------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
+void DFCloseAsyncSetLimit( int maxConcurrent )
+{
+    QMutexLocker    ml( &closeMtx );
+
+    closeLimit = qMax( 1, maxConcurrent );
+}
+
+
+// Queue the close; start a task if under the limit.
+//
 void DFCloseAsync( DataFile *df, const KeyValMap &kvm )
 {
-    QThread             *thread  = new QThread;
-    DFCloseAsyncWorker  *worker  = new DFCloseAsyncWorker( df, kvm );
+    DFCloseJob  J;
+    bool        spawn;
 
-    worker->moveToThread( thread );
+    J.df    = df;
+    J.kvm   = kvm;
 
-    Connect( thread, SIGNAL(started()), worker, SLOT(run()) );
-    Connect( worker, SIGNAL(finished()), worker, SLOT(deleteLater()) );
-    Connect( worker, SIGNAL(destroyed()), thread, SLOT(quit()), Qt::DirectConnection );
-    Connect( thread, SIGNAL(finished()), thread, SLOT(deleteLater()) );
+    closeMtx.lock();
+        closeQ.push_back( J );
 
-    thread->start();
+        if( (spawn = (closeThreads < closeLimit)) )
+            ++closeThreads;
+    closeMtx.unlock();
+
+    if( spawn )
+        TaskPool::submit( new DFCloseAsyncWorker, TaskPool::Write );
+}
+
+/* ---------------------------------------------------------------- */
+/* DFOpenForRead -------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Private reader for a worker thread: file of the type
+// and probe its name implies, opened for read.
+//
+// Return new DataFile (caller deletes) or 0 with error.
+//
+DataFile *DFOpenForRead( const QString &binName, QString &error )
+{
+    DataFile    *df = 0;
+    int         ip;
+
+    switch( DFName::typeAndIP( ip, QFileInfo( binName ).fileName(), &error ) ) {
+        case 0:  df = new DataFileIMAP( ip ); break;
+        case 1:  df = new DataFileIMLF( ip ); break;
+        case 2:  df = new DataFileNI; break;
+        default: return 0;
+    }
+
+    if( !df->openForRead( binName, error ) ) {
+        delete df;
+        return 0;
+    }
+
+    return df;
 }
 
 
@@ -3,9 +3,12 @@
 
 #include "SampleBufQ.h"
 #include "KVParams.h"
+#include "TaskPool.h"
 
 #include <QObject>
 
+#include <atomic>
+
 class DataFile;
 
 /* ---------------------------------------------------------------- */
@@ -13,30 +16,112 @@ class DataFile;
 /* ---------------------------------------------------------------- */
 
 /* ---------------------------------------------------------------- */
-/* DFWriter ------------------------------------------------------- */
+/* DFDirectIO ----------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
-class DFWriterWorker : public QObject, public SampleBufQ
+// Direct (unbuffered) output to an already created file.
+//
+// Data are staged in a sector-aligned buffer and sent to disk a
+// whole buffer at a time, so the OS page cache is never filled
+// with data we won't read back. close() pads the partial tail
+// buffer to a sector multiple; the caller then truncates the
+// file to size() through a normal handle.
+//
+class DFDirectIO
+{
+private:
+    char    *buf;
+    qint64  nBuf,
+            nTot;
+    qintptr h;
+    int     got;
+
+public:
+    DFDirectIO();
+    virtual ~DFDirectIO();
+
+    bool open( const QString &path );
+    qint64 write( const char *src, qint64 bytes );
+    bool close();
+
+    qint64 size() const     {return nTot;}
+};
+
+/* ---------------------------------------------------------------- */
+/* DFHasher ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// SHA1 runs behind the writer on its own thread, taking each
+// block the writer has finished with (buffer swapped, not copied),
+// so hashing speed doesn't cap write speed.
+//
+class DFHashWorker : public QObject, public SampleBufQ
 {
     Q_OBJECT
 
 private:
-    DataFile        *d;
-    mutable QMutex  runMtx;
-    volatile bool   _waitData,
-                    pleaseStop;
+    DataFile            *d;
+    std::atomic<bool>   _waitData,
+                        pleaseStop;
 
 public:
-    DFWriterWorker( DataFile *df, int maxQSize )
+    DFHashWorker( DataFile *df, int maxQSize )
     :   QObject(0), SampleBufQ(maxQSize),
         d(df), _waitData(true),
         pleaseStop(false)           {}
+    virtual ~DFHashWorker()         {}
+
+    void stayAwake()
+        {_waitData.store( false, std::memory_order_release );}
+    bool waitData() const
+        {return _waitData.load( std::memory_order_acquire );}
+    void stop()
+        {pleaseStop.store( true, std::memory_order_release );}
+    bool isStopped() const
+        {return pleaseStop.load( std::memory_order_acquire );}
+
+signals:
+    void finished();
+
+public slots:
+    void run();
+
+protected:
+    virtual void overflowWarning();
+};
+
+/* ---------------------------------------------------------------- */
+/* DFWriter ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+class DFWriterWorker : public QObject, public SampleBufQ
+{
+    Q_OBJECT
+
+private:
+    DataFile            *d;
+    DFHashWorker        *hasher;
+    vec_i16             pend;       // coalescing blocks
+    double              tPend;      // time pend started
+    uint                blkWords;   // write size target, 0=off
+    std::atomic<bool>   _waitData,
+                        pleaseStop;
+
+public:
+    DFWriterWorker( DataFile *df, DFHashWorker *hasher, int maxQSize )
+    :   QObject(0), SampleBufQ(maxQSize),
+        d(df), hasher(hasher), tPend(0), blkWords(0),
+        _waitData(true), pleaseStop(false)  {}
     virtual ~DFWriterWorker()       {}
 
-    void stayAwake()        {QMutexLocker ml( &runMtx ); _waitData = false;}
-    bool waitData() const   {QMutexLocker ml( &runMtx ); return _waitData;}
-    void stop()             {QMutexLocker ml( &runMtx ); pleaseStop = true;}
-    bool isStopped() const  {QMutexLocker ml( &runMtx ); return pleaseStop;}
+    void stayAwake()
+        {_waitData.store( false, std::memory_order_release );}
+    bool waitData() const
+        {return _waitData.load( std::memory_order_acquire );}
+    void stop()
+        {pleaseStop.store( true, std::memory_order_release );}
+    bool isStopped() const
+        {return pleaseStop.load( std::memory_order_acquire );}
 
 signals:
     void finished();
@@ -45,47 +130,48 @@ public slots:
     void run();
 
 private:
-    bool write( const vec_i16 &scans );
+    bool write( vec_i16 &scans );
+    bool flush( bool final );
 };
 
 
 class DFWriter
 {
 public:
-    QThread         *thread;
+    QThread         *thread,
+                    *hashThread;
     DFWriterWorker  *worker;
+    DFHashWorker    *hasher;
 
 public:
     DFWriter( DataFile *df, int maxQSize );
     virtual ~DFWriter();
+
+    void lowerPriority();
 };
 
 /* ---------------------------------------------------------------- */
 /* DFCloseAsync --------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
-class DFCloseAsyncWorker : public QObject
+// Closes are queued to one scheduler served by at most
+// maxConcurrent TaskPool Write tasks, so rapid trigger cycling
+// can't put many flush/hash/meta tails in contention with the
+// files still being written. Each task takes queued closes
+// in order until none remain, then exits.
+//
+class DFCloseAsyncWorker : public PoolTask
 {
-    Q_OBJECT
-
-private:
-    DataFile    *d;
-    KeyValMap   kvm;
-
 public:
-    DFCloseAsyncWorker( DataFile *df, const KeyValMap &kvm )
-    :   QObject(0), d(df), kvm(kvm) {}
-
-signals:
-    void finished();
-
-public slots:
-    void run();
+    virtual void run();
 };
 
 
+void DFCloseAsyncSetLimit( int maxConcurrent );
 void DFCloseAsync( DataFile *df, const KeyValMap &kvm );
 
+DataFile *DFOpenForRead( const QString &binName, QString &error );
+
 #endif // DATAFILE_HELPERS_H
 
 
@@ -0,0 +1,431 @@
+
+#include "ExportBatch.h"
+#include "ExportJob.h"
+#include "Util.h"
+#include "DataFile.h"
+#include "DataFile_Helpers.h"
+#include "Subset.h"
+
+#include <QFileInfo>
+#include <QDir>
+#include <QMutex>
+#include <QPointer>
+#include <QThread>
+
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+struct BatchJob {
+    enum State {
+        queued      = 0,
+        running     = 1,
+        done        = 2,
+        failed      = 3,
+        canceled    = 4
+    };
+
+    ExportBatch::Spec   S;
+    QString             resName;    // resolved output name
+    std::atomic<int>    pct;
+    std::atomic<bool>   pleaseStop;
+    int                 id;
+    State               state;
+
+    BatchJob( const ExportBatch::Spec &S, int id )
+    :   S(S), pct(0), pleaseStop(false), id(id), state(queued)  {}
+};
+
+
+class BatchProgress : public ExportProgress
+{
+private:
+    BatchJob    &J;
+
+public:
+    BatchProgress( BatchJob &J ) : J(J) {}
+
+    virtual bool update( int percent )
+    {
+        J.pct = percent;
+        return !J.pleaseStop;
+    }
+};
+
+
+static QMutex           batchMtx;
+static QList<BatchJob*> batchQ;     // all records, add order
+static QList<QPointer<QThread> >    batchThreadL;
+static ExportBudget     batchBudget;
+static int              batchThreads    = 0,
+                        batchLimit      = EXPORTBATCH_DEFJOBS,
+                        batchNextId     = 1;
+static bool             batchDown       = false;
+
+
+static const char *stateName( BatchJob::State s )
+{
+    static const char *N[] = {"queued", "running", "done", "failed", "canceled"};
+
+    return N[s];
+}
+
+
+// Drop oldest finished records beyond EXPORTBATCH_KEEP.
+// Caller holds batchMtx.
+//
+static void trimFinished()
+{
+    int nFin = 0;
+
+    for( int i = batchQ.size() - 1; i >= 0; --i ) {
+
+        if( batchQ[i]->state < BatchJob::done )
+            continue;
+
+        if( ++nFin > EXPORTBATCH_KEEP ) {
+            delete batchQ[i];
+            batchQ.removeAt( i );
+        }
+    }
+}
+
+
+// Start workers, up to the limit, for queued jobs.
+//
+static void startWorkers()
+{
+    for(;;) {
+
+        batchMtx.lock();
+
+            int nQ = 0;
+
+            foreach( BatchJob *J, batchQ ) {
+
+                if( J->state == BatchJob::queued )
+                    ++nQ;
+            }
+
+            bool    spawn = !batchDown
+                            && nQ > 0
+                            && batchThreads < qMin( batchLimit, nQ );
+
+            QThread *thread = 0;
+
+            if( spawn ) {
+
+                ++batchThreads;
+                thread = new QThread;
+
+                // Forget threads already deleted
+
+                for( int i = batchThreadL.size() - 1; i >= 0; --i ) {
+
+                    if( !batchThreadL[i] )
+                        batchThreadL.removeAt( i );
+                }
+
+                batchThreadL.push_back( thread );
+            }
+
+        batchMtx.unlock();
+
+        if( !spawn )
+            return;
+
+        ExportBatchWorker   *worker = new ExportBatchWorker;
+
+        worker->moveToThread( thread );
+
+        Connect( thread, SIGNAL(started()), worker, SLOT(run()) );
+        Connect( worker, SIGNAL(finished()), worker, SLOT(deleteLater()) );
+        Connect( worker, SIGNAL(destroyed()), thread, SLOT(quit()), Qt::DirectConnection );
+        Connect( thread, SIGNAL(finished()), thread, SLOT(deleteLater()) );
+
+        thread->start( QThread::LowPriority );
+    }
+}
+
+
+// Return default output name, made unique among this session's
+// jobs so that duplicate jobs on one file and span don't write
+// over each other.
+//
+static QString uniqueOutName( BatchJob &J, const QString &name )
+{
+    QMutexLocker    ml( &batchMtx );
+    QString         s = name;
+
+    foreach( BatchJob *Q, batchQ ) {
+
+        if( Q != &J && Q->resName == name ) {
+
+            QFileInfo   fi( name );
+
+            s = QString("%1/%2_job%3.%4")
+                    .arg( fi.absolutePath() )
+                    .arg( fi.completeBaseName() )
+                    .arg( J.id )
+                    .arg( fi.suffix() );
+            break;
+        }
+    }
+
+    J.resName = s;
+    return s;
+}
+
+
+// Open the job's file, resolve channels, span and output name,
+// then run the export.
+//
+static bool runJob( BatchJob &J )
+{
+    const ExportBatch::Spec &S = J.S;
+
+    QString     error;
+    DataFile    *df = DFOpenForRead( S.binName, error );
+
+    if( !df ) {
+        Error() << "Export job " << J.id << ": " << error;
+        return false;
+    }
+
+    ExportJob   E;
+    double      srate   = df->samplingRateHz();
+    qint64      scanCt  = df->scanCount();
+    int         nC      = df->numChans();
+    bool        ok      = false;
+
+// Channels
+
+    if( S.chans.isEmpty() || Subset::isAllChansStr( S.chans ) )
+        Subset::defaultBits( E.grfBits, nC );
+    else {
+
+        QVector<uint>   chans;
+
+        E.grfBits.fill( false, nC );
+
+        if( Subset::rngStr2Vec( chans, S.chans ) ) {
+
+            const QVector<uint> &src = df->channelIDs();
+
+            for( int ic = 0, n = chans.size(); ic < n; ++ic ) {
+
+                int idx = src.indexOf( chans[ic] );
+
+                if( idx >= 0 )
+                    E.grfBits.setBit( idx );
+            }
+        }
+    }
+
+// Span
+
+    E.scnFrom   = qBound( 0LL, qint64(S.t0 * srate + 0.5), scanCt );
+    E.scnTo     = (S.t1 < 0 ? scanCt :
+                    qBound( E.scnFrom, qint64(S.t1 * srate + 0.5), scanCt ));
+
+// Output
+
+    E.filename = S.outName;
+
+    if( E.filename.isEmpty() ) {
+
+        QFileInfo   fi( S.binName );
+
+        E.filename  = QString("%1/%2.exported.%3.%4")
+                        .arg( fi.absoluteDir().canonicalPath() )
+                        .arg( fi.baseName() )
+                        .arg( df->fileLblFromObj() )
+                        .arg( ExportJob::suffix( S.fmt ) );
+
+        E.filename = uniqueOutName( J, E.filename );
+    }
+    else {
+        QMutexLocker    ml( &batchMtx );
+        J.resName = E.filename;
+    }
+
+    if( !E.grfBits.count( true ) || E.scnTo <= E.scnFrom )
+        Error() << "Export job " << J.id << ": No channels or empty span.";
+    else {
+
+        E.df        = df;
+        E.budget    = &batchBudget;
+        E.fmt       = S.fmt;
+        E.fltZP     = S.fltZP;
+        E.zarrZ     = S.zarrZ;
+        E.fileGains();
+
+        BatchProgress   P( J );
+
+        ok = E.run( P );
+    }
+
+    delete df;
+    return ok;
+}
+
+/* ---------------------------------------------------------------- */
+/* ExportBatchWorker ---------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void ExportBatchWorker::run()
+{
+    for(;;) {
+
+        BatchJob    *J = 0;
+
+        batchMtx.lock();
+
+            foreach( BatchJob *Q, batchQ ) {
+
+                if( Q->state == BatchJob::queued ) {
+                    J = Q;
+                    break;
+                }
+            }
+
+            if( J )
+                J->state = BatchJob::running;
+            else
+                --batchThreads;
+
+        batchMtx.unlock();
+
+        if( !J )
+            break;
+
+        Log() << "Export job " << J->id << " started [" << J->S.binName << "].";
+
+        bool    ok = runJob( *J );
+
+        batchMtx.lock();
+
+            if( J->pleaseStop )
+                J->state = BatchJob::canceled;
+            else if( ok ) {
+                J->state    = BatchJob::done;
+                J->pct      = 100;
+            }
+            else
+                J->state = BatchJob::failed;
+
+            Log() << "Export job " << J->id << " " << stateName( J->state ) << ".";
+
+            trimFinished();
+
+        batchMtx.unlock();
+    }
+
+    emit finished();
+}
+
+/* ---------------------------------------------------------------- */
+/* ExportBatch ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Return job id.
+//
+int ExportBatch::add( const Spec &S )
+{
+    int id;
+
+    batchMtx.lock();
+        id = batchNextId++;
+        batchQ.push_back( new BatchJob( S, id ) );
+    batchMtx.unlock();
+
+    startWorkers();
+    return id;
+}
+
+
+// Cancel job id, or all jobs if (id < 0).
+// Return true if any queued or running job was canceled.
+//
+bool ExportBatch::cancel( int id )
+{
+    QMutexLocker    ml( &batchMtx );
+    bool            found = false;
+
+    foreach( BatchJob *J, batchQ ) {
+
+        if( id >= 0 && J->id != id )
+            continue;
+
+        if( J->state == BatchJob::queued ) {
+            J->state = BatchJob::canceled;
+            found    = true;
+        }
+        else if( J->state == BatchJob::running ) {
+            J->pleaseStop = true;
+            found         = true;
+        }
+    }
+
+    return found;
+}
+
+
+void ExportBatch::setLimits( int maxJobs, double MBps )
+{
+    batchMtx.lock();
+        batchLimit = qMax( 1, maxJobs );
+    batchMtx.unlock();
+
+    batchBudget.setMBps( MBps );
+    startWorkers();
+}
+
+
+QString ExportBatch::status()
+{
+    QMutexLocker    ml( &batchMtx );
+    QString         s;
+
+    foreach( BatchJob *J, batchQ ) {
+
+        s += QString("%1 %2 %3 %4\n")
+                .arg( J->id )
+                .arg( stateName( J->state ) )
+                .arg( J->pct.load() )
+                .arg( !J->resName.isEmpty() ? J->resName :
+                      (J->S.outName.isEmpty() ? J->S.binName : J->S.outName) );
+    }
+
+    return s;
+}
+
+
+// Cancel all jobs, then wait for each worker thread to exit.
+// Workers check pleaseStop at each progress update, so this
+// returns within one export chunk.
+//
+// Main thread only: deleteLater'd threads stay alive while
+// we block here, and QPointer drops those already gone.
+//
+void ExportBatch::shutdown()
+{
+    QList<QPointer<QThread> >   L;
+
+    cancel( -1 );
+
+    batchMtx.lock();
+        batchDown = true;
+        L = batchThreadL;
+        batchThreadL.clear();
+    batchMtx.unlock();
+
+    foreach( const QPointer<QThread> &T, L ) {
+
+        if( T )
+            T->wait();
+    }
+}
+
+
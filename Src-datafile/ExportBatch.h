@@ -0,0 +1,81 @@
+#ifndef EXPORTBATCH_H
+#define EXPORTBATCH_H
+
+#include <QObject>
+#include <QString>
+
+// Default count of jobs run at once.
+#define EXPORTBATCH_DEFJOBS 2
+
+// Finished job records kept for status().
+#define EXPORTBATCH_KEEP    100
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Worker runs queued jobs in order until none remain, then exits.
+//
+class ExportBatchWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    ExportBatchWorker() : QObject(0)    {}
+
+signals:
+    void finished();
+
+public slots:
+    void run();
+};
+
+
+// Process-wide queue of background exports, fed by the viewer's
+// export dialog and the command server, so a day's recordings
+// can be converted unattended.
+//
+// Each job names a bin file, a time span in seconds (t1 < 0 is
+// end of file), a channel-ID list (empty or "*" is all) and a
+// format; outName defaults to the viewer's export name, with
+// "_job<id>" appended if another job already resolved to that
+// name. Jobs open their own files and use the file's gains.
+//
+// Up to maxJobs run at once, each in its own thread, sharing
+// one ExportBudget read rate. status() lists one line per job:
+// "id state percent outName", state one of {queued, running,
+// done, failed, canceled}.
+//
+// shutdown() cancels everything and joins the worker threads;
+// the app calls it on quit. No new workers start afterward.
+//
+// All methods are thread-safe.
+//
+class ExportBatch
+{
+public:
+    struct Spec {
+        QString binName,
+                outName,
+                chans;
+        double  t0,
+                t1;
+        int     fmt;        // ExportJob::Format
+        bool    fltZP,
+                zarrZ;
+
+        Spec()
+        :   t0(0), t1(-1), fmt(0), fltZP(false), zarrZ(true)    {}
+    };
+
+public:
+    static int add( const Spec &S );
+    static bool cancel( int id );
+    static void setLimits( int maxJobs, double MBps );
+    static QString status();
+    static void shutdown();
+};
+
+#endif  // EXPORTBATCH_H
+
+
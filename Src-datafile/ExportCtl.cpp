@@ -2,24 +2,52 @@
 #include "ui_ExportDialog.h"
 
 #include "ExportCtl.h"
+#include "ExportBatch.h"
+#include "ExportJob.h"
 #include "Util.h"
 #include "ConfigCtl.h"
 #include "FileViewerWindow.h"
-#include "DataFileIMAP.h"
-#include "DataFileIMLF.h"
-#include "DataFileNI.h"
+#include "DataFile.h"
 #include "DFName.h"
 #include "Subset.h"
 
 #include <QButtonGroup>
 #include <QFileDialog>
 #include <QMessageBox>
+#include <QPushButton>
 #include <QProgressDialog>
 #include <QSettings>
 
 #include <math.h>
 
 
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Export progress shown in the modal dialog.
+//
+class ExportDlgProgress : public ExportProgress
+{
+private:
+    QProgressDialog &progress;
+    int             prevPerCent;
+
+public:
+    ExportDlgProgress( QProgressDialog &progress )
+    :   progress(progress), prevPerCent(-1)    {}
+
+    virtual bool update( int percent )
+    {
+        if( percent > prevPerCent )
+            progress.setValue( prevPerCent = percent );
+        else
+            guiBreathe();
+
+        return !progress.wasCanceled();
+    }
+};
+
 /* ---------------------------------------------------------------- */
 /* struct ExportParams -------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -27,7 +55,8 @@
 ExportCtl::ExportParams::ExportParams()
     :   inScnsMax(0), inScnSelFrom(-1), inScnSelTo(-1),
         inNG(0), scnFrom(-1), scnTo(-1),
-        fmtR(bin), grfR(sel), scnR(all)
+        fmtR(bin), grfR(sel), scnR(all), dnsmp(1),
+        fltZP(false), zarrZ(true), proc(false)
 {
 }
 
@@ -38,7 +67,7 @@ void ExportCtl::ExportParams::loadSettings( QSettings &S )
 
     fmtR = (Radio)S.value( "lastExportFormat", bin ).toInt();
 
-    if( fmtR < bin || fmtR > csv )
+    if( fmtR < bin || fmtR > zarr )
         fmtR = bin;
 
     grfR = (Radio)S.value( "lastExportChans", sel ).toInt();
@@ -46,6 +75,11 @@ void ExportCtl::ExportParams::loadSettings( QSettings &S )
     if( grfR < all || grfR > custom )
         grfR = sel;
 
+    fltZP = S.value( "lastExportZeroPhase", false ).toBool();
+    zarrZ = S.value( "lastExportZarrZlib", true ).toBool();
+    proc  = S.value( "lastExportProcessed", false ).toBool();
+    dnsmp = qBound( 1, S.value( "lastExportDnsmp", 1 ).toInt(), 100 );
+
     S.endGroup();
 }
 
@@ -56,10 +90,20 @@ void ExportCtl::ExportParams::saveSettings( QSettings &S ) const
 
     S.setValue( "lastExportFormat", fmtR );
     S.setValue( "lastExportChans", grfR );
+    S.setValue( "lastExportZeroPhase", fltZP );
+    S.setValue( "lastExportZarrZlib", zarrZ );
+    S.setValue( "lastExportProcessed", proc );
+    S.setValue( "lastExportDnsmp", dnsmp );
 
     S.endGroup();
 }
 
+
+QString ExportCtl::ExportParams::suffix() const
+{
+    return ExportJob::suffix( fmtR );
+}
+
 /* ---------------------------------------------------------------- */
 /* ExportCtl ------------------------------------------------------ */
 /* ---------------------------------------------------------------- */
@@ -78,6 +122,11 @@ ExportCtl::ExportCtl( QWidget *parent )
     ConnectUI( expUI->browseBut, SIGNAL(clicked()), this, SLOT(browseButClicked()) );
     ConnectUI( expUI->buttonBox, SIGNAL(accepted()), this, SLOT(okBut()) );
 
+    QPushButton *B = expUI->buttonBox->addButton(
+                        "&Queue", QDialogButtonBox::ActionRole );
+    B->setToolTip( "Run in background; see batch export status" );
+    ConnectUI( B, SIGNAL(clicked()), this, SLOT(queueBut()) );
+
 // -------------
 // button groups
 // -------------
@@ -87,6 +136,7 @@ ExportCtl::ExportCtl( QWidget *parent )
     bg = new QButtonGroup( this );
     bg->addButton( expUI->binRadio );
     bg->addButton( expUI->csvRadio );
+    bg->addButton( expUI->zarrRadio );
 
     bg = new QButtonGroup( this );
     bg->addButton( expUI->grfAllRadio );
@@ -104,6 +154,8 @@ ExportCtl::ExportCtl( QWidget *parent )
 
     ConnectUI( expUI->binRadio, SIGNAL(clicked()), this, SLOT(formatChanged()) );
     ConnectUI( expUI->csvRadio, SIGNAL(clicked()), this, SLOT(formatChanged()) );
+    ConnectUI( expUI->zarrRadio, SIGNAL(clicked()), this, SLOT(formatChanged()) );
+    ConnectUI( expUI->dnsmpSB, SIGNAL(valueChanged(int)), this, SLOT(procChanged()) );
 
 // --------------
 // graphs changed
@@ -145,7 +197,7 @@ void ExportCtl::initDataFile( const DataFile *df )
                     .arg( fi.absoluteDir().canonicalPath() )
                     .arg( fi.baseName() )
                     .arg( df->fileLblFromObj() )
-                    .arg( E.fmtR == ExportParams::bin ? "bin" : "csv" );
+                    .arg( E.suffix() );
 
     E.inNG      = df->numChans();
     E.inScnsMax = df->scanCount();
@@ -201,6 +253,7 @@ void ExportCtl::browseButClicked()
 
     types.push_back( "Binary File (*.bin)" );
     types.push_back( "CSV Text (*.csv *.txt)" );
+    types.push_back( "Zarr Store (*.zarr)" );
 
     f = QFileDialog::getSaveFileName(
             dlg,
@@ -217,10 +270,10 @@ void ExportCtl::browseButClicked()
         expUI->binRadio->setChecked( true );
     else if( suff == "csv" || suff == "txt" )
         expUI->csvRadio->setChecked( true );
-    else if( E.fmtR == ExportParams::bin )
-        f += ".bin";
+    else if( suff == "zarr" )
+        expUI->zarrRadio->setChecked( true );
     else
-        f += ".csv";
+        f += "." + E.suffix();
 
     expUI->filenameLE->setText( f );
 
@@ -230,11 +283,15 @@ void ExportCtl::browseButClicked()
 
 void ExportCtl::formatChanged()
 {
-    if( expUI->csvRadio->isChecked() )
+    if( expUI->zarrRadio->isChecked() )
+        E.fmtR = ExportParams::zarr;
+    else if( expUI->csvRadio->isChecked() )
         E.fmtR = ExportParams::csv;
     else
         E.fmtR = ExportParams::bin;
 
+    expUI->zarrCB->setEnabled( E.fmtR == ExportParams::zarr );
+
     QFileInfo   fi( expUI->filenameLE->text() );
 
     if( !fi.fileName().isEmpty() ) {
@@ -244,7 +301,7 @@ void ExportCtl::formatChanged()
             .arg( fi.absoluteDir().canonicalPath() )
             .arg( fi.baseName() )
             .arg( df->fileLblFromObj() )
-            .arg( E.fmtR == ExportParams::bin ? "bin" : "csv" ) );
+            .arg( E.suffix() ) );
     }
 
     estimateFileSize();
@@ -282,6 +339,12 @@ void ExportCtl::scansChanged()
 }
 
 
+void ExportCtl::procChanged()
+{
+    estimateFileSize();
+}
+
+
 void ExportCtl::okBut()
 {
     if( validateSettings() ) {
@@ -295,6 +358,55 @@ void ExportCtl::okBut()
 }
 
 
+// Hand current settings to the background batch queue.
+// Batch jobs read the file's own gains.
+//
+void ExportCtl::queueBut()
+{
+    if( validateSettings() ) {
+
+        if( E.proc || E.dnsmp > 1 ) {
+
+            QMessageBox::critical(
+                dlg,
+                "Processed Export Not Queued",
+                "Queued exports don't have the viewer's filters:\n"
+                "Uncheck 'Apply viewer filters', set 'Downsample by' 1,\n"
+                "or export now with OK." );
+            return;
+        }
+
+        STDSETTINGS( settings, "fileviewer" );
+        E.saveSettings( settings );
+
+        ExportBatch::Spec   S;
+        QVector<uint>       chans;
+        double              srate   = df->samplingRateHz();
+        const QVector<uint> &src    = df->channelIDs();
+
+        for( int i = 0; i < E.inNG; ++i ) {
+
+            if( E.grfBits.testBit( i ) )
+                chans.push_back( src[i] );
+        }
+
+        S.binName   = df->binFileName();
+        S.outName   = E.filename;
+        S.chans     = Subset::vec2RngStr( chans );
+        S.t0        = E.scnFrom / srate;
+        S.t1        = E.scnTo / srate;
+        S.fmt       = E.fmtR;
+        S.fltZP     = E.fltZP;
+        S.zarrZ     = E.zarrZ;
+
+        int id = ExportBatch::add( S );
+
+        Log() << "Export job " << id << " queued [" << E.filename << "].";
+        dlg->accept();
+    }
+}
+
+
 void ExportCtl::dialogFromParams()
 {
 // ----
@@ -307,11 +419,22 @@ void ExportCtl::dialogFromParams()
 // format
 // ------
 
-    if( E.fmtR == ExportParams::csv )
+    if( E.fmtR == ExportParams::zarr )
+        expUI->zarrRadio->setChecked( true );
+    else if( E.fmtR == ExportParams::csv )
         expUI->csvRadio->setChecked( true );
     else
         expUI->binRadio->setChecked( true );
 
+    expUI->zarrCB->setChecked( E.zarrZ );
+    expUI->zarrCB->setEnabled( E.fmtR == ExportParams::zarr );
+
+    expUI->fltCB->setChecked( E.fltZP );
+    expUI->fltCB->setEnabled( df->subtypeFromObj() != "imec.lf" );
+
+    expUI->procCB->setChecked( E.proc );
+    expUI->dnsmpSB->setValue( E.dnsmp );
+
 // ------
 // graphs
 // ------
@@ -485,8 +608,8 @@ void ExportCtl::estimateFileSize()
 // format
 // ------
 
-    if( E.fmtR == ExportParams::bin )
-        sampleBytes = sizeof(qint16);
+    if( E.fmtR != ExportParams::csv )
+        sampleBytes = sizeof(qint16);   // zarr uncompressed
     else
         sampleBytes = 8;    // estimated csv size
 
@@ -516,6 +639,8 @@ void ExportCtl::estimateFileSize()
     else
         nScans = E.inScnsMax;
 
+    nScans = (nScans + expUI->dnsmpSB->value() - 1) / expUI->dnsmpSB->value();
+
 // ------
 // report
 // ------
@@ -536,6 +661,20 @@ bool ExportCtl::validateSettings()
 // filename
 // --------
 
+    if( E.fmtR == ExportParams::zarr
+        && QFileInfo( fname ).exists()
+        && !QFileInfo( fname + "/.zgroup" ).exists() ) {
+
+        QMessageBox::critical(
+            dlg,
+            "Output Is Not A Zarr Store",
+            QString(
+            "Choose a new name or an existing Zarr store. '%1'")
+            .arg( QFileInfo( fname ).fileName() ) );
+
+        return false;
+    }
+
     if( QFileInfo( fname ).exists() ) {
 
         int yesNo = QMessageBox::question(
@@ -557,6 +696,11 @@ bool ExportCtl::validateSettings()
 // format
 // ------
 
+    E.fltZP = expUI->fltCB->isChecked();
+    E.zarrZ = expUI->zarrCB->isChecked();
+    E.proc  = expUI->procCB->isChecked();
+    E.dnsmp = expUI->dnsmpSB->value();
+
 // ------
 // graphs
 // ------
@@ -625,10 +769,39 @@ bool ExportCtl::validateSettings()
 }
 
 
+void ExportCtl::jobFromParams( ExportJob &J ) const
+{
+    J.df        = df;
+    J.filename  = E.filename;
+    J.grfBits   = E.grfBits;
+    J.scnFrom   = E.scnFrom;
+    J.scnTo     = E.scnTo;
+    J.fmt       = E.fmtR;
+    J.fltZP     = E.fltZP;
+    J.zarrZ     = E.zarrZ;
+    J.nSpk      = fvw->getSpikeChanCount( E.grfBits );
+
+    fvw->getInverseGains( J.invGain, E.grfBits );
+
+    // Viewer's zero-phase choice replaces its forward highpass
+
+    if( E.proc ) {
+
+        fvw->getExportChain( J.chain );
+
+        if( J.chain.hp300 && fvw->tbGetZeroPhase() ) {
+            J.chain.hp300   = false;
+            J.fltZP         = true;
+        }
+    }
+
+    J.chain.dnsmp = E.dnsmp;
+}
+
+
 void ExportCtl::doExport()
 {
-    qint64  nscans  = E.scnTo - E.scnFrom,
-            step    = qMin( 1000LL, nscans );
+    qint64  nscans  = E.scnTo - E.scnFrom;
 
     QProgressDialog progress(
         QString("Exporting %1 scans...").arg( nscans ),
@@ -641,12 +814,12 @@ void ExportCtl::doExport()
     progress.setWindowModality( Qt::WindowModal );
     progress.setMinimumDuration( 0 );
 
-    if( E.fmtR == ExportParams::bin ) {
+    ExportJob           J;
+    ExportDlgProgress   P( progress );
 
-        if( !exportAsBinary( progress, nscans, step ) )
-            return;
-    }
-    else if( !exportAsText( progress, nscans, step ) )
+    jobFromParams( J );
+
+    if( !J.run( P ) )
         return;
 
     progress.setValue( 100 );
@@ -658,153 +831,5 @@ void ExportCtl::doExport()
 }
 
 
-bool ExportCtl::exportAsBinary(
-    QProgressDialog &progress,
-    qint64          nscans,
-    qint64          step )
-{
-    vec_i16         scan;
-    DataFile        *out;
-    QVector<uint>   idxOtherChans;
-    int             prevPerCent = -1;
-    bool            ok = false;
-
-    if( df->subtypeFromObj() == "imec.ap" )
-        out = new DataFileIMAP( df->probeNum() );
-    else if( df->subtypeFromObj() == "imec.lf" )
-        out = new DataFileIMLF( df->probeNum() );
-    else
-        out = new DataFileNI;
-
-    Subset::bits2Vec( idxOtherChans, E.grfBits );
-
-    if( !out->openForExport( *df, E.filename, idxOtherChans ) ) {
-
-        Error() << "Could not open export file for write.";
-        goto exit;
-    }
-
-    out->setAsyncWriting( false );
-    out->setFirstSample( df->firstCt() + E.scnFrom );
-
-    for( qint64 i = 0; ; ) {
-
-        qint64  nread;
-        nread = df->readScans( scan, E.scnFrom + i, step, E.grfBits );
-
-        if( nread <= 0 )
-            break;
-
-        i += nread;
-
-        out->writeAndInvalScans( scan );
-
-        int progPerCent = int( 100 * i / nscans );
-
-        if( progPerCent > prevPerCent )
-            progress.setValue( prevPerCent = progPerCent );
-
-        if( progress.wasCanceled() ) {
-
-            QString f = out->binFileName(),
-                    m = out->metaFileName();
-
-            out->closeAndFinalize();
-            QFile::remove( f );
-            QFile::remove( m );
-            goto exit;
-        }
-
-        qint64  rem = nscans - i;
-
-        if( rem <= 0 )
-            break;
-
-        if( rem < step )
-            step = rem;
-    }
-
-    out->closeAndFinalize();
-    ok = true;
-
-exit:
-    delete out;
-    return ok;
-}
-
-
-bool ExportCtl::exportAsText(
-    QProgressDialog &progress,
-    qint64          nscans,
-    qint64          step )
-{
-    QFile   out( E.filename );
-
-    if( !out.open( QIODevice::WriteOnly | QIODevice::Text ) ) {
-        Error() << "Could not open export file for write.";
-        return false;
-    }
-
-    QTextStream         ts( &out );
-    vec_i16             scan;
-    std::vector<double> gain;
-
-    double  minV = df->vRange().rmin,
-            spnV = df->vRange().span(),
-            minS = double(df->streamFromObj() == "nidq" ?
-                    SHRT_MIN :
-                    // Handle 2.0 app opens 1.0 file
-                    -qMax(df->getParam("imMaxInt").toInt(), 512)),
-            spnU = double(-2 * minS),
-            sclV = spnV / spnU;
-    int     nOn  = E.grfBits.count( true ),
-            prevPerCent = -1;
-
-    fvw->getInverseGains( gain, E.grfBits );
-
-    for( qint64 i = 0; ; ) {
-
-        qint64  nread;
-        nread = df->readScans( scan, E.scnFrom + i, step, E.grfBits );
-
-        if( nread <= 0 )
-            break;
-
-        i += nread;
-
-        qint16  *S = &scan[0];
-
-        for( int is = 0; is < nread; ++is ) {
-
-            ts << gain[0] * (minV + sclV * (*S++ - minS));
-
-            for( int ic = 1; ic < nOn; ++ic )
-                ts << "," << gain[ic] * (minV + sclV * (*S++ - minS));
-
-            ts << "\n";
-        }
-
-        int progPerCent = int( 100 * i / nscans );
-
-        if( progPerCent > prevPerCent )
-            progress.setValue( prevPerCent = progPerCent );
-
-        if( progress.wasCanceled() ) {
-            out.close();
-            out.remove();
-            return false;
-        }
-
-        qint64  rem = nscans - i;
-
-        if( rem <= 0 )
-            break;
-
-        if( rem < step )
-            step = rem;
-    }
-
-    return true;
-}
 
 
@@ -1,6 +1,8 @@
 #ifndef EXPORTCTL_H
 #define EXPORTCTL_H
 
+#include "SGLTypes.h"
+
 #include <QObject>
 #include <QBitArray>
 #include <QString>
@@ -10,11 +12,11 @@ class ExportDialog;
 }
 
 class DataFile;
+class ExportJob;
 class FileViewerWindow;
 
 class QDialog;
 class QWidget;
-class QProgressDialog;
 class QSettings;
 
 /* ---------------------------------------------------------------- */
@@ -32,6 +34,7 @@ private:
             // format
             bin     = 0,
             csv     = 1,
+            zarr    = 2,
             // grf or scn
             all     = 0,
             sel     = 1,
@@ -53,10 +56,15 @@ private:
         Radio       fmtR,       // < from settings
                     grfR,       // < from settings
                     scnR;       // < from caller inputs
+        int         dnsmp;      // < from settings
+        bool        fltZP,      // < from settings
+                    zarrZ,      // < from settings
+                    proc;       // < from settings
 
         ExportParams();
         void loadSettings( QSettings &S );
         void saveSettings( QSettings &S ) const;
+        QString suffix() const;
     };
 
 private:
@@ -95,22 +103,17 @@ private slots:
     void formatChanged();
     void graphsChanged();
     void scansChanged();
+    void procChanged();
     void okBut();
+    void queueBut();
 
 private:
     void dialogFromParams();
     int customLE2Bits( QBitArray &bits, bool warn );
     void estimateFileSize();
     bool validateSettings();
+    void jobFromParams( ExportJob &J ) const;
     void doExport();
-    bool exportAsBinary(
-        QProgressDialog &progress,
-        qint64          nscans,
-        qint64          step );
-    bool exportAsText(
-        QProgressDialog &progress,
-        qint64          nscans,
-        qint64          step );
 };
 
 #endif  // EXPORTCTL_H
@@ -0,0 +1,1427 @@
+
+#include "ExportJob.h"
+#include "Util.h"
+#include "DataFileIMAP.h"
+#include "DataFileIMLF.h"
+#include "DataFileNI.h"
+#include "DataFile_Helpers.h"
+#include "DFDirIndex.h"
+#include "KVParams.h"
+#include "Subset.h"
+#include "Decimator.h"
+#include "CimCfg.h"
+#include "CniCfg.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Read n scans of the export subset at file scan (from).
+//
+// If hipass given, its leading nSpk channels are zero-phase
+// filtered, with up to BIQUAD_TRANS_WIDE neighbor scans read
+// each side so that consecutive blocks join seamlessly.
+//
+// Return scans read.
+//
+static qint64 readBlock(
+    vec_i16         &scan,
+    const DataFile  *df,
+    const QBitArray &grfBits,
+    qint64          from,
+    qint64          n,
+    Biquad          *hipass,
+    int             nSpk )
+{
+    if( !hipass )
+        return df->readScans( scan, from, n, grfBits );
+
+    int     nC      = grfBits.count( true ),
+            maxInt  = df->maxInt();
+    qint64  padL    = qMin( (qint64)BIQUAD_TRANS_WIDE, from ),
+            padR    = qBound( 0LL,
+                        (qint64)df->scanCount() - from - n,
+                        (qint64)BIQUAD_TRANS_WIDE ),
+            nread;
+
+    nread = df->readScans( scan, from - padL, padL + n + padR, grfBits );
+
+    if( nread <= padL )
+        return 0;
+
+    hipass->applyZeroPhase(
+        &scan[0], maxInt, nread, nC, 0, nSpk, getNProcessors() );
+
+    scan.erase( scan.begin(), scan.begin() + padL * nC );
+    nread = qMin( nread - padL, n );
+    scan.resize( nread * nC );
+
+    return nread;
+}
+
+
+// Notch channel group [J.i0, J.iLim) through its own cascade.
+//
+static void notchJob( const BiquadJob &J )
+{
+    ((BiquadCascade*)J.ctx)->applyBlockwiseMem(
+        J.data, J.maxInt, J.ntpts, J.nchans, J.i0, J.iLim );
+}
+
+
+struct LocalRef {
+    const std::vector<std::vector<int> >    *T;
+    const qint16                            *src;
+    qint16                                  *dst;
+    int                                     ntpts,
+                                            nC;
+};
+
+
+// Local -<S> of spike channels [J.i0, J.iLim): each value less
+// its neighbors' mean, as the viewer does, all taken from the
+// unreferenced copy.
+//
+static void localRefJob( const BiquadJob &J )
+{
+    const LocalRef  *L = (const LocalRef*)J.ctx;
+
+    for( int ig = J.i0; ig < J.iLim; ++ig ) {
+
+        const std::vector<int>  &V  = (*L->T)[ig];
+        int                     nv  = V.size();
+
+        if( !nv )
+            continue;
+
+        const qint16    *S = L->src;
+        qint16          *D = L->dst + ig;
+        const int       *v = &V[0];
+
+        for( int it = 0; it < L->ntpts; ++it, S += L->nC, D += L->nC ) {
+
+            int sum = 0;
+
+            for( int iv = 0; iv < nv; ++iv )
+                sum += S[v[iv]];
+
+            *D = S[ig] - sum/nv;
+        }
+    }
+}
+
+
+static bool writeJson( const QString &path, const QJsonObject &o )
+{
+    QFile       f( path );
+    QByteArray  B = QJsonDocument( o ).toJson();
+
+    return f.open( QIODevice::WriteOnly | QIODevice::Truncate )
+            && f.write( B ) == B.size();
+}
+
+/* ---------------------------------------------------------------- */
+/* ExportBudget --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void ExportBudget::setMBps( double MBps )
+{
+    QMutexLocker    ml( &mtx );
+
+    bytesPerSec = qMax( 0.0, MBps ) * 1024 * 1024;
+    tNext       = 0;
+}
+
+
+double ExportBudget::MBps()
+{
+    QMutexLocker    ml( &mtx );
+    return bytesPerSec / (1024 * 1024);
+}
+
+
+void ExportBudget::take( qint64 bytes )
+{
+    double  wait;
+
+    mtx.lock();
+
+        if( bytesPerSec <= 0 ) {
+            mtx.unlock();
+            return;
+        }
+
+        double  tNow    = getTime(),
+                t0      = qMax( tNext, tNow );
+
+        tNext   = t0 + bytes / bytesPerSec;
+        wait    = t0 - tNow;
+
+    mtx.unlock();
+
+    if( wait > 0 )
+        QThread::usleep( qint64(1e6 * wait) );
+}
+
+/* ---------------------------------------------------------------- */
+/* ExportPipe ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Return false if stopped.
+//
+bool ExportPipe::put( vec_i16 &blk )
+{
+    QMutexLocker    ml( &mtx );
+
+    while( !pleaseStop && Q.size() >= EXPORT_MAXBLKS )
+        condPut.wait( &mtx );
+
+    if( pleaseStop )
+        return false;
+
+    Q.push_back( vec_i16() );
+    Q.back().swap( blk );
+    condTake.wakeAll();
+    return true;
+}
+
+
+// Return true if a block was taken.
+//
+bool ExportPipe::take( vec_i16 &blk, int ms, quint64 *seq )
+{
+    QMutexLocker    ml( &mtx );
+
+    if( Q.empty() && !eof )
+        condTake.wait( &mtx, ms );
+
+    if( Q.empty() )
+        return false;
+
+    blk.swap( Q.front() );
+    Q.pop_front();
+
+    if( seq )
+        *seq = nTaken;
+
+    ++nTaken;
+    condPut.wakeAll();
+    return true;
+}
+
+
+void ExportPipe::finish()
+{
+    QMutexLocker    ml( &mtx );
+
+    eof = true;
+    condTake.wakeAll();
+}
+
+
+void ExportPipe::stop()
+{
+    QMutexLocker    ml( &mtx );
+
+    pleaseStop = true;
+    Q.clear();
+    condPut.wakeAll();
+}
+
+
+bool ExportPipe::isStopped()
+{
+    QMutexLocker    ml( &mtx );
+    return pleaseStop;
+}
+
+
+// True if reader is done and every block taken.
+//
+bool ExportPipe::isDrained()
+{
+    QMutexLocker    ml( &mtx );
+    return eof && Q.empty();
+}
+
+/* ---------------------------------------------------------------- */
+/* ExportReader --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+ExportReader::ExportReader(
+    ExportPipe          &pipe,
+    ExportBudget        *budget,
+    const QString       &binName,
+    const QBitArray     &grfBits,
+    Biquad              *hipass,
+    const ExportChain   &chain,
+    int                 nSpk,
+    qint64              from,
+    qint64              nscans,
+    qint64              step )
+    :   QObject(0), pipe(pipe), budget(budget), binName(binName),
+        grfBits(grfBits), chain(chain), hipass(hipass), hpFwd(0),
+        dec(0), from(from), nscans(nscans), step(step), nPicked(0),
+        nSpk(nSpk), maxInt(0)
+{
+}
+
+
+ExportReader::~ExportReader()
+{
+    if( hipass )
+        delete hipass;
+
+    if( hpFwd )
+        delete hpFwd;
+
+    if( dec )
+        delete dec;
+}
+
+
+// Full-width chains read every channel, then filter, reference
+// and subset; (input) blocks are step * dnsmp scans.
+//
+void ExportReader::run()
+{
+    QString     error;
+    DataFile    *rdf = DFOpenForRead( binName, error );
+
+    if( !rdf )
+        Error() << "Export could not open [" << binName << "]: " << error;
+    else {
+
+        QBitArray   rdBits  = grfBits;
+        qint64      rdStep  = step * chain.dnsmp;
+        int         nSpkRd  = nSpk;
+        bool        ok      = true;
+
+        initChain( rdf );
+
+        if( !iKeep.isEmpty() ) {
+            Subset::defaultBits( rdBits, rdf->numChans() );
+            nSpkRd = chain.nSpk;
+        }
+
+        for( qint64 i = 0; ok && i < nscans && !pipe.isStopped(); ) {
+
+            vec_i16 scan;
+            qint64  nread,
+                    n = qMin( rdStep, nscans - i );
+
+            if( budget )
+                budget->take( n * rdf->numChans() * sizeof(qint16) );
+
+            nread = readBlock( scan, rdf, rdBits, from + i, n, hipass, nSpkRd );
+
+            if( nread <= 0 )
+                break;
+
+            i += nread;
+
+            if( !iKeep.isEmpty() ) {
+                filter( scan, nread );
+                reference( scan, nread );
+                Subset::subset( scan, scan, iKeep, rdf->numChans() );
+            }
+
+            if( dec ) {
+                decimate( scan, nread );
+                ok = putOut( false );
+            }
+            else
+                ok = pipe.put( scan );
+        }
+
+        if( ok && dec && !pipe.isStopped() ) {
+
+            vec_i16 none;
+
+            decimate( none, 0 );
+            putOut( true );
+        }
+
+        delete rdf;
+    }
+
+    pipe.finish();
+    emit finished();
+}
+
+
+// Make filters and decimator. Forward filters settle on up
+// to EXPORT_LEADSECS of data ahead of the span, so the export
+// starts without their transient.
+//
+void ExportReader::initChain( const DataFile *rdf )
+{
+    int nC = rdf->numChans();
+
+    maxInt = rdf->maxInt();
+
+    if( chain.isFullWidth() )
+        Subset::bits2Vec( iKeep, grfBits );
+
+    if( chain.hp300 && chain.nSpk > 0 && !hipass ) {
+        hpFwd = new Biquad(
+                    bq_type_highpass, 300 / rdf->samplingRateHz() );
+    }
+
+    if( chain.notchHz > 0 && chain.nNeu > 0 ) {
+
+        int nGrp = qBound(
+                    1, chain.nNeu / EXPORT_GRPCHANS,
+                    BiquadPool::pool().nWorkers() + 1 );
+
+        notch.resize( nGrp );
+
+        for( int ig = 0; ig < nGrp; ++ig ) {
+            notch[ig].addBand(
+                BiquadBand( 0, 0, chain.notchHz, BIQUAD_NOTCH_NHARM ),
+                rdf->samplingRateHz() );
+        }
+    }
+
+    if( chain.dnsmp > 1 )
+        dec = new Decimator( chain.dnsmp, grfBits.count( true ) );
+
+// Settle
+
+    qint64  lead = qMin( from,
+                    qint64(EXPORT_LEADSECS * rdf->samplingRateHz()) );
+
+    if( lead > 0 && (hpFwd || !notch.empty()) ) {
+
+        vec_i16 scan;
+        qint64  nread;
+
+        if( budget )
+            budget->take( lead * nC * sizeof(qint16) );
+
+        nread = rdf->readScans( scan, from - lead, lead, QBitArray() );
+
+        if( nread > 0 )
+            filter( scan, nread );
+    }
+}
+
+
+// Forward highpass, then notches, on whole scans; channels
+// are split into groups across the filter pool.
+//
+void ExportReader::filter( vec_i16 &scan, int ntpts )
+{
+    int nC = scan.size() / ntpts;
+
+    if( hpFwd ) {
+        hpFwd->applyBlockwiseThd(
+            &scan[0], maxInt, ntpts, nC, 0, chain.nSpk,
+            getNProcessors() );
+    }
+
+    int nGrp = notch.size();
+
+    if( !nGrp )
+        return;
+
+    std::vector<BiquadJob>  jobs( nGrp );
+    int                     remain = nGrp;
+
+    for( int ig = 0; ig < nGrp; ++ig ) {
+
+        BiquadJob   &J = jobs[ig];
+
+        J.fn        = notchJob;
+        J.ctx       = &notch[ig];
+        J.data      = &scan[0];
+        J.maxInt    = maxInt;
+        J.ntpts     = ntpts;
+        J.nchans    = nC;
+        J.i0        = ig * chain.nNeu / nGrp;
+        J.iLim      = (ig + 1) * chain.nNeu / nGrp;
+        J.remain    = &remain;
+    }
+
+    BiquadPool::pool().runBatch( jobs );
+}
+
+
+// -<S> on whole scans: global in one SIMD pass, local split
+// into channel groups across the filter pool.
+//
+void ExportReader::reference( vec_i16 &scan, int ntpts )
+{
+    int nC = scan.size() / ntpts;
+
+    if( !chain.gRef.isEmpty() ) {
+        chain.gRef.apply( &scan[0], ntpts, nC, 1 );
+        return;
+    }
+
+    int nL = qMin( int(chain.lRef.size()), chain.nSpk );
+
+    if( nL <= 0 )
+        return;
+
+    vec_i16     src( scan );
+    LocalRef    L;
+    int         nThd = qBound(
+                        1, nL / EXPORT_GRPCHANS,
+                        BiquadPool::pool().nWorkers() + 1 ),
+                remain = nThd;
+
+    L.T     = &chain.lRef;
+    L.src   = &src[0];
+    L.dst   = &scan[0];
+    L.ntpts = ntpts;
+    L.nC    = nC;
+
+    std::vector<BiquadJob>  jobs( nThd );
+
+    for( int i = 0; i < nThd; ++i ) {
+
+        BiquadJob   &J = jobs[i];
+
+        J.fn        = localRefJob;
+        J.ctx       = &L;
+        J.i0        = i * nL / nThd;
+        J.iLim      = (i + 1) * nL / nThd;
+        J.remain    = &remain;
+    }
+
+    BiquadPool::pool().runBatch( jobs );
+}
+
+
+// Append decimated subset scans to out; ntpts = 0 flushes.
+// Digital words are taken, not filtered: output m gets input
+// scan m * dnsmp, the first of the bin it's centered on.
+//
+void ExportReader::decimate( vec_i16 &scan, int ntpts )
+{
+    vec_i16 D;
+    int     nC  = dec->nChans(),
+            nD  = qMin( chain.nDig, nC ),
+            R   = chain.dnsmp,
+            n;
+
+    if( nD > 0 && ntpts > 0 ) {
+
+        const qint16    *S = &scan[nC - nD];
+
+        for( int it = 0; it < ntpts; ++it, S += nC ) {
+
+            if( (nPicked + it) % R == 0 )
+                dig.insert( dig.end(), S, S + nD );
+        }
+    }
+
+    nPicked += ntpts;
+
+    n = (ntpts ? dec->apply( D, &scan[0], ntpts ) : dec->finish( D ));
+
+    if( n <= 0 )
+        return;
+
+    if( nD > 0 ) {
+
+        n = qMin( n, int(dig.size()) / nD );
+
+        for( int im = 0; im < n; ++im )
+            memcpy( &D[im*nC + nC - nD], &dig[im*nD], nD * sizeof(qint16) );
+
+        dig.erase( dig.begin(), dig.begin() + n * nD );
+    }
+
+    out.insert( out.end(), D.begin(), D.begin() + n * nC );
+}
+
+
+// Put out in blocks of step scans; all = also a short last one.
+//
+bool ExportReader::putOut( bool all )
+{
+    qint64  blk = step * dec->nChans();
+
+    while( qint64(out.size()) >= blk || (all && !out.empty()) ) {
+
+        qint64  n = qMin( blk, qint64(out.size()) );
+        vec_i16 B( out.begin(), out.begin() + n );
+
+        out.erase( out.begin(), out.begin() + n );
+
+        if( !pipe.put( B ) )
+            return false;
+    }
+
+    return true;
+}
+
+/* ---------------------------------------------------------------- */
+/* ExportText ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+ExportText::ExportText(
+    ExportPipe                  &pipe,
+    const std::vector<double>   &gain,
+    double                      minV,
+    double                      sclV,
+    double                      minS,
+    int                         nWorkers )
+    :   pipe(pipe), nNext(0), nRunning(nWorkers),
+        nAhead(2 * nWorkers), pleaseStop(false)
+{
+    int     nC      = gain.size();
+    double  maxS    = -minS - 1;
+
+    k.resize( nC );
+    o.resize( nC );
+    p10.resize( nC );
+    dec.resize( nC );
+
+    for( int ic = 0; ic < nC; ++ic ) {
+
+        double  vMax;
+        int     d = 0;
+
+        k[ic]   = gain[ic] * sclV;
+        o[ic]   = gain[ic] * (minV - sclV * minS);
+        vMax    = qMax( fabs( o[ic] + k[ic] * minS ), fabs( o[ic] + k[ic] * maxS ) );
+
+        if( vMax > 0 )
+            d = qBound( 0, 6 - int(ceil( log10( vMax ) )), 15 );
+
+        dec[ic] = d;
+        p10[ic] = 1;
+
+        while( d-- > 0 )
+            p10[ic] *= 10;
+
+        k[ic]   *= p10[ic];
+        o[ic]   *= p10[ic];
+    }
+}
+
+
+// Return true if block nNext was taken.
+//
+bool ExportText::next( QByteArray &txt, qint64 &nScans, int ms )
+{
+    QMutexLocker    ml( &doneMtx );
+
+    if( !done.contains( nNext ) && nRunning )
+        condDone.wait( &doneMtx, ms );
+
+    QMap<quint64,Blk>::iterator it = done.find( nNext );
+
+    if( it == done.end() )
+        return false;
+
+    txt.swap( it->txt );
+    nScans = it->nScans;
+    done.erase( it );
+    ++nNext;
+    condRoom.wakeAll();
+    return true;
+}
+
+
+// True if formatters are done and every block taken.
+//
+bool ExportText::isDrained()
+{
+    QMutexLocker    ml( &doneMtx );
+    return !nRunning && done.isEmpty();
+}
+
+
+void ExportText::stop()
+{
+    QMutexLocker    ml( &doneMtx );
+
+    pleaseStop = true;
+    condRoom.wakeAll();
+}
+
+
+bool ExportText::take( vec_i16 &blk, quint64 &seq )
+{
+    while( !pleaseStop ) {
+
+        if( pipe.take( blk, 50, &seq ) )
+            return true;
+
+        if( pipe.isDrained() )
+            break;
+    }
+
+    return false;
+}
+
+
+// The block the consumer wants next never waits.
+//
+void ExportText::put( Blk &B, quint64 seq )
+{
+    QMutexLocker    ml( &doneMtx );
+
+    while( !pleaseStop && seq >= nNext + nAhead )
+        condRoom.wait( &doneMtx );
+
+    if( pleaseStop )
+        return;
+
+    Blk &D = done[seq];
+
+    D.txt.swap( B.txt );
+    D.nScans = B.nScans;
+    condDone.wakeAll();
+}
+
+
+void ExportText::format( Blk &B, const vec_i16 &blk ) const
+{
+    int     nC  = k.size(),
+            nS  = blk.size() / nC;
+
+    B.nScans = nS;
+    B.txt.resize( nS * (nC * 24 + 1) );
+
+    const qint16    *S = &blk[0];
+    char            *p0 = B.txt.data(),
+                    *p  = p0;
+
+    for( int is = 0; is < nS; ++is ) {
+
+        for( int ic = 0; ic < nC; ++ic ) {
+
+            qint64  q = qint64(floor( o[ic] + k[ic] * *S++ + 0.5 ));
+            char    ip[24];
+            int     ni = 0;
+
+            if( ic )
+                *p++ = ',';
+
+            if( q < 0 ) {
+                *p++ = '-';
+                q = -q;
+            }
+
+            qint64  iv = q / p10[ic],
+                    fv = q - iv * p10[ic];
+
+            do {
+                ip[ni++] = char('0' + iv % 10);
+                iv /= 10;
+            } while( iv );
+
+            while( ni )
+                *p++ = ip[--ni];
+
+            if( int d = dec[ic] ) {
+
+                *p++ = '.';
+
+                for( int id = d - 1; id >= 0; --id ) {
+                    p[id] = char('0' + fv % 10);
+                    fv /= 10;
+                }
+
+                p += d;
+            }
+        }
+
+        *p++ = '\n';
+    }
+
+    B.txt.resize( p - p0 );
+}
+
+
+void ExportText::workerExit()
+{
+    QMutexLocker    ml( &doneMtx );
+
+    --nRunning;
+    condDone.wakeAll();
+}
+
+/* ---------------------------------------------------------------- */
+/* ExportTextWorker ----------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void ExportTextWorker::run()
+{
+    vec_i16 blk;
+    quint64 seq;
+
+    while( T.take( blk, seq ) ) {
+
+        ExportText::Blk B;
+
+        T.format( B, blk );
+        T.put( B, seq );
+    }
+
+    T.workerExit();
+    emit finished();
+}
+
+/* ---------------------------------------------------------------- */
+/* ExportZarr ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+bool ExportZarr::writeRow( const vec_i16 &blk, quint64 row )
+{
+    int     nS      = blk.size() / nC,
+            nG      = (nC + chunkChans - 1) / chunkChans;
+    vec_i16 chunk( chunkScans * chunkChans );
+
+    for( int g = 0; g < nG; ++g ) {
+
+        int c0 = g * chunkChans,
+            nc = qMin( chunkChans, nC - c0 );
+
+        if( nS < chunkScans || nc < chunkChans )
+            std::fill( chunk.begin(), chunk.end(), 0 );
+
+        const qint16    *S = &blk[c0];
+        qint16          *D = &chunk[0];
+
+        for( int is = 0; is < nS; ++is, S += nC, D += chunkChans )
+            memcpy( D, S, nc * sizeof(qint16) );
+
+        QByteArray  B( (const char*)&chunk[0], chunk.size() * sizeof(qint16) );
+
+        // qCompress prepends a 4-byte length to the zlib stream
+
+        if( level >= 0 )
+            B = qCompress( B, level ).mid( 4 );
+
+        QFile   f( QString("%1/%2.%3").arg( arrDir ).arg( row ).arg( g ) );
+
+        if( !f.open( QIODevice::WriteOnly | QIODevice::Truncate )
+            || f.write( B ) != B.size() ) {
+
+            return false;
+        }
+    }
+
+    nScans += nS;
+    return true;
+}
+
+/* ---------------------------------------------------------------- */
+/* ExportZarrWorker ----------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void ExportZarrWorker::run()
+{
+    vec_i16 blk;
+    quint64 row;
+
+    while( !Z.pleaseStop ) {
+
+        if( Z.pipe.take( blk, 50, &row ) ) {
+
+            if( !Z.writeRow( blk, row ) ) {
+                Z.failed = true;
+                break;
+            }
+        }
+        else if( Z.pipe.isDrained() )
+            break;
+    }
+
+    --Z.nRunning;
+    emit finished();
+}
+
+/* ---------------------------------------------------------------- */
+/* ExportJob ------------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+QString ExportJob::suffix( int fmt )
+{
+    if( fmt == zarr )
+        return "zarr";
+    else if( fmt == csv )
+        return "csv";
+
+    return "bin";
+}
+
+
+// Gains and spike channels from the file's own meta data,
+// matching what a viewer of the file starts with. Spike
+// channels (AP, or NI MN) lead the file's channel order.
+//
+void ExportJob::fileGains()
+{
+    const QVector<uint> &src    = df->channelIDs();
+    int                 nSpkMax = df->cumTypCnt()[0];
+    bool                isLF    = df->subtypeFromObj() == "imec.lf";
+
+    invGain.clear();
+    nSpk = 0;
+
+    for( int ic = 0, nC = grfBits.size(); ic < nC; ++ic ) {
+
+        if( grfBits.testBit( ic ) ) {
+
+            invGain.push_back( 1.0 / df->origID2Gain( src[ic] ) );
+
+            if( !isLF && int(src[ic]) < nSpkMax )
+                ++nSpk;
+        }
+    }
+}
+
+
+// Exporters get the count of output (decimated) scans.
+//
+bool ExportJob::run( ExportProgress &P )
+{
+    qint64  nscans = scnTo - scnFrom;
+
+    if( !df || nscans <= 0 || !grfBits.count( true ) )
+        return false;
+
+    chain.dnsmp = qMax( 1, chain.dnsmp );
+    nscans      = (nscans + chain.dnsmp - 1) / chain.dnsmp;
+
+// Digital words trail the subset
+
+    const QVector<uint> &src    = df->channelIDs();
+    int                 digID   = df->cumTypCnt()[
+                                    df->streamFromObj() == "nidq" ?
+                                    CniCfg::niSumAnalog :
+                                    CimCfg::imSumNeural];
+
+    chain.nDig = 0;
+
+    for( int ic = 0, nC = grfBits.size(); ic < nC; ++ic ) {
+
+        if( grfBits.testBit( ic ) && int(src[ic]) >= digID )
+            ++chain.nDig;
+    }
+
+    if( fmt == bin )
+        return exportAsBinary( P, nscans );
+    else if( fmt == zarr )
+        return exportAsZarr( P, nscans );
+
+    return exportAsText( P, nscans );
+}
+
+
+double ExportJob::outRate() const
+{
+    return df->samplingRateHz() / chain.dnsmp;
+}
+
+
+// Summary of applied processing for output meta data,
+// e.g., "hp300,notch60,sref=global,dnsmp=4"; empty if none.
+//
+QString ExportJob::processing() const
+{
+    QStringList L;
+
+    if( isZeroPhase() )
+        L << "hp300zp";
+    else if( chain.hp300 )
+        L << "hp300";
+
+    if( chain.notchHz > 0 )
+        L << QString("notch%1").arg( chain.notchHz );
+
+    if( !chain.gRef.isEmpty() )
+        L << "sref=global";
+    else if( !chain.lRef.empty() )
+        L << "sref=local";
+
+    if( chain.dnsmp > 1 )
+        L << QString("dnsmp=%1").arg( chain.dnsmp );
+
+    return L.join( "," );
+}
+
+
+// Full-width chains filter the file's spike channels even
+// if none are exported (they feed -<S>).
+//
+bool ExportJob::isZeroPhase() const
+{
+    return fltZP
+            && (chain.isFullWidth() ? chain.nSpk : nSpk)
+            && df->subtypeFromObj() != "imec.lf";
+}
+
+
+// Return 300 Hz highpass if user wants filtered export, else 0.
+//
+Biquad *ExportJob::newHipass() const
+{
+    if( !isZeroPhase() )
+        return 0;
+
+    return new Biquad( bq_type_highpass, 300 / df->samplingRateHz() );
+}
+
+
+// Start an ExportReader over the export range; it owns hipass.
+//
+QThread *ExportJob::startReader(
+    ExportPipe  &pipe,
+    Biquad      *hipass,
+    qint64      step ) const
+{
+    QThread         *thread = new QThread;
+    ExportReader    *worker = new ExportReader(
+                                pipe, budget, df->binFileName(), grfBits,
+                                hipass, chain, nSpk, scnFrom,
+                                scnTo - scnFrom, step );
+
+    worker->moveToThread( thread );
+
+    Connect( thread, SIGNAL(started()), worker, SLOT(run()) );
+    Connect( worker, SIGNAL(finished()), worker, SLOT(deleteLater()) );
+    Connect( worker, SIGNAL(destroyed()), thread, SLOT(quit()), Qt::DirectConnection );
+
+    thread->start();
+    return thread;
+}
+
+
+// Pipeline: ExportReader thread reads, subsets and filters
+// blocks into a bounded ExportPipe; this thread hands them
+// to the output file's async writer, whose own threads write
+// and hash. The writer is fed only while its queue is short,
+// so memory stays bounded at any file length, and progress
+// stays live throughout.
+//
+bool ExportJob::exportAsBinary( ExportProgress &P, qint64 nscans )
+{
+    ExportPipe      pipe;
+    DataFile        *out;
+    QThread         *thread = 0;
+    QVector<uint>   idxOtherChans;
+    qint64          i       = 0,
+                    step;
+    int             nC      = grfBits.count( true );
+    Biquad          *hipass = newHipass();
+    bool            ok      = false;
+
+    if( df->subtypeFromObj() == "imec.ap" )
+        out = new DataFileIMAP( df->probeNum() );
+    else if( df->subtypeFromObj() == "imec.lf" )
+        out = new DataFileIMLF( df->probeNum() );
+    else
+        out = new DataFileNI;
+
+    Subset::bits2Vec( idxOtherChans, grfBits );
+
+    if( !out->openForExport( *df, filename, idxOtherChans ) ) {
+
+        Error() << "Could not open export file for write.";
+
+        if( hipass )
+            delete hipass;
+
+        goto exit;
+    }
+
+    out->setAsyncWriting( true );
+    out->setFirstSample( (df->firstCt() + scnFrom) / chain.dnsmp );
+
+    if( chain.dnsmp > 1 )
+        out->setSampleRate( outRate() );
+
+    if( !processing().isEmpty() )
+        out->setParam( "exportProcessing", processing() );
+
+// -----
+// Start
+// -----
+
+    step    = qBound( 1LL,
+                qint64(EXPORT_BLKSECS * outRate()), nscans );
+    thread  = startReader( pipe, hipass, step );
+
+// -----
+// Write
+// -----
+
+    for(;;) {
+
+        vec_i16 scan;
+
+        if( out->percentFull() < EXPORT_WRMAXPCT && pipe.take( scan, 50 ) ) {
+
+            i += scan.size() / nC;
+
+            if( !out->writeAndInvalScans( scan ) )
+                break;
+        }
+        else if( pipe.isDrained() ) {
+            ok = true;
+            break;
+        }
+        else
+            QThread::msleep( 5 );
+
+        if( !P.update( int( 100 * i / nscans ) ) )
+            break;
+    }
+
+// ------
+// Finish
+// ------
+
+// worker object auto-deleted asynchronously
+// thread object manually deleted synchronously (so we can call wait())
+
+    pipe.stop();
+    thread->wait();
+    delete thread;
+
+    if( ok && i < nscans )
+        Warning() << "Export read " << i << " of " << nscans << " scans.";
+
+    if( !out->closeAndFinalize() )
+        ok = false;
+
+    if( !ok ) {
+
+        QFile::remove( out->binFileName() );
+        QFile::remove( out->metaFileName() );
+    }
+
+exit:
+    delete out;
+    return ok;
+}
+
+
+// Same reader as binary export, then ExportText formats blocks
+// on several threads; this thread writes them in order.
+//
+bool ExportJob::exportAsText( ExportProgress &P, qint64 nscans )
+{
+    QFile   out( filename );
+
+    if( !out.open( QIODevice::WriteOnly | QIODevice::Text ) ) {
+        Error() << "Could not open export file for write.";
+        return false;
+    }
+
+    ExportPipe              pipe;
+    std::vector<QThread*>   vT;
+
+    double  minV = df->vRange().rmin,
+            spnV = df->vRange().span(),
+            minS = double(-df->maxInt()),
+            spnU = double(-2 * minS),
+            sclV = spnV / spnU;
+    qint64  i    = 0,
+            step;
+    int     nOn  = grfBits.count( true ),
+            nThd = qBound( 1, getNProcessors() - 1, EXPORT_MAXTHDS );
+    bool    ok   = false;
+
+    ExportText  T( pipe, invGain, minV, sclV, minS, nThd );
+
+// -----
+// Start
+// -----
+
+    step = qBound( 1LL, qint64(EXPORT_TXTSAMPS / nOn), nscans );
+
+    QThread *thread = startReader( pipe, newHipass(), step );
+
+    for( int it = 0; it < nThd; ++it ) {
+
+        QThread             *fThread = new QThread;
+        ExportTextWorker    *worker  = new ExportTextWorker( T );
+
+        worker->moveToThread( fThread );
+
+        Connect( fThread, SIGNAL(started()), worker, SLOT(run()) );
+        Connect( worker, SIGNAL(finished()), worker, SLOT(deleteLater()) );
+        Connect( worker, SIGNAL(destroyed()), fThread, SLOT(quit()), Qt::DirectConnection );
+
+        fThread->start();
+        vT.push_back( fThread );
+    }
+
+// -----
+// Write
+// -----
+
+    for(;;) {
+
+        QByteArray  txt;
+        qint64      n;
+
+        if( T.next( txt, n, 50 ) ) {
+
+            if( out.write( txt ) != txt.size() ) {
+                Error() << "Export file writing error.";
+                break;
+            }
+
+            i += n;
+        }
+        else if( T.isDrained() ) {
+            ok = true;
+            break;
+        }
+
+        if( !P.update( int( 100 * i / nscans ) ) )
+            break;
+    }
+
+// ------
+// Finish
+// ------
+
+// worker objects auto-deleted asynchronously
+// thread objects manually deleted synchronously (so we can call wait())
+
+    T.stop();
+    pipe.stop();
+
+    for( int it = 0; it < nThd; ++it ) {
+        vT[it]->wait();
+        delete vT[it];
+    }
+
+    thread->wait();
+    delete thread;
+
+    if( ok && i < nscans )
+        Warning() << "Export read " << i << " of " << nscans << " scans.";
+
+    out.close();
+
+    if( !ok )
+        out.remove();
+
+    return ok;
+}
+
+// Zarr v2 store (directory) holding group attributes and
+// array "traces" [scans, channels] of int16, chunked by
+// EXPORT_ZARRSECS by EXPORT_ZARRCHANS and (optionally) zlib
+// compressed. Group attributes carry the source meta data
+// and per-channel volts = offset + sample * volts_per_bit.
+//
+// Reading and filtering are the same as binary export; chunk
+// rows are compressed and written by several ExportZarrWorker
+// threads at once.
+//
+bool ExportJob::exportAsZarr( ExportProgress &P, qint64 nscans )
+{
+// -----------
+// Fresh store
+// -----------
+
+    QDir    D( filename );
+
+    if( D.exists() && !QFileInfo( filename + "/.zgroup" ).exists() ) {
+        Error() << "Export path is not a Zarr store [" << filename << "].";
+        return false;
+    }
+
+    if( D.exists() && !D.removeRecursively() ) {
+        Error() << "Could not replace Zarr store [" << filename << "].";
+        return false;
+    }
+
+    QString arrDir = filename + "/traces";
+
+    if( !QDir().mkpath( arrDir ) ) {
+        Error() << "Could not create Zarr store [" << filename << "].";
+        return false;
+    }
+
+// --------
+// Metadata
+// --------
+
+    KVParams            kvp;
+    QJsonObject         meta, attrs, zarray, arrAttrs;
+    QJsonArray          ids, vpb, voff, shape, chunks;
+
+    double  srate   = outRate(),
+            minV    = df->vRange().rmin,
+            minS    = double(-df->maxInt()),
+            sclV    = df->vRange().span() / (-2 * minS);
+    int     nOn     = grfBits.count( true ),
+            cScans  = qMax( 1, int(EXPORT_ZARRSECS * srate) ),
+            cChans  = qMin( nOn, EXPORT_ZARRCHANS ),
+            nThd    = qBound( 1, getNProcessors() - 1, EXPORT_MAXTHDS );
+
+    DFDirIndex::meta( kvp, df->metaFileName() );
+
+    for( KVParams::const_iterator it = kvp.begin(); it != kvp.end(); ++it )
+        meta[it.key()] = it.value().toString();
+
+    const QVector<uint> &src = df->channelIDs();
+
+    for( int ic = 0, k = 0, nC = grfBits.size(); ic < nC; ++ic ) {
+
+        if( grfBits.testBit( ic ) ) {
+            ids.append( int(src[ic]) );
+            vpb.append( invGain[k] * sclV );
+            voff.append( invGain[k] * (minV - sclV * minS) );
+            ++k;
+        }
+    }
+
+    Biquad  *hipass = newHipass();
+    bool    ok      = false;
+
+    attrs["sglx_meta"]      = meta;
+    attrs["sample_rate"]    = srate;
+    attrs["first_sample"]   = double((df->firstCt() + scnFrom) / chain.dnsmp);
+    attrs["channel_ids"]    = ids;
+    attrs["volts_per_bit"]  = vpb;
+    attrs["volts_offset"]   = voff;
+    attrs["zero_phase_300"] = hipass != 0;
+    attrs["processing"]     = processing();
+
+    shape.append( double(nscans) );
+    shape.append( nOn );
+    chunks.append( cScans );
+    chunks.append( cChans );
+
+    zarray["zarr_format"]   = 2;
+    zarray["shape"]         = shape;
+    zarray["chunks"]        = chunks;
+    zarray["dtype"]         = QString("<i2");
+    zarray["fill_value"]    = 0;
+    zarray["order"]         = QString("C");
+    zarray["filters"]       = QJsonValue();
+
+    if( zarrZ ) {
+
+        QJsonObject cmp;
+
+        cmp["id"]       = QString("zlib");
+        cmp["level"]    = EXPORT_ZARRLEVEL;
+        zarray["compressor"] = cmp;
+    }
+    else
+        zarray["compressor"] = QJsonValue();
+
+    arrAttrs["_ARRAY_DIMENSIONS"] = QJsonArray() << "time" << "channel";
+
+    QJsonObject zgroup;
+    zgroup["zarr_format"] = 2;
+
+    if( !writeJson( filename + "/.zgroup", zgroup )
+        || !writeJson( filename + "/.zattrs", attrs )
+        || !writeJson( arrDir + "/.zarray", zarray )
+        || !writeJson( arrDir + "/.zattrs", arrAttrs ) ) {
+
+        Error() << "Could not write Zarr metadata [" << filename << "].";
+
+        if( hipass )
+            delete hipass;
+
+        D.removeRecursively();
+        return false;
+    }
+
+// -----
+// Start
+// -----
+
+    ExportPipe              pipe;
+    ExportZarr              Z( pipe, arrDir, nOn, cScans, cChans,
+                                (zarrZ ? EXPORT_ZARRLEVEL : -1), nThd );
+    std::vector<QThread*>   vT;
+
+    QThread *thread = startReader( pipe, hipass, cScans );
+
+    for( int it = 0; it < nThd; ++it ) {
+
+        QThread             *zThread = new QThread;
+        ExportZarrWorker    *worker  = new ExportZarrWorker( Z );
+
+        worker->moveToThread( zThread );
+
+        Connect( zThread, SIGNAL(started()), worker, SLOT(run()) );
+        Connect( worker, SIGNAL(finished()), worker, SLOT(deleteLater()) );
+        Connect( worker, SIGNAL(destroyed()), zThread, SLOT(quit()), Qt::DirectConnection );
+
+        zThread->start();
+        vT.push_back( zThread );
+    }
+
+// ----
+// Wait
+// ----
+
+    for(;;) {
+
+        if( Z.isDone() || Z.isFailed() ) {
+
+            if( !(ok = !Z.isFailed()) )
+                Error() << "Zarr chunk writing error [" << filename << "].";
+
+            break;
+        }
+
+        QThread::msleep( 20 );
+
+        if( !P.update( int( 100 * Z.scansDone() / nscans ) ) )
+            break;
+    }
+
+// ------
+// Finish
+// ------
+
+// worker objects auto-deleted asynchronously
+// thread objects manually deleted synchronously (so we can call wait())
+
+    Z.stop();
+    pipe.stop();
+
+    for( int it = 0; it < nThd; ++it ) {
+        vT[it]->wait();
+        delete vT[it];
+    }
+
+    thread->wait();
+    delete thread;
+
+    if( ok && Z.scansDone() < nscans )
+        Warning() << "Export read " << Z.scansDone() << " of " << nscans << " scans.";
+
+    if( !ok )
+        D.removeRecursively();
+
+    return ok;
+}
+
+
@@ -0,0 +1,395 @@
+#ifndef EXPORTJOB_H
+#define EXPORTJOB_H
+
+#include "SGLTypes.h"
+#include "Biquad.h"
+#include "SpatialRef.h"
+
+#include <QObject>
+#include <QBitArray>
+#include <QByteArray>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <deque>
+
+class DataFile;
+class Decimator;
+
+class QThread;
+
+// Binary export block size, blocks queued between reader and
+// writer, and writer queue fill at which we stop feeding it
+// (~10 blocks of DataFile's 4000-entry queue).
+#define EXPORT_BLKSECS      0.25
+#define EXPORT_MAXBLKS      8
+#define EXPORT_WRMAXPCT     0.25
+
+// Text export block size (samples).
+#define EXPORT_TXTSAMPS     (1024*1024)
+
+// Zarr chunk shape (scans by channels), and zlib level.
+#define EXPORT_ZARRSECS     1.0
+#define EXPORT_ZARRCHANS    64
+#define EXPORT_ZARRLEVEL    1
+
+// Most formatting or compressing threads.
+#define EXPORT_MAXTHDS      8
+
+// Forward filters settle on this much data ahead of the span,
+// and split channels into groups of at least this many.
+#define EXPORT_LEADSECS     0.5
+#define EXPORT_GRPCHANS     32
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Read bandwidth shared by concurrent exports. Each take()
+// reserves the next slot at the budget rate and sleeps until
+// it starts, so borrowers interleave fairly. Zero = no limit.
+//
+class ExportBudget
+{
+private:
+    QMutex  mtx;
+    double  bytesPerSec,
+            tNext;
+
+public:
+    ExportBudget() : bytesPerSec(0), tNext(0)   {}
+
+    void setMBps( double MBps );
+    double MBps();
+    void take( qint64 bytes );
+};
+
+
+// Export progress sink: dialog in the viewer, job record in
+// a batch. update() returns false to cancel.
+//
+class ExportProgress
+{
+public:
+    virtual ~ExportProgress()   {}
+    virtual bool update( int percent ) = 0;
+};
+
+
+// Offline processing as in the viewer, run by the reader on
+// whole file scans before subsetting: forward 300 Hz highpass
+// on the nSpk spike channels, line notches (notchHz and its
+// harmonics) on the nNeu neural channels, then -<S> as global
+// (gRef) or local (lRef[ig] lists spike channel ig's ring of
+// neighbors) reference. Any of these makes the reader read
+// every channel.
+//
+// After subsetting, dnsmp > 1 decimates: analog channels by
+// an anti-alias Decimator, the trailing nDig digital words of
+// the subset by taking each output bin's first scan.
+//
+struct ExportChain {
+    SpatialRef                      gRef;
+    std::vector<std::vector<int> >  lRef;
+    double                          notchHz;
+    int                             nSpk,
+                                    nNeu,
+                                    nDig,
+                                    dnsmp;
+    bool                            hp300;
+
+    ExportChain()
+    :   notchHz(0), nSpk(0), nNeu(0), nDig(0), dnsmp(1), hp300(false)  {}
+
+    bool isFullWidth() const
+        {return hp300 || notchHz > 0 || !gRef.isEmpty() || !lRef.empty();}
+};
+
+
+// Bounded queue of export blocks from the reader thread to the
+// GUI thread or to worker threads; put() blocks when full,
+// take() waits up to ms and can report the block's position
+// in file order.
+//
+class ExportPipe
+{
+private:
+    std::deque<vec_i16> Q;
+    QMutex              mtx;
+    QWaitCondition      condPut,
+                        condTake;
+    quint64             nTaken;
+    bool                eof,
+                        pleaseStop;
+
+public:
+    ExportPipe() : nTaken(0), eof(false), pleaseStop(false) {}
+
+    bool put( vec_i16 &blk );
+    bool take( vec_i16 &blk, int ms, quint64 *seq = 0 );
+    void finish();
+    void stop();
+    bool isStopped();
+    bool isDrained();
+};
+
+
+// Reader reads, subsets and optionally filters blocks through
+// its own DataFile, so the viewer's file position isn't shared
+// and disk reads overlap the writer's writing and hashing.
+// If given a budget, reads are paced by it.
+//
+// Blocks put to the pipe hold step (output) scans, the last
+// may be short; with decimation, outputs are regrouped so.
+//
+class ExportReader : public QObject
+{
+    Q_OBJECT
+
+private:
+    ExportPipe                  &pipe;
+    ExportBudget                *budget;
+    QString                     binName;
+    QBitArray                   grfBits;
+    ExportChain                 chain;
+    QVector<uint>               iKeep;      // full-width: subset
+    std::vector<BiquadCascade>  notch;      // per channel group
+    vec_i16                     dig,        // picked digital rows
+                                out;        // decimated, unsent
+    Biquad                      *hipass,    // zero-phase
+                                *hpFwd;
+    Decimator                   *dec;
+    qint64                      from,
+                                nscans,
+                                step,
+                                nPicked;    // input scans seen
+    int                         nSpk,
+                                maxInt;
+
+public:
+    ExportReader(
+        ExportPipe          &pipe,
+        ExportBudget        *budget,
+        const QString       &binName,
+        const QBitArray     &grfBits,
+        Biquad              *hipass,
+        const ExportChain   &chain,
+        int                 nSpk,
+        qint64              from,
+        qint64              nscans,
+        qint64              step );
+    virtual ~ExportReader();
+
+signals:
+    void finished();
+
+public slots:
+    void run();
+
+private:
+    void initChain( const DataFile *rdf );
+    void filter( vec_i16 &scan, int ntpts );
+    void reference( vec_i16 &scan, int ntpts );
+    void decimate( vec_i16 &scan, int ntpts );
+    bool putOut( bool all );
+};
+
+
+// CSV formatting shared by several ExportTextWorker threads.
+//
+// Each channel's volts are (o + k * sample), printed as fixed
+// decimals with 6 significant digits at full scale, converted
+// from a rounded integer rather than through double-to-text.
+// Blocks are numbered in the order taken from the reader's
+// pipe and handed back to next() in that order; formatters
+// stay at most 2 * nWorkers blocks ahead of the consumer.
+//
+class ExportText
+{
+    friend class ExportTextWorker;
+
+private:
+    struct Blk {
+        QByteArray  txt;
+        qint64      nScans;
+    };
+
+    ExportPipe              &pipe;
+    std::vector<double>     k,
+                            o;
+    std::vector<qint64>     p10;        // 10^decimals
+    std::vector<int>        dec;
+    QMap<quint64,Blk>       done;       // seq -> text
+    QMutex                  doneMtx;
+    QWaitCondition          condDone,
+                            condRoom;
+    quint64                 nNext;
+    int                     nRunning,
+                            nAhead;
+    std::atomic<bool>       pleaseStop;
+
+public:
+    ExportText(
+        ExportPipe                  &pipe,
+        const std::vector<double>   &gain,
+        double                      minV,
+        double                      sclV,
+        double                      minS,
+        int                         nWorkers );
+
+    bool next( QByteArray &txt, qint64 &nScans, int ms );
+    bool isDrained();
+    void stop();
+
+private:
+    bool take( vec_i16 &blk, quint64 &seq );
+    void put( Blk &B, quint64 seq );
+    void format( Blk &B, const vec_i16 &blk ) const;
+    void workerExit();
+};
+
+
+class ExportTextWorker : public QObject
+{
+    Q_OBJECT
+
+private:
+    ExportText  &T;
+
+public:
+    ExportTextWorker( ExportText &T ) : QObject(0), T(T)    {}
+
+signals:
+    void finished();
+
+public slots:
+    void run();
+};
+
+
+// Chunk writer for a Zarr (v2) int16 array, shared by several
+// ExportZarrWorker threads.
+//
+// Each pipe block is one row of chunks (chunkScans scans, last
+// may be short). Workers cut a row into chunkChans-channel
+// chunks, optionally zlib-compress them, and write each to its
+// own file "<row>.<group>" in arrDir, so compression and writes
+// run in parallel with no ordering between workers. Edge chunks
+// are zero-padded to full chunk shape, as Zarr requires.
+//
+class ExportZarr
+{
+    friend class ExportZarrWorker;
+
+private:
+    ExportPipe          &pipe;
+    QString             arrDir;
+    int                 nC,
+                        chunkScans,
+                        chunkChans,
+                        level;      // -1 = raw
+    std::atomic<qint64> nScans;     // written
+    std::atomic<int>    nRunning;
+    std::atomic<bool>   pleaseStop,
+                        failed;
+
+public:
+    ExportZarr(
+        ExportPipe      &pipe,
+        const QString   &arrDir,
+        int             nC,
+        int             chunkScans,
+        int             chunkChans,
+        int             level,
+        int             nWorkers )
+    :   pipe(pipe), arrDir(arrDir), nC(nC), chunkScans(chunkScans),
+        chunkChans(chunkChans), level(level), nScans(0),
+        nRunning(nWorkers), pleaseStop(false), failed(false)    {}
+
+    qint64 scansDone() const    {return nScans;}
+    bool isDone() const         {return !nRunning;}
+    bool isFailed() const       {return failed;}
+    void stop()                 {pleaseStop = true;}
+
+private:
+    bool writeRow( const vec_i16 &blk, quint64 row );
+};
+
+
+class ExportZarrWorker : public QObject
+{
+    Q_OBJECT
+
+private:
+    ExportZarr  &Z;
+
+public:
+    ExportZarrWorker( ExportZarr &Z ) : QObject(0), Z(Z)    {}
+
+signals:
+    void finished();
+
+public slots:
+    void run();
+};
+
+
+// One export of a channel subset and scan range of a file,
+// run to completion (or cancel) by run() on the calling
+// thread, with its own reader and worker threads.
+//
+// invGain holds volts per unit gain for each exported channel
+// (text and Zarr scaling); nSpk is the count of leading spike
+// channels that fltZP filters. fileGains() sets both from the
+// file itself, for callers without a viewer. The chain adds
+// viewer processing and decimation; its nDig is set by run().
+//
+class ExportJob
+{
+public:
+    enum Format {
+        bin     = 0,
+        csv     = 1,
+        zarr    = 2
+    };
+
+    const DataFile      *df;
+    ExportBudget        *budget;
+    QString             filename;
+    QBitArray           grfBits;
+    std::vector<double> invGain;
+    ExportChain         chain;
+    qint64              scnFrom,
+                        scnTo;
+    int                 fmt,
+                        nSpk;
+    bool                fltZP,
+                        zarrZ;
+
+public:
+    ExportJob()
+    :   df(0), budget(0), scnFrom(0), scnTo(0),
+        fmt(bin), nSpk(0), fltZP(false), zarrZ(true)    {}
+
+    static QString suffix( int fmt );
+    void fileGains();
+
+    bool run( ExportProgress &P );
+
+private:
+    double outRate() const;
+    QString processing() const;
+    bool isZeroPhase() const;
+    Biquad *newHipass() const;
+    QThread *startReader( ExportPipe &pipe, Biquad *hipass, qint64 step ) const;
+    bool exportAsBinary( ExportProgress &P, qint64 nscans );
+    bool exportAsText( ExportProgress &P, qint64 nscans );
+    bool exportAsZarr( ExportProgress &P, qint64 nscans );
+};
+
+#endif  // EXPORTJOB_H
+
+
@@ -2,85 +2,120 @@
 #include "SampleBufQ.h"
 #include "Util.h"
 
-
+#include <QThread>
 
 
 void SampleBufQ::enqueue( vec_i16 &src )
 {
-    QMutexLocker    ml( &dataQMtx );
+    quint64 wr = wrPos.load( std::memory_order_relaxed );
+
+// Full: warn once per episode, then wait for a slot
+
+    if( wr - rdPos.load( std::memory_order_acquire ) >= maxQSize ) {
 
-    if( dataQ.size() >= maxQSize )
-        overflowWarning();
+        if( !warned ) {
+            overflowWarning();
+            warned = true;
+        }
+
+        do {
+            QThread::usleep( 100 );
+        } while( wr - rdPos.load( std::memory_order_acquire ) >= maxQSize );
+    }
+    else
+        warned = false;
 
-    dataQ.push_back( SampleBuf( src ) );
+    vec_i16 &slot = ring[wr % maxQSize];
 
-// Have an entry; wake a waiting dequeue caller
+    slot.swap( src );
+    src.clear();
 
-    condBufQIsEntry.wakeAll();
+    wrPos.store( wr + 1 );
+
+// Have an entry; wake consumer only if it waits
+
+    if( sleeping.exchange( false ) )
+        semEntry.release();
 }
 
 
 // Returns true if data ready to be written...
-// ...if true, dst is swapped for a data buffer in the deque.
+// ...if true, dst is swapped for a data buffer in the ring.
 //
 bool SampleBufQ::dequeue( vec_i16 &dst, bool wait )
 {
     dst.clear();
 
-    if( !dataQMtx.tryLock( 2000 ) )
-        return false;
+    quint64 rd  = rdPos.load( std::memory_order_relaxed ),
+            wr  = wrPos.load( std::memory_order_acquire );
 
 // Caller sleeps here if no data...
+//
+// Setting sleeping before the recheck pairs with enqueue()
+// publishing wrPos before testing sleeping, so one side always
+// sees the other. Surplus wakeups are drained on the way out.
 
-    if( wait && !dataQ.size() )
-        condBufQIsEntry.wait( &dataQMtx, 4000 );
+    if( wait && wr == rd ) {
 
-// ...And wakes up here when there is
+        sleeping.store( true );
 
-    int     N           = (int)dataQ.size();
-    bool    dataReady   = (N != 0);
+        if( wrPos.load() == rd )
+            semEntry.tryAcquire( 1, 4000 );
 
-    if( N ) {
+        sleeping.store( false );
 
-        // First, dequeue one block
+        int nsem = semEntry.available();
 
-        dst.swap( dataQ.front().data );
-        dataQ.pop_front();
-        --N;
+        if( nsem )
+            semEntry.tryAcquire( nsem );
 
-        // In the following, if the queue is lagging we take action--
-        // We dequeue and join up to joinMax words, but not more than
-        // memory allows, of course. Writing larger blocks clears the
-        // queue faster, and is more efficient for sequential I/O.
+        wr = wrPos.load( std::memory_order_acquire );
+    }
+
+// ...And wakes up here when there is
+
+    int N = int(wr - rd);
+
+    if( !N )
+        return false;
+
+// First, dequeue one block
+
+    dst.swap( ring[rd % maxQSize] );
+    ++rd;
+    --N;
 
-        const int   actionThresh    = 20;
-        const uint  joinMax         = 8*1024*1024/2;
+// In the following, if the queue is lagging we take action--
+// We dequeue and join up to joinMax words, but not more than
+// memory allows, of course. Writing larger blocks clears the
+// queue faster, and is more efficient for sequential I/O.
 
-        if( N >= actionThresh ) {
+    const int   actionThresh    = 20;
+    const uint  joinMax         = 8*1024*1024/2;
 
-            for( int i = 0; N > 0 && dst.size() < joinMax; ++i ) {
+    if( N >= actionThresh ) {
 
-                vec_i16 &src = dataQ.front().data;
+        while( N > 0 && dst.size() < joinMax ) {
 
-                try {
-                    dst.insert( dst.end(), src.begin(), src.end() );
-                }
-                catch( const std::exception& ) {
-                    Error() << "Write queue low mem.";
-                    break;
-                }
+            vec_i16 &src = ring[rd % maxQSize];
 
-                dataQ.pop_front();
-                --N;
+            try {
+                dst.insert( dst.end(), src.begin(), src.end() );
             }
+            catch( const std::exception& ) {
+                Error() << "Write queue low mem.";
+                break;
+            }
+
+            vec_i16().swap( src );
+            ++rd;
+            --N;
         }
     }
 
-    if( !dataQ.size() )
-        condBufQIsEmpty.wakeAll();
+    rdPos.store( rd, std::memory_order_release );
 
-    dataQMtx.unlock();
-    return dataReady;
+    return true;
 }
 
 
@@ -89,28 +124,17 @@ bool SampleBufQ::dequeue( vec_i16 &dst, bool wait )
 //
 bool SampleBufQ::waitForEmpty( int ms )
 {
-    bool    empty = false;
+    double  tEnd = getTime() + 0.001 * ms;
 
-    if( dataQMtx.tryLock( ms ) ) {
+    while( wrPos.load() != rdPos.load() ) {
 
-        empty = !dataQ.size();
+        if( ms >= 0 && getTime() >= tEnd )
+            return false;
 
-        if( !empty ) {
-
-            // Note that wait() requires a locked mutex on entry.
-            // It then unlocks the mutex, performs the wait, and
-            // relocks the mutex on behalf of the caller on exit.
-            // On exit, the mutex is locked regardless of (ok).
-
-            empty = condBufQIsEmpty.wait(
-                        &dataQMtx,
-                        (ms < 0 ? ULONG_MAX : ms) );
-        }
-
-        dataQMtx.unlock();
+        QThread::usleep( 1000 );
     }
 
-    return empty;
+    return true;
 }
 
 
@@ -123,3 +147,38 @@ void SampleBufQ::overflowWarning()
 }
 
 
+// If available, swap an empty recycled buffer into dst.
+//
+void SampleBufPool::get( vec_i16 &dst )
+{
+    QMutexLocker    ml( &poolMtx );
+
+    if( pool.size() ) {
+        dst.swap( pool.back() );
+        pool.pop_back();
+    }
+}
+
+
+// Take src's storage for reuse; src is left empty.
+//
+void SampleBufPool::put( vec_i16 &src )
+{
+    if( !src.capacity() )
+        return;
+
+    src.clear();
+
+    QMutexLocker    ml( &poolMtx );
+
+    if( pool.size() < SAMPLEBUFPOOL_MAX ) {
+        pool.push_back( vec_i16() );
+        pool.back().swap( src );
+    }
+    else {
+        ml.unlock();
+        vec_i16().swap( src );
+    }
+}
+
+
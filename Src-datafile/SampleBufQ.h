@@ -4,53 +4,58 @@
 #include "SGLTypes.h"
 
 #include <QMutex>
-#include <QWaitCondition>
-#include <deque>
+#include <QSemaphore>
+
+#include <atomic>
+
+// Most idle buffers a SampleBufPool retains.
+#define SAMPLEBUFPOOL_MAX   8
 
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
+// Single-producer, single-consumer queue of sample blocks.
+//
+// Blocks are swapped (not copied) into a fixed ring of maxQSize
+// slots. The hand-off is lock-free: only the producer advances
+// wrPos and only the consumer advances rdPos. A consumer that
+// finds the ring empty may sleep on a semaphore; the producer
+// signals it only if it's actually asleep, so the usual enqueue
+// costs two atomic ops and no system call.
+//
+// If the ring ever fills, enqueue() warns and waits for a slot
+// rather than dropping data (DataFile stops the run at 95%).
+//
 class SampleBufQ
 {
-/* ----- */
-/* Types */
-/* ----- */
-
-private:
-    struct SampleBuf {
-        vec_i16 data;
-        SampleBuf( vec_i16 &src )   {data.swap( src );}
-    };
-
 /* ---- */
 /* Data */
 /* ---- */
 
 private:
-    std::deque<SampleBuf>   dataQ;
-    mutable QMutex          dataQMtx;
-    mutable QWaitCondition  condBufQIsEntry,
-                            condBufQIsEmpty;
+    std::vector<vec_i16>    ring;
+    std::atomic<quint64>    wrPos,
+                            rdPos;
+    std::atomic<bool>       sleeping;
+    QSemaphore              semEntry;
     const uint              maxQSize;
+    bool                    warned;     // producer only
 
 /* ------- */
 /* Methods */
 /* ------- */
 
 public:
-    SampleBufQ( int maxQSize ) : maxQSize(maxQSize) {}
+    SampleBufQ( int maxQSize )
+    :   ring(maxQSize), wrPos(0), rdPos(0), sleeping(false),
+        maxQSize(maxQSize), warned(false)   {}
 
-    void wake()
-    {
-        condBufQIsEntry.wakeAll();
-        condBufQIsEmpty.wakeAll();
-    }
+    void wake()     {semEntry.release();}
 
     double percentFull() const
     {
-        QMutexLocker ml( &dataQMtx );
-        return (100.0 * dataQ.size()) / maxQSize;
+        return (100.0 * (wrPos.load() - rdPos.load())) / maxQSize;
     }
 
     void enqueue( vec_i16 &src );
@@ -61,6 +66,27 @@ protected:
     virtual void overflowWarning();
 };
 
+
+// Recycles written sample buffers back to their producer.
+//
+// The producer get()s a block before filling it, and the last
+// consumer put()s it back when done, so steady-state writing
+// reuses the same few heap blocks rather than allocating and
+// freeing megabytes per block across threads. One pool per
+// stream keeps block sizes alike. Never blocks: get() on an
+// empty pool leaves dst as is; put() on a full pool frees src.
+//
+class SampleBufPool
+{
+private:
+    std::vector<vec_i16>    pool;
+    mutable QMutex          poolMtx;
+
+public:
+    void get( vec_i16 &dst );
+    void put( vec_i16 &src );
+};
+
 #endif  // SAMPLEBUFQ_H
 
 
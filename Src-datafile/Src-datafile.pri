@@ -5,8 +5,25 @@ HEADERS += \
     $$PWD/DataFileIMAP.h \
     $$PWD/DataFileIMLF.h \
     $$PWD/DataFileNI.h \
+    $$PWD/DFActivity.h \
+    $$PWD/DFCheckpoint.h \
+    $$PWD/DFChunkSum.h \
+    $$PWD/DFCompress.h \
+    $$PWD/DFDirIndex.h \
+    $$PWD/DFDiskBench.h \
+    $$PWD/DFDiskMon.h \
+    $$PWD/DFEpochs.h \
+    $$PWD/DFEvents.h \
     $$PWD/DFName.h \
+    $$PWD/DFOverview.h \
+    $$PWD/DFReadCache.h \
+    $$PWD/DFSequence.h \
+    $$PWD/DFSidecar.h \
+    $$PWD/DFStamps.h \
+    $$PWD/DFTranspose.h \
+    $$PWD/ExportBatch.h \
     $$PWD/ExportCtl.h \
+    $$PWD/ExportJob.h \
     $$PWD/SampleBufQ.h
 
 SOURCES += \
@@ -15,8 +32,25 @@ SOURCES += \
     $$PWD/DataFileIMAP.cpp \
     $$PWD/DataFileIMLF.cpp \
     $$PWD/DataFileNI.cpp \
+    $$PWD/DFActivity.cpp \
+    $$PWD/DFCheckpoint.cpp \
+    $$PWD/DFChunkSum.cpp \
+    $$PWD/DFCompress.cpp \
+    $$PWD/DFDirIndex.cpp \
+    $$PWD/DFDiskBench.cpp \
+    $$PWD/DFDiskMon.cpp \
+    $$PWD/DFEpochs.cpp \
+    $$PWD/DFEvents.cpp \
     $$PWD/DFName.cpp \
+    $$PWD/DFOverview.cpp \
+    $$PWD/DFReadCache.cpp \
+    $$PWD/DFSequence.cpp \
+    $$PWD/DFSidecar.cpp \
+    $$PWD/DFStamps.cpp \
+    $$PWD/DFTranspose.cpp \
+    $$PWD/ExportBatch.cpp \
     $$PWD/ExportCtl.cpp \
+    $$PWD/ExportJob.cpp \
     $$PWD/SampleBufQ.cpp
 
 
@@ -28,57 +28,1057 @@
 #define M_PI    3.14159265358979323846
 #endif
 
+/* ---------------------------------------------------------------- */
+/* Row kernels ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// One timepoint of the multichannel filter: n contiguous channels
+// at row, each with its own state z1[i], z2[i]. K = {a0,a1,a2,b1,b2}.
+// Cascade (BiquadCascade) rows run nSec such sections back to back
+// in registers, with section s state at z + 2*s*zStride (z1, then
+// z2), clamping only the final output.
+//
+// Channels are independent, so vector kernels run 4 (SSE2, NEON)
+// or 8 (AVX2) channels per step. They keep double precision and do
+// exactly the scalar ops lane-wise (no fused multiply-add), and
+// clamp before truncating, which is equivalent to the scalar
+// truncate-then-clamp. So results are bit-identical to the scalar
+// loop. Time stays the outer loop: the recurrence makes each
+// channel a serial chain, and independent channels are what keep
+// the pipeline full; state for a few hundred channels sits in L1.
+// The widest kernel the CPU supports is chosen once at startup.
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#define BQ_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define BQ_AVX2_FN
+#else
+#define BQ_AVX2_FN __attribute__((target("avx2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define BQ_NEON
+#include <arm_neon.h>
+#endif
+
+typedef void (*BQRowFn)(
+    short           *row,
+    double          *z1,
+    double          *z2,
+    const double    *K,
+    double          Y,
+    int             maxInt,
+    int             n );
+
+
+static void bqRow_scalar(
+    short           *row,
+    double          *z1,
+    double          *z2,
+    const double    *K,
+    double          Y,
+    int             maxInt,
+    int             n )
+{
+    for( int i = 0; i < n; ++i ) {
+
+        double  in  = row[i] * Y,
+                out = in * K[0] + z1[i];
+
+        z1[i] = in * K[1] + z2[i] - K[3] * out;
+        z2[i] = in * K[2] - K[4] * out;
+
+        row[i] = qBound( -maxInt, int(out * maxInt), maxInt - 1 );
+    }
+}
+
+
+typedef void (*BQCasRowFn)(
+    short           *row,
+    double          *z,
+    const double    *K,
+    int             nSec,
+    double          Y,
+    int             maxInt,
+    int             n,
+    int             zStride );
+
+
+static void bqCasRow_scalar(
+    short           *row,
+    double          *z,
+    const double    *K,
+    int             nSec,
+    double          Y,
+    int             maxInt,
+    int             n,
+    int             zStride )
+{
+    for( int i = 0; i < n; ++i ) {
+
+        double  v = row[i] * Y;
+
+        for( int is = 0; is < nSec; ++is ) {
+
+            const double    *k  = &K[5*is];
+            double          *z1 = &z[2*is*zStride + i],
+                            *z2 = z1 + zStride,
+                            out = v * k[0] + *z1;
+
+            *z1 = v * k[1] + *z2 - k[3] * out;
+            *z2 = v * k[2] - k[4] * out;
+            v   = out;
+        }
+
+        row[i] = qBound( -maxInt, int(v * maxInt), maxInt - 1 );
+    }
+}
+
+
+#ifdef BQ_X86
+
+static inline __m128d bqStep_sse2(
+    __m128d         in,
+    double          *z1,
+    double          *z2,
+    const __m128d   *vK )
+{
+    __m128d out = _mm_add_pd( _mm_mul_pd( in, vK[0] ), _mm_loadu_pd( z1 ) );
+
+    _mm_storeu_pd( z1,
+        _mm_sub_pd(
+            _mm_add_pd( _mm_mul_pd( in, vK[1] ), _mm_loadu_pd( z2 ) ),
+            _mm_mul_pd( vK[3], out ) ) );
+    _mm_storeu_pd( z2,
+        _mm_sub_pd( _mm_mul_pd( in, vK[2] ), _mm_mul_pd( vK[4], out ) ) );
+
+    return out;
+}
+
+
+static inline void bqLoad4_sse2(
+    __m128d     &inA,
+    __m128d     &inB,
+    const short *src,
+    __m128d     vY )
+{
+    __m128i s16 = _mm_loadl_epi64( (const __m128i*)src ),
+            s32 = _mm_srai_epi32( _mm_unpacklo_epi16( s16, s16 ), 16 );
+
+    inA = _mm_mul_pd( _mm_cvtepi32_pd( s32 ), vY );
+    inB = _mm_mul_pd( _mm_cvtepi32_pd( _mm_unpackhi_epi64( s32, s32 ) ), vY );
+}
+
+
+static inline void bqStore4_sse2(
+    short   *dst,
+    __m128d oA,
+    __m128d oB,
+    __m128d vM,
+    __m128d vLo,
+    __m128d vHi )
+{
+    oA = _mm_min_pd( _mm_max_pd( _mm_mul_pd( oA, vM ), vLo ), vHi );
+    oB = _mm_min_pd( _mm_max_pd( _mm_mul_pd( oB, vM ), vLo ), vHi );
+
+    __m128i o32 = _mm_unpacklo_epi64(
+                    _mm_cvttpd_epi32( oA ),
+                    _mm_cvttpd_epi32( oB ) );
+
+    _mm_storel_epi64( (__m128i*)dst, _mm_packs_epi32( o32, o32 ) );
+}
+
+
+static void bqRow_sse2(
+    short           *row,
+    double          *z1,
+    double          *z2,
+    const double    *K,
+    double          Y,
+    int             maxInt,
+    int             n )
+{
+    __m128d vK[5],
+            vY  = _mm_set1_pd( Y ),
+            vM  = _mm_set1_pd( maxInt ),
+            vLo = _mm_set1_pd( -maxInt ),
+            vHi = _mm_set1_pd( maxInt - 1 );
+    int     i   = 0;
+
+    for( int k = 0; k < 5; ++k )
+        vK[k] = _mm_set1_pd( K[k] );
+
+    for( ; i + 4 <= n; i += 4 ) {
+
+        __m128d inA, inB;
+
+        bqLoad4_sse2( inA, inB, &row[i], vY );
+
+        bqStore4_sse2(
+            &row[i],
+            bqStep_sse2( inA, &z1[i], &z2[i], vK ),
+            bqStep_sse2( inB, &z1[i+2], &z2[i+2], vK ),
+            vM, vLo, vHi );
+    }
+
+    bqRow_scalar( row + i, z1 + i, z2 + i, K, Y, maxInt, n - i );
+}
+
+
+static void bqCasRow_sse2(
+    short           *row,
+    double          *z,
+    const double    *K,
+    int             nSec,
+    double          Y,
+    int             maxInt,
+    int             n,
+    int             zStride )
+{
+    __m128d vK[5*BIQUAD_MAX_SECS],
+            vY  = _mm_set1_pd( Y ),
+            vM  = _mm_set1_pd( maxInt ),
+            vLo = _mm_set1_pd( -maxInt ),
+            vHi = _mm_set1_pd( maxInt - 1 );
+    int     i   = 0;
+
+    for( int k = 0; k < 5*nSec; ++k )
+        vK[k] = _mm_set1_pd( K[k] );
+
+    for( ; i + 4 <= n; i += 4 ) {
+
+        __m128d inA, inB;
+
+        bqLoad4_sse2( inA, inB, &row[i], vY );
+
+        for( int is = 0; is < nSec; ++is ) {
+
+            double  *z1 = &z[2*is*zStride + i],
+                    *z2 = z1 + zStride;
+
+            inA = bqStep_sse2( inA, z1, z2, &vK[5*is] );
+            inB = bqStep_sse2( inB, z1 + 2, z2 + 2, &vK[5*is] );
+        }
+
+        bqStore4_sse2( &row[i], inA, inB, vM, vLo, vHi );
+    }
+
+    bqCasRow_scalar( row + i, z + i, K, nSec, Y, maxInt, n - i, zStride );
+}
+
+
+BQ_AVX2_FN
+static inline __m256d bqStep_avx2(
+    __m256d         in,
+    double          *z1,
+    double          *z2,
+    const __m256d   *vK )
+{
+    __m256d out = _mm256_add_pd(
+                    _mm256_mul_pd( in, vK[0] ), _mm256_loadu_pd( z1 ) );
+
+    _mm256_storeu_pd( z1,
+        _mm256_sub_pd(
+            _mm256_add_pd( _mm256_mul_pd( in, vK[1] ), _mm256_loadu_pd( z2 ) ),
+            _mm256_mul_pd( vK[3], out ) ) );
+    _mm256_storeu_pd( z2,
+        _mm256_sub_pd(
+            _mm256_mul_pd( in, vK[2] ), _mm256_mul_pd( vK[4], out ) ) );
+
+    return out;
+}
+
+
+BQ_AVX2_FN
+static inline void bqLoad8_avx2(
+    __m256d     &inA,
+    __m256d     &inB,
+    const short *src,
+    __m256d     vY )
+{
+    __m256i s32 = _mm256_cvtepi16_epi32(
+                    _mm_loadu_si128( (const __m128i*)src ) );
+
+    inA = _mm256_mul_pd(
+            _mm256_cvtepi32_pd( _mm256_castsi256_si128( s32 ) ), vY );
+    inB = _mm256_mul_pd(
+            _mm256_cvtepi32_pd( _mm256_extracti128_si256( s32, 1 ) ), vY );
+}
+
+
+BQ_AVX2_FN
+static inline void bqStore8_avx2(
+    short   *dst,
+    __m256d oA,
+    __m256d oB,
+    __m256d vM,
+    __m256d vLo,
+    __m256d vHi )
+{
+    oA = _mm256_min_pd( _mm256_max_pd( _mm256_mul_pd( oA, vM ), vLo ), vHi );
+    oB = _mm256_min_pd( _mm256_max_pd( _mm256_mul_pd( oB, vM ), vLo ), vHi );
+
+    _mm_storeu_si128( (__m128i*)dst,
+        _mm_packs_epi32(
+            _mm256_cvttpd_epi32( oA ),
+            _mm256_cvttpd_epi32( oB ) ) );
+}
+
+
+BQ_AVX2_FN
+static void bqRow_avx2(
+    short           *row,
+    double          *z1,
+    double          *z2,
+    const double    *K,
+    double          Y,
+    int             maxInt,
+    int             n )
+{
+    __m256d vK[5],
+            vY  = _mm256_set1_pd( Y ),
+            vM  = _mm256_set1_pd( maxInt ),
+            vLo = _mm256_set1_pd( -maxInt ),
+            vHi = _mm256_set1_pd( maxInt - 1 );
+    int     i   = 0;
+
+    for( int k = 0; k < 5; ++k )
+        vK[k] = _mm256_set1_pd( K[k] );
+
+    for( ; i + 8 <= n; i += 8 ) {
+
+        __m256d inA, inB;
+
+        bqLoad8_avx2( inA, inB, &row[i], vY );
+
+        bqStore8_avx2(
+            &row[i],
+            bqStep_avx2( inA, &z1[i], &z2[i], vK ),
+            bqStep_avx2( inB, &z1[i+4], &z2[i+4], vK ),
+            vM, vLo, vHi );
+    }
+
+    bqRow_sse2( row + i, z1 + i, z2 + i, K, Y, maxInt, n - i );
+}
+
+
+BQ_AVX2_FN
+static void bqCasRow_avx2(
+    short           *row,
+    double          *z,
+    const double    *K,
+    int             nSec,
+    double          Y,
+    int             maxInt,
+    int             n,
+    int             zStride )
+{
+    __m256d vK[5*BIQUAD_MAX_SECS],
+            vY  = _mm256_set1_pd( Y ),
+            vM  = _mm256_set1_pd( maxInt ),
+            vLo = _mm256_set1_pd( -maxInt ),
+            vHi = _mm256_set1_pd( maxInt - 1 );
+    int     i   = 0;
+
+    for( int k = 0; k < 5*nSec; ++k )
+        vK[k] = _mm256_set1_pd( K[k] );
+
+    for( ; i + 8 <= n; i += 8 ) {
+
+        __m256d inA, inB;
+
+        bqLoad8_avx2( inA, inB, &row[i], vY );
+
+        for( int is = 0; is < nSec; ++is ) {
+
+            double  *z1 = &z[2*is*zStride + i],
+                    *z2 = z1 + zStride;
+
+            inA = bqStep_avx2( inA, z1, z2, &vK[5*is] );
+            inB = bqStep_avx2( inB, z1 + 4, z2 + 4, &vK[5*is] );
+        }
+
+        bqStore8_avx2( &row[i], inA, inB, vM, vLo, vHi );
+    }
+
+    bqCasRow_sse2( row + i, z + i, K, nSec, Y, maxInt, n - i, zStride );
+}
+
+#endif  // BQ_X86
+
+
+#ifdef BQ_NEON
+
+static inline float64x2_t bqStep_neon(
+    float64x2_t         in,
+    double              *z1,
+    double              *z2,
+    const float64x2_t   *vK )
+{
+    float64x2_t out = vaddq_f64( vmulq_f64( in, vK[0] ), vld1q_f64( z1 ) );
+
+    vst1q_f64( z1,
+        vsubq_f64(
+            vaddq_f64( vmulq_f64( in, vK[1] ), vld1q_f64( z2 ) ),
+            vmulq_f64( vK[3], out ) ) );
+    vst1q_f64( z2,
+        vsubq_f64( vmulq_f64( in, vK[2] ), vmulq_f64( vK[4], out ) ) );
+
+    return out;
+}
+
+
+static inline void bqLoad4_neon(
+    float64x2_t &inA,
+    float64x2_t &inB,
+    const short *src,
+    float64x2_t vY )
+{
+    int32x4_t   s32 = vmovl_s16( vld1_s16( src ) );
+
+    inA = vmulq_f64( vcvtq_f64_s64( vmovl_s32( vget_low_s32( s32 ) ) ), vY );
+    inB = vmulq_f64( vcvtq_f64_s64( vmovl_s32( vget_high_s32( s32 ) ) ), vY );
+}
+
+
+static inline void bqStore4_neon(
+    short       *dst,
+    float64x2_t oA,
+    float64x2_t oB,
+    float64x2_t vM,
+    float64x2_t vLo,
+    float64x2_t vHi )
+{
+    oA = vminq_f64( vmaxq_f64( vmulq_f64( oA, vM ), vLo ), vHi );
+    oB = vminq_f64( vmaxq_f64( vmulq_f64( oB, vM ), vLo ), vHi );
+
+    vst1_s16( dst,
+        vmovn_s32(
+            vcombine_s32(
+                vmovn_s64( vcvtq_s64_f64( oA ) ),
+                vmovn_s64( vcvtq_s64_f64( oB ) ) ) ) );
+}
+
+
+static void bqRow_neon(
+    short           *row,
+    double          *z1,
+    double          *z2,
+    const double    *K,
+    double          Y,
+    int             maxInt,
+    int             n )
+{
+    float64x2_t vK[5],
+                vY  = vdupq_n_f64( Y ),
+                vM  = vdupq_n_f64( maxInt ),
+                vLo = vdupq_n_f64( -maxInt ),
+                vHi = vdupq_n_f64( maxInt - 1 );
+    int         i   = 0;
+
+    for( int k = 0; k < 5; ++k )
+        vK[k] = vdupq_n_f64( K[k] );
+
+    for( ; i + 4 <= n; i += 4 ) {
+
+        float64x2_t inA, inB;
+
+        bqLoad4_neon( inA, inB, &row[i], vY );
+
+        bqStore4_neon(
+            &row[i],
+            bqStep_neon( inA, &z1[i], &z2[i], vK ),
+            bqStep_neon( inB, &z1[i+2], &z2[i+2], vK ),
+            vM, vLo, vHi );
+    }
+
+    bqRow_scalar( row + i, z1 + i, z2 + i, K, Y, maxInt, n - i );
+}
+
+
+static void bqCasRow_neon(
+    short           *row,
+    double          *z,
+    const double    *K,
+    int             nSec,
+    double          Y,
+    int             maxInt,
+    int             n,
+    int             zStride )
+{
+    float64x2_t vK[5*BIQUAD_MAX_SECS],
+                vY  = vdupq_n_f64( Y ),
+                vM  = vdupq_n_f64( maxInt ),
+                vLo = vdupq_n_f64( -maxInt ),
+                vHi = vdupq_n_f64( maxInt - 1 );
+    int         i   = 0;
+
+    for( int k = 0; k < 5*nSec; ++k )
+        vK[k] = vdupq_n_f64( K[k] );
+
+    for( ; i + 4 <= n; i += 4 ) {
+
+        float64x2_t inA, inB;
+
+        bqLoad4_neon( inA, inB, &row[i], vY );
+
+        for( int is = 0; is < nSec; ++is ) {
+
+            double  *z1 = &z[2*is*zStride + i],
+                    *z2 = z1 + zStride;
+
+            inA = bqStep_neon( inA, z1, z2, &vK[5*is] );
+            inB = bqStep_neon( inB, z1 + 2, z2 + 2, &vK[5*is] );
+        }
+
+        bqStore4_neon( &row[i], inA, inB, vM, vLo, vHi );
+    }
+
+    bqCasRow_scalar( row + i, z + i, K, nSec, Y, maxInt, n - i, zStride );
+}
+
+#endif  // BQ_NEON
+
+
+static BQRowFn pickBQRow()
+{
+#if defined(BQ_X86)
+    if( cpuHasAVX2() )
+        return bqRow_avx2;
+
+    return bqRow_sse2;
+#elif defined(BQ_NEON)
+    return bqRow_neon;
+#else
+    return bqRow_scalar;
+#endif
+}
+
+
+static BQCasRowFn pickBQCasRow()
+{
+#if defined(BQ_X86)
+    if( cpuHasAVX2() )
+        return bqCasRow_avx2;
+
+    return bqCasRow_sse2;
+#elif defined(BQ_NEON)
+    return bqCasRow_neon;
+#else
+    return bqCasRow_scalar;
+#endif
+}
+
+static const BQRowFn    bqRow       = pickBQRow();
+static const BQCasRowFn bqCasRow    = pickBQCasRow();
+
+/* ---------------------------------------------------------------- */
+/* Fixed-point row kernels ---------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Direct form I in Q14 with 32-bit accumulators, for maxInt <= 512
+// (10-bit imec). Inputs are scaled up by 2^BQ_FXP_XSH so that
+// x, y (int16) carry 4 fraction bits; each channel keeps x1, x2,
+// y1, y2 at s + {0,1,2,3}*stride, and its accumulator remainder
+// e (first-order error feedback, in [0, 2^14)), which keeps the
+// quantization noise from pooling under the poles. Worst-case
+// |acc| < 2^31 for full scale input at this scaling; y saturates
+// at int16 (2048 LSB, far outside the output clamp).
+//
+// K = {a0,a1,a2,-b1,-b2} in Q14. Output truncates toward zero and
+// clamps like the double path; measured error vs double path is
+// at most 1 LSB (about 95% of samples identical) for the 300 Hz
+// highpass at 30 kHz.
+//
+// All versions do identical integer ops, so results are
+// bit-identical to the scalar loop.
+
+#define BQ_FXP_Q    14
+#define BQ_FXP_XSH  4
+
+typedef void (*BQFxpRowFn)(
+    short           *row,
+    qint16          *s,
+    qint32          *e,
+    const qint16    *K,
+    int             maxInt,
+    int             n,
+    int             stride );
+
+
+static void bqFxpRow_scalar(
+    short           *row,
+    qint16          *s,
+    qint32          *e,
+    const qint16    *K,
+    int             maxInt,
+    int             n,
+    int             stride )
+{
+    qint16  *x1 = s,
+            *x2 = s + stride,
+            *y1 = s + 2 * stride,
+            *y2 = s + 3 * stride;
+
+    for( int i = 0; i < n; ++i ) {
+
+        qint32  x   = row[i] * (1 << BQ_FXP_XSH),
+                acc = K[0] * x + K[1] * x1[i] + K[2] * x2[i]
+                    + K[3] * y1[i] + K[4] * y2[i] + e[i],
+                y   = acc >> BQ_FXP_Q;
+
+        e[i]  = acc - (y << BQ_FXP_Q);
+        y     = qBound( -32768, y, 32767 );
+        x2[i] = x1[i];
+        x1[i] = qint16(x);
+        y2[i] = y1[i];
+        y1[i] = qint16(y);
+
+        y = (y + ((y >> 15) & ((1 << BQ_FXP_XSH) - 1))) >> BQ_FXP_XSH;
+
+        row[i] = qBound( -maxInt, int(y), maxInt - 1 );
+    }
+}
+
+
+#ifdef BQ_X86
+
+// Q14 products summed pairwise: (u,v) lanes times (Ku,Kv).
+static inline __m128i bqFxpPair_sse2( __m128i uv, qint16 Ku, qint16 Kv )
+{
+    return _mm_madd_epi16(
+            uv, _mm_set1_epi32( (quint16(Kv) << 16) | quint16(Ku) ) );
+}
+
+
+static void bqFxpRow_sse2(
+    short           *row,
+    qint16          *s,
+    qint32          *e,
+    const qint16    *K,
+    int             maxInt,
+    int             n,
+    int             stride )
+{
+    const __m128i   vZ  = _mm_setzero_si128(),
+                    vLo = _mm_set1_epi16( -maxInt ),
+                    vHi = _mm_set1_epi16( maxInt - 1 ),
+                    vRm = _mm_set1_epi16( (1 << BQ_FXP_XSH) - 1 );
+    qint16          *x1 = s,
+                    *x2 = s + stride,
+                    *y1 = s + 2 * stride,
+                    *y2 = s + 3 * stride;
+    int             i   = 0;
+
+    for( ; i + 8 <= n; i += 8 ) {
+
+        __m128i X   = _mm_slli_epi16(
+                        _mm_loadu_si128( (__m128i*)(row + i) ), BQ_FXP_XSH ),
+                X1  = _mm_loadu_si128( (__m128i*)(x1 + i) ),
+                X2  = _mm_loadu_si128( (__m128i*)(x2 + i) ),
+                Y1  = _mm_loadu_si128( (__m128i*)(y1 + i) ),
+                Y2  = _mm_loadu_si128( (__m128i*)(y2 + i) ),
+                aL  = _mm_add_epi32(
+                        _mm_add_epi32(
+                            bqFxpPair_sse2( _mm_unpacklo_epi16( X, X1 ), K[0], K[1] ),
+                            bqFxpPair_sse2( _mm_unpacklo_epi16( X2, Y1 ), K[2], K[3] ) ),
+                        _mm_add_epi32(
+                            bqFxpPair_sse2( _mm_unpacklo_epi16( Y2, vZ ), K[4], 0 ),
+                            _mm_loadu_si128( (__m128i*)(e + i) ) ) ),
+                aH  = _mm_add_epi32(
+                        _mm_add_epi32(
+                            bqFxpPair_sse2( _mm_unpackhi_epi16( X, X1 ), K[0], K[1] ),
+                            bqFxpPair_sse2( _mm_unpackhi_epi16( X2, Y1 ), K[2], K[3] ) ),
+                        _mm_add_epi32(
+                            bqFxpPair_sse2( _mm_unpackhi_epi16( Y2, vZ ), K[4], 0 ),
+                            _mm_loadu_si128( (__m128i*)(e + i + 4) ) ) ),
+                yL  = _mm_srai_epi32( aL, BQ_FXP_Q ),
+                yH  = _mm_srai_epi32( aH, BQ_FXP_Q ),
+                Y;
+
+        _mm_storeu_si128( (__m128i*)(e + i),
+            _mm_sub_epi32( aL, _mm_slli_epi32( yL, BQ_FXP_Q ) ) );
+        _mm_storeu_si128( (__m128i*)(e + i + 4),
+            _mm_sub_epi32( aH, _mm_slli_epi32( yH, BQ_FXP_Q ) ) );
+
+        Y = _mm_packs_epi32( yL, yH );
+
+        _mm_storeu_si128( (__m128i*)(x2 + i), X1 );
+        _mm_storeu_si128( (__m128i*)(x1 + i), X );
+        _mm_storeu_si128( (__m128i*)(y2 + i), Y1 );
+        _mm_storeu_si128( (__m128i*)(y1 + i), Y );
+
+        Y = _mm_srai_epi16(
+                _mm_add_epi16(
+                    Y, _mm_and_si128( _mm_srai_epi16( Y, 15 ), vRm ) ),
+                BQ_FXP_XSH );
+
+        _mm_storeu_si128( (__m128i*)(row + i),
+            _mm_min_epi16( _mm_max_epi16( Y, vLo ), vHi ) );
+    }
+
+    if( i < n )
+        bqFxpRow_scalar( row + i, s + i, e + i, K, maxInt, n - i, stride );
+}
+
+
+BQ_AVX2_FN
+static inline __m256i bqFxpPair_avx2( __m256i uv, qint16 Ku, qint16 Kv )
+{
+    return _mm256_madd_epi16(
+            uv, _mm256_set1_epi32( (quint16(Kv) << 16) | quint16(Ku) ) );
+}
+
+
+// 256-bit unpack and pack work within 128-bit lanes, so the
+// accumulator halves hold channels {0-3,8-11} and {4-7,12-15};
+// e is permuted to and from natural order at load and store.
+//
+BQ_AVX2_FN
+static void bqFxpRow_avx2(
+    short           *row,
+    qint16          *s,
+    qint32          *e,
+    const qint16    *K,
+    int             maxInt,
+    int             n,
+    int             stride )
+{
+    const __m256i   vZ  = _mm256_setzero_si256(),
+                    vLo = _mm256_set1_epi16( -maxInt ),
+                    vHi = _mm256_set1_epi16( maxInt - 1 ),
+                    vRm = _mm256_set1_epi16( (1 << BQ_FXP_XSH) - 1 );
+    qint16          *x1 = s,
+                    *x2 = s + stride,
+                    *y1 = s + 2 * stride,
+                    *y2 = s + 3 * stride;
+    int             i   = 0;
+
+    for( ; i + 16 <= n; i += 16 ) {
+
+        __m256i X   = _mm256_slli_epi16(
+                        _mm256_loadu_si256( (__m256i*)(row + i) ), BQ_FXP_XSH ),
+                X1  = _mm256_loadu_si256( (__m256i*)(x1 + i) ),
+                X2  = _mm256_loadu_si256( (__m256i*)(x2 + i) ),
+                Y1  = _mm256_loadu_si256( (__m256i*)(y1 + i) ),
+                Y2  = _mm256_loadu_si256( (__m256i*)(y2 + i) ),
+                E0  = _mm256_loadu_si256( (__m256i*)(e + i) ),
+                E1  = _mm256_loadu_si256( (__m256i*)(e + i + 8) ),
+                aL  = _mm256_add_epi32(
+                        _mm256_add_epi32(
+                            bqFxpPair_avx2( _mm256_unpacklo_epi16( X, X1 ), K[0], K[1] ),
+                            bqFxpPair_avx2( _mm256_unpacklo_epi16( X2, Y1 ), K[2], K[3] ) ),
+                        _mm256_add_epi32(
+                            bqFxpPair_avx2( _mm256_unpacklo_epi16( Y2, vZ ), K[4], 0 ),
+                            _mm256_permute2x128_si256( E0, E1, 0x20 ) ) ),
+                aH  = _mm256_add_epi32(
+                        _mm256_add_epi32(
+                            bqFxpPair_avx2( _mm256_unpackhi_epi16( X, X1 ), K[0], K[1] ),
+                            bqFxpPair_avx2( _mm256_unpackhi_epi16( X2, Y1 ), K[2], K[3] ) ),
+                        _mm256_add_epi32(
+                            bqFxpPair_avx2( _mm256_unpackhi_epi16( Y2, vZ ), K[4], 0 ),
+                            _mm256_permute2x128_si256( E0, E1, 0x31 ) ) ),
+                yL  = _mm256_srai_epi32( aL, BQ_FXP_Q ),
+                yH  = _mm256_srai_epi32( aH, BQ_FXP_Q ),
+                Y;
+
+        aL = _mm256_sub_epi32( aL, _mm256_slli_epi32( yL, BQ_FXP_Q ) );
+        aH = _mm256_sub_epi32( aH, _mm256_slli_epi32( yH, BQ_FXP_Q ) );
+
+        _mm256_storeu_si256( (__m256i*)(e + i),
+            _mm256_permute2x128_si256( aL, aH, 0x20 ) );
+        _mm256_storeu_si256( (__m256i*)(e + i + 8),
+            _mm256_permute2x128_si256( aL, aH, 0x31 ) );
+
+        Y = _mm256_packs_epi32( yL, yH );
+
+        _mm256_storeu_si256( (__m256i*)(x2 + i), X1 );
+        _mm256_storeu_si256( (__m256i*)(x1 + i), X );
+        _mm256_storeu_si256( (__m256i*)(y2 + i), Y1 );
+        _mm256_storeu_si256( (__m256i*)(y1 + i), Y );
+
+        Y = _mm256_srai_epi16(
+                _mm256_add_epi16(
+                    Y, _mm256_and_si256( _mm256_srai_epi16( Y, 15 ), vRm ) ),
+                BQ_FXP_XSH );
+
+        _mm256_storeu_si256( (__m256i*)(row + i),
+            _mm256_min_epi16( _mm256_max_epi16( Y, vLo ), vHi ) );
+    }
+
+    if( i < n )
+        bqFxpRow_sse2( row + i, s + i, e + i, K, maxInt, n - i, stride );
+}
+
+#endif  // BQ_X86
+
+
+#ifdef BQ_NEON
+
+static void bqFxpRow_neon(
+    short           *row,
+    qint16          *s,
+    qint32          *e,
+    const qint16    *K,
+    int             maxInt,
+    int             n,
+    int             stride )
+{
+    const int16x8_t vLo = vdupq_n_s16( -maxInt ),
+                    vHi = vdupq_n_s16( maxInt - 1 ),
+                    vRm = vdupq_n_s16( (1 << BQ_FXP_XSH) - 1 );
+    qint16          *x1 = s,
+                    *x2 = s + stride,
+                    *y1 = s + 2 * stride,
+                    *y2 = s + 3 * stride;
+    int             i   = 0;
+
+    for( ; i + 8 <= n; i += 8 ) {
+
+        int16x8_t   X   = vshlq_n_s16( vld1q_s16( row + i ), BQ_FXP_XSH ),
+                    X1  = vld1q_s16( x1 + i ),
+                    X2  = vld1q_s16( x2 + i ),
+                    Y1  = vld1q_s16( y1 + i ),
+                    Y2  = vld1q_s16( y2 + i ),
+                    Y;
+        int32x4_t   aL  = vld1q_s32( e + i ),
+                    aH  = vld1q_s32( e + i + 4 ),
+                    yL, yH;
+
+        aL = vmlal_n_s16( aL, vget_low_s16( X ),   K[0] );
+        aL = vmlal_n_s16( aL, vget_low_s16( X1 ),  K[1] );
+        aL = vmlal_n_s16( aL, vget_low_s16( X2 ),  K[2] );
+        aL = vmlal_n_s16( aL, vget_low_s16( Y1 ),  K[3] );
+        aL = vmlal_n_s16( aL, vget_low_s16( Y2 ),  K[4] );
+        aH = vmlal_n_s16( aH, vget_high_s16( X ),  K[0] );
+        aH = vmlal_n_s16( aH, vget_high_s16( X1 ), K[1] );
+        aH = vmlal_n_s16( aH, vget_high_s16( X2 ), K[2] );
+        aH = vmlal_n_s16( aH, vget_high_s16( Y1 ), K[3] );
+        aH = vmlal_n_s16( aH, vget_high_s16( Y2 ), K[4] );
+
+        yL = vshrq_n_s32( aL, BQ_FXP_Q );
+        yH = vshrq_n_s32( aH, BQ_FXP_Q );
+
+        vst1q_s32( e + i,     vsubq_s32( aL, vshlq_n_s32( yL, BQ_FXP_Q ) ) );
+        vst1q_s32( e + i + 4, vsubq_s32( aH, vshlq_n_s32( yH, BQ_FXP_Q ) ) );
+
+        Y = vcombine_s16( vqmovn_s32( yL ), vqmovn_s32( yH ) );
+
+        vst1q_s16( x2 + i, X1 );
+        vst1q_s16( x1 + i, X );
+        vst1q_s16( y2 + i, Y1 );
+        vst1q_s16( y1 + i, Y );
+
+        Y = vshrq_n_s16(
+                vaddq_s16( Y, vandq_s16( vshrq_n_s16( Y, 15 ), vRm ) ),
+                BQ_FXP_XSH );
+
+        vst1q_s16( row + i, vminq_s16( vmaxq_s16( Y, vLo ), vHi ) );
+    }
+
+    if( i < n )
+        bqFxpRow_scalar( row + i, s + i, e + i, K, maxInt, n - i, stride );
+}
+
+#endif  // BQ_NEON
+
+
+static BQFxpRowFn pickBQFxpRow()
+{
+#if defined(BQ_X86)
+    if( cpuHasAVX2() )
+        return bqFxpRow_avx2;
+
+    return bqFxpRow_sse2;
+#elif defined(BQ_NEON)
+    return bqFxpRow_neon;
+#else
+    return bqFxpRow_scalar;
+#endif
+}
+
+static const BQFxpRowFn bqFxpRow    = pickBQFxpRow();
+
 
 /* ---------------------------------------------------------------- */
 /* Threading helpers ---------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
-static Biquad   *ME;
+static void bqJobRows( const BiquadJob &J )
+{
+    short   *row = J.data;
 
-void BiquadWorker::run()
+    for( int it = 0; it < J.ntpts; ++it, row += J.nchans )
+        bqRow( row, J.z1, J.z2, J.K, J.Y, J.maxInt, J.n );
+}
+
+
+// Per channel: copy to doubles with BIQUAD_TRANS_WIDE odd-reflected
+// points each end, run forward and backward from zero state, then
+// write back the center, clamped.
+//
+static void bqJobZeroPhase( const BiquadJob &J )
 {
-    double  Y   = 1.0 / maxInt,
-            A0  = ME->a0,
-            A1  = ME->a1,
-            A2  = ME->a2,
-            B1  = ME->b1,
-            B2  = ME->b2;
+    const double        *K      = J.K;
+    int                 nt      = J.ntpts,
+                        npad    = qMin( BIQUAD_TRANS_WIDE, nt - 1 ),
+                        nx      = nt + 2 * npad;
+    std::vector<double> vx( nx );
+    double              *x      = &vx[0];
 
-    for( int it = 0; it < ntpts; ++it, data += nchans ) {
+    for( int ic = 0; ic < J.n; ++ic ) {
+
+        short   *d = J.data + ic;
+        double  z1, z2, in, out;
+
+        for( int it = 0; it < nt; ++it )
+            x[npad + it] = d[it * J.nchans];
+
+        for( int k = 1; k <= npad; ++k ) {
+            x[npad - k]          = 2 * x[npad] - x[npad + k];
+            x[npad + nt - 1 + k] = 2 * x[npad + nt - 1] - x[npad + nt - 1 - k];
+        }
+
+        z1 = z2 = 0;
+
+        for( int ix = 0; ix < nx; ++ix ) {
+            in    = x[ix];
+            out   = in * K[0] + z1;
+            z1    = in * K[1] + z2 - K[3] * out;
+            z2    = in * K[2] - K[4] * out;
+            x[ix] = out;
+        }
+
+        z1 = z2 = 0;
+
+        for( int ix = nx - 1; ix >= 0; --ix ) {
+            in    = x[ix];
+            out   = in * K[0] + z1;
+            z1    = in * K[1] + z2 - K[3] * out;
+            z2    = in * K[2] - K[4] * out;
+            x[ix] = out;
+        }
+
+        for( int it = 0; it < nt; ++it ) {
+            d[it * J.nchans] =
+                qBound( -J.maxInt, int(x[npad + it]), J.maxInt - 1 );
+        }
+    }
+}
+
+
+BiquadPool &BiquadPool::pool()
+{
+    static BiquadPool   P( getNProcessors() - 1 );
+    return P;
+}
+
+
+BiquadPool::BiquadPool( int nThd ) : stop(false)
+{
+    for( int i = 0; i < nThd; ++i )
+        vT.push_back( new BiquadThread( *this ) );
+}
+
+
+BiquadPool::~BiquadPool()
+{
+    poolMtx.lock();
+        stop = true;
+    poolMtx.unlock();
+    condJob.wakeAll();
+
+    for( int i = 0, n = vT.size(); i < n; ++i )
+        delete vT[i];
+}
+
+
+// Post all jobs, help until none of ours are queued,
+// then wait for workers to finish the rest.
+//
+// Jobs must share one remain counter, set to jobs.size().
+//
+void BiquadPool::runBatch( std::vector<BiquadJob> &jobs )
+{
+    int         nJ      = jobs.size();
+    const int   *remain = jobs[0].remain;
+    BiquadJob   J;
 
-        for( int c = cFirst; c < cLim; ++c ) {
+    poolMtx.lock();
+        queue.insert( queue.end(), jobs.begin(), jobs.end() );
+    poolMtx.unlock();
 
-            double  in  = data[c] * Y,
-                    z1  = ME->vz1[c - c0],
-                    z2  = ME->vz2[c - c0],
-                    out = in * A0 + z1;
+    if( nJ > 1 )
+        condJob.wakeAll();
+
+    while( take( J, remain ) ) {
+        J.run();
+        done( J );
+    }
+
+    poolMtx.lock();
+        while( *remain > 0 )
+            condDone.wait( &poolMtx );
+    poolMtx.unlock();
+}
 
-            z1 = in * A1 + z2 - B1 * out;
-            z2 = in * A2 - B2 * out;
 
-            data[c] = qBound( -maxInt, int(out * maxInt), maxInt - 1 );
+// Pop a queued job, only from batch (remain) if given.
+// Workers (remain = 0) block until a job comes or stop.
+//
+// Return false if none.
+//
+bool BiquadPool::take( BiquadJob &J, const int *remain )
+{
+    QMutexLocker    ml( &poolMtx );
 
-            ME->vz1[c - c0] = z1;
-            ME->vz2[c - c0] = z2;
+    for(;;) {
+
+        for( int i = int(queue.size()) - 1; i >= 0; --i ) {
+
+            if( !remain || queue[i].remain == remain ) {
+                J = queue[i];
+                queue.erase( queue.begin() + i );
+                return true;
+            }
         }
+
+        if( remain || stop )
+            return false;
+
+        condJob.wait( &poolMtx );
+    }
+}
+
+
+void BiquadPool::done( const BiquadJob &J )
+{
+    poolMtx.lock();
+        bool    last = !--*J.remain;
+    poolMtx.unlock();
+
+    if( last )
+        condDone.wakeAll();
+}
+
+
+void BiquadWorker::run()
+{
+    BiquadJob   J;
+
+    while( P.take( J ) ) {
+        J.run();
+        P.done( J );
     }
 
     emit finished();
 }
 
-BiquadThread::BiquadThread(
-    short   *data,
-    int     maxInt,
-    int     ntpts,
-    int     nchans,
-    int     c0,
-    int     cFirst,
-    int     cLim )
+BiquadThread::BiquadThread( BiquadPool &P )
 {
     thread  = new QThread;
-    worker  = new BiquadWorker(
-                    data, maxInt, ntpts,
-                    nchans, c0, cFirst, cLim );
+    worker  = new BiquadWorker( P );
 
     worker->moveToThread( thread );
 
@@ -116,6 +1116,7 @@ Biquad::Biquad() {
     z1      = 0.0;
     z2      = 0.0;
     type    = bq_type_lowpass;
+    fxp     = false;
 }
 
 
@@ -179,19 +1180,9 @@ void Biquad::applyBlockwiseThd(
     int     cLim,
     int     nThd )
 {
-    ME = this;
-
-    double  Y   = 1.0 / maxInt,
-            A0  = a0,
-            A1  = a1,
-            A2  = a2,
-            B1  = b1,
-            B2  = b2;
+    double  K[5]    = {a0, a1, a2, b1, b2};
     int     nneural = cLim - c0,
-            cPer    = nneural / nThd,
-            cFirst  = c0;
-
-    --nThd;
+            remain;
 
     if( nneural != (int)vz1.size() ) {
 
@@ -199,56 +1190,100 @@ void Biquad::applyBlockwiseThd(
         vz2.assign( nneural, 0 );
     }
 
-// Make nThd companion workers
+    nThd = qMin( nThd, BiquadPool::pool().nWorkers() + 1 );
 
-    std::vector<BiquadThread*>  vT;
+    if( nThd < 2 || nneural / nThd < 4 ) {
+        applyBlockwiseMem( data, maxInt, ntpts, nchans, c0, cLim );
+        return;
+    }
 
-    if( !nThd || cPer < 4 )
-        nThd = 0;
-    else {
+// One job per channel group; groups multiple of 4 channels
+// (SIMD width) except the last.
 
-        for( int i = 0; i < nThd; ++i ) {
+    std::vector<BiquadJob>  jobs( nThd );
+    int                     cPer = (nneural / nThd) & ~3,
+                            cFirst = 0;
 
-            vT.push_back( new BiquadThread(
-                                data, maxInt, ntpts, nchans,
-                                c0, cFirst, cFirst + cPer ) );
+    for( int i = 0; i < nThd; ++i ) {
 
-            cFirst += cPer;
+        BiquadJob   &J = jobs[i];
+        int         n  = (i < nThd - 1 ? cPer : nneural - cFirst);
 
-            if( cLim - cFirst <= cPer )
-                break;
-        }
+        J.fn        = bqJobRows;
+        J.data      = data + c0 + cFirst;
+        J.z1        = &vz1[cFirst];
+        J.z2        = &vz2[cFirst];
+        J.K         = K;
+        J.remain    = &remain;
+        J.Y         = 1.0 / maxInt;
+        J.maxInt    = maxInt;
+        J.ntpts     = ntpts;
+        J.nchans    = nchans;
+        J.n         = n;
+
+        cFirst += n;
     }
 
-// The final worker is me, the calling thread
+    remain = nThd;
+    BiquadPool::pool().runBatch( jobs );
+}
 
-    for( int it = 0; it < ntpts; ++it, data += nchans ) {
 
-        for( int c = cFirst; c < cLim; ++c ) {
+void Biquad::applyZeroPhase(
+    short   *data,
+    int     maxInt,
+    int     ntpts,
+    int     nchans,
+    int     c0,
+    int     cLim,
+    int     nThd )
+{
+    double  K[5]    = {a0, a1, a2, b1, b2};
+    int     nneural = cLim - c0,
+            remain;
 
-            double  in  = data[c] * Y,
-                    z1  = vz1[c - c0],
-                    z2  = vz2[c - c0],
-                    out = in * A0 + z1;
+    if( ntpts <= 0 || nneural <= 0 )
+        return;
 
-            z1 = in * A1 + z2 - B1 * out;
-            z2 = in * A2 - B2 * out;
+    nThd = qBound( 1, qMin( nThd, nneural ), BiquadPool::pool().nWorkers() + 1 );
 
-            data[c] = qBound( -maxInt, int(out * maxInt), maxInt - 1 );
+    std::vector<BiquadJob>  jobs( nThd );
+    int                     cPer = nneural / nThd,
+                            cFirst = 0;
 
-            vz1[c - c0] = z1;
-            vz2[c - c0] = z2;
-        }
+    for( int i = 0; i < nThd; ++i ) {
+
+        BiquadJob   &J = jobs[i];
+        int         n  = (i < nThd - 1 ? cPer : nneural - cFirst);
+
+        J.fn        = bqJobZeroPhase;
+        J.data      = data + c0 + cFirst;
+        J.z1        = 0;
+        J.z2        = 0;
+        J.K         = K;
+        J.remain    = &remain;
+        J.Y         = 1.0 / maxInt;
+        J.maxInt    = maxInt;
+        J.ntpts     = ntpts;
+        J.nchans    = nchans;
+        J.n         = n;
+
+        cFirst += n;
     }
 
-// Clean up workers
+    if( nThd == 1 ) {
+        bqJobZeroPhase( jobs[0] );
+        return;
+    }
 
-    for( int it = 0; it < nThd; ++it )
-        delete vT[it];
+    remain = nThd;
+    BiquadPool::pool().runBatch( jobs );
 }
 
 
-void Biquad::applyBlockwiseMem(
+// Fixed-point path when fxpOK( maxInt ), else applyBlockwiseMem.
+//
+void Biquad::applyBlockwiseFxp(
     short   *data,
     int     maxInt,
     int     ntpts,
@@ -256,38 +1291,50 @@ void Biquad::applyBlockwiseMem(
     int     c0,
     int     cLim )
 {
-    double  Y   = 1.0 / maxInt,
-            A0  = a0,
-            A1  = a1,
-            A2  = a2,
-            B1  = b1,
-            B2  = b2;
-    int     nneural = cLim - c0;
+    if( !fxpOK( maxInt ) ) {
+        applyBlockwiseMem( data, maxInt, ntpts, nchans, c0, cLim );
+        return;
+    }
 
-    if( nneural != (int)vz1.size() ) {
+    int nneural = cLim - c0;
 
-        vz1.assign( nneural, 0 );
-        vz2.assign( nneural, 0 );
+    if( nneural <= 0 )
+        return;
+
+    if( nneural != (int)vfe.size() ) {
+
+        vfs.assign( 4 * nneural, 0 );
+        vfe.assign( nneural, 0 );
     }
 
-    for( int it = 0; it < ntpts; ++it, data += nchans ) {
+    for( int it = 0; it < ntpts; ++it, data += nchans )
+        bqFxpRow( data + c0, &vfs[0], &vfe[0], fxK, maxInt, nneural, nneural );
+}
 
-        for( int c = c0; c < cLim; ++c ) {
 
-            double  in  = data[c] * Y,
-                    z1  = vz1[c - c0],
-                    z2  = vz2[c - c0],
-                    out = in * A0 + z1;
+void Biquad::applyBlockwiseMem(
+    short   *data,
+    int     maxInt,
+    int     ntpts,
+    int     nchans,
+    int     c0,
+    int     cLim )
+{
+    double  K[5]    = {a0, a1, a2, b1, b2},
+            Y       = 1.0 / maxInt;
+    int     nneural = cLim - c0;
 
-            z1 = in * A1 + z2 - B1 * out;
-            z2 = in * A2 - B2 * out;
+    if( nneural <= 0 )
+        return;
 
-            data[c] = qBound( -maxInt, int(out * maxInt), maxInt - 1 );
+    if( nneural != (int)vz1.size() ) {
 
-            vz1[c - c0] = z1;
-            vz2[c - c0] = z2;
-        }
+        vz1.assign( nneural, 0 );
+        vz2.assign( nneural, 0 );
     }
+
+    for( int it = 0; it < ntpts; ++it, data += nchans )
+        bqRow( data + c0, &vz1[0], &vz2[0], K, Y, maxInt, nneural );
 }
 
 
@@ -402,6 +1449,45 @@ void Biquad::apply1BlockwiseNoMem(
 }
 
 
+// Q14 coefficients for applyBlockwiseFxp, if they fit. Only the
+// highpass and lowpass are taken, and only if a0 >= 1/8, so that
+// numerator rounding stays below ~2^-11 relative; low-cutoff
+// lowpasses (tiny a0) stay on the double path. a1 is set from a0
+// exactly so the highpass keeps a true zero at DC.
+//
+void Biquad::calcFxp()
+{
+    double  K[5]    = {a0, a1, a2, -b1, -b2};
+
+    vfs.clear();
+    vfe.clear();
+    fxp = false;
+
+    if( type != bq_type_highpass && type != bq_type_lowpass )
+        return;
+
+    if( a0 < 0.125 )
+        return;
+
+    for( int i = 0; i < 5; ++i ) {
+
+        double  q = floor( K[i] * (1 << BQ_FXP_Q) + 0.5 );
+
+        if( q < -32768 || q > 32767 )
+            return;
+
+        fxK[i] = qint16(q);
+    }
+
+    if( 2 * qAbs( int(fxK[0]) ) > 32767 )
+        return;
+
+    fxK[1] = (type == bq_type_highpass ? -2 : 2) * fxK[0];
+    fxK[2] = fxK[0];
+    fxp    = true;
+}
+
+
 void Biquad::calcBiquad()
 {
     vz1.clear();
@@ -454,6 +1540,7 @@ void Biquad::calcBiquad()
                 break;
         }
 
+        calcFxp();
         return;
     }
 
@@ -518,6 +1605,80 @@ void Biquad::calcBiquad()
             }
             break;
     }
+
+    calcFxp();
+}
+
+/* ---------------------------------------------------------------- */
+/* BiquadCascade -------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Append a copy of bq's coefficients as the next section,
+// up to BIQUAD_MAX_SECS. Resets state.
+//
+void BiquadCascade::add( const Biquad &bq )
+{
+    if( nSections() >= BIQUAD_MAX_SECS )
+        return;
+
+    K.push_back( bq.a0 );
+    K.push_back( bq.a1 );
+    K.push_back( bq.a2 );
+    K.push_back( bq.b1 );
+    K.push_back( bq.b2 );
+
+    vz.clear();
+}
+
+
+// Append sections for B at sample rate srate. Harmonics at
+// or above 0.45*srate, or beyond BIQUAD_MAX_SECS, are skipped.
+//
+void BiquadCascade::addBand( const BiquadBand &B, double srate )
+{
+    if( B.loHz > 0 )
+        add( Biquad( bq_type_highpass, B.loHz / srate ) );
+
+    if( B.hiHz > 0 )
+        add( Biquad( bq_type_lowpass, B.hiHz / srate ) );
+
+    for( int ih = 1; ih <= B.nNotch; ++ih ) {
+
+        double  f = ih * B.notchHz;
+
+        if( f >= 0.45 * srate )
+            break;
+
+        add( Biquad( bq_type_notch, f / srate, f / BIQUAD_NOTCH_BW ) );
+    }
+}
+
+
+void BiquadCascade::applyBlockwiseMem(
+    short   *data,
+    int     maxInt,
+    int     ntpts,
+    int     nchans,
+    int     c0,
+    int     cLim )
+{
+    int nneural = cLim - c0,
+        nSec    = nSections();
+
+    if( nneural <= 0 || !nSec )
+        return;
+
+    if( 2 * nSec * nneural != (int)vz.size() )
+        vz.assign( 2 * nSec * nneural, 0 );
+
+    double  Y = 1.0 / maxInt;
+
+    for( int it = 0; it < ntpts; ++it, data += nchans ) {
+
+        bqCasRow(
+            data + c0, &vz[0], &K[0], nSec,
+            Y, maxInt, nneural, nneural );
+    }
 }
 
 
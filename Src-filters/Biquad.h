@@ -20,39 +20,83 @@
 #define Biquad_h
 
 #include <QObject>
+#include <QMutex>
+#include <QWaitCondition>
 
 #include <vector>
 
 class QThread;
+class BiquadThread;
 
 /* ---------------------------------------------------------------- */
 /* Threading helpers ---------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
+// One channel-partition of a multithreaded Biquad call: (fn) on
+// (n) channels at (data), stride (nchans), for (ntpts) timepoints.
+// Caller's stack holds (K) and (remain) until the batch is done.
+// Non-filter work (e.g. viewer channel groups) shares the pool
+// via (fn), (ctx) and [i0,iLim).
+//
+struct BiquadJob {
+    void            (*fn)( const BiquadJob &J );
+    short           *data;
+    double          *z1,
+                    *z2;
+    const double    *K;
+    int             *remain;
+    void            *ctx;       // other pool users: own context
+    double          Y;
+    int             maxInt,
+                    ntpts,
+                    nchans,
+                    n,
+                    i0,         // other pool users: item range
+                    iLim;
+
+    void run() const    {fn( *this );}
+};
+
+// Persistent workers shared by all filters; started on first
+// use and sized by getNProcessors(). Callers post a batch of
+// jobs, work on it themselves, then wait until every job in
+// their batch is done. Several callers can share the pool.
+//
+class BiquadPool
+{
+    friend class BiquadWorker;
+
+private:
+    std::vector<BiquadThread*>          vT;
+    std::vector<BiquadJob>              queue;
+    QMutex                              poolMtx;
+    QWaitCondition                      condJob,
+                                        condDone;
+    bool                                stop;
+
+public:
+    static BiquadPool &pool();
+
+    BiquadPool( int nThd );
+    virtual ~BiquadPool();
+
+    int nWorkers() const    {return int(vT.size());}
+
+    void runBatch( std::vector<BiquadJob> &jobs );
+
+private:
+    bool take( BiquadJob &J, const int *remain = 0 );
+    void done( const BiquadJob &J );
+};
+
 class BiquadWorker : public QObject
 {
     Q_OBJECT
 
 private:
-    short   *data;
-    int     maxInt,
-            ntpts,
-            nchans,
-            c0,
-            cFirst,
-            cLim;
+    BiquadPool  &P;
 public:
-    BiquadWorker(
-        short   *data,
-        int     maxInt,
-        int     ntpts,
-        int     nchans,
-        int     c0,
-        int     cFirst,
-        int     cLim )
-    :   data(data), maxInt(maxInt),
-        ntpts(ntpts), nchans(nchans),
-        c0(c0), cFirst(cFirst), cLim(cLim)  {}
+    BiquadWorker( BiquadPool &P ) : P(P)    {}
 signals:
     void finished();
 public slots:
@@ -65,14 +109,7 @@ public:
     QThread         *thread;
     BiquadWorker    *worker;
 public:
-    BiquadThread(
-        short   *data,
-        int     maxInt,
-        int     ntpts,
-        int     nchans,
-        int     c0,
-        int     cFirst,
-        int     cLim );
+    BiquadThread( BiquadPool &P );
     virtual ~BiquadThread();
 };
 
@@ -91,6 +128,15 @@ public:
 
 #define BIQUAD_TRANS_WIDE  120
 
+// Most sections a BiquadCascade holds; add() ignores more.
+#define BIQUAD_MAX_SECS    8
+
+// Notch sections have this -3 dB width (Hz) at every harmonic.
+#define BIQUAD_NOTCH_BW    2.0
+
+// Default count of notched line harmonics (fundamental included).
+#define BIQUAD_NOTCH_NHARM 3
+
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -116,18 +162,22 @@ enum BiquadType {
 //
 // The bandpass option doesn't allow separate low/high edge specs.,
 // so instead, run highpass followed by lowpass. This is tested and
-// works correctly.
+// works correctly. BiquadCascade does both in one pass.
 //
 class Biquad
 {
-    friend class    BiquadWorker;
+    friend class    BiquadCascade;
 
 private:
     std::vector<double> vz1, vz2;
+    std::vector<qint16> vfs;    // fixed-point x1, x2, y1, y2
+    std::vector<qint32> vfe;    // fixed-point error feedback
     double  z1, z2;
     double  a0, a1, a2, b1, b2;
     double  Fc, Q, G;
     int     type;
+    qint16  fxK[5];
+    bool    fxp;
 
 public:
     Biquad();
@@ -150,14 +200,30 @@ public:
 
     float process( float in );
 
-    void clearMem()  {vz1.clear(); vz2.clear();}
+    void clearMem()  {vz1.clear(); vz2.clear(); vfs.clear(); vfe.clear();}
+
+    // Snapshot/restore applyBlockwiseMem state (z1s then z2s),
+    // so a caller can resume a stream at a checkpointed scan.
+    void getState( std::vector<double> &S ) const
+        {S = vz1; S.insert( S.end(), vz2.begin(), vz2.end() );}
+    void setState( const std::vector<double> &S )
+        {
+            vz1.assign( S.begin(), S.begin() + S.size()/2 );
+            vz2.assign( S.begin() + S.size()/2, S.end() );
+        }
+
+    // True if applyBlockwiseFxp() runs in fixed point for this
+    // filter and data range: highpass, or lowpass with cutoff
+    // above ~Fs/10, on 10-bit data (maxInt <= 512).
+    bool fxpOK( int maxInt ) const  {return fxp && maxInt <= 512;}
 
     // Apply filter in-place to (ntpts) worth of data, starting at
     // address (data). (nchans) includes (neural + aux) channels,
     // so is the array stride between timepoints. Filter will only
     // be applied to channel range [c0,cLim). Class retains state
     // data for each channel in the filtered range between calls.
-    // Work is distributed among nThd worker threads.
+    // Work is split into up to nThd channel groups, run by the
+    // calling thread and the shared BiquadPool.
     void applyBlockwiseThd(
         short   *data,
         int     maxInt,
@@ -167,6 +233,35 @@ public:
         int     cLim,
         int     nThd );
 
+    // As applyBlockwiseMem, but in Q14 fixed point on integer SIMD
+    // lanes when fxpOK( maxInt ), else simply calls that. Results
+    // are within 1 LSB of the double path. Fixed and double paths
+    // keep separate state; use one or the other on a stream.
+    void applyBlockwiseFxp(
+        short   *data,
+        int     maxInt,
+        int     ntpts,
+        int     nchans,
+        int     c0,
+        int     cLim );
+
+    // Apply filter forward then backward (zero phase, squared
+    // magnitude) in-place to (ntpts) worth of data, starting at
+    // address (data). (nchans) includes (neural + aux) channels,
+    // so is the array stride between timepoints. Filter will only
+    // be applied to channel range [c0,cLim). Block ends are padded
+    // by odd reflection, so no state is used or retained; callers
+    // wanting seamless blocks should overlap them. Channels are
+    // shared among up to nThd threads, as for applyBlockwiseThd.
+    void applyZeroPhase(
+        short   *data,
+        int     maxInt,
+        int     ntpts,
+        int     nchans,
+        int     c0,
+        int     cLim,
+        int     nThd );
+
     // Apply filter in-place to (ntpts) worth of data, starting at
     // address (data). (nchans) includes (neural + aux) channels,
     // so is the array stride between timepoints. Filter will only
@@ -217,9 +312,72 @@ public:
         int     ichan );
 
 private:
+    void calcFxp();
     void calcBiquad();
 };
 
+// Filter chain spec, as sections of a BiquadCascade: highpass at
+// loHz, lowpass at hiHz, then notches at notchHz and its next
+// nNotch-1 harmonics (line noise). Zero disables each part.
+//
+struct BiquadBand {
+    double  loHz,
+            hiHz,
+            notchHz;
+    int     nNotch;
+
+    BiquadBand(
+        double  loHz    = 0,
+        double  hiHz    = 0,
+        double  notchHz = 0,
+        int     nNotch  = 0 )
+    :   loHz(loHz), hiHz(hiHz),
+        notchHz(nNotch > 0 ? notchHz : 0),
+        nNotch(notchHz > 0 ? nNotch : 0)    {}
+
+    bool isOff() const
+        {return loHz <= 0 && hiHz <= 0 && notchHz <= 0;}
+
+    bool operator==( const BiquadBand &rhs ) const
+        {
+            return loHz == rhs.loHz && hiHz == rhs.hiHz
+                    && notchHz == rhs.notchHz && nNotch == rhs.nNotch;
+        }
+};
+
+// N Biquad sections applied in one pass per timepoint, e.g.,
+// highpass + lowpass as a bandpass, or stacked sections for a
+// higher order. Intermediate values stay in double; only the
+// final output is clamped to [-maxInt, maxInt). Each section
+// keeps state per channel in the filtered range between calls.
+//
+class BiquadCascade
+{
+private:
+    std::vector<double> K,  // {a0,a1,a2,b1,b2} per section
+                        vz; // per section: z1[nneural], z2[nneural]
+
+public:
+    void add( const Biquad &bq );
+    void addBand( const BiquadBand &B, double srate );
+    int nSections() const   {return int(K.size() / 5);}
+    const double *coeffs() const    {return (K.empty() ? 0 : &K[0]);}
+
+    void clearMem()         {vz.clear();}
+
+    // Apply all sections in-place to (ntpts) worth of data,
+    // starting at address (data). (nchans) includes (neural +
+    // aux) channels, so is the array stride between timepoints.
+    // Filter will only be applied to channel range [c0,cLim).
+    void applyBlockwiseMem(
+        short   *data,
+        int     maxInt,
+        int     ntpts,
+        int     nchans,
+        int     c0,
+        int     cLim );
+};
+
 inline float Biquad::process( float in ) {
     double  out = in * a0 + z1;
     z1 = in * a1 + z2 - b1 * out;
@@ -0,0 +1,257 @@
+
+#include "Decimator.h"
+
+#include <math.h>
+#include <string.h>
+
+
+#ifndef M_PI
+#define M_PI    3.14159265358979323846
+#endif
+
+
+// Kaiser beta for ~60 dB stopband.
+#define DECIM_BETA  5.65
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Zeroth order modified Bessel function (series).
+//
+static double besselI0( double x )
+{
+    double  sum = 1, term = 1, q = x * x / 4;
+
+    for( int k = 1; k < 50; ++k ) {
+
+        term *= q / (k * k);
+        sum  += term;
+
+        if( term < 1e-12 * sum )
+            break;
+    }
+
+    return sum;
+}
+
+/* ---------------------------------------------------------------- */
+/* Decimator ------------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+// Length nT has the parity of R, so the symmetric filter
+// centers exactly on the bin center m*R + (R-1)/2. Factor and
+// taps are clamped (DECIM_MAXDNSMP, DECIM_MAXTAPS) so nT stays
+// a sane allocation.
+//
+Decimator::Decimator( int dnsmp, int nchans, int tapsPerPhase )
+    :   R(qBound( 1, dnsmp, DECIM_MAXDNSMP )), nC(nchans)
+{
+    if( R == 1 ) {
+        nT  = 1;
+        off = 0;
+        h.assign( 1, 1.0F );
+    }
+    else {
+        nT = qBound( 2, tapsPerPhase, DECIM_MAXTAPS ) * R;
+
+        if( (nT - R) & 1 )
+            ++nT;
+
+        off = (R - nT) / 2;
+
+        double  fc  = 0.4 / R,
+                cen = 0.5 * (nT - 1),
+                i0b = besselI0( DECIM_BETA ),
+                sum = 0;
+
+        std::vector<double> H( nT );
+
+        for( int k = 0; k < nT; ++k ) {
+
+            double  t = k - cen,
+                    r = t / cen,
+                    s = (t ? sin( 2*M_PI*fc*t ) / (M_PI*t) : 2*fc);
+
+            H[k] = s * besselI0( DECIM_BETA * sqrt( qMax( 0.0, 1 - r*r ) ) )
+                    / i0b;
+            sum += H[k];
+        }
+
+        h.resize( nT );
+
+        for( int k = 0; k < nT; ++k )
+            h[k] = float(H[k] / sum);
+    }
+
+    clearMem();
+}
+
+
+void Decimator::clearMem()
+{
+    buf.clear();
+    nIn     = 0;
+    mNext   = 0;
+    buf0    = 0;
+}
+
+
+// Append ntpts scans; set dst to the outputs now complete.
+//
+// Return count of dst timepoints.
+//
+int Decimator::apply( vec_i16 &dst, const qint16 *src, int ntpts )
+{
+    dst.clear();
+
+    if( ntpts <= 0 )
+        return 0;
+
+    // Edge hold before first scan
+
+    if( !nIn ) {
+
+        buf0 = off;
+
+        for( int it = off; it < 0; ++it )
+            buf.insert( buf.end(), src, src + nC );
+    }
+
+    buf.insert( buf.end(), src, src + ntpts * nC );
+    nIn += ntpts;
+
+    // Outputs with whole support in buf
+
+    qint64  lim = qint64(nIn) - off - nT;
+
+    if( lim < 0 )
+        return 0;
+
+    int n = int(lim / R + 1 - qint64(mNext));
+
+    if( n <= 0 )
+        return 0;
+
+    dst.resize( n * nC );
+
+    for( int im = 0; im < n; ++im ) {
+
+        qint64  row = qint64(mNext + im) * R + off - buf0;
+
+        output( &dst[im * nC], &buf[row * nC] );
+    }
+
+    mNext += n;
+
+    // Drop scans no longer needed
+
+    qint64  keep0 = qint64(mNext) * R + off,
+            nDrop = keep0 - buf0;
+
+    if( nDrop > 0 ) {
+        buf.erase( buf.begin(), buf.begin() + nDrop * nC );
+        buf0 = keep0;
+    }
+
+    return n;
+}
+
+
+// Complete outputs through ceil(nIn/R), holding last scan,
+// then reset for a new stream.
+//
+// Return count of dst timepoints.
+//
+int Decimator::finish( vec_i16 &dst )
+{
+    dst.clear();
+
+    quint64 mTot = (nIn + R - 1) / R;
+
+    if( !nIn || mNext >= mTot ) {
+        clearMem();
+        return 0;
+    }
+
+    qint64  need = qint64(mTot - 1) * R + off + nT - qint64(nIn);
+    int     n    = 0;
+
+    if( need > 0 ) {
+
+        vec_i16 last( buf.end() - nC, buf.end() ),
+                pad;
+
+        pad.reserve( need * nC );
+
+        for( qint64 i = 0; i < need; ++i )
+            pad.insert( pad.end(), last.begin(), last.end() );
+
+        n = apply( dst, &pad[0], int(need) );
+    }
+
+    clearMem();
+    return n;
+}
+
+
+// One-shot counterpart to Subset::downsample.
+//
+// In-place operation (dst == src) is allowed.
+//
+// Return count of resulting dst timepoints.
+//
+uint Decimator::downsample(
+    vec_i16         &dst,
+    vec_i16         &src,
+    int             nchans,
+    int             dnsmp )
+{
+    int ntpts = (int)src.size() / nchans;
+
+    if( dnsmp <= 1 || !ntpts ) {
+
+        if( &dst != &src )
+            dst = src;
+
+        return ntpts;
+    }
+
+    Decimator   D( dnsmp, nchans );
+    vec_i16     A, B;
+
+    D.apply( A, &src[0], ntpts );
+    D.finish( B );
+
+    A.insert( A.end(), B.begin(), B.end() );
+    dst.swap( A );
+
+    return (uint)dst.size() / nchans;
+}
+
+
+// D = sum_k h[k] * X[k*nC], all channels.
+//
+void Decimator::output( qint16 *D, const qint16 *X )
+{
+    acc.assign( nC, 0.0F );
+
+    float   *A = &acc[0];
+
+    for( int k = 0; k < nT; ++k, X += nC ) {
+
+        float   hk = h[k];
+
+        for( int ic = 0; ic < nC; ++ic )
+            A[ic] += hk * X[ic];
+    }
+
+    for( int ic = 0; ic < nC; ++ic ) {
+
+        float   v = floorf( A[ic] + 0.5F );
+
+        D[ic] = qint16(v > 32767 ? 32767 : (v < -32768 ? -32768 : v));
+    }
+}
+
+
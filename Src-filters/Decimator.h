@@ -0,0 +1,74 @@
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include "SGLTypes.h"
+
+#include <vector>
+
+// Default FIR length per output (taps = DECIM_TAPS * dnsmp).
+#define DECIM_TAPS      16
+
+// Caps on dnsmp and tapsPerPhase, bounding the filter length.
+#define DECIM_MAXDNSMP  65535
+#define DECIM_MAXTAPS   64
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Anti-alias decimation by integer factor dnsmp.
+//
+// Kaiser-windowed sinc lowpass, cutoff 0.4 of the output rate,
+// about 60 dB down by output Nyquist. The filter is evaluated
+// only at kept outputs (polyphase: each output sums one phase
+// of the input), so cost per output scan is taps * nchans MACs,
+// a factor dnsmp below filtering at full rate, then dropping.
+//
+// Output m is centered on input bin [m*dnsmp, (m+1)*dnsmp), the
+// same timepoint Subset::downsample reports, so the two are
+// drop-in alternatives. Input before the first scan is taken as
+// a copy of the first scan (edge hold).
+//
+// Streaming: successive apply() calls continue seamlessly; each
+// returns the outputs whose whole support has arrived. finish()
+// flushes the rest, holding the last scan, so one-shot use
+// yields ceil(ntpts/dnsmp) outputs like Subset::downsample.
+//
+class Decimator
+{
+private:
+    std::vector<float>  h;
+    std::vector<float>  acc;
+    vec_i16             buf;        // pending input scans
+    quint64             nIn,        // scans received
+                        mNext;      // next output index
+    qint64              buf0;       // input index of buf[0]
+    int                 R,
+                        nT,
+                        off,        // support of y[m] starts at
+                        nC;         // m*R + off
+
+public:
+    Decimator( int dnsmp, int nchans, int tapsPerPhase = DECIM_TAPS );
+
+    int dnsmp() const   {return R;}
+    int nChans() const  {return nC;}
+
+    void clearMem();
+
+    int apply( vec_i16 &dst, const qint16 *src, int ntpts );
+    int finish( vec_i16 &dst );
+
+    static uint downsample(
+        vec_i16         &dst,
+        vec_i16         &src,
+        int             nchans,
+        int             dnsmp );
+
+private:
+    void output( qint16 *D, const qint16 *X );
+};
+
+#endif  // DECIMATOR_H
+
+
@@ -0,0 +1,435 @@
+
+#include "GpuCascade.h"
+#include "Biquad.h"
+#include "Util.h"
+
+#ifdef HAVE_OPENCL
+
+#define CL_TARGET_OPENCL_VERSION    120
+
+#ifdef MACX
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include <QMutex>
+
+#include <vector>
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Same arithmetic as bqCasRow_scalar(), one channel per item;
+// z1,z2 of section s at z[2*s*nN + i], z[(2*s+1)*nN + i].
+//
+static const char *bqKernelSrc =
+"#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n"
+"__kernel void bqCas(\n"
+"    __global short          *data,\n"
+"    __global double         *z,\n"
+"    __constant double       *K,\n"
+"    int                     nSec,\n"
+"    int                     nchans,\n"
+"    int                     c0,\n"
+"    int                     nN,\n"
+"    int                     ntpts,\n"
+"    int                     maxInt,\n"
+"    double                  Y )\n"
+"{\n"
+"    int i = get_global_id( 0 );\n"
+"    if( i >= nN )\n"
+"        return;\n"
+"    double  z1[BQ_MAXSEC], z2[BQ_MAXSEC];\n"
+"    for( int s = 0; s < nSec; ++s ) {\n"
+"        z1[s] = z[2*s*nN + i];\n"
+"        z2[s] = z[(2*s+1)*nN + i];\n"
+"    }\n"
+"    __global short  *p = data + c0 + i;\n"
+"    for( int it = 0; it < ntpts; ++it, p += nchans ) {\n"
+"        double  v = *p * Y;\n"
+"        for( int s = 0; s < nSec; ++s ) {\n"
+"            __constant double   *k = K + 5*s;\n"
+"            double              out = v * k[0] + z1[s];\n"
+"            z1[s] = v * k[1] + z2[s] - k[3] * out;\n"
+"            z2[s] = v * k[2] - k[4] * out;\n"
+"            v     = out;\n"
+"        }\n"
+"        *p = (short)clamp( (int)(v * maxInt), -maxInt, maxInt - 1 );\n"
+"    }\n"
+"    for( int s = 0; s < nSec; ++s ) {\n"
+"        z[2*s*nN + i]     = z1[s];\n"
+"        z[(2*s+1)*nN + i] = z2[s];\n"
+"    }\n"
+"}\n";
+
+
+// Device, context and program are shared by all cascades;
+// each cascade has its own queue, kernel and buffers, so
+// stages on different threads don't contend on the host.
+//
+struct GpuShared {
+    cl_context      ctx;
+    cl_device_id    dev;
+    cl_program      prog;
+    QString         name;
+    bool            tried,
+                    ok;
+
+    GpuShared() : ctx(0), dev(0), prog(0), tried(false), ok(false)  {}
+};
+
+static QMutex       gpuMtx;
+static GpuShared    gpu;
+
+
+static QString devInfoStr( cl_device_id dev, cl_device_info what )
+{
+    size_t  n = 0;
+
+    if( clGetDeviceInfo( dev, what, 0, 0, &n ) != CL_SUCCESS || !n )
+        return QString::null;
+
+    std::vector<char>   s( n + 1, 0 );
+
+    clGetDeviceInfo( dev, what, n, &s[0], 0 );
+
+    return QString( &s[0] );
+}
+
+
+// First GPU with double precision, over all platforms.
+//
+static cl_device_id pickDevice()
+{
+    cl_uint nP = 0;
+
+    if( clGetPlatformIDs( 0, 0, &nP ) != CL_SUCCESS || !nP )
+        return 0;
+
+    std::vector<cl_platform_id> vP( nP );
+
+    clGetPlatformIDs( nP, &vP[0], 0 );
+
+    for( cl_uint ip = 0; ip < nP; ++ip ) {
+
+        cl_uint nD = 0;
+
+        if( clGetDeviceIDs( vP[ip], CL_DEVICE_TYPE_GPU, 0, 0, &nD ) != CL_SUCCESS
+            || !nD ) {
+
+            continue;
+        }
+
+        std::vector<cl_device_id>   vD( nD );
+
+        clGetDeviceIDs( vP[ip], CL_DEVICE_TYPE_GPU, nD, &vD[0], 0 );
+
+        for( cl_uint id = 0; id < nD; ++id ) {
+
+            if( devInfoStr( vD[id], CL_DEVICE_EXTENSIONS )
+                    .contains( "cl_khr_fp64" ) ) {
+
+                return vD[id];
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+// Open shared state once. Caller holds gpuMtx.
+//
+static bool openShared()
+{
+    if( gpu.tried )
+        return gpu.ok;
+
+    gpu.tried = true;
+
+    if( !(gpu.dev = pickDevice()) ) {
+        Log() << "GPU filtering: No OpenCL GPU with double precision.";
+        return false;
+    }
+
+    gpu.name = devInfoStr( gpu.dev, CL_DEVICE_NAME );
+
+    cl_int      err;
+    QByteArray  opts = QString("-D BQ_MAXSEC=%1")
+                        .arg( BIQUAD_MAX_SECS ).toLatin1();
+
+    gpu.ctx = clCreateContext( 0, 1, &gpu.dev, 0, 0, &err );
+
+    if( err == CL_SUCCESS )
+        gpu.prog = clCreateProgramWithSource( gpu.ctx, 1, &bqKernelSrc, 0, &err );
+
+    if( err == CL_SUCCESS )
+        err = clBuildProgram( gpu.prog, 1, &gpu.dev, opts.constData(), 0, 0 );
+
+    if( err != CL_SUCCESS ) {
+
+        Warning() <<
+            QString("GPU filtering: Setup failed on [%1], error %2.")
+            .arg( gpu.name ).arg( err );
+
+        if( gpu.prog )
+            clReleaseProgram( gpu.prog );
+
+        if( gpu.ctx )
+            clReleaseContext( gpu.ctx );
+
+        gpu.prog    = 0;
+        gpu.ctx     = 0;
+        return false;
+    }
+
+    Log() << QString("GPU filtering on [%1].").arg( gpu.name );
+
+    return (gpu.ok = true);
+}
+
+/* ---------------------------------------------------------------- */
+/* GpuCascadeCL --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+struct GpuCascadeCL {
+    cl_command_queue    q;
+    cl_kernel           kern;
+    cl_mem              bData,
+                        bZ,
+                        bK;
+    int                 nSec;
+
+    GpuCascadeCL()
+    :   q(0), kern(0), bData(0), bZ(0), bK(0), nSec(0)  {}
+};
+
+/* ---------------------------------------------------------------- */
+/* GpuCascade ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+bool GpuCascade::available()
+{
+    QMutexLocker    ml( &gpuMtx );
+
+    return openShared();
+}
+
+
+QString GpuCascade::deviceName()
+{
+    QMutexLocker    ml( &gpuMtx );
+
+    return (openShared() ? gpu.name : QString::null);
+}
+
+
+// Filter channels [c0,cLim) of blocks up to maxScans long,
+// with row stride nchans, using the sections of C.
+//
+bool GpuCascade::init(
+    const BiquadCascade &C,
+    int                 nchans,
+    int                 c0,
+    int                 cLim,
+    int                 maxScans )
+{
+    release();
+
+    int nSec    = C.nSections(),
+        nN      = cLim - c0;
+
+    if( nSec <= 0 || nN <= 0 || maxScans <= 0 || !available() )
+        return false;
+
+    cl_int  err;
+
+    d       = new GpuCascadeCL;
+    d->nSec = nSec;
+    d->q    = clCreateCommandQueue( gpu.ctx, gpu.dev, 0, &err );
+
+    if( err == CL_SUCCESS )
+        d->kern = clCreateKernel( gpu.prog, "bqCas", &err );
+
+    if( err == CL_SUCCESS ) {
+        d->bK = clCreateBuffer(
+                    gpu.ctx, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                    5 * nSec * sizeof(double),
+                    (void*)C.coeffs(), &err );
+    }
+
+    if( err == CL_SUCCESS ) {
+        d->bZ = clCreateBuffer(
+                    gpu.ctx, CL_MEM_READ_WRITE,
+                    2 * nSec * nN * sizeof(double), 0, &err );
+    }
+
+    if( err == CL_SUCCESS ) {
+        d->bData = clCreateBuffer(
+                    gpu.ctx, CL_MEM_READ_WRITE,
+                    size_t(maxScans) * nchans * sizeof(short), 0, &err );
+    }
+
+    if( err != CL_SUCCESS ) {
+        Warning() << QString("GPU filtering: Buffers failed, error %1.").arg( err );
+        release();
+        return false;
+    }
+
+    this->nchans    = nchans;
+    this->c0        = c0;
+    this->cLim      = cLim;
+    this->maxScans  = maxScans;
+    zeroMem         = true;
+
+    return true;
+}
+
+
+void GpuCascade::release()
+{
+    if( !d )
+        return;
+
+    if( d->bData )
+        clReleaseMemObject( d->bData );
+
+    if( d->bZ )
+        clReleaseMemObject( d->bZ );
+
+    if( d->bK )
+        clReleaseMemObject( d->bK );
+
+    if( d->kern )
+        clReleaseKernel( d->kern );
+
+    if( d->q )
+        clReleaseCommandQueue( d->q );
+
+    delete d;
+    d = 0;
+}
+
+
+// Filter block in place (ntpts <= maxScans). The upload is
+// queued without waiting; the blocking readback orders it.
+//
+bool GpuCascade::apply( short *data, int maxInt, int ntpts )
+{
+    if( !d || ntpts > maxScans )
+        return false;
+
+    if( ntpts <= 0 )
+        return true;
+
+    int     nN      = cLim - c0;
+    size_t  bytes   = size_t(ntpts) * nchans * sizeof(short),
+            global  = nN;
+    cl_int  arg[6]  = {d->nSec, nchans, c0, nN, ntpts, maxInt},
+            err     = CL_SUCCESS;
+    double  Y       = 1.0 / maxInt;
+
+    if( zeroMem ) {
+
+        std::vector<double> z( 2 * d->nSec * nN, 0.0 );
+
+        err = clEnqueueWriteBuffer(
+                d->q, d->bZ, CL_TRUE, 0,
+                z.size() * sizeof(double), &z[0], 0, 0, 0 );
+
+        zeroMem = false;
+    }
+
+    if( err == CL_SUCCESS ) {
+        err = clEnqueueWriteBuffer(
+                d->q, d->bData, CL_FALSE, 0, bytes, data, 0, 0, 0 );
+    }
+
+    if( err == CL_SUCCESS )
+        err = clSetKernelArg( d->kern, 0, sizeof(cl_mem), &d->bData );
+
+    if( err == CL_SUCCESS )
+        err = clSetKernelArg( d->kern, 1, sizeof(cl_mem), &d->bZ );
+
+    if( err == CL_SUCCESS )
+        err = clSetKernelArg( d->kern, 2, sizeof(cl_mem), &d->bK );
+
+    for( int i = 0; i < 6 && err == CL_SUCCESS; ++i )
+        err = clSetKernelArg( d->kern, 3 + i, sizeof(cl_int), &arg[i] );
+
+    if( err == CL_SUCCESS )
+        err = clSetKernelArg( d->kern, 9, sizeof(double), &Y );
+
+    if( err == CL_SUCCESS ) {
+        err = clEnqueueNDRangeKernel(
+                d->q, d->kern, 1, 0, &global, 0, 0, 0, 0 );
+    }
+
+    if( err == CL_SUCCESS ) {
+        err = clEnqueueReadBuffer(
+                d->q, d->bData, CL_TRUE, 0, bytes, data, 0, 0, 0 );
+    }
+
+    if( err != CL_SUCCESS ) {
+        Warning() << QString("GPU filtering: Device error %1.").arg( err );
+        release();
+        return false;
+    }
+
+    return true;
+}
+
+#else   // !HAVE_OPENCL
+
+/* ---------------------------------------------------------------- */
+/* GpuCascade ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+bool GpuCascade::available()
+{
+    return false;
+}
+
+
+QString GpuCascade::deviceName()
+{
+    return QString::null;
+}
+
+
+bool GpuCascade::init(
+    const BiquadCascade &C,
+    int                 nchans,
+    int                 c0,
+    int                 cLim,
+    int                 maxScans )
+{
+    Q_UNUSED( C )
+    Q_UNUSED( nchans )
+    Q_UNUSED( c0 )
+    Q_UNUSED( cLim )
+    Q_UNUSED( maxScans )
+
+    return false;
+}
+
+
+void GpuCascade::release()
+{
+}
+
+
+bool GpuCascade::apply( short *data, int maxInt, int ntpts )
+{
+    Q_UNUSED( data )
+    Q_UNUSED( maxInt )
+    Q_UNUSED( ntpts )
+
+    return false;
+}
+
+#endif  // !HAVE_OPENCL
+
+
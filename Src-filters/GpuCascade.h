@@ -0,0 +1,58 @@
+#ifndef GPUCASCADE_H
+#define GPUCASCADE_H
+
+#include <QString>
+
+class BiquadCascade;
+struct GpuCascadeCL;
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Optional OpenCL offload of a BiquadCascade pass.
+//
+// One work-item per filtered channel runs all sections over
+// the block, with filter memory kept on the device between
+// calls; rows are read in place, so adjacent channels make
+// coalesced accesses. Output matches the CPU cascade (double
+// precision, same rounding and clipping), so a device without
+// cl_khr_fp64 isn't used.
+//
+// Built only with DEFINES += HAVE_OPENCL; otherwise available()
+// is false and callers keep the CPU path. Any device error makes
+// apply() return false, and the caller falls back for good.
+//
+class GpuCascade
+{
+private:
+    GpuCascadeCL    *d;
+    int             nchans,
+                    c0,
+                    cLim,
+                    maxScans;
+    bool            zeroMem;
+
+public:
+    GpuCascade() : d(0), nchans(0), c0(0), cLim(0), maxScans(0), zeroMem(true) {}
+    virtual ~GpuCascade()   {release();}
+
+    static bool available();
+    static QString deviceName();
+
+    bool init(
+        const BiquadCascade &C,
+        int                 nchans,
+        int                 c0,
+        int                 cLim,
+        int                 maxScans );
+    void release();
+
+    void clearMem()         {zeroMem = true;}
+
+    bool apply( short *data, int maxInt, int ntpts );
+};
+
+#endif  // GPUCASCADE_H
+
+
@@ -0,0 +1,369 @@
+
+#include "SpatialRef.h"
+#include "ShankMap.h"
+#include "Util.h"
+
+#include <algorithm>
+
+
+/* ---------------------------------------------------------------- */
+/* Run kernels ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Masked sum of n values d[i]*m[i] (m = 0/1), and in-place
+// subtraction of A from n values. Sums of int16 over a few
+// thousand channels fit int32 exactly; subtraction wraps as
+// the scalar int16 arithmetic does. The widest kernel the CPU
+// supports is chosen once at startup.
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#define SR_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SR_AVX2_FN
+#else
+#define SR_AVX2_FN __attribute__((target("avx2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define SR_NEON
+#include <arm_neon.h>
+#endif
+
+typedef qint32 (*SRSumFn)( const qint16 *d, const qint16 *m, int n );
+typedef void (*SRSubFn)( qint16 *d, int A, int n );
+
+
+static qint32 srSum_scalar( const qint16 *d, const qint16 *m, int n )
+{
+    qint32  S = 0;
+
+    for( int i = 0; i < n; ++i )
+        S += d[i] * m[i];
+
+    return S;
+}
+
+
+static void srSub_scalar( qint16 *d, int A, int n )
+{
+    for( int i = 0; i < n; ++i )
+        d[i] -= A;
+}
+
+
+#ifdef SR_X86
+
+static qint32 srSum_sse2( const qint16 *d, const qint16 *m, int n )
+{
+    __m128i acc = _mm_setzero_si128();
+    int     i   = 0;
+
+    for( ; i + 8 <= n; i += 8 ) {
+        acc = _mm_add_epi32( acc,
+                _mm_madd_epi16(
+                    _mm_loadu_si128( (__m128i*)(d + i) ),
+                    _mm_loadu_si128( (__m128i*)(m + i) ) ) );
+    }
+
+    acc = _mm_add_epi32( acc, _mm_shuffle_epi32( acc, 0x4E ) );
+    acc = _mm_add_epi32( acc, _mm_shuffle_epi32( acc, 0xB1 ) );
+
+    return _mm_cvtsi128_si32( acc ) + srSum_scalar( d + i, m + i, n - i );
+}
+
+
+static void srSub_sse2( qint16 *d, int A, int n )
+{
+    const __m128i   vA  = _mm_set1_epi16( qint16(A) );
+    int             i   = 0;
+
+    for( ; i + 8 <= n; i += 8 ) {
+        _mm_storeu_si128( (__m128i*)(d + i),
+            _mm_sub_epi16( _mm_loadu_si128( (__m128i*)(d + i) ), vA ) );
+    }
+
+    srSub_scalar( d + i, A, n - i );
+}
+
+
+SR_AVX2_FN
+static qint32 srSum_avx2( const qint16 *d, const qint16 *m, int n )
+{
+    __m256i acc = _mm256_setzero_si256();
+    int     i   = 0;
+
+    for( ; i + 16 <= n; i += 16 ) {
+        acc = _mm256_add_epi32( acc,
+                _mm256_madd_epi16(
+                    _mm256_loadu_si256( (__m256i*)(d + i) ),
+                    _mm256_loadu_si256( (__m256i*)(m + i) ) ) );
+    }
+
+    __m128i s = _mm_add_epi32(
+                    _mm256_castsi256_si128( acc ),
+                    _mm256_extracti128_si256( acc, 1 ) );
+
+    s = _mm_add_epi32( s, _mm_shuffle_epi32( s, 0x4E ) );
+    s = _mm_add_epi32( s, _mm_shuffle_epi32( s, 0xB1 ) );
+
+    return _mm_cvtsi128_si32( s ) + srSum_scalar( d + i, m + i, n - i );
+}
+
+
+SR_AVX2_FN
+static void srSub_avx2( qint16 *d, int A, int n )
+{
+    const __m256i   vA  = _mm256_set1_epi16( qint16(A) );
+    int             i   = 0;
+
+    for( ; i + 16 <= n; i += 16 ) {
+        _mm256_storeu_si256( (__m256i*)(d + i),
+            _mm256_sub_epi16( _mm256_loadu_si256( (__m256i*)(d + i) ), vA ) );
+    }
+
+    srSub_scalar( d + i, A, n - i );
+}
+
+#endif  // SR_X86
+
+
+#ifdef SR_NEON
+
+static qint32 srSum_neon( const qint16 *d, const qint16 *m, int n )
+{
+    int32x4_t   acc = vdupq_n_s32( 0 );
+    int         i   = 0;
+
+    for( ; i + 8 <= n; i += 8 ) {
+
+        int16x8_t   vd = vld1q_s16( d + i ),
+                    vm = vld1q_s16( m + i );
+
+        acc = vmlal_s16( acc, vget_low_s16( vd ), vget_low_s16( vm ) );
+        acc = vmlal_s16( acc, vget_high_s16( vd ), vget_high_s16( vm ) );
+    }
+
+    return vaddvq_s32( acc ) + srSum_scalar( d + i, m + i, n - i );
+}
+
+
+static void srSub_neon( qint16 *d, int A, int n )
+{
+    const int16x8_t vA  = vdupq_n_s16( qint16(A) );
+    int             i   = 0;
+
+    for( ; i + 8 <= n; i += 8 )
+        vst1q_s16( d + i, vsubq_s16( vld1q_s16( d + i ), vA ) );
+
+    srSub_scalar( d + i, A, n - i );
+}
+
+#endif  // SR_NEON
+
+
+static SRSumFn pickSRSum()
+{
+#if defined(SR_X86)
+    if( cpuHasAVX2() )
+        return srSum_avx2;
+
+    return srSum_sse2;
+#elif defined(SR_NEON)
+    return srSum_neon;
+#else
+    return srSum_scalar;
+#endif
+}
+
+
+static SRSubFn pickSRSub()
+{
+#if defined(SR_X86)
+    if( cpuHasAVX2() )
+        return srSub_avx2;
+
+    return srSub_sse2;
+#elif defined(SR_NEON)
+    return srSub_neon;
+#else
+    return srSub_scalar;
+#endif
+}
+
+static const SRSumFn    srSum   = pickSRSum();
+static const SRSubFn    srSub   = pickSRSub();
+
+/* ---------------------------------------------------------------- */
+/* SpatialRef ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Each set is split by shank (SM.e[ic].s); each (set, shank) group
+// gets its member list and its offsets as sorted consecutive runs.
+//
+void SpatialRef::build(
+    const ShankMap                          &SM,
+    const std::vector<std::vector<int> >    &sets,
+    bool                                    median )
+{
+    clear();
+
+    this->median = median;
+
+    int nOff = 0;
+
+    for( int iset = 0, nset = sets.size(); iset < nset; ++iset ) {
+
+        const std::vector<int>  &S = sets[iset];
+
+        for( int k = 0, n = S.size(); k < n; ++k )
+            nOff = qMax( nOff, S[k] + 1 );
+    }
+
+    umask.assign( nOff, 0 );
+
+    std::vector<std::vector<int> >  byShank( SM.ns );
+
+    for( int iset = 0, nset = sets.size(); iset < nset; ++iset ) {
+
+        const std::vector<int>  &S = sets[iset];
+
+        for( uint is = 0; is < SM.ns; ++is )
+            byShank[is].clear();
+
+        for( int k = 0, n = S.size(); k < n; ++k ) {
+
+            int                 ic  = S[k];
+            const ShankMapDesc  &E  = SM.e[ic];
+
+            byShank[E.s].push_back( ic );
+            umask[ic] = (E.u != 0);
+        }
+
+        for( uint is = 0; is < SM.ns; ++is ) {
+
+            std::vector<int>    &C = byShank[is];
+
+            if( C.empty() )
+                continue;
+
+            std::sort( C.begin(), C.end() );
+
+            Group   g;
+
+            g.r0 = R.size();
+
+            for( int k = 0, n = C.size(); k < n; ) {
+
+                int k0 = k;
+
+                while( ++k < n && C[k] == C[k - 1] + 1 )
+                    ;
+
+                R.push_back( Run( C[k0], k - k0 ) );
+            }
+
+            g.rLim = R.size();
+
+            for( int k = 0, n = C.size(); k < n; ++k ) {
+
+                if( umask[C[k]] )
+                    g.mbr.push_back( C[k] );
+            }
+
+            G.push_back( g );
+        }
+    }
+}
+
+
+// One set: neural channels [0,nAP).
+//
+void SpatialRef::buildAll( const ShankMap &SM, int nAP, bool median )
+{
+    std::vector<std::vector<int> >  sets( 1 );
+
+    for( int ic = 0; ic < nAP; ++ic )
+        sets[0].push_back( ic );
+
+    build( SM, sets, median );
+}
+
+
+void SpatialRef::apply( qint16 *d, int ntpts, int nC, int dwnSmp ) const
+{
+    if( G.empty() )
+        return;
+
+    int                 dStep = nC * dwnSmp;
+    std::vector<qint16> buf;
+
+    for( int it = 0; it < ntpts; it += dwnSmp, d += dStep ) {
+
+        if( median )
+            applyMedian( d, buf );
+        else
+            applyMean( d );
+    }
+}
+
+
+void SpatialRef::applyMean( qint16 *d ) const
+{
+    const qint16    *m = &umask[0];
+
+    for( int ig = 0, ng = G.size(); ig < ng; ++ig ) {
+
+        const Group &g = G[ig];
+        int         N  = g.mbr.size(),
+                    A  = 0;
+
+        if( N ) {
+
+            qint32  S = 0;
+
+            for( int ir = g.r0; ir < g.rLim; ++ir )
+                S += srSum( d + R[ir].c0, m + R[ir].c0, R[ir].n );
+
+            A = float(S) / N;
+        }
+
+        if( A ) {
+            for( int ir = g.r0; ir < g.rLim; ++ir )
+                srSub( d + R[ir].c0, A, R[ir].n );
+        }
+    }
+}
+
+
+void SpatialRef::applyMedian( qint16 *d, std::vector<qint16> &buf ) const
+{
+    for( int ig = 0, ng = G.size(); ig < ng; ++ig ) {
+
+        const Group &g = G[ig];
+        int         N  = g.mbr.size(),
+                    A;
+
+        if( !N )
+            continue;
+
+        buf.resize( N );
+
+        for( int k = 0; k < N; ++k )
+            buf[k] = d[g.mbr[k]];
+
+        std::nth_element( buf.begin(), buf.begin() + N/2, buf.end() );
+
+        A = buf[N/2];
+
+        if( !(N & 1) )
+            A = (A + *std::max_element( buf.begin(), buf.begin() + N/2 )) / 2;
+
+        if( A ) {
+            for( int ir = g.r0; ir < g.rLim; ++ir )
+                srSub( d + R[ir].c0, A, R[ir].n );
+        }
+    }
+}
+
+
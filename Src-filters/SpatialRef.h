@@ -0,0 +1,73 @@
+#ifndef SPATIALREF_H
+#define SPATIALREF_H
+
+#include <QtGlobal>
+
+#include <vector>
+
+struct ShankMap;
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Global spatial reference (-<S>): at each timepoint, subtract from
+// every channel of a group the mean (or median) of the group's used
+// channels. Groups are the given channel sets (all neural channels,
+// a mux stride residue, a demux row...) split by shank.
+//
+// Channel indices are offsets into a timepoint, and also index the
+// ShankMap entries; callers translate (e.g. file viewer ic2ig)
+// before building. A group is stored as runs of consecutive
+// offsets, so the common case (whole shank, a few references
+// masked out) is summed and subtracted on SIMD lanes.
+//
+// Mean results match the historical float-sum/truncate loops.
+// Median is exact: mean of the two middle values for even counts.
+//
+class SpatialRef
+{
+private:
+    struct Run {
+        int c0, n;
+        Run( int c0, int n ) : c0(c0), n(n) {}
+    };
+
+    struct Group {
+        std::vector<int>    mbr;    // used channels (for median)
+        int                 r0,     // runs [r0, rLim)
+                            rLim;
+    };
+
+    std::vector<Group>  G;
+    std::vector<Run>    R;
+    std::vector<qint16> umask;      // per offset: 1 if used
+    bool                median;
+
+public:
+    SpatialRef() : median(false)    {}
+
+    void clear()            {G.clear(); R.clear(); umask.clear();}
+    bool isEmpty() const    {return G.empty();}
+
+    void build(
+        const ShankMap                          &SM,
+        const std::vector<std::vector<int> >    &sets,
+        bool                                    median = false );
+
+    void buildAll(
+        const ShankMap  &SM,
+        int             nAP,
+        bool            median = false );
+
+    // Apply to every dwnSmp'th timepoint of (ntpts), stride (nC).
+    void apply( qint16 *d, int ntpts, int nC, int dwnSmp ) const;
+
+private:
+    void applyMean( qint16 *d ) const;
+    void applyMedian( qint16 *d, std::vector<qint16> &buf ) const;
+};
+
+#endif  // SPATIALREF_H
+
+
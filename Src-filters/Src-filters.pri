@@ -1,8 +1,16 @@
 
 HEADERS += \
-    $$PWD/Biquad.h
+    $$PWD/Biquad.h \
+    $$PWD/Decimator.h \
+    $$PWD/GpuCascade.h \
+    $$PWD/SpatialRef.h \
+    $$PWD/WelchPSD.h
 
 SOURCES += \
-    $$PWD/Biquad.cpp
+    $$PWD/Biquad.cpp \
+    $$PWD/Decimator.cpp \
+    $$PWD/GpuCascade.cpp \
+    $$PWD/SpatialRef.cpp \
+    $$PWD/WelchPSD.cpp
 
 
@@ -0,0 +1,153 @@
+
+#include "WelchPSD.h"
+
+#include <math.h>
+#include <algorithm>
+
+
+/* ---------------------------------------------------------------- */
+/* WelchPSD ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+WelchPSD::WelchPSD( int nfft, double fs ) : fs(fs), wss(0), N(nfft)
+{
+    int nb = 0;
+
+    while( (1 << nb) < N )
+        ++nb;
+
+    win.resize( N );
+    rev.resize( N );
+    wr.resize( N/2 );
+    wi.resize( N/2 );
+
+    for( int i = 0; i < N; ++i ) {
+
+        win[i]  = float(0.5 - 0.5 * cos( 2 * M_PI * i / N ));
+        wss    += double(win[i]) * win[i];
+
+        int r = 0;
+
+        for( int b = 0; b < nb; ++b ) {
+            if( i & (1 << b) )
+                r |= 1 << (nb - 1 - b);
+        }
+
+        rev[i] = r;
+    }
+
+    for( int k = 0; k < N/2; ++k ) {
+        wr[k] = float(cos( 2 * M_PI * k / N ));
+        wi[k] = float(-sin( 2 * M_PI * k / N ));
+    }
+}
+
+
+// Add one segment's periodogram of each of nch channels to P.
+// Channel ich's N samples are at x + ich*xstride; its nBins()
+// sums at P + ich*nBins().
+//
+void WelchPSD::addSegs(
+    double      *P,
+    const float *x,
+    int         xstride,
+    int         nch ) const
+{
+    std::vector<float>  re( N ),
+                        im( N, 0.0F );
+    const int           nB  = nBins();
+
+    for( int ich = 0; ich < nch; ich += 2 ) {
+
+        bool    two = ich + 1 < nch;
+
+        prep( &re[0], x + ich * xstride );
+
+        if( two )
+            prep( &im[0], x + (ich + 1) * xstride );
+        else
+            std::fill( im.begin(), im.end(), 0.0F );
+
+        fft( &re[0], &im[0] );
+
+        double  *A = P + ich * nB,
+                *B = A + nB;
+
+        // A = (Z[k] + conj(Z[N-k]))/2
+        // B = (Z[k] - conj(Z[N-k]))/2i
+        // Interior bins doubled for one-sided sums.
+
+        for( int k = 0; k < nB; ++k ) {
+
+            int     m   = (N - k) & (N - 1);
+            double  sr  = double(re[k]) + re[m],
+                    dr  = double(re[k]) - re[m],
+                    si  = double(im[k]) + im[m],
+                    di  = double(im[k]) - im[m],
+                    g   = (k && k < N/2 ? 0.5 : 0.25);
+
+            A[k] += g * (sr*sr + di*di);
+
+            if( two )
+                B[k] += g * (si*si + dr*dr);
+        }
+    }
+}
+
+
+// Copy segment x to dst, mean removed and windowed.
+//
+void WelchPSD::prep( float *dst, const float *x ) const
+{
+    double  sum = 0;
+
+    for( int i = 0; i < N; ++i )
+        sum += x[i];
+
+    float   ave = float(sum / N);
+
+    for( int i = 0; i < N; ++i )
+        dst[i] = (x[i] - ave) * win[i];
+}
+
+
+// In-place iterative radix-2 complex FFT.
+//
+void WelchPSD::fft( float *re, float *im ) const
+{
+    for( int i = 0; i < N; ++i ) {
+
+        int j = rev[i];
+
+        if( i < j ) {
+            std::swap( re[i], re[j] );
+            std::swap( im[i], im[j] );
+        }
+    }
+
+    for( int len = 2; len <= N; len <<= 1 ) {
+
+        int half = len / 2,
+            step = N / len;
+
+        for( int i = 0; i < N; i += len ) {
+
+            for( int k = 0; k < half; ++k ) {
+
+                float   cr  = wr[k * step],
+                        ci  = wi[k * step];
+                int     a   = i + k,
+                        b   = a + half;
+                float   tr  = re[b]*cr - im[b]*ci,
+                        ti  = re[b]*ci + im[b]*cr;
+
+                re[b]   = re[a] - tr;
+                im[b]   = im[a] - ti;
+                re[a]  += tr;
+                im[a]  += ti;
+            }
+        }
+    }
+}
+
+
@@ -0,0 +1,56 @@
+#ifndef WELCHPSD_H
+#define WELCHPSD_H
+
+#include <vector>
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Welch power spectral density over many channels.
+//
+// Segments of nfft (a power of 2) samples have their mean taken
+// out, are Hann windowed and transformed; one-sided periodograms
+// are summed into P, nBins() values per channel. Multiply sums
+// by density(nSeg) for input units^2 per Hz.
+//
+// Channels go two at a time as the real and imaginary parts of
+// one complex FFT, separated after using the conjugate symmetry
+// of real spectra, so a batch of nch real FFTs costs about nch/2
+// complex ones. Tables are read-only after construction, so one
+// object serves concurrent addSegs() calls on disjoint P.
+//
+class WelchPSD
+{
+private:
+    std::vector<float>  win,
+                        wr,     // twiddles exp(-2 pi i k/N)
+                        wi;
+    std::vector<int>    rev;    // bit reversal
+    double              fs,
+                        wss;    // sum of win^2
+    int                 N;
+
+public:
+    WelchPSD( int nfft, double fs );
+
+    int nFFT() const        {return N;}
+    int nBins() const       {return N/2 + 1;}
+    double binHz() const    {return fs / N;}
+    double density( int nSeg ) const
+        {return (nSeg > 0 ? 1.0 / (nSeg * fs * wss) : 0);}
+
+    void addSegs(
+        double      *P,
+        const float *x,
+        int         xstride,
+        int         nch ) const;
+
+private:
+    void prep( float *dst, const float *x ) const;
+    void fft( float *re, float *im ) const;
+};
+
+#endif  // WELCHPSD_H
+
+
@@ -49,6 +49,9 @@ bool GateBase::baseStartReaders()
 
 // Config allowance: np probes X 20 sec each + 10 sec NI.
 
+    double  tImRdy  = 0,
+            tNiRdy  = 0;
+
     while( !isStopped() ) {
 
         if( getTime() - tStart > np*20.0 + 10.0 ) {
@@ -68,10 +71,13 @@ bool GateBase::baseStartReaders()
         if( ni && !ni->thread->isRunning() )
             goto wait_external_kill;
 
-        if( im && !im->worker->isReady() )
-            continue;
+        if( im && !tImRdy && im->worker->isReady() )
+            tImRdy = getTime();
 
-        if( ni && !ni->worker->isReady() )
+        if( ni && !tNiRdy && ni->worker->isReady() )
+            tNiRdy = getTime();
+
+        if( (im && !tImRdy) || (ni && !tNiRdy) )
             continue;
 
         break;
@@ -136,6 +142,24 @@ samples_loop_again:;
         // and we might introduce long startup latency.
     }
 
+// Phase timing: each config ran from its configure() call, in
+// parallel with the other and with run setup.
+
+    if( !isStopped() ) {
+
+        QString s = "Startup:";
+
+        if( im )
+            s += QString(" imec config %1 s,").arg( tImRdy - im->tConfig, 0, 'f', 2 );
+
+        if( ni )
+            s += QString(" nidq config %1 s,").arg( tNiRdy - ni->tConfig, 0, 'f', 2 );
+
+        s += QString(" start to samples %1 s.").arg( getTime() - tStart, 0, 'f', 2 );
+
+        Log() << s;
+    }
+
 // ---------
 // Adjust t0
 // ---------
@@ -213,11 +237,12 @@ wait_external_kill:
 
 void GateBase::baseSleep()
 {
-    if( canSleep() ) {
-        runMtx.lock();
+    runMtx.lock();
+
+    if( canSleep() )
         condWake.wait( &runMtx );
-        runMtx.unlock();
-    }
+
+    runMtx.unlock();
 }
 
 /* ---------------------------------------------------------------- */
@@ -5,6 +5,8 @@
 #include <QMutex>
 #include <QWaitCondition>
 
+#include <atomic>
+
 namespace DAQ {
 struct Params;
 }
@@ -27,7 +29,7 @@ private:
     NIReader                *ni;
     mutable QMutex          runMtx;
     mutable QWaitCondition  condWake;
-    volatile bool           _canSleep,
+    std::atomic<bool>       _canSleep,
                             pleaseStop;
 
 protected:
@@ -41,11 +43,19 @@ public:
         TrigBase            *trg  );
     virtual ~GateBase() {}
 
+    // Flag locking as in CimAcq (test here is in baseSleep()).
     void wake()             {condWake.wakeAll();}
-    void stayAwake()        {QMutexLocker ml( &runMtx ); _canSleep = false;}
-    bool canSleep() const   {QMutexLocker ml( &runMtx ); return _canSleep;}
-    void stop()             {QMutexLocker ml( &runMtx ); pleaseStop = true;}
-    bool isStopped() const  {QMutexLocker ml( &runMtx ); return pleaseStop;}
+    void stayAwake()
+        {
+            QMutexLocker ml( &runMtx );
+            _canSleep.store( false, std::memory_order_release );
+        }
+    bool canSleep() const
+        {return _canSleep.load( std::memory_order_acquire );}
+    void stop()
+        {pleaseStop.store( true, std::memory_order_release );}
+    bool isStopped() const
+        {return pleaseStop.load( std::memory_order_acquire );}
 
 signals:
     void runStarted();
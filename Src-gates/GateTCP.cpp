@@ -6,10 +6,11 @@
 
 
 // This does the work (not run()).
+// Edge time t (stream time) or if t < 0, now.
 //
-void GateTCP::rgtSetGate( bool hi )
+void GateTCP::rgtSetGate( bool hi, double t )
 {
-    trg->setGate( hi );
+    trg->setGate( hi, t );
 }
 
 
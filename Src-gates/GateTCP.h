@@ -17,7 +17,7 @@ public:
         TrigBase            *trg  )
     :   GateBase( p, im, ni, trg )  {}
 
-    void rgtSetGate( bool hi );
+    void rgtSetGate( bool hi, double t = -1 );
 
 public slots:
     virtual void run();
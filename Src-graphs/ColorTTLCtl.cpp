@@ -9,10 +9,39 @@
 #include "HelpButDialog.h"
 #include "SignalBlocker.h"
 #include "Subset.h"
+#include "AIQ.h"
 
 #include <QMessageBox>
 #include <QSettings>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+#define CTTL_TILE   512     // AIQ edge kernel tile
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+static inline int ctz64( quint64 x )
+{
+#ifdef _MSC_VER
+    unsigned long   i;
+#ifdef _M_X64
+    _BitScanForward64( &i, x );
+#else
+    if( !_BitScanForward( &i, quint32(x) ) ) {
+        _BitScanForward( &i, quint32(x >> 32) );
+        i += 32;
+    }
+#endif
+    return i;
+#else
+    return __builtin_ctzll( x );
+#endif
+}
 
 /* ---------------------------------------------------------------- */
 /* TTLClrEach ----------------------------------------------------- */
@@ -532,7 +561,7 @@ void ColorTTLCtl::saveSettings() const
 
 void ColorTTLCtl::resetState()
 {
-    memset( state, 0, 4*sizeof(int) );
+    memset( es, 0, 4*sizeof(EdgeState) );
 }
 
 
@@ -596,243 +625,125 @@ bool ColorTTLCtl::getChan(
 }
 
 
-bool ColorTTLCtl::findRisingEdge(
-    int         &outCt,
-    const short *data,
-    int         ntpts,
-    int         offset,
-    int         nchans,
-    int         chan,
-    qint16      T ) const
-{
-    const short *d      = &data[chan + offset*nchans],
-                *dlim   = &data[chan +  ntpts*nchans];
-    int         nok     = 0;
-
-// -------------------
-// Must start on a low
-// -------------------
-
-    if( *d >= T ) {
-
-        while( (d += nchans) < dlim ) {
-
-            if( *d < T )
-                goto seek_edge;
-        }
-
-        return false;
-    }
-
-// -------------------
-// Seek edge candidate
-// -------------------
-
-seek_edge:
-    while( (d += nchans) < dlim ) {
-
-        if( *d >= T ) {
-
-            // Mark edge start
-            outCt   = (d - &data[chan]) / nchans;
-            nok     = 1;
+#define DST_TREL( ct )  (syncDstTAbs( ct, src, dst, p ) - dst->Q->tZero())
 
-            if( set.inarow == 1 )
-                return true;
 
-            // Check extended run length
-            while( (d += nchans) < dlim ) {
+void ColorTTLCtl::addSpan( Stream *src, Stream *dst, int clr, quint64 ct )
+{
+    double  start = ct / src->Q->sRate();
 
-                if( *d >= T ) {
+    src->X->spanMtx.lock();
+    src->X->evQ[clr].push_back( EvtSpan( start, start + set.minSecs ) );
+    src->X->spanMtx.unlock();
 
-                    if( ++nok >= set.inarow )
-                        return true;
-                }
-                else
-                    break;
-            }
-        }
+    if( dst ) {
+        start = DST_TREL( ct );
+        dst->X->spanMtx.lock();
+        dst->X->evQ[clr].push_back( EvtSpan( start, start + set.minSecs ) );
+        dst->X->spanMtx.unlock();
     }
-
-// ----
-// Fail
-// ----
-
-    return false;
 }
 
 
-bool ColorTTLCtl::findBitRisingEdge(
-    int         &outCt,
-    const short *data,
-    int         ntpts,
-    int         offset,
-    int         nchans,
-    int         chan,
-    int         bit ) const
+void ColorTTLCtl::extendSpan( Stream *src, Stream *dst, int clr, quint64 ct )
 {
-    const short *d      = &data[chan + offset*nchans],
-                *dlim   = &data[chan +  ntpts*nchans];
-    int         nok     = 0;
-
-// -------------------
-// Must start on a low
-// -------------------
+    double  end = ct / src->Q->sRate();
 
-    if( (*d >> bit) & 1 ) {
+    src->X->spanMtx.lock();
+    src->X->evQExtendLast( end, set.minSecs, clr );
+    src->X->spanMtx.unlock();
 
-        while( (d += nchans) < dlim ) {
-
-            if( !((*d >> bit) & 1))
-                goto seek_edge;
-        }
-
-        return false;
+    if( dst ) {
+        end = DST_TREL( ct );
+        dst->X->spanMtx.lock();
+        dst->X->evQExtendLast( end, set.minSecs, clr );
+        dst->X->spanMtx.unlock();
     }
-
-// -------------------
-// Seek edge candidate
-// -------------------
-
-seek_edge:
-    while( (d += nchans) < dlim ) {
-
-        if( (*d >> bit) & 1 ) {
-
-            // Mark edge start
-            outCt   = (d - &data[chan]) / nchans;
-            nok     = 1;
-
-            if( set.inarow == 1 )
-                return true;
-
-            // Check extended run length
-            while( (d += nchans) < dlim ) {
-
-                if( (*d >> bit) & 1 ) {
-
-                    if( ++nok >= set.inarow )
-                        return true;
-                }
-                else
-                    break;
-            }
-        }
-    }
-
-// ----
-// Fail
-// ----
-
-    return false;
 }
 
 
-bool ColorTTLCtl::findFallingEdge(
-    int         &outCt,
-    const short *data,
-    int         ntpts,
-    int         offset,
-    int         nchans,
-    int         chan,
-    qint16      T ) const
+// Step clr's edge state over nb level bits w (bit set = high),
+// bit 0 being count ct0. Whole runs of bits are skipped at once.
+//
+// A run of inarow highs, after a low, starts an event at its
+// first scan; a run of inarow lows ends it likewise.
+//
+void ColorTTLCtl::scanBits(
+    Stream      *src,
+    Stream      *dst,
+    int         clr,
+    quint64     w,
+    int         nb,
+    quint64     ct0 )
 {
-    const short *d      = &data[chan + offset*nchans],
-                *dlim   = &data[chan +  ntpts*nchans];
-    int         nok     = 0;
+    EdgeState   &E      = es[clr];
+    int         inarow  = qMax( set.inarow, 1 ),
+                i       = 0;
 
-// -------------------
-// Seek edge candidate
-// -------------------
+    while( i < nb ) {
 
-    while( (d += nchans) < dlim ) {
+        // r bit set where sample at sought level
 
-        if( *d < T ) {
+        quint64 r = (E.lvl ? ~w : w) >> i;
+        int     n;
 
-            // Mark edge start
-            outCt   = (d - &data[chan]) / nchans;
-            nok     = 1;
+        if( !E.armed ) {
 
-            if( set.inarow == 1 )
-                return true;
+            // Must start on a low
 
-            // Check extended run length
-            while( (d += nchans) < dlim ) {
+            n = (~r ? ctz64( ~r ) : 64);
 
-                if( *d < T ) {
+            if( (i += n) < nb )
+                E.armed = true;
 
-                    if( ++nok >= set.inarow )
-                        return true;
-                }
-                else
-                    break;
-            }
+            continue;
         }
-    }
 
-// ----
-// Fail
-// ----
+        if( !E.run ) {
 
-    return false;
-}
+            // Seek run start
 
+            n = (r ? ctz64( r ) : 64);
 
-bool ColorTTLCtl::findBitFallingEdge(
-    int         &outCt,
-    const short *data,
-    int         ntpts,
-    int         offset,
-    int         nchans,
-    int         chan,
-    int         bit ) const
-{
-    const short *d      = &data[chan + offset*nchans],
-                *dlim   = &data[chan +  ntpts*nchans];
-    int         nok     = 0;
-
-// -------------------
-// Seek edge candidate
-// -------------------
+            if( (i += n) >= nb )
+                break;
 
-    while( (d += nchans) < dlim ) {
+            E.runCt  = ct0 + i;
+            r      >>= n;
+        }
 
-        if( !((*d >> bit) & 1) ) {
+        // Extend run
 
-            // Mark edge start
-            outCt   = (d - &data[chan]) / nchans;
-            nok     = 1;
+        n = qMin( (~r ? ctz64( ~r ) : 64), nb - i );
 
-            if( set.inarow == 1 )
-                return true;
+        if( E.run + n >= inarow ) {
 
-            // Check extended run length
-            while( (d += nchans) < dlim ) {
+            i      += inarow - E.run;
+            E.run   = 0;
 
-                if( !((*d >> bit) & 1) ) {
+            if( E.lvl )
+                extendSpan( src, dst, clr, E.runCt );
+            else
+                addSpan( src, dst, clr, E.runCt );
 
-                    if( ++nok >= set.inarow )
-                        return true;
-                }
-                else
-                    break;
-            }
+            E.lvl = !E.lvl;
+            continue;
         }
-    }
 
-// ----
-// Fail
-// ----
+        E.run += n;
 
-    return false;
+        if( (i += n) < nb )
+            E.run = 0;
+    }
 }
 
 
-#define DST_TREL( ct )  (syncDstTAbs( ct, src, dst, p ) - dst->Q->tZero())
-
-
 // On each call whole data block is scanned.
-// The state[] variables bridge action across blocks.
+// The es[] variables bridge action (and runs) across blocks.
+//
+// Each watched channel is gathered a tile at a time, once for
+// all colors using it, and reduced to level bitmasks by the
+// vectorized AIQ edge kernels.
 //
 void ColorTTLCtl::processEvents(
     const vec_i16       &data,
@@ -843,6 +754,9 @@ void ColorTTLCtl::processEvents(
 {
     const int ntpts = (int)data.size() / nC;
 
+    if( !ntpts )
+        return;
+
     Stream  *src,
             *dst = 0;
 
@@ -857,95 +771,60 @@ void ColorTTLCtl::processEvents(
             dst = &A;
     }
 
-    for( int i = 0, ni = vClr.size(); i < ni; ++i ) {
+    int     nclr = vClr.size(),
+            chan[4], bit[4], thresh[4];
+    bool    isAnalog[4];
 
-        int     clr     = vClr[i],
-                nextCt  = 0,
-                chan, bit, thresh;
-        bool    isAnalog,
-                found;
+    for( int i = 0; i < nclr; ++i )
+        isAnalog[i] = getChan( chan[i], bit[i], thresh[i], vClr[i], ip );
 
-        isAnalog = getChan( chan, bit, thresh, clr, ip );
+    qint16  tile[4][CTTL_TILE];
+    quint64 bits[CTTL_TILE/64];
 
-        while( nextCt < ntpts ) {
+    for( int it0 = 0; it0 < ntpts; it0 += CTTL_TILE ) {
 
-            if( !state[clr] ) {
+        int nt      = qMin( CTTL_TILE, ntpts - it0 ),
+            ntile   = 0,
+            tchan[4];
 
-                // Low, seeking high
+        for( int i = 0; i < nclr; ++i ) {
 
-                if( isAnalog ) {
-                    found = findRisingEdge(
-                                nextCt, &data[0], ntpts,
-                                nextCt, nC, chan, thresh );
-                }
-                else {
-                    found = findBitRisingEdge(
-                                nextCt, &data[0], ntpts,
-                                nextCt, nC, chan, bit );
-                }
+            int j = 0;
 
-                if( found ) {
+            while( j < ntile && tchan[j] != chan[i] )
+                ++j;
 
-                    quint64 ct      = headCt + nextCt;
-                    double  start   = ct / src->Q->sRate();
+            if( j == ntile ) {
 
-                    state[clr]  = 1;
-                    nextCt     += set.inarow;
+                const qint16    *S = &data[it0*nC + chan[i]];
+                qint16          *D = tile[j];
 
-                    src->X->spanMtx.lock();
-                    src->X->evQ[clr].push_back(
-                        EvtSpan( start, start + set.minSecs ) );
-                    src->X->spanMtx.unlock();
+                for( int it = 0; it < nt; ++it, S += nC )
+                    D[it] = *S;
 
-                    if( dst ) {
-                        start = DST_TREL( ct );
-                        dst->X->spanMtx.lock();
-                        dst->X->evQ[clr].push_back(
-                            EvtSpan( start, start + set.minSecs ) );
-                        dst->X->spanMtx.unlock();
-                    }
-                }
-                else
-                    goto next_clr;
+                tchan[ntile++] = chan[i];
             }
 
-            // high, seeking low
-
-            if( isAnalog ) {
-                found = findFallingEdge(
-                            nextCt, &data[0], ntpts,
-                            nextCt, nC, chan, thresh );
-            }
-            else {
-                found = findBitFallingEdge(
-                            nextCt, &data[0], ntpts,
-                            nextCt, nC, chan, bit );
-            }
+            if( isAnalog[i] )
+                AIQ::threshMask512( bits, tile[j], nt, thresh[i] );
+            else
+                AIQ::bitMask512( bits, tile[j], nt, bit[i] );
 
-            // always update painting
+            for( int iw = 0; iw * 64 < nt; ++iw ) {
 
-            quint64 ct  = headCt + (found ? nextCt : ntpts-1);
-            double  end = ct / src->Q->sRate();
+                scanBits( src, dst, vClr[i],
+                    bits[iw], qMin( 64, nt - iw * 64 ),
+                    headCt + it0 + iw * 64 );
+            }
+        }
+    }
 
-            src->X->spanMtx.lock();
-            src->X->evQExtendLast( end, set.minSecs, clr );
-            src->X->spanMtx.unlock();
+// Always update painting: open events reach block end
 
-            if( dst ) {
-                end = DST_TREL( ct );
-                dst->X->spanMtx.lock();
-                dst->X->evQExtendLast( end, set.minSecs, clr );
-                dst->X->spanMtx.unlock();
-            }
+    for( int i = 0; i < nclr; ++i ) {
 
-            if( found ) {
-                nextCt     += set.inarow;
-                state[clr]  = 0;
-            }
-            else
-                goto next_clr;
-        }
-next_clr:;
+        if( es[vClr[i]].lvl )
+            extendSpan( src, dst, vClr[i], headCt + ntpts - 1 );
     }
 }
 
@@ -69,6 +69,13 @@ private:
         void analogChanged( TTLClrEach &C, bool algCBChanged );
     };
 
+    struct EdgeState {
+        quint64 runCt;  // start of current run
+        int     lvl,    // {0,1}=seek{high,low}
+                run;    // length of current run
+        bool    armed;  // low seen since reset
+    };
+
     struct Stream : public SyncStream {
         MGraphX *X;
 
@@ -87,7 +94,7 @@ private:
     TTLClrSet           set,
                         uiSet;
     mutable QMutex      setMtx;
-    int                 state[4];   // {0,1}=seek{high,low}
+    EdgeState           es[4];
 
 public:
     ColorTTLCtl( QObject *parent, const DAQ::Params &p );
@@ -141,41 +148,16 @@ private:
         int     clr,
         int     ip ) const;
 
-    bool findRisingEdge(
-        int         &outCt,
-        const short *data,
-        int         ntpts,
-        int         offset,
-        int         nchans,
-        int         chan,
-        qint16      T ) const;
-
-    bool findBitRisingEdge(
-        int         &outCt,
-        const short *data,
-        int         ntpts,
-        int         offset,
-        int         nchans,
-        int         chan,
-        int         bit ) const;
-
-    bool findFallingEdge(
-        int         &outCt,
-        const short *data,
-        int         ntpts,
-        int         offset,
-        int         nchans,
-        int         chan,
-        qint16      T ) const;
-
-    bool findBitFallingEdge(
-        int         &outCt,
-        const short *data,
-        int         ntpts,
-        int         offset,
-        int         nchans,
-        int         chan,
-        int         bit ) const;
+    void addSpan( Stream *src, Stream *dst, int clr, quint64 ct );
+    void extendSpan( Stream *src, Stream *dst, int clr, quint64 ct );
+
+    void scanBits(
+        Stream      *src,
+        Stream      *dst,
+        int         clr,
+        quint64     w,
+        int         nb,
+        quint64     ct0 );
 
     void processEvents(
         const vec_i16       &data,
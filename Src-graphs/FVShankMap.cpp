@@ -0,0 +1,219 @@
+
+#include "Util.h"
+#include "FileViewerWindow.h"
+#include "FVShankMap.h"
+#include "DataFile.h"
+#include "DFActivity.h"
+#include "ShankView.h"
+#include "SignalBlocker.h"
+
+#include <QComboBox>
+#include <QHBoxLayout>
+#include <QKeyEvent>
+#include <QLabel>
+#include <QSettings>
+#include <QSpinBox>
+#include <QVBoxLayout>
+
+
+/* ---------------------------------------------------------------- */
+/* FVShankMap ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+FVShankMap::FVShankMap( FileViewerWindow *fv )
+    :   QWidget(0), fv(fv), s0Drawn(0), sLimDrawn(0),
+        what(0), drawn(false)
+{
+    loadSettings();
+
+    QVBoxLayout *VL = new QVBoxLayout( this );
+    QHBoxLayout *HL = new QHBoxLayout;
+
+    whatCB = new QComboBox( this );
+    whatCB->addItem( "Spike rate Hz" );
+    whatCB->addItem( "Pk-pk uV" );
+    whatCB->addItem( "Rms uV" );
+    whatCB->setCurrentIndex( what );
+    HL->addWidget( whatCB );
+
+    HL->addWidget( new QLabel( "Color max", this ) );
+
+    rngSB = new QSpinBox( this );
+    rngSB->setRange( 1, 10000 );
+    rngSB->setValue( rng[what] );
+    HL->addWidget( rngSB );
+    HL->addStretch();
+
+    VL->addLayout( HL );
+
+    scroll = new ShankScroll( this );
+    scroll->setMinimumSize( 160, 320 );
+    VL->addWidget( scroll, 1 );
+
+    spanLbl = new QLabel( this );
+    VL->addWidget( spanLbl );
+
+    statusLbl = new QLabel( this );
+    VL->addWidget( statusLbl );
+
+    ConnectUI( whatCB, SIGNAL(currentIndexChanged(int)), this, SLOT(whatChanged(int)) );
+    ConnectUI( rngSB, SIGNAL(valueChanged(int)), this, SLOT(rangeChanged(int)) );
+    ConnectUI( scroll->theV, SIGNAL(cursorOver(int,bool)), this, SLOT(cursorOver(int,bool)) );
+
+    setAttribute( Qt::WA_DeleteOnClose, false );
+}
+
+
+void FVShankMap::setShankMap( const ShankMap *map )
+{
+    scroll->theV->setShankMap( map );
+    scroll->adjustLayout();
+
+    drawn = false;
+    updateMap();
+}
+
+
+// Color pads for the selection, else the whole file; skipped
+// if that span is already drawn.
+//
+void FVShankMap::updateMap()
+{
+    const ShankMap  *M = scroll->theV->getSmap();
+
+    if( !M )
+        return;
+
+    int ne = M->e.size();
+
+    if( !fv->act || !fv->act->isReady() ) {
+
+        spanLbl->setText( fv->act ? "Indexing file activity..." : "" );
+        val.assign( ne, 0.0 );
+        drawn = false;
+    }
+    else {
+
+        DataFile    *df     = fv->df;
+        double      srate   = df->samplingRateHz();
+        quint64     s0      = 0,
+                    sLim    = df->scanCount();
+        bool        sel     = fv->dragL >= 0 && fv->dragR > fv->dragL;
+
+        if( sel ) {
+            s0      = fv->dragL;
+            sLim    = fv->dragR + 1;
+        }
+
+        if( drawn && s0 == s0Drawn && sLim == sLimDrawn )
+            return;
+
+        if( !fv->act->values( val, what, s0, sLim ) )
+            return;
+
+        // Counts to uV
+
+        if( what != DFActivity::Rate ) {
+
+            double  uVPerCt = 1e6 * df->vRange().span() / (2 * df->maxInt());
+            int     n       = qMin( (int)val.size(), (int)fv->grfParams.size() );
+
+            for( int i = 0; i < n; ++i )
+                val[i] *= uVPerCt / fv->grfParams[i].gain;
+        }
+
+        val.resize( ne, 0.0 );
+
+        spanLbl->setText(
+            QString("%1 s to %2 s%3")
+            .arg( s0 / srate, 0, 'f', 3 )
+            .arg( sLim / srate, 0, 'f', 3 )
+            .arg( sel ? "" : " (whole file)" ) );
+
+        s0Drawn     = s0;
+        sLimDrawn   = sLim;
+        drawn       = true;
+    }
+
+    if( scroll->theV->colorPads( val, rng[what] ) )
+        scroll->theV->updateNow();
+}
+
+
+void FVShankMap::whatChanged( int i )
+{
+    what = i;
+
+    SignalBlocker   b0(rngSB);
+    rngSB->setValue( rng[what] );
+
+    saveSettings();
+
+    drawn = false;
+    updateMap();
+}
+
+
+void FVShankMap::rangeChanged( int r )
+{
+    rng[what] = r;
+    saveSettings();
+
+    drawn = false;
+    updateMap();
+}
+
+
+void FVShankMap::cursorOver( int ic, bool shift )
+{
+    Q_UNUSED( shift )
+
+    if( ic < 0 || ic >= (int)val.size() ) {
+        statusLbl->setText( QString::null );
+        return;
+    }
+
+    statusLbl->setText(
+        QString("%1: %2 %3")
+        .arg( fv->nameGraph( ic ) )
+        .arg( val[ic], 0, 'f', 1 )
+        .arg( what == DFActivity::Rate ? "Hz" : "uV" ) );
+}
+
+
+void FVShankMap::keyPressEvent( QKeyEvent *e )
+{
+    if( e->key() == Qt::Key_Escape ) {
+
+        close();
+        e->accept();
+    }
+    else
+        QWidget::keyPressEvent( e );
+}
+
+
+void FVShankMap::loadSettings()
+{
+    STDSETTINGS( settings, "fileviewer" );
+    settings.beginGroup( "FileViewer_ShankMap" );
+
+    what    = qBound( 0, settings.value( "what", 0 ).toInt(), 2 );
+    rng[0]  = settings.value( "rngRate", 100 ).toInt();
+    rng[1]  = settings.value( "rngPkPk", 200 ).toInt();
+    rng[2]  = settings.value( "rngRms", 50 ).toInt();
+}
+
+
+void FVShankMap::saveSettings() const
+{
+    STDSETTINGS( settings, "fileviewer" );
+    settings.beginGroup( "FileViewer_ShankMap" );
+
+    settings.setValue( "what", what );
+    settings.setValue( "rngRate", rng[0] );
+    settings.setValue( "rngPkPk", rng[1] );
+    settings.setValue( "rngRms", rng[2] );
+}
+
+
@@ -0,0 +1,65 @@
+#ifndef FVSHANKMAP_H
+#define FVSHANKMAP_H
+
+#include <QWidget>
+
+#include <vector>
+
+class FileViewerWindow;
+class ShankScroll;
+struct ShankMap;
+
+class QComboBox;
+class QLabel;
+class QSpinBox;
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Activity map of a viewer's file: spike rate, pk-pk or rms per
+// site over the whole file, or over the selection if there is
+// one, from the file's DFActivity sidecar. The viewer calls
+// updateMap() when the selection or sidecar changes, and
+// setShankMap() when the map is edited.
+//
+class FVShankMap : public QWidget
+{
+    Q_OBJECT
+
+private:
+    FileViewerWindow    *fv;
+    ShankScroll         *scroll;
+    QComboBox           *whatCB;
+    QSpinBox            *rngSB;
+    QLabel              *spanLbl,
+                        *statusLbl;
+    std::vector<double> val;
+    quint64             s0Drawn,
+                        sLimDrawn;
+    int                 what,
+                        rng[3];     // {Hz, uV, uV}
+    bool                drawn;
+
+public:
+    FVShankMap( FileViewerWindow *fv );
+
+    void setShankMap( const ShankMap *map );
+    void updateMap();
+
+private slots:
+    void whatChanged( int i );
+    void rangeChanged( int r );
+    void cursorOver( int ic, bool shift );
+
+protected:
+    virtual void keyPressEvent( QKeyEvent *e );
+
+private:
+    void loadSettings();
+    void saveSettings() const;
+};
+
+#endif  // FVSHANKMAP_H
+
+
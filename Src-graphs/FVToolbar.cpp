@@ -135,8 +135,25 @@ FVToolbar::FVToolbar( FileViewerWindow *fv, int fType ) : fv(fv)
         C->setChecked( fv->tbGet300HzOn() );
         ConnectUI( C, SIGNAL(clicked(bool)), fv, SLOT(tbHipassClicked(bool)) );
         addWidget( C );
+
+        C = new QCheckBox( "0-phase", this );
+        C->setToolTip( "Run 300 - INF forward and backward (no phase lag)" );
+        C->setChecked( fv->tbGetZeroPhase() );
+        ConnectUI( C, SIGNAL(clicked(bool)), fv, SLOT(tbZeroPhaseClicked(bool)) );
+        addWidget( C );
     }
 
+// Notch
+
+    CB = new QComboBox( this );
+    CB->setToolTip( "Notch line noise and harmonics in neural channels" );
+    CB->addItem( "No Notch" );
+    CB->addItem( "50 Hz" );
+    CB->addItem( "60 Hz" );
+    CB->setCurrentIndex( fv->tbGetNotchSel() );
+    ConnectUI( CB, SIGNAL(currentIndexChanged(int)), fv, SLOT(tbNotchSelChanged(int)) );
+    addWidget( CB );
+
 // -<T> (DC filter)
 
     C = new QCheckBox( "-<T>", this );
@@ -162,6 +179,7 @@ FVToolbar::FVToolbar( FileViewerWindow *fv, int fType ) : fv(fv)
         CB->addItem( "Loc 2,8" );
         CB->addItem( "Glb All" );
         CB->addItem( "Glb Dmx" );
+        CB->addItem( "Glb Med" );
         CB->setCurrentIndex( fv->tbGetSAveSel() );
         ConnectUI( CB, SIGNAL(currentIndexChanged(int)), fv, SLOT(tbSAveSelChanged(int)) );
         addWidget( CB );
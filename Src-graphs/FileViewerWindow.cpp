@@ -13,14 +13,25 @@
 #include "FileViewerWindow.h"
 #include "FVToolbar.h"
 #include "FVScanGrp.h"
+#include "FVShankMap.h"
 #include "DataFileIMAP.h"
 #include "DataFileIMLF.h"
 #include "DataFileNI.h"
 #include "DFName.h"
+#include "DFActivity.h"
+#include "DFEvents.h"
+#include "DFOverview.h"
+#include "DFReadCache.h"
+#include "DFSequence.h"
+#include "DFTranspose.h"
 #include "MGraph.h"
+#include "GraphStats.h"
 #include "Biquad.h"
+#include "SpatialRef.h"
 #include "ExportCtl.h"
+#include "ExportJob.h"
 #include "ClickableLabel.h"
+#include "SignalBlocker.h"
 #include "Subset.h"
 #include "Version.h"
 
@@ -39,8 +50,35 @@
 #include <QCursor>
 #include <QSettings>
 #include <QMessageBox>
+#include <QThread>
 
 #include <math.h>
+#include <string.h>
+
+
+// Hipass state is checkpointed every FLTCKPT_SCANS file scans
+// while drawing, up to FLTCKPT_MAX snapshots per file.
+#define FLTCKPT_SCANS   256
+#define FLTCKPT_MAX     2048
+
+// Line notches ring far longer than the hipass, so with notches
+// on, drawing starts this far ahead of the view to settle them.
+#define NOTCH_LEADSECS  0.5
+
+// Draw jobs split shown channels into groups of at least
+// this many across the filter pool.
+#define FVW_FILLGRPCHANS    32
+
+// -<T> keeps the span it reads for the drawing pass, up to this.
+#define DCAVE_KEEPBYTES     (256LL*1024*1024)
+
+// Event jumps place the edge this far into the view; markers
+// closer than 1/FVEVT_MINDIVS of the view merge.
+#define FVEVT_LEADFRAC      0.1
+#define FVEVT_MINDIVS       1000
+
+// Draw job pool: half the cores, in [2, FVJOB_MAXTHREADS].
+#define FVJOB_MAXTHREADS    8
 
 /* ---------------------------------------------------------------- */
 /* class TaggableLabel -------------------------------------------- */
@@ -70,16 +108,28 @@ void FileViewerWindow::DCAve::init( int nChannels, int nNeural )
 }
 
 
+// If the span [xpos, xpos+nRem) fits DCAVE_KEEPBYTES, it's
+// left in keep, so the drawing pass needn't read it again;
+// else keep is empty.
+//
 void FileViewerWindow::DCAve::updateLvl(
-    const DataFile  *df,
+    vec_i16         &keep,
+    DFReadCache     *rc,
     qint64          xpos,
     qint64          nRem,
     qint64          chunk,
     int             dwnSmp )
 {
+    keep.clear();
+
     if( nN <= 0 )
         return;
 
+    bool    keepOK = nRem * nC * qint64(sizeof(qint16)) <= DCAVE_KEEPBYTES;
+
+    if( keepOK )
+        keep.reserve( nRem * nC );
+
     std::vector<float>  sum( nN, 0.0F );
 
     int     *L      = &lvl[0];
@@ -98,11 +148,14 @@ void FileViewerWindow::DCAve::updateLvl(
         qint64  nthis = qMin( chunk, nRem );
         int     ntpts;
 
-        ntpts = df->readScans( data, xpos, nthis, QBitArray() );
+        ntpts = rc->readScans( data, xpos, nthis, QBitArray() );
 
         if( ntpts <= 0 )
             break;
 
+        if( keepOK )
+            keep.insert( keep.end(), data.begin(), data.end() );
+
         // update counting
 
         xpos    += ntpts;
@@ -164,9 +217,12 @@ static bool     _linkManUpdt, _linkCanDraw = true;
 
 FileViewerWindow::FileViewerWindow()
     :   QMainWindow(0), tMouseOver(-1.0), yMouseOver(-1.0),
-        df(0), shankMap(0), chanMap(0), hipass(0),
+        df(0), ovw(0), rdCache(0), seq(0), tps(0), evt(0),
+        act(0), actMap(0),
+        shankMap(0), chanMap(0), hipass(0), notch(0), joinAct(0),
         igSelected(-1), igMaximized(-1), igMouseOver(-1),
-        didLayout(false), selDrag(false), zoomDrag(false)
+        didLayout(false), selDrag(false), zoomDrag(false), evtShow(true),
+        jobGen(0), jobPend(false), jobBusy(false), jobAbort(false)
 {
     initDataIndepStuff();
 
@@ -177,6 +233,29 @@ FileViewerWindow::FileViewerWindow()
 
 FileViewerWindow::~FileViewerWindow()
 {
+    jobCancel();
+
+    if( actMap )
+        delete actMap;
+
+    if( act )
+        delete act;
+
+    if( evt )
+        delete evt;
+
+    if( tps )
+        delete tps;
+
+    if( ovw )
+        delete ovw;
+
+    if( rdCache )
+        delete rdCache;
+
+    if( seq )
+        delete seq;
+
     if( df )
         delete df;
 
@@ -188,11 +267,16 @@ FileViewerWindow::~FileViewerWindow()
 
     if( hipass )
         delete hipass;
+
+    if( notch )
+        delete notch;
 }
 
 
 bool FileViewerWindow::viewFile( const QString &fname, QString *errMsg )
 {
+    jobCancel();
+
     if( igMaximized != -1 )
         toggleMaximized();
 
@@ -220,6 +304,7 @@ bool FileViewerWindow::viewFile( const QString &fname, QString *errMsg )
     scanGrp->setRanges( true );
     scanGrp->enableManualUpdate( sav.all.manualUpdate );
     initHipass();
+    initNotch();
 
 // --------------------------
 // Manage previous array data
@@ -296,7 +381,7 @@ QString FileViewerWindow::file() const
 
 double FileViewerWindow::tbGetfileSecs() const
 {
-    return (df ? df->fileTimeSecs() : 0);
+    return (df ? dfCount / df->samplingRateHz() : 0);
 }
 
 
@@ -313,6 +398,48 @@ void FileViewerWindow::getInverseGains(
     }
 }
 
+
+// Spike channels come first in file order, so they are
+// also the leading block of any exported subset.
+//
+// Return count of exported spike channels.
+//
+int FileViewerWindow::getSpikeChanCount( const QBitArray &exportBits ) const
+{
+    int n = 0;
+
+    for( int i = 0, nC = qMin( exportBits.size(), nSpikeChans ); i < nC; ++i )
+        n += exportBits.testBit( i );
+
+    return n;
+}
+
+
+// Current filters and -<S> for processed export (not -<T>,
+// which depends on the span drawn). Caller chooses zero-phase
+// or forward highpass, and decimation.
+//
+void FileViewerWindow::getExportChain( ExportChain &C ) const
+{
+    int sel = tbGetSAveSel();
+
+    C.nSpk      = nSpikeChans;
+    C.nNeu      = nNeurChans;
+    C.hp300     = tbGet300HzOn();
+    C.notchHz   = (!tbGetNotchSel() ? 0 : (tbGetNotchSel() == 1 ? 50 : 60));
+
+    C.gRef.clear();
+    C.lRef.clear();
+
+    if( sel == 1 || sel == 2 )
+        C.lRef = TSM;
+    else if( sel >= 3 ) {
+        sAveGlobalRef(
+            C.gRef, sel, nSpikeChans,
+            (fType < 2 ? 24 : df->getParam("niMuxFactor").toInt()) );
+    }
+}
+
 /* ---------------------------------------------------------------- */
 /* Toolbar -------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -427,6 +554,28 @@ void FileViewerWindow::tbHipassClicked( bool b )
 }
 
 
+void FileViewerWindow::tbZeroPhaseClicked( bool b )
+{
+    sav.all.zeroPhase = b;
+    saveSettings();
+
+    if( tbGet300HzOn() )
+        updateGraphs();
+}
+
+
+// Selections: {0=Off, 1=50 Hz, 2=60 Hz}.
+//
+void FileViewerWindow::tbNotchSelChanged( int sel )
+{
+    sav.all.notchSel = sel;
+    saveSettings();
+
+    initNotch();
+    updateGraphs();
+}
+
+
 void FileViewerWindow::tbDcClicked( bool b )
 {
     if( fType == 0 )
@@ -684,6 +833,11 @@ justR1:
 
 void FileViewerWindow::file_Link()
 {
+    if( seq ) {
+        statusBar()->showMessage( "Can't link joined trigger files.", 3000 );
+        return;
+    }
+
     FVLinkRec   L;
 
     if( !linkShowDialog( L ) )
@@ -782,6 +936,11 @@ void FileViewerWindow::file_Unlink()
 
 void FileViewerWindow::file_Export()
 {
+    if( seq ) {
+        statusBar()->showMessage( "Export one trigger file at a time.", 3000 );
+        return;
+    }
+
 // communicate settings across sessions/windows
     STDSETTINGS( settings, "fileviewer" );
     exportCtl->loadSettings( settings );
@@ -907,6 +1066,113 @@ void FileViewerWindow::file_Options()
 }
 
 
+// Build <name>.tps in the background (once per file);
+// views of few channels then read just those.
+//
+void FileViewerWindow::file_Transpose()
+{
+    if( seq ) {
+        statusBar()->showMessage( "Channel-major cache is per file.", 3000 );
+        return;
+    }
+
+    if( df->hasTranspose() ) {
+        statusBar()->showMessage( "Channel-major cache already in use.", 3000 );
+        return;
+    }
+
+    if( tps )
+        return;
+
+    statusBar()->showMessage( "Building channel-major cache...", 3000 );
+
+    tps = new DFTranspose( *df );
+    Connect( tps, SIGNAL(ready()), this, SLOT(tpsReady()) );
+}
+
+
+// Show this stream's other trigger files (_t<N>) of the gate
+// with this one as one timeline, or go back to this file alone.
+//
+void FileViewerWindow::file_JoinTrig( bool on )
+{
+    if( on == (seq != 0) )
+        return;
+
+    DFSequence  *S = 0;
+
+    if( on ) {
+
+        QString error;
+
+        if( linkIsLinked( linkFindMe() ) )
+            error = "Unlink before joining trigger files.";
+        else if( !(S = new DFSequence)->build( error, *df ) ) {
+            delete S;
+            S = 0;
+        }
+
+        if( !S ) {
+
+            statusBar()->showMessage( error, 5000 );
+
+            SignalBlocker   b0(joinAct);
+            joinAct->setChecked( false );
+            return;
+        }
+    }
+
+    jobCancel();
+    killReaders();
+
+    seq = S;
+    initReaders();
+
+    dragL = dragR = -1;
+    scanGrp->setRanges( true );
+    updateXSel();
+    updateGraphs();
+
+    if( seq ) {
+        statusBar()->showMessage(
+            QString("Joined %1 trigger files.").arg( seq->nFiles() ), 3000 );
+    }
+}
+
+
+// Per-site activity over the whole file or the selection;
+// the file is indexed in the background on first use.
+//
+void FileViewerWindow::file_ActMap()
+{
+    if( seq ) {
+        statusBar()->showMessage( "Activity maps are per file.", 3000 );
+        return;
+    }
+
+    if( !shankMap || !nNeurChans ) {
+        statusBar()->showMessage( "No shank map for this file.", 3000 );
+        return;
+    }
+
+    if( !act ) {
+        act = new DFActivity( *df, nNeurChans, fType != 1 );
+        Connect( act, SIGNAL(ready()), this, SLOT(actReady()) );
+    }
+
+    if( !actMap )
+        actMap = new FVShankMap( this );
+
+    actMap->setWindowTitle(
+        QString("Activity Map: %1")
+        .arg( QFileInfo( df->binFileName() ).fileName() ) );
+
+    actMap->setShankMap( shankMap );
+    actMap->showNormal();
+    actMap->activateWindow();
+}
+
+
 void FileViewerWindow::file_Notes()
 {
     QDialog             dlg;
@@ -929,6 +1195,45 @@ void FileViewerWindow::file_Notes()
 }
 
 
+void FileViewerWindow::events_Markers( bool on )
+{
+    evtShow = on;
+    updateEvents();
+    mscroll->theM->update();
+}
+
+
+// Jumps put the edge FVEVT_LEADFRAC into the view,
+// so the next jump starts from there.
+//
+void FileViewerWindow::events_Next()
+{
+    if( !evt || !evt->isReady() )
+        return;
+
+    qint64  span = nScansPerGraph(),
+            lead = qint64(FVEVT_LEADFRAC * span);
+    quint64 ct;
+
+    if( evt->next( ct, scanGrp->curPos() + lead ) )
+        scanGrp->guiSetPos( qMax( 0LL, qint64(ct) - lead ) );
+}
+
+
+void FileViewerWindow::events_Prev()
+{
+    if( !evt || !evt->isReady() )
+        return;
+
+    qint64  span = nScansPerGraph(),
+            lead = qint64(FVEVT_LEADFRAC * span);
+    quint64 ct;
+
+    if( evt->prev( ct, scanGrp->curPos() + lead ) )
+        scanGrp->guiSetPos( qMax( 0LL, qint64(ct) - lead ) );
+}
+
+
 void FileViewerWindow::channels_ShowAll()
 {
     hideCloseLabel();
@@ -1107,8 +1412,12 @@ void FileViewerWindow::shankmap_Tog()
 {
     if( shankMap && shankMap->e.size() > igMouseOver ) {
 
+        jobCancel();
         shankMap->e[igMouseOver].u = !shankMap->e[igMouseOver].u;
         updateGraphs();
+
+        if( actMap )
+            actMap->setShankMap( shankMap );
     }
 }
 
@@ -1164,6 +1473,8 @@ void FileViewerWindow::shankmap_Edit()
 
         int nC = chans.size();
 
+        jobCancel();
+
         for( int ic = 0; ic < nC; ++ic ) {
 
             // IMPORTANT:
@@ -1178,6 +1489,9 @@ void FileViewerWindow::shankmap_Edit()
         }
 
         updateGraphs();
+
+        if( actMap )
+            actMap->setShankMap( shankMap );
     }
 }
 
@@ -1186,9 +1500,13 @@ void FileViewerWindow::shankmap_Restore()
 {
     if( shankMap ) {
 
+        jobCancel();
         delete shankMap;
         shankMap = df->shankMap();
         updateGraphs();
+
+        if( actMap )
+            actMap->setShankMap( shankMap );
     }
 }
 
@@ -1530,6 +1848,41 @@ void FileViewerWindow::linkRecvDraw()
     guiBreathe();
 }
 
+
+void FileViewerWindow::ovwReady()
+{
+    if( !sav.all.manualUpdate )
+        updateGraphs();
+}
+
+
+void FileViewerWindow::evtReady()
+{
+    updateEvents();
+    mscroll->theM->update();
+}
+
+
+void FileViewerWindow::actReady()
+{
+    if( actMap && actMap->isVisible() )
+        actMap->updateMap();
+}
+
+
+void FileViewerWindow::tpsReady()
+{
+    tps->deleteLater();
+    tps = 0;
+
+    jobCancel();
+    df->openTranspose();
+    rdCache->openTranspose();
+
+    if( !sav.all.manualUpdate )
+        updateGraphs();
+}
+
 /* ---------------------------------------------------------------- */
 /* Protected ------------------------------------------------------ */
 /* ---------------------------------------------------------------- */
@@ -1616,6 +1969,10 @@ void FileViewerWindow::initMenus()
     m->addAction( "Zoom &In...", this, SLOT(file_ZoomIn()), QKeySequence( tr("Ctrl++") ) );
     m->addAction( "Zoom &Out...", this, SLOT(file_ZoomOut()), QKeySequence( tr("Ctrl+-") ) );
     m->addAction( "&Time Scrolling...", this, SLOT(file_Options()) );
+    m->addAction( "Build Channel-&Major Cache", this, SLOT(file_Transpose()) );
+    joinAct = m->addAction( "&Join Trigger Files", this, SLOT(file_JoinTrig(bool)) );
+    joinAct->setCheckable( true );
+    m->addAction( "Shank &Activity Map...", this, SLOT(file_ActMap()) );
     m->addSeparator();
     m->addAction( "&View Notes", this, SLOT(file_Notes()) );
 
@@ -1626,6 +1983,13 @@ void FileViewerWindow::initMenus()
     m->addSeparator();
     channelsMenu = m;
 
+    m = mb->addMenu( "&Events" );
+    QAction *A = m->addAction( "Show &Markers", this, SLOT(events_Markers(bool)) );
+    A->setCheckable( true );
+    A->setChecked( evtShow );
+    m->addAction( "&Next Edge", this, SLOT(events_Next()), QKeySequence( tr("Ctrl+Right") ) );
+    m->addAction( "&Previous Edge", this, SLOT(events_Prev()), QKeySequence( tr("Ctrl+Left") ) );
+
     m = mb->addMenu( "&Help" );
     m->addAction( "File Viewer &Help", this, SLOT(help_ShowHelp()), QKeySequence( tr("Ctrl+H") ) );
 }
@@ -1755,6 +2119,18 @@ bool FileViewerWindow::openFile( const QString &fname, QString *errMsg )
 // Create new file of correct type/IP
 // ----------------------------------
 
+    killReaders();
+
+    if( seq ) {
+        delete seq;
+        seq = 0;
+    }
+
+    if( joinAct ) {
+        SignalBlocker   b0(joinAct);
+        joinAct->setChecked( false );
+    }
+
     if( df )
         delete df;
 
@@ -1810,32 +2186,129 @@ bool FileViewerWindow::openFile( const QString &fname, QString *errMsg )
         return false;
     }
 
+    initReaders();
+
+    mainApp()->modelessOpened( this );
+    linkAddMe( fname );
+
+    return true;
+}
+
+
+// Delete readers and sidecars of the current view.
+//
+void FileViewerWindow::killReaders()
+{
+    if( actMap )
+        actMap->hide();
+
+    if( act ) {
+        delete act;
+        act = 0;
+    }
+
+    if( evt ) {
+        delete evt;
+        evt = 0;
+    }
+
+    if( tps ) {
+        delete tps;
+        tps = 0;
+    }
+
+    if( ovw ) {
+        delete ovw;
+        ovw = 0;
+    }
+
+    if( rdCache ) {
+        delete rdCache;
+        rdCache = 0;
+    }
+}
+
+
+// Create readers and sidecars for df, or for seq if joined;
+// the overview and edge index are per file, so joined views
+// go without them.
+//
+void FileViewerWindow::initReaders()
+{
+    QString name    = QFileInfo( df->binFileName() ).fileName();
     double  srate   = df->samplingRateHz(),
-            t0      = df->firstCt() / srate,
-            dt      = dfCount / srate;
+            t0      = (seq ? seq->file( 0 ).firstCt : df->firstCt()) / srate;
+
+    dfCount = (seq ? seq->vScans() : df->scanCount());
+
+    if( seq )
+        name += QString(" +%1 trigger files").arg( seq->nFiles() - 1 );
 
     setWindowTitle(
         QString(APPNAME " File Viewer: %1 [%2 chans @ %3 Hz] (t0, dt)=(%4, %5)")
-        .arg( fname_no_path )
+        .arg( name )
         .arg( df->numChans() )
         .arg( srate )
         .arg( t0, 0, 'f', 3 )
-        .arg( dt, 0, 'f', 3 ) );
+        .arg( dfCount / srate, 0, 'f', 3 ) );
 
-    mainApp()->modelessOpened( this );
-    linkAddMe( fname );
+// Reads go through a prefetching block cache
 
-    return true;
+    rdCache     = new DFReadCache( df, seq );
+    rdLastPos   = 0;
+
+    if( seq )
+        return;
+
+// Zoomed-out views draw from overview once available
+
+    ovw = new DFOverview( *df );
+    Connect( ovw, SIGNAL(ready()), this, SLOT(ovwReady()) );
+
+// Digital edges marked and navigable once indexed
+
+    QVector<DFEvtLine>  lines;
+    evtLines( lines );
+
+    evt = new DFEvents( *df, lines );
+    Connect( evt, SIGNAL(ready()), this, SLOT(evtReady()) );
 }
 
 
 void FileViewerWindow::initHipass()
 {
+    jobCancel();
+
     if( hipass )
         delete hipass;
 
     hipass =
     new Biquad( bq_type_highpass, 300.0 / df->samplingRateHz() );
+
+    fltCkpt.clear();
+}
+
+
+// Notch line frequency and its first BIQUAD_NOTCH_NHARM
+// harmonics, in any file type.
+//
+void FileViewerWindow::initNotch()
+{
+    jobCancel();
+
+    if( notch ) {
+        delete notch;
+        notch = 0;
+    }
+
+    int sel = tbGetNotchSel();
+
+    if( sel ) {
+        notch = new BiquadCascade;
+        notch->addBand(
+            BiquadBand( 0, 0, (sel == 1 ? 50 : 60), BIQUAD_NOTCH_NHARM ),
+            df->samplingRateHz() );
+    }
 }
 
 
@@ -1983,6 +2456,8 @@ void FileViewerWindow::loadSettings()
     sav.all.nDivs       = settings.value( "nDivs", 4 ).toInt();
     sav.all.sortUserOrder   = settings.value( "sortUserOrder", false ).toBool();
     sav.all.manualUpdate    = settings.value( "manualUpdate", false ).toBool();
+    sav.all.zeroPhase       = settings.value( "zeroPhase", false ).toBool();
+    sav.all.notchSel        = settings.value( "notchSel", 0 ).toInt();
     settings.endGroup();
 
     if( fabs( sav.all.fArrowKey ) < 0.0001 )
@@ -2042,6 +2517,8 @@ void FileViewerWindow::saveSettings() const
     settings.setValue( "nDivs", qMax( sav.all.nDivs, 1 ) );
     settings.setValue( "sortUserOrder", sav.all.sortUserOrder );
     settings.setValue( "manualUpdate", sav.all.manualUpdate );
+    settings.setValue( "zeroPhase", sav.all.zeroPhase );
+    settings.setValue( "notchSel", sav.all.notchSel );
     settings.endGroup();
 
 // ---------
@@ -2286,95 +2763,26 @@ void FileViewerWindow::toggleMaximized()
 // - Annulus with {inner, outer} radii {self, 2} or {2, 8}.
 // - The list is sorted for cache friendliness.
 //
-// Sel: {0=Off; 1=Loc 1,2; 2=Loc 2,8; 3=Glb All, 4=Glb Dmx}.
+// Sel: {0=Off; 1=Loc 1,2; 2=Loc 2,8; 3=Glb All, 4=Glb Dmx,
+// 5=Glb Med}.
 //
 void FileViewerWindow::sAveTable( int sel )
 {
+    jobCancel();
+
     TSM.clear();
 
     if( !(sel == 1 || sel == 2) || nSpikeChans <= 0 )
         return;
 
-    TSM.resize( nSpikeChans );
-
-    QMap<ShankMapDesc,uint> ISM;
-    shankMap->inverseMap( ISM );
-
-    int rIn, rOut;
-
-    if( sel == 1 ) {
-        rIn     = 0;
-        rOut    = 2;
-    }
-    else if( sel == 2 ) {
-        rIn     = 2;
-        rOut    = 8;
-    }
-
-    for( int ig = 0; ig < nSpikeChans; ++ig ) {
-
-        const ShankMapDesc  &E = shankMap->e[ig];
-
-        if( !E.u )
-            continue;
-
-        // ----------------------------------
-        // Form map of excluded inner indices
-        // ----------------------------------
-
-        QMap<int,int>   inner;  // keys sorted, value is arbitrary
-
-        int xL  = qMax( int(E.c)  - rIn, 0 ),
-            xH  = qMin( uint(E.c) + rIn + 1, shankMap->nc ),
-            yL  = qMax( int(E.r)  - rIn, 0 ),
-            yH  = qMin( uint(E.r) + rIn + 1, shankMap->nr );
-
-        for( int ix = xL; ix < xH; ++ix ) {
-
-            for( int iy = yL; iy < yH; ++iy ) {
-
-                QMap<ShankMapDesc,uint>::iterator   it;
-
-                it = ISM.find( ShankMapDesc( E.s, ix, iy, 1 ) );
-
-                if( it != ISM.end() )
-                    inner[it.value()] = 1;
-            }
-        }
-
-        // -------------------------
-        // Fill with annulus members
-        // -------------------------
-
-        std::vector<int>    &V = TSM[ig];
-
-        xL  = qMax( int(E.c)  - rOut, 0 );
-        xH  = qMin( uint(E.c) + rOut + 1, shankMap->nc );
-        yL  = qMax( int(E.r)  - rOut, 0 );
-        yH  = qMin( uint(E.r) + rOut + 1, shankMap->nr );
-
-        for( int ix = xL; ix < xH; ++ix ) {
-
-            for( int iy = yL; iy < yH; ++iy ) {
+    ShankMapIndex   X( *shankMap );
 
-                QMap<ShankMapDesc,uint>::iterator   it;
-
-                it = ISM.find( ShankMapDesc( E.s, ix, iy, 1 ) );
-
-                if( it != ISM.end() ) {
-
-                    int i = it.value();
-
-                    // Exclude inners
-
-                    if( inner.find( i ) == inner.end() )
-                        V.push_back( i );
-                }
-            }
-        }
+    if( sel == 1 )
+        X.annuli( *shankMap, nSpikeChans, 0, 2 );
+    else
+        X.annuli( *shankMap, nSpikeChans, 2, 8 );
 
-        qSort( V );
-    }
+    X.toVecs( TSM );
 }
 
 
@@ -2402,242 +2810,339 @@ int FileViewerWindow::sAveApplyLocal( const qint16 *d_ig, int ig )
 }
 
 
-// Space averaging for all values.
+// Global space averaging reference over the nAP spike channels.
+// Sel: {3=All, 4=Dmx (NI: mux stride, else mux table rows),
+// 5=Median}.
 //
-void FileViewerWindow::sAveApplyGlobal(
-    qint16  *d,
-    int     ntpts,
-    int     nC,
-    int     nAP,
-    int     dwnSmp )
+void FileViewerWindow::sAveGlobalRef(
+    SpatialRef  &sr,
+    int         sel,
+    int         nAP,
+    int         stride ) const
 {
+    sr.clear();
+
     if( nAP <= 0 )
         return;
 
-    const ShankMapDesc  *E = &shankMap->e[0];
+    if( sel != 4 ) {
+        sr.buildAll( *shankMap, nAP, sel == 5 );
+        return;
+    }
 
-    int                 ns      = shankMap->ns,
-                        dStep   = nC * dwnSmp;
-    std::vector<int>    _A( ns ),
-                        _N( ns );
-    std::vector<float>  _S( ns );
-    int                 *A  = &_A[0],
-                        *N  = &_N[0];
-    float               *S  = &_S[0];
+    std::vector<std::vector<int> >  sets;
 
-    for( int it = 0; it < ntpts; it += dwnSmp, d += dStep ) {
+    if( fType == 2 ) {
 
-        for( int is = 0; is < ns; ++is ) {
-            S[is] = 0;
-            N[is] = 0;
-            A[is] = 0;
+        nAP = ig2ic[nAP-1];    // highest acquired channel saved
+
+        sets.resize( stride );
+
+        for( int ic = 0; ic <= nAP; ++ic ) {
+
+            int ig = ic2ig[ic];
+
+            if( ig >= 0 )
+                sets[ic % stride].push_back( ig );
         }
+    }
+    else {
 
-        for( int ig = 0; ig < nAP; ++ig ) {
+        const int   *T = &muxTbl[0];
 
-            const ShankMapDesc  *e = &E[ig];
+        sets.resize( nChn );
+
+        for( int irow = 0; irow < nChn; ++irow ) {
+
+            for( int icol = 0; icol < nADC; ++icol ) {
+
+                int ig = ic2ig[T[nADC*irow + icol]];
 
-            if( e->u ) {
-                S[e->s] += d[ig];
-                ++N[e->s];
+                if( ig >= 0 )
+                    sets[irow].push_back( ig );
             }
         }
+    }
+
+    sr.build( *shankMap, sets );
+}
 
-        for( int is = 0; is < ns; ++is ) {
 
-            if( N[is] )
-                A[is] = S[is] / N[is];
-        }
+void FileViewerWindow::updateXSel()
+{
+    MGraphX *theX = mscroll->theX;
+
+    if( dragL >= 0
+        && dragR > dragL
+        && dragR < dfCount ) {
 
-        for( int ig = 0; ig < nAP; ++ig )
-            d[ig] -= A[E[ig].s];
+        // transform selection from scans to range [0..1].
+
+        double  span    = nScansPerGraph();
+        qint64  pos     = scanGrp->curPos();
+        float   gselbeg = (dragL - pos) / span,
+                gselend = (dragR - pos) / span;
+
+        theX->setXSelEnabled( true );
+        theX->setXSelRange( gselbeg, gselend );
     }
+    else
+        theX->setXSelEnabled( false );
+
+    mscroll->theM->update();
+
+    if( actMap && actMap->isVisible() )
+        actMap->updateMap();
 }
 
 
-// Space averaging for all values.
+// Mark spans where each indexed line is high, in graph
+// coordinates [0..1], one of the four event colors per line.
 //
-void FileViewerWindow::sAveApplyGlobalStride(
-    qint16  *d,
-    int     ntpts,
-    int     nC,
-    int     nAP,
-    int     stride,
-    int     dwnSmp )
+void FileViewerWindow::updateEvents()
 {
-    if( nAP <= 0 )
-        return;
+    MGraphX         *theX = mscroll->theX;
+    QMutexLocker    ml( &theX->spanMtx );
 
-    nAP = ig2ic[nAP-1];    // highest acquired channel saved
+    theX->evQReset();
 
-    const ShankMapDesc  *E = &shankMap->e[0];
+    if( !evtShow || !evt || !evt->isReady() )
+        return;
 
-    int                 ns      = shankMap->ns,
-                        dStep   = nC * dwnSmp;
-    std::vector<int>    _A( ns ),
-                        _N( ns );
-    std::vector<float>  _S( ns );
-    int                 *A  = &_A[0],
-                        *N  = &_N[0];
-    float               *S  = &_S[0];
+    std::vector<quint64>    v;
+    double                  span    = nScansPerGraph();
+    qint64                  pos     = scanGrp->curPos();
+    quint64                 minGap  = qMax( 1.0, span / FVEVT_MINDIVS );
 
-    for( int it = 0; it < ntpts; it += dwnSmp, d += dStep ) {
+    for( int i = 0, n = evt->nLines(); i < n; ++i ) {
 
-        for( int ic0 = 0; ic0 < stride; ++ic0 ) {
+        evt->highSpans( v, i, pos, pos + qint64(span), minGap );
 
-            for( int is = 0; is < ns; ++is ) {
-                S[is] = 0;
-                N[is] = 0;
-                A[is] = 0;
-            }
+        for( int k = 0, nv = v.size(); k < nv; k += 2 ) {
 
-            for( int ic = ic0; ic <= nAP; ic += stride ) {
+            double  start   = (v[k] - pos) / span,
+                    end     = (v[k+1] - pos) / span;
 
-                int ig = ic2ig[ic];
+            theX->evQ[i & 3].push_back(
+                EvtSpan( start, qMax( end, start + 1.0 / FVEVT_MINDIVS ) ) );
+        }
+    }
+}
 
-                if( ig >= 0 ) {
 
-                    const ShankMapDesc  *e = &E[ig];
+// Index SY bit 6 (imec) or every bit of saved digital
+// words (NI).
+//
+void FileViewerWindow::evtLines( QVector<DFEvtLine> &lines ) const
+{
+    const QVector<uint> &ids = df->channelIDs();
 
-                    if( e->u ) {
-                        S[e->s] += d[ig];
-                        ++N[e->s];
-                    }
-                }
-            }
+    lines.clear();
 
-            for( int is = 0; is < ns; ++is ) {
+    if( fType == 2 ) {
 
-                if( N[is] )
-                    A[is] = S[is] / N[is];
-            }
+        int d0 = df->cumTypCnt()[CniCfg::niSumAnalog];
 
-            for( int ic = ic0; ic <= nAP; ic += stride ) {
+        for( int ic = 0, nC = ids.size(); ic < nC; ++ic ) {
 
-                int ig = ic2ig[ic];
+            if( int(ids[ic]) >= d0 ) {
 
-                if( ig >= 0 )
-                    d[ig] -= A[E[ig].s];
+                for( int bit = 0; bit < 16; ++bit )
+                    lines.push_back( DFEvtLine( ic, bit ) );
             }
         }
     }
+    else {
+
+        int ic = ids.indexOf( df->cumTypCnt()[CimCfg::imSumNeural] );
+
+        if( ic >= 0 )
+            lines.push_back( DFEvtLine( ic, 6 ) );
+    }
 }
 
 
-// Space averaging for all values.
-//
-void FileViewerWindow::sAveApplyDmxTbl(
-    qint16  *d,
-    int     ntpts,
-    int     nC,
-    int     nAP,
-    int     dwnSmp )
+void FileViewerWindow::zoomTime()
 {
-    if( nAP <= 0 )
+    if( dragR <= dragL )
         return;
 
-    const ShankMapDesc  *E = &shankMap->e[0];
+    dragR = qBound( 0LL, dragR, dfCount - 1 );
+    dragL = qBound( 0LL, dragL, dragR );
 
-    int                 ns      = shankMap->ns,
-                        dStep   = nC * dwnSmp;
-    std::vector<int>    _A( ns ),
-                        _N( ns );
-    std::vector<float>  _S( ns );
-    int                 *T  = &muxTbl[0],
-                        *A  = &_A[0],
-                        *N  = &_N[0];
-    float               *S  = &_S[0];
+    double  spn = qMax( 0.0001, scanGrp->timeFromPos( dragR - dragL ) );
 
-    for( int it = 0; it < ntpts; it += dwnSmp, d += dStep ) {
+    linkRecvPos( scanGrp->timeFromPos( dragL ), spn, 3 );
+    linkSendPos( 2 );
+}
 
-        for( int irow = 0; irow < nChn; ++irow ) {
+/* ---------------------------------------------------------------- */
+/* updateGraphs --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
 
-            for( int is = 0; is < ns; ++is ) {
-                S[is] = 0;
-                N[is] = 0;
-                A[is] = 0;
-            }
+#define MAX16BIT    32768
 
-            for( int icol = 0; icol < nADC; ++icol ) {
+#define V_S_AVE( d_ig )                                         \
+    (sAveLocal ? sAveApplyLocal( d_ig, ig ) : *d_ig)
 
-                int ig = ic2ig[T[nADC*irow + icol]];
 
-                if( ig >= 0 ) {
+// Hipass (ntpts) scans at (d), the block starting at file scan t0,
+// snapshotting state at each FLTCKPT_SCANS multiple reached, if
+// state is settled there (>= tOK) and not already saved.
+//
+void FileViewerWindow::hipassCkpt(
+    qint16  *d,
+    int     maxInt,
+    qint64  t0,
+    int     ntpts,
+    int     nG,
+    qint64  tOK )
+{
+    qint64  tLim = t0 + ntpts,
+            tk   = ((t0 + FLTCKPT_SCANS - 1) / FLTCKPT_SCANS) * FLTCKPT_SCANS;
 
-                    const ShankMapDesc  *e = &E[ig];
+    for( ; tk < tLim; tk += FLTCKPT_SCANS ) {
 
-                    if( e->u ) {
-                        S[e->s] += d[ig];
-                        ++N[e->s];
-                    }
-                }
-            }
+        int n = int(tk - t0);
 
-            for( int is = 0; is < ns; ++is ) {
+        if( n ) {
+            hipass->applyBlockwiseMem( d, maxInt, n, nG, 0, nSpikeChans );
+            d  += n * nG;
+            t0  = tk;
+        }
 
-                if( N[is] )
-                    A[is] = S[is] / N[is];
-            }
+        if( tk >= tOK && !fltCkpt.contains( tk ) ) {
 
-            for( int icol = 0; icol < nADC; ++icol ) {
+            // At capacity, drop snapshot farthest from here
 
-                int ig = ic2ig[T[nADC*irow + icol]];
+            if( fltCkpt.size() >= FLTCKPT_MAX ) {
 
-                if( ig >= 0 )
-                    d[ig] -= A[E[ig].s];
+                if( tk - fltCkpt.firstKey() > fltCkpt.lastKey() - tk )
+                    fltCkpt.erase( fltCkpt.begin() );
+                else
+                    fltCkpt.erase( --fltCkpt.end() );
             }
+
+            hipass->getState( fltCkpt[tk] );
         }
     }
+
+    if( tLim > t0 ) {
+        hipass->applyBlockwiseMem(
+            d, maxInt, int(tLim - t0), nG, 0, nSpikeChans );
+    }
 }
 
 
-void FileViewerWindow::updateXSel()
+// Draw gtpts bins of dwnSmp scans from the overview level whose
+// bins fit in dwnSmp. Each graph point is the (min, max) over the
+// overview bins its scans touch, so every channel is drawn as a
+// min/max envelope (digital shows the max word). -<T> levels are
+// the mean bin midpoints.
+//
+// Return false if no level fits or the read fails.
+//
+bool FileViewerWindow::updateGraphsOvw(
+    qint64              xpos,
+    qint64              ntpts,
+    int                 dwnSmp,
+    qint64              gtpts,
+    const QVector<uint> &iv2ig,
+    float               ysc )
 {
-    MGraphX *theX = mscroll->theX;
+    int lev = ovw->level( dwnSmp );
 
-    if( dragL >= 0
-        && dragR > dragL
-        && dragR < dfCount ) {
+    if( lev < 0 )
+        return false;
 
-        // transform selection from scans to range [0..1].
+    vec_i16 mm;
+    int     dec     = ovw->dec( lev ),
+            nG      = df->numChans(),
+            nVis    = iv2ig.size();
+    qint64  b0      = xpos / dec,
+            nb      = (xpos + ntpts + dec - 1) / dec - b0;
 
-        double  span    = nScansPerGraph();
-        qint64  pos     = scanGrp->curPos();
-        float   gselbeg = (dragL - pos) / span,
-                gselend = (dragR - pos) / span;
+    if( ovw->read( mm, lev, b0, nb ) != nb )
+        return false;
 
-        theX->setXSelEnabled( true );
-        theX->setXSelRange( gselbeg, gselend );
+    for( int iv = 0; iv < nVis; ++iv )
+        grfY[iv2ig[iv]].resize( gtpts );
+
+    mscroll->theX->initVerts( gtpts );
+
+// ----
+// -<T>
+// ----
+
+    std::vector<int>    lvl( nG, 0 );
+
+    if( tbGetDCChkOn() ) {
+
+        for( int ig = 0; ig < nNeurChans; ++ig ) {
+
+            const qint16    *M  = &mm[2*ig];
+            qint64          sum = 0;
+
+            for( qint64 ib = 0; ib < nb; ++ib, M += 2*nG )
+                sum += M[0] + M[1];
+
+            lvl[ig] = sum / (2*nb);
+        }
     }
-    else
-        theX->setXSelEnabled( false );
 
-    mscroll->theM->update();
-}
+// -------------------------
+// For each shown channel...
+// -------------------------
 
+    std::vector<float>  ybuf( gtpts ),
+                        ybuf2( gtpts );
 
-void FileViewerWindow::zoomTime()
-{
-    if( dragR <= dragL )
-        return;
+    for( int iv = 0; iv < nVis; ++iv ) {
 
-    dragR = qBound( 0LL, dragR, dfCount - 1 );
-    dragL = qBound( 0LL, dragL, dragR );
+        int     ig  = iv2ig[iv],
+                L   = lvl[ig];
+        MGraphY &G  = grfY[ig];
 
-    double  spn = qMax( 0.0001, scanGrp->timeFromPos( dragR - dragL ) );
+        if( G.usrType == 0 && shankMap && !shankMap->e[ig].u )
+            continue;
 
-    linkRecvPos( scanGrp->timeFromPos( dragL ), spn, 3 );
-    linkSendPos( 2 );
-}
+        for( qint64 k = 0; k < gtpts; ++k ) {
 
-/* ---------------------------------------------------------------- */
-/* updateGraphs --------------------------------------------------- */
-/* ---------------------------------------------------------------- */
+            qint64  s       = xpos + k * dwnSmp,
+                    e       = qMin( s + dwnSmp, xpos + ntpts ),
+                    ib      = s / dec - b0,
+                    ibLim   = (e + dec - 1) / dec - b0;
 
-#define MAX16BIT    32768
+            const qint16    *M      = &mm[2*(ib*nG + ig)];
+            int             vmin    = M[0],
+                            vmax    = M[1];
 
-#define V_S_AVE( d_ig )                                         \
-    (sAveLocal ? sAveApplyLocal( d_ig, ig ) : *d_ig)
+            for( ++ib, M += 2*nG; ib < ibLim; ++ib, M += 2*nG ) {
+
+                if( M[0] < vmin )
+                    vmin = M[0];
+
+                if( M[1] > vmax )
+                    vmax = M[1];
+            }
+
+            if( G.usrType == 2 )
+                ybuf[k] = vmax;
+            else {
+                ybuf[k]  = (vmax - L) * ysc;
+                ybuf2[k] = (vmin - L) * ysc;
+            }
+        }
+
+        G.drawBinMax = (G.usrType != 2);
+        G.yval.putData( &ybuf[0], gtpts );
+
+        if( G.drawBinMax )
+            G.yval2.putData( &ybuf2[0], gtpts );
+    }
+
+    return true;
+}
 
 
 // Notes:
@@ -2656,76 +3161,123 @@ void FileViewerWindow::zoomTime()
 // - Rather, we treat a long span as several short chunks. We have to
 // retain state data for filters and DC calcs across chunks.
 //
+// - Hipass state is snapshot at each FLTCKPT_SCANS multiple as we
+// draw (once settled). A redraw starting after a snapshot resumes
+// from it: the lead-in (xflt) is then only back to the snapshot,
+// and the result is identical to one continuous filter pass.
+//
+// - Zero-phase filtering can't carry state across chunks. Instead,
+// each chunk is read with up to BIQUAD_TRANS_WIDE neighbor scans
+// each side, filtered forward-backward, and trimmed back. So no
+// lead-in (xflt) is needed and chunks join seamlessly.
+//
+// - Line notches run forward only, after the hipass, in every mode.
+// Their lead-in is NOTCH_LEADSECS, and as their state isn't saved,
+// hipass snapshots aren't resumed from while they're on.
+//
+// - The GUI thread only sets up a DrawJob; reading and processing
+// run on the shared FVJobPool (drawJob), so linked windows fill
+// concurrently, and drawJobDone() hands the finished buffers to
+// the graphs. A newer request aborts the
+// running job at its next chunk. The filters, -<S> tables and
+// shank map are only changed after jobCancel().
+//
 void FileViewerWindow::updateGraphs()
 {
     if( !_linkCanDraw )
         return;
 
+    jobCancel();
+
 // -------------
 // Channel setup
 // -------------
 
-    float   ysc,
-            srate   = df->samplingRateHz();
-    // Handle 2.0 app opens 1.0 file
-    int     maxInt  = (fType < 2 ? qMax(df->getParam("imMaxInt").toInt(), 512)
-                        : MAX16BIT),
-            stride  = (fType < 2 ? 24 : df->getParam("niMuxFactor").toInt()),
-            nG      = df->numChans(),
-            nVis    = grfVisBits.count( true );
-
-    ysc = 1.0F / maxInt;
+    DrawJob &J = job;
+    float   srate   = df->samplingRateHz();
 
-    QVector<uint>   iv2ig;
+    // Handle 2.0 app opens 1.0 file
+    J.maxInt    = (fType < 2 ? df->maxInt() : MAX16BIT);
+    J.stride    = (fType < 2 ? 24 : df->getParam("niMuxFactor").toInt());
+    J.nG        = df->numChans();
+    J.ysc       = 1.0F / J.maxInt;
 
-    Subset::bits2Vec( iv2ig, grfVisBits );
+    Subset::bits2Vec( J.iv2ig, grfVisBits );
 
 // -----------
 // Scans setup
 // -----------
 
-    qint64  pos         = scanGrp->curPos(),
-            xpos, num2Read;
-    int     xflt,
-            dwnSmp,
-            binMax;
-    bool    sAveLocal   = false;
+    J.pos       = scanGrp->curPos();
+    J.ckpt      = -1;
+    J.hp300     = tbGet300HzOn();
+    J.zeroPhase = J.hp300 && sav.all.zeroPhase;
+    J.dcOn      = tbGetDCChkOn();
+    J.sAveSel   = tbGetSAveSel();
 
-    if( tbGet300HzOn() )
-        xflt = qMin( (qint64)BIQUAD_TRANS_WIDE, pos );
+    qint64  pos = J.pos;
+
+    if( J.hp300 && !J.zeroPhase ) {
+
+        qint64  ck = (pos / FLTCKPT_SCANS) * FLTCKPT_SCANS;
+
+        if( !notch && fltCkpt.contains( ck ) ) {
+            J.ckpt = ck;
+            J.xflt = pos - ck;
+        }
+        else
+            J.xflt = qMin( (qint64)BIQUAD_TRANS_WIDE, pos );
+    }
     else
-        xflt = 0;
+        J.xflt = 0;
+
+    if( notch )
+        J.xflt = qMax( (qint64)J.xflt, qMin( pos, qint64(NOTCH_LEADSECS * srate) ) );
 
-    xpos        = pos - xflt;
-    num2Read    = xflt + ceil(sav.all.xSpan * srate);
-    dwnSmp      = num2Read / (2 * mscroll->viewport()->width());
+    J.xpos      = pos - J.xflt;
+    J.fltOK     = (J.ckpt >= 0 || !J.xpos ? J.xpos : J.xpos + BIQUAD_TRANS_WIDE);
+    J.num2Read  = J.xflt + ceil(sav.all.xSpan * srate);
+    J.dwnSmp    = J.num2Read / (2 * mscroll->viewport()->width());
 
 // Note: dwnSmp oversamples by 2X.
 
-    if( dwnSmp < 1 )
-        dwnSmp = 1;
+    if( J.dwnSmp < 1 )
+        J.dwnSmp = 1;
 
-    binMax = (dwnSmp > 1 ? tbGetBinMax() : 0);
+    J.binMax = (J.dwnSmp > 1 ? tbGetBinMax() : 0);
 
 // -----------
 // Size graphs
 // -----------
 
-    if( xpos >= dfCount )
+    if( J.xpos >= dfCount )
         return;
 
-    qint64  ntpts   = qMin( num2Read, dfCount - xpos ),
-            dtpts   = (ntpts + dwnSmp - 1) / dwnSmp,
-            gtpts   = (ntpts - xflt + dwnSmp - 1) / dwnSmp,
-            xoff    = dtpts - gtpts;
+    J.ntpts = qMin( J.num2Read, dfCount - J.xpos );
 
-    if( gtpts <= 0 )
+    qint64  dtpts = (J.ntpts + J.dwnSmp - 1) / J.dwnSmp;
+
+    J.gtpts = (J.ntpts - J.xflt + J.dwnSmp - 1) / J.dwnSmp;
+    J.xoff  = dtpts - J.gtpts;
+
+    if( J.gtpts <= 0 )
         return;
 
-    for( int iv = 0; iv < nVis; ++iv )
-        grfY[iv2ig[iv]].resize( gtpts );
+// --------
+// Overview
+// --------
 
-    mscroll->theX->initVerts( gtpts );
+// Zoomed-out views without filters or -<S> draw from the
+// overview pyramid, when it's ready.
+
+    if( ovw && !J.xflt && !J.hp300 && !notch && !J.sAveSel
+        && updateGraphsOvw(
+            J.xpos, J.ntpts, J.dwnSmp, J.gtpts, J.iv2ig, J.ysc ) ) {
+
+        updateEvents();
+        updateXSel();
+        return;
+    }
 
 // -----------------
 // Pick a chunk size
@@ -2735,9 +3287,46 @@ void FileViewerWindow::updateGraphs()
 // Smaller chunks reduce memory thrashing, but at the penalty
 // of more indexing.
 
-    qint64  chunk =
-            qMax( 1, int((tbGet300HzOn() ? 0.05 : 0.02)*srate/dwnSmp) )
-            * dwnSmp;
+    J.chunk =
+        qMax( 1, int((J.hp300 ? 0.05 : 0.02)*srate/J.dwnSmp) ) * J.dwnSmp;
+
+// ----
+// Post
+// ----
+
+    jobPost();
+}
+
+
+// Job thread: process posted job into its y buffers.
+//
+// Return false if aborted or nothing drawn.
+//
+bool FileViewerWindow::drawJob()
+{
+    DrawJob &J          = job;
+    qint64  xpos        = J.xpos,
+            ntpts       = J.ntpts,
+            chunk       = J.chunk,
+            xoff        = J.xoff,
+            dtpts;
+    int     nG          = J.nG,
+            nVis        = J.iv2ig.size(),
+            dwnSmp      = J.dwnSmp,
+            binMax      = J.binMax,
+            maxInt      = J.maxInt;
+    bool    sAveLocal   = (J.sAveSel == 1 || J.sAveSel == 2),
+            zeroPhase   = J.zeroPhase;
+
+    J.y.resize( nVis );
+    J.y2.resize( nVis );
+    J.mode.assign( nVis, 0 );
+    J.ny = 0;
+
+    for( int iv = 0; iv < nVis; ++iv ) {
+        J.y[iv].resize( J.gtpts );
+        J.y2[iv].resize( binMax ? J.gtpts : 0 );
+    }
 
 // ------------
 // Filter setup
@@ -2745,12 +3334,21 @@ void FileViewerWindow::updateGraphs()
 
     hipass->clearMem();
 
+    if( J.ckpt >= 0 )
+        hipass->setState( fltCkpt[J.ckpt] );
+
+    if( notch )
+        notch->clearMem();
+
     // -<T>; not applied if hipass filtered
 
-    if( tbGetDCChkOn() && !tbGet300HzOn() ) {
+    vec_i16 dcKeep;
+    qint64  dcKeep0 = xpos;
+
+    if( J.dcOn && !J.hp300 ) {
 
         dc.init( nG, nNeurChans );
-        dc.updateLvl( df, xpos, ntpts, chunk, dwnSmp );
+        dc.updateLvl( dcKeep, rdCache, xpos, ntpts, chunk, dwnSmp );
     }
 
 // --------------
@@ -2764,6 +3362,9 @@ void FileViewerWindow::updateGraphs()
         if( nRem <= 0 )
             break;
 
+        if( jobAbort )
+            return false;
+
         // ---------------
         // Read this block
         // ---------------
@@ -2774,7 +3375,42 @@ void FileViewerWindow::updateGraphs()
         vec_i16 data;
         qint64  nthis = qMin( chunk, nRem );
 
-        ntpts = df->readScans( data, xpos, nthis, QBitArray() );
+        if( zeroPhase ) {
+
+            qint64  padL = qMin( (qint64)BIQUAD_TRANS_WIDE, xpos ),
+                    padR = qBound( 0LL,
+                            dfCount - xpos - nthis,
+                            (qint64)BIQUAD_TRANS_WIDE );
+
+            ntpts = rdCache->readScans(
+                        data, xpos - padL, padL + nthis + padR,
+                        QBitArray() );
+
+            if( ntpts <= padL )
+                break;
+
+            hipass->applyZeroPhase(
+                &data[0], maxInt, ntpts, nG, 0, nSpikeChans,
+                getNProcessors() );
+
+            data.erase( data.begin(), data.begin() + padL * nG );
+            ntpts = qMin( ntpts - padL, nthis );
+            data.resize( ntpts * nG );
+        }
+        else if( qint64(dcKeep.size()) > (xpos - dcKeep0) * nG ) {
+
+            // Span already read by -<T>
+
+            qint64  off = (xpos - dcKeep0) * nG;
+
+            ntpts = qMin( nthis, (qint64(dcKeep.size()) - off) / nG );
+
+            data.assign(
+                dcKeep.begin() + off,
+                dcKeep.begin() + off + ntpts * nG );
+        }
+        else
+            ntpts = rdCache->readScans( data, xpos, nthis, QBitArray() );
 
         if( ntpts <= 0 )
             break;
@@ -2797,178 +3433,469 @@ void FileViewerWindow::updateGraphs()
         // Bandpass
         // --------
 
-        if( tbGet300HzOn() ) {
-            hipass->applyBlockwiseMem(
-                    &data[0], maxInt, ntpts, nG, 0, nSpikeChans );
+        if( J.hp300 && !zeroPhase ) {
+            hipassCkpt(
+                &data[0], maxInt, xpos - ntpts, ntpts, nG, J.fltOK );
+        }
+
+        if( notch ) {
+            notch->applyBlockwiseMem(
+                &data[0], maxInt, ntpts, nG, 0, nNeurChans );
         }
 
         // ------------------------------------
         // -<T>; not applied if hipass filtered
         // ------------------------------------
 
-        if( tbGetDCChkOn() && !tbGet300HzOn() )
+        if( J.dcOn && !J.hp300 )
             dc.apply( &data[0], ntpts, (binMax ? binMax : dwnSmp) );
 
         // ----
         // -<S>
         // ----
 
-        switch( tbGetSAveSel() ) {
+        if( J.sAveSel >= 3 ) {
 
-            case 1:
-            case 2:
-                sAveLocal = true;
-                break;
-            case 3:
-                sAveApplyGlobal(
-                    &data[0], ntpts, nG, nSpikeChans,
-                    (binMax ? binMax : dwnSmp) );
-                break;
-            case 4:
-                if( fType == 2 ) {
-                    sAveApplyGlobalStride(
-                        &data[0], ntpts, nG, nSpikeChans,
-                        stride, (binMax ? binMax : dwnSmp) );
-                }
-                else {
-                    sAveApplyDmxTbl(
-                        &data[0], ntpts, nG, nSpikeChans,
-                        (binMax ? binMax : dwnSmp) );
-                }
-                break;
-            default:
-                ;
+            SpatialRef  sr;
+
+            sAveGlobalRef( sr, J.sAveSel, nSpikeChans, J.stride );
+            sr.apply( &data[0], ntpts, nG, (binMax ? binMax : dwnSmp) );
         }
 
-        // -------------
-        // Result buffer
-        // -------------
+        // -------------------------------------------
+        // Shown channels, in groups across the pool
+        // -------------------------------------------
 
-        std::vector<float>  ybuf( dtpts ),
-                            ybuf2( binMax ? dtpts : 0 );
+        DrawFill    F;
+        int         nThd;
 
-        // -------------------------
-        // For each shown channel...
-        // -------------------------
+        F.fvw       = this;
+        F.data      = &data[0];
+        F.ntpts     = ntpts;
+        F.dtpts     = dtpts;
+        F.xoff      = xoff;
+        F.sAveLocal = sAveLocal;
 
-        for( int iv = 0; iv < nVis; ++iv ) {
+        nThd = qBound(
+                1, nVis / FVW_FILLGRPCHANS,
+                BiquadPool::pool().nWorkers() + 1 );
 
-            int     ig      = iv2ig[iv],
-                    dstep   = dwnSmp * nG,
-                    ny      = 0;
-            qint16  *d      = &data[ig];
+        if( nThd > 1 ) {
 
-            if( grfY[ig].usrType == 0 ) {
+            std::vector<BiquadJob>  jobs( nThd );
+            int                     remain = nThd;
 
-                // ---------------
-                // Neural channels
-                // ---------------
+            for( int i = 0; i < nThd; ++i ) {
 
-                // ---------------
-                // Skip references
-                // ---------------
+                BiquadJob   &B = jobs[i];
 
-                if( shankMap && !shankMap->e[ig].u )
-                    continue;
+                B.fn        = drawFillJob;
+                B.ctx       = &F;
+                B.i0        = i * nVis / nThd;
+                B.iLim      = (i + 1) * nVis / nThd;
+                B.remain    = &remain;
+            }
 
-                // -------------------
-                // Neural downsampling
-                // -------------------
+            BiquadPool::pool().runBatch( jobs );
+        }
+        else
+            drawFill( F, 0, nVis );
 
-                // Within each bin, report both max and min
-                // values. This ensures spikes aren't missed.
-                // Max in ybuf, min in ybuf2.
+        J.ny += dtpts - xoff;
+        xoff  = 0;  // only first chunk includes offset
+    }   // end chunks
 
-                if( binMax ) {
+    return !jobAbort && J.ny > 0;
+}
 
-                    int ndRem = ntpts;
 
-                    grfY[ig].drawBinMax = true;
+void FileViewerWindow::drawFillJob( const BiquadJob &B )
+{
+    const DrawFill  *F = (const DrawFill*)B.ctx;
 
-                    for(
-                        int it = 0;
-                        it < ntpts;
-                        it += dwnSmp, d = &data[ig + it*nG] ) {
+    F->fvw->drawFill( *F, B.i0, B.iLim );
+}
 
-                        int val     = V_S_AVE( d ),
-                            vmax    = val,
-                            vmin    = val,
-                            binWid  = dwnSmp;
 
-                        d += binMax*nG;
+// Downsample shown channels [iv0,ivLim) of chunk F.data into
+// job y buffers at current job offset ny.
+//
+void FileViewerWindow::drawFill( const DrawFill &F, int iv0, int ivLim )
+{
+    DrawJob &J          = job;
+    int     nG          = J.nG,
+            dwnSmp      = J.dwnSmp,
+            binMax      = J.binMax,
+            ntpts       = F.ntpts,
+            dtpts       = F.dtpts,
+            xoff        = F.xoff;
+    float   ysc         = J.ysc;
+    bool    sAveLocal   = F.sAveLocal;
 
-                        if( ndRem < binWid )
-                            binWid = ndRem;
+    // -------------
+    // Result buffer
+    // -------------
 
-                        for(
-                            int ib = binMax;
-                            ib < binWid;
-                            ib += binMax, d += binMax*nG ) {
+    std::vector<float>  ybuf( dtpts ),
+                        ybuf2( binMax ? dtpts : 0 ),
+                        yRun, yRun2;
 
-                            val = V_S_AVE( d );
+    // -------------------------
+    // For each shown channel...
+    // -------------------------
 
-                            if( val > vmax )
-                                vmax = val;
-                            else if( val < vmin )
-                                vmin = val;
-                        }
+    for( int iv = iv0; iv < ivLim; ++iv ) {
 
-                        ndRem -= binWid;
+        int     ig      = J.iv2ig[iv],
+                dstep   = dwnSmp * nG,
+                ny      = 0;
+        qint16  *d      = &F.data[ig];
 
-                        ybuf[ny]  = vmax * ysc;
-                        ybuf2[ny] = vmin * ysc;
-                        ++ny;
-                    }
+        // -------------------------------------
+        // Vector binMax over a run of neural ig
+        // -------------------------------------
 
-                    grfY[ig].yval2.putData( &ybuf2[xoff], dtpts - xoff );
-                }
-                else if( sAveLocal ) {
+        if( binMax && !sAveLocal ) {
+
+            int nRun = 0;
+
+            while( iv + nRun < ivLim
+                    && J.iv2ig[iv + nRun] == ig + nRun
+                    && grfY[ig + nRun].usrType == 0
+                    && !(shankMap && !shankMap->e[ig + nRun].u) ) {
+
+                ++nRun;
+            }
+
+            if( nRun ) {
 
-                    grfY[ig].drawBinMax = false;
+                yRun.resize( nRun * dtpts );
+                yRun2.resize( nRun * dtpts );
 
-                    for( int it = 0; it < ntpts; it += dwnSmp, d += dstep )
-                        ybuf[ny++] = sAveApplyLocal( d, ig ) * ysc;
+                GraphStats::binMax(
+                    &yRun[0], &yRun2[0], dtpts, 0, d,
+                    ntpts, nG, nRun, dwnSmp, binMax, ysc );
+
+                for( int k = 0; k < nRun; ++k ) {
+
+                    J.mode[iv + k] = 2;
+
+                    memcpy( &J.y[iv + k][J.ny], &yRun[k * dtpts + xoff],
+                        (dtpts - xoff) * sizeof(float) );
+                    memcpy( &J.y2[iv + k][J.ny], &yRun2[k * dtpts + xoff],
+                        (dtpts - xoff) * sizeof(float) );
                 }
-                else {
-                    grfY[ig].drawBinMax = false;
-                    goto draw_analog;
+
+                iv += nRun - 1;
+                continue;
+            }
+        }
+
+        if( grfY[ig].usrType == 0 ) {
+
+            // ---------------
+            // Neural channels
+            // ---------------
+
+            // ---------------
+            // Skip references
+            // ---------------
+
+            if( shankMap && !shankMap->e[ig].u )
+                continue;
+
+            // -------------------
+            // Neural downsampling
+            // -------------------
+
+            // Within each bin, report both max and min
+            // values. This ensures spikes aren't missed.
+            // Max in ybuf, min in ybuf2.
+
+            if( binMax ) {
+
+                int ndRem = ntpts;
+
+                J.mode[iv] = 2;
+
+                for(
+                    int it = 0;
+                    it < ntpts;
+                    it += dwnSmp, d = &F.data[ig + it*nG] ) {
+
+                    int val     = V_S_AVE( d ),
+                        vmax    = val,
+                        vmin    = val,
+                        binWid  = dwnSmp;
+
+                    d += binMax*nG;
+
+                    if( ndRem < binWid )
+                        binWid = ndRem;
+
+                    for(
+                        int ib = binMax;
+                        ib < binWid;
+                        ib += binMax, d += binMax*nG ) {
+
+                        val = V_S_AVE( d );
+
+                        if( val > vmax )
+                            vmax = val;
+                        else if( val < vmin )
+                            vmin = val;
+                    }
+
+                    ndRem -= binWid;
+
+                    ybuf[ny]  = vmax * ysc;
+                    ybuf2[ny] = vmin * ysc;
+                    ++ny;
                 }
+
+                memcpy( &J.y2[iv][J.ny], &ybuf2[xoff],
+                    (dtpts - xoff) * sizeof(float) );
             }
-            else if( grfY[ig].usrType == 1 ) {
+            else if( sAveLocal ) {
 
-                // -----------------
-                // Analog: LF or Aux
-                // -----------------
+                J.mode[iv] = 1;
 
-draw_analog:
                 for( int it = 0; it < ntpts; it += dwnSmp, d += dstep )
-                    ybuf[ny++] = *d * ysc;
+                    ybuf[ny++] = sAveApplyLocal( d, ig ) * ysc;
             }
             else {
+                J.mode[iv] = 1;
+                goto draw_analog;
+            }
+        }
+        else if( grfY[ig].usrType == 1 ) {
 
-                // -------
-                // Digital
-                // -------
+            // -----------------
+            // Analog: LF or Aux
+            // -----------------
 
-                for( int it = 0; it < ntpts; it += dwnSmp, d += dstep )
-                    ybuf[ny++] = *d;
-            }
+            J.mode[iv] = 1;
+
+draw_analog:
+            for( int it = 0; it < ntpts; it += dwnSmp, d += dstep )
+                ybuf[ny++] = *d * ysc;
+        }
+        else {
+
+            // -------
+            // Digital
+            // -------
 
-            // -------------
-            // Copy to graph
-            // -------------
+            J.mode[iv] = 1;
 
-            grfY[ig].yval.putData( &ybuf[xoff], dtpts - xoff );
+            for( int it = 0; it < ntpts; it += dwnSmp, d += dstep )
+                ybuf[ny++] = *d;
         }
 
-        xoff = 0;   // only first chunk includes offset
-    }   // end chunks
+        // -----------
+        // Copy to job
+        // -----------
 
-// -----------------
-// Select and redraw
-// -----------------
+        memcpy( &J.y[iv][J.ny], &ybuf[xoff], (dtpts - xoff) * sizeof(float) );
+    }
+}
+
+/* ---------------------------------------------------------------- */
+/* Draw jobs ------------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+FVJobPool &FVJobPool::pool()
+{
+    static FVJobPool    P( qBound( 2, getNProcessors() / 2, FVJOB_MAXTHREADS ) );
+    return P;
+}
+
+
+FVJobPool::FVJobPool( int nThd ) : stop(false)
+{
+    for( int i = 0; i < nThd; ++i ) {
+
+        QThread     *thread = new QThread;
+        FVJobWorker *worker = new FVJobWorker( *this );
+
+        worker->moveToThread( thread );
 
+        Connect( thread, SIGNAL(started()), worker, SLOT(run()) );
+        Connect( worker, SIGNAL(finished()), worker, SLOT(deleteLater()) );
+        Connect( worker, SIGNAL(destroyed()), thread, SLOT(quit()), Qt::DirectConnection );
+
+        thread->start();
+        vT.push_back( thread );
+    }
+}
+
+
+// worker objects auto-deleted asynchronously
+// thread objects manually deleted synchronously (so we can call wait())
+//
+FVJobPool::~FVJobPool()
+{
+    poolMtx.lock();
+        stop = true;
+    poolMtx.unlock();
+    condJob.wakeAll();
+
+    for( int i = 0, n = vT.size(); i < n; ++i ) {
+
+        if( vT[i]->isRunning() )
+            vT[i]->wait( 20000 );
+
+        delete vT[i];
+    }
+}
+
+
+// Queue W's job (already set up), superseding earlier results.
+//
+void FVJobPool::post( FileViewerWindow *W )
+{
+    QMutexLocker    ml( &poolMtx );
+
+    ++W->jobGen;
+
+    if( !W->jobPend ) {
+        W->jobPend = true;
+        queue.push_back( W );
+    }
+
+    condJob.wakeOne();
+}
+
+
+// Abort W's running job (at its next chunk) and wait; drop
+// any pending or queued results. After this the GUI thread
+// may change W's job, filters and tables.
+//
+void FVJobPool::cancel( FileViewerWindow *W )
+{
+    QMutexLocker    ml( &poolMtx );
+
+    ++W->jobGen;
+
+    if( W->jobPend ) {
+        queue.removeOne( W );
+        W->jobPend = false;
+    }
+
+    W->jobAbort = true;
+
+    while( W->jobBusy )
+        W->jobIdle.wait( &poolMtx );
+
+    W->jobAbort = false;
+}
+
+
+// True if results of W's job gen are complete and current.
+//
+bool FVJobPool::isCurrent( FileViewerWindow *W, int gen )
+{
+    QMutexLocker    ml( &poolMtx );
+
+    return gen == W->jobGen && !W->jobPend && !W->jobBusy;
+}
+
+
+// Workers block until a job comes or stop.
+//
+// Return window to run, or 0 if stopping.
+//
+FileViewerWindow *FVJobPool::take( int &gen )
+{
+    QMutexLocker    ml( &poolMtx );
+
+    while( !stop && queue.isEmpty() )
+        condJob.wait( &poolMtx );
+
+    if( stop )
+        return 0;
+
+    FileViewerWindow    *W = queue.takeFirst();
+
+    W->jobPend  = false;
+    W->jobBusy  = true;
+    gen         = W->jobGen;
+
+    return W;
+}
+
+
+// Result is posted before W goes idle, so W can't be
+// destroyed (cancel waits for idle) before posting.
+//
+void FVJobPool::done( FileViewerWindow *W, int gen, bool ok )
+{
+    QMutexLocker    ml( &poolMtx );
+
+    if( ok ) {
+        QMetaObject::invokeMethod(
+            W, "drawJobDone",
+            Qt::QueuedConnection,
+            Q_ARG(int, gen) );
+    }
+
+    W->jobBusy = false;
+    W->jobIdle.wakeAll();
+}
+
+
+void FVJobWorker::run()
+{
+    FileViewerWindow    *W;
+    int                 gen;
+
+    while( (W = P.take( gen )) )
+        P.done( W, gen, W->drawJob() );
+
+    emit finished();
+}
+
+
+// GUI thread: upload finished job unless superseded.
+//
+void FileViewerWindow::drawJobDone( int gen )
+{
+    if( !FVJobPool::pool().isCurrent( this, gen ) )
+        return;
+
+    DrawJob &J      = job;
+    int     nVis    = J.iv2ig.size();
+
+    for( int iv = 0; iv < nVis; ++iv )
+        grfY[J.iv2ig[iv]].resize( J.gtpts );
+
+    mscroll->theX->initVerts( J.gtpts );
+
+    for( int iv = 0; iv < nVis; ++iv ) {
+
+        MGraphY &G = grfY[J.iv2ig[iv]];
+
+        if( !J.mode[iv] )
+            continue;
+
+        G.drawBinMax = (J.mode[iv] == 2);
+        G.yval.putData( &J.y[iv][0], J.ny );
+
+        if( G.drawBinMax )
+            G.yval2.putData( &J.y2[iv][0], J.ny );
+    }
+
+    updateEvents();
     updateXSel();
+
+// ------------------
+// Prefetch next span
+// ------------------
+
+    rdCache->prefetch(
+        J.pos, J.num2Read,
+        (J.pos > rdLastPos ? 1 : (J.pos < rdLastPos ? -1 : 0)) );
+    rdLastPos = J.pos;
 }
 
 
@@ -5,19 +5,39 @@
 
 #include <QMainWindow>
 #include <QBitArray>
+#include <QMap>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <vector>
 
 class FileViewerWindow;
 class FVToolbar;
 class FVScanGrp;
+class FVShankMap;
 class DataFile;
+class DFActivity;
+class DFOverview;
+class DFEvents;
+struct DFEvtLine;
+class DFReadCache;
+class DFSequence;
+class DFTranspose;
 struct ShankMap;
 struct ChanMap;
 class MGraphY;
 class MGScroll;
 class Biquad;
+class BiquadCascade;
+struct BiquadJob;
 class ExportCtl;
+struct ExportChain;
+class SpatialRef;
 class TaggableLabel;
 
+class QThread;
+
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -32,6 +52,54 @@ struct FVOpen {
     :   fvw(fvw), runTag(fname) {}
 };
 
+// Draw job threads shared by all viewers, so linked windows
+// update in parallel. Each window has at most one job queued
+// or running; posting again just supersedes its parameters.
+//
+class FVJobPool
+{
+    friend class FVJobWorker;
+
+private:
+    std::vector<QThread*>       vT;
+    QList<FileViewerWindow*>    queue;
+    QMutex                      poolMtx;
+    QWaitCondition              condJob;
+    bool                        stop;
+
+public:
+    static FVJobPool &pool();
+
+    FVJobPool( int nThd );
+    virtual ~FVJobPool();
+
+    void post( FileViewerWindow *W );
+    void cancel( FileViewerWindow *W );
+    bool isCurrent( FileViewerWindow *W, int gen );
+
+private:
+    FileViewerWindow *take( int &gen );
+    void done( FileViewerWindow *W, int gen, bool ok );
+};
+
+class FVJobWorker : public QObject
+{
+    Q_OBJECT
+
+private:
+    FVJobPool   &P;
+
+public:
+    FVJobWorker( FVJobPool &P ) : QObject(0), P(P)  {}
+
+signals:
+    void finished();
+
+public slots:
+    void run();
+};
+
+
 struct FVLinkRec {
     DFRunTag    runTag;
     QBitArray   apBits,
@@ -48,6 +116,8 @@ class FileViewerWindow : public QMainWindow
     Q_OBJECT
 
     friend class FVScanGrp;
+    friend class FVShankMap;
+    friend class FVJobPool;
 
 private:
     struct SaveAll {
@@ -56,9 +126,11 @@ private:
                 xSpan,
                 ySclAux;
         int     yPix,
-                nDivs;
+                nDivs,
+                notchSel;       // {0=Off, 1=50 Hz, 2=60 Hz}
         bool    sortUserOrder,
-                manualUpdate;
+                manualUpdate,
+                zeroPhase;      // 300 Hz run forward-backward
 
         SaveAll() : fArrowKey(0.1), fPageKey(0.5)   {}
     };
@@ -103,7 +175,8 @@ private:
     public:
         void init( int nChannels, int nNeural );
         void updateLvl(
-            const DataFile  *df,
+            vec_i16         &keep,
+            DFReadCache     *rc,
             qint64          xpos,
             qint64          nRem,
             qint64          chunk,
@@ -114,6 +187,45 @@ private:
             int             dwnSmp );
     };
 
+    // Posted by updateGraphs, run by drawJob
+    struct DrawJob {
+        QVector<uint>                       iv2ig;
+        std::vector<std::vector<float> >    y,
+                                            y2;     // binMax mins
+        std::vector<char>                   mode;   // {0=skip,1=y,2=y+y2}
+        qint64                              pos,
+                                            xpos,
+                                            ntpts,
+                                            num2Read,
+                                            ckpt,
+                                            fltOK,
+                                            gtpts,
+                                            xoff,
+                                            chunk,
+                                            ny;     // y filled
+        float                               ysc;
+        int                                 maxInt,
+                                            stride,
+                                            nG,
+                                            xflt,
+                                            dwnSmp,
+                                            binMax,
+                                            sAveSel;
+        bool                                hp300,
+                                            zeroPhase,
+                                            dcOn;
+    };
+
+    // One chunk's channel-group fill context
+    struct DrawFill {
+        FileViewerWindow    *fvw;
+        qint16              *data;
+        int                 ntpts,
+                            dtpts,
+                            xoff;
+        bool                sAveLocal;
+    };
+
     FVToolbar               *tbar;
     FVScanGrp               *scanGrp;
     SaveSet                 sav;
@@ -122,17 +234,28 @@ private:
     double                  tMouseOver,
                             yMouseOver;
     qint64                  dfCount,
+                            rdLastPos,          // prefetch direction
                             dragAnchor,
                             dragL,              // or -1
                             dragR,
                             savedDragL,         // zoom: temp save sel
                             savedDragR;
     DataFile                *df;
+    DFOverview              *ovw;
+    DFReadCache             *rdCache;
+    DFSequence              *seq;       // joined trigger files, if any
+    DFTranspose             *tps;       // building sidecar, if any
+    DFEvents                *evt;       // digital edge index
+    DFActivity              *act;       // per-site activity, on demand
+    FVShankMap              *actMap;
     ShankMap                *shankMap;
     ChanMap                 *chanMap;
     Biquad                  *hipass;
+    BiquadCascade           *notch;
+    QMap<qint64,std::vector<double> >   fltCkpt;    // scan -> state
     ExportCtl               *exportCtl;
     QMenu                   *channelsMenu;
+    QAction                 *joinAct;
     MGScroll                *mscroll;
     TaggableLabel           *closeLbl;
     QTimer                  *hideCloseTimer;
@@ -156,7 +279,15 @@ private:
                             nNeurChans;
     bool                    didLayout,
                             selDrag,
-                            zoomDrag;
+                            zoomDrag,
+                            evtShow;
+
+    DrawJob                 job;
+    QWaitCondition          jobIdle;    // FVJobPool guards job state
+    int                     jobGen;
+    bool                    jobPend,
+                            jobBusy;
+    std::atomic<bool>       jobAbort;
 
     static std::vector<FVOpen>  vOpen;
     static QSet<QString>        linkedRuns;
@@ -199,6 +330,8 @@ public:
                 default: return false;
             }
         }
+    bool    tbGetZeroPhase() const  {return sav.all.zeroPhase;}
+    int     tbGetNotchSel() const   {return sav.all.notchSel;}
     bool    tbGetDCChkOn() const
         {
             switch( fType ) {
@@ -220,6 +353,8 @@ public:
     void getInverseGains(
         std::vector<double> &invGain,
         const QBitArray     &exportBits ) const;
+    int getSpikeChanCount( const QBitArray &exportBits ) const;
+    void getExportChain( ExportChain &C ) const;
 
 public slots:
 // Toolbar
@@ -231,6 +366,8 @@ public slots:
     void tbSetMuxGain( double d );
     void tbSetNDivs( int n );
     void tbHipassClicked( bool b );
+    void tbZeroPhaseClicked( bool b );
+    void tbNotchSelChanged( int sel );
     void tbDcClicked( bool b );
     void tbSAveSelChanged( int sel );
     void tbBinMaxChanged( int n );
@@ -250,7 +387,13 @@ private slots:
     void file_ZoomIn();
     void file_ZoomOut();
     void file_Options();
+    void file_Transpose();
+    void file_JoinTrig( bool on );
+    void file_ActMap();
     void file_Notes();
+    void events_Markers( bool on );
+    void events_Next();
+    void events_Prev();
     void channels_ShowAll();
     void channels_HideAll();
     void channels_Edit();
@@ -286,6 +429,15 @@ private slots:
     void linkRecvManualUpdate( bool manualUpdate );
     void linkRecvDraw();
 
+// Overview
+    void ovwReady();
+    void tpsReady();
+    void evtReady();
+    void actReady();
+
+// Draw jobs
+    void drawJobDone( int gen );
+
 protected:
     virtual bool eventFilter( QObject *obj, QEvent *e );
     virtual void closeEvent( QCloseEvent *e );
@@ -299,7 +451,10 @@ private:
 
 // Data-dependent inits
     bool openFile( const QString &fname, QString *errMsg );
+    void killReaders();
+    void initReaders();
     void initHipass();
+    void initNotch();
     void killActions();
     void initGraphs();
 
@@ -318,28 +473,35 @@ private:
     void toggleMaximized();
     void sAveTable( int sel );
     int sAveApplyLocal( const qint16 *d_ig, int ig );
-    void sAveApplyGlobal(
-        qint16  *d,
-        int     ntpts,
-        int     nC,
-        int     nAP,
-        int     dwnSmp );
-    void sAveApplyGlobalStride(
-        qint16  *d,
-        int     ntpts,
-        int     nC,
-        int     nAP,
-        int     stride,
-        int     dwnSmp );
-    void sAveApplyDmxTbl(
-        qint16  *d,
-        int     ntpts,
-        int     nC,
-        int     nAP,
-        int     dwnSmp );
+    void sAveGlobalRef(
+        SpatialRef  &sr,
+        int         sel,
+        int         nAP,
+        int         stride ) const;
     void updateXSel();
+    void updateEvents();
+    void evtLines( QVector<DFEvtLine> &lines ) const;
     void zoomTime();
+    void hipassCkpt(
+        qint16  *d,
+        int     maxInt,
+        qint64  t0,
+        int     ntpts,
+        int     nG,
+        qint64  tOK );
+    bool updateGraphsOvw(
+        qint64              xpos,
+        qint64              ntpts,
+        int                 dwnSmp,
+        qint64              gtpts,
+        const QVector<uint> &iv2ig,
+        float               ysc );
     void updateGraphs();
+    bool drawJob();
+    static void drawFillJob( const BiquadJob &B );
+    void drawFill( const DrawFill &F, int iv0, int ivLim );
+    void jobPost()      {FVJobPool::pool().post( this );}
+    void jobCancel()    {FVJobPool::pool().cancel( this );}
 
     void printStatusMessage();
     bool queryCloseOK();
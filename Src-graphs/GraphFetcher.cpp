@@ -2,55 +2,74 @@
 #include "GraphFetcher.h"
 #include "Util.h"
 #include "AIQ.h"
+#include "FltStream.h"
 #include "SVGrafsM.h"
+#include "ThdPlace.h"
 
 #include <QThread>
 
 
-#define PERIOD_SECS 0.1
+#define PERIOD_SECS         0.1
+#define BKGND_PERIOD_SECS   0.3
 
 
 /* ---------------------------------------------------------------- */
 /* GFWorker ------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
-void GFWorker::setStreams( const std::vector<GFStream> &gfs )
+void GFWorker::setStream( const GFStream &S )
 {
     QMutexLocker    ml( &gfsMtx );
 
-    this->gfs = gfs;
+    share( 0 );
 
-    for( int is = 0, ns = gfs.size(); is < ns; ++is ) {
+    // Each viewer pane reports its own lag
 
-        GFStream    &G = this->gfs[is];
+    if( this->S.aiQ )
+        this->S.aiQ->readerFree( this->S.rdrId );
 
-        G.setCts = PERIOD_SECS * G.aiQ->sRate();
-        G.nextCt = 0;
+    this->S = S;
+
+    if( S.aiQ ) {
+        this->S.setCts  = PERIOD_SECS * S.aiQ->sRate();
+        this->S.nextCt  = 0;
+        this->S.rdrId   = S.aiQ->readerId( "graphs", true );
     }
 }
 
 
 void GFWorker::run()
 {
-    Debug() << "Graph fetching started.";
+    ThdPlace::apply( ThdPlace::roleGraph );
 
-    const int   loopPeriod_us = 1e6 * PERIOD_SECS;
+    Debug() << "Graph fetching started.";
 
     while( !isStopped() ) {
 
-        double  loopT = getTime();
+        double  loopT   = getTime(),
+                period  = periodSecs();
 
         if( !isPaused() ) {
 
             gfsMtx.lock();
 
-            for( int is = 0, ns = gfs.size(); is < ns; ++is )
-                fetch( gfs[is] );
+            if( S.aiQ ) {
+                S.setCts = period * S.aiQ->sRate();
+                fetch( S );
+            }
 
             gfsMtx.unlock();
         }
+        else {
+
+            gfsMtx.lock();
+                share( 0 );
+            gfsMtx.unlock();
+        }
+
+        // Fetch no more often than every period
 
-        // Fetch no more often than every loopPeriod_us
+        int loopPeriod_us = 1e6 * period;
 
         loopT = 1e6*(getTime() - loopT);    // microsec
 
@@ -60,15 +79,98 @@ void GFWorker::run()
             QThread::usleep( 1000 * 10 );
     }
 
+    gfsMtx.lock();
+        share( 0 );
+    gfsMtx.unlock();
+
     Debug() << "Graph fetching stopped.";
 
     emit finished();
 }
 
 
+double GFWorker::periodSecs() const
+{
+    return (bkgnd.load( std::memory_order_acquire ) ?
+            BKGND_PERIOD_SECS : PERIOD_SECS);
+}
+
+
+// Declare (src, B) as the band this view filters with, dropping
+// any previous one. Caller holds gfsMtx.
+//
+void GFWorker::share(
+    const AIQ           *src,
+    const BiquadBand    &B,
+    int                 cLim,
+    int                 maxInt )
+{
+    if( src == shQ && (!src || B == shB) )
+        return;
+
+    if( shQ )
+        FltStream::unshare( shQ, shB );
+
+    shQ = src;
+    shB = B;
+
+    if( src )
+        FltStream::share( src, cLim, maxInt, B );
+}
+
+
+// Return stage F if it holds the scans we'd fetch next, else 0.
+// A stage made on demand has a gap before the count where it
+// joined, then a filter transient; so might one that lost data.
+//
+const AIQ *GFWorker::fltQueue( const GFStream &S, const AIQ *F ) const
+{
+    if( !F )
+        return 0;
+
+    quint64 endCt   = F->endCount(),
+            fromCt  = S.nextCt,
+            g0, g1;
+
+    if( !fromCt )
+        fromCt = (endCt > S.setCts ? endCt - S.setCts : 0);
+
+    if( endCt <= fromCt )
+        return 0;
+
+    fromCt -= qMin( fromCt, quint64(BIQUAD_TRANS_WIDE) );
+
+    if( F->findGap( g0, g1, fromCt, int(endCt - fromCt) ) )
+        return 0;
+
+    return F;
+}
+
+
+// If there's a filter stage on this stream with just the band
+// the view would apply itself, read that instead of the raw
+// queue. Counts match, so nextCt and readerAt are unaffected.
+//
 void GFWorker::fetch( GFStream &S )
 {
-    quint64 endCt = S.aiQ->endCount();
+    BiquadBand  B;
+    const AIQ   *Q      = 0;
+    int         cLim,
+                maxInt;
+
+    if( S.W->viewBand( B, cLim, maxInt ) ) {
+        share( S.aiQ, B, cLim, maxInt );
+        Q = fltQueue( S, FltStream::find( S.aiQ, B, true ) );
+    }
+    else
+        share( 0 );
+
+    bool    fltd    = (Q != 0);
+
+    if( !fltd )
+        Q = S.aiQ;
+
+    quint64 endCt   = Q->endCount();
 
 // Just wait if fetching too soon
 
@@ -109,7 +211,7 @@ void GFWorker::fetch( GFStream &S )
             << " scans.";
     }
 
-    if( 1 != S.aiQ->getNScansFromCt( data, S.nextCt, nMax ) ) {
+    if( 1 != Q->getNScansFromCt( data, S.nextCt, nMax ) ) {
 
         Warning()
             << "GraphFetcher low mem; dropped "
@@ -117,13 +219,14 @@ void GFWorker::fetch( GFStream &S )
             << " scans.";
     }
 
-    S.W->putScans( data, S.nextCt );
+    S.W->putScans( data, S.nextCt, fltd );
 
 // putScans() is allowed to resize the data block to make
 // downsampling smoother. The result of that tells us where
 // to fetch the next contiguous block.
 
     S.nextCt += data.size() / S.aiQ->nChans();
+    S.aiQ->readerAt( S.rdrId, S.nextCt );
 }
 
 /* ---------------------------------------------------------------- */
@@ -131,32 +234,95 @@ void GFWorker::fetch( GFStream &S )
 /* ---------------------------------------------------------------- */
 
 GraphFetcher::GraphFetcher()
+    :   hardPaused(false), softPaused(false), bkgnd(false)
 {
-    thread  = new QThread;
-    worker  = new GFWorker;
+}
+
+
+GraphFetcher::~GraphFetcher()
+{
+// worker objects auto-deleted asynchronously
+// thread objects manually deleted synchronously (so we can call wait())
 
-    worker->moveToThread( thread );
+    for( int iw = 0, nw = vW.size(); iw < nw; ++iw ) {
 
-    Connect( thread, SIGNAL(started()), worker, SLOT(run()) );
-    Connect( worker, SIGNAL(finished()), worker, SLOT(deleteLater()) );
-    Connect( worker, SIGNAL(destroyed()), thread, SLOT(quit()), Qt::DirectConnection );
+        if( vT[iw]->isRunning() ) {
 
-    thread->start();
+            vW[iw]->stop();
+            vT[iw]->wait();
+        }
+
+        delete vT[iw];
+    }
 }
 
 
-GraphFetcher::~GraphFetcher()
+// Start a worker for each new stream; surplus workers idle.
+//
+void GraphFetcher::setStreams( const std::vector<GFStream> &gfs )
 {
-// worker object auto-deleted asynchronously
-// thread object manually deleted synchronously (so we can call wait())
+    int ns = gfs.size();
 
-    if( thread->isRunning() ) {
+    while( int(vW.size()) < ns ) {
 
-        worker->stop();
-        thread->wait();
+        QThread     *thread = new QThread;
+        GFWorker    *worker = new GFWorker( hardPaused, softPaused, bkgnd );
+
+        worker->moveToThread( thread );
+
+        Connect( thread, SIGNAL(started()), worker, SLOT(run()) );
+        Connect( worker, SIGNAL(finished()), worker, SLOT(deleteLater()) );
+        Connect( worker, SIGNAL(destroyed()), thread, SLOT(quit()), Qt::DirectConnection );
+
+        thread->start();
+
+        vT.push_back( thread );
+        vW.push_back( worker );
     }
 
-    delete thread;
+    for( int iw = 0, nw = vW.size(); iw < nw; ++iw )
+        vW[iw]->setStream( iw < ns ? gfs[iw] : GFStream() );
+}
+
+
+bool GraphFetcher::hardPause( bool pause )
+{
+    bool    was = hardPaused;
+
+    hardPaused = pause;
+
+    for( int iw = 0, nw = vW.size(); iw < nw; ++iw )
+        vW[iw]->hardPause( pause );
+
+    return was;
+}
+
+
+void GraphFetcher::softPause( bool pause )
+{
+    softPaused = pause;
+
+    for( int iw = 0, nw = vW.size(); iw < nw; ++iw )
+        vW[iw]->softPause( pause );
+}
+
+
+void GraphFetcher::setBkgnd( bool bkgnd )
+{
+    if( bkgnd == this->bkgnd )
+        return;
+
+    this->bkgnd = bkgnd;
+
+    for( int iw = 0, nw = vW.size(); iw < nw; ++iw )
+        vW[iw]->setBkgnd( bkgnd );
+}
+
+
+void GraphFetcher::waitPaused()
+{
+    for( int iw = 0, nw = vW.size(); iw < nw; ++iw )
+        vW[iw]->waitPaused();
 }
 
 
@@ -1,14 +1,19 @@
 #ifndef GRAPHFETCHER_H
 #define GRAPHFETCHER_H
 
+#include "Biquad.h"
+
 #include <QObject>
 #include <QMutex>
 
+#include <atomic>
 #include <vector>
 
 class SVGrafsM;
 class AIQ;
 
+class QThread;
+
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -19,54 +24,69 @@ struct GFStream {
     AIQ         *aiQ;
     quint64     setCts,
                 nextCt;
+    int         rdrId;
 
     GFStream()
-        :   W(0), aiQ(0), setCts(0), nextCt(0)                  {}
+        :   W(0), aiQ(0), setCts(0), nextCt(0), rdrId(-1)  {}
     GFStream( const QString &stream, SVGrafsM *W )
-        :   stream(stream), W(W), aiQ(0), setCts(0), nextCt(0)  {}
+        :   stream(stream), W(W), aiQ(0),
+            setCts(0), nextCt(0), rdrId(-1)                 {}
 };
 
+// One worker per stream, each in its own thread with its own
+// pacing, so a slow putScans() on one view doesn't hold up the
+// others. Background windows (setBkgnd) may fetch less often.
+//
+// Each worker declares the band its view filters with, so views
+// of the same stream in several windows share one filter stage
+// (see FltStream::share) and each does only its own downsampling.
+// Paused workers withdraw.
+//
 class GFWorker : public QObject
 {
     Q_OBJECT
 
 private:
-    std::vector<GFStream>   gfs;
-    mutable QMutex          gfsMtx,
-                            runMtx;
-    volatile bool           hardPaused, // Pause button
+    GFStream                S;  // idle if S.aiQ = 0
+    const AIQ               *shQ;   // sharing (shQ, shB) if shQ
+    BiquadBand              shB;
+    mutable QMutex          gfsMtx;
+    std::atomic<bool>       hardPaused, // Pause button
                             softPaused, // Window state
+                            bkgnd,      // Slow refresh
                             pleaseStop;
 
 public:
-    GFWorker()
-    :   QObject(0),
-        hardPaused(false), softPaused(false),
-        pleaseStop(false)                   {}
+    GFWorker( bool hardPaused, bool softPaused, bool bkgnd )
+    :   QObject(0), shQ(0),
+        hardPaused(hardPaused), softPaused(softPaused),
+        bkgnd(bkgnd), pleaseStop(false)     {}
     virtual ~GFWorker()                     {}
 
-    void setStreams( const std::vector<GFStream> &gfs );
+    void setStream( const GFStream &S );
 
-    bool hardPause( bool pause )
-        {
-            QMutexLocker ml( &runMtx );
-            bool was = hardPaused;
-            hardPaused = pause;
-            return was;
-        }
+    void hardPause( bool pause )
+        {hardPaused.store( pause, std::memory_order_release );}
     void softPause( bool pause )
-        {QMutexLocker ml( &runMtx ); softPaused = pause;}
+        {softPaused.store( pause, std::memory_order_release );}
+    void setBkgnd( bool bkgnd )
+        {this->bkgnd.store( bkgnd, std::memory_order_release );}
     bool isPaused() const
-        {QMutexLocker ml( &runMtx ); return hardPaused || softPaused;}
+        {
+            return hardPaused.load( std::memory_order_acquire )
+                || softPaused.load( std::memory_order_acquire );
+        }
     void waitPaused()
         {
-            QMutexLocker ml( &runMtx );
-            if( hardPaused || softPaused )
-                QMutexLocker ml2( &gfsMtx );
+            // Returns once any fetch in progress is done
+            if( isPaused() )
+                QMutexLocker ml( &gfsMtx );
         }
 
-    void stop()             {QMutexLocker ml( &runMtx ); pleaseStop = true;}
-    bool isStopped() const  {QMutexLocker ml( &runMtx ); return pleaseStop;}
+    void stop()
+        {pleaseStop.store( true, std::memory_order_release );}
+    bool isStopped() const
+        {return pleaseStop.load( std::memory_order_acquire );}
 
 signals:
     void finished();
@@ -75,26 +95,39 @@ public slots:
     void run();
 
 private:
+    double periodSecs() const;
+    void share(
+        const AIQ           *src,
+        const BiquadBand    &B = BiquadBand(),
+        int                 cLim = 0,
+        int                 maxInt = 0 );
+    const AIQ *fltQueue( const GFStream &S, const AIQ *F ) const;
     void fetch( GFStream &S );
 };
 
 
+// Owns a GFWorker thread per stream of one GraphsWindow;
+// the pause and background states apply to all of them.
+//
 class GraphFetcher
 {
 private:
-    QThread     *thread;
-    GFWorker    *worker;
+    std::vector<QThread*>   vT;
+    std::vector<GFWorker*>  vW;
+    bool                    hardPaused,
+                            softPaused,
+                            bkgnd;
 
 public:
     GraphFetcher();
     virtual ~GraphFetcher();
 
-    void setStreams( const std::vector<GFStream> &gfs )
-        {worker->setStreams( gfs );}
+    void setStreams( const std::vector<GFStream> &gfs );
 
-    bool hardPause( bool pause )    {return worker->hardPause( pause );}
-    void softPause( bool pause )    {worker->softPause( pause );}
-    void waitPaused()               {worker->waitPaused();}
+    bool hardPause( bool pause );
+    void softPause( bool pause );
+    void setBkgnd( bool bkgnd );
+    void waitPaused();
 };
 
 #endif  // GRAPHFETCHER_H
@@ -0,0 +1,219 @@
+
+#include "GraphPub.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+
+
+QMutex                      GraphPub::subMtx;
+std::deque<GraphPubSub*>    GraphPub::subs;
+std::atomic<int>            GraphPub::nSub( 0 );
+std::atomic<int>            GraphPub::nHeadless( 0 );
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Round graph values back to counts, saturating.
+//
+static void quantize( qint16 *dst, const float *src, int n, float scl )
+{
+    for( int i = 0; i < n; ++i ) {
+
+        float   v = src[i] * scl;
+
+        v += (v >= 0 ? 0.5F : -0.5F);
+
+        dst[i] = qint16(qBound( -32768.0F, v, 32767.0F ));
+    }
+}
+
+/* ---------------------------------------------------------------- */
+/* GraphPubSub ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Wait up to timeout_ms for the oldest frame.
+//
+bool GraphPubSub::take( QByteArray &F, int timeout_ms )
+{
+    QMutexLocker    ml( &qMtx );
+
+    if( Q.empty() )
+        condWake.wait( &qMtx, timeout_ms );
+
+    if( Q.empty() )
+        return false;
+
+    F = Q.front();
+    Q.pop_front();
+    return true;
+}
+
+
+quint64 GraphPubSub::dropped()
+{
+    QMutexLocker    ml( &qMtx );
+    return nDrop;
+}
+
+/* ---------------------------------------------------------------- */
+/* GraphPubFrame -------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+GraphPubFrame::GraphPubFrame(
+    int     ip,
+    quint64 headCt,
+    int     dwnSmp,
+    double  srate )
+    :   B(sizeof(GraphPubHdr), 0), ip(ip), nG(0)
+{
+    GraphPubHdr *H = (GraphPubHdr*)B.data();
+
+    H->magic    = GRAPHPUB_MAGIC;
+    H->ip       = ip;
+    H->dwnSmp   = dwnSmp;
+    H->headCt   = headCt;
+    H->srate    = srate;
+}
+
+
+// Append graph ic; y2 non-null for binMax rows.
+// scl = 1/ysc converts graph values to counts.
+//
+void GraphPubFrame::add(
+    int         ic,
+    const float *y,
+    const float *y2,
+    int         ny,
+    float       scl,
+    bool        dig )
+{
+    int len0    = B.size(),
+        nPlane  = (y2 ? 2 : 1);
+
+    B.resize( len0 + sizeof(GraphPubRec) + nPlane * ny * sizeof(qint16) );
+
+    GraphPubRec *R = (GraphPubRec*)(B.data() + len0);
+    qint16      *D = (qint16*)(R + 1);
+
+    R->ic       = ic;
+    R->binMax   = (y2 != 0);
+    R->dig      = dig;
+    R->nPts     = ny;
+
+    quantize( D, y, ny, scl );
+
+    if( y2 )
+        quantize( D + ny, y2, ny, scl );
+
+    ++nG;
+}
+
+
+void GraphPubFrame::publish()
+{
+    if( !nG )
+        return;
+
+    GraphPubHdr *H = (GraphPubHdr*)B.data();
+
+    H->bytes    = B.size();
+    H->nG       = nG;
+
+    GraphPub::publish( ip, B );
+}
+
+/* ---------------------------------------------------------------- */
+/* GraphPub ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Cheap test for graphs to skip framing when nobody listens.
+//
+bool GraphPub::wanted( int ip )
+{
+    if( !nSub.load( std::memory_order_relaxed ) )
+        return false;
+
+    QMutexLocker    ml( &subMtx );
+
+    for( int i = 0, n = subs.size(); i < n; ++i ) {
+
+        if( subs[i]->ip == ip )
+            return true;
+    }
+
+    return false;
+}
+
+
+GraphPubSub *GraphPub::subscribe( int ip, bool headless )
+{
+    GraphPubSub     *S = new GraphPubSub( ip, headless );
+    QMutexLocker    ml( &subMtx );
+
+    subs.push_back( S );
+    ++nSub;
+
+    if( headless )
+        ++nHeadless;
+
+    return S;
+}
+
+
+void GraphPub::unsubscribe( GraphPubSub *S )
+{
+    if( !S )
+        return;
+
+    subMtx.lock();
+
+        std::deque<GraphPubSub*>::iterator
+            it = std::find( subs.begin(), subs.end(), S );
+
+        if( it != subs.end() ) {
+
+            subs.erase( it );
+            --nSub;
+
+            if( S->headless )
+                --nHeadless;
+        }
+
+    subMtx.unlock();
+
+    delete S;
+}
+
+
+// Queue F to each subscriber of stream ip; a slow viewer
+// loses its oldest frames rather than holding up graphs.
+//
+void GraphPub::publish( int ip, const QByteArray &F )
+{
+    QMutexLocker    ml( &subMtx );
+
+    for( int i = 0, n = subs.size(); i < n; ++i ) {
+
+        GraphPubSub *S = subs[i];
+
+        if( S->ip != ip )
+            continue;
+
+        S->qMtx.lock();
+
+            if( S->Q.size() >= GRAPHPUB_MAXQ ) {
+                S->Q.pop_front();
+                ++S->nDrop;
+            }
+
+            S->Q.push_back( F );
+
+        S->qMtx.unlock();
+
+        S->condWake.wakeAll();
+    }
+}
+
+
@@ -0,0 +1,120 @@
+#ifndef GRAPHPUB_H
+#define GRAPHPUB_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <deque>
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#define GRAPHPUB_MAGIC  0x474C4753  // 'SGLG'
+
+// Frames a subscriber may fall behind before oldest dropped.
+#define GRAPHPUB_MAXQ   8
+
+// Graph stream frame (little-endian), one per putScans() block:
+// - GraphPubHdr.
+// - Per graph: GraphPubRec, qint16 y[nPts],
+//   and if binMax, qint16 ymin[nPts].
+//
+// Points are the post-filter, post-binMax graph values in
+// stream counts (digital words as is), so a viewer draws
+// exactly what the local graphs would.
+//
+struct GraphPubHdr {
+    quint32 magic;  // GRAPHPUB_MAGIC
+    quint32 bytes;  // whole frame including header
+    qint16  ip;     // -1=nidq, >=0 imec probe
+    quint16 nG;     // graph records following
+    quint32 dwnSmp; // stream samples per point
+    quint64 headCt; // stream count of first sample
+    double  srate;
+};
+
+
+struct GraphPubRec {
+    quint16 ic;     // acquired channel index
+    quint8  binMax; // 1=ymin plane follows
+    quint8  dig;    // 1=digital word
+    quint32 nPts;
+};
+
+
+// One remote viewer's queue of frames.
+//
+class GraphPubSub
+{
+    friend class GraphPub;
+
+private:
+    QMutex                  qMtx;
+    QWaitCondition          condWake;
+    std::deque<QByteArray>  Q;
+    quint64                 nDrop;
+    int                     ip;
+    bool                    headless;
+
+public:
+    GraphPubSub( int ip, bool headless )
+    :   nDrop(0), ip(ip), headless(headless)    {}
+
+    bool take( QByteArray &F, int timeout_ms );
+    quint64 dropped();
+};
+
+
+// Assembles one frame; frames are implicitly shared,
+// so one copy serves every subscriber.
+//
+class GraphPubFrame
+{
+private:
+    QByteArray  B;
+    int         ip,
+                nG;
+
+public:
+    GraphPubFrame( int ip, quint64 headCt, int dwnSmp, double srate );
+
+    void add(
+        int         ic,
+        const float *y,
+        const float *y2,
+        int         ny,
+        float       scl,
+        bool        dig );
+    void publish();
+};
+
+
+// Remote-display hub: SVGrafsM_Xx::putScans() publishes
+// its graph points to any subscribed viewers. A headless
+// subscriber suspends local drawing while connected.
+//
+class GraphPub
+{
+private:
+    static QMutex                   subMtx;
+    static std::deque<GraphPubSub*> subs;
+    static std::atomic<int>         nSub,
+                                    nHeadless;
+
+public:
+    static bool wanted( int ip );
+    static bool isHeadless()
+        {return nHeadless.load( std::memory_order_relaxed ) > 0;}
+
+    static GraphPubSub *subscribe( int ip, bool headless );
+    static void unsubscribe( GraphPubSub *S );
+
+    static void publish( int ip, const QByteArray &F );
+};
+
+#endif  // GRAPHPUB_H
+
+
@@ -1,10 +1,364 @@
 
 #include "GraphStats.h"
+#include "Util.h"
 
 #include <math.h>
 
 
+/* ---------------------------------------------------------------- */
+/* Bin kernels ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
 
+// Min/max binning of nc adjacent channels of interleaved data,
+// a vector of channels per instruction, with integer sums for
+// the running stats so results match GraphStats::add() exactly.
+// Lanes are 8 (SSE2, NEON) or 16 (AVX2) channels; leftovers go
+// scalar. The widest kernel the CPU supports is chosen once at
+// startup.
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#define GS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define GS_AVX2_FN
+#else
+#define GS_AVX2_FN __attribute__((target("avx2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define GS_NEON
+#include <arm_neon.h>
+#endif
+
+// Per-bin int32 lane sums are exact up to this many samples.
+#define GS_MAXBINSMP    65536
+
+struct GSBin {
+    float           *ymax,
+                    *ymin;
+    GraphStats      *S;
+    const qint16    *d;
+    qint64          tstep;  // d step between samples in bin
+    int             ystride,
+                    nt,
+                    nC,
+                    dwnSmp,
+                    step;
+    float           ysc;
+};
+
+typedef void (*GSBinFn)( const GSBin &B, int c0, int cLim );
+
+
+// Write lane values of bin ib to their channel rows.
+//
+static inline void gsScatter(
+    float           *y,
+    int             ystride,
+    int             ib,
+    const qint16    *v,
+    int             L,
+    float           ysc )
+{
+    for( int l = 0; l < L; ++l )
+        y[l * ystride + ib] = v[l] * ysc;
+}
+
+
+// Each lane's sums into its GraphStats.
+//
+static inline void gsAddSums(
+    GraphStats      *S,
+    const qint64    *S1,
+    const qint64    *S2,
+    uint            n,
+    int             L )
+{
+    if( S ) {
+        for( int l = 0; l < L; ++l )
+            S[l].addSums( S1[l], S2[l], n );
+    }
+}
+
+
+static void gsBin_scalar( const GSBin &B, int c0, int cLim )
+{
+    for( int c = c0; c < cLim; ++c ) {
+
+        float   *ymax   = B.ymax + c * B.ystride,
+                *ymin   = B.ymin + c * B.ystride;
+        qint64  S1      = 0,
+                S2      = 0;
+        uint    n       = 0;
+
+        for( int t0 = 0, ib = 0; t0 < B.nt; t0 += B.dwnSmp, ++ib ) {
+
+            int             tLim    = qMin( t0 + B.dwnSmp, B.nt );
+            const qint16    *d      = B.d + t0 * qint64(B.nC) + c;
+            int             vmax    = *d,
+                            vmin    = vmax;
+
+            for( int t = t0; t < tLim; t += B.step, d += B.tstep, ++n ) {
+
+                int val = *d;
+
+                if( val > vmax )
+                    vmax = val;
+                else if( val < vmin )
+                    vmin = val;
+
+                S1 += val;
+                S2 += val * val;
+            }
+
+            ymax[ib] = vmax * B.ysc;
+            ymin[ib] = vmin * B.ysc;
+        }
+
+        if( B.S )
+            B.S[c].addSums( S1, S2, n );
+    }
+}
+
+
+#ifdef GS_X86
+
+static void gsBin_sse2( const GSBin &B, int c0, int cLim )
+{
+    const __m128i   z       = _mm_setzero_si128(),
+                    vLo     = _mm_set1_epi16( -32768 ),
+                    vHi     = _mm_set1_epi16( 32767 );
+    int             c       = c0;
+
+    for( ; c + 8 <= cLim; c += 8 ) {
+
+        qint16  vmax[8],
+                vmin[8];
+        qint32  s1[8];
+        qint64  S1[8] = {0},
+                S2[8];
+        __m128i q0 = z, q1 = z, q2 = z, q3 = z; // s2, 2 lanes each
+        uint    n = 0;
+
+        for( int t0 = 0, ib = 0; t0 < B.nt; t0 += B.dwnSmp, ++ib ) {
+
+            int             tLim    = qMin( t0 + B.dwnSmp, B.nt );
+            const qint16    *d      = B.d + t0 * qint64(B.nC) + c;
+            __m128i         mx      = vLo,
+                            mn      = vHi,
+                            a0      = z,
+                            a1      = z;
+
+            for( int t = t0; t < tLim; t += B.step, d += B.tstep, ++n ) {
+
+                __m128i v   = _mm_loadu_si128( (const __m128i*)d ),
+                        lo  = _mm_mullo_epi16( v, v ),
+                        hi  = _mm_mulhi_epi16( v, v ),
+                        p0  = _mm_unpacklo_epi16( lo, hi ),
+                        p1  = _mm_unpackhi_epi16( lo, hi );
+
+                mx = _mm_max_epi16( mx, v );
+                mn = _mm_min_epi16( mn, v );
+                a0 = _mm_add_epi32( a0,
+                        _mm_srai_epi32( _mm_unpacklo_epi16( v, v ), 16 ) );
+                a1 = _mm_add_epi32( a1,
+                        _mm_srai_epi32( _mm_unpackhi_epi16( v, v ), 16 ) );
+                q0 = _mm_add_epi64( q0, _mm_unpacklo_epi32( p0, z ) );
+                q1 = _mm_add_epi64( q1, _mm_unpackhi_epi32( p0, z ) );
+                q2 = _mm_add_epi64( q2, _mm_unpacklo_epi32( p1, z ) );
+                q3 = _mm_add_epi64( q3, _mm_unpackhi_epi32( p1, z ) );
+            }
+
+            _mm_storeu_si128( (__m128i*)vmax, mx );
+            _mm_storeu_si128( (__m128i*)vmin, mn );
+            _mm_storeu_si128( (__m128i*)s1, a0 );
+            _mm_storeu_si128( (__m128i*)(s1 + 4), a1 );
+
+            for( int l = 0; l < 8; ++l )
+                S1[l] += s1[l];
+
+            gsScatter( B.ymax + c * B.ystride, B.ystride, ib, vmax, 8, B.ysc );
+            gsScatter( B.ymin + c * B.ystride, B.ystride, ib, vmin, 8, B.ysc );
+        }
+
+        _mm_storeu_si128( (__m128i*)S2, q0 );
+        _mm_storeu_si128( (__m128i*)(S2 + 2), q1 );
+        _mm_storeu_si128( (__m128i*)(S2 + 4), q2 );
+        _mm_storeu_si128( (__m128i*)(S2 + 6), q3 );
+
+        gsAddSums( (B.S ? B.S + c : 0), S1, S2, n, 8 );
+    }
+
+    gsBin_scalar( B, c, cLim );
+}
+
+
+GS_AVX2_FN
+static void gsBin_avx2( const GSBin &B, int c0, int cLim )
+{
+    const __m256i   z       = _mm256_setzero_si256(),
+                    vLo     = _mm256_set1_epi16( -32768 ),
+                    vHi     = _mm256_set1_epi16( 32767 );
+    int             c       = c0;
+
+    for( ; c + 16 <= cLim; c += 16 ) {
+
+        qint16  vmax[16],
+                vmin[16];
+        qint32  s1[16];
+        qint64  S1[16] = {0},
+                S2[16];
+        __m256i q0 = z, q1 = z, q2 = z, q3 = z; // s2, 4 lanes each
+        uint    n = 0;
+
+        for( int t0 = 0, ib = 0; t0 < B.nt; t0 += B.dwnSmp, ++ib ) {
+
+            int             tLim    = qMin( t0 + B.dwnSmp, B.nt );
+            const qint16    *d      = B.d + t0 * qint64(B.nC) + c;
+            __m256i         mx      = vLo,
+                            mn      = vHi,
+                            a0      = z,
+                            a1      = z;
+
+            for( int t = t0; t < tLim; t += B.step, d += B.tstep, ++n ) {
+
+                __m256i v   = _mm256_loadu_si256( (const __m256i*)d ),
+                        w0  = _mm256_cvtepi16_epi32(
+                                _mm256_castsi256_si128( v ) ),
+                        w1  = _mm256_cvtepi16_epi32(
+                                _mm256_extracti128_si256( v, 1 ) ),
+                        p0  = _mm256_mullo_epi32( w0, w0 ),
+                        p1  = _mm256_mullo_epi32( w1, w1 );
+
+                mx = _mm256_max_epi16( mx, v );
+                mn = _mm256_min_epi16( mn, v );
+                a0 = _mm256_add_epi32( a0, w0 );
+                a1 = _mm256_add_epi32( a1, w1 );
+                q0 = _mm256_add_epi64( q0,
+                        _mm256_cvtepu32_epi64( _mm256_castsi256_si128( p0 ) ) );
+                q1 = _mm256_add_epi64( q1,
+                        _mm256_cvtepu32_epi64( _mm256_extracti128_si256( p0, 1 ) ) );
+                q2 = _mm256_add_epi64( q2,
+                        _mm256_cvtepu32_epi64( _mm256_castsi256_si128( p1 ) ) );
+                q3 = _mm256_add_epi64( q3,
+                        _mm256_cvtepu32_epi64( _mm256_extracti128_si256( p1, 1 ) ) );
+            }
+
+            _mm256_storeu_si256( (__m256i*)vmax, mx );
+            _mm256_storeu_si256( (__m256i*)vmin, mn );
+            _mm256_storeu_si256( (__m256i*)s1, a0 );
+            _mm256_storeu_si256( (__m256i*)(s1 + 8), a1 );
+
+            for( int l = 0; l < 16; ++l )
+                S1[l] += s1[l];
+
+            gsScatter( B.ymax + c * B.ystride, B.ystride, ib, vmax, 16, B.ysc );
+            gsScatter( B.ymin + c * B.ystride, B.ystride, ib, vmin, 16, B.ysc );
+        }
+
+        _mm256_storeu_si256( (__m256i*)S2, q0 );
+        _mm256_storeu_si256( (__m256i*)(S2 + 4), q1 );
+        _mm256_storeu_si256( (__m256i*)(S2 + 8), q2 );
+        _mm256_storeu_si256( (__m256i*)(S2 + 12), q3 );
+
+        gsAddSums( (B.S ? B.S + c : 0), S1, S2, n, 16 );
+    }
+
+    gsBin_sse2( B, c, cLim );
+}
+
+#endif  // GS_X86
+
+
+#ifdef GS_NEON
+
+static void gsBin_neon( const GSBin &B, int c0, int cLim )
+{
+    int c = c0;
+
+    for( ; c + 8 <= cLim; c += 8 ) {
+
+        qint16      vmax[8],
+                    vmin[8];
+        qint32      s1[8];
+        qint64      S1[8] = {0},
+                    S2[8];
+        int64x2_t   q0 = vdupq_n_s64( 0 ),  // s2, 2 lanes each
+                    q1 = q0, q2 = q0, q3 = q0;
+        uint        n = 0;
+
+        for( int t0 = 0, ib = 0; t0 < B.nt; t0 += B.dwnSmp, ++ib ) {
+
+            int             tLim    = qMin( t0 + B.dwnSmp, B.nt );
+            const qint16    *d      = B.d + t0 * qint64(B.nC) + c;
+            int16x8_t       mx      = vdupq_n_s16( -32768 ),
+                            mn      = vdupq_n_s16( 32767 );
+            int32x4_t       a0      = vdupq_n_s32( 0 ),
+                            a1      = a0;
+
+            for( int t = t0; t < tLim; t += B.step, d += B.tstep, ++n ) {
+
+                int16x8_t   v   = vld1q_s16( d );
+                int16x4_t   vl  = vget_low_s16( v ),
+                            vh  = vget_high_s16( v );
+                int32x4_t   p0  = vmull_s16( vl, vl ),
+                            p1  = vmull_s16( vh, vh );
+
+                mx = vmaxq_s16( mx, v );
+                mn = vminq_s16( mn, v );
+                a0 = vaddw_s16( a0, vl );
+                a1 = vaddw_s16( a1, vh );
+                q0 = vaddw_s32( q0, vget_low_s32( p0 ) );
+                q1 = vaddw_s32( q1, vget_high_s32( p0 ) );
+                q2 = vaddw_s32( q2, vget_low_s32( p1 ) );
+                q3 = vaddw_s32( q3, vget_high_s32( p1 ) );
+            }
+
+            vst1q_s16( vmax, mx );
+            vst1q_s16( vmin, mn );
+            vst1q_s32( s1, a0 );
+            vst1q_s32( s1 + 4, a1 );
+
+            for( int l = 0; l < 8; ++l )
+                S1[l] += s1[l];
+
+            gsScatter( B.ymax + c * B.ystride, B.ystride, ib, vmax, 8, B.ysc );
+            gsScatter( B.ymin + c * B.ystride, B.ystride, ib, vmin, 8, B.ysc );
+        }
+
+        vst1q_s64( (int64_t*)S2, q0 );
+        vst1q_s64( (int64_t*)(S2 + 2), q1 );
+        vst1q_s64( (int64_t*)(S2 + 4), q2 );
+        vst1q_s64( (int64_t*)(S2 + 6), q3 );
+
+        gsAddSums( (B.S ? B.S + c : 0), S1, S2, n, 8 );
+    }
+
+    gsBin_scalar( B, c, cLim );
+}
+
+#endif  // GS_NEON
+
+
+static GSBinFn pickGSBin()
+{
+#if defined(GS_X86)
+    if( cpuHasAVX2() )
+        return gsBin_avx2;
+
+    return gsBin_sse2;
+#elif defined(GS_NEON)
+    return gsBin_neon;
+#else
+    return gsBin_scalar;
+#endif
+}
+
+static const GSBinFn    gsBin   = pickGSBin();
+
+/* ---------------------------------------------------------------- */
+/* GraphStats ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
 
 double GraphStats::rms() const
 {
@@ -38,3 +392,43 @@ double GraphStats::stdDev() const
 }
 
 
+// Bin nt scans of nc adjacent channels starting at d (scan
+// stride nC). Bin ib spans scans [ib*dwnSmp, (ib+1)*dwnSmp),
+// the last one possibly short, sampled every step'th scan.
+// Channel c's bin max and min (times ysc) go to ymax, ymin
+// [c*ystride + ib]. If S, every sample is added to S[c].
+//
+void GraphStats::binMax(
+    float           *ymax,
+    float           *ymin,
+    int             ystride,
+    GraphStats      *S,
+    const qint16    *d,
+    int             nt,
+    int             nC,
+    int             nc,
+    int             dwnSmp,
+    int             step,
+    float           ysc )
+{
+    GSBin   B;
+
+    B.ymax      = ymax;
+    B.ymin      = ymin;
+    B.S         = S;
+    B.d         = d;
+    B.tstep     = qint64(step) * nC;
+    B.ystride   = ystride;
+    B.nt        = nt;
+    B.nC        = nC;
+    B.dwnSmp    = dwnSmp;
+    B.step      = step;
+    B.ysc       = ysc;
+
+    if( (dwnSmp + step - 1) / step > GS_MAXBINSMP )
+        gsBin_scalar( B, 0, nc );
+    else
+        gsBin( B, 0, nc );
+}
+
+
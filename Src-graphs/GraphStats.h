@@ -18,9 +18,24 @@ public:
     GraphStats()                {clear();}
     void clear()                {s1 = s2 = num = 0;}
     inline void add( int v )    {s1 += v, s2 += v*v, ++num;}
+    inline void addSums( qint64 S1, qint64 S2, uint n )
+        {s1 += S1, s2 += S2, num += n;}
     double mean() const {return (num > 1 ? s1/num : s1);}
     double rms() const;
     double stdDev() const;
+
+    static void binMax(
+        float           *ymax,
+        float           *ymin,
+        int             ystride,
+        GraphStats      *S,
+        const qint16    *d,
+        int             nt,
+        int             nC,
+        int             nc,
+        int             dwnSmp,
+        int             step,
+        float           ysc );
 };
 
 #endif  // GRAPHSTATS_H
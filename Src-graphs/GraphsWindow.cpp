@@ -117,6 +117,27 @@ void GraphsWindow::eraseGraphs()
         rW->eraseGraphs();
 }
 
+// Window kept from the previous run with the same streams and
+// maps. Views and their filters stay; the toolbar and LEDs hold
+// run state (name, times, recording) so are made afresh.
+//
+void GraphsWindow::reuseForRun()
+{
+    if( igw == 0 ) {
+
+        removeToolBar( tbar );
+        delete tbar;
+        addToolBar( tbar = new RunToolbar( this, p ) );
+
+        statusBar()->removeWidget( LED );
+        delete LED;
+        statusBar()->addPermanentWidget( LED = new GWLEDWidget( p ) );
+    }
+
+    eraseGraphs();
+    updateRHSFlags();
+}
+
 /* ---------------------------------------------------------------- */
 /* Slots ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -379,10 +400,19 @@ void GraphsWindow::hideEvent( QHideEvent *e )
 
 
 // Detect window minimized: pause graphing if so.
+// Detect (de)activation: background refresh rate.
 //
 void GraphsWindow::changeEvent( QEvent *e )
 {
-    if( e->type() == QEvent::WindowStateChange ) {
+    if( e->type() == QEvent::ActivationChange ) {
+
+        QMetaObject::invokeMethod(
+            mainApp()->getRun(),
+            "grfBkgndUpdate",
+            Qt::QueuedConnection,
+            Q_ARG(int, igw) );
+    }
+    else if( e->type() == QEvent::WindowStateChange ) {
 
         QWindowStateChangeEvent *wsce =
             static_cast<QWindowStateChangeEvent*>( e );
@@ -57,6 +57,7 @@ public:
 
 // Run
     void eraseGraphs();
+    void reuseForRun();
 
 public slots:
 // View control
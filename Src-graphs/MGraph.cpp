@@ -4,14 +4,27 @@
 #include "MainApp.h"
 
 #include <QDesktopWidget>
+#include <QImage>
 #include <QPoint>
 #include <QMouseEvent>
+#include <QOpenGLBuffer>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
 #include <QPainter>
 #include <QScrollBar>
+#include <QTimer>
 #include <QVBoxLayout>
 
 #include <math.h>
 
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#define MG_SSE2
+#include <emmintrin.h>
+#endif
+
 #ifdef Q_WS_MACX
 #include <gl.h>
 #include <agl.h>
@@ -61,6 +74,8 @@ void MGraphY::resize( int n )
 // Notes
 // -----
 // fixedNGrf: If > 0, resize() uses this to set ypxPerGrf.
+// lblGen: Clients editing Y labels call labelsChanged(),
+// so MGraph rebuilds its cached label quads.
 //
 MGraphX::MGraphX()
 {
@@ -79,6 +94,7 @@ MGraphX::MGraphX()
     fixedNGrf       = -1;
     ypxPerGrf       = 10;
     clipTop         = 0;
+    lblGen          = 0;
     gridStipplePat  = 0xf0f0; // 4pix on 4 off 4 on 4 off
     drawCursor      = true;
     isXsel          = false;
@@ -113,7 +129,10 @@ void MGraphX::initVerts( int n )
 {
     verts.resize( n );
     verts2x.resize( 2 * n );
-    vdigclr.resize( 3 * n );
+    vdig.resize( 2 * n + 2 );
+    vdigclr.resize( 3 * (2 * n + 2) );
+    dword.resize( n );
+    dedge.resize( n );
 
     for( int i = 0; i < n; ++i )
         verts[i].x = i;
@@ -214,11 +233,15 @@ void MGraphX::calcYpxPerGrf()
         ypxPerGrf = G->height() / fixedNGrf;
 
     ypxPerGrf = qMax( ypxPerGrf, 1 );
+
+    labelsChanged();
 }
 
 
 void MGraphX::setYSelByUsrChan( int usrChan )
 {
+    labelsChanged();
+
     ySel = -1;
 
     if( usrChan < 0 )
@@ -246,6 +269,27 @@ int MGraphX::getSelY0()
 }
 
 
+// Rows [iy0,iyLim) in the scrolled view or within a page of
+// it; all rows if not attached. Like clipTop, read unlocked:
+// a stale answer only costs fidelity for one fetch.
+//
+void MGraphX::visRows( int &iy0, int &iyLim ) const
+{
+    int ny = Y.size();
+
+    iy0     = 0;
+    iyLim   = ny;
+
+    if( !G || ny <= 1 )
+        return;
+
+    int hgt = G->height();
+
+    iy0     = qMax( (clipTop - hgt) / ypxPerGrf, 0 );
+    iyLim   = qMin( (clipTop + 2*hgt) / ypxPerGrf + 1, ny );
+}
+
+
 void MGraphX::setXSelRange( float begin_x, float end_x )
 {
     if( begin_x <= end_x ) {
@@ -337,6 +381,583 @@ void MGraphX::applyGLTraceClr( int iy ) const
     glColor4f( C.redF(), C.greenF(), C.blueF(), C.alphaF() );
 }
 
+/* ---------------------------------------------------------------- */
+/* MGraphGPU ------------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+// GPU-side analog traces.
+//
+// Each trace's yval ring is mirrored in a vertex buffer with
+// the same slot layout, so a frame uploads only the slots put
+// since the last one (see WrapBuffer::putCount). A shared
+// buffer holds x = slot index, and a vertex shader applies
+// each trace's offset and scale (uniforms) under the fixed-
+// function matrices, so the CPU no longer touches vertices.
+//
+// If shaders aren't available, init() fails and MGraph keeps
+// drawing from client-side arrays.
+//
+// All methods called with the owner's context current.
+
+class MGraphGPU {
+private:
+    struct Trace {
+        QOpenGLBuffer   vbo;
+        const MGraphY   *Y;
+        quint64         putCt;
+        uint            gen;
+        int             cap;
+        Trace() : vbo(QOpenGLBuffer::VertexBuffer),
+                  Y(0), putCt(0), gen(0), cap(0)    {}
+    };
+private:
+    QOpenGLShaderProgram    prog;
+    QOpenGLBuffer           xVBO;
+    std::vector<Trace*>     vT;
+    QOpenGLFunctions        *f;
+    int                     nX,
+                            locY,
+                            locY0,
+                            locScl;
+public:
+    MGraphGPU() : xVBO(QOpenGLBuffer::VertexBuffer), f(0), nX(0)    {}
+    virtual ~MGraphGPU();
+
+    bool init( QOpenGLFunctions *f );
+    void draw1Analog( int iy, const MGraphY *Y, float y0, float scl );
+
+private:
+    void sync( Trace &T, const MGraphY *Y );
+};
+
+
+MGraphGPU::~MGraphGPU()
+{
+    for( int i = 0, n = vT.size(); i < n; ++i )
+        delete vT[i];
+}
+
+
+// Attribute x is bound to 0 so no array aliases gl_Vertex.
+//
+bool MGraphGPU::init( QOpenGLFunctions *f )
+{
+    this->f = f;
+
+    if( !QOpenGLShaderProgram::hasOpenGLShaderPrograms() )
+        return false;
+
+    bool    ok =
+        prog.addShaderFromSourceCode( QOpenGLShader::Vertex,
+            "attribute float x;\n"
+            "attribute float y;\n"
+            "uniform float y0;\n"
+            "uniform float scl;\n"
+            "void main() {\n"
+            "    gl_Position = gl_ModelViewProjectionMatrix"
+            " * vec4( x, y0 + scl * y, 0.0, 1.0 );\n"
+            "    gl_FrontColor = gl_Color;\n"
+            "}\n" )
+        && prog.addShaderFromSourceCode( QOpenGLShader::Fragment,
+            "void main() {\n"
+            "    gl_FragColor = gl_Color;\n"
+            "}\n" );
+
+    if( ok ) {
+        prog.bindAttributeLocation( "x", 0 );
+        ok = prog.link();
+    }
+
+    if( !ok || !xVBO.create() ) {
+        Warning() << "MGraph: GPU traces unavailable: " << prog.log();
+        return false;
+    }
+
+    locY    = prog.attributeLocation( "y" );
+    locY0   = prog.uniformLocation( "y0" );
+    locScl  = prog.uniformLocation( "scl" );
+
+    return locY >= 0;
+}
+
+
+// The whole ring is drawn, as for the client array path.
+//
+void MGraphGPU::draw1Analog(
+    int             iy,
+    const MGraphY   *Y,
+    float           y0,
+    float           scl )
+{
+    int len = Y->yval.capacity();
+
+    if( len < 2 )
+        return;
+
+// Shared x
+
+    xVBO.bind();
+
+    if( nX < len ) {
+
+        std::vector<float>  x( len );
+
+        for( int i = 0; i < len; ++i )
+            x[i] = i;
+
+        xVBO.allocate( &x[0], len * sizeof(float) );
+        nX = len;
+    }
+
+// Trace y
+
+    while( int(vT.size()) <= iy )
+        vT.push_back( new Trace );
+
+    Trace   &T = *vT[iy];
+
+    sync( T, Y );
+
+// Draw
+
+    glDisableClientState( GL_VERTEX_ARRAY );
+    prog.bind();
+    prog.setUniformValue( locY0, y0 );
+    prog.setUniformValue( locScl, scl );
+
+    xVBO.bind();
+    f->glVertexAttribPointer( 0, 1, GL_FLOAT, GL_FALSE, 0, 0 );
+    f->glEnableVertexAttribArray( 0 );
+
+    T.vbo.bind();
+    f->glVertexAttribPointer( locY, 1, GL_FLOAT, GL_FALSE, 0, 0 );
+    f->glEnableVertexAttribArray( locY );
+
+    glDrawArrays( GL_LINE_STRIP, 0, len );
+
+    f->glDisableVertexAttribArray( locY );
+    f->glDisableVertexAttribArray( 0 );
+    T.vbo.release();
+    prog.release();
+    glEnableClientState( GL_VERTEX_ARRAY );
+}
+
+
+// Upload whole ring if the trace, its size or generation changed,
+// or if a lap or more was put; else just the slots put since the
+// last sync, which end at cursor().
+//
+void MGraphGPU::sync( Trace &T, const MGraphY *Y )
+{
+    const float *y;
+    int         cap = Y->yval.all( (float* &)y );
+    quint64     put = Y->yval.putCount();
+    uint        gen = Y->yval.generation();
+
+    if( !T.vbo.isCreated() ) {
+        T.vbo.create();
+        T.vbo.setUsagePattern( QOpenGLBuffer::DynamicDraw );
+    }
+
+    T.vbo.bind();
+
+    if( T.cap != cap ) {
+        T.vbo.allocate( y, cap * sizeof(float) );
+        T.cap = cap;
+    }
+    else if( T.Y != Y || T.gen != gen || put - T.putCt >= quint64(cap) )
+        T.vbo.write( 0, y, cap * sizeof(float) );
+    else if( put > T.putCt ) {
+
+        int n   = int(put - T.putCt),
+            s0  = (Y->yval.cursor() + cap - n) % cap,
+            n1  = qMin( n, cap - s0 );
+
+        T.vbo.write( s0 * sizeof(float), &y[s0], n1 * sizeof(float) );
+
+        if( n -= n1 )
+            T.vbo.write( 0, y, n * sizeof(float) );
+    }
+
+    T.Y     = Y;
+    T.putCt = put;
+    T.gen   = gen;
+}
+
+/* ---------------------------------------------------------------- */
+/* MGraphText ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Batched graph labels.
+//
+// Printable ASCII is rendered once per label font into an alpha
+// texture (glyph atlas). The labels of all graphs are kept as
+// textured quads in unscrolled window pixels, rebuilt only when
+// layout, selection or labels change (see MGraphX::labelsChanged)
+// or the width or graph count does. A frame draws the quads of
+// the visible rows in one call, tinted by the current color.
+//
+// All methods called with the owner's context current.
+
+#define MGTXT_C0    32      // ' '
+#define MGTXT_NC    95      // ' '..'~'
+#define MGTXT_COLS  16
+
+class MGraphText {
+private:
+    struct Glyph {
+        float   s0, s1,
+                t0, t1;
+        int     adv;
+    };
+    struct Key {
+        int     ypx, W, ny, gen;
+        Key() : ypx(0), W(0), ny(0), gen(-1)    {}
+        Key( int ypx, int W, int ny, int gen )
+        :   ypx(ypx), W(W), ny(ny), gen(gen)    {}
+        bool operator==( const Key &rhs ) const
+            {return ypx == rhs.ypx && W == rhs.W
+                    && ny == rhs.ny && gen == rhs.gen;}
+    };
+private:
+    Glyph               G[MGTXT_NC];
+    std::vector<float>  vV,     // 2 float/vtx, 4 vtx/glyph
+                        vT;
+    std::vector<int>    rowQ,   // row iy quads [rowQ[iy],rowQ[iy+1])
+                        rowY;   // row iy baseline
+    Key                 K;
+    qreal               fontDpr;
+    GLuint              tex;
+    int                 fontPts,
+                        asc,
+                        hgt,
+                        ftHt,
+                        sWid;
+public:
+    MGraphText()
+    :   fontDpr(0), tex(0), fontPts(0),
+        asc(0), hgt(0), ftHt(0), sWid(0)    {}
+    virtual ~MGraphText();
+
+    void draw( const MGraphX *X, int W, int H, qreal dpr );
+
+private:
+    void loadFont( int pts, qreal dpr );
+    void build( const MGraphX *X, int W );
+    void addStr( const QString &s, int x, int y );
+};
+
+
+MGraphText::~MGraphText()
+{
+    if( tex )
+        glDeleteTextures( 1, &tex );
+}
+
+
+// Font size follows graph height, as before.
+//
+void MGraphText::draw( const MGraphX *X, int W, int H, qreal dpr )
+{
+    int ypx = X->ypxPerGrf,
+        pts = (ypx-3 > 12 ? 12 : qMax( ypx-3, 6 ));
+
+    if( !tex || pts != fontPts || dpr != fontDpr ) {
+        loadFont( pts, dpr );
+        K = Key();
+    }
+
+    Key k( ypx, W, X->Y.size(), X->lblGen );
+
+    if( !(k == K) ) {
+        build( X, W );
+        K = k;
+    }
+
+// Rows whose baseline is in view
+
+    int q0 = rowQ[std::lower_bound(
+                    rowY.begin(), rowY.end(), X->clipTop ) - rowY.begin()],
+        q1 = rowQ[std::upper_bound(
+                    rowY.begin(), rowY.end(), X->clipTop + H ) - rowY.begin()];
+
+    if( q1 <= q0 )
+        return;
+
+    glMatrixMode( GL_PROJECTION );
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho( 0, W, H, 0, -1, 1 );
+    glMatrixMode( GL_MODELVIEW );
+    glPushMatrix();
+    glLoadIdentity();
+    glTranslatef( 0, -X->clipTop, 0 );
+
+    glEnable( GL_TEXTURE_2D );
+    glBindTexture( GL_TEXTURE_2D, tex );
+    glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+
+    glVertexPointer( 2, GL_FLOAT, 0, &vV[0] );
+    glTexCoordPointer( 2, GL_FLOAT, 0, &vT[0] );
+    glDrawArrays( GL_QUADS, 4*q0, 4*(q1 - q0) );
+
+    glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+    glBindTexture( GL_TEXTURE_2D, 0 );
+    glDisable( GL_TEXTURE_2D );
+
+    glPopMatrix();
+    glMatrixMode( GL_PROJECTION );
+    glPopMatrix();
+    glMatrixMode( GL_MODELVIEW );
+}
+
+
+// Glyphs are white on clear, one cell per char, with a pixel
+// margin either side of the advance. Only alpha is uploaded;
+// the default GL_MODULATE texture env supplies the color.
+//
+void MGraphText::loadFont( int pts, qreal dpr )
+{
+    QFont   font = QFont();
+
+    font.setPointSize( pts );
+    font.setWeight( pts >= 10 ? QFont::DemiBold : QFont::Bold );
+
+    QFontMetrics    FM( font );
+
+    asc     = FM.ascent();
+    hgt     = FM.height();
+    ftHt    = FM.boundingRect( 'A' ).height();
+    sWid    = FM.width( 'S' );
+
+    int cellW   = FM.maxWidth() + 2,
+        rows    = (MGTXT_NC + MGTXT_COLS - 1) / MGTXT_COLS,
+        aw      = int(ceil( MGTXT_COLS * cellW * dpr )),
+        ah      = int(ceil( rows * hgt * dpr ));
+
+    QImage  img( aw, ah, QImage::Format_ARGB32_Premultiplied );
+    img.fill( Qt::transparent );
+
+    QPainter    p( &img );
+
+    p.scale( dpr, dpr );
+    p.setFont( font );
+    p.setPen( Qt::white );
+    p.setRenderHints(
+        QPainter::Antialiasing | QPainter::TextAntialiasing );
+
+    for( int i = 0; i < MGTXT_NC; ++i ) {
+
+        QChar   c( MGTXT_C0 + i );
+        Glyph   &g  = G[i];
+        int     x   = (i % MGTXT_COLS) * cellW,
+                y   = (i / MGTXT_COLS) * hgt;
+
+        p.drawText( x + 1, y + asc, QString( c ) );
+
+        g.adv   = FM.width( c );
+        g.s0    = x * dpr / aw;
+        g.s1    = (x + g.adv + 2) * dpr / aw;
+        g.t0    = y * dpr / ah;
+        g.t1    = (y + hgt) * dpr / ah;
+    }
+
+    p.end();
+
+    std::vector<uchar>  A( aw * ah );
+
+    for( int y = 0; y < ah; ++y ) {
+
+        const QRgb  *L = (const QRgb*)img.constScanLine( y );
+        uchar       *a = &A[y * aw];
+
+        for( int x = 0; x < aw; ++x )
+            a[x] = qAlpha( L[x] );
+    }
+
+    if( !tex )
+        glGenTextures( 1, &tex );
+
+    glBindTexture( GL_TEXTURE_2D, tex );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+    glTexImage2D( GL_TEXTURE_2D, 0, GL_ALPHA, aw, ah, 0,
+        GL_ALPHA, GL_UNSIGNED_BYTE, &A[0] );
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+    glBindTexture( GL_TEXTURE_2D, 0 );
+
+    fontPts = pts;
+    fontDpr = dpr;
+}
+
+
+// Placement: lhs at x = 4, rhs right-aligned by 'S' widths,
+// baselines at a fixed offset in each row.
+//
+void MGraphText::build( const MGraphX *X, int W )
+{
+    int     ny      = X->Y.size(),
+            ypx     = X->ypxPerGrf,
+            right   = W - 4;
+    float   offset  = (ypx > 2.25 * ftHt ? 0.25F : 0.5F);
+
+    vV.clear();
+    vT.clear();
+    rowQ.resize( ny + 1 );
+    rowY.resize( ny );
+
+    for( int iy = 0; iy < ny; ++iy ) {
+
+        const MGraphY   *Y = X->Y[iy];
+        int             yb = ftHt / 2 + int((iy + offset) * ypx);
+
+        rowQ[iy] = vV.size() / 8;
+        rowY[iy] = yb;
+
+        if( !Y->lhsLabel.isEmpty() )
+            addStr( Y->lhsLabel, 4, yb );
+
+        if( !Y->rhsLabel.isEmpty() )
+            addStr( Y->rhsLabel, right - Y->rhsLabel.size() * sWid, yb );
+    }
+
+    rowQ[ny] = vV.size() / 8;
+}
+
+
+void MGraphText::addStr( const QString &s, int x, int y )
+{
+    float   T = y - asc,
+            B = T + hgt;
+
+    for( int i = 0, n = s.size(); i < n; ++i ) {
+
+        int c = s[i].unicode() - MGTXT_C0;
+
+        if( c < 0 || c >= MGTXT_NC )
+            c = '?' - MGTXT_C0;
+
+        const Glyph &g = G[c];
+
+        if( c ) {
+
+            float   L = x - 1,
+                    R = x + g.adv + 1;
+
+            vV.push_back( L );  vV.push_back( T );
+            vV.push_back( L );  vV.push_back( B );
+            vV.push_back( R );  vV.push_back( B );
+            vV.push_back( R );  vV.push_back( T );
+
+            vT.push_back( g.s0 );   vT.push_back( g.t0 );
+            vT.push_back( g.s0 );   vT.push_back( g.t1 );
+            vT.push_back( g.s1 );   vT.push_back( g.t1 );
+            vT.push_back( g.s1 );   vT.push_back( g.t0 );
+        }
+
+        x += g.adv;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+/* Digital edges -------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Digital rows hold 16-bit words as floats (exact). Words are
+// packed once per frame, then only samples where some bit
+// changed are listed, so each line's trace costs its edges,
+// not its samples.
+
+// Pack n words of y, as quint16(y[i]), to w.
+//
+static void mgPackWords( quint16 *w, const float *y, int n )
+{
+    int i = 0;
+
+#ifdef MG_SSE2
+    // Keep low 16 bits of each int, sign-extended so the
+    // saturating pack is exact.
+
+    for( ; i + 8 <= n; i += 8 ) {
+
+        __m128i a = _mm_cvttps_epi32( _mm_loadu_ps( y + i ) ),
+                b = _mm_cvttps_epi32( _mm_loadu_ps( y + i + 4 ) );
+
+        a = _mm_srai_epi32( _mm_slli_epi32( a, 16 ), 16 );
+        b = _mm_srai_epi32( _mm_slli_epi32( b, 16 ), 16 );
+
+        _mm_storeu_si128( (__m128i*)(w + i), _mm_packs_epi32( a, b ) );
+    }
+#endif
+
+    for( ; i < n; ++i )
+        w[i] = quint16(y[i]);
+}
+
+
+// Set e to indices i in [1,n) where w[i] != w[i-1].
+// Return their count.
+//
+static int mgEdgeIdx( quint32 *e, const quint16 *w, int n )
+{
+    int ne  = 0,
+        i   = 1;
+
+#ifdef MG_SSE2
+    __m128i zero = _mm_setzero_si128();
+
+    for( ; i + 8 <= n; i += 8 ) {
+
+        __m128i t = _mm_xor_si128(
+                        _mm_loadu_si128( (const __m128i*)(w + i) ),
+                        _mm_loadu_si128( (const __m128i*)(w + i - 1) ) );
+        int     m = ~_mm_movemask_epi8( _mm_cmpeq_epi16( t, zero ) ) & 0xFFFF;
+
+        // Two mask bits per lane
+
+        for( int l = 0; m; ++l, m >>= 2 ) {
+
+            if( m & 1 )
+                e[ne++] = i + l;
+        }
+    }
+#endif
+
+    for( ; i < n; ++i ) {
+
+        if( w[i] != w[i-1] )
+            e[ne++] = i;
+    }
+
+    return ne;
+}
+
+
+// Append vertex (x, level b) to a digital strip, colored from
+// cgrp's dark (b = 0) or bright entry.
+//
+static inline void mgDigVtx(
+    Vec2f           *V,
+    quint8          *C,
+    int             &nv,
+    uint            x,
+    int             b,
+    float           y0,
+    float           y1,
+    const quint8    *cgrp )
+{
+    const quint8    *csrc = cgrp + 3*b;
+    quint8          *cdst = C + 3*nv;
+
+    V[nv++] = Vec2f( x, (b ? y1 : y0) );
+    cdst[0] = csrc[0];
+    cdst[1] = csrc[1];
+    cdst[2] = csrc[2];
+}
+
 /* ---------------------------------------------------------------- */
 /* MGraph --------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -372,6 +993,12 @@ static SharedData   shr;
 #endif
 
 
+// Live updates are paced so painting takes about 1/MGRAPH_PACE
+// of wall time per graph, but never wait more than MGRAPH_MAXWAITMS.
+#define MGRAPH_PACE         4
+#define MGRAPH_MAXWAITMS    500
+
+
 QMap<QString,MGraph::shrRef>  MGraph::usr2Ref;
 
 
@@ -383,12 +1010,17 @@ MGraph::MGraph( const QString &usr, QWidget *parent, MGraphX *X )
 #else
     :   QGLWidget(shr.fmt, parent), usr(usr),
 #endif
-        X(X), ownsX(false)
+        X(X), gpu(0), txt(0), paintSecs(0), tPainted(0),
+        ownsX(false), gpuTried(false)
 {
 #ifdef OPENGL54
     Q_UNUSED( usr )
 #endif
 
+    liveTimer = new QTimer( this );
+    liveTimer->setSingleShot( true );
+    ConnectUI( liveTimer, SIGNAL(timeout()), this, SLOT(update()) );
+
     if( X ) {
         ownsX = true;
         attach( X );
@@ -402,6 +1034,8 @@ MGraph::MGraph( const QString &usr, QWidget *parent, MGraphX *X )
 
 MGraph::~MGraph()
 {
+    cleanupGL();
+
     if( X && ownsX )
         delete X;
 
@@ -424,6 +1058,9 @@ void MGraph::attach( MGraphX *newX )
         newX->attach( this );
         X = newX;
 
+        trc.clear();
+        baseKey = BaseKey();
+
         immed_update    = false;
         need_update     = false;
         setMouseTracking( true );
@@ -443,6 +1080,9 @@ void MGraph::detach()
         X->detach();
         X = 0;
     }
+
+    trc.clear();
+    baseKey = BaseKey();
 }
 
 
@@ -452,6 +1092,11 @@ void MGraph::initializeGL()
 {
 #ifdef OPENGL54
     initializeOpenGLFunctions();
+
+    Connect(
+        context(), SIGNAL(aboutToBeDestroyed()),
+        this, SLOT(cleanupGL()),
+        Qt::DirectConnection );
 #endif
 
     glDisable( GL_DEPTH_TEST );
@@ -464,6 +1109,52 @@ void MGraph::initializeGL()
 }
 
 
+// Release GPU traces and label atlas while our context still
+// exists; they're rebuilt on next draw if a new context is made.
+//
+void MGraph::cleanupGL()
+{
+    if( gpu || txt ) {
+
+        makeCurrent();
+
+        if( gpu ) {
+            delete gpu;
+            gpu = 0;
+        }
+
+        if( txt ) {
+            delete txt;
+            txt = 0;
+        }
+
+        doneCurrent();
+    }
+
+    gpuTried = false;
+}
+
+
+// Fetchers call this (queued) as new data arrive. If painting
+// has been costly, the update is deferred so that frame rate
+// adapts to frame cost: many probes on a slow machine get a
+// lower rate instead of a saturated GUI thread. Requests made
+// while one is pending coalesce into it.
+//
+void MGraph::updateLive()
+{
+    if( liveTimer->isActive() )
+        return;
+
+    double  wait = MGRAPH_PACE * paintSecs - (getTime() - tPainted);
+
+    if( wait <= 0 )
+        update();
+    else
+        liveTimer->start( qMin( int(1000 * wait) + 1, MGRAPH_MAXWAITMS ) );
+}
+
+
 // Note: makeCurrent() called automatically.
 //
 void MGraph::resizeGL( int w, int h )
@@ -488,6 +1179,8 @@ void MGraph::paintGL()
     if( !X || !isVisible() || !width() || !height() )
         return;
 
+    double  t0 = getTime();
+
 // -----
 // Setup
 // -----
@@ -527,6 +1220,9 @@ void MGraph::paintGL()
 // -------
 
     X->dataMtx.unlock();
+
+    tPainted    = getTime();
+    paintSecs   = 0.8 * paintSecs + 0.2 * (tPainted - t0);
 }
 
 
@@ -673,30 +1369,87 @@ void MGraph::win2LogicalCoords( double &x, double &y, int iy )
 }
 
 
+// Return true if trace iy's cached vertices T are current for
+// its data (put count, generation) and placement (y0, scl),
+// else restamp T for the caller to rebuild.
+//
+bool MGraph::trCached( TrCache* &T, int iy, uint len, float y0, float scl )
+{
+    const MGraphY   *Y = X->Y[iy];
+
+    if( int(trc.size()) <= iy )
+        trc.resize( iy + 1 );
+
+    T = &trc[iy];
+
+    quint64 put     = Y->yval.putCount(),
+            put2    = Y->yval2.putCount();
+    uint    gen     = Y->yval.generation(),
+            gen2    = Y->yval2.generation();
+
+    if( T->Y == Y
+        && T->put == put && T->put2 == put2
+        && T->gen == gen && T->gen2 == gen2
+        && T->len == len && T->y0 == y0 && T->scl == scl ) {
+
+        return true;
+    }
+
+    T->Y    = Y;
+    T->put  = put;
+    T->put2 = put2;
+    T->gen  = gen;
+    T->gen2 = gen2;
+    T->len  = len;
+    T->y0   = y0;
+    T->scl  = scl;
+
+    return false;
+}
+
+
 // Draw each graph's y = 0.
 //
+// All visible baselines in one draw call; the vertices are
+// kept while layout and scroll position are unchanged.
+//
 void MGraph::drawBaselines()
 {
-    GLfloat h[] = {0.0F, 0.0F, 1.0F, 0.0F};
-
     int     clipHgt = height();
     float   yscl    = 2.0F / clipHgt;
 
-    for( int iy = 0, ny = X->Y.size(); iy < ny; ++iy ) {
+    if( baseKey.ypx != X->ypxPerGrf
+        || baseKey.top != X->clipTop
+        || baseKey.hgt != clipHgt
+        || baseKey.ny  != int(X->Y.size()) ) {
 
-        if( X->Y[iy]->isDigType )
-            continue;
+        baseKey.ypx = X->ypxPerGrf;
+        baseKey.top = X->clipTop;
+        baseKey.hgt = clipHgt;
+        baseKey.ny  = int(X->Y.size());
 
-        float   y0_px = (iy+0.5F)*X->ypxPerGrf;
+        baseVs.clear();
 
-        if( y0_px < X->clipTop || y0_px > X->clipTop + clipHgt )
-            continue;
+        for( int iy = 0, ny = X->Y.size(); iy < ny; ++iy ) {
 
-        float   y0 = 1.0F - yscl*(y0_px - X->clipTop);
+            if( X->Y[iy]->isDigType )
+                continue;
 
-        h[1] = h[3] = y0;
-        glVertexPointer( 2, GL_FLOAT, 0, h );
-        glDrawArrays( GL_LINES, 0, 2 );
+            float   y0_px = (iy+0.5F)*X->ypxPerGrf;
+
+            if( y0_px < X->clipTop || y0_px > X->clipTop + clipHgt )
+                continue;
+
+            float   y0 = 1.0F - yscl*(y0_px - X->clipTop);
+
+            baseVs.push_back( Vec2f( 0.0F, y0 ) );
+            baseVs.push_back( Vec2f( 1.0F, y0 ) );
+        }
+    }
+
+    if( baseVs.size() ) {
+        glVertexPointer( 2, GL_FLOAT, 0, &baseVs[0] );
+        glDrawArrays( GL_LINES, 0, baseVs.size() );
     }
 }
 
@@ -756,84 +1509,20 @@ void MGraph::drawGrid()
 }
 
 
+// Labels come batched from the glyph atlas (see MGraphText).
+//
 void MGraph::drawLabels()
 {
-// ----
-// Save
-// ----
+    if( !txt )
+        txt = new MGraphText;
 
     GLfloat savedClr[4];
-    GLint   savedPat = 0, savedRepeat = 0;
-    bool    wasEnabled = glIsEnabled( GL_LINE_STIPPLE );
-
     glGetFloatv( GL_CURRENT_COLOR, savedClr );
-    glGetIntegerv( GL_LINE_STIPPLE_PATTERN, &savedPat );
-    glGetIntegerv( GL_LINE_STIPPLE_REPEAT, &savedRepeat );
-
-// -----
-// Setup
-// -----
 
     X->applyGLLabelClr();
-
-    if( !wasEnabled )
-        glEnable( GL_LINE_STIPPLE );
-
-// ------
-// Labels
-// ------
-
-    QFont   font = QFont();
-
-    font.setPointSize(X->ypxPerGrf-3 > 12 ? 12 : qMax(X->ypxPerGrf-3, 6));
-    font.setWeight(font.pointSize() >= 10 ? QFont::DemiBold : QFont::Bold);
-
-    QFontMetrics    FM( font );
-    int             clipHgt = height(),
-                    right   = width() - 4,
-                    ftHt    = FM.boundingRect( 'A' ).height(),
-                    fontMid = ftHt / 2 - X->clipTop;
-    float           offset  = (X->ypxPerGrf > 2.25 * ftHt ? 0.25F : 0.5F);
-
-    for( int iy = 0, ny = X->Y.size(); iy < ny; ++iy ) {
-
-        bool    isL = !X->Y[iy]->lhsLabel.isEmpty(),
-                isR = !X->Y[iy]->rhsLabel.isEmpty();
-
-        if( !(isL || isR) )
-            continue;
-
-        float   y_base = fontMid + (iy + offset)*X->ypxPerGrf;
-
-        if( y_base < 0 || y_base > clipHgt )
-            continue;
-
-        if( isL ) {
-
-            renderTextWin(
-                4,
-                y_base,
-                X->Y[iy]->lhsLabel, font );
-        }
-
-        if( isR ) {
-
-            renderTextWin(
-                right - X->Y[iy]->rhsLabel.size() * FM.width( 'S' ),
-                y_base,
-                X->Y[iy]->rhsLabel, font );
-        }
-    }
-
-// -------
-// Restore
-// -------
+    txt->draw( X, width(), height(), devicePixelRatio() );
 
     glColor4f( savedClr[0], savedClr[1], savedClr[2], savedClr[3] );
-    glLineStipple( savedRepeat, savedPat );
-
-    if( !wasEnabled )
-        glDisable( GL_LINE_STIPPLE );
 }
 
 
@@ -1043,11 +1732,13 @@ void MGraph::drawEvents()
 // Here we'll work again in yval units [-1,1],
 // hence, adopt the same scale = ypxPerGrf/clipHgt.
 //
+// Each line is a strip through its first sample, the sample
+// pair around each of its transitions, and its last sample:
+// the same trace as a vertex per sample, less collinear runs.
+//
 void MGraph::draw1Digital( int iy )
 {
-    glEnableClientState( GL_COLOR_ARRAY );
-
-    std::vector<Vec2f>  &V      = X->verts;
+    std::vector<Vec2f>  &V      = X->vdig;
     std::vector<quint8> &C      = X->vdigclr;
     MGraphY             *Y      = X->Y[iy];
     const float         *y;
@@ -1062,37 +1753,76 @@ void MGraph::draw1Digital( int iy )
             ht      = scl * (2.0F - 2*mrg) / 16;
     uint    len     = Y->yval.all( (float* &)y );
 
-// Compose a WHITE color group and a GREEN group.
-// WHITE-dark1, WHITE-bright1, GREEN-dark2, GREEN-bright2.
-// Each set of 4 lines will use the WHITE or GREEN group.
+    if( !len )
+        return;
 
-    quint8  clrs[(3*2)*2] = {
-                90,90,90,   // 80,80,80
-                250,250,250,
-                100,100,20, // 70,100,20
-                120,255,0};
+    TrCache *T;
 
-    for( int line = 0; line < 16; ++line ) {
+    if( !trCached( T, iy, len, lo, scl ) ) {
 
-        float   y0      = lo + off + line * ht;
-        quint8  *cgrp   = &clrs[6*((line / 4) & 1)];    // which group
+        quint16 *w  = &X->dword[0];
+        quint32 *e  = &X->dedge[0];
+        int     ne;
 
-        for( uint i = 0; i < len; ++i ) {
+        mgPackWords( w, y, len );
+        ne = mgEdgeIdx( e, w, len );
+
+        // Compose a WHITE color group and a GREEN group.
+        // WHITE-dark1, WHITE-bright1, GREEN-dark2, GREEN-bright2.
+        // Each set of 4 lines will use the WHITE or GREEN group.
+
+        quint8  clrs[(3*2)*2] = {
+                    90,90,90,   // 80,80,80
+                    250,250,250,
+                    100,100,20, // 70,100,20
+                    120,255,0};
+
+        T->V.clear();
+        T->C.clear();
+
+        for( int line = 0; line < 16; ++line ) {
+
+            float   y0      = lo + off + line * ht,
+                    y1      = y0 + 0.80F * ht;
+            quint8  *cgrp   = &clrs[6*((line / 4) & 1)];    // which group
+            int     b       = (w[0] >> line) & 1,
+                    nv      = 0;
+            uint    last    = 0;
 
-            quint8  *cdst   = &C[3*i];
-            int     b       = (quint16(y[i]) >> line) & 1;
-//            int     b       = (((quint32*)y)[i] >> (line+16)) & 1; // test
-            quint8  *csrc   = cgrp + 3*b;
+            mgDigVtx( &V[0], &C[0], nv, 0, b, y0, y1, cgrp );
 
-            V[i].y  = y0 + 0.80F * ht * b;
-            cdst[0] = csrc[0];
-            cdst[1] = csrc[1];
-            cdst[2] = csrc[2];
+            for( int k = 0; k < ne; ++k ) {
+
+                uint    i = e[k];
+
+                if( !(((w[i] ^ w[i-1]) >> line) & 1) )
+                    continue;
+
+                if( last != i - 1 )
+                    mgDigVtx( &V[0], &C[0], nv, i - 1, b, y0, y1, cgrp );
+
+                b ^= 1;
+                mgDigVtx( &V[0], &C[0], nv, i, b, y0, y1, cgrp );
+                last = i;
+            }
+
+            if( last != len - 1 )
+                mgDigVtx( &V[0], &C[0], nv, len - 1, b, y0, y1, cgrp );
+
+            T->V.insert( T->V.end(), V.begin(), V.begin() + nv );
+            T->C.insert( T->C.end(), C.begin(), C.begin() + 3 * nv );
+            T->nv[line] = nv;
         }
+    }
 
-        glColorPointer( 3, GL_UNSIGNED_BYTE, 0, &C[0] );
-        glVertexPointer( 2, GL_FLOAT, 0, &V[0] );
-        glDrawArrays( GL_LINE_STRIP, 0, len );
+    glEnableClientState( GL_COLOR_ARRAY );
+
+    for( int line = 0, v0 = 0; line < 16; ++line ) {
+
+        glColorPointer( 3, GL_UNSIGNED_BYTE, 0, &T->C[3 * v0] );
+        glVertexPointer( 2, GL_FLOAT, 0, &T->V[v0] );
+        glDrawArrays( GL_LINE_STRIP, 0, T->nv[line] );
+        v0 += T->nv[line];
     }
 
     glDisableClientState( GL_COLOR_ARRAY );
@@ -1123,12 +1853,19 @@ void MGraph::draw1BinMax( int iy )
 
     X->applyGLTraceClr( iy );
 
-    for( uint i = 0; i < len; ++i ) {
-        V[2*i].y    = y0 + scl*y[i];
-        V[2*i+1].y  = y0 + scl*y2[i];
+    TrCache *T;
+
+    if( !trCached( T, iy, len, y0, scl ) ) {
+
+        T->V.assign( V.begin(), V.begin() + 2*len );
+
+        for( uint i = 0; i < len; ++i ) {
+            T->V[2*i].y     = y0 + scl*y[i];
+            T->V[2*i+1].y   = y0 + scl*y2[i];
+        }
     }
 
-    glVertexPointer( 2, GL_FLOAT, 0, &V[0] );
+    glVertexPointer( 2, GL_FLOAT, 0, &T->V[0] );
     glDrawArrays( GL_LINE_STRIP, 0, 2*len );
 }
 
@@ -1154,10 +1891,36 @@ void MGraph::draw1Analog( int iy )
 
     X->applyGLTraceClr( iy );
 
-    for( uint i = 0; i < len; ++i )
-        V[i].y = y0 + scl*y[i];
+    if( !gpuTried ) {
 
-    glVertexPointer( 2, GL_FLOAT, 0, &V[0] );
+        gpuTried = true;
+        gpu      = new MGraphGPU;
+
+        if( !gpu->init( QOpenGLContext::currentContext()->functions() ) ) {
+            delete gpu;
+            gpu = 0;
+        }
+    }
+
+    if( gpu ) {
+        gpu->draw1Analog( iy, Y, y0, scl );
+        return;
+    }
+
+    if( !len )
+        return;
+
+    TrCache *T;
+
+    if( !trCached( T, iy, len, y0, scl ) ) {
+
+        T->V.assign( V.begin(), V.begin() + len );
+
+        for( uint i = 0; i < len; ++i )
+            T->V[i].y = y0 + scl*y[i];
+    }
+
+    glVertexPointer( 2, GL_FLOAT, 0, &T->V[0] );
     glDrawArrays( GL_LINE_STRIP, 0, len );
 }
 
@@ -1239,310 +2002,6 @@ void MGraph::drawPointsMain()
     glColor4f( savedClr[0], savedClr[1], savedClr[2], savedClr[3] );
 }
 
-
-static void qt_save_gl_state( bool bAll )
-{
-    glPushClientAttrib( GL_CLIENT_ALL_ATTRIB_BITS );
-    glPushAttrib( GL_ALL_ATTRIB_BITS );
-
-    if( bAll ) {
-
-        glMatrixMode( GL_TEXTURE );
-        glPushMatrix();
-        glLoadIdentity();
-        glMatrixMode( GL_PROJECTION );
-        glPushMatrix();
-        glMatrixMode( GL_MODELVIEW );
-        glPushMatrix();
-
-        glShadeModel( GL_FLAT );
-        glDisable( GL_CULL_FACE );
-        glDisable( GL_LIGHTING );
-        glDisable( GL_STENCIL_TEST );
-        glDisable( GL_DEPTH_TEST );
-        glEnable( GL_BLEND );
-        glBlendFunc( GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
-    }
-}
-
-
-static void qt_restore_gl_state( bool bAll )
-{
-    if( bAll ) {
-
-        glMatrixMode( GL_TEXTURE );
-        glPopMatrix();
-        glMatrixMode( GL_PROJECTION );
-        glPopMatrix();
-        glMatrixMode( GL_MODELVIEW );
-        glPopMatrix();
-    }
-
-    glPopAttrib();
-    glPopClientAttrib();
-}
-
-
-static void qt_gl_draw_text(
-    QPainter        &p,
-    int             x,
-    int             y,
-    const QString   &str,
-    const QFont     &font )
-{
-    GLfloat color[4];
-    glGetFloatv( GL_CURRENT_COLOR, &color[0] );
-
-    QColor  col;
-    col.setRgbF( color[0], color[1], color[2], color[3] );
-
-    QPen    old_pen     = p.pen();
-    QFont   old_font    = p.font();
-
-    p.setPen( col );
-    p.setFont( font );
-    p.setRenderHints(
-        QPainter::Antialiasing | QPainter::TextAntialiasing );
-    p.drawText( x, y, str );
-
-    p.setPen( old_pen );
-    p.setFont( old_font );
-}
-
-
-static inline void transformPoint(
-    GLdouble        out[4],
-    const GLdouble  m[16],
-    const GLdouble  in[4] )
-{
-#define M(row,col)   m[row+4*col]
-    out[0] =
-        M(0,0)*in[0] + M(0,1)*in[1] + M(0,2)*in[2] + M(0,3)*in[3];
-    out[1] =
-        M(1,0)*in[0] + M(1,1)*in[1] + M(1,2)*in[2] + M(1,3)*in[3];
-    out[2] =
-        M(2,0)*in[0] + M(2,1)*in[1] + M(2,2)*in[2] + M(2,3)*in[3];
-    out[3] =
-        M(3,0)*in[0] + M(3,1)*in[1] + M(3,2)*in[2] + M(3,3)*in[3];
-#undef M
-}
-
-
-static inline bool project(
-    GLdouble        *winx,
-    GLdouble        *winy,
-    GLdouble        *winz,
-    const GLint     viewport[4],
-    const GLdouble  proj[16],
-    const GLdouble  model[16],
-    GLdouble        objx,
-    GLdouble        objy,
-    GLdouble        objz )
-{
-    GLdouble    out[4], in[4];
-
-    in[0] = objx;
-    in[1] = objy;
-    in[2] = objz;
-    in[3] = 1.0;
-    transformPoint( out, model, in );
-    transformPoint( in, proj, out );
-
-    if( !in[3] ) {
-
-        *winx = 0;
-        *winy = 0;
-        *winz = 0;
-        return false;
-    }
-
-    in[0] /= in[3];
-    in[1] /= in[3];
-    in[2] /= in[3];
-
-    *winx = viewport[0] + (1 + in[0]) * viewport[2] / 2;
-    *winy = viewport[1] + (1 + in[1]) * viewport[3] / 2;
-    *winz = (1 + in[2]) / 2;
-
-    return true;
-}
-
-
-bool MGraph::isAutoBufSwap()
-{
-#ifdef OPENGL54
-    return true;
-#else
-    return autoBufferSwap();
-#endif
-}
-
-
-void MGraph::setAutoBufSwap( bool on )
-{
-#ifdef OPENGL54
-    Q_UNUSED( on )
-#else
-    setAutoBufferSwap( on );
-#endif
-}
-
-
-void MGraph::clipToView( int *view )
-{
-    GLint   _view[4];
-    bool    use_scissor_testing = glIsEnabled( GL_SCISSOR_TEST );
-
-    if( !use_scissor_testing ) {
-
-        // If the user hasn't set a scissor box, we set one that
-        // covers the current viewport.
-
-        if( !view ) {
-            glGetIntegerv( GL_VIEWPORT, &_view[0] );
-            view = &_view[0];
-        }
-
-        QRect   viewport( view[0], view[1], view[2], view[3] );
-
-        if( viewport != rect() ) {
-            glScissor( view[0], view[1], view[2], view[3] );
-            glEnable( GL_SCISSOR_TEST );
-        }
-    }
-    else
-        glEnable( GL_SCISSOR_TEST );
-}
-
-
-/*!
-   Renders the string \a str into the GL context of this widget.
-
-   \a x and \a y are specified in window coordinates, with the origin
-   in the upper left-hand corner of the window. If \a font is not
-   specified, the currently set application font will be used to
-   render the string. To change the color of the rendered text you can
-   use the glColor() call (or the qglColor() convenience function),
-   just before the renderText() call.
-
-   The \a listBase parameter is obsolete and will be removed in a
-   future version of Qt.
-
-   \note This function clears the stencil buffer.
-
-   \note This function is not supported on OpenGL/ES systems.
-
-   \note This function temporarily disables depth-testing when the
-   text is drawn.
-
-   \note This function can only be used inside a
-   QPainter::beginNativePainting()/QPainter::endNativePainting() block
-   if the default OpenGL paint engine is QPaintEngine::OpenGL. To make
-   QPaintEngine::OpenGL the default GL engine, call
-   QGL::setPreferredPaintEngine(QPaintEngine::OpenGL) before the
-   QApplication constructor.
-
-   \l{Overpainting Example}{Overpaint} with QPainter::drawText() instead.
-*/
-
-void MGraph::renderTextWin(
-    int             x,
-    int             y,
-    const QString   &str,
-    const QFont     &font )
-{
-    if( str.isEmpty() )
-        return;
-
-    qt_save_gl_state( false );
-
-    clipToView( 0 );
-
-    bool    auto_swap = isAutoBufSwap();
-    setAutoBufSwap( false );
-
-    QPainter    p( this );
-
-    qt_gl_draw_text( p, x, y, str, font );
-
-    p.end();
-    setAutoBufSwap( auto_swap );
-
-    qt_restore_gl_state( false );
-}
-
-
-/*! \overload
-
-    \a x, \a y and \a z are specified in scene or object coordinates
-    relative to the currently set projection and model matrices. This
-    can be useful if you want to annotate models with text labels and
-    have the labels move with the model as it is rotated etc.
-
-    \note This function is not supported on OpenGL/ES systems.
-
-    \note If depth testing is enabled before this function is called,
-    then the drawn text will be depth-tested against the models that
-    have already been drawn in the scene.  Use \c{glDisable(GL_DEPTH_TEST)}
-    before calling this function to annotate the models without
-    depth-testing the text.
-
-    \l{Overpainting Example}{Overpaint} with QPainter::drawText() instead.
-*/
-
-void MGraph::renderTextMdl(
-    double          x,
-    double          y,
-    double          z,
-    const QString   &str,
-    const QFont     &font )
-{
-    if( str.isEmpty() )
-        return;
-
-    GLdouble    model[4][4], proj[4][4];
-    GLint       view[4];
-    int         W = width(), H = height();
-    bool        use_depth_testing = glIsEnabled( GL_DEPTH_TEST );
-
-    glGetDoublev( GL_MODELVIEW_MATRIX, &model[0][0] );
-    glGetDoublev( GL_PROJECTION_MATRIX, &proj[0][0] );
-    glGetIntegerv( GL_VIEWPORT, &view[0] );
-
-    project( &x, &y, &z, &view[0], &proj[0][0], &model[0][0], x, y, z );
-    y = H - y;   // y is inverted
-
-    qt_save_gl_state( true );
-
-    clipToView( view );
-
-    if( use_depth_testing )
-        glEnable( GL_DEPTH_TEST );
-
-    glMatrixMode( GL_PROJECTION );
-    glLoadIdentity();
-    glViewport( 0, 0, W, H );
-    glOrtho( 0, W, H, 0, 0, 1 );
-    glMatrixMode( GL_MODELVIEW );
-    glLoadIdentity();
-    glTranslated( 0, 0, -z );
-
-    glAlphaFunc( GL_GREATER, 0.0 );
-    glEnable( GL_ALPHA_TEST );
-
-    bool    auto_swap = isAutoBufSwap();
-    setAutoBufSwap( false );
-
-    QPainter    p( this );
-
-    qt_gl_draw_text( p, qRound( x ), qRound( y ), str, font );
-
-    p.end();
-    setAutoBufSwap( auto_swap );
-
-    qt_restore_gl_state( true );
-}
-
 /* ---------------------------------------------------------------- */
 /* MGScroll ------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -1599,6 +2058,7 @@ void MGScroll::adjustLayout()
         theX->ypxPerGrf = gh = vh;
 
     theX->ypxPerGrf = qMax( theX->ypxPerGrf, 1 );
+    theX->labelsChanged();
 
     verticalScrollBar()->setPageStep( vh );
     verticalScrollBar()->setRange( 0, gh - vh );
@@ -17,8 +17,12 @@
 #include <deque>
 
 class MGraph;
+class MGraphGPU;
+class MGraphText;
 class MGScroll;
 
+class QTimer;
+
 #undef max  // inherited from WinDef.h via QGLWidget
 
 /* ---------------------------------------------------------------- */
@@ -70,8 +74,11 @@ class MGraphX
 
 private:
     std::vector<Vec2f>      verts,
-                            verts2x;    // used for binMax
+                            verts2x,    // used for binMax
+                            vdig;       // digital edge strip
     std::vector<quint8>     vdigclr;
+    std::vector<quint16>    dword;      // digital packed words
+    std::vector<quint32>    dedge;      // ...and edge indices
 // use setters for grid members
     std::vector<Vec2f>      gridVs;
     int                     nVGridLines,
@@ -95,7 +102,8 @@ public:
     int                     ySel,
                             fixedNGrf,
                             ypxPerGrf,
-                            clipTop;
+                            clipTop,
+                            lblGen;     // see labelsChanged()
     ushort                  gridStipplePat;
     bool                    drawCursor,
                             isXsel;
@@ -115,9 +123,11 @@ public:
     void setVGridLinesAuto();
 
     void setClipTop( int top )      {clipTop=top;}
+    void labelsChanged()            {++lblGen;}
     void calcYpxPerGrf();
     void setYSelByUsrChan( int usrChan );
     int getSelY0();
+    void visRows( int &iy0, int &iyLim ) const;
 
     void setXSelRange( float begin_x, float end_x );
     void setXSelEnabled( bool onoff );
@@ -156,14 +166,53 @@ private:
         shrRef( MGraph *G ) : gShr(G), nG(1) {}
     };
 
+    // Vertices a trace was last drawn with on the CPU paths
+    // (digital, bin-max, analog without GPU), reused until its
+    // data or placement change. Repaints for cursor, selection,
+    // pacing or other traces then skip rebuilding it.
+    struct TrCache {
+        std::vector<Vec2f>  V;
+        std::vector<quint8> C;          // digital colors
+        const MGraphY       *Y;
+        quint64             put,
+                            put2;
+        uint                gen,
+                            gen2,
+                            len;
+        float               y0,
+                            scl;
+        int                 nv[16];     // digital verts per line
+
+        TrCache() : Y(0), put(0), put2(0), gen(0), gen2(0), len(0) {}
+    };
+
+    // Baselines are rebuilt only if layout or scroll change.
+    struct BaseKey {
+        int     ypx,
+                top,
+                hgt,
+                ny;
+
+        BaseKey() : ypx(0), top(0), hgt(0), ny(-1) {}
+    };
+
 private:
     static QMap<QString,shrRef>  usr2Ref;
 
-    QString     usr;
-    MGraphX     *X;
-    bool        ownsX,
-                immed_update,
-                need_update;
+    QString                 usr;
+    MGraphX                 *X;
+    MGraphGPU               *gpu;
+    MGraphText              *txt;
+    QTimer                  *liveTimer;
+    std::vector<Vec2f>      baseVs;
+    std::vector<TrCache>    trc;
+    BaseKey                 baseKey;
+    double                  paintSecs,  // frame cost estimate
+                            tPainted;
+    bool                    ownsX,
+                            gpuTried,
+                            immed_update,
+                            need_update;
 
 public:
     MGraph( const QString &usr, QWidget *parent = 0, MGraphX *X = 0 );
@@ -205,6 +254,10 @@ public slots:
     void update() {if(immed_update) updateGL(); else need_update=true;}
     void updateNow()    {updateGL();}
 #endif
+    void updateLive();
+
+private slots:
+    void cleanupGL();
 
 protected:
     void initializeGL();
@@ -219,6 +272,7 @@ protected:
 private:
     const MGraph *getShr( const QString &usr );
     void win2LogicalCoords( double &x, double &y, int iy );
+    bool trCached( TrCache* &T, int iy, uint len, float y0, float scl );
     void drawBaselines();
     void drawGrid();
     void drawLabels();
@@ -229,23 +283,6 @@ private:
     void draw1BinMax( int iy );
     void draw1Analog( int iy );
     void drawPointsMain();
-
-    bool isAutoBufSwap();
-    void setAutoBufSwap( bool on );
-    void clipToView( int *view );
-
-    void renderTextWin(
-        int             x,
-        int             y,
-        const QString   &str,
-        const QFont     &font = QFont() );
-
-    void renderTextMdl(
-        double          x,
-        double          y,
-        double          z,
-        const QString   &str,
-        const QFont     &font = QFont() );
 };
 
 /* ---------------------------------------------------------------- */
@@ -9,11 +9,22 @@
 #include "ShankCtl.h"
 #include "ShankMap.h"
 #include "Biquad.h"
+#include "SpatialRef.h"
 #include "ColorTTLCtl.h"
 
 #include <QStatusBar>
 #include <QVBoxLayout>
 
+#include <math.h>
+#include <string.h>
+
+
+// -<T> smoothing time constant, seconds.
+#define DCAVE_TAU       1.0
+
+// Most sampled scans summed in int32 lanes before folding.
+#define DCAVE_LANESCANS 32768
+
 
 
 
@@ -21,103 +32,93 @@
 /* class DCAve ---------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
-void SVGrafsM::DCAve::init( int nChannels, int nNeural )
+void SVGrafsM::DCAve::init( int nChannels, int nNeural, double srate )
 {
-    nC = nChannels;
-    nN = nNeural;
+    nC          = nChannels;
+    nN          = nNeural;
+    this->srate = srate;
+    blk.assign( nN, 0 );
+    ema.assign( nN, 0.0F );
+    primed.assign( nN, 0 );
     lvl.assign( nN, 0 );
-    clock = 0.0;
 }
 
 
 void SVGrafsM::DCAve::setChecked( bool checked )
 {
-    sum.assign( nN, 0.0F );
-    cnt.assign( nN, 0 );
+    Q_UNUSED( checked )
 
-    if( !checked )
-        lvl.assign( nN, 0 );
-    else
-        clock = 0.0;
+    ema.assign( nN, 0.0F );
+    primed.assign( nN, 0 );
+    lvl.assign( nN, 0 );
 }
 
 
-// Every 5 seconds the level is updated, based
-// upon averaging over the preceding 1 second.
+// Subtract levels from neural channels [c0,nN), every dwnSmp-th
+// scan, and fold those scans into the levels, in one traversal.
+// Levels subtracted are those of earlier blocks. Channels below
+// c0 are left alone and restart their level when next tracked.
+//
+// Sums run across contiguous channels in int32 lanes, so the
+// inner loop vectorizes; a lane holds DCAVE_LANESCANS 16-bit
+// values without overflow.
 //
-void SVGrafsM::DCAve::updateLvl(
-    const qint16    *d,
+void SVGrafsM::DCAve::updateApply(
+    qint16          *d,
     int             ntpts,
+    int             c0,
     int             dwnSmp )
 {
-// -------------------
-// Time to update lvl?
-// -------------------
+    if( c0 >= nN ) {
+        primed.assign( nN, 0 );
+        return;
+    }
 
-    double  T = getTime();
+    qint32  *B      = &blk[0];
+    int     *L      = &lvl[0];
+    int     dStep   = nC * dwnSmp;
 
-    if( !clock )
-        clock = T - 4.0;
+    for( int it0 = 0; it0 < ntpts; ) {
 
-    if( T - clock >= 5.0 ) {
+        int dtpts = qMin( DCAVE_LANESCANS, (ntpts - it0 + dwnSmp - 1) / dwnSmp );
 
-        clock = T;
+        memset( B, 0, nN * sizeof(qint32) );
 
-        for( int ic = 0; ic < nN; ++ic ) {
-            lvl[ic] = (cnt[ic] ? sum[ic]/cnt[ic] : 0);
-            sum[ic] = 0.0F;
-            cnt[ic] = 0;
-        }
-    }
-    else if( T - clock >= 4.0 )
-        updateSums( d, ntpts, dwnSmp );
-}
+        for( int k = 0; k < dtpts; ++k, d += dStep ) {
 
+            for( int ic = c0; ic < nN; ++ic ) {
 
-// Apply level subtraction to neural channels.
-//
-void SVGrafsM::DCAve::apply(
-    qint16          *d,
-    int             ntpts,
-    int             c0,
-    int             dwnSmp )
-{
-    if( nN <= 0 )
-        return;
+                int v = d[ic];
 
-    int *L      = &lvl[0];
-    int dStep   = nC * dwnSmp;
-
-    for( int it = 0; it < ntpts; it += dwnSmp, d += dStep ) {
+                B[ic]  += v;
+                d[ic]   = v - L[ic];
+            }
+        }
 
-        for( int ic = c0; ic < nN; ++ic )
-            d[ic] -= L[ic];
+        smooth( c0, qMin( dtpts * dwnSmp, ntpts - it0 ), dtpts );
+        it0 += dtpts * dwnSmp;
     }
 }
 
 
-// Accumulate data into sum and cnt.
+// Move levels toward block means, weighting by block length
+// against DCAVE_TAU; a channel's first block sets its level.
 //
-void SVGrafsM::DCAve::updateSums(
-    const qint16    *d,
-    int             ntpts,
-    int             dwnSmp )
+void SVGrafsM::DCAve::smooth( int c0, int nscans, int dtpts )
 {
-    if( nN <= 0 )
-        return;
+    float   a = float(1.0 - exp( -nscans / (srate * DCAVE_TAU) ));
 
-    float   *S      = &sum[0];
-    int     dStep   = nC * dwnSmp,
-            dtpts   = (ntpts + dwnSmp - 1) / dwnSmp;
+    for( int ic = 0; ic < c0; ++ic )
+        primed[ic] = 0;
 
-    for( int it = 0; it < ntpts; it += dwnSmp, d += dStep ) {
+    for( int ic = c0; ic < nN; ++ic ) {
 
-        for( int ic = 0; ic < nN; ++ic )
-            S[ic] += d[ic];
-    }
+        float   m = float(blk[ic]) / dtpts;
 
-    for( int ic = 0; ic < nN; ++ic )
-        cnt[ic] += dtpts;
+        ema[ic]     = (primed[ic] ? ema[ic] + a * (m - ema[ic]) : m);
+        primed[ic]  = 1;
+        lvl[ic]     = int(ema[ic]);
+    }
 }
 
 /* ---------------------------------------------------------------- */
@@ -125,7 +126,7 @@ void SVGrafsM::DCAve::updateSums(
 /* ---------------------------------------------------------------- */
 
 SVGrafsM::SVGrafsM( GraphsWindow *gw, const DAQ::Params &p )
-    :   gw(gw), shankCtl(0), p(p), hipass(0), lopass(0),
+    :   gw(gw), shankCtl(0), p(p), hipass(0), bandpass(0), notch(0),
         drawMtx(QMutex::Recursive), timStatBar(250, this),
         lastMouseOverChan(-1), selected(-1), maximized(-1),
         externUpdateTimes(true), inConstructor(true)
@@ -169,10 +170,11 @@ void SVGrafsM::init( SVToolsM *tb )
 // ----------
 
     tb->init();
-    dc.init( n, neurChanCount() );
+    dc.init( n, neurChanCount(), mySampRate() );
     dcChkClicked( set.dcChkOn );
     binMaxChkClicked( set.binMaxOn );
     bandSelChanged( set.bandSel );
+    notchSelChanged( set.notchSel );
     sAveSelChanged( set.sAveSel );
 
     ic2iy.fill( -1 );
@@ -209,8 +211,10 @@ SVGrafsM::~SVGrafsM()
     fltMtx.lock();
         if( hipass )
             delete hipass;
-        if( lopass )
-            delete lopass;
+        if( bandpass )
+            delete bandpass;
+        if( notch )
+            delete notch;
     fltMtx.unlock();
 
     if( shankCtl ) {
@@ -439,6 +443,34 @@ void SVGrafsM::binMaxChkClicked( bool checked )
 }
 
 
+// Selections: {0=Off, 1=50 Hz, 2=60 Hz}, notching the line
+// frequency and harmonics on neural channels.
+//
+void SVGrafsM::notchSelChanged( int sel )
+{
+    fltMtx.lock();
+
+    if( notch ) {
+        delete notch;
+        notch = 0;
+    }
+
+    if( sel ) {
+        notch = new BiquadCascade;
+        notch->addBand(
+            BiquadBand( 0, 0, notchSelHz( sel ), myNotchHarms() ),
+            mySampRate() );
+    }
+
+    fltMtx.unlock();
+
+    drawMtx.lock();
+    set.notchSel = sel;
+    saveSettings();
+    drawMtx.unlock();
+}
+
+
 void SVGrafsM::refresh()
 {
     mainApp()->getRun()->grfRefresh();
@@ -550,95 +582,23 @@ void SVGrafsM::ensureVisible()
 // - Annulus with {inner, outer} radii {self, 2} or {2, 8}.
 // - The list is sorted for cache friendliness.
 //
-// Sel: {0=Off; 1=Loc 1,2; 2=Loc 2,8; 3=Glb All, 4=Glb Dmx}.
+// Sel: {0=Off; 1=Loc 1,2; 2=Loc 2,8; 3=Glb All, 4=Glb Dmx,
+// 5=Glb Med}.
 //
 void SVGrafsM::sAveTable( const ShankMap &SM, int nSpikeChans, int sel )
 {
-    TSM.clear();
+    TSM.off.clear();
+    TSM.nbr.clear();
 
     if( !(sel == 1 || sel == 2) || nSpikeChans <= 0 )
         return;
 
-    TSM.resize( nSpikeChans );
-
-    QMap<ShankMapDesc,uint> ISM;
-    SM.inverseMap( ISM );
-
-    int rIn, rOut;
-
-    if( sel == 1 ) {
-        rIn     = 0;
-        rOut    = 2;
-    }
-    else if( sel == 2 ) {
-        rIn     = 2;
-        rOut    = 8;
-    }
-
-    for( int ic = 0; ic < nSpikeChans; ++ic ) {
-
-        const ShankMapDesc  &E = SM.e[ic];
-
-        if( !E.u )
-            continue;
+    TSM.build( SM );
 
-        // ----------------------------------
-        // Form map of excluded inner indices
-        // ----------------------------------
-
-        QMap<int,int>   inner;  // keys sorted, value is arbitrary
-
-        int xL  = qMax( int(E.c)  - rIn, 0 ),
-            xH  = qMin( uint(E.c) + rIn + 1, SM.nc ),
-            yL  = qMax( int(E.r)  - rIn, 0 ),
-            yH  = qMin( uint(E.r) + rIn + 1, SM.nr );
-
-        for( int ix = xL; ix < xH; ++ix ) {
-
-            for( int iy = yL; iy < yH; ++iy ) {
-
-                QMap<ShankMapDesc,uint>::iterator   it;
-
-                it = ISM.find( ShankMapDesc( E.s, ix, iy, 1 ) );
-
-                if( it != ISM.end() )
-                    inner[it.value()] = 1;
-            }
-        }
-
-        // -------------------------
-        // Fill with annulus members
-        // -------------------------
-
-        std::vector<int>    &V = TSM[ic];
-
-        xL  = qMax( int(E.c)  - rOut, 0 );
-        xH  = qMin( uint(E.c) + rOut + 1, SM.nc );
-        yL  = qMax( int(E.r)  - rOut, 0 );
-        yH  = qMin( uint(E.r) + rOut + 1, SM.nr );
-
-        for( int ix = xL; ix < xH; ++ix ) {
-
-            for( int iy = yL; iy < yH; ++iy ) {
-
-                QMap<ShankMapDesc,uint>::iterator   it;
-
-                it = ISM.find( ShankMapDesc( E.s, ix, iy, 1 ) );
-
-                if( it != ISM.end() ) {
-
-                    int i = it.value();
-
-                    // Exclude inners
-
-                    if( inner.find( i ) == inner.end() )
-                        V.push_back( i );
-                }
-            }
-        }
-
-        qSort( V );
-    }
+    if( sel == 1 )
+        TSM.annuli( SM, nSpikeChans, 0, 2 );
+    else
+        TSM.annuli( SM, nSpikeChans, 2, 8 );
 }
 
 
@@ -646,14 +606,12 @@ void SVGrafsM::sAveTable( const ShankMap &SM, int nSpikeChans, int sel )
 //
 int SVGrafsM::sAveApplyLocal( const qint16 *d_ic, int ic )
 {
-    const std::vector<int>  &V = TSM[ic];
-
-    int nv = V.size();
+    int nv = TSM.nNbr( ic );
 
     if( nv ) {
 
         const qint16    *d  = d_ic - ic;
-        const int       *v  = &V[0];
+        const int       *v  = TSM.nbrs( ic );
         int             sum = 0;
 
         for( int iv = 0; iv < nv; ++iv )
@@ -674,49 +632,16 @@ void SVGrafsM::sAveApplyGlobal(
     int             ntpts,
     int             nC,
     int             nAP,
-    int             dwnSmp )
+    int             dwnSmp,
+    bool            median )
 {
     if( nAP <= 0 )
         return;
 
-    const ShankMapDesc  *E = &SM.e[0];
+    SpatialRef  sr;
 
-    int                 ns      = SM.ns,
-                        dStep   = nC * dwnSmp;
-    std::vector<int>    _A( ns ),
-                        _N( ns );
-    std::vector<float>  _S( ns );
-    int                 *A  = &_A[0],
-                        *N  = &_N[0];
-    float               *S  = &_S[0];
-
-    for( int it = 0; it < ntpts; it += dwnSmp, d += dStep ) {
-
-        for( int is = 0; is < ns; ++is ) {
-            S[is] = 0;
-            N[is] = 0;
-            A[is] = 0;
-        }
-
-        for( int ic = 0; ic < nAP; ++ic ) {
-
-            const ShankMapDesc  *e = &E[ic];
-
-            if( e->u ) {
-                S[e->s] += d[ic];
-                ++N[e->s];
-            }
-        }
-
-        for( int is = 0; is < ns; ++is ) {
-
-            if( N[is] )
-                A[is] = S[is] / N[is];
-        }
-
-        for( int ic = 0; ic < nAP; ++ic )
-            d[ic] -= A[E[ic].s];
-    }
+    sr.buildAll( SM, nAP, median );
+    sr.apply( d, ntpts, nC, dwnSmp );
 }
 
 
@@ -734,47 +659,14 @@ void SVGrafsM::sAveApplyGlobalStride(
     if( nAP <= 0 )
         return;
 
-    const ShankMapDesc  *E = &SM.e[0];
+    std::vector<std::vector<int> >  sets( stride );
+    SpatialRef                      sr;
 
-    int                 ns      = SM.ns,
-                        dStep   = nC * dwnSmp;
-    std::vector<int>    _A( ns ),
-                        _N( ns );
-    std::vector<float>  _S( ns );
-    int                 *A  = &_A[0],
-                        *N  = &_N[0];
-    float               *S  = &_S[0];
+    for( int ic = 0; ic < nAP; ++ic )
+        sets[ic % stride].push_back( ic );
 
-    for( int it = 0; it < ntpts; it += dwnSmp, d += dStep ) {
-
-        for( int ic0 = 0; ic0 < stride; ++ic0 ) {
-
-            for( int is = 0; is < ns; ++is ) {
-                S[is] = 0;
-                N[is] = 0;
-                A[is] = 0;
-            }
-
-            for( int ic = ic0; ic < nAP; ic += stride ) {
-
-                const ShankMapDesc  *e = &E[ic];
-
-                if( e->u ) {
-                    S[e->s] += d[ic];
-                    ++N[e->s];
-                }
-            }
-
-            for( int is = 0; is < ns; ++is ) {
-
-                if( N[is] )
-                    A[is] = S[is] / N[is];
-            }
-
-            for( int ic = ic0; ic < nAP; ic += stride )
-                d[ic] -= A[E[ic].s];
-        }
-    }
+    sr.build( SM, sets );
+    sr.apply( d, ntpts, nC, dwnSmp );
 }
 
 
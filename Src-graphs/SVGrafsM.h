@@ -5,6 +5,7 @@
 #include "MGraph.h"
 #include "GraphStats.h"
 #include "TimedTextUpdate.h"
+#include "ShankMap.h"
 
 #include <QWidget>
 
@@ -16,8 +17,9 @@ class GraphsWindow;
 class SVToolsM;
 class MNavbar;
 class ShankCtl;
-struct ShankMap;
 class Biquad;
+class BiquadCascade;
+struct BiquadBand;
 
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
@@ -47,38 +49,36 @@ protected:
                 clr2;
         int     navNChan,
                 bandSel,
+                notchSel,   // {0=Off, 1=50 Hz, 2=60 Hz}
                 sAveSel;    // {0=Off, 1=Local, 2=Global}
         bool    dcChkOn,
                 binMaxOn,
                 usrOrder;
     };
 
+    // -<T> levels: each neural channel's mean, exponentially
+    // smoothed over the blocks drawn, tracked in the same pass
+    // that subtracts it.
     class DCAve {
     private:
-        std::vector<float>  sum;
-        std::vector<int>    cnt;
-        double              clock;
+        std::vector<qint32> blk;    // block sums, int32 lanes
+        std::vector<float>  ema;
+        std::vector<char>   primed;
+        double              srate;
         int                 nC,
                             nN;
     public:
         std::vector<int>    lvl;
     public:
-        void init( int nChannels, int nNeural );
+        void init( int nChannels, int nNeural, double srate );
         void setChecked( bool checked );
-        void updateLvl(
-            const qint16    *d,
-            int             ntpts,
-            int             dwnSmp );
-        void apply(
+        void updateApply(
             qint16          *d,
             int             ntpts,
             int             c0,
             int             dwnSmp );
     private:
-        void updateSums(
-            const qint16    *d,
-            int             ntpts,
-            int             dwnSmp );
+        void smooth( int c0, int nscans, int dtpts );
     };
 
 protected:
@@ -95,13 +95,14 @@ protected:
                             *saveAction,
                             *refreshAction,
                             *cTTLAction;
-    Biquad                  *hipass,
-                            *lopass;
+    Biquad                  *hipass;
+    BiquadCascade           *bandpass,
+                            *notch;
     std::vector<MGraphY>    ic2Y;
     std::vector<GraphStats> ic2stat;
     QVector<int>            ic2iy,
                             ig2ic;
-    std::vector<std::vector<int> >  TSM;
+    ShankMapIndex           TSM;
     mutable QMutex          drawMtx,
                             fltMtx;
     UsrSettings             set;
@@ -126,7 +127,9 @@ public:
     void shankCtlGeomSet( const QByteArray &geom, bool show );
 
     void eraseGraphs();
-    virtual void putScans( vec_i16 &data, quint64 headCt ) = 0;
+    virtual void putScans( vec_i16 &data, quint64 headCt, bool fltd ) = 0;
+    virtual bool viewBand( BiquadBand &B, int &cLim, int &maxInt ) const
+        {return false;}
     virtual void updateRHSFlags() = 0;
 
     virtual int chanCount()     const = 0;
@@ -135,6 +138,7 @@ public:
     int  navNChan()         const   {return set.navNChan;}
     int  curSel()           const   {return selected;}
     int  curBandSel()       const   {return set.bandSel;}
+    int  curNotchSel()      const   {return set.notchSel;}
     int  curSAveSel()       const   {return set.sAveSel;}
     bool isDcChkOn()        const   {return set.dcChkOn;}
     bool isBinMaxOn()       const   {return set.binMaxOn;}
@@ -161,6 +165,7 @@ public slots:
     void dcChkClicked( bool checked );
     void binMaxChkClicked( bool checked );
     virtual void bandSelChanged( int sel ) = 0;
+    void notchSelChanged( int sel );
     virtual void sAveSelChanged( int sel ) = 0;
     // Right-click
     void refresh();
@@ -181,6 +186,7 @@ protected:
 
     virtual void myInit() = 0;
     virtual double mySampRate() const = 0;
+    virtual int myNotchHarms() const = 0;
     virtual void mySort_ig2ic() = 0;
     virtual QString myChanName( int ic ) const = 0;
     virtual const QBitArray& mySaveBits() const = 0;
@@ -189,6 +195,9 @@ protected:
     virtual void loadSettings() = 0;
     virtual void saveSettings() const = 0;
 
+    static double notchSelHz( int sel )
+        {return (sel == 1 ? 50 : (sel == 2 ? 60 : 0));}
+
     void setSorting( bool userSorted );
     void selectChan( int ic );
     void ensureVisible();
@@ -201,7 +210,8 @@ protected:
         int             ntpts,
         int             nC,
         int             nAP,
-        int             dwnSmp );
+        int             dwnSmp,
+        bool            median = false );
     void sAveApplyGlobalStride(
         const ShankMap  &SM,
         qint16          *d,
@@ -9,12 +9,15 @@
 #include "AOCtl.h"
 #include "ChanMapCtl.h"
 #include "ColorTTLCtl.h"
+#include "GraphPub.h"
 #include "IMROEditor_T0.h"
 #include "IMROEditor_T21.h"
 #include "IMROEditor_T24.h"
 #include "SVGrafsM_Im.h"
+#include "Trace.h"
 #include "ShankCtl_Im.h"
 #include "Biquad.h"
+#include "SpatialRef.h"
 
 #include <QAction>
 #include <QSettings>
@@ -66,8 +69,6 @@ SVGrafsM_Im::SVGrafsM_Im(
 
     cTTLAction = new QAction( "Color TTL Events...", this );
     ConnectUI( cTTLAction, SIGNAL(triggered()), this, SLOT(colorTTL()) );
-
-    p.im.each[ip].roTbl->muxTable( nADC, nChn, muxTbl );
 }
 
 
@@ -81,10 +82,11 @@ static void addLF2AP(
 {
     std::vector<float>  _fgain( nAP );
     float               *fgain  = &_fgain[0];
+    const float         *G      = &E.lut.gain[0];
     int                 dStep   = nC * dwnSmp;
 
     for( int ic = 0; ic < nAP; ++ic )
-        fgain[ic] = E.chanGain( ic ) / E.chanGain( ic+nAP );
+        fgain[ic] = G[ic] / G[ic+nAP];
 
     for( int it = 0; it < ntpts; it += dwnSmp, d += dStep ) {
 
@@ -106,17 +108,21 @@ static void addLF2AP(
     Rather, min_x and max_x suggest only the span of depicted data.
 */
 
+// Channels per putScans() fill group; see putFill().
+#define SVGM_FILLGRPCHANS   32
+
 #define V_S_AVE( d_ic )                                         \
     (sAveLocal ? sAveApplyLocal( d_ic, ic ) : *d_ic)
 
 
-void SVGrafsM_Im::putScans( vec_i16 &data, quint64 headCt )
+// fltd: data AP channels already highpassed and notched
+// by a shared filter stage (see viewBand).
+//
+void SVGrafsM_Im::putScans( vec_i16 &data, quint64 headCt, bool fltd )
 {
     const CimCfg::AttrEach  &E = p.im.each[ip];
 
-#if 0
-    double  tProf = getTime();
-#endif
+    TraceZone   tz( "graph put", ip );
     float       ysc;
     const int   nC      = chanCount(),
                 nNu     = neurChanCount(),
@@ -146,8 +152,14 @@ void SVGrafsM_Im::putScans( vec_i16 &data, quint64 headCt )
 // Push data to shank viewer
 // -------------------------
 
-    if( shankCtl->isVisible() )
-        shankCtl->putScans( data );
+    if( shankCtl->isVisible() ) {
+
+        fltMtx.lock();
+            bool    hp300 = fltd && hipass;
+        fltMtx.unlock();
+
+        shankCtl->putScans( data, hp300 );
+    }
 
 // ------------
 // TTL coloring
@@ -164,8 +176,12 @@ void SVGrafsM_Im::putScans( vec_i16 &data, quint64 headCt )
     // ---------
 
     fltMtx.lock();
-    if( hipass )
-        hipass->applyBlockwiseMem( &data[0], maxInt, ntpts, nC, 0, nAP );
+    if( hipass && !fltd )
+        hipass->applyBlockwiseFxp( &data[0], maxInt, ntpts, nC, 0, nAP );
+    if( notch ) {
+        notch->applyBlockwiseMem(
+            &data[0], maxInt, ntpts, nC, (fltd ? nAP : 0), nNu );
+    }
     fltMtx.unlock();
 
     // ------------------------------------------
@@ -192,9 +208,7 @@ void SVGrafsM_Im::putScans( vec_i16 &data, quint64 headCt )
 
     if( set.dcChkOn ) {
 
-        dc.updateLvl( &data[0], ntpts, dwnSmp );
-
-        dc.apply(
+        dc.updateApply(
             &data[0], ntpts,
             (set.bandSel == 1 ? nAP : 0),
             (drawBinMax ? 1 : dwnSmp) );
@@ -222,21 +236,211 @@ void SVGrafsM_Im::putScans( vec_i16 &data, quint64 headCt )
                 &data[0], ntpts, nC, nAP,
                 (drawBinMax ? 1 : dwnSmp) );
             break;
+        case 5:
+            sAveApplyGlobal(
+                E.sns.shankMap,
+                &data[0], ntpts, nC, nAP,
+                (drawBinMax ? 1 : dwnSmp), true );
+            break;
         default:
             ;
     }
 
+// --------------------------------------------
+// Fill points and stats, in groups across pool
+// --------------------------------------------
+
+    PutFill             F;
+    const int           nyMax = ntpts / dwnSmp;
+    std::vector<float>  yAll( nC * nyMax ),
+                        yAll2( drawBinMax ? nC * nyMax : 0 );
+    std::vector<int>    nyAll( nC, 0 );
+    std::vector<char>   bmAll( nC, -1 );
+    int                 nThd;
+
+    F.W             = this;
+    F.used          = &E.lut.used[0];
+    F.data          = &data[0];
+    F.y             = &yAll[0];
+    F.y2            = (drawBinMax ? &yAll2[0] : 0);
+    F.ny            = &nyAll[0];
+    F.bm            = &bmAll[0];
+    F.ysc           = ysc;
+    F.nC            = nC;
+    F.nNu           = nNu;
+    F.nAP           = nAP;
+    F.ntpts         = ntpts;
+    F.dwnSmp        = dwnSmp;
+    F.nyMax         = nyMax;
+    F.drawBinMax    = drawBinMax;
+    F.sAveLocal     = sAveLocal;
+
+    // A headless viewer gets every row at full fidelity
+
+    if( GraphPub::isHeadless() ) {
+        F.iy0   = 0;
+        F.iyLim = nC;
+    }
+    else
+        theX->visRows( F.iy0, F.iyLim );
+
+    nThd = qBound(
+            1, nC / SVGM_FILLGRPCHANS,
+            BiquadPool::pool().nWorkers() + 1 );
+
+    if( nThd > 1 ) {
+
+        std::vector<BiquadJob>  jobs( nThd );
+        int                     remain = nThd;
+
+        for( int i = 0; i < nThd; ++i ) {
+
+            BiquadJob   &B = jobs[i];
+
+            // Group edges on 16-channel lanes for binMax kernel
+
+            B.fn        = putFillJob;
+            B.ctx       = &F;
+            B.i0        = (i * nC / nThd) & ~15;
+            B.iLim      = (i + 1 < nThd ? ((i + 1) * nC / nThd) & ~15 : nC);
+            B.remain    = &remain;
+        }
+
+        BiquadPool::pool().runBatch( jobs );
+    }
+    else
+        putFill( F, 0, nC );
+
+// ------------------------
+// Publish to remote viewer
+// ------------------------
+
+    if( GraphPub::wanted( ip ) ) {
+
+        GraphPubFrame   G( ip, headCt, dwnSmp, E.srate );
+
+        for( int ic = 0; ic < nC; ++ic ) {
+
+            if( ic2iy[ic] < 0 || !nyAll[ic] )
+                continue;
+
+            bool    bm = (bmAll[ic] >= 0 ? bmAll[ic] : ic2Y[ic].drawBinMax);
+
+            G.add(
+                ic, &yAll[ic * nyMax],
+                (bm && drawBinMax ? &yAll2[ic * nyMax] : 0),
+                nyAll[ic], (ic < nNu ? maxInt : 1), ic >= nNu );
+        }
+
+        G.publish();
+    }
+
 // ---------------------
 // Append data to graphs
 // ---------------------
 
-    std::vector<float>  ybuf( ntpts ),  // append en masse
-                        ybuf2( drawBinMax ? ntpts : 0 );
-
     theX->dataMtx.lock();
 
     for( int ic = 0; ic < nC; ++ic ) {
 
+        if( ic2iy[ic] < 0 )
+            continue;
+
+        MGraphY &Y = ic2Y[ic];
+
+        if( bmAll[ic] >= 0 )
+            Y.drawBinMax = bmAll[ic];
+
+        // Append points en masse
+        // Renormalize x-coords -> consecutive indices.
+
+        Y.yval.putData( &yAll[ic * nyMax], nyAll[ic] );
+
+        if( Y.drawBinMax && drawBinMax )
+            Y.yval2.putData( &yAll2[ic * nyMax], nyAll[ic] );
+    }
+
+// -----------------------
+// Update pseudo time axis
+// -----------------------
+
+    theX->spanMtx.lock();
+
+    double  span        = theX->spanSecs(),
+            TabsCursor  = (headCt + ntpts) / E.srate,
+            TwinCursor  = span * theX->Y[0]->yval.cursor()
+                            / theX->Y[0]->yval.capacity();
+
+    theX->min_x = qMax( TabsCursor - TwinCursor, 0.0 );
+    theX->max_x = theX->min_x + span;
+
+    theX->spanMtx.unlock();
+
+// ----
+// Draw
+// ----
+
+    theX->dataMtx.unlock();
+
+    drawMtx.unlock();
+
+    if( !GraphPub::isHeadless() )
+        QMetaObject::invokeMethod( theM, "updateLive", Qt::QueuedConnection );
+
+// ---------
+// Profiling
+// ---------
+}
+
+
+void SVGrafsM_Im::putFillJob( const BiquadJob &B )
+{
+    const PutFill   *F = (const PutFill*)B.ctx;
+
+    F->W->putFill( *F, B.i0, B.iLim );
+}
+
+
+// Return end of run [ic,icRun) of adjacent channels that are
+// all shown, used, on-screen AP: these share one binMax kernel
+// call. Returns ic if ic itself isn't such a channel.
+//
+int SVGrafsM_Im::binMaxRun( const PutFill &F, int ic, int icLim ) const
+{
+    int icRun = ic;
+
+    for( ; icRun < icLim && icRun < F.nAP; ++icRun ) {
+
+        int iy = ic2iy[icRun];
+
+        if( iy < F.iy0 || iy >= F.iyLim || !F.used[icRun] )
+            break;
+    }
+
+    return icRun;
+}
+
+
+// Downsample channels [ic0,icLim) of block F.data into their
+// F.y (F.y2) rows and update their stats. Channels are
+// independent, so groups run concurrently; graphs are not
+// touched here.
+//
+void SVGrafsM_Im::putFill( const PutFill &F, int ic0, int icLim )
+{
+    const quint8    *used       = F.used;
+    float           ysc         = F.ysc;
+    const int       nC          = F.nC,
+                    nNu         = F.nNu,
+                    nAP         = F.nAP,
+                    ntpts       = F.ntpts,
+                    dwnSmp      = F.dwnSmp,
+                    dstep       = dwnSmp * nC;
+    const bool      drawBinMax  = F.drawBinMax,
+                    sAveLocal   = F.sAveLocal;
+
+    for( int ic = ic0; ic < icLim; ++ic ) {
+
         // -----------------
         // For active graphs
         // -----------------
@@ -244,6 +448,32 @@ void SVGrafsM_Im::putScans( vec_i16 &data, quint64 headCt )
         if( ic2iy[ic] < 0 )
             continue;
 
+        // -----------------------------
+        // Vector binMax over an AP run
+        // -----------------------------
+
+        if( drawBinMax && !sAveLocal ) {
+
+            int icRun = binMaxRun( F, ic, icLim );
+
+            if( icRun > ic ) {
+
+                for( int jc = ic; jc < icRun; ++jc ) {
+                    ic2stat[jc].clear();
+                    F.ny[jc] = F.nyMax;
+                    F.bm[jc] = 1;
+                }
+
+                GraphStats::binMax(
+                    &F.y[ic * F.nyMax], &F.y2[ic * F.nyMax], F.nyMax,
+                    &ic2stat[ic], &F.data[ic],
+                    ntpts, nC, icRun - ic, dwnSmp, 1, ysc );
+
+                ic = icRun - 1;
+                continue;
+            }
+        }
+
         // ----------
         // Init stats
         // ----------
@@ -251,6 +481,8 @@ void SVGrafsM_Im::putScans( vec_i16 &data, quint64 headCt )
         // Collect points, update mean, stddev
 
         GraphStats  &stat = ic2stat[ic];
+        float       *ybuf = &F.y[ic * F.nyMax],
+                    *ybuf2;
 
         stat.clear();
 
@@ -258,15 +490,41 @@ void SVGrafsM_Im::putScans( vec_i16 &data, quint64 headCt )
         // By channel type...
         // ------------------
 
-        qint16  *d  = &data[ic];
+        qint16  *d  = &F.data[ic];
         int     ny  = 0;
 
+        // ----------------------
+        // Off-screen neural rows
+        // ----------------------
+
+        // Plain decimation keeps the row's buffer in step; binMax,
+        // local CAR and stats resume on scroll-in. The putScans()
+        // filters still run on every channel to keep state intact.
+
+        if( (ic2iy[ic] < F.iy0 || ic2iy[ic] >= F.iyLim)
+            && ic < nNu
+            && used[ic] ) {
+
+            for( int it = 0; it < ntpts; it += dwnSmp, d += dstep )
+                ybuf[ny++] = *d * ysc;
+
+            if( ic < nAP ) {
+
+                F.bm[ic] = drawBinMax;
+
+                if( drawBinMax )
+                    memcpy( &F.y2[ic * F.nyMax], ybuf, ny * sizeof(float) );
+            }
+
+            goto putData;
+        }
+
         if( ic < nAP ) {
 
-            if( !E.sns.shankMap.e[ic].u ) {
+            if( !used[ic] ) {
 
-                ny = (ntpts + dwnSmp - 1) / dwnSmp;
-                memset( &ybuf[0], 0, ny * sizeof(float) );
+                ny = F.nyMax;
+                memset( ybuf, 0, ny * sizeof(float) );
                 goto putData;
             }
 
@@ -282,7 +540,8 @@ void SVGrafsM_Im::putScans( vec_i16 &data, quint64 headCt )
 
                 int ndRem = ntpts;
 
-                ic2Y[ic].drawBinMax = true;
+                ybuf2       = &F.y2[ic * F.nyMax];
+                F.bm[ic]    = 1;
 
                 for( int it = 0; it < ntpts; it += dwnSmp ) {
 
@@ -319,7 +578,7 @@ void SVGrafsM_Im::putScans( vec_i16 &data, quint64 headCt )
             }
             else if( sAveLocal ) {
 
-                ic2Y[ic].drawBinMax = false;
+                F.bm[ic] = 0;
 
                 for( int it = 0; it < ntpts; it += dwnSmp, d += dstep ) {
 
@@ -330,7 +589,7 @@ void SVGrafsM_Im::putScans( vec_i16 &data, quint64 headCt )
                 }
             }
             else {
-                ic2Y[ic].drawBinMax = false;
+                F.bm[ic] = 0;
                 goto draw_analog;
             }
         }
@@ -340,10 +599,10 @@ void SVGrafsM_Im::putScans( vec_i16 &data, quint64 headCt )
             // LFP
             // ---
 
-            if( !E.sns.shankMap.e[ic - nAP].u ) {
+            if( !used[ic] ) {
 
-                ny = (ntpts + dwnSmp - 1) / dwnSmp;
-                memset( &ybuf[0], 0, ny * sizeof(float) );
+                ny = F.nyMax;
+                memset( ybuf, 0, ny * sizeof(float) );
                 goto putData;
             }
 
@@ -364,50 +623,9 @@ draw_analog:
                 ybuf[ny++] = *d;
         }
 
-        // Append points en masse
-        // Renormalize x-coords -> consecutive indices.
-
 putData:
-        ic2Y[ic].yval.putData( &ybuf[0], ny );
-
-        if( ic2Y[ic].drawBinMax )
-            ic2Y[ic].yval2.putData( &ybuf2[0], ny );
+        F.ny[ic] = ny;
     }
-
-// -----------------------
-// Update pseudo time axis
-// -----------------------
-
-    theX->spanMtx.lock();
-
-    double  span        = theX->spanSecs(),
-            TabsCursor  = (headCt + ntpts) / E.srate,
-            TwinCursor  = span * theX->Y[0]->yval.cursor()
-                            / theX->Y[0]->yval.capacity();
-
-    theX->min_x = qMax( TabsCursor - TwinCursor, 0.0 );
-    theX->max_x = theX->min_x + span;
-
-    theX->spanMtx.unlock();
-
-// ----
-// Draw
-// ----
-
-    theX->dataMtx.unlock();
-
-    drawMtx.unlock();
-
-    QMetaObject::invokeMethod( theM, "update", Qt::QueuedConnection );
-
-// ---------
-// Profiling
-// ---------
-
-#if 0
-    tProf = getTime() - tProf;
-    Log() << "Graph millis " << 1000*tProf;
-#endif
 }
 
 
@@ -418,13 +636,13 @@ void SVGrafsM_Im::updateRHSFlags()
 
 // First consider only save flags for all channels
 
-    const QBitArray &saveBits = p.im.each[ip].sns.saveBits;
+    const std::vector<quint8>   &save = p.im.each[ip].lut.save;
 
     for( int ic = 0, nC = ic2Y.size(); ic < nC; ++ic ) {
 
         MGraphY &Y = ic2Y[ic];
 
-        if( saveBits.testBit( ic ) )
+        if( save[ic] )
             Y.rhsLabel = "S";
         else
             Y.rhsLabel.clear();
@@ -440,13 +658,14 @@ void SVGrafsM_Im::updateRHSFlags()
 
             MGraphY &Y = ic2Y[ic];
 
-            if( saveBits.testBit( ic ) )
+            if( save[ic] )
                 Y.rhsLabel = "A S";
             else
                 Y.rhsLabel = "A  ";
         }
     }
 
+    theX->labelsChanged();
     theX->dataMtx.unlock();
     drawMtx.unlock();
 }
@@ -464,6 +683,29 @@ int SVGrafsM_Im::neurChanCount() const
 }
 
 
+// Set band B we'd apply to AP channels [0,cLim), and return
+// true if shared data filtered with just that band would do.
+// A visible shank viewer must also be able to use AP already
+// highpassed at 300 Hz.
+//
+bool SVGrafsM_Im::viewBand( BiquadBand &B, int &cLim, int &maxInt ) const
+{
+    const CimCfg::AttrEach  &E = p.im.each[ip];
+    QMutexLocker            ml( &fltMtx );
+
+    B = BiquadBand(
+            (hipass ? 300 : 0), 0,
+            (notch ? notchSelHz( set.notchSel ) : 0),
+            p.im.all.fltNotchN );
+
+    cLim    = E.imCumTypCnt[CimCfg::imSumAP];
+    maxInt  = E.roTbl->maxInt();
+
+    return !B.isOff()
+            && (!hipass || !shankCtl->isVisible() || shankCtl->takesHp300());
+}
+
+
 bool SVGrafsM_Im::isSelAnalog() const
 {
 // MS: Analog and digital aux may be redefined in phase 3B2
@@ -842,6 +1084,7 @@ void SVGrafsM_Im::loadSettings()
     set.clr2        = clrFromString( settings.value( "clr2", "ff44eeff" ).toString() );
     set.navNChan    = settings.value( "navNChan", 32 ).toInt();
     set.bandSel     = settings.value( "bandSel", 0 ).toInt();
+    set.notchSel    = settings.value( "notchSel", 0 ).toInt();
     set.sAveSel     = settings.value( "sAveSel", 0 ).toInt();
     set.dcChkOn     = settings.value( "dcChkOn", false ).toBool();
     set.binMaxOn    = settings.value( "binMaxOn", false ).toBool();
@@ -867,6 +1110,7 @@ void SVGrafsM_Im::saveSettings() const
     settings.setValue( "clr2", clrToString( set.clr2 ) );
     settings.setValue( "navNChan", set.navNChan );
     settings.setValue( "bandSel", set.bandSel );
+    settings.setValue( "notchSel", set.notchSel );
     settings.setValue( "sAveSel", set.sAveSel );
     settings.setValue( "dcChkOn", set.dcChkOn );
     settings.setValue( "binMaxOn", set.binMaxOn );
@@ -888,52 +1132,19 @@ void SVGrafsM_Im::sAveApplyDmxTbl(
     if( nAP <= 0 )
         return;
 
-    const ShankMapDesc  *E = &SM.e[0];
-
-    int                 ns      = SM.ns,
-                        dStep   = nC * dwnSmp;
-    std::vector<int>    _A( ns ),
-                        _N( ns );
-    std::vector<float>  _S( ns );
-    int                 *T  = &muxTbl[0],
-                        *A  = &_A[0],
-                        *N  = &_N[0];
-    float               *S  = &_S[0];
-
-    for( int it = 0; it < ntpts; it += dwnSmp, d += dStep ) {
-
-        for( int irow = 0; irow < nChn; ++irow ) {
-
-            for( int is = 0; is < ns; ++is ) {
-                S[is] = 0;
-                N[is] = 0;
-                A[is] = 0;
-            }
-
-            for( int icol = 0; icol < nADC; ++icol ) {
-
-                int                 ic = T[nADC*irow + icol];
-                const ShankMapDesc  *e = &E[ic];
-
-                if( e->u ) {
-                    S[e->s] += d[ic];
-                    ++N[e->s];
-                }
-            }
+    const CimCfg::ChanLUT           &L = p.im.each[ip].lut;
+    std::vector<std::vector<int> >  sets( L.nChn );
+    SpatialRef                      sr;
+    const int                       *T = &L.muxTbl[0];
 
-            for( int is = 0; is < ns; ++is ) {
+    for( int irow = 0; irow < L.nChn; ++irow ) {
 
-                if( N[is] )
-                    A[is] = S[is] / N[is];
-            }
-
-            for( int icol = 0; icol < nADC; ++icol ) {
-
-                int ic = T[nADC*irow + icol];
-                d[ic] -= A[E[ic].s];
-            }
-        }
+        for( int icol = 0; icol < L.nADC; ++icol )
+            sets[irow].push_back( T[L.nADC*irow + icol] );
     }
+
+    sr.build( SM, sets );
+    sr.apply( d, ntpts, nC, dwnSmp );
 }
 
 
@@ -3,6 +3,8 @@
 
 #include "SVGrafsM.h"
 
+struct BiquadJob;
+
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -11,12 +13,35 @@ class SVGrafsM_Im : public SVGrafsM
 {
     Q_OBJECT
 
+private:
+    // One block's channel-group fill context:
+    // rows y, y2 are [nC][nyMax]; ny, bm are [nC],
+    // bm = {-1=keep, 0, 1} drawBinMax.
+    // Neural rows outside [iy0,iyLim) are only decimated.
+    struct PutFill {
+        SVGrafsM_Im     *W;
+        const quint8    *used;  // lut.used
+        qint16          *data;
+        float           *y,
+                        *y2;
+        int             *ny;
+        char            *bm;
+        float           ysc;
+        int             nC,
+                        nNu,
+                        nAP,
+                        ntpts,
+                        dwnSmp,
+                        nyMax,
+                        iy0,    // full fidelity rows
+                        iyLim;
+        bool            drawBinMax,
+                        sAveLocal;
+    };
+
 private:
     QAction             *imroAction,
                         *stdbyAction;
-    std::vector<int>    muxTbl;
-    int                 nADC,
-                        nChn;
     const int           ip,
                         jpanel;
 
@@ -27,7 +52,8 @@ public:
         int                 ip,
         int                 jpanel );
 
-    virtual void putScans( vec_i16 &data, quint64 headCt );
+    virtual void putScans( vec_i16 &data, quint64 headCt, bool fltd );
+    virtual bool viewBand( BiquadBand &B, int &cLim, int &maxInt ) const;
     virtual void updateRHSFlags();
 
     virtual int chanCount() const;
@@ -59,6 +85,7 @@ private slots:
 protected:
     virtual void myInit();
     virtual double mySampRate() const;
+    virtual int myNotchHarms() const    {return p.im.all.fltNotchN;}
     virtual void mySort_ig2ic();
     virtual QString myChanName( int ic ) const;
     virtual const QBitArray& mySaveBits() const;
@@ -68,6 +95,9 @@ protected:
     virtual void saveSettings() const;
 
 private:
+    static void putFillJob( const BiquadJob &B );
+    void putFill( const PutFill &F, int ic0, int icLim );
+    int binMaxRun( const PutFill &F, int ic, int icLim ) const;
     void sAveApplyDmxTbl(
         const ShankMap  &SM,
         qint16          *d,
@@ -8,6 +8,7 @@
 #include "AOCtl.h"
 #include "ChanMapCtl.h"
 #include "ColorTTLCtl.h"
+#include "GraphPub.h"
 #include "SVGrafsM_Ni.h"
 #include "ShankCtl_Ni.h"
 #include "Biquad.h"
@@ -75,7 +76,10 @@ SVGrafsM_Ni::SVGrafsM_Ni(
     (sAveLocal ? sAveApplyLocal( d_ic, ic ) : *d_ic)
 
 
-void SVGrafsM_Ni::putScans( vec_i16 &data, quint64 headCt )
+// fltd: data neural channels already filtered by a shared
+// stage with our band (see viewBand).
+//
+void SVGrafsM_Ni::putScans( vec_i16 &data, quint64 headCt, bool fltd )
 {
 #if 0
     double  tProf = getTime();
@@ -104,8 +108,14 @@ void SVGrafsM_Ni::putScans( vec_i16 &data, quint64 headCt )
 // Push data to shank viewer
 // -------------------------
 
-    if( shankCtl->isVisible() )
-        shankCtl->putScans( data );
+    if( shankCtl->isVisible() ) {
+
+        fltMtx.lock();
+            bool    hp300 = fltd && hipass;
+        fltMtx.unlock();
+
+        shankCtl->putScans( data, hp300 );
+    }
 
 // ------------
 // TTL coloring
@@ -122,10 +132,14 @@ void SVGrafsM_Ni::putScans( vec_i16 &data, quint64 headCt )
     // --------
 
     fltMtx.lock();
-    if( hipass )
-        hipass->applyBlockwiseMem( &data[0], MAX16BIT, ntpts, nC, 0, nNu );
-    if( lopass )
-        lopass->applyBlockwiseMem( &data[0], MAX16BIT, ntpts, nC, 0, nNu );
+    if( !fltd ) {
+        if( hipass )
+            hipass->applyBlockwiseMem( &data[0], MAX16BIT, ntpts, nC, 0, nNu );
+        if( bandpass )
+            bandpass->applyBlockwiseMem( &data[0], MAX16BIT, ntpts, nC, 0, nNu );
+        if( notch )
+            notch->applyBlockwiseMem( &data[0], MAX16BIT, ntpts, nC, 0, nNu );
+    }
     fltMtx.unlock();
 
     // ------------------------------------------
@@ -143,13 +157,10 @@ void SVGrafsM_Ni::putScans( vec_i16 &data, quint64 headCt )
 
     if( set.dcChkOn ) {
 
-        dc.updateLvl( &data[0], ntpts, dwnSmp );
-
-        if( set.bandSel != 1 ) {
-            dc.apply(
-                &data[0], ntpts, 0,
-                (drawBinMax ? 1 : dwnSmp) );
-        }
+        dc.updateApply(
+            &data[0], ntpts,
+            (set.bandSel != 1 ? 0 : neurChanCount()),
+            (drawBinMax ? 1 : dwnSmp) );
     }
 
     // ----
@@ -174,6 +185,12 @@ void SVGrafsM_Ni::putScans( vec_i16 &data, quint64 headCt )
                 &data[0], ntpts, nC, nNu, p.ni.muxFactor,
                 (drawBinMax ? 1 : dwnSmp) );
             break;
+        case 5:
+            sAveApplyGlobal(
+                p.ni.sns.shankMap,
+                &data[0], ntpts, nC, nNu,
+                (drawBinMax ? 1 : dwnSmp), true );
+            break;
         default:
             ;
     }
@@ -185,6 +202,24 @@ void SVGrafsM_Ni::putScans( vec_i16 &data, quint64 headCt )
     std::vector<float>  ybuf( ntpts ),  // append en masse
                         ybuf2( drawBinMax ? ntpts : 0 );
 
+    // Neural binMax rows, all channels at once
+
+    const int               nBin    = ntpts / dwnSmp;
+    bool                    vecBM   = drawBinMax && !sAveLocal && nNu;
+    std::vector<float>      yNu( vecBM ? nNu * nBin : 0 ),
+                            yNu2( vecBM ? nNu * nBin : 0 );
+    std::vector<GraphStats> sNu( vecBM ? nNu : 0 );
+    GraphPubFrame           *G      = 0;
+
+    if( GraphPub::wanted( -1 ) )
+        G = new GraphPubFrame( -1, headCt, dwnSmp, p.ni.srate );
+
+    if( vecBM ) {
+        GraphStats::binMax(
+            &yNu[0], &yNu2[0], nBin, &sNu[0], &data[0],
+            ntpts, nC, nNu, dwnSmp, 1, ysc );
+    }
+
     theX->dataMtx.lock();
 
     for( int ic = 0; ic < nC; ++ic ) {
@@ -230,7 +265,17 @@ void SVGrafsM_Ni::putScans( vec_i16 &data, quint64 headCt )
             // values. This ensures spikes aren't missed.
             // Max in ybuf, min in ybuf2.
 
-            if( drawBinMax ) {
+            if( vecBM ) {
+
+                ic2Y[ic].drawBinMax = true;
+
+                ny      = nBin;
+                stat    = sNu[ic];
+
+                memcpy( &ybuf[0], &yNu[ic * nBin], ny * sizeof(float) );
+                memcpy( &ybuf2[0], &yNu2[ic * nBin], ny * sizeof(float) );
+            }
+            else if( drawBinMax ) {
 
                 int ndRem = ntpts;
 
@@ -317,6 +362,25 @@ putData:
 
         if( ic2Y[ic].drawBinMax )
             ic2Y[ic].yval2.putData( &ybuf2[0], ny );
+
+        if( G && ny ) {
+
+            bool    dig = ic >= p.ni.niCumTypCnt[CniCfg::niSumAnalog];
+
+            G->add(
+                ic, &ybuf[0],
+                (ic2Y[ic].drawBinMax && drawBinMax ? &ybuf2[0] : 0),
+                ny, (dig ? 1 : MAX16BIT), dig );
+        }
+    }
+
+// ------------------------
+// Publish to remote viewer
+// ------------------------
+
+    if( G ) {
+        G->publish();
+        delete G;
     }
 
 // -----------------------
@@ -343,7 +407,8 @@ putData:
 
     drawMtx.unlock();
 
-    QMetaObject::invokeMethod( theM, "update", Qt::QueuedConnection );
+    if( !GraphPub::isHeadless() )
+        QMetaObject::invokeMethod( theM, "updateLive", Qt::QueuedConnection );
 
 // ---------
 // Profiling
@@ -392,6 +457,7 @@ void SVGrafsM_Ni::updateRHSFlags()
         }
     }
 
+    theX->labelsChanged();
     theX->dataMtx.unlock();
     drawMtx.unlock();
 }
@@ -433,9 +499,9 @@ void SVGrafsM_Ni::bandSelChanged( int sel )
         hipass = 0;
     }
 
-    if( lopass ) {
-        delete lopass;
-        lopass = 0;
+    if( bandpass ) {
+        delete bandpass;
+        bandpass = 0;
     }
 
     if( !sel )
@@ -443,8 +509,9 @@ void SVGrafsM_Ni::bandSelChanged( int sel )
     else if( sel == 1 )
         hipass = new Biquad( bq_type_highpass, 300/p.ni.srate );
     else {
-        hipass = new Biquad( bq_type_highpass, 0.1/p.ni.srate );
-        lopass = new Biquad( bq_type_lowpass,  300/p.ni.srate );
+        bandpass = new BiquadCascade;
+        bandpass->add( Biquad( bq_type_highpass, 0.1/p.ni.srate ) );
+        bandpass->add( Biquad( bq_type_lowpass,  300/p.ni.srate ) );
     }
 
     fltMtx.unlock();
@@ -459,6 +526,30 @@ void SVGrafsM_Ni::bandSelChanged( int sel )
 }
 
 
+// Set band B we'd apply to neural channels [0,cLim), and
+// return true if shared data filtered with just that band
+// would do.
+//
+bool SVGrafsM_Ni::viewBand( BiquadBand &B, int &cLim, int &maxInt ) const
+{
+    QMutexLocker    ml( &fltMtx );
+
+    double  notchHz = (notch ? notchSelHz( set.notchSel ) : 0);
+
+    if( hipass )
+        B = BiquadBand( 300, 0, notchHz, p.ni.fltNotchN );
+    else if( bandpass )
+        B = BiquadBand( 0.1, 300, notchHz, p.ni.fltNotchN );
+    else
+        B = BiquadBand( 0, 0, notchHz, p.ni.fltNotchN );
+
+    cLim    = neurChanCount();
+    maxInt  = 32768;
+
+    return !B.isOff();
+}
+
+
 void SVGrafsM_Ni::sAveSelChanged( int sel )
 {
     drawMtx.lock();
@@ -715,6 +806,7 @@ void SVGrafsM_Ni::loadSettings()
     set.clr2        = clrFromString( settings.value( "clr2", "ff44eeff" ).toString() );
     set.navNChan    = settings.value( "navNChan", 32 ).toInt();
     set.bandSel     = settings.value( "bandSel", 0 ).toInt();
+    set.notchSel    = settings.value( "notchSel", 0 ).toInt();
     set.sAveSel     = settings.value( "sAveSel", 0 ).toInt();
     set.dcChkOn     = settings.value( "dcChkOn", false ).toBool();
     set.binMaxOn    = settings.value( "binMaxOn", false ).toBool();
@@ -740,6 +832,7 @@ void SVGrafsM_Ni::saveSettings() const
     settings.setValue( "clr2", clrToString( set.clr2 ) );
     settings.setValue( "navNChan", set.navNChan );
     settings.setValue( "bandSel", set.bandSel );
+    settings.setValue( "notchSel", set.notchSel );
     settings.setValue( "sAveSel", set.sAveSel );
     settings.setValue( "dcChkOn", set.dcChkOn );
     settings.setValue( "binMaxOn", set.binMaxOn );
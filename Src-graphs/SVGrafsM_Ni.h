@@ -17,7 +17,8 @@ public:
         const DAQ::Params   &p,
         int                 jpanel );
 
-    virtual void putScans( vec_i16 &data, quint64 headCt );
+    virtual void putScans( vec_i16 &data, quint64 headCt, bool fltd );
+    virtual bool viewBand( BiquadBand &B, int &cLim, int &maxInt ) const;
     virtual void updateRHSFlags();
 
     virtual int chanCount() const;
@@ -47,6 +48,7 @@ private slots:
 protected:
     virtual void myInit();
     virtual double mySampRate() const;
+    virtual int myNotchHarms() const    {return p.ni.fltNotchN;}
     virtual void mySort_ig2ic();
     virtual QString myChanName( int ic ) const;
     virtual const QBitArray& mySaveBits() const;
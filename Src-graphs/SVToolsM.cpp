@@ -142,6 +142,17 @@ void SVToolsM::init()
     ConnectUI( CB, SIGNAL(currentIndexChanged(int)), gr, SLOT(bandSelChanged(int)) );
     addWidget( CB );
 
+// Notch: Always
+
+    CB = new QComboBox( this );
+    CB->setToolTip( "Notch line noise and harmonics in neural channels  " );
+    CB->addItem( "No Notch" );
+    CB->addItem( "50 Hz" );
+    CB->addItem( "60 Hz" );
+    CB->setCurrentIndex( gr->curNotchSel() );
+    ConnectUI( CB, SIGNAL(currentIndexChanged(int)), gr, SLOT(notchSelChanged(int)) );
+    addWidget( CB );
+
 // -<T> (DC filter): Always
 
     C = new QCheckBox( "-<T>", this );
@@ -167,6 +178,7 @@ void SVToolsM::init()
     CB->addItem( "Loc 2,8" );
     CB->addItem( "Glb All" );
     CB->addItem( "Glb Dmx" );
+    CB->addItem( "Glb Med" );
     CB->setCurrentIndex( gr->curSAveSel() );
     ConnectUI( CB, SIGNAL(currentIndexChanged(int)), gr, SLOT(sAveSelChanged(int)) );
     addWidget( CB );
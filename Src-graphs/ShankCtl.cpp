@@ -8,9 +8,80 @@
 #include "DAQ.h"
 #include "Biquad.h"
 #include "SignalBlocker.h"
+#include "Run.h"
+#include "SpecStream.h"
 
 #include <QAction>
 #include <QCloseEvent>
+#include <QThread>
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SHK_SSE2
+#endif
+
+
+#define SHANK_MAXQ  4   // queued blocks
+
+/* ---------------------------------------------------------------- */
+/* ShankWorker ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void ShankWorker::stop()
+{
+    QMutexLocker    ml( &qMtx );
+
+    pleaseStop = true;
+    condWake.wakeAll();
+}
+
+
+// Called from graph fetcher thread.
+//
+void ShankWorker::enqueue( const vec_i16 &data, bool hp300 )
+{
+    QMutexLocker    ml( &qMtx );
+
+    if( Q.size() >= SHANK_MAXQ )
+        Q.pop_front();
+
+    Q.push_back( Blk() );
+    Q.back().data   = data;
+    Q.back().hp300  = hp300;
+
+    condWake.wakeOne();
+}
+
+
+void ShankWorker::run()
+{
+    Blk B;
+
+    for(;;) {
+
+        qMtx.lock();
+
+            while( Q.empty() && !pleaseStop )
+                condWake.wait( &qMtx );
+
+            if( pleaseStop ) {
+                qMtx.unlock();
+                break;
+            }
+
+            B.data.swap( Q.front().data );
+            B.hp300 = Q.front().hp300;
+            Q.pop_front();
+
+        qMtx.unlock();
+
+        sc->procScans( B.data, B.hp300 );
+    }
+
+    emit finished();
+}
 
 /* ---------------------------------------------------------------- */
 /* class Tally ---------------------------------------------------- */
@@ -40,14 +111,20 @@ void ShankCtl::Tally::updtChanged( double s )
 
 void ShankCtl::Tally::zeroData()
 {
-    vmin.assign( nPads,  99000 );
-    vmax.assign( nPads, -99000 );
+    vmin.assign( nPads,  32767 );
+    vmax.assign( nPads, -32768 );
     sums.assign( nPads,  0 );
     sumSamps    = 0;
     chunksDone  = 0;
 }
 
 
+// Scans outer, so channels run in vector lanes. Per channel,
+// H counts successive samples at or below T (capped at
+// inarow+1) and a spike is tallied as H reaches inarow.
+// The 16-bit tallies N are flushed to sums well before
+// they could overflow (a spike takes at least two scans).
+//
 bool ShankCtl::Tally::countSpikes(
     const short *data,
     int         ntpts,
@@ -62,31 +139,84 @@ bool ShankCtl::Tally::countSpikes(
 
     sumSamps += ntpts;
 
-    for( int c = c0; c < cLim; ++c ) {
+    const short *d      = &data[c0];
+    int         nc      = cLim - c0;
+    qint16      lim     = qBound( 0, inarow, 32766 );
+
+    vT.resize( nc );
+    vHi.resize( nc );
+    vN.assign( nc, 0 );
+
+    for( int i = 0; i < nc; ++i ) {
+
+        int T = (ip >= 0 ?
+                    p.im.each[ip].vToInt( thresh*1e-6, i ) :
+                    p.ni.vToInt16( thresh*1e-6, i ));
+
+        vT[i]   = qBound( -32768, T, 32767 );
+        vHi[i]  = (d[i] <= vT[i] ? lim : 0);
+    }
+
+    qint16  *T = &vT[0],
+            *H = &vHi[0],
+            *N = &vN[0];
 
-        const short *d      = &data[c],
-                    *dlim   = &data[c + ntpts*nchans];
-        int i       = c - c0,
-            T       = (ip >= 0 ?
-                        p.im.each[ip].vToInt( thresh*1e-6, i ) :
-                        p.ni.vToInt16( thresh*1e-6, i ));
-        int hiCnt   = (*d <= T ? inarow : 0),
-            spikes  = 0;
+#ifdef SHK_SSE2
+    const __m128i   vLim    = _mm_set1_epi16( lim ),
+                    vCap    = _mm_set1_epi16( lim + 1 ),
+                    one     = _mm_set1_epi16( 1 );
+#endif
 
-        while( (d += nchans) < dlim ) {
+    for( int it = 1; it < ntpts; ++it ) {
 
-            if( *d <= T ) {
+        d += nchans;
 
-                if( ++hiCnt == inarow )
-                    ++spikes;
+        int i = 0;
+
+#ifdef SHK_SSE2
+        for( ; i + 8 <= nc; i += 8 ) {
+
+            __m128i v   = _mm_loadu_si128( (const __m128i*)&d[i] ),
+                    h   = _mm_loadu_si128( (const __m128i*)&H[i] ),
+                    n   = _mm_loadu_si128( (const __m128i*)&N[i] ),
+                    gt  = _mm_cmpgt_epi16(
+                            v, _mm_loadu_si128( (const __m128i*)&T[i] ) );
+
+            h = _mm_andnot_si128(
+                    gt, _mm_min_epi16( _mm_adds_epi16( h, one ), vCap ) );
+            n = _mm_sub_epi16(
+                    n, _mm_andnot_si128( gt, _mm_cmpeq_epi16( h, vLim ) ) );
+
+            _mm_storeu_si128( (__m128i*)&H[i], h );
+            _mm_storeu_si128( (__m128i*)&N[i], n );
+        }
+#endif
+
+        for( ; i < nc; ++i ) {
+
+            if( d[i] <= T[i] ) {
+
+                H[i] = qMin( H[i] + 1, lim + 1 );
+
+                if( H[i] == lim )
+                    ++N[i];
             }
             else
-                hiCnt = 0;
+                H[i] = 0;
         }
 
-        sums[i] += spikes;
+        if( !(it & 0x3FFF) ) {
+
+            for( int k = 0; k < nc; ++k ) {
+                sums[k] += N[k];
+                N[k]     = 0;
+            }
+        }
     }
 
+    for( int i = 0; i < nc; ++i )
+        sums[i] += N[i];
+
     bool    done = ++chunksDone >= chunksReqd;
 
     if( done ) {
@@ -112,18 +242,34 @@ bool ShankCtl::Tally::accumPkPk(
     if( !ntpts )
         return false;
 
+    qint16  *mn = &vmin[0],
+            *mx = &vmax[0];
+    int     nc  = cLim - c0;
+
     for( int it = 0; it < ntpts; ++it, data += nchans ) {
 
-        for( int c = c0; c < cLim; ++c ) {
+        const short *d = &data[c0];
+        int         i  = 0;
 
-            int v = data[c],
-                i = c - c0;
+#ifdef SHK_SSE2
+        for( ; i + 8 <= nc; i += 8 ) {
 
-            if( v < vmin[i] )
-                vmin[i] = v;
+            __m128i v = _mm_loadu_si128( (const __m128i*)&d[i] );
 
-            if( v > vmax[i] )
-                vmax[i] = v;
+            _mm_storeu_si128( (__m128i*)&mn[i],
+                _mm_min_epi16( _mm_loadu_si128( (const __m128i*)&mn[i] ), v ) );
+            _mm_storeu_si128( (__m128i*)&mx[i],
+                _mm_max_epi16( _mm_loadu_si128( (const __m128i*)&mx[i] ), v ) );
+        }
+#endif
+
+        for( ; i < nc; ++i ) {
+
+            if( d[i] < mn[i] )
+                mn[i] = d[i];
+
+            if( d[i] > mx[i] )
+                mx[i] = d[i];
         }
     }
 
@@ -132,7 +278,7 @@ bool ShankCtl::Tally::accumPkPk(
     if( done ) {
 
         for( int i = 0; i < nPads; ++i )
-            sums[i] = vmax[i] - vmin[i];
+            sums[i] = int(vmax[i]) - vmin[i];
     }
 
     return done;
@@ -144,21 +290,24 @@ bool ShankCtl::Tally::accumPkPk(
 
 ShankCtl::ShankCtl( const DAQ::Params &p, int jpanel, QWidget *parent )
     :   QWidget(parent), p(p), scUI(0), tly(p),
-        hipass(0), lopass(0), jpanel(jpanel)
+        hipass(0), bandpass(0), thread(0), worker(0),
+        specGen(0), jpanel(jpanel), hp300In(false)
 {
 }
 
 
 ShankCtl::~ShankCtl()
 {
+    stopWorker();
+
     drawMtx.lock();
         if( hipass ) {
             delete hipass;
             hipass = 0;
         }
-        if( lopass ) {
-            delete lopass;
-            lopass = 0;
+        if( bandpass ) {
+            delete bandpass;
+            bandpass = 0;
         }
     drawMtx.unlock();
 
@@ -188,6 +337,29 @@ void ShankCtl::update()
 }
 
 
+// Caller still owns data; a copy is queued for the worker.
+//
+// hp300: neural (AP) channels already highpassed at 300 Hz
+// by the shared filter stage.
+//
+void ShankCtl::putScans( const vec_i16 &data, bool hp300 )
+{
+    if( worker )
+        worker->enqueue( data, hp300 );
+}
+
+
+// Can we use a block with the neural (AP) channels already
+// highpassed at 300 Hz (doesn't disturb the current mode)?
+//
+bool ShankCtl::takesHp300() const
+{
+    QMutexLocker    ml( &drawMtx );
+
+    return set.what != 2;
+}
+
+
 void ShankCtl::selChan( int ic, const QString &name )
 {
     const ShankMap  *M = scUI->scroll->theV->getSmap();
@@ -221,6 +393,7 @@ void ShankCtl::whatChanged( int i )
         scUI->rngSB->setValue( set.rng[i] );
         updateFilter( false );
         tly.zeroData();
+        specGen = 0;
         scUI->scroll->theV->colorPads( tly.sums, 1e99 );
         QMetaObject::invokeMethod(
             scUI->scroll->theV,
@@ -330,6 +503,78 @@ void ShankCtl::baseInit( int ip )
     setAttribute( Qt::WA_DeleteOnClose, false );
 
     tly.init( set.updtSecs, ip );
+
+    thread  = new QThread;
+    worker  = new ShankWorker( this );
+
+    worker->moveToThread( thread );
+
+    Connect( thread, SIGNAL(started()), worker, SLOT(run()) );
+    Connect( worker, SIGNAL(finished()), worker, SLOT(deleteLater()) );
+    Connect( worker, SIGNAL(destroyed()), thread, SLOT(quit()), Qt::DirectConnection );
+
+    thread->start();
+}
+
+
+// Subclass destructors call this, as worker calls
+// their procScans().
+//
+// worker object auto-deleted asynchronously
+// thread object manually deleted synchronously (so we can call wait())
+//
+void ShankCtl::stopWorker()
+{
+    if( !thread )
+        return;
+
+    if( thread->isRunning() ) {
+        worker->stop();
+        thread->wait();
+    }
+
+    delete thread;
+    thread = 0;
+    worker = 0;
+}
+
+
+// Spectral modes color pads from the run's spectral stage
+// rather than the block; blocks just pace the polling, and
+// polling keeps the stage alive. Caller holds drawMtx.
+//
+// - what 3: LF rms uV, sqrt of 1-300 Hz band power.
+// - what 4: line noise dB, worse of 50 and 60 Hz lines.
+//
+void ShankCtl::specUpdate( int ip )
+{
+    SpecSnap    S;
+
+    if( !mainApp()->getRun()->specSnapshot( S, ip, set.updtSecs )
+        || S.gen == specGen ) {
+
+        return;
+    }
+
+    specGen = S.gen;
+
+    int n = qMin( S.nCh, (int)tly.sums.size() );
+
+    for( int i = 0; i < n; ++i ) {
+
+        if( set.what == 3 )
+            tly.sums[i] = sqrt( S.bandPower( i, 1, 300 ) );
+        else
+            tly.sums[i] = qMax( S.lineDb( i, 50 ), S.lineDb( i, 60 ) );
+    }
+
+    if( scUI->scroll->theV->colorPads( tly.sums, set.rng[set.what] ) ) {
+
+        QMetaObject::invokeMethod(
+            scUI->scroll->theV,
+            "updateNow",
+            Qt::QueuedConnection );
+    }
 }
 
 
@@ -5,6 +5,9 @@
 
 #include <QWidget>
 #include <QMutex>
+#include <QWaitCondition>
+
+#include <deque>
 
 namespace Ui {
 class ShankWindow;
@@ -15,15 +18,56 @@ struct Params;
 }
 
 class Biquad;
+class BiquadCascade;
+class ShankCtl;
+
+class QThread;
 
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
+// Worker filters and tallies the blocks queued by the graph
+// fetcher, keeping the shank work off the trace drawing path.
+// If the backlog grows the oldest blocks are dropped.
+//
+class ShankWorker : public QObject
+{
+    Q_OBJECT
+
+private:
+    struct Blk {
+        vec_i16 data;
+        bool    hp300;
+    };
+
+    ShankCtl            *sc;
+    std::deque<Blk>     Q;
+    QMutex              qMtx;
+    QWaitCondition      condWake;
+    bool                pleaseStop;
+
+public:
+    ShankWorker( ShankCtl *sc )
+    :   QObject(0), sc(sc), pleaseStop(false)   {}
+
+    void stop();
+    void enqueue( const vec_i16 &data, bool hp300 );
+
+signals:
+    void finished();
+
+public slots:
+    void run();
+};
+
+
 class ShankCtl : public QWidget
 {
     Q_OBJECT
 
+    friend class ShankWorker;
+
 protected:
     struct UsrSettings {
         double  updtSecs;
@@ -31,14 +75,17 @@ protected:
                 what,
                 thresh, // uV
                 inarow,
-                rng[3]; // {rate, uV, uV}
+                rng[5]; // {rate, uV, uV, uV, dB}
     };
 
     class Tally {
     private:
         const DAQ::Params   &p;
-        std::vector<int>    vmin,
-                            vmax;
+        std::vector<qint16> vmin,
+                            vmax,
+                            vT,
+                            vHi,
+                            vN;
         double              sumSamps;
         int                 ip,
                             chunksDone,
@@ -72,10 +119,14 @@ protected:
     Ui::ShankWindow     *scUI;
     UsrSettings         set;
     Tally               tly;
-    Biquad              *hipass,
-                        *lopass;
+    Biquad              *hipass;
+    BiquadCascade       *bandpass;
+    QThread             *thread;
+    ShankWorker         *worker;
+    quint64             specGen;
     int                 nzero,
                         jpanel;
+    bool                hp300In;
     mutable QMutex      drawMtx;
 
 public:
@@ -89,7 +140,8 @@ public:
     void update();
     void selChan( int ic, const QString &name );
 
-    virtual void putScans( const vec_i16 &_data ) = 0;
+    virtual bool takesHp300() const;
+    void putScans( const vec_i16 &data, bool hp300 );
 
 signals:
     void selChanged( int ic, bool shift );
@@ -111,6 +163,11 @@ private slots:
 
 protected:
     void baseInit( int ip );
+    void stopWorker();
+
+    virtual void procScans( vec_i16 &_data, bool hp300 ) = 0;
+
+    void specUpdate( int ip );
 
     void zeroFilterTransient( short *data, int ntpts, int nchans );
 
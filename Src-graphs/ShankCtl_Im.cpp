@@ -47,7 +47,19 @@ void ShankCtl_Im::mapChanged()
 }
 
 
-void ShankCtl_Im::putScans( const vec_i16 &_data )
+// LF mode takes hp300 blocks only if LF chans are separate.
+//
+bool ShankCtl_Im::takesHp300() const
+{
+    QMutexLocker    ml( &drawMtx );
+
+    return set.what != 2 || p.im.each[ip].roTbl->nLF();
+}
+
+
+// Called from worker thread.
+//
+void ShankCtl_Im::procScans( vec_i16 &_data, bool hp300 )
 {
     const CimCfg::AttrEach  &E = p.im.each[ip];
 
@@ -62,6 +74,29 @@ void ShankCtl_Im::putScans( const vec_i16 &_data )
 
     drawMtx.lock();
 
+    if( set.what >= 3 ) {
+        specUpdate( ip );
+        drawMtx.unlock();
+        return;
+    }
+
+// ----------------------------------------
+// Skip our hipass if AP already done (or
+// drop a block the mode can't use anymore)
+// ----------------------------------------
+
+    bool    useHp = hp300 && set.what < 2;
+
+    if( hp300 && !useHp && !E.roTbl->nLF() ) {
+        drawMtx.unlock();
+        return;
+    }
+
+    if( useHp != hp300In ) {
+        hp300In = useHp;
+        updateFilter( false );
+    }
+
 // -----------------------------
 // Make local copy we can filter
 // -----------------------------
@@ -69,14 +104,17 @@ void ShankCtl_Im::putScans( const vec_i16 &_data )
     vec_i16 data;
 
     if( set.what < 2 || !E.roTbl->nLF() )
-        Subset::subsetBlock( data, *(vec_i16*)&_data, 0, nAP, nC );
+        Subset::subsetBlock( data, _data, 0, nAP, nC );
     else
-        Subset::subsetBlock( data, *(vec_i16*)&_data, nAP, nNu, nC );
+        Subset::subsetBlock( data, _data, nAP, nNu, nC );
 
-    hipass->applyBlockwiseMem( &data[0], maxInt, ntpts, nAP, 0, nAP );
+    if( !useHp ) {
 
-    if( lopass )
-        lopass->applyBlockwiseMem( &data[0], maxInt, ntpts, nAP, 0, nAP );
+        if( bandpass )
+            bandpass->applyBlockwiseMem( &data[0], maxInt, ntpts, nAP, 0, nAP );
+        else
+            hipass->applyBlockwiseFxp( &data[0], maxInt, ntpts, nAP, 0, nAP );
+    }
 
     zeroFilterTransient( &data[0], ntpts, nAP );
 
@@ -124,14 +162,18 @@ void ShankCtl_Im::putScans( const vec_i16 &_data )
 
     if( done ) {
 
-        scUI->scroll->theV->colorPads( tly.sums, set.rng[set.what] );
+        bool    changed =
+                scUI->scroll->theV->colorPads( tly.sums, set.rng[set.what] );
 
         tly.zeroData();
 
-        QMetaObject::invokeMethod(
-            scUI->scroll->theV,
-            "updateNow",
-            Qt::QueuedConnection );
+        if( changed ) {
+
+            QMetaObject::invokeMethod(
+                scUI->scroll->theV,
+                "updateNow",
+                Qt::QueuedConnection );
+        }
     }
 
     drawMtx.unlock();
@@ -191,21 +233,21 @@ void ShankCtl_Im::updateFilter( bool lock )
         hipass = 0;
     }
 
-    if( lopass ) {
-        delete lopass;
-        lopass = 0;
+    if( bandpass ) {
+        delete bandpass;
+        bandpass = 0;
     }
 
     const CimCfg::AttrEach  &E = p.im.each[ip];
 
     if( set.what < 2 )
         hipass = new Biquad( bq_type_highpass, 300/E.srate );
-    else {
-
+    else if( E.roTbl->nLF() )
         hipass = new Biquad( bq_type_highpass, 0.2/E.srate );
-
-        if( !E.roTbl->nLF() )
-            lopass = new Biquad( bq_type_lowpass, 300/E.srate );
+    else {
+        bandpass = new BiquadCascade;
+        bandpass->add( Biquad( bq_type_highpass, 0.2/E.srate ) );
+        bandpass->add( Biquad( bq_type_lowpass, 300/E.srate ) );
     }
 
     nzero = BIQUAD_TRANS_WIDE;
@@ -230,6 +272,8 @@ void ShankCtl_Im::loadSettings()
     set.rng[0]      = settings.value( "rngSpk", 1000 ).toInt();
     set.rng[1]      = settings.value( "rngAP", 100 ).toInt();
     set.rng[2]      = settings.value( "rngLF", 100 ).toInt();
+    set.rng[3]      = settings.value( "rngLFPow", 50 ).toInt();
+    set.rng[4]      = settings.value( "rngLine", 20 ).toInt();
     settings.endGroup();
 }
 
@@ -247,6 +291,8 @@ void ShankCtl_Im::saveSettings() const
     settings.setValue( "rngSpk", set.rng[0] );
     settings.setValue( "rngAP", set.rng[1] );
     settings.setValue( "rngLF", set.rng[2] );
+    settings.setValue( "rngLFPow", set.rng[3] );
+    settings.setValue( "rngLine", set.rng[4] );
     settings.endGroup();
 }
 
@@ -20,16 +20,19 @@ public:
         int                 ip,
         int                 jpanel,
         QWidget             *parent = 0 );
+    virtual ~ShankCtl_Im()  {stopWorker();}
+
     virtual void init();
     virtual void mapChanged();
 
-    virtual void putScans( const vec_i16 &_data );
+    virtual bool takesHp300() const;
 
 public slots:
     virtual void cursorOver( int ic, bool shift );
     virtual void lbutClicked( int ic, bool shift );
 
 protected:
+    virtual void procScans( vec_i16 &_data, bool hp300 );
     virtual void updateFilter( bool lock );
 
     virtual void loadSettings();
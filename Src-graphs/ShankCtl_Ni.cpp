@@ -46,7 +46,9 @@ void ShankCtl_Ni::mapChanged()
 }
 
 
-void ShankCtl_Ni::putScans( const vec_i16 &_data )
+// Called from worker thread.
+//
+void ShankCtl_Ni::procScans( vec_i16 &_data, bool hp300 )
 {
     double      ysc     = 1e6 * p.ni.range.rmax / MAX16BIT;
     const int   nC      = p.ni.niCumTypCnt[CniCfg::niSumAll],
@@ -55,17 +57,41 @@ void ShankCtl_Ni::putScans( const vec_i16 &_data )
 
     drawMtx.lock();
 
+    if( set.what >= 3 ) {
+        specUpdate( -1 );
+        drawMtx.unlock();
+        return;
+    }
+
+// ----------------------------------------
+// Skip our hipass if neural already done
+// (or drop a block LF mode can't use)
+// ----------------------------------------
+
+    if( hp300 && set.what == 2 ) {
+        drawMtx.unlock();
+        return;
+    }
+
+    if( hp300 != hp300In ) {
+        hp300In = hp300;
+        updateFilter( false );
+    }
+
 // -----------------------------
 // Make local copy we can filter
 // -----------------------------
 
     vec_i16 data;
-    Subset::subsetBlock( data, *(vec_i16*)&_data, 0, nNu, nC );
+    Subset::subsetBlock( data, _data, 0, nNu, nC );
 
-    hipass->applyBlockwiseMem( &data[0], MAX16BIT, ntpts, nNu, 0, nNu );
+    if( !hp300 ) {
 
-    if( lopass )
-        lopass->applyBlockwiseMem( &data[0], MAX16BIT, ntpts, nNu, 0, nNu );
+        if( bandpass )
+            bandpass->applyBlockwiseMem( &data[0], MAX16BIT, ntpts, nNu, 0, nNu );
+        else
+            hipass->applyBlockwiseMem( &data[0], MAX16BIT, ntpts, nNu, 0, nNu );
+    }
 
     zeroFilterTransient( &data[0], ntpts, nNu );
 
@@ -101,14 +127,18 @@ void ShankCtl_Ni::putScans( const vec_i16 &_data )
 
     if( done ) {
 
-        scUI->scroll->theV->colorPads( tly.sums, set.rng[set.what] );
+        bool    changed =
+                scUI->scroll->theV->colorPads( tly.sums, set.rng[set.what] );
 
         tly.zeroData();
 
-        QMetaObject::invokeMethod(
-            scUI->scroll->theV,
-            "updateNow",
-            Qt::QueuedConnection );
+        if( changed ) {
+
+            QMetaObject::invokeMethod(
+                scUI->scroll->theV,
+                "updateNow",
+                Qt::QueuedConnection );
+        }
     }
 
     drawMtx.unlock();
@@ -158,16 +188,17 @@ void ShankCtl_Ni::updateFilter( bool lock )
         hipass = 0;
     }
 
-    if( lopass ) {
-        delete lopass;
-        lopass = 0;
+    if( bandpass ) {
+        delete bandpass;
+        bandpass = 0;
     }
 
     if( set.what < 2 )
         hipass = new Biquad( bq_type_highpass, 300/p.ni.srate );
     else {
-        hipass = new Biquad( bq_type_highpass, 0.2/p.ni.srate );
-        lopass = new Biquad( bq_type_lowpass,  300/p.ni.srate );
+        bandpass = new BiquadCascade;
+        bandpass->add( Biquad( bq_type_highpass, 0.2/p.ni.srate ) );
+        bandpass->add( Biquad( bq_type_lowpass,  300/p.ni.srate ) );
     }
 
     nzero = BIQUAD_TRANS_WIDE;
@@ -192,6 +223,8 @@ void ShankCtl_Ni::loadSettings()
     set.rng[0]      = settings.value( "rngSpk", 1000 ).toInt();
     set.rng[1]      = settings.value( "rngAP", 100 ).toInt();
     set.rng[2]      = settings.value( "rngLF", 100 ).toInt();
+    set.rng[3]      = settings.value( "rngLFPow", 50 ).toInt();
+    set.rng[4]      = settings.value( "rngLine", 20 ).toInt();
     settings.endGroup();
 }
 
@@ -209,6 +242,8 @@ void ShankCtl_Ni::saveSettings() const
     settings.setValue( "rngSpk", set.rng[0] );
     settings.setValue( "rngAP", set.rng[1] );
     settings.setValue( "rngLF", set.rng[2] );
+    settings.setValue( "rngLFPow", set.rng[3] );
+    settings.setValue( "rngLine", set.rng[4] );
     settings.endGroup();
 }
 
@@ -16,16 +16,17 @@ public:
         const DAQ::Params   &p,
         int                 jpanel,
         QWidget             *parent = 0 );
+    virtual ~ShankCtl_Ni()  {stopWorker();}
+
     virtual void init();
     virtual void mapChanged();
 
-    virtual void putScans( const vec_i16 &_data );
-
 public slots:
     virtual void cursorOver( int ic, bool shift );
     virtual void lbutClicked( int ic, bool shift );
 
 protected:
+    virtual void procScans( vec_i16 &_data, bool hp300 );
     virtual void updateFilter( bool lock );
 
     virtual void loadSettings();
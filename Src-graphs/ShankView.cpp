@@ -92,16 +92,23 @@ void ShankView::setSel( int ic )
 // Compare each val[i] to range [0..rngMax] and assign
 // appropriate lut color to the vC[{i}] for that pad.
 //
+// Only pads whose lut index moved are rewritten; return
+// true if any did, so caller can skip a needless repaint.
+//
 // Assumed: val.size() = smap->e.size().
 //
-void ShankView::colorPads( const std::vector<double> &val, double rngMax )
+bool ShankView::colorPads( const std::vector<double> &val, double rngMax )
 {
     QMutexLocker    ml( &dataMtx );
 
     if( !smap )
-        return;
+        return false;
 
-    int ne = smap->e.size();
+    int     ne      = smap->e.size();
+    bool    changed = false;
+
+    if( (int)vI.size() != ne )
+        return false;
 
     for( int i = 0; i < ne; ++i ) {
 
@@ -118,13 +125,21 @@ void ShankView::colorPads( const std::vector<double> &val, double rngMax )
                 ilut = 255 * val[i]/rngMax;
         }
 
+        if( ilut == vI[i] )
+            continue;
+
         SColor  *C = &vC[4*i];
 
         C[0] = lut[ilut];
         C[1] = lut[ilut];
         C[2] = lut[ilut];
         C[3] = lut[ilut];
+
+        vI[i]   = ilut;
+        changed = true;
     }
+
+    return changed;
 }
 
 
@@ -311,6 +326,7 @@ void ShankView::resizePads()
         vR.resize( 8*ne );          // 2 float/vtx, 4 vtx/rect
 
     vC.assign( 4*ne, SColor() );    // 1 color/vtx, 4 vtx/rect
+    vI.assign( ne, -1 );
 
     pmrg    = PADMRG*(VRGT-VLFT)/w;
     colWid  = (shkWid - 2*pmrg)/(nc + (nc-1)*COLSEP);
@@ -32,6 +32,7 @@ private:
     QMap<ShankMapDesc,uint> ISM;
     std::vector<float>      vR;
     std::vector<SColor>     vC;
+    std::vector<int>        vI;     // lut index per pad, -1 = none
     mutable QMutex          dataMtx;
     float                   shkWid,
                             hlfWid,
@@ -54,7 +55,7 @@ public:
     void setSel( int ic );
     int getSel()                {return sel;}
 
-    void colorPads( const std::vector<double> &val, double rngMax );
+    bool colorPads( const std::vector<double> &val, double rngMax );
 
 signals:
     void cursorOver( int ic, bool shift );
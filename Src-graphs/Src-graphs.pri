@@ -3,8 +3,10 @@ HEADERS += \
     $$PWD/ColorTTLCtl.h \
     $$PWD/FileViewerWindow.h \
     $$PWD/FVScanGrp.h \
+    $$PWD/FVShankMap.h \
     $$PWD/FVToolbar.h \
     $$PWD/GraphFetcher.h \
+    $$PWD/GraphPub.h \
     $$PWD/GraphStats.h \
     $$PWD/GraphsWindow.h \
     $$PWD/GWLEDWidget.h \
@@ -30,8 +32,10 @@ SOURCES += \
     $$PWD/ColorTTLCtl.cpp \
     $$PWD/FileViewerWindow.cpp \
     $$PWD/FVScanGrp.cpp \
+    $$PWD/FVShankMap.cpp \
     $$PWD/FVToolbar.cpp \
     $$PWD/GraphFetcher.cpp \
+    $$PWD/GraphPub.cpp \
     $$PWD/GraphStats.cpp \
     $$PWD/GraphsWindow.cpp \
     $$PWD/GWLEDWidget.cpp \
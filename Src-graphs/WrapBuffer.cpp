@@ -15,6 +15,8 @@ WrapBuffer &WrapBuffer::operator=( const WrapBuffer &rhs )
 
     head    = rhs.head;
     len     = rhs.len;
+    nPut    = 0;
+    ++gen;
 
     memcpy( buf, rhs.buf, bufsz );
 
@@ -34,12 +36,16 @@ void WrapBuffer::resizeAndErase( uint newSize )
     }
 
     len = head = 0;
+    nPut = 0;
+    ++gen;
 }
 
 
 void WrapBuffer::zeroFill()
 {
     memset( buf, 0, bufsz );
+    nPut = 0;
+    ++gen;
 }
 
 
@@ -81,6 +87,8 @@ void WrapBuffer::putData( const void *data, uint nBytes )
 {
     const char  *src = (const char*)data;
 
+    nPut += nBytes;
+
     if( nBytes >= bufsz ) {
         // Keep only newest bufsz-worth.
         head    = 0;
@@ -7,23 +7,32 @@
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
+// putCount() and generation() let a mirror (e.g., a GPU copy)
+// update incrementally: if generation is unchanged and fewer
+// than capacity bytes were put since it last synced, only the
+// slots ending at cursor() are new.
+//
 class WrapBuffer
 {
 private:
     char    *buf;
+    quint64 nPut;   // bytes put this generation
     uint    bufsz,
             head,
-            len;
+            len,
+            gen;    // bumped by any other change
 
 public:
-    WrapBuffer( uint size = 0 ) : buf(0), bufsz(0) {resizeAndErase(size);}
-    WrapBuffer( const WrapBuffer &rhs ) : buf(0), bufsz(0) {*this=rhs;}
+    WrapBuffer( uint size = 0 ) : buf(0), bufsz(0), gen(0)
+        {resizeAndErase(size);}
+    WrapBuffer( const WrapBuffer &rhs ) : buf(0), bufsz(0), gen(0)
+        {*this=rhs;}
     virtual ~WrapBuffer()   {killbuf();}
 
     WrapBuffer &operator=( const WrapBuffer &rhs );
 
     void resizeAndErase( uint newSize );
-    void erase() {head = len = 0;}
+    void erase() {head = len = 0; nPut = 0; ++gen;}
     void zeroFill();
 
     uint capacity() const           {return bufsz;}
@@ -31,6 +40,8 @@ public:
     uint unusedCapacity() const     {return bufsz - len;}
     uint cursor() const             {return (head+len) % bufsz;}
     bool isBufferWrapped() const    {return head+len > bufsz;}
+    quint64 putCount() const        {return nPut;}
+    uint generation() const         {return gen;}
 
     void rangesPutWillChange(
         uint    &r10,
@@ -84,6 +95,12 @@ public:
     bool isBufferWrapped() const
         {return WrapBuffer::isBufferWrapped();}
 
+    quint64 putCount() const
+        {return WrapBuffer::putCount()/sizeof(T);}
+
+    uint generation() const
+        {return WrapBuffer::generation();}
+
     void rangesPutWillChange(
         uint    &r10,
         uint    &r1Lim,
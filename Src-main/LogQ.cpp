@@ -0,0 +1,312 @@
+
+#include "LogQ.h"
+#include "Util.h"
+#include "MainApp.h"
+#include "ConsoleWindow.h"
+
+#include <QThread>
+
+#include <iostream>
+
+
+// Milliseconds between sweeps of rate limit windows.
+#define LOGQ_SWEEPMS    1000
+
+// Forget a message shape idle this long.
+#define LOGQ_FORGETMS   10000
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+LogQ::Slot              LogQ::ring[LogQ::NREC];
+std::atomic<quint64>    LogQ::wr( 0 );
+std::atomic<quint64>    LogQ::nDrop( 0 );
+quint64                 LogQ::rd = 0;
+std::atomic<bool>       LogQ::running( false );
+QThread                 *LogQ::thread = 0;
+LogQWorker              *LogQ::worker = 0;
+
+
+// Message text less digits, so lines differing only in
+// counts, indices or times share a rate limit.
+//
+static QString shape( const QString &s )
+{
+    QString S;
+    S.reserve( s.size() );
+
+    for( int i = 0, n = s.size(); i < n; ++i ) {
+
+        if( !s[i].isDigit() )
+            S += s[i];
+    }
+
+    return S;
+}
+
+/* ---------------------------------------------------------------- */
+/* LogQWorker ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void LogQWorker::run()
+{
+    for(;;) {
+
+        bool    stopping = pleaseStop;
+        LogRec  R;
+
+        while( LogQ::take( R ) )
+            LogQ::deliver( R, admit( R ) );
+
+        if( quint64 n = LogQ::nDrop.exchange( 0 ) ) {
+
+            R           = LogRec();
+            R.str       = QString("Log queue full: %1 lines dropped.").arg( n );
+            R.color     = Qt::darkMagenta;
+            R.msecs     = QDateTime::currentMSecsSinceEpoch();
+            R.thd       = (quint64)QThread::currentThreadId();
+            R.flags     = LogRec::lrEco;
+            LogQ::deliver( R );
+        }
+
+        qint64  t = QDateTime::currentMSecsSinceEpoch();
+
+        if( t - tSweep >= LOGQ_SWEEPMS )
+            sweep( t );
+
+        if( stopping )
+            break;
+
+        QThread::msleep( 5 );
+    }
+
+    sweep( QDateTime::currentMSecsSinceEpoch() + LOGQ_FORGETMS );
+
+    emit finished();
+}
+
+
+bool LogQWorker::admit( const LogRec &R )
+{
+    Site    &S = sites[shape( R.str )];
+
+    if( R.msecs - S.t0 >= 1000 ) {
+
+        if( S.nSup )
+            suppressed( S, R.color );
+
+        S.t0    = R.msecs;
+        S.n     = 0;
+        S.nSup  = 0;
+    }
+
+    if( ++S.n <= LogQ::SITEBURST )
+        return true;
+
+    ++S.nSup;
+    return false;
+}
+
+
+// Report bursts whose window has ended; forget idle shapes.
+//
+void LogQWorker::sweep( qint64 t )
+{
+    QHash<QString,Site>::iterator   it = sites.begin();
+
+    while( it != sites.end() ) {
+
+        Site    &S = it.value();
+
+        if( t - S.t0 >= 1000 && S.nSup ) {
+            suppressed( S, Qt::darkMagenta );
+            S.nSup = 0;
+        }
+
+        if( t - S.t0 >= LOGQ_FORGETMS )
+            it = sites.erase( it );
+        else
+            ++it;
+    }
+
+    tSweep = t;
+}
+
+
+void LogQWorker::suppressed( const Site &S, const QColor &color )
+{
+    LogRec  R;
+
+    R.str   = QString("(%1 similar lines suppressed)").arg( S.nSup );
+    R.color = color;
+    R.msecs = QDateTime::currentMSecsSinceEpoch();
+    R.thd   = (quint64)QThread::currentThreadId();
+    LogQ::deliver( R );
+}
+
+/* ---------------------------------------------------------------- */
+/* LogQ ----------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Call from main thread, before any other threads log.
+//
+void LogQ::start()
+{
+    if( thread )
+        return;
+
+    for( int i = 0; i < NREC; ++i )
+        ring[i].seq.store( i, std::memory_order_relaxed );
+
+    wr.store( 0, std::memory_order_relaxed );
+    rd = 0;
+
+    thread  = new QThread;
+    worker  = new LogQWorker;
+
+    worker->moveToThread( thread );
+
+    Connect( thread, SIGNAL(started()), worker, SLOT(run()) );
+    Connect( worker, SIGNAL(finished()), thread, SLOT(quit()), Qt::DirectConnection );
+
+    thread->start();
+
+    running.store( true, std::memory_order_release );
+}
+
+
+// Revert to synchronous delivery, drain, join logger thread.
+//
+void LogQ::stop()
+{
+    if( !thread )
+        return;
+
+    running.store( false, std::memory_order_release );
+
+// Let posts already past the running check land
+
+    QThread::msleep( 10 );
+
+    worker->stop();
+    thread->wait();
+
+    delete worker;
+    delete thread;
+    worker = 0;
+    thread = 0;
+}
+
+
+// Return false if not running (caller delivers), else true
+// (posted, or dropped if full). R.str is taken.
+//
+bool LogQ::post( LogRec &R )
+{
+    if( !running.load( std::memory_order_acquire ) )
+        return false;
+
+    quint64 pos = wr.load( std::memory_order_relaxed );
+
+    for(;;) {
+
+        Slot    &S  = ring[pos & (NREC - 1)];
+        qint64  dif = qint64(S.seq.load( std::memory_order_acquire ) - pos);
+
+        if( !dif ) {
+
+            if( wr.compare_exchange_weak( pos, pos + 1,
+                    std::memory_order_relaxed ) ) {
+
+                S.rec.str.swap( R.str );
+                S.rec.color = R.color;
+                S.rec.msecs = R.msecs;
+                S.rec.thd   = R.thd;
+                S.rec.cpu   = R.cpu;
+                S.rec.flags = R.flags;
+
+                S.seq.store( pos + 1, std::memory_order_release );
+                return true;
+            }
+        }
+        else if( dif < 0 ) {
+            nDrop.fetch_add( 1, std::memory_order_relaxed );
+            return true;
+        }
+        else
+            pos = wr.load( std::memory_order_relaxed );
+    }
+}
+
+
+// Format and deliver R. If !show, only the disk record
+// (errors) is made.
+//
+void LogQ::deliver( const LogRec &R, bool show )
+{
+    QString msg =
+        QString("[Thd %1 CPU %2 %3] %4")
+            .arg( R.thd )
+            .arg( R.cpu )
+            .arg( dateTime2Str(
+                    QDateTime::fromMSecsSinceEpoch( R.msecs ),
+                    "M/dd/yy hh:mm:ss.zzz" ) )
+            .arg( R.str );
+
+    MainApp *app = mainApp();
+
+    if( !app ) {
+        std::cerr << STR2CHR( msg ) << "\n";
+        return;
+    }
+
+    if( show ) {
+
+        if( R.flags & (LogRec::lrRaise | LogRec::lrTray) ) {
+
+            if( app->isConsoleHidden() )
+                Systray( true ) << R.str;
+            else if( R.flags & LogRec::lrRaise ) {
+                ConsoleWindow   *w = app->console();
+                QMetaObject::invokeMethod( w, "showNormal", Qt::AutoConnection );
+                QMetaObject::invokeMethod( w, "raise", Qt::AutoConnection );
+                w->activateWindow();
+            }
+        }
+
+        app->msg.logMsg( msg, R.flags & LogRec::lrEco, R.color );
+    }
+
+    if( R.flags & LogRec::lrDsk ) {
+        QMetaObject::invokeMethod(
+            app, "runLogErrorToDisk",
+            Qt::AutoConnection,
+            Q_ARG(QString, msg) );
+    }
+}
+
+
+// Logger thread: next record in post order, if published.
+//
+bool LogQ::take( LogRec &R )
+{
+    Slot    &S = ring[rd & (NREC - 1)];
+
+    if( S.seq.load( std::memory_order_acquire ) != rd + 1 )
+        return false;
+
+    R.str.clear();
+    R.str.swap( S.rec.str );
+    R.color = S.rec.color;
+    R.msecs = S.rec.msecs;
+    R.thd   = S.rec.thd;
+    R.cpu   = S.rec.cpu;
+    R.flags = S.rec.flags;
+
+    S.seq.store( rd + NREC, std::memory_order_release );
+    ++rd;
+    return true;
+}
+
+
@@ -0,0 +1,126 @@
+#ifndef LOGQ_H
+#define LOGQ_H
+
+#include <QColor>
+#include <QHash>
+#include <QObject>
+
+#include <atomic>
+
+class QThread;
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// One Log() line as posted: raw fields only, the header
+// (thread, CPU, date) is formatted by the logger thread.
+//
+struct LogRec {
+    enum Flags {
+        lrEco   = 0x01,     // echo to metrics window
+        lrDsk   = 0x02,     // append to run errors file
+        lrTray  = 0x04,     // systray if console hidden
+        lrRaise = 0x08      // raise console, else systray
+    };
+
+    QString     str;
+    QColor      color;
+    qint64      msecs;      // since epoch
+    quint64     thd;
+    int         cpu,
+                flags;
+
+    LogRec() : msecs(0), thd(0), cpu(0), flags(0)  {}
+};
+
+
+// Logger thread: drains LogQ, rate limits, delivers.
+//
+class LogQWorker : public QObject
+{
+    Q_OBJECT
+
+private:
+    struct Site {
+        qint64  t0;         // window start, msecs
+        int     n,          // lines this window
+                nSup;       // lines suppressed this window
+        Site() : t0(0), n(0), nSup(0)   {}
+    };
+
+    QHash<QString,Site> sites;
+    qint64              tSweep;
+    std::atomic<bool>   pleaseStop;
+
+public:
+    LogQWorker() : QObject(0), tSweep(0), pleaseStop(false) {}
+
+    void stop()     {pleaseStop = true;}
+
+signals:
+    void finished();
+
+public slots:
+    void run();
+
+private:
+    bool admit( const LogRec &R );
+    void sweep( qint64 t );
+    void suppressed( const Site &S, const QColor &color );
+};
+
+
+// Log lines are posted by any thread to a bounded lock-free
+// ring (multi-producer, single consumer). Posting only claims
+// a slot and swaps in the message string; formatting, console
+// and metrics posting, systray and disk writes happen on the
+// logger thread. If the ring is full the line is dropped and
+// counted rather than blocking the caller; drops are reported.
+//
+// Per message shape (text with digits removed, standing in
+// for the call site), SITEBURST lines per second are shown;
+// the rest of a burst is summarized as a count. Error lines
+// are still all appended to the run errors file.
+//
+// Before start() and after stop(), lines are delivered
+// synchronously by the posting thread, as before.
+//
+class LogQ
+{
+    friend class LogQWorker;
+
+public:
+    enum {
+        NREC        = 4096, // ring slots, power of 2
+        SITEBURST   = 20    // shown lines per shape per second
+    };
+
+private:
+    struct Slot {
+        std::atomic<quint64>    seq;
+        LogRec                  rec;
+    };
+
+    static Slot                 ring[NREC];
+    static std::atomic<quint64> wr,
+                                nDrop;
+    static quint64              rd;         // logger thread only
+    static std::atomic<bool>    running;
+    static QThread              *thread;
+    static LogQWorker           *worker;
+
+public:
+    static void start();
+    static void stop();
+
+    static bool post( LogRec &R );
+    static void deliver( const LogRec &R, bool show = true );
+
+private:
+    static bool take( LogRec &R );
+};
+
+#endif  // LOGQ_H
+
+
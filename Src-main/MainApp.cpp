@@ -5,13 +5,19 @@
 #include "Util.h"
 #include "MainApp.h"
 #include "ConsoleWindow.h"
+#include "LogQ.h"
 #include "MetricsWindow.h"
 #include "FileViewerWindow.h"
 #include "DFName.h"
+#include "ExportBatch.h"
 #include "ConfigCtl.h"
 #include "AOCtl.h"
 #include "CmdSrvDlg.h"
 #include "RgtSrvDlg.h"
+#include "MetricsExport.h"
+#include "TaskPool.h"
+#include "DFDiskBench.h"
+#include "DFDiskMon.h"
 #include "Run.h"
 #include "CalSRateCtl.h"
 #include "IMBISTCtl.h"
@@ -19,6 +25,8 @@
 #include "IMFirmCtl.h"
 #include "Sha1Verifier.h"
 #include "Par2Window.h"
+#include "Scrubber.h"
+#include "RunBench.h"
 #include "Version.h"
 
 #include <QDesktopWidget>
@@ -42,8 +50,15 @@ MainApp::MainApp( int &argc, char **argv )
         consoleWindow(0), mxWin(0), par2Win(0),
         configCtl(0), aoCtl(0),
         cmdSrv(new CmdSrvDlg), rgtSrv(new RgtSrvDlg),
-        calSRRun(0), runInitingDlg(0), initialized(false)
+        mxExport(new MetricsExport),
+        calSRRun(0), bench(0), scrubber(0), runInitingDlg(0),
+        initialized(false)
 {
+// Startup phase stamps, logged when done
+
+    double  tStart = getTime(),
+            tSet, tWin, tCfg, tAO;
+
 // --------------
 // App attributes
 // --------------
@@ -59,6 +74,8 @@ MainApp::MainApp( int &argc, char **argv )
 
     loadSettings();
 
+    tSet = getTime();
+
 // -----------------
 // Low-level helpers
 // -----------------
@@ -89,6 +106,7 @@ MainApp::MainApp( int &argc, char **argv )
 // ------------
 
     msg.initMessenger( consoleWindow );
+    LogQ::start();
 
     Log() << VERSION_STR;
     Log() << "Application started";
@@ -97,19 +115,36 @@ MainApp::MainApp( int &argc, char **argv )
     mxWin->setAttribute( Qt::WA_DeleteOnClose, false );
     ConnectUI( mxWin, SIGNAL(closed(QWidget*)), this, SLOT(modelessClosed(QWidget*)) );
 
+    tWin = getTime();
+
 // -------------
 // Other helpers
 // -------------
 
+// ConfigCtl builds its dialog on first showDialog(), and AOCtl
+// probes the audio device in the background.
+
     configCtl = new ConfigCtl;
 
+    tCfg = getTime();
+
     aoCtl = new AOCtl( configCtl->acceptedParams );
     aoCtl->setAttribute( Qt::WA_DeleteOnClose, false );
     aoCtl->setWindowTitle( APPNAME " - Audio Settings" );
     ConnectUI( aoCtl, SIGNAL(closed(QWidget*)), this, SLOT(modelessClosed(QWidget*)) );
 
+    tAO = getTime();
+
+    scrubber = new Scrubber;
+
+    if( appData.scrub )
+        scrubber->start();
+
+    DFDiskMon::start();
+
     cmdSrv->startServer( true );
     rgtSrv->startServer( true );
+    mxExport->start();
 
 // ----
 // Done
@@ -120,16 +155,46 @@ MainApp::MainApp( int &argc, char **argv )
     remoteMtx.unlock();
 
     Log() << "Application initialized";
+
+    double  tEnd = getTime();
+
+    Log() <<
+        QString("Startup: settings %1, windows %2, config %3, audio %4,"
+        " servers %5; total %6 ms")
+        .arg( int(1000 * (tSet - tStart)) )
+        .arg( int(1000 * (tWin - tSet)) )
+        .arg( int(1000 * (tCfg - tWin)) )
+        .arg( int(1000 * (tAO - tCfg)) )
+        .arg( int(1000 * (tEnd - tAO)) )
+        .arg( int(1000 * (tEnd - tStart)) );
     Status() <<  APPNAME << " initialized.";
 
     updateConsoleTitle( "READY" );
 
     showStartupMessages();
+
+// Unattended benchmark?
+
+    if( (bench = RunBench::fromArgs( arguments() )) ) {
+        QTimer::singleShot(
+            0, bench,
+            (bench->isKernels() ? SLOT(startKernels()) : SLOT(start())) );
+    }
 }
 
 
 MainApp::~MainApp()
 {
+    if( scrubber ) {
+        delete scrubber;
+        scrubber = 0;
+    }
+
+    if( bench ) {
+        delete bench;
+        bench = 0;
+    }
+
     if( par2Win ) {
         delete par2Win;
         par2Win = 0;
@@ -140,6 +205,11 @@ MainApp::~MainApp()
         rgtSrv = 0;
     }
 
+    if( mxExport ) {
+        delete mxExport;
+        mxExport = 0;
+    }
+
     if( cmdSrv ) {
         delete cmdSrv;
         cmdSrv = 0;
@@ -160,6 +230,10 @@ MainApp::~MainApp()
         mxWin = 0;
     }
 
+    DFDiskMon::stop();
+    TaskPool::stop();
+    LogQ::stop();
+
     if( consoleWindow ) {
         delete consoleWindow;
         consoleWindow = 0;
@@ -202,6 +276,33 @@ bool MainApp::remoteSetsDataDir( const QString &path )
 }
 
 
+// Return main dataDir, then existing stripe dirs.
+//
+// Main dir first; any dir on a volume DFDiskMon judged full
+// is replaced by the spill dir.
+//
+QStringList MainApp::dataDirs() const
+{
+    QMutexLocker    ml( &remoteMtx );
+    QStringList     L( DFDiskMon::mapDir( appData.dataDir ) );
+
+    foreach( const QString &s, appData.stripeDirs ) {
+
+        QString d = rmvLastSlash( s );
+
+        if( !d.isEmpty() && d != appData.dataDir && QDir( d ).exists() ) {
+
+            d = DFDiskMon::mapDir( d );
+
+            if( !L.contains( d ) )
+                L.append( d );
+        }
+    }
+
+    return L;
+}
+
+
 void MainApp::makePathAbsolute( QString &path )
 {
     if( !QFileInfo( path ).isAbsolute() ) {
@@ -249,15 +350,20 @@ void MainApp::saveSettings() const
     settings.setValue( "lastViewedFile", appData.lastViewedFile );
     settings.setValue( "debug", appData.debug );
     settings.setValue( "editLog", appData.editLog );
+    settings.setValue( "slowBkgndGrf", appData.slowBkgndGrf );
+    settings.setValue( "scrub", appData.scrub );
 
     remoteMtx.lock();
     settings.setValue( "dataDir", appData.dataDir );
+    settings.setValue( "dataDirStripes", appData.stripeDirs );
+    settings.setValue( "dataDirSpill", appData.spillDir );
     remoteMtx.unlock();
 
     settings.endGroup();
 
     cmdSrv->saveSettings( settings );
     rgtSrv->saveSettings( settings );
+    mxExport->saveSettings( settings );
 }
 
 /* ---------------------------------------------------------------- */
@@ -513,6 +619,8 @@ void MainApp::file_AskQuit()
         processEvents();
     }
 
+    ExportBatch::shutdown();
+
     msg.appQuiting();
     win.closeAll();
 
@@ -557,6 +665,19 @@ void MainApp::options_AODlg()
 }
 
 
+void MainApp::options_ToggleSlowBkgndGrf()
+{
+    appData.slowBkgndGrf = !appData.slowBkgndGrf;
+
+    Log() << "Slow background graphs: "
+          << (appData.slowBkgndGrf ? "on" : "off");
+
+    run->grfBkgndUpdate();
+
+    saveSettings();
+}
+
+
 void MainApp::tools_VerifySha1()
 {
 // Sha1Verifier is self-deleting object
@@ -581,6 +702,91 @@ void MainApp::tools_ShowPar2Win()
 }
 
 
+void MainApp::tools_ToggleScrub()
+{
+    appData.scrub = !appData.scrub;
+
+    if( appData.scrub )
+        scrubber->start();
+    else
+        scrubber->stop();
+
+    saveSettings();
+}
+
+
+// Write the accepted configuration's files to the data dirs
+// flat out; results feed the configuration's budget planner.
+// The modal dialog holds off other commands meanwhile.
+//
+void MainApp::tools_DiskBench()
+{
+    if( run->isRunning() ) {
+
+        QMessageBox::critical(
+            consoleWindow,
+            "Run in Progress",
+            "Stop the current run before benchmarking disks." );
+        return;
+    }
+
+    DFDiskBench::Config             C;
+    QVector<DFDiskBench::Result>    vR;
+    QString                         err;
+
+    C.fromParams( configCtl->acceptedParams );
+
+    int yesNo = QMessageBox::question(
+        consoleWindow,
+        "Disk Benchmark",
+        QString(
+        "Write %1 scratch files to %2 data directories\n"
+        "for %3 seconds (SHA1 on, direct I/O %4)?")
+        .arg( C.files.size() ).arg( C.dirs.size() )
+        .arg( C.secs ).arg( C.direct ? "on" : "off" ),
+        QMessageBox::Yes | QMessageBox::No,
+        QMessageBox::Yes );
+
+    if( yesNo != QMessageBox::Yes )
+        return;
+
+    QProgressDialog dlg(
+        "Benchmarking data directories...",
+        QString::null, 0, 0, consoleWindow );
+
+    dlg.setWindowTitle( "Disk Benchmark" );
+    dlg.setWindowModality( Qt::ApplicationModal );
+    dlg.show();
+    guiBreathe();
+
+    bool    ok = DFDiskBench::run( vR, err, C );
+
+    dlg.close();
+
+    if( !ok ) {
+        Error() << err;
+        QMessageBox::critical( consoleWindow, "Disk Benchmark", err );
+        return;
+    }
+
+    QString s;
+
+    foreach( const DFDiskBench::Result &R, vR ) {
+
+        s += QString("%1\n  %2 files, need %3 MB/s,"
+                " sustained %4 MB/s, worst 1 s %5 MB/s\n")
+                .arg( R.dir ).arg( R.nFiles )
+                .arg( R.needMBps, 0, 'f', 1 )
+                .arg( R.avgMBps, 0, 'f', 1 )
+                .arg( R.minMBps, 0, 'f', 1 );
+    }
+
+    Log() << "DiskBench:\n" << s.trimmed();
+
+    QMessageBox::information( consoleWindow, "Disk Benchmark", s );
+}
+
+
 void MainApp::tools_CalSRate()
 {
     if( run->isRunning() ) {
@@ -852,12 +1058,6 @@ void MainApp::remoteStopsRun()
 }
 
 
-void MainApp::remoteSetsDigitalOut( const QString &chan, bool onoff )
-{
-    CniCfg::setDO( chan, onoff );
-}
-
-
 void MainApp::remoteShowsConsole( bool show )
 {
     if( show ^ consoleWindow->isVisible() )
@@ -985,6 +1185,9 @@ void MainApp::runStarted()
         runInitingDlg = 0;
     }
 
+    if( bench )
+        bench->runStarted();
+
     if( calSRRun ) {
         // Due to limited accuracy, long intervals are
         // best implemented as sequences of short ones.
@@ -1016,12 +1219,21 @@ void MainApp::runStopped()
             calSRRun, "finish",
             Qt::QueuedConnection );
     }
+
+    if( bench )
+        bench->runStopped();
 }
 
 
 void MainApp::runDaqError( const QString &e )
 {
     run->stopRun();
+
+    if( bench ) {
+        bench->setError( e );
+        return;
+    }
+
     QMessageBox::critical( 0, "DAQ Error", e );
 }
 
@@ -1082,7 +1294,9 @@ void MainApp::loadDataDir( QSettings &settings )
 
     remoteMtx.lock();
 
-    appData.dataDir = settings.value( "dataDir" ).toString();
+    appData.dataDir     = settings.value( "dataDir" ).toString();
+    appData.stripeDirs  = settings.value( "dataDirStripes" ).toStringList();
+    appData.spillDir    = settings.value( "dataDirSpill" ).toString();
 
     if( appData.dataDir.isEmpty()
         || !QFileInfo( appData.dataDir ).exists() ) {
@@ -1136,11 +1350,16 @@ void MainApp::loadSettings()
         settings.value( "debug", false ).toBool();
     appData.editLog =
         settings.value( "editLog", false ).toBool();
+    appData.slowBkgndGrf =
+        settings.value( "slowBkgndGrf", false ).toBool();
+    appData.scrub =
+        settings.value( "scrub", false ).toBool();
 
     settings.endGroup();
 
     cmdSrv->loadSettings( settings );
     rgtSrv->loadSettings( settings );
+    mxExport->loadSettings( settings );
 }
 
 
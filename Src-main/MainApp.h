@@ -9,6 +9,7 @@
 
 class Run;
 class ConsoleWindow;
+class MetricsExport;
 class MetricsWindow;
 class Par2Window;
 class ConfigCtl;
@@ -16,6 +17,8 @@ class AOCtl;
 class CmdSrvDlg;
 class RgtSrvDlg;
 class CalSRRun;
+class RunBench;
+class Scrubber;
 
 class QProgressDialog;
 class QSettings;
@@ -25,10 +28,14 @@ class QSettings;
 /* ---------------------------------------------------------------- */
 
 struct AppData {
-    QString dataDir,
-            lastViewedFile;
-    bool    debug,
-            editLog;
+    QString     dataDir,
+                lastViewedFile;
+    QStringList stripeDirs;     // extra recording disks
+    QString     spillDir;       // used when a recording disk fills
+    bool        debug,
+                editLog,
+                slowBkgndGrf,
+                scrub;          // background data scrub
 };
 
 /* ---------------------------------------------------------------- */
@@ -57,7 +64,10 @@ private:
     AOCtl           *aoCtl;
     CmdSrvDlg       *cmdSrv;
     RgtSrvDlg       *rgtSrv;
+    MetricsExport   *mxExport;
     CalSRRun        *calSRRun;
+    RunBench        *bench;
+    Scrubber        *scrubber;
     QProgressDialog *runInitingDlg;
     mutable QMutex  remoteMtx;
     AppData         appData;
@@ -100,6 +110,9 @@ public:
     AOCtl *getAOCtl() const
         {return aoCtl;}
 
+    Scrubber *getScrubber() const
+        {return scrubber;}
+
 // ----------
 // Properties
 // ----------
@@ -111,10 +124,15 @@ public:
     bool isConsoleHidden() const;
     bool isShiftPressed() const;
     bool isLogEditable() const          {return appData.editLog;}
+    bool isBkgndGrfSlow() const         {return appData.slowBkgndGrf;}
+    bool isScrubbing() const            {return appData.scrub;}
 
     bool remoteSetsDataDir( const QString &path );
     QString dataDir() const
         {QMutexLocker ml(&remoteMtx); return appData.dataDir;}
+    QStringList dataDirs() const;
+    QString spillDir() const
+        {QMutexLocker ml(&remoteMtx); return appData.spillDir;}
     void makePathAbsolute( QString &path );
 
     void saveSettings() const;
@@ -141,10 +159,13 @@ public slots:
     void options_PickDataDir();
     void options_ExploreRunDir();
     void options_AODlg();
+    void options_ToggleSlowBkgndGrf();
 
 // Tools
     void tools_VerifySha1();
     void tools_ShowPar2Win();
+    void tools_ToggleScrub();
+    void tools_DiskBench();
     void tools_CalSRate();
     void tools_ImClose();
     void tools_ImBist();
@@ -183,7 +204,6 @@ public slots:
     QString remoteSetsRunName( const QString &name );
     QString remoteStartsRun();
     void remoteStopsRun();
-    void remoteSetsDigitalOut( const QString &chan, bool onoff );
     void remoteShowsConsole( bool show );
 
 // Run synchronizes with app
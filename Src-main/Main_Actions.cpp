@@ -63,6 +63,11 @@ void Main_Actions::initActions()
     rgtSrvOptAct = new QAction( "&Gate/Trigger Server Settings...", this );
     ConnectUI( rgtSrvOptAct, SIGNAL(triggered()), app->rgtSrv, SLOT(showOptionsDlg()) );
 
+    bkgndGrfAct = new QAction( "Slow &Background Graphs", this );
+    bkgndGrfAct->setCheckable( true );
+    bkgndGrfAct->setChecked( app->isBkgndGrfSlow() );
+    ConnectUI( bkgndGrfAct, SIGNAL(triggered()), app, SLOT(options_ToggleSlowBkgndGrf()) );
+
 // -----
 // Tools
 // -----
@@ -73,6 +78,14 @@ void Main_Actions::initActions()
     par2Act = new QAction( "&PAR2 Redundancy Tool...", this );
     ConnectUI( par2Act, SIGNAL(triggered()), app, SLOT(tools_ShowPar2Win()) );
 
+    scrubAct = new QAction( "Background Data &Scrub", this );
+    scrubAct->setCheckable( true );
+    scrubAct->setChecked( app->isScrubbing() );
+    ConnectUI( scrubAct, SIGNAL(triggered()), app, SLOT(tools_ToggleScrub()) );
+
+    diskBenchAct = new QAction( "&Disk Benchmark...", this );
+    ConnectUI( diskBenchAct, SIGNAL(triggered()), app, SLOT(tools_DiskBench()) );
+
     calSRateAct = new QAction( "Sample &Rates From Run...", this );
     ConnectUI( calSRateAct, SIGNAL(triggered()), app, SLOT(tools_CalSRate()) );
 
@@ -175,10 +188,14 @@ void Main_Actions::initMenus( QMainWindow *w )
     m->addSeparator();
     m->addAction( cmdSrvOptAct );
     m->addAction( rgtSrvOptAct );
+    m->addSeparator();
+    m->addAction( bkgndGrfAct );
 
     m = mb->addMenu( "&Tools" );
     m->addAction( sha1Act );
     m->addAction( par2Act );
+    m->addAction( scrubAct );
+    m->addAction( diskBenchAct );
     m->addSeparator();
     m->addAction( calSRateAct );
     m->addSeparator();
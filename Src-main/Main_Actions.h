@@ -30,9 +30,12 @@ public:
         *aoDlgAct,
         *cmdSrvOptAct,
         *rgtSrvOptAct,
+        *bkgndGrfAct,
     // Tools
         *sha1Act,
         *par2Act,
+        *scrubAct,
+        *diskBenchAct,
         *calSRateAct,
         *imCloseAct,
         *imBistAct,
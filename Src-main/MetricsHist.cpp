@@ -0,0 +1,301 @@
+
+#include "MetricsHist.h"
+#include "Util.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+static const char *glbName[MetricsHist::NGLB] = {
+    "imFull", "niFull", "wrMBps", "reqMBps", "niDepth", "niLag"
+};
+
+static const char *fldName[MetricsHist::NFLD] = {
+    "Fifo", "Awake", "Depth", "Lag", "Errs"
+};
+
+
+// Eighth-block characters, scaled to [0,hi]; hi <= 0 autoscales
+// to the largest value. Empty if no values.
+//
+static QString spark( const std::vector<float> &v, float hi )
+{
+    QString s;
+
+    if( v.empty() )
+        return s;
+
+    if( hi <= 0 ) {
+
+        for( int i = 0, n = v.size(); i < n; ++i )
+            hi = qMax( hi, v[i] );
+
+        if( hi <= 0 )
+            hi = 1;
+    }
+
+    for( int i = 0, n = v.size(); i < n; ++i ) {
+
+        int lvl = int(8 * v[i] / hi);
+
+        s += QChar( 0x2581 + qBound( 0, lvl, 7 ) );
+    }
+
+    return s;
+}
+
+/* ---------------------------------------------------------------- */
+/* MetricsHist ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Call at run start; clears history.
+//
+void MetricsHist::init( const QString &runName, int nIm, int capSecs )
+{
+    QMutexLocker    ml( &mtx );
+
+    this->runName   = runName;
+    this->nIm       = nIm;
+    nMax            = qMax( 1, capSecs );
+    head            = 0;
+    nRow            = 0;
+    t0              = getTime();
+
+    tSec.assign( nMax, 0 );
+    glb.assign( nMax * NGLB, 0 );
+    cell.assign( nMax * nIm, Cell() );
+}
+
+
+// g[NGLB], c[nIm]; row is stamped now.
+//
+void MetricsHist::add( const float *g, const Cell *c )
+{
+    QMutexLocker    ml( &mtx );
+
+    if( !nMax )
+        return;
+
+    tSec[head] = getTime() - t0;
+
+    for( int i = 0; i < NGLB; ++i )
+        glb[head*NGLB + i] = g[i];
+
+    for( int ip = 0; ip < nIm; ++ip )
+        cell[head*nIm + ip] = c[ip];
+
+    head = (head + 1) % nMax;
+
+    if( nRow < nMax )
+        ++nRow;
+}
+
+
+int MetricsHist::size() const
+{
+    QMutexLocker    ml( &mtx );
+    return nRow;
+}
+
+
+// Newest row: time, g[NGLB], c[nIm]; false if none.
+//
+bool MetricsHist::latest( float &t, float *g, std::vector<Cell> &c ) const
+{
+    QMutexLocker    ml( &mtx );
+
+    if( !nRow )
+        return false;
+
+    int row = rowOf( nRow - 1 );
+
+    t = tSec[row];
+
+    for( int ig = 0; ig < NGLB; ++ig )
+        g[ig] = glb[row*NGLB + ig];
+
+    c.assign( cell.begin() + row*nIm, cell.begin() + (row + 1)*nIm );
+
+    return true;
+}
+
+
+// Trend of global ig over the last nPts rows.
+//
+QString MetricsHist::sparkGlb( int ig, int nPts ) const
+{
+    QMutexLocker        ml( &mtx );
+    std::vector<float>  v;
+
+    for( int i = qMax( 0, nRow - nPts ); i < nRow; ++i )
+        v.push_back( glb[rowOf( i )*NGLB + ig] );
+
+    return spark( v,
+            (ig == gWrMBps || ig == gReqMBps ? 0 : 100) );
+}
+
+
+// Trend of stream ip field fld over the last nPts rows;
+// errors are shown as new counts per row.
+//
+QString MetricsHist::sparkIm( int ip, int fld, int nPts ) const
+{
+    QMutexLocker        ml( &mtx );
+    std::vector<float>  v;
+
+    if( ip < 0 || ip >= nIm )
+        return QString();
+
+    for( int i = qMax( 0, nRow - nPts ); i < nRow; ++i ) {
+
+        float   f = cellVal( rowOf( i ), ip, fld );
+
+        if( fld == fErrs )
+            f = (i ? f - cellVal( rowOf( i - 1 ), ip, fld ) : 0);
+
+        v.push_back( f );
+    }
+
+    return spark( v, (fld == fErrs ? 0 : 100) );
+}
+
+
+// Header line then one row per line, oldest first; lastSecs > 0
+// limits rows to that span before the newest.
+//
+QString MetricsHist::csv( double lastSecs ) const
+{
+    QMutexLocker    ml( &mtx );
+    QString         s = header() + "\n";
+
+    for( int i = firstRow( lastSecs ); i < nRow; ++i )
+        s += rowStr( i ) + "\n";
+
+    return s;
+}
+
+
+// {"run":, "columns":[...], "rows":[[...], ...]}.
+//
+QString MetricsHist::json() const
+{
+    QMutexLocker    ml( &mtx );
+    QJsonObject     o;
+    QJsonArray      cols,
+                    rows;
+
+    foreach( const QString &c, header().split( "," ) )
+        cols.append( c );
+
+    for( int i = 0; i < nRow; ++i ) {
+
+        QJsonArray  r;
+        int         row = rowOf( i );
+
+        r.append( tSec[row] );
+
+        for( int ig = 0; ig < NGLB; ++ig )
+            r.append( glb[row*NGLB + ig] );
+
+        for( int ip = 0; ip < nIm; ++ip ) {
+            for( int f = 0; f < NFLD; ++f )
+                r.append( cellVal( row, ip, f ) );
+        }
+
+        rows.append( r );
+    }
+
+    o["run"]        = runName;
+    o["columns"]    = cols;
+    o["rows"]       = rows;
+
+    return QString( QJsonDocument( o ).toJson( QJsonDocument::Compact ) );
+}
+
+
+// Caller holds mtx.
+//
+float MetricsHist::cellVal( int row, int ip, int fld ) const
+{
+    const Cell  &C = cell[row*nIm + ip];
+
+    switch( fld ) {
+        case fFifo:     return C.fifo;
+        case fAwake:    return C.awake;
+        case fDepth:    return C.depth;
+        case fLag:      return C.lag;
+        default:        return C.errs;
+    }
+}
+
+
+// Caller holds mtx.
+//
+int MetricsHist::firstRow( double lastSecs ) const
+{
+    if( lastSecs <= 0 || !nRow )
+        return 0;
+
+    float   tLim = tSec[rowOf( nRow - 1 )] - lastSecs;
+    int     i    = nRow;
+
+    while( i > 0 && tSec[rowOf( i - 1 )] > tLim )
+        --i;
+
+    return i;
+}
+
+
+// Caller holds mtx.
+//
+QString MetricsHist::header() const
+{
+    QStringList sl;
+
+    sl << "t";
+
+    for( int ig = 0; ig < NGLB; ++ig )
+        sl << glbName[ig];
+
+    for( int ip = 0; ip < nIm; ++ip ) {
+        for( int f = 0; f < NFLD; ++f )
+            sl << QString("im%1%2").arg( ip ).arg( fldName[f] );
+    }
+
+    return sl.join( "," );
+}
+
+
+// Caller holds mtx.
+//
+QString MetricsHist::rowStr( int i ) const
+{
+    int         row = rowOf( i );
+    QStringList sl;
+
+    sl << QString::number( tSec[row], 'f', 1 );
+
+    for( int ig = 0; ig < NGLB; ++ig )
+        sl << QString::number( glb[row*NGLB + ig], 'f', 1 );
+
+    for( int ip = 0; ip < nIm; ++ip ) {
+
+        const Cell  &C = cell[row*nIm + ip];
+
+        sl << QString::number( C.fifo )
+           << QString::number( C.awake )
+           << QString::number( C.depth )
+           << QString::number( C.lag )
+           << QString::number( C.errs );
+    }
+
+    return sl.join( "," );
+}
+
+
@@ -0,0 +1,95 @@
+#ifndef METRICSHIST_H
+#define METRICSHIST_H
+
+#include <QMutex>
+#include <QString>
+
+#include <vector>
+
+#define MXHIST_SECS     (8*3600)
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Rolling history of MetricsWindow figures, sampled once a second
+// for the run and kept after it, so FIFO spikes or disk lag can
+// be lined up with events after the fact.
+//
+// A row is a time (secs from run start), the disk figures and,
+// per imec stream, a Cell: FIFO %, worker awake %, fetch depth %,
+// worst consumer lag as % of queue (a byte each) and the summed
+// error flag counts. Rows live in a ring of MXHIST_SECS; with 32
+// probes that's about 8 MB.
+//
+// Filled by the GUI thread; readers (CmdServer) may take copies
+// from any thread.
+//
+class MetricsHist
+{
+public:
+    enum Glb {
+        gImFull     = 0,    // write buffer %, worst imec
+        gNiFull     = 1,    // write buffer %, nidq
+        gWrMBps     = 2,    // actual write rate
+        gReqMBps    = 3,    // required write rate
+        gNiDepth    = 4,    // nidq fetch depth %
+        gNiLag      = 5,    // nidq worst consumer lag %
+        NGLB        = 6
+    };
+
+    enum Fld {
+        fFifo       = 0,
+        fAwake      = 1,
+        fDepth      = 2,
+        fLag        = 3,
+        fErrs       = 4,
+        NFLD        = 5
+    };
+
+    struct Cell {
+        quint32 errs;
+        quint8  fifo,
+                awake,
+                depth,
+                lag;
+        Cell() : errs(0), fifo(0), awake(0), depth(0), lag(0)    {}
+    };
+
+private:
+    mutable QMutex      mtx;
+    std::vector<float>  tSec,
+                        glb;    // NGLB per row
+    std::vector<Cell>   cell;   // nIm per row
+    QString             runName;
+    double              t0;
+    int                 nIm,
+                        nMax,
+                        head,   // next row written
+                        nRow;
+
+public:
+    MetricsHist() : t0(0), nIm(0), nMax(0), head(0), nRow(0)  {}
+
+    void init( const QString &runName, int nIm, int capSecs = MXHIST_SECS );
+    void add( const float *g, const Cell *c );
+
+    int size() const;
+    bool latest( float &t, float *g, std::vector<Cell> &c ) const;
+    QString sparkGlb( int ig, int nPts ) const;
+    QString sparkIm( int ip, int fld, int nPts ) const;
+
+    QString csv( double lastSecs = 0 ) const;
+    QString json() const;
+
+private:
+    int rowOf( int i ) const    {return (head - nRow + i + nMax) % nMax;}
+    float cellVal( int row, int ip, int fld ) const;
+    int firstRow( double lastSecs ) const;
+    QString header() const;
+    QString rowStr( int i ) const;
+};
+
+#endif  // METRICSHIST_H
+
+
@@ -5,13 +5,43 @@
 #include "Util.h"
 #include "MainApp.h"
 #include "ConfigCtl.h"
+#include "Run.h"
+#include "AIQ.h"
+#include "AOCtl.h"
+#include "DFDiskMon.h"
 
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QKeyEvent>
 #include <QScrollBar>
 #include <QSettings>
 
 
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Worst lag of active consumers as % of queue, or 0.
+//
+static double worstLag( const AIQ *Q )
+{
+    QVector<AIQ::ReaderStat>    vS;
+    double                      maxPct = 0;
+
+    if( !Q )
+        return 0;
+
+    Q->readerStats( vS );
+
+    for( int ir = 0, nr = vS.size(); ir < nr; ++ir ) {
+
+        if( vS[ir].idleSecs <= 5.0 && vS[ir].fillPct > maxPct )
+            maxPct = vS[ir].fillPct;
+    }
+
+    return maxPct;
+}
+
 /* ---------------------------------------------------------------- */
 /* MXDiskRec ------------------------------------------------------ */
 /* ---------------------------------------------------------------- */
@@ -33,7 +63,7 @@ void MetricsWindow::MXDiskRec::init()
 /* ---------------------------------------------------------------- */
 
 MetricsWindow::MetricsWindow( QWidget *parent )
-    :   QWidget(parent), mxTimer( this ),
+    :   QWidget(parent), mxTimer( this ), histTimer( this ),
         erLines(0), erMaxLines(2000), isRun(false)
 {
     mxUI = new Ui::MetricsWindow;
@@ -45,6 +75,12 @@ MetricsWindow::MetricsWindow( QWidget *parent )
     mxTimer.setInterval( 2000 );
     ConnectUI( &mxTimer, SIGNAL(timeout()), this, SLOT(updateMx()) );
 
+// History is sampled whether shown or not
+
+    histTimer.setTimerType( Qt::CoarseTimer );
+    histTimer.setInterval( 1000 );
+    ConnectUI( &histTimer, SIGNAL(timeout()), this, SLOT(histSample()) );
+
 // Choices of monospaced fonts widely available:
 // Consolas
 // Lucida Console
@@ -78,10 +114,16 @@ void MetricsWindow::runInit()
     err.init();
     prf.init();
     dsk.init();
+    tlmLast.clear();
+    memset( &trgLast, 0, sizeof(TrigTelemetry::Snapshot) );
+    memset( &aoLast, 0, sizeof(AOTelemetry::Snapshot) );
+
+    const DAQ::Params   &p = mainApp()->cfgCtl()->acceptedParams;
 
-    setWindowTitle(
-        QString("Metrics: %1")
-        .arg( mainApp()->cfgCtl()->acceptedParams.sns.runName ) );
+    hist.init( p.sns.runName, (p.im.enabled ? p.im.get_nProbes() : 0) );
+    histTimer.start();
+
+    setWindowTitle( QString("Metrics: %1").arg( p.sns.runName ) );
 
     mxUI->mxTE->clear();
     mxUI->erTE->clear();
@@ -103,6 +145,7 @@ void MetricsWindow::runEnd()
 {
     isRun = false;
     mxTimer.stop();
+    histTimer.stop();
     updateMx();
 }
 
@@ -357,6 +400,36 @@ void MetricsWindow::updateMx()
         te->setTextColor( defColor );
     }
 
+// Consumers
+
+    if( isRun )
+        ledstate = qMax( ledstate, updateReaders( te ) );
+
+// NUMA placement
+
+    if( isRun )
+        updatePlacement( te );
+
+// Imec telemetry
+
+    if( isRun )
+        ledstate = qMax( ledstate, updateTelemetry( te ) );
+
+// Trigger telemetry
+
+    if( isRun )
+        ledstate = qMax( ledstate, updateTrigger( te ) );
+
+// Audio telemetry
+
+    if( isRun )
+        ledstate = qMax( ledstate, updateAudio( te ) );
+
+// Sync calibration
+
+    if( isRun )
+        ledstate = qMax( ledstate, updateSync( te ) );
+
 // ----
 // Disk
 // ----
@@ -381,6 +454,11 @@ void MetricsWindow::updateMx()
         .arg( dsk.wbps, 0, 'f', 1 )
         .arg( dsk.rbps, 0, 'f', 1 ) );
 
+// Space forecast
+
+    foreach( const QString &s, DFDiskMon::summary() )
+        te->append( "Volume " + s );
+
 // Lags
 
     if( dsk.lags.size() ) {
@@ -446,6 +524,13 @@ void MetricsWindow::updateMx()
         te->setTextColor( defColor );
     }
 
+// ------
+// Trends
+// ------
+
+    if( hist.size() )
+        updateTrends( te );
+
 // Restore user cursor
 
     S = te->horizontalScrollBar();
@@ -462,19 +547,475 @@ void MetricsWindow::updateMx()
 }
 
 
+// Show each stream's registered consumers with their lag
+// behind the stream head: seconds(% of ring capacity).
+// Consumers idle over 5 seconds are shown but not rated.
+//
+// Return LED state.
+//
+int MetricsWindow::updateReaders( QTextEdit *te )
+{
+    Run                         *run = mainApp()->getRun();
+    QVector<AIQ::ReaderStat>    vS;
+    int                         ledstate = 0;
+    bool                        isNI     = false;
+
+    for( int ip = 0; !isNI; ++ip ) {
+
+        const AIQ   *Q = run->getImQ( ip );
+        QString     who;
+
+        if( Q )
+            who = QString("Stream-i %1").arg( ip, 2, 10, QChar('0') );
+        else if( (Q = run->getNiQ()) ) {
+            who     = "Stream-n";
+            isNI    = true;
+        }
+        else
+            break;
+
+        Q->readerStats( vS );
+
+        if( vS.size() ) {
+
+            // --------------------
+            // Color title by worst
+            // --------------------
+
+            double  maxPct = 0;
+
+            for( int ir = 0, nr = vS.size(); ir < nr; ++ir ) {
+
+                if( vS[ir].idleSecs <= 5.0 && vS[ir].fillPct > maxPct )
+                    maxPct = vS[ir].fillPct;
+            }
+
+            if( maxPct >= 50 ) {
+                te->setTextColor( Qt::darkRed );
+                ledstate = qMax( ledstate, 2 );
+            }
+            else if( maxPct >= 20 ) {
+                te->setTextColor( Qt::darkMagenta );
+                ledstate = qMax( ledstate, 1 );
+            }
+            else
+                te->setTextColor( Qt::darkGreen );
+
+            te->append( QString("%1 consumer lag (s(%)):").arg( who ) );
+
+            // --------------------
+            // Color and write each
+            // --------------------
+
+            for( int ir = 0, nr = vS.size(); ir < nr; ++ir ) {
+
+                const AIQ::ReaderStat   &S = vS[ir];
+
+                te->moveCursor( QTextCursor::End );
+
+                if( S.idleSecs > 5.0 )
+                    te->setTextColor( defColor );
+                else if( S.fillPct >= 50 )
+                    te->setTextColor( Qt::darkRed );
+                else if( S.fillPct >= 20 )
+                    te->setTextColor( Qt::darkMagenta );
+                else
+                    te->setTextColor( Qt::darkGreen );
+
+                te->insertPlainText(
+                    QString("  %1 %2(%3)%4")
+                    .arg( S.name )
+                    .arg( S.lagSecs, 0, 'f', 3 )
+                    .arg( S.fillPct, 0, 'f', 1 )
+                    .arg( S.idleSecs > 5.0 ? " idle" : "" ) );
+            }
+
+            te->setTextColor( defColor );
+        }
+    }
+
+    return ledstate;
+}
+
+
+// Show NUMA node of each stream's queue ring, as placed by its
+// pinned producer; nothing shown unless some ring was placed.
+//
+void MetricsWindow::updatePlacement( QTextEdit *te )
+{
+    Run         *run = mainApp()->getRun();
+    const AIQ   *Q;
+    QString     s;
+    int         nOnLine = 0;
+    bool        any     = false;
+
+    for( int ip = 0; (Q = run->getImQ( ip )); ++ip ) {
+
+        if( !(nOnLine++ % 8) )
+            s += "\n";
+
+        if( Q->memNode() >= 0 ) {
+            s  += QString("  %1(n%2)").arg( ip, 2, 10, QChar(' ') ).arg( Q->memNode() );
+            any = true;
+        }
+        else
+            s += QString("  %1(-)").arg( ip, 2, 10, QChar(' ') );
+    }
+
+    if( (Q = run->getNiQ()) ) {
+
+        if( !(nOnLine++ % 8) )
+            s += "\n";
+
+        if( Q->memNode() >= 0 ) {
+            s  += QString("  ni(n%1)").arg( Q->memNode() );
+            any = true;
+        }
+        else
+            s += "  ni(-)";
+    }
+
+    if( !any )
+        return;
+
+    te->append( "Stream memory (NUMA node):" );
+    te->insertPlainText( s );
+}
+
+
+// Sparklines of the last minute of history (1 s per point);
+// percentages are scaled to 100, rates and errors to their
+// largest value shown.
+//
+void MetricsWindow::updateTrends( QTextEdit *te )
+{
+    const int   nPts = 60;
+
+    te->setFontPointSize( 12 );
+    te->setFontWeight( QFont::Bold );
+    te->append( "Trends <last minute>" );
+    te->setFontPointSize( defSize );
+    te->setFontWeight( defWeight );
+
+    te->append(
+        QString("Write buffer full (%); imec-max and nidq:  %1  %2")
+        .arg( hist.sparkGlb( MetricsHist::gImFull, nPts ) )
+        .arg( hist.sparkGlb( MetricsHist::gNiFull, nPts ) ) );
+
+    te->append(
+        QString("Actual write rate (MB/s):                  %1")
+        .arg( hist.sparkGlb( MetricsHist::gWrMBps, nPts ) ) );
+
+    for( int ip = 0; ; ++ip ) {
+
+        QString s = hist.sparkIm( ip, MetricsHist::fFifo, nPts );
+
+        if( s.isEmpty() )
+            break;
+
+        te->append(
+            QString("Stream-i %1 fifo %2  awake %3  depth %4  lag %5  errs %6")
+            .arg( ip, 2, 10, QChar('0') )
+            .arg( s )
+            .arg( hist.sparkIm( ip, MetricsHist::fAwake, nPts ) )
+            .arg( hist.sparkIm( ip, MetricsHist::fDepth, nPts ) )
+            .arg( hist.sparkIm( ip, MetricsHist::fLag, nPts ) )
+            .arg( hist.sparkIm( ip, MetricsHist::fErrs, nPts ) ) );
+    }
+}
+
+
+// Show each stream's sample rate as measured against the sync
+// pulser so far, and its drift from the configured rate; files
+// closed now get this rate in their metadata.
+//
+// Return LED state.
+//
+int MetricsWindow::updateSync( QTextEdit *te )
+{
+    Run     *run     = mainApp()->getRun();
+    int     ledstate = 0;
+    bool    isNI     = false,
+            isHdr    = false;
+
+    for( int ip = 0; !isNI; ++ip ) {
+
+        const AIQ   *Q = run->getImQ( ip );
+        QString     who;
+        double      rate, span;
+
+        if( Q )
+            who = QString("i %1").arg( ip, 2, 10, QChar('0') );
+        else if( (Q = run->getNiQ()) ) {
+            who     = "n   ";
+            isNI    = true;
+        }
+        else
+            break;
+
+        if( !Q->syncRate( rate, span ) )
+            continue;
+
+        if( !isHdr ) {
+            te->setTextColor( defColor );
+            te->append( "Sync-measured rate (Hz), drift (ppm), over (s):" );
+            isHdr = true;
+        }
+
+        double  ppm = 1e6 * (rate / Q->sRate() - 1.0);
+
+        if( qAbs( ppm ) >= 50 ) {
+            te->setTextColor( Qt::darkMagenta );
+            ledstate = qMax( ledstate, 1 );
+        }
+        else
+            te->setTextColor( Qt::darkGreen );
+
+        te->append(
+            QString("  Stream-%1  %2  %3  %4")
+            .arg( who )
+            .arg( rate, 0, 'f', 6 )
+            .arg( ppm, 6, 'f', 1 )
+            .arg( span, 0, 'f', 0 ) );
+    }
+
+    te->setTextColor( defColor );
+
+    return ledstate;
+}
+
+
+// Show each probe's acquisition telemetry since the last
+// update: count of abnormal timestamp deltas, fetch cycle
+// time percentiles, FIFO fill percentiles.
+//
+// Return LED state.
+//
+int MetricsWindow::updateTelemetry( QTextEdit *te )
+{
+    Run *run = mainApp()->getRun();
+    int ledstate = 0,
+        np       = 0;
+
+    while( run->getImQ( np ) )
+        ++np;
+
+    if( !np )
+        return 0;
+
+    if( tlmLast.size() != np ) {
+        tlmLast.resize( np );
+        for( int ip = 0; ip < np; ++ip )
+            memset( &tlmLast[ip], 0, sizeof(ImTelemetry::Snapshot) );
+    }
+
+    te->setTextColor( defColor );
+    te->append(
+        "Imec telemetry: tstamp gaps;"
+        " cycle ms p50/p99/max; FIFO% p50/p99/max" );
+
+    for( int ip = 0; ip < np; ++ip ) {
+
+        ImTelemetry::Snapshot   now, D;
+        quint64                 nGap;
+        int                     fifo99;
+
+        ImTelemetry::snapshot( now, ip );
+        D.diff( now, tlmLast[ip] );
+        tlmLast[ip] = now;
+
+        nGap    = D.nGapEvt();
+        fifo99  = D.fifoPctile( 99 );
+
+        if( nGap || fifo99 >= 50 ) {
+            te->setTextColor( Qt::darkRed );
+            ledstate = qMax( ledstate, 2 );
+        }
+        else if( fifo99 >= 20 ) {
+            te->setTextColor( Qt::darkMagenta );
+            ledstate = qMax( ledstate, 1 );
+        }
+        else
+            te->setTextColor( Qt::darkGreen );
+
+        te->append(
+            QString("  %1: %2;  %3/%4/%5;  %6/%7/%8")
+            .arg( ip, 2, 10, QChar('0') )
+            .arg( nGap )
+            .arg( 1000*D.cycPctile( 50 ), 0, 'f', 2 )
+            .arg( 1000*D.cycPctile( 99 ), 0, 'f', 2 )
+            .arg( 1000*D.cycPctile( 100 ), 0, 'f', 2 )
+            .arg( D.fifoPctile( 50 ) )
+            .arg( fifo99 )
+            .arg( D.fifoPctile( 100 ) ) );
+    }
+
+    te->setTextColor( defColor );
+
+    return ledstate;
+}
+
+
+// Show TTL trigger telemetry since the last update: current
+// state, % time per state, xferAll time percentiles, and the
+// tracked stream's lag behind its queue head.
+//
+// Return LED state.
+//
+int MetricsWindow::updateTrigger( QTextEdit *te )
+{
+    if( mainApp()->cfgCtl()->acceptedParams.mode.mTrig != DAQ::eTrigTTL )
+        return 0;
+
+    TrigTelemetry::Snapshot now, D;
+    double                  lag99;
+    int                     ledstate = 0;
+
+    TrigTelemetry::snapshot( now );
+    D.diff( now, trgLast );
+    trgLast = now;
+
+    lag99 = D.lagPctile( 99 );
+
+    te->setTextColor( defColor );
+    te->append(
+        "TTL trigger: state; % time L/Pre/H/Post;"
+        " xfer ms p50/p99/max; lag ms p99" );
+
+    if( lag99 >= 1.0 ) {
+        te->setTextColor( Qt::darkRed );
+        ledstate = 2;
+    }
+    else if( lag99 >= 0.25 ) {
+        te->setTextColor( Qt::darkMagenta );
+        ledstate = 1;
+    }
+    else
+        te->setTextColor( Qt::darkGreen );
+
+    te->append(
+        QString("  %1;  %2/%3/%4/%5;  %6/%7/%8;  %9")
+        .arg( TrigTelemetry::stateName( D.state ) )
+        .arg( D.statePct( 0 ), 0, 'f', 0 )
+        .arg( D.statePct( 1 ), 0, 'f', 0 )
+        .arg( D.statePct( 2 ), 0, 'f', 0 )
+        .arg( D.statePct( 3 ), 0, 'f', 0 )
+        .arg( 1000*D.xferPctile( 50 ), 0, 'f', 2 )
+        .arg( 1000*D.xferPctile( 99 ), 0, 'f', 2 )
+        .arg( 1000*D.xferPctile( 100 ), 0, 'f', 2 )
+        .arg( 1000*lag99, 0, 'f', 1 ) );
+
+    te->setTextColor( defColor );
+
+    return ledstate;
+}
+
+
+// Show audio output telemetry since the last update: callback
+// time and ring fill it found, feeder block time and lag, then
+// counts of starves (feeder late), device underflows (device
+// late), misses (AIQ lapped the feeder), rejoins and restarts.
+//
+// Return LED state.
+//
+int MetricsWindow::updateAudio( QTextEdit *te )
+{
+    if( !mainApp()->getAOCtl()->readyForScans() )
+        return 0;
+
+    AOTelemetry::Snapshot   now, D;
+    int                     ledstate = 0;
+
+    AOTelemetry::snapshot( now );
+    D.diff( now, aoLast );
+    aoLast = now;
+
+    te->setTextColor( defColor );
+    te->append(
+        "Audio: callback ms p50/p99/max; fill ms p1;"
+        " feed ms p99; lag ms p99;"
+        " starve/devUnder/miss/rejoin/restart" );
+
+    if( D.nRestart || D.nStarve + D.nDevUnder > 2 ) {
+        te->setTextColor( Qt::darkRed );
+        ledstate = 2;
+    }
+    else if( D.nStarve || D.nDevUnder || D.nMiss || D.nRejoin ) {
+        te->setTextColor( Qt::darkMagenta );
+        ledstate = 1;
+    }
+    else
+        te->setTextColor( Qt::darkGreen );
+
+    te->append(
+        QString("  %1/%2/%3;  %4;  %5;  %6;  %7/%8/%9/%10/%11")
+        .arg( 1000*D.cbPctile( 50 ), 0, 'f', 3 )
+        .arg( 1000*D.cbPctile( 99 ), 0, 'f', 3 )
+        .arg( 1000*D.cbPctile( 100 ), 0, 'f', 3 )
+        .arg( 1000*D.fillPctile( 1 ), 0, 'f', 1 )
+        .arg( 1000*D.feedPctile( 99 ), 0, 'f', 3 )
+        .arg( 1000*D.lagPctile( 99 ), 0, 'f', 1 )
+        .arg( D.nStarve )
+        .arg( D.nDevUnder )
+        .arg( D.nMiss )
+        .arg( D.nRejoin )
+        .arg( D.nRestart ) );
+
+    te->setTextColor( defColor );
+
+    return ledstate;
+}
+
+
+// Record current figures to history.
+//
+void MetricsWindow::histSample()
+{
+    const DAQ::Params               &p   = mainApp()->cfgCtl()->acceptedParams;
+    Run                             *run = mainApp()->getRun();
+    std::vector<MetricsHist::Cell>  C( p.im.enabled ? p.im.get_nProbes() : 0 );
+    float                           g[MetricsHist::NGLB];
+
+    g[MetricsHist::gImFull]  = dsk.imFull;
+    g[MetricsHist::gNiFull]  = dsk.niFull;
+    g[MetricsHist::gWrMBps]  = dsk.wbps;
+    g[MetricsHist::gReqMBps] = dsk.rbps;
+    g[MetricsHist::gNiDepth] = dsk.lags.value( -1, 0 );
+    g[MetricsHist::gNiLag]   = worstLag( run->getNiQ() );
+
+    for( int ip = 0, np = C.size(); ip < np; ++ip ) {
+
+        MetricsHist::Cell   &c = C[ip];
+        MXErrFlags          F  = err.flags.value( ip );
+
+        c.fifo  = quint8(qBound( 0, prf.fifoPct.value( ip, 0 ), 100 ));
+        c.awake = quint8(qBound( 0, prf.awakePct.value( ip, 0 ), 100 ));
+        c.depth = quint8(qBound( 0.0, dsk.lags.value( ip, 0 ), 100.0 ));
+        c.lag   = quint8(qBound( 0.0, worstLag( run->getImQ( ip ) ), 100.0 ));
+        c.errs  = F.errCOUNT + F.errSERDES + F.errLOCK + F.errPOP + F.errSYNC;
+    }
+
+    hist.add( g, (C.size() ? &C[0] : 0) );
+}
+
+
 void MetricsWindow::help()
 {
     showHelp( "Metrics_Help" );
 }
 
 
+// Text saves what's shown; csv and json save the history.
+//
 void MetricsWindow::save()
 {
     QString fn = QFileDialog::getSaveFileName(
                     this,
-                    "Save metrics as text file",
+                    "Save metrics as text file, or history as CSV/JSON",
                     mainApp()->dataDir(),
-                    "Text files (*.txt)" );
+                    "Text files (*.txt);;"
+                    "History CSV (*.csv);;"
+                    "History JSON (*.json)" );
 
     if( fn.length() ) {
 
@@ -483,6 +1024,16 @@ void MetricsWindow::save()
         if( f.open( QIODevice::WriteOnly | QIODevice::Text ) ) {
 
             QTextStream ts( &f );
+            QString     sfx = QFileInfo( fn ).suffix().toLower();
+
+            if( sfx == "csv" ) {
+                ts << hist.csv();
+                return;
+            }
+            else if( sfx == "json" ) {
+                ts << hist.json();
+                return;
+            }
 
             ts << "Run: ";
             ts << mainApp()->cfgCtl()->acceptedParams.sns.runName;
@@ -1,9 +1,17 @@
 #ifndef METRICSWINDOW_H
 #define METRICSWINDOW_H
 
+#include "ImTelemetry.h"
+#include "TrigTelemetry.h"
+#include "AOTelemetry.h"
+#include "MetricsHist.h"
+
 #include <QWidget>
 #include <QMap>
 #include <QTimer>
+#include <QVector>
+
+class QTextEdit;
 
 namespace Ui {
 class MetricsWindow;
@@ -86,10 +94,15 @@ private:
 
 private:
     Ui::MetricsWindow   *mxUI;
-    QTimer              mxTimer;
+    QTimer              mxTimer,
+                        histTimer;
     MXErrRec            err;
     MXPrfRec            prf;
     MXDiskRec           dsk;
+    MetricsHist         hist;
+    QVector<ImTelemetry::Snapshot>  tlmLast;
+    TrigTelemetry::Snapshot         trgLast;
+    AOTelemetry::Snapshot           aoLast;
     qreal               defSize;
     QColor              defColor;
     int                 defWeight,
@@ -103,6 +116,18 @@ public:
 
     void showDialog();
 
+    const MetricsHist &history() const  {return hist;}
+
+    void getDiskPerf(
+        double  &imFull,
+        double  &niFull,
+        double  &wbps,
+        double  &rbps ) const
+        {
+            imFull=dsk.imFull; niFull=dsk.niFull;
+            wbps=dsk.wbps; rbps=dsk.rbps;
+        }
+
     void runInit();
     void runStart();
     void runEnd();
@@ -140,6 +165,7 @@ public slots:
 
 private slots:
     void updateMx();
+    void histSample();
     void help();
     void save();
 
@@ -151,6 +177,13 @@ protected:
     virtual void closeEvent( QCloseEvent *e );
 
 private:
+    int  updateReaders( QTextEdit *te );
+    void updatePlacement( QTextEdit *te );
+    void updateTrends( QTextEdit *te );
+    int  updateTelemetry( QTextEdit *te );
+    int  updateTrigger( QTextEdit *te );
+    int  updateAudio( QTextEdit *te );
+    int  updateSync( QTextEdit *te );
     void saveScreenState();
     void restoreScreenState();
 };
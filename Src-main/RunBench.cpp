@@ -0,0 +1,467 @@
+
+#include "RunBench.h"
+#include "Util.h"
+#include "MainApp.h"
+#include "MetricsWindow.h"
+#include "Run.h"
+#include "AIQ.h"
+#include "Biquad.h"
+#include "Decimator.h"
+#include "Subset.h"
+
+#include "SHA1.h"
+#undef TCHAR
+
+#include <QFile>
+#include <QSettings>
+#include <QTextStream>
+
+
+// Stream lag, rate and fill figures ignore the first
+// RAMPSECS seconds while readers and writers spin up.
+#define RAMPSECS    1.0
+
+// Kernel timing: each runs at least KRNSECS on blocks of
+// KRNSCANS scans, with imec (385) or nidq (9) channel counts.
+#define KRNSECS     0.5
+#define KRNSCANS    3000
+#define KRNIMCHN    385
+#define KRNNICHN    9
+
+// Time statement S; set secs per execution.
+#define KRNTIME( secs, S )                          \
+    do {                                            \
+        double  _t = getTime();                     \
+        int     _n = 0;                             \
+        do {S; ++_n;} while( getTime() - _t < KRNSECS ); \
+        secs = (getTime() - _t) / _n;               \
+    } while( 0 )
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+static void krnPut(
+    QTextStream &ts,
+    const char  *name,
+    double      secs,
+    int         nScans,
+    int         nChans )
+{
+    ts << name << "_nsPerScan=" << 1e9 * secs / nScans << "\n";
+    ts << name << "_MBps="
+       << nScans * nChans * sizeof(qint16) / (secs * 1024*1024) << "\n";
+}
+
+
+std::atomic<qint64> RunBench::stgCPU_us[RunBench::NSTG];
+
+/* ---------------------------------------------------------------- */
+/* RunBench ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+RunBench::RunBench( double secs, const QString &outFile )
+    :   QObject(0), outFile(outFile), secs(secs),
+        t0(0), tRun(0), cpu0(0), cpuRun(0),
+        imLag(0), niLag(0), rdrFill(0), imFull(0), niFull(0),
+        sumWbps(0), rbps(0), nWbps(0), started(false)
+{
+    for( int is = 0; is < NSTG; ++is )
+        stgCPU_us[is] = 0;
+
+    sampTimer.setInterval( 250 );
+    ConnectUI( &sampTimer, SIGNAL(timeout()), this, SLOT(sample()) );
+}
+
+
+// Parse "-bench=secs[,file]" or "-microbench[=file]".
+//
+// Return new RunBench, or 0 if not requested.
+//
+RunBench *RunBench::fromArgs( const QStringList &args )
+{
+    foreach( const QString &a, args ) {
+
+        if( a.startsWith( "-microbench" ) )
+            return new RunBench( 0, a.mid( 12 ) );
+
+        if( a.startsWith( "-bench=" ) ) {
+
+            QString s   = a.mid( 7 );
+            int     i   = s.indexOf( ',' );
+            double  t   = s.left( i ).toDouble();
+
+            return new RunBench(
+                        (t > 0 ? t : 10.0),
+                        (i >= 0 ? s.mid( i + 1 ) : QString()) );
+        }
+    }
+
+    return 0;
+}
+
+
+// Stage threads call this on exit to add their lifetime CPU.
+//
+void RunBench::addCPU( Stage stg )
+{
+    stgCPU_us[stg] += qint64(1e6 * getThreadCPUSecs());
+}
+
+
+// Time hot inner loops on synthetic data.
+//
+// Not covered: CniAcqDmx::demuxMerge, doProbe_T0 (need
+// hardware builds) and SVGrafsM_Im::putScans (needs a view).
+//
+// Return name=value lines.
+//
+QString RunBench::kernels()
+{
+    QString     s;
+    QTextStream ts( &s, QIODevice::WriteOnly );
+    vec_i16     im( KRNSCANS * KRNIMCHN ),
+                ni( KRNSCANS * KRNNICHN ),
+                dst;
+    double      secs;
+
+    for( int i = 0, n = im.size(); i < n; ++i )
+        im[i] = qint16((i * 2654435761U) >> 23) - 256;
+
+    for( int i = 0, n = ni.size(); i < n; ++i )
+        ni[i] = qint16((i * 2654435761U) >> 16);
+
+// Filters
+
+    {
+        Biquad  hp( bq_type_highpass, 300 / 30000.0 );
+
+        KRNTIME( secs,
+            hp.applyBlockwiseMem(
+                &im[0], 512, KRNSCANS, KRNIMCHN, 0, KRNIMCHN - 1 ) );
+        krnPut( ts, "biquadAP", secs, KRNSCANS, KRNIMCHN );
+    }
+
+    {
+        Biquad  hp( bq_type_highpass, 300 / 30000.0 ),
+                hx( bq_type_highpass, 300 / 30000.0 );
+        vec_i16 a( im.size() ), b;
+        int     err = 0;
+
+        KRNTIME( secs,
+            hx.applyBlockwiseFxp(
+                &im[0], 512, KRNSCANS, KRNIMCHN, 0, KRNIMCHN - 1 ) );
+        krnPut( ts, "biquadAPfxp", secs, KRNSCANS, KRNIMCHN );
+
+        // Fixed vs double on same fresh input
+
+        hx.clearMem();
+
+        for( int i = 0; i < 4; ++i ) {
+
+            for( int j = 0, n = a.size(); j < n; ++j )
+                a[j] = qint16(((j + i) * 2654435761U) >> 23) - 256;
+
+            b = a;
+
+            hp.applyBlockwiseMem(
+                &a[0], 512, KRNSCANS, KRNIMCHN, 0, KRNIMCHN - 1 );
+            hx.applyBlockwiseFxp(
+                &b[0], 512, KRNSCANS, KRNIMCHN, 0, KRNIMCHN - 1 );
+
+            for( int j = 0, n = a.size(); j < n; ++j )
+                err = qMax( err, qAbs( a[j] - b[j] ) );
+        }
+
+        ts << "biquadFxpMaxErrLSB=" << err << "\n";
+    }
+
+// Subset
+
+    {
+        QVector<uint>   iKeep;
+
+        for( int c = 0; c < KRNIMCHN; c += 2 )
+            iKeep.push_back( c );
+
+        KRNTIME( secs, Subset::subset( dst, im, iKeep, KRNIMCHN ) );
+        krnPut( ts, "subsetHalf", secs, KRNSCANS, KRNIMCHN );
+
+        KRNTIME( secs, Subset::downsample( dst, im, KRNIMCHN, 12 ) );
+        krnPut( ts, "downsample12", secs, KRNSCANS, KRNIMCHN );
+
+        KRNTIME( secs, Decimator::downsample( dst, im, KRNIMCHN, 12 ) );
+        krnPut( ts, "decimateFIR12", secs, KRNSCANS, KRNIMCHN );
+    }
+
+// Stream queue
+
+    {
+        AIQ Q( 30000, KRNIMCHN, 4 );
+
+        KRNTIME( secs, Q.enqueue( &im[0], KRNSCANS ) );
+        krnPut( ts, "aiqEnqueue", secs, KRNSCANS, KRNIMCHN );
+
+        KRNTIME( secs,
+            Q.getNScansFromCt( dst, Q.endCount() - KRNSCANS, KRNSCANS ) );
+        krnPut( ts, "aiqGetNScans", secs, KRNSCANS, KRNIMCHN );
+    }
+
+    {
+        AIQ     Q( 25000, KRNNICHN, 4 );
+        vec_i16 flat( ni.size(), 0 );
+        quint64 outCt;
+
+        for( int i = 0; i < 25; ++i )
+            Q.enqueue( &flat[0], KRNSCANS );
+
+        quint64 from = Q.endCount() - 20 * KRNSCANS;
+
+        KRNTIME( secs, Q.findRisingEdge( outCt, from, 0, 1000, 5 ) );
+        krnPut( ts, "aiqFindEdgeNI", secs, 20 * KRNSCANS, KRNNICHN );
+    }
+
+// SHA1: as detected, then each backend this CPU has
+
+    {
+        static const char   *name[3] = {"sha1Scalar", "sha1SSSE3", "sha1NI"};
+        CSHA1::BACKEND      be0 = CSHA1::GetBackend();
+        CSHA1               sha;
+
+        KRNTIME( secs,
+            sha.Update(
+                (const UINT_8*)&im[0],
+                UINT_32(im.size() * sizeof(qint16)) ) );
+        krnPut( ts, "sha1Update", secs, KRNSCANS, KRNIMCHN );
+
+        for( int be = CSHA1::BACKEND_SCALAR; be <= CSHA1::BACKEND_NI; ++be ) {
+
+            if( !CSHA1::SetBackend( CSHA1::BACKEND(be) ) )
+                continue;
+
+            KRNTIME( secs,
+                sha.Update(
+                    (const UINT_8*)&im[0],
+                    UINT_32(im.size() * sizeof(qint16)) ) );
+            krnPut( ts, name[be], secs, KRNSCANS, KRNIMCHN );
+        }
+
+        CSHA1::SetBackend( be0 );
+        ts << "sha1Backend=" << name[be0] << "\n";
+    }
+
+    ts.flush();
+    return s;
+}
+
+
+// Last saved result "group/name", else def.
+//
+double RunBench::result( const QString &key, double def )
+{
+    STDSETTINGS( settings, "microbench" );
+
+    bool    ok;
+    double  v = settings.value( key, def ).toDouble( &ok );
+
+    return (ok ? v : def);
+}
+
+
+void RunBench::setError( const QString &e )
+{
+    if( err.isEmpty() )
+        err = e;
+
+    Error() << "Bench: " << e;
+}
+
+
+void RunBench::runStarted()
+{
+    started = true;
+    t0      = getTime();
+    cpu0    = getProcessCPUSecs();
+
+    sampTimer.start();
+    QTimer::singleShot( int(1000 * secs), this, SLOT(stop()) );
+
+    Log() << QString("Bench running %1 seconds.").arg( secs );
+}
+
+
+void RunBench::runStopped()
+{
+    sampTimer.stop();
+
+    if( started && !tRun ) {
+        tRun    = getTime() - t0;
+        cpuRun  = getProcessCPUSecs() - cpu0;
+    }
+
+    report();
+}
+
+
+void RunBench::start()
+{
+    QString e = mainApp()->remoteStartsRun();
+
+    if( !e.isEmpty() ) {
+        setError( e );
+        report();
+    }
+}
+
+
+void RunBench::startKernels()
+{
+    QString s = kernels();
+
+    Log() << "Kernel results:\n" << s;
+
+    saveResults( "Kernels", s );
+
+    if( !outFile.isEmpty() ) {
+
+        QFile   f( outFile );
+
+        if( f.open( QIODevice::WriteOnly | QIODevice::Text ) )
+            f.write( STR2CHR( s ) );
+        else
+            Error() << "Bench: Can't write '" << outFile << "'.";
+    }
+
+    qApp->exit( 0 );
+}
+
+
+void RunBench::sample()
+{
+    double  tNow = getTime();
+
+    if( tNow - t0 < RAMPSECS )
+        return;
+
+    Run                         *run = mainApp()->getRun();
+    const AIQ                   *Q;
+    QVector<AIQ::ReaderStat>    vS;
+    double                      imF, niF, wbps;
+
+// Stream head lag and consumer fill
+
+    for( int ip = 0; ; ++ip ) {
+
+        Q = run->getImQ( ip );
+
+        if( !Q ) {
+
+            if( !(Q = run->getNiQ()) )
+                break;
+
+            niLag = qMax( niLag, tNow - Q->endTime() );
+            ip    = -2;
+        }
+        else
+            imLag = qMax( imLag, tNow - Q->endTime() );
+
+        Q->readerStats( vS );
+
+        for( int ir = 0, nr = vS.size(); ir < nr; ++ir ) {
+
+            if( vS[ir].idleSecs <= 5.0 )
+                rdrFill = qMax( rdrFill, vS[ir].fillPct );
+        }
+
+        if( ip < 0 )
+            break;
+    }
+
+// Writers
+
+    mainApp()->metrics()->getDiskPerf( imF, niF, wbps, rbps );
+
+    imFull  = qMax( imFull, imF );
+    niFull  = qMax( niFull, niF );
+    sumWbps += wbps;
+    ++nWbps;
+}
+
+
+void RunBench::stop()
+{
+    sampTimer.stop();
+
+    tRun    = getTime() - t0;
+    cpuRun  = getProcessCPUSecs() - cpu0;
+
+    mainApp()->remoteStopsRun();
+}
+
+
+// Write name=value lines and quit with status 0 (ok) or 1.
+//
+void RunBench::report()
+{
+    QString     s;
+    QTextStream ts( &s, QIODevice::WriteOnly );
+
+    ts << "benchSecs="      << tRun << "\n";
+    ts << "cpuSecs="        << cpuRun << "\n";
+    ts << "cpuAcqSecs="     << stgCPU_us[stgAcq] / 1e6 << "\n";
+    ts << "cpuTrigSecs="    << stgCPU_us[stgTrig] / 1e6 << "\n";
+    ts << "cpuWriteSecs="   << stgCPU_us[stgWrite] / 1e6 << "\n";
+    ts << "wrMBpsAvg="      << (nWbps ? sumWbps / nWbps : 0) << "\n";
+    ts << "wrMBpsReq="      << rbps << "\n";
+    ts << "wrBufPctPeakIm=" << imFull << "\n";
+    ts << "wrBufPctPeakNi=" << niFull << "\n";
+    ts << "lagSecsMaxIm="   << imLag << "\n";
+    ts << "lagSecsMaxNi="   << niLag << "\n";
+    ts << "rdrPctPeak="     << rdrFill << "\n";
+
+    if( !err.isEmpty() )
+        ts << "error=" << err << "\n";
+
+    ts.flush();
+
+    Log() << "Bench results:\n" << s;
+
+    if( err.isEmpty() )
+        saveResults( "Bench", s );
+
+    if( !outFile.isEmpty() ) {
+
+        QFile   f( outFile );
+
+        if( f.open( QIODevice::WriteOnly | QIODevice::Text ) )
+            f.write( STR2CHR( s ) );
+        else
+            Error() << "Bench: Can't write '" << outFile << "'.";
+    }
+
+    qApp->exit( err.isEmpty() ? 0 : 1 );
+}
+
+
+// Store name=value lines of s under group, replacing the
+// group's previous results.
+//
+void RunBench::saveResults( const QString &group, const QString &s )
+{
+    STDSETTINGS( settings, "microbench" );
+
+    settings.remove( group );
+    settings.beginGroup( group );
+
+    foreach( const QString &line, s.split( "\n", QString::SkipEmptyParts ) ) {
+
+        int i = line.indexOf( '=' );
+
+        if( i > 0 )
+            settings.setValue( line.left( i ), line.mid( i + 1 ) );
+    }
+
+    settings.endGroup();
+}
+
+
@@ -0,0 +1,93 @@
+#ifndef RUNBENCH_H
+#define RUNBENCH_H
+
+#include <QObject>
+#include <QTimer>
+
+#include <atomic>
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Unattended pipeline benchmark, command line "-bench=secs[,file]".
+// Or, "-microbench[=file]" times hot kernels in isolation (see
+// kernels()) and quits without running.
+//
+// Starts a run with the current (accepted) settings, typically
+// simulated sources, lets it go for secs, stops it, then writes
+// name=value results to file (or the log) and quits the app.
+//
+// Sampled while running: stream head lag (AIQ::endTime), worst
+// registered-reader fill, writer buffer fill (SampleBufQ) and
+// write rate. Stage threads report their lifetime CPU seconds
+// via addCPU() as they exit, so those totals are complete after
+// the run stops.
+//
+// Both kinds of results are also kept in _Configs/microbench.ini
+// (groups Kernels and Bench) for the configuration's budget
+// planner; see result().
+//
+class RunBench : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Stage {
+        stgAcq      = 0,
+        stgTrig     = 1,
+        stgWrite    = 2,
+        NSTG        = 3
+    };
+
+private:
+    static std::atomic<qint64>  stgCPU_us[NSTG];
+
+    QTimer      sampTimer;
+    QString     outFile,
+                err;
+    double      secs,           // 0 = kernels only
+                t0,
+                tRun,
+                cpu0,
+                cpuRun,
+                imLag,
+                niLag,
+                rdrFill,
+                imFull,
+                niFull,
+                sumWbps,
+                rbps;
+    int         nWbps;
+    bool        started;
+
+public:
+    RunBench( double secs, const QString &outFile );
+
+    static RunBench *fromArgs( const QStringList &args );
+    static void addCPU( Stage stg );
+    static QString kernels();
+    static double result( const QString &key, double def );
+
+    bool isKernels() const  {return secs <= 0;}
+
+    void setError( const QString &e );
+    void runStarted();
+    void runStopped();
+
+public slots:
+    void start();
+    void startKernels();
+
+private slots:
+    void sample();
+    void stop();
+
+private:
+    void report();
+    static void saveResults( const QString &group, const QString &s );
+};
+
+#endif  // RUNBENCH_H
+
+
@@ -1,24 +1,34 @@
 
 HEADERS += \
     $$PWD/ConsoleWindow.h \
+    $$PWD/LogQ.h \
     $$PWD/Main_Actions.h \
     $$PWD/Main_Msg.h \
     $$PWD/Main_WinMenu.h \
     $$PWD/MainApp.h \
+    $$PWD/MetricsHist.h \
     $$PWD/MetricsWindow.h \
     $$PWD/MXLEDWidget.h \
+    $$PWD/RunBench.h \
+    $$PWD/TaskPool.h \
+    $$PWD/Trace.h \
     $$PWD/Util.h \
     $$PWD/Version.h
 
 SOURCES += \
     $$PWD/ConsoleWindow.cpp \
     $$PWD/main.cpp \
+    $$PWD/LogQ.cpp \
     $$PWD/Main_Actions.cpp \
     $$PWD/Main_Msg.cpp \
     $$PWD/Main_WinMenu.cpp \
     $$PWD/MainApp.cpp \
+    $$PWD/MetricsHist.cpp \
     $$PWD/MetricsWindow.cpp \
     $$PWD/MXLEDWidget.cpp \
+    $$PWD/RunBench.cpp \
+    $$PWD/TaskPool.cpp \
+    $$PWD/Trace.cpp \
     $$PWD/Util.cpp \
     $$PWD/Util_osdep.cpp
 
@@ -0,0 +1,313 @@
+
+#include "TaskPool.h"
+#include "Util.h"
+#include "Trace.h"
+
+#include <QThread>
+
+#include <algorithm>
+
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+TaskPool::Local         TaskPool::loc[TASKPOOL_MAXTHDS];
+std::deque<PoolTask*>   TaskPool::injQ[TaskPool::NCLASS];
+QThread                 *TaskPool::thds[TASKPOOL_MAXTHDS];
+QMutex                  TaskPool::mtx;
+QWaitCondition          TaskPool::cond;
+std::atomic<int>        TaskPool::nQueued( 0 );
+std::atomic<int>        TaskPool::nThd( 0 );
+int                     TaskPool::nIdle     = 0;
+int                     TaskPool::maxThds   = 0;
+bool                    TaskPool::stopping  = false;
+
+// Pool thread index, -1 if not a pool thread.
+static thread_local int me = -1;
+
+
+static QThread::Priority clsPrio( int cls )
+{
+    switch( cls ) {
+        case TaskPool::Write:   return QThread::LowPriority;
+        case TaskPool::Display: return QThread::NormalPriority;
+        default:                return QThread::LowestPriority;
+    }
+}
+
+
+// Remove T from Q if there.
+//
+static bool erase( std::deque<PoolTask*> &Q, PoolTask *T )
+{
+    std::deque<PoolTask*>::iterator it = std::find( Q.begin(), Q.end(), T );
+
+    if( it == Q.end() )
+        return false;
+
+    Q.erase( it );
+    return true;
+}
+
+/* ---------------------------------------------------------------- */
+/* PoolTask ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void PoolTask::wait()
+{
+    if( TaskPool::unqueue( this ) ) {
+        exec();
+        return;
+    }
+
+    QMutexLocker    ml( &doneMtx );
+
+    while( state.load() != 2 )
+        doneCond.wait( &doneMtx );
+}
+
+
+void PoolTask::exec()
+{
+    state = 1;
+
+    run();
+
+    if( autoDel ) {
+        delete this;
+        return;
+    }
+
+    QMutexLocker    ml( &doneMtx );
+
+    state = 2;
+    doneCond.wakeAll();
+}
+
+/* ---------------------------------------------------------------- */
+/* TaskPoolWorker ------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void TaskPoolWorker::run()
+{
+    Trace::nameThread( QString("pool %1").arg( self ) );
+
+    me = self;
+
+    while( PoolTask *T = TaskPool::take( self ) ) {
+
+        QThread::currentThread()->setPriority( clsPrio( T->cls ) );
+        T->exec();
+    }
+
+    emit finished();
+}
+
+/* ---------------------------------------------------------------- */
+/* TaskPool ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void TaskPool::setMaxThreads( int n )
+{
+    QMutexLocker    ml( &mtx );
+
+    maxThds = qBound( 1, n, TASKPOOL_MAXTHDS );
+}
+
+
+int TaskPool::maxThreads()
+{
+    QMutexLocker    ml( &mtx );
+
+    if( !maxThds ) {
+        maxThds = qBound( 2, QThread::idealThreadCount() - 2,
+                    TASKPOOL_MAXTHDS );
+    }
+
+    return maxThds;
+}
+
+
+void TaskPool::submit( PoolTask *T, int cls, bool autoDelete )
+{
+    T->cls      = qBound( 0, cls, NCLASS - 1 );
+    T->autoDel  = autoDelete;
+    T->state    = 0;
+
+    int nMax = maxThreads();
+
+    mtx.lock();
+
+    if( stopping ) {
+        mtx.unlock();
+        T->exec();
+        return;
+    }
+
+    if( me >= 0 ) {
+        loc[me].mtx.lock();
+        loc[me].Q[T->cls].push_back( T );
+        loc[me].mtx.unlock();
+    }
+    else
+        injQ[T->cls].push_back( T );
+
+    ++nQueued;
+
+    if( !nIdle && nThd.load() < nMax )
+        spawn();
+    else
+        cond.wakeOne();
+
+    mtx.unlock();
+}
+
+
+// Run everything queued, then join the threads.
+//
+void TaskPool::stop()
+{
+    mtx.lock();
+        stopping = true;
+        cond.wakeAll();
+    mtx.unlock();
+
+    for( int i = 0, n = nThd.load(); i < n; ++i ) {
+        thds[i]->wait();
+        delete thds[i];
+        thds[i] = 0;
+    }
+
+    nThd = 0;
+}
+
+
+// Next task for pool thread self, or 0 when stopping and none left.
+//
+PoolTask *TaskPool::take( int self )
+{
+    for(;;) {
+
+        if( PoolTask *T = find( self ) )
+            return T;
+
+        QMutexLocker    ml( &mtx );
+
+        if( nQueued.load() > 0 )
+            continue;
+
+        if( stopping )
+            return 0;
+
+        ++nIdle;
+        cond.wait( &mtx );
+        --nIdle;
+    }
+}
+
+
+PoolTask *TaskPool::find( int self )
+{
+    if( !nQueued.load() )
+        return 0;
+
+    int nT = nThd.load();
+
+    for( int cls = 0; cls < NCLASS; ++cls ) {
+
+        PoolTask    *T = 0;
+
+        // Own deque, newest
+
+        loc[self].mtx.lock();
+
+            std::deque<PoolTask*>   &Q = loc[self].Q[cls];
+
+            if( !Q.empty() ) {
+                T = Q.back();
+                Q.pop_back();
+            }
+
+        loc[self].mtx.unlock();
+
+        // Shared queue, oldest
+
+        if( !T ) {
+
+            mtx.lock();
+
+                if( !injQ[cls].empty() ) {
+                    T = injQ[cls].front();
+                    injQ[cls].pop_front();
+                }
+
+            mtx.unlock();
+        }
+
+        // Steal oldest from others
+
+        for( int k = 1; !T && k < nT; ++k ) {
+
+            Local   &L = loc[(self + k) % nT];
+
+            L.mtx.lock();
+
+                if( !L.Q[cls].empty() ) {
+                    T = L.Q[cls].front();
+                    L.Q[cls].pop_front();
+                }
+
+            L.mtx.unlock();
+        }
+
+        if( T ) {
+            --nQueued;
+            return T;
+        }
+    }
+
+    return 0;
+}
+
+
+// Take T back if no thread has it yet.
+//
+bool TaskPool::unqueue( PoolTask *T )
+{
+    QMutexLocker    ml( &mtx );
+    bool            found = erase( injQ[T->cls], T );
+
+    for( int i = 0, n = nThd.load(); !found && i < n; ++i ) {
+        QMutexLocker    ml2( &loc[i].mtx );
+        found = erase( loc[i].Q[T->cls], T );
+    }
+
+    if( found )
+        --nQueued;
+
+    return found;
+}
+
+
+// Caller holds mtx.
+//
+void TaskPool::spawn()
+{
+    int             i       = nThd.load();
+    QThread         *thread = new QThread;
+    TaskPoolWorker  *worker = new TaskPoolWorker( i );
+
+    worker->moveToThread( thread );
+
+    Connect( thread, SIGNAL(started()), worker, SLOT(run()) );
+    Connect( worker, SIGNAL(finished()), worker, SLOT(deleteLater()) );
+    Connect( worker, SIGNAL(destroyed()), thread, SLOT(quit()), Qt::DirectConnection );
+
+    thds[i] = thread;
+    nThd    = i + 1;
+
+    thread->start( QThread::LowPriority );
+}
+
+
@@ -0,0 +1,133 @@
+#ifndef TASKPOOL_H
+#define TASKPOOL_H
+
+#include <QMutex>
+#include <QObject>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <deque>
+
+class QThread;
+
+// Most pool threads; default is two fewer than cores, at least 2.
+#define TASKPOOL_MAXTHDS    8
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// A unit of pool work. Subclass and implement run().
+//
+// Submitted with autoDelete the pool deletes the task after
+// run(). Otherwise the owner calls wait() before deleting it;
+// wait() runs the task in the caller's thread if no pool thread
+// has taken it yet, so a waiter never queues behind other work.
+//
+class PoolTask
+{
+    friend class TaskPool;
+
+private:
+    QMutex              doneMtx;
+    QWaitCondition      doneCond;
+    std::atomic<int>    state;      // 0=queued, 1=running, 2=done
+    int                 cls;
+    bool                autoDel;
+
+public:
+    PoolTask() : state(0), cls(0), autoDel(true)   {}
+    virtual ~PoolTask()                             {}
+
+    virtual void run() = 0;
+
+    bool isDone() const {return state.load() == 2;}
+    void wait();
+
+private:
+    void exec();
+};
+
+
+class TaskPoolWorker : public QObject
+{
+    Q_OBJECT
+
+private:
+    int self;
+
+public:
+    TaskPoolWorker( int self ) : QObject(0), self(self)    {}
+
+signals:
+    void finished();
+
+public slots:
+    void run();
+};
+
+
+// Shared pool for short jobs that would otherwise each spawn a
+// thread: file close tails and sidecar index builds. Threads
+// are started on demand up to maxThreads and live until stop().
+//
+// Each thread has its own deque per class. A task submitted from
+// a pool thread goes to that thread's deque (newest first, while
+// its data are warm); others go to a shared injection queue. An
+// idle thread takes, in class order, from its own deque, then the
+// shared queue, then the oldest task of another thread.
+//
+// Class sets order of service and the thread priority the task
+// runs at. Acquisition, trigger, writer and display fetch threads
+// are not pool work: they block on streams for the whole run and
+// keep their dedicated (possibly pinned) threads.
+//
+// After stop(), submit() runs tasks synchronously.
+//
+class TaskPool
+{
+    friend class PoolTask;
+    friend class TaskPoolWorker;
+
+public:
+    enum Class {
+        Write       = 0,    // file close tails
+        Display     = 1,    // viewer processing
+        Background  = 2,    // index builds, housekeeping
+        NCLASS      = 3
+    };
+
+private:
+    struct Local {
+        QMutex                  mtx;
+        std::deque<PoolTask*>   Q[NCLASS];
+    };
+
+    static Local                    loc[TASKPOOL_MAXTHDS];
+    static std::deque<PoolTask*>    injQ[NCLASS];
+    static QThread                  *thds[TASKPOOL_MAXTHDS];
+    static QMutex                   mtx;
+    static QWaitCondition           cond;
+    static std::atomic<int>         nQueued,
+                                    nThd;
+    static int                      nIdle,
+                                    maxThds;
+    static bool                     stopping;
+
+public:
+    static void setMaxThreads( int n );
+    static int maxThreads();
+
+    static void submit( PoolTask *T, int cls, bool autoDelete = true );
+    static void stop();
+
+private:
+    static PoolTask *take( int self );
+    static PoolTask *find( int self );
+    static bool unqueue( PoolTask *T );
+    static void spawn();
+};
+
+#endif  // TASKPOOL_H
+
+
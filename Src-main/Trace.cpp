@@ -0,0 +1,349 @@
+
+#include "Trace.h"
+#include "Util.h"
+
+#include <QFile>
+#include <QMutex>
+#include <QTextStream>
+#include <QThread>
+
+#include <vector>
+
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+struct TraceEvt {
+    const char  *name;
+    quint64     tUs,
+                durUs;
+    double      val;
+    int         id;
+    char        ph;     // 'X' zone, 'C' counter, 'i' instant
+};
+
+struct TraceRing {
+    TraceEvt                E[Trace::NEVT];
+    std::atomic<quint64>    head;   // events ever written
+    std::atomic<bool>       alive;  // owner thread not exited
+    QString                 name;   // guarded by trcMtx
+    int                     tid;
+
+    TraceRing( int tid ) : head(0), alive(true), tid(tid)   {}
+};
+
+// Thread's handle; at thread exit marks its ring dead,
+// so the next start() can free it.
+//
+struct TraceRef {
+    TraceRing   *R;
+    QString     name;
+
+    TraceRef() : R(0)   {}
+    ~TraceRef() {if( R ) R->alive.store( false, std::memory_order_release );}
+};
+
+
+// Latest-value slot: state 0=free, 1=claiming, 2=ready.
+// Each (name, id) is normally written by one thread only.
+//
+struct TraceLast {
+    std::atomic<int>            state;
+    const char                  *name;
+    int                         id;
+    std::atomic<double>         val;
+
+    TraceLast() : state(0), name(0), id(0), val(0)  {}
+};
+
+
+std::atomic<bool>   Trace::enabled( false ),
+                    Trace::keepLast( false );
+
+static TraceLast                lasts[Trace::NLAST];
+
+static QMutex                   trcMtx;
+static std::vector<TraceRing*>  rings;
+static quint64                  tStartUs    = 0;
+static int                      nextTid     = 0;
+static thread_local TraceRef    me;
+
+
+// Calling thread's ring, made on its first event.
+//
+static TraceRing *myRing()
+{
+    if( !me.R ) {
+
+        QMutexLocker    ml( &trcMtx );
+
+        me.R = new TraceRing( ++nextTid );
+
+        if( !me.name.isEmpty() )
+            me.R->name = me.name;
+        else if( !QThread::currentThread()->objectName().isEmpty() )
+            me.R->name = QThread::currentThread()->objectName();
+        else
+            me.R->name = QString("thread %1").arg( me.R->tid );
+
+        rings.push_back( me.R );
+    }
+
+    return me.R;
+}
+
+
+// Sole writer of its ring: fill the slot, then publish.
+//
+static void record(
+    const char  *name,
+    quint64     tUs,
+    quint64     durUs,
+    double      val,
+    int         id,
+    char        ph )
+{
+    TraceRing   *R = myRing();
+    quint64     h  = R->head.load( std::memory_order_relaxed );
+    TraceEvt    &E = R->E[h & (Trace::NEVT - 1)];
+
+    E.name  = name;
+    E.tUs   = tUs;
+    E.durUs = durUs;
+    E.val   = val;
+    E.id    = id;
+    E.ph    = ph;
+
+    R->head.store( h + 1, std::memory_order_release );
+}
+
+
+static QString jsonStr( const QString &s )
+{
+    return QString(s).replace( "\\", "\\\\" ).replace( "\"", "\\\"" );
+}
+
+
+static void writeEvt( QTextStream &ts, const TraceEvt &E, int tid )
+{
+    QString name = E.name;
+
+    if( E.ph == 'C' && E.id >= 0 )
+        name += QString(" %1").arg( E.id );
+
+    ts << QString(",\n{\"name\":\"%1\",\"ph\":\"%2\",\"pid\":1,\"tid\":%3,\"ts\":%4")
+            .arg( jsonStr( name ) ).arg( E.ph ).arg( tid )
+            .arg( E.tUs - tStartUs );
+
+    if( E.ph == 'X' ) {
+
+        ts << QString(",\"dur\":%1").arg( E.durUs );
+
+        if( E.id >= 0 )
+            ts << QString(",\"args\":{\"id\":%1}").arg( E.id );
+    }
+    else if( E.ph == 'C' )
+        ts << QString(",\"args\":{\"value\":%1}").arg( E.val );
+    else
+        ts << ",\"s\":\"t\"";
+
+    ts << "}";
+}
+
+/* ---------------------------------------------------------------- */
+/* Trace ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+quint64 Trace::nowUs()
+{
+    return quint64(1e6 * getTime());
+}
+
+
+// Events are kept from now. Rings of exited threads are freed;
+// live ones keep their slots (older events are skipped at stop).
+//
+void Trace::start()
+{
+    QMutexLocker    ml( &trcMtx );
+
+    for( int i = int(rings.size()) - 1; i >= 0; --i ) {
+
+        if( !rings[i]->alive.load( std::memory_order_acquire ) ) {
+            delete rings[i];
+            rings.erase( rings.begin() + i );
+        }
+    }
+
+    tStartUs = nowUs();
+    enabled.store( true, std::memory_order_relaxed );
+
+    Log() << "Tracing started";
+}
+
+
+// Stop recording and write the trace to file.
+//
+bool Trace::stop( QString &err, const QString &file )
+{
+    if( !on() ) {
+        err = "Tracing is not started.";
+        return false;
+    }
+
+    enabled.store( false, std::memory_order_relaxed );
+
+// Let in-flight records land
+
+    QThread::msleep( 10 );
+
+    QMutexLocker    ml( &trcMtx );
+    QFile           f( file );
+
+    if( !f.open( QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text ) ) {
+        err = QString("Can't open trace file '%1'.").arg( file );
+        return false;
+    }
+
+    QTextStream ts( &f );
+    quint64     nEvt = 0;
+
+    ts << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+          "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+          "\"args\":{\"name\":\"SpikeGLX\"}}";
+
+    for( int ir = 0, nr = rings.size(); ir < nr; ++ir ) {
+
+        const TraceRing *R = rings[ir];
+        quint64         h  = R->head.load( std::memory_order_acquire ),
+                        k0 = (h > NEVT ? h - NEVT : 0);
+
+        ts << QString(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                "\"tid\":%1,\"args\":{\"name\":\"%2\"}}")
+                .arg( R->tid ).arg( jsonStr( R->name ) );
+
+        for( quint64 k = k0; k < h; ++k ) {
+
+            const TraceEvt  &E = R->E[k & (NEVT - 1)];
+
+            if( E.tUs >= tStartUs ) {
+                writeEvt( ts, E, R->tid );
+                ++nEvt;
+            }
+        }
+    }
+
+    ts << "\n]}\n";
+    ts.flush();
+
+    if( f.error() != QFile::NoError ) {
+        err = QString("Error writing trace file '%1'.").arg( file );
+        return false;
+    }
+
+    Log() << QString("Tracing stopped: %1 events to '%2'").arg( nEvt ).arg( file );
+    return true;
+}
+
+
+// Name calling thread's trace track.
+//
+void Trace::nameThread( const QString &name )
+{
+    me.name = name;
+
+    if( me.R ) {
+        QMutexLocker    ml( &trcMtx );
+        me.R->name = name;
+    }
+}
+
+
+// Zone [t0Us, now].
+//
+void Trace::zone( const char *name, quint64 t0Us, int id )
+{
+    if( on() ) {
+
+        quint64 t = nowUs();
+
+        record( name, t0Us, (t > t0Us ? t - t0Us : 0), 0, id, 'X' );
+    }
+}
+
+
+// Store newest value of (name, id), claiming a slot if new;
+// dropped if the table is full.
+//
+static void setLast( const char *name, double val, int id )
+{
+    for( int i = 0; i < Trace::NLAST; ++i ) {
+
+        TraceLast   &L  = lasts[i];
+        int         st  = L.state.load( std::memory_order_acquire );
+
+        if( st == 2 ) {
+
+            if( L.name == name && L.id == id ) {
+                L.val.store( val, std::memory_order_relaxed );
+                return;
+            }
+        }
+        else if( !st ) {
+
+            if( !L.state.compare_exchange_strong( st, 1 ) )
+                continue;
+
+            L.name  = name;
+            L.id    = id;
+            L.val.store( val, std::memory_order_relaxed );
+            L.state.store( 2, std::memory_order_release );
+            return;
+        }
+    }
+}
+
+
+void Trace::counter( const char *name, double val, int id )
+{
+    if( on() )
+        record( name, nowUs(), 0, val, id, 'C' );
+
+    if( keepLast.load( std::memory_order_relaxed ) )
+        setLast( name, val, id );
+}
+
+
+void Trace::keepLatest( bool keep )
+{
+    keepLast.store( keep, std::memory_order_relaxed );
+}
+
+
+// Ready slots, in order claimed.
+//
+void Trace::latest( std::vector<Latest> &v )
+{
+    v.clear();
+
+    for( int i = 0; i < NLAST; ++i ) {
+
+        const TraceLast &L = lasts[i];
+
+        if( L.state.load( std::memory_order_acquire ) != 2 )
+            continue;
+
+        Latest  X = {L.name, L.id, L.val.load( std::memory_order_relaxed )};
+        v.push_back( X );
+    }
+}
+
+
+void Trace::instant( const char *name, int id )
+{
+    if( on() )
+        record( name, nowUs(), 0, 0, id, 'i' );
+}
+
+
@@ -0,0 +1,95 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QString>
+
+#include <atomic>
+#include <vector>
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Always-compiled event tracing, off until start().
+//
+// Each thread that records gets its own ring of NEVT events, so
+// recording is a relaxed store and a release of the ring head;
+// no locks, no allocation after a thread's first event. Oldest
+// events are overwritten when a ring wraps. While tracing is off
+// every probe costs one relaxed load.
+//
+// Events:
+// - Zone: named span, usually via a scoped TraceZone.
+// - Counter: named value at a time.
+// - Instant: named moment.
+// Names must be string literals (pointers are stored). The
+// optional id (e.g. stream ip) is exported as an argument of
+// zones, and as a name suffix of counters.
+//
+// stop() writes everything recorded since start() to a file in
+// Chrome trace JSON, viewable in Perfetto or chrome://tracing.
+//
+// Independently, keepLatest( true ) has counters also store their
+// newest value, per name and id, in a fixed table of NLAST slots
+// (claimed on first use, never freed) that latest() reads without
+// locks, for metrics exporters. Guard costly counter arguments
+// with counting() rather than on().
+//
+class Trace
+{
+public:
+    enum {
+        NEVT    = 32*1024,  // per-thread ring, power of 2
+        NLAST   = 64        // latest-value counter slots
+    };
+
+    struct Latest {
+        const char  *name;
+        int         id;
+        double      val;
+    };
+
+private:
+    static std::atomic<bool>    enabled,
+                                keepLast;
+
+public:
+    static inline bool on()
+        {return enabled.load( std::memory_order_relaxed );}
+    static inline bool counting()
+        {return on() || keepLast.load( std::memory_order_relaxed );}
+
+    static void keepLatest( bool keep );
+    static void latest( std::vector<Latest> &v );
+
+    static quint64 nowUs();
+
+    static void start();
+    static bool stop( QString &err, const QString &file );
+
+    static void nameThread( const QString &name );
+
+    static void zone( const char *name, quint64 t0Us, int id = -1 );
+    static void counter( const char *name, double val, int id = -1 );
+    static void instant( const char *name, int id = -1 );
+};
+
+
+// Record the scope as a zone, if tracing when constructed.
+//
+class TraceZone
+{
+private:
+    const char  *name;
+    quint64     t0;
+    int         id;
+
+public:
+    TraceZone( const char *name, int id = -1 )
+    :   name(name), t0(Trace::on() ? Trace::nowUs() : 0), id(id)  {}
+    ~TraceZone()    {if( t0 ) Trace::zone( name, t0, id );}
+};
+
+#endif  // TRACE_H
+
+
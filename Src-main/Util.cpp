@@ -1,10 +1,11 @@
 
 #include "Util.h"
 #include "MainApp.h"
-#include "ConsoleWindow.h"
+#include "LogQ.h"
 
 #include <ctime>
 #include <iostream>
+#include <math.h>
 
 #include <QMessageBox>
 #include <QThread>
@@ -39,39 +40,32 @@ namespace Util {
 
 Log::Log()
     :   stream( &str, QIODevice::WriteOnly ),
-        doprt(true), doeco(false), dodsk(false)
+        doprt(true), doeco(false), dodsk(false), dotry(false), dorai(false)
 {
 }
 
 
+// Capture raw fields; formatting and delivery are done
+// by the logger thread (see LogQ).
+//
 Log::~Log()
 {
     if( doprt ) {
 
-        QString msg =
-            QString("[Thd %1 CPU %2 %3] %4")
-                .arg( (quint64)QThread::currentThreadId() )
-                .arg( getCurProcessorIdx() )
-                .arg( dateTime2Str(
-                        QDateTime::currentDateTime(),
-                        "M/dd/yy hh:mm:ss.zzz" ) )
-                .arg( str );
-
-        MainApp *app = mainApp();
+        LogRec  R;
 
-        if( app ) {
+        R.str.swap( str );
+        R.color = color;
+        R.msecs = QDateTime::currentMSecsSinceEpoch();
+        R.thd   = (quint64)QThread::currentThreadId();
+        R.cpu   = getCurProcessorIdx();
+        R.flags = (doeco ? LogRec::lrEco : 0)
+                | (dodsk ? LogRec::lrDsk : 0)
+                | (dotry ? LogRec::lrTray : 0)
+                | (dorai ? LogRec::lrRaise : 0);
 
-            app->msg.logMsg( msg, doeco, color );
-
-            if( dodsk ) {
-                QMetaObject::invokeMethod(
-                    app, "runLogErrorToDisk",
-                    Qt::AutoConnection,
-                    Q_ARG(QString, msg) );
-            }
-        }
-        else
-            std::cerr << STR2CHR( msg ) << "\n";
+        if( !LogQ::post( R ) )
+            LogQ::deliver( R );
     }
 }
 
@@ -102,15 +96,7 @@ Error::~Error()
 
     doeco = true;
     dodsk = true;
-
-    if( app->isConsoleHidden() )
-        Systray( true ) << str;
-    else {
-        ConsoleWindow   *w = app->console();
-        QMetaObject::invokeMethod( w, "showNormal", Qt::AutoConnection );
-        QMetaObject::invokeMethod( w, "raise", Qt::AutoConnection );
-        w->activateWindow();
-    }
+    dorai = true;
 }
 
 
@@ -124,9 +110,7 @@ Warning::~Warning()
         return;
 
     doeco = true;
-
-    if( app->isConsoleHidden() )
-        Systray( true ) << str;
+    dotry = true;
 }
 
 /* ---------------------------------------------------------------- */
@@ -264,6 +248,44 @@ int ffs( int x )
     return r;
 }
 
+
+int qoctBin( double secs, double base, int nBin )
+{
+    if( secs <= base )
+        return 0;
+
+    return qMin( int(4.0 * log( secs / base ) / log( 2.0 )), nBin - 1 );
+}
+
+
+// Return upper edge of bin holding pct-th percentile,
+// or 0 if H is empty.
+//
+double qoctPctile(
+    const quint64   *H,
+    int             nBin,
+    double          base,
+    double          pct )
+{
+    quint64 N = 0, sum = 0;
+
+    for( int i = 0; i < nBin; ++i )
+        N += H[i];
+
+    if( !N )
+        return 0;
+
+    for( int i = 0; i < nBin; ++i ) {
+
+        sum += H[i];
+
+        if( sum >= 0.01 * pct * N )
+            return base * pow( 2.0, (i + 1) / 4.0 );
+    }
+
+    return base * pow( 2.0, nBin / 4.0 );
+}
+
 /* ---------------------------------------------------------------- */
 /* Objects -------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -51,7 +51,9 @@ protected:
     QColor      color;
     bool        doprt,  // debug() silent unless verbose mode
                 doeco,  // echo errors and warnings to metrics
-                dodsk;  // also record errors in runDir
+                dodsk,  // also record errors in runDir
+                dotry,  // systray if console hidden
+                dorai;  // raise console (errors)
 public:
     Log();
     virtual ~Log();
@@ -132,6 +134,15 @@ double uniformDev( double rmin = 0.0, double rmax = 1.0 );
 // Position of least significant bit (like libc::ffs)
 int ffs( int x );
 
+// Quarter-octave histograms, as telemetry keeps: bin i has
+// upper edge base*2^((i+1)/4); values <= base are in bin 0.
+int qoctBin( double secs, double base, int nBin );
+double qoctPctile(
+    const quint64   *H,
+    int             nBin,
+    double          base,
+    double          pct );
+
 /* ---------------------------------------------------------------- */
 /* Objects -------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -241,8 +252,8 @@ qint64 readChunky( const QFile &f, void *dst, qint64 bytes );
 // Efficient version of QIODevice::write
 qint64 writeChunky( QFile &f, const void *src, qint64 bytes );
 
-// Amount of space available on disk
-quint64 availableDiskSpace();
+// Amount of space available on disk holding dir (default dataDir)
+quint64 availableDiskSpace( const QString &dir = QString() );
 
 // Remove TEMP files (SpikeGL_DSTemp_*.bin)
 void removeTempDataFiles();
@@ -261,6 +272,10 @@ uint secsSinceBoot();
 // Current seconds from high resolution timer
 double getTime();
 
+// CPU seconds (user + kernel) used by process, calling thread
+double getProcessCPUSecs();
+double getThreadCPUSecs();
+
 /* ---------------------------------------------------------------- */
 /* Sockets -------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -295,9 +310,19 @@ bool isWindows7OrLater();
 // Set application process to realtime priority
 void setRTPriority();
 
+// Calling thread's disk I/O yields to everyone else's (on),
+// or returns to normal (off)
+void setThreadBkgndIO( bool on );
+
 // Set higher precision system timing on/off
 void setPreciseTiming( bool on );
 
+// Sleep calling thread for secs with sub-ms precision:
+// OS timed wait for the bulk, then spin to the deadline.
+// Waking up to slack late is acceptable, so that much less
+// is spun (none if slack covers the timer's lateness).
+void preciseSleep( double secs, double slack = 0 );
+
 // Number of real CPUs (cores) on the system
 int getNProcessors();
 
@@ -311,12 +336,87 @@ void setProcessAffinityMask( uint mask );
 // Return previous mask, or zero if error.
 uint setCurrentThreadAffinityMask( uint mask );
 
+// Mask-bits of processors on NUMA node, or zero if unknown
+uint getNumaNodeMask( int node );
+
+// NUMA node holding every processor the calling thread may run
+// on, or -1 if unknown, spanning nodes, or a single-node system
+int getCurrentThreadNumaNode();
+
 // Installed RAM as seen by 32-bit application
 double getRAMBytes32BitApp();
 
 // Installed RAM as seen by 64-bit application
 double getRAMBytes64BitApp();
 
+// Instruction set extensions usable on this machine
+enum CPUFeatureFlags {
+    cpuSSSE3    = 0x01,
+    cpuSSE41    = 0x02,
+    cpuSSE42    = 0x04,
+    cpuAVX2     = 0x08, // including OS support for YMM state
+    cpuSHA      = 0x10
+};
+
+// CPUFeatureFlags set, probed once; 0 if not x86
+uint cpuFeatures();
+bool cpuHasSSSE3();
+bool cpuHasSSE41();
+bool cpuHasSSE42();
+bool cpuHasAVX2();
+bool cpuHasSHA();
+
+// Large stream buffer options
+enum StreamMemFlags {
+    smemLock    = 0x1,  // lock pages in RAM
+    smemLarge   = 0x2,  // use large pages where available
+    smemMirror  = 0x4   // granted only: allocMirrorMem memory
+};
+
+// Allocate zeroed, pre-faulted, page-aligned memory for
+// long-lived stream buffers, honoring requested StreamMemFlags
+// where the OS permits (else silently degrading). Report the
+// granted flags in got; pass them to freeStreamMem.
+// Return 0 if fail.
+void *allocStreamMem( size_t bytes, int flags, int &got );
+
+void freeStreamMem( void *p, size_t bytes, int got );
+
+// Move allocStreamMem memory onto NUMA node, where the OS
+// permits; contents are not kept. Pass got as granted.
+// Return true if done.
+bool moveStreamMem( void *p, size_t bytes, int node, int got );
+
+// Ring backing mapped twice back to back, so p[i] and p[i+bytes]
+// are the same RAM and any window up to bytes long is contiguous.
+// bytes must be a multiple of mirrorGranule(). Only smemLock
+// applies; got includes smemMirror. Free with freeStreamMem.
+// Return 0 if the OS can't (caller then uses allocStreamMem).
+size_t mirrorGranule();
+void *allocMirrorMem( size_t bytes, int flags, int &got );
+
+// Unbuffered file output, bypassing the OS page cache.
+// Each write must be a whole multiple of DIRECTIO_ALIGN bytes
+// from a DIRECTIO_ALIGN-aligned buffer (allocStreamMem memory
+// qualifies). The file must already exist; it's overwritten
+// from offset zero.
+// Return handle, or -1 if fail.
+#define DIRECTIO_ALIGN  4096
+qintptr directFileOpen( const QString &path );
+
+// Return bytes written, or -1 if error.
+qint64 directFileWrite( qintptr h, const void *src, qint64 bytes );
+
+void directFileClose( qintptr h );
+
+// Reserve disk blocks for open file f through offset bytes,
+// leaving its size alone: no sparse extension, no zero fill.
+// Return true if done.
+bool filePreallocate( QFile &f, qint64 bytes );
+
+// Release reservation beyond f's current size.
+void fileTrimAlloc( QFile &f );
+
 /* ---------------------------------------------------------------- */
 /* Misc OS helpers ------------------------------------------------ */
 /* ---------------------------------------------------------------- */
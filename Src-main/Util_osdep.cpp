@@ -19,6 +19,7 @@
 
 #ifdef Q_OS_WIN
     #include <QDir>
+    #include <io.h>
 #elif defined(Q_WS_X11)
     #include <GL/gl.h>
     #include <GL/glx.h>
@@ -31,6 +32,7 @@
     #include <sys/types.h>
     #include <sys/stat.h>
     #include <sys/sysinfo.h>
+    #include <sys/syscall.h>
     #include <errno.h>
     #include <sched.h>
     #include <time.h>
@@ -49,7 +51,21 @@
     #include <QTime>
 #endif
 
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+    #define UTIL_X86
+    #ifdef _MSC_VER
+        #include <immintrin.h>
+        #include <intrin.h>
+    #else
+        #include <cpuid.h>
+    #endif
+#endif
+
 #if !defined(Q_OS_WIN)
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <sys/statvfs.h>
+    #include <unistd.h>
     #include <sys/socket.h>
     #include <netinet/in.h>
     #include <netinet/tcp.h>
@@ -82,12 +98,12 @@ namespace Util {
 
 #ifdef Q_OS_WIN
 
-quint64 availableDiskSpace()
+quint64 availableDiskSpace( const QString &dir )
 {
     quint64 availableBytes;
 
     if( GetDiskFreeSpaceEx(
-            mainApp()->dataDir().toStdWString().data(),
+            (dir.isEmpty() ? mainApp()->dataDir() : dir).toStdWString().data(),
             (PULARGE_INTEGER)&availableBytes,
             NULL,
             NULL ) ) {
@@ -103,8 +119,15 @@ quint64 availableDiskSpace()
 
 #else
 
-quint64 availableDiskSpace()
+quint64 availableDiskSpace( const QString &dir )
 {
+    struct statvfs  sv;
+    QByteArray      path = QFile::encodeName(
+                            dir.isEmpty() ? mainApp()->dataDir() : dir );
+
+    if( !statvfs( path.constData(), &sv ) )
+        return quint64(sv.f_bavail) * sv.f_frsize;
+
 // Failing any actual query, return either a show-stopping zero
 // or a modest number, such as 4GB.
 
@@ -199,6 +222,73 @@ double getTime()
 
 #endif
 
+/* ---------------------------------------------------------------- */
+/* getProcessCPUSecs ---------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#ifdef Q_OS_WIN
+
+static double fileTimeSecs( const FILETIME &ft )
+{
+    return (quint64(ft.dwHighDateTime) << 32 | ft.dwLowDateTime) * 1e-7;
+}
+
+double getProcessCPUSecs()
+{
+    FILETIME    c, e, k, u;
+
+    if( !GetProcessTimes( GetCurrentProcess(), &c, &e, &k, &u ) )
+        return 0;
+
+    return fileTimeSecs( k ) + fileTimeSecs( u );
+}
+
+double getThreadCPUSecs()
+{
+    FILETIME    c, e, k, u;
+
+    if( !GetThreadTimes( GetCurrentThread(), &c, &e, &k, &u ) )
+        return 0;
+
+    return fileTimeSecs( k ) + fileTimeSecs( u );
+}
+
+#elif defined(Q_OS_LINUX)
+
+static double clockSecs( clockid_t id )
+{
+    struct timespec ts;
+
+    if( clock_gettime( id, &ts ) )
+        return 0;
+
+    return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+}
+
+double getProcessCPUSecs()
+{
+    return clockSecs( CLOCK_PROCESS_CPUTIME_ID );
+}
+
+double getThreadCPUSecs()
+{
+    return clockSecs( CLOCK_THREAD_CPUTIME_ID );
+}
+
+#else /* !Q_OS_WIN && !Q_OS_LINUX */
+
+double getProcessCPUSecs()
+{
+    return 0;
+}
+
+double getThreadCPUSecs()
+{
+    return 0;
+}
+
+#endif
+
 /* ---------------------------------------------------------------- */
 /* socketNoNagle -------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -588,6 +678,37 @@ void setRTPriority()
 
 #endif
 
+/* ---------------------------------------------------------------- */
+/* setThreadBkgndIO ----------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#ifdef Q_OS_WIN
+
+void setThreadBkgndIO( bool on )
+{
+    SetThreadPriority(
+        GetCurrentThread(),
+        on ? THREAD_MODE_BACKGROUND_BEGIN : THREAD_MODE_BACKGROUND_END );
+}
+
+#elif defined(Q_OS_LINUX)
+
+// ioprio_set( IOPRIO_WHO_PROCESS, 0=calling thread, class ),
+// class IDLE on, NONE (follow CPU nice) off.
+//
+void setThreadBkgndIO( bool on )
+{
+    syscall( SYS_ioprio_set, 1, 0, (on ? 3 : 0) << 13 );
+}
+
+#else /* !Q_OS_WIN && !Q_OS_LINUX */
+
+void setThreadBkgndIO( bool )
+{
+}
+
+#endif
+
 /* ---------------------------------------------------------------- */
 /* setPreciseTiming ----------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -611,6 +732,97 @@ void setPreciseTiming( bool on )
 
 #endif
 
+/* ---------------------------------------------------------------- */
+/* preciseSleep --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#ifdef Q_OS_WIN
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION   0x00000002
+#endif
+
+// High resolution waitable timers (Win10 1803+) wake within
+// ~0.1 ms; else Sleep() granularity is ~1 ms even with
+// setPreciseTiming(), so we spin more of the interval.
+//
+struct PreciseTimer {
+    HANDLE  h;
+    double  spin;
+    PreciseTimer()
+    {
+        h = CreateWaitableTimerExW(
+                NULL, NULL,
+                CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+                TIMER_ALL_ACCESS );
+        spin = (h ? 100e-6 : 1.2e-3);
+    }
+    virtual ~PreciseTimer() {if( h ) CloseHandle( h );}
+};
+
+void preciseSleep( double secs, double slack )
+{
+    static thread_local PreciseTimer    T;
+
+    double  tEnd    = getTime() + secs,
+            coarse  = secs - qMax( 0.0, T.spin - slack );
+
+    if( coarse > 0 ) {
+
+        if( T.h ) {
+
+            LARGE_INTEGER   due;
+
+            due.QuadPart = -qint64(coarse * 1e7);   // relative, 100 ns
+
+            if( SetWaitableTimer( T.h, &due, 0, NULL, NULL, FALSE ) )
+                WaitForSingleObject( T.h, INFINITE );
+        }
+        else
+            Sleep( DWORD(1000 * coarse) );
+    }
+
+    while( getTime() < tEnd )
+        YieldProcessor();
+}
+
+#elif defined(Q_OS_LINUX)
+
+void preciseSleep( double secs, double slack )
+{
+    double  tEnd    = getTime() + secs,
+            coarse  = secs - qMax( 0.0, 60e-6 - slack );
+
+    if( coarse > 0 ) {
+
+        struct timespec ts;
+
+        ts.tv_sec   = time_t(coarse);
+        ts.tv_nsec  = long(1e9 * (coarse - ts.tv_sec));
+
+        clock_nanosleep( CLOCK_MONOTONIC, 0, &ts, NULL );
+    }
+
+    while( getTime() < tEnd )
+        ;
+}
+
+#else
+
+void preciseSleep( double secs, double slack )
+{
+    double  tEnd    = getTime() + secs,
+            coarse  = secs - qMax( 0.0, 1e-3 - slack );
+
+    if( coarse > 0 )
+        QThread::usleep( ulong(1e6 * coarse) );
+
+    while( getTime() < tEnd )
+        ;
+}
+
+#endif
+
 /* ---------------------------------------------------------------- */
 /* getNProcessors ------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -770,7 +982,42 @@ uint setCurrentThreadAffinityMask( uint mask )
         SetThreadAffinityMask( GetCurrentThread(), (DWORD_PTR)mask ));
 }
 
-#else /* !Q_OS_WIN */
+#elif defined(Q_OS_LINUX)
+
+// pid 0 addresses calling thread.
+//
+uint setCurrentThreadAffinityMask( uint mask )
+{
+    cpu_set_t   set;
+    uint        prev = 0;
+
+    CPU_ZERO( &set );
+
+    if( !sched_getaffinity( 0, sizeof(set), &set ) ) {
+
+        for( int i = 0; i < 32; ++i ) {
+            if( CPU_ISSET( i, &set ) )
+                prev |= 1u << i;
+        }
+    }
+
+    CPU_ZERO( &set );
+
+    for( int i = 0; i < 32; ++i ) {
+        if( mask & (1u << i) )
+            CPU_SET( i, &set );
+    }
+
+    if( sched_setaffinity( 0, sizeof(set), &set ) ) {
+        int e = errno;
+        Warning() << "Error from sched_setaffinity(): " << strerror( e );
+        return 0;
+    }
+
+    return prev;
+}
+
+#else /* !Q_OS_WIN && !Q_OS_LINUX */
 
 uint setCurrentThreadAffinityMask( uint )
 {
@@ -780,6 +1027,144 @@ uint setCurrentThreadAffinityMask( uint )
 
 #endif
 
+/* ---------------------------------------------------------------- */
+/* getNumaNodeMask ------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+#ifdef Q_OS_WIN
+
+uint getNumaNodeMask( int node )
+{
+    ULONGLONG   mask = 0;
+
+    if( node < 0 || node > 255
+        || !GetNumaNodeProcessorMask( UCHAR(node), &mask ) ) {
+
+        return 0;
+    }
+
+    return uint(mask & 0xFFFFFFFF);
+}
+
+#elif defined(Q_OS_LINUX)
+
+// Parse sysfs cpulist, e.g. "0-3,8-11".
+//
+uint getNumaNodeMask( int node )
+{
+    QFile   f( QString("/sys/devices/system/node/node%1/cpulist").arg( node ) );
+    uint    mask = 0;
+
+    if( node < 0 || !f.open( QIODevice::ReadOnly | QIODevice::Text ) )
+        return 0;
+
+    QStringList sl = QString(f.readAll()).trimmed().split(
+                        ",", QString::SkipEmptyParts );
+
+    foreach( const QString &s, sl ) {
+
+        QStringList ab  = s.split( "-" );
+        int         a   = ab[0].toInt(),
+                    b   = (ab.size() > 1 ? ab[1].toInt() : a);
+
+        for( int i = qMax( a, 0 ); i <= b && i < 32; ++i )
+            mask |= 1u << i;
+    }
+
+    return mask;
+}
+
+#else /* !Q_OS_WIN && !Q_OS_LINUX */
+
+uint getNumaNodeMask( int )
+{
+    return 0;
+}
+
+#endif
+
+/* ---------------------------------------------------------------- */
+/* getCurrentThreadNumaNode --------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Node whose processors include all of mask, else -1. Only
+// the first 32 processors are seen, as for affinity masks.
+//
+static int maskNumaNode( uint mask )
+{
+    int node    = -1,
+        nNode   = 0;
+
+    if( !mask )
+        return -1;
+
+    for( int n = 0; n < 64; ++n ) {
+
+        uint    nm = getNumaNodeMask( n );
+
+        if( !nm )
+            continue;
+
+        ++nNode;
+
+        if( node < 0 && !(mask & ~nm) )
+            node = n;
+    }
+
+    return (nNode > 1 ? node : -1);
+}
+
+#ifdef Q_OS_WIN
+
+// No getter for thread affinity: set it to the process mask,
+// which returns the previous one, then restore that.
+//
+int getCurrentThreadNumaNode()
+{
+    DWORD_PTR   pMask, sMask, prev;
+
+    if( !GetProcessAffinityMask( GetCurrentProcess(), &pMask, &sMask ) )
+        return -1;
+
+    prev = SetThreadAffinityMask( GetCurrentThread(), pMask );
+
+    if( !prev )
+        return -1;
+
+    SetThreadAffinityMask( GetCurrentThread(), prev );
+
+    return maskNumaNode( uint(prev & 0xFFFFFFFF) );
+}
+
+#elif defined(Q_OS_LINUX)
+
+int getCurrentThreadNumaNode()
+{
+    cpu_set_t   set;
+    uint        mask = 0;
+
+    CPU_ZERO( &set );
+
+    if( sched_getaffinity( 0, sizeof(set), &set ) )
+        return -1;
+
+    for( int i = 0; i < 32; ++i ) {
+        if( CPU_ISSET( i, &set ) )
+            mask |= 1u << i;
+    }
+
+    return maskNumaNode( mask );
+}
+
+#else /* !Q_OS_WIN && !Q_OS_LINUX */
+
+int getCurrentThreadNumaNode()
+{
+    return maskNumaNode( 0 );
+}
+
+#endif
+
 /* ---------------------------------------------------------------- */
 /* getRAMBytes32BitApp -------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -857,6 +1242,841 @@ double getRAMBytes64BitApp()
 
 #endif
 
+/* ---------------------------------------------------------------- */
+/* cpuFeatures ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#ifdef UTIL_X86
+
+static uint cpuProbe()
+{
+    uint    F = 0;
+
+#ifdef _MSC_VER
+    int r[4];
+
+    __cpuid( r, 0 );
+
+    int nLeaf = r[0];
+
+    __cpuid( r, 1 );
+
+    if( r[2] & (1 << 9) )
+        F |= cpuSSSE3;
+
+    if( r[2] & (1 << 19) )
+        F |= cpuSSE41;
+
+    if( r[2] & (1 << 20) )
+        F |= cpuSSE42;
+
+    // OSXSAVE and AVX, and OS saves YMM state
+
+    bool    ymm = (r[2] & (1 << 27 | 1 << 28)) == (1 << 27 | 1 << 28)
+                    && (_xgetbv( 0 ) & 6) == 6;
+
+    if( nLeaf >= 7 ) {
+
+        __cpuidex( r, 7, 0 );
+
+        if( ymm && (r[1] & (1 << 5)) )
+            F |= cpuAVX2;
+
+        if( r[1] & (1 << 29) )
+            F |= cpuSHA;
+    }
+#else
+    unsigned int    a, b, c, d;
+
+    __builtin_cpu_init();
+
+    if( __builtin_cpu_supports( "ssse3" ) )
+        F |= cpuSSSE3;
+
+    if( __builtin_cpu_supports( "sse4.1" ) )
+        F |= cpuSSE41;
+
+    if( __builtin_cpu_supports( "sse4.2" ) )
+        F |= cpuSSE42;
+
+    if( __builtin_cpu_supports( "avx2" ) )
+        F |= cpuAVX2;
+
+    // SHA: leaf 7 EBX bit 29
+
+    if( __get_cpuid_max( 0, 0 ) >= 7 ) {
+
+        __cpuid_count( 7, 0, a, b, c, d );
+
+        if( b & (1 << 29) )
+            F |= cpuSHA;
+    }
+#endif
+
+    return F;
+}
+
+
+// Safe from static initializers of other translation units.
+//
+uint cpuFeatures()
+{
+    static const uint   F = cpuProbe();
+
+    return F;
+}
+
+#else /* !UTIL_X86 */
+
+uint cpuFeatures()
+{
+    return 0;
+}
+
+#endif
+
+
+bool cpuHasSSSE3()
+{
+    return (cpuFeatures() & cpuSSSE3) != 0;
+}
+
+
+bool cpuHasSSE41()
+{
+    return (cpuFeatures() & cpuSSE41) != 0;
+}
+
+
+bool cpuHasSSE42()
+{
+    return (cpuFeatures() & cpuSSE42) != 0;
+}
+
+
+bool cpuHasAVX2()
+{
+    return (cpuFeatures() & cpuAVX2) != 0;
+}
+
+
+bool cpuHasSHA()
+{
+    return (cpuFeatures() & cpuSHA) != 0;
+}
+
+/* ---------------------------------------------------------------- */
+/* allocStreamMem ------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#if defined(Q_OS_WIN) || defined(Q_OS_LINUX)
+// Mirror pages are faulted in through the first view; reading
+// the second maps its page table entries as well.
+//
+static void touchMirror( void *p, size_t bytes )
+{
+    volatile const char *v = (const char*)p + bytes;
+
+    for( size_t i = 0; i < bytes; i += 4096 )
+        (void)v[i];
+}
+#endif
+
+#ifdef Q_OS_WIN
+
+static bool enableLockMemoryPrivilege()
+{
+    HANDLE              hTok;
+    TOKEN_PRIVILEGES    tp;
+    bool                ok = false;
+
+    if( !OpenProcessToken(
+            GetCurrentProcess(),
+            TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY,
+            &hTok ) ) {
+
+        return false;
+    }
+
+    if( LookupPrivilegeValue(
+            NULL, SE_LOCK_MEMORY_NAME, &tp.Privileges[0].Luid ) ) {
+
+        tp.PrivilegeCount           = 1;
+        tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+        ok = AdjustTokenPrivileges( hTok, FALSE, &tp, 0, NULL, NULL )
+                && GetLastError() == ERROR_SUCCESS;
+    }
+
+    CloseHandle( hTok );
+
+    return ok;
+}
+
+
+// Grow working set so VirtualLock can succeed, then lock.
+//
+static bool lockStreamMem( void *p, size_t bytes )
+{
+    SIZE_T  wsMin, wsMax;
+    HANDLE  hProc = GetCurrentProcess();
+
+    if( GetProcessWorkingSetSize( hProc, &wsMin, &wsMax ) ) {
+        SetProcessWorkingSetSize(
+            hProc, wsMin + bytes, qMax( wsMax, wsMin + bytes ) );
+    }
+
+    if( VirtualLock( p, bytes ) )
+        return true;
+
+    Warning()
+        << "Could not lock stream buffer in RAM; error "
+        << (int)GetLastError();
+
+    return false;
+}
+
+
+void *allocStreamMem( size_t bytes, int flags, int &got )
+{
+    void    *p = 0;
+
+    got = 0;
+
+// Large pages: size must be multiple of large page;
+// requires SeLockMemoryPrivilege ("Lock pages in memory").
+
+    if( flags & smemLarge ) {
+
+        static bool priv = enableLockMemoryPrivilege();
+        SIZE_T      lp   = GetLargePageMinimum();
+
+        if( priv && lp ) {
+
+            SIZE_T  lbytes = ((bytes + lp - 1) / lp) * lp;
+
+            p = VirtualAlloc(
+                    NULL, lbytes,
+                    MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                    PAGE_READWRITE );
+
+            if( p )
+                got = smemLarge | smemLock; // large pages never paged
+            else {
+                Warning()
+                    << "Large page stream buffer unavailable; error "
+                    << (int)GetLastError();
+            }
+        }
+    }
+
+    if( !p ) {
+
+        p = VirtualAlloc(
+                NULL, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE );
+
+        if( !p )
+            return 0;
+
+        // Pre-fault: VirtualAlloc pages are demand-zero
+
+        memset( p, 0, bytes );
+
+        if( (flags & smemLock) && lockStreamMem( p, bytes ) )
+            got |= smemLock;
+    }
+
+    return p;
+}
+
+
+size_t mirrorGranule()
+{
+    SYSTEM_INFO si;
+
+    GetSystemInfo( &si );
+
+    return si.dwAllocationGranularity;
+}
+
+
+// A pagefile-backed section mapped as two adjacent views. The
+// address is found by reserving 2 x bytes, then releasing it
+// and mapping there; another thread may take the range between
+// those steps, so retry a few times.
+//
+void *allocMirrorMem( size_t bytes, int flags, int &got )
+{
+    char    *p = 0;
+
+    got = 0;
+
+    if( !bytes || bytes % mirrorGranule() )
+        return 0;
+
+    HANDLE  hMap = CreateFileMapping(
+                    INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                    DWORD(quint64(bytes) >> 32), DWORD(bytes),
+                    NULL );
+
+    if( !hMap )
+        return 0;
+
+    for( int itry = 0; itry < 8 && !p; ++itry ) {
+
+        void    *base = VirtualAlloc(
+                            NULL, 2 * bytes, MEM_RESERVE, PAGE_NOACCESS );
+
+        if( !base )
+            break;
+
+        VirtualFree( base, 0, MEM_RELEASE );
+
+        void    *v1 = MapViewOfFileEx(
+                        hMap, FILE_MAP_ALL_ACCESS, 0, 0, bytes, base ),
+                *v2 = 0;
+
+        if( v1 ) {
+
+            v2 = MapViewOfFileEx(
+                    hMap, FILE_MAP_ALL_ACCESS, 0, 0, bytes,
+                    (char*)base + bytes );
+
+            if( v2 )
+                p = (char*)v1;
+            else
+                UnmapViewOfFile( v1 );
+        }
+    }
+
+    // Views keep the section alive
+
+    CloseHandle( hMap );
+
+    if( !p )
+        return 0;
+
+    got = smemMirror;
+
+    memset( p, 0, bytes );
+    touchMirror( p, bytes );
+
+    if( (flags & smemLock) && lockStreamMem( p, bytes ) )
+        got |= smemLock;
+
+    return p;
+}
+
+
+void freeStreamMem( void *p, size_t bytes, int got )
+{
+    if( !p )
+        return;
+
+    if( (got & smemLock) && !(got & smemLarge) )
+        VirtualUnlock( p, bytes );
+
+    if( got & smemMirror ) {
+        UnmapViewOfFile( (char*)p + bytes );
+        UnmapViewOfFile( p );
+        return;
+    }
+
+    VirtualFree( p, 0, MEM_RELEASE );
+}
+
+
+// Pages can't migrate: decommit, then recommit in place from
+// the node, pre-faulted again. Large pages can't be decommitted,
+// nor can section views (mirrors stay where first faulted).
+//
+bool moveStreamMem( void *p, size_t bytes, int node, int got )
+{
+    if( !p || node < 0 || (got & (smemLarge | smemMirror)) )
+        return false;
+
+    if( got & smemLock )
+        VirtualUnlock( p, bytes );
+
+    bool    ok = VirtualFree( p, bytes, MEM_DECOMMIT )
+                && VirtualAllocExNuma(
+                    GetCurrentProcess(), p, bytes,
+                    MEM_COMMIT, PAGE_READWRITE, DWORD(node) );
+
+    if( !ok )
+        VirtualAlloc( p, bytes, MEM_COMMIT, PAGE_READWRITE );
+
+    memset( p, 0, bytes );
+
+    if( got & smemLock )
+        VirtualLock( p, bytes );
+
+    return ok;
+}
+
+#elif defined(Q_OS_LINUX)
+
+#define HUGEPGSZ    (2*1024*1024)
+
+void *allocStreamMem( size_t bytes, int flags, int &got )
+{
+    void    *p = MAP_FAILED;
+
+    got = 0;
+
+#ifdef MAP_HUGETLB
+    if( flags & smemLarge ) {
+
+        p = mmap(
+                0, ((bytes + HUGEPGSZ - 1) / HUGEPGSZ) * HUGEPGSZ,
+                PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE,
+                -1, 0 );
+
+        if( p != MAP_FAILED )
+            got |= smemLarge;
+    }
+#endif
+
+    if( p == MAP_FAILED ) {
+
+        p = mmap(
+                0, bytes,
+                PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE,
+                -1, 0 );
+
+        if( p == MAP_FAILED )
+            return 0;
+
+#ifdef MADV_HUGEPAGE
+        if( flags & smemLarge )
+            madvise( p, bytes, MADV_HUGEPAGE );
+#endif
+        // Pre-fault in case MAP_POPULATE ignored
+
+        memset( p, 0, bytes );
+    }
+
+    if( flags & smemLock ) {
+
+        if( !mlock( p, bytes ) )
+            got |= smemLock;
+        else {
+            int e = errno;
+            Warning()
+                << "Could not lock stream buffer in RAM: " << strerror( e );
+        }
+    }
+
+    return p;
+}
+
+
+size_t mirrorGranule()
+{
+    return sysconf( _SC_PAGESIZE );
+}
+
+
+// A memfd mapped twice with MAP_FIXED over a 2 x bytes
+// reservation of our own, so nothing can take the range.
+//
+void *allocMirrorMem( size_t bytes, int flags, int &got )
+{
+    got = 0;
+
+#ifdef SYS_memfd_create
+    if( !bytes || bytes % mirrorGranule() )
+        return 0;
+
+    int fd = syscall( SYS_memfd_create, "sglring", 0 );
+
+    if( fd < 0 )
+        return 0;
+
+    void    *p = MAP_FAILED;
+
+    if( !ftruncate( fd, bytes ) ) {
+
+        p = mmap(
+                0, 2 * bytes, PROT_NONE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+
+        if( p != MAP_FAILED
+            && (MAP_FAILED == mmap(
+                    p, bytes, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_FIXED | MAP_POPULATE, fd, 0 )
+                || MAP_FAILED == mmap(
+                    (char*)p + bytes, bytes, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_FIXED | MAP_POPULATE, fd, 0 )) ) {
+
+            munmap( p, 2 * bytes );
+            p = MAP_FAILED;
+        }
+    }
+
+    // Mappings keep the memfd alive
+
+    close( fd );
+
+    if( p == MAP_FAILED )
+        return 0;
+
+    got = smemMirror;
+
+    memset( p, 0, bytes );
+    touchMirror( p, bytes );
+
+    if( flags & smemLock ) {
+
+        if( !mlock( p, bytes ) )
+            got |= smemLock;
+        else {
+            int e = errno;
+            Warning()
+                << "Could not lock stream buffer in RAM: " << strerror( e );
+        }
+    }
+
+    return p;
+#else
+    Q_UNUSED( bytes )
+    Q_UNUSED( flags )
+
+    return 0;
+#endif
+}
+
+
+void freeStreamMem( void *p, size_t bytes, int got )
+{
+    if( !p )
+        return;
+
+    if( got & smemLock )
+        munlock( p, bytes );
+
+    if( got & smemMirror )
+        bytes *= 2;
+    else if( got & smemLarge )
+        bytes = ((bytes + HUGEPGSZ - 1) / HUGEPGSZ) * HUGEPGSZ;
+
+    munmap( p, bytes );
+}
+
+
+// mbind( MPOL_PREFERRED, MPOL_MF_MOVE ) via syscall, so there's
+// no libnuma dependency: resident pages migrate, and later faults
+// prefer the node, falling back if it runs short.
+//
+#define SGL_MPOL_PREFERRED  1
+#define SGL_MPOL_MF_MOVE    (1 << 1)
+
+bool moveStreamMem( void *p, size_t bytes, int node, int got )
+{
+#ifdef SYS_mbind
+    unsigned long   nodes;
+
+    if( !p || node < 0 || node >= int(8 * sizeof(nodes)) )
+        return false;
+
+    nodes = 1UL << node;
+
+// Mirror pages are shared (mapped twice), so they don't migrate;
+// instead set the memfd's policy, drop its pages, and refault.
+
+    if( got & smemMirror ) {
+#ifdef MADV_REMOVE
+        if( syscall(
+                SYS_mbind, p, bytes, SGL_MPOL_PREFERRED,
+                &nodes, 8 * sizeof(nodes) + 1, 0 ) ) {
+
+            return false;
+        }
+
+        if( got & smemLock )
+            munlock( p, bytes );
+
+        madvise( p, bytes, MADV_REMOVE );
+        memset( p, 0, bytes );
+        touchMirror( p, bytes );
+
+        if( got & smemLock )
+            mlock( p, bytes );
+
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    if( got & smemLarge )
+        bytes = ((bytes + HUGEPGSZ - 1) / HUGEPGSZ) * HUGEPGSZ;
+
+    return !syscall(
+                SYS_mbind, p, bytes, SGL_MPOL_PREFERRED,
+                &nodes, 8 * sizeof(nodes) + 1, SGL_MPOL_MF_MOVE );
+#else
+    Q_UNUSED( p )
+    Q_UNUSED( bytes )
+    Q_UNUSED( node )
+    Q_UNUSED( got )
+
+    return false;
+#endif
+}
+
+#else /* !Q_OS_WIN && !Q_OS_LINUX */
+
+void *allocStreamMem( size_t bytes, int flags, int &got )
+{
+    Q_UNUSED( flags )
+
+    got = 0;
+
+    return calloc( 1, bytes );
+}
+
+
+size_t mirrorGranule()
+{
+    return 4096;
+}
+
+
+void *allocMirrorMem( size_t bytes, int flags, int &got )
+{
+    Q_UNUSED( bytes )
+    Q_UNUSED( flags )
+
+    got = 0;
+
+    return 0;
+}
+
+
+void freeStreamMem( void *p, size_t bytes, int got )
+{
+    Q_UNUSED( bytes )
+    Q_UNUSED( got )
+
+    free( p );
+}
+
+
+bool moveStreamMem( void *p, size_t bytes, int node, int got )
+{
+    Q_UNUSED( p )
+    Q_UNUSED( bytes )
+    Q_UNUSED( node )
+    Q_UNUSED( got )
+
+    return false;
+}
+
+#endif
+
+/* ---------------------------------------------------------------- */
+/* directFileOpen ------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#ifdef Q_OS_WIN
+
+// Shared with the QFile handle DataFile holds on the same file.
+//
+qintptr directFileOpen( const QString &path )
+{
+    HANDLE  h = CreateFileW(
+                    (LPCWSTR)QDir::toNativeSeparators( path ).utf16(),
+                    GENERIC_WRITE,
+                    FILE_SHARE_READ | FILE_SHARE_WRITE,
+                    NULL,
+                    OPEN_EXISTING,
+                    FILE_ATTRIBUTE_NORMAL
+                    | FILE_FLAG_NO_BUFFERING
+                    | FILE_FLAG_WRITE_THROUGH,
+                    NULL );
+
+    if( h == INVALID_HANDLE_VALUE ) {
+        Warning()
+            << "Direct I/O open failed; error "
+            << (int)GetLastError();
+        return -1;
+    }
+
+    return (qintptr)h;
+}
+
+
+qint64 directFileWrite( qintptr h, const void *src, qint64 bytes )
+{
+    const char  *s      = (const char*)src;
+    qint64      nWrit   = 0;
+
+    while( nWrit < bytes ) {
+
+        DWORD   n = (DWORD)qMin( bytes - nWrit, qint64(1 << 30) ),
+                got;
+
+        if( !WriteFile( (HANDLE)h, s + nWrit, n, &got, NULL ) )
+            return -1;
+
+        nWrit += got;
+    }
+
+    return nWrit;
+}
+
+
+void directFileClose( qintptr h )
+{
+    if( h != -1 )
+        CloseHandle( (HANDLE)h );
+}
+
+#else /* !Q_OS_WIN */
+
+// Linux uses O_DIRECT; Mac uses F_NOCACHE on a plain handle.
+//
+qintptr directFileOpen( const QString &path )
+{
+    int flags = O_WRONLY;
+
+#ifdef O_DIRECT
+    flags |= O_DIRECT;
+#endif
+
+    int fd = ::open( STR2CHR( path ), flags );
+
+    if( fd < 0 ) {
+        Warning() << "Direct I/O open failed; errno " << errno;
+        return -1;
+    }
+
+#ifdef F_NOCACHE
+    fcntl( fd, F_NOCACHE, 1 );
+#endif
+
+    return fd;
+}
+
+
+qint64 directFileWrite( qintptr h, const void *src, qint64 bytes )
+{
+    const char  *s      = (const char*)src;
+    qint64      nWrit   = 0;
+
+    while( nWrit < bytes ) {
+
+        ssize_t got = ::write( int(h), s + nWrit, size_t(bytes - nWrit) );
+
+        if( got < 0 ) {
+
+            if( errno == EINTR )
+                continue;
+
+            return -1;
+        }
+
+        nWrit += got;
+    }
+
+    return nWrit;
+}
+
+
+void directFileClose( qintptr h )
+{
+    if( h != -1 )
+        ::close( int(h) );
+}
+
+#endif
+
+/* ---------------------------------------------------------------- */
+/* filePreallocate ------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+#ifdef Q_OS_WIN
+
+static bool setAllocSize( QFile &f, qint64 bytes )
+{
+    HANDLE  h = (HANDLE)_get_osfhandle( f.handle() );
+
+    if( h == INVALID_HANDLE_VALUE )
+        return false;
+
+    FILE_ALLOCATION_INFO    fai;
+    fai.AllocationSize.QuadPart = bytes;
+
+    return SetFileInformationByHandle(
+            h, FileAllocationInfo, &fai, sizeof(fai) );
+}
+
+
+bool filePreallocate( QFile &f, qint64 bytes )
+{
+    return setAllocSize( f, bytes );
+}
+
+
+void fileTrimAlloc( QFile &f )
+{
+    f.flush();
+    setAllocSize( f, f.size() );
+}
+
+#else /* !Q_OS_WIN */
+
+// Linux: fallocate KEEP_SIZE; Mac: F_PREALLOCATE.
+//
+bool filePreallocate( QFile &f, qint64 bytes )
+{
+    int fd = f.handle();
+
+    if( fd < 0 )
+        return false;
+
+#if defined(FALLOC_FL_KEEP_SIZE)
+    return !fallocate( fd, FALLOC_FL_KEEP_SIZE, 0, bytes );
+#elif defined(F_PREALLOCATE)
+    fstore_t    fs;
+
+    fs.fst_flags    = F_ALLOCATECONTIG;
+    fs.fst_posmode  = F_PEOFPOSMODE;
+    fs.fst_offset   = 0;
+    fs.fst_length   = bytes - f.size();
+
+    if( fs.fst_length <= 0 )
+        return true;
+
+    if( fcntl( fd, F_PREALLOCATE, &fs ) == -1 ) {
+
+        fs.fst_flags = F_ALLOCATEALL;
+
+        if( fcntl( fd, F_PREALLOCATE, &fs ) == -1 )
+            return false;
+    }
+
+    return true;
+#else
+    Q_UNUSED( bytes )
+    return false;
+#endif
+}
+
+
+void fileTrimAlloc( QFile &f )
+{
+    f.flush();
+
+    if( f.handle() >= 0 && ftruncate( f.handle(), f.size() ) )
+        Warning() << "Can't trim preallocation; errno " << errno;
+}
+
+#endif
+
 /* ---------------------------------------------------------------- */
 /* isMouseDown ---------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -16,6 +16,7 @@
 #include <QFileInfo>
 #include <QSettings>
 #include <QTableWidget>
+#include <QThread>
 
 
 /* ---------------------------------------------------------------- */
@@ -779,6 +780,87 @@ bool CimCfg::AttrEach::deriveStdbyBits( QString &err, int nAP )
 }
 
 
+// Given input fields:
+// - roTbl
+// - imCumTypCnt[]
+// - sns.shankMap
+// - sns.saveBits
+//
+// Derive:
+// - lut
+//
+// Vectors keep their storage when sizes don't change, so
+// a live edit doesn't move arrays under a reader.
+//
+void CimCfg::AttrEach::deriveChanLUT()
+{
+    if( !roTbl )
+        return;
+
+    const ShankMap  &SM = sns.shankMap;
+    const int       nAP = imCumTypCnt[imSumAP],
+                    nNu = imCumTypCnt[imSumNeural],
+                    nC  = imCumTypCnt[imSumAll],
+                    nSM = int(SM.e.size());
+
+// ---
+// Mux
+// ---
+
+    roTbl->muxTable( lut.nADC, lut.nChn, lut.muxTbl );
+
+    lut.mux.assign( nAP, 0 );
+
+    for( int irow = 0; irow < lut.nChn; ++irow ) {
+
+        for( int icol = 0; icol < lut.nADC; ++icol ) {
+
+            int ic = lut.muxTbl[lut.nADC*irow + icol];
+
+            if( ic >= 0 && ic < nAP )
+                lut.mux[ic] = irow;
+        }
+    }
+
+// -------------
+// Per acq chan
+// -------------
+
+    lut.gain.resize( nC );
+    lut.used.resize( nC );
+    lut.save.resize( nC );
+
+    for( int ic = 0; ic < nC; ++ic ) {
+
+        int ie = (ic < nAP ? ic : ic - nAP);
+
+        lut.gain[ic] = (ic < nNu ? chanGain( ic ) : 1.0);
+        lut.used[ic] = (ic >= nNu || (ie < nSM && SM.e[ie].u));
+        lut.save[ic] = (ic < sns.saveBits.size() && sns.saveBits.testBit( ic ));
+    }
+
+// -----------
+// Per AP chan
+// -----------
+
+    lut.shank.resize( nAP );
+    lut.col.resize( nAP );
+    lut.row.resize( nAP );
+
+    for( int ic = 0; ic < nAP; ++ic ) {
+
+        if( ic < nSM ) {
+            const ShankMapDesc  &D = SM.e[ic];
+            lut.shank[ic]   = D.s;
+            lut.col[ic]     = D.c;
+            lut.row[ic]     = D.r;
+        }
+        else
+            lut.shank[ic] = lut.col[ic] = lut.row[ic] = 0;
+    }
+}
+
+
 void CimCfg::AttrEach::justAPBits(
     QBitArray       &apBits,
     const QBitArray &saveBits ) const
@@ -893,6 +975,66 @@ void CimCfg::loadSettings( QSettings &S )
     all.bistAtDetect =
     S.value( "imBistAtDetect", true ).toBool();
 
+    all.thdMode =
+    S.value( "imThdMode", 0 ).toInt();
+
+    all.thdCores =
+    S.value( "imThdCores", QString() ).toString();
+
+    all.thdRTPrio =
+    S.value( "imThdRTPrio", false ).toBool();
+
+    all.fetchTarg =
+    S.value( "imFetchTarg", 5 ).toInt();
+
+    all.cfgParallel =
+    S.value( "imCfgParallel", false ).toBool();
+
+    all.updPrbOnly =
+    S.value( "imUpdPrbOnly", false ).toBool();
+
+    all.rawRec =
+    S.value( "imRawRec", false ).toBool();
+
+    all.simPrbs =
+    S.value( "imSimPrbs", 0 ).toInt();
+
+    all.simSeed =
+    S.value( "imSimSeed", 0 ).toInt();
+
+    all.simFast =
+    S.value( "imSimFast", false ).toBool();
+
+    all.simReplay =
+    S.value( "imSimReplay", QString() ).toString();
+
+    all.simSpeed =
+    S.value( "imSimSpeed", 1.0 ).toDouble();
+
+    all.simPPM =
+    S.value( "imSimPPM", QString() ).toString();
+
+    all.simJitUs =
+    S.value( "imSimJitUs", 0.0 ).toDouble();
+
+    all.simBank =
+    S.value( "imSimBank", false ).toBool();
+
+    all.simNoiseUV =
+    S.value( "imSimNoiseUV", 0.0 ).toDouble();
+
+    all.fltLoHz =
+    S.value( "imFltStgLo", 0.0 ).toDouble();
+
+    all.fltHiHz =
+    S.value( "imFltStgHi", 0.0 ).toDouble();
+
+    all.fltNotchHz =
+    S.value( "imFltStgNotch", 0.0 ).toDouble();
+
+    all.fltNotchN =
+    S.value( "imFltStgNotchN", 3 ).toInt();
+
     nProbes =
     S.value( "imNProbes", 1 ).toInt();
 
@@ -950,6 +1092,26 @@ void CimCfg::saveSettings( QSettings &S ) const
     S.setValue( "imTrgSource", all.trgSource );
     S.setValue( "imTrgRising", all.bistAtDetect );
     S.setValue( "imBistAtDetect", all.bistAtDetect );
+    S.setValue( "imThdMode", all.thdMode );
+    S.setValue( "imThdCores", all.thdCores );
+    S.setValue( "imThdRTPrio", all.thdRTPrio );
+    S.setValue( "imFetchTarg", all.fetchTarg );
+    S.setValue( "imCfgParallel", all.cfgParallel );
+    S.setValue( "imUpdPrbOnly", all.updPrbOnly );
+    S.setValue( "imRawRec", all.rawRec );
+    S.setValue( "imSimPrbs", all.simPrbs );
+    S.setValue( "imSimSeed", all.simSeed );
+    S.setValue( "imSimFast", all.simFast );
+    S.setValue( "imSimReplay", all.simReplay );
+    S.setValue( "imSimSpeed", all.simSpeed );
+    S.setValue( "imSimPPM", all.simPPM );
+    S.setValue( "imSimJitUs", all.simJitUs );
+    S.setValue( "imSimBank", all.simBank );
+    S.setValue( "imSimNoiseUV", all.simNoiseUV );
+    S.setValue( "imFltStgLo", all.fltLoHz );
+    S.setValue( "imFltStgHi", all.fltHiHz );
+    S.setValue( "imFltStgNotch", all.fltNotchHz );
+    S.setValue( "imFltStgNotchN", all.fltNotchN );
     S.setValue( "imNProbes", nProbes );
     S.setValue( "imEnabled", enabled );
 
@@ -1008,12 +1170,25 @@ void CimCfg::closeAllBS()
 }
 
 
+// Detect slots, then their probes, filling T and reporting
+// versions to slVers and BIST failures to slBIST.
+//
+// If parallel (daq.ini imCfgParallel), each slot is detected
+// on its own thread. A slot's probes share its base station,
+// so they and their BISTs are done in turn by that thread.
+//
+// Probe EEPROM strings (HS, flex and probe part numbers and
+// versions) are cached in _Configs/imdetect_cache.ini keyed
+// by HS and probe serial numbers, so on an unchanged rig only
+// the serial numbers need reading. BIST is never cached.
+//
 bool CimCfg::detect(
         QStringList     &slVers,
         QStringList     &slBIST,
         QVector<int>    &vHS20,
         ImProbeTable    &T,
-        bool            doBIST )
+        bool            doBIST,
+        bool            parallel )
 {
 // ---------
 // Close all
@@ -1028,8 +1203,13 @@ bool CimCfg::detect(
 // Local vars
 // ----------
 
-    int     nProbes;
-    bool    ok = false;
+    QMap<QString,QStringList>   cache;
+    QVector<ImDetWorker*>       vW;
+    QVector<QThread*>           vT;
+    double                      t0 = getTime();
+    int                         nProbes,
+                                nCached = 0;
+    bool                        ok = true;
 
     T.init();
     slVers.clear();
@@ -1038,20 +1218,13 @@ bool CimCfg::detect(
 
     nProbes = T.buildEnabIndexTables();
 
-#ifdef HAVE_IMEC
-    char            strPN[64];
-#define StrPNWid    (sizeof(strPN) - 1)
-    quint64         u64;
-    NP_ErrorCode    err;
-    quint16         build;
-    quint8          maj8, min8;
-#endif
-
 // -------
 // APIVers
 // -------
 
 #ifdef HAVE_IMEC
+    quint8  maj8, min8;
+
     getAPIVersion( &maj8, &min8 );
 
     T.api = QString("%1.%2").arg( maj8 ).arg( min8 );
@@ -1061,412 +1234,512 @@ bool CimCfg::detect(
 
     slVers.append( QString("API version %1").arg( T.api ) );
 
-// ---------------
-// Loop over slots
-// ---------------
+// ----------------------
+// One worker per slot...
+// ----------------------
+
+    detCacheLoad( cache );
 
     for( int is = 0, ns = T.nLogSlots(); is < ns; ++is ) {
 
-        ImSlotVers  V;
-        int         slot = T.getEnumSlot( is );
+        QVector<ImProbeDat*>    vP;
+        int                     slot = T.getEnumSlot( is );
 
-        // ------
-        // OpenBS
-        // ------
+        // Probe refs taken here, so workers never touch the table
 
-#ifdef HAVE_IMEC
-        err = openBS( slot );
+        for( int ip = 0; ip < nProbes; ++ip ) {
 
-        if( err != SUCCESS ) {
-            slVers.append(
-                QString("IMEC openBS( %1 ) error %2 '%3'.")
-                .arg( slot ).arg( err ).arg( np_GetErrorMessage( err ) ) );
-            slVers.append(
-                "Check {slot,port} assignments, connections and power." );
-            goto exit;
+            ImProbeDat  &P = T.mod_iProbe( ip );
+
+            if( P.slot == slot )
+                vP.push_back( &P );
         }
-#endif
 
-        // ----
-        // BSFW
-        // ----
+        vW.push_back( new ImDetWorker( cache, vP, slot, doBIST ) );
+    }
 
-#ifdef HAVE_IMEC
-        err = getBSBootVersion( slot, &maj8, &min8, &build );
+// -------------------------------
+// ...run concurrently or in turn
+// -------------------------------
 
-        if( err != SUCCESS ) {
-            slVers.append(
-                QString("IMEC getBSBootVersion(slot %1) error %2 '%3'.")
-                .arg( slot ).arg( err ).arg( np_GetErrorMessage( err ) ) );
-            goto exit;
+    if( parallel && vW.size() > 1 ) {
+
+        for( int i = 0, n = vW.size(); i < n; ++i ) {
+
+            QThread *thread = new QThread;
+
+            vW[i]->moveToThread( thread );
+
+            Connect( thread, SIGNAL(started()), vW[i], SLOT(run()) );
+            Connect( vW[i], SIGNAL(finished()), thread, SLOT(quit()), Qt::DirectConnection );
+
+            thread->start();
+            vT.push_back( thread );
         }
 
-        V.bsfw = QString("%1.%2.%3").arg( maj8 ).arg( min8 ).arg( build );
-#else
-        V.bsfw = "0.0.0";
-#endif
+        for( int i = 0, n = vT.size(); i < n; ++i ) {
+            vT[i]->wait();
+            delete vT[i];
+        }
+    }
+    else {
+
+        for( int i = 0, n = vW.size(); i < n && ok; ++i ) {
+            vW[i]->run();
+            ok = vW[i]->ok;
+        }
+    }
+
+// -------------------------
+// Merge reports, slot order
+// -------------------------
+
+    ok = true;
+
+    for( int i = 0, n = vW.size(); i < n; ++i ) {
+
+        ImDetWorker *W = vW[i];
+
+        slVers += W->slSlot;
+
+        if( W->slotOK )
+            T.slot2Vers[W->slot] = W->V;
+    }
+
+    for( int i = 0, n = vW.size(); i < n; ++i ) {
+
+        ImDetWorker *W = vW[i];
+
+        slVers  += W->slPrb;
+        slBIST  += W->slBIST;
+        nCached += W->nCached;
+        ok       = ok && W->ok;
+
+        delete W;
+    }
+
+    if( !ok ) {
 
         slVers.append(
-            QString("BS(slot %1) firmware version %2")
-            .arg( slot ).arg( V.bsfw ) );
+            "Check {slot,port} assignments, connections and power." );
+        goto exit;
+    }
+
+// ----
+// HS20
+// ----
 
-        // -----
-        // BSCPN
-        // -----
+    for( int ip = 0; ip < nProbes; ++ip ) {
 
-#ifdef HAVE_IMEC
-        err = readBSCPN( slot, strPN, StrPNWid );
+        ImProbeDat  &P = T.mod_iProbe( ip );
 
-        if( err != SUCCESS ) {
-            slVers.append(
-                QString("IMEC readBSCPN(slot %1) error %2 '%3'.")
-                .arg( slot ).arg( err ).arg( np_GetErrorMessage( err ) ) );
-            goto exit;
+        if( P.type == 21 || P.type == 24 ) {
+
+            if( vHS20.isEmpty() )
+                vHS20.push_back( ip );
+            else {
+
+                ImProbeDat  &Z = T.mod_iProbe( vHS20[vHS20.size() - 1] );
+
+                if( Z.slot != P.slot || Z.port != P.port )
+                    vHS20.push_back( ip );
+            }
         }
+    }
 
-        V.bscpn = strPN;
-#else
-        V.bscpn = "sim";
+// ------------
+// Update cache
+// ------------
+
+#ifdef HAVE_IMEC
+    for( int ip = 0; ip < nProbes; ++ip ) {
+
+        const ImProbeDat    &P = T.get_iProbe( ip );
+
+        cache[detCacheKey( P.hssn, P.sn )] =
+            QStringList() << P.hspn << P.hsfw << P.fxpn << P.fxhw << P.pn;
+    }
+
+    detCacheSave( cache );
 #endif
 
-        slVers.append(
-            QString("BSC(slot %1) part number %2")
-            .arg( slot ).arg( V.bscpn ) );
+    slVers.append(
+        QString("Detected %1 slots, %2 probes (%3 cached) in %4 s (%5)")
+        .arg( T.nLogSlots() ).arg( nProbes ).arg( nCached )
+        .arg( getTime() - t0, 0, 'f', 1 )
+        .arg( parallel ? "parallel" : "serial" ) );
 
-        // -----
-        // BSCSN
-        // -----
+// ----
+// Exit
+// ----
 
+exit:
 #ifdef HAVE_IMEC
-        err = readBSCSN( slot, &u64 );
+    for( int is = 0, ns = T.nLogSlots(); is < ns; ++is )
+        closeBS( T.getEnumSlot( is ) );
+#endif
 
-        if( err != SUCCESS ) {
-            slVers.append(
-                QString("IMEC readBSCSN(slot %1) error %2 '%3'.")
-                .arg( slot ).arg( err ).arg( np_GetErrorMessage( err ) ) );
-            goto exit;
-        }
+    return ok;
+}
 
-        V.bscsn = QString::number( u64 );
-#else
-        V.bscsn = "0";
+
+/* ---------------------------------------------------------------- */
+/* ImDetWorker ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#ifdef HAVE_IMEC
+#define NPERR( fn, where )                                      \
+    QString("IMEC %1(%2) error %3 '%4'.")                       \
+    .arg( fn ).arg( where ).arg( err ).arg( np_GetErrorMessage( err ) )
 #endif
 
-        slVers.append(
-            QString("BSC(slot %1) serial number %2")
-            .arg( slot ).arg( V.bscsn ) );
 
-        // -----
-        // BSCHW
-        // -----
+void ImDetWorker::run()
+{
+    ok = false;
 
-#ifdef HAVE_IMEC
-        err = getBSCVersion( slot, &maj8, &min8 );
+    if( (slotOK = detectSlot()) ) {
 
-        if( err != SUCCESS ) {
-            slVers.append(
-                QString("IMEC getBSCVersion(slot %1) error %2 '%3'.")
-                .arg( slot ).arg( err ).arg( np_GetErrorMessage( err ) ) );
-            goto exit;
+        for( int i = 0, n = vP.size(); i < n; ++i ) {
+
+            if( !detectProbe( *vP[i] ) )
+                goto exit;
+
+            if( doBIST )
+                bist( *vP[i] );
         }
 
-        V.bschw = QString("%1.%2").arg( maj8 ).arg( min8 );
-#else
-        V.bschw = "0.0";
+        ok = true;
+    }
+
+exit:
+#ifdef HAVE_IMEC
+    if( doBIST )
+        closeBS( slot );
 #endif
 
-        slVers.append(
-            QString("BSC(slot %1) hardware version %2")
-            .arg( slot ).arg( V.bschw ) );
+    emit finished();
+}
 
-        // -----
-        // BSCFW
-        // -----
 
+bool ImDetWorker::detectSlot()
+{
 #ifdef HAVE_IMEC
-        err = getBSCBootVersion( slot, &maj8, &min8, &build );
+    char            strPN[64];
+    quint64         u64;
+    NP_ErrorCode    err;
+    quint16         build;
+    quint8          maj8, min8;
+    QString         where = QString("slot %1").arg( slot );
 
-        if( err != SUCCESS ) {
-            slVers.append(
-                QString("IMEC getBSCBootVersion(slot %1) error %2 '%3'.")
-                .arg( slot ).arg( err ).arg( np_GetErrorMessage( err ) ) );
-            goto exit;
-        }
+    // ------
+    // OpenBS
+    // ------
 
-        V.bscfw = QString("%1.%2.%3").arg( maj8 ).arg( min8 ).arg( build );
-#else
-        V.bscfw = "0.0.0";
-#endif
+    if( SUCCESS != (err = openBS( slot )) ) {
+        slSlot.append( NPERR( "openBS", where ) );
+        return false;
+    }
 
-        slVers.append(
-            QString("BSC(slot %1) firmware version %2")
-            .arg( slot ).arg( V.bscfw ) );
+    // ----
+    // BSFW
+    // ----
+
+    if( SUCCESS != (err = getBSBootVersion( slot, &maj8, &min8, &build )) ) {
+        slSlot.append( NPERR( "getBSBootVersion", where ) );
+        return false;
+    }
 
-        // -------------
-        // Add map entry
-        // -------------
+    V.bsfw = QString("%1.%2.%3").arg( maj8 ).arg( min8 ).arg( build );
 
-        T.slot2Vers[slot] = V;
+    // -----
+    // BSCPN
+    // -----
+
+    if( SUCCESS != (err = readBSCPN( slot, strPN, sizeof(strPN) - 1 )) ) {
+        slSlot.append( NPERR( "readBSCPN", where ) );
+        return false;
     }
 
-// --------------------
-// Individual HS/probes
-// --------------------
+    V.bscpn = strPN;
 
-    for( int ip = 0; ip < nProbes; ++ip ) {
+    // -----
+    // BSCSN
+    // -----
 
-        ImProbeDat  &P = T.mod_iProbe( ip );
+    if( SUCCESS != (err = readBSCSN( slot, &u64 )) ) {
+        slSlot.append( NPERR( "readBSCSN", where ) );
+        return false;
+    }
 
-        // --------------------
-        // Connect to that port
-        // --------------------
+    V.bscsn = QString::number( u64 );
 
-#ifdef HAVE_IMEC
-        err = openProbe( P.slot, P.port, P.dock );
+    // -----
+    // BSCHW
+    // -----
 
-        if( err != SUCCESS ) {
-            slVers.append(
-                QString("IMEC openProbe(slot %1, port %2, dock %3) error %4 '%5'.")
-                .arg( P.slot ).arg( P.port ).arg( P.dock )
-                .arg( err ).arg( np_GetErrorMessage( err ) ) );
-            goto exit;
-        }
-#endif
+    if( SUCCESS != (err = getBSCVersion( slot, &maj8, &min8 )) ) {
+        slSlot.append( NPERR( "getBSCVersion", where ) );
+        return false;
+    }
 
-        // ----
-        // HSPN
-        // ----
+    V.bschw = QString("%1.%2").arg( maj8 ).arg( min8 );
 
-#ifdef HAVE_IMEC
-        err = readHSPN( P.slot, P.port, strPN, StrPNWid );
+    // -----
+    // BSCFW
+    // -----
 
-        if( err != SUCCESS ) {
-            slVers.append(
-                QString("IMEC readHSPN(slot %1, port %2) error %3 '%4'.")
-                .arg( P.slot ).arg( P.port )
-                .arg( err ).arg( np_GetErrorMessage( err ) ) );
-            goto exit;
-        }
+    if( SUCCESS != (err = getBSCBootVersion( slot, &maj8, &min8, &build )) ) {
+        slSlot.append( NPERR( "getBSCBootVersion", where ) );
+        return false;
+    }
 
-        P.hspn = strPN;
+    V.bscfw = QString("%1.%2.%3").arg( maj8 ).arg( min8 ).arg( build );
 #else
-        P.hspn = "sim";
+    V.bsfw  = "0.0.0";
+    V.bscpn = "sim";
+    V.bscsn = "0";
+    V.bschw = "0.0";
+    V.bscfw = "0.0.0";
 #endif
 
-        slVers.append(
-            QString("HS(slot %1, port %2) part number %3")
-            .arg( P.slot ).arg( P.port ).arg( P.hspn ) );
+    slSlot.append(
+        QString("BS(slot %1) firmware version %2")
+        .arg( slot ).arg( V.bsfw ) );
+    slSlot.append(
+        QString("BSC(slot %1) part number %2")
+        .arg( slot ).arg( V.bscpn ) );
+    slSlot.append(
+        QString("BSC(slot %1) serial number %2")
+        .arg( slot ).arg( V.bscsn ) );
+    slSlot.append(
+        QString("BSC(slot %1) hardware version %2")
+        .arg( slot ).arg( V.bschw ) );
+    slSlot.append(
+        QString("BSC(slot %1) firmware version %2")
+        .arg( slot ).arg( V.bscfw ) );
+
+    return true;
+}
 
-        // ----
-        // HSSN
-        // ----
 
+// Serial numbers are read first; if the cache knows that HS
+// and probe, the remaining EEPROM reads are skipped.
+//
+bool ImDetWorker::detectProbe( CimCfg::ImProbeDat &P )
+{
 #ifdef HAVE_IMEC
-        err = readHSSN( P.slot, P.port, &u64 );
+    char            strPN[64];
+    quint64         u64;
+    NP_ErrorCode    err;
+    quint8          maj8, min8;
+    QString         wherePort = QString("slot %1, port %2")
+                                .arg( P.slot ).arg( P.port ),
+                    whereDock = QString("%1, dock %2")
+                                .arg( wherePort ).arg( P.dock );
 
-        if( err != SUCCESS ) {
-            slVers.append(
-                QString("IMEC readHSSN(slot %1, port %2) error %3 '%4'.")
-                .arg( P.slot ).arg( P.port )
-                .arg( err ).arg( np_GetErrorMessage( err ) ) );
-            goto exit;
+    // --------------------
+    // Connect to that port
+    // --------------------
+
+    if( SUCCESS != (err = openProbe( P.slot, P.port, P.dock )) ) {
+        slPrb.append( NPERR( "openProbe", whereDock ) );
+        return false;
+    }
+
+    // -----------
+    // HSSN, SN...
+    // -----------
+
+    if( SUCCESS != (err = readHSSN( P.slot, P.port, &u64 )) ) {
+        slPrb.append( NPERR( "readHSSN", wherePort ) );
+        return false;
+    }
+
+    P.hssn = u64;
+
+    if( SUCCESS != (err = readProbeSN( P.slot, P.port, P.dock, &u64 )) ) {
+        slPrb.append( NPERR( "readProbeSN", whereDock ) );
+        return false;
+    }
+
+    P.sn = u64;
+
+    // -------------------
+    // ...then from cache?
+    // -------------------
+
+    QMap<QString,QStringList>::const_iterator   it =
+        cache.find( CimCfg::detCacheKey( P.hssn, P.sn ) );
+
+    if( it != cache.end() ) {
+
+        P.hspn  = it.value()[0];
+        P.hsfw  = it.value()[1];
+        P.fxpn  = it.value()[2];
+        P.fxhw  = it.value()[3];
+        P.pn    = it.value()[4];
+        ++nCached;
+    }
+    else {
+
+        // ----
+        // HSPN
+        // ----
+
+        if( SUCCESS != (err = readHSPN( P.slot, P.port, strPN, sizeof(strPN) - 1 )) ) {
+            slPrb.append( NPERR( "readHSPN", wherePort ) );
+            return false;
         }
 
-        P.hssn = u64;
-#else
-        P.hssn = 0;
-#endif
+        P.hspn = strPN;
 
         // ----
         // HSFW
         // ----
 
-#ifdef HAVE_IMEC
-        err = getHSVersion( P.slot, P.port, &maj8, &min8 );
-
-        if( err != SUCCESS ) {
-            slVers.append(
-                QString("IMEC getHSVersion(slot %1, port %2) error %3 '%4'.")
-                .arg( P.slot ).arg( P.port )
-                .arg( err ).arg( np_GetErrorMessage( err ) ) );
-            goto exit;
+        if( SUCCESS != (err = getHSVersion( P.slot, P.port, &maj8, &min8 )) ) {
+            slPrb.append( NPERR( "getHSVersion", wherePort ) );
+            return false;
         }
 
         P.hsfw = QString("%1.%2").arg( maj8 ).arg( min8 );
-#else
-        P.hsfw = "0.0";
-#endif
-
-        slVers.append(
-            QString("HS(slot %1, port %2) firmware version %3")
-            .arg( P.slot ).arg( P.port ).arg( P.hsfw ) );
 
         // ----
         // FXPN
         // ----
 
-#ifdef HAVE_IMEC
-        err = readFlexPN( P.slot, P.port, P.dock, strPN, StrPNWid );
+        if( SUCCESS != (err = readFlexPN(
+                                P.slot, P.port, P.dock,
+                                strPN, sizeof(strPN) - 1 )) ) {
 
-        if( err != SUCCESS ) {
-            slVers.append(
-                QString("IMEC readFlexPN(slot %1, port %2, dock %3) error %4 '%5'.")
-                .arg( P.slot ).arg( P.port ).arg( P.dock )
-                .arg( err ).arg( np_GetErrorMessage( err ) ) );
-            goto exit;
+            slPrb.append( NPERR( "readFlexPN", whereDock ) );
+            return false;
         }
 
         P.fxpn = strPN;
-#else
-        P.fxpn = "sim";
-#endif
-
-        slVers.append(
-            QString("FX(slot %1, port %2, dock %3) part number %4")
-            .arg( P.slot ).arg( P.port ).arg( P.dock ).arg( P.fxpn ) );
 
         // ----
         // FXHW
         // ----
 
-#ifdef HAVE_IMEC
-        err = getFlexVersion( P.slot, P.port, P.dock, &maj8, &min8 );
+        if( SUCCESS != (err = getFlexVersion(
+                                P.slot, P.port, P.dock, &maj8, &min8 )) ) {
 
-        if( err != SUCCESS ) {
-            slVers.append(
-                QString("IMEC getFlexVersion(slot %1, port %2, dock %3) error %4 '%5'.")
-                .arg( P.slot ).arg( P.port ).arg( P.dock )
-                .arg( err ).arg( np_GetErrorMessage( err ) ) );
-            goto exit;
+            slPrb.append( NPERR( "getFlexVersion", whereDock ) );
+            return false;
         }
 
         P.fxhw = QString("%1.%2").arg( maj8 ).arg( min8 );
-#else
-        P.fxhw = "0.0";
-#endif
-
-        slVers.append(
-            QString("FX(slot %1, port %2, dock %3) hardware version %4")
-            .arg( P.slot ).arg( P.port ).arg( P.dock ).arg( P.fxhw ) );
 
         // --
         // PN
         // --
 
-#ifdef HAVE_IMEC
-        err = readProbePN( P.slot, P.port, P.dock, strPN, StrPNWid );
+        if( SUCCESS != (err = readProbePN(
+                                P.slot, P.port, P.dock,
+                                strPN, sizeof(strPN) - 1 )) ) {
 
-        if( err != SUCCESS ) {
-            slVers.append(
-                QString("IMEC readProbePN(slot %1, port %2, dock %3) error %4 '%5'.")
-                .arg( P.slot ).arg( P.port ).arg( P.dock )
-                .arg( err ).arg( np_GetErrorMessage( err ) ) );
-            goto exit;
+            slPrb.append( NPERR( "readProbePN", whereDock ) );
+            return false;
         }
 
         P.pn = strPN;
-#else
-        P.pn = "sim";
-#endif
-
-        // --
-        // SN
-        // --
-
-#ifdef HAVE_IMEC
-        err = readProbeSN( P.slot, P.port, P.dock, &u64 );
+    }
 
-        if( err != SUCCESS ) {
-            slVers.append(
-                QString("IMEC readProbeSN(slot %1, port %2, dock %3) error %4 '%5'.")
-                .arg( P.slot ).arg( P.port ).arg( P.dock )
-                .arg( err ).arg( np_GetErrorMessage( err ) ) );
-            goto exit;
-        }
+    // ---
+    // CAL
+    // ---
 
-        P.sn = u64;
+    P.cal = QDir( QString("%1/%2").arg( calibPath() ).arg( P.sn ) ).exists();
 #else
-        P.sn = 0;
+    P.hspn  = "sim";
+    P.hssn  = 0;
+    P.hsfw  = "0.0";
+    P.fxpn  = "sim";
+    P.fxhw  = "0.0";
+    P.pn    = "sim";
+    P.sn    = 0;
+    P.cal   = 1;
 #endif
 
-        // ----
-        // HS20
-        // ----
-
-        P.setProbeType();
-
-        if( P.type == 21 || P.type == 24 ) {
-
-            if( vHS20.isEmpty() )
-                vHS20.push_back( ip );
-            else {
-
-                ImProbeDat  &Z = T.mod_iProbe( vHS20[vHS20.size() - 1] );
+    P.setProbeType();
+
+    slPrb.append(
+        QString("HS(slot %1, port %2) part number %3")
+        .arg( P.slot ).arg( P.port ).arg( P.hspn ) );
+    slPrb.append(
+        QString("HS(slot %1, port %2) firmware version %3")
+        .arg( P.slot ).arg( P.port ).arg( P.hsfw ) );
+    slPrb.append(
+        QString("FX(slot %1, port %2, dock %3) part number %4")
+        .arg( P.slot ).arg( P.port ).arg( P.dock ).arg( P.fxpn ) );
+    slPrb.append(
+        QString("FX(slot %1, port %2, dock %3) hardware version %4")
+        .arg( P.slot ).arg( P.port ).arg( P.dock ).arg( P.fxhw ) );
 
-                if( Z.slot != P.slot || Z.port != P.port )
-                    vHS20.push_back( ip );
-            }
-        }
+    return true;
+}
 
-        // ---
-        // CAL
-        // ---
 
+// BIST SR (shift register) and PSB (parallel serial bus).
+//
+void ImDetWorker::bist( const CimCfg::ImProbeDat &P )
+{
 #ifdef HAVE_IMEC
-        QString path = QString("%1/%2").arg( calibPath() ).arg( P.sn );
+    if( SUCCESS != bistSR( P.slot, P.port, P.dock ) ) {
+        slBIST.append(
+            QString("slot %1, port %2, dock %3: Shift Register")
+            .arg( P.slot ).arg( P.port ).arg( P.dock ) );
+    }
 
-        P.cal = QDir( path ).exists();
+    if( SUCCESS != bistPSB( P.slot, P.port, P.dock ) ) {
+        slBIST.append(
+            QString("slot %1, port %2, dock %3: Parallel Serial Bus")
+            .arg( P.slot ).arg( P.port ).arg( P.dock ) );
+    }
 #else
-        P.cal = 1;
+    Q_UNUSED( P )
 #endif
+}
 
-        // ------------------------
-        // BIST SR (shift register)
-        // ------------------------
+/* ---------------------------------------------------------------- */
+/* detect cache --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
 
-#ifdef HAVE_IMEC
-        if( !doBIST )
-            continue;
+QString CimCfg::detCacheKey( quint64 hssn, quint64 sn )
+{
+    return QString("%1_%2").arg( hssn ).arg( sn );
+}
 
-        err = bistSR( P.slot, P.port, P.dock );
 
-        if( err != SUCCESS ) {
-            slBIST.append(
-                QString("slot %1, port %2, dock %3: Shift Register")
-                .arg( P.slot ).arg( P.port ).arg( P.dock ) );
-        }
-#endif
+void CimCfg::detCacheLoad( QMap<QString,QStringList> &cache )
+{
+    STDSETTINGS( settings, "imdetect_cache" );
+    settings.beginGroup( "ProbeEEPROM" );
 
-        // ------------------------------
-        // BIST PSB (parallel serial bus)
-        // ------------------------------
+    cache.clear();
 
-#ifdef HAVE_IMEC
-        err = bistPSB( P.slot, P.port, P.dock );
+    foreach( const QString &key, settings.childKeys() ) {
 
-        if( err != SUCCESS ) {
-            slBIST.append(
-                QString("slot %1, port %2, dock %3: Parallel Serial Bus")
-                .arg( P.slot ).arg( P.port ).arg( P.dock ) );
-        }
+        QStringList sl = settings.value( key ).toStringList();
 
-        closeBS( P.slot );
-#endif
+        if( sl.size() == 5 )
+            cache[key] = sl;
     }
+}
 
-// ----
-// Exit
-// ----
 
-    ok = true;
+void CimCfg::detCacheSave( const QMap<QString,QStringList> &cache )
+{
+    STDSETTINGS( settings, "imdetect_cache" );
+    settings.remove( "ProbeEEPROM" );
+    settings.beginGroup( "ProbeEEPROM" );
 
-#ifdef HAVE_IMEC
-exit:
-    for( int is = 0, ns = T.nLogSlots(); is < ns; ++is )
-        closeBS( T.getEnumSlot( is ) );
-#endif
+    QMap<QString,QStringList>::const_iterator   it;
 
-    return ok;
+    for( it = cache.begin(); it != cache.end(); ++it )
+        settings.setValue( it.key(), it.value() );
 }
 
 
@@ -1478,6 +1751,10 @@ void CimCfg::forceProbeData(
     const QString   &pn )
 {
 #ifdef HAVE_IMEC
+// EEPROM changing, cached strings are stale
+
+    detCacheSave( QMap<QString,QStringList>() );
+
     if( SUCCESS == openBS( slot ) &&
         SUCCESS == openProbe( slot, port, dock ) ) {
 
@@ -6,6 +6,8 @@
 #include "IMROTbl.h"
 
 #include <QMap>
+#include <QObject>
+#include <QStringList>
 
 class QSettings;
 class QTableWidget;
@@ -169,15 +171,64 @@ public:
     // -------------------------------
 
     struct AttrAll {
-        int     calPolicy,  // {0=required,1=avail,2=never}
-                trgSource;  // {0=software,1=SMA}
+        QString thdCores,   // fetch worker cores, e.g. "4,5,6"
+                simReplay,  // sim replays this run's ap.bin files
+                simPPM;     // sim per-probe clock drift list
+        double  simSpeed,   // sim rate multiplier
+                simJitUs,   // sim sync edge jitter
+                simNoiseUV, // sim bank noise amplitude
+                fltLoHz,    // shared AP filter stage, 0=off
+                fltHiHz,    // shared AP filter stage, 0=none
+                fltNotchHz; // shared AP line notch, 0=none
+        int     fltNotchN,  // notched harmonics
+                calPolicy,  // {0=required,1=avail,2=never}
+                trgSource,  // {0=software,1=SMA}
+                thdMode,    // {0=3 probes/thd,1=per probe,2=per slot}
+                fetchTarg,  // worker sleeps till fifo has this many pkts
+                simPrbs,    // simulated probe count, 0=table
+                simSeed;    // simulated waveform seed
         bool    trgRising,
-                bistAtDetect;
+                bistAtDetect,
+                thdRTPrio,  // time-critical fetch threads
+                cfgParallel,// configure slots concurrently
+                updPrbOnly, // live update pauses probe, not slot
+                rawRec,     // record fetched packets to .pkt files
+                simFast,    // simulate as fast as possible
+                simBank;    // sim copies precomputed waveforms
 
         AttrAll()
-        :   calPolicy(0),
-            trgSource(0), trgRising(true),
-            bistAtDetect(true)  {}
+        :   simSpeed(1.0), simJitUs(0), simNoiseUV(0),
+            fltLoHz(0), fltHiHz(0), fltNotchHz(0),
+            fltNotchN(3), calPolicy(0),
+            trgSource(0), thdMode(0), fetchTarg(5),
+            simPrbs(0), simSeed(0), trgRising(true),
+            bistAtDetect(true), thdRTPrio(false), cfgParallel(false),
+            updPrbOnly(false), rawRec(false), simFast(false),
+            simBank(false)                                      {}
+    };
+
+    // -----------------------
+    // Flat per-channel tables
+    // -----------------------
+
+    // Rebuilt by deriveChanLUT() whenever roTbl, shankMap or
+    // saveBits change, so streaming code indexes arrays rather
+    // than calling IMROTbl virtuals or walking maps per channel.
+    // Indexed by acq channel unless marked [AP].
+    //
+    struct ChanLUT {
+        std::vector<int>    muxTbl;     // IMROTbl::muxTable()
+        std::vector<float>  gain;       // chanGain(); SY=1
+        std::vector<qint16> shank,      // [AP] shankMap
+                            col,        // [AP] shankMap
+                            row,        // [AP] shankMap
+                            mux;        // [AP] muxTbl row (sample slot)
+        std::vector<quint8> used,       // shankMap; LF as AP; SY=1
+                            save;       // saveBits
+        int                 nADC,
+                            nChn;
+
+        ChanLUT() : nADC(0), nChn(0)    {}
     };
 
     // --------------------------
@@ -187,6 +238,7 @@ public:
     // derived:
     // stdbyBits
     // imCumTypCnt[]
+    // lut
 
     struct AttrEach {
         double          srate;
@@ -197,6 +249,7 @@ public:
         int             imCumTypCnt[imNTypes];
         bool            LEDEnable;
         SnsChansImec    sns;
+        ChanLUT         lut;
 
         AttrEach()
         :   srate(30000.0), roTbl(0), LEDEnable(false)  {}
@@ -208,6 +261,7 @@ public:
             stdbyBits   = rhs.stdbyBits;
             LEDEnable   = rhs.LEDEnable;
             sns         = rhs.sns;
+            lut         = rhs.lut;
 
             if( rhs.roTbl ) {
                 roTbl = IMROTbl::alloc( rhs.roTbl->type );
@@ -227,6 +281,7 @@ public:
             stdbyBits   = rhs.stdbyBits;
             LEDEnable   = rhs.LEDEnable;
             sns         = rhs.sns;
+            lut         = rhs.lut;
 
             if( roTbl ) {
                 delete roTbl;
@@ -249,6 +304,7 @@ public:
 
         void deriveChanCounts();
         bool deriveStdbyBits( QString &err, int nAP );
+        void deriveChanLUT();
 
         void justAPBits(
             QBitArray       &apBits,
@@ -308,13 +364,64 @@ public:
         QStringList     &slBIST,
         QVector<int>    &vHS20,
         ImProbeTable    &T,
-        bool            doBIST );
+        bool            doBIST,
+        bool            parallel );
     static void forceProbeData(
         int             slot,
         int             port,
         int             dock,
         const QString   &sn,
         const QString   &pn );
+
+    static QString detCacheKey( quint64 hssn, quint64 sn );
+    static void detCacheLoad( QMap<QString,QStringList> &cache );
+    static void detCacheSave( const QMap<QString,QStringList> &cache );
+};
+
+
+// Detects one slot and its probes for CimCfg::detect,
+// on its own thread when detecting in parallel. Works
+// only on the probe entries it's handed, and reports
+// into its own lists for the caller to merge.
+//
+class ImDetWorker : public QObject
+{
+    Q_OBJECT
+
+private:
+    const QMap<QString,QStringList> &cache;
+    QVector<CimCfg::ImProbeDat*>    vP;
+    bool                            doBIST;
+
+public:
+    CimCfg::ImSlotVers  V;
+    QStringList         slSlot,
+                        slPrb,
+                        slBIST;
+    int                 slot,
+                        nCached;
+    bool                slotOK,
+                        ok;
+
+public:
+    ImDetWorker(
+        const QMap<QString,QStringList>     &cache,
+        const QVector<CimCfg::ImProbeDat*>  &vP,
+        int                                 slot,
+        bool                                doBIST )
+    :   QObject(0), cache(cache), vP(vP), doBIST(doBIST),
+        slot(slot), nCached(0), slotOK(false), ok(false)    {}
+
+signals:
+    void finished();
+
+public slots:
+    void run();
+
+private:
+    bool detectSlot();
+    bool detectProbe( CimCfg::ImProbeDat &P );
+    void bist( const CimCfg::ImProbeDat &P );
 };
 
 #endif  // CIMCFG_H
@@ -11,6 +11,8 @@
 #endif
 
 #include <QComboBox>
+#include <QMap>
+#include <QMutex>
 #include <QSettings>
 #include <QThread>
 
@@ -257,6 +259,36 @@ void CniCfg::loadSettings( QSettings &S )
     startEnable =
     S.value( "niStartEnable", false ).toBool();
 
+    fetchEvt =
+    S.value( "niFetchEvt", false ).toBool();
+
+    dualDevPar =
+    S.value( "niDualDevPar", false ).toBool();
+
+    simReplay =
+    S.value( "niSimReplay", QString() ).toString();
+
+    simSpeed =
+    S.value( "niSimSpeed", 1.0 ).toDouble();
+
+    simPPM =
+    S.value( "niSimPPM", 0.0 ).toDouble();
+
+    simJitUs =
+    S.value( "niSimJitUs", 0.0 ).toDouble();
+
+    fltLoHz =
+    S.value( "niFltStgLo", 0.0 ).toDouble();
+
+    fltHiHz =
+    S.value( "niFltStgHi", 0.0 ).toDouble();
+
+    fltNotchHz =
+    S.value( "niFltStgNotch", 0.0 ).toDouble();
+
+    fltNotchN =
+    S.value( "niFltStgNotchN", 3 ).toInt();
+
     startLine =
     S.value( "niStartLine", "" ).toString();
 
@@ -296,6 +328,16 @@ void CniCfg::saveSettings( QSettings &S ) const
     S.setValue( "niEnabled", enabled );
     S.setValue( "niDualDevMode", isDualDevMode );
     S.setValue( "niStartEnable", startEnable );
+    S.setValue( "niFetchEvt", fetchEvt );
+    S.setValue( "niDualDevPar", dualDevPar );
+    S.setValue( "niSimReplay", simReplay );
+    S.setValue( "niSimSpeed", simSpeed );
+    S.setValue( "niSimPPM", simPPM );
+    S.setValue( "niSimJitUs", simJitUs );
+    S.setValue( "niFltStgLo", fltLoHz );
+    S.setValue( "niFltStgHi", fltHiHz );
+    S.setValue( "niFltStgNotch", fltNotchHz );
+    S.setValue( "niFltStgNotchN", fltNotchN );
     S.setValue( "niStartLine", startLine );
     S.setValue( "niSnsShankMapFile", sns.shankMapFile );
     S.setValue( "niSnsChanMapFile", sns.chanMapFile );
@@ -333,6 +375,16 @@ void CniCfg::saveSettings( QSettings &S ) const
 static QVector<char>    dmxErrMsg;
 static const char       *dmxFnName;
 static int32            dmxErrNum;
+
+// DO tasks kept started while caching (a run), so setDO
+// is a single write. Keyed by lower-cased lines string.
+// doMtx also serializes setDO's use of the dmxErr vars.
+
+#define MAX_DOTASKS 16
+
+static QMutex                   doMtx;
+static QMap<QString,TaskHandle> doTasks;
+static bool                     doCaching = false;
 #endif
 
 static bool noDaqErrPrint = false;
@@ -1438,20 +1490,64 @@ bool CniCfg::isDigitalDev( const QString & )
 //
 // Param (lines) can be a comma separated list of legal lines.
 //
+// Callable from any thread.
+//
+// While caching, the first call for a given lines string
+// creates and starts a task that later calls just write to.
+// A started task reserves its lines, so callers should name
+// a shared line the same way each time.
+//
 #ifdef HAVE_NIDAQmx
 QString CniCfg::setDO( const QString &lines, bool onoff )
 {
-    TaskHandle  taskHandle  = 0;
-    uInt32      w_data      = (onoff ? -1 : 0);
+    QMutexLocker    ml( &doMtx );
+    QString         key         = lines.toLower();
+    TaskHandle      taskHandle  = 0;
+    uInt32          w_data      = (onoff ? -1 : 0);
 
     clearDmxErrors();
 
+// ----------
+// Fast path
+// ----------
+
+    if( doCaching && (taskHandle = doTasks.value( key, 0 )) ) {
+
+        DAQmxErrChk( DAQmxWriteDigitalScalarU32(
+                        taskHandle,
+                        false,          // already started
+                        2.5,            // timeout secs
+                        w_data,
+                        NULL ) );
+
+        return QString::null;
+    }
+
+// --------
+// New task
+// --------
+
     DAQmxErrChk( DAQmxCreateTask( "", &taskHandle ) );
     DAQmxErrChk( DAQmxCreateDOChan(
                     taskHandle,
                     STR2CHR( lines ),
                     "",
                     DAQmx_Val_ChanForAllLines ) );
+
+    if( doCaching && doTasks.size() < MAX_DOTASKS ) {
+
+        DAQmxErrChk( DAQmxStartTask( taskHandle ) );
+        DAQmxErrChk( DAQmxWriteDigitalScalarU32(
+                        taskHandle,
+                        false,          // already started
+                        2.5,            // timeout secs
+                        w_data,
+                        NULL ) );
+
+        doTasks[key] = taskHandle;
+        return QString::null;
+    }
+
     DAQmxErrChk( DAQmxWriteDigitalScalarU32(
                     taskHandle,
                     true,           // autostart
@@ -1463,6 +1559,9 @@ Error_Out:
     if( DAQmxFailed( dmxErrNum ) )
         lastDAQErrMsg();
 
+    if( doTasks.value( key, 0 ) == taskHandle )
+        doTasks.remove( key );
+
     destroyTask( taskHandle );
 
     if( DAQmxFailed( dmxErrNum ) ) {
@@ -1488,6 +1587,35 @@ QString CniCfg::setDO( const QString &lines, bool onoff )
 }
 #endif
 
+
+// Run calls with on=true at start, and false at stop,
+// which clears the cached tasks (lines left as written).
+//
+#ifdef HAVE_NIDAQmx
+void CniCfg::setDOCaching( bool on )
+{
+    QMutexLocker    ml( &doMtx );
+
+    doCaching = on;
+
+    if( on )
+        return;
+
+    QMap<QString,TaskHandle>::iterator  it  = doTasks.begin(),
+                                        end = doTasks.end();
+
+    for( ; it != end; ++it )
+        destroyTask( it.value() );
+
+    doTasks.clear();
+}
+#else
+void CniCfg::setDOCaching( bool on )
+{
+    Q_UNUSED( on )
+}
+#endif
+
 /* ---------------------------------------------------------------- */
 /* sampleFreqMode ------------------------------------------------- */
 /* ---------------------------------------------------------------- */
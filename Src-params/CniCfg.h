@@ -82,15 +82,25 @@ public:
                     uiMAStr1,
                     uiXAStr1,
                     uiXDStr1,
-                    startLine;
-    int             xdBytes1,
+                    startLine,
+                    simReplay;      // sim replays this nidq.bin
+    double          simSpeed,       // sim rate multiplier
+                    simPPM,         // sim clock drift
+                    simJitUs,       // sim sync edge jitter
+                    fltLoHz,        // shared neural filter, 0=off
+                    fltHiHz,        // shared neural filter, 0=none
+                    fltNotchHz;     // shared line notch, 0=none
+    int             fltNotchN,      // notched harmonics
+                    xdBytes1,
                     xdBytes2,
                     niCumTypCnt[niNTypes];
     uint            muxFactor;
     TermConfig      termCfg;
     bool            enabled,
                     isDualDevMode,
-                    startEnable;
+                    startEnable,
+                    fetchEvt,       // DAQmx event-driven fetch
+                    dualDevPar;     // read dev2 concurrently
     SnsChansNidq    sns;
 
     // -------------
@@ -203,6 +213,7 @@ public:
     static bool isDigitalDev( const QString &dev );
 
     static QString setDO( const QString &lines, bool onoff );
+    static void setDOCaching( bool on );
 
     static double sampleFreqMode(
         const QString   &dev,
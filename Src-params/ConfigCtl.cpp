@@ -38,6 +38,9 @@
 #include "Subset.h"
 #include "SignalBlocker.h"
 #include "Version.h"
+#include "Biquad.h"
+#include "RunBench.h"
+#include "DFDiskBench.h"
 
 #include <QButtonGroup>
 #include <QCommonStyle>
@@ -46,6 +49,9 @@
 #include <QSettings>
 #include <QDirIterator>
 #include <QDesktopServices>
+#include <QFileInfo>
+#include <QMutex>
+#include <QThread>
 
 #include <math.h>
 
@@ -61,6 +67,143 @@ static const char *DEF_NISKMP_LE = "*Default (1 shk, 2 col, tip=[0,0])";
 static const char *DEF_IMCHMP_LE = "*Default (follows imro table)";
 static const char *DEF_NICHMP_LE = "*Default (acquired order)";
 
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Parsed imro and shank map files, keyed by path and checked
+// against size and mtime, so that revalidating a many-probe
+// config (often all naming the same few files) doesn't reparse.
+// Probe validations run concurrently, hence the mutex.
+
+struct MapFileStamp {
+    QDateTime   mtime;
+    qint64      size;
+
+    MapFileStamp() : size(-1)  {}
+    MapFileStamp( const QFileInfo &fi )
+        :   mtime(fi.lastModified()), size(fi.size())   {}
+    bool operator==( const MapFileStamp &rhs ) const
+        {return size == rhs.size && mtime == rhs.mtime;}
+};
+
+struct ImroFileRec {
+    MapFileStamp    S;
+    IMROTbl         *R;
+};
+
+struct ShankFileRec {
+    MapFileStamp    S;
+    ShankMap        M;
+};
+
+// Kernel costs for the budget planner, ns per 385-channel scan,
+// used until -microbench has saved this machine's own figures.
+
+struct BudgetKrn {
+    const char  *name;
+    double      ns;
+};
+
+static const BudgetKrn budgetKrnDef[] = {
+    {"aiqEnqueue",      60},
+    {"aiqGetNScans",    80},
+    {"biquadAP",        900},
+    {"subsetHalf",      250},
+    {"downsample12",    40},
+    {"sha1Update",      1300},
+    {"aiqFindEdgeNI",   2}
+};
+
+enum BudgetKrnId {
+    bkEnq   = 0,
+    bkGet,
+    bkFlt,
+    bkSub,
+    bkDwn,
+    bkSha,
+    bkEdge,
+    bkN
+};
+
+static QMutex                       mapFileMtx;
+static QMap<QString,ImroFileRec>    imroFiles;
+static QMap<QString,ShankFileRec>   shankFiles;
+
+
+// Same contract as R->loadFile(); R must be of the probe type.
+//
+static bool loadImroCached( QString &msg, IMROTbl *R, const QString &path )
+{
+    QFileInfo       fi( path );
+    MapFileStamp    S( fi );
+
+    if( fi.exists() ) {
+
+        QMutexLocker                                ml( &mapFileMtx );
+        QMap<QString,ImroFileRec>::const_iterator   it = imroFiles.find( path );
+
+        if( it != imroFiles.end() && it->S == S && it->R->type == R->type ) {
+            R->copyFrom( it->R );
+            return true;
+        }
+    }
+
+    quint32 type = R->type;
+
+    if( !R->loadFile( msg, path ) )
+        return false;
+
+    if( fi.exists() && R->type == type ) {
+
+        QMutexLocker    ml( &mapFileMtx );
+        ImroFileRec     &F = imroFiles[path];
+
+        if( F.S.size >= 0 )
+            delete F.R;
+
+        F.S = S;
+        F.R = IMROTbl::alloc( type );
+        F.R->copyFrom( R );
+    }
+
+    return true;
+}
+
+
+// Same contract as M.loadFile().
+//
+static bool loadShankCached( QString &msg, ShankMap &M, const QString &path )
+{
+    QFileInfo       fi( path );
+    MapFileStamp    S( fi );
+
+    if( fi.exists() ) {
+
+        QMutexLocker                                ml( &mapFileMtx );
+        QMap<QString,ShankFileRec>::const_iterator  it = shankFiles.find( path );
+
+        if( it != shankFiles.end() && it->S == S ) {
+            M = it->M;
+            return true;
+        }
+    }
+
+    if( !M.loadFile( msg, path ) )
+        return false;
+
+    if( fi.exists() ) {
+
+        QMutexLocker    ml( &mapFileMtx );
+        ShankFileRec    &F = shankFiles[path];
+
+        F.S = S;
+        F.M = M;
+    }
+
+    return true;
+}
+
 
 /* ---------------------------------------------------------------- */
 /* ConfigCtl ------------------------------------------------------ */
@@ -72,6 +215,9 @@ static const char *DEF_NICHMP_LE = "*Default (acquired order)";
 // may fire during dialog initialization when those controls are
 // populated. We wish to defer that reaction.
 //
+// The dialog itself is built on first use (buildDialog), which
+// keeps its many tab forms off the startup path.
+//
 ConfigCtl::ConfigCtl( QObject *parent )
     :   QObject(parent),
         cfgUI(0),
@@ -93,198 +239,6 @@ ConfigCtl::ConfigCtl( QObject *parent )
         imecOK(false), nidqOK(false),
         validated(false)
 {
-    QVBoxLayout *L;
-    QWidget     *panel;
-
-// -----------
-// Main dialog
-// -----------
-
-    cfgDlg = new HelpButDialog( "UserManual" );
-    cfgDlg->setWindowIcon( QIcon(QPixmap(Icon_Config_xpm)) );
-    cfgDlg->setAttribute( Qt::WA_DeleteOnClose, false );
-
-    cfgUI = new Ui::ConfigureDialog;
-    cfgUI->setupUi( cfgDlg );
-    cfgUI->tabsW->setCurrentIndex( 0 );
-    ConnectUI( cfgUI->probeCB, SIGNAL(currentIndexChanged(int)), this, SLOT(probeCBChanged()) );
-    ConnectUI( cfgUI->resetBut, SIGNAL(clicked()), this, SLOT(reset()) );
-    ConnectUI( cfgUI->verifyBut, SIGNAL(clicked()), this, SLOT(verify()) );
-    ConnectUI( cfgUI->buttonBox, SIGNAL(accepted()), this, SLOT(okButClicked()) );
-
-// Make OK default button
-
-    QPushButton *B;
-
-    B = cfgUI->buttonBox->button( QDialogButtonBox::Ok );
-    B->setText( "Run" );
-    B->setAutoDefault( true );
-    B->setDefault( true );
-
-    B = cfgUI->buttonBox->button( QDialogButtonBox::Cancel );
-    B->setAutoDefault( false );
-    B->setDefault( false );
-
-// ----------
-// DevicesTab
-// ----------
-
-    QIcon   warnIcon =
-            QCommonStyle().standardIcon( QStyle::SP_MessageBoxWarning );
-
-    devTabUI = new Ui::DevicesTab;
-    devTabUI->setupUi( cfgUI->devTab );
-    devTabUI->warnIcon->setPixmap( warnIcon.pixmap( 24, 24 ) );
-    devTabUI->warnIcon->setStyleSheet( "padding-bottom: 1px; padding-left: 20px" );
-    devTabUI->warnIcon->hide();
-    devTabUI->warnLbl->hide();
-    ConnectUI( devTabUI->imecGB, SIGNAL(clicked()), this, SLOT(imPrbTabChanged()) );
-    ConnectUI( devTabUI->nidqGB, SIGNAL(clicked()), this, SLOT(nidqEnabClicked()) );
-    ConnectUI( devTabUI->moreBut, SIGNAL(clicked()), this, SLOT(moreButClicked()) );
-    ConnectUI( devTabUI->lessBut, SIGNAL(clicked()), this, SLOT(lessButClicked()) );
-    ConnectUI( devTabUI->imPrbTbl, SIGNAL(cellChanged(int,int)), this, SLOT(imPrbTabCellChng(int,int)) );
-    ConnectUI( devTabUI->detectBut, SIGNAL(clicked()), this, SLOT(detectButClicked()) );
-
-// --------
-// IMCfgTab
-// --------
-
-    imTabUI = new Ui::IMCfgTab;
-    imTabUI->setupUi( cfgUI->imTab );
-    ConnectUI( imTabUI->forceBut, SIGNAL(clicked()), this, SLOT(forceButClicked()) );
-    ConnectUI( imTabUI->otherCB, SIGNAL(currentIndexChanged(int)), this, SLOT(otherProbeCBChanged()) );
-    ConnectUI( imTabUI->copyBut, SIGNAL(clicked()), this, SLOT(copyButClicked()) );
-    ConnectUI( imTabUI->imroBut, SIGNAL(clicked()), this, SLOT(imroButClicked()) );
-    ConnectUI( imTabUI->calCB, SIGNAL(currentIndexChanged(int)), this, SLOT(updateCalWarning()) );
-
-// --------
-// NICfgTab
-// --------
-
-    niTabUI = new Ui::NICfgTab;
-    niTabUI->setupUi( cfgUI->niTab );
-    ConnectUI( niTabUI->device1CB, SIGNAL(currentIndexChanged(int)), this, SLOT(device1CBChanged()) );
-    ConnectUI( niTabUI->device2CB, SIGNAL(currentIndexChanged(int)), this, SLOT(device2CBChanged()) );
-    ConnectUI( niTabUI->mn1LE, SIGNAL(textChanged(QString)), this, SLOT(muxingChanged()) );
-    ConnectUI( niTabUI->ma1LE, SIGNAL(textChanged(QString)), this, SLOT(muxingChanged()) );
-    ConnectUI( niTabUI->mn2LE, SIGNAL(textChanged(QString)), this, SLOT(muxingChanged()) );
-    ConnectUI( niTabUI->ma2LE, SIGNAL(textChanged(QString)), this, SLOT(muxingChanged()) );
-    ConnectUI( niTabUI->dev2GB, SIGNAL(clicked()), this, SLOT(muxingChanged()) );
-    ConnectUI( niTabUI->clkSourceCB, SIGNAL(currentIndexChanged(int)), this, SLOT(clkSourceCBChanged()) );
-    ConnectUI( niTabUI->newSourceBut, SIGNAL(clicked()), this, SLOT(newSourceButClicked()) );
-    ConnectUI( niTabUI->startEnabChk, SIGNAL(clicked(bool)), this, SLOT(startEnableClicked(bool)) );
-
-// -------
-// SyncTab
-// -------
-
-    syncTabUI = new Ui::SyncTab;
-    syncTabUI->setupUi( cfgUI->syncTab );
-    ConnectUI( syncTabUI->sourceCB, SIGNAL(currentIndexChanged(int)), this, SLOT(syncSourceCBChanged()) );
-    ConnectUI( syncTabUI->niChanCB, SIGNAL(currentIndexChanged(int)), this, SLOT(syncNiChanTypeCBChanged()) );
-    ConnectUI( syncTabUI->calChk, SIGNAL(clicked(bool)), this, SLOT(syncCalChkClicked()) );
-
-// -------
-// GateTab
-// -------
-
-    gateTabUI = new Ui::GateTab;
-    gateTabUI->setupUi( cfgUI->gateTab );
-    ConnectUI( gateTabUI->gateModeCB, SIGNAL(currentIndexChanged(int)), this, SLOT(gateModeChanged()) );
-    ConnectUI( gateTabUI->manOvShowButChk, SIGNAL(clicked(bool)), this, SLOT(manOvShowButClicked(bool)) );
-
-    L = new QVBoxLayout( gateTabUI->gateFrame );
-
-// Immediate
-    panel = new QWidget;
-    panel->setObjectName( QString("panel_%1").arg( DAQ::eGateImmed ) );
-    gateImmPanelUI = new Ui::GateImmedPanel;
-    gateImmPanelUI->setupUi( panel );
-    L->addWidget( panel );
-
-// TCP
-    panel = new QWidget;
-    panel->setObjectName( QString("panel_%1").arg( DAQ::eGateTCP ) );
-    gateTCPPanelUI = new Ui::GateTCPPanel;
-    gateTCPPanelUI->setupUi( panel );
-    L->addWidget( panel );
-
-// -------
-// TrigTab
-// -------
-
-    trigTabUI = new Ui::TrigTab;
-    trigTabUI->setupUi( cfgUI->trigTab );
-    ConnectUI( trigTabUI->trigModeCB, SIGNAL(currentIndexChanged(int)), this, SLOT(trigModeChanged()) );
-
-    L = new QVBoxLayout( trigTabUI->trigFrame );
-
-// Immediate
-    panel = new QWidget;
-    panel->setObjectName( QString("panel_%1").arg( DAQ::eTrigImmed ) );
-    trigImmPanelUI = new Ui::TrigImmedPanel;
-    trigImmPanelUI->setupUi( panel );
-    L->addWidget( panel );
-
-// Timed
-    panel = new QWidget;
-    panel->setObjectName( QString("panel_%1").arg( DAQ::eTrigTimed ) );
-    trigTimPanelUI = new Ui::TrigTimedPanel;
-    trigTimPanelUI->setupUi( panel );
-    ConnectUI( trigTimPanelUI->HInfRadio, SIGNAL(clicked()), this, SLOT(trigTimHInfClicked()) );
-    ConnectUI( trigTimPanelUI->cyclesRadio, SIGNAL(clicked()), this, SLOT(trigTimHInfClicked()) );
-    ConnectUI( trigTimPanelUI->NInfChk, SIGNAL(clicked(bool)), this, SLOT(trigTimNInfClicked(bool)) );
-
-    QButtonGroup    *bgTim = new QButtonGroup( panel );
-    bgTim->addButton( trigTimPanelUI->HInfRadio );
-    bgTim->addButton( trigTimPanelUI->cyclesRadio );
-    L->addWidget( panel );
-
-// TTL
-    panel = new QWidget;
-    panel->setObjectName( QString("panel_%1").arg( DAQ::eTrigTTL ) );
-    trigTTLPanelUI = new Ui::TrigTTLPanel;
-    trigTTLPanelUI->setupUi( panel );
-    ConnectUI( trigTTLPanelUI->analogRadio, SIGNAL(clicked()), this, SLOT(trigTTLAnalogChanged()) );
-    ConnectUI( trigTTLPanelUI->digRadio, SIGNAL(clicked()), this, SLOT(trigTTLAnalogChanged()) );
-    ConnectUI( trigTTLPanelUI->modeCB, SIGNAL(currentIndexChanged(int)), this, SLOT(trigTTLModeChanged(int)) );
-    ConnectUI( trigTTLPanelUI->NInfChk, SIGNAL(clicked(bool)), this, SLOT(trigTTLNInfClicked(bool)) );
-    L->addWidget( panel );
-
-// Spike
-    panel = new QWidget;
-    panel->setObjectName( QString("panel_%1").arg( DAQ::eTrigSpike ) );
-    trigSpkPanelUI = new Ui::TrigSpikePanel;
-    trigSpkPanelUI->setupUi( panel );
-    ConnectUI( trigSpkPanelUI->NInfChk, SIGNAL(clicked(bool)), this, SLOT(trigSpkNInfClicked(bool)) );
-    L->addWidget( panel );
-
-// TCP
-    panel = new QWidget;
-    panel->setObjectName( QString("panel_%1").arg( DAQ::eTrigTCP ) );
-    trigTCPPanelUI = new Ui::TrigTCPPanel;
-    trigTCPPanelUI->setupUi( panel );
-    L->addWidget( panel );
-
-// ------
-// MapTab
-// ------
-
-    mapTabUI = new Ui::MapTab;
-    mapTabUI->setupUi( cfgUI->mapTab );
-    ConnectUI( mapTabUI->imShkMapBut, SIGNAL(clicked()), this, SLOT(imShkMapButClicked()) );
-    ConnectUI( mapTabUI->niShkMapBut, SIGNAL(clicked()), this, SLOT(niShkMapButClicked()) );
-    ConnectUI( mapTabUI->imChnMapBut, SIGNAL(clicked()), this, SLOT(imChnMapButClicked()) );
-    ConnectUI( mapTabUI->niChnMapBut, SIGNAL(clicked()), this, SLOT(niChnMapButClicked()) );
-
-// -----------
-// SeeNSaveTab
-// -----------
-
-    snsTabUI = new Ui::SeeNSaveTab;
-    snsTabUI->setupUi( cfgUI->snsTab );
-    ConnectUI( snsTabUI->dataDirBut, SIGNAL(clicked()), this, SLOT(dataDirButClicked()) );
-    ConnectUI( snsTabUI->diskBut, SIGNAL(clicked()), this, SLOT(diskButClicked()) );
 }
 
 
@@ -384,6 +338,7 @@ ConfigCtl::~ConfigCtl()
 
 bool ConfigCtl::showDialog()
 {
+    buildDialog();
     reset();
     setupGateTab( acceptedParams ); // adjusts initial dialog sizing
     setupTrigTab( acceptedParams ); // adjusts initial dialog sizing
@@ -410,6 +365,9 @@ void ConfigCtl::setParams( const DAQ::Params &p, bool write )
 {
     acceptedParams = p;
 
+    for( int ip = 0, np = acceptedParams.im.get_nProbes(); ip < np; ++ip )
+        acceptedParams.im.each[ip].deriveChanLUT();
+
     if( write )
         acceptedParams.saveSettings();
 }
@@ -426,7 +384,7 @@ bool ConfigCtl::externSetsRunName(
 
         acceptedParams.saveSettings();
 
-        if( cfgDlg->isVisible() )
+        if( cfgDlg && cfgDlg->isVisible() )
             snsTabUI->runNameLE->setText( name );
 
         return true;
@@ -462,6 +420,7 @@ void ConfigCtl::graphSetsImroFile( const QString &file, int ip )
             validImChanMap( err, p, ip );
         }
 
+        E.deriveChanLUT();
         p.saveSettings();
     }
     else
@@ -483,6 +442,7 @@ void ConfigCtl::graphSetsStdbyStr( const QString &sdtbyStr, int ip )
 
         E.sns.shankMap = E.sns.shankMap_orig;
         E.sns.shankMap.andOutImStdby( E.stdbyBits );
+        E.deriveChanLUT();
         p.saveSettings();
     }
     else
@@ -583,8 +543,10 @@ void ConfigCtl::graphSetsImSaveStr( const QString &saveStr, int ip )
     oldStr = p.im.each[ip].sns.uiSaveChanStr;
     p.im.each[ip].sns.uiSaveChanStr = saveStr;
 
-    if( validImSaveBits( err, p, ip ) )
+    if( validImSaveBits( err, p, ip ) ) {
+        p.im.each[ip].deriveChanLUT();
         p.saveSettings();
+    }
     else {
         p.im.each[ip].sns.uiSaveChanStr = oldStr;
         Error() << err;
@@ -618,6 +580,7 @@ void ConfigCtl::graphSetsImSaveBit( int chan, bool setOn, int ip )
         && chan < E.imCumTypCnt[CimCfg::imSumAll] ) {
 
         E.sns.saveBits.setBit( chan, setOn );
+        E.deriveChanLUT();
 
         E.sns.uiSaveChanStr =
             Subset::bits2RngStr( E.sns.saveBits );
@@ -805,6 +768,7 @@ QString ConfigCtl::cmdSrvSetsParamStr( const QString &paramString )
 
 // Currently allow only niEnable to change
 //    setupDevTab( p );   // Note: If called, may write to imecOK
+    buildDialog();
     devTabUI->nidqGB->setChecked( p.ni.enabled );
 
     setNoDialogAccess();
@@ -2142,33 +2106,235 @@ void ConfigCtl::reset()
 }
 
 
-void ConfigCtl::verify()
-{
-    QString err;
+void ConfigCtl::verify()
+{
+    QString err;
+
+    if( valid( err, cfgDlg ) )
+        ;
+    else if( !err.isEmpty() )
+        QMessageBox::critical( cfgDlg, "ACQ Parameter Error", err );
+}
+
+
+void ConfigCtl::okButClicked()
+{
+    QString err;
+
+    if( valid( err, cfgDlg ) )
+        cfgDlg->accept();
+    else if( !err.isEmpty() )
+        QMessageBox::critical( cfgDlg, "ACQ Parameter Error", err );
+}
+
+/* ---------------------------------------------------------------- */
+/* Private -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Return true if this app instance owns NI hardware.
+//
+// Create dialog and tab forms once, on first need.
+//
+void ConfigCtl::buildDialog()
+{
+    if( cfgDlg )
+        return;
+
+    QVBoxLayout *L;
+    QWidget     *panel;
+
+// -----------
+// Main dialog
+// -----------
+
+    cfgDlg = new HelpButDialog( "UserManual" );
+    cfgDlg->setWindowIcon( QIcon(QPixmap(Icon_Config_xpm)) );
+    cfgDlg->setAttribute( Qt::WA_DeleteOnClose, false );
+
+    cfgUI = new Ui::ConfigureDialog;
+    cfgUI->setupUi( cfgDlg );
+    cfgUI->tabsW->setCurrentIndex( 0 );
+    ConnectUI( cfgUI->probeCB, SIGNAL(currentIndexChanged(int)), this, SLOT(probeCBChanged()) );
+    ConnectUI( cfgUI->resetBut, SIGNAL(clicked()), this, SLOT(reset()) );
+    ConnectUI( cfgUI->verifyBut, SIGNAL(clicked()), this, SLOT(verify()) );
+    ConnectUI( cfgUI->buttonBox, SIGNAL(accepted()), this, SLOT(okButClicked()) );
+
+// Make OK default button
+
+    QPushButton *B;
+
+    B = cfgUI->buttonBox->button( QDialogButtonBox::Ok );
+    B->setText( "Run" );
+    B->setAutoDefault( true );
+    B->setDefault( true );
+
+    B = cfgUI->buttonBox->button( QDialogButtonBox::Cancel );
+    B->setAutoDefault( false );
+    B->setDefault( false );
+
+// ----------
+// DevicesTab
+// ----------
+
+    QIcon   warnIcon =
+            QCommonStyle().standardIcon( QStyle::SP_MessageBoxWarning );
+
+    devTabUI = new Ui::DevicesTab;
+    devTabUI->setupUi( cfgUI->devTab );
+    devTabUI->warnIcon->setPixmap( warnIcon.pixmap( 24, 24 ) );
+    devTabUI->warnIcon->setStyleSheet( "padding-bottom: 1px; padding-left: 20px" );
+    devTabUI->warnIcon->hide();
+    devTabUI->warnLbl->hide();
+    ConnectUI( devTabUI->imecGB, SIGNAL(clicked()), this, SLOT(imPrbTabChanged()) );
+    ConnectUI( devTabUI->nidqGB, SIGNAL(clicked()), this, SLOT(nidqEnabClicked()) );
+    ConnectUI( devTabUI->moreBut, SIGNAL(clicked()), this, SLOT(moreButClicked()) );
+    ConnectUI( devTabUI->lessBut, SIGNAL(clicked()), this, SLOT(lessButClicked()) );
+    ConnectUI( devTabUI->imPrbTbl, SIGNAL(cellChanged(int,int)), this, SLOT(imPrbTabCellChng(int,int)) );
+    ConnectUI( devTabUI->detectBut, SIGNAL(clicked()), this, SLOT(detectButClicked()) );
+
+// --------
+// IMCfgTab
+// --------
+
+    imTabUI = new Ui::IMCfgTab;
+    imTabUI->setupUi( cfgUI->imTab );
+    ConnectUI( imTabUI->forceBut, SIGNAL(clicked()), this, SLOT(forceButClicked()) );
+    ConnectUI( imTabUI->otherCB, SIGNAL(currentIndexChanged(int)), this, SLOT(otherProbeCBChanged()) );
+    ConnectUI( imTabUI->copyBut, SIGNAL(clicked()), this, SLOT(copyButClicked()) );
+    ConnectUI( imTabUI->imroBut, SIGNAL(clicked()), this, SLOT(imroButClicked()) );
+    ConnectUI( imTabUI->calCB, SIGNAL(currentIndexChanged(int)), this, SLOT(updateCalWarning()) );
+
+// --------
+// NICfgTab
+// --------
+
+    niTabUI = new Ui::NICfgTab;
+    niTabUI->setupUi( cfgUI->niTab );
+    ConnectUI( niTabUI->device1CB, SIGNAL(currentIndexChanged(int)), this, SLOT(device1CBChanged()) );
+    ConnectUI( niTabUI->device2CB, SIGNAL(currentIndexChanged(int)), this, SLOT(device2CBChanged()) );
+    ConnectUI( niTabUI->mn1LE, SIGNAL(textChanged(QString)), this, SLOT(muxingChanged()) );
+    ConnectUI( niTabUI->ma1LE, SIGNAL(textChanged(QString)), this, SLOT(muxingChanged()) );
+    ConnectUI( niTabUI->mn2LE, SIGNAL(textChanged(QString)), this, SLOT(muxingChanged()) );
+    ConnectUI( niTabUI->ma2LE, SIGNAL(textChanged(QString)), this, SLOT(muxingChanged()) );
+    ConnectUI( niTabUI->dev2GB, SIGNAL(clicked()), this, SLOT(muxingChanged()) );
+    ConnectUI( niTabUI->clkSourceCB, SIGNAL(currentIndexChanged(int)), this, SLOT(clkSourceCBChanged()) );
+    ConnectUI( niTabUI->newSourceBut, SIGNAL(clicked()), this, SLOT(newSourceButClicked()) );
+    ConnectUI( niTabUI->startEnabChk, SIGNAL(clicked(bool)), this, SLOT(startEnableClicked(bool)) );
+
+// -------
+// SyncTab
+// -------
+
+    syncTabUI = new Ui::SyncTab;
+    syncTabUI->setupUi( cfgUI->syncTab );
+    ConnectUI( syncTabUI->sourceCB, SIGNAL(currentIndexChanged(int)), this, SLOT(syncSourceCBChanged()) );
+    ConnectUI( syncTabUI->niChanCB, SIGNAL(currentIndexChanged(int)), this, SLOT(syncNiChanTypeCBChanged()) );
+    ConnectUI( syncTabUI->calChk, SIGNAL(clicked(bool)), this, SLOT(syncCalChkClicked()) );
+
+// -------
+// GateTab
+// -------
+
+    gateTabUI = new Ui::GateTab;
+    gateTabUI->setupUi( cfgUI->gateTab );
+    ConnectUI( gateTabUI->gateModeCB, SIGNAL(currentIndexChanged(int)), this, SLOT(gateModeChanged()) );
+    ConnectUI( gateTabUI->manOvShowButChk, SIGNAL(clicked(bool)), this, SLOT(manOvShowButClicked(bool)) );
+
+    L = new QVBoxLayout( gateTabUI->gateFrame );
+
+// Immediate
+    panel = new QWidget;
+    panel->setObjectName( QString("panel_%1").arg( DAQ::eGateImmed ) );
+    gateImmPanelUI = new Ui::GateImmedPanel;
+    gateImmPanelUI->setupUi( panel );
+    L->addWidget( panel );
+
+// TCP
+    panel = new QWidget;
+    panel->setObjectName( QString("panel_%1").arg( DAQ::eGateTCP ) );
+    gateTCPPanelUI = new Ui::GateTCPPanel;
+    gateTCPPanelUI->setupUi( panel );
+    L->addWidget( panel );
+
+// -------
+// TrigTab
+// -------
+
+    trigTabUI = new Ui::TrigTab;
+    trigTabUI->setupUi( cfgUI->trigTab );
+    ConnectUI( trigTabUI->trigModeCB, SIGNAL(currentIndexChanged(int)), this, SLOT(trigModeChanged()) );
+
+    L = new QVBoxLayout( trigTabUI->trigFrame );
+
+// Immediate
+    panel = new QWidget;
+    panel->setObjectName( QString("panel_%1").arg( DAQ::eTrigImmed ) );
+    trigImmPanelUI = new Ui::TrigImmedPanel;
+    trigImmPanelUI->setupUi( panel );
+    L->addWidget( panel );
+
+// Timed
+    panel = new QWidget;
+    panel->setObjectName( QString("panel_%1").arg( DAQ::eTrigTimed ) );
+    trigTimPanelUI = new Ui::TrigTimedPanel;
+    trigTimPanelUI->setupUi( panel );
+    ConnectUI( trigTimPanelUI->HInfRadio, SIGNAL(clicked()), this, SLOT(trigTimHInfClicked()) );
+    ConnectUI( trigTimPanelUI->cyclesRadio, SIGNAL(clicked()), this, SLOT(trigTimHInfClicked()) );
+    ConnectUI( trigTimPanelUI->NInfChk, SIGNAL(clicked(bool)), this, SLOT(trigTimNInfClicked(bool)) );
+
+    QButtonGroup    *bgTim = new QButtonGroup( panel );
+    bgTim->addButton( trigTimPanelUI->HInfRadio );
+    bgTim->addButton( trigTimPanelUI->cyclesRadio );
+    L->addWidget( panel );
+
+// TTL
+    panel = new QWidget;
+    panel->setObjectName( QString("panel_%1").arg( DAQ::eTrigTTL ) );
+    trigTTLPanelUI = new Ui::TrigTTLPanel;
+    trigTTLPanelUI->setupUi( panel );
+    ConnectUI( trigTTLPanelUI->analogRadio, SIGNAL(clicked()), this, SLOT(trigTTLAnalogChanged()) );
+    ConnectUI( trigTTLPanelUI->digRadio, SIGNAL(clicked()), this, SLOT(trigTTLAnalogChanged()) );
+    ConnectUI( trigTTLPanelUI->modeCB, SIGNAL(currentIndexChanged(int)), this, SLOT(trigTTLModeChanged(int)) );
+    ConnectUI( trigTTLPanelUI->NInfChk, SIGNAL(clicked(bool)), this, SLOT(trigTTLNInfClicked(bool)) );
+    L->addWidget( panel );
+
+// Spike
+    panel = new QWidget;
+    panel->setObjectName( QString("panel_%1").arg( DAQ::eTrigSpike ) );
+    trigSpkPanelUI = new Ui::TrigSpikePanel;
+    trigSpkPanelUI->setupUi( panel );
+    ConnectUI( trigSpkPanelUI->NInfChk, SIGNAL(clicked(bool)), this, SLOT(trigSpkNInfClicked(bool)) );
+    L->addWidget( panel );
+
+// TCP
+    panel = new QWidget;
+    panel->setObjectName( QString("panel_%1").arg( DAQ::eTrigTCP ) );
+    trigTCPPanelUI = new Ui::TrigTCPPanel;
+    trigTCPPanelUI->setupUi( panel );
+    L->addWidget( panel );
 
-    if( valid( err, cfgDlg ) )
-        ;
-    else if( !err.isEmpty() )
-        QMessageBox::critical( cfgDlg, "ACQ Parameter Error", err );
-}
+// ------
+// MapTab
+// ------
 
+    mapTabUI = new Ui::MapTab;
+    mapTabUI->setupUi( cfgUI->mapTab );
+    ConnectUI( mapTabUI->imShkMapBut, SIGNAL(clicked()), this, SLOT(imShkMapButClicked()) );
+    ConnectUI( mapTabUI->niShkMapBut, SIGNAL(clicked()), this, SLOT(niShkMapButClicked()) );
+    ConnectUI( mapTabUI->imChnMapBut, SIGNAL(clicked()), this, SLOT(imChnMapButClicked()) );
+    ConnectUI( mapTabUI->niChnMapBut, SIGNAL(clicked()), this, SLOT(niChnMapButClicked()) );
 
-void ConfigCtl::okButClicked()
-{
-    QString err;
+// -----------
+// SeeNSaveTab
+// -----------
 
-    if( valid( err, cfgDlg ) )
-        cfgDlg->accept();
-    else if( !err.isEmpty() )
-        QMessageBox::critical( cfgDlg, "ACQ Parameter Error", err );
+    snsTabUI = new Ui::SeeNSaveTab;
+    snsTabUI->setupUi( cfgUI->snsTab );
+    ConnectUI( snsTabUI->dataDirBut, SIGNAL(clicked()), this, SLOT(dataDirButClicked()) );
+    ConnectUI( snsTabUI->diskBut, SIGNAL(clicked()), this, SLOT(diskButClicked()) );
 }
 
-/* ---------------------------------------------------------------- */
-/* Private -------------------------------------------------------- */
-/* ---------------------------------------------------------------- */
 
-// Return true if this app instance owns NI hardware.
-//
 bool ConfigCtl::singletonReserve()
 {
 #ifdef HAVE_NIDAQmx
@@ -2443,10 +2609,11 @@ void ConfigCtl::imDetect()
 // @@@ FIX v2.0 BIST temporarily disabled
 //    imecOK = CimCfg::detect(
 //                slVers, slBIST, vHS20, prbTab,
-//                devTabUI->bistChk->isChecked() );
+//                devTabUI->bistChk->isChecked(),
+//                acceptedParams.im.all.cfgParallel );
     imecOK = CimCfg::detect(
                 slVers, slBIST, vHS20, prbTab,
-                false );
+                false, acceptedParams.im.all.cfgParallel );
 
 // -------
 // Reports
@@ -3257,6 +3424,7 @@ void ConfigCtl::setupTrigTab( const DAQ::Params &p )
     trigTimPanelUI->HInfRadio->setChecked( p.trgTim.isHInf );
     trigTimPanelUI->cyclesRadio->setChecked( !p.trgTim.isHInf );
     trigTimPanelUI->NInfChk->setChecked( p.trgTim.isNInf );
+    trigTimPanelUI->oneFileChk->setChecked( p.trgTim.oneFile );
 
 // ------------
 // TrgTTLParams
@@ -3285,6 +3453,8 @@ void ConfigCtl::setupTrigTab( const DAQ::Params &p )
     trigTTLPanelUI->analogRadio->setChecked( p.trgTTL.isAnalog );
     trigTTLPanelUI->digRadio->setChecked( !p.trgTTL.isAnalog );
     trigTTLPanelUI->NInfChk->setChecked( p.trgTTL.isNInf );
+    trigTTLPanelUI->lowLatChk->setChecked( p.trgTTL.lowLat );
+    trigTTLPanelUI->doLineLE->setText( p.trgTTL.doLine );
 
 // --------------
 // TrgSpikeParams
@@ -3297,9 +3467,11 @@ void ConfigCtl::setupTrigTab( const DAQ::Params &p )
     trigSpkPanelUI->periSB->setValue( p.trgSpike.periEvtSecs );
     trigSpkPanelUI->refracSB->setValue( p.trgSpike.refractSecs );
     trigSpkPanelUI->chanSB->setValue( p.trgSpike.aiChan );
+    trigSpkPanelUI->chansLE->setText( p.trgSpike.chans );
     trigSpkPanelUI->inarowSB->setValue( p.trgSpike.inarow );
     trigSpkPanelUI->NSB->setValue( p.trgSpike.nS );
     trigSpkPanelUI->NInfChk->setChecked( p.trgSpike.isNInf );
+    trigSpkPanelUI->mergeChk->setChecked( p.trgSpike.merge );
 
 // -------
 // TrigTab
@@ -3395,6 +3567,8 @@ void ConfigCtl::setupSnsTab( const DAQ::Params &p )
     snsTabUI->runNameLE->setText( p.sns.runName );
     snsTabUI->fldChk->setChecked( p.sns.fldPerPrb );
     snsTabUI->fldChk->setEnabled( imecOK );
+    snsTabUI->dioChk->setChecked( p.sns.directIO );
+    snsTabUI->cmpChk->setChecked( p.sns.compress );
 
     snsTabUI->diskSB->setValue( p.sns.reqMins );
 
@@ -3689,6 +3863,7 @@ void ConfigCtl::paramsFromDialog(
     q.trgTim.nH     = trigTimPanelUI->NSB->value();
     q.trgTim.isHInf = trigTimPanelUI->HInfRadio->isChecked();
     q.trgTim.isNInf = trigTimPanelUI->NInfChk->isChecked();
+    q.trgTim.oneFile= trigTimPanelUI->oneFileChk->isChecked();
 
 // ------------
 // TrgTTLParams
@@ -3705,6 +3880,8 @@ void ConfigCtl::paramsFromDialog(
     q.trgTTL.nH             = trigTTLPanelUI->NSB->value();
     q.trgTTL.isAnalog       = trigTTLPanelUI->analogRadio->isChecked();
     q.trgTTL.isNInf         = trigTTLPanelUI->NInfChk->isChecked();
+    q.trgTTL.lowLat         = trigTTLPanelUI->lowLatChk->isChecked();
+    q.trgTTL.doLine         = trigTTLPanelUI->doLineLE->text().trimmed();
 
     if( q.trgTTL.isAnalog )
         q.trgTTL.stream = trigTTLPanelUI->aStreamCB->currentText();
@@ -3720,9 +3897,11 @@ void ConfigCtl::paramsFromDialog(
     q.trgSpike.refractSecs  = trigSpkPanelUI->refracSB->value();
     q.trgSpike.stream       = trigSpkPanelUI->streamCB->currentText();
     q.trgSpike.aiChan       = trigSpkPanelUI->chanSB->value();
+    q.trgSpike.chans        = trigSpkPanelUI->chansLE->text().trimmed();
     q.trgSpike.inarow       = trigSpkPanelUI->inarowSB->value();
     q.trgSpike.nS           = trigSpkPanelUI->NSB->value();
     q.trgSpike.isNInf       = trigSpkPanelUI->NInfChk->isChecked();
+    q.trgSpike.merge        = trigSpkPanelUI->mergeChk->isChecked();
 
 // ----------
 // ModeParams
@@ -3750,6 +3929,13 @@ void ConfigCtl::paramsFromDialog(
     q.sns.notes             = snsTabUI->notesTE->toPlainText().trimmed();
     q.sns.runName           = snsTabUI->runNameLE->text().trimmed();
     q.sns.fldPerPrb         = snsTabUI->fldChk->isChecked();
+    q.sns.directIO          = snsTabUI->dioChk->isChecked();
+    q.sns.compress          = snsTabUI->cmpChk->isChecked();
+    q.sns.imWrBlkMB         = acceptedParams.sns.imWrBlkMB;
+    q.sns.niWrBlkMB         = acceptedParams.sns.niWrBlkMB;
+    q.sns.maxCloses         = acceptedParams.sns.maxCloses;
+    q.sns.par2MB            = acceptedParams.sns.par2MB;
+    q.sns.wrShedLF          = acceptedParams.sns.wrShedLF;
     q.sns.reqMins           = snsTabUI->diskSB->value();
 }
 
@@ -3791,7 +3977,7 @@ bool ConfigCtl::validImROTbl( QString &err, CimCfg::AttrEach &E, int ip ) const
 
     QString msg;
 
-    if( !E.roTbl->loadFile( msg, E.imroFile ) ) {
+    if( !loadImroCached( msg, E.roTbl, E.imroFile ) ) {
 
         err = QString("ImroFile: %1.").arg( msg );
         return false;
@@ -4482,6 +4668,25 @@ bool ConfigCtl::validImTriggering( QString &err, DAQ::Params &q ) const
             return false;
         }
 
+        if( q.mode.mTrig == DAQ::eTrigSpike && !q.trgSpike.chans.isEmpty() ) {
+
+            QVector<uint>   vc;
+
+            if( !Subset::rngStr2Vec( vc, q.trgSpike.chans )
+                || vc.isEmpty()
+                || vc.last() >= uint(nLegal) ) {
+
+                err =
+                QString(
+                "Invalid '%1' trigger channel list [%2];"
+                " must be in range [0..%3].")
+                .arg( DAQ::trigModeToString( q.mode.mTrig ) )
+                .arg( q.trgSpike.chans )
+                .arg( nLegal - 1 );
+                return false;
+            }
+        }
+
         double  Tmin = q.im.each[ip].intToV( -maxInt, trgChan ),
                 Tmax = q.im.each[ip].intToV(  maxInt - 1, trgChan );
 
@@ -4566,6 +4771,25 @@ bool ConfigCtl::validNiTriggering( QString &err, DAQ::Params &q ) const
             return false;
         }
 
+        if( q.mode.mTrig == DAQ::eTrigSpike && !q.trgSpike.chans.isEmpty() ) {
+
+            QVector<uint>   vc;
+
+            if( !Subset::rngStr2Vec( vc, q.trgSpike.chans )
+                || vc.isEmpty()
+                || vc.last() >= uint(nLegal) ) {
+
+                err =
+                QString(
+                "Invalid '%1' trigger channel list [%2];"
+                " must be in range [0..%3].")
+                .arg( DAQ::trigModeToString( q.mode.mTrig ) )
+                .arg( q.trgSpike.chans )
+                .arg( nLegal - 1 );
+                return false;
+            }
+        }
+
         double  Tmin = q.ni.int16ToV( -32768, trgChan ),
                 Tmax = q.ni.int16ToV(  32767, trgChan );
 
@@ -4646,25 +4870,28 @@ bool ConfigCtl::validTrgPeriEvent( QString &err, DAQ::Params &q ) const
     if( q.mode.mTrig == DAQ::eTrigSpike
         || q.mode.mTrig == DAQ::eTrigTTL ) {
 
-        // Test for perievent window
+        // Test for perievent window.
+        // Context beyond 50% of the stream length is
+        // supplied by pre-trigger spill, if RAM allows.
 
-        double stream, trgMrg;
+        Run     *run = mainApp()->getRun();
+        double  GB, trgMrg;
 
         if( q.mode.mTrig == DAQ::eTrigSpike )
             trgMrg = q.trgSpike.periEvtSecs;
         else
             trgMrg = q.trgTTL.marginSecs;
 
-        stream = 0.50 * mainApp()->getRun()->streamSpanMax( q, false );
-
-        if( trgMrg >= stream ) {
+        if( !run->trgSpillFits( GB, q ) ) {
 
             err =
             QString(
-            "The trigger added context secs [%1] must be shorter than"
-            " [%2] which is 50% of the expected stream length.")
+            "The trigger added context secs [%1] needs [%2] GB of"
+            " pre-trigger spill memory beyond the [%3] second stream,"
+            " which is more than 25% of available RAM.")
             .arg( trgMrg )
-            .arg( stream );
+            .arg( GB, 0, 'f', 2 )
+            .arg( run->streamSpanMax( q, false ) );
             return false;
         }
     }
@@ -4684,6 +4911,14 @@ bool ConfigCtl::validTrgLowTime( QString &err, DAQ::Params &q ) const
             err = "Time trigger: A negative L must be smaller than H/2.";
             return false;
         }
+
+        // One file can't hold overlapping cycles
+
+        if( q.trgTim.tL < 0 && q.trgTim.oneFile && !q.trgTim.isHInf ) {
+
+            err = "Time trigger: One file per gate requires L >= 0.";
+            return false;
+        }
     }
 
     return true;
@@ -4717,7 +4952,7 @@ bool ConfigCtl::validImShankMap( QString &err, DAQ::Params &q, int ip ) const
 
     QString msg;
 
-    if( !M.loadFile( msg, E.sns.shankMapFile ) ) {
+    if( !loadShankCached( msg, M, E.sns.shankMapFile ) ) {
 
         err = QString("ShankMap: %1.").arg( msg );
         return false;
@@ -4971,6 +5206,320 @@ bool ConfigCtl::validDiskAvail( QString &err, DAQ::Params &q ) const
 }
 
 
+// Estimated cores, bytes and bytes/s the run would need: each
+// stage's scans/s times benchmarked ns/scan, scaled by channels.
+// Acquisition counts queueing only; probe packet decode and NI
+// demux weren't benchmarked.
+//
+// Graphs are costed for the two heaviest streams, as in one
+// window with both panes showing.
+//
+// Fetch threading follows CimAcqImec: thdMode 0 = 3 probes per
+// thread, 1 = a thread per probe, 2 = a thread per slot. A mode
+// or core list is recommended if a fetch thread would be loaded
+// beyond 50%, or cores are free to dedicate to fetching.
+//
+// Each data directory's share of the write rate is checked
+// against its last DiskBench result, if any.
+//
+// Set over if CPU beyond 75% of cores, any fetch thread beyond
+// 80%, queues beyond 60% of RAM, or a directory's rate beyond
+// 80% of its sustained DiskBench rate.
+//
+QString ConfigCtl::budgetPlan( bool &over, const DAQ::Params &q ) const
+{
+    double  ns[bkN];
+    bool    measured = true;
+
+    for( int i = 0; i < bkN; ++i ) {
+
+        ns[i] = RunBench::result(
+                    QString("Kernels/%1_nsPerScan").arg( budgetKrnDef[i].name ),
+                    -1 );
+
+        if( ns[i] <= 0 ) {
+            ns[i]       = budgetKrnDef[i].ns;
+            measured    = false;
+        }
+
+        ns[i] *= 1e-9;
+    }
+
+    QVector<int>    vSecs;
+    QVector<double> vSpill;
+
+    mainApp()->getRun()->streamCapacity( vSecs, vSpill, q );
+
+    int     nCores      = qMax( 1, QThread::idealThreadCount() );
+    double  cpuAcq      = 0,
+            cpuFlt      = 0,
+            cpuSave     = 0,
+            cpuTrig     = 0,
+            cpuAcqPrb   = 0,
+            grf[2]      = {0, 0},
+            ramQ        = 0,
+            BPS         = 0,
+            trgRate     = 0;
+    QString trgStream   = q.trigStream();
+
+    BiquadBand  imB( q.im.all.fltLoHz, q.im.all.fltHiHz,
+                    q.im.all.fltNotchHz, q.im.all.fltNotchN ),
+                niB( q.ni.fltLoHz, q.ni.fltHiHz,
+                    q.ni.fltNotchHz, q.ni.fltNotchN );
+
+// ----------------
+// Stream by stream
+// ----------------
+
+    int np = (doingImec() ? q.im.get_nProbes() : 0);
+
+    for( int is = (doingNidq() ? -1 : 0); is < np; ++is ) {
+
+        double  srate;
+        int     nC, nNeu, nSave,
+                iq = (is < 0 ? vSecs.size() - 1 : is);
+        bool    flt;
+
+        if( is < 0 ) {
+            srate   = q.ni.srate;
+            nC      = q.ni.niCumTypCnt[CniCfg::niSumAll];
+            nNeu    = q.ni.niCumTypCnt[CniCfg::niSumNeural];
+            nSave   = q.ni.sns.saveBits.count( true );
+            flt     = !niB.isOff();
+
+            if( trgStream == "nidq" )
+                trgRate = srate;
+        }
+        else {
+
+            const CimCfg::AttrEach  &E = q.im.each[is];
+
+            srate   = E.srate;
+            nC      = E.imCumTypCnt[CimCfg::imSumAll];
+            nNeu    = E.imCumTypCnt[CimCfg::imSumAP];
+            nSave   = E.apSaveChanCount();
+            flt     = !imB.isOff();
+
+            if( E.lfIsSaving() ) {
+
+                int nLF = E.lfSaveChanCount();
+
+                cpuSave += srate/12 * nLF/385.0 * (ns[bkSub] + ns[bkSha]);
+                BPS     += nLF * srate/12 * 2;
+            }
+
+            if( trgStream == QString("imec%1").arg( is ) )
+                trgRate = srate;
+        }
+
+        double  k   = nC / 385.0,
+                a   = srate * k * ns[bkEnq],
+                g   = srate * (k * (ns[bkGet] + ns[bkDwn])
+                        + nNeu/385.0 * ns[bkFlt]);
+
+        cpuAcq += a;
+
+        if( is >= 0 )
+            cpuAcqPrb = qMax( cpuAcqPrb, a );
+
+        if( flt ) {
+            cpuFlt += srate * (k * (ns[bkGet] + ns[bkEnq])
+                        + nNeu/385.0 * ns[bkFlt]);
+            ramQ   += qMin( vSecs[iq], 10 ) * srate * nC * 2;
+        }
+
+        if( nSave ) {
+            cpuSave += srate * (k * (ns[bkGet] + ns[bkSub])
+                        + nSave/385.0 * ns[bkSha]);
+            BPS     += nSave * srate * 2;
+        }
+
+        if( g > grf[0] ) {
+            grf[1] = grf[0];
+            grf[0] = g;
+        }
+        else if( g > grf[1] )
+            grf[1] = g;
+
+        ramQ += srate * nC * 2
+                * (vSecs[iq] + 0.5 * q.strm.histSecs
+                    + 17.0/16.0 * vSpill[iq]);
+    }
+
+    if( q.mode.mTrig == DAQ::eTrigTTL || q.mode.mTrig == DAQ::eTrigSpike )
+        cpuTrig = trgRate * ns[bkEdge];
+
+// -------------
+// Fetch threads
+// -------------
+
+    int nPrbThd = 1,
+        nThd    = 0,
+        recMode = q.im.all.thdMode;
+
+    if( np ) {
+
+        if( q.im.all.thdMode == 0 ) {
+            nPrbThd = 3;
+            nThd    = (np + 2) / 3;
+        }
+        else if( q.im.all.thdMode == 1 )
+            nThd = np;
+        else {
+            nThd    = qMax( 1, prbTab.nLogSlots() );
+            nPrbThd = (np + nThd - 1) / nThd;
+        }
+
+        if( nPrbThd * cpuAcqPrb > 0.5 )
+            recMode = 1;
+    }
+
+// ------
+// Totals
+// ------
+
+    double  cpuGrf  = grf[0] + grf[1],
+            cpu     = cpuAcq + cpuFlt + cpuSave + cpuTrig + cpuGrf,
+            thdLoad = nPrbThd * cpuAcqPrb;
+
+#ifdef Q_OS_WIN64
+    double  ram = getRAMBytes64BitApp();
+#else
+    double  ram = getRAMBytes32BitApp();
+#endif
+
+// Per data directory vs DiskBench
+
+    DFDiskBench::Config dbC;
+    QString             diskS;
+    bool                diskOver = false;
+
+    dbC.fromParams( q );
+
+    for( int id = 0, nd = dbC.dirs.size(); id < nd; ++id ) {
+
+        double  need = 0, avg, mn;
+
+        for( int i = 0, nf = dbC.files.size(); i < nf; ++i ) {
+
+            if( dbC.files[i].idir == id )
+                need += dbC.files[i].Bps / (1024*1024);
+        }
+
+        if( !DFDiskBench::lookup( avg, mn, dbC.dirs[id] ) )
+            continue;
+
+        diskS += QString("  Disk [%1] %2 MB/s of %3 sustained, %4 worst 1 s\n")
+                    .arg( dbC.dirs[id] ).arg( need, 0, 'f', 1 )
+                    .arg( avg, 0, 'f', 1 ).arg( mn, 0, 'f', 1 );
+
+        if( need > 0.80 * avg ) {
+            diskS    += QString("  Over: [%1] beyond 80% of its DiskBench rate\n")
+                            .arg( dbC.dirs[id] );
+            diskOver = true;
+        }
+    }
+
+    over = cpu > 0.75 * nCores || thdLoad > 0.80 || ramQ > 0.60 * ram
+            || diskOver;
+
+// ----
+// Text
+// ----
+
+    QString s;
+
+    s  = QString("Budget (%1):\n")
+            .arg( measured ? "this machine's -microbench" : "default kernel costs" );
+    s += QString("  CPU acquire %1, filter %2, save %3, trigger %4, graphs %5\n")
+            .arg( cpuAcq, 0, 'f', 2 ).arg( cpuFlt, 0, 'f', 2 )
+            .arg( cpuSave, 0, 'f', 2 ).arg( cpuTrig, 0, 'f', 2 )
+            .arg( cpuGrf, 0, 'f', 2 );
+    s += QString("  CPU total %1 of %2 cores (%3%)\n")
+            .arg( cpu, 0, 'f', 2 ).arg( nCores )
+            .arg( 100 * cpu / nCores, 0, 'f', 0 );
+    s += QString("  RAM queues %1 GB of %2 GB (%3 s streams)\n")
+            .arg( ramQ / (1024.0*1024*1024), 0, 'f', 2 )
+            .arg( ram / (1024.0*1024*1024), 0, 'f', 1 )
+            .arg( vSecs.isEmpty() ? 0 : vSecs[0] );
+    s += QString("  Disk %1 MB/s").arg( BPS / (1024*1024), 0, 'f', 1 );
+
+    double  wr = RunBench::result( "Bench/wrMBpsAvg", 0 );
+
+    if( wr > 0 )
+        s += QString(" (last -bench wrote %1 MB/s)").arg( wr, 0, 'f', 1 );
+
+    s += "\n";
+    s += diskS;
+
+    if( np ) {
+
+        s += QString("  Fetch %1 thread(s), busiest %2%\n")
+                .arg( nThd ).arg( 100 * thdLoad, 0, 'f', 0 );
+
+        if( recMode != q.im.all.thdMode )
+            s += QString("  Recommend: fetch thread mode %1 (thread per probe)\n")
+                    .arg( recMode );
+
+        int nRec = (recMode == 1 ? np : nThd);
+
+        if( q.im.all.thdCores.isEmpty() && nCores >= nRec + 2 ) {
+            s += QString("  Recommend: fetch cores %1-%2 (leave core 0 to GUI/OS)\n")
+                    .arg( 1 ).arg( nRec );
+        }
+    }
+
+    if( cpu > 0.75 * nCores )
+        s += "  Over: CPU beyond 75% of cores\n";
+
+    if( thdLoad > 0.80 )
+        s += "  Over: a fetch thread beyond 80%\n";
+
+    if( ramQ > 0.60 * ram )
+        s += "  Over: stream queues beyond 60% of RAM\n";
+
+    return s;
+}
+
+
+// Log budget plan; if over, warn and let user choose to go on.
+// Remote configurations just log the warning.
+//
+bool ConfigCtl::validBudget(
+    QString         &err,
+    DAQ::Params     &q,
+    QWidget         *parent ) const
+{
+    Q_UNUSED( err )
+
+    bool    over;
+    QString plan = budgetPlan( over, q );
+
+    Log() << plan.trimmed();
+
+    if( !over )
+        return true;
+
+    if( !parent ) {
+        Warning() << "Configuration may exceed this machine's resources.";
+        return true;
+    }
+
+    int yesNo = QMessageBox::question(
+        parent,
+        "Configuration May Exceed This Machine",
+        QString(
+        "%1\n"
+        "Estimates may be off; FIFO overflow is the real limit.\n"
+        "Run (or Verify/Save) anyway?")
+        .arg( plan ),
+        QMessageBox::Yes | QMessageBox::No,
+        QMessageBox::No );
+
+    return yesNo == QMessageBox::Yes;
+}
+
+
 static bool runNameExists( const DAQ::Params &q )
 {
     if( q.mode.initG == -1 ) {
@@ -5219,6 +5768,100 @@ bool ConfigCtl::diskParamsToQ( QString &err, DAQ::Params &q ) const
 }
 
 
+struct ValidImCtx {
+    const ConfigCtl         *C;
+    DAQ::Params             *q;
+    std::vector<QString>    err;
+    std::vector<char>       ok;
+    int                     phase;
+};
+
+
+// Per-probe checks of valid() touch only q.im.each[ip] and
+// read-only tables, so probes are checked concurrently on the
+// shared BiquadPool (the GUI thread takes part and waits).
+// - phase 0: imro table, stdby bits.
+// - phase 1: shank map, chan map.
+// The lowest failing probe's error is reported, as if checked
+// in turn.
+//
+bool ConfigCtl::validImEach( QString &err, DAQ::Params &q, int phase ) const
+{
+    int np = q.im.get_nProbes();
+
+    if( !np )
+        return true;
+
+    ValidImCtx  X;
+    int         nJ = qMin( np, BiquadPool::pool().nWorkers() + 1 );
+
+    X.C     = this;
+    X.q     = &q;
+    X.phase = phase;
+    X.err.resize( np );
+    X.ok.assign( np, 1 );
+
+    if( nJ > 1 ) {
+
+        std::vector<BiquadJob>  jobs( nJ );
+        int                     remain = nJ;
+
+        for( int i = 0; i < nJ; ++i ) {
+
+            BiquadJob   &B = jobs[i];
+
+            B.fn        = validImJob;
+            B.ctx       = &X;
+            B.i0        = i * np / nJ;
+            B.iLim      = (i + 1) * np / nJ;
+            B.remain    = &remain;
+        }
+
+        BiquadPool::pool().runBatch( jobs );
+    }
+    else {
+
+        BiquadJob   B;
+
+        B.ctx   = &X;
+        B.i0    = 0;
+        B.iLim  = np;
+        validImJob( B );
+    }
+
+    for( int ip = 0; ip < np; ++ip ) {
+
+        if( !X.ok[ip] ) {
+            err = X.err[ip];
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+void ConfigCtl::validImJob( const BiquadJob &J )
+{
+    ValidImCtx  *X = (ValidImCtx*)J.ctx;
+
+    for( int ip = J.i0; ip < J.iLim; ++ip ) {
+
+        CimCfg::AttrEach    &E      = X->q->im.each[ip];
+        QString             &err    = X->err[ip];
+
+        if( X->phase == 0 ) {
+            X->ok[ip] = X->C->validImROTbl( err, E, ip )
+                        && X->C->validImStdbyBits( err, E );
+        }
+        else {
+            X->ok[ip] = X->C->validImShankMap( err, *X->q, ip )
+                        && X->C->validImChanMap( err, *X->q, ip );
+        }
+    }
+}
+
+
 bool ConfigCtl::valid( QString &err, QWidget *parent )
 {
     err.clear();
@@ -5247,16 +5890,8 @@ bool ConfigCtl::valid( QString &err, QWidget *parent )
     if( !validDevTab( err, q ) )
         return false;
 
-    for( int ip = 0; ip < np; ++ip ) {
-
-        CimCfg::AttrEach    &E = q.im.each[ip];
-
-        if( !validImROTbl( err, E, ip ) )
-            return false;
-
-        if( !validImStdbyBits( err, E ) )
-            return false;
-    }
+    if( !validImEach( err, q, 0 ) )
+        return false;
 
     if( !validNiDevices( err, q )
         || !validNiClock( err, q )
@@ -5299,14 +5934,8 @@ bool ConfigCtl::valid( QString &err, QWidget *parent )
     if( !validTrgLowTime( err, q ) )
         return false;
 
-    for( int ip = 0; ip < np; ++ip ) {
-
-        if( !validImShankMap( err, q, ip ) )
-            return false;
-
-        if( !validImChanMap( err, q, ip ) )
-            return false;
-    }
+    if( !validImEach( err, q, 1 ) )
+        return false;
 
     if( !validNiShankMap( err, q ) )
         return false;
@@ -5323,6 +5952,9 @@ bool ConfigCtl::valid( QString &err, QWidget *parent )
     if( !validRunName( err, q, q.sns.runName, parent ) )
         return false;
 
+    if( !validBudget( err, q, parent ) )
+        return false;
+
 // --------------------------
 // Warn about ColorTTL issues
 // --------------------------
@@ -29,6 +29,8 @@ class HelpButDialog;
 
 class QSharedMemory;
 
+struct BiquadJob;
+
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -169,6 +171,7 @@ private slots:
     void okButClicked();
 
 private:
+    void buildDialog();
     bool singletonReserve();
     void singletonRelease();
     void setNoDialogAccess( bool clearNi = true );
@@ -248,6 +251,8 @@ private:
     bool validNiChanMap( QString &err, DAQ::Params &q ) const;
     bool validDataDir( QString &err ) const;
     bool validDiskAvail( QString &err, DAQ::Params &q ) const;
+    QString budgetPlan( bool &over, const DAQ::Params &q ) const;
+    bool validBudget( QString &err, DAQ::Params &q, QWidget *parent ) const;
 
     bool validRunName(
         QString         &err,
@@ -257,6 +262,8 @@ private:
 
     bool shankParamsToQ( QString &err, DAQ::Params &q ) const;
     bool diskParamsToQ( QString &err, DAQ::Params &q ) const;
+    bool validImEach( QString &err, DAQ::Params &q, int phase ) const;
+    static void validImJob( const BiquadJob &J );
     bool valid( QString &err, QWidget *parent = 0 );
 };
 
@@ -44,6 +44,17 @@ void DOParams::deriveDOParams()
 {
 }
 
+/* ---------------------------------------------------------------- */
+/* StreamParams --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Return Util::StreamMemFlags for AIQ allocation.
+//
+int StreamParams::memFlags() const
+{
+    return (memLock ? smemLock : 0) | (memLargePages ? smemLarge : 0);
+}
+
 /* ---------------------------------------------------------------- */
 /* Params --------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -190,6 +201,9 @@ void Params::loadSettings( bool remote )
     trgTim.isNInf =
     settings.value( "trgTimIsNInf", false ).toBool();
 
+    trgTim.oneFile =
+    settings.value( "trgTimOneFile", false ).toBool();
+
 // ------------
 // TrgTTLParams
 // ------------
@@ -230,6 +244,12 @@ void Params::loadSettings( bool remote )
     trgTTL.isNInf =
     settings.value( "trgTTLIsNInf", true ).toBool();
 
+    trgTTL.lowLat =
+    settings.value( "trgTTLLowLatency", false ).toBool();
+
+    trgTTL.doLine =
+    settings.value( "trgTTLDOLine", "" ).toString();
+
 // --------------
 // TrgSpikeParams
 // --------------
@@ -249,6 +269,9 @@ void Params::loadSettings( bool remote )
     trgSpike.aiChan =
     settings.value( "trgSpikeAIChan", 4 ).toInt();
 
+    trgSpike.chans =
+    settings.value( "trgSpikeChans", "" ).toString();
+
     trgSpike.inarow =
     settings.value( "trgSpikeInarow", 5 ).toUInt();
 
@@ -258,6 +281,9 @@ void Params::loadSettings( bool remote )
     trgSpike.isNInf =
     settings.value( "trgSpikeIsNInf", false ).toBool();
 
+    trgSpike.merge =
+    settings.value( "trgSpikeMerge", false ).toBool();
+
 // ----------
 // ModeParams
 // ----------
@@ -280,6 +306,34 @@ void Params::loadSettings( bool remote )
     if( !mode.manOvShowBut )
         mode.manOvInitOff = false;
 
+// ------------
+// StreamParams
+// ------------
+
+    strm.memLock =
+    settings.value( "strmMemLock", false ).toBool();
+
+    strm.memLargePages =
+    settings.value( "strmMemLargePages", false ).toBool();
+
+    strm.memShared =
+    settings.value( "strmMemShared", false ).toBool();
+
+    strm.fltGpu =
+    settings.value( "strmFltGpu", false ).toBool();
+
+    strm.shankOrder =
+    settings.value( "strmShankOrder", false ).toBool();
+
+    strm.histSecs =
+    settings.value( "strmHistSecs", 0.0 ).toDouble();
+
+    strm.memBudgetGB =
+    settings.value( "strmMemBudgetGB", 0.0 ).toDouble();
+
+    strm.thdPlace =
+    settings.value( "strmThdPlace", QString() ).toString();
+
 // --------
 // SeeNSave
 // --------
@@ -299,6 +353,30 @@ void Params::loadSettings( bool remote )
     sns.fldPerPrb =
     settings.value( "snsFldPerProbe", true ).toBool();
 
+    sns.directIO =
+    settings.value( "snsDirectIO", false ).toBool();
+
+    sns.compress =
+    settings.value( "snsCompress", false ).toBool();
+
+    sns.imWrBlkMB =
+    settings.value( "snsImWrBlkMB", 8.0 ).toDouble();
+
+    sns.niWrBlkMB =
+    settings.value( "snsNiWrBlkMB", 1.0 ).toDouble();
+
+    sns.maxCloses =
+    settings.value( "snsMaxCloses", 2 ).toInt();
+
+    sns.par2MB =
+    settings.value( "snsPar2MB", 0.0 ).toDouble();
+
+    sns.wrShedLF =
+    settings.value( "snsWrShedLF", false ).toBool();
+
+    sns.niAlignChans =
+    settings.value( "snsNiAlignChans", "" ).toString();
+
     settings.endGroup();
 
 // ----
@@ -350,6 +428,7 @@ void Params::saveSettings( bool remote ) const
     settings.setValue( "trgTimNH", trgTim.nH );
     settings.setValue( "trgTimIsHInf", trgTim.isHInf );
     settings.setValue( "trgTimIsNInf", trgTim.isNInf );
+    settings.setValue( "trgTimOneFile", trgTim.oneFile );
 
 // ------------
 // TrgTTLParams
@@ -367,6 +446,8 @@ void Params::saveSettings( bool remote ) const
     settings.setValue( "trgTTLNH", trgTTL.nH );
     settings.setValue( "trgTTLIsAnalog", trgTTL.isAnalog );
     settings.setValue( "trgTTLIsNInf", trgTTL.isNInf );
+    settings.setValue( "trgTTLLowLatency", trgTTL.lowLat );
+    settings.setValue( "trgTTLDOLine", trgTTL.doLine );
 
 // --------------
 // TrgSpikeParams
@@ -377,9 +458,11 @@ void Params::saveSettings( bool remote ) const
     settings.setValue( "trgSpikeRefractS", trgSpike.refractSecs );
     settings.setValue( "trgSpikeStream", trgSpike.stream );
     settings.setValue( "trgSpikeAIChan", trgSpike.aiChan );
+    settings.setValue( "trgSpikeChans", trgSpike.chans );
     settings.setValue( "trgSpikeInarow", trgSpike.inarow );
     settings.setValue( "trgSpikeNS", trgSpike.nS );
     settings.setValue( "trgSpikeIsNInf", trgSpike.isNInf );
+    settings.setValue( "trgSpikeMerge", trgSpike.merge );
 
 // ----------
 // ModeParams
@@ -395,6 +478,19 @@ void Params::saveSettings( bool remote ) const
     else
         settings.setValue( "manOvInitOff", false );
 
+// ------------
+// StreamParams
+// ------------
+
+    settings.setValue( "strmMemLock", strm.memLock );
+    settings.setValue( "strmMemLargePages", strm.memLargePages );
+    settings.setValue( "strmMemShared", strm.memShared );
+    settings.setValue( "strmFltGpu", strm.fltGpu );
+    settings.setValue( "strmShankOrder", strm.shankOrder );
+    settings.setValue( "strmHistSecs", strm.histSecs );
+    settings.setValue( "strmMemBudgetGB", strm.memBudgetGB );
+    settings.setValue( "strmThdPlace", strm.thdPlace );
+
 // --------
 // SeeNSave
 // --------
@@ -404,6 +500,14 @@ void Params::saveSettings( bool remote ) const
     settings.setValue( "snsReqMins", sns.reqMins );
     settings.setValue( "snsPairChk", sns.pairChk );
     settings.setValue( "snsFldPerProbe", sns.fldPerPrb );
+    settings.setValue( "snsDirectIO", sns.directIO );
+    settings.setValue( "snsCompress", sns.compress );
+    settings.setValue( "snsImWrBlkMB", sns.imWrBlkMB );
+    settings.setValue( "snsNiWrBlkMB", sns.niWrBlkMB );
+    settings.setValue( "snsMaxCloses", sns.maxCloses );
+    settings.setValue( "snsPar2MB", sns.par2MB );
+    settings.setValue( "snsWrShedLF", sns.wrShedLF );
+    settings.setValue( "snsNiAlignChans", sns.niAlignChans );
 
     settings.endGroup();
 
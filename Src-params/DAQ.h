@@ -69,7 +69,8 @@ struct TrgTimParams {
                     tL;
     uint            nH;
     bool            isHInf,
-                    isNInf;
+                    isNInf,
+                    oneFile;    // all H of a gate in one file
 };
 
 struct TrgTTLParams {
@@ -77,25 +78,29 @@ struct TrgTTLParams {
                     marginSecs,
                     refractSecs,
                     tH;
-    QString         stream;
+    QString         stream,
+                    doLine;     // NI DO mirroring high; empty=off
     int             mode,
                     chan,
                     bit;
     uint            inarow,
                     nH;
     bool            isAnalog,
-                    isNInf;
+                    isNInf,
+                    lowLat;     // wake per enqueue, high priority
 };
 
 struct TrgSpikeParams {
     double          T,
                     periEvtSecs,
                     refractSecs;
-    QString         stream;
+    QString         stream,
+                    chans;      // range list; empty: just aiChan
     int             aiChan;
     uint            inarow,
                     nS;
-    bool            isNInf;
+    bool            isNInf,
+                    merge;      // overlapping windows in one file
 };
 
 struct ModeParams {
@@ -109,12 +114,33 @@ struct ModeParams {
     ModeParams() : initG(-1), initT(-1) {}
 };
 
+struct StreamParams {
+    QString         thdPlace;   // thread placement policy; see ThdPlace
+    double          histSecs,   // packed history beyond ring; 0=off
+                    memBudgetGB;// all streams' queues; 0=size by secs
+    bool            memLock,
+                    memLargePages,
+                    memShared,  // rings in named shared memory
+                    fltGpu,     // filter stages on GPU (OpenCL)
+                    shankOrder; // site-ordered companion stages
+
+    int memFlags() const;
+};
+
 struct SeeNSave {
     QString         notes,
-                    runName;
-    int             reqMins;
+                    runName,
+                    niAlignChans;   // nidq acq ids on probe clocks
+    double          imWrBlkMB,  // imec coalesced write size, 0=off
+                    niWrBlkMB,  // nidq coalesced write size, 0=off
+                    par2MB;     // PAR2 parity RAM per file, 0=off
+    int             reqMins,
+                    maxCloses;  // concurrent file closes
     bool            pairChk,
-                    fldPerPrb;
+                    fldPerPrb,
+                    directIO,   // unbuffered writes (bypass OS cache)
+                    wrShedLF,   // governor may stop LF if disk lags
+                    compress;   // lossless compressed bin files
 };
 
 struct Params {
@@ -126,6 +152,7 @@ struct Params {
     TrgTTLParams    trgTTL;
     TrgSpikeParams  trgSpike;
     ModeParams      mode;
+    StreamParams    strm;
     SeeNSave        sns;
 
     static int streamID( const QString &stream );
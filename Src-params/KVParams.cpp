@@ -2,66 +2,69 @@
 #include "KVParams.h"
 #include "Util.h"
 
+#include <QFile>
+#include <QHash>
+#include <QMutex>
 
 
 
-bool KVParams::parseOneLine( QString &line )
-{
-    line = line.trimmed();
 
-    if( !line.length() )
-        return true;
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
 
-/* ------------------------------------------ */
-/* Delete comments and ini-file group headers */
-/* ------------------------------------------ */
-
-// Semicolons are a popular comment character. However,
-// ChanMap strings might include them, so exception is
-// made for anything called 'map'.
+static QMutex               keyMtx;
+static QHash<QString,int>   keyPool;    // value unused
 
-    QRegExp comment("(\\[|;|#|//).*");
 
-    if( !line.contains( "notes", Qt::CaseInsensitive )
-        && !line.contains( "map", Qt::CaseInsensitive )
-        && line.contains( comment ) ) {
+// Return the shared copy of key, so the many maps built when
+// browsing a run folder (one per meta) share key storage.
+//
+static QString internKey( const QString &key )
+{
+    QMutexLocker                        ml( &keyMtx );
+    QHash<QString,int>::const_iterator  it = keyPool.find( key );
 
-        Debug() << "Params comment skipped: '" << comment.cap(0) << "'";
-        line.replace( comment, QString::null );
-        line = line.trimmed();
+    if( it != keyPool.end() )
+        return it.key();
 
-        if( !line.length() )
-            return true;
-    }
+    keyPool.insert( key, 0 );
+    return key;
+}
 
-/* -------------------------- */
-/* Capture (name)=(val) pairs */
-/* -------------------------- */
 
-    QRegExp re("([^=]+)=(.*)");
+static bool isWhite( QChar c )
+{
+    return c.unicode() <= ' ' && c.isSpace();
+}
 
-    if( re.exactMatch( line ) ) {
+/* ---------------------------------------------------------------- */
+/* KVParams ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
 
-        (*this)[re.cap(1).trimmed()] = re.cap(2).trimmed();
-        return true;
-    }
-    else {
-        Error() << "Bad params line [" << line << "].";
-        return false;
-    }
+bool KVParams::parseOneLine( QString &line )
+{
+    return parseRange( line, 0, line.size() );
 }
 
 
 bool KVParams::fromString( const QString &s )
 {
-    QTextStream ts( (QString*)&s, QIODevice::ReadOnly | QIODevice::Text );
-    QString     line;
-    bool        ok = true;
+    bool    ok = true;
+    int     n  = s.size();
 
     clear();
 
-    while( !(line = ts.readLine()).isNull() )
-        ok &= parseOneLine( line );
+    for( int i0 = 0; i0 < n; ) {
+
+        int iLim = s.indexOf( '\n', i0 );
+
+        if( iLim < 0 )
+            iLim = n;
+
+        ok &= parseRange( s, i0, iLim );
+        i0 = iLim + 1;
+    }
 
     return ok;
 }
@@ -79,18 +82,36 @@ QString KVParams::toString() const
 }
 
 
+// The whole file is decoded once, then split in place;
+// no per-line strings or regular expressions.
+//
 bool KVParams::fromMetaFile( const QString &metaFile )
 {
     QFile   f( metaFile );
 
-    if( f.open( QIODevice::ReadOnly | QIODevice::Text ) ) {
+    if( f.open( QIODevice::ReadOnly ) ) {
 
-        QTextStream ts( &f );
-        QString     s = ts.readAll();
+        qint64      n   = f.size();
+        const char  *m  = (n > 0 ? (const char*)f.map( 0, n ) : 0);
+        QByteArray  b;
+
+        if( !m && n > 0 ) {
+            f.unsetError();
+            b = f.readAll();
+            m = b.constData();
+            n = b.size();
+        }
+
+        if( f.error() == QFile::NoError ) {
 
-        if( ts.status() == QTextStream::Ok ) {
+            // Skip UTF-8 BOM
 
-            if( fromString( s ) )
+            if( n >= 3 && !memcmp( m, "\xEF\xBB\xBF", 3 ) ) {
+                m += 3;
+                n -= 3;
+            }
+
+            if( fromString( QString::fromLocal8Bit( m, n ) ) )
                 return true;
         }
         else {
@@ -147,3 +168,84 @@ bool KVParams::toMetaFile( const QString &metaFile ) const
 }
 
 
+// Parse line s[i0,iLim) exactly as the former regex rules:
+//
+// - Trim; empty is OK.
+// - Unless line mentions 'notes' or 'map' (ChanMap strings may
+//   contain semicolons), cut from first of '[', ';', '#', "//".
+// - Otherwise need (key)=(val), key nonempty; both trimmed.
+//
+bool KVParams::parseRange( const QString &s, int i0, int iLim )
+{
+    const QChar *c = s.constData();
+
+    while( i0 < iLim && isWhite( c[i0] ) )
+        ++i0;
+
+    while( iLim > i0 && isWhite( c[iLim - 1] ) )
+        --iLim;
+
+    if( i0 >= iLim )
+        return true;
+
+/* ------------------------------------------ */
+/* Delete comments and ini-file group headers */
+/* ------------------------------------------ */
+
+    QStringRef  line( &s, i0, iLim - i0 );
+
+    if( !line.contains( "notes", Qt::CaseInsensitive )
+        && !line.contains( "map", Qt::CaseInsensitive ) ) {
+
+        for( int i = i0; i < iLim; ++i ) {
+
+            ushort  u = c[i].unicode();
+
+            if( u == '[' || u == ';' || u == '#'
+                || (u == '/' && i + 1 < iLim && c[i + 1] == '/') ) {
+
+                Debug()
+                    << "Params comment skipped: '"
+                    << s.mid( i, iLim - i ) << "'";
+
+                iLim = i;
+
+                while( iLim > i0 && isWhite( c[iLim - 1] ) )
+                    --iLim;
+
+                if( i0 >= iLim )
+                    return true;
+
+                break;
+            }
+        }
+    }
+
+/* -------------------------- */
+/* Capture (name)=(val) pairs */
+/* -------------------------- */
+
+    int eq = i0;
+
+    while( eq < iLim && c[eq] != '=' )
+        ++eq;
+
+    if( eq == i0 || eq == iLim ) {
+        Error() << "Bad params line [" << s.mid( i0, iLim - i0 ) << "].";
+        return false;
+    }
+
+    int k1 = eq,
+        v0 = eq + 1;
+
+    while( k1 > i0 && isWhite( c[k1 - 1] ) )
+        --k1;
+
+    while( v0 < iLim && isWhite( c[v0] ) )
+        ++v0;
+
+    (*this)[internKey( s.mid( i0, k1 - i0 ) )] = s.mid( v0, iLim - v0 );
+    return true;
+}
+
+
@@ -31,6 +31,9 @@ public:
 
     bool fromMetaFile( const QString &metaFile );
     bool toMetaFile( const QString &metaFile ) const;
+
+private:
+    bool parseRange( const QString &s, int i0, int iLim );
 };
 
 #endif  // KVPARAMS_H
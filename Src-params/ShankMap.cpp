@@ -5,6 +5,8 @@
 
 #include <QFileInfo>
 
+#include <algorithm>
+
 
 /* ---------------------------------------------------------------- */
 /* ShankMapDesc --------------------------------------------------- */
@@ -366,6 +368,43 @@ void ShankMap::inverseMap( QMap<ShankMapDesc,uint> &inv ) const
 }
 
 
+struct SiteLess {
+    const std::vector<ShankMapDesc> &e;
+    SiteLess( const std::vector<ShankMapDesc> &e ) : e(e)   {}
+    bool operator()( int a, int b ) const
+        {
+            const ShankMapDesc  &A = e[a], &B = e[b];
+
+            if( A.s != B.s )
+                return A.s < B.s;
+
+            if( A.r != B.r )
+                return A.r < B.r;
+
+            return A.c < B.c;
+        }
+};
+
+
+// Channels [0,nChans) in site order (shank, row, col), so
+// spatial neighbors are near each other in a layout ordered
+// by it. Ties keep channel order; channels beyond the map
+// follow in their own order.
+//
+void ShankMap::depthOrder( std::vector<int> &ord, int nChans ) const
+{
+    int nE = qMin( nChans, int(e.size()) );
+
+    ord.resize( qMax( nChans, 0 ) );
+
+    for( int i = 0; i < nChans; ++i )
+        ord[i] = i;
+
+    if( nE > 1 )
+        std::stable_sort( ord.begin(), ord.begin() + nE, SiteLess( e ) );
+}
+
+
 bool ShankMap::equalHdr( const ShankMap &rhs ) const
 {
     return  ns == rhs.ns && nc == rhs.nc && nr == rhs.nr;
@@ -546,4 +585,91 @@ bool ShankMap::saveFile( QString &msg, const QString &path ) const
     }
 }
 
+/* ---------------------------------------------------------------- */
+/* ShankMapIndex -------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Like inverseMap(), a site shared by several used entries
+// maps to the last of them.
+//
+void ShankMapIndex::build( const ShankMap &SM )
+{
+    ns = SM.ns;
+    nc = SM.nc;
+    nr = SM.nr;
+
+    grid.assign( ns * nc * nr, -1 );
+    off.clear();
+    nbr.clear();
+
+    for( int i = 0, n = SM.e.size(); i < n; ++i ) {
+
+        const ShankMapDesc  &E = SM.e[i];
+
+        if( E.u && E.s < ns && E.c < nc && E.r < nr )
+            grid[(E.s*nc + E.c)*nr + E.r] = i;
+    }
+}
+
+
+// For each used channel [0,nChans) of SM (the map build() was
+// given), list the used channels whose sites lie within rOut
+// (col, row) steps on the same shank, but not within rIn. With
+// rIn = 0 that excludes just the channel's own site.
+//
+// This is the local CAR neighborhood of the graphs and viewer.
+//
+void ShankMapIndex::annuli( const ShankMap &SM, int nChans, int rIn, int rOut )
+{
+    off.assign( nChans + 1, 0 );
+    nbr.clear();
+
+    for( int ic = 0; ic < nChans; ++ic ) {
+
+        off[ic] = nbr.size();
+
+        if( ic >= int(SM.e.size()) || !SM.e[ic].u )
+            continue;
+
+        const ShankMapDesc  &E  = SM.e[ic];
+        int                 k0  = nbr.size(),
+                            xL  = qMax( int(E.c) - rOut, 0 ),
+                            xH  = qMin( int(E.c) + rOut + 1, int(nc) ),
+                            yL  = qMax( int(E.r) - rOut, 0 ),
+                            yH  = qMin( int(E.r) + rOut + 1, int(nr) );
+
+        if( E.s >= ns )
+            continue;
+
+        for( int ix = xL; ix < xH; ++ix ) {
+
+            const int   *G = &grid[(E.s*nc + ix)*nr];
+            bool        xIn = qAbs( ix - int(E.c) ) <= rIn;
+
+            for( int iy = yL; iy < yH; ++iy ) {
+
+                int i = G[iy];
+
+                if( i >= 0 && !(xIn && qAbs( iy - int(E.r) ) <= rIn) )
+                    nbr.push_back( i );
+            }
+        }
+
+        std::sort( nbr.begin() + k0, nbr.end() );
+    }
+
+    off[nChans] = nbr.size();
+}
+
+
+void ShankMapIndex::toVecs( std::vector<std::vector<int> > &V ) const
+{
+    int n = int(off.size()) - 1;
+
+    V.assign( qMax( n, 0 ), std::vector<int>() );
+
+    for( int i = 0; i < n; ++i )
+        V[i].assign( nbr.begin() + off[i], nbr.begin() + off[i+1] );
+}
+
 
@@ -6,6 +6,8 @@
 #include <QString>
 #include <QVector>
 
+#include <vector>
+
 struct IMROTbl;
 
 /* ---------------------------------------------------------------- */
@@ -59,6 +61,7 @@ struct ShankMap
     void revChanOrderFromMapIm( QString &s ) const;
     void revChanOrderFromMapNi( QString &s ) const;
     void inverseMap( QMap<ShankMapDesc,uint> &inv ) const;
+    void depthOrder( std::vector<int> &ord, int nChans ) const;
 
     int nSites() const  {return ns * nc * nr;}
     bool equalHdr( const ShankMap &rhs ) const;
@@ -79,6 +82,41 @@ struct ShankMap
     bool saveFile( QString &msg, const QString &path ) const;
 };
 
+
+// Spatial index over a ShankMap's used entries.
+//
+// A dense (shank, col, row) grid gives the channel at a site
+// in O(1), where inverseMap() costs a QMap lookup. Neighbor
+// lists are stored flat (CSR): channel i's neighbors are
+// nbr[off[i], off[i+1]), sorted.
+//
+struct ShankMapIndex
+{
+    std::vector<int>    grid,   // [(s*nc + c)*nr + r] -> chan, -1=none
+                        off,
+                        nbr;
+    uint                ns, nc, nr;
+
+    ShankMapIndex() : ns(0), nc(0), nr(0)   {}
+    ShankMapIndex( const ShankMap &SM )     {build( SM );}
+
+    void build( const ShankMap &SM );
+
+    int at( int s, int c, int r ) const
+        {return (s < 0 || c < 0 || r < 0
+                || uint(s) >= ns || uint(c) >= nc || uint(r) >= nr) ?
+                -1 : grid[(s*nc + c)*nr + r];}
+
+    void annuli( const ShankMap &SM, int nChans, int rIn, int rOut );
+
+    int nNbr( int i ) const
+        {return (i + 1 < int(off.size()) ? off[i+1] - off[i] : 0);}
+    const int *nbrs( int i ) const
+        {return &nbr[0] + off[i];}
+
+    void toVecs( std::vector<std::vector<int> > &V ) const;
+};
+
 #endif  // SHANKMAP_H
 
 
@@ -4,6 +4,16 @@
 #include <QStringList>
 #include <QTextStream>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SUB_SSE2
+#endif
+
+
+// Gathers switch from per-channel to per-run copies when
+// kept runs average at least this many channels.
+#define SUB_MINRUN  4
+
 
 /* ---------------------------------------------------------------- */
 /* bits2Vec ------------------------------------------------------- */
@@ -54,6 +64,40 @@ void Subset::vec2Bits( QBitArray &b, const QVector<uint> &v )
     }
 }
 
+/* ---------------------------------------------------------------- */
+/* bits2Runs ------------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+// Runs are (first, count) pairs of consecutive set bits,
+// in ascending order, for use with subsetRuns().
+//
+// Return count of set bits.
+//
+int Subset::bits2Runs( QVector<uint> &runs, const QBitArray &b )
+{
+    int nb  = b.size(),
+        nk  = 0;
+
+    runs.clear();
+
+    for( int i = 0; i < nb; ++i ) {
+
+        if( !b.testBit( i ) )
+            continue;
+
+        int i0 = i;
+
+        while( i + 1 < nb && b.testBit( i + 1 ) )
+            ++i;
+
+        runs.push_back( i0 );
+        runs.push_back( i - i0 + 1 );
+        nk += i - i0 + 1;
+    }
+
+    return nk;
+}
+
 /* ---------------------------------------------------------------- */
 /* canonVec ------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -346,6 +390,32 @@ bool Subset::rngStr2Vec( QVector<uint> &v, const QString &s )
 /* subset --------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
+// Split iKeep[] into (first, count) pairs of consecutive
+// indices, as bits2Runs() does for bits.
+//
+// Return run count.
+//
+static int keep2Runs( QVector<uint> &runs, const QVector<uint> &iKeep )
+{
+    int nk = iKeep.size();
+
+    runs.clear();
+
+    for( int ik = 0; ik < nk; ) {
+
+        int ik0 = ik;
+
+        while( ++ik < nk && iKeep[ik] == iKeep[ik-1] + 1 )
+            ;
+
+        runs.push_back( iKeep[ik0] );
+        runs.push_back( ik - ik0 );
+    }
+
+    return runs.size() / 2;
+}
+
+
 // Given (nchans) src channels per timepoint, create
 // dst vector keeping only listed indices (iKeep[]).
 //
@@ -374,20 +444,116 @@ void Subset::subset(
     if( &dst != &src )
         dst.resize( ntpts * nk );
 
-    const uint  *K = &iKeep[0];
-    qint16      *D = &dst[0],
-                *S = &src[0];
+    QVector<uint>   runs;
+    qint16          *D = &dst[0],
+                    *S = &src[0];
 
-    for( int it = 0; it < ntpts; ++it, S += nchans ) {
+    if( keep2Runs( runs, iKeep ) * SUB_MINRUN <= nk ) {
 
-        for( int ik = 0; ik < nk; ++ik )
-            *D++ = S[K[ik]];
+        // Runs move as blocks; memmove because in-place
+        // dst trails src within a timepoint.
+
+        const uint  *R  = &runs[0];
+        int         nr  = runs.size();
+
+        for( int it = 0; it < ntpts; ++it, S += nchans ) {
+
+            for( int ir = 0; ir < nr; ir += 2 ) {
+
+                int n = R[ir+1];
+
+                memmove( D, &S[R[ir]], n * sizeof(qint16) );
+                D += n;
+            }
+        }
+    }
+    else {
+
+        const uint  *K = &iKeep[0];
+
+        for( int it = 0; it < ntpts; ++it, S += nchans ) {
+
+            for( int ik = 0; ik < nk; ++ik )
+                *D++ = S[K[ik]];
+        }
     }
 
     if( &dst == &src )
         dst.resize( ntpts * nk );
 }
 
+// Raw-buffer flavor for gathering directly from
+// a read-only source, e.g., an AIQ::View span.
+//
+// Return pointer past last dst item written.
+//
+qint16* Subset::subset(
+    qint16              *dst,
+    const qint16        *src,
+    int                 ntpts,
+    const QVector<uint> &iKeep,
+    int                 nchans )
+{
+    QVector<uint>   runs;
+    const uint      *K  = &iKeep[0];
+    int             nk  = iKeep.size();
+
+    if( keep2Runs( runs, iKeep ) * SUB_MINRUN <= nk )
+        return subsetRuns( dst, src, ntpts, runs, nchans );
+
+    for( int it = 0; it < ntpts; ++it, src += nchans ) {
+
+        for( int ik = 0; ik < nk; ++ik )
+            *dst++ = src[K[ik]];
+    }
+
+    return dst;
+}
+
+// Gather flavor taking bits2Runs() runs; each run is one
+// memcpy, so channel blocks move at memory bandwidth.
+//
+// Return pointer past last dst item written.
+//
+qint16* Subset::subsetRuns(
+    qint16              *dst,
+    const qint16        *src,
+    int                 ntpts,
+    const QVector<uint> &runs,
+    int                 nchans )
+{
+    const uint  *R  = &runs[0];
+    int         nr  = runs.size();
+
+    if( nr == 2 ) {
+
+        int c0  = R[0],
+            nk  = R[1];
+
+        for( int it = 0; it < ntpts; ++it, src += nchans, dst += nk )
+            memcpy( dst, &src[c0], nk * sizeof(qint16) );
+
+        return dst;
+    }
+
+    for( int it = 0; it < ntpts; ++it, src += nchans ) {
+
+        for( int ir = 0; ir < nr; ir += 2 ) {
+
+            int nk = R[ir+1];
+
+            if( nk == 1 )
+                *dst++ = src[R[ir]];
+            else {
+                memcpy( dst, &src[R[ir]], nk * sizeof(qint16) );
+                dst += nk;
+            }
+        }
+    }
+
+    return dst;
+}
+
 /* ---------------------------------------------------------------- */
 /* subsetBlock ---------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -434,8 +600,36 @@ void Subset::subsetBlock(
 /* downsample ----------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
+// Add (n) int16 values of S to int32 sums A.
+//
+static void accum32( qint32 *A, const qint16 *S, int n )
+{
+    int i = 0;
+
+#ifdef SUB_SSE2
+    for( ; i + 8 <= n; i += 8 ) {
+
+        __m128i x   = _mm_loadu_si128( (const __m128i*)&S[i] ),
+                lo  = _mm_srai_epi32( _mm_unpacklo_epi16( x, x ), 16 ),
+                hi  = _mm_srai_epi32( _mm_unpackhi_epi16( x, x ), 16 );
+
+        _mm_storeu_si128( (__m128i*)&A[i],
+            _mm_add_epi32( _mm_loadu_si128( (__m128i*)&A[i] ), lo ) );
+        _mm_storeu_si128( (__m128i*)&A[i+4],
+            _mm_add_epi32( _mm_loadu_si128( (__m128i*)&A[i+4] ), hi ) );
+    }
+#endif
+
+    for( ; i < n; ++i )
+        A[i] += S[i];
+}
+
+
 // All src channels are downsampled/averaged.
 //
+// Bins up to 65536 samples sum exactly in int32; the quotient
+// truncates toward zero, as the double path did.
+//
 // In-place operation (dst == src) is allowed.
 //
 // Return count of resulting dst timepoints.
@@ -463,6 +657,30 @@ uint Subset::downsample(
 
     qint16              *D = &dst[0],
                         *S = &src[0];
+
+    if( dnsmp <= 65536 ) {
+
+        std::vector<qint32> sum( nchans );
+
+        for( int it = 0; it < ntpts; it += dnsmp, D += nchans ) {
+
+            int ns = std::min( ntpts - it, dnsmp );
+
+            memset( &sum[0], 0, nchans*sizeof(qint32) );
+
+            for( int is = 0; is < ns; ++is, S += nchans )
+                accum32( &sum[0], S, nchans );
+
+            for( int ic = 0; ic < nchans; ++ic )
+                D[ic] = qint16(sum[ic] / ns);
+        }
+
+        if( &dst == &src )
+            dst.resize( dtpts * nchans );
+
+        return dtpts;
+    }
+
     std::vector<double> sum( nchans );
 
     for( int it = 0; it < ntpts; it += dnsmp, D += nchans ) {
@@ -18,6 +18,7 @@ public:
 
     static void bits2Vec( QVector<uint> &v, const QBitArray &b );
     static void vec2Bits( QBitArray &b, const QVector<uint> &v );
+    static int bits2Runs( QVector<uint> &runs, const QBitArray &b );
     static void canonVec( QVector<uint> &vo, const QVector<uint> &vi );
 
     static void defaultBits( QBitArray &b, int nChans );
@@ -43,6 +44,20 @@ public:
         const QVector<uint> &iKeep,
         int                 nchans );
 
+    static qint16* subset(
+        qint16              *dst,
+        const qint16        *src,
+        int                 ntpts,
+        const QVector<uint> &iKeep,
+        int                 nchans );
+
+    static qint16* subsetRuns(
+        qint16              *dst,
+        const qint16        *src,
+        int                 ntpts,
+        const QVector<uint> &runs,
+        int                 nchans );
+
     static void subsetBlock(
         vec_i16             &dst,
         vec_i16             &src,
@@ -7,13 +7,31 @@
 #include "AOCtl.h"
 #include "AIQ.h"
 #include "Run.h"
+#include "ImTelemetry.h"
+#include "TrigTelemetry.h"
+#include "AOTelemetry.h"
+#include "MetricsWindow.h"
+#include "Scrubber.h"
+#include "SpecStream.h"
 #include "Sync.h"
 #include "Subset.h"
+#include "Decimator.h"
+#include "Biquad.h"
+#include "SpatialRef.h"
+#include "ShankMap.h"
 #include "Sha1Verifier.h"
 #include "Par2Window.h"
+#include "DFDirIndex.h"
+#include "DFDiskBench.h"
+#include "ErpStream.h"
+#include "ExportBatch.h"
+#include "GraphPub.h"
+#include "SpikeEvt.h"
+#include "ThdPlace.h"
+#include "Trace.h"
 
 #include <QDir>
-#include <QDirIterator>
+#include <QReadWriteLock>
 #include <QThread>
 
 
@@ -26,6 +44,157 @@ static bool     allstop = false;
 static void     stopAll()   {QMutexLocker ml(&kilMtx); allstop=true;}
 static bool     allStop()   {QMutexLocker ml(&kilMtx); return allstop;}
 
+// SUBSCRIBE and SPIKESTREAM sessions touch their AIQ only
+// under a read lock, and only while strRun is the value they
+// started with.
+static QReadWriteLock   strLock;
+static int              strRun  = 0;
+
+
+// Release a connection's own AIQ reader slot, unless its run
+// (and queue) is gone.
+//
+static void freeReader( const AIQ *aiQ, int rid, int run0 )
+{
+    strLock.lockForRead();
+
+        if( strRun == run0 )
+            aiQ->readerFree( rid );
+
+    strLock.unlock();
+}
+
+
+// FETCH options applied to the kept neural channels, which
+// lead each timepoint since iKeep is ascending: causal highpass
+// at loHz and lowpass at hiHz (S.hp, S.lp; 0 = off), then global
+// CAR on the kept AP (imec) or neural (nidq) channels, by the
+// viewer's SpatialRef (1 = mean, 2 = median) per shank. Filter
+// memory carries across consecutive fetches (see CmdFetchState),
+// so these join seamlessly without overlap; the first fetch of
+// a sequence has the usual BIQUAD_TRANS_WIDE scan transient.
+//
+static void fetchFilter(
+    vec_i16             &data,
+    CmdFetchState       &S,
+    int                 ip,
+    int                 car )
+{
+    const DAQ::Params   &p      = mainApp()->cfgCtl()->acceptedParams;
+    const QVector<uint> &iKeep  = S.iKeep;
+
+    const ShankMap  *SM;
+    int             nC      = iKeep.size(),
+                    ntpts   = data.size() / nC,
+                    nNu,
+                    nAP,
+                    maxInt,
+                    nKNu    = 0,
+                    nKAP    = 0;
+
+    if( ip >= 0 ) {
+        const CimCfg::AttrEach  &E = p.im.each[ip];
+        SM      = &E.sns.shankMap;
+        nNu     = E.imCumTypCnt[CimCfg::imSumNeural];
+        nAP     = E.imCumTypCnt[CimCfg::imSumAP];
+        maxInt  = E.roTbl->maxInt();
+    }
+    else {
+        SM      = &p.ni.sns.shankMap;
+        nNu     = p.ni.niCumTypCnt[CniCfg::niSumNeural];
+        nAP     = nNu;
+        maxInt  = 32768;
+    }
+
+    while( nKNu < nC && int(iKeep[nKNu]) < nNu )
+        ++nKNu;
+
+    while( nKAP < nKNu && int(iKeep[nKAP]) < nAP )
+        ++nKAP;
+
+    if( !nKNu || !ntpts )
+        return;
+
+    int nThd = getNProcessors();
+
+    if( S.hp )
+        S.hp->applyBlockwiseThd( &data[0], maxInt, ntpts, nC, 0, nKNu, nThd );
+
+    if( S.lp )
+        S.lp->applyBlockwiseThd( &data[0], maxInt, ntpts, nC, 0, nKNu, nThd );
+
+    if( car > 0 && nKAP && int(SM->e.size()) >= nAP ) {
+
+        // Map of the kept AP channels, indexed by offset
+
+        ShankMap    SMk( SM->ns, SM->nc, SM->nr );
+        SpatialRef  sr;
+
+        for( int k = 0; k < nKAP; ++k )
+            SMk.e.push_back( SM->e[iKeep[k]] );
+
+        sr.buildAll( SMk, nKAP, car > 1 );
+        sr.apply( &data[0], ntpts, nC, 1 );
+    }
+}
+
+/* ---------------------------------------------------------------- */
+/* CmdFetchState -------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+CmdFetchState::CmdFetchState(
+    const AIQ           *aiQ,
+    const QVector<uint> &iKeep,
+    quint64             fromCt,
+    double              loHz,
+    double              hiHz,
+    int                 dnsmp )
+    :   iKeep(iKeep), aiQ(aiQ), hp(0), lp(0), dec(0),
+        nextCt(fromCt), baseCt(fromCt), nOut(0),
+        loHz(loHz), hiHz(hiHz), dnsmp(dnsmp)
+{
+    double  srate = aiQ->sRate();
+
+    if( loHz > 0 )
+        hp = new Biquad( bq_type_highpass, loHz / srate );
+
+    if( hiHz > 0 )
+        lp = new Biquad( bq_type_lowpass, hiHz / srate );
+
+    if( dnsmp > 1 )
+        dec = new Decimator( dnsmp, iKeep.size() );
+}
+
+
+CmdFetchState::~CmdFetchState()
+{
+    if( dec )
+        delete dec;
+
+    if( lp )
+        delete lp;
+
+    if( hp )
+        delete hp;
+}
+
+
+bool CmdFetchState::continues(
+    const AIQ           *aiQ,
+    const QVector<uint> &iKeep,
+    quint64             fromCt,
+    double              loHz,
+    double              hiHz,
+    int                 dnsmp ) const
+{
+    return aiQ == this->aiQ
+            && fromCt == nextCt
+            && loHz == this->loHz
+            && hiHz == this->hiHz
+            && dnsmp == this->dnsmp
+            && iKeep == this->iKeep;
+}
+
 /* ---------------------------------------------------------------- */
 /* class CmdServer ------------------------------------------------ */
 /* ---------------------------------------------------------------- */
@@ -74,6 +243,16 @@ void CmdServer::deleteAllActiveConnections()
 }
 
 
+// Run calls this before deleting its queues; SUBSCRIBE and
+// SPIKESTREAM sessions then end without touching them again.
+//
+void CmdServer::stopStreams()
+{
+    QWriteLocker    wl( &strLock );
+    ++strRun;
+}
+
+
 // Create and start a self-destructing connection worker.
 //
 void CmdServer::incomingConnection( qintptr sockFd )
@@ -99,6 +278,14 @@ CmdWorker::~CmdWorker()
 {
     Debug() << "Del " << SU.tag() << SU.addr();
 
+    qDeleteAll( fetchSt );
+    fetchSt.clear();
+
+    QMap<const AIQ*,int>::const_iterator    it;
+
+    for( it = fetchRid.begin(); it != fetchRid.end(); ++it )
+        freeReader( it.key(), it.value(), fetchRun );
+
     if( par2 ) {
         delete par2;
         par2 = 0;
@@ -115,6 +302,8 @@ CmdWorker::~CmdWorker()
 
 void CmdWorker::run()
 {
+    ThdPlace::apply( ThdPlace::roleCmd );
+
 // -----------------------
 // Create/configure socket
 // -----------------------
@@ -125,6 +314,7 @@ void CmdWorker::run()
 
     SU.init( sock, timeout, "CmdWorker", &errMsg, true );
     SU.setLowLatency();
+    SU.setSendQueue( CMD_SNDQ_BYTES );
 
     Debug() << "New " << SU.tag() << SU.addr();
 
@@ -161,6 +351,9 @@ void CmdWorker::run()
 // Self cleanup
 // ------------
 
+    if( SU.sockValid() )
+        SU.flush();
+
     Debug() << "End " << SU.tag() << SU.addr();
 
     emit finished();
@@ -321,699 +514,2155 @@ void CmdWorker::getImProbeSN( QString &resp, int ip )
 }
 
 
-void CmdWorker::getImVoltageRange( QString &resp, int ip )
+void CmdWorker::getImTelemetry( QString &resp, int ip )
 {
-    ConfigCtl   *C = okCfgStreamID( "GETIMVOLTAGERANGE", ip );
-
-    if( !C )
+    if( ip < 0 ) {
+        errMsg = "GETIMTELEMETRY: Requires IM streamID >= 0.";
         return;
+    }
 
-    const DAQ::Params   &p = C->acceptedParams;
-
-    double  V = p.im.each[ip].roTbl->maxVolts();
+    if( !okCfgStreamID( "GETIMTELEMETRY", ip ) )
+        return;
 
-    resp = QString("%1 %2\n").arg( -V ).arg( V );
+    resp = ImTelemetry::remoteStr( ip );
 }
 
 
-void CmdWorker::getSampleRate( QString &resp, int ip )
+void CmdWorker::getTrigTelemetry( QString &resp )
 {
-    ConfigCtl   *C = okCfgStreamID( "GETSAMPLERATE", ip );
-
-    if( !C )
+    if( !okRunStarted( "GETTRIGTELEMETRY" ) )
         return;
 
-    const DAQ::Params   &p = C->acceptedParams;
+    if( mainApp()->cfgCtl()->acceptedParams.mode.mTrig != DAQ::eTrigTTL ) {
+        errMsg = "GETTRIGTELEMETRY: Requires TTL trigger mode.";
+        return;
+    }
 
-    resp = QString("%1\n")
-            .arg( ip >= 0 ? p.im.each[ip].srate : p.ni.srate, 0, 'f', 6 );
+    resp = TrigTelemetry::remoteStr();
 }
 
 
-void CmdWorker::getAcqChanCounts( QString &resp, int ip )
+void CmdWorker::getAudioTelemetry( QString &resp )
 {
-    ConfigCtl   *C = okCfgStreamID( "GETACQCHANCOUNTS", ip );
-
-    if( !C )
+    if( !okRunStarted( "GETAUDIOTELEMETRY" ) )
         return;
 
-    const DAQ::Params   &p = C->acceptedParams;
-
-    if( ip >= 0 ) {
+    if( !mainApp()->getAOCtl()->readyForScans() ) {
+        errMsg = "GETAUDIOTELEMETRY: Audio is not running.";
+        return;
+    }
 
-        const int   *type = p.im.each[ip].imCumTypCnt;
+    resp = AOTelemetry::remoteStr();
+}
 
-        int AP, LF, SY;
 
-        AP = type[CimCfg::imTypeAP];
-        LF = type[CimCfg::imTypeLF] - type[CimCfg::imTypeAP];
-        SY = type[CimCfg::imTypeSY] - type[CimCfg::imTypeLF];
+// Metrics history as CSV lines (header first), oldest first;
+// lastSecs > 0 limits to that span. Kept after the run ends.
+//
+void CmdWorker::getMetricsHist( QString &resp, const QStringList &toks )
+{
+    MetricsWindow   *W = mainApp()->metrics();
 
-        resp = QString("%1 %2 %3\n")
-                .arg( AP ).arg( LF ).arg( SY );
+    if( !W || !W->history().size() ) {
+        errMsg = "GETMETRICSHIST: No metrics history.";
+        return;
     }
-    else {
 
-        const int   *type = p.ni.niCumTypCnt;
+    resp = W->history().csv( toks.size() ? toks.front().toDouble() : 0 );
+}
 
-        int MN, MA, XA, XD;
 
-        MN = type[CniCfg::niTypeMN];
-        MA = type[CniCfg::niTypeMA] - type[CniCfg::niTypeMN];
-        XA = type[CniCfg::niTypeXA] - type[CniCfg::niTypeMA];
-        XD = type[CniCfg::niTypeXD] - type[CniCfg::niTypeXA];
+// Scrubber state and results; runs or not.
+//
+void CmdWorker::getScrubReport( QString &resp )
+{
+    Scrubber    *S = mainApp()->getScrubber();
 
-        resp = QString("%1 %2 %3 %4\n")
-                .arg( MN ).arg( MA ).arg( XA ).arg( XD );
+    if( !S ) {
+        errMsg = "GETSCRUBREPORT: Scrubber not available.";
+        return;
     }
+
+    resp = S->remoteStr();
 }
 
 
-void CmdWorker::getSaveChans( QString &resp, int ip )
+// Benchmark data directories with the accepted configuration's
+// write pattern; blocks for secs. Optional toks override:
+// secs, blkMB (0 = stream's own), sha1, direct.
+//
+void CmdWorker::getDiskBench( QString &resp, const QStringList &toks )
 {
-    ConfigCtl   *C = okCfgStreamID( "GETSAVECHANS", ip );
+    ConfigCtl   *C = okCfgValidated( "DISKBENCH" );
 
     if( !C )
         return;
 
-    if( ip >= 0 ) {
-        QMetaObject::invokeMethod(
-            C, "cmdSrvGetsSaveChansIm",
-            Qt::BlockingQueuedConnection,
-            Q_RETURN_ARG(QString, resp),
-            Q_ARG(uint, ip) );
-    }
-    else {
-        QMetaObject::invokeMethod(
-            C, "cmdSrvGetsSaveChansNi",
-            Qt::BlockingQueuedConnection,
-            Q_RETURN_ARG(QString, resp) );
+    if( mainApp()->getRun()->isRunning() ) {
+        errMsg = "DISKBENCH: Stop the run first.";
+        return;
     }
-}
 
+    DFDiskBench::Config             B;
+    QVector<DFDiskBench::Result>    vR;
+    QString                         err;
+    int                             nt = toks.size();
 
-void CmdWorker::isConsoleHidden( QString &resp )
-{
-    bool    b;
+    B.fromParams( C->acceptedParams );
 
-    QMetaObject::invokeMethod(
-        mainApp(),
-        "remoteGetsIsConsoleHidden",
-        Qt::BlockingQueuedConnection,
-        Q_RETURN_ARG(bool, b) );
+    if( nt > 0 )
+        B.secs = qBound( DFDB_RAMPSECS + 1.0, toks[0].toDouble(), 600.0 );
 
-    resp = QString("%1\n").arg( b );
+    if( nt > 1 )
+        B.setBlkBytes( int(qBound( 0.0, toks[1].toDouble(), 256.0 ) * 1024*1024) );
+
+    if( nt > 2 )
+        B.sha1 = toks[2].toInt();
+
+    if( nt > 3 )
+        B.direct = toks[3].toInt();
+
+    if( !DFDiskBench::run( vR, err, B ) ) {
+        errMsg = err;
+        return;
+    }
+
+    resp = DFDiskBench::remoteStr( B, vR );
 }
 
 
-// Expected tok params:
-// 0) dst stream
-// 1) src scan index
-// 2) src stream
+// Start a trial averaging stage; reply its id. Params:
+// evStreamID evChan evBit evThreshV inarow streamID chans
+// preSecs postSecs [binSecs [spkThresh_uV psthSecs refrac_ms
+// hipass]]. evBit < 0 selects analog edges through evThreshV.
+// A spike threshold (negative) adds PSTHs; chans must then be
+// neural.
 //
-void CmdWorker::mapSample( QString &resp, const QStringList &toks )
+void CmdWorker::erpStart( QString &resp, const QStringList &toks )
 {
-    if( toks.size() >= 3 ) {
+    int nt = toks.size();
 
-        MainApp             *app    = mainApp();
-        const DAQ::Params   &p      = app->cfgCtl()->acceptedParams;
+    if( nt < 9 ) {
+        errMsg = "ERPSTART: Requires at least 9 params.";
+        return;
+    }
 
-        quint64 srcC    = toks.at( 1 ).toLongLong();
-        int     dstip   = toks.at( 0 ).toInt(),
-                srcip   = toks.at( 2 ).toInt(),
-                np      = p.im.get_nProbes();
+    int         evIp    = toks.at( 0 ).toInt(),
+                ip      = toks.at( 5 ).toInt();
+    ConfigCtl   *C;
+    Run         *run;
 
-        if( dstip < -1 || dstip >= np ) {
-            errMsg =
-            QString("MAPSAMPLE: dstStream must be in range [-1..%1].")
-                .arg( np - 1 );
-            Warning() << errMsg;
-            return;
-        }
+    if( !okCfgStreamID( "ERPSTART", evIp )
+        || !(C = okCfgStreamID( "ERPSTART", ip ))
+        || !(run = okRunStarted( "ERPSTART" )) ) {
 
-        if( srcip < -1 || srcip >= np ) {
-            errMsg =
-            QString("MAPSAMPLE: srcStream must be in range [-1..%1].")
-                .arg( np - 1 );
-            Warning() << errMsg;
-            return;
-        }
+        return;
+    }
 
-        if( dstip == srcip ) {
-            resp = toks.at( 1 ).trimmed() + "\n";
-            return;
-        }
+    const DAQ::Params   &p = C->acceptedParams;
+    ErpParams           P;
+    double              srate,
+                        ysc;
+    int                 nChans,
+                        nNu,
+                        evChans;
 
-        Run *run = app->getRun();
+    if( ip >= 0 ) {
+        const CimCfg::AttrEach  &E = p.im.each[ip];
+        srate   = E.srate;
+        nChans  = E.imCumTypCnt[CimCfg::imSumAll];
+        nNu     = E.imCumTypCnt[CimCfg::imSumNeural];
+        ysc     = 1e6 * E.roTbl->maxVolts() / E.roTbl->maxInt();
+    }
+    else {
+        srate   = p.ni.srate;
+        nChans  = p.ni.niCumTypCnt[CniCfg::niSumAll];
+        nNu     = p.ni.niCumTypCnt[CniCfg::niSumNeural];
+        ysc     = 1e6 * p.ni.range.rmax / 32768;
+    }
 
-        const AIQ*  dstQ =
-        (dstip >= 0 ? run->getImQ( dstip ) : run->getNiQ());
+    P.maxInt = (ip >= 0 ? p.im.each[ip].roTbl->maxInt() : 32768);
 
-        if( !dstQ ) {
-            Warning() << (errMsg = "MAPSAMPLE: Dst stream not enabled.");
-            return;
-        }
+    evChans = (evIp >= 0 ?
+                p.im.each[evIp].imCumTypCnt[CimCfg::imSumAll] :
+                p.ni.niCumTypCnt[CniCfg::niSumAll]);
 
-        const AIQ*  srcQ =
-        (srcip >= 0 ? run->getImQ( srcip ) : run->getNiQ());
+// Event line
 
-        if( !srcQ ) {
-            Warning() << (errMsg = "MAPSAMPLE: Src stream not enabled.");
-            return;
-        }
+    double  evV = toks.at( 3 ).toDouble();
 
-        SyncStream  dstS, srcS;
-        dstS.init( dstQ, dstip, p );
-        srcS.init( srcQ, srcip, p );
-        syncDstTAbs( srcC, &srcS, &dstS, p );
+    P.evChan    = toks.at( 1 ).toInt();
+    P.evBit     = toks.at( 2 ).toInt();
+    P.evInarow  = qMax( 1, toks.at( 4 ).toInt() );
 
-        resp = QString("%1\n").arg( dstS.TAbs2Ct( dstS.tAbs ) );
+    if( P.evChan < 0 || P.evChan >= evChans || P.evBit > 15 ) {
+        errMsg = "ERPSTART: Invalid event line.";
+        return;
     }
-    else
-        Warning() << (errMsg = "MAPSAMPLE: Requires at least 3 params.");
-}
-
 
-void CmdWorker::setDataDir( const QString &path )
-{
-    QFileInfo   info( path );
-
-    if( info.isDir() && info.exists() ) {
-        mainApp()->remoteSetsDataDir( path );
-        Log() << "Remote client set data dir: " << path;
-    }
-    else {
-        errMsg =
-            QString("SETDATADIR: Not a directory or does not exist '%1'.")
-            .arg( path );
+    if( P.evBit < 0 ) {
+        P.evT = (evIp >= 0 ?
+                    p.im.each[evIp].vToInt( evV, P.evChan ) :
+                    p.ni.vToInt16( evV, P.evChan ));
     }
-}
 
+// Chans
 
-bool CmdWorker::enumDir( const QString &path )
-{
-    QDir    dir( path );
+    const QBitArray &allBits =
+                        (ip >= 0 ?
+                        p.im.each[ip].sns.saveBits :
+                        p.ni.sns.saveBits);
 
-    if( !dir.exists() ) {
-        errMsg = "ENUMDATADIR: Directory not found: " + path;
-        return false;
-    }
-    else {
+    QBitArray       chanBits;
+    QVector<uint>   vc;
 
-        QDirIterator    it( path );
-        QString         pth = path + "/";
+    QString err =
+        Subset::cmdStr2Bits(
+            chanBits, allBits, toks.at( 6 ), nChans );
 
-        while( it.hasNext() ) {
+    if( !err.isEmpty() ) {
+        errMsg = err;
+        return;
+    }
 
-            it.next();
+    Subset::bits2Vec( vc, chanBits );
 
-            QFileInfo   fi      = it.fileInfo();
-            QString     entry   = fi.fileName();
+    if( vc.isEmpty() ) {
+        errMsg = "ERPSTART: No channels.";
+        return;
+    }
 
-            if( fi.isDir() ) {
+    for( int i = 0, n = vc.size(); i < n; ++i ) {
 
-                if( entry == "." || entry == ".." )
-                    continue;
+        int ic = vc[i];
 
-                if( !enumDir( pth + entry ) )
-                    return false;
-            }
-            else if( !SU.send( QString("%1\n").arg( pth + entry ), true ) )
-                return false;
-        }
+        P.chans.push_back( ic );
+        P.uvPer.push_back(
+            ysc / (ip >= 0 ? p.im.each[ip].chanGain( ic ) : p.ni.chanGain( ic )) );
     }
 
-    return true;
-}
+// Window
 
+    P.preSecs   = toks.at( 7 ).toDouble();
+    P.postSecs  = toks.at( 8 ).toDouble();
 
-// Read one param line at a time from client,
-// append to str,
-// then set params en masse.
-//
-void CmdWorker::setParams()
-{
-    ConfigCtl   *C = okCfgValidated( "SETPARAMS" );
+    if( nt > 9 )
+        P.binSecs = toks.at( 9 ).toDouble();
 
-    if( !C )
+    if( P.preSecs < 0 || P.postSecs <= 0 || P.binSecs <= 0
+        || (P.preSecs + P.postSecs) / qMax( P.binSecs, 1.0 / srate ) > 100000 ) {
+
+        errMsg = "ERPSTART: Invalid window.";
         return;
+    }
 
-    if( SU.send( "READY\n", true ) ) {
+// PSTH
 
-        QString params, line;
+    if( nt > 10 ) {
 
-        while( !(line = SU.readLine()).isNull() ) {
+        double  uV = toks.at( 10 ).toDouble();
 
-            if( !line.length() )
-                break; // done on blank line
+        if( nt > 11 )
+            P.psthSecs = toks.at( 11 ).toDouble();
 
-            params += QString("%1\n").arg( line );
-        }
+        if( nt > 12 )
+            P.refracSecs = 0.001 * toks.at( 12 ).toDouble();
 
-        if( !params.isEmpty() ) {
+        if( nt > 13 )
+            P.spkBand = BiquadBand( toks.at( 13 ).toDouble() );
 
-            QMetaObject::invokeMethod(
-                C, "cmdSrvSetsParamStr",
-                Qt::BlockingQueuedConnection,
-                Q_RETURN_ARG(QString, errMsg),
-                Q_ARG(QString, params) );
+        if( uV >= 0 || P.psthSecs <= 0 || P.refracSecs < 0
+            || P.spkBand.loHz < 0 || P.spkBand.loHz >= 0.5 * srate
+            || int(vc.last()) >= nNu ) {
+
+            errMsg = "ERPSTART: Invalid PSTH parameter.";
+            return;
         }
-        else
-            errMsg = "SETPARAMS: Param string is empty.";
+
+        for( int i = 0, n = P.chans.size(); i < n; ++i ) {
+            P.spkT.push_back(
+                ip >= 0 ?
+                p.im.each[ip].vToInt( 1e-6 * uV, P.chans[i] ) :
+                p.ni.vToInt16( 1e-6 * uV, P.chans[i] ) );
+        }
+    }
+
+    int id = run->erpStart( err, evIp, ip, P );
+
+    if( id < 0 ) {
+        errMsg = QString("ERPSTART: %1").arg( err );
+        return;
     }
+
+    resp = QString("%1\n").arg( id );
 }
 
 
-// Read one param line at a time from client,
-// append to str,
-// then set params en masse.
+// Trial averages of stage id; a second param of 1 starts the
+// average over. Header "nEvt,nDrop,nCh,nBins,binSecs,preSecs,
+// nPsth,psthSecs", then a line of ERP means (uV) per chan, then
+// if nPsth, a line of PSTH rates (spikes/s) per chan.
 //
-void CmdWorker::SetAudioParams( const QString &group )
+void CmdWorker::getErp( QString &resp, const QStringList &toks )
 {
-    MainApp *app = okAppValidated( "SETAUDIOPARAMS" );
+    if( toks.isEmpty() ) {
+        errMsg = "GETERP: Requires param {id}.";
+        return;
+    }
 
-    if( !app )
+    Run *run = okRunStarted( "GETERP" );
+
+    if( !run )
         return;
 
-    if( SU.send( "READY\n", true ) ) {
+    ErpSnap S;
 
-        QString params, line;
+    if( !run->erpSnapshot( S, toks.at( 0 ).toInt(),
+            toks.size() > 1 && toks.at( 1 ).toInt() ) ) {
 
-        while( !(line = SU.readLine()).isNull() ) {
+        errMsg = "GETERP: No such trial average.";
+        return;
+    }
 
-            if( !line.length() )
-                break; // done on blank line
+    resp = QString("%1,%2,%3,%4,%5,%6,%7,%8\n")
+            .arg( S.nEvt ).arg( S.nDrop ).arg( S.nCh ).arg( S.nBins )
+            .arg( S.binSecs, 0, 'g', 8 ).arg( S.preSecs, 0, 'g', 8 )
+            .arg( S.nPsth ).arg( S.psthSecs, 0, 'g', 8 );
 
-            params += QString("%1\n").arg( line );
-        }
+    for( int ic = 0; ic < S.nCh; ++ic ) {
 
-        if( !params.isEmpty() ) {
+        const float *V = &S.erp[ic * S.nBins];
 
-            QMetaObject::invokeMethod(
-                app->getAOCtl(),
-                "cmdSrvSetsAOParamStr",
-                Qt::BlockingQueuedConnection,
-                Q_RETURN_ARG(QString, errMsg),
-                Q_ARG(QString, group),
-                Q_ARG(QString, params) );
-        }
-        else
-            errMsg = "SETAUDIOPARAMS: Param string is empty.";
+        for( int ib = 0; ib < S.nBins; ++ib )
+            resp += QString(ib ? ",%1" : "%1").arg( V[ib], 0, 'g', 5 );
+
+        resp += "\n";
+    }
+
+    for( int ic = 0; S.nPsth && ic < S.nCh; ++ic ) {
+
+        const float *V = &S.psth[ic * S.nPsth];
+
+        for( int ib = 0; ib < S.nPsth; ++ib )
+            resp += QString(ib ? ",%1" : "%1").arg( V[ib], 0, 'g', 5 );
+
+        resp += "\n";
     }
 }
 
 
-// Expected tok parameter is Boolean 0/1.
+void CmdWorker::erpStop( const QStringList &toks )
+{
+    if( toks.isEmpty() ) {
+        errMsg = "ERPSTOP: Requires param {id}.";
+        return;
+    }
+
+    Run *run = okRunStarted( "ERPSTOP" );
+
+    if( run && !run->erpStop( toks.at( 0 ).toInt() ) )
+        errMsg = "ERPSTOP: No such trial average.";
+}
+
+
+// Name of stream's shared-memory ring (AIQ::ShmHdr),
+// if daq.ini strmMemShared is set and it could be made.
 //
-void CmdWorker::setAudioEnable( const QStringList &toks )
+void CmdWorker::getStreamShm( QString &resp, int ip )
 {
-    MainApp *app = okAppValidated( "SETAUDIOENABLE" );
+    Run *run;
+
+    if( !okCfgStreamID( "GETSTREAMSHM", ip )
+        || !(run = okRunStarted( "GETSTREAMSHM" )) ) {
 
-    if( !app )
         return;
+    }
 
-    if( toks.size() > 0 ) {
+    strLock.lockForRead();
+        int run0 = strRun;
+    strLock.unlock();
 
-        bool    b = toks.front().toInt();
+    const AIQ   *aiQ = (ip >= 0 ? run->getImQ( ip ) : run->getNiQ());
+    QString     name;
 
-        QMetaObject::invokeMethod(
-            app->getRun(),
-            (b ? "aoStart" : "aoStop"),
-            Qt::QueuedConnection );
+    if( aiQ ) {
+
+        strLock.lockForRead();
+
+            if( strRun == run0 )
+                name = aiQ->shmName();
+
+        strLock.unlock();
     }
+
+    if( name.isEmpty() )
+        errMsg = "GETSTREAMSHM: Stream not in shared memory.";
     else
-        errMsg = "SETAUDIOENABLE: Requires parameter {0 or 1}.";
+        resp = QString("%1\n").arg( name );
 }
 
 
-// Expected tok parameter is Boolean 0/1.
+// Latest spectra of stream's neural channels (imec LF if
+// separate, else AP). First line: binHz,nBins,nChans,gen;
+// then one line per channel of nBins PSD values (uV^2/Hz).
+// Optional updtSecs sets the publish interval. The stage
+// runs only while polled, so the first call may just wake
+// it and ask for a retry.
 //
-void CmdWorker::setRecordingEnabled( const QStringList &toks )
+void CmdWorker::getSpectrum( QString &resp, const QStringList &toks )
 {
-    MainApp *app = okAppValidated( "SETRECORDENAB" );
+    if( toks.isEmpty() ) {
+        errMsg = "GETSPECTRUM: Requires streamID.";
+        return;
+    }
+
+    int ip = toks.front().toInt();
+    Run *run;
+
+    if( !okCfgStreamID( "GETSPECTRUM", ip )
+        || !(run = okRunStarted( "GETSPECTRUM" )) ) {
 
-    if( !app )
         return;
+    }
 
-    if( toks.size() > 0 ) {
+    SpecSnap    S;
 
-        bool    b = toks.front().toInt();
+    if( !run->specSnapshot( S, ip, toks.size() > 1 ? toks[1].toDouble() : 0 ) ) {
+        errMsg = "GETSPECTRUM: Spectra not ready; retry.";
+        return;
+    }
 
-        QMetaObject::invokeMethod(
-            app->getRun(),
-            "dfSetRecordingEnabled",
-            Qt::QueuedConnection,
-            Q_ARG(bool, b),
-            Q_ARG(bool, true) );
+    resp = QString("%1,%2,%3,%4\n")
+            .arg( S.binHz ).arg( S.nBins ).arg( S.nCh ).arg( S.gen );
+
+    for( int ic = 0; ic < S.nCh; ++ic ) {
+
+        const float *P = S.chan( ic );
+
+        for( int ib = 0; ib < S.nBins; ++ib )
+            resp += QString(ib ? ",%1" : "%1").arg( P[ib], 0, 'g', 5 );
+
+        resp += "\n";
     }
-    else
-        errMsg = "SETRECORDENAB: Requires parameter {0 or 1}.";
 }
 
 
-// Expected tok parameter is run name.
+// Power (uV^2) in [loHz,hiHz] per channel, of the latest
+// spectra (see getSpectrum).
 //
-void CmdWorker::setRunName( const QStringList &toks )
+void CmdWorker::getSpecBand( QString &resp, const QStringList &toks )
 {
-    MainApp *app = okAppValidated( "SETRUNNAME" );
+    if( toks.size() < 3 ) {
+        errMsg = "GETSPECBAND: Requires streamID, loHz, hiHz.";
+        return;
+    }
+
+    int ip = toks.front().toInt();
+    Run *run;
+
+    if( !okCfgStreamID( "GETSPECBAND", ip )
+        || !(run = okRunStarted( "GETSPECBAND" )) ) {
 
-    if( !app )
         return;
+    }
 
-    if( toks.size() > 0 ) {
+    SpecSnap    S;
 
-        QString s = toks.join(" ").trimmed();
+    if( !run->specSnapshot( S, ip ) ) {
+        errMsg = "GETSPECBAND: Spectra not ready; retry.";
+        return;
+    }
 
-        QMetaObject::invokeMethod(
-            app, "remoteSetsRunName",
-            Qt::BlockingQueuedConnection,
-            Q_RETURN_ARG(QString, errMsg),
-            Q_ARG(QString, s) );
+    double  lo = toks[1].toDouble(),
+            hi = toks[2].toDouble();
 
-        if( !errMsg.isEmpty() )
-            errMsg = "SETRUNNAME: " + errMsg;
+    for( int ic = 0; ic < S.nCh; ++ic )
+        resp += QString("%1\n").arg( S.bandPower( ic, lo, hi ), 0, 'g', 6 );
+}
+
+
+void CmdWorker::getImVoltageRange( QString &resp, int ip )
+{
+    ConfigCtl   *C = okCfgStreamID( "GETIMVOLTAGERANGE", ip );
+
+    if( !C )
+        return;
+
+    const DAQ::Params   &p = C->acceptedParams;
+
+    double  V = p.im.each[ip].roTbl->maxVolts();
+
+    resp = QString("%1 %2\n").arg( -V ).arg( V );
+}
+
+
+void CmdWorker::getSampleRate( QString &resp, int ip )
+{
+    ConfigCtl   *C = okCfgStreamID( "GETSAMPLERATE", ip );
+
+    if( !C )
+        return;
+
+    const DAQ::Params   &p = C->acceptedParams;
+
+    resp = QString("%1\n")
+            .arg( ip >= 0 ? p.im.each[ip].srate : p.ni.srate, 0, 'f', 6 );
+}
+
+
+// One reply for a dashboard poll, as name=value lines: run
+// state, then per enabled stream (prefix "ni", "im0", ...)
+// the answers to GETSAMPLERATE, GETACQCHANCOUNTS (comma-
+// separated), GETSAVECHANS, GETSCANCOUNT and GETFILESTART.
+//
+void CmdWorker::getStatus( QString &resp )
+{
+    ConfigCtl   *C = okCfgValidated( "GETSTATUS" );
+
+    if( !C )
+        return;
+
+    const DAQ::Params   &p      = C->acceptedParams;
+    Run                 *run    = mainApp()->getRun();
+    AOCtl               *aoC    = mainApp()->getAOCtl();
+    QVector<int>        vip;
+    bool                running = run->isRunning(),
+                        audio   = aoC->readyForScans();
+
+    if( p.ni.enabled )
+        vip.push_back( -1 );
+
+    if( p.im.enabled ) {
+
+        for( int ip = 0, np = p.im.get_nProbes(); ip < np; ++ip )
+            vip.push_back( ip );
+    }
+
+    resp  = QString("time=%1\n").arg( getTime(), 0, 'f', 3 );
+    resp += QString("running=%1\n").arg( running );
+    resp += QString("saving=%1\n").arg( run->dfIsSaving() );
+    resp += QString("audio=%1\n").arg( audio );
+    resp += QString("audioLatencyMs=%1\n")
+                .arg( audio ? aoC->latencyMs() : 0.0, 0, 'f', 1 );
+    resp += QString("nStreams=%1\n").arg( vip.size() );
+
+    foreach( int ip, vip ) {
+
+        QString pfx = (ip >= 0 ? QString("im%1").arg( ip ) : QString("ni")),
+                s;
+
+        getSampleRate( s, ip );
+        resp += QString("%1srate=%2").arg( pfx ).arg( s );
+
+        getAcqChanCounts( s, ip );
+        resp += QString("%1acqChanCounts=%2")
+                    .arg( pfx ).arg( s.replace( ' ', ',' ) );
+
+        getSaveChans( s, ip );
+        resp += QString("%1saveChans=%2\n").arg( pfx ).arg( s.trimmed() );
+
+        resp += QString("%1scanCount=%2\n")
+                    .arg( pfx ).arg( running ? run->getScanCount( ip ) : 0 );
+        resp += QString("%1fileStart=%2\n")
+                    .arg( pfx ).arg( running ? run->dfGetFileStart( ip ) : 0 );
     }
-    else
-        errMsg = "SETRUNNAME: Requires name parameter.";
 }
 
 
-void CmdWorker::setNextFileName( const QString &name )
+void CmdWorker::getAcqChanCounts( QString &resp, int ip )
 {
-    Run *run = okRunStarted( "SETNEXTFILENAME" );
+    ConfigCtl   *C = okCfgStreamID( "GETACQCHANCOUNTS", ip );
 
-    if( !run )
+    if( !C )
         return;
 
-    if( name.size() > 0 ) {
+    const DAQ::Params   &p = C->acceptedParams;
+
+    if( ip >= 0 ) {
+
+        const int   *type = p.im.each[ip].imCumTypCnt;
+
+        int AP, LF, SY;
+
+        AP = type[CimCfg::imTypeAP];
+        LF = type[CimCfg::imTypeLF] - type[CimCfg::imTypeAP];
+        SY = type[CimCfg::imTypeSY] - type[CimCfg::imTypeLF];
+
+        resp = QString("%1 %2 %3\n")
+                .arg( AP ).arg( LF ).arg( SY );
+    }
+    else {
+
+        const int   *type = p.ni.niCumTypCnt;
+
+        int MN, MA, XA, XD;
+
+        MN = type[CniCfg::niTypeMN];
+        MA = type[CniCfg::niTypeMA] - type[CniCfg::niTypeMN];
+        XA = type[CniCfg::niTypeXA] - type[CniCfg::niTypeMA];
+        XD = type[CniCfg::niTypeXD] - type[CniCfg::niTypeXA];
+
+        resp = QString("%1 %2 %3 %4\n")
+                .arg( MN ).arg( MA ).arg( XA ).arg( XD );
+    }
+}
+
+
+void CmdWorker::getSaveChans( QString &resp, int ip )
+{
+    ConfigCtl   *C = okCfgStreamID( "GETSAVECHANS", ip );
+
+    if( !C )
+        return;
 
+    if( ip >= 0 ) {
         QMetaObject::invokeMethod(
-            run, "dfSetNextFileName",
-            Qt::QueuedConnection,
-            Q_ARG(QString, name) );
+            C, "cmdSrvGetsSaveChansIm",
+            Qt::BlockingQueuedConnection,
+            Q_RETURN_ARG(QString, resp),
+            Q_ARG(uint, ip) );
+    }
+    else {
+        QMetaObject::invokeMethod(
+            C, "cmdSrvGetsSaveChansNi",
+            Qt::BlockingQueuedConnection,
+            Q_RETURN_ARG(QString, resp) );
     }
-    else
-        errMsg = "SETNEXTFILENAME: Requires path/name parameter.";
 }
 
 
-// Read one param line at a time from client,
-// append to KVParams,
-// then set meta data en masse.
-//
-void CmdWorker::setMetaData()
+void CmdWorker::isConsoleHidden( QString &resp )
 {
-    Run *run = okRunStarted( "SETMETADATA" );
+    bool    b;
+
+    QMetaObject::invokeMethod(
+        mainApp(),
+        "remoteGetsIsConsoleHidden",
+        Qt::BlockingQueuedConnection,
+        Q_RETURN_ARG(bool, b) );
+
+    resp = QString("%1\n").arg( b );
+}
+
+
+// Expected tok params:
+// 0) dst stream
+// 1) src scan index
+// 2) src stream
+//
+void CmdWorker::mapSample( QString &resp, const QStringList &toks )
+{
+    if( toks.size() >= 3 ) {
+
+        MainApp             *app    = mainApp();
+        const DAQ::Params   &p      = app->cfgCtl()->acceptedParams;
+
+        quint64 srcC    = toks.at( 1 ).toLongLong();
+        int     dstip   = toks.at( 0 ).toInt(),
+                srcip   = toks.at( 2 ).toInt(),
+                np      = p.im.get_nProbes();
+
+        if( dstip < -1 || dstip >= np ) {
+            errMsg =
+            QString("MAPSAMPLE: dstStream must be in range [-1..%1].")
+                .arg( np - 1 );
+            Warning() << errMsg;
+            return;
+        }
+
+        if( srcip < -1 || srcip >= np ) {
+            errMsg =
+            QString("MAPSAMPLE: srcStream must be in range [-1..%1].")
+                .arg( np - 1 );
+            Warning() << errMsg;
+            return;
+        }
+
+        if( dstip == srcip ) {
+            resp = toks.at( 1 ).trimmed() + "\n";
+            return;
+        }
+
+        Run *run = app->getRun();
+
+        const AIQ*  dstQ =
+        (dstip >= 0 ? run->getImQ( dstip ) : run->getNiQ());
+
+        if( !dstQ ) {
+            Warning() << (errMsg = "MAPSAMPLE: Dst stream not enabled.");
+            return;
+        }
+
+        const AIQ*  srcQ =
+        (srcip >= 0 ? run->getImQ( srcip ) : run->getNiQ());
+
+        if( !srcQ ) {
+            Warning() << (errMsg = "MAPSAMPLE: Src stream not enabled.");
+            return;
+        }
+
+        SyncStream  dstS, srcS;
+        dstS.init( dstQ, dstip, p );
+        srcS.init( srcQ, srcip, p );
+        syncDstTAbs( srcC, &srcS, &dstS, p );
+
+        resp = QString("%1\n").arg( dstS.TAbs2Ct( dstS.tAbs ) );
+    }
+    else
+        Warning() << (errMsg = "MAPSAMPLE: Requires at least 3 params.");
+}
+
+
+// Toks: {format, t0, t1, chans, filter, file}.
+// Format one of {bin, csv, zarr}; t1 < 0 is end of file;
+// chans "*" is all; filter 1 = zero-phase 300 Hz hipass.
+// Reply job id.
+//
+void CmdWorker::exportAdd( QString &resp, const QStringList &toks )
+{
+    if( toks.size() < 6 ) {
+        errMsg = "EXPORTADD: Requires params {fmt, t0, t1, chans, filter, file}.";
+        return;
+    }
+
+    ExportBatch::Spec   S;
+    QString             fmt = toks.at( 0 ).toLower();
+
+    if( fmt == "bin" )
+        S.fmt = 0;
+    else if( fmt == "csv" )
+        S.fmt = 1;
+    else if( fmt == "zarr" )
+        S.fmt = 2;
+    else {
+        errMsg = "EXPORTADD: Format must be one of {bin, csv, zarr}.";
+        return;
+    }
+
+    S.t0        = toks.at( 1 ).toDouble();
+    S.t1        = toks.at( 2 ).toDouble();
+    S.chans     = toks.at( 3 );
+    S.fltZP     = toks.at( 4 ).toInt();
+    S.binName   = toks.mid( 5 ).join( " " ).trimmed();
+
+    mainApp()->makePathAbsolute( S.binName );
+
+    QFileInfo   fi( S.binName );
+
+    if( fi.suffix() != "bin" || !fi.exists() ) {
+        errMsg =
+            QString("EXPORTADD: Bin file not found '%1'.").arg( S.binName );
+        return;
+    }
+
+    resp = QString("%1\n").arg( ExportBatch::add( S ) );
+}
+
+
+void CmdWorker::setDataDir( const QString &path )
+{
+    QFileInfo   info( path );
+
+    if( info.isDir() && info.exists() ) {
+        mainApp()->remoteSetsDataDir( path );
+        Log() << "Remote client set data dir: " << path;
+    }
+    else {
+        errMsg =
+            QString("SETDATADIR: Not a directory or does not exist '%1'.")
+            .arg( path );
+    }
+}
+
+
+bool CmdWorker::enumDir( const QString &path )
+{
+    QDir    dir( path );
+
+    if( !dir.exists() ) {
+        errMsg = "ENUMDATADIR: Directory not found: " + path;
+        return false;
+    }
+    else {
+
+        // Files from the shared index (also used by the viewers
+        // and validation), so repeat listings are cheap.
+
+        QStringList files = DFDirIndex::files( path ),
+                    subs  = dir.entryList( QDir::Dirs | QDir::NoDotAndDotDot );
+        QString     pth   = path + "/";
+
+        foreach( const QString &f, files ) {
+
+            if( !SU.send( QString("%1\n").arg( f ), true ) )
+                return false;
+        }
+
+        foreach( const QString &s, subs ) {
+
+            if( !enumDir( pth + s ) )
+                return false;
+        }
+    }
+
+    return true;
+}
+
+
+// Read one param line at a time from client,
+// append to str,
+// then set params en masse.
+//
+void CmdWorker::setParams()
+{
+    ConfigCtl   *C = okCfgValidated( "SETPARAMS" );
+
+    if( !C )
+        return;
+
+    if( SU.send( "READY\n", true ) ) {
+
+        QString params, line;
+
+        while( !(line = SU.readLine()).isNull() ) {
+
+            if( !line.length() )
+                break; // done on blank line
+
+            params += QString("%1\n").arg( line );
+        }
+
+        if( !params.isEmpty() ) {
+
+            QMetaObject::invokeMethod(
+                C, "cmdSrvSetsParamStr",
+                Qt::BlockingQueuedConnection,
+                Q_RETURN_ARG(QString, errMsg),
+                Q_ARG(QString, params) );
+        }
+        else
+            errMsg = "SETPARAMS: Param string is empty.";
+    }
+}
+
+
+// Read one param line at a time from client,
+// append to str,
+// then set params en masse.
+//
+void CmdWorker::SetAudioParams( const QString &group )
+{
+    MainApp *app = okAppValidated( "SETAUDIOPARAMS" );
+
+    if( !app )
+        return;
+
+    if( SU.send( "READY\n", true ) ) {
+
+        QString params, line;
+
+        while( !(line = SU.readLine()).isNull() ) {
+
+            if( !line.length() )
+                break; // done on blank line
+
+            params += QString("%1\n").arg( line );
+        }
+
+        if( !params.isEmpty() ) {
+
+            QMetaObject::invokeMethod(
+                app->getAOCtl(),
+                "cmdSrvSetsAOParamStr",
+                Qt::BlockingQueuedConnection,
+                Q_RETURN_ARG(QString, errMsg),
+                Q_ARG(QString, group),
+                Q_ARG(QString, params) );
+        }
+        else
+            errMsg = "SETAUDIOPARAMS: Param string is empty.";
+    }
+}
+
+
+// Expected tok parameter is Boolean 0/1.
+//
+void CmdWorker::setAudioEnable( const QStringList &toks )
+{
+    MainApp *app = okAppValidated( "SETAUDIOENABLE" );
+
+    if( !app )
+        return;
+
+    if( toks.size() > 0 ) {
+
+        bool    b = toks.front().toInt();
+
+        QMetaObject::invokeMethod(
+            app->getRun(),
+            (b ? "aoStart" : "aoStop"),
+            Qt::QueuedConnection );
+    }
+    else
+        errMsg = "SETAUDIOENABLE: Requires parameter {0 or 1}.";
+}
+
+
+// Expected tok parameter is Boolean 0/1.
+//
+void CmdWorker::setRecordingEnabled( const QStringList &toks )
+{
+    MainApp *app = okAppValidated( "SETRECORDENAB" );
+
+    if( !app )
+        return;
+
+    if( toks.size() > 0 ) {
+
+        bool    b = toks.front().toInt();
+
+        QMetaObject::invokeMethod(
+            app->getRun(),
+            "dfSetRecordingEnabled",
+            Qt::QueuedConnection,
+            Q_ARG(bool, b),
+            Q_ARG(bool, true) );
+    }
+    else
+        errMsg = "SETRECORDENAB: Requires parameter {0 or 1}.";
+}
+
+
+// Expected tok parameter is run name.
+//
+void CmdWorker::setRunName( const QStringList &toks )
+{
+    MainApp *app = okAppValidated( "SETRUNNAME" );
+
+    if( !app )
+        return;
+
+    if( toks.size() > 0 ) {
+
+        QString s = toks.join(" ").trimmed();
+
+        QMetaObject::invokeMethod(
+            app, "remoteSetsRunName",
+            Qt::BlockingQueuedConnection,
+            Q_RETURN_ARG(QString, errMsg),
+            Q_ARG(QString, s) );
+
+        if( !errMsg.isEmpty() )
+            errMsg = "SETRUNNAME: " + errMsg;
+    }
+    else
+        errMsg = "SETRUNNAME: Requires name parameter.";
+}
+
+
+void CmdWorker::setNextFileName( const QString &name )
+{
+    Run *run = okRunStarted( "SETNEXTFILENAME" );
+
+    if( !run )
+        return;
+
+    if( name.size() > 0 ) {
+
+        QMetaObject::invokeMethod(
+            run, "dfSetNextFileName",
+            Qt::QueuedConnection,
+            Q_ARG(QString, name) );
+    }
+    else
+        errMsg = "SETNEXTFILENAME: Requires path/name parameter.";
+}
+
+
+// Read one param line at a time from client,
+// append to KVParams,
+// then set meta data en masse.
+//
+void CmdWorker::setMetaData()
+{
+    Run *run = okRunStarted( "SETMETADATA" );
+
+    if( !run )
+        return;
+
+    if( SU.send( "READY\n", true ) ) {
+
+        KVParams    kvp;
+        QString     line;
+
+        while( !(line = SU.readLine()).isNull() ) {
+
+            if( !line.length() )
+                break; // done on blank line
+
+            kvp.parseOneLine( line );
+        }
+
+        if( kvp.size() ) {
+
+            QMetaObject::invokeMethod(
+                run, "rgtSetMetaData",
+                Qt::QueuedConnection,
+                Q_ARG(KeyValMap, kvp) );
+        }
+        else
+            errMsg = "SETMETADATA: Meta data empty.";
+    }
+}
+
+
+void CmdWorker::setTriggerOffBeep( const QStringList &toks )
+{
+    Run *run = okRunStarted( "SETTRIGGEROFFBEEP" );
+
+    if( !run )
+        return;
+
+    if( toks.size() >= 2 ) {
+
+        QMetaObject::invokeMethod(
+            run, "dfSetTriggerOffBeep",
+            Qt::QueuedConnection,
+            Q_ARG(quint32, toks.at( 0 ).toInt()),
+            Q_ARG(quint32, toks.at( 1 ).toInt()) );
+    }
+    else
+        errMsg = "SETTRIGGEROFFBEEP: Requires params {hertz, millisec}.";
+}
+
+
+void CmdWorker::setTriggerOnBeep( const QStringList &toks )
+{
+    Run *run = okRunStarted( "SETTRIGGERONBEEP" );
+
+    if( !run )
+        return;
+
+    if( toks.size() >= 2 ) {
+
+        QMetaObject::invokeMethod(
+            run, "dfSetTriggerOnBeep",
+            Qt::QueuedConnection,
+            Q_ARG(quint32, toks.at( 0 ).toInt()),
+            Q_ARG(quint32, toks.at( 1 ).toInt()) );
+    }
+    else
+        errMsg = "SETTRIGGERONBEEP: Requires params {hertz, millisec}.";
+}
+
+
+void CmdWorker::startRun()
+{
+    MainApp *app = okAppValidated( "STARTRUN" );
+
+    if( !app )
+        return;
+
+    QMetaObject::invokeMethod(
+        app, "remoteStartsRun",
+        Qt::BlockingQueuedConnection,
+        Q_RETURN_ARG(QString, errMsg) );
+}
+
+
+void CmdWorker::stopRun()
+{
+    QMetaObject::invokeMethod(
+        mainApp(), "remoteStopsRun",
+        Qt::QueuedConnection );
+}
+
+
+// Expected tok params:
+// 0) Boolean 0/1
+// 1) channel string
+//
+void CmdWorker::setDigOut( const QStringList &toks )
+{
+    if( toks.size() >= 2 ) {
+
+        QString devRem;
+        int     lineRem;
+        errMsg = CniCfg::parseDIStr( devRem, lineRem, toks.at( 1 ) );
+
+        if( !errMsg.isEmpty() ) {
+            errMsg = "SETDIGOUT: " + errMsg;
+            return;
+        }
+
+        MainApp *app = okAppValidated( "SETDIGOUT" );
+
+        if( !app )
+            return;
+
+        const DAQ::Params  &p = app->cfgCtl()->acceptedParams;
+
+        if( p.ni.startEnable ) {
+
+            QString devStart;
+            int     lineStart;
+            CniCfg::parseDIStr( devStart, lineStart, p.ni.startLine );
+
+            if( !devStart.compare( devRem, Qt::CaseInsensitive ) ) {
+                errMsg =
+                "SETDIGOUT: Cannot use start line for digital output.";
+                return;
+            }
+        }
+
+        // Direct call: setDO is thread-safe, and during a run
+        // just writes to an already started task.
+
+        errMsg = CniCfg::setDO( toks.at( 1 ), toks.at( 0 ).toInt() );
+
+        if( !errMsg.isEmpty() )
+            errMsg = "SETDIGOUT: " + errMsg.replace( "\n", " " );
+    }
+    else
+        errMsg = "SETDIGOUT: Requires at least 2 params.";
+}
+
+
+// Copy up to nMax whole scans of channels iKeep from fromCt,
+// viewing the queue ring in place, else reaching back into
+// packed history. Return false (errMsg set) if too late.
+//
+bool CmdWorker::readScans(
+    vec_i16             &data,
+    const AIQ           *aiQ,
+    quint64             fromCt,
+    int                 nMax,
+    const QVector<uint> &iKeep,
+    const QString       &cmd )
+{
+    AIQ::View   V;
+    int         nChans  = aiQ->nChans();
+    bool        inRing;
+
+    data.clear();
+
+    if( nMax <= 0 ) {
+        Warning() << (errMsg = QString("%1: Scan count must be > 0.").arg( cmd ));
+        return false;
+    }
+
+// -----------------------------------
+// View whole timepoints in queue ring
+// -----------------------------------
+
+    inRing = aiQ->getView( V, fromCt, nMax ) >= 0;
+
+    if( inRing && V.nScans() ) {
+
+        // ---------------------------------------
+        // Gather requested subset directly from V
+        // ---------------------------------------
+
+        try {
+            data.resize( V.nScans() * iKeep.size() );
+        }
+        catch( const std::exception& ) {
+            Warning() << (errMsg = QString("%1: Low mem.").arg( cmd ));
+            return false;
+        }
+
+        qint16  *D = &data[0];
+
+        for( int is = 0; is < 2; ++is ) {
+
+            if( !V.nspan[is] )
+                continue;
+
+            if( iKeep.size() < nChans ) {
+                D = Subset::subset(
+                        D, V.span[is], V.nspan[is],
+                        iKeep, nChans );
+            }
+            else {
+                memcpy( D, V.span[is],
+                    V.nspan[is] * nChans * sizeof(qint16) );
+                D += V.nspan[is] * nChans;
+            }
+        }
+
+        inRing = aiQ->isIntact( V );
+    }
+
+// -------------------------------------
+// Else reach back into packed history
+// -------------------------------------
+
+    if( !inRing ) {
+
+        data.clear();
+
+        if( aiQ->getHistScans( data, fromCt, nMax ) < 0 ) {
+            Warning() << (errMsg = QString("%1: Too late.").arg( cmd ));
+            return false;
+        }
+
+        if( iKeep.size() < nChans )
+            Subset::subset( data, data, iKeep, nChans );
+    }
+
+    return true;
+}
+
+
+// Each connection reports its own reader lag, so one client
+// keeping up can't mask another falling behind.
+//
+QString CmdWorker::readerName()
+{
+    return QString("remote %1").arg( SU.addr() );
+}
+
+
+// Return this connection's FETCH reader slot on aiQ,
+// registering it on first use this run.
+//
+int CmdWorker::fetchReader( const AIQ *aiQ )
+{
+    strLock.lockForRead();
+        int run = strRun;
+    strLock.unlock();
+
+    if( run != fetchRun ) {
+        fetchRid.clear();   // old queues are gone
+        fetchRun = run;
+    }
+
+    QMap<const AIQ*,int>::iterator  it = fetchRid.find( aiQ );
+
+    if( it != fetchRid.end() )
+        return it.value();
+
+    int rid = aiQ->readerId( readerName(), true );
+
+    fetchRid[aiQ] = rid;
+
+    return rid;
+}
+
+
+// Return stream ip's FETCH state if this fetch continues it,
+// else a fresh one replacing it.
+//
+CmdFetchState *CmdWorker::fetchState(
+    int                 ip,
+    const AIQ           *aiQ,
+    const QVector<uint> &iKeep,
+    quint64             fromCt,
+    double              loHz,
+    double              hiHz,
+    int                 dnsmp )
+{
+    CmdFetchState   *S = fetchSt.value( ip, 0 );
+
+    if( S && S->continues( aiQ, iKeep, fromCt, loHz, hiHz, dnsmp ) )
+        return S;
+
+    if( S )
+        delete S;
+
+    S = new CmdFetchState( aiQ, iKeep, fromCt, loHz, hiHz, dnsmp );
+    fetchSt[ip] = S;
+
+    return S;
+}
+
+
+// Expected tok params:
+// 0) streamID
+// 1) starting scan index
+// 2) scan count
+// 3) <channel subset pattern "id1#id2#...">
+// 4) <integer downsample factor>
+// 5) <downsample mode: 0=bin average, 1=anti-alias FIR>
+// 6) <highpass Hz, 0=off>
+// 7) <lowpass Hz, 0=off>
+// 8) <CAR: 0=off, 1=global mean, 2=global median>
+//
+// Filters and CAR precede downsampling; see fetchFilter().
+// Filter and FIR decimator memory persist per stream while each
+// fetch starts where the last ended (CmdFetchState). The FIR
+// decimator returns only outputs whose support has arrived, so
+// a reply can hold fewer scans than read, the rest following in
+// the next; its headCt is then the first output's bin start.
+//
+// Send( 'BINARY_DATA %d %d uint64(%ld) %.6f %.6f'\n",
+//          nChans, nScans, headCt, tEnq, tSend ).
+// Write binary data stream.
+//
+// tEnq is when the newest scan sent was enqueued, tSend when
+// the reply was begun, both app secs (as GETTIME).
+//
+void CmdWorker::fetch( const QStringList &toks )
+{
+    if( toks.size() >= 3 ) {
+
+        MainApp             *app    = mainApp();
+        const DAQ::Params   &p      = app->cfgCtl()->acceptedParams;
+
+        int ip = toks.at( 0 ).toInt();
+
+        if( ip >= 0 ) {
+
+            int np = p.im.get_nProbes();
+
+            if( ip >= np ) {
+                errMsg =
+                QString("FETCH: StreamID must be in range [-1..%1].")
+                .arg( np - 1 );
+                return;
+            }
+        }
+
+        const AIQ*  aiQ =
+                (ip >= 0 ?
+                app->getRun()->getImQ( ip ) :
+                app->getRun()->getNiQ());
+
+        if( !aiQ )
+            Warning() << (errMsg = "FETCH: Not running.");
+        else {
+
+            const QBitArray &allBits =
+                    (ip >= 0 ?
+                    p.im.each[ip].sns.saveBits :
+                    p.ni.sns.saveBits);
+
+            QBitArray   chanBits;
+            int         nChans  = aiQ->nChans();
+            uint        dnsmp   = 1;
+            double      loHz    = 0,
+                        hiHz    = 0;
+            int         car     = 0;
+            bool        dnFIR   = false;
+
+            // -----
+            // Chans
+            // -----
+
+            if( toks.size() >= 4 ) {
+
+                QString err =
+                    Subset::cmdStr2Bits(
+                        chanBits, allBits, toks.at( 3 ), nChans );
+
+                if( !err.isEmpty() ) {
+                    errMsg = err;
+                    Warning() << err;
+                    return;
+                }
+            }
+            else
+                chanBits = allBits;
+
+            // ----------
+            // Downsample
+            // ----------
+
+            if( toks.size() >= 5 )
+                dnsmp = qBound( 1, toks.at( 4 ).toInt(), 65535 );
+
+            if( toks.size() >= 6 )
+                dnFIR = toks.at( 5 ).toInt() > 0;
+
+            // ------
+            // Filter
+            // ------
+
+            if( toks.size() >= 7 )
+                loHz = toks.at( 6 ).toDouble();
+
+            if( toks.size() >= 8 )
+                hiHz = toks.at( 7 ).toDouble();
+
+            if( toks.size() >= 9 )
+                car = toks.at( 8 ).toInt();
+
+            if( loHz < 0 || hiHz < 0
+                || qMax( loHz, hiHz ) >= 0.5 * aiQ->sRate()
+                || (loHz > 0 && hiHz > 0 && loHz >= hiHz) ) {
+
+                Warning() << (errMsg = "FETCH: Invalid filter corners.");
+                return;
+            }
+
+            // ----
+            // Read
+            // ----
+
+            vec_i16         data;
+            QVector<uint>   iKeep;
+            quint64         fromCt  = toks.at( 1 ).toLongLong();
+            double          t0      = getTime(),
+                            tEnq;
+            int             nMax    = toks.at( 2 ).toInt(),
+                            size;
+
+            if( chanBits.count( true ) < nChans )
+                Subset::bits2Vec( iKeep, chanBits );
+            else
+                Subset::defaultVec( iKeep, nChans );
+
+            if( !readScans( data, aiQ, fromCt, nMax, iKeep, "FETCH" ) )
+                return;
+
+            if( data.size() ) {
+
+                quint64 endCt   = fromCt + data.size() / iKeep.size(),
+                        headCt  = fromCt;
+
+                aiQ->readerAt( fetchReader( aiQ ), endCt );
+
+                tEnq    = aiQ->enqTime( endCt - 1 );
+                nChans  = iKeep.size();
+
+                double  t1 = getTime();
+
+                tlm.add( CmdTelemetry::READ, t1 - t0 );
+
+                // ----------
+                // Filter/CAR
+                // ----------
+
+                CmdFetchState   *S = 0;
+
+                if( loHz > 0 || hiHz > 0 || car > 0 || dnFIR ) {
+
+                    S = fetchState( ip, aiQ, iKeep, fromCt,
+                            loHz, hiHz, (dnFIR ? dnsmp : 1) );
+                    S->nextCt = endCt;
+
+                    if( loHz > 0 || hiHz > 0 || car > 0 )
+                        fetchFilter( data, *S, ip, car );
+                }
+
+                // ----------
+                // Downsample
+                // ----------
+
+                if( dnsmp > 1 ) {
+
+                    if( S && S->dec ) {
+
+                        vec_i16 D;
+                        int     n = S->dec->apply(
+                                        D, &data[0], data.size() / nChans );
+
+                        headCt   = S->baseCt + S->nOut * dnsmp;
+                        S->nOut += n;
+                        data.swap( D );
+                    }
+                    else
+                        Subset::downsample( data, data, nChans, dnsmp );
+                }
+
+                // ----
+                // Send
+                // ----
+
+                double  t2 = getTime();
+
+                tlm.add( CmdTelemetry::PROC, t2 - t1 );
+
+                size = data.size();
+
+                SU.send(
+                    QString("BINARY_DATA %1 %2 uint64(%3) %4 %5\n")
+                    .arg( nChans )
+                    .arg( size / nChans )
+                    .arg( headCt )
+                    .arg( tEnq, 0, 'f', 6 )
+                    .arg( t2, 0, 'f', 6 ),
+                    true );
+
+                if( size )
+                    SU.sendBinary( &data[0], size*sizeof(qint16) );
+
+                double  t3 = getTime();
+
+                tlm.add( CmdTelemetry::SEND, t3 - t2 );
+                tlm.add( CmdTelemetry::LAT, t3 - tEnq );
+            }
+            else
+                Warning() << (errMsg = "FETCH: No data read from queue.");
+        }
+    }
+    else
+        Warning() << (errMsg = "FETCH: Requires at least 3 params.");
+}
+
+
+// Expected tok params:
+// 0) srcStreamID, whose counts give the window
+// 1) starting scan index
+// 2) scan count
+// 3) stream list "id1#id2#..." (srcStreamID always included)
+// 4) <integer downsample factor (bin average)>
+//
+// Every stream gets the same absolute time window, mapped from
+// the source through sync edges (Sync.cpp) as for MAPSAMPLE,
+// holding that stream's save-channel subset. All windows are
+// read back-to-back, then sent as one response:
+//
+// Send( 'BINARY_MULTI %d\n', nStreams ).
+// Per stream, write CmdMultiHdr, then binary data.
+//
+void CmdWorker::fetchMulti( const QStringList &toks )
+{
+    if( toks.size() < 4 ) {
+        Warning() << (errMsg = "FETCHMULTI: Requires at least 4 params.");
+        return;
+    }
+
+    ConfigCtl   *C = okCfgValidated( "FETCHMULTI" );
+    Run         *run;
+
+    if( !C || !(run = okRunStarted( "FETCHMULTI" )) )
+        return;
+
+    const DAQ::Params   &p = C->acceptedParams;
+
+    quint64 srcCt   = toks.at( 1 ).toLongLong();
+    int     srcN    = toks.at( 2 ).toInt(),
+            np      = p.im.get_nProbes(),
+            dnsmp   = 1;
+
+    if( toks.size() >= 5 )
+        dnsmp = qMax( 1, toks.at( 4 ).toInt() );
+
+// -------
+// Streams
+// -------
+
+    QStringList sl = toks.at( 3 ).split( "#", QString::SkipEmptyParts );
+    QVector<int>    vip;
+
+    sl.prepend( toks.at( 0 ) );
+
+    foreach( const QString &s, sl ) {
+
+        int ip = s.toInt();
+
+        if( ip < -1 || ip >= np ) {
+            errMsg =
+            QString("FETCHMULTI: StreamID must be in range [-1..%1].")
+                .arg( np - 1 );
+            Warning() << errMsg;
+            return;
+        }
+
+        if( !vip.contains( ip ) )
+            vip.push_back( ip );
+    }
+
+    int                     nS = vip.size();
+    std::vector<SyncStream> vS( nS );
+
+    for( int is = 0; is < nS; ++is ) {
+
+        int         ip  = vip[is];
+        const AIQ   *Q  = (ip >= 0 ? run->getImQ( ip ) : run->getNiQ());
+
+        if( !Q ) {
+            errMsg = QString("FETCHMULTI: Stream %1 not enabled.").arg( ip );
+            Warning() << errMsg;
+            return;
+        }
+
+        vS[is].init( Q, ip, p );
+    }
+
+// ---------------------------
+// Map window ends to each one
+// ---------------------------
+
+    std::vector<quint64>    ct0( nS ),
+                            ct1( nS );
+
+    for( int ie = 0; ie < 2; ++ie ) {
+
+        std::vector<quint64>    &ct = (ie ? ct1 : ct0);
+
+        syncDstTAbsMult( srcCt + (ie ? srcN : 0), 0, vS, p );
+
+        for( int is = 0; is < nS; ++is ) {
+
+            const SyncStream    &S = vS[is];
+
+            if( !is )
+                ct[is] = srcCt + (ie ? srcN : 0);
+            else if( S.tAbs > S.Q->tZero() )
+                ct[is] = S.TAbs2Ct( S.tAbs );
+            else
+                ct[is] = 0;
+        }
+    }
+
+// ----
+// Read
+// ----
+
+    std::vector<vec_i16>        vD( nS );
+    std::vector<CmdMultiHdr>    vH( nS );
+
+    for( int is = 0; is < nS; ++is ) {
+
+        const SyncStream    &S = vS[is];
+        const QBitArray     &bits =
+                                (S.ip >= 0 ?
+                                p.im.each[S.ip].sns.saveBits :
+                                p.ni.sns.saveBits);
+        QVector<uint>       iKeep;
+        int                 nChans  = S.Q->nChans(),
+                            n       = int(ct1[is] > ct0[is] ? ct1[is] - ct0[is] : 0);
+
+        if( bits.count( true ) < nChans )
+            Subset::bits2Vec( iKeep, bits );
+        else
+            Subset::defaultVec( iKeep, nChans );
+
+        if( n && !readScans( vD[is], S.Q, ct0[is], n, iKeep, "FETCHMULTI" ) )
+            return;
+
+        CmdMultiHdr &H = vH[is];
+
+        H.ip        = S.ip;
+        H.nChans    = iKeep.size();
+        H.headCt    = ct0[is];
+        H.bySync    = (is && S.bySync);
+    }
+
+// ----
+// Send
+// ----
+
+    SU.send( QString("BINARY_MULTI %1\n").arg( nS ), true );
+
+    for( int is = 0; is < nS; ++is ) {
+
+        vec_i16     &D = vD[is];
+        CmdMultiHdr &H = vH[is];
+
+        if( dnsmp > 1 && D.size() )
+            Subset::downsample( D, D, H.nChans, dnsmp );
+
+        H.nScans = D.size() / H.nChans;
+
+        if( !SU.sendBinary( &H, sizeof(H) ) )
+            return;
+
+        if( D.size() && !SU.sendBinary( &D[0], D.size() * sizeof(qint16) ) )
+            return;
+    }
+}
+
+
+// Expected tok params:
+// 0) streamID
+// 1) <headless: 1=suspend local graph drawing>
+//
+// Send OK, then push graph frames (GraphPubHdr, see GraphPub.h)
+// until the client closes or sends anything. The connection is
+// then closed.
+//
+void CmdWorker::graphStream( const QStringList &toks )
+{
+    if( toks.size() < 1 ) {
+        Warning() << (errMsg = "GRAPHSTREAM: Requires at least 1 param.");
+        return;
+    }
+
+    int ip = toks.at( 0 ).toInt();
+
+    if( !okCfgStreamID( "GRAPHSTREAM", ip ) || !okRunStarted( "GRAPHSTREAM" ) )
+        return;
+
+    GraphPubSub *S = GraphPub::subscribe(
+                        ip, toks.size() >= 2 && toks.at( 1 ).toInt() > 0 );
+
+    sendOK();
+
+    Log() << QString("Graph stream %1 opened %2.").arg( ip ).arg( SU.addr() );
+
+    while( !allStop() && SU.sockValid() ) {
+
+        QByteArray  F;
+
+        if( S->take( F, 100 )
+            && !SU.sendBinary( F.constData(), F.size() ) ) {
+
+            break;
+        }
+
+        if( sock->bytesAvailable() || sock->waitForReadyRead( 0 ) )
+            break;
+    }
+
+    Log() << QString("Graph stream %1 closed %2 (%3 frames dropped).")
+                .arg( ip ).arg( SU.addr() ).arg( S->dropped() );
+
+    GraphPub::unsubscribe( S );
+    SU.flush();
+    sock->close();
+}
+
+
+// Expected tok params:
+// 0) streamID
+// 1) <channel subset pattern "id1#id2#...">
+// 2) <integer downsample factor (bin average)>
+// 3) <starting scan index; default = current end>
+//
+// Send OK, then push each new block (CmdSubHdr, then data) as
+// it's enqueued, until the client closes or sends anything, or
+// the run stops. The connection is then closed.
+//
+// Frames hold whole downsample bins; a remainder waits for the
+// next block. A subscriber that falls off the ring resumes at
+// the oldest queued scan, which shows as a gap in fromCt.
+//
+void CmdWorker::subscribe( const QStringList &toks )
+{
+    if( toks.size() < 1 ) {
+        Warning() << (errMsg = "SUBSCRIBE: Requires at least 1 param.");
+        return;
+    }
+
+    int         ip  = toks.at( 0 ).toInt();
+    ConfigCtl   *C  = okCfgStreamID( "SUBSCRIBE", ip );
+    Run         *run;
+
+    if( !C || !(run = okRunStarted( "SUBSCRIBE" )) )
+        return;
+
+    // Take run0 before the queue: if Run stops in between,
+    // either getXxQ() returns 0 or strRun no longer matches.
+    // (Don't hold strLock over getXxQ(); stopRun holds runMtx.)
+
+    strLock.lockForRead();
+        int run0 = strRun;
+    strLock.unlock();
+
+    const AIQ   *aiQ = (ip >= 0 ? run->getImQ( ip ) : run->getNiQ());
+    quint64     fromCt;
+    double      srate;
+    int         nChans,
+                rid;
+    bool        live;
+
+    if( aiQ ) {
+
+        strLock.lockForRead();
+
+            if( (live = (strRun == run0)) ) {
+                nChans  = aiQ->nChans();
+                srate   = aiQ->sRate();
+                fromCt  = aiQ->endCount();
+            }
+
+        strLock.unlock();
+    }
+
+    if( !aiQ || !live ) {
+        Warning() << (errMsg = "SUBSCRIBE: Not running.");
+        return;
+    }
+
+// -----
+// Chans
+// -----
+
+    const DAQ::Params   &p = C->acceptedParams;
+    const QBitArray     &allBits =
+                            (ip >= 0 ?
+                            p.im.each[ip].sns.saveBits :
+                            p.ni.sns.saveBits);
+
+    QBitArray       chanBits;
+    QVector<uint>   iKeep;
+
+    if( toks.size() >= 2 ) {
+
+        QString err =
+            Subset::cmdStr2Bits(
+                chanBits, allBits, toks.at( 1 ), nChans );
+
+        if( !err.isEmpty() ) {
+            errMsg = err;
+            Warning() << err;
+            return;
+        }
+    }
+    else
+        chanBits = allBits;
+
+    if( chanBits.count( true ) < nChans )
+        Subset::bits2Vec( iKeep, chanBits );
+    else
+        Subset::defaultVec( iKeep, nChans );
+
+// ----------
+// Downsample
+// ----------
+
+    int dnsmp = 1;
+
+    if( toks.size() >= 3 )
+        dnsmp = qBound( 1, toks.at( 2 ).toInt(), 65535 );
+
+    int nMax = qMax( 1, int(CMD_SUB_MAXSECS * srate) / dnsmp ) * dnsmp;
+
+// ----
+// Push
+// ----
+
+    CmdSubHdr   H;
+    vec_i16     data;
+
+    if( toks.size() >= 4 )
+        fromCt = toks.at( 3 ).toLongLong();
+
+    H.magic     = CMD_SUB_MAGIC;
+    H.seq       = 0;
+    H.nChans    = iKeep.size();
+    H.dnsmp     = dnsmp;
+    H.tEnq      = 0;
+
+    strLock.lockForRead();
+        rid = (strRun == run0 ? aiQ->readerId( readerName(), true ) : -1);
+    strLock.unlock();
+
+    sendOK();
+
+    Log() << QString("Subscription %1 opened %2.").arg( ip ).arg( SU.addr() );
+
+    while( !allStop() && SU.sockValid() ) {
+
+        if( sock->bytesAvailable() || sock->waitForReadyRead( 0 ) )
+            break;
+
+        double  t0, t1;
+        bool    got = false;
 
-    if( !run )
-        return;
+        strLock.lockForRead();
 
-    if( SU.send( "READY\n", true ) ) {
+            if( (live = (strRun == run0))
+                && aiQ->waitForCt( fromCt + dnsmp, CMD_SUB_POLL_MS ) ) {
 
-        KVParams    kvp;
-        QString     line;
+                int n = int(qMin( quint64(nMax), aiQ->endCount() - fromCt ));
 
-        while( !(line = SU.readLine()).isNull() ) {
+                n -= n % dnsmp;
+                t0 = getTime();
 
-            if( !line.length() )
-                break; // done on blank line
+                if( (got = readScans( data, aiQ, fromCt, n, iKeep, "SUBSCRIBE" )) ) {
 
-            kvp.parseOneLine( line );
-        }
+                    n = data.size() / H.nChans;
+                    n -= n % dnsmp;
+                    data.resize( n * H.nChans );
 
-        if( kvp.size() ) {
+                    aiQ->readerAt( rid, fromCt + n );
 
-            QMetaObject::invokeMethod(
-                run, "rgtSetMetaData",
-                Qt::QueuedConnection,
-                Q_ARG(KeyValMap, kvp) );
-        }
-        else
-            errMsg = "SETMETADATA: Meta data empty.";
-    }
-}
+                    if( n )
+                        H.tEnq = aiQ->enqTime( fromCt + n - 1 );
+                }
+                else
+                    fromCt = qMax( fromCt, aiQ->qHeadCt() );
+            }
 
+        strLock.unlock();
 
-void CmdWorker::setTriggerOffBeep( const QStringList &toks )
-{
-    Run *run = okRunStarted( "SETTRIGGEROFFBEEP" );
+        if( !live )
+            break;
 
-    if( !run )
-        return;
+        if( !got || !data.size() )
+            continue;
 
-    if( toks.size() >= 2 ) {
+        t1          = getTime();
+        H.fromCt    = fromCt;
+        fromCt     += data.size() / H.nChans;
 
-        QMetaObject::invokeMethod(
-            run, "dfSetTriggerOffBeep",
-            Qt::QueuedConnection,
-            Q_ARG(quint32, toks.at( 0 ).toInt()),
-            Q_ARG(quint32, toks.at( 1 ).toInt()) );
-    }
-    else
-        errMsg = "SETTRIGGEROFFBEEP: Requires params {hertz, millisec}.";
-}
+        tlm.add( CmdTelemetry::READ, t1 - t0 );
 
+        if( dnsmp > 1 )
+            Subset::downsample( data, data, H.nChans, dnsmp );
 
-void CmdWorker::setTriggerOnBeep( const QStringList &toks )
-{
-    Run *run = okRunStarted( "SETTRIGGERONBEEP" );
+        H.nScans    = data.size() / H.nChans;
 
-    if( !run )
-        return;
+        double  t2 = getTime();
 
-    if( toks.size() >= 2 ) {
+        tlm.add( CmdTelemetry::PROC, t2 - t1 );
 
-        QMetaObject::invokeMethod(
-            run, "dfSetTriggerOnBeep",
-            Qt::QueuedConnection,
-            Q_ARG(quint32, toks.at( 0 ).toInt()),
-            Q_ARG(quint32, toks.at( 1 ).toInt()) );
-    }
-    else
-        errMsg = "SETTRIGGERONBEEP: Requires params {hertz, millisec}.";
-}
+        if( !SU.sendBinary( &H, sizeof(H) )
+            || !SU.sendBinary( &data[0], data.size() * sizeof(qint16) ) ) {
 
+            break;
+        }
 
-void CmdWorker::startRun()
-{
-    MainApp *app = okAppValidated( "STARTRUN" );
+        double  t3 = getTime();
 
-    if( !app )
-        return;
+        tlm.add( CmdTelemetry::SEND, t3 - t2 );
+        tlm.add( CmdTelemetry::LAT, t3 - H.tEnq );
 
-    QMetaObject::invokeMethod(
-        app, "remoteStartsRun",
-        Qt::BlockingQueuedConnection,
-        Q_RETURN_ARG(QString, errMsg) );
-}
+        ++H.seq;
+    }
 
+    freeReader( aiQ, rid, run0 );
 
-void CmdWorker::stopRun()
-{
-    QMetaObject::invokeMethod(
-        mainApp(), "remoteStopsRun",
-        Qt::QueuedConnection );
+    Log() << QString("Subscription %1 closed %2 (%3 frames): %4")
+                .arg( ip ).arg( SU.addr() ).arg( H.seq ).arg( tlm.logStr() );
+
+    SU.flush();
+    sock->close();
 }
 
 
 // Expected tok params:
-// 0) Boolean 0/1
-// 1) channel string
+// 0) streamID
+// 1) neural channel subset pattern "id1#id2#..."
+// 2) threshold uV (negative)
+// 3) <refractory ms; default 1>
+// 4) <highpass Hz; default 300; 0=off>
+// 5) <lowpass Hz; default 0=off>
+// 6) <snippet scans before crossing; default 0>
+// 7) <snippet scans from crossing; default 0>
 //
-void CmdWorker::setDigOut( const QStringList &toks )
+// Send OK, then push a frame (SpikeEvtHdr, records, snippets)
+// each time detection advances, until the client closes or
+// sends anything, or the run stops. The connection is then
+// closed. Detection starts at the current end of the stream.
+//
+void CmdWorker::spikeStream( const QStringList &toks )
 {
-    if( toks.size() >= 2 ) {
+    if( toks.size() < 3 ) {
+        Warning() << (errMsg = "SPIKESTREAM: Requires at least 3 params.");
+        return;
+    }
 
-        QString devRem;
-        int     lineRem;
-        errMsg = CniCfg::parseDIStr( devRem, lineRem, toks.at( 1 ) );
+    int         ip  = toks.at( 0 ).toInt();
+    ConfigCtl   *C  = okCfgStreamID( "SPIKESTREAM", ip );
+    Run         *run;
 
-        if( !errMsg.isEmpty() ) {
-            errMsg = "SETDIGOUT: " + errMsg;
-            return;
-        }
+    if( !C || !(run = okRunStarted( "SPIKESTREAM" )) )
+        return;
 
-        MainApp *app = okAppValidated( "SETDIGOUT" );
+    // As SUBSCRIBE: run0 before the queue.
 
-        if( !app )
-            return;
+    strLock.lockForRead();
+        int run0 = strRun;
+    strLock.unlock();
 
-        const DAQ::Params  &p = app->cfgCtl()->acceptedParams;
+    const AIQ   *aiQ = (ip >= 0 ? run->getImQ( ip ) : run->getNiQ());
+    quint64     fromCt;
+    double      srate;
+    int         nChans,
+                rid;
+    bool        live;
 
-        if( p.ni.startEnable ) {
+    if( aiQ ) {
 
-            QString devStart;
-            int     lineStart;
-            CniCfg::parseDIStr( devStart, lineStart, p.ni.startLine );
+        strLock.lockForRead();
 
-            if( !devStart.compare( devRem, Qt::CaseInsensitive ) ) {
-                errMsg =
-                "SETDIGOUT: Cannot use start line for digital output.";
-                return;
+            if( (live = (strRun == run0)) ) {
+                nChans  = aiQ->nChans();
+                srate   = aiQ->sRate();
+                fromCt  = aiQ->endCount();
             }
-        }
 
-        QMetaObject::invokeMethod(
-            app, "remoteSetsDigitalOut",
-            Qt::QueuedConnection,
-            Q_ARG(QString, toks.at( 1 )),
-            Q_ARG(bool, toks.at( 0 ).toInt()) );
+        strLock.unlock();
     }
-    else
-        errMsg = "SETDIGOUT: Requires at least 2 params.";
-}
 
+    if( !aiQ || !live ) {
+        Warning() << (errMsg = "SPIKESTREAM: Not running.");
+        return;
+    }
 
-// Expected tok params:
-// 0) streamID
-// 1) starting scan index
-// 2) scan count
-// 3) <channel subset pattern "id1#id2#...">
-// 4) <integer downsample factor>
-//
-// Send( 'BINARY_DATA %d %d uint64(%ld)'\n", nChans, nScans, headCt ).
-// Write binary data stream.
-//
-void CmdWorker::fetch( const QStringList &toks )
-{
-    if( toks.size() >= 3 ) {
+// -----
+// Chans
+// -----
 
-        MainApp             *app    = mainApp();
-        const DAQ::Params   &p      = app->cfgCtl()->acceptedParams;
+    const DAQ::Params   &p = C->acceptedParams;
+    const QBitArray     &allBits =
+                            (ip >= 0 ?
+                            p.im.each[ip].sns.saveBits :
+                            p.ni.sns.saveBits);
+
+    QBitArray       chanBits;
+    QVector<uint>   vc;
+    int             nNu,
+                    maxInt;
+
+    QString err =
+        Subset::cmdStr2Bits(
+            chanBits, allBits, toks.at( 1 ), nChans );
+
+    if( !err.isEmpty() ) {
+        errMsg = err;
+        Warning() << err;
+        return;
+    }
 
-        int ip = toks.at( 0 ).toInt();
+    Subset::bits2Vec( vc, chanBits );
 
-        if( ip >= 0 ) {
+    if( ip >= 0 ) {
+        const CimCfg::AttrEach  &E = p.im.each[ip];
+        nNu     = E.imCumTypCnt[CimCfg::imSumNeural];
+        maxInt  = E.roTbl->maxInt();
+    }
+    else {
+        nNu     = p.ni.niCumTypCnt[CniCfg::niSumNeural];
+        maxInt  = 32768;
+    }
 
-            int np = p.im.get_nProbes();
+    if( vc.isEmpty() || int(vc.last()) >= nNu ) {
+        Warning() <<
+            (errMsg = "SPIKESTREAM: Channels must be neural, at least one.");
+        return;
+    }
 
-            if( ip >= np ) {
-                errMsg =
-                QString("FETCH: StreamID must be in range [-1..%1].")
-                .arg( np - 1 );
-                return;
-            }
-        }
+// ------
+// Params
+// ------
 
-        const AIQ*  aiQ =
-                (ip >= 0 ?
-                app->getRun()->getImQ( ip ) :
-                app->getRun()->getNiQ());
+    std::vector<int>    chans( vc.begin(), vc.end() ),
+                        vT;
+    double              uV      = toks.at( 2 ).toDouble(),
+                        refms   = 1.0,
+                        loHz    = 300,
+                        hiHz    = 0;
+    int                 nPre    = 0,
+                        nPost   = 0;
 
-        if( !aiQ )
-            Warning() << (errMsg = "FETCH: Not running.");
-        else {
+    if( toks.size() >= 4 )
+        refms = toks.at( 3 ).toDouble();
 
-            const QBitArray &allBits =
-                    (ip >= 0 ?
-                    p.im.each[ip].sns.saveBits :
-                    p.ni.sns.saveBits);
+    if( toks.size() >= 5 )
+        loHz = toks.at( 4 ).toDouble();
 
-            QBitArray   chanBits;
-            int         nChans  = aiQ->nChans();
-            uint        dnsmp   = 1;
+    if( toks.size() >= 6 )
+        hiHz = toks.at( 5 ).toDouble();
 
-            // -----
-            // Chans
-            // -----
+    if( toks.size() >= 7 )
+        nPre = toks.at( 6 ).toInt();
 
-            if( toks.size() >= 4 ) {
+    if( toks.size() >= 8 )
+        nPost = toks.at( 7 ).toInt();
 
-                QString err =
-                    Subset::cmdStr2Bits(
-                        chanBits, allBits, toks.at( 3 ), nChans );
+    if( uV >= 0 || refms < 0
+        || loHz < 0 || hiHz < 0
+        || qMax( loHz, hiHz ) >= 0.5 * srate
+        || (loHz > 0 && hiHz > 0 && loHz >= hiHz)
+        || nPre < 0 || nPost < 0
+        || nPre + nPost > SPIKEEVT_MAXSNIP ) {
 
-                if( !err.isEmpty() ) {
-                    errMsg = err;
-                    Warning() << err;
-                    return;
-                }
-            }
-            else
-                chanBits = allBits;
+        Warning() << (errMsg = "SPIKESTREAM: Invalid parameter.");
+        return;
+    }
 
-            // ----------
-            // Downsample
-            // ----------
+    for( int i = 0, n = chans.size(); i < n; ++i ) {
 
-            if( toks.size() >= 5 )
-                dnsmp = toks.at( 4 ).toUInt();
+        vT.push_back(
+            ip >= 0 ?
+            p.im.each[ip].vToInt( 1e-6 * uV, chans[i] ) :
+            p.ni.vToInt16( 1e-6 * uV, chans[i] ) );
+    }
 
-            // ---------------------------------
-            // Fetch whole timepoints from queue
-            // ---------------------------------
+    SpikeEvtDetect  D(
+                        chans, vT, BiquadBand( loHz, hiHz ),
+                        srate, maxInt, 0.001 * refms, nPre, nPost );
 
-            vec_i16 data;
-            quint64 fromCt  = toks.at( 1 ).toLongLong();
-            int     nMax    = toks.at( 2 ).toInt(),
-                    size,
-                    ret;
+    D.reset( fromCt );
 
-            try {
-                data.reserve( nChans * nMax );
-            }
-            catch( const std::exception& ) {
-                Warning() << (errMsg = "FETCH: Low mem.");
-                return;
-            }
+// ----
+// Push
+// ----
 
-            ret = aiQ->getNScansFromCt( data, fromCt, nMax );
+    SpikeEvtHdr H;
+    quint64     nEvt    = 0;
+    int         nMax    = qMax( 1, int(CMD_SUB_MAXSECS * srate) );
 
-            if( ret < 0 ) {
-                Warning() << (errMsg = "FETCH: Too late.");
-                return;
-            }
+    H.magic     = SPIKEEVT_MAGIC;
+    H.seq       = 0;
+    H.doneCt    = D.doneCt();
+    H.nPre      = nPre;
+    H.nPost     = nPost;
+    H.tEnq      = 0;
 
-            if( ret == 0 ) {
-                Warning() << (errMsg = "FETCH: Low mem.");
-                return;
-            }
+    strLock.lockForRead();
+        rid = (strRun == run0 ? aiQ->readerId( readerName(), true ) : -1);
+    strLock.unlock();
 
-            size = data.size();
+    sendOK();
 
-            if( size ) {
+    Log() << QString("Spike stream %1 opened %2.").arg( ip ).arg( SU.addr() );
 
-                // ----------------
-                // Requested subset
-                // ----------------
+    while( !allStop() && SU.sockValid() ) {
 
-                if( chanBits.count( true ) < nChans ) {
+        if( sock->bytesAvailable() || sock->waitForReadyRead( 0 ) )
+            break;
 
-                    QVector<uint>   iKeep;
+        QByteArray  evts,
+                    snips;
+        double      t0, t1;
 
-                    Subset::bits2Vec( iKeep, chanBits );
-                    Subset::subset( data, data, iKeep, nChans );
-                    nChans = iKeep.size();
-                }
+        strLock.lockForRead();
 
-                // ----------
-                // Downsample
-                // ----------
+            if( (live = (strRun == run0))
+                && aiQ->waitForCt( D.readCt() + 1, CMD_SUB_POLL_MS ) ) {
 
-                if( dnsmp > 1 )
-                    Subset::downsample( data, data, nChans, dnsmp );
+                t0 = getTime();
+                D.process( evts, snips, aiQ, nMax );
+                aiQ->readerAt( rid, D.readCt() );
 
-                // ----
-                // Send
-                // ----
+                if( D.doneCt() != H.doneCt )
+                    H.tEnq = aiQ->enqTime( D.doneCt() - 1 );
+            }
 
-                size = data.size();
+        strLock.unlock();
 
-                SU.send(
-                    QString("BINARY_DATA %1 %2 uint64(%3)\n")
-                    .arg( nChans )
-                    .arg( size / nChans )
-                    .arg( fromCt ),
-                    true );
+        if( !live )
+            break;
 
-                SU.sendBinary( &data[0], size*sizeof(qint16) );
-            }
-            else
-                Warning() << (errMsg = "FETCH: No data read from queue.");
+        if( D.doneCt() == H.doneCt )
+            continue;
+
+        t1          = getTime();
+        H.doneCt    = D.doneCt();
+        H.nEvts     = evts.size() / sizeof(SpikeEvtRec);
+
+        tlm.add( CmdTelemetry::PROC, t1 - t0 );
+
+        if( !SU.sendBinary( &H, sizeof(H) )
+            || (evts.size() && !SU.sendBinary( evts.constData(), evts.size() ))
+            || (snips.size() && !SU.sendBinary( snips.constData(), snips.size() )) ) {
+
+            break;
         }
+
+        double  t2 = getTime();
+
+        tlm.add( CmdTelemetry::SEND, t2 - t1 );
+        tlm.add( CmdTelemetry::LAT, t2 - H.tEnq );
+
+        nEvt += H.nEvts;
+        ++H.seq;
     }
-    else
-        Warning() << (errMsg = "FETCH: Requires at least 3 params.");
+
+    freeReader( aiQ, rid, run0 );
+
+    Log() << QString("Spike stream %1 closed %2 (%3 events): %4")
+                .arg( ip ).arg( SU.addr() ).arg( nEvt ).arg( tlm.logStr() );
+
+    SU.flush();
+    sock->close();
 }
 
 
@@ -1162,6 +2811,61 @@ void CmdWorker::par2Start( QStringList toks )
 }
 
 
+// Toks: {id} or {all}.
+//
+void CmdWorker::exportCancel( const QStringList &toks )
+{
+    if( toks.isEmpty() ) {
+        errMsg = "EXPORTCANCEL: Requires param {id or all}.";
+        return;
+    }
+
+    int id = (toks.at( 0 ).toLower() == "all" ? -1 : toks.at( 0 ).toInt());
+
+    if( !ExportBatch::cancel( id ) )
+        errMsg = "EXPORTCANCEL: No such queued or running job.";
+}
+
+
+// One line per job: "id state percent name".
+//
+void CmdWorker::exportStatus()
+{
+    QStringList L = ExportBatch::status().split( "\n", QString::SkipEmptyParts );
+
+    foreach( const QString &s, L ) {
+
+        if( !SU.send( QString("%1\n").arg( s ), true ) )
+            return;
+    }
+}
+
+
+// Toks: {maxJobs, MBps}; MBps = 0 is unlimited.
+//
+void CmdWorker::setExportLimits( const QStringList &toks )
+{
+    if( toks.size() >= 2 )
+        ExportBatch::setLimits( toks.at( 0 ).toInt(), toks.at( 1 ).toDouble() );
+    else
+        errMsg = "SETEXPORTLIMITS: Requires params {maxJobs, MBps}.";
+}
+
+
+void CmdWorker::traceStop( const QString &file )
+{
+    if( file.isEmpty() ) {
+        errMsg = "TRACESTOP: Requires param {filename}.";
+        return;
+    }
+
+    QString err;
+
+    if( !Trace::stop( err, file ) )
+        errMsg = "TRACESTOP: " + err;
+}
+
+
 // Return true if cmd handled here.
 //
 bool CmdWorker::doQuery( const QString &cmd, const QStringList &toks )
@@ -1191,10 +2895,36 @@ bool CmdWorker::doQuery( const QString &cmd, const QStringList &toks )
         getImProbeCount( resp );
     else if( cmd == "GETIMPROBESN" )
         getImProbeSN( resp, STREAMID );
+    else if( cmd == "GETIMTELEMETRY" )
+        getImTelemetry( resp, STREAMID );
+    else if( cmd == "GETTRIGTELEMETRY" )
+        getTrigTelemetry( resp );
+    else if( cmd == "GETAUDIOTELEMETRY" )
+        getAudioTelemetry( resp );
+    else if( cmd == "GETMETRICSHIST" )
+        getMetricsHist( resp, toks );
+    else if( cmd == "GETSCRUBREPORT" )
+        getScrubReport( resp );
+    else if( cmd == "DISKBENCH" )
+        getDiskBench( resp, toks );
+    else if( cmd == "ERPSTART" )
+        erpStart( resp, toks );
+    else if( cmd == "GETERP" )
+        getErp( resp, toks );
     else if( cmd == "GETIMVOLTAGERANGE" )
         getImVoltageRange( resp, STREAMID );
     else if( cmd == "GETSAMPLERATE" )
         getSampleRate( resp, STREAMID );
+    else if( cmd == "GETSTREAMSHM" )
+        getStreamShm( resp, STREAMID );
+    else if( cmd == "GETSPECTRUM" )
+        getSpectrum( resp, toks );
+    else if( cmd == "GETSPECBAND" )
+        getSpecBand( resp, toks );
+    else if( cmd == "GETSTATUS" )
+        getStatus( resp );
+    else if( cmd == "GETCMDTELEMETRY" )
+        resp = tlm.remoteStr();
     else if( cmd == "GETACQCHANCOUNTS" )
         getAcqChanCounts( resp, STREAMID );
     else if( cmd == "GETSAVECHANS" )
@@ -1230,6 +2960,8 @@ bool CmdWorker::doQuery( const QString &cmd, const QStringList &toks )
         isConsoleHidden( resp );
     else if( cmd == "MAPSAMPLE" )
         mapSample( resp, toks );
+    else if( cmd == "EXPORTADD" )
+        exportAdd( resp, toks );
     else
         handled = false;
 
@@ -1267,8 +2999,18 @@ bool CmdWorker::doCommand( const QString &cmd, const QStringList &toks )
     }
     else if( cmd == "SETDATADIR" )
         setDataDir( toks.join( " " ).trimmed() );
-    else if( cmd == "ENUMDATADIR" )
-        enumDir( mainApp()->dataDir() );
+    else if( cmd == "ENUMDATADIR" ) {
+
+        // Striped runs: list every data dir, main first
+
+        QStringList roots = mainApp()->dataDirs();
+
+        for( int i = 0, n = roots.size(); i < n; ++i ) {
+
+            if( !enumDir( roots[i] ) )
+                break;
+        }
+    }
     else if( cmd == "SETPARAMS" )
         setParams();
     else if( cmd == "SETAUDIOPARAMS" )
@@ -1295,6 +3037,14 @@ bool CmdWorker::doCommand( const QString &cmd, const QStringList &toks )
         setDigOut( toks );
     else if( cmd == "FETCH" )
         fetch( toks );
+    else if( cmd == "FETCHMULTI" )
+        fetchMulti( toks );
+    else if( cmd == "GRAPHSTREAM" )
+        graphStream( toks );
+    else if( cmd == "SUBSCRIBE" )
+        subscribe( toks );
+    else if( cmd == "SPIKESTREAM" )
+        spikeStream( toks );
     else if( cmd == "CONSOLEHIDE" )
         consoleShow( false );
     else if( cmd == "CONSOLESHOW" )
@@ -1303,12 +3053,25 @@ bool CmdWorker::doCommand( const QString &cmd, const QStringList &toks )
         verifySha1( toks.join( " " ).trimmed() );
     else if( cmd == "PAR2" )
         par2Start( toks );
+    else if( cmd == "ERPSTOP" )
+        erpStop( toks );
+    else if( cmd == "EXPORTCANCEL" )
+        exportCancel( toks );
+    else if( cmd == "GETEXPORTSTATUS" )
+        exportStatus();
+    else if( cmd == "SETEXPORTLIMITS" )
+        setExportLimits( toks );
+    else if( cmd == "TRACESTART" )
+        Trace::start();
+    else if( cmd == "TRACESTOP" )
+        traceStop( toks.join( " " ).trimmed() );
     else if( cmd == "BYE"
             || cmd == "QUIT"
             || cmd == "EXIT"
             || cmd == "CLOSE" ) {
 
         Debug() << "Bye " << SU.tag() << SU.addr() << " [Closed by client.]";
+        SU.flush();
         sock->close();
     }
     else
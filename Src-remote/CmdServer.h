@@ -1,11 +1,18 @@
 #ifndef COMMANDSERVER_H
 #define COMMANDSERVER_H
 
+#include "SGLTypes.h"
 #include "SockUtil.h"
+#include "CmdTelemetry.h"
 
 #include <QTcpServer>
 #include <QStringList>
+#include <QVector>
+#include <QMap>
 
+class AIQ;
+class Biquad;
+class Decimator;
 class Par2Worker;
 class MainApp;
 class ConfigCtl;
@@ -20,6 +27,79 @@ class QTcpSocket;
 #define CMD_DEF_PORT    4142
 #define CMD_TOUT_MS     10000
 
+// Bytes a connection may leave queued before its sender waits.
+#define CMD_SNDQ_BYTES  (4*1024*1024)
+
+#define CMD_SUB_MAGIC   0x534C4753  // 'SGLS'
+
+// SUBSCRIBE: max seconds per frame, queue poll period.
+#define CMD_SUB_MAXSECS 0.1
+#define CMD_SUB_POLL_MS 100
+
+// FETCHMULTI per-stream header (24 bytes, little-endian),
+// followed by qint16 data[nScans][nChans].
+//
+struct CmdMultiHdr {
+    qint32  ip;     // -1=nidq, >=0 imec probe
+    quint32 nChans;
+    quint64 headCt; // stream count of first scan
+    quint32 nScans;
+    quint32 bySync; // 1=window mapped by sync edges
+};
+
+
+// SUBSCRIBE push frame header (32 bytes, little-endian),
+// followed by qint16 data[nScans][nChans].
+//
+// Consecutive frames satisfy next.fromCt = fromCt + nScans*dnsmp
+// unless the subscriber fell off the ring and was moved forward.
+//
+struct CmdSubHdr {
+    quint32 magic;  // CMD_SUB_MAGIC
+    quint32 seq;    // frame number from 0
+    quint64 fromCt; // stream count of first scan
+    quint16 nChans;
+    quint16 dnsmp;  // stream scans per output scan
+    quint32 nScans; // output scans following
+    double  tEnq;   // app secs newest scan enqueued
+};
+
+
+// FETCH filter and decimator memory for one stream on one
+// connection. A fetch continues it if it starts at nextCt with
+// the same channels and options; any other fetch starts anew.
+//
+struct CmdFetchState {
+    QVector<uint>   iKeep;
+    const AIQ       *aiQ;
+    Biquad          *hp,
+                    *lp;
+    Decimator       *dec;
+    quint64         nextCt,     // stream count expected next
+                    baseCt;     // stream count of dec's first scan
+    qint64          nOut;       // dec outputs so far
+    double          loHz,
+                    hiHz;
+    int             dnsmp;
+
+    CmdFetchState(
+        const AIQ           *aiQ,
+        const QVector<uint> &iKeep,
+        quint64             fromCt,
+        double              loHz,
+        double              hiHz,
+        int                 dnsmp );
+    virtual ~CmdFetchState();
+
+    bool continues(
+        const AIQ           *aiQ,
+        const QVector<uint> &iKeep,
+        quint64             fromCt,
+        double              loHz,
+        double              hiHz,
+        int                 dnsmp ) const;
+};
+
 
 class CmdServer : protected QTcpServer
 {
@@ -37,6 +117,7 @@ public:
         uint            timeout_ms = CMD_TOUT_MS );
 
     static void deleteAllActiveConnections();
+    static void stopStreams();
 
 protected:
     virtual void incomingConnection( qintptr sockFd );  // from QTcpServer
@@ -53,16 +134,20 @@ class CmdWorker : public QObject
     Q_OBJECT
 
 private:
-    QString     errMsg;
-    Par2Worker  *par2;
-    QTcpSocket  *sock;
-    SockUtil    SU;
-    qintptr     sockFd,     // socket 'file descriptor'
-                timeout;
+    QString                     errMsg;
+    CmdTelemetry                tlm;
+    QMap<int,CmdFetchState*>    fetchSt;    // by streamID
+    QMap<const AIQ*,int>        fetchRid;   // FETCH reader slots
+    int                         fetchRun;   // strRun of fetchRid
+    Par2Worker                  *par2;
+    QTcpSocket                  *sock;
+    SockUtil                    SU;
+    qintptr                     sockFd,     // socket 'file descriptor'
+                                timeout;
 
 public:
     CmdWorker( qintptr sockFd, int timeout )
-    :   QObject(0), par2(0),
+    :   QObject(0), fetchRun(-1), par2(0),
         sock(0), sockFd(sockFd),
         timeout(timeout)  {}
     virtual ~CmdWorker();
@@ -87,12 +172,26 @@ private:
     void getParams( QString &resp );
     void getImProbeCount( QString &resp );
     void getImProbeSN( QString &resp, int ip );
+    void getImTelemetry( QString &resp, int ip );
+    void getTrigTelemetry( QString &resp );
+    void getAudioTelemetry( QString &resp );
+    void getMetricsHist( QString &resp, const QStringList &toks );
+    void getScrubReport( QString &resp );
+    void getDiskBench( QString &resp, const QStringList &toks );
+    void erpStart( QString &resp, const QStringList &toks );
+    void getErp( QString &resp, const QStringList &toks );
+    void erpStop( const QStringList &toks );
     void getImVoltageRange( QString &resp, int ip );
     void getSampleRate( QString &resp, int ip );
+    void getStreamShm( QString &resp, int ip );
+    void getSpectrum( QString &resp, const QStringList &toks );
+    void getSpecBand( QString &resp, const QStringList &toks );
+    void getStatus( QString &resp );
     void getAcqChanCounts( QString &resp, int ip );
     void getSaveChans( QString &resp, int ip );
     void isConsoleHidden( QString &resp );
     void mapSample( QString &resp, const QStringList &toks );
+    void exportAdd( QString &resp, const QStringList &toks );
     void setDataDir( const QString &path );
     bool enumDir( const QString &path );
     void setParams();
@@ -107,10 +206,35 @@ private:
     void startRun();
     void stopRun();
     void setDigOut( const QStringList &toks );
+    bool readScans(
+        vec_i16             &data,
+        const AIQ           *aiQ,
+        quint64             fromCt,
+        int                 nMax,
+        const QVector<uint> &iKeep,
+        const QString       &cmd );
+    QString readerName();
+    int fetchReader( const AIQ *aiQ );
+    CmdFetchState *fetchState(
+        int                 ip,
+        const AIQ           *aiQ,
+        const QVector<uint> &iKeep,
+        quint64             fromCt,
+        double              loHz,
+        double              hiHz,
+        int                 dnsmp );
     void fetch( const QStringList &toks );
+    void fetchMulti( const QStringList &toks );
+    void graphStream( const QStringList &toks );
+    void subscribe( const QStringList &toks );
+    void spikeStream( const QStringList &toks );
     void consoleShow( bool show );
     void verifySha1( QString file );
     void par2Start( QStringList toks );
+    void exportCancel( const QStringList &toks );
+    void exportStatus();
+    void setExportLimits( const QStringList &toks );
+    void traceStop( const QString &file );
     bool doQuery( const QString &cmd, const QStringList &toks );
     bool doCommand( const QString &cmd, const QStringList &toks );
     bool processLine( const QString &line );
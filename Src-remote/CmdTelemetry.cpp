@@ -0,0 +1,100 @@
+
+#include "CmdTelemetry.h"
+#include "Util.h"
+
+#include <string.h>
+
+
+#define TLM_BASE    16e-6
+
+/* ---------------------------------------------------------------- */
+/* CmdTelemetry --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+const char *CmdTelemetry::stageName( int st )
+{
+    static const char *name[NSTAGE] = {"read", "proc", "send", "lat"};
+
+    return (st >= 0 && st < NSTAGE ? name[st] : "X");
+}
+
+
+void CmdTelemetry::reset()
+{
+    memset( H, 0, sizeof(H) );
+    memset( N, 0, sizeof(N) );
+    memset( sum, 0, sizeof(sum) );
+    memset( max, 0, sizeof(max) );
+}
+
+
+void CmdTelemetry::add( int st, double secs )
+{
+    if( st < 0 || st >= NSTAGE )
+        return;
+
+    if( secs < 0 )
+        secs = 0;
+
+    ++H[st][qoctBin( secs, TLM_BASE, NBIN )];
+    ++N[st];
+    sum[st] += secs;
+
+    if( secs > max[st] )
+        max[st] = secs;
+}
+
+
+// Return upper edge of bin holding pct-th percentile, seconds.
+//
+double CmdTelemetry::pctile( int st, double pct ) const
+{
+    if( !N[st] )
+        return 0;
+
+    return qMin( qoctPctile( H[st], NBIN, TLM_BASE, pct ), max[st] );
+}
+
+
+// Totals as name=value lines for GETCMDTELEMETRY.
+//
+QString CmdTelemetry::remoteStr() const
+{
+    QString s;
+
+    for( int st = 0; st < NSTAGE; ++st ) {
+
+        const char  *nm = stageName( st );
+
+        s += QString("%1N=%2\n").arg( nm ).arg( N[st] );
+        s += QString("%1MsMean=%2\n")
+                .arg( nm ).arg( N[st] ? 1000*sum[st]/N[st] : 0, 0, 'f', 3 );
+        s += QString("%1MsP50=%2\n").arg( nm ).arg( 1000*pctile( st, 50 ), 0, 'f', 3 );
+        s += QString("%1MsP90=%2\n").arg( nm ).arg( 1000*pctile( st, 90 ), 0, 'f', 3 );
+        s += QString("%1MsP99=%2\n").arg( nm ).arg( 1000*pctile( st, 99 ), 0, 'f', 3 );
+        s += QString("%1MsMax=%2\n").arg( nm ).arg( 1000*max[st], 0, 'f', 3 );
+    }
+
+    return s;
+}
+
+
+// One line for the log when a push session closes.
+//
+QString CmdTelemetry::logStr() const
+{
+    QString s;
+
+    for( int st = 0; st < NSTAGE; ++st ) {
+
+        s += QString(" %1 p50/p99/max %2/%3/%4 ms")
+                .arg( stageName( st ) )
+                .arg( 1000*pctile( st, 50 ), 0, 'f', 2 )
+                .arg( 1000*pctile( st, 99 ), 0, 'f', 2 )
+                .arg( 1000*max[st], 0, 'f', 2 );
+    }
+
+    return s.trimmed();
+}
+
+
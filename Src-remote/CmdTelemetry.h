@@ -0,0 +1,55 @@
+#ifndef CMDTELEMETRY_H
+#define CMDTELEMETRY_H
+
+#include <QString>
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Timing of one Command Server connection's data replies
+// (FETCH, SUBSCRIBE and SPIKESTREAM frames), owned and updated
+// by its CmdWorker thread alone, so no atomics.
+//
+// - READ: AIQ copy and channel subset.
+// - PROC: filter, CAR, downsample or detection.
+// - SEND: queueing the reply on the socket.
+// - LAT:  from enqueue of the reply's newest scan to its send.
+//
+// Each stage has a count, total, max and quarter-octave
+// histogram from 16 us.
+//
+class CmdTelemetry
+{
+public:
+    enum {
+        READ    = 0,
+        PROC,
+        SEND,
+        LAT,
+        NSTAGE,
+        NBIN    = 64    // quarter-octave bins from 16 us
+    };
+
+private:
+    quint64 H[NSTAGE][NBIN],
+            N[NSTAGE];
+    double  sum[NSTAGE],
+            max[NSTAGE];
+
+public:
+    CmdTelemetry()  {reset();}
+
+    static const char *stageName( int st );
+
+    void reset();
+    void add( int st, double secs );
+
+    double pctile( int st, double pct ) const;
+    QString remoteStr() const;
+    QString logStr() const;
+};
+
+#endif  // CMDTELEMETRY_H
+
+
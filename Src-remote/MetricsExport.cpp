@@ -0,0 +1,381 @@
+
+#include "MetricsExport.h"
+#include "Util.h"
+#include "MainApp.h"
+#include "MetricsWindow.h"
+#include "Run.h"
+#include "Trace.h"
+
+#include <QHostInfo>
+#include <QSettings>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+#include <QTimer>
+#include <QUdpSocket>
+
+#include <string.h>
+
+
+// Keep StatsD datagrams within a typical MTU.
+#define MXEXP_MAXDGRAM  1400
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+static void add(
+    std::vector<MXExpSample>    &v,
+    const char                  *name,
+    const QString               &stream,
+    double                      val,
+    bool                        isCtr = false )
+{
+    MXExpSample S;
+
+    S.name  = name;
+    S.path  = stream;
+    S.val   = val;
+    S.isCtr = isCtr;
+
+    if( !stream.isEmpty() )
+        S.prom = QString("stream=\"%1\"").arg( stream );
+
+    v.push_back( S );
+}
+
+/* ---------------------------------------------------------------- */
+/* MetricsExportWorker -------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Sockets and timer are made here so they live in our thread.
+//
+void MetricsExportWorker::run()
+{
+    Trace::nameThread( "metrics export" );
+
+    if( port > 0 ) {
+
+        http = new QTcpServer( this );
+        Connect( http, SIGNAL(newConnection()), this, SLOT(newConn()) );
+
+        if( http->listen( QHostAddress( iface ), port ) ) {
+            Log() <<
+                QString("Metrics exporter serving http://%1:%2/metrics")
+                .arg( iface ).arg( port );
+        }
+        else {
+            Warning() <<
+                QString("Metrics exporter could not listen on %1:%2 (%3).")
+                .arg( iface ).arg( port ).arg( http->errorString() );
+        }
+    }
+
+    if( sdPort > 0 ) {
+
+        udp     = new QUdpSocket( this );
+        sdTimer = new QTimer( this );
+
+        sdTimer->setTimerType( Qt::CoarseTimer );
+        sdTimer->setInterval( 1000 * qMax( 1, sdSecs ) );
+        Connect( sdTimer, SIGNAL(timeout()), this, SLOT(sendStatsD()) );
+        sdTimer->start();
+
+        Log() <<
+            QString("Metrics exporter sending StatsD to %1:%2 every %3 s")
+            .arg( sdHost.toString() ).arg( sdPort ).arg( qMax( 1, sdSecs ) );
+    }
+}
+
+
+void MetricsExportWorker::newConn()
+{
+    while( http->hasPendingConnections() ) {
+
+        QTcpSocket  *c = http->nextPendingConnection();
+
+        Connect( c, SIGNAL(readyRead()), this, SLOT(readConn()) );
+        Connect( c, SIGNAL(disconnected()), c, SLOT(deleteLater()) );
+    }
+}
+
+
+// One request per connection (HTTP/1.0 style): answer the
+// request line, then close.
+//
+void MetricsExportWorker::readConn()
+{
+    QTcpSocket  *c = qobject_cast<QTcpSocket*>(sender());
+
+    if( !c )
+        return;
+
+    if( !c->canReadLine() ) {
+
+        if( c->bytesAvailable() > 8192 )
+            c->abort();
+
+        return;
+    }
+
+    QStringList req = QString(c->readLine()).split( " " );
+    QByteArray  body;
+    QString     status;
+
+    c->disconnect( this );
+
+    if( req.size() >= 2 && req[0] == "GET"
+        && (req[1] == "/metrics" || req[1].startsWith( "/metrics?" )) ) {
+
+        status  = "200 OK";
+        body    = MetricsExport::promText().toUtf8();
+    }
+    else {
+        status  = "404 Not Found";
+        body    = "Not found; try /metrics\n";
+    }
+
+    c->write(
+        QString(
+        "HTTP/1.0 %1\r\n"
+        "Content-Type: text/plain; version=0.0.4\r\n"
+        "Content-Length: %2\r\n"
+        "Connection: close\r\n\r\n")
+        .arg( status ).arg( body.size() ).toLatin1() );
+    c->write( body );
+    c->disconnectFromHost();
+}
+
+
+// Gauges as "sglx.<path>.<name>:<val>|g" lines, packed into
+// datagrams of at most MXEXP_MAXDGRAM bytes.
+//
+void MetricsExportWorker::sendStatsD()
+{
+    std::vector<MXExpSample>    v;
+    QByteArray                  D;
+
+    MetricsExport::gather( v );
+
+    for( int i = 0, n = v.size(); i < n; ++i ) {
+
+        const MXExpSample   &S = v[i];
+
+        QByteArray  L = QString("sglx.%1%2:%3|g")
+                        .arg( S.path.isEmpty() ? QString() : S.path + "." )
+                        .arg( S.name )
+                        .arg( S.val, 0, 'g', 10 ).toLatin1();
+
+        if( D.size() && D.size() + 1 + L.size() > MXEXP_MAXDGRAM ) {
+            udp->writeDatagram( D, sdHost, sdPort );
+            D.clear();
+        }
+
+        if( D.size() )
+            D += '\n';
+
+        D += L;
+    }
+
+    if( D.size() )
+        udp->writeDatagram( D, sdHost, sdPort );
+}
+
+/* ---------------------------------------------------------------- */
+/* MetricsExport -------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void MetricsExport::loadSettings( QSettings &S )
+{
+    S.beginGroup( "MetricsExport" );
+
+    port    = S.value( "httpPort", 0 ).toInt();
+    iface   = S.value( "httpIface",
+                QHostAddress( QHostAddress::LocalHost ).toString() )
+                .toString();
+    statsd  = S.value( "statsd", QString() ).toString();
+    sdSecs  = S.value( "statsdSecs", MXEXP_DEF_STATSD_SECS ).toInt();
+
+    S.endGroup();
+}
+
+
+void MetricsExport::saveSettings( QSettings &S ) const
+{
+    S.beginGroup( "MetricsExport" );
+
+    S.setValue( "httpPort", port );
+    S.setValue( "httpIface", iface );
+    S.setValue( "statsd", statsd );
+    S.setValue( "statsdSecs", sdSecs );
+
+    S.endGroup();
+}
+
+
+// Start per settings; nothing if both outputs off.
+//
+void MetricsExport::start()
+{
+    stop();
+
+    QHostAddress    sdHost;
+    int             sdPort = 0;
+
+    if( !statsd.trimmed().isEmpty() ) {
+
+        QStringList hp  = statsd.trimmed().split( ":" );
+        QString     h   = hp[0];
+
+        sdPort = (hp.size() > 1 ? hp[1].toInt() : 8125);
+
+        if( !sdHost.setAddress( h ) ) {
+
+            QHostInfo   hi = QHostInfo::fromName( h );
+
+            if( hi.addresses().size() )
+                sdHost = hi.addresses()[0];
+        }
+
+        if( sdHost.isNull() || sdPort <= 0 ) {
+            Warning() << "Metrics exporter: bad statsd address '" << statsd << "'.";
+            sdPort = 0;
+        }
+    }
+
+    if( port <= 0 && !sdPort )
+        return;
+
+    Trace::keepLatest( true );
+
+    thread  = new QThread;
+    worker  = new MetricsExportWorker( iface, port, sdHost, sdPort, sdSecs );
+
+    worker->moveToThread( thread );
+
+    Connect( thread, SIGNAL(started()), worker, SLOT(run()) );
+    Connect( worker, SIGNAL(destroyed()), thread, SLOT(quit()), Qt::DirectConnection );
+
+    thread->start();
+}
+
+
+// worker object auto-deleted asynchronously, in its thread
+// thread object manually deleted synchronously (so we can call wait())
+//
+void MetricsExport::stop()
+{
+    if( !thread )
+        return;
+
+    worker->deleteLater();
+    thread->wait();
+
+    delete thread;
+    thread = 0;
+    worker = 0;
+
+    Trace::keepLatest( false );
+}
+
+
+// Samples grouped by name, as Prometheus requires.
+//
+void MetricsExport::gather( std::vector<MXExpSample> &v )
+{
+    MetricsWindow                   *W = mainApp()->metrics();
+    std::vector<MetricsHist::Cell>  C;
+    std::vector<Trace::Latest>      L;
+    float                           t, g[MetricsHist::NGLB];
+
+    v.clear();
+
+    add( v, "running", QString(), mainApp()->getRun()->isRunning() );
+
+    if( W && W->history().latest( t, g, C ) ) {
+
+        int nIm = C.size();
+
+        add( v, "run_seconds", QString(), t );
+
+        add( v, "write_buffer_percent", "imec", g[MetricsHist::gImFull] );
+        add( v, "write_buffer_percent", "nidq", g[MetricsHist::gNiFull] );
+
+        add( v, "write_mbps", QString(), g[MetricsHist::gWrMBps] );
+        add( v, "write_required_mbps", QString(), g[MetricsHist::gReqMBps] );
+
+        for( int ip = 0; ip < nIm; ++ip )
+            add( v, "fifo_percent", QString("imec%1").arg( ip ), C[ip].fifo );
+
+        for( int ip = 0; ip < nIm; ++ip )
+            add( v, "awake_percent", QString("imec%1").arg( ip ), C[ip].awake );
+
+        for( int ip = 0; ip < nIm; ++ip )
+            add( v, "fetch_depth_percent", QString("imec%1").arg( ip ), C[ip].depth );
+
+        add( v, "fetch_depth_percent", "nidq", g[MetricsHist::gNiDepth] );
+
+        for( int ip = 0; ip < nIm; ++ip )
+            add( v, "consumer_lag_percent", QString("imec%1").arg( ip ), C[ip].lag );
+
+        add( v, "consumer_lag_percent", "nidq", g[MetricsHist::gNiLag] );
+
+        for( int ip = 0; ip < nIm; ++ip )
+            add( v, "errors_total", QString("imec%1").arg( ip ), C[ip].errs, true );
+    }
+
+// Trace counters: name and id as labels
+
+    Trace::latest( L );
+
+    for( int i = 0, n = L.size(); i < n; ++i ) {
+
+        MXExpSample S;
+        QString     nm = QString(L[i].name);
+
+        S.name  = "trace_counter";
+        S.val   = L[i].val;
+        S.isCtr = false;
+        S.prom  = QString("counter=\"%1\"").arg( nm );
+        S.path  = "trace." + nm.replace( QRegExp("[^A-Za-z0-9]+"), "_" );
+
+        if( L[i].id >= 0 ) {
+            S.prom += QString(",id=\"%1\"").arg( L[i].id );
+            S.path += QString(".%1").arg( L[i].id );
+        }
+
+        v.push_back( S );
+    }
+}
+
+
+// Prometheus text exposition format 0.0.4.
+//
+QString MetricsExport::promText()
+{
+    std::vector<MXExpSample>    v;
+    QString                     s;
+    const char                  *last = 0;
+
+    gather( v );
+
+    for( int i = 0, n = v.size(); i < n; ++i ) {
+
+        const MXExpSample   &S = v[i];
+
+        if( !last || strcmp( last, S.name ) ) {
+            s += QString("# TYPE sglx_%1 %2\n")
+                    .arg( S.name ).arg( S.isCtr ? "counter" : "gauge" );
+            last = S.name;
+        }
+
+        s += QString("sglx_%1%2 %3\n")
+                .arg( S.name )
+                .arg( S.prom.isEmpty() ? QString() : "{" + S.prom + "}" )
+                .arg( S.val, 0, 'g', 10 );
+    }
+
+    return s;
+}
+
+
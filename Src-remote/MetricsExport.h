@@ -0,0 +1,111 @@
+#ifndef METRICSEXPORT_H
+#define METRICSEXPORT_H
+
+#include <QObject>
+#include <QHostAddress>
+#include <QString>
+
+#include <vector>
+
+class QSettings;
+class QTcpServer;
+class QThread;
+class QTimer;
+class QUdpSocket;
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#define MXEXP_DEF_STATSD_SECS   10
+
+// One exported figure.
+//
+struct MXExpSample {
+    const char  *name;  // e.g. "fifo_percent"
+    QString     prom,   // Prometheus labels, e.g. stream="imec0"
+                path;   // StatsD key segment, e.g. imec0
+    double      val;
+    bool        isCtr;  // else gauge
+};
+
+
+// Runs in its own thread: serves GET /metrics, and/or sends
+// StatsD gauges every statsdSecs.
+//
+class MetricsExportWorker : public QObject
+{
+    Q_OBJECT
+
+private:
+    QString         iface;
+    QHostAddress    sdHost;
+    QTcpServer      *http;
+    QUdpSocket      *udp;
+    QTimer          *sdTimer;
+    int             port,
+                    sdPort,
+                    sdSecs;
+
+public:
+    MetricsExportWorker(
+        const QString       &iface,
+        int                 port,
+        const QHostAddress  &sdHost,
+        int                 sdPort,
+        int                 sdSecs )
+    :   QObject(0), iface(iface), sdHost(sdHost),
+        http(0), udp(0), sdTimer(0),
+        port(port), sdPort(sdPort), sdSecs(sdSecs)  {}
+
+public slots:
+    void run();
+
+private slots:
+    void newConn();
+    void readConn();
+    void sendStatsD();
+};
+
+
+// Optional exporter of MetricsWindow figures and trace counters
+// for fleet monitoring. Settings (INI only, mainapp.ini group
+// MetricsExport):
+//
+// - httpPort (0=off), httpIface: Prometheus text format at
+//   http://iface:port/metrics.
+// - statsd = host:port (empty=off), statsdSecs: UDP StatsD
+//   gauges sglx.<stream>.<name>.
+//
+// Figures come from the newest MetricsHist row (written once a
+// second by the GUI thread) and Trace::latest(), neither of which
+// locks anything on the acquisition path.
+//
+class MetricsExport
+{
+private:
+    QString             iface,
+                        statsd;
+    MetricsExportWorker *worker;
+    QThread             *thread;
+    int                 port,
+                        sdSecs;
+
+public:
+    MetricsExport()
+    :   worker(0), thread(0), port(0), sdSecs(MXEXP_DEF_STATSD_SECS)   {}
+    virtual ~MetricsExport()    {stop();}
+
+    void loadSettings( QSettings &S );
+    void saveSettings( QSettings &S ) const;
+
+    void start();
+    void stop();
+
+    static void gather( std::vector<MXExpSample> &v );
+    static QString promText();
+};
+
+#endif  // METRICSEXPORT_H
+
+
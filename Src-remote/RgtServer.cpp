@@ -1,9 +1,11 @@
 
 #include "RgtServer.h"
 #include "Util.h"
-#include "SockUtil.h"
+#include "MainApp.h"
+#include "Run.h"
 
 #include <QHostAddress>
+#include <QThread>
 
 
 #define GREETING    "XOXO"
@@ -12,6 +14,7 @@
 #define SETTRIGHI   "SETTRIG 1"
 #define SETTRIGLO   "SETTRIG 0"
 #define SETMETA     "SETMETA"
+#define SETBINARY   "SETBINARY"
 #define METAEND     "METAEND"
 #define OK          "OK"
 
@@ -190,16 +193,176 @@ bool rgtSetMetaData(
     return epilogue( SETMETA, err, SU );
 }
 
+/* ---------------------------------------------------------------- */
+/* RgtBinClient --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+bool RgtBinClient::open(
+    const QString   &host,
+    ushort          port,
+    int             timeout_msecs )
+{
+    err.clear();
+    SU.init( &sock, timeout_msecs, "RemoteApp", &err );
+
+    if( !prologue( SETBINARY, &err, SU, host, port )
+        || !epilogue( SETBINARY, &err, SU ) ) {
+
+        return false;
+    }
+
+    SU.setLowLatency();
+    return true;
+}
+
+
+bool RgtBinClient::send( char cmd, bool hi, int ip, quint64 ct )
+{
+    RgtBinFrame F;
+    RgtBinReply R;
+
+    F.cmd   = cmd;
+    F.hi    = hi;
+    F.ip    = ip;
+    F.seq   = ++seq;
+    F.ct    = ct;
+
+    if( !SU.sendBinary( &F, sizeof(F) ) )
+        return false;
+
+    while( sock.bytesAvailable() < (qint64)sizeof(R) ) {
+
+        if( !sock.waitForReadyRead( 1000 ) ) {
+            SU.appendError( &err, "Binary edge: No ACK." );
+            return false;
+        }
+    }
+
+    if( sock.read( (char*)&R, sizeof(R) ) != sizeof(R)
+        || R.seq != F.seq
+        || R.status != RGT_BIN_OK ) {
+
+        SU.appendError( &err,
+            QString("Binary edge: ACK not OK [%1].").arg( R.status ) );
+        return false;
+    }
+
+    return true;
+}
+
+/* ---------------------------------------------------------------- */
+/* RgtBinWorker --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+RgtBinWorker::~RgtBinWorker()
+{
+    SockUtil::shutdown( sock );
+    delete sock;
+}
+
+
+void RgtBinWorker::run()
+{
+    QString     err;
+    SockUtil    SU( sock, RGT_TOUT_MS, "RgtBin", &err );
+
+    SU.setLowLatency();
+
+    Log() << QString("Gate/Trigger binary session opened %1.")
+                .arg( SU.addr() );
+
+    while( !stop && SU.sockValid() ) {
+
+        if( sock->bytesAvailable() < (qint64)sizeof(RgtBinFrame) ) {
+            sock->waitForReadyRead( RGT_BIN_POLL_MS );
+            continue;
+        }
+
+        RgtBinFrame F;
+
+        if( sock->read( (char*)&F, sizeof(F) ) != sizeof(F)
+            || !dispatch( F, SU ) ) {
+
+            break;
+        }
+    }
+
+    Log() << QString("Gate/Trigger binary session closed %1.")
+                .arg( SU.addr() );
+
+    emit finished();
+}
+
+
+// Reply at once, then apply. A gate low with a count is
+// held until the stream reaches it, so triggers that stop
+// on the gate stop at that sample.
+//
+// Return false if reply failed.
+//
+bool RgtBinWorker::dispatch( const RgtBinFrame &F, SockUtil &SU )
+{
+    Run         *run    = mainApp()->getRun();
+    RgtBinReply R;
+    double      t       = -1,
+                now     = 0;
+
+    R.seq       = F.seq;
+    R.status    = RGT_BIN_OK;
+
+    if( F.cmd != 'G' && F.cmd != 'T' )
+        R.status = RGT_BIN_BADCMD;
+    else if( F.ip != RGT_BIN_NOW && !run->rgtMapCt( t, now, F.ip, F.ct ) )
+        R.status = RGT_BIN_NOSTRM;
+
+    if( !SU.sendBinary( &R, sizeof(R) ) )
+        return false;
+
+    if( R.status != RGT_BIN_OK )
+        return true;
+
+    if( F.cmd == 'G' ) {
+
+        while( !F.hi && t > now && !stop ) {
+
+            QThread::usleep( qBound( 100, int(1e6 * (t - now)), 1000 ) );
+
+            if( !run->rgtMapCt( t, now, F.ip, F.ct ) )
+                return true;
+        }
+
+        run->rgtSetGate( F.hi, t );
+    }
+    else
+        run->rgtSetTrig( F.hi, t );
+
+    return true;
+}
+
 /* ---------------------------------------------------------------- */
 /* Server-side message handling ----------------------------------- */
 /* ---------------------------------------------------------------- */
 
 RgtServer::RgtServer( QObject *parent )
-    :   QTcpServer(parent), timeout_msecs(RGT_TOUT_MS)
+    :   QTcpServer(parent), binStop(false), timeout_msecs(RGT_TOUT_MS)
 {
 }
 
 
+// worker objects auto-deleted asynchronously
+// thread objects manually deleted synchronously (so we can call wait())
+//
+RgtServer::~RgtServer()
+{
+    binStop = true;
+
+    foreach( QThread *thread, binThd ) {
+        thread->wait();
+        delete thread;
+    }
+}
+
+
 bool RgtServer::beginListening(
     const QString   &iface,
     ushort          port,
@@ -234,15 +397,18 @@ bool RgtServer::beginListening(
 
 void RgtServer::incomingConnection( int sockFd )
 {
-    QTcpSocket  sock;
+    QTcpSocket  *sock = new QTcpSocket;
 
-    sock.setSocketDescriptor( sockFd );
+    sock->setSocketDescriptor( sockFd );
 
-    processConnection( sock );
+    if( !processConnection( *sock ) )
+        delete sock;
 }
 
 
-void RgtServer::processConnection( QTcpSocket &sock )
+// Return true if sock was handed to a binary session.
+//
+bool RgtServer::processConnection( QTcpSocket &sock )
 {
     QString     line, cmd, err;
     SockUtil    SU( &sock, timeout_msecs, "RgtSrv", &err );
@@ -255,7 +421,7 @@ void RgtServer::processConnection( QTcpSocket &sock )
 
         Error() << QString("RgtSrv test err %1%2 [%3]")
                     .arg( SU.tag() ).arg( SU.addr() ).arg( err );
-        return;
+        return false;
     }
 
 // -------------
@@ -266,7 +432,7 @@ void RgtServer::processConnection( QTcpSocket &sock )
 
         Error() << QString("RgtSrv send greeting err %1%2 [%3]")
                     .arg( SU.tag() ).arg( SU.addr() ).arg( err );
-        return;
+        return false;
     }
 
 // -------------
@@ -279,7 +445,7 @@ void RgtServer::processConnection( QTcpSocket &sock )
 
         Error() << QString("RgtSrv empty cmd err %1%2 [%3]")
                     .arg( SU.tag() ).arg( SU.addr() ).arg( err );
-        return;
+        return false;
     }
 
     cmd = line.trimmed();
@@ -288,6 +454,18 @@ void RgtServer::processConnection( QTcpSocket &sock )
         emit rgtSetGate( cmd.startsWith( SETGATEHI ) );
     else if( cmd.startsWith( "SETTRIG" ) )
         emit rgtSetTrig( cmd.startsWith( SETTRIGHI ) );
+    else if( cmd.startsWith( SETBINARY ) ) {
+
+        if( !SU.send( OK "\n" ) ) {
+
+            Error() << QString("RgtSrv send OK err %1%2 [%3]")
+                        .arg( SU.tag() ).arg( SU.addr() ).arg( err );
+            return false;
+        }
+
+        startBinary( &sock );
+        return true;
+    }
     else if( cmd.startsWith( "SETMETA" ) ) {
 
         KVParams    kvp;
@@ -300,7 +478,7 @@ void RgtServer::processConnection( QTcpSocket &sock )
     else {
         Error() << QString("RgtSrv unknown cmd err %1%2 [%3]")
                     .arg( SU.tag() ).arg( SU.addr() ).arg( cmd );
-        return;
+        return false;
     }
 
 // -----------
@@ -311,7 +489,7 @@ void RgtServer::processConnection( QTcpSocket &sock )
 
         Error() << QString("RgtSrv send OK err %1%2 [%3]")
                     .arg( SU.tag() ).arg( SU.addr() ).arg( err );
-        return;
+        return false;
     }
 
 // ----
@@ -320,6 +498,36 @@ void RgtServer::processConnection( QTcpSocket &sock )
 
     Debug() << QString("RgtSrv processed %1%2 [%3]")
                 .arg( SU.tag() ).arg( SU.addr() ).arg( cmd );
+
+    return false;
+}
+
+
+// Move sock to its own thread for a persistent binary
+// session; finished sessions are reaped here.
+//
+void RgtServer::startBinary( QTcpSocket *sock )
+{
+    for( int i = binThd.size() - 1; i >= 0; --i ) {
+
+        if( binThd[i]->isFinished() ) {
+            delete binThd[i];
+            binThd.removeAt( i );
+        }
+    }
+
+    QThread         *thread = new QThread;
+    RgtBinWorker    *worker = new RgtBinWorker( sock, binStop );
+
+    sock->moveToThread( thread );
+    worker->moveToThread( thread );
+
+    Connect( thread, SIGNAL(started()), worker, SLOT(run()) );
+    Connect( worker, SIGNAL(finished()), worker, SLOT(deleteLater()) );
+    Connect( worker, SIGNAL(destroyed()), thread, SLOT(quit()), Qt::DirectConnection );
+
+    binThd.append( thread );
+    thread->start( QThread::TimeCriticalPriority );
 }
 
 }   // namespace ns_RgtServer
@@ -2,9 +2,14 @@
 #define RGTSERVER_H
 
 #include "KVParams.h"
+#include "SockUtil.h"
 
 #include <QTcpServer>
 
+#include <atomic>
+
+class QThread;
+
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -15,6 +20,37 @@ namespace ns_RgtServer
 #define RGT_DEF_PORT    52521
 #define RGT_TOUT_MS     1000
 
+// Binary session reply codes; RGT_BIN_NOW for an edge without count.
+#define RGT_BIN_NOW     -2
+#define RGT_BIN_OK      0
+#define RGT_BIN_BADCMD  1
+#define RGT_BIN_NOSTRM  2   // not running or no such stream
+
+// Binary session socket poll period.
+#define RGT_BIN_POLL_MS 100
+
+// Binary mode frame, client to server (16 bytes, little-endian).
+//
+// A frame stamped with a stream count takes effect at that sample
+// rather than on arrival. Trigger edges may be sent ahead of time;
+// a gate low is held by the server until the stream reaches it.
+//
+struct RgtBinFrame {
+    quint8  cmd;    // 'G'=gate, 'T'=trigger
+    quint8  hi;     // 1=high, 0=low
+    qint16  ip;     // stream of ct: -1=nidq, >=0 imec probe, or RGT_BIN_NOW
+    quint32 seq;    // echoed in reply
+    quint64 ct;     // stream sample count of edge
+};
+
+
+// Binary mode reply, one per frame (8 bytes).
+//
+struct RgtBinReply {
+    quint32 seq;
+    qint32  status; // RGT_BIN_xxx
+};
+
 /* ---------------------------------------------------------------- */
 /* Remote messages to server app ---------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -52,19 +88,79 @@ bool rgtSetMetaData(
     int             timeout_msecs = RGT_TOUT_MS,
     QString         *err = 0 );
 
+// Remote app holds one connection open for back-to-back
+// gate and trigger edges, sent as binary frames. Each call
+// blocks until the edge is acknowledged or timeout.
+//
+class RgtBinClient
+{
+private:
+    QTcpSocket  sock;
+    SockUtil    SU;
+    QString     err;
+    quint32     seq;
+
+public:
+    RgtBinClient() : seq(0)    {}
+
+    bool open(
+        const QString   &host = "127.0.0.1",
+        ushort          port = RGT_DEF_PORT,
+        int             timeout_msecs = RGT_TOUT_MS );
+
+    bool setGate( bool hi, int ip = RGT_BIN_NOW, quint64 ct = 0 )
+        {return send( 'G', hi, ip, ct );}
+    bool setTrig( bool hi, int ip = RGT_BIN_NOW, quint64 ct = 0 )
+        {return send( 'T', hi, ip, ct );}
+
+    const QString &error() const    {return err;}
+
+private:
+    bool send( char cmd, bool hi, int ip, quint64 ct );
+};
+
 /* ---------------------------------------------------------------- */
 /* Server-side message handling ----------------------------------- */
 /* ---------------------------------------------------------------- */
 
+// Serves one binary session on its own thread.
+//
+class RgtBinWorker : public QObject
+{
+    Q_OBJECT
+
+private:
+    QTcpSocket              *sock;
+    const std::atomic<bool> &stop;
+
+public:
+    RgtBinWorker( QTcpSocket *sock, const std::atomic<bool> &stop )
+    :   QObject(0), sock(sock), stop(stop)  {}
+    virtual ~RgtBinWorker();
+
+signals:
+    void finished();
+
+public slots:
+    void run();
+
+private:
+    bool dispatch( const RgtBinFrame &F, SockUtil &SU );
+};
+
+
 class RgtServer : public QTcpServer
 {
     Q_OBJECT
 
 private:
-    int timeout_msecs;
+    QList<QThread*>     binThd;
+    std::atomic<bool>   binStop;
+    int                 timeout_msecs;
 
 public:
     RgtServer( QObject *parent );
+    virtual ~RgtServer();
 
     bool beginListening(
         const QString   &iface = "127.0.0.1",
@@ -80,7 +176,8 @@ protected:
     void incomingConnection( int sockFd ); // from QTcpServer
 
 private:
-    void processConnection( QTcpSocket &sock );
+    bool processConnection( QTcpSocket &sock );
+    void startBinary( QTcpSocket *sock );
 };
 
 }   // namespace ns_RgtServer
@@ -11,6 +11,9 @@
 
 #define LINELEN 65536
 
+// Max bytes handed to socket per write.
+#define CHUNK   (1024*1024)
+
 
 void SockUtil::setLowLatency()
 {
@@ -112,18 +115,7 @@ bool SockUtil::send( const QString &msg, bool debugInput )
 
     sock->write( STR2CHR( msg ) );
 
-    if( sock->bytesToWrite()
-        && !sock->waitForBytesWritten( timeout_ms ) ) {
-
-        appendError( errOut, errorToString( sock->error() ) );
-
-        if( autoAbort )
-            sock->abort();
-
-        return false;
-    }
-
-    return true;
+    return drainTo( sndqMax );
 }
 
 
@@ -132,17 +124,18 @@ bool SockUtil::sendBinary( const void* src, qint64 bytes )
     if( !sockExists() )
         return false;
 
-    sock->write( (const char*)src, bytes );
+    const char  *p = (const char*)src;
 
-    if( sock->bytesToWrite()
-        && !sock->waitForBytesWritten( timeout_ms ) ) {
+    while( bytes > 0 ) {
 
-        appendError( errOut, errorToString( sock->error() ) );
+        qint64  n = qMin( bytes, qint64(CHUNK) );
 
-        if( autoAbort )
-            sock->abort();
+        sock->write( p, n );
+        p       += n;
+        bytes   -= n;
 
-        return false;
+        if( !drainTo( sndqMax ) )
+            return false;
     }
 
     return true;
@@ -177,6 +170,28 @@ QString SockUtil::readLine()
 }
 
 
+// Wait while more than limit bytes are queued in socket.
+// Fail only if no bytes go out for timeout_ms.
+//
+bool SockUtil::drainTo( qint64 limit )
+{
+    while( sock->bytesToWrite() > limit ) {
+
+        if( !sock->waitForBytesWritten( timeout_ms ) ) {
+
+            appendError( errOut, errorToString( sock->error() ) );
+
+            if( autoAbort )
+                sock->abort();
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
 // Note:
 // -----
 // Calling sock->error() on a new healthy socket returns value
@@ -11,6 +11,15 @@
 // Lightweight wrapper around a socket to
 // simplify call sequences and report errors.
 //
+// Sends block until written, unless setSendQueue() allows up
+// to maxBytes to stay queued in the socket: then send() returns
+// at once, a sender waits only while the queue is over bound,
+// and the queue drains in the background of later socket waits
+// (e.g. readLine). Call flush() before closing such a socket.
+// Either way, large payloads are written a chunk at a time, so
+// the socket never buffers a whole copy, and a timeout means
+// no progress for timeout_ms rather than a slow transfer.
+//
 // No destructor, caller retains socket ownership.
 //
 class SockUtil
@@ -20,6 +29,7 @@ private:
     QString     _tag,       // context string for err messages
                 _addr;      // "(host:port)"; made by addr()
     QString     *errOut;    // caller's optional message copy
+    qint64      sndqMax;    // bytes allowed queued; 0=blocking
     int         timeout_ms;
     bool        autoAbort;  // abort() on send() error
 
@@ -47,9 +57,11 @@ public:
             this->errOut        = errOut;
             this->timeout_ms    = timeout_ms;
             this->autoAbort     = autoAbort;
+            this->sndqMax       = 0;
         }
 
     void setLowLatency();
+    void setSendQueue( qint64 maxBytes )    {sndqMax = maxBytes;}
 
     const QString &tag()   {return _tag;}
     const QString &addr();
@@ -61,6 +73,7 @@ public:
 
     bool send( const QString &msg, bool debugInput = false );
     bool sendBinary( const void* src, qint64 bytes );
+    bool flush()    {return sockExists() && drainTo( 0 );}
 
     QString readLine();
 
@@ -68,6 +81,9 @@ public:
     static void appendError( QString *eDst, const QString &eNew );
 
     static void shutdown( QTcpSocket *sock );
+
+private:
+    bool drainTo( qint64 limit );
 };
 
 #endif  // SOCKUTIL_H
@@ -2,6 +2,8 @@
 HEADERS += \
     $$PWD/CmdSrvDlg.h \
     $$PWD/CmdServer.h \
+    $$PWD/CmdTelemetry.h \
+    $$PWD/MetricsExport.h \
     $$PWD/RgtServer.h \
     $$PWD/RgtSrvDlg.h \
     $$PWD/SockUtil.h
@@ -9,6 +11,8 @@ HEADERS += \
 SOURCES += \
     $$PWD/CmdSrvDlg.cpp \
     $$PWD/CmdServer.cpp \
+    $$PWD/CmdTelemetry.cpp \
+    $$PWD/MetricsExport.cpp \
     $$PWD/RgtServer.cpp \
     $$PWD/RgtSrvDlg.cpp \
     $$PWD/SockUtil.cpp
@@ -2,81 +2,220 @@
 #include "AIQ.h"
 #include "Util.h"
 
+#include <QSharedMemory>
+
+#include <deque>
+#include <new>
+
+#include <limits.h>
+
 
 #define SAMPS( arg )    (nchans * (arg))
 #define BYTES( arg )    (nchans * sizeof(qint16) * (arg))
 
+#define SHM_MAGIC       0x514C4753  // 'SGLQ'
+#define SHM_VERSION     1
+
 /* ---------------------------------------------------------------- */
-/* RingWalker ----------------------------------------------------- */
+/* Edge kernels --------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
-// Utility class assists edge detection around the ring.
-
-class RingWalker {
-private:
-    const vec_i16   &buf;
-    int             bufmax,
-                    bufhead,
-                    buflen,
-                    nchans,
-                    chan,
-                    icur,
-                    len,
-                    nrhs;
-    quint64         headCt;
-public:
-    const qint16    *cur;
-public:
-    RingWalker(
-        const vec_i16   &buf,
-        int             bufmax,
-        int             bufhead,
-        int             buflen,
-        int             nchans,
-        int             chan )
-    :   buf(buf), bufmax(bufmax), bufhead(bufhead),
-        buflen(buflen), nchans(nchans), chan(chan),
-        icur(0) {}
-
-    bool setStart( quint64 fromCt, quint64 endCt );
-    bool next();
-    quint64 curCt() {return headCt + icur;}
+// Unfiltered edge finders gather the target channel for a tile
+// of EDGETILE timepoints into contiguous memory, validate the
+// tile against producer overrun, then reduce it to a bitmask
+// (bit i set if tile[i] is at the sought level). Compares use
+// SSE2/AVX2 where compiled in, else scalar. The run-length
+// (inarow) search then steps over whole runs of bits at once.
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define EDGE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EDGE_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define EDGETILE    512
+
+enum EdgeLevel {
+    edgeGE      = 0,    // v >= T
+    edgeLT      = 1,    // v <  T
+    edgeBitHi   = 2,    // bit set
+    edgeBitLo   = 3     // bit clear
 };
 
 
-bool RingWalker::setStart( quint64 fromCt, quint64 endCt )
+static inline int ctz64( quint64 x )
 {
-    headCt = endCt - buflen;
+#ifdef _MSC_VER
+    unsigned long   i;
+#ifdef _M_X64
+    _BitScanForward64( &i, x );
+#else
+    if( !_BitScanForward( &i, quint32(x) ) ) {
+        _BitScanForward( &i, quint32(x >> 32) );
+        i += 32;
+    }
+#endif
+    return i;
+#else
+    return __builtin_ctzll( x );
+#endif
+}
 
-    if( fromCt >= endCt )
-        return false;
 
-    if( fromCt < headCt )
-        fromCt = headCt;
+static inline bool edgeLevel( qint16 v, int kind, qint16 T, int bit )
+{
+    switch( kind ) {
+        case edgeGE:    return v >= T;
+        case edgeLT:    return v < T;
+        case edgeBitHi: return (v >> bit) & 1;
+        default:        return !((v >> bit) & 1);
+    }
+}
 
-    int offset  = fromCt - headCt,
-        head    = (bufhead + offset) % bufmax;
 
-    len     = buflen - offset;
-    nrhs    = std::min( len, bufmax - head );
-    cur     = &buf[SAMPS(head) + chan];
-    headCt  = fromCt;
+// Set bits[] from tile[0..n); unused high bits are zeroed.
+//
+static void edgeMask(
+    quint64         *bits,
+    const qint16    *tile,
+    int             n,
+    int             kind,
+    qint16          T,
+    int             bit )
+{
+    memset( bits, 0, (EDGETILE / 64) * sizeof(quint64) );
 
-    return true;
+    int i = 0;
+
+#if defined(EDGE_AVX2)
+    const __m256i   vT  = _mm256_set1_epi16( T ),
+                    vB  = _mm256_set1_epi16( qint16(1 << bit) ),
+                    vZ  = _mm256_setzero_si256();
+
+    for( ; i + 32 <= n; i += 32 ) {
+
+        __m256i a = _mm256_loadu_si256( (const __m256i*)&tile[i] ),
+                b = _mm256_loadu_si256( (const __m256i*)&tile[i + 16] );
+
+        if( kind <= edgeLT ) {
+            a = _mm256_cmpgt_epi16( vT, a );    // v < T
+            b = _mm256_cmpgt_epi16( vT, b );
+        }
+        else {
+            a = _mm256_cmpeq_epi16( _mm256_and_si256( a, vB ), vZ );
+            b = _mm256_cmpeq_epi16( _mm256_and_si256( b, vB ), vZ );
+        }
+
+        // packs interleaves 128-bit lanes; permute restores order
+        quint32 m = _mm256_movemask_epi8(
+                        _mm256_permute4x64_epi64(
+                            _mm256_packs_epi16( a, b ), 0xD8 ) );
+
+        if( kind == edgeGE || kind == edgeBitHi )
+            m = ~m;
+
+        bits[i >> 6] |= quint64(m) << (i & 63);
+    }
+#elif defined(EDGE_SSE2)
+    const __m128i   vT  = _mm_set1_epi16( T ),
+                    vB  = _mm_set1_epi16( qint16(1 << bit) ),
+                    vZ  = _mm_setzero_si128();
+
+    for( ; i + 16 <= n; i += 16 ) {
+
+        __m128i a = _mm_loadu_si128( (const __m128i*)&tile[i] ),
+                b = _mm_loadu_si128( (const __m128i*)&tile[i + 8] );
+
+        if( kind <= edgeLT ) {
+            a = _mm_cmplt_epi16( a, vT );
+            b = _mm_cmplt_epi16( b, vT );
+        }
+        else {
+            a = _mm_cmpeq_epi16( _mm_and_si128( a, vB ), vZ );
+            b = _mm_cmpeq_epi16( _mm_and_si128( b, vB ), vZ );
+        }
+
+        quint32 m = _mm_movemask_epi8( _mm_packs_epi16( a, b ) );
+
+        if( kind == edgeGE || kind == edgeBitHi )
+            m = ~m & 0xFFFF;
+
+        bits[i >> 6] |= quint64(m) << (i & 63);
+    }
+#endif
+
+    for( ; i < n; ++i ) {
+
+        if( edgeLevel( tile[i], kind, T, bit ) )
+            bits[i >> 6] |= quint64(1) << (i & 63);
+    }
 }
 
 
-bool RingWalker::next()
+// Run-length state carried across words and tiles.
+//
+// inRun:    previous sample was at level.
+// runValid: current run was preceded by a non-level sample,
+//           so its first sample is an edge candidate.
+//
+struct EdgeRun {
+    quint64 runStart;
+    int     runLen,
+            inarow;
+    bool    inRun,
+            runValid;
+
+    EdgeRun( int inarow )
+    :   runStart(0), runLen(0), inarow(inarow),
+        inRun(true), runValid(false)    {}
+
+    bool scan( quint64 w, int nb, quint64 ct0 );
+};
+
+
+// Scan nb bits of w; bit 0 is count ct0.
+// Return true if edge found (@ runStart).
+//
+bool EdgeRun::scan( quint64 w, int nb, quint64 ct0 )
 {
-    if( ++icur >= len )
-        return false;
+    int i = 0;
 
-    if( icur != nrhs )
-        cur += nchans;
-    else
-        cur = &buf[chan];
+    while( i < nb ) {
 
-    return true;
+        quint64 r = w >> i;
+
+        if( inRun ) {
+
+            int ones = (~r ? ctz64( ~r ) : 64);
+
+            ones = std::min( ones, nb - i );
+
+            if( runValid && (runLen += ones) >= inarow )
+                return true;
+
+            if( (i += ones) < nb )
+                inRun = false;
+        }
+        else {
+
+            int zeros = (r ? ctz64( r ) : 64);
+
+            if( (i += zeros) < nb ) {
+                inRun       = true;
+                runValid    = true;
+                runStart    = ct0 + i;
+                runLen      = 0;
+            }
+        }
+    }
+
+    return false;
 }
 
 /* ---------------------------------------------------------------- */
@@ -85,19 +224,23 @@ bool RingWalker::next()
 
 // Utility class assists edge detection around the ring;
 // filters data via callback usrFlt.
+//
+// Each block is validated as soon as it's copied out of the
+// ring, so usrFlt (and its filter state) never sees data the
+// producer has overwritten; the walk ends early instead.
 
 class RingFltWalker {
 private:
-    const vec_i16       &buf;
+    const AIQ           &Q;
+    const qint16        *buf;
     int                 bufmax,
-                        bufhead,
-                        buflen,
                         nchans,
                         icur,
                         head,
                         len,
                         nrhs;
-    quint64             headCt;
+    quint64             headCt,
+                        chkCt;
     AIQ::T_AIQFilter    &usrFlt;
     int                 nflt,
                         iflt;
@@ -105,44 +248,37 @@ public:
     const qint16    *cur;
 public:
     RingFltWalker(
-        const vec_i16       &buf,
+        const AIQ           &Q,
+        const qint16        *buf,
         int                 bufmax,
-        int                 bufhead,
-        int                 buflen,
         int                 nchans,
         AIQ::T_AIQFilter    &usrFlt )
-    :   buf(buf), bufmax(bufmax), bufhead(bufhead),
-        buflen(buflen), nchans(nchans), icur(0),
-        usrFlt(usrFlt)  {}
+    :   Q(Q), buf(buf), bufmax(bufmax),
+        nchans(nchans), icur(0), usrFlt(usrFlt) {}
 
-    bool setStart( quint64 fromCt, quint64 endCt );
+    bool setStart( quint64 fromCt, quint64 qHeadCt, quint64 endCt );
     bool next();
-    quint64 curCt() {return headCt + icur;}
+    quint64 checkCt()   {return chkCt;}
+    quint64 curCt()     {return headCt + icur;}
 private:
-    void filter();
+    bool filter();
 };
 
 
-bool RingFltWalker::setStart( quint64 fromCt, quint64 endCt )
+bool RingFltWalker::setStart( quint64 fromCt, quint64 qHeadCt, quint64 endCt )
 {
-    headCt = endCt - buflen;
+    if( fromCt < qHeadCt )
+        fromCt = qHeadCt;
 
     if( fromCt >= endCt )
         return false;
 
-    if( fromCt < headCt )
-        fromCt = headCt;
-
-    int offset = fromCt - headCt;
-
-    head    = (bufhead + offset) % bufmax;
-    len     = buflen - offset;
-    nrhs    = std::min( len, bufmax - head );
+    head    = fromCt % bufmax;
+    len     = endCt - fromCt;
+    nrhs    = Q.nContig( head, len );
     headCt  = fromCt;
 
-    filter();
-
-    return true;
+    return filter();
 }
 
 
@@ -152,15 +288,14 @@ bool RingFltWalker::next()
         return false;
 
     if( ++iflt >= nflt )
-        filter();
-    else
-        ++cur;
+        return filter();
 
+    ++cur;
     return true;
 }
 
 
-void RingFltWalker::filter()
+bool RingFltWalker::filter()
 {
     const qint16    *src;
     qint16          *dst = &usrFlt.fltbuf[0];
@@ -179,316 +314,1751 @@ void RingFltWalker::filter()
     for( int i = 0; i < nflt; ++i, src += nchans )
         *dst++ = *src;
 
+    chkCt = curCt();
+
+    Q.zeroGaps( &usrFlt.fltbuf[0], chkCt, nflt, 1 );
+
+    if( !Q.isIntact( chkCt ) )
+        return false;
+
     usrFlt( nflt );
 
     iflt    = 0;
     cur     = &usrFlt.fltbuf[0];
+
+    return true;
 }
 
 /* ---------------------------------------------------------------- */
-/* AIQ ------------------------------------------------------------ */
+/* AIQSyncIdx ----------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
-AIQ::AIQ( double srate, int nchans, int capacitySecs )
-    :   srate(srate), nchans(nchans), bufmax(capacitySecs * srate),
-        tzero(0), endCt(0), bufhead(0), buflen(0)
-{
-    buf.resize( SAMPS(bufmax) );
-}
+// Incremental index of sync edges detected by the producer as
+// blocks are enqueued. Each entry pairs an edge count with its
+// sync-derived time: the first edge is stamped with nominal
+// stream time, and each later edge adds a whole number of sync
+// periods. Piecewise-linear interpolation between entries maps
+// count <-> time with sub-sample resolution, tracking drift in
+// the effective sample rate over arbitrarily long runs, in
+// O(log n) without rescanning the ring.
+//
+// One writer (producer) appends; readers binary-search the
+// newest NIDX entries, keeping clear of the overwrite margin.
+// Once indexing has begun, the table is the authority on
+// which edges have arrived, so readers need not rescan data.
 
+#define SYNCINAROW  100     // same debounce as SyncStream::findEdge
+#define SYNCMARGIN  64
 
-// Fill with (tLim-t0)*srate zero samples.
+class AIQSyncIdx {
+private:
+    enum { NIDX = 16384 };
+    struct Entry {
+        quint64 ct;
+        double  t;
+    };
+private:
+    Entry                   E[NIDX],
+                            E0;     // first ever, kept for rate
+    std::atomic<quint64>    nE,
+                            idxCt0;
+    const double            srate,
+                            period,
+                            perCts;
+    const int               nchans,
+                            chan,
+                            bit;
+    const qint16            thresh;
+    quint64                 candCt;
+    int                     run;
+    bool                    armed;
+public:
+    AIQSyncIdx(
+        double  srate,
+        int     nchans,
+        int     chan,
+        int     bit,
+        qint16  thresh,
+        double  period )
+    :   nE(0), idxCt0(UNSET64),
+        srate(srate), period(period), perCts(period * srate),
+        nchans(nchans), chan(chan), bit(bit), thresh(thresh),
+        candCt(0), run(0), armed(false) {}
+
+    bool sameAs( int chan, int bit, qint16 thresh ) const
+        {return chan == this->chan && bit == this->bit
+                && (bit >= 0 || thresh == this->thresh);}
+
+    void scan( const qint16 *src, quint64 ct0, int n, double tzero );
+
+    bool covers( quint64 fromCt ) const;
+    bool edgeFrom( quint64 &edgeCt, quint64 fromCt ) const;
+    bool edgeBefore( quint64 &edgeCt, quint64 ct ) const;
+    bool ct2Time( double &t, double ct ) const;
+    bool time2Ct( double &ct, double t ) const;
+    bool rate( double &srate, double &spanSecs ) const;
+
+private:
+    void add( quint64 ct, double tzero );
+    void range( quint64 &lo, quint64 &hi ) const;
+};
+
+
+// Producer: detect confirmed rising edges in new block.
 //
-void AIQ::enqueueZero( double t0, double tLim )
+void AIQSyncIdx::scan(
+    const qint16    *src,
+    quint64         ct0,
+    int             n,
+    double          tzero )
 {
-    int nCts = (tLim - t0) * srate;
+    if( idxCt0.load( std::memory_order_relaxed ) == quint64(UNSET64) )
+        idxCt0.store( ct0, std::memory_order_release );
 
-    QMutexLocker    ml( &QMtx );
+    src += chan;
 
-    endCt += nCts;
+    for( int i = 0; i < n; ++i, src += nchans ) {
 
-    if( nCts >= bufmax ) {
-        // Keep only newest bufmax-worth.
-        bufhead = 0;
-        buflen  = bufmax;
-        memset( &buf[0], 0, BYTES(bufmax) );
+        bool hi = (bit >= 0 ? (*src >> bit) & 1 : *src >= thresh);
+
+        if( !hi ) {
+            armed   = true;
+            run     = 0;
+        }
+        else if( armed ) {
+
+            if( !run++ )
+                candCt = ct0 + i;
+
+            if( run >= SYNCINAROW ) {
+                add( candCt, tzero );
+                armed = false;
+            }
+        }
     }
+}
+
+
+void AIQSyncIdx::add( quint64 ct, double tzero )
+{
+    quint64 n = nE.load( std::memory_order_relaxed );
+    double  t;
+
+    if( !n )
+        t = tzero + ct / srate;
     else {
-        // All new data fit, with some room for old data.
-        int newlen  = std::min( buflen + nCts, bufmax ),
-            newhead = (bufhead + buflen + nCts - newlen) % bufmax,
-            oldtail = (bufhead + buflen) % bufmax,
-            ncpy1   = std::min( nCts, bufmax - oldtail );
 
-        memset( &buf[SAMPS(oldtail)], 0, BYTES(ncpy1) );
+        const Entry &P = E[(n - 1) % NIDX];
 
-        if( nCts -= ncpy1 )
-            memset( &buf[0], 0, BYTES(nCts) );
+        double  k = qRound( (ct - P.ct) / perCts );
 
-        bufhead = newhead;
-        buflen  = newlen;
+        if( k < 1 )
+            return;     // glitch
+
+        t = P.t + k * period;
     }
+
+    Entry   &D = E[n % NIDX];
+
+    D.ct    = ct;
+    D.t     = t;
+
+    if( !n )
+        E0 = D;
+    nE.store( n + 1, std::memory_order_release );
 }
 
 
-void AIQ::enqueue( const qint16 *src, int nCts )
+// Reader: safe index range [lo,hi).
+//
+void AIQSyncIdx::range( quint64 &lo, quint64 &hi ) const
 {
-    QMutexLocker    ml( &QMtx );
+    hi = nE.load( std::memory_order_acquire );
+    lo = (hi > NIDX - SYNCMARGIN ? hi - (NIDX - SYNCMARGIN) : 0);
+}
 
-    endCt += nCts;
 
-    if( nCts >= bufmax ) {
-        // Keep only newest bufmax-worth.
-        bufhead = 0;
-        buflen  = bufmax;
-        memcpy( &buf[0], &src[SAMPS(nCts-bufmax)], BYTES(bufmax) );
-    }
-    else {
-        // All new data fit, with some room for old data.
-        int newlen  = std::min( buflen + nCts, bufmax ),
-            newhead = (bufhead + buflen + nCts - newlen) % bufmax,
-            oldtail = (bufhead + buflen) % bufmax,
-            ncpy1   = std::min( nCts, bufmax - oldtail );
+// True if every confirmed edge >= fromCt is in the index,
+// that is, indexing began by fromCt and no entry after it
+// has been overwritten.
+//
+bool AIQSyncIdx::covers( quint64 fromCt ) const
+{
+    quint64 lo, hi;
 
-        memcpy( &buf[SAMPS(oldtail)], &src[0], BYTES(ncpy1) );
+    range( lo, hi );
 
-        if( nCts -= ncpy1 )
-            memcpy( &buf[0], &src[SAMPS(ncpy1)], BYTES(nCts) );
+    if( idxCt0.load( std::memory_order_acquire ) > fromCt )
+        return false;
 
-        bufhead = newhead;
-        buflen  = newlen;
-    }
+    return !lo || E[lo % NIDX].ct <= fromCt;
 }
 
 
-void AIQ::enqueueProfile(
-    double          &tLock,
-    double          &tWork,
-    const qint16    *src,
-    int             nCts )
+// First indexed edge >= fromCt.
+//
+bool AIQSyncIdx::edgeFrom( quint64 &edgeCt, quint64 fromCt ) const
 {
-    double  t, t0 = getTime();
+    quint64 lo, hi;
 
-    QMutexLocker    ml( &QMtx );
+    range( lo, hi );
 
-    t       = getTime();
-    tLock   =  t - t0;  // time to get lock
+// Require fromCt inside indexed span so no unindexed
+// earlier edge can be skipped.
 
-    endCt += nCts;
+    if( lo >= hi
+        || E[lo % NIDX].ct > fromCt
+        || E[(hi - 1) % NIDX].ct < fromCt ) {
 
-    if( nCts >= bufmax ) {
-        // Keep only newest bufmax-worth.
-        bufhead = 0;
-        buflen  = bufmax;
-        memcpy( &buf[0], &src[SAMPS(nCts-bufmax)], BYTES(bufmax) );
+        return false;
     }
-    else {
-        // All new data fit, with some room for old data.
-        int newlen  = std::min( buflen + nCts, bufmax ),
-            newhead = (bufhead + buflen + nCts - newlen) % bufmax,
-            oldtail = (bufhead + buflen) % bufmax,
-            ncpy1   = std::min( nCts, bufmax - oldtail );
 
-        memcpy( &buf[SAMPS(oldtail)], &src[0], BYTES(ncpy1) );
+    while( lo < hi ) {
 
-        if( nCts -= ncpy1 )
-            memcpy( &buf[0], &src[SAMPS(ncpy1)], BYTES(nCts) );
+        quint64 mid = (lo + hi) / 2;
 
-        bufhead = newhead;
-        buflen  = newlen;
+        if( E[mid % NIDX].ct < fromCt )
+            lo = mid + 1;
+        else
+            hi = mid;
     }
 
-    tWork = getTime() - t;  // time for everything else
+    edgeCt = E[lo % NIDX].ct;
+    return true;
 }
 
 
-// Return headCt at front of queue.
+// Last indexed edge <= ct.
 //
-quint64 AIQ::qHeadCt() const
+bool AIQSyncIdx::edgeBefore( quint64 &edgeCt, quint64 ct ) const
 {
-    QMutexLocker    ml( &QMtx );
+    quint64 lo, hi;
 
-    return endCt - buflen;
-}
+    range( lo, hi );
+
+    if( lo >= hi || E[lo % NIDX].ct > ct )
+        return false;
 
+    while( hi - lo > 1 ) {
 
-// Return count of scans since run start.
-//
-quint64 AIQ::endCount() const
-{
-    QMutexLocker    ml( &QMtx );
+        quint64 mid = (lo + hi) / 2;
+
+        if( E[mid % NIDX].ct <= ct )
+            lo = mid;
+        else
+            hi = mid;
+    }
 
-    return endCt;
+    edgeCt = E[lo % NIDX].ct;
+    return true;
 }
 
 
-// Return stream's current wall time.
+// Outside indexed span, extrapolate using nearest segment rate
+// (or nominal rate if only one entry).
 //
-double AIQ::endTime() const
+bool AIQSyncIdx::ct2Time( double &t, double ct ) const
 {
-    QMutexLocker    ml( &QMtx );
+    quint64 lo, hi;
 
-    return tzero + endCt / srate;
-}
+    range( lo, hi );
 
+    if( lo >= hi )
+        return false;
 
-// Map given time to corresponding count.
-// Return {-2=way left, -1=left, 0=inside, 1=right} of stream.
-//
-int AIQ::mapTime2Ct( quint64 &ct, double t ) const
-{
-    ct = 0;
+    quint64 L = lo, H = hi - 1;
 
-    QMutexLocker    ml( &QMtx );
+// Find segment [L, L+1] containing ct
 
-    if( t < tzero || !endCt )
-        return -2;
+    if( ct <= E[L % NIDX].ct )
+        H = L + 1;
+    else if( ct >= E[H % NIDX].ct )
+        L = H - 1;
+    else {
 
-    quint64 C = (t - tzero) * srate;
+        while( H - L > 1 ) {
 
-    if( C >= endCt )
-        return 1;
+            quint64 mid = (L + H) / 2;
 
-    if( C < endCt - buflen )
-        return -1;
+            if( E[mid % NIDX].ct <= ct )
+                L = mid;
+            else
+                H = mid;
+        }
+    }
 
-    ct = C;
+    if( L < lo || H >= hi ) {
+        const Entry &A = E[(L < lo ? lo : L) % NIDX];
+        t = A.t + (ct - A.ct) / srate;
+        return true;
+    }
 
-    return 0;
+    const Entry &A = E[L % NIDX],
+                &B = E[H % NIDX];
+
+    t = A.t + (ct - A.ct) * (B.t - A.t) / (B.ct - A.ct);
+    return true;
 }
 
 
-// Map given count to corresponding time.
-// Return {-2=way left, -1=left, 0=inside, 1=right} of stream.
-//
-int AIQ::mapCt2Time( double &t, quint64 ct ) const
+bool AIQSyncIdx::time2Ct( double &ct, double t ) const
 {
-    t = 0;
+    quint64 lo, hi;
 
-    QMutexLocker    ml( &QMtx );
+    range( lo, hi );
 
-    if( !endCt )
-        return -2;
+    if( lo >= hi )
+        return false;
 
-    if( ct >= endCt )
-        return 1;
+    quint64 L = lo, H = hi - 1;
 
-    if( ct < endCt - buflen )
-        return -1;
+    if( t <= E[L % NIDX].t )
+        H = L + 1;
+    else if( t >= E[H % NIDX].t )
+        L = H - 1;
+    else {
 
-    t = tzero + ct / srate;
+        while( H - L > 1 ) {
 
-    return 0;
-}
+            quint64 mid = (L + H) / 2;
 
+            if( E[mid % NIDX].t <= t )
+                L = mid;
+            else
+                H = mid;
+        }
+    }
 
-// Copy up to N scans with count >= fromCt.
-//
-// On entry dest should be cleared and reserved to nominal size.
-//
-// Return {-1=left of stream, 0=fail, 1=success}.
+    if( L < lo || H >= hi ) {
+        const Entry &A = E[(L < lo ? lo : L) % NIDX];
+        ct = A.ct + (t - A.t) * srate;
+        return true;
+    }
+
+    const Entry &A = E[L % NIDX],
+                &B = E[H % NIDX];
+
+    ct = A.ct + (t - A.t) * (B.ct - A.ct) / (B.t - A.t);
+    return true;
+}
+
+// Effective sample rate over all edges so far: counts per
+// second of sync time between first and newest edges.
 //
-int AIQ::getNScansFromCtProfile(
-    double          &pctFromLeft,
-    vec_i16         &dest,
-    quint64         fromCt,
-    int             nMax ) const
+bool AIQSyncIdx::rate( double &srate, double &spanSecs ) const
 {
-    QMutexLocker    ml( &QMtx );
+    quint64 n = nE.load( std::memory_order_acquire );
 
-    quint64 headCt = endCt - buflen;
+    if( n < 2 )
+        return false;
 
-    if( fromCt >= endCt ) {
-        pctFromLeft = 101.0;
-        return 1;
-    }
+    const Entry &B = E[(n - 1) % NIDX];
 
-    if( fromCt < headCt ) {
-        pctFromLeft = -1.0;
-        return -1;
-    }
+    spanSecs    = B.t - E0.t;
+    srate       = (B.ct - E0.ct) / spanSecs;
+    return true;
+}
 
-    pctFromLeft = 100.0 * (fromCt - headCt) / buflen;
+/* ---------------------------------------------------------------- */
+/* AIQStampLog ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
 
-    int offset  = fromCt - headCt,
-        head    = (bufhead + offset) % bufmax,
-        len     = buflen - offset;
+// Hardware timestamp of each enqueued block, newest NSTAMP kept,
+// so a file writer trailing the producer by seconds can still
+// pair its scans with the probe's own clock. Same one-writer
+// ring discipline as AIQSyncIdx.
+//
+#define STAMPMARGIN 64
 
-    nMax = std::min( nMax, len );
+class AIQStampLog {
+private:
+    enum { NSTAMP = 32768 };
+private:
+    AIQ::Stamp              S[NSTAMP];
+    std::atomic<quint64>    nS;
+public:
+    AIQStampLog() : nS(0)   {}
 
-// Get up to RHS limit
+    void add( quint64 ct, quint32 hw, double t );
+    int get(
+        std::vector<AIQ::Stamp> &v,
+        quint64                 fromCt,
+        quint64                 toCt ) const;
+};
 
-    int nrhs = std::min( nMax, bufmax - head );
 
-    try {
-        dest.insert(
-            dest.end(),
-            buf.begin() + SAMPS(head),
-            buf.begin() + SAMPS(head + nrhs) );
-    }
-    catch( const std::exception& ) {
-        Warning()
-            << "AIQ::nScans low mem. SRate " << srate;
-        return 0;
-    }
+// Producer: blocks arrive in count order; empty ones are
+// not logged since they'd share the next block's count.
+//
+void AIQStampLog::add( quint64 ct, quint32 hw, double t )
+{
+    quint64 n = nS.load( std::memory_order_relaxed );
 
-// Get any remainder from LHS
+    if( n && S[(n - 1) % NSTAMP].ct >= ct )
+        return;
 
-    if( nMax -= nrhs ) {
+    AIQ::Stamp  &D = S[n % NSTAMP];
 
-        try {
-            dest.insert(
-                dest.end(),
-                buf.begin(),
-                buf.begin() + SAMPS(nMax) );
-        }
-        catch( const std::exception& ) {
-            Warning()
-                << "AIQ::nScans low mem. SRate " << srate;
-            return 0;
-        }
-    }
+    D.ct    = ct;
+    D.t     = t;
+    D.hw    = hw;
 
-    return 1;
+    nS.store( n + 1, std::memory_order_release );
 }
 
 
-// Copy up to N scans with count >= fromCt.
-//
-// On entry dest should be cleared and reserved to nominal size.
-//
-// Return {-1=left of stream, 0=fail, 1=success}.
+// Reader: append entries with ct in [fromCt,toCt), preceded by
+// the last one before fromCt (the block fromCt lies in).
 //
-int AIQ::getNScansFromCt(
-    vec_i16         &dest,
-    quint64         fromCt,
-    int             nMax ) const
+int AIQStampLog::get(
+    std::vector<AIQ::Stamp> &v,
+    quint64                 fromCt,
+    quint64                 toCt ) const
 {
-    QMutexLocker    ml( &QMtx );
+    quint64 hi = nS.load( std::memory_order_acquire ),
+            lo = (hi > NSTAMP - STAMPMARGIN ? hi - (NSTAMP - STAMPMARGIN) : 0);
+    int     n0 = v.size();
 
-    quint64 headCt = endCt - buflen;
+    if( lo >= hi )
+        return 0;
 
-    if( fromCt >= endCt )
-        return 1;
+// Last entry <= fromCt
 
-    if( fromCt < headCt )
-        return -1;
+    quint64 L = lo, H = hi;
 
-    int offset  = fromCt - headCt,
-        head    = (bufhead + offset) % bufmax,
-        len     = buflen - offset;
+    while( H - L > 1 ) {
 
-    nMax = std::min( nMax, len );
+        quint64 mid = (L + H) / 2;
 
-// Get up to RHS limit
+        if( S[mid % NSTAMP].ct <= fromCt )
+            L = mid;
+        else
+            H = mid;
+    }
 
-    int nrhs = std::min( nMax, bufmax - head );
+    for( ; L < hi; ++L ) {
 
-    try {
-        dest.insert(
-            dest.end(),
-            buf.begin() + SAMPS(head),
-            buf.begin() + SAMPS(head + nrhs) );
+        const AIQ::Stamp    &E = S[L % NSTAMP];
+
+        if( E.ct >= toCt )
+            break;
+
+        v.push_back( E );
+    }
+
+    return v.size() - n0;
+}
+
+/* ---------------------------------------------------------------- */
+/* AIQHist -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Optional extended-history tier behind the hot ring.
+//
+// Just before the producer overwrites ring slots, each whole
+// block of HISTBLK scans about to be lost is losslessly packed
+// into a byte pool: per channel, first value, then zigzagged
+// deltas bit-packed at the block's max width. Smooth neural
+// data (10-bit imec) typically packs 2-3X. Oldest blocks are
+// dropped as the pool fills, so depth (seconds) depends on
+// the signal; see AIQ::histSpan().
+//
+// Producer appends and readers copy out packed bytes under
+// histMtx; unpacking is done outside the lock.
+
+#define HISTBLK     256
+
+class AIQHist {
+private:
+    struct Blk {
+        quint64 ct0;
+        size_t  off;
+        int     len;
+    };
+private:
+    std::vector<quint8> pool;
+    std::deque<Blk>     B;
+    vec_i16             stage;
+    std::vector<quint8> pack;
+    mutable QMutex      histMtx;
+    const int           nchans;
+    size_t              tail;
+    quint64             hCt;    // next count to pack
+public:
+    AIQHist( int nchans, size_t bytes )
+    :   pool(bytes), nchans(nchans), tail(0), hCt(0)
+        {
+            stage.resize( HISTBLK * nchans );
+            pack.resize( blkMaxBytes( nchans ) );
+        }
+
+    static size_t blkMaxBytes( int nchans )
+        {return nchans * (3 + (HISTBLK * 17 + 7) / 8);}
+    static size_t sureBytes( int nchans, double scans );
+
+    void evict(
+        const AIQ       &Q,
+        const qint16    *buf,
+        int             bufmax,
+        quint64         end,
+        quint64         wr );
+
+    int get( vec_i16 &dest, quint64 fromCt, int nMax ) const;
+    bool span( quint64 &fromCt, quint64 &toCt ) const;
+
+    void reset()
+        {
+            QMutexLocker    ml( &histMtx );
+            B.clear();
+            tail    = 0;
+            hCt     = 0;
+        }
+
+private:
+    int encode( const qint16 *src );
+    void decode( qint16 *dst, const quint8 *src ) const;
+    void append( quint64 ct0, int len );
+};
+
+
+// Pool bytes that hold at least scans of any signal: every
+// block packed at worst-case width, plus a block each for the
+// partial blocks at either end and the slack at pool wrap.
+//
+size_t AIQHist::sureBytes( int nchans, double scans )
+{
+    return (size_t(scans / HISTBLK) + 4) * blkMaxBytes( nchans );
+}
+
+
+// Producer: pack every whole block that writing up to wr
+// would overwrite. Blocks already lost (huge writes) are
+// skipped, leaving a gap.
+//
+void AIQHist::evict(
+    const AIQ       &Q,
+    const qint16    *buf,
+    int             bufmax,
+    quint64         end,
+    quint64         wr )
+{
+    if( wr <= quint64(bufmax) )
+        return;
+
+    quint64 lim = wr - bufmax;
+
+    if( end > quint64(bufmax) && hCt < end - bufmax )
+        hCt = (end - bufmax + HISTBLK - 1) / HISTBLK * HISTBLK;
+
+    while( hCt < lim && hCt + HISTBLK <= end ) {
+
+        int             head = int(hCt % bufmax),
+                        n1   = Q.nContig( head, HISTBLK );
+        const qint16    *src = &buf[head * nchans];
+
+        quint64         g0, g1;
+        bool            gap  = Q.findGap( g0, g1, hCt, HISTBLK );
+
+        if( n1 < HISTBLK ) {
+            memcpy( &stage[0], src, n1 * nchans * sizeof(qint16) );
+            memcpy( &stage[n1 * nchans], buf,
+                (HISTBLK - n1) * nchans * sizeof(qint16) );
+            src = &stage[0];
+        }
+        else if( gap ) {
+            memcpy( &stage[0], src, HISTBLK * nchans * sizeof(qint16) );
+            src = &stage[0];
+        }
+
+        if( gap )
+            Q.zeroGaps( &stage[0], hCt, HISTBLK, nchans );
+
+        append( hCt, encode( src ) );
+        hCt += HISTBLK;
+    }
+}
+
+
+// Copy up to nMax scans from fromCt to dest.
+//
+// Return count appended, or -1 if not in history.
+//
+int AIQHist::get( vec_i16 &dest, quint64 fromCt, int nMax ) const
+{
+    std::vector<quint8> P;
+    std::vector<int>    L;
+    quint64             ct0;
+
+    if( nMax <= 0 )
+        return 0;
+
+// Copy packed blocks under lock
+
+    {
+        QMutexLocker    ml( &histMtx );
+
+        if( B.empty()
+            || fromCt < B.front().ct0
+            || fromCt >= B.back().ct0 + HISTBLK ) {
+
+            return -1;
+        }
+
+        int lo = 0, hi = B.size() - 1;
+
+        while( lo < hi ) {
+
+            int mid = (lo + hi + 1) / 2;
+
+            if( B[mid].ct0 <= fromCt )
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+
+        ct0 = B[lo].ct0;
+
+        if( fromCt >= ct0 + HISTBLK )
+            return -1;  // in a gap
+
+        quint64 need = fromCt + nMax;
+
+        for( int ib = lo, nb = B.size(); ib < nb; ++ib ) {
+
+            const Blk   &K = B[ib];
+
+            if( K.ct0 >= need || K.ct0 != ct0 + L.size() * HISTBLK )
+                break;
+
+            P.insert( P.end(), &pool[K.off], &pool[K.off] + K.len );
+            L.push_back( K.len );
+        }
+    }
+
+// Unpack
+
+    int     skip  = int(fromCt - ct0),
+            nGot  = std::min( nMax, int(L.size()) * HISTBLK - skip );
+    size_t  size0 = dest.size();
+    vec_i16 T( HISTBLK * nchans );
+
+    if( nGot <= 0 )
+        return 0;
+
+    try {
+        dest.resize( size0 + nGot * nchans );
+    }
+    catch( const std::exception& ) {
+        Warning() << "AIQ::history low mem.";
+        return 0;
+    }
+
+    qint16          *D   = &dest[size0];
+    const quint8    *src = &P[0];
+    int             left = nGot;
+
+    for( int ib = 0, nb = L.size(); ib < nb && left > 0; ++ib ) {
+
+        int n = std::min( left, HISTBLK - skip );
+
+        decode( &T[0], src );
+        memcpy( D, &T[skip * nchans], n * nchans * sizeof(qint16) );
+
+        D    += n * nchans;
+        src  += L[ib];
+        left -= n;
+        skip  = 0;
+    }
+
+    return nGot;
+}
+
+
+// Return counts spanned [fromCt, toCt).
+//
+bool AIQHist::span( quint64 &fromCt, quint64 &toCt ) const
+{
+    QMutexLocker    ml( &histMtx );
+
+    if( B.empty() )
+        return false;
+
+    fromCt  = B.front().ct0;
+    toCt    = B.back().ct0 + HISTBLK;
+    return true;
+}
+
+
+// Pack block into pack[]; return length.
+//
+// Per channel: width byte, first value (LE), then HISTBLK-1
+// zigzagged deltas at width bits, LSB first, byte aligned.
+//
+int AIQHist::encode( const qint16 *src )
+{
+    quint8  *d = &pack[0];
+
+    for( int c = 0; c < nchans; ++c ) {
+
+        const qint16    *s  = src + c;
+        quint32         zz[HISTBLK],
+                        orz = 0;
+        int             prev = s[0];
+
+        for( int i = 1; i < HISTBLK; ++i ) {
+
+            int v   = s[i * nchans],
+                dv  = v - prev;
+
+            zz[i]   = (quint32(dv) << 1) ^ quint32(dv >> 31);
+            orz    |= zz[i];
+            prev    = v;
+        }
+
+        int w = 0;
+
+        while( orz >> w )
+            ++w;
+
+        *d++ = quint8(w);
+        *d++ = quint8(s[0] & 0xFF);
+        *d++ = quint8((s[0] >> 8) & 0xFF);
+
+        if( !w )
+            continue;
+
+        quint64 acc   = 0;
+        int     nbits = 0;
+
+        for( int i = 1; i < HISTBLK; ++i ) {
+
+            acc   |= quint64(zz[i]) << nbits;
+            nbits += w;
+
+            while( nbits >= 8 ) {
+                *d++    = quint8(acc);
+                acc   >>= 8;
+                nbits  -= 8;
+            }
+        }
+
+        if( nbits )
+            *d++ = quint8(acc);
+    }
+
+    return int(d - &pack[0]);
+}
+
+
+void AIQHist::decode( qint16 *dst, const quint8 *src ) const
+{
+    for( int c = 0; c < nchans; ++c ) {
+
+        qint16  *o  = dst + c;
+        int     w   = *src++,
+                v   = qint16(src[0] | (src[1] << 8));
+
+        src += 2;
+        o[0] = qint16(v);
+
+        if( !w ) {
+
+            for( int i = 1; i < HISTBLK; ++i )
+                o[i * nchans] = qint16(v);
+
+            continue;
+        }
+
+        quint64 acc   = 0;
+        quint32 mask  = (1u << w) - 1;
+        int     nbits = 0;
+
+        for( int i = 1; i < HISTBLK; ++i ) {
+
+            while( nbits < w ) {
+                acc   |= quint64(*src++) << nbits;
+                nbits += 8;
+            }
+
+            quint32 z = quint32(acc) & mask;
+
+            acc   >>= w;
+            nbits  -= w;
+            v      += int(z >> 1) ^ -int(z & 1);
+            o[i * nchans] = qint16(v);
+        }
+    }
+}
+
+
+// Store pack[0..len) as block ct0, evicting oldest blocks
+// that occupy the needed pool bytes.
+//
+void AIQHist::append( quint64 ct0, int len )
+{
+    if( size_t(len) > pool.size() )
+        return;
+
+    QMutexLocker    ml( &histMtx );
+
+    if( B.empty() )
+        tail = 0;
+
+    size_t  pos = tail;
+
+    if( pos + len > pool.size() ) {
+
+        // Drop old blocks parked beyond tail, then wrap
+
+        while( !B.empty() && B.front().off >= tail )
+            B.pop_front();
+
+        pos = 0;
+    }
+
+    while( !B.empty()
+        && B.front().off < pos + len
+        && B.front().off + B.front().len > pos ) {
+
+        B.pop_front();
+    }
+
+    memcpy( &pool[pos], &pack[0], len );
+
+    Blk K = {ct0, pos, len};
+    B.push_back( K );
+    tail = pos + len;
+}
+
+/* ---------------------------------------------------------------- */
+/* AIQ ------------------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+// Ring capacity in scans. A mirror must span whole granules, so
+// when one will be tried round up to the least scan count doing
+// that (e.g. 32768 scans of 385 channels under 64 KB granules).
+//
+static int ringScans(
+    double          srate,
+    int             nchans,
+    int             capacitySecs,
+    int             memFlags,
+    const QString   &shmName )
+{
+    quint64 n = quint64(capacitySecs * srate);
+
+    if( !shmName.isEmpty() || (memFlags & smemLarge) )
+        return int(n);
+
+    quint64 g = mirrorGranule(),
+            a = g,
+            b = nchans * sizeof(qint16);
+
+    while( b ) {
+        quint64 t = a % b;
+        a = b;
+        b = t;
+    }
+
+    g  /= a;    // scans per granule multiple
+    n   = (n + g - 1) / g * g;
+
+    return int(qMin( n, quint64(INT_MAX) / g * g ));
+}
+
+
+// memFlags are Util::StreamMemFlags {lock, large pages}.
+// Unless large pages (or shared memory) are asked for, the ring
+// is mirrored where the OS allows, so every window up to bufmax
+// scans is contiguous in place: views are one span and block
+// copies one memcpy. Capacity is then rounded up a little.
+// Buffer is always pre-faulted so first pass around the ring
+// incurs no page faults.
+//
+// Non-empty shmName places the ring, after a ShmHdr, in that
+// named (native key) shared memory segment instead; memFlags
+// don't apply. If the segment can't be made, fall back to
+// private memory.
+//
+AIQ::AIQ(
+    double          srate,
+    int             nchans,
+    int             capacitySecs,
+    int             memFlags,
+    const QString   &shmName )
+    :   srate(srate), nchans(nchans),
+        bufmax(ringScans( srate, nchans, capacitySecs, memFlags, shmName )),
+        buf(0), mirror(false), bufNode(-1), tzero(0), endCt(0), wrCt(0), endUs(0),
+        nTaps(0), nReaders(0), nWaiters(0),
+        syIdx(0), stLog(0), nGaps(0), hist(0), shm(0), shmH(0)
+{
+    if( !shmName.isEmpty() ) {
+
+        shm = new QSharedMemory;
+        shm->setNativeKey( shmName );
+
+        if( shm->create( sizeof(ShmHdr) + BYTES(bufmax) ) ) {
+
+            memset( shm->data(), 0, sizeof(ShmHdr) + BYTES(bufmax) );
+
+            shmH    = (ShmHdr*)shm->data();
+            buf     = (qint16*)(shmH + 1);
+
+            shmH->magic     = SHM_MAGIC;
+            shmH->version   = SHM_VERSION;
+            shmH->nchans    = nchans;
+            shmH->bufmax    = bufmax;
+            shmH->srate     = srate;
+            bufFlags        = 0;
+            return;
+        }
+
+        Warning()
+            << "AIQ shared memory [" << shmName << "] unavailable ("
+            << shm->errorString() << "); using private memory.";
+
+        delete shm;
+        shm = 0;
+    }
+
+    if( !(memFlags & smemLarge) )
+        buf = (qint16*)allocMirrorMem( BYTES(bufmax), memFlags, bufFlags );
+
+    if( buf )
+        mirror = true;
+    else
+        buf = (qint16*)allocStreamMem( BYTES(bufmax), memFlags, bufFlags );
+
+    if( !buf )
+        throw std::bad_alloc();
+
+    if( memFlags && memFlags != bufFlags ) {
+        Warning()
+            << "AIQ memory options partly unavailable: requested "
+            << memFlags << " granted " << bufFlags << ".";
+    }
+}
+
+
+AIQ::~AIQ()
+{
+    delete syIdx.load();
+    delete stLog.load();
+    delete hist;
+
+    if( shm )
+        delete shm;
+    else
+        freeStreamMem( buf, BYTES(bufmax), bufFlags );
+}
+
+
+// Return to the freshly constructed state, keeping the memory
+// of ring, taps and history, so a following run with the same
+// shape can reuse this queue rather than reallocate it.
+//
+// Call only while there is no producer and no consumers. Taps,
+// reader names and sync index are dropped; their owners call
+// addTap(), readerId() and enableSyncIndex() again. Resized
+// tap buffers are already at size, so that costs nothing.
+//
+void AIQ::reset()
+{
+    QMutexLocker    ml( &tapMtx );
+
+    tzero = 0;
+    endCt.store( 0, std::memory_order_relaxed );
+    wrCt.store( 0, std::memory_order_relaxed );
+    endUs.store( 0, std::memory_order_relaxed );
+
+    for( int i = 0, n = nTaps.load(); i < n; ++i ) {
+        taps[i].fromCt.store( UNSET64, std::memory_order_relaxed );
+        taps[i].chan = -1;
+    }
+
+    nTaps.store( 0, std::memory_order_release );
+
+    for( int ir = 0, nr = nReaders.load(); ir < nr; ++ir ) {
+        readers[ir].name.clear();
+        readers[ir].atCt.store( 0, std::memory_order_relaxed );
+        readers[ir].atT.store( 0, std::memory_order_relaxed );
+    }
+
+    nReaders.store( 0, std::memory_order_release );
+
+    delete syIdx.exchange( 0 );
+    delete stLog.exchange( 0 );
+
+    for( int i = 0; i < MAXGAPS; ++i ) {
+        gaps[i].ct0.store( 0, std::memory_order_relaxed );
+        gaps[i].ct1.store( 0, std::memory_order_relaxed );
+    }
+
+    nGaps.store( 0, std::memory_order_release );
+
+    if( hist )
+        hist->reset();
+
+    if( shmH ) {
+        shmH->tzero = 0;
+        shmH->endCt.store( 0, std::memory_order_relaxed );
+        shmH->wrCt.store( 0, std::memory_order_relaxed );
+        shmH->endUs.store( 0, std::memory_order_release );
+    }
+}
+
+
+// Producer calls once pinned, before its first enqueue of a run:
+// ring pages move to the NUMA node the calling thread is pinned
+// to, so fetch, enqueue and readers sharing that node all touch
+// local memory. Contents aren't kept, which is why nothing may
+// have been enqueued yet. Rings in shared memory stay where the
+// OS put them, as do mirrored rings where the OS can't rebind
+// them (Windows).
+//
+// Return node holding the ring, or -1 if unplaced.
+//
+int AIQ::placeLocal()
+{
+    int node = getCurrentThreadNumaNode();
+
+    if( node < 0
+        || node == bufNode.load()
+        || shm
+        || endCt.load() ) {
+
+        return bufNode.load();
+    }
+
+    if( moveStreamMem( buf, BYTES(bufmax), node, bufFlags ) ) {
+
+        bufNode.store( node );
+
+        Debug() <<
+            QString("AIQ ring (%1 MB) placed on NUMA node %2.")
+            .arg( BYTES(bufmax) / (1024*1024) ).arg( node );
+    }
+    else if( mirror )
+        Debug() << "AIQ mirrored ring stays where first faulted.";
+    else
+        Warning() << "AIQ ring could not move to NUMA node " << node << ".";
+
+    return bufNode.load();
+}
+
+
+// Native key of shared ring, or empty if private.
+//
+QString AIQ::shmName() const
+{
+    return (shm ? shm->nativeKey() : QString());
+}
+
+
+// Ask producer to maintain a contiguous copy of this channel
+// for single-channel consumers {sync, audio, TTL triggers}.
+// May be called from any thread at any time; the tap becomes
+// usable starting with the next enqueued block, and readers
+// transparently use the interleaved ring until then.
+//
+// Return false if MAXTAPS already registered.
+//
+bool AIQ::addTap( int chan ) const
+{
+    QMutexLocker    ml( &tapMtx );
+
+    int n = nTaps.load( std::memory_order_relaxed );
+
+    for( int i = 0; i < n; ++i ) {
+        if( taps[i].chan == chan )
+            return true;
+    }
+
+    if( n >= MAXTAPS )
+        return false;
+
+    Tap &T = taps[n];
+
+    try {
+        T.data.resize( bufmax );
+    }
+    catch( const std::exception& ) {
+        Warning() << "AIQ::addTap low mem. SRate " << srate;
+        return false;
+    }
+
+    T.chan = chan;
+    nTaps.store( n + 1, std::memory_order_release );
+
+    return true;
+}
+
+
+// Keep about secs more history beyond the ring, packed.
+// Pool sized at nominal 2:1 over raw; achieved depth varies
+// with signal, see histSpan().
+//
+// sureSecs is a floor that holds regardless of signal (pool
+// sized for worst-case packing): the trigger's pre-trigger
+// spill, for context reaching back beyond the ring.
+//
+// Call before enqueuing starts.
+//
+void AIQ::enableHistory( double secs, double sureSecs )
+{
+    if( hist || (secs <= 0 && sureSecs <= 0) )
+        return;
+
+    size_t  bytes = 0;
+
+    if( secs > 0 )
+        bytes = size_t(secs * srate) * BYTES(1) / 2;
+
+    if( sureSecs > 0 )
+        bytes = std::max( bytes, AIQHist::sureBytes( nchans, sureSecs * srate ) );
+
+    try {
+        hist = new AIQHist( nchans, bytes );
+    }
+    catch( const std::exception& ) {
+        Warning() << "AIQ::history low mem. SRate " << srate;
+        hist = 0;
+    }
+}
+
+
+// Return seconds currently held in history tier.
+//
+double AIQ::histSpan() const
+{
+    quint64 from, to;
+
+    if( hist && hist->span( from, to ) )
+        return (to - from) / srate;
+
+    return 0;
+}
+
+
+// Copy up to nMax scans starting at fromCt from history tier
+// (only; ring not consulted).
+//
+// Return count appended, 0 if low mem, -1 if not available.
+//
+int AIQ::getHistScans( vec_i16 &dest, quint64 fromCt, int nMax ) const
+{
+    return (hist ? hist->get( dest, fromCt, nMax ) : -1);
+}
+
+
+// Fallback for reads that miss the ring.
+//
+// Return {-1=left of history, 0=fail, 1=success}.
+//
+int AIQ::histScans( vec_i16 &dest, quint64 fromCt, int nMax ) const
+{
+    int n = getHistScans( dest, fromCt, nMax );
+
+    return (n > 0 ? 1 : n);
+}
+
+
+// Get id for named consumer, registering it on first call.
+// Consumers then call readerAt() after each read so that
+// metrics can show which one is nearest to being overrun.
+// Names are shared: all threads of one consumer kind naming
+// the same reader just update the same slot. Consumers that
+// may run several at once (connections, viewers) instead ask
+// for (own) slots, so a fast one can't hide a slow one, and
+// readerFree() them when done.
+//
+// Return -1 if table full.
+//
+int AIQ::readerId( const QString &name, bool own ) const
+{
+    QMutexLocker    ml( &tapMtx );
+
+    int nr  = nReaders.load( std::memory_order_relaxed ),
+        ifr = -1;
+
+    for( int ir = 0; ir < nr; ++ir ) {
+
+        if( readers[ir].name.isEmpty() ) {
+            if( ifr < 0 )
+                ifr = ir;
+        }
+        else if( !own && readers[ir].name == name )
+            return ir;
+    }
+
+    if( ifr < 0 ) {
+
+        if( nr >= MAXREADERS )
+            return -1;
+
+        ifr = nr;
+    }
+
+    Reader  &R = readers[ifr];
+
+    R.name = name;
+    R.atCt.store( endCt.load( std::memory_order_acquire ),
+        std::memory_order_relaxed );
+    R.atT.store( getTime(), std::memory_order_relaxed );
+
+    if( ifr == nr )
+        nReaders.store( nr + 1, std::memory_order_release );
+
+    return ifr;
+}
+
+
+// Release an (own) slot for reuse.
+//
+void AIQ::readerFree( int rid ) const
+{
+    if( rid < 0 )
+        return;
+
+    QMutexLocker    ml( &tapMtx );
+
+    readers[rid].name.clear();
+}
+
+
+// Consumer rid has now consumed all scans before ct.
+//
+void AIQ::readerAt( int rid, quint64 ct ) const
+{
+    if( rid < 0 )
+        return;
+
+    Reader  &R = readers[rid];
+
+    R.atCt.store( ct, std::memory_order_relaxed );
+    R.atT.store( getTime(), std::memory_order_relaxed );
+}
+
+
+void AIQ::readerStats( QVector<ReaderStat> &vS ) const
+{
+    QMutexLocker    ml( &tapMtx );
+
+    int     nr  = nReaders.load( std::memory_order_acquire );
+    quint64 end = endCt.load( std::memory_order_acquire );
+    double  now = getTime(),
+            cap = capacitySecs();
+
+    vS.clear();
+    vS.reserve( nr );
+
+    for( int ir = 0; ir < nr; ++ir ) {
+
+        const Reader    &R  = readers[ir];
+
+        if( R.name.isEmpty() )
+            continue;
+
+        vS.push_back( ReaderStat() );
+
+        ReaderStat      &S  = vS.back();
+        quint64         ct  = R.atCt.load( std::memory_order_relaxed );
+
+        S.name      = R.name;
+        S.lagSecs   = (end > ct ? (end - ct) / srate : 0);
+        S.fillPct   = 100.0 * S.lagSecs / cap;
+        S.idleSecs  = now - R.atT.load( std::memory_order_relaxed );
+    }
+}
+
+
+// Ask producer to index rising edges of the sync signal,
+// given as (chan, bit) for digital, or (chan, -1, thresh)
+// for analog. Indexing starts with the next enqueued block.
+// Only one sync signal per stream; later calls naming the
+// same signal are no-ops.
+//
+// Return true if index now enabled for this signal.
+//
+bool AIQ::enableSyncIndex(
+    int             chan,
+    int             bit,
+    qint16          thresh,
+    double          period ) const
+{
+    QMutexLocker    ml( &tapMtx );
+
+    AIQSyncIdx  *X = syIdx.load( std::memory_order_relaxed );
+
+    if( X )
+        return X->sameAs( chan, bit, thresh );
+
+    if( period <= 0 )
+        return false;
+
+    syIdx.store(
+        new AIQSyncIdx( srate, nchans, chan, bit, thresh, period ),
+        std::memory_order_release );
+
+    return true;
+}
+
+
+// Find first indexed sync edge with count >= fromCt.
+//
+bool AIQ::syncEdgeFrom( quint64 &edgeCt, quint64 fromCt ) const
+{
+    AIQSyncIdx  *X = syIdx.load( std::memory_order_acquire );
+
+    return X && X->edgeFrom( edgeCt, fromCt );
+}
+
+
+// Find last indexed sync edge with count <= ct.
+//
+bool AIQ::syncEdgeBefore( quint64 &edgeCt, quint64 ct ) const
+{
+    AIQSyncIdx  *X = syIdx.load( std::memory_order_acquire );
+
+    return X && X->edgeBefore( edgeCt, ct );
+}
+
+
+// True if sync index holds every edge from fromCt on, so a
+// failed lookup means no edge has arrived there yet.
+//
+bool AIQ::syncIndexCovers( quint64 fromCt ) const
+{
+    AIQSyncIdx  *X = syIdx.load( std::memory_order_acquire );
+
+    return X && X->covers( fromCt );
+}
+
+
+// Drift-corrected map of (fractional) count to stream time
+// using sync edge index; falls back to nominal srate.
+//
+// Return true if sync index was used.
+//
+bool AIQ::mapCt2TimeSync( double &t, double ct ) const
+{
+    AIQSyncIdx  *X = syIdx.load( std::memory_order_acquire );
+
+    if( X && X->ct2Time( t, ct ) )
+        return true;
+
+    t = tzero + ct / srate;
+    return false;
+}
+
+
+// Drift-corrected map of stream time to (fractional) count
+// using sync edge index; falls back to nominal srate.
+//
+// Return true if sync index was used.
+//
+bool AIQ::mapTime2CtSync( double &ct, double t ) const
+{
+    AIQSyncIdx  *X = syIdx.load( std::memory_order_acquire );
+
+    if( X && X->time2Ct( ct, t ) )
+        return true;
+
+    ct = (t - tzero) * srate;
+    return false;
+}
+
+
+// Running sample rate calibrated against the sync pulser,
+// and the span of sync time it is measured over. Error is
+// of order one count per span.
+//
+// Return false if sync index not enabled or < 2 edges.
+//
+bool AIQ::syncRate( double &rate, double &spanSecs ) const
+{
+    AIQSyncIdx  *X = syIdx.load( std::memory_order_acquire );
+
+    return X && X->rate( rate, spanSecs );
+}
+
+
+// Producer only: log hardware timestamp hw of the block about
+// to be enqueued (its first scan is endCount()), taken at app
+// time t. The log is made on first use.
+//
+void AIQ::addStamp( quint32 hw, double t )
+{
+    AIQStampLog *L = stLog.load( std::memory_order_relaxed );
+
+    if( !L ) {
+        L = new AIQStampLog;
+        stLog.store( L, std::memory_order_release );
+    }
+
+    L->add( endCt.load( std::memory_order_relaxed ), hw, t );
+}
+
+
+// Append logged block stamps covering counts [fromCt,toCt):
+// those starting in the span and the one fromCt falls in.
+//
+// Return count appended; zero if producer doesn't log stamps
+// or the span has aged out of the log.
+//
+int AIQ::getStamps(
+    std::vector<Stamp>  &v,
+    quint64             fromCt,
+    quint64             toCt ) const
+{
+    AIQStampLog *L = stLog.load( std::memory_order_acquire );
+
+    return (L ? L->get( v, fromCt, toCt ) : 0);
+}
+
+
+// Fill with (tLim-t0)*srate zero samples.
+//
+// Zero-fill the interval [t0,tLim) as a gap record, so even a
+// multi-second gap costs no ring writes here; readers expand it.
+// If all gap records are still live, fall back to writing zeros.
+//
+void AIQ::enqueueZero( double t0, double tLim )
+{
+    int     nCts    = (tLim - t0) * srate;
+    quint64 end     = endCt.load( std::memory_order_relaxed ),
+            wr      = end + nCts;
+
+    if( nCts <= 0 )
+        return;
+
+    publishBegin( wr );
+
+    if( zblk.empty() )
+        zblk.assign( SAMPS(ZEROBLK), 0 );
+
+    int ng  = nGaps.load( std::memory_order_relaxed );
+    Gap &G  = gaps[ng % MAXGAPS];
+
+    // Shared-ring readers can't see gap records
+
+    if( shmH
+        || (ng >= MAXGAPS
+            && G.ct1.load( std::memory_order_relaxed ) > safeHeadCt()) ) {
+
+        writeZeros( end, wr );
+    }
+    else {
+        // Readers seeing ct0 >= ct1 ignore entry
+
+        G.ct1.store( 0, std::memory_order_relaxed );
+        G.ct0.store( end, std::memory_order_relaxed );
+        G.ct1.store( wr, std::memory_order_release );
+        nGaps.store( ng + 1, std::memory_order_release );
+    }
+
+    int nt = nTaps.load( std::memory_order_acquire );
+
+    for( int it = 0; it < nt; ++it ) {
+        if( taps[it].fromCt.load( std::memory_order_relaxed ) == UNSET64 )
+            taps[it].fromCt.store( end, std::memory_order_relaxed );
+    }
+
+    publishEnd( wr );
+}
+
+
+void AIQ::enqueue( const qint16 *src, int nCts )
+{
+    quint64 wr = endCt.load( std::memory_order_relaxed ) + nCts;
+
+    publishBegin( wr );
+    writeBlock( src, nCts );
+    publishEnd( wr );
+}
+
+
+// Commit one block to each of nQ queues (nCts[i] may be 0)
+// as a unit: all wrCt claims are made first, then all data
+// are copied, then all endCt heads are published back-to-back.
+// A consumer reading several queues (e.g. probes served by a
+// single acquisition thread) thus sees their heads advance
+// together, rather than staggered by each other's copy time.
+//
+// Each queue must have this thread as its sole producer.
+//
+void AIQ::enqueueBatch(
+    AIQ* const          *Q,
+    const qint16* const *src,
+    const int           *nCts,
+    int                 nQ )
+{
+    for( int i = 0; i < nQ; ++i ) {
+        if( nCts[i] ) {
+            Q[i]->publishBegin(
+                Q[i]->endCt.load( std::memory_order_relaxed ) + nCts[i] );
+        }
+    }
+
+    for( int i = 0; i < nQ; ++i ) {
+        if( nCts[i] )
+            Q[i]->writeBlock( src[i], nCts[i] );
+    }
+
+    for( int i = 0; i < nQ; ++i ) {
+        if( nCts[i] )
+            Q[i]->publishEnd( Q[i]->wrCt.load( std::memory_order_relaxed ) );
+    }
+}
+
+
+// Return headCt at front of queue.
+//
+quint64 AIQ::qHeadCt() const
+{
+    return std::min( safeHeadCt(), endCt.load( std::memory_order_acquire ) );
+}
+
+
+// Return count of scans since run start.
+//
+quint64 AIQ::endCount() const
+{
+    return endCt.load( std::memory_order_acquire );
+}
+
+
+// Block until scans through count ct are enqueued, or ms pass,
+// so consumers wake on data arrival rather than polling. The
+// producer signals only while someone waits; otherwise its cost
+// is one fence and load per block.
+//
+// Return true if ct reached.
+//
+bool AIQ::waitForCt( quint64 ct, int ms ) const
+{
+    if( endCt.load( std::memory_order_acquire ) >= ct )
+        return true;
+
+    double  tEnd = getTime() + 0.001 * ms;
+    bool    ok;
+
+    // Registering before the check pairs with the fence in
+    // publishEnd: either we see the new endCt, or it sees us.
+
+    nWaiters.fetch_add( 1 );
+
+    waitMtx.lock();
+
+        for(;;) {
+
+            double  tLeft;
+
+            if( (ok = endCt.load() >= ct) )
+                break;
+
+            if( (tLeft = tEnd - getTime()) <= 0 )
+                break;
+
+            condNew.wait( &waitMtx, qMax( 1UL, (unsigned long)(1000 * tLeft) ) );
+        }
+
+    waitMtx.unlock();
+
+    nWaiters.fetch_sub( 1 );
+
+    return ok;
+}
+
+
+// Return stream's current wall time.
+//
+double AIQ::endTime() const
+{
+    return tzero + endCount() / srate;
+}
+
+
+// App time scan ct was enqueued, estimated from the latest
+// publish at srate (for ct > endCt, when it will be).
+//
+double AIQ::enqTime( quint64 ct ) const
+{
+    quint64 end = endCt.load( std::memory_order_acquire ),
+            us  = endUs.load( std::memory_order_relaxed );
+
+    return 1e-6 * us - (double(end) - double(ct) - 1) / srate;
+}
+
+
+// Map given time to corresponding count.
+// Return {-2=way left, -1=left, 0=inside, 1=right} of stream.
+//
+int AIQ::mapTime2Ct( quint64 &ct, double t ) const
+{
+    ct = 0;
+
+    quint64 end = endCount();
+
+    if( t < tzero || !end )
+        return -2;
+
+    quint64 C = (t - tzero) * srate;
+
+    if( C >= end )
+        return 1;
+
+    if( C < safeHeadCt() )
+        return -1;
+
+    ct = C;
+
+    return 0;
+}
+
+
+// Map given count to corresponding time.
+// Return {-2=way left, -1=left, 0=inside, 1=right} of stream.
+//
+int AIQ::mapCt2Time( double &t, quint64 ct ) const
+{
+    t = 0;
+
+    quint64 end = endCount();
+
+    if( !end )
+        return -2;
+
+    if( ct >= end )
+        return 1;
+
+    if( ct < safeHeadCt() )
+        return -1;
+
+    t = tzero + ct / srate;
+
+    return 0;
+}
+
+
+// Copy up to N scans with count >= fromCt.
+//
+// On entry dest should be cleared and reserved to nominal size.
+//
+// Return {-1=left of stream, 0=fail, 1=success}.
+//
+int AIQ::getNScansFromCtProfile(
+    double          &pctFromLeft,
+    vec_i16         &dest,
+    quint64         fromCt,
+    int             nMax ) const
+{
+    quint64 end     = endCount(),
+            headCt  = safeHeadCt();
+
+    if( fromCt >= end ) {
+        pctFromLeft = 101.0;
+        return 1;
+    }
+
+    if( fromCt < headCt ) {
+        int ret = histScans( dest, fromCt, nMax );
+        pctFromLeft = (ret > 0 ? 0.0 : -1.0);
+        return ret;
+    }
+
+    pctFromLeft = 100.0 * (fromCt - headCt) / (end - headCt);
+
+    int     head    = slot( fromCt );
+    size_t  size0   = dest.size();
+
+    nMax = int(std::min( quint64(nMax), end - fromCt ));
+
+    int nGet = nMax;
+
+// Get up to RHS limit
+
+    int nrhs = nContig( head, nMax );
+
+    try {
+        dest.insert(
+            dest.end(),
+            buf + SAMPS(head),
+            buf + SAMPS(head + nrhs) );
+    }
+    catch( const std::exception& ) {
+        Warning()
+            << "AIQ::nScans low mem. SRate " << srate;
+        return 0;
+    }
+
+// Get any remainder from LHS
+
+    if( nMax -= nrhs ) {
+
+        try {
+            dest.insert(
+                dest.end(),
+                buf,
+                buf + SAMPS(nMax) );
+        }
+        catch( const std::exception& ) {
+            Warning()
+                << "AIQ::nScans low mem. SRate " << srate;
+            return 0;
+        }
+    }
+
+// Overrun while copying?
+
+    zeroGaps( &dest[size0], fromCt, nGet, nchans );
+
+    if( !isIntact( fromCt ) ) {
+        dest.resize( size0 );
+        int ret = histScans( dest, fromCt, nGet );
+        pctFromLeft = (ret > 0 ? 0.0 : -1.0);
+        return ret;
+    }
+
+    return 1;
+}
+
+
+// Copy up to N scans with count >= fromCt.
+//
+// On entry dest should be cleared and reserved to nominal size.
+//
+// Return {-1=left of stream, 0=fail, 1=success}.
+//
+int AIQ::getNScansFromCt(
+    vec_i16         &dest,
+    quint64         fromCt,
+    int             nMax ) const
+{
+    quint64 end = endCount();
+
+    if( fromCt >= end )
+        return 1;
+
+    if( fromCt < safeHeadCt() )
+        return histScans( dest, fromCt, nMax );
+
+    int     head    = slot( fromCt );
+    size_t  size0   = dest.size();
+
+    nMax = int(std::min( quint64(nMax), end - fromCt ));
+
+    int nGet = nMax;
+
+// Get up to RHS limit
+
+    int nrhs = nContig( head, nMax );
+
+    try {
+        dest.insert(
+            dest.end(),
+            buf + SAMPS(head),
+            buf + SAMPS(head + nrhs) );
     }
     catch( const std::exception& ) {
         Warning()
@@ -503,8 +2073,8 @@ int AIQ::getNScansFromCt(
         try {
             dest.insert(
                 dest.end(),
-                buf.begin(),
-                buf.begin() + SAMPS(nMax) );
+                buf,
+                buf + SAMPS(nMax) );
         }
         catch( const std::exception& ) {
             Warning()
@@ -513,6 +2083,74 @@ int AIQ::getNScansFromCt(
         }
     }
 
+// Overrun while copying?
+
+    zeroGaps( &dest[size0], fromCt, nGet, nchans );
+
+    if( !isIntact( fromCt ) ) {
+        dest.resize( size0 );
+        return histScans( dest, fromCt, nGet );
+    }
+
+    return 1;
+}
+
+
+// Describe in place up to N scans with count >= fromCt.
+// Gaps are described by a block of zero scans, so a view
+// may hold fewer scans than are available.
+//
+// Caller processes V.span[] directly, and afterward must
+// confirm with isIntact( V ) that the data were not overrun.
+//
+// Return {-1=left of stream, 1=success}.
+//
+int AIQ::getView(
+    View            &V,
+    quint64         fromCt,
+    int             nMax ) const
+{
+    V = View();
+    V.fromCt = fromCt;
+
+    if( nMax <= 0 )
+        return 1;
+
+    quint64 end = endCount();
+
+    if( fromCt >= end )
+        return 1;
+
+    if( fromCt < safeHeadCt() )
+        return -1;
+
+    int     head = slot( fromCt );
+    quint64 g0, g1;
+
+    nMax = int(std::min( quint64(nMax), end - fromCt ));
+
+// Present gap as zero block, or stop short of it
+
+    if( findGap( g0, g1, fromCt, nMax ) ) {
+
+        if( g0 <= fromCt ) {
+            V.span[0]   = &zblk[0];
+            V.nspan[0]  = int(std::min( quint64(std::min( nMax, int(ZEROBLK) )),
+                            g1 - fromCt ));
+            return 1;
+        }
+
+        nMax = int(g0 - fromCt);
+    }
+
+    V.span[0]   = &buf[SAMPS(head)];
+    V.nspan[0]  = nContig( head, nMax );
+
+    if( (nMax -= V.nspan[0]) ) {
+        V.span[1]   = &buf[0];
+        V.nspan[1]  = nMax;
+    }
+
     return 1;
 }
 
@@ -531,38 +2169,27 @@ qint64 AIQ::getNScansFromCtMono(
     int             nScans,
     int             chan ) const
 {
-    QMutexLocker    ml( &QMtx );
-
-    quint64 headCt = endCt - buflen;
+    quint64 end = endCount();
 
 // Off left end?
 
-    if( fromCt < headCt )
+    if( fromCt < safeHeadCt() )
         return -1;
 
 // Enough samples available?
 
-    int offset  = fromCt - headCt,
-        head    = (bufhead + offset) % bufmax,
-        len     = buflen - offset;
-
-    if( len < nScans )
+    if( fromCt + nScans > end )
         return -1;
 
-// Get up to RHS limit
-
-    int             nrhs = std::min( nScans, bufmax - head );
-    const qint16    *src = &buf[SAMPS(head) + chan];
-
-    for( int i = 0; i < nrhs; ++i, src += nchans )
-        dst[i] = *src;
+// Contiguous tap or strided ring
 
-// Get any remainder from LHS
+    const qint16    *src = gatherChan( dst, fromCt, nScans, chan );
 
-    src = &buf[chan];
+    if( src != dst )
+        memcpy( dst, src, nScans * sizeof(qint16) );
 
-    for( int i = nrhs; i < nScans; ++i, src += nchans )
-        dst[i] = *src;
+    if( !isIntact( fromCt ) )
+        return -1;
 
     return fromCt;
 }
@@ -583,30 +2210,52 @@ qint64 AIQ::getNScansFromCtStereo(
     int             chan1,
     int             chan2 ) const
 {
-    QMutexLocker    ml( &QMtx );
-
-    quint64 headCt = endCt - buflen;
+    quint64 end = endCount();
 
 // Off left end?
 
-    if( fromCt < headCt )
+    if( fromCt < safeHeadCt() )
         return -1;
 
 // Enough samples available?
 
-    int offset  = fromCt - headCt,
-        head    = (bufhead + offset) % bufmax,
-        len     = buflen - offset;
-
-    if( len < nScans )
+    if( fromCt + nScans > end )
         return -1;
 
+    int             head = slot( fromCt ),
+                    nrhs = std::min( nScans, bufmax - head ),
+                    nGet = nScans;
+    const Tap       *T1  = findTap( chan1, fromCt ),
+                    *T2  = findTap( chan2, fromCt );
+    qint16          *dst0 = dst;
+
+// Contiguous taps
+
+    if( T1 && T2 ) {
+
+        const qint16    *s1 = &T1->data[head],
+                        *s2 = &T2->data[head];
+
+        for( int i = 0; i < nScans; ++i ) {
+
+            if( i == nrhs ) {
+                s1 = &T1->data[0];
+                s2 = &T2->data[0];
+            }
+
+            *dst++ = *s1++;
+            *dst++ = *s2++;
+        }
+
+        goto validate;
+    }
+
 // Get up to RHS limit
 
-    int             nrhs = std::min( nScans, bufmax - head );
+    {
     const qint16    *src = &buf[SAMPS(head)];
 
-    nrhs   *= 2;
+    nrhs    = 2 * nContig( head, nScans );
     nScans *= 2;
 
     for( int i = 0; i < nrhs; i += 2, src += nchans ) {
@@ -622,6 +2271,13 @@ qint64 AIQ::getNScansFromCtStereo(
         dst[i]   = src[chan1];
         dst[i+1] = src[chan2];
     }
+    }
+
+validate:
+    zeroGaps( dst0, fromCt, nGet, 2 );
+
+    if( !isIntact( fromCt ) )
+        return -1;
 
     return fromCt;
 }
@@ -689,80 +2345,7 @@ bool AIQ::findRisingEdge(
     qint16          T,
     int             inarow ) const
 {
-    int nok = 0;
-
-    outCt = fromCt;
-
-    QMutexLocker    ml( &QMtx );
-
-    RingWalker  W( buf, bufmax, bufhead, buflen, nchans, chan );
-
-    if( !W.setStart( fromCt, endCt ) )
-        return false;
-
-// -------------------
-// Must start on a low
-// -------------------
-
-    if( *W.cur >= T ) {
-
-        while( W.next() ) {
-
-            if( *W.cur < T )
-                goto seek_edge;
-        }
-
-        goto fail;
-    }
-
-// -------------------
-// Seek edge candidate
-// -------------------
-
-seek_edge:
-    while( W.next() ) {
-
-        if( *W.cur >= T ) {
-
-            // Mark edge start
-            outCt   = W.curCt();
-            nok     = 1;
-
-            if( inarow == 1 )
-                return true;
-
-            // Check extended run length
-            while( W.next() ) {
-
-                if( *W.cur >= T ) {
-
-                    if( ++nok >= inarow )
-                        return true;
-                }
-                else {
-                    nok = 0;
-                    break;
-                }
-            }
-        }
-    }
-
-// ----
-// Fail
-// ----
-
-// Back off to pre-transition level for next time.
-// Notes:
-// - outCt (found edge mark) always > 0 by policy.
-// - endCt always > 0 because GateBase waits for samples.
-
-fail:
-    if( nok )
-        outCt -= 1;
-    else
-        outCt = endCt - 1;
-
-    return false;
+    return findEdge( outCt, fromCt, chan, edgeGE, T, 0, inarow );
 }
 
 
@@ -787,11 +2370,11 @@ bool AIQ::findFltRisingEdge(
 
     outCt = fromCt;
 
-    QMutexLocker    ml( &QMtx );
+    quint64 end = endCount();
 
-    RingFltWalker  W( buf, bufmax, bufhead, buflen, nchans, usrFlt );
+    RingFltWalker  W( *this, buf, bufmax, nchans, usrFlt );
 
-    if( !W.setStart( fromCt, endCt ) )
+    if( !W.setStart( fromCt, safeHeadCt(), end ) )
         return false;
 
 // -------------------
@@ -823,7 +2406,7 @@ seek_edge:
             nok     = 1;
 
             if( inarow == 1 )
-                return true;
+                goto found;
 
             // Check extended run length
             while( W.next() ) {
@@ -831,7 +2414,7 @@ seek_edge:
                 if( *W.cur >= T ) {
 
                     if( ++nok >= inarow )
-                        return true;
+                        goto found;
                 }
                 else {
                     nok = 0;
@@ -841,22 +2424,11 @@ seek_edge:
         }
     }
 
-// ----
-// Fail
-// ----
-
-// Back off to pre-transition level for next time.
-// Notes:
-// - outCt (found edge mark) always > 0 by policy.
-// - endCt always > 0 because GateBase waits for samples.
-
 fail:
-    if( nok )
-        outCt -= 1;
-    else
-        outCt = endCt - 1;
+    return edgeEnd( outCt, nok, false, W.checkCt(), end );
 
-    return false;
+found:
+    return edgeEnd( outCt, nok, true, W.checkCt(), end );
 }
 
 
@@ -877,83 +2449,31 @@ bool AIQ::findBitRisingEdge(
     int             bit,
     int             inarow ) const
 {
-    int nok = 0;
-
-    outCt = fromCt;
-
-    QMutexLocker    ml( &QMtx );
-
-    RingWalker  W( buf, bufmax, bufhead, buflen, nchans, chan );
-
-    if( !W.setStart( fromCt, endCt ) )
-        return false;
-
-// -------------------
-// Must start on a low
-// -------------------
-
-    if( (*W.cur >> bit) & 1 ) {
-
-        while( W.next() ) {
-
-            if( !((*W.cur >> bit) & 1) )
-                goto seek_edge;
-        }
-
-        goto fail;
-    }
-
-// -------------------
-// Seek edge candidate
-// -------------------
-
-seek_edge:
-    while( W.next() ) {
-
-        if( (*W.cur >> bit) & 1 ) {
-
-            // Mark edge start
-            outCt   = W.curCt();
-            nok     = 1;
-
-            if( inarow == 1 )
-                return true;
-
-            // Check extended run length
-            while( W.next() ) {
-
-                if( (*W.cur >> bit) & 1 ) {
-
-                    if( ++nok >= inarow )
-                        return true;
-                }
-                else {
-                    nok = 0;
-                    break;
-                }
-            }
-        }
-    }
-
-// ----
-// Fail
-// ----
-
-// Back off to pre-transition level for next time.
-// Notes:
-// - outCt (found edge mark) always > 0 by policy.
-// - endCt always > 0 because GateBase waits for samples.
+    return findEdge( outCt, fromCt, chan, edgeBitHi, 0, bit, inarow );
+}
 
-fail:
-    if( nok )
-        outCt -= 1;
-    else
-        outCt = endCt - 1;
 
-    return false;
+// Starting from fromCt, scan given chan for falling edge
+// (from above to < T). Including first crossing, require
+// signal stays < T for at least inarow counts.
+//
+// Return:
+// false = no edge; resume looking from outCt.
+// true  = edge @ outCt.
+//
+bool AIQ::findFallingEdge(
+    quint64         &outCt,
+    quint64         fromCt,
+    int             chan,
+    qint16          T,
+    int             inarow ) const
+{
+    return findEdge( outCt, fromCt, chan, edgeLT, T, 0, inarow );
 }
 
 
+// Acting on filtered data via callback usrFlt...
+//
 // Starting from fromCt, scan given chan for falling edge
 // (from above to < T). Including first crossing, require
 // signal stays < T for at least inarow counts.
@@ -962,22 +2482,22 @@ fail:
 // false = no edge; resume looking from outCt.
 // true  = edge @ outCt.
 //
-bool AIQ::findFallingEdge(
+bool AIQ::findFltFallingEdge(
     quint64         &outCt,
     quint64         fromCt,
-    int             chan,
     qint16          T,
-    int             inarow ) const
+    int             inarow,
+    T_AIQFilter     &usrFlt ) const
 {
     int nok = 0;
 
     outCt = fromCt;
 
-    QMutexLocker    ml( &QMtx );
+    quint64 end = endCount();
 
-    RingWalker  W( buf, bufmax, bufhead, buflen, nchans, chan );
+    RingFltWalker  W( *this, buf, bufmax, nchans, usrFlt );
 
-    if( !W.setStart( fromCt, endCt ) )
+    if( !W.setStart( fromCt, safeHeadCt(), end ) )
         return false;
 
 // --------------------
@@ -1009,7 +2529,7 @@ seek_edge:
             nok     = 1;
 
             if( inarow == 1 )
-                return true;
+                goto found;
 
             // Check extended run length
             while( W.next() ) {
@@ -1017,7 +2537,7 @@ seek_edge:
                 if( *W.cur < T ) {
 
                     if( ++nok >= inarow )
-                        return true;
+                        goto found;
                 }
                 else {
                     nok = 0;
@@ -1027,208 +2547,471 @@ seek_edge:
         }
     }
 
-// ----
-// Fail
-// ----
-
-// Back off to pre-transition level for next time.
-// Notes:
-// - outCt (found edge mark) always > 0 by policy.
-// - endCt always > 0 because GateBase waits for samples.
-
 fail:
-    if( nok )
-        outCt -= 1;
-    else
-        outCt = endCt - 1;
+    return edgeEnd( outCt, nok, false, W.checkCt(), end );
 
-    return false;
+found:
+    return edgeEnd( outCt, nok, true, W.checkCt(), end );
 }
 
 
-// Acting on filtered data via callback usrFlt...
+// Using specified digital bit within a word...
 //
 // Starting from fromCt, scan given chan for falling edge
-// (from above to < T). Including first crossing, require
-// signal stays < T for at least inarow counts.
+// (1 -> 0). Including first crossing, require
+// signal stays low for at least inarow counts.
 //
 // Return:
 // false = no edge; resume looking from outCt.
 // true  = edge @ outCt.
 //
-bool AIQ::findFltFallingEdge(
+bool AIQ::findBitFallingEdge(
     quint64         &outCt,
     quint64         fromCt,
-    qint16          T,
-    int             inarow,
-    T_AIQFilter     &usrFlt ) const
+    int             chan,
+    int             bit,
+    int             inarow ) const
 {
-    int nok = 0;
+    return findEdge( outCt, fromCt, chan, edgeBitLo, 0, bit, inarow );
+}
 
-    outCt = fromCt;
 
-    QMutexLocker    ml( &QMtx );
+// Edge kernel for other scanners (e.g. indexing file edges):
+// bit i of bits[] set if bit 'bit' of src[i] is set, for
+// contiguous src[0..n), n <= EDGETILE (512).
+//
+void AIQ::bitMask512(
+    quint64         bits[8],
+    const qint16    *src,
+    int             n,
+    int             bit )
+{
+    edgeMask( bits, src, qMin( n, EDGETILE ), edgeBitHi, 0, bit );
+}
 
-    RingFltWalker  W( buf, bufmax, bufhead, buflen, nchans, usrFlt );
 
-    if( !W.setStart( fromCt, endCt ) )
-        return false;
+// As bitMask512, but bit i set if src[i] >= T.
+//
+void AIQ::threshMask512(
+    quint64         bits[8],
+    const qint16    *src,
+    int             n,
+    qint16          T )
+{
+    edgeMask( bits, src, qMin( n, EDGETILE ), edgeGE, T, 0 );
+}
 
-// --------------------
-// Must start on a high
-// --------------------
+/* ---------------------------------------------------------------- */
+/* Private -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
 
-    if( *W.cur < T ) {
+// Announce that slots for counts up to wr are being overwritten,
+// first packing any doomed blocks into history.
+// The release fence orders this store before the data writes.
+//
+void AIQ::publishBegin( quint64 wr )
+{
+    if( hist ) {
+        hist->evict(
+            *this, buf, bufmax, endCt.load( std::memory_order_relaxed ), wr );
+    }
 
-        while( W.next() ) {
+    wrCt.store( wr, std::memory_order_relaxed );
 
-            if( *W.cur >= T )
-                goto seek_edge;
-        }
+    if( shmH )
+        shmH->wrCt.store( wr, std::memory_order_relaxed );
 
-        goto fail;
+    std::atomic_thread_fence( std::memory_order_release );
+}
+
+
+// Make data up to wr visible to readers.
+//
+void AIQ::publishEnd( quint64 wr )
+{
+    quint64 us = quint64(1e6 * getTime());
+
+    endUs.store( us, std::memory_order_relaxed );
+    endCt.store( wr, std::memory_order_release );
+
+    if( shmH ) {
+        shmH->endUs.store( us, std::memory_order_relaxed );
+        shmH->endCt.store( wr, std::memory_order_release );
     }
 
-// -------------------
-// Seek edge candidate
-// -------------------
+    std::atomic_thread_fence( std::memory_order_seq_cst );
 
-seek_edge:
-    while( W.next() ) {
+    if( nWaiters.load( std::memory_order_relaxed ) ) {
+        waitMtx.lock();
+            condNew.wakeAll();
+        waitMtx.unlock();
+    }
+}
 
-        if( *W.cur < T ) {
 
-            // Mark edge start
-            outCt   = W.curCt();
-            nok     = 1;
+// Producer only: copy nCts scans to ring at current endCt.
+//
+void AIQ::writeBlock( const qint16 *src, int nCts )
+{
+    quint64 end = endCt.load( std::memory_order_relaxed );
 
-            if( inarow == 1 )
-                return true;
+    if( nCts >= bufmax ) {
+        // Keep only newest bufmax-worth.
+        src += SAMPS(nCts - bufmax);
+        end += nCts - bufmax;
+        nCts = bufmax;
+    }
 
-            // Check extended run length
-            while( W.next() ) {
+    int oldtail = slot( end ),
+        ncpy1   = nContig( oldtail, nCts );
 
-                if( *W.cur < T ) {
+    memcpy( &buf[SAMPS(oldtail)], &src[0], BYTES(ncpy1) );
 
-                    if( ++nok >= inarow )
-                        return true;
-                }
-                else {
-                    nok = 0;
-                    break;
-                }
-            }
+    if( nCts - ncpy1 )
+        memcpy( &buf[0], &src[SAMPS(ncpy1)], BYTES(nCts - ncpy1) );
+
+    writeTaps( src, end, nCts );
+
+    AIQSyncIdx  *X = syIdx.load( std::memory_order_acquire );
+
+    if( X )
+        X->scan( src, end, nCts, tzero );
+}
+
+
+// Producer only: write zeros to ring and taps for [fromCt,toCt).
+//
+void AIQ::writeZeros( quint64 fromCt, quint64 toCt )
+{
+    if( toCt - fromCt > quint64(bufmax) )
+        fromCt = toCt - bufmax;
+
+    int nCts    = int(toCt - fromCt),
+        oldtail = slot( fromCt ),
+        ncpy1   = std::min( nCts, bufmax - oldtail ),
+        ncpy2   = nCts - ncpy1,
+        nring   = nContig( oldtail, nCts ),
+        nt      = nTaps.load( std::memory_order_acquire );
+
+    memset( &buf[SAMPS(oldtail)], 0, BYTES(nring) );
+
+    if( nCts - nring )
+        memset( &buf[0], 0, BYTES(nCts - nring) );
+
+    for( int it = 0; it < nt; ++it ) {
+
+        qint16  *T = &taps[it].data[0];
+
+        memset( &T[oldtail], 0, ncpy1 * sizeof(qint16) );
+
+        if( ncpy2 )
+            memset( T, 0, ncpy2 * sizeof(qint16) );
+    }
+}
+
+
+// Producer only: extract tapped channels from src block,
+// whose first scan has count fromCt.
+//
+void AIQ::writeTaps( const qint16 *src, quint64 fromCt, int nCts )
+{
+    int nt = nTaps.load( std::memory_order_acquire );
+
+    if( !nt )
+        return;
+
+    int tail    = slot( fromCt ),
+        ncpy1   = std::min( nCts, bufmax - tail );
+
+    for( int it = 0; it < nt; ++it ) {
+
+        Tap             &T  = taps[it];
+        qint16          *D  = &T.data[tail];
+        const qint16    *S  = &src[T.chan];
+
+        for( int i = 0; i < ncpy1; ++i, S += nchans )
+            *D++ = *S;
+
+        D = &T.data[0];
+
+        for( int i = ncpy1; i < nCts; ++i, S += nchans )
+            *D++ = *S;
+
+        // Tap valid from first block it receives.
+        // Published to readers by publishEnd().
+
+        if( T.fromCt.load( std::memory_order_relaxed ) == UNSET64 )
+            T.fromCt.store( fromCt, std::memory_order_relaxed );
+    }
+}
+
+
+// Return tap for chan if it covers counts >= fromCt, else 0.
+// Caller must have already loaded endCount() (acquire), so
+// tap data up to that count are visible.
+//
+const AIQ::Tap *AIQ::findTap( int chan, quint64 fromCt ) const
+{
+    int nt = nTaps.load( std::memory_order_acquire );
+
+    for( int it = 0; it < nt; ++it ) {
+
+        const Tap   &T = taps[it];
+
+        if( T.chan == chan )
+            return (fromCt >= T.fromCt.load( std::memory_order_acquire ) ? &T : 0);
+    }
+
+    return 0;
+}
+
+
+// Oldest count not being overwritten by the producer.
+//
+quint64 AIQ::safeHeadCt() const
+{
+    quint64 wr = wrCt.load( std::memory_order_acquire );
+
+    return (wr > quint64(bufmax) ? wr - bufmax : 0);
+}
+
+
+// Call after reading ring data starting at fromCt.
+// Return true if producer has not since overwritten that data.
+//
+// Edge finders hold no lock across a scan; walkers call this
+// per block so a lapped scan aborts promptly.
+//
+bool AIQ::isIntact( quint64 fromCt ) const
+{
+    std::atomic_thread_fence( std::memory_order_acquire );
+
+    quint64 wr = wrCt.load( std::memory_order_relaxed );
+
+    return wr <= quint64(bufmax) || fromCt >= wr - bufmax;
+}
+
+
+// Get earliest gap overlapping n scans from fromCt.
+// Return false if none.
+//
+bool AIQ::findGap( quint64 &g0, quint64 &g1, quint64 fromCt, int n ) const
+{
+    int     ng      = nGaps.load( std::memory_order_acquire ),
+            lim     = std::max( 0, ng - MAXGAPS );
+    quint64 toCt    = fromCt + n;
+    bool    found   = false;
+
+    for( int ig = ng - 1; ig >= lim; --ig ) {
+
+        const Gap   &G  = gaps[ig % MAXGAPS];
+        quint64     c1  = G.ct1.load( std::memory_order_acquire ),
+                    c0  = G.ct0.load( std::memory_order_relaxed );
+
+        if( c0 >= c1 )
+            continue;
+
+        if( c1 <= fromCt )
+            break;
+
+        if( c0 < toCt ) {
+            g0      = c0;
+            g1      = c1;
+            found   = true;
         }
     }
 
-// ----
-// Fail
-// ----
+    return found;
+}
 
-// Back off to pre-transition level for next time.
-// Notes:
-// - outCt (found edge mark) always > 0 by policy.
-// - endCt always > 0 because GateBase waits for samples.
 
-fail:
-    if( nok )
-        outCt -= 1;
-    else
-        outCt = endCt - 1;
+// Zero the parts of dst (n scans from fromCt, perScan values
+// each) that lie in gaps. Call after copying from the ring and
+// before isIntact().
+//
+void AIQ::zeroGaps(
+    qint16          *dst,
+    quint64         fromCt,
+    int             n,
+    int             perScan ) const
+{
+    int     ng      = nGaps.load( std::memory_order_acquire ),
+            lim     = std::max( 0, ng - MAXGAPS );
+    quint64 toCt    = fromCt + n;
 
-    return false;
+    for( int ig = ng - 1; ig >= lim; --ig ) {
+
+        const Gap   &G  = gaps[ig % MAXGAPS];
+        quint64     c1  = G.ct1.load( std::memory_order_acquire ),
+                    c0  = G.ct0.load( std::memory_order_relaxed );
+
+        if( c0 >= c1 )
+            continue;
+
+        if( c1 <= fromCt )
+            break;
+
+        quint64 a = std::max( c0, fromCt ),
+                b = std::min( c1, toCt );
+
+        if( a < b ) {
+            memset( &dst[(a - fromCt) * perScan], 0,
+                (b - a) * perScan * sizeof(qint16) );
+        }
+    }
 }
 
 
-// Using specified digital bit within a word...
+// Get n scans of one channel from ring, starting at fromCt.
+// Where the channel is tapped and doesn't wrap, return pointer
+// directly into tap; else fill dst and return dst.
 //
-// Starting from fromCt, scan given chan for falling edge
-// (1 -> 0). Including first crossing, require
-// signal stays low for at least inarow counts.
+const qint16 *AIQ::gatherChan(
+    qint16          *dst,
+    quint64         fromCt,
+    int             n,
+    int             chan ) const
+{
+    quint64         g0, g1;
+    int             head = slot( fromCt ),
+                    nrhs = std::min( n, bufmax - head );
+    const Tap       *T   = findTap( chan, fromCt );
+    bool            gap  = findGap( g0, g1, fromCt, n );
+
+    if( T ) {
+
+        if( nrhs == n && !gap )
+            return &T->data[head];
+
+        memcpy( dst, &T->data[head], nrhs * sizeof(qint16) );
+        memcpy( &dst[nrhs], &T->data[0], (n - nrhs) * sizeof(qint16) );
+        goto gaps;
+    }
+
+    {
+    qint16          *D   = dst;
+    const qint16    *src = &buf[SAMPS(head) + chan];
+
+    nrhs = nContig( head, n );
+
+    for( int i = 0; i < nrhs; ++i, src += nchans )
+        *D++ = *src;
+
+    src = &buf[chan];
+
+    for( int i = nrhs; i < n; ++i, src += nchans )
+        *D++ = *src;
+    }
+
+gaps:
+    if( gap )
+        zeroGaps( dst, fromCt, n, 1 );
+
+    return dst;
+}
+
+
+// Tiled search shared by unfiltered edge finders.
+//
+// Starting from fromCt, scan given chan for the first sample at
+// the sought level (kind) preceded by one not at level, such that
+// the level persists for at least inarow counts.
 //
 // Return:
 // false = no edge; resume looking from outCt.
 // true  = edge @ outCt.
 //
-bool AIQ::findBitFallingEdge(
+bool AIQ::findEdge(
     quint64         &outCt,
     quint64         fromCt,
     int             chan,
+    int             kind,
+    qint16          T,
     int             bit,
     int             inarow ) const
 {
-    int nok = 0;
-
     outCt = fromCt;
 
-    QMutexLocker    ml( &QMtx );
+    quint64 end     = endCount(),
+            head    = safeHeadCt();
 
-    RingWalker  W( buf, bufmax, bufhead, buflen, nchans, chan );
+    if( fromCt < head )
+        fromCt = head;
 
-    if( !W.setStart( fromCt, endCt ) )
+    if( fromCt >= end )
         return false;
 
-// --------------------
-// Must start on a high
-// --------------------
-
-    if( !((*W.cur >> bit) & 1) ) {
+    qint16  tile[EDGETILE];
+    quint64 bits[EDGETILE / 64];
+    EdgeRun R( inarow );
 
-        while( W.next() ) {
+    for( quint64 ct = fromCt; ct < end; ct += EDGETILE ) {
 
-            if( (*W.cur >> bit) & 1 )
-                goto seek_edge;
-        }
+        int n = int(std::min( quint64(EDGETILE), end - ct ));
 
-        goto fail;
-    }
+        const qint16    *src = gatherChan( tile, ct, n, chan );
 
-// -------------------
-// Seek edge candidate
-// -------------------
+        edgeMask( bits, src, n, kind, T, bit );
 
-seek_edge:
-    while( W.next() ) {
+        if( !isIntact( ct ) ) {
+            outCt = safeHeadCt();
+            return false;
+        }
 
-        if( !((*W.cur >> bit) & 1) ) {
 
-            // Mark edge start
-            outCt   = W.curCt();
-            nok     = 1;
+        for( int iw = 0; iw * 64 < n; ++iw ) {
 
-            if( inarow == 1 )
+            if( R.scan( bits[iw], std::min( 64, n - iw * 64 ), ct + iw * 64 ) ) {
+                outCt = R.runStart;
                 return true;
-
-            // Check extended run length
-            while( W.next() ) {
-
-                if( !((*W.cur >> bit) & 1) ) {
-
-                    if( ++nok >= inarow )
-                        return true;
-                }
-                else {
-                    nok = 0;
-                    break;
-                }
             }
         }
     }
 
-// ----
-// Fail
-// ----
-
 // Back off to pre-transition level for next time.
 // Notes:
 // - outCt (found edge mark) always > 0 by policy.
-// - endCt always > 0 because GateBase waits for samples.
+// - end always > 0 because GateBase waits for samples.
+
+    if( R.inRun && R.runValid )
+        outCt = R.runStart - 1;
+    else
+        outCt = end - 1;
+
+    return false;
+}
+
+
+// Common exit for filtered edge finders; validates scanned data.
+//
+// Fail: Back off to pre-transition level for next time.
+// Notes:
+// - outCt (found edge mark) always > 0 by policy.
+// - end always > 0 because GateBase waits for samples.
+//
+// Overrun: Scanned data (from checkCt, the last block not yet
+// validated by the walker) were overwritten, so any finding is
+// suspect; resume looking from the current queue head.
+//
+bool AIQ::edgeEnd(
+    quint64         &outCt,
+    int             nok,
+    bool            found,
+    quint64         checkCt,
+    quint64         end ) const
+{
+    if( !isIntact( checkCt ) ) {
+        outCt = safeHeadCt();
+        return false;
+    }
+
+    if( found )
+        return true;
 
-fail:
     if( nok )
         outCt -= 1;
     else
-        outCt = endCt - 1;
+        outCt = end - 1;
 
     return false;
 }
@@ -8,11 +8,22 @@
 #include "SGLTypes.h"
 
 #include <QMutex>
+#include <QString>
+#include <QVector>
+#include <QWaitCondition>
+
+#include <atomic>
 
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
+class AIQSyncIdx;
+class AIQStampLog;
+class AIQHist;
+
+class QSharedMemory;
+
 class AIQ
 {
 /* ----- */
@@ -33,48 +44,215 @@ public:
         virtual void operator()( int nflt ) = 0;
     };
 
+    // Zero-copy window onto queued scans. Data are
+    // presented in place as up to two spans, the second
+    // being the remainder wrapped to the ring start; a
+    // mirrored ring always gives one span.
+    // Producer never waits on a view, so the consumer
+    // must process, then call isIntact( V ) and discard
+    // its results if the producer has since lapped V.
+    struct View {
+        const qint16    *span[2];
+        int             nspan[2];   // scans per span
+        quint64         fromCt;
+        View() : fromCt(0)
+            {span[0]=span[1]=0; nspan[0]=nspan[1]=0;}
+        int nScans() const  {return nspan[0] + nspan[1];}
+    };
+
+    // Producer's hardware timestamp of the first scan of an
+    // enqueued block, and the app time it was enqueued.
+    struct Stamp {
+        quint64 ct;
+        double  t;
+        quint32 hw;
+    };
+
+private:
+    // Opt-in channel-major copy of one channel, maintained
+    // by the producer alongside the interleaved ring, using
+    // the same slot mapping. Valid for counts >= fromCt.
+    struct Tap {
+        vec_i16                 data;
+        std::atomic<quint64>    fromCt;
+        int                     chan;
+        Tap() : fromCt(UNSET64), chan(-1)   {}
+    };
+
+    enum { MAXTAPS = 8 };
+
+    // Consumer lag bookkeeping: each named reader reports
+    // the count it has consumed through, and when.
+    struct Reader {
+        QString                 name;
+        std::atomic<quint64>    atCt;
+        std::atomic<double>     atT;
+        Reader() : atCt(0), atT(0)  {}
+    };
+
+    enum { MAXREADERS = 16 };
+
+    // Zero-filled span [ct0,ct1) recorded in lieu of writing
+    // zeros to the ring; readers overlay zeros on anything they
+    // copy from a live gap. Entries are appended in count order,
+    // newest at gaps[(nGaps-1) % MAXGAPS].
+    struct Gap {
+        std::atomic<quint64>    ct0,
+                                ct1;
+        Gap() : ct0(0), ct1(0)  {}
+    };
+
+    enum { MAXGAPS = 32, ZEROBLK = 256 };
+
+public:
+    // Header of a ring placed in named shared memory for local
+    // zero-copy readers; the ring follows it, scan-interleaved,
+    // nchans int16 per scan, scan ct in slot (ct % bufmax).
+    //
+    // Same protocol as in-process readers: load endCt, copy
+    // scans [ct0,ct1) with ct1 <= endCt, then reload wrCt; the
+    // copy is good if wrCt - ct0 <= bufmax. Gaps are written
+    // as zeros to a shared ring.
+    struct ShmHdr {
+        quint32                 magic;      // 'SGLQ'
+        quint32                 version;
+        qint32                  nchans,
+                                bufmax;     // ring capacity, scans
+        double                  srate,
+                                tzero;      // run start, app secs
+        std::atomic<quint64>    endCt,      // scans published
+                                wrCt,       // scans claimed
+                                endUs;      // app usecs endCt published
+        quint64                 rsv;
+    };
+
+    struct ReaderStat {
+        QString name;
+        double  lagSecs,    // behind head
+                fillPct,    // lag as % of ring capacity
+                idleSecs;   // since last report
+    };
+
 /* ---- */
 /* Data */
 /* ---- */
 
+// Lock-free single-producer/multi-consumer ring.
+// - Scan with count ct lives in ring slot (ct % bufmax).
+// - Producer first publishes wrCt (end of block it's about
+//   to write), copies data, then publishes endCt = wrCt.
+// - Readers never block the producer. They snapshot endCt,
+//   read, then validate against wrCt (seqlock-style) that
+//   the region read was not overwritten; else overrun.
+// - Consumers may sleep in waitForCt(); publishing endCt
+//   wakes them (the producer's only lock, taken only then).
+
 private:
-    const double    srate;
-    const int       nchans,
-                    bufmax;
-    vec_i16         buf;
-    mutable QMutex  QMtx;
-    double          tzero;
-    quint64         endCt;
-    int             bufhead,
-                    buflen;
+    const double                srate;
+    const int                   nchans,
+                                bufmax;
+    qint16                      *buf;
+    int                         bufFlags;   // granted StreamMemFlags
+    bool                        mirror;     // buf[ring+i] == buf[i]
+    std::atomic<int>            bufNode;    // NUMA node, -1=unplaced
+    double                      tzero;
+    std::atomic<quint64>        endCt,
+                                wrCt,
+                                endUs;      // app usecs endCt published
+    mutable Tap                 taps[MAXTAPS];
+    mutable std::atomic<int>    nTaps;
+    mutable Reader              readers[MAXREADERS];
+    mutable std::atomic<int>    nReaders;
+    mutable QMutex              tapMtx;     // serializes registrations
+    mutable QMutex              waitMtx;    // waitForCt() sleepers
+    mutable QWaitCondition      condNew;
+    mutable std::atomic<int>    nWaiters;
+    mutable std::atomic<AIQSyncIdx*>    syIdx;
+    std::atomic<AIQStampLog*>   stLog;
+    Gap                         gaps[MAXGAPS];
+    std::atomic<int>            nGaps;
+    vec_i16                     zblk;       // ZEROBLK zero scans
+    AIQHist                     *hist;      // set before run
+    QSharedMemory               *shm;       // if ring is shared
+    ShmHdr                      *shmH;
 
 /* ------- */
 /* Methods */
 /* ------- */
 
 public:
-    AIQ( double srate, int nchans, int capacitySecs );
+    AIQ(
+        double          srate,
+        int             nchans,
+        int             capacitySecs,
+        int             memFlags = 0,
+        const QString   &shmName = QString() );
+    virtual ~AIQ();
+
+    void reset();
+    int placeLocal();
+    int memNode() const {return bufNode.load( std::memory_order_relaxed );}
+
+    bool addTap( int chan ) const;
+
+    int readerId( const QString &name, bool own = false ) const;
+    void readerFree( int rid ) const;
+    void readerAt( int rid, quint64 ct ) const;
+    void readerStats( QVector<ReaderStat> &vS ) const;
+    double capacitySecs() const {return bufmax / srate;}
+    bool isMirrored() const     {return mirror;}
+
+    // Scans readable in place starting at ring slot head:
+    // all n if mirrored, else up to the ring end.
+    int nContig( int head, int n ) const
+        {return (mirror || n <= bufmax - head ? n : bufmax - head);}
+
+    void enableHistory( double secs, double sureSecs = 0 );
+    double histSpan() const;
+    int getHistScans( vec_i16 &dest, quint64 fromCt, int nMax ) const;
+
+    bool enableSyncIndex(
+        int             chan,
+        int             bit,
+        qint16          thresh,
+        double          period ) const;
+    bool syncEdgeFrom( quint64 &edgeCt, quint64 fromCt ) const;
+    bool syncEdgeBefore( quint64 &edgeCt, quint64 ct ) const;
+    bool syncIndexCovers( quint64 fromCt ) const;
+    bool mapCt2TimeSync( double &t, double ct ) const;
+    bool mapTime2CtSync( double &ct, double t ) const;
+    bool syncRate( double &rate, double &spanSecs ) const;
+
+    void addStamp( quint32 hw, double t );
+    int getStamps(
+        std::vector<Stamp>  &v,
+        quint64             fromCt,
+        quint64             toCt ) const;
 
     double sRate() const        {return srate;}
     double chanRate() const     {return nchans * srate;}
     int nChans() const          {return nchans;}
+    QString shmName() const;
 
-    void setTZero( double t0 )  {tzero = t0;}
+    void setTZero( double t0 )
+        {tzero = t0; if( shmH ) shmH->tzero = t0;}
     double tZero() const        {return tzero;}
 
     void enqueueZero( double t0, double tLim );
 
     void enqueue( const qint16 *src, int nCts );
 
-    void enqueueProfile(
-        double          &tLock,
-        double          &tWork,
-        const qint16    *src,
-        int             nCts );
+    static void enqueueBatch(
+        AIQ* const          *Q,
+        const qint16* const *src,
+        const int           *nCts,
+        int                 nQ );
 
     quint64 qHeadCt() const;
     quint64 endCount() const;
+    bool waitForCt( quint64 ct, int ms ) const;
     double endTime() const;
+    double enqTime( quint64 ct ) const;
     int mapTime2Ct( quint64 &ct, double t ) const;
     int mapCt2Time( double &t, quint64 ct ) const;
 
@@ -89,6 +267,21 @@ public:
         quint64         fromCt,
         int             nMax ) const;
 
+    int getView(
+        View            &V,
+        quint64         fromCt,
+        int             nMax ) const;
+
+    bool isIntact( quint64 fromCt ) const;
+    bool isIntact( const View &V ) const    {return isIntact( V.fromCt );}
+
+    bool findGap( quint64 &g0, quint64 &g1, quint64 fromCt, int n ) const;
+    void zeroGaps(
+        qint16          *dst,
+        quint64         fromCt,
+        int             n,
+        int             perScan ) const;
+
     qint64 getNScansFromCtMono(
         qint16          *dst,
         quint64         fromCt,
@@ -154,6 +347,48 @@ public:
         int             chan,
         int             bit,
         int             inarow ) const;
+
+    static void bitMask512(
+        quint64         bits[8],
+        const qint16    *src,
+        int             n,
+        int             bit );
+
+    static void threshMask512(
+        quint64         bits[8],
+        const qint16    *src,
+        int             n,
+        qint16          T );
+
+private:
+    int slot( quint64 ct ) const    {return int(ct % bufmax);}
+    void publishBegin( quint64 wr );
+    void publishEnd( quint64 wr );
+    void writeBlock( const qint16 *src, int nCts );
+    void writeZeros( quint64 fromCt, quint64 toCt );
+    void writeTaps( const qint16 *src, quint64 fromCt, int nCts );
+    const Tap *findTap( int chan, quint64 fromCt ) const;
+    quint64 safeHeadCt() const;
+    int histScans( vec_i16 &dest, quint64 fromCt, int nMax ) const;
+    const qint16 *gatherChan(
+        qint16          *dst,
+        quint64         fromCt,
+        int             n,
+        int             chan ) const;
+    bool findEdge(
+        quint64         &outCt,
+        quint64         fromCt,
+        int             chan,
+        int             kind,
+        qint16          T,
+        int             bit,
+        int             inarow ) const;
+    bool edgeEnd(
+        quint64         &outCt,
+        int             nok,
+        bool            found,
+        quint64         checkCt,
+        quint64         end ) const;
 };
 
 #endif  // AIQ_H
@@ -15,56 +15,110 @@
 
 //#define EDGEFILES
 
+// One-channel reads are small; fewer, longer reads are cheaper.
+#define CALSR_CHUNKSECS 10
 
 
 
+
+/* ---------------------------------------------------------------- */
+/* CalSRJobWorker ------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void CalSRJobWorker::run()
+{
+    W->runJobs();
+    emit finished();
+}
+
 /* ---------------------------------------------------------------- */
 /* CalSRWorker ---------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
+// Streams (files) are independent jobs. This thread and up to
+// (cores - 1) helper threads take jobs from a shared counter
+// until all are done, so an N-probe run costs about as long as
+// its biggest file rather than the sum of all of them.
+//
 void CalSRWorker::run()
 {
-    int nIM = vIM.size(),
-        nNI = vNI.size();
+    nJobs   = vIM.size() + vNI.size();
+    nextJob = 0;
+    pctRpt  = 0;
+    jobTenth.assign( nJobs, 0 );
 
-    pctCum = 0;
-    pctMax = 10*(nIM + nNI);
-    pctRpt = 0;
+    int nThd = qMin( nJobs, qMax( 1, QThread::idealThreadCount() ) );
 
-    for( int is = 0; is < nIM; ++is ) {
+    std::vector<QThread*>   vT;
 
-        calcRateIM( vIM[is] );
+    for( int iThd = 1; iThd < nThd; ++iThd ) {
 
-        if( isCanceled() )
-            goto exit;
+        QThread         *T = new QThread;
+        CalSRJobWorker  *J = new CalSRJobWorker( this );
 
-        reportTenth( 10 );
-        pctCum += 10;
-    }
-
-    if( isCanceled() )
-        goto exit;
+        J->moveToThread( T );
 
-    for( int is = 0; is < nNI; ++is ) {
+        Connect( T, SIGNAL(started()), J, SLOT(run()) );
+        Connect( J, SIGNAL(finished()), J, SLOT(deleteLater()) );
+        Connect( J, SIGNAL(destroyed()), T, SLOT(quit()), Qt::DirectConnection );
 
-        calcRateNI( vNI[is] );
+        T->start();
+        vT.push_back( T );
+    }
 
-        if( isCanceled() )
-            goto exit;
+    runJobs();
 
-        reportTenth( 10 );
-        pctCum += 10;
+    for( int iThd = 0, n = vT.size(); iThd < n; ++iThd ) {
+        vT[iThd]->wait();
+        delete vT[iThd];
     }
 
-exit:
-    reportTenth( pctMax );
+    emit percent( 100 );
     emit finished();
 }
 
 
-void CalSRWorker::reportTenth( int tenth )
+// Take and process jobs until none left or canceled.
+//
+void CalSRWorker::runJobs()
+{
+    int nIM = vIM.size();
+
+    for(;;) {
+
+        int iJob;
+
+        runMtx.lock();
+            iJob = (_cancel ? nJobs : nextJob++);
+        runMtx.unlock();
+
+        if( iJob >= nJobs )
+            break;
+
+        if( iJob < nIM )
+            calcRateIM( vIM[iJob], iJob );
+        else
+            calcRateNI( vNI[iJob - nIM], iJob );
+
+        reportTenth( iJob, 10 );
+    }
+}
+
+
+// Each job contributes up to 10 tenths to the total.
+//
+void CalSRWorker::reportTenth( int iJob, int tenth )
 {
-    int pct = qMin( 100.0, 100.0 * (pctCum + tenth) / pctMax );
+    QMutexLocker    ml( &runMtx );
+
+    jobTenth[iJob] = qMin( 10, tenth );
+
+    int sum = 0;
+
+    for( int i = 0; i < nJobs; ++i )
+        sum += jobTenth[i];
+
+    int pct = 100 * sum / (10 * nJobs);
 
     if( pct > pctRpt ) {
 
@@ -74,7 +128,7 @@ void CalSRWorker::reportTenth( int tenth )
 }
 
 
-void CalSRWorker::calcRateIM( CalSRStream &S )
+void CalSRWorker::calcRateIM( CalSRStream &S, int iJob )
 {
     QVariant    qv;
     double      syncPer;
@@ -89,7 +143,7 @@ void CalSRWorker::calcRateIM( CalSRStream &S )
     if( !df->openForRead( runTag.filename( S.ip, "ap.bin" ), S.err ) )
         goto close;
 
-    S.srate = df->getParam( "imSampRate" ).toDouble();
+    S.srate = df->samplingRateHz();
 
 // ---------------------------
 // Extract sync metadata items
@@ -113,7 +167,7 @@ void CalSRWorker::calcRateIM( CalSRStream &S )
 
     scanDigital(
         S, df, syncPer, syncChan,
-        df->cumTypCnt()[CimCfg::imSumNeural] );
+        df->cumTypCnt()[CimCfg::imSumNeural], iJob );
 
 // -----
 // Close
@@ -124,7 +178,7 @@ close:
 }
 
 
-void CalSRWorker::calcRateNI( CalSRStream &S )
+void CalSRWorker::calcRateNI( CalSRStream &S, int iJob )
 {
     QVariant    qv;
     double      syncPer,
@@ -141,7 +195,7 @@ void CalSRWorker::calcRateNI( CalSRStream &S )
     if( !df->openForRead( runTag.filename( -1, "bin" ), S.err ) )
         goto close;
 
-    S.srate = df->getParam( "niSampRate" ).toDouble();
+    S.srate = df->samplingRateHz();
 
 // ---------------------------
 // Extract sync metadata items
@@ -194,10 +248,10 @@ void CalSRWorker::calcRateNI( CalSRStream &S )
     if( syncType == 0 ) {
         scanDigital(
             S, df, syncPer, syncChan,
-            df->cumTypCnt()[CniCfg::niSumAnalog] + syncChan/16 );
+            df->cumTypCnt()[CniCfg::niSumAnalog] + syncChan/16, iJob );
     }
     else
-        scanAnalog( S, df, syncPer, syncThresh, syncChan );
+        scanAnalog( S, df, syncPer, syncThresh, syncChan, iJob );
 
 // -----
 // Close
@@ -213,7 +267,8 @@ void CalSRWorker::scanDigital(
     DataFile        *df,
     double          syncPer,
     int             syncChan,
-    int             dword )
+    int             dword,
+    int             iJob )
 {
 #ifdef EDGEFILES
 QFile f( QString("%1/%2_edges.txt")
@@ -239,8 +294,7 @@ QTextStream ts( &f );
     qint64  nRem    = df->scanCount(),
             xpos    = 0,
             lastX   = 0;
-    int     nC      = df->numChans(),
-            nthEdge = (quint64(nRem / (srate * syncPer)) - 1) / statN,
+    int     nthEdge = (quint64(nRem / (srate * syncPer)) - 1) / statN,
             iEdge   = nthEdge - 1,
             tenth   = 0;
     bool    isHi    = false;
@@ -256,6 +310,11 @@ QTextStream ts( &f );
         return;
     }
 
+// Read just the sync word (mapped, subset or sidecar path)
+
+    QBitArray   keep( df->numChans() );
+    keep.setBit( iword );
+
 // --------------------------
 // Collect and bin the counts
 // --------------------------
@@ -269,10 +328,10 @@ QTextStream ts( &f );
 
         vec_i16 data;
         qint64  ntpts,
-                chunk = srate,
+                chunk = CALSR_CHUNKSECS * srate,
                 nthis = qMin( chunk, nRem );
 
-        ntpts = df->readScans( data, xpos, nthis, QBitArray() );
+        ntpts = df->readScans( data, xpos, nthis, keep );
 
         if( ntpts <= 0 )
             break;
@@ -280,7 +339,7 @@ QTextStream ts( &f );
         // Init high/low flag
 
         if( !xpos )
-            isHi = (data[iword] & mask) > 0;
+            isHi = (data[0] & mask) > 0;
 
         // Scan block for edges
 
@@ -288,12 +347,12 @@ QTextStream ts( &f );
 
             if( isHi ) {
 
-                if( (data[i*nC + iword] & mask) < 1 )
+                if( (data[i] & mask) < 1 )
                     isHi = false;
             }
             else {
 
-                if( (data[i*nC + iword] & mask) > 0 ) {
+                if( (data[i] & mask) > 0 ) {
 
                     if( ++iEdge >= nthEdge ) {
 
@@ -318,7 +377,7 @@ ts << c << "\n";
 binned:
                         lastX = xpos + i;
                         iEdge = 0;
-                        reportTenth( ++tenth );
+                        reportTenth( iJob, ++tenth );
                     }
 
                     isHi = true;
@@ -402,7 +461,8 @@ void CalSRWorker::scanAnalog(
     DataFile        *df,
     double          syncPer,
     double          syncThresh,
-    int             syncChan )
+    int             syncChan,
+    int             iJob )
 {
 #ifdef EDGEFILES
 QFile f( QString("%1/%2_edges.txt")
@@ -428,8 +488,7 @@ QTextStream ts( &f );
     qint64  nRem    = df->scanCount(),
             xpos    = 0,
             lastX   = 0;
-    int     nC      = df->numChans(),
-            nthEdge = (quint64(nRem / (srate * syncPer)) - 1) / statN,
+    int     nthEdge = (quint64(nRem / (srate * syncPer)) - 1) / statN,
             iEdge   = nthEdge - 1,
             tenth   = 0;
     bool    isHi    = false;
@@ -445,6 +504,11 @@ QTextStream ts( &f );
         return;
     }
 
+// Read just the sync channel (mapped, subset or sidecar path)
+
+    QBitArray   keep( df->numChans() );
+    keep.setBit( iword );
+
 // --------------------------
 // Collect and bin the counts
 // --------------------------
@@ -458,10 +522,10 @@ QTextStream ts( &f );
 
         vec_i16 data;
         qint64  ntpts,
-                chunk = srate,
+                chunk = CALSR_CHUNKSECS * srate,
                 nthis = qMin( chunk, nRem );
 
-        ntpts = df->readScans( data, xpos, nthis, QBitArray() );
+        ntpts = df->readScans( data, xpos, nthis, keep );
 
         if( ntpts <= 0 )
             break;
@@ -469,7 +533,7 @@ QTextStream ts( &f );
         // Init high/low flag
 
         if( !xpos )
-            isHi = data[iword] > T;
+            isHi = data[0] > T;
 
         // Scan block for edges
 
@@ -477,12 +541,12 @@ QTextStream ts( &f );
 
             if( isHi ) {
 
-                if( data[i*nC + iword] <= T )
+                if( data[i] <= T )
                     isHi = false;
             }
             else {
 
-                if( data[i*nC + iword] > T ) {
+                if( data[i] > T ) {
 
                     if( ++iEdge >= nthEdge ) {
 
@@ -507,7 +571,7 @@ ts << c << "\n";
 binned:
                         lastX = xpos + i;
                         iEdge = 0;
-                        reportTenth( ++tenth );
+                        reportTenth( iJob, ++tenth );
                     }
 
                     isHi = true;
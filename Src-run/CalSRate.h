@@ -59,8 +59,9 @@ private:
     std::vector<CalSRStream>    &vIM,
                                 &vNI;
     mutable QMutex              runMtx;
-    int                         pctCum,
-                                pctMax,
+    std::vector<int>            jobTenth;
+    int                         nJobs,
+                                nextJob,
                                 pctRpt;
     bool                        _cancel;
 
@@ -71,9 +72,12 @@ public:
         std::vector<CalSRStream>    &vNI )
         :   runTag(runTag),
             vIM(vIM), vNI(vNI),
+            nJobs(0), nextJob(0), pctRpt(0),
             _cancel(false)  {}
     virtual ~CalSRWorker()  {}
 
+    void runJobs();
+
 signals:
     void percent( int pct );
     void finished();
@@ -84,23 +88,46 @@ public slots:
 
 private:
     bool isCanceled()   {QMutexLocker ml( &runMtx ); return _cancel;}
-    void reportTenth( int tenth );
-    void calcRateIM( CalSRStream &S );
-    void calcRateNI( CalSRStream &S );
+    void reportTenth( int iJob, int tenth );
+    void calcRateIM( CalSRStream &S, int iJob );
+    void calcRateNI( CalSRStream &S, int iJob );
 
     void scanDigital(
         CalSRStream     &S,
         DataFile        *df,
         double          syncPer,
         int             syncChan,
-        int             dword );
+        int             dword,
+        int             iJob );
 
     void scanAnalog(
         CalSRStream     &S,
         DataFile        *df,
         double          syncPer,
         double          syncThresh,
-        int             syncChan );
+        int             syncChan,
+        int             iJob );
+};
+
+
+// Helper thread body: takes jobs from the CalSRWorker.
+//
+class CalSRJobWorker : public QObject
+{
+    Q_OBJECT
+
+private:
+    CalSRWorker *W;
+
+public:
+    CalSRJobWorker( CalSRWorker *W ) : QObject(0), W(W)  {}
+    virtual ~CalSRJobWorker()                           {}
+
+signals:
+    void finished();
+
+public slots:
+    void run();
 };
 
 
@@ -5,6 +5,7 @@
 #include "Util.h"
 #include "MainApp.h"
 #include "ConfigCtl.h"
+#include "DFDirIndex.h"
 #include "DFName.h"
 #include "KVParams.h"
 #include "HelpButDialog.h"
@@ -246,6 +247,7 @@ void CalSRateCtl::apply()
                 kvp.fromMetaFile( name );
                 kvp["imSampRate"] = S.av;
                 kvp.toMetaFile( name );
+                DFDirIndex::forget( name );
             }
 
             isRslt = true;
@@ -276,6 +278,7 @@ void CalSRateCtl::apply()
                 kvp.fromMetaFile( name );
                 kvp["niSampRate"] = S.av;
                 kvp.toMetaFile( name );
+                DFDirIndex::forget( name );
             }
 
             isRslt = true;
@@ -5,6 +5,8 @@
 
 #include <QWaitCondition>
 
+#include <atomic>
+
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -20,7 +22,7 @@ protected:
     const DAQ::Params       &p;
     mutable QMutex          runMtx;
     mutable QWaitCondition  condRun;
-    volatile bool           _canSleep,
+    std::atomic<bool>       _canSleep,
                             ready,
                             pleaseStop;
 
@@ -32,20 +34,32 @@ public:
     virtual void run() = 0;
     virtual void update( int ip ) = 0;
 
+    // Writers of flags the sleep tests hold runMtx, so a change
+    // can't slip between the test and wait; readers don't lock.
     void atomicSleepWhenReady()
     {
         runMtx.lock();
-        ready = true;
-        if( _canSleep && !pleaseStop )
+        ready.store( true, std::memory_order_release );
+        if( _canSleep.load( std::memory_order_acquire ) && !pleaseStop.load( std::memory_order_acquire ) )
             condRun.wait( &runMtx );
         runMtx.unlock();
     }
 
     void wake()             {condRun.wakeAll();}
-    void stayAwake()        {QMutexLocker ml( &runMtx ); _canSleep = false;}
-    bool isReady() const    {QMutexLocker ml( &runMtx ); return ready;}
-    void stop()             {QMutexLocker ml( &runMtx ); pleaseStop = true;}
-    bool isStopped() const  {QMutexLocker ml( &runMtx ); return pleaseStop;}
+    void stayAwake()
+        {
+            QMutexLocker ml( &runMtx );
+            _canSleep.store( false, std::memory_order_release );
+        }
+    bool isReady() const
+        {return ready.load( std::memory_order_acquire );}
+    void stop()
+        {
+            QMutexLocker ml( &runMtx );
+            pleaseStop.store( true, std::memory_order_release );
+        }
+    bool isStopped() const
+        {return pleaseStop.load( std::memory_order_acquire );}
 };
 
 #endif  // CIMACQ_H
@@ -3,12 +3,21 @@
 
 #include "CimAcqImec.h"
 #include "Util.h"
+#include "RunBench.h"
 #include "MainApp.h"
 #include "ConfigCtl.h"
 #include "Run.h"
 #include "MetricsWindow.h"
+#include "ImTelemetry.h"
+#include "ThdPlace.h"
+#include "Trace.h"
 
+#include <QDateTime>
 #include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QMutex>
 #include <QThread>
 
 
@@ -18,10 +27,313 @@
 #define TPNTPERFETCH    12
 #define AVEE            5
 #define MAXE            24
-//#define PROFILE
 //#define TUNE            0
 
 
+/* ---------------------------------------------------------------- */
+/* LF interpolation kernels --------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// T0 packets carry one LF sample per TPNTPERFETCH AP samples.
+// For each AP timepoint we write all LF channels linearly
+// interpolated from the previous packet's values:
+//
+//     dst = last + slope*(src - last),  truncated to int16.
+//
+// Vector kernels do exactly the scalar float ops (sub, mul,
+// add, truncate) lane-wise, so results are bit-identical to
+// the scalar loop. The widest kernel the CPU supports is
+// chosen once at startup.
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#define LFI_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define LFI_AVX2_FN
+#else
+#define LFI_AVX2_FN __attribute__((target("avx2")))
+#endif
+#endif
+
+typedef void (*LFInterpFn)(
+    qint16          *dst,
+    const float     *last,
+    const qint16    *src,
+    int             n,
+    float           slope );
+
+
+static void lfInterp_scalar(
+    qint16          *dst,
+    const float     *last,
+    const qint16    *src,
+    int             n,
+    float           slope )
+{
+    for( int i = 0; i < n; ++i )
+        dst[i] = last[i] + slope*(src[i]-last[i]);
+}
+
+
+#ifdef LFI_X86
+
+static void lfInterp_sse2(
+    qint16          *dst,
+    const float     *last,
+    const qint16    *src,
+    int             n,
+    float           slope )
+{
+    __m128  vS = _mm_set1_ps( slope );
+    int     i  = 0;
+
+    for( ; i + 8 <= n; i += 8 ) {
+
+        __m128i s16 = _mm_loadu_si128( (const __m128i*)&src[i] ),
+                sLo = _mm_srai_epi32( _mm_unpacklo_epi16( s16, s16 ), 16 ),
+                sHi = _mm_srai_epi32( _mm_unpackhi_epi16( s16, s16 ), 16 );
+        __m128  lLo = _mm_loadu_ps( &last[i] ),
+                lHi = _mm_loadu_ps( &last[i + 4] ),
+                vLo = _mm_add_ps( lLo,
+                        _mm_mul_ps( vS,
+                        _mm_sub_ps( _mm_cvtepi32_ps( sLo ), lLo ) ) ),
+                vHi = _mm_add_ps( lHi,
+                        _mm_mul_ps( vS,
+                        _mm_sub_ps( _mm_cvtepi32_ps( sHi ), lHi ) ) );
+
+        _mm_storeu_si128( (__m128i*)&dst[i],
+            _mm_packs_epi32(
+                _mm_cvttps_epi32( vLo ),
+                _mm_cvttps_epi32( vHi ) ) );
+    }
+
+    lfInterp_scalar( dst + i, last + i, src + i, n - i, slope );
+}
+
+
+LFI_AVX2_FN
+static void lfInterp_avx2(
+    qint16          *dst,
+    const float     *last,
+    const qint16    *src,
+    int             n,
+    float           slope )
+{
+    __m256  vS = _mm256_set1_ps( slope );
+    int     i  = 0;
+
+    for( ; i + 16 <= n; i += 16 ) {
+
+        __m256i sLo = _mm256_cvtepi16_epi32(
+                        _mm_loadu_si128( (const __m128i*)&src[i] ) ),
+                sHi = _mm256_cvtepi16_epi32(
+                        _mm_loadu_si128( (const __m128i*)&src[i + 8] ) );
+        __m256  lLo = _mm256_loadu_ps( &last[i] ),
+                lHi = _mm256_loadu_ps( &last[i + 8] ),
+                vLo = _mm256_add_ps( lLo,
+                        _mm256_mul_ps( vS,
+                        _mm256_sub_ps( _mm256_cvtepi32_ps( sLo ), lLo ) ) ),
+                vHi = _mm256_add_ps( lHi,
+                        _mm256_mul_ps( vS,
+                        _mm256_sub_ps( _mm256_cvtepi32_ps( sHi ), lHi ) ) );
+
+        // packs works within 128-bit lanes; restore order
+
+        __m256i p = _mm256_packs_epi32(
+                        _mm256_cvttps_epi32( vLo ),
+                        _mm256_cvttps_epi32( vHi ) );
+
+        _mm256_storeu_si256( (__m256i*)&dst[i],
+            _mm256_permute4x64_epi64( p, 0xD8 ) );
+    }
+
+    lfInterp_sse2( dst + i, last + i, src + i, n - i, slope );
+}
+
+#endif  // LFI_X86
+
+
+static LFInterpFn pickLFInterp()
+{
+#ifdef LFI_X86
+    if( cpuHasAVX2() )
+        return lfInterp_avx2;
+
+    return lfInterp_sse2;
+#else
+    return lfInterp_scalar;
+#endif
+}
+
+static const LFInterpFn lfInterp = pickLFInterp();
+
+/* ---------------------------------------------------------------- */
+/* Probe architecture kernels ------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Scaling loops are templated on channel counts so that each
+// known architecture gets its own fixed-size copy, unrolled and
+// vectorized by the compiler. Zero parameters mean "use the
+// runtime count", which covers custom architectures. A probe's
+// kernel is picked once, in the ImAcqProbe ctor.
+//
+// Timestamp telemetry is done by the caller in its own pass,
+// keeping these loops free of calls.
+
+template<int NAP, int NLF>
+static void scaleT0(
+    qint16                  *dst,
+    float                   *lfLast,
+    const electrodePacket   *E,
+    int                     nE,
+    int                     nAP,
+    int                     nLF )
+{
+    if( NAP )
+        nAP = NAP;
+
+    if( NLF )
+        nLF = NLF;
+
+    for( int ie = 0; ie < nE; ++ie ) {
+
+        const electrodePacket   &pE     = E[ie];
+        const qint16            *srcLF  = pE.lfpData;
+
+        for( int it = 0; it < TPNTPERFETCH; ++it ) {
+
+            // ----------
+            // ap - as is
+            // ----------
+
+            memcpy( dst, pE.apData[it], nAP * sizeof(qint16) );
+
+//------------------------------------------------------------------
+// Experiment to visualize timestamps as sawtooth in channel 16.
+#if 0
+dst[16] = pE.timestamp[it] % 8000 - 4000;
+#endif
+//------------------------------------------------------------------
+
+//------------------------------------------------------------------
+// Experiment to visualize counter as sawtooth in channel 16.
+// (One counter per kernel; the probe index isn't passed here.)
+#if 0
+static uint count = 0;
+count += 3;
+dst[16] = count % 8000 - 4000;
+#endif
+//------------------------------------------------------------------
+
+            dst += nAP;
+
+            // -----------------
+            // lf - interpolated
+            // -----------------
+
+#if 1
+// Standard linear interpolation
+            lfInterp( dst, lfLast, srcLF, nLF, float(it)/TPNTPERFETCH );
+            dst += nLF;
+#else
+// Raw data for diagnostics
+            for( int lf = 0; lf < nLF; ++lf )
+                *dst++ = srcLF[lf];
+#endif
+
+            // ----
+            // sync
+            // ----
+
+            *dst++ = pE.Status[it];
+        }
+
+        // ---------------
+        // update saved lf
+        // ---------------
+
+        for( int lf = 0; lf < nLF; ++lf )
+            lfLast[lf] = srcLF[lf];
+    }
+}
+
+
+// @@@ FIX v2.0 Clear bits {1,6}, then shift 1 to 6
+//
+template<int NAP>
+static void scaleT2(
+    qint16                      *dst,
+    const qint16                *src,
+    const struct PacketInfo     *H,
+    int                         nT,
+    int                         nAP )
+{
+    if( NAP )
+        nAP = NAP;
+
+    for( int it = 0; it < nT; ++it ) {
+
+        // ----------
+        // ap - as is
+        // ----------
+
+// @@@ FIX v2.0 Sign inverted AP
+#if 0
+        memcpy( dst, src, nAP * sizeof(qint16) );
+#else
+        for( int k = 0; k < nAP; ++k )
+            dst[k] = -src[k];
+#endif
+
+//------------------------------------------------------------------
+// Experiment to visualize timestamps as sawtooth in channel 16.
+#if 0
+dst[16] = H[it].Timestamp % 8000 - 4000;
+#endif
+//------------------------------------------------------------------
+
+//------------------------------------------------------------------
+// Experiment to visualize counter as sawtooth in channel 16.
+// (One counter per kernel; the probe index isn't passed here.)
+#if 0
+static uint count = 0;
+count += 3;
+dst[16] = count % 8000 - 4000;
+#endif
+//------------------------------------------------------------------
+
+        dst += nAP;
+        src += nAP;
+
+        // ----
+        // sync
+        // ----
+
+        int stat = H[it].Status;
+
+        *dst++ = (stat & 0xBD) + ((stat & 2) << 5);
+    }
+}
+
+
+static ImScaleT0Fn pickScaleT0( int nAP, int nLF )
+{
+    if( nAP == 384 && nLF == 384 )
+        return scaleT0<384,384>;
+
+    return scaleT0<0,0>;
+}
+
+
+static ImScaleT2Fn pickScaleT2( int nAP )
+{
+    if( nAP == 384 )
+        return scaleT2<384>;
+
+    return scaleT2<0>;
+}
+
 /* ---------------------------------------------------------------- */
 /* ImAcqShared ---------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -55,12 +367,16 @@ ImAcqShared::~ImAcqShared()
 // One can collect just difs within packets, or just between
 // packets, or both.
 //
+// Live telemetry always gets every stamp.
+//
 void ImAcqShared::tStampHist_T0(
     const electrodePacket*  E,
     int                     ip,
     int                     ie,
     int                     it )
 {
+    ImTelemetry::addTStamp( ip, E[ie].timestamp[it] );
+
 #if 0
     qint64  dif = -999999;
     if( it > 0 )        // intra-packet
@@ -121,6 +437,8 @@ void ImAcqShared::tStampHist_T2(
     int                         ip,
     int                         it )
 {
+    ImTelemetry::addTStamp( ip, H[it].Timestamp );
+
 #if 0
     qint64  dif = -999999;
     if( it > 0 )        // intra-packet
@@ -183,7 +501,8 @@ ImAcqProbe::ImAcqProbe(
     :   tLastErrReport(0), tLastFifoReport(0),
         peakDT(0), sumTot(0), totPts(0ULL), lastTStamp(0),
         errCOUNT(0), errSERDES(0), errLOCK(0), errPOP(0), errSYNC(0),
-        fifoAve(0), fifoN(0), sumN(0), ip(ip), zeroFill(false)
+        fifoAve(0), fifoN(0), sumN(0), ip(ip),
+        zeroFill(false), flushFifo(false)
 {
 // @@@ FIX Experiment to report large fetch cycle times.
     tLastFetch      = 0;
@@ -191,12 +510,7 @@ ImAcqProbe::ImAcqProbe(
 // Experiment to detect gaps in timestamps across fetches.
     tStampLastFetch = 0;
 
-#ifdef PROFILE
-    sumLag  = 0;
-    sumGet  = 0;
-    sumScl  = 0;
-    sumEnq  = 0;
-#endif
+    blkTStamp       = 0;
 
     const int   *cum = p.im.each[ip].imCumTypCnt;
     nAP = cum[CimCfg::imTypeAP];
@@ -210,6 +524,8 @@ ImAcqProbe::ImAcqProbe(
     dock = P.dock;
 
     fetchType = (P.type == 21 || P.type == 24 ? 2 : 0);
+    scaleT0   = pickScaleT0( nAP, nLF );
+    scaleT2   = pickScaleT2( nAP );
 }
 
 
@@ -290,11 +606,15 @@ void ImAcqProbe::checkErrFlags_T2( const struct PacketInfo* H, int nT ) const
 }
 
 
-bool ImAcqProbe::checkFifo( size_t *packets, CimAcqImec *acq ) const
+bool ImAcqProbe::checkFifo( size_t *packets, int *pct, CimAcqImec *acq ) const
 {
     double  tFifo = getTime();
 
-    fifoAve += acq->fifoPct( packets, *this );
+    *pct = acq->fifoPct( packets, *this );
+
+    ImTelemetry::addFifo( ip, *pct );
+
+    fifoAve += *pct;
     ++fifoN;
 
     if( tFifo - tLastFifoReport >= 5.0 ) {
@@ -332,6 +652,289 @@ bool ImAcqProbe::checkFifo( size_t *packets, CimAcqImec *acq ) const
     return true;
 }
 
+/* ---------------------------------------------------------------- */
+/* ImAcqPrefetch -------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+ImAcqPrefetch::ImAcqPrefetch( CimAcqImec *acq, int maxAP )
+    :   QObject(0), acq(acq), req(0), iBuf(1),
+        busy(false), pleaseStop(false)
+{
+    for( int ib = 0; ib < 2; ++ib ) {
+        bufs[ib].H.resize( MAXE * TPNTPERFETCH );
+        bufs[ib].D.resize( MAXE * TPNTPERFETCH * maxAP );
+        bufs[ib].nT = 0;
+        bufs[ib].ok = true;
+    }
+
+    thread = new QThread;
+    moveToThread( thread );
+    Connect( thread, SIGNAL(started()), this, SLOT(run()) );
+    thread->start();
+}
+
+
+// Lets any in-flight read finish, then joins.
+//
+ImAcqPrefetch::~ImAcqPrefetch()
+{
+    mtx.lock();
+        pleaseStop = true;
+        condReq.wakeAll();
+    mtx.unlock();
+
+    thread->wait();
+    delete thread;
+}
+
+
+// Start async read for P into the next buffer.
+// Caller must wait() once per request.
+//
+void ImAcqPrefetch::request( const ImAcqProbe &P )
+{
+    QMutexLocker    ml( &mtx );
+
+    iBuf    = 1 - iBuf;
+    req     = &P;
+    busy    = true;
+    condReq.wakeAll();
+}
+
+
+// Block until current request done; return its buffer.
+//
+ImAcqPrefetch::Buf &ImAcqPrefetch::wait()
+{
+    QMutexLocker    ml( &mtx );
+
+    while( busy )
+        condDone.wait( &mtx );
+
+    return bufs[iBuf];
+}
+
+
+void ImAcqPrefetch::run()
+{
+    mtx.lock();
+
+    for(;;) {
+
+        while( !req && !pleaseStop )
+            condReq.wait( &mtx );
+
+        if( !req )
+            break;
+
+        const ImAcqProbe    *P = req;
+        Buf                 &B = bufs[iBuf];
+
+        req = 0;
+
+        mtx.unlock();
+            B.ok = acq->fetchD_T2( B.nT, &B.H[0], &B.D[0], *P );
+        mtx.lock();
+
+        busy = false;
+        condDone.wakeAll();
+    }
+
+    mtx.unlock();
+    thread->quit();
+}
+
+/* ---------------------------------------------------------------- */
+/* ImRawRec ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+ImRawRec::ImRawRec( const DAQ::Params &p, const std::vector<int> &fetchType )
+    :   QObject(0), pleaseStop(false)
+{
+    for( int ip = 0, np = fetchType.size(); ip < np; ++ip ) {
+
+        Ring    *G = new Ring;
+        QString path =
+                    QString("%1/%2.imec%3.pkt")
+                    .arg( mainApp()->dataDir() )
+                    .arg( p.sns.runName )
+                    .arg( ip );
+
+        R.push_back( G );
+
+        G->f = new QFile( path );
+
+        if( !G->f->open( QIODevice::WriteOnly ) ) {
+            Warning() <<
+                QString("IMEC raw recorder can't open '%1'.").arg( path );
+            delete G->f;
+            G->f = 0;
+            continue;
+        }
+
+        const int   *cum = p.im.each[ip].imCumTypCnt;
+        RawFileHdr  F = {0x504C4753, 1, quint32(ip),
+                         quint32(fetchType[ip]),
+                         quint32(cum[CimCfg::imTypeAP])};
+
+        G->f->write( (const char*)&F, sizeof(F) );
+        G->buf.resize( RINGBYTES );
+    }
+
+    thread = new QThread;
+    moveToThread( thread );
+    Connect( thread, SIGNAL(started()), this, SLOT(run()) );
+    thread->start();
+}
+
+
+// Drains what remains, closes files, reports drops.
+//
+ImRawRec::~ImRawRec()
+{
+    pleaseStop.store( true );
+    thread->wait();
+    delete thread;
+
+    for( int ip = 0, np = R.size(); ip < np; ++ip ) {
+
+        Ring    *G = R[ip];
+
+        if( G->f ) {
+
+            if( G->nDrop ) {
+                Warning() <<
+                    QString("IMEC raw recorder probe %1 dropped %2 fetches.")
+                    .arg( ip ).arg( G->nDrop );
+            }
+
+            G->f->close();
+            delete G->f;
+        }
+
+        delete G;
+    }
+}
+
+
+void ImRawRec::put_T0( int ip, const electrodePacket *E, int nE )
+{
+    post( ip, nE, E, nE * sizeof(electrodePacket), 0, 0 );
+}
+
+
+void ImRawRec::put_T2(
+    int                         ip,
+    const struct PacketInfo     *H,
+    const qint16                *D,
+    int                         nT,
+    int                         nChan )
+{
+    post( ip, nT,
+        H, nT * sizeof(struct PacketInfo),
+        D, nT * nChan * sizeof(qint16) );
+}
+
+
+void ImRawRec::run()
+{
+    for(;;) {
+
+        bool    stop    = pleaseStop.load(),
+                busy    = false;
+
+        for( int ip = 0, np = R.size(); ip < np; ++ip ) {
+
+            if( R[ip]->f )
+                busy |= drain( *R[ip] );
+        }
+
+        if( !busy ) {
+
+            if( stop )
+                break;
+
+            QThread::msleep( 5 );
+        }
+    }
+
+    thread->quit();
+}
+
+
+// Producer (fetch thread of probe ip) only.
+// Return false if record dropped.
+//
+bool ImRawRec::post(
+    int             ip,
+    int             nPkt,
+    const void      *src1,
+    int             n1,
+    const void      *src2,
+    int             n2 )
+{
+    Ring    &G = *R[ip];
+
+    if( !G.f || nPkt <= 0 )
+        return true;
+
+    RawRecHdr   K   = {getTime(), quint32(nPkt), quint32(n1 + n2)};
+    quint64     wr  = G.wrPos.load( std::memory_order_relaxed ),
+                rd  = G.rdPos.load( std::memory_order_acquire );
+    size_t      len = sizeof(K) + n1 + n2,
+                cap = G.buf.size();
+
+    if( wr + len - rd > cap ) {
+        ++G.nDrop;
+        return false;
+    }
+
+    const quint8    *S[3]   = {(const quint8*)&K,
+                               (const quint8*)src1,
+                               (const quint8*)src2};
+    size_t          L[3]    = {sizeof(K), size_t(n1), size_t(n2)};
+
+    for( int is = 0; is < 3; ++is ) {
+
+        size_t  pos = wr % cap,
+                n   = std::min( L[is], cap - pos );
+
+        memcpy( &G.buf[pos], S[is], n );
+
+        if( n < L[is] )
+            memcpy( &G.buf[0], S[is] + n, L[is] - n );
+
+        wr += L[is];
+    }
+
+    G.wrPos.store( wr, std::memory_order_release );
+    return true;
+}
+
+
+// Write whatever is queued; return true if anything was.
+//
+bool ImRawRec::drain( Ring &G )
+{
+    quint64 rd  = G.rdPos.load( std::memory_order_relaxed ),
+            wr  = G.wrPos.load( std::memory_order_acquire );
+    size_t  cap = G.buf.size();
+
+    if( wr == rd )
+        return false;
+
+    size_t  pos = rd % cap,
+            n   = std::min( size_t(wr - rd), cap - pos );
+
+    G.f->write( (const char*)&G.buf[pos], n );
+
+    if( n < wr - rd )
+        G.f->write( (const char*)&G.buf[0], wr - rd - n );
+
+    G.rdPos.store( wr, std::memory_order_release );
+    return true;
+}
+
 /* ---------------------------------------------------------------- */
 /* ImAcqWorker ---------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -340,39 +943,69 @@ ImAcqWorker::ImAcqWorker(
     CimAcqImec              *acq,
     QVector<AIQ*>           &imQ,
     ImAcqShared             &shr,
-    std::vector<ImAcqProbe> &probes )
-    :   tLastYieldReport(getTime()), yieldSum(0),
-        acq(acq), imQ(imQ), shr(shr), probes(probes)
+    std::vector<ImAcqProbe> &probes,
+    int                     core,
+    bool                    rtPrio )
+    :   tLastYieldReport(getTime()), yieldSum(0), pktRate(0),
+        fifoLvl(0), acq(acq), imQ(imQ), shr(shr), probes(probes),
+        core(core), rtPrio(rtPrio)
 {
+    targPkts = qBound( 1, acq->p.im.all.fetchTarg, MAXE - 1 );
+
+    for( int iID = 0, nID = probes.size(); iID < nID; ++iID ) {
+        pktRate = qMax( pktRate,
+                    acq->p.im.each[probes[iID].ip].srate / TPNTPERFETCH );
+    }
 }
 
 
 void ImAcqWorker::run()
 {
+// Place thread first, so buffers and queue rings it touches
+// are allocated on its NUMA node.
+
+    setScheduling();
+
+    ThdPlace::apply(
+        ThdPlace::roleIMFetch,
+        QString("imec worker %1-%2")
+        .arg( probes[0].ip ).arg( probes[probes.size()-1].ip ) );
+
 // Size buffers
 // ------------
 // - lfLast[][]: each probe must retain the prev LF for all channels.
-// - i16Buf[]:   max sized over probe nCH; reused each iID.
+// - i16Buf[][]: one per probe; all are held until batch enqueue.
 // - D[]:        max sized over {fetchType, MAXE}; reused each iID.
 //
 
     std::vector<std::vector<float> >    lfLast;
-    std::vector<qint16>                 i16Buf;
+    std::vector<vec_i16>                i16Buf;
+    std::vector<AIQ*>                   bQ;
+    std::vector<const qint16*>          bSrc;
+    std::vector<int>                    bCts;
+    std::vector<int>                    nextT2;
+    ImAcqPrefetch                       *pf = 0;
 
     const int   nID     = probes.size();
-    int         nCHMax  = 0,
-                nT0     = 0,
+    int         nT0     = 0,
                 nT2     = 0,
-                iT2     = 0;
+                iT2     = 0,
+                firstT2 = -1,
+                maxAP2  = 0;
 
     lfLast.resize( nID );
+    i16Buf.resize( nID );
+    bQ.resize( nID );
+    bSrc.resize( nID );
+    bCts.resize( nID );
 
     for( int iID = 0; iID < nID; ++iID ) {
 
         const ImAcqProbe    &P = probes[iID];
 
-        if( P.nCH > nCHMax )
-            nCHMax = P.nCH;
+        i16Buf[iID].resize( MAXE * TPNTPERFETCH * P.nCH );
+        bQ[iID]     = imQ[P.ip];
+        bSrc[iID]   = &i16Buf[iID][0];
 
         if( P.fetchType == 0 ) {
             lfLast[iID].assign( P.nLF, 0.0F );
@@ -381,10 +1014,28 @@ void ImAcqWorker::run()
         else {
             ++nT2;
             iT2 = iID;
+            maxAP2 = qMax( maxAP2, P.nAP );
         }
     }
 
-    i16Buf.resize( MAXE * TPNTPERFETCH * nCHMax );
+// With 2+ T2 probes, pipeline their reads:
+// nextT2[iID] = next T2 probe to request after iID's data arrive.
+
+    if( nT2 >= 2 ) {
+
+        pf = new ImAcqPrefetch( acq, maxAP2 );
+        nextT2.assign( nID, -1 );
+
+        for( int iID = nID - 1, nxt = -1; iID >= 0; --iID ) {
+
+            if( probes[iID].fetchType == 2 ) {
+                nextT2[iID] = nxt;
+                nxt         = iID;
+            }
+
+            firstT2 = nxt;
+        }
+    }
 
     if( nT0 )
         D.resize( MAXE * sizeof(electrodePacket) / sizeof(qint32) );
@@ -396,6 +1047,9 @@ void ImAcqWorker::run()
     if( nT2 )
         H.resize( MAXE * TPNTPERFETCH );
 
+    for( int iID = 0; iID < nID; ++iID )
+        bQ[iID]->placeLocal();
+
     if( !shr.wait() )
         goto exit;
 
@@ -413,6 +1067,9 @@ void ImAcqWorker::run()
         // Do my probes
         // ------------
 
+        if( pf )
+            pf->request( probes[firstT2] );
+
         for( int iID = 0; iID < nID; ++iID ) {
 
             const ImAcqProbe    &P = probes[iID];
@@ -423,16 +1080,31 @@ void ImAcqWorker::run()
             double  dtTot = getTime();
 
             if( P.fetchType == 0 ) {
-                if( !doProbe_T0( &lfLast[iID][0], i16Buf, P ) )
+                if( !doProbe_T0(
+                        bCts[iID], &lfLast[iID][0], i16Buf[iID], P ) ) {
+
+                    goto exit;
+                }
+            }
+            else if( pf ) {
+
+                ImAcqPrefetch::Buf  &B = pf->wait();
+
+                if( nextT2[iID] >= 0 )
+                    pf->request( probes[nextT2[iID]] );
+
+                if( !doProbe_T2( bCts[iID], i16Buf[iID], P, &B ) )
                     goto exit;
             }
             else {
-                if( !doProbe_T2( i16Buf, P ) )
+                if( !doProbe_T2( bCts[iID], i16Buf[iID], P ) )
                     goto exit;
             }
 
             dtTot = getTime() - dtTot;
 
+            ImTelemetry::addCycle( P.ip, dtTot );
+
             if( dtTot > P.peakDT )
                 P.peakDT = dtTot;
 
@@ -440,6 +1112,12 @@ void ImAcqWorker::run()
             ++P.sumN;
         }
 
+        // -------
+        // Enqueue
+        // -------
+
+        enqueueAll( &bQ[0], &bSrc[0], &bCts[0] );
+
         // -----
         // Yield
         // -----
@@ -457,9 +1135,6 @@ void ImAcqWorker::run()
 
                 const ImAcqProbe    &P = probes[iID];
 
-#ifdef PROFILE
-                profile( P );
-#endif
                 P.peakDT    = 0;
                 P.sumTot    = 0;
                 P.sumN      = 0;
@@ -470,23 +1145,31 @@ void ImAcqWorker::run()
     }
 
 exit:
+    if( pf )
+        delete pf;
+
+    RunBench::addCPU( RunBench::stgAcq );
     emit finished();
 }
 
 
+// Fetch and scale probe's data into dst1D; set nT = samples
+// ready for enqueueAll().
+//
 bool ImAcqWorker::doProbe_T0(
+    int                 &nT,
     float               *lfLast,
     vec_i16             &dst1D,
     const ImAcqProbe    &P )
 {
-#ifdef PROFILE
-    double  prbT0 = getTime();
-#endif
+    quint64 tGet = (Trace::on() ? Trace::nowUs() : 0);
 
     electrodePacket*    E   = (electrodePacket*)&D[0];
     qint16*             dst = &dst1D[0];
     int                 nE;
 
+    nT = 0;
+
 // -----
 // Fetch
 // -----
@@ -510,9 +1193,8 @@ bool ImAcqWorker::doProbe_T0(
         return true;
     }
 
-#ifdef PROFILE
-    P.sumGet += getTime() - prbT0;
-#endif
+    if( tGet )
+        Trace::zone( "imec get", tGet, P.ip );
 
 // -----
 // Scale
@@ -537,127 +1219,51 @@ P.tStampLastFetch = E[nE-1].timestamp[11];
 #endif
 //------------------------------------------------------------------
 
-#ifdef PROFILE
-    double  dtScl = getTime();
-#endif
-
-    for( int ie = 0; ie < nE; ++ie ) {
-
-        const qint16    *srcLF  = 0;
-        const quint16   *srcSY  = 0;
-        electrodePacket *pE     = &E[ie];
-
-        srcLF = pE->lfpData;
-        srcSY = pE->Status;
-
-        for( int it = 0; it < TPNTPERFETCH; ++it ) {
-
-            // ----------
-            // ap - as is
-            // ----------
-
-            memcpy( dst,
-                E[ie].apData[it],
-                P.nAP * sizeof(qint16) );
-
-            shr.tStampHist_T0( E, P.ip, ie, it );
-
-//------------------------------------------------------------------
-// Experiment to visualize timestamps as sawtooth in channel 16.
-#if 0
-dst[16] = E[ie].timestamp[it] % 8000 - 4000;
-#endif
-//------------------------------------------------------------------
-
-//------------------------------------------------------------------
-// Experiment to visualize counter as sawtooth in channel 16.
-#if 0
-static uint count[16] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
-count[P.ip] += 3;
-dst[16] = count[P.ip] % 8000 - 4000;
-#endif
-//------------------------------------------------------------------
-
-            dst += P.nAP;
-
-            // -----------------
-            // lf - interpolated
-            // -----------------
-
-#if 1
-// Standard linear interpolation
-            float slope = float(it)/TPNTPERFETCH;
-
-            for( int lf = 0, nlf = P.nLF; lf < nlf; ++lf )
-                *dst++ = lfLast[lf] + slope*(srcLF[lf]-lfLast[lf]);
-#else
-// Raw data for diagnostics
-            for( int lf = 0, nlf = P.nLF; lf < nlf; ++lf )
-                *dst++ = srcLF[lf];
-#endif
-
-            // ----
-            // sync
-            // ----
-
-            *dst++ = srcSY[it];
-
-        }   // it
-
-        // ---------------
-        // update saved lf
-        // ---------------
-
-        for( int lf = 0, nlf = P.nLF; lf < nlf; ++lf )
-            lfLast[lf] = srcLF[lf];
-    }   // ie
-
-#ifdef PROFILE
-    P.sumScl += getTime() - dtScl;
-#endif
+    {
+        TraceZone   tz( "imec scale", P.ip );
 
-// -------
-// Enqueue
-// -------
+        P.scaleT0( dst, lfLast, E, nE, P.nAP, P.nLF );
 
-    P.tPreEnq = getTime();
+        for( int ie = 0; ie < nE; ++ie ) {
 
-    if( P.zeroFill ) {
-        imQ[P.ip]->enqueueZero( P.tPostEnq, P.tPreEnq );
-        P.zeroFill = false;
+            for( int it = 0; it < TPNTPERFETCH; ++it )
+                shr.tStampHist_T0( E, P.ip, ie, it );
+        }
     }
 
-    imQ[P.ip]->enqueue( &dst1D[0], TPNTPERFETCH * nE );
-    P.tPostEnq = getTime();
-    P.totPts  += TPNTPERFETCH * nE;
-
-#ifdef PROFILE
-    P.sumLag += mainApp()->getRun()->getStreamTime() -
-                (imQ[P.ip]->tZero() + P.totPts / imQ[P.ip]->sRate());
-    P.sumEnq += P.tPostEnq - P.tPreEnq;
-#endif
+    P.blkTStamp = E[0].timestamp[0];
 
+    nT = TPNTPERFETCH * nE;
     return true;
 }
 
 
+// If B given, the fetch was already done by prefetcher.
+//
 bool ImAcqWorker::doProbe_T2(
+    int                 &nT,
     vec_i16             &dst1D,
-    const ImAcqProbe    &P )
+    const ImAcqProbe    &P,
+    ImAcqPrefetch::Buf  *B )
 {
-#ifdef PROFILE
-    double  prbT0 = getTime();
-#endif
+    quint64 tGet = (Trace::on() ? Trace::nowUs() : 0);
+
+    const PacketInfo    *H   = (B ? &B->H[0] : &this->H[0]);
+    qint16              *src = (B ? &B->D[0] : (qint16*)&D[0]),
+                        *dst = &dst1D[0];
 
-    qint16  *src = (qint16*)&D[0],
-            *dst = &dst1D[0];
-    int     nT;
+    nT = 0;
 
 // -----
 // Fetch
 // -----
 
-    if( !acq->fetchD_T2( nT, &H[0], src, P ) )
+    if( B ) {
+        if( !B->ok )
+            return false;
+        nT = B->nT;
+    }
+    else if( !acq->fetchD_T2( nT, &this->H[0], src, P ) )
         return false;
 
     if( !nT ) {
@@ -676,9 +1282,8 @@ bool ImAcqWorker::doProbe_T2(
         return true;
     }
 
-#ifdef PROFILE
-    P.sumGet += getTime() - prbT0;
-#endif
+    if( tGet )
+        Trace::zone( "imec get", tGet, P.ip );
 
 //------------------------------------------------------------------
 // Experiment to check duplicate data values returned in fetch.
@@ -741,87 +1346,92 @@ P.tStampLastFetch = H[nT-1].Timestamp;
 #endif
 //------------------------------------------------------------------
 
-#ifdef PROFILE
-    double  dtScl = getTime();
-#endif
+    TraceZone   tz( "imec scale", P.ip );
 
-    for( int it = 0; it < nT; ++it ) {
+    P.scaleT2( dst, src, H, nT, P.nAP );
 
-        // ----------
-        // ap - as is
-        // ----------
+    for( int it = 0; it < nT; ++it )
+        shr.tStampHist_T2( &H[0], P.ip, it );
 
-// @@@ FIX v2.0 Sign inverted AP
-#if 0
-        memcpy( dst, src, P.nAP * sizeof(qint16) );
-#else
-        for( int k = 0; k < P.nAP; ++k )
-            dst[k] = -src[k];
-#endif
+    P.blkTStamp = H[0].Timestamp;
 
-//------------------------------------------------------------------
-// Experiment to visualize timestamps as sawtooth in channel 16.
-#if 0
-dst[16] = H[it].Timestamp % 8000 - 4000;
-#endif
-//------------------------------------------------------------------
+    return true;
+}
 
-//------------------------------------------------------------------
-// Experiment to visualize counter as sawtooth in channel 16.
-#if 0
-static uint count[16] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
-count[P.ip] += 3;
-dst[16] = count[P.ip] % 8000 - 4000;
-#endif
-//------------------------------------------------------------------
 
-        dst += P.nAP;
-        src += P.nAP;
+// Publish this loop's blocks for all my probes together,
+// stamped with one shared pre/post enqueue time, so that
+// consumers see coherent multi-probe heads.
+//
+void ImAcqWorker::enqueueAll(
+    AIQ* const          *bQ,
+    const qint16* const *bSrc,
+    const int           *bCts )
+{
+    const int   nID = probes.size();
+    double      tPre = getTime();
+    TraceZone   tz( "imec enq" );
 
-        // ----
-        // sync
-        // ----
+    for( int iID = 0; iID < nID; ++iID ) {
 
-        // @@@ FIX v2.0 Clear bits {1,6}, then shift 1 to 6
+        const ImAcqProbe    &P = probes[iID];
 
-        int stat = H[it].Status;
+        if( P.zeroFill && bCts[iID] ) {
+            bQ[iID]->enqueueZero( P.tPostEnq, tPre );
+            P.zeroFill = false;
+        }
 
-        *dst++ = (stat & 0xBD) + ((stat & 2) << 5);
+        if( bCts[iID] )
+            bQ[iID]->addStamp( P.blkTStamp, tPre );
+    }
 
-        // ------------
-        // TStamp check
-        // ------------
+    AIQ::enqueueBatch( bQ, bSrc, bCts, nID );
 
-        shr.tStampHist_T2( &H[0], P.ip, it );
+    double  tPost = getTime();
 
-    }   // it
+    for( int iID = 0; iID < nID; ++iID ) {
 
-#ifdef PROFILE
-    P.sumScl += getTime() - dtScl;
-#endif
+        const ImAcqProbe    &P = probes[iID];
 
-// -------
-// Enqueue
-// -------
+        if( !bCts[iID] )
+            continue;
 
-    P.tPreEnq = getTime();
+        P.tPreEnq   = tPre;
+        P.tPostEnq  = tPost;
+        P.totPts   += bCts[iID];
 
-    if( P.zeroFill ) {
-        imQ[P.ip]->enqueueZero( P.tPostEnq, P.tPreEnq );
-        P.zeroFill = false;
+        if( Trace::counting() ) {
+            Trace::counter( "imec lag ms", 1000 *
+                (mainApp()->getRun()->getStreamTime() -
+                (bQ[iID]->tZero() + P.totPts / bQ[iID]->sRate())), P.ip );
+        }
     }
+}
 
-    imQ[P.ip]->enqueue( &dst1D[0], nT );
-    P.tPostEnq = getTime();
-    P.totPts  += nT;
 
-#ifdef PROFILE
-    P.sumLag += mainApp()->getRun()->getStreamTime() -
-                (imQ[P.ip]->tZero() + P.totPts / imQ[P.ip]->sRate());
-    P.sumEnq += P.tPostEnq - P.tPreEnq;
-#endif
+// Optionally pin to configured core and raise priority so
+// this worker's fetching is not delayed by other threads.
+//
+void ImAcqWorker::setScheduling()
+{
+    if( core >= 0 ) {
+
+        if( core < 32 && setCurrentThreadAffinityMask( 1u << core ) ) {
+            Debug() <<
+                QString("IMEC worker probes %1-%2 pinned to core %3.")
+                .arg( probes[0].ip )
+                .arg( probes[probes.size()-1].ip )
+                .arg( core );
+        }
+        else {
+            Warning() <<
+                QString("IMEC worker could not pin to core %1.")
+                .arg( core );
+        }
+    }
 
-    return true;
+    if( rtPrio )
+        QThread::currentThread()->setPriority( QThread::TimeCriticalPriority );
 }
 
 
@@ -830,16 +1440,21 @@ bool ImAcqWorker::workerYield()
 // Get maximum outstanding packets for this worker thread
 
     size_t  maxQPkts    = 0;
-    int     nID         = probes.size();
+    int     nID         = probes.size(),
+            maxPct      = 0;
 
     for( int iID = 0; iID < nID; ++iID ) {
 
         const ImAcqProbe    &P = probes[iID];
         size_t              packets;
+        int                 pct;
 
-        if( !P.checkFifo( &packets, acq ) )
+        if( !P.checkFifo( &packets, &pct, acq ) )
             return false;
 
+        if( pct > maxPct )
+            maxPct = pct;
+
         if( P.fetchType == 2 ) {
             // Round to TPNTPERFETCH
             int pkt = packets;
@@ -852,12 +1467,31 @@ bool ImAcqWorker::workerYield()
             maxQPkts = packets;
     }
 
-// Yield time if fewer than the average fetched packet count.
+// Pacing: if fewer than target packets are queued, sleep
+// until the fastest probe is predicted to reach target,
+// then fetch. A fixed usleep(250) would wake too often on
+// fast systems, and on Windows oversleep in 1 ms ticks.
+// Sleep is capped at a quarter of FIFO depth (MAXE), so a
+// stall or rate misestimate can't push us to overflow.
+//
+// The rate is scaled up by recent max FIFO fill%: each 1%
+// backlog shortens sleeps as if packets came that much
+// faster. While the FIFO is empty, waking late just fetches
+// more per call, so half the headroom to MAXE is slack that
+// preciseSleep() needn't spin.
 
     double  t = getTime();
 
-    if( maxQPkts < AVEE ) {
-        QThread::usleep( 250 );
+    fifoLvl += 0.1 * (maxPct - fifoLvl);
+
+    if( maxQPkts < size_t(targPkts) && pktRate > 0 ) {
+
+        double  rate    = pktRate * (1.0 + fifoLvl),
+                dt      = qMin( (targPkts - maxQPkts) / rate,
+                                0.25 * MAXE / rate ),
+                slack   = (fifoLvl < 1.0 ? 0.5 * (MAXE - targPkts) / rate : 0);
+
+        preciseSleep( dt, slack );
         yieldSum += getTime() - t;
     }
 
@@ -874,45 +1508,8 @@ bool ImAcqWorker::workerYield()
         yieldSum            = 0;
         tLastYieldReport    = t;
     }
-
-    return true;
-}
-
-
-// sumN is the number of loop executions in the 5 sec check
-// interval. The minimum value is 5*srate/(MAXE*TPNTPERFETCH).
-//
-// sumTot/sumN is the average loop time to process the samples.
-// The maximum value is MAXE*TPNTPERFETCH/srate.
-//
-// Get measures the time spent fetching the data.
-// Scl measures the time spent scaling the data.
-// Enq measures the time spent enquing data to the stream.
-//
-// Required values header is written at run start.
-//
-void ImAcqWorker::profile( const ImAcqProbe &P )
-{
-#ifndef PROFILE
-    Q_UNUSED( P )
-#else
-    Log() <<
-        QString(
-        "imec %1 loop ms <%2> lag<%3> get<%4> scl<%5> enq<%6> n(%7) %(%8)")
-        .arg( P.ip, 2, 10, QChar('0') )
-        .arg( 1000*P.sumTot/P.sumN, 0, 'f', 3 )
-        .arg( 1000*P.sumLag/P.sumN, 0, 'f', 3 )
-        .arg( 1000*P.sumGet/P.sumN, 0, 'f', 3 )
-        .arg( 1000*P.sumScl/P.sumN, 0, 'f', 3 )
-        .arg( 1000*P.sumEnq/P.sumN, 0, 'f', 3 )
-        .arg( P.sumN )
-        .arg( acq->fifoPct( 0, P ), 2, 10, QChar('0') );
-
-    P.sumLag    = 0;
-    P.sumGet    = 0;
-    P.sumScl    = 0;
-    P.sumEnq    = 0;
-#endif
+
+    return true;
 }
 
 /* ---------------------------------------------------------------- */
@@ -923,10 +1520,12 @@ ImAcqThread::ImAcqThread(
     CimAcqImec              *acq,
     QVector<AIQ*>           &imQ,
     ImAcqShared             &shr,
-    std::vector<ImAcqProbe> &probes )
+    std::vector<ImAcqProbe> &probes,
+    int                     core,
+    bool                    rtPrio )
 {
     thread  = new QThread;
-    worker  = new ImAcqWorker( acq, imQ, shr, probes );
+    worker  = new ImAcqWorker( acq, imQ, shr, probes, core, rtPrio );
 
     worker->moveToThread( thread );
 
@@ -949,6 +1548,31 @@ ImAcqThread::~ImAcqThread()
     delete thread;
 }
 
+/* ---------------------------------------------------------------- */
+/* ImCfgWorker ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Any failure (here or in a sibling) ends all workers promptly.
+//
+void ImCfgWorker::run()
+{
+    for( int i = 0, n = vip.size(); i < n; ++i ) {
+
+        if( acq->isStopped() || acq->cfgFailed() )
+            goto exit;
+
+        if( !acq->_configProbe( acq->T.get_iProbe( vip[i] ) ) ) {
+            acq->setCfgFailed();
+            goto exit;
+        }
+    }
+
+    ok = true;
+
+exit:
+    emit finished();
+}
+
 /* ---------------------------------------------------------------- */
 /* CimAcqImec ----------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -956,7 +1580,8 @@ ImAcqThread::~ImAcqThread()
 CimAcqImec::CimAcqImec( IMReaderWorker *owner, const DAQ::Params &p )
     :   CimAcq( owner, p ),
         T(mainApp()->cfgCtl()->prbTab),
-        pausDocksRequired(0), pausSlot(-1), nThd(0)
+        rawRec(0), pausDocksRequired(0), pausSlot(-1), pausPrb(-1), nThd(0),
+        cfgFail(false)
 {
 }
 
@@ -973,6 +1598,11 @@ CimAcqImec::~CimAcqImec()
         delete imT[iThd];
     }
 
+    if( rawRec ) {
+        delete rawRec;
+        rawRec = 0;
+    }
+
     QThread::msleep( 2000 );
 
 // Close hardware
@@ -996,24 +1626,68 @@ void CimAcqImec::run()
     if( !configure() )
         return;
 
+    ImTelemetry::reset( p.im.get_nProbes() );
+
+// Raw recorder
+
+    if( p.im.all.rawRec ) {
+
+        std::vector<int>    fetchType;
+
+        for( int ip = 0, np = p.im.get_nProbes(); ip < np; ++ip ) {
+            int type = T.get_iProbe( ip ).type;
+            fetchType.push_back( type == 21 || type == 24 ? 2 : 0 );
+        }
+
+        rawRec = new ImRawRec( p, fetchType );
+    }
+
 // Create worker threads
+// - thdMode 0: groups of nPrbPerThd probes.
+// - thdMode 1: one thread per probe.
+// - thdMode 2: one thread per slot.
+// - thdCores:  assigned to threads in order, cycling.
 
 // @@@ FIX Tune probes per thread here and in triggers
-    const int   nPrbPerThd = 3;
+    const int   nPrbPerThd = (p.im.all.thdMode == 1 ? 1 : 3);
+
+    QVector<int>    cores;
+    QStringList     sl = p.im.all.thdCores.split(
+                            QRegExp("[,;\\s]+"),
+                            QString::SkipEmptyParts );
+
+    foreach( const QString &s, sl ) {
 
-    for( int ip0 = 0, np = p.im.get_nProbes(); ip0 < np; ip0 += nPrbPerThd ) {
+        bool    ok;
+        int     c = s.toInt( &ok );
+
+        if( ok && c >= 0 )
+            cores.push_back( c );
+    }
+
+    for( int ip0 = 0, np = p.im.get_nProbes(); ip0 < np; ) {
 
         std::vector<ImAcqProbe> probes;
 
-        for( int id = 0; id < nPrbPerThd; ++id ) {
+        for( int id = 0; ip0 + id < np; ++id ) {
 
-            if( ip0 + id < np )
-                probes.push_back( ImAcqProbe( T, p, ip0 + id ) );
-            else
+            if( p.im.all.thdMode == 2 ) {
+                if( id && T.get_iProbe( ip0 + id ).slot != probes[0].slot )
+                    break;
+            }
+            else if( id >= nPrbPerThd )
                 break;
+
+            probes.push_back( ImAcqProbe( T, p, ip0 + id ) );
         }
 
-        imT.push_back( new ImAcqThread( this, owner->imQ, shr, probes ) );
+        ip0 += probes.size();
+
+        imT.push_back(
+            new ImAcqThread(
+                    this, owner->imQ, shr, probes,
+                    (cores.size() ? cores[nThd % cores.size()] : -1),
+                    p.im.all.thdRTPrio ) );
         ++nThd;
     }
 
@@ -1040,15 +1714,6 @@ void CimAcqImec::run()
 // Run
 // ---
 
-#ifdef PROFILE
-    // Table header, see profile discussion
-    Log() <<
-        QString("Require loop ms < [[ %1 ]] n > [[ %2 ]] MAXE %3")
-        .arg( 1000*MAXE*TPNTPERFETCH/p.im.each[0].srate, 0, 'f', 3 )
-        .arg( qRound( 5*p.im.each[0].srate/(MAXE*TPNTPERFETCH) ) )
-        .arg( MAXE );
-#endif
-
     shr.startT = getTime();
 
 // Wake all workers
@@ -1075,6 +1740,11 @@ void CimAcqImec::update( int ip )
     const CimCfg::ImProbeDat    &P = T.get_iProbe( ip );
     NP_ErrorCode                err;
 
+    if( p.im.all.updPrbOnly ) {
+        updateProbeOnly( P );
+        return;
+    }
+
     pauseSlot( P.slot );
 
     while( !pauseAllAck() )
@@ -1097,26 +1767,7 @@ void CimAcqImec::update( int ip )
 // Update settings this probe
 // --------------------------
 
-    if( P.type == 21 ) {
-        if( !_selectElectrodesN( P ) )
-            return;
-    }
-    else if( !_selectElectrodes1( P ) )
-        return;
-
-    if( !_setReferences( P ) )
-        return;
-
-    if( !_setGains( P ) )
-        return;
-
-    if( !_setHighPassFilter( P ) )
-        return;
-
-    if( !_setStandby( P ) )
-        return;
-
-    if( !_writeProbe( P ) )
+    if( !_updateSettings( P ) )
         return;
 
 // -------------------------------------------------
@@ -1165,6 +1816,44 @@ void CimAcqImec::update( int ip )
     pauseSlot( -1 );
 }
 
+
+// Slot keeps streaming; only this probe's fetching pauses.
+// Its queue is zero-filled for the interval, and the stale
+// FIFO backlog is discarded on resumption.
+//
+// On failure the step has raised runError, so, as for a slot
+// update, the probe stays paused while the run stops.
+//
+void CimAcqImec::updateProbeOnly( const CimCfg::ImProbeDat &P )
+{
+    pauseProbe( P.ip );
+
+    while( !pauseAllAck() )
+        QThread::usleep( 100 );
+
+    if( !_updateSettings( P ) )
+        return;
+
+    pauseProbe( -1 );
+}
+
+
+bool CimAcqImec::_updateSettings( const CimCfg::ImProbeDat &P )
+{
+    if( P.type == 21 ) {
+        if( !_selectElectrodesN( P ) )
+            return false;
+    }
+    else if( !_selectElectrodes1( P ) )
+        return false;
+
+    return _setReferences( P )
+        && _setGains( P )
+        && _setHighPassFilter( P )
+        && _setStandby( P )
+        && _writeProbe( P );
+}
+
 /* ---------------------------------------------------------------- */
 /* Pause controls ------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -1179,6 +1868,16 @@ void CimAcqImec::pauseSlot( int slot )
 }
 
 
+void CimAcqImec::pauseProbe( int ip )
+{
+    QMutexLocker    ml( &runMtx );
+
+    pausPrb             = ip;
+    pausDocksRequired   = (ip >= 0 ? 1 : 0);
+    pausDocksReported.clear();
+}
+
+
 bool CimAcqImec::pauseAck( int port, int dock )
 {
     QMutexLocker    ml( &runMtx );
@@ -1209,11 +1908,13 @@ bool CimAcqImec::fetchE_T0( int &nE, electrodePacket* E, const ImAcqProbe &P )
 // Hardware pause acknowledged here
 // --------------------------------
 
-    if( pausedSlot() == P.slot ) {
+    if( isPaused( P ) ) {
 
 ackPause:
-        if( !pauseAck( P.port, P.dock ) )
-            P.zeroFill = true;
+        if( !pauseAck( P.port, P.dock ) ) {
+            P.zeroFill  = true;
+            P.flushFifo = (pausedProbe() == P.ip);
+        }
 
         return true;
     }
@@ -1264,7 +1965,7 @@ if( P.ip == 0 ) {
 
     if( err != SUCCESS ) {
 
-        if( pausedSlot() == P.slot )
+        if( isPaused( P ) )
             goto ackPause;
 
         runError(
@@ -1277,6 +1978,23 @@ if( P.ip == 0 ) {
 
     nE = out;
 
+// -------------------------------------------
+// Discard backlog from a probe-only pause;
+// that interval is covered by the zero-fill.
+// -------------------------------------------
+
+    if( P.flushFifo ) {
+
+        if( out < MAXE )
+            P.flushFifo = false;
+
+        nE = 0;
+        return true;
+    }
+
+    if( rawRec )
+        rawRec->put_T0( P.ip, E, nE );
+
 #ifdef TUNE
     // Tune AVEE and MAXE on designated probe
     if( TUNE == P.ip ) {
@@ -1317,12 +2035,13 @@ bool CimAcqImec::fetchD_T2( int &nT, struct PacketInfo* H, qint16* D, const ImAc
 // Hardware pause acknowledged here
 // --------------------------------
 
-    if( pausedSlot() == P.slot ) {
+    if( isPaused( P ) ) {
 
 ackPause:
         if( !pauseAck( P.port, P.dock ) ) {
             P.lastTStamp = 0;
-            P.zeroFill = true;
+            P.zeroFill  = true;
+            P.flushFifo = (pausedProbe() == P.ip);
         }
 
         return true;
@@ -1438,7 +2157,7 @@ if( P.ip == 0 ) {
 
     if( err != SUCCESS ) {
 
-        if( pausedSlot() == P.slot )
+        if( isPaused( P ) )
             goto ackPause;
 
         runError(
@@ -1451,6 +2170,23 @@ if( P.ip == 0 ) {
 
     nT = out;
 
+// -------------------------------------------
+// Discard backlog from a probe-only pause;
+// that interval is covered by the zero-fill.
+// -------------------------------------------
+
+    if( P.flushFifo ) {
+
+        if( out < MAXE * TPNTPERFETCH )
+            P.flushFifo = false;
+
+        nT = 0;
+        return true;
+    }
+
+    if( rawRec )
+        rawRec->put_T2( P.ip, H, D, nT, P.nAP );
+
 #ifdef TUNE
     // Tune AVEE and MAXE on designated probe
     if( TUNE == P.ip ) {
@@ -1490,7 +2226,7 @@ int CimAcqImec::fifoPct( size_t *packets, const ImAcqProbe &P ) const
 {
     quint8  pct = 0;
 
-    if( pausedSlot() != P.slot ) {
+    if( !isPaused( P ) ) {
 
         size_t          nused, nempty;
         NP_ErrorCode    err;
@@ -1537,6 +2273,83 @@ int CimAcqImec::fifoPct( size_t *packets, const ImAcqProbe &P ) const
 #define STOPCHECK   if( isStopped() ) return false;
 
 
+// Calibration file index, kept across runs. Key "sn/kind";
+// value is the native path handed to the API, and the size
+// and mtime the file had when staged (read through once so
+// the API's own parse reads from the OS cache). A file is
+// restaged only if its size or mtime changes.
+//
+struct ImCalRec {
+    QString     path;
+    QDateTime   mtime;
+    qint64      size;
+};
+
+static QMutex                   calMtx;
+static QMap<QString,ImCalRec>   calRecs;
+
+
+// Set path to probe sn's calibration file of given kind,
+// staging it if new or changed. Caller has made calibPath().
+//
+static bool calFile(
+    QString         &path,
+    QString         &err,
+    const QString   &sn,
+    const QString   &kind )
+{
+    QString     file = QString("%1/%2/%2_%3.csv")
+                        .arg( calibPath() ).arg( sn ).arg( kind );
+    QFileInfo   fi( file );
+
+    if( !fi.exists() ) {
+        err = QString("Can't find file '%1'.").arg( file );
+        return false;
+    }
+
+    QString         key = sn + "/" + kind;
+    QMutexLocker    ml( &calMtx );
+    ImCalRec        &R  = calRecs[key];
+
+    if( !R.path.isEmpty()
+        && R.size == fi.size()
+        && R.mtime == fi.lastModified() ) {
+
+        path = R.path;
+        return true;
+    }
+
+    QFile   f( file );
+
+    if( !f.open( QIODevice::ReadOnly ) ) {
+        calRecs.remove( key );
+        err = QString("Can't read file '%1'.").arg( file );
+        return false;
+    }
+
+    if( qint64 n = f.size() ) {
+
+        if( uchar *m = f.map( 0, n ) ) {
+
+            volatile uchar  sum = 0;
+
+            for( qint64 i = 0; i < n; i += 4096 )
+                sum += m[i];
+
+            f.unmap( m );
+        }
+        else
+            f.readAll();
+    }
+
+    R.path  = QString(file).replace( "/", "\\" );
+    R.size  = fi.size();
+    R.mtime = fi.lastModified();
+    path    = R.path;
+    return true;
+}
+
+
 void CimAcqImec::SETLBL( const QString &s, bool zero )
 {
     QMetaObject::invokeMethod(
@@ -1770,6 +2583,44 @@ bool CimAcqImec::_openProbe( const CimCfg::ImProbeDat &P )
 }
 
 
+// Index and stage all probes' calibration files up front, so
+// per-probe steps (possibly on several slot workers) only look
+// up a path. Missing files are reported by those steps, which
+// apply calPolicy.
+//
+bool CimAcqImec::_stageCalibration()
+{
+    if( p.im.all.calPolicy == 2 )
+        return true;
+
+    QString path = calibPath();
+
+    if( !QDir().mkpath( path ) ) {
+        runError( QString("Failed to create folder '%1'.").arg( path ) );
+        return false;
+    }
+
+    QString sErr;
+    int     nF = 0;
+
+    for( int ip = 0, np = p.im.get_nProbes(); ip < np; ++ip ) {
+
+        const CimCfg::ImProbeDat    &P = T.get_iProbe( ip );
+
+        if( P.cal < 1 )
+            continue;
+
+        if( P.type != 21 && P.type != 24 )
+            nF += calFile( path, sErr, P.sn, "ADCCalibration" );
+
+        nF += calFile( path, sErr, P.sn, "gainCalValues" );
+    }
+
+    Log() << QString("IMEC staged %1 calibration files").arg( nF );
+    return true;
+}
+
+
 bool CimAcqImec::_calibrateADC( const CimCfg::ImProbeDat &P )
 {
     if( P.type == 21 || P.type == 24 ) {
@@ -1799,22 +2650,13 @@ warn:
 
     SETLBL( QString("calibrate probe %1 ADC").arg( P.ip )  );
 
-    QString path = calibPath();
-
-    if( !QDir().mkpath( path ) ) {
-        runError( QString("Failed to create folder '%1'.").arg( path ) );
-        return false;
-    }
+    QString path, sErr;
 
-    path = QString("%1/%2/%2_ADCCalibration.csv").arg( path ).arg( P.sn ) ;
-
-    if( !QFile( path ).exists() ) {
-        runError( QString("Can't find file '%1'.").arg( path ) );
+    if( !calFile( path, sErr, P.sn, "ADCCalibration" ) ) {
+        runError( sErr );
         return false;
     }
 
-    path.replace( "/", "\\" );
-
     NP_ErrorCode    err;
 
     err = setADCCalibration( P.slot, P.port, STR2CHR( path ) );
@@ -1858,22 +2700,13 @@ warn:
 
     SETLBL( QString("calibrate probe %1 gains").arg( P.ip ) );
 
-    QString path = calibPath();
-
-    if( !QDir().mkpath( path ) ) {
-        runError( QString("Failed to create folder '%1'.").arg( path ) );
-        return false;
-    }
+    QString path, sErr;
 
-    path = QString("%1/%2/%2_gainCalValues.csv").arg( path ).arg( P.sn ) ;
-
-    if( !QFile( path ).exists() ) {
-        runError( QString("Can't find file '%1'.").arg( path ) );
+    if( !calFile( path, sErr, P.sn, "gainCalValues" ) ) {
+        runError( sErr );
         return false;
     }
 
-    path.replace( "/", "\\" );
-
     NP_ErrorCode    err;
 
     err = setGainCalibration( P.slot, P.port, P.dock, STR2CHR( path ) );
@@ -2339,88 +3172,175 @@ bool CimAcqImec::_softStart()
 }
 
 
-bool CimAcqImec::configure()
+// Program one probe, logging time spent in each step.
+//
+// Note: Every step is required at every run start. The session
+// is closed (closeBS) at run end, and openProbe/init return the
+// probe and the API's shadow registers to defaults, so there is
+// no programmed state that survives to a following run; steps
+// can't be skipped just because the settings are unchanged.
+// The logged step times show where startup time goes.
+//
+bool CimAcqImec::_configProbe( const CimCfg::ImProbeDat &P )
 {
-    STOPCHECK;
+    QString tStr;
+    double  t0 = getTime(),
+            tPrev = t0;
 
-    if( !_allProbesSizeStreamBufs() )
-        return false;
+#define CFGSTEP( step, name )                                   \
+    if( !(step) )                                               \
+        return false;                                           \
+    STOPCHECK;                                                  \
+    {                                                           \
+        double  tNow = getTime();                               \
+        tStr += QString(" %1 %2").arg( name )                   \
+                .arg( tNow - tPrev, 0, 'f', 3 );                \
+        tPrev = tNow;                                           \
+    }
 
     STOPCHECK;
 
-    if( !_open( T ) )
-        return false;
+    CFGSTEP( _openProbe( P ), "open" );
+    CFGSTEP( _calibrateADC( P ), "adc" );
+    CFGSTEP( _calibrateGain( P ), "gain" );
+//    CFGSTEP( _dataGenerator( P ), "datagen" );
+    CFGSTEP( _setLEDs( P ), "led" );
 
-    STOPCHECK;
+    if( P.type == 21 ) {
+        CFGSTEP( _selectElectrodesN( P ), "elec" );
+    }
+    else {
+        CFGSTEP( _selectElectrodes1( P ), "elec" );
+    }
 
-    if( !_setSync( T ) )
-        return false;
+    CFGSTEP( _setReferences( P ), "ref" );
+    CFGSTEP( _setGains( P ), "gains" );
+    CFGSTEP( _setHighPassFilter( P ), "filter" );
+    CFGSTEP( _setStandby( P ), "stdby" );
+    CFGSTEP( _writeProbe( P ), "write" );
 
-    STOPCHECK;
+#undef CFGSTEP
 
-    for( int ip = 0, np = p.im.get_nProbes(); ip < np; ++ip ) {
+    Log() <<
+        QString("IMEC probe %1 config secs:%2 total %3")
+        .arg( P.ip ).arg( tStr ).arg( getTime() - t0, 0, 'f', 3 );
 
-        const CimCfg::ImProbeDat    &P = T.get_iProbe( ip );
+    return true;
+}
 
-        if( !_openProbe( P ) )
-            return false;
 
-        STOPCHECK;
+bool CimAcqImec::_configProbes()
+{
+    for( int ip = 0, np = p.im.get_nProbes(); ip < np; ++ip ) {
 
-        if( !_calibrateADC( P ) )
+        if( !_configProbe( T.get_iProbe( ip ) ) )
             return false;
+    }
 
-        STOPCHECK;
+    return true;
+}
 
-        if( !_calibrateGain( P ) )
-            return false;
 
-//        STOPCHECK;
+// One worker per slot: the API serializes calls within a slot,
+// but distinct slots can be programmed concurrently.
+//
+bool CimAcqImec::_configProbesParallel()
+{
+    QMap<int,QVector<int> > slot2ips;
 
-//        if( !_dataGenerator( P ) )
-//            return false;
+    for( int ip = 0, np = p.im.get_nProbes(); ip < np; ++ip )
+        slot2ips[T.get_iProbe( ip ).slot].push_back( ip );
 
-        STOPCHECK;
+    if( slot2ips.size() < 2 )
+        return _configProbes();
 
-        if( !_setLEDs( P ) )
-            return false;
+    QVector<QThread*>       vT;
+    QVector<ImCfgWorker*>   vW;
+    bool                    ok = true;
 
-        STOPCHECK;
+    cfgFail = false;
 
-        if( P.type == 21 ) {
-            if( !_selectElectrodesN( P ) )
-                return false;
-        }
-        else if( !_selectElectrodes1( P ) )
-            return false;
+    QMap<int,QVector<int> >::const_iterator it  = slot2ips.begin(),
+                                            end = slot2ips.end();
 
-        STOPCHECK;
+    for( ; it != end; ++it ) {
 
-        if( !_setReferences( P ) )
-            return false;
+        QThread     *thread = new QThread;
+        ImCfgWorker *worker = new ImCfgWorker( this, it.value() );
 
-        STOPCHECK;
+        worker->moveToThread( thread );
 
-        if( !_setGains( P ) )
-            return false;
+        Connect( thread, SIGNAL(started()), worker, SLOT(run()) );
+        Connect( worker, SIGNAL(finished()), thread, SLOT(quit()), Qt::DirectConnection );
 
-        STOPCHECK;
+        vT.push_back( thread );
+        vW.push_back( worker );
 
-        if( !_setHighPassFilter( P ) )
-            return false;
+        thread->start();
+    }
 
-        STOPCHECK;
+    for( int i = 0, n = vT.size(); i < n; ++i ) {
 
-        if( !_setStandby( P ) )
-            return false;
+        vT[i]->wait();
 
-        STOPCHECK;
+        ok = ok && vW[i]->ok;
 
-        if( !_writeProbe( P ) )
-            return false;
+        delete vW[i];
+        delete vT[i];
+    }
+
+    return ok;
+}
+
+
+bool CimAcqImec::configure()
+{
+    QString tStr;
+    double  t0 = getTime(),
+            tPrev = t0;
+
+#define CFGPHASE( name )                                        \
+    {                                                           \
+        double  tNow = getTime();                               \
+        tStr += QString(" %1 %2").arg( name )                   \
+                .arg( tNow - tPrev, 0, 'f', 3 );                \
+        tPrev = tNow;                                           \
+    }
+
+    STOPCHECK;
+
+    if( !_allProbesSizeStreamBufs() )
+        return false;
+
+    STOPCHECK;
+
+    if( !_stageCalibration() )
+        return false;
+
+    CFGPHASE( "calib" );
+    STOPCHECK;
+
+    if( !_open( T ) )
+        return false;
+
+    CFGPHASE( "open" );
+    STOPCHECK;
+
+    if( !_setSync( T ) )
+        return false;
+
+    CFGPHASE( "sync" );
+    STOPCHECK;
 
-        STOPCHECK;
+    if( p.im.all.cfgParallel ) {
+        if( !_configProbesParallel() )
+            return false;
     }
+    else if( !_configProbes() )
+        return false;
+
+    CFGPHASE( "probes" );
+    STOPCHECK;
 
     if( !_setTrigger() )
         return false;
@@ -2428,6 +3348,15 @@ bool CimAcqImec::configure()
     if( !_setArm() )
         return false;
 
+    CFGPHASE( "trigger" );
+
+#undef CFGPHASE
+
+    Log() <<
+        QString("IMEC configure secs (%1):%2 total %3")
+        .arg( p.im.all.cfgParallel ? "parallel" : "serial" )
+        .arg( tStr ).arg( getTime() - t0, 0, 'f', 3 );
+
 // Flush all progress messages
     SETVALBLOCKING( 100 );
 
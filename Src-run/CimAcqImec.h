@@ -8,7 +8,12 @@
 
 #include <QSet>
 
+#include <atomic>
+
+class QFile;
+
 class CimAcqImec;
+class QThread;
 
 
 /* ---------------------------------------------------------------- */
@@ -26,7 +31,7 @@ struct ImAcqShared {
     QWaitCondition          condWake;
     int                     awake,
                             asleep;
-    bool                    stop;
+    std::atomic<bool>       stop;
 
     ImAcqShared();
 
@@ -49,30 +54,44 @@ struct ImAcqShared {
             ++asleep;
             condWake.wait( &runMtx );
             ++awake;
-            run = !stop;
+            run = !stop.load( std::memory_order_acquire );
         runMtx.unlock();
         return run;
     }
 
-    bool stopping()
-    {
-        bool    _stop;
-        runMtx.lock();
-            _stop = stop;
-        runMtx.unlock();
-        return _stop;
-    }
+    bool stopping() const
+        {return stop.load( std::memory_order_acquire );}
 
     void kill()
     {
         runMtx.lock();
-            stop = true;
+            stop.store( true, std::memory_order_release );
         runMtx.unlock();
         condWake.wakeAll();
     }
 };
 
 
+// Per-architecture scaling kernels (packets -> interleaved
+// AP, LF, SY timepoints), picked once per probe; see
+// CimAcqImec.cpp.
+//
+typedef void (*ImScaleT0Fn)(
+    qint16                  *dst,
+    float                   *lfLast,
+    const electrodePacket   *E,
+    int                     nE,
+    int                     nAP,
+    int                     nLF );
+
+typedef void (*ImScaleT2Fn)(
+    qint16                      *dst,
+    const qint16                *src,
+    const struct PacketInfo     *H,
+    int                         nT,
+    int                         nAP );
+
+
 struct ImAcqProbe {
 // @@@ FIX Experiment to report large fetch cycle times.
     mutable double  tLastFetch,
@@ -81,11 +100,7 @@ struct ImAcqProbe {
                     tPreEnq,
                     tPostEnq,
                     peakDT,
-                    sumTot,
-                    sumLag,
-                    sumGet,
-                    sumScl,
-                    sumEnq;
+                    sumTot;
     mutable quint64 totPts;
 // Experiment to detect gaps in timestamps across fetches.
     mutable quint32 lastTStamp,
@@ -94,7 +109,8 @@ struct ImAcqProbe {
                     errLOCK,
                     errPOP,
                     errSYNC,
-                    tStampLastFetch;
+                    tStampLastFetch,
+                    blkTStamp;      // this fetch's first timestamp
     mutable int     fifoAve,
                     fifoN,
                     sumN;
@@ -107,7 +123,10 @@ struct ImAcqProbe {
                     port,
                     dock,
                     fetchType;  // accommodate custom probe architectures
-    mutable bool    zeroFill;
+    ImScaleT0Fn     scaleT0;
+    ImScaleT2Fn     scaleT2;
+    mutable bool    zeroFill,
+                    flushFifo;  // drop backlog after probe-only pause
 
     ImAcqProbe()    {}
     ImAcqProbe(
@@ -119,7 +138,118 @@ struct ImAcqProbe {
     void sendErrMetrics() const;
     void checkErrFlags_T0( const electrodePacket* E, int nE ) const;
     void checkErrFlags_T2( const struct PacketInfo* H, int nT ) const;
-    bool checkFifo( size_t *packets, CimAcqImec *acq ) const;
+    bool checkFifo( size_t *packets, int *pct, CimAcqImec *acq ) const;
+};
+
+
+// Fetch-ahead helper for a worker with several 2.0 (T2)
+// probes: while the worker scales and stages probe N, this
+// thread runs the API read for probe N+1 into the other of
+// two reusable packet buffers.
+//
+class ImAcqPrefetch : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Buf {
+        std::vector<struct PacketInfo>  H;
+        std::vector<qint16>             D;
+        int                             nT;
+        bool                            ok;
+    };
+
+private:
+    CimAcqImec          *acq;
+    QThread             *thread;
+    const ImAcqProbe    *req;       // guarded by mtx
+    Buf                 bufs[2];
+    QMutex              mtx;
+    QWaitCondition      condReq,
+                        condDone;
+    int                 iBuf;       // buffer of current request
+    bool                busy,       // guarded by mtx
+                        pleaseStop; // guarded by mtx
+
+public:
+    ImAcqPrefetch( CimAcqImec *acq, int maxAP );
+    virtual ~ImAcqPrefetch();
+
+    void request( const ImAcqProbe &P );
+    Buf &wait();
+
+public slots:
+    void run();
+};
+
+
+// Optional raw recorder: fetch threads post each fetched
+// block, exactly as returned by the API, to a per-probe
+// lock-free SPSC byte ring; a dedicated I/O thread drains
+// the rings to sidecar files <runName>.imec<ip>.pkt.
+//
+// File: RawFileHdr, then per fetch:
+//  RawRecHdr, then
+//  T0: electrodePacket[nPkt]
+//  T2: PacketInfo[nPkt], qint16[nPkt * nChan]
+//
+// A full ring drops the record (counted), never blocking
+// the fetch thread.
+//
+class ImRawRec : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct RawFileHdr {
+        quint32 magic,      // 'SGLP'
+                version,    // 1
+                ip,
+                fetchType,
+                nChan;      // T2 data stride
+    };
+
+    struct RawRecHdr {
+        double  tFetch;     // getTime()
+        quint32 nPkt,
+                nBytes;     // payload
+    };
+
+private:
+    struct Ring {
+        std::vector<quint8>     buf;
+        std::atomic<quint64>    wrPos,
+                                rdPos;
+        QFile                   *f;
+        quint64                 nDrop;
+        Ring() : wrPos(0), rdPos(0), f(0), nDrop(0)    {}
+    };
+
+    enum { RINGBYTES = 16 * 1024 * 1024 };
+
+    QThread                 *thread;
+    std::vector<Ring*>      R;
+    std::atomic<bool>       pleaseStop;
+
+public:
+    ImRawRec( const DAQ::Params &p, const std::vector<int> &fetchType );
+    virtual ~ImRawRec();
+
+    void put_T0( int ip, const electrodePacket *E, int nE );
+    void put_T2( int ip, const struct PacketInfo *H, const qint16 *D, int nT, int nChan );
+
+public slots:
+    void run();
+
+private:
+    bool post(
+        int             ip,
+        int             nPkt,
+        const void      *src1,
+        int             n1,
+        const void      *src2,
+        int             n2 );
+    bool drain( Ring &G );
 };
 
 
@@ -133,20 +263,27 @@ private:
     double                          tLastYieldReport,
                                     yieldSum,
                                     loopT,
-                                    lastCheckT;
+                                    lastCheckT,
+                                    pktRate,    // fastest probe pkts/s
+                                    fifoLvl;    // smoothed max fill%
     CimAcqImec                      *acq;
     QVector<AIQ*>                   &imQ;
     ImAcqShared                     &shr;
     std::vector<ImAcqProbe>         probes;
     std::vector<struct PacketInfo>  H;
     std::vector<qint32>             D;
+    int                             core,   // {-1=any}
+                                    targPkts;
+    bool                            rtPrio;
 
 public:
     ImAcqWorker(
         CimAcqImec              *acq,
         QVector<AIQ*>           &imQ,
         ImAcqShared             &shr,
-        std::vector<ImAcqProbe> &probes );
+        std::vector<ImAcqProbe> &probes,
+        int                     core,
+        bool                    rtPrio );
     virtual ~ImAcqWorker()  {}
 
 signals:
@@ -157,14 +294,21 @@ public slots:
 
 private:
     bool doProbe_T0(
+        int                 &nT,
         float               *lfLast,
         vec_i16             &dst1D,
         const ImAcqProbe    &P );
     bool doProbe_T2(
+        int                 &nT,
         vec_i16             &dst1D,
-        const ImAcqProbe    &P );
+        const ImAcqProbe    &P,
+        ImAcqPrefetch::Buf  *B = 0 );
+    void enqueueAll(
+        AIQ* const          *bQ,
+        const qint16* const *bSrc,
+        const int           *bCts );
+    void setScheduling();
     bool workerYield();
-    void profile( const ImAcqProbe &P );
 };
 
 
@@ -179,26 +323,59 @@ public:
         CimAcqImec              *acq,
         QVector<AIQ*>           &imQ,
         ImAcqShared             &shr,
-        std::vector<ImAcqProbe> &probes );
+        std::vector<ImAcqProbe> &probes,
+        int                     core,
+        bool                    rtPrio );
     virtual ~ImAcqThread();
 };
 
 
+// Configures the probes of one slot (parallel run start).
+//
+class ImCfgWorker : public QObject
+{
+    Q_OBJECT
+
+private:
+    CimAcqImec      *acq;
+    QVector<int>    vip;
+
+public:
+    bool            ok;
+
+public:
+    ImCfgWorker( CimAcqImec *acq, const QVector<int> &vip )
+    :   QObject(0), acq(acq), vip(vip), ok(false)   {}
+    virtual ~ImCfgWorker()  {}
+
+signals:
+    void finished();
+
+public slots:
+    void run();
+};
+
+
 // Hardware IMEC input
 //
 class CimAcqImec : public CimAcq
 {
     friend struct ImAcqProbe;
     friend class  ImAcqWorker;
+    friend class  ImAcqPrefetch;
+    friend class  ImCfgWorker;
 
 private:
     const CimCfg::ImProbeTable  &T;
     ImAcqShared                 shr;
     std::vector<ImAcqThread*>   imT;
+    ImRawRec                    *rawRec;
     QSet<int>                   pausDocksReported;
     int                         pausDocksRequired,
                                 pausSlot,
+                                pausPrb,
                                 nThd;
+    bool                        cfgFail;    // guarded by runMtx
 
 public:
     CimAcqImec( IMReaderWorker *owner, const DAQ::Params &p );
@@ -209,7 +386,14 @@ public:
 
 private:
     void pauseSlot( int slot );
+    void pauseProbe( int ip );
     int  pausedSlot() const {QMutexLocker ml( &runMtx ); return pausSlot;}
+    int  pausedProbe() const {QMutexLocker ml( &runMtx ); return pausPrb;}
+    bool isPaused( const ImAcqProbe &P ) const
+        {
+            QMutexLocker ml( &runMtx );
+            return pausSlot == P.slot || pausPrb == P.ip;
+        }
     bool pauseAck( int port, int dock );
     bool pauseAllAck() const;
 
@@ -227,6 +411,7 @@ private:
     bool _setSyncAsInput( int slot );
     bool _setSync( const CimCfg::ImProbeTable &T );
     bool _openProbe( const CimCfg::ImProbeDat &P );
+    bool _stageCalibration();
     bool _calibrateADC( const CimCfg::ImProbeDat &P );
     bool _calibrateGain( const CimCfg::ImProbeDat &P );
     bool _dataGenerator( const CimCfg::ImProbeDat &P );
@@ -238,12 +423,19 @@ private:
     bool _setHighPassFilter( const CimCfg::ImProbeDat &P );
     bool _setStandby( const CimCfg::ImProbeDat &P );
     bool _writeProbe( const CimCfg::ImProbeDat &P );
+    bool _updateSettings( const CimCfg::ImProbeDat &P );
+    void updateProbeOnly( const CimCfg::ImProbeDat &P );
+    bool _configProbe( const CimCfg::ImProbeDat &P );
+    bool _configProbes();
+    bool _configProbesParallel();
 
     bool _setTrigger();
     bool _setArm();
 
     bool _softStart();
 
+    bool cfgFailed() const  {QMutexLocker ml( &runMtx ); return cfgFail;}
+    void setCfgFailed()     {QMutexLocker ml( &runMtx ); cfgFail = true;}
     bool configure();
     bool startAcq();
     void runError( QString err );
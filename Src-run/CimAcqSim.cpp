@@ -3,6 +3,11 @@
 #include "Util.h"
 #include "MainApp.h"
 #include "ConfigCtl.h"
+#include "RunBench.h"
+#include "ThdPlace.h"
+#include "Trace.h"
+#include "DFName.h"
+#include "SimReplay.h"
 
 #include <QThread>
 
@@ -20,7 +25,24 @@
 #define MAXS            288
 #define LOOPSECS        0.003
 #define SINEWAVES
-#define PROFILE
+#define SIMXTRASECS     4
+#define SIMBANK         8192
+
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// SplitMix64 finalizer: stateless, so generated data depend only
+// upon their inputs.
+//
+static inline quint64 simHash( quint64 x )
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x  = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x  = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
 
 
 /* ---------------------------------------------------------------- */
@@ -36,32 +58,36 @@ ImSimShared::ImSimShared()
 /* ImSimProbe ----------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
+// Probe ip simulates table probe ipSrc; these differ
+// only for extra (beyond table) load-test probes.
+//
 ImSimProbe::ImSimProbe(
     const CimCfg::ImProbeTable  &T,
     const DAQ::Params           &p,
-    int                         ip )
-    :   peakDT(0), sumTot(0),
-        totPts(0ULL), ip(ip),
+    int                         ip,
+    int                         ipSrc )
+    :   peakDT(0), runPeakDT(0), sumTot(0),
+        totPts(0ULL), rep(0), bank(0), ip(ip),
         sumN(0)
 {
-#ifdef PROFILE
-    sumGet  = 0;
-    sumEnq  = 0;
-    sumLok  = 0;
-    sumWrk  = 0;
-    sumPts  = 0;
-#endif
-
-    const CimCfg::AttrEach  &E      = p.im.each[ip];
+    const CimCfg::AttrEach  &E      = p.im.each[ipSrc];
     const int               *cum    = E.imCumTypCnt;
 
+    key = simHash( p.im.all.simSeed ) ^ (quint64(ip) << 48);
+
+    const QStringList   sl = p.im.all.simPPM.split(
+                                QRegExp("^\\s+|\\s*,\\s*"),
+                                QString::SkipEmptyParts );
+
     srate   = E.srate;
+    bankOff = int(key % SIMBANK);
+    ppm     = (sl.size() ? sl[ip % sl.size()].toDouble() : 0);
     nAP     = cum[CimCfg::imTypeAP];
     nLF     = cum[CimCfg::imTypeLF] - cum[CimCfg::imTypeAP];
     nSY     = cum[CimCfg::imTypeSY] - cum[CimCfg::imTypeLF];
     nCH     = nAP + nLF + nSY;
 
-    const CimCfg::ImProbeDat    &P = T.get_iProbe( ip );
+    const CimCfg::ImProbeDat    &P = T.get_iProbe( ipSrc );
     slot = P.slot;
     port = P.port;
 
@@ -90,10 +116,17 @@ void ImSimWorker::run()
 
     const int   nID = probes.size();
 
+    ThdPlace::apply(
+        ThdPlace::roleIMFetch,
+        QString("imec sim %1-%2")
+        .arg( probes[0].ip ).arg( probes[nID-1].ip ) );
+
     i16Buf.resize( nID );
 
-    for( int iID = 0; iID < nID; ++iID )
+    for( int iID = 0; iID < nID; ++iID ) {
         i16Buf[iID].resize( MAXS * probes[iID].nCH );
+        imQ[probes[iID].ip]->placeLocal();
+    }
 
     if( !shr.wait() )
         goto exit;
@@ -116,9 +149,19 @@ void ImSimWorker::run()
 
             ImSimProbe  &P = probes[iID];
 
-            if( !P.totPts )
+            if( !P.totPts ) {
+
+                const DAQ::Params   &p = acq->p;
+
                 imQ[P.ip]->setTZero( loopT + T0FUDGE );
 
+                P.sync.init(
+                    loopT + T0FUDGE, P.srate * p.im.all.simSpeed, P.ppm,
+                    (p.sync.sourceIdx != DAQ::eSyncSourceNone ?
+                        p.sync.sourcePeriod : 1.0),
+                    1e-6 * p.im.all.simJitUs, P.key );
+            }
+
             double  dtTot = getTime();
 
             if( !doProbe( i16Buf[iID], P ) )
@@ -129,6 +172,9 @@ void ImSimWorker::run()
             if( dtTot > P.peakDT )
                 P.peakDT = dtTot;
 
+            if( dtTot > P.runPeakDT )
+                P.runPeakDT = dtTot;
+
             P.sumTot += dtTot;
             ++P.sumN;
         }
@@ -139,7 +185,7 @@ void ImSimWorker::run()
 
         double  dt = getTime() - loopT;
 
-        if( dt < LOOPSECS )
+        if( dt < LOOPSECS && !acq->p.im.all.simFast )
             QThread::usleep( 250 );
 
         // ---------------
@@ -152,9 +198,6 @@ void ImSimWorker::run()
 
                 ImSimProbe  &P = probes[iID];
 
-#ifdef PROFILE
-                profile( P );
-#endif
                 P.peakDT    = 0;
                 P.sumTot    = 0;
                 P.sumN      = 0;
@@ -164,17 +207,17 @@ void ImSimWorker::run()
         }
     }
 
+    for( int iID = 0; iID < nID; ++iID )
+        runStats( probes[iID] );
+
 exit:
+    RunBench::addCPU( RunBench::stgAcq );
     emit finished();
 }
 
 
 bool ImSimWorker::doProbe( vec_i16 &dst1D, ImSimProbe &P )
 {
-#ifdef PROFILE
-    double  prbT0 = getTime();
-#endif
-
     qint16* dst = &dst1D[0];
     int     nS;
 
@@ -182,80 +225,54 @@ bool ImSimWorker::doProbe( vec_i16 &dst1D, ImSimProbe &P )
 // Fetch
 // -----
 
-    nS = acq->fetchE( dst, P, loopT );
+    {
+        TraceZone   tz( "imec sim gen", P.ip );
 
-#ifdef PROFILE
-    P.sumPts += nS;
-#endif
+        nS = acq->fetchE( dst, P, loopT );
+    }
 
     if( !nS )
         return true;
 
-#ifdef PROFILE
-    P.sumGet += getTime() - prbT0;
-#endif
-
 // -------
 // Enqueue
 // -------
 
-#ifdef PROFILE
-    double  dtEnq = getTime();
-#endif
+    {
+        TraceZone   tz( "imec enq", P.ip );
 
-    double  tLock, tWork;
+        imQ[P.ip]->enqueue( dst, nS );
+    }
 
-    imQ[P.ip]->enqueueProfile( tLock, tWork, dst, nS );
     P.totPts += nS;
 
-#ifdef PROFILE
-    P.sumEnq += getTime() - dtEnq;
-    P.sumLok += tLock;
-    P.sumWrk += tWork;
-#endif
+    if( Trace::counting() ) {
+        Trace::counter( "imec lag ms",
+            1000*(getTime() - imQ[P.ip]->endTime()), P.ip );
+    }
 
     return true;
 }
 
 
-// sumN is the number of loop executions in the 5 sec check
-// interval. The minimum value is 5*srate/MAXS.
-//
-// sumTot/sumN is the average loop time to process the samples.
-// The maximum value is MAXS/srate.
-//
-// Pts measures pts per fetch.
-// Get measures the time spent fetching/making the data.
-// Enq measures total time spent enquing stream data.
-// Lok measures the time spent waiting for queue lock.
-// Wrk measures the time spent allocating and writing.
+// Whole-run summary: achieved rate vs nominal measures the
+// pipeline ceiling in fast mode, or keeping up in realtime.
 //
-// Required values header is written at run start.
-//
-void ImSimWorker::profile( ImSimProbe &P )
+void ImSimWorker::runStats( const ImSimProbe &P )
 {
-#ifndef PROFILE
-    Q_UNUSED( P )
-#else
+    double  secs = getTime() - shr.startT;
+
+    if( secs <= 0 || !P.totPts )
+        return;
+
     Log() <<
         QString(
-        "imec %1 loop ms <%2> lag <%3> gen<%4>"
-        " enq<%5> lok<%6> wrk<%7> n(%8)")
+        "imec %1 sim pts %2 rate %3 (x%4 nominal) peak loop ms %5")
         .arg( P.ip, 2, 10, QChar('0') )
-        .arg( 1000*P.sumTot/P.sumN, 0, 'f', 3 )
-        .arg( 1000*(getTime() - imQ[P.ip]->endTime()), 0, 'f', 3 )
-        .arg( 1000*P.sumGet/P.sumN, 0, 'f', 3 )
-        .arg( 1000*P.sumEnq/P.sumN, 0, 'f', 3 )
-        .arg( 1000*P.sumLok/P.sumN, 0, 'f', 3 )
-        .arg( 1000*P.sumWrk/P.sumN, 0, 'f', 3 )
-        .arg( P.sumN );
-
-    P.sumGet    = 0;
-    P.sumEnq    = 0;
-    P.sumLok    = 0;
-    P.sumWrk    = 0;
-    P.sumPts    = 0;
-#endif
+        .arg( P.totPts )
+        .arg( P.totPts / secs, 0, 'f', 1 )
+        .arg( P.totPts / (secs * P.srate), 0, 'f', 3 )
+        .arg( 1000*P.runPeakDT, 0, 'f', 3 );
 }
 
 /* ---------------------------------------------------------------- */
@@ -319,6 +336,12 @@ CimAcqSim::~CimAcqSim()
         imT[iThd]->thread->wait( 10000/nThd );
         delete imT[iThd];
     }
+
+    for( int ip = owner->imQ.size(), np = simQ.size(); ip < np; ++ip )
+        delete simQ[ip];
+
+    for( int ip = 0, np = reps.size(); ip < np; ++ip )
+        delete reps[ip];
 }
 
 /* ---------------------------------------------------------------- */
@@ -348,21 +371,89 @@ void CimAcqSim::run()
 // MS: support a target probe count.
 
 // @@@ FIX Tune probes per thread here and in triggers
-    const int   nPrbPerThd = 3;
+    const int   nPrbPerThd = 3,
+                nTab       = p.im.get_nProbes(),
+                nSim       = (nTab ? qMax( nTab, p.im.all.simPrbs ) : 0);
+
+// Extra load-test probes get private queues
+
+    simQ = owner->imQ;
+
+    for( int ip = nTab; ip < nSim; ++ip ) {
+
+        const CimCfg::AttrEach  &E = p.im.each[ip % nTab];
+
+        simQ.push_back(
+            new AIQ(
+                E.srate,
+                E.imCumTypCnt[CimCfg::imSumAll],
+                SIMXTRASECS ) );
+    }
+
+    if( nSim > nTab ) {
+        Log() << QString("IMEC simulating %1 extra probes.")
+                    .arg( nSim - nTab );
+    }
+
+    if( !p.im.all.simPPM.isEmpty() || p.im.all.simJitUs > 0 ) {
+        Log() << QString("IMEC sim clock drift ppm {%1} jitter %2 us.")
+                    .arg( p.im.all.simPPM )
+                    .arg( p.im.all.simJitUs );
+    }
+
+// Optional file sources for table probes
+
+    if( !p.im.all.simReplay.isEmpty() ) {
+
+        DFRunTag    tag( p.im.all.simReplay );
+
+        for( int ip = 0; ip < nTab; ++ip ) {
+
+            const CimCfg::AttrEach  &E = p.im.each[ip];
+            QString                 err;
+
+            reps.push_back( new SimReplay );
+
+            if( !reps[ip]->open(
+                    err, tag.filename( ip, "ap.bin" ), ip,
+                    E.imCumTypCnt[CimCfg::imSumAll], E.srate ) ) {
+
+                runError( err );
+                return;
+            }
+        }
+    }
+
+#ifdef SINEWAVES
+    if( p.im.all.simBank && reps.empty() ) {
+
+        banks.resize( nTab );
+
+        for( int ip = 0; ip < nTab; ++ip )
+            genBank( banks[ip], ImSimProbe( T, p, ip, ip ) );
+    }
+#endif
 
-    for( int ip0 = 0, np = p.im.get_nProbes(); ip0 < np; ip0 += nPrbPerThd ) {
+    for( int ip0 = 0; ip0 < nSim; ip0 += nPrbPerThd ) {
 
         std::vector<ImSimProbe> probes;
 
         for( int id = 0; id < nPrbPerThd; ++id ) {
 
-            if( ip0 + id < np )
-                probes.push_back( ImSimProbe( T, p, ip0 + id ) );
+            int ip = ip0 + id;
+
+            if( ip < nSim ) {
+                probes.push_back( ImSimProbe( T, p, ip, ip % nTab ) );
+                if( ip < (int)reps.size() )
+                    probes.back().rep = reps[ip];
+                else if( banks.size() )
+                    probes.back().bank = &banks[ip % nTab][0];
+            }
             else
                 break;
         }
 
-        imT.push_back( new ImSimThread( this, owner->imQ, shr, probes ) );
+        imT.push_back( new ImSimThread( this, simQ, shr, probes ) );
         ++nThd;
     }
 
@@ -389,15 +480,6 @@ void CimAcqSim::run()
 // Run
 // ---
 
-#ifdef PROFILE
-    // Table header, see profile discussion
-    Log() <<
-        QString("Require loop ms < [[ %1 ]] n > [[ %2 ]] MAXS %3")
-        .arg( 1000*MAXS/p.im.each[0].srate, 0, 'f', 3 )
-        .arg( qRound( 5*p.im.each[0].srate/MAXS ) )
-        .arg( MAXS );
-#endif
-
     shr.startT = getTime();
 
 // Wake all workers
@@ -419,24 +501,37 @@ void CimAcqSim::run()
 
 #ifdef SINEWAVES
 
-// Give each analog channel a sin wave of period T.
+// Give each analog channel a sin wave of period sampPerT.
 // Amp = 100 uV.
-// Sync words get zeros.
+//
+// Add spikes (~20 Hz per probe, 1 ms, -200 uV peak) to AP
+// channels, each centered on a random channel and tapering
+// over 4 neighbors either side.
+//
+// Sync words carry the pulser (sync) on bit 6.
+//
+// Everything derives from (key, sample index), not from the
+// fetch history, so streams are reproducible given the seed.
 //
 static void genNPts(
     qint16          *dst,
     const double    *gain,
+    const SimPulser &sync,
     double          maxV,
     double          srate,
+    double          sampPerT,
+    quint64         key,
+    int             nAP,
     int             nNeu,
     int             nCH,
     quint64         cumSamp,
     int             nPts )
 {
-    const double    Tsec        = 1.0,
-                    sampPerT    = Tsec * srate,
-                    f           = 2*M_PI / sampPerT,
-                    A           = MAX10BIT * 100e-6 / maxV;
+    const double    f           = 2*M_PI / sampPerT,
+                    A           = MAX10BIT * 100e-6 / maxV,
+                    S           = MAX10BIT * 200e-6 / maxV;
+    const int       W           = qMax( 8, int(srate / 1000) ),
+                    spkDiv      = qMax( 1, int(srate / 20) );
 
     for( int s = 0; s < nPts; ++s ) {
 
@@ -450,12 +545,135 @@ static void genNPts(
 
         for( int c = nNeu; c < nCH; ++c )
             dst[c + s*nCH] = 0;
+
+        if( nCH > nNeu && sync.level( cumSamp + s ) )
+            dst[nNeu + s*nCH] = 1 << 6;
+    }
+
+// Spikes: include those that started up to W-1 samples
+// before this block.
+
+    if( !nAP )
+        return;
+
+    quint64 t0 = (cumSamp >= quint64(W-1) ? cumSamp - (W-1) : 0),
+            tLim = cumSamp + nPts;
+
+    for( quint64 t = t0; t < tLim; ++t ) {
+
+        quint64 h = simHash( key + t );
+
+        if( h % spkDiv )
+            continue;
+
+        int ctr = int((simHash( h ) >> 16) % nAP);
+
+        for( int k = 0; k < W; ++k ) {
+
+            qint64  s = qint64(t - cumSamp) + k;
+
+            if( s < 0 )
+                continue;
+            else if( s >= nPts )
+                break;
+
+            double  V = -S * sin( M_PI * (k + 0.5) / W );
+
+            for( int c = qMax( 0, ctr - 4 ),
+                 cLim = qMin( nAP, ctr + 5 ); c < cLim; ++c ) {
+
+                qint16  &d = dst[c + s*nCH];
+
+                d = qBound( -MAX10BIT,
+                        d + int(gain[c] * V * (1.0 - qAbs( c - ctr )/5.0)),
+                        MAX10BIT-1 );
+            }
+        }
+    }
+}
+
+
+// Fill bank with SIMBANK scans like P's generated stream, but
+// with sine period SIMBANK so the ring wraps seamlessly, and
+// optional noise (~uniform sum, imSimNoiseUV rms) baked in.
+// SY words are left zero for copyBank to fill.
+//
+void CimAcqSim::genBank( vec_i16 &bank, const ImSimProbe &P ) const
+{
+    SimPulser   off;
+    int         nNeu = P.nAP + P.nLF;
+
+    bank.resize( SIMBANK * P.nCH );
+
+    genNPts(
+        &bank[0], &P.gain[0], off, maxV, P.srate, SIMBANK, P.key,
+        P.nAP, nNeu, P.nCH, 0, SIMBANK );
+
+    if( p.im.all.simNoiseUV > 0 ) {
+
+        // Sum of 3 uniforms in [-1,1] has rms 1
+
+        const double    A = MAX10BIT * 1e-6 * p.im.all.simNoiseUV / maxV;
+
+        for( int s = 0; s < SIMBANK; ++s ) {
+
+            for( int c = 0; c < nNeu; ++c ) {
+
+                quint64 h = simHash( P.key ^ (quint64(s) << 20) ^ c );
+                double  u = 0;
+
+                for( int k = 0; k < 3; ++k, h >>= 21 )
+                    u += (h & 0x1FFFFF) / double(0x100000) - 1.0;
+
+                qint16  &d = bank[c + s*P.nCH];
+
+                d = qBound( -MAX10BIT, d + int(P.gain[c] * A * u), MAX10BIT-1 );
+            }
+        }
+    }
+
+    for( int s = 0; s < SIMBANK; ++s ) {
+
+        for( int c = nNeu; c < P.nCH; ++c )
+            bank[c + s*P.nCH] = 0;
     }
 }
 
 #endif
 
 
+// Ring-copy nS scans from P.bank, then set live SY bit 6.
+//
+void CimAcqSim::copyBank( qint16 *dst, const ImSimProbe &P, int nS ) const
+{
+    int nNeu    = P.nAP + P.nLF,
+        iBank   = int((P.totPts + P.bankOff) % SIMBANK),
+        nDone   = 0;
+
+    while( nDone < nS ) {
+
+        int n = qMin( nS - nDone, SIMBANK - iBank );
+
+        memcpy(
+            dst + nDone * P.nCH,
+            P.bank + iBank * P.nCH,
+            n * P.nCH * sizeof(qint16) );
+
+        nDone  += n;
+        iBank   = 0;
+    }
+
+    if( P.nCH > nNeu ) {
+
+        for( int s = 0; s < nS; ++s ) {
+
+            dst[nNeu + s*P.nCH] =
+                (P.sync.level( P.totPts + s ) ? 1 << 6 : 0);
+        }
+    }
+}
+
+
 // Return sample count nS.
 //
 int CimAcqSim::fetchE(
@@ -465,8 +683,11 @@ int CimAcqSim::fetchE(
 {
     int nS = 0;
 
-    double  t0          = owner->imQ[P.ip]->tZero();
-    quint64 targetCt    = (loopT+LOOPSECS - t0) * p.im.each[P.ip].srate;
+    double  t0          = simQ[P.ip]->tZero();
+    quint64 targetCt    = (loopT+LOOPSECS - t0) * P.sync.clockRate();
+
+    if( p.im.all.simFast )
+        targetCt = P.totPts + MAXS;
 
     if( targetCt > P.totPts ) {
 
@@ -475,10 +696,18 @@ int CimAcqSim::fetchE(
         if( nS <= 0 )
             return nS;
 
+        if( P.rep )
+            return P.rep->get( dst, nS );
+
+        if( P.bank ) {
+            copyBank( dst, P, nS );
+            return nS;
+        }
+
 #ifdef SINEWAVES
         genNPts(
-            dst, &P.gain[0], maxV, P.srate,
-            P.nAP + P.nLF, P.nCH, P.totPts, nS );
+            dst, &P.gain[0], P.sync, maxV, P.srate, P.srate, P.key,
+            P.nAP, P.nAP + P.nLF, P.nCH, P.totPts, nS );
 #else
         memset( dst, 0, nS * P.nCH * sizeof(qint16) );
 #endif
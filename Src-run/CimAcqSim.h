@@ -2,8 +2,10 @@
 #define CIMACQSIM_H
 
 #include "CimAcq.h"
+#include "SimPulser.h"
 
 class CimAcqSim;
+class SimReplay;
 
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
@@ -51,16 +53,17 @@ struct ImSimShared {
 
 
 struct ImSimProbe {
+    SimPulser           sync;       // SY bit 6 source, own clock
     double              srate,
+                        ppm,
                         peakDT,
-                        sumTot,
-                        sumGet,
-                        sumEnq,
-                        sumLok,
-                        sumWrk;
-    quint64             sumPts,
-                        totPts;
+                        runPeakDT,
+                        sumTot;
+    quint64             totPts;
     std::vector<double> gain;
+    quint64             key;        // waveform seed for this probe
+    SimReplay           *rep;       // file source, else generated
+    const qint16        *bank;      // precomputed source, else 0
     int                 ip,
                         nAP,
                         nLF,
@@ -68,13 +71,15 @@ struct ImSimProbe {
                         nCH,
                         slot,
                         port,
+                        bankOff,    // this probe's bank phase
                         sumN;
 
     ImSimProbe()        {}
     ImSimProbe(
         const CimCfg::ImProbeTable  &T,
         const DAQ::Params           &p,
-        int                         ip );
+        int                         ip,
+        int                         ipSrc );
 };
 
 
@@ -107,7 +112,7 @@ public slots:
 
 private:
     bool doProbe( vec_i16 &dst1D, ImSimProbe &P );
-    void profile( ImSimProbe &P );
+    void runStats( const ImSimProbe &P );
 };
 
 
@@ -129,6 +134,23 @@ public:
 
 // Simulated IMEC input
 //
+// As a load generator (imSimPrbs, imSimFast, imSimSeed):
+// - Probes beyond the table clone table probes round-robin and
+//   enqueue to private AIQs, so they load generation and enqueue
+//   but no downstream consumer.
+// - Fast mode generates full blocks without realtime pacing.
+// - Waveforms are a pure function of seed, probe and sample
+//   index, hence reproducible run to run.
+// - Or (imSimReplay) table probes replay a recorded run's
+//   ap.bin files, at imSimSpeed times the sample rate.
+// - Each probe clock can drift (imSimPPM list, entry ip mod
+//   count), and SY bit 6 carries the sync pulser as that clock
+//   sees it, edges jittered by up to imSimJitUs.
+// - Bank mode (imSimBank) precomputes SIMBANK scans per table
+//   probe (plus optional imSimNoiseUV noise) and fetches are
+//   ring copies at a per-probe phase; only SY is made live.
+//   Waveforms then repeat every SIMBANK scans.
+//
 class CimAcqSim : public CimAcq
 {
     friend class ImSimWorker;
@@ -136,6 +158,9 @@ class CimAcqSim : public CimAcq
 private:
     const CimCfg::ImProbeTable  &T;
     ImSimShared                 shr;
+    QVector<AIQ*>               simQ;   // imQ + extra sim probes
+    std::vector<SimReplay*>     reps;
+    std::vector<vec_i16>        banks;  // per table probe
     std::vector<ImSimThread*>   imT;
     const double                maxV;
     int                         nThd;
@@ -152,6 +177,8 @@ private:
         qint16              *dst,
         const ImSimProbe    &P,
         double              loopT );
+    void genBank( vec_i16 &bank, const ImSimProbe &P ) const;
+    void copyBank( qint16 *dst, const ImSimProbe &P, int nS ) const;
 
     void runError( QString err );
 };
@@ -5,6 +5,8 @@
 
 #include <QWaitCondition>
 
+#include <atomic>
+
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -21,7 +23,7 @@ protected:
     quint64                 totPts;
     mutable QMutex          runMtx;
     mutable QWaitCondition  condRun;
-    volatile bool           _canSleep,
+    std::atomic<bool>       _canSleep,
                             ready,
                             pleaseStop;
 
@@ -33,20 +35,31 @@ public:
 
     virtual void run() = 0;
 
+    // Flag locking as in CimAcq.
     void atomicSleepWhenReady()
     {
         runMtx.lock();
-        ready = true;
-        if( _canSleep )
+        ready.store( true, std::memory_order_release );
+        if( _canSleep.load( std::memory_order_acquire ) )
             condRun.wait( &runMtx );
         runMtx.unlock();
     }
 
     void wake()             {condRun.wakeAll();}
-    void stayAwake()        {QMutexLocker ml( &runMtx ); _canSleep = false;}
-    bool isReady() const    {QMutexLocker ml( &runMtx ); return ready;}
-    void stop()             {QMutexLocker ml( &runMtx ); pleaseStop = true;}
-    bool isStopped() const  {QMutexLocker ml( &runMtx ); return pleaseStop;}
+    void stayAwake()
+        {
+            QMutexLocker ml( &runMtx );
+            _canSleep.store( false, std::memory_order_release );
+        }
+    bool isReady() const
+        {return ready.load( std::memory_order_acquire );}
+    virtual void stop()
+        {
+            QMutexLocker ml( &runMtx );
+            pleaseStop.store( true, std::memory_order_release );
+        }
+    bool isStopped() const
+        {return pleaseStop.load( std::memory_order_acquire );}
 };
 
 #endif  // CNIACQ_H
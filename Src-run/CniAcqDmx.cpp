@@ -3,6 +3,7 @@
 
 #include "CniAcqDmx.h"
 #include "Util.h"
+#include "RunBench.h"
 #include "Subset.h"
 
 #include <QThread>
@@ -124,12 +125,105 @@ static void diChanString(
     }
 }
 
+/* ---------------------------------------------------------------- */
+/* NIDev2Fetch ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+NIDev2Fetch::NIDev2Fetch( CniAcqDmx *acq )
+    :   QObject(0), acq(acq), reqN(0), errNum(0), errFn(""),
+        reqAt(0), reqRem(0), busy(false), pleaseStop(false)
+{
+    thread = new QThread;
+    moveToThread( thread );
+    Connect( thread, SIGNAL(started()), this, SLOT(run()) );
+    thread->start();
+}
+
+
+// Lets any in-flight read finish, then joins.
+//
+NIDev2Fetch::~NIDev2Fetch()
+{
+    mtx.lock();
+        pleaseStop = true;
+        condReq.wakeAll();
+    mtx.unlock();
+
+    thread->wait();
+    delete thread;
+}
+
+
+// Start async read of nFetched dev2 samples at offset.
+// Caller must wait() once per request.
+//
+void NIDev2Fetch::request( int32 nFetched, int at, int rem )
+{
+    QMutexLocker    ml( &mtx );
+
+    reqN    = nFetched;
+    reqAt   = at;
+    reqRem  = rem;
+    busy    = true;
+    condReq.wakeAll();
+}
+
+
+// Block until current request done.
+//
+// Return ok, else DAQmx error info.
+//
+bool NIDev2Fetch::wait( int32 &errNum, const char* &errFn )
+{
+    QMutexLocker    ml( &mtx );
+
+    while( busy )
+        condDone.wait( &mtx );
+
+    errNum  = this->errNum;
+    errFn   = this->errFn;
+
+    return !DAQmxFailed( errNum );
+}
+
+
+void NIDev2Fetch::run()
+{
+    mtx.lock();
+
+    for(;;) {
+
+        while( !reqN && !pleaseStop )
+            condReq.wait( &mtx );
+
+        if( !reqN )
+            break;
+
+        int32   n = reqN;
+
+        reqN = 0;
+
+        mtx.unlock();
+            acq->fetchDev2( n, reqAt, reqRem, errNum, errFn );
+        mtx.lock();
+
+        busy = false;
+        condDone.wakeAll();
+    }
+
+    mtx.unlock();
+    thread->quit();
+}
+
 /* ---------------------------------------------------------------- */
 /* ~CniAcqDmx ----------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
 CniAcqDmx::~CniAcqDmx()
 {
+    if( dev2 )
+        delete dev2;
+
     setDO( false );
     destroyTasks();
 }
@@ -202,9 +296,10 @@ CniAcqDmx::~CniAcqDmx()
     The read function knows nothing of muxing so may well deliver data
     for partial timepoints. It will fall to us to reassemble timepoints
     manually. I'll manage that in a simple way, sizing a fetch buffer to
-    hold maxMuxedSampPerChan, plus 1 extra timepoint. On each read I'll
-    track any fractional timepoint tail. On the next read we will slide
-    that fraction forward and append new fetched data to that.
+    hold maxMuxedSampPerChan, plus 1 extra timepoint, plus some slack.
+    On each read I'll track any fractional timepoint tail and append the
+    next read directly after it. Only when the tail has advanced into
+    the slack do we slide that fraction back to the front.
 */
 
 void CniAcqDmx::run()
@@ -245,13 +340,22 @@ void CniAcqDmx::run()
         * daqAIFetchPeriodMillis()
         * (kxd1+kxd2 ? 2 : 0.1);
 
+// In event mode (p.ni.fetchEvt) DAQmx wakes us every evtN
+// samples, so we sleep fully between events. A wait timing out
+// twice without data means the clock has stopped.
+
+    const double evtWaitSecs =
+        qMax( DAQ_TIMEOUT_SEC, 4.0 * evtN / (kmux * p.ni.srate) );
+
     double  peak_loopT  = 0;
     int32   nFetched;
     int     peak_nWhole = 0,
             nWhole      = 0,
             rem         = 0,
-            remFront    = true,
             nTries      = 0;
+    bool    evtTimeout  = false;
+
+    rawOff = 0;
 
     while( !isStopped() ) {
 
@@ -259,18 +363,15 @@ void CniAcqDmx::run()
 
         nWhole = 0;
 
-        // Slide partial timepoint forward.
-        //
-        // The purpose of remFront is to prevent sliding again
-        // next time, just in case we got no samples this time.
-        // In reality, if we actually had any rem (meaning acq
-        // is in progress) and we got no samples, then we have
-        // much bigger problems than that.
+        // Fetches append after the partial timepoint (rem) at
+        // rawOff. Only when the raw buffers lack room for a
+        // full fetch is rem slid to the front: about once per
+        // rawSlack samples, rather than every iteration.
 
-        if( rem && !remFront ) {
+        if( rawOff > rawSlack ) {
 
-            slideRemForward( rem, nFetched );
-            remFront = true;
+            slideRemForward( rem );
+            rawOff = 0;
         }
 
         // -----
@@ -308,15 +409,7 @@ void CniAcqDmx::run()
 
         nFetched += rem;
         nWhole    = nFetched / kmux;
-
-        if( nWhole ) {
-            rem         = nFetched - kmux * nWhole;
-            remFront    = false;
-        }
-        else {
-            rem         = nFetched;
-            remFront    = true;
-        }
+        rem       = nFetched - kmux * nWhole;
 
         // ---------
         // MEM usage
@@ -351,6 +444,7 @@ void CniAcqDmx::run()
             // ---------------
 
             demuxMerge( nWhole );
+            rawOff += kmux * nWhole;
 
             // -------
             // Publish
@@ -378,7 +472,9 @@ void CniAcqDmx::run()
 next_fetch:
         if( !nWhole ) {
 
-            if( ++nTries > 1100 ) {
+            // In event mode only timed-out waits count.
+
+            if( (!evtN || evtTimeout) && ++nTries > (evtN ? 1 : 1100) ) {
                 runError( "NIReader getting no samples." );
                 goto exit;
             }
@@ -416,7 +512,9 @@ next_fetch:
     Q_UNUSED( peak_loopT )
 #endif
 
-        if( loopT < loopPeriod_us )
+        if( evtN )
+            evtTimeout = !evtWait( evtWaitSecs );
+        else if( loopT < loopPeriod_us )
             QThread::usleep( qMin( 0.5*(loopPeriod_us - loopT), 500.0 ) );
     }
 
@@ -429,6 +527,7 @@ Error_Out:
 
 exit:
     setDO( false );
+    RunBench::addCPU( RunBench::stgAcq );
 }
 
 /* ---------------------------------------------------------------- */
@@ -779,6 +878,46 @@ bool CniAcqDmx::createSyncPulserTask()
     return true;
 }
 
+/* ---------------------------------------------------------------- */
+/* registerEvtTask ------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+// Register an every-N-samples event on the task that sets the
+// fetch count (see fetch()). N is the nearest divisor of the input
+// buffer size at or above one fetch period of samples, since some
+// devices require the buffer to be a multiple of N.
+//
+// Callbacks arrive on a DAQmx thread; evtCallback only posts.
+//
+bool CniAcqDmx::registerEvtTask()
+{
+    TaskHandle  T = (KAI1 ? taskAI1 : taskDI1);
+
+    evtN =
+        qMax( uInt32(kmux),
+        uInt32(kmux * p.ni.srate * daqAIFetchPeriodMillis() / 1000) );
+
+    while( evtN < maxMuxedSampPerChan && maxMuxedSampPerChan % evtN )
+        ++evtN;
+
+    evtPend = 0;
+
+    if( DAQmxErrChkNoJump( DAQmxRegisterEveryNSamplesEvent(
+                            T,
+                            DAQmx_Val_Acquired_Into_Buffer,
+                            evtN,
+                            0,
+                            evtCallback,
+                            this ) ) ) {
+
+        evtN = 0;
+        return false;
+    }
+
+    Log() << QString("NI fetch events every %1 samples.").arg( evtN );
+    return true;
+}
+
 /* ---------------------------------------------------------------- */
 /* configure ------------------------------------------------------ */
 /* ---------------------------------------------------------------- */
@@ -901,6 +1040,14 @@ bool CniAcqDmx::configure()
         return false;
     }
 
+    if( p.ni.fetchEvt && !registerEvtTask() ) {
+        runError();
+        return false;
+    }
+
+    if( p.ni.isDualDevMode && p.ni.dualDevPar && (KAI2 || kxd2) )
+        dev2 = new NIDev2Fetch( this );
+
 // -------
 // Buffers
 // -------
@@ -910,6 +1057,9 @@ bool CniAcqDmx::configure()
 // Any of the raw buffers may get zero allocated size if no channels
 // of that type were selected...so never access &rawXXX[0] without
 // testing array size.
+//
+// Raw buffers hold the partial timepoint plus one full fetch, plus
+// rawSlack samples so fetches can append at advancing offsets.
 
     merged.resize(
         maxSampPerChan*(
@@ -918,11 +1068,15 @@ bool CniAcqDmx::configure()
             + (1 + kxd1+kxd2)/2
         ) );
 
-    rawAI1.resize( (maxMuxedSampPerChan + kmux)*KAI1 );
-    rawAI2.resize( (maxMuxedSampPerChan + kmux)*KAI2 );
+    rawSlack = maxMuxedSampPerChan / 2;
+
+    rawAI1.resize( (maxMuxedSampPerChan + kmux + rawSlack)*KAI1 );
+    rawAI2.resize( (maxMuxedSampPerChan + kmux + rawSlack)*KAI2 );
 
-    rawDI1.resize( maxMuxedSampPerChan + kmux );
-    rawDI2.resize( maxMuxedSampPerChan + kmux );
+    rawDI1.resize( maxMuxedSampPerChan + kmux + rawSlack );
+    rawDI2.resize( maxMuxedSampPerChan + kmux + rawSlack );
+
+    demuxPlan();
 
     return true;
 }
@@ -995,37 +1149,99 @@ void CniAcqDmx::setDO( bool onoff )
         emit owner->daqError( err );
 }
 
+/* ---------------------------------------------------------------- */
+/* evtCallback ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+int32 CVICALLBACK CniAcqDmx::evtCallback(
+    TaskHandle  task,
+    int32       evtType,
+    uInt32      nSamples,
+    void        *data )
+{
+    Q_UNUSED( task )
+    Q_UNUSED( evtType )
+    Q_UNUSED( nSamples )
+
+    CniAcqDmx   *D = (CniAcqDmx*)data;
+
+    D->evtMtx.lock();
+        ++D->evtPend;
+        D->evtCond.wakeOne();
+    D->evtMtx.unlock();
+
+    return 0;
+}
+
+/* ---------------------------------------------------------------- */
+/* evtWait -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Sleep until next DAQmx event, or timeout.
+//
+// Return true if an event arrived.
+//
+bool CniAcqDmx::evtWait( double timeout )
+{
+    QMutexLocker    ml( &evtMtx );
+
+    if( !evtPend )
+        evtCond.wait( &evtMtx, ulong(1000 * timeout) );
+
+    bool    got = evtPend > 0;
+
+    evtPend = 0;
+    return got;
+}
+
+
+// Also end an evtWait() in progress, so run() sees the
+// stop now rather than at the event timeout.
+//
+void CniAcqDmx::stop()
+{
+    CniAcq::stop();
+
+    QMutexLocker    ml( &evtMtx );
+    evtCond.wakeAll();
+}
+
 /* ---------------------------------------------------------------- */
 /* slideRemForward ------------------------------------------------ */
 /* ---------------------------------------------------------------- */
 
-void CniAcqDmx::slideRemForward( int rem, int nFetched )
+// Move partial timepoint at rawOff to buffer fronts.
+//
+void CniAcqDmx::slideRemForward( int rem )
 {
+    if( !rem )
+        return;
+
     if( KAI1 ) {
-        memcpy(
+        memmove(
             &rawAI1[0],
-            &rawAI1[(nFetched-rem)*KAI1],
+            &rawAI1[rawOff*KAI1],
             rem*KAI1*sizeof(qint16) );
     }
 
     if( kxd1 ) {
-        memcpy(
+        memmove(
             &rawDI1[0],
-            &rawDI1[nFetched-rem],
+            &rawDI1[rawOff],
             rem*sizeof(uInt32) );
     }
 
     if( KAI2 ) {
-        memcpy(
+        memmove(
             &rawAI2[0],
-            &rawAI2[(nFetched-rem)*KAI2],
+            &rawAI2[rawOff*KAI2],
             rem*KAI2*sizeof(qint16) );
     }
 
     if( kxd2 ) {
-        memcpy(
+        memmove(
             &rawDI2[0],
-            &rawDI2[nFetched-rem],
+            &rawDI2[rawOff],
             rem*sizeof(uInt32) );
     }
 }
@@ -1034,7 +1250,7 @@ void CniAcqDmx::slideRemForward( int rem, int nFetched )
 /* fetch ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
-// Fetch ALL dev1 samples, appending them to rem.
+// Fetch ALL dev1 samples, appending them to rem (at rawOff).
 // The first used channel type on dev1 sets nFetched,
 // and that specifies the fetch count for other reads.
 //
@@ -1042,6 +1258,11 @@ void CniAcqDmx::slideRemForward( int rem, int nFetched )
 //
 bool CniAcqDmx::fetch( int32 &nFetched, int rem )
 {
+    if( dev2 )
+        return fetchPar( nFetched, rem );
+
+    int at = rawOff + rem;
+
     nFetched = 0;
 
     if( KAI1 ) {
@@ -1052,7 +1273,7 @@ bool CniAcqDmx::fetch( int32 &nFetched, int rem )
                 DAQmx_Val_Auto,
                 DAQ_TIMEOUT_SEC,
                 DAQmx_Val_GroupByScanNumber,
-                &rawAI1[rem*KAI1],
+                &rawAI1[at*KAI1],
                 (maxMuxedSampPerChan+kmux-rem)*KAI1,
                 &nFetched,
                 NULL ) );
@@ -1069,7 +1290,7 @@ bool CniAcqDmx::fetch( int32 &nFetched, int rem )
                 (nFetched ? nFetched : DAQmx_Val_Auto),
                 DAQ_TIMEOUT_SEC,
                 DAQmx_Val_GroupByScanNumber,
-                &rawDI1[rem],
+                &rawDI1[at],
                 (maxMuxedSampPerChan+kmux-rem),
                 &nFetched,
                 NULL ) );
@@ -1093,7 +1314,7 @@ bool CniAcqDmx::fetch( int32 &nFetched, int rem )
                     nFetched,
                     DAQ_TIMEOUT_SEC,
                     DAQmx_Val_GroupByScanNumber,
-                    &rawAI2[rem*KAI2],
+                    &rawAI2[at*KAI2],
                     (maxMuxedSampPerChan+kmux-rem)*KAI2,
                     &nFetched2,
                     NULL ) );
@@ -1110,7 +1331,7 @@ bool CniAcqDmx::fetch( int32 &nFetched, int rem )
                     nFetched,
                     DAQ_TIMEOUT_SEC,
                     DAQmx_Val_GroupByScanNumber,
-                    &rawDI2[rem],
+                    &rawDI2[at],
                     (maxMuxedSampPerChan+kmux-rem),
                     &nFetched2,
                     NULL ) );
@@ -1127,23 +1348,303 @@ Error_Out:
     return false;
 }
 
+/* ---------------------------------------------------------------- */
+/* fetchPar ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Dual-device fetch with dev2 read on NIDev2Fetch thread.
+//
+// Count is set up front from dev1 available samples, so
+// both devices' reads run fully concurrently.
+//
+// Return ok.
+//
+bool CniAcqDmx::fetchPar( int32 &nFetched, int rem )
+{
+    const char  *errFn2;
+    int32       errNum2;
+    uInt32      avail   = 0;
+    int         at      = rawOff + rem;
+
+    nFetched = 0;
+
+    DAQmxErrChk(
+        DAQmxGetReadAvailSampPerChan(
+            (KAI1 ? taskAI1 : taskDI1),
+            &avail ) );
+
+    if( !avail )
+        return true;
+
+    nFetched = qMin( avail, maxMuxedSampPerChan + kmux - rem );
+
+    dev2->request( nFetched, at, rem );
+
+    if( KAI1 ) {
+
+        DAQmxErrChk(
+            DAQmxReadBinaryI16(
+                taskAI1,
+                nFetched,
+                DAQ_TIMEOUT_SEC,
+                DAQmx_Val_GroupByScanNumber,
+                &rawAI1[at*KAI1],
+                (maxMuxedSampPerChan+kmux-rem)*KAI1,
+                &nFetched,
+                NULL ) );
+    }
+
+    if( kxd1 ) {
+
+        DAQmxErrChk(
+            DAQmxReadDigitalU32(
+                taskDI1,
+                nFetched,
+                DAQ_TIMEOUT_SEC,
+                DAQmx_Val_GroupByScanNumber,
+                &rawDI1[at],
+                (maxMuxedSampPerChan+kmux-rem),
+                &nFetched,
+                NULL ) );
+    }
+
+    if( !dev2->wait( errNum2, errFn2 ) ) {
+        dmxErrNum = errNum2;
+        dmxFnName = errFn2;
+        return false;
+    }
+
+    return true;
+
+Error_Out:
+    dev2->wait( errNum2, errFn2 );  // join before returning
+    return false;
+}
+
+/* ---------------------------------------------------------------- */
+/* fetchDev2 ------------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+// Fetch nFetched dev2 samples at offset (runs on NIDev2Fetch).
+// Errors go to errNum/errFn, not the shared dmx statics.
+//
+// Return ok.
+//
+bool CniAcqDmx::fetchDev2(
+    int32       nFetched,
+    int         at,
+    int         rem,
+    int32       &errNum,
+    const char* &errFn )
+{
+    int32   nFetched2;
+
+    errNum  = 0;
+    errFn   = "";
+
+    if( KAI2 ) {
+
+        errNum =
+            DAQmxReadBinaryI16(
+                taskAI2,
+                nFetched,
+                DAQ_TIMEOUT_SEC,
+                DAQmx_Val_GroupByScanNumber,
+                &rawAI2[at*KAI2],
+                (maxMuxedSampPerChan+kmux-rem)*KAI2,
+                &nFetched2,
+                NULL );
+
+        if( DAQmxFailed( errNum ) ) {
+            errFn = "DAQmxReadBinaryI16( taskAI2 )";
+            return false;
+        }
+
+        if( nFetched2 != nFetched )
+            Warning() << "Detected dev2-dev1 analog phase shift.";
+    }
+
+    if( kxd2 ) {
+
+        errNum =
+            DAQmxReadDigitalU32(
+                taskDI2,
+                nFetched,
+                DAQ_TIMEOUT_SEC,
+                DAQmx_Val_GroupByScanNumber,
+                &rawDI2[at],
+                (maxMuxedSampPerChan+kmux-rem),
+                &nFetched2,
+                NULL );
+
+        if( DAQmxFailed( errNum ) ) {
+            errFn = "DAQmxReadDigitalU32( taskDI2 )";
+            return false;
+        }
+
+        if( nFetched2 != nFetched )
+            Warning() << "Detected dev2-dev1 digital phase shift.";
+    }
+
+    return true;
+}
+
 /* ---------------------------------------------------------------- */
 /* demuxMerge ----------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
+// Pack one timepoint's digital words into low-order bytes:
+// XD1 bytes from dev1 then XD2 bytes from dev2, contiguous.
+// Instantiated per (kxd1, kxd2) so all branches resolve at
+// compile time.
+//
+template<int XD1, int XD2>
+static qint16 *packXD( qint16 *dst, const uInt32 *sD1, const uInt32 *sD2 )
+{
+    const bool  F = (XD1 == 1 || XD1 == 3);    // odd byte pending
+    quint16     W = 0;
+
+    if( XD1 == 4 ) {
+        *dst++ = *sD1;
+        *dst++ = *sD1 >> 16;
+    }
+    else if( XD1 == 3 ) {
+        *dst++ = *sD1;
+        W = (*sD1 >> 16) & 0xFF;
+    }
+    else if( XD1 == 2 )
+        *dst++ = *sD1;
+    else if( XD1 == 1 )
+        W = *sD1 & 0xFF;
+
+    if( XD2 == 0 ) {
+
+        if( F )
+            *dst++ = W;
+    }
+    else if( XD2 == 1 ) {
+
+        if( !F )
+            *dst++ = *sD2 & 0xFF;
+        else
+            *dst++ = W + (*sD2 << 8);
+    }
+    else if( XD2 == 2 ) {
+
+        if( !F )
+            *dst++ = *sD2;
+        else {
+            *dst++ = W + (*sD2 << 8);
+            *dst++ = (*sD2 >> 8) & 0xFF;
+        }
+    }
+    else if( XD2 == 3 ) {
+
+        if( !F ) {
+            *dst++ = *sD2;
+            *dst++ = (*sD2 >> 16) & 0xFF;
+        }
+        else {
+            *dst++ = W + (*sD2 << 8);
+            *dst++ = *sD2 >> 8;
+        }
+    }
+    else if( XD2 == 4 ) {
+
+        if( !F ) {
+            *dst++ = *sD2;
+            *dst++ = *sD2 >> 16;
+        }
+        else {
+            *dst++ = W + (*sD2 << 8);
+            *dst++ = *sD2 >> 8;
+            *dst++ = *sD2 >> 24;
+        }
+    }
+
+    return dst;
+}
+
+
+#define XDROW( i )  \
+    {&packXD<i,0>, &packXD<i,1>, &packXD<i,2>, &packXD<i,3>, &packXD<i,4>}
+
+static const CniAcqDmx::XDPacker xdPackers[5][5] =
+    {XDROW( 0 ), XDROW( 1 ), XDROW( 2 ), XDROW( 3 ), XDROW( 4 )};
+
+#undef XDROW
+
+
+static inline qint16 *gather(
+    qint16              *dst,
+    const qint16        *src,
+    const std::vector<int>  &idx )
+{
+    for( int i = 0, n = idx.size(); i < n; ++i )
+        dst[i] = src[idx[i]];
+
+    return dst + idx.size();
+}
+
+
+// Build per-timepoint gather plan from channel counts.
+//
+// In each timepoint the muxed channels form a matrix. As acquired,
+// each column is a muxer (so, ncol = kmn1 + kmn2 + kma1 + kma2).
+// There are kmux rows. We transpose this matrix so that all the
+// samples from a given muxer are together. The gather tables give,
+// for each output slot, the offset of its source sample within the
+// device's raw timepoint block (kmux rows of KAIn values).
+//
+void CniAcqDmx::demuxPlan()
+{
+    gMN1.clear();
+    gMN2.clear();
+    gMA1.clear();
+    gMA2.clear();
+
+    for( int c = 0; c < kmn1; ++c ) {
+        for( int s = 0; s < kmux; ++s )
+            gMN1.push_back( s*KAI1 + c );
+    }
+
+    for( int c = 0; c < kmn2; ++c ) {
+        for( int s = 0; s < kmux; ++s )
+            gMN2.push_back( s*KAI2 + c );
+    }
+
+    for( int c = 0; c < kma1; ++c ) {
+        for( int s = 0; s < kmux; ++s )
+            gMA1.push_back( s*KAI1 + kmn1 + c );
+    }
+
+    for( int c = 0; c < kma2; ++c ) {
+        for( int s = 0; s < kmux; ++s )
+            gMA2.push_back( s*KAI2 + kmn2 + c );
+    }
+
+    sumXA.assign( kxa1 + kxa2, 0 );
+
+    xdPack = xdPackers[qBound( 0, kxd1, 4 )][qBound( 0, kxd2, 4 )];
+}
+
+
 // - Merge data from 2 devices.
 // - Group by whole timepoints.
 // - Subgroup (mn0 | mn1 |...| ma0 | ma1 |...| xa | xd).
 // - Average oversampled xa chans.
 // - Downsample oversampled xd and pack bytes into low-order bits.
 //
+// Uses plan from demuxPlan(); reads whole timepoints from rawOff.
+//
 void CniAcqDmx::demuxMerge( int nwhole )
 {
     qint16          *dst    = &merged[0];
-    const qint16    *sA1    = (rawAI1.size() ? &rawAI1[0] : 0),
-                    *sA2    = (rawAI2.size() ? &rawAI2[0] : 0);
-    const uInt32    *sD1    = (kxd1 ? &rawDI1[0] : 0),
-                    *sD2    = (kxd2 ? &rawDI2[0] : 0);
+    const qint16    *sA1    = (rawAI1.size() ? &rawAI1[rawOff*KAI1] : 0),
+                    *sA2    = (rawAI2.size() ? &rawAI2[rawOff*KAI2] : 0);
+    const uInt32    *sD1    = (kxd1 ? &rawDI1[rawOff] : 0),
+                    *sD2    = (kxd2 ? &rawDI2[rawOff] : 0);
+    const bool      isXD    = (kxd1 + kxd2 > 0);
 
 // ----------
 // Not muxing
@@ -1169,79 +1670,10 @@ void CniAcqDmx::demuxMerge( int nwhole )
 
             // Copy XD
 
-            if( kxd1 + kxd2 == 0 )
-                continue;
-
-            quint16 W = 0;
-            bool    F = 0;   // filling F: {0=empty,1=lsb,2=full}
-
-            if( kxd1 == 4 ) {
-                *dst++ = *sD1;
-                *dst++ = *sD1 >> 16;
-                ++sD1;
-            }
-            if( kxd1 == 3 ) {
-                *dst++ = *sD1;
-                W = (*sD1 >> 16) & 0xFF;
-                F = 1;
-                ++sD1;
-            }
-            else if( kxd1 == 2 ) {
-                *dst++ = *sD1++;
-            }
-            else if( kxd1 == 1 ) {
-                W = *sD1++ & 0xFF;
-                F = 1;
-            }
-
-            if( kxd2 == 0 ) {
-
-                if( F > 0 )
-                    *dst++ = W;
-            }
-            else if( kxd2 == 1 ) {
-
-                if( F == 0 )
-                    *dst++ = *sD2++ & 0xFF;
-                else
-                    *dst++ = W + (*sD2++ << 8);
-            }
-            else if( kxd2 == 2 ) {
-
-                if( F == 0 )
-                    *dst++ = *sD2++;
-                else {
-                    *dst++ = W + (*sD2 << 8);
-                    *dst++ = (*sD2 >> 8) & 0xFF;
-                    ++sD2;
-                }
-            }
-            else if( kxd2 == 3 ) {
-
-                if( F == 0 ) {
-                    *dst++ = *sD2;
-                    *dst++ = (*sD2 >> 16) & 0xFF;
-                    ++sD2;
-                }
-                else {
-                    *dst++ = W + (*sD2 << 8);
-                    *dst++ = *sD2 >> 8;
-                    ++sD2;
-                }
-            }
-            else if( kxd2 == 4 ) {
-
-                if( F == 0 ) {
-                    *dst++ = *sD2;
-                    *dst++ = *sD2 >> 16;
-                    ++sD2;
-                }
-                else {
-                    *dst++ = W + (*sD2 << 8);
-                    *dst++ = *sD2 >> 8;
-                    *dst++ = *sD2 >> 24;
-                    ++sD2;
-                }
+            if( isXD ) {
+                dst = xdPack( dst, sD1, sD2 );
+                sD1 += (kxd1 ? 1 : 0);
+                sD2 += (kxd2 ? 1 : 0);
             }
         }
 
@@ -1252,164 +1684,73 @@ void CniAcqDmx::demuxMerge( int nwhole )
 // Muxing
 // ------
 
-// In each timepoint the muxed channels form a matrix. As acquired,
-// each column is a muxer (so, ncol = kmn1 + kmn2 + kma1 + kma2).
-// There are kmux rows. We will transpose this matrix so that all
-// the samples from a given muxer are together. In each timepoint
-// the xa values are oversampled by kmux, so we will average them.
-
-    int     ncol    = kmn1 + kmn2 + kma1 + kma2,
-            nrow    = kmux,
-            ntmp    = nrow * ncol;
-    vec_i16 vtmp( ntmp );
+    const int   xa1Off  = kmn1 + kma1,
+                xa2Off  = kmn2 + kma2;
+    qint32      *sum1   = &sumXA[0],
+                *sum2   = sum1 + kxa1;
 
     for( int w = 0; w < nwhole; ++w ) {
 
-        std::vector<long>   sumxa1( kxa1, 0 ),
-                            sumxa2( kxa2, 0 );
-        qint16              *tmp = &vtmp[0];
-
-        for( int s = 0; s < kmux; ++s ) {
-
-            // Fill MN, MA matrix
-
-            if( kmn1 ) {
-                memcpy( tmp, sA1, kmn1*sizeof(qint16) );
-                tmp += kmn1;
-                sA1 += kmn1;
-            }
+        // Transposed MN, MA
 
-            if( kmn2 ) {
-                memcpy( tmp, sA2, kmn2*sizeof(qint16) );
-                tmp += kmn2;
-                sA2 += kmn2;
-            }
+        dst = gather( dst, sA1, gMN1 );
+        dst = gather( dst, sA2, gMN2 );
+        dst = gather( dst, sA1, gMA1 );
+        dst = gather( dst, sA2, gMA2 );
 
-            if( kma1 ) {
-                memcpy( tmp, sA1, kma1*sizeof(qint16) );
-                tmp += kma1;
-                sA1 += kma1;
-            }
+        // XA averages
 
-            if( kma2 ) {
-                memcpy( tmp, sA2, kma2*sizeof(qint16) );
-                tmp += kma2;
-                sA2 += kma2;
-            }
+        if( kxa1 ) {
 
-            // Sum XA
+            const qint16    *s = sA1 + xa1Off;
 
             for( int x = 0; x < kxa1; ++x )
-                sumxa1[x] += *sA1++;
+                sum1[x] = s[x];
 
-            for( int x = 0; x < kxa2; ++x )
-                sumxa2[x] += *sA2++;
-        }
+            for( int r = 1; r < kmux; ++r ) {
 
-        // Transpose and store MN, MA:
-        // Original element address is [ncol*Y + X].
-        // Swap roles X <-> Y and row <-> col.
+                s += KAI1;
 
-        for( int iacq = 0; iacq < ntmp; ++iacq ) {
-
-            int Y = iacq / ncol,
-                X = iacq - ncol * Y;
+                for( int x = 0; x < kxa1; ++x )
+                    sum1[x] += s[x];
+            }
 
-            dst[nrow*X + Y] = vtmp[iacq];
+            for( int x = 0; x < kxa1; ++x )
+                *dst++ = sum1[x] / kmux;
         }
 
-        dst += ntmp;
-
-        // Copy XA averages
+        if( kxa2 ) {
 
-        for( int x = 0; x < kxa1; ++x )
-            *dst++ = sumxa1[x] / kmux;
+            const qint16    *s = sA2 + xa2Off;
 
-        for( int x = 0; x < kxa2; ++x )
-            *dst++ = sumxa2[x] / kmux;
+            for( int x = 0; x < kxa2; ++x )
+                sum2[x] = s[x];
 
-        // Copy XD
+            for( int r = 1; r < kmux; ++r ) {
 
-        if( kxd1 + kxd2 == 0 )
-            continue;
+                s += KAI2;
 
-        quint16 W = 0;
-        bool    F = 0;   // filling F: {0=empty,1=lsb,2=full}
+                for( int x = 0; x < kxa2; ++x )
+                    sum2[x] += s[x];
+            }
 
-        if( kxd1 == 4 ) {
-            *dst++ = *sD1;
-            *dst++ = *sD1 >> 16;
-            ++sD1;
-        }
-        if( kxd1 == 3 ) {
-            *dst++ = *sD1;
-            W = (*sD1 >> 16) & 0xFF;
-            F = 1;
-            ++sD1;
-        }
-        else if( kxd1 == 2 ) {
-            *dst++ = *sD1++;
-        }
-        else if( kxd1 == 1 ) {
-            W = *sD1++ & 0xFF;
-            F = 1;
+            for( int x = 0; x < kxa2; ++x )
+                *dst++ = sum2[x] / kmux;
         }
 
-        if( kxd2 == 0 ) {
-
-            if( F > 0 )
-                *dst++ = W;
-        }
-        else if( kxd2 == 1 ) {
+        if( KAI1 )
+            sA1 += kmux * KAI1;
 
-            if( F == 0 )
-                *dst++ = *sD2++ & 0xFF;
-            else
-                *dst++ = W + (*sD2++ << 8);
-        }
-        else if( kxd2 == 2 ) {
-
-            if( F == 0 )
-                *dst++ = *sD2++;
-            else {
-                *dst++ = W + (*sD2 << 8);
-                *dst++ = (*sD2 >> 8) & 0xFF;
-                ++sD2;
-            }
-        }
-        else if( kxd2 == 3 ) {
+        if( KAI2 )
+            sA2 += kmux * KAI2;
 
-            if( F == 0 ) {
-                *dst++ = *sD2;
-                *dst++ = (*sD2 >> 16) & 0xFF;
-                ++sD2;
-            }
-            else {
-                *dst++ = W + (*sD2 << 8);
-                *dst++ = *sD2 >> 8;
-                ++sD2;
-            }
-        }
-        else if( kxd2 == 4 ) {
+        // XD from first sample of timepoint
 
-            if( F == 0 ) {
-                *dst++ = *sD2;
-                *dst++ = *sD2 >> 16;
-                ++sD2;
-            }
-            else {
-                *dst++ = W + (*sD2 << 8);
-                *dst++ = *sD2 >> 8;
-                *dst++ = *sD2 >> 24;
-                ++sD2;
-            }
+        if( isXD ) {
+            dst = xdPack( dst, sD1, sD2 );
+            sD1 += (kxd1 ? kmux : 0);
+            sD2 += (kxd2 ? kmux : 0);
         }
-
-        if( kxd1 )
-            sD1 += (kmux - 1);
-
-        if( kxd2 )
-            sD2 += (kmux - 1);
     }
 }
 
@@ -6,37 +6,100 @@
 #include "CniAcq.h"
 #include "NI/NIDAQmx.h"
 
+#include <QMutex>
+#include <QWaitCondition>
+
+class CniAcqDmx;
+
+class QThread;
+
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
+// Optional dev2 reader (p.ni.dualDevPar): reads the secondary
+// device tasks on its own thread while the caller reads dev1,
+// so the two device reads overlap rather than add.
+//
+class NIDev2Fetch : public QObject
+{
+    Q_OBJECT
+
+private:
+    CniAcqDmx       *acq;
+    QThread         *thread;
+    QMutex          mtx;
+    QWaitCondition  condReq,
+                    condDone;
+    int32           reqN,       // guarded by mtx
+                    errNum;
+    const char      *errFn;
+    int             reqAt,
+                    reqRem;
+    bool            busy,       // guarded by mtx
+                    pleaseStop; // guarded by mtx
+
+public:
+    NIDev2Fetch( CniAcqDmx *acq );
+    virtual ~NIDev2Fetch();
+
+    void request( int32 nFetched, int at, int rem );
+    bool wait( int32 &errNum, const char* &errFn );
+
+public slots:
+    void run();
+};
+
+
 // Dmx NI-DAQ input
 //
 class CniAcqDmx : public CniAcq
 {
+    friend class NIDev2Fetch;
+
+public:
+    typedef qint16* (*XDPacker)(
+        qint16          *dst,
+        const uInt32    *sD1,
+        const uInt32    *sD2 );
+
 private:
     vec_i16             merged,
                         rawAI1,     rawAI2;
     std::vector<uInt32> rawDI1,     rawDI2;
+    std::vector<int>    gMN1,       gMN2,   // demux gather plan
+                        gMA1,       gMA2;
+    std::vector<qint32> sumXA;
+    XDPacker            xdPack;
     TaskHandle          taskAI1,    taskAI2,
                         taskDI1,    taskDI2,
                         taskIntCTR, taskSyncPls;
     QString             diClkTerm;
-    uInt32              maxMuxedSampPerChan;
-    int                 kmux, KAI1, KAI2,
+    NIDev2Fetch         *dev2;
+    QMutex              evtMtx;
+    QWaitCondition      evtCond;
+    uInt32              maxMuxedSampPerChan,
+                        evtN;       // samples/event; 0 = polling
+    int                 evtPend,    // events since last wait
+                        rawOff,     // first unconsumed sample
+                        rawSlack,   // rawOff limit before slide
+                        kmux, KAI1, KAI2,
                         kmn1, kma1, kxa1, kxd1,
                         kmn2, kma2, kxa2, kxd2;
 
 public:
     CniAcqDmx( NIReaderWorker *owner, const DAQ::Params &p )
     :   CniAcq( owner, p ),
+        xdPack(0),
         taskAI1(0), taskAI2(0),
         taskDI1(0), taskDI2(0),
-        taskIntCTR(0), taskSyncPls(0)
+        taskIntCTR(0), taskSyncPls(0), dev2(0),
+        evtN(0), evtPend(0), rawOff(0), rawSlack(0)
         {setDO( false );}
     virtual ~CniAcqDmx();
 
     virtual void run();
+    virtual void stop();
 
 private:
     bool createAITasks(
@@ -49,13 +112,28 @@ private:
 
     bool createInternalCTRTask();
     bool createSyncPulserTask();
+    bool registerEvtTask();
 
     bool configure();
     bool startTasks();
     void destroyTasks();
     void setDO( bool onoff );
-    void slideRemForward( int rem, int nFetched );
+    static int32 CVICALLBACK evtCallback(
+        TaskHandle  task,
+        int32       evtType,
+        uInt32      nSamples,
+        void        *data );
+    bool evtWait( double timeout );
+    void slideRemForward( int rem );
     bool fetch( int32 &nFetched, int rem );
+    bool fetchPar( int32 &nFetched, int rem );
+    bool fetchDev2(
+        int32       nFetched,
+        int         at,
+        int         rem,
+        int32       &errNum,
+        const char* &errFn );
+    void demuxPlan();
     void demuxMerge( int nwhole );
     void runError( const QString &err = "" );
 };
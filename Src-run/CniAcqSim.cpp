@@ -1,6 +1,11 @@
 
 #include "CniAcqSim.h"
 #include "Util.h"
+#include "DFName.h"
+#include "RunBench.h"
+#include "SimPulser.h"
+#include "SimReplay.h"
+#include "Trace.h"
 
 #include <QThread>
 
@@ -12,7 +17,6 @@
 
 
 #define MAX16BIT    32768
-//#define PROFILE
 
 
 /* ---------------------------------------------------------------- */
@@ -24,10 +28,15 @@
 // Aux amp = 2.2 V.
 // Digital words/channels get zeros.
 //
+// If sync is enabled, the configured sync channel instead
+// carries the pulser (sync), as a digital bit or as an analog
+// 0/90%-range square wave.
+//
 static void genNPts(
     vec_i16             &data,
     const DAQ::Params   &p,
     const double        *gain,
+    const SimPulser     &sync,
     int                 nPts,
     quint64             cumSamp )
 {
@@ -77,6 +86,36 @@ else
         for( int c = nAna; c < n16; ++c )
             dst[c + s*n16] = 0;
     }
+
+// Sync channel
+
+    if( p.sync.sourceIdx == DAQ::eSyncSourceNone )
+        return;
+
+    int     chan;
+    qint16  hi;
+
+    if( p.sync.niChanType == 0 ) {
+        chan    = nAna + p.sync.niChan/16;
+        hi      = 1 << (p.sync.niChan % 16);
+    }
+    else {
+        chan    = p.sync.niChan;
+        hi      = p.ni.vToInt16( 0.9 * p.ni.range.rmax, chan );
+    }
+
+    if( chan < 0 || chan >= n16 )
+        return;
+
+    for( int s = 0; s < nPts; ++s ) {
+
+        qint16  &d = dst[chan + s*n16];
+
+        if( p.sync.niChanType == 0 )
+            d = (sync.level( cumSamp + s ) ? d | hi : d & ~hi);
+        else
+            d = (sync.level( cumSamp + s ) ? hi : 0);
+    }
 }
 
 /* ---------------------------------------------------------------- */
@@ -84,7 +123,8 @@ else
 /* ---------------------------------------------------------------- */
 
 // Alternately:
-// (1) Generate pts at the sample rate.
+// (1) Generate pts at the sample rate (times simSpeed),
+//     or replay them from p.ni.simReplay.
 // (2) Sleep balance of time, up to loopSecs.
 //
 void CniAcqSim::run()
@@ -101,6 +141,28 @@ void CniAcqSim::run()
     for( int c = 0; c < nAna; ++c )
         gain[c] = p.ni.chanGain( c );
 
+// Optional file source
+
+    SimReplay   rep;
+    bool        isRep = !p.ni.simReplay.isEmpty();
+
+    if( isRep ) {
+
+        QString err;
+
+        if( !rep.open(
+                err,
+                DFRunTag( p.ni.simReplay ).filename( -1, "bin" ),
+                -1,
+                p.ni.niCumTypCnt[CniCfg::niSumAll],
+                p.ni.srate ) ) {
+
+            Error() << err;
+            emit owner->daqError( err );
+            return;
+        }
+    }
+
 // -----
 // Start
 // -----
@@ -117,9 +179,24 @@ void CniAcqSim::run()
 // The penalty is a reduction in actual sample rate.
 
     const double    loopSecs    = 0.02;
-    const quint64   maxPts      = 10 * loopSecs * p.ni.srate;
 
-    double  t0 = getTime();
+    SimPulser   sync;
+    double      t0 = getTime();
+
+    sync.init(
+        t0, p.ni.srate * p.ni.simSpeed, p.ni.simPPM,
+        (p.sync.sourceIdx != DAQ::eSyncSourceNone ?
+            p.sync.sourcePeriod : 1.0),
+        1e-6 * p.ni.simJitUs, quint64(p.im.all.simSeed) ^ 0xFFFFULL );
+
+    if( p.ni.simPPM || p.ni.simJitUs > 0 ) {
+        Log() << QString("NI sim clock drift %1 ppm jitter %2 us.")
+                    .arg( p.ni.simPPM )
+                    .arg( p.ni.simJitUs );
+    }
+
+    const double    srate   = sync.clockRate();
+    const quint64   maxPts  = 10 * loopSecs * srate;
 
     owner->niQ->setTZero( t0 );
 
@@ -128,7 +205,7 @@ void CniAcqSim::run()
         double  tGen,
                 t           = getTime(),
                 tElapse     = t + loopSecs - t0;
-        quint64 targetCt    = tElapse * p.ni.srate;
+        quint64 targetCt    = tElapse * srate;
 
         // Make some more pts?
 
@@ -137,39 +214,33 @@ void CniAcqSim::run()
             vec_i16 data;
             int     nPts = qMin( targetCt - totPts, maxPts );
 
-            genNPts( data, p, &gain[0], nPts, totPts );
-
-            owner->niQ->enqueue( &data[0], nPts );
-            totPts += nPts;
+            if( isRep ) {
+                data.resize( p.ni.niCumTypCnt[CniCfg::niSumAll] * nPts );
+                nPts = rep.get( &data[0], nPts );
+            }
+            else
+                genNPts( data, p, &gain[0], sync, nPts, totPts );
+
+            if( nPts ) {
+                owner->niQ->enqueue( &data[0], nPts );
+                totPts += nPts;
+            }
         }
 
         tGen = getTime() - t;
 
-        static double   tLastReport = t;
-
-        if( t - tLastReport > 1.0 ) {
-
-#ifdef PROFILE
-// The actual rate should be ~p.ni.srate = [[ 19737 ]].
-// The generator T should be <= loopSecs = [[ 20.00 ]] ms.
-
-            static quint64  lastPts = 0;
+        // Generator time should be <= loopSecs
 
-            Log() <<
-                QString("ni rate %1    tot %2")
-                .arg( (totPts-lastPts)/(t-tLastReport), 0, 'f', 0 )
-                .arg( 1000*tGen, 5, 'f', 2, '0' );
-
-            lastPts = totPts;
-#endif
-            tLastReport = t;
-        }
+        if( Trace::on() )
+            Trace::zone( "ni sim gen", quint64(1e6 * t) );
 
         if( tGen < loopSecs )
             QThread::usleep( 1e6 * (loopSecs - tGen) );
         else
             QThread::usleep( 1000 * 10 );
     }
+
+    RunBench::addCPU( RunBench::stgAcq );
 }
 
 
@@ -0,0 +1,379 @@
+#include "ErpStream.h"
+#include "Util.h"
+#include "AIQ.h"
+
+#include <QThread>
+
+#include <algorithm>
+
+
+#define ERP_MAXSECS     0.05    // src scans per detect pass
+#define ERP_KEEPSECS    2.0     // spikes kept for late events
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+static bool ctLess( const SpikeEvtRec &R, quint64 ct )
+{
+    return R.ct < ct;
+}
+
+/* ---------------------------------------------------------------- */
+/* ErpStream ------------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+ErpStream::ErpStream( const AIQ *evQ, const AIQ *src, const ErpParams &P )
+    :   QObject(0), evQ(evQ), src(src), thread(0), spk(0), P(P),
+        nEvt(0), nDrop(0), psthLen(1), nPsth(0), pleaseStop(false)
+{
+    double  srate   = src->sRate();
+    int     nK      = P.chans.size();
+
+    nPre    = int(P.preSecs * srate + 0.5);
+    nPost   = qMax( 1, int(P.postSecs * srate + 0.5) );
+    binLen  = qMax( 1, int(P.binSecs * srate + 0.5) );
+    nBins   = (nPre + nPost + binLen - 1) / binLen;
+
+    acc.assign( nBins * nK, 0 );
+    win.assign( nBins * nK, 0 );
+
+    kOf.assign( src->nChans(), -1 );
+
+    for( int k = 0; k < nK; ++k )
+        kOf[P.chans[k]] = k;
+
+    if( !P.spkT.empty() ) {
+
+        psthLen = qMax( 1, int(P.psthSecs * srate + 0.5) );
+        nPsth   = (nPre + nPost + psthLen - 1) / psthLen;
+
+        hist.assign( nPsth * nK, 0 );
+
+        spk = new SpikeEvtDetect(
+                    P.chans, P.spkT, P.spkBand, srate,
+                    P.maxInt, P.refracSecs, 0, 0 );
+        spk->reset( src->endCount() );
+    }
+
+    evNext  = evQ->endCount();
+    evRid   = evQ->readerId( "erp" );
+    rdrId   = (src != evQ ? src->readerId( "erp" ) : evRid);
+
+    thread = new QThread;
+    moveToThread( thread );
+    Connect( thread, SIGNAL(started()), this, SLOT(run()) );
+    thread->start();
+}
+
+
+ErpStream::~ErpStream()
+{
+    pleaseStop = true;
+
+    thread->wait();
+    delete thread;
+
+    if( spk )
+        delete spk;
+}
+
+
+// Copy means so far; reset starts a new average.
+//
+void ErpStream::snapshot( ErpSnap &S, bool reset )
+{
+    const int   nK      = P.chans.size(),
+                nW      = nPre + nPost;
+    double      srate   = src->sRate();
+
+    QMutexLocker    ml( &accMtx );
+
+    S.nEvt      = nEvt;
+    S.nDrop     = nDrop;
+    S.binSecs   = binLen / srate;
+    S.psthSecs  = (nPsth ? psthLen / srate : 0);
+    S.preSecs   = nPre / srate;
+    S.nCh       = nK;
+    S.nBins     = nBins;
+    S.nPsth     = nPsth;
+
+    S.erp.assign( nK * nBins, 0.0F );
+    S.psth.assign( nK * nPsth, 0.0F );
+
+    if( nEvt ) {
+
+        // Last bins may be short
+
+        for( int b = 0; b < nBins; ++b ) {
+
+            double          d = 1.0 / (double(nEvt) * qMin( binLen, nW - b * binLen ));
+            const qint64    *A = &acc[b * nK];
+
+            for( int k = 0; k < nK; ++k )
+                S.erp[k * nBins + b] = float(A[k] * d * P.uvPer[k]);
+        }
+
+        for( int b = 0; b < nPsth; ++b ) {
+
+            double          d = srate / (double(nEvt) * qMin( psthLen, nW - b * psthLen ));
+            const quint32   *H = &hist[b * nK];
+
+            for( int k = 0; k < nK; ++k )
+                S.psth[k * nPsth + b] = float(H[k] * d);
+        }
+    }
+
+    if( reset ) {
+        std::fill( acc.begin(), acc.end(), 0 );
+        std::fill( hist.begin(), hist.end(), 0 );
+        nEvt    = 0;
+        nDrop   = 0;
+    }
+}
+
+
+void ErpStream::run()
+{
+    while( !pleaseStop ) {
+
+        bool    busy = findEvents();
+
+        if( spk && detectSpikes() )
+            busy = true;
+
+        if( addWindows() )
+            busy = true;
+
+        // Readers at oldest count still needed
+
+        quint64 srcAt = (spk ? spk->readCt() : src->endCount());
+
+        if( !pend.empty() )
+            srcAt = qMin( srcAt, pend.front() - nPre );
+
+        if( src != evQ ) {
+            evQ->readerAt( evRid, evNext );
+            src->readerAt( rdrId, srcAt );
+        }
+        else
+            evQ->readerAt( evRid, qMin( evNext, srcAt ) );
+
+        if( !busy )
+            QThread::usleep( 1000 * 5 );
+    }
+
+    thread->quit();
+}
+
+
+// Queue new edges as src counts. Return true if any.
+//
+bool ErpStream::findEvents()
+{
+    bool    any = false;
+
+    for(;;) {
+
+        quint64 edgeCt;
+        bool    found;
+
+        if( P.evBit >= 0 ) {
+            found = evQ->findBitRisingEdge(
+                        edgeCt, evNext, P.evChan, P.evBit, P.evInarow );
+        }
+        else {
+            found = evQ->findRisingEdge(
+                        edgeCt, evNext, P.evChan, P.evT, P.evInarow );
+        }
+
+        if( !found ) {
+            evNext = edgeCt;
+            break;
+        }
+
+        evNext  = edgeCt + 1;
+        any     = true;
+
+        double  ct = edgeCt;
+
+        if( src != evQ ) {
+
+            double  t;
+
+            evQ->mapCt2TimeSync( t, edgeCt );
+            src->mapTime2CtSync( ct, t );
+        }
+
+        if( ct < nPre ) {
+            QMutexLocker    ml( &accMtx );
+            ++nDrop;
+            continue;
+        }
+
+        pend.push_back( quint64(ct + 0.5) );
+    }
+
+    return any;
+}
+
+
+// Run detector along src. Return true if it advanced.
+//
+bool ErpStream::detectSpikes()
+{
+    QByteArray  evts,
+                snips;
+    quint64     done0   = spk->doneCt();
+    int         nMax    = qMax( 1, int(ERP_MAXSECS * src->sRate()) );
+
+    if( spk->process( evts, snips, src, nMax ) < 0 ) {
+
+        // Lapped: spikes for pending windows are lost
+
+        dropPending();
+        spikes.clear();
+        return true;
+    }
+
+    const SpikeEvtRec   *R = (const SpikeEvtRec*)evts.constData();
+
+    for( int i = 0, n = evts.size() / sizeof(SpikeEvtRec); i < n; ++i )
+        spikes.push_back( R[i] );
+
+    return spk->doneCt() != done0;
+}
+
+
+// Sum pending windows now complete (and searched for spikes).
+// Return true if any.
+//
+bool ErpStream::addWindows()
+{
+    quint64 endCt   = src->endCount();
+    bool    any     = false;
+
+    if( spk )
+        endCt = qMin( endCt, spk->doneCt() );
+
+    while( !pend.empty() && pend.front() + nPost <= endCt ) {
+
+        quint64 ct = pend.front();
+
+        pend.pop_front();
+        any = true;
+
+        if( !addWindow( ct ) ) {
+            QMutexLocker    ml( &accMtx );
+            ++nDrop;
+        }
+    }
+
+    if( spk )
+        trimSpikes();
+
+    return any;
+}
+
+
+// Sum window of ct, read in place, into bins. Return false
+// if src lapped it.
+//
+bool ErpStream::addWindow( quint64 ct )
+{
+    const int   nC      = src->nChans(),
+                nK      = P.chans.size(),
+                nW      = nPre + nPost,
+                *C      = &P.chans[0];
+    quint64     fromCt  = ct - nPre;
+    int         it0     = 0;
+
+    std::fill( win.begin(), win.end(), 0 );
+
+    while( it0 < nW ) {
+
+        AIQ::View   V;
+
+        if( src->getView( V, fromCt + it0, nW - it0 ) < 0 || !V.nScans() )
+            return false;
+
+        for( int is = 0; is < 2; ++is ) {
+
+            const qint16    *S = V.span[is];
+
+            for( int it = 0, ns = V.nspan[is]; it < ns; ++it, ++it0, S += nC ) {
+
+                qint64  *A = &win[(it0 / binLen) * nK];
+
+                for( int k = 0; k < nK; ++k )
+                    A[k] += S[C[k]];
+            }
+        }
+
+        if( !src->isIntact( V ) )
+            return false;
+    }
+
+    QMutexLocker    ml( &accMtx );
+
+    for( int i = 0, n = acc.size(); i < n; ++i )
+        acc[i] += win[i];
+
+    if( spk )
+        addPsth( ct );
+
+    ++nEvt;
+    return true;
+}
+
+
+// Bin spikes within window of ct; caller holds accMtx.
+//
+void ErpStream::addPsth( quint64 ct )
+{
+    const int   nK  = P.chans.size();
+    quint64     w0  = ct - nPre,
+                w1  = ct + nPost;
+
+    std::deque<SpikeEvtRec>::const_iterator
+        it  = std::lower_bound( spikes.begin(), spikes.end(), w0, ctLess ),
+        end = spikes.end();
+
+    for( ; it != end && it->ct < w1; ++it ) {
+
+        int k = kOf[it->ic];
+
+        if( k >= 0 )
+            ++hist[((it->ct - w0) / psthLen) * nK + k];
+    }
+}
+
+
+void ErpStream::dropPending()
+{
+    QMutexLocker    ml( &accMtx );
+
+    nDrop += pend.size();
+    pend.clear();
+}
+
+
+// Forget spikes older than any window could still want: the
+// oldest pending one's, or one ERP_KEEPSECS back for events
+// not yet seen on a lagging event stream.
+//
+void ErpStream::trimSpikes()
+{
+    quint64 keep    = quint64(ERP_KEEPSECS * src->sRate()) + nPre,
+            oldest  = (pend.empty() ? spk->doneCt() : pend.front());
+
+    if( oldest <= keep )
+        return;
+
+    oldest -= keep;
+
+    while( !spikes.empty() && spikes.front().ct < oldest )
+        spikes.pop_front();
+}
+
+
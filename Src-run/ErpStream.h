@@ -0,0 +1,136 @@
+#ifndef ERPSTREAM_H
+#define ERPSTREAM_H
+
+#include "SpikeEvt.h"
+
+#include <QObject>
+#include <QMutex>
+
+#include <atomic>
+#include <deque>
+
+class QThread;
+
+// Longest peri-event window, pre + post.
+#define ERP_MAXWINSECS  10.0
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Event line, window and channels of an ErpStream. Events are
+// rising edges: of bit evBit of acquired word evChan, or if evBit
+// < 0, of analog channel evChan through threshold evT (counts);
+// the level must hold evInarow counts. If spkT is given (per
+// channel, negative counts) spikes are also detected on chans
+// and binned into PSTHs.
+//
+struct ErpParams {
+    std::vector<int>    chans,      // data stream acquired chans
+                        spkT;       // empty = no PSTH
+    std::vector<float>  uvPer;      // per chan uV per count
+    BiquadBand          spkBand;
+    double              preSecs,
+                        postSecs,
+                        binSecs,    // ERP bin width
+                        psthSecs,   // PSTH bin width
+                        refracSecs;
+    int                 evChan,
+                        evBit,
+                        evInarow,
+                        maxInt;     // data stream count range
+    qint16              evT;
+
+    ErpParams()
+    :   spkBand(300), preSecs(0.1), postSecs(0.5), binSecs(0.001),
+        psthSecs(0.01), refracSecs(0.001), evChan(0), evBit(0),
+        evInarow(1), maxInt(32768), evT(0)  {}
+};
+
+
+// A published result: per channel ERP means (uV) and, if any,
+// PSTH rates (spikes/s), chan-major.
+//
+struct ErpSnap {
+    std::vector<float>  erp,
+                        psth;
+    quint64             nEvt,
+                        nDrop;
+    double              binSecs,
+                        psthSecs,
+                        preSecs;
+    int                 nCh,
+                        nBins,
+                        nPsth;
+
+    ErpSnap()
+    :   nEvt(0), nDrop(0), binSecs(0), psthSecs(0), preSecs(0),
+        nCh(0), nBins(0), nPsth(0)  {}
+};
+
+
+// Server-side trial averaging.
+//
+// A worker follows event stream evQ from its head with the
+// tiled AIQ edge finders. Each edge is mapped (sync-corrected,
+// if the streams differ) to a count of data stream src, and
+// once its whole window [ct - pre, ct + post) is queued the
+// window is summed into per-channel bins, read in place. If
+// PSTHs are on, SpikeEvtDetect runs along src too, and the
+// spikes in the window are binned once detection is past it.
+//
+// Windows src has already lapped are dropped (counted). Sums
+// are exact (integer); snapshot() scales them to means.
+//
+class ErpStream : public QObject
+{
+    Q_OBJECT
+
+private:
+    const AIQ               *evQ,
+                            *src;
+    QThread                 *thread;
+    SpikeEvtDetect          *spk;
+    ErpParams               P;
+    std::vector<qint64>     acc,    // nBins * nCh, bin-major
+                            win;    // one event's sums
+    std::vector<quint32>    hist;   // nPsth * nCh, bin-major
+    std::vector<int>        kOf;    // acquired chan -> index
+    std::deque<quint64>     pend;   // event counts in src
+    std::deque<SpikeEvtRec> spikes;
+    mutable QMutex          accMtx;
+    quint64                 nEvt,
+                            nDrop,
+                            evNext;
+    int                     nPre,
+                            nPost,
+                            binLen,
+                            nBins,
+                            psthLen,
+                            nPsth,
+                            evRid,
+                            rdrId;
+    std::atomic<bool>       pleaseStop;
+
+public:
+    ErpStream( const AIQ *evQ, const AIQ *src, const ErpParams &P );
+    virtual ~ErpStream();
+
+    void snapshot( ErpSnap &S, bool reset );
+
+public slots:
+    void run();
+
+private:
+    bool findEvents();
+    bool detectSpikes();
+    bool addWindows();
+    bool addWindow( quint64 ct );
+    void addPsth( quint64 ct );
+    void dropPending();
+    void trimSpikes();
+};
+
+#endif  // ERPSTREAM_H
+
+
@@ -0,0 +1,418 @@
+
+#include "FltStream.h"
+#include "Util.h"
+#include "AIQ.h"
+#include "GpuCascade.h"
+
+#include <QMutex>
+#include <QThread>
+
+
+#define FLTMAXSECS  0.05
+
+// On-demand stages: queue capacity, and join offset behind head.
+#define SHARESECS   1
+#define SHAREBACK   0.5
+
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+struct ShareRec {
+    const AIQ   *src;
+    BiquadBand  B;
+    FltStream   *F;     // on-demand stage, if made
+    int         nUser;
+};
+
+static QMutex                   regMtx;
+static QVector<FltStream*>      registry;
+static QMutex                   shrMtx;
+static QVector<ShareRec>        shares;
+static bool                     gpuOn = false;
+
+/* ---------------------------------------------------------------- */
+/* FltStream ------------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+FltStream::FltStream(
+    const AIQ           *src,
+    int                 c0,
+    int                 cLim,
+    int                 maxInt,
+    const BiquadBand    &B,
+    int                 capacitySecs,
+    quint64             fromCt,
+    bool                viewsOnly,
+    const std::vector<int>  *ord )
+    :   QObject(0), src(src), thread(0), gpu(0), band(B),
+        maxInt(maxInt), c0(c0), cLim(cLim),
+        viewsOnly(viewsOnly), wantGpu(gpuOn), fromCt(fromCt),
+        nzero(BIQUAD_TRANS_WIDE), pleaseStop(false)
+{
+    dst = new AIQ( src->sRate(), src->nChans(), capacitySecs );
+
+    flt.addBand( B, src->sRate() );
+
+    if( !flt.nSections() )
+        nzero = 0;
+
+    if( ord ) {
+        this->ord.assign( ord->begin(), ord->begin() + (cLim - c0) );
+        row.resize( cLim - c0 );
+    }
+
+    rdrId = src->readerId( "filter" );
+
+    regMtx.lock();
+        registry.push_back( this );
+    regMtx.unlock();
+
+    thread = new QThread;
+    moveToThread( thread );
+    Connect( thread, SIGNAL(started()), this, SLOT(run()) );
+    thread->start();
+}
+
+
+// Consumers must be done with queue() before this.
+//
+FltStream::~FltStream()
+{
+    regMtx.lock();
+        registry.removeOne( this );
+    regMtx.unlock();
+
+    pleaseStop = true;
+
+    thread->wait();
+    delete thread;
+
+    if( gpu )
+        delete gpu;
+
+    delete dst;
+}
+
+
+// Stop following src, keeping queue and filter for restart().
+//
+void FltStream::stop()
+{
+    pleaseStop = true;
+    thread->wait();
+}
+
+
+// Follow src again from count zero: src has been reset for
+// a new run, so dst and filter memory are reset to match.
+//
+void FltStream::restart()
+{
+    dst->reset();
+    flt.clearMem();
+
+    if( gpu )
+        gpu->clearMem();
+
+    fromCt      = 0;
+    rdrId       = src->readerId( "filter" );
+    nzero       = (flt.nSections() ? BIQUAD_TRANS_WIDE : 0);
+    pleaseStop  = false;
+
+    thread->start();
+}
+
+
+// Stages made after this call filter on the GPU if on
+// and one is usable. Call from GUI thread.
+//
+void FltStream::useGpu( bool on )
+{
+    gpuOn = on;
+}
+
+
+// Return filtered companion of src with given band, else 0.
+// On-demand stages are returned only to views.
+//
+const AIQ *FltStream::find(
+    const AIQ           *src,
+    const BiquadBand    &B,
+    bool                views )
+{
+    QMutexLocker    ml( &regMtx );
+
+    for( int i = 0, n = registry.size(); i < n; ++i ) {
+
+        const FltStream *F = registry[i];
+
+        if( F->src == src && F->band == B
+            && (views || !F->viewsOnly) && F->ord.empty() ) {
+
+            return F->dst;
+        }
+    }
+
+    return 0;
+}
+
+
+// Return site-ordered companion of src's band B stage (of src
+// itself if B is off), and its order, else 0.
+//
+const AIQ *FltStream::findOrdered(
+    const AIQ           *src,
+    const BiquadBand    &B,
+    std::vector<int>    &ord )
+{
+    const AIQ   *Q = (B.isOff() ? src : find( src, B ));
+
+    if( !Q )
+        return 0;
+
+    QMutexLocker    ml( &regMtx );
+
+    for( int i = 0, n = registry.size(); i < n; ++i ) {
+
+        const FltStream *F = registry[i];
+
+        if( F->src == Q && !F->ord.empty() ) {
+            ord = F->ord;
+            return F->dst;
+        }
+    }
+
+    return 0;
+}
+
+
+// Count a user of (src, B), filtering channels [0,cLim). Make
+// a stage if this is the second user and none exists yet.
+//
+void FltStream::share(
+    const AIQ           *src,
+    int                 cLim,
+    int                 maxInt,
+    const BiquadBand    &B )
+{
+    QMutexLocker    ml( &shrMtx );
+    ShareRec        *R = 0;
+
+    for( int i = 0, n = shares.size(); i < n; ++i ) {
+
+        if( shares[i].src == src && shares[i].B == B ) {
+            R = &shares[i];
+            break;
+        }
+    }
+
+    if( !R ) {
+
+        ShareRec    S;
+
+        S.src   = src;
+        S.B     = B;
+        S.F     = 0;
+        S.nUser = 0;
+
+        shares.push_back( S );
+        R = &shares.back();
+    }
+
+    if( ++R->nUser < 2 || R->F || find( src, B, true ) )
+        return;
+
+    quint64 endCt   = src->endCount(),
+            back    = quint64(SHAREBACK * src->sRate());
+
+    R->F = new FltStream(
+                src, 0, cLim, maxInt, B, SHARESECS,
+                (endCt > back ? endCt - back : 0), true );
+
+    Debug() << "Filter stage shared by " << R->nUser << " views.";
+}
+
+
+// Drop a user of (src, B), and its on-demand stage with
+// the last one.
+//
+void FltStream::unshare( const AIQ *src, const BiquadBand &B )
+{
+    QMutexLocker    ml( &shrMtx );
+
+    for( int i = 0, n = shares.size(); i < n; ++i ) {
+
+        ShareRec    &R = shares[i];
+
+        if( R.src != src || !(R.B == B) )
+            continue;
+
+        if( --R.nUser <= 0 ) {
+
+            if( R.F )
+                delete R.F;
+
+            shares.remove( i );
+        }
+
+        return;
+    }
+}
+
+
+void FltStream::run()
+{
+    vec_i16 data;
+    quint64 nextCt  = fromCt;
+    int     nC      = src->nChans(),
+            nMax    = qMax( 1, int(FLTMAXSECS * src->sRate()) );
+    bool    joined  = false;
+
+    while( !pleaseStop ) {
+
+        if( dst->tZero() != src->tZero() )
+            dst->setTZero( src->tZero() );
+
+        quint64 endCt = src->endCount();
+
+        if( endCt <= nextCt ) {
+            QThread::usleep( 1000 );
+            continue;
+        }
+
+        if( !joined ) {
+
+            follow();
+            gpuInit( nMax );
+
+            // Joining late: counts before ours are a gap
+
+            if( nextCt )
+                dst->enqueueZero( 0, (nextCt + 0.5) / src->sRate() );
+
+            joined = true;
+        }
+
+        int n = int(qMin( endCt - nextCt, quint64(nMax) ));
+
+        data.clear();
+
+        if( 1 != src->getNScansFromCt( data, nextCt, n )
+            || (int)data.size() != n * nC ) {
+
+            lost( n );
+            nextCt += n;
+            continue;
+        }
+
+        if( gpu ) {
+
+            if( !gpu->apply( &data[0], maxInt, n ) ) {
+
+                delete gpu;
+                gpu = 0;
+
+                lost( n );
+                nextCt += n;
+                continue;
+            }
+        }
+        else
+            flt.applyBlockwiseMem( &data[0], maxInt, n, nC, c0, cLim );
+
+        if( !ord.empty() )
+            reorder( &data[0], n, nC );
+
+        if( nzero > 0 ) {
+
+            int nz = qMin( nzero, n );
+
+            for( int it = 0; it < nz; ++it ) {
+
+                memset(
+                    &data[it*nC + c0], 0,
+                    (cLim - c0) * sizeof(qint16) );
+            }
+
+            nzero -= nz;
+        }
+
+        dst->enqueue( &data[0], n );
+        nextCt += n;
+        src->readerAt( rdrId, nextCt );
+    }
+
+    thread->quit();
+}
+
+
+// Src is placed by its producer before its first enqueue, so
+// once it has data its node is settled. Called before our first
+// enqueue and first filter pass, which sizes filter memory.
+//
+void FltStream::follow()
+{
+    int     node = src->memNode();
+    uint    mask = (node >= 0 ? getNumaNodeMask( node ) : 0);
+
+    if( mask && setCurrentThreadAffinityMask( mask ) )
+        dst->placeLocal();
+}
+
+
+// Device filter state lives on the GPU; once made it's kept
+// across restart().
+//
+void FltStream::gpuInit( int maxScans )
+{
+    if( !wantGpu || gpu )
+        return;
+
+    gpu = new GpuCascade;
+
+    if( !gpu->init( flt, src->nChans(), c0, cLim, maxScans ) ) {
+        delete gpu;
+        gpu = 0;
+    }
+}
+
+
+// Permute each row's [c0,cLim) into site order.
+//
+void FltStream::reorder( qint16 *data, int ntpts, int nchans )
+{
+    int         nN  = cLim - c0;
+    const int   *o  = &ord[0];
+    qint16      *R  = &row[0];
+
+    for( int it = 0; it < ntpts; ++it, data += nchans ) {
+
+        qint16  *d = data + c0;
+
+        memcpy( R, d, nN * sizeof(qint16) );
+
+        for( int k = 0; k < nN; ++k )
+            d[k] = R[o[k] - c0];
+    }
+}
+
+
+// Source lapped us: zero-fill n scans, restart filter state.
+//
+void FltStream::lost( int n )
+{
+    Warning() << "Filter stage lost " << n << " scans.";
+
+    dst->enqueueZero( 0, (n + 0.5) / src->sRate() );
+
+    flt.clearMem();
+
+    if( gpu )
+        gpu->clearMem();
+
+    nzero = (flt.nSections() ? BIQUAD_TRANS_WIDE : 0);
+}
+
+
@@ -0,0 +1,126 @@
+#ifndef FLTSTREAM_H
+#define FLTSTREAM_H
+
+#include "Biquad.h"
+
+#include <QObject>
+
+#include <atomic>
+#include <vector>
+
+class AIQ;
+class GpuCascade;
+
+class QThread;
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Filtered companion stream.
+//
+// A worker follows source AIQ src and enqueues a copy to its own
+// AIQ with channels [c0,cLim) filtered by band B (highpass,
+// lowpass and line notches, one BiquadCascade pass), others
+// copied as is.
+// Counts and tZero match src scan for scan, so consumers can read
+// either queue interchangeably. If the worker ever falls out of
+// src, the gap is zero-filled to keep counts aligned.
+//
+// Consumers wanting a given band look it up with find(src, B)
+// rather than filtering privately, so filtering cost is paid once
+// per stream however many views and triggers are reading.
+//
+// Views, whose band can change, also declare the band they're
+// using with share(); once two or more share a (src, band) that
+// has no stage, one is made on demand, joining src about half a
+// second back from its head so its zero-filled start is behind
+// the readers. It's deleted when unshare() drops its last user,
+// so only find(src, B, views=true), used by views between their
+// share and unshare calls, returns it.
+//
+// The worker joins the NUMA node src was placed on, and puts its
+// own queue and filter memory there.
+//
+// A stage made with ord is a site-ordered companion instead:
+// its rows hold channel ord[k] of src at offset c0 + k (see
+// ShankMap::depthOrder), so spatial kernels (local or shank
+// CAR, neighborhoods) walk contiguous memory. These normally
+// follow a filtered stage with B off, and are returned only by
+// findOrdered(), which also gives the order. Saved files are
+// not affected.
+//
+// With useGpu(true) (daq.ini strmFltGpu, OpenCL builds) stages
+// made afterward run the cascade on the GPU, leaving the CPU to
+// acquisition; a device error zero-fills that block like a lost
+// one and the stage continues on the CPU.
+//
+class FltStream : public QObject
+{
+    Q_OBJECT
+
+private:
+    const AIQ           *src;
+    AIQ                 *dst;
+    QThread             *thread;
+    BiquadCascade       flt;
+    GpuCascade          *gpu;
+    std::vector<int>    ord;    // ordered: row offset c0+k <- ord[k]
+    std::vector<qint16> row;
+    const BiquadBand    band;
+    const int           maxInt,
+                        c0,
+                        cLim;
+    const bool          viewsOnly,
+                        wantGpu;
+    quint64             fromCt;
+    int                 rdrId,
+                        nzero;
+    std::atomic<bool>   pleaseStop;
+
+public:
+    FltStream(
+        const AIQ           *src,
+        int                 c0,
+        int                 cLim,
+        int                 maxInt,
+        const BiquadBand    &B,
+        int                 capacitySecs,
+        quint64             fromCt = 0,
+        bool                viewsOnly = false,
+        const std::vector<int>  *ord = 0 );
+    virtual ~FltStream();
+
+    void stop();
+    void restart();
+
+    static void useGpu( bool on );
+
+    static const AIQ *find(
+        const AIQ           *src,
+        const BiquadBand    &B,
+        bool                views = false );
+    static const AIQ *findOrdered(
+        const AIQ           *src,
+        const BiquadBand    &B,
+        std::vector<int>    &ord );
+    static void share(
+        const AIQ           *src,
+        int                 cLim,
+        int                 maxInt,
+        const BiquadBand    &B );
+    static void unshare( const AIQ *src, const BiquadBand &B );
+
+public slots:
+    void run();
+
+private:
+    void follow();
+    void gpuInit( int maxScans );
+    void reorder( qint16 *data, int ntpts, int nchans );
+    void lost( int n );
+};
+
+#endif  // FLTSTREAM_H
+
+
@@ -70,6 +70,7 @@ void IMReaderWorker::run()
 /* ---------------------------------------------------------------- */
 
 IMReader::IMReader( const DAQ::Params &p, QVector<AIQ*> &imQ )
+    :   tConfig(0)
 {
     thread  = new QThread;
     worker  = new IMReaderWorker( p, imQ );
@@ -80,7 +81,7 @@ IMReader::IMReader( const DAQ::Params &p, QVector<AIQ*> &imQ )
     Connect( worker, SIGNAL(finished()), worker, SLOT(deleteLater()) );
     Connect( worker, SIGNAL(destroyed()), thread, SLOT(quit()), Qt::DirectConnection );
 
-// Thread manually started by gate, via configure().
+// Thread manually started by run or gate, via configure().
 //    thread->start();
 }
 
@@ -102,8 +103,16 @@ IMReader::~IMReader()
 }
 
 
+// Start thread, which configures the hardware then waits
+// for start(). Later calls do nothing, so a reader that has
+// already quit isn't restarted.
+//
 void IMReader::configure()
 {
+    if( tConfig )
+        return;
+
+    tConfig = getTime();
     thread->start();
 }
 
@@ -51,6 +51,7 @@ class IMReader
 public:
     QThread         *thread;
     IMReaderWorker  *worker;
+    double          tConfig;    // when configure() began, 0=not yet
 
 public:
     IMReader( const DAQ::Params &p, QVector<AIQ*> &imQ );
@@ -0,0 +1,209 @@
+#include "ImTelemetry.h"
+#include "Util.h"
+
+#include <string.h>
+
+
+ImTelemetry::Prb    ImTelemetry::P[MAXPRB];
+
+/* ---------------------------------------------------------------- */
+/* Snapshot ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void ImTelemetry::Snapshot::diff(
+    const Snapshot  &now,
+    const Snapshot  &was )
+{
+    for( int i = 0; i < NGAP; ++i )
+        gap[i] = now.gap[i] - was.gap[i];
+
+    for( int i = 0; i < NCYC; ++i )
+        cyc[i] = now.cyc[i] - was.cyc[i];
+
+    for( int i = 0; i < NFIFO; ++i )
+        fifo[i] = now.fifo[i] - was.fifo[i];
+}
+
+
+quint64 ImTelemetry::Snapshot::nGapEvt() const
+{
+    quint64 n = 0;
+
+    for( int i = 0; i < NGAP; ++i ) {
+        if( i < 3 || i > 4 )
+            n += gap[i];
+    }
+
+    return n;
+}
+
+
+quint64 ImTelemetry::Snapshot::nCyc() const
+{
+    quint64 n = 0;
+
+    for( int i = 0; i < NCYC; ++i )
+        n += cyc[i];
+
+    return n;
+}
+
+
+quint64 ImTelemetry::Snapshot::nFifo() const
+{
+    quint64 n = 0;
+
+    for( int i = 0; i < NFIFO; ++i )
+        n += fifo[i];
+
+    return n;
+}
+
+
+double ImTelemetry::Snapshot::cycPctile( double pct ) const
+{
+    return qoctPctile( cyc, NCYC, 16e-6, pct );
+}
+
+
+int ImTelemetry::Snapshot::fifoPctile( double pct ) const
+{
+    quint64 N = nFifo(), sum = 0;
+
+    if( !N )
+        return 0;
+
+    for( int i = 0; i < NFIFO; ++i ) {
+
+        sum += fifo[i];
+
+        if( sum >= 0.01 * pct * N )
+            return qMin( 100, 5 * (i + 1) );
+    }
+
+    return 100;
+}
+
+/* ---------------------------------------------------------------- */
+/* ImTelemetry ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Call at run start, before fetching begins.
+//
+void ImTelemetry::reset( int np )
+{
+    for( int ip = 0; ip < np && ip < MAXPRB; ++ip ) {
+
+        Prb &R = P[ip];
+
+        for( int i = 0; i < NGAP; ++i )
+            R.gap[i].store( 0, std::memory_order_relaxed );
+
+        for( int i = 0; i < NCYC; ++i )
+            R.cyc[i].store( 0, std::memory_order_relaxed );
+
+        for( int i = 0; i < NFIFO; ++i )
+            R.fifo[i].store( 0, std::memory_order_relaxed );
+
+        R.lastTStamp = 0;
+        R.haveTStamp = false;
+    }
+}
+
+
+// Histogram successive timestamp differences,
+// both within and across fetches.
+//
+void ImTelemetry::addTStamp( int ip, quint32 ts )
+{
+    if( ip >= MAXPRB )
+        return;
+
+    Prb &R = P[ip];
+
+    if( R.haveTStamp ) {
+
+        qint64  dif = qint64(ts) - R.lastTStamp;
+
+        if( dif < 0 )
+            bump( R.gap[32] );
+        else if( dif > 31 )
+            bump( R.gap[33] );
+        else
+            bump( R.gap[dif] );
+    }
+
+    R.lastTStamp = ts;
+    R.haveTStamp = true;
+}
+
+
+// Record one fetch/scale cycle time; quarter-octave bins.
+//
+void ImTelemetry::addCycle( int ip, double secs )
+{
+    if( ip >= MAXPRB )
+        return;
+
+    bump( P[ip].cyc[qoctBin( secs, 16e-6, NCYC )] );
+}
+
+
+void ImTelemetry::addFifo( int ip, int pct )
+{
+    if( ip >= MAXPRB )
+        return;
+
+    bump( P[ip].fifo[qBound( 0, pct / 5, NFIFO - 1 )] );
+}
+
+
+void ImTelemetry::snapshot( Snapshot &S, int ip )
+{
+    if( ip >= MAXPRB ) {
+        memset( &S, 0, sizeof(Snapshot) );
+        return;
+    }
+
+    const Prb   &R = P[ip];
+
+    for( int i = 0; i < NGAP; ++i )
+        S.gap[i] = R.gap[i].load( std::memory_order_relaxed );
+
+    for( int i = 0; i < NCYC; ++i )
+        S.cyc[i] = R.cyc[i].load( std::memory_order_relaxed );
+
+    for( int i = 0; i < NFIFO; ++i )
+        S.fifo[i] = R.fifo[i].load( std::memory_order_relaxed );
+}
+
+
+// Run totals as name=value lines for GETIMTELEMETRY.
+//
+QString ImTelemetry::remoteStr( int ip )
+{
+    Snapshot    S;
+    QString     s, g;
+
+    snapshot( S, ip );
+
+    for( int i = 0; i < NGAP; ++i )
+        g += QString(i ? ",%1" : "%1").arg( S.gap[i] );
+
+    s  = QString("tStampGapEvents=%1\n").arg( S.nGapEvt() );
+    s += QString("tStampDeltaHist=%1\n").arg( g );
+    s += QString("cycleN=%1\n").arg( S.nCyc() );
+    s += QString("cycleMsP50=%1\n").arg( 1000*S.cycPctile( 50 ), 0, 'f', 3 );
+    s += QString("cycleMsP90=%1\n").arg( 1000*S.cycPctile( 90 ), 0, 'f', 3 );
+    s += QString("cycleMsP99=%1\n").arg( 1000*S.cycPctile( 99 ), 0, 'f', 3 );
+    s += QString("cycleMsMax=%1\n").arg( 1000*S.cycPctile( 100 ), 0, 'f', 3 );
+    s += QString("fifoN=%1\n").arg( S.nFifo() );
+    s += QString("fifoPctP50=%1\n").arg( S.fifoPctile( 50 ) );
+    s += QString("fifoPctP90=%1\n").arg( S.fifoPctile( 90 ) );
+    s += QString("fifoPctP99=%1\n").arg( S.fifoPctile( 99 ) );
+    s += QString("fifoPctMax=%1\n").arg( S.fifoPctile( 100 ) );
+
+    return s;
+}
+
+
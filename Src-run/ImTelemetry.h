@@ -0,0 +1,73 @@
+#ifndef IMTELEMETRY_H
+#define IMTELEMETRY_H
+
+#include <QString>
+
+#include <atomic>
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Always-on imec acquisition telemetry, per probe.
+//
+// Each probe's counters have a single writer (its fetch
+// thread), so updates are plain relaxed load/store; readers
+// (MetricsWindow, CmdServer) take relaxed snapshots anytime.
+// Counters accumulate over the run; callers wanting recent
+// figures difference two snapshots.
+//
+class ImTelemetry
+{
+public:
+    enum {
+        MAXPRB  = 64,
+        NGAP    = 34,   // timestamp delta [0..31], <0, >31
+        NCYC    = 48,   // quarter-octave bins from 16 us
+        NFIFO   = 21    // 5% bins, [0..100]
+    };
+
+    struct Snapshot {
+        quint64 gap[NGAP],
+                cyc[NCYC],
+                fifo[NFIFO];
+
+        void diff( const Snapshot &now, const Snapshot &was );
+
+        quint64 nGapEvt() const;   // deltas outside normal [3,4]
+        quint64 nCyc() const;
+        quint64 nFifo() const;
+        double cycPctile( double pct ) const;   // seconds
+        int fifoPctile( double pct ) const;     // %
+    };
+
+private:
+    struct Prb {
+        std::atomic<quint64>    gap[NGAP],
+                                cyc[NCYC],
+                                fifo[NFIFO];
+        quint32                 lastTStamp;
+        bool                    haveTStamp;
+    };
+
+    static Prb  P[MAXPRB];
+
+public:
+    static void reset( int np );
+
+    static void addTStamp( int ip, quint32 ts );
+    static void addCycle( int ip, double secs );
+    static void addFifo( int ip, int pct );
+
+    static void snapshot( Snapshot &S, int ip );
+    static QString remoteStr( int ip );
+
+private:
+    static inline void bump( std::atomic<quint64> &c )
+        {c.store( c.load( std::memory_order_relaxed ) + 1,
+            std::memory_order_relaxed );}
+};
+
+#endif  // IMTELEMETRY_H
+
+
@@ -3,6 +3,7 @@
 #include "Util.h"
 #include "CniAcqDmx.h"
 #include "CniAcqSim.h"
+#include "ThdPlace.h"
 
 #include <QThread>
 
@@ -54,6 +55,9 @@ void NIReaderWorker::stop()
 
 void NIReaderWorker::run()
 {
+    ThdPlace::apply( ThdPlace::roleNI );
+    niQ->placeLocal();
+
     niAcq->run();
 
     emit finished();
@@ -64,6 +68,7 @@ void NIReaderWorker::run()
 /* ---------------------------------------------------------------- */
 
 NIReader::NIReader( const DAQ::Params &p, AIQ *niQ )
+    :   tConfig(0)
 {
     thread  = new QThread;
     worker  = new NIReaderWorker( p, niQ );
@@ -74,7 +79,7 @@ NIReader::NIReader( const DAQ::Params &p, AIQ *niQ )
     Connect( worker, SIGNAL(finished()), worker, SLOT(deleteLater()) );
     Connect( worker, SIGNAL(destroyed()), thread, SLOT(quit()), Qt::DirectConnection );
 
-// Thread manually started by gate, via configure().
+// Thread manually started by run or gate, via configure().
 //    thread->start();
 }
 
@@ -96,8 +101,16 @@ NIReader::~NIReader()
 }
 
 
+// Start thread, which configures the hardware then waits
+// for start(). Later calls do nothing, so a reader that has
+// already quit isn't restarted.
+//
 void NIReader::configure()
 {
+    if( tConfig )
+        return;
+
+    tConfig = getTime();
     thread->start();
 }
 
@@ -49,6 +49,7 @@ class NIReader
 public:
     QThread         *thread;
     NIReaderWorker  *worker;
+    double          tConfig;    // when configure() began, 0=not yet
 
 public:
     NIReader( const DAQ::Params &p, AIQ *niQ );
@@ -9,13 +9,23 @@
 #include "TrigTCP.h"
 #include "GraphsWindow.h"
 #include "GraphFetcher.h"
+#include "CmdServer.h"
 #include "AOCtl.h"
+#include "DFDiskMon.h"
+#include "FltStream.h"
+#include "SpecStream.h"
+#include "ErpStream.h"
+#include "Sync.h"
+#include "ThdPlace.h"
 #include "Version.h"
 
 #include <QAction>
 #include <QMessageBox>
 
 
+#define SPEC_RATE   2500    // target spectral stage rate
+
+
 
 
 /* ---------------------------------------------------------------- */
@@ -66,6 +76,17 @@ void Run::GWPair::createWindow( const DAQ::Params &p, int igw )
 }
 
 
+void Run::GWPair::reuseWindow( int igw )
+{
+    gw->reuseForRun();
+    gw->show();
+
+    MainApp *app = mainApp();
+    app->act.shwHidGrfsAct->setEnabled( true );
+    app->modelessOpened( gw, igw > 0 );
+}
+
+
 void Run::GWPair::setTitle( int igw )
 {
     if( gw ) {
@@ -82,6 +103,19 @@ void Run::GWPair::setTitle( int igw )
 }
 
 
+// Hide window for reuse by next run.
+//
+void Run::GWPair::park()
+{
+    stopFetching();
+
+    if( gw ) {
+        mainApp()->modelessClosed( gw );
+        gw->hide();
+    }
+}
+
+
 void Run::GWPair::kill()
 {
     stopFetching();
@@ -112,6 +146,43 @@ void Run::GWPair::stopFetching()
     }
 }
 
+/* ---------------------------------------------------------------- */
+/* struct Parked -------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Note: filter stages read the queues, so go first, and
+// site-ordered stages, which read filter stages, go before
+// those (they're made last).
+//
+void Run::Parked::killQueues()
+{
+    for( int i = flts.size() - 1; i >= 0; --i )
+        delete flts[i];
+
+    flts.clear();
+
+    if( niQ ) {
+        delete niQ;
+        niQ = 0;
+    }
+
+    for( int ip = 0, np = imQ.size(); ip < np; ++ip )
+        delete imQ[ip];
+
+    imQ.clear();
+    qKey.clear();
+}
+
+
+void Run::Parked::killGraphs()
+{
+    for( int igw = 0, ngw = vGW.size(); igw < ngw; ++igw )
+        vGW[igw].kill();
+
+    vGW.clear();
+    gKey.clear();
+}
+
 /* ---------------------------------------------------------------- */
 /* Ctor ----------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -119,8 +190,15 @@ void Run::GWPair::stopFetching()
 Run::Run( MainApp *app )
     :   QObject(0), app(app), niQ(0),
         imReader(0), niReader(0),
-        gate(0), trg(0), running(false)
+        gate(0), trg(0), erpNextId(0), running(false)
+{
+}
+
+
+Run::~Run()
 {
+    park.killGraphs();
+    park.killQueues();
 }
 
 /* ---------------------------------------------------------------- */
@@ -426,6 +504,193 @@ int Run::streamSpanMax( const DAQ::Params &p, bool warn )
 #endif
 
 
+// Return seconds of pre-trigger spill each stream keeps behind
+// its ring: the part of the trigger's added context that the
+// ring can't supply while no more than half full, as for
+// spans within the ring alone. Zero if none needed.
+//
+double Run::trgSpillSecs( const DAQ::Params &p )
+{
+    double  ctx = trgContext( p );
+
+    if( ctx <= 0 )
+        return 0;
+
+    return qMax( 0.0, ctx - 0.50 * streamSpanMax( p, false ) );
+}
+
+
+// Set each stream's ring secs and pre-trigger spill secs, in
+// stream order (imec probes, then nidq).
+//
+// By default all rings get streamSpanMax() secs. If
+// p.strm.memBudgetGB is set, the budget (capped at 40% of
+// available RAM, where that's known) is divided instead:
+//
+// - Every stream's bytes are charged: ring, its filter stage
+//   copy, history tier (nominal 2:1) and spill (17/16).
+// - Rings all get the same secs S, so each stream's share goes
+//   by its channel count and rate, S being the most that fits,
+//   in [2, 30]. Spill then covers what trigger context half a
+//   ring can't.
+//
+// report logs the sizing and each stream's reach in seconds.
+//
+void Run::streamCapacity(
+    QVector<int>        &vSecs,
+    QVector<double>     &vSpill,
+    const DAQ::Params   &p,
+    bool                report )
+{
+    QVector<double> vBps;
+    double          ctx = trgContext( p );
+
+    streamBps( vBps, p );
+
+    int ns = vBps.size();
+
+    vSecs.fill( 0, ns );
+    vSpill.fill( 0, ns );
+
+    if( p.strm.memBudgetGB <= 0 ) {
+
+        int     secs    = streamSpanMax( p, report );
+        double  spill   = trgSpillSecs( p );
+
+        vSecs.fill( secs, ns );
+        vSpill.fill( spill, ns );
+
+        if( report && spill > 0 )
+            Log() << QString("Pre-trigger spill %1 seconds.").arg( spill, 0, 'f', 1 );
+
+        return;
+    }
+
+// ------
+// Budget
+// ------
+
+#ifdef Q_OS_WIN64
+    double  ram     = 0.40 * getRAMBytes64BitApp();
+#else
+    double  ram     = 0.40 * getRAMBytes32BitApp();
+#endif
+    double  budget  = p.strm.memBudgetGB * 1024.0 * 1024.0 * 1024.0,
+            need    = 0;
+    bool    imFlt   = !BiquadBand( p.im.all.fltLoHz, p.im.all.fltHiHz,
+                        p.im.all.fltNotchHz, p.im.all.fltNotchN ).isOff(),
+            niFlt   = !BiquadBand( p.ni.fltLoHz, p.ni.fltHiHz,
+                        p.ni.fltNotchHz, p.ni.fltNotchN ).isOff();
+    int     np      = p.im.get_nProbes(),
+            S;
+
+    if( ram > 0 && ram < budget )
+        budget = ram;
+
+    for( S = 30; S >= 2; --S ) {
+
+        double  spill = qMax( 0.0, ctx - 0.50 * S );
+
+        need = 0;
+
+        for( int is = 0; is < ns; ++is ) {
+
+            bool    flt = (is < np ? imFlt : niFlt);
+
+            need += vBps[is]
+                    * (S + (flt ? qMin( S, 10 ) : 0)
+                        + 0.5 * p.strm.histSecs
+                        + 17.0/16.0 * spill);
+        }
+
+        if( need <= budget || S == 2 )
+            break;
+    }
+
+    vSecs.fill( S, ns );
+    vSpill.fill( qMax( 0.0, ctx - 0.50 * S ), ns );
+
+    if( !report )
+        return;
+
+    Log() <<
+        QString("Stream memory budget %1 GB, using %2 GB.")
+        .arg( budget / (1024.0*1024.0*1024.0), 0, 'f', 2 )
+        .arg( need / (1024.0*1024.0*1024.0), 0, 'f', 2 );
+
+    if( need > budget ) {
+        Warning() <<
+            QString("Stream memory budget too small; minimum streams need"
+            " %1 GB.")
+            .arg( need / (1024.0*1024.0*1024.0), 0, 'f', 2 );
+    }
+
+    for( int is = 0; is < ns; ++is ) {
+
+        QString name = (is < np ? QString("imec%1").arg( is ) : QString("nidq"));
+
+        Log() <<
+            QString("  %1: ring %2 s, history ~%3 s, spill %4 s.")
+            .arg( name )
+            .arg( vSecs[is] )
+            .arg( p.strm.histSecs, 0, 'f', 1 )
+            .arg( vSpill[is], 0, 'f', 1 );
+    }
+}
+
+
+// Spill is sized for worst-case packing (17/16 of raw), and
+// may take at most fracMax of available RAM.
+//
+// Parked queues that p would reuse already hold their spill,
+// and that memory isn't available, so those fit as they are.
+//
+// Return true if fits; GB is the total over all streams.
+//
+bool Run::trgSpillFits( double &GB, const DAQ::Params &p )
+{
+    QVector<double> vBps,
+                    vSpill;
+    QVector<int>    vSecs;
+    double          fracMax = 0.25,
+                    ram;
+    bool            parked;
+
+    runMtx.lock();
+        parked = !park.qKey.isEmpty() && park.qKey == queueKey( p );
+        if( parked ) {
+            vSecs   = park.vSecs;
+            vSpill  = park.vSpill;
+        }
+    runMtx.unlock();
+
+    if( !parked )
+        streamCapacity( vSecs, vSpill, p );
+
+    streamBps( vBps, p );
+
+    GB = 0;
+
+    for( int is = 0, ns = qMin( vBps.size(), vSpill.size() ); is < ns; ++is )
+        GB += vBps[is] * 17.0 / 16.0 * vSpill[is];
+
+    GB /= 1024.0 * 1024.0 * 1024.0;
+
+// A memory budget already holds its spill
+
+    if( parked || p.strm.memBudgetGB > 0 )
+        return true;
+
+#ifdef Q_OS_WIN64
+    ram = getRAMBytes64BitApp();
+#else
+    ram = getRAMBytes32BitApp();
+#endif
+
+    return GB * 1024.0 * 1024.0 * 1024.0 <= fracMax * ram;
+}
+
+
 quint64 Run::getScanCount( int ip ) const
 {
     QMutexLocker    ml( &runMtx );
@@ -474,6 +739,103 @@ double Run::getStreamTime() const
     return getTime();
 }
 
+/* ---------------------------------------------------------------- */
+/* Spectral stage ops --------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Latest spectra of stream ip (-1 = nidq), if running and some
+// published; updtSecs > 0 also sets the stage update period.
+// Calling keeps the stage working (see SpecStream).
+//
+// specMtx, not runMtx: shank viewer workers call this, and
+// graphs (hence those workers) are deleted under runMtx.
+//
+bool Run::specSnapshot( SpecSnap &S, int ip, double updtSecs ) const
+{
+    QMutexLocker    ml( &specMtx );
+
+    QMap<int,SpecStream*>::const_iterator   it = specs.find( ip );
+
+    if( it == specs.end() )
+        return false;
+
+    if( updtSecs > 0 )
+        it.value()->setUpdtSecs( updtSecs );
+
+    return it.value()->snapshot( S );
+}
+
+/* ---------------------------------------------------------------- */
+/* Trial averaging stage ops -------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Start a trial averaging stage: events on stream evIp, data
+// from stream ip (-1 = nidq). Return its id, or -1 and err.
+//
+int Run::erpStart( QString &err, int evIp, int ip, const ErpParams &P )
+{
+    QMutexLocker    ml( &runMtx );
+
+    const AIQ   *evQ    = (evIp >= 0 ? (evIp < imQ.size() ? imQ[evIp] : 0) : niQ),
+                *src    = (ip >= 0 ? (ip < imQ.size() ? imQ[ip] : 0) : niQ);
+
+    if( !running || !evQ || !src ) {
+        err = "Not running.";
+        return -1;
+    }
+
+    if( P.preSecs + P.postSecs
+        > qMin( ERP_MAXWINSECS, 0.5 * src->capacitySecs() ) ) {
+
+        err = "Window too long.";
+        return -1;
+    }
+
+    QMutexLocker    ml2( &erpMtx );
+
+    int id = erpNextId++;
+
+    erps[id] = new ErpStream( evQ, src, P );
+
+    Log() << QString("Trial average %1 started on stream %2 (events %3).")
+                .arg( id ).arg( ip ).arg( evIp );
+
+    return id;
+}
+
+
+// Latest means of stage id; reset starts its average over.
+//
+bool Run::erpSnapshot( ErpSnap &S, int id, bool reset )
+{
+    QMutexLocker    ml( &erpMtx );
+
+    QMap<int,ErpStream*>::iterator  it = erps.find( id );
+
+    if( it == erps.end() )
+        return false;
+
+    it.value()->snapshot( S, reset );
+    return true;
+}
+
+
+bool Run::erpStop( int id )
+{
+    QMutexLocker    ml( &erpMtx );
+
+    QMap<int,ErpStream*>::iterator  it = erps.find( id );
+
+    if( it == erps.end() )
+        return false;
+
+    delete it.value();
+    erps.erase( it );
+
+    Log() << QString("Trial average %1 stopped.").arg( id );
+    return true;
+}
+
 /* ---------------------------------------------------------------- */
 /* Run control ---------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -514,18 +876,60 @@ bool Run::startRun( QString &errTitle, QString &errMsg )
     DAQ::Params &p = app->cfgCtl()->acceptedParams;
 
     setPreciseTiming( true );
+    ThdPlace::configure( p.strm.thdPlace );
+    DFDiskMon::reset();
+    CniCfg::setDOCaching( true );
 
-// ------
-// Graphs
-// ------
+// ---------------------------
+// Reuse last run's pipeline?
+// ---------------------------
+
+// Anything parked that doesn't fit this run is freed before
+// sizing and allocating its replacement. Reused queues keep
+// the sizes they were given, as parked memory would otherwise
+// count against the RAM the sizing sees as available.
 
-    vGW.push_back( GWPair( p, 0 ) );
+    qKey = queueKey( p );
+    gKey = graphKey( p );
+
+    if( park.gKey != gKey )
+        park.killGraphs();
+
+    if( qKey.isEmpty() || park.qKey != qKey )
+        park.killQueues();
+
+    bool    reuseQ = !park.qKey.isEmpty();
+
+    if( !reuseQ )
+        streamCapacity( park.vSecs, park.vSpill, p, true );
+
+    const QVector<int>      &vSecs  = park.vSecs;
+    const QVector<double>   &vSpill = park.vSpill;
+
+// Phases: each reader starts configuring its hardware as soon
+// as its queues exist, in its own thread, while the remaining
+// setup proceeds here. The gate arms both once both are ready,
+// so the start waits on the slowest, not the sum.
+
+    double  tPh0 = getTime(),
+            tPhQ, tPhF, tPhG;
 
 // -----------
 // IMEC stream
 // -----------
 
-    int streamSecs = streamSpanMax( p );
+    if( reuseQ ) {
+
+        imQ.swap( park.imQ );
+        niQ         = park.niQ;
+        park.niQ    = 0;
+
+        for( int ip = 0, np = imQ.size(); ip < np; ++ip )
+            imQ[ip]->reset();
+
+        if( niQ )
+            niQ->reset();
+    }
 
     if( p.im.enabled ) {
 
@@ -533,16 +937,30 @@ bool Run::startRun( QString &errTitle, QString &errMsg )
 
             const CimCfg::AttrEach  &E = p.im.each[ip];
 
-            imQ.push_back(
-                new AIQ(
-                    E.srate,
-                    E.imCumTypCnt[CimCfg::imSumAll],
-                    streamSecs ) );
+            if( !reuseQ ) {
+
+                imQ.push_back(
+                    new AIQ(
+                        E.srate,
+                        E.imCumTypCnt[CimCfg::imSumAll],
+                        vSecs[ip],
+                        p.strm.memFlags(),
+                        (p.strm.memShared ?
+                            QString("SpikeGLX_imec%1").arg( ip ) : QString()) ) );
+            }
+
+            imQ[ip]->enableHistory( p.strm.histSecs, vSpill[ip] );
+
+            // Index sync edges from the first block on
+
+            SyncStream  S;
+            S.init( imQ[ip], ip, p );
         }
 
         imReader = new IMReader( p, imQ );
         ConnectUI( imReader->worker, SIGNAL(daqError(QString)), app, SLOT(runDaqError(QString)) );
         ConnectUI( imReader->worker, SIGNAL(finished()), this, SLOT(workerStopsRun()) );
+        imReader->configure();
     }
 
 // -----------
@@ -551,17 +969,142 @@ bool Run::startRun( QString &errTitle, QString &errMsg )
 
     if( p.ni.enabled ) {
 
-        niQ =
-            new AIQ(
-                p.ni.srate,
-                p.ni.niCumTypCnt[CniCfg::niSumAll],
-                streamSecs );
+        if( !niQ ) {
+
+            niQ =
+                new AIQ(
+                    p.ni.srate,
+                    p.ni.niCumTypCnt[CniCfg::niSumAll],
+                    vSecs.back(),
+                    p.strm.memFlags(),
+                    (p.strm.memShared ? QString("SpikeGLX_nidq") : QString()) );
+        }
+
+        niQ->enableHistory( p.strm.histSecs, vSpill.back() );
+
+        SyncStream  S;
+        S.init( niQ, -1, p );
 
         niReader = new NIReader( p, niQ );
         ConnectUI( niReader->worker, SIGNAL(daqError(QString)), app, SLOT(runDaqError(QString)) );
         ConnectUI( niReader->worker, SIGNAL(finished()), this, SLOT(workerStopsRun()) );
+        niReader->configure();
+    }
+
+    tPhQ = getTime();
+
+// ---------------------
+// Shared filter stages
+// ---------------------
+
+// Made before consumers (trigger, graphs) so they can find them.
+
+    FltStream::useGpu( p.strm.fltGpu );
+
+    BiquadBand  imB( p.im.all.fltLoHz, p.im.all.fltHiHz,
+                    p.im.all.fltNotchHz, p.im.all.fltNotchN ),
+                niB( p.ni.fltLoHz, p.ni.fltHiHz,
+                    p.ni.fltNotchHz, p.ni.fltNotchN );
+
+    if( reuseQ ) {
+
+        flts.swap( park.flts );
+        park.qKey.clear();
+
+        for( int i = 0, n = flts.size(); i < n; ++i )
+            flts[i]->restart();
+    }
+    else if( !imB.isOff() ) {
+
+        for( int ip = 0, np = imQ.size(); ip < np; ++ip ) {
+
+            const CimCfg::AttrEach  &E = p.im.each[ip];
+
+            flts.push_back(
+                new FltStream(
+                    imQ[ip], 0, E.imCumTypCnt[CimCfg::imSumAP],
+                    E.roTbl->maxInt(), imB,
+                    qMin( vSecs[ip], 10 ) ) );
+        }
     }
 
+    if( !reuseQ && niQ && !niB.isOff() ) {
+
+        flts.push_back(
+            new FltStream(
+                niQ, 0, p.ni.niCumTypCnt[CniCfg::niSumNeural],
+                32768, niB,
+                qMin( vSecs.back(), 10 ) ) );
+    }
+
+// Site-ordered companions follow the filter stages (or raw
+// queues if unfiltered), reordering only.
+
+    if( !reuseQ && p.strm.shankOrder ) {
+
+        std::vector<int>    ord;
+
+        for( int ip = 0, np = imQ.size(); ip < np; ++ip ) {
+
+            const CimCfg::AttrEach  &E      = p.im.each[ip];
+            int                     nAP     = E.imCumTypCnt[CimCfg::imSumAP];
+            const AIQ               *Q      = imQ[ip];
+
+            if( !imB.isOff() )
+                Q = FltStream::find( Q, imB );
+
+            E.sns.shankMap.depthOrder( ord, nAP );
+
+            flts.push_back(
+                new FltStream(
+                    Q, 0, nAP, E.roTbl->maxInt(), BiquadBand(),
+                    qMin( vSecs[ip], 10 ), 0, false, &ord ) );
+        }
+
+        if( niQ ) {
+
+            int         nNu = p.ni.niCumTypCnt[CniCfg::niSumNeural];
+            const AIQ   *Q  = niQ;
+
+            if( !niB.isOff() )
+                Q = FltStream::find( Q, niB );
+
+            p.ni.sns.shankMap.depthOrder( ord, nNu );
+
+            flts.push_back(
+                new FltStream(
+                    Q, 0, nNu, 32768, BiquadBand(),
+                    qMin( vSecs.back(), 10 ), 0, false, &ord ) );
+        }
+    }
+
+// ------------------------------------
+// Spectral stages (idle until read)
+// ------------------------------------
+
+    specCreate( p );
+
+    tPhF = getTime();
+
+// ------
+// Graphs
+// ------
+
+    if( !park.vGW.empty() ) {
+
+        vGW.swap( park.vGW );
+        park.gKey.clear();
+
+        for( int igw = 0, ngw = vGW.size(); igw < ngw; ++igw )
+            vGW[igw].reuseWindow( igw );
+
+        app->act.moreTracesAct->setEnabled( vGW.size() == 1 );
+    }
+    else
+        vGW.push_back( GWPair( p, 0 ) );
+
+    tPhG = getTime();
+
 // -------
 // Trigger
 // -------
@@ -589,6 +1132,14 @@ bool Run::startRun( QString &errTitle, QString &errMsg )
     Status() << s;
     Log() << s;
 
+    Log() <<
+        QString("Run setup (beside hardware config): queues %1 s,"
+        " filters %2 s, graphs %3 s, trigger %4 s.")
+        .arg( tPhQ - tPh0, 0, 'f', 2 )
+        .arg( tPhF - tPhQ, 0, 'f', 2 )
+        .arg( tPhG - tPhF, 0, 'f', 2 )
+        .arg( getTime() - tPhG, 0, 'f', 2 );
+
     ml.unlock();    // ensure runMtx available to startup agents
 
     gate->startRun();
@@ -611,6 +1162,8 @@ void Run::stopRun()
     for( int igw = 0, ngw = vGW.size(); igw < ngw; ++igw )
         vGW[igw].stopFetching();
 
+    CmdServer::stopStreams();
+
 // Note: gate sends messages to trg, so must delete gate before trg.
 
     if( gate ) {
@@ -633,24 +1186,35 @@ void Run::stopRun()
         imReader = 0;
     }
 
-    if( niQ ) {
-        delete niQ;
-        niQ = 0;
-    }
+    CniCfg::setDOCaching( false );
 
-    for( int ip = 0, np = imQ.size(); ip < np; ++ip )
-        delete imQ[ip];
+// Park queues and filter stages, now without producer or
+// consumers, for the next run.
 
-    imQ.clear();
+    specKill();
+    erpKill();
+
+    for( int i = 0, n = flts.size(); i < n; ++i )
+        flts[i]->stop();
+
+    park.flts.swap( flts );
+    park.imQ.swap( imQ );
+    park.niQ    = niQ;
+    park.qKey   = qKey;
+    niQ         = 0;
 
 // Note: graphFetcher (e.g. putScans), gate and trg (e.g. setTriggerLED)
 // talk to graphsWindow. Therefore, we must wait for those threads to
-// complete before tearing graphsWindow down.
+// complete before parking graphsWindow.
 
     for( int igw = 0, ngw = vGW.size(); igw < ngw; ++igw )
-        vGW[igw].kill();
+        vGW[igw].park();
 
-    vGW.clear();
+    park.vGW.swap( vGW );
+    park.gKey = gKey;
+
+    if( qKey.isEmpty() )
+        park.killQueues();
 
     grfUpdateWindowTitles();
 
@@ -729,6 +1293,28 @@ void Run::grfSoftPause( bool pause, int igw )
     }
 }
 
+
+// Background windows refresh less often, if so optioned.
+// igw = -1 for all fetchers.
+//
+void Run::grfBkgndUpdate( int igw )
+{
+    QMutexLocker    ml( &runMtx );
+
+    bool    slow = app->isBkgndGrfSlow();
+
+    for( int jgw = 0, ngw = vGW.size(); jgw < ngw; ++jgw ) {
+
+        if( igw >= 0 && jgw != igw )
+            continue;
+
+        const GWPair    &P = vGW[jgw];
+
+        if( P.gw && P.gf )
+            P.gf->setBkgnd( slow && !P.gw->isActiveWindow() );
+    }
+}
+
 /* ---------------------------------------------------------------- */
 /* Owned Datafile ops --------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -853,7 +1439,9 @@ quint64 Run::dfGetFileStart( int ip ) const
 /* Owned gate and trigger ops ------------------------------------- */
 /* ---------------------------------------------------------------- */
 
-void Run::rgtSetGate( bool hi )
+// Edge time t (stream time) or if t < 0, now.
+//
+void Run::rgtSetGate( bool hi, double t )
 {
     QMutexLocker    ml( &runMtx );
 
@@ -862,12 +1450,14 @@ void Run::rgtSetGate( bool hi )
         DAQ::Params &p = app->cfgCtl()->acceptedParams;
 
         if( p.mode.mGate == DAQ::eGateTCP )
-            dynamic_cast<GateTCP*>(gate->worker)->rgtSetGate( hi );
+            dynamic_cast<GateTCP*>(gate->worker)->rgtSetGate( hi, t );
     }
 }
 
 
-void Run::rgtSetTrig( bool hi )
+// Edge time t (stream time) or if t < 0, now.
+//
+void Run::rgtSetTrig( bool hi, double t )
 {
     QMutexLocker    ml( &runMtx );
 
@@ -876,11 +1466,23 @@ void Run::rgtSetTrig( bool hi )
         DAQ::Params &p = app->cfgCtl()->acceptedParams;
 
         if( p.mode.mTrig == DAQ::eTrigTCP )
-            dynamic_cast<TrigTCP*>(trg->worker)->rgtSetTrig( hi );
+            dynamic_cast<TrigTCP*>(trg->worker)->rgtSetTrig( hi, t );
     }
 }
 
 
+// Map count ct of stream ip (-1=nidq) to stream time t,
+// with current stream time now, for count-stamped edges.
+// Return false if not running or no such stream.
+//
+bool Run::rgtMapCt( double &t, double &now, int ip, quint64 ct ) const
+{
+    QMutexLocker    ml( &runMtx );
+
+    return trg && trg->worker->mapStreamCt( t, now, ip, ct );
+}
+
+
 void Run::rgtSetMetaData( const KeyValMap &kvm )
 {
     QMutexLocker    ml( &runMtx );
@@ -967,3 +1569,223 @@ bool Run::aoStopDev()
 }
 
 
+// A stage per stream with neural channels: imec LF if
+// separate, else AP; nidq MN. Decimated to about SPEC_RATE.
+//
+void Run::specCreate( const DAQ::Params &p )
+{
+    QMutexLocker    ml( &specMtx );
+
+    for( int ip = 0, np = imQ.size(); ip < np; ++ip ) {
+
+        const CimCfg::AttrEach  &E = p.im.each[ip];
+
+        int     nAP     = E.imCumTypCnt[CimCfg::imSumAP],
+                nNu     = E.imCumTypCnt[CimCfg::imSumNeural],
+                c0      = (E.roTbl->nLF() ? nAP : 0),
+                cLim    = (E.roTbl->nLF() ? nNu : nAP);
+        double  ysc     = 1e6 * E.roTbl->maxVolts() / E.roTbl->maxInt();
+
+        if( cLim <= c0 )
+            continue;
+
+        std::vector<float>  uv( cLim - c0 );
+
+        for( int ic = c0; ic < cLim; ++ic )
+            uv[ic - c0] = ysc / E.chanGain( ic );
+
+        specs[ip] = new SpecStream(
+                        imQ[ip], c0, cLim,
+                        qMax( 1, int(E.srate / SPEC_RATE + 0.5) ), uv );
+    }
+
+    if( niQ ) {
+
+        int     nNu = p.ni.niCumTypCnt[CniCfg::niSumNeural];
+        double  ysc = 1e6 * p.ni.range.rmax / 32768;
+
+        if( nNu > 0 ) {
+
+            std::vector<float>  uv( nNu );
+
+            for( int ic = 0; ic < nNu; ++ic )
+                uv[ic] = ysc / p.ni.chanGain( ic );
+
+            specs[-1] = new SpecStream(
+                            niQ, 0, nNu,
+                            qMax( 1, int(p.ni.srate / SPEC_RATE + 0.5) ), uv );
+        }
+    }
+}
+
+
+// Stages read the queues, so go before they're parked.
+//
+void Run::specKill()
+{
+    QMutexLocker    ml( &specMtx );
+
+    QMap<int,SpecStream*>::iterator it  = specs.begin(),
+                                    end = specs.end();
+
+    for( ; it != end; ++it )
+        delete it.value();
+
+    specs.clear();
+}
+
+
+// Stages read the queues, so go before they're parked.
+//
+void Run::erpKill()
+{
+    QMutexLocker    ml( &erpMtx );
+
+    QMap<int,ErpStream*>::iterator  it  = erps.begin(),
+                                    end = erps.end();
+
+    for( ; it != end; ++it )
+        delete it.value();
+
+    erps.clear();
+}
+
+
+// Bytes/s of each stream, imec probes then nidq.
+//
+void Run::streamBps( QVector<double> &vBps, const DAQ::Params &p )
+{
+    vBps.clear();
+
+    for( int ip = 0, np = p.im.get_nProbes(); ip < np; ++ip ) {
+        const CimCfg::AttrEach  &E = p.im.each[ip];
+        vBps.push_back( 2.0 * E.srate * E.imCumTypCnt[CimCfg::imSumAll] );
+    }
+
+    if( p.ni.enabled )
+        vBps.push_back( 2.0 * p.ni.srate * p.ni.niCumTypCnt[CniCfg::niSumAll] );
+}
+
+
+// Trigger's added context secs, 0 if none.
+//
+double Run::trgContext( const DAQ::Params &p )
+{
+    if( p.mode.mTrig == DAQ::eTrigSpike )
+        return p.trgSpike.periEvtSecs;
+    else if( p.mode.mTrig == DAQ::eTrigTTL )
+        return p.trgTTL.marginSecs;
+
+    return 0;
+}
+
+
+// Params that fix the queues and filter stages: stream shapes,
+// trigger context (spill), history and memory options, and
+// filter bands. Empty (never reuse) for rings in shared memory,
+// which local readers find by name and expect to be made anew
+// each run.
+//
+QString Run::queueKey( const DAQ::Params &p )
+{
+    if( p.strm.memShared )
+        return QString();
+
+    QString s = QString("%1 %2 %3 %4 %5 %6 %7 %8 %9")
+                .arg( p.mode.mTrig )
+                .arg( p.mode.mTrig == DAQ::eTrigSpike ?
+                        p.trgSpike.periEvtSecs : p.trgTTL.marginSecs )
+                .arg( p.strm.histSecs )
+                .arg( p.strm.memFlags() )
+                .arg( p.im.all.fltLoHz ).arg( p.im.all.fltHiHz )
+                .arg( p.im.all.fltNotchHz ).arg( p.im.all.fltNotchN )
+                .arg( p.im.enabled );
+
+    s += QString(" %1 %2 %3 %4 %5 %6")
+            .arg( p.ni.fltLoHz ).arg( p.ni.fltHiHz )
+            .arg( p.ni.fltNotchHz ).arg( p.ni.fltNotchN )
+            .arg( p.ni.enabled )
+            .arg( p.strm.memBudgetGB );
+
+    if( p.strm.shankOrder ) {
+
+        s += " so";
+
+        for( int ip = 0, np = p.im.get_nProbes(); p.im.enabled && ip < np; ++ip )
+            s += " " + p.im.each[ip].sns.shankMap.toString();
+
+        if( p.ni.enabled )
+            s += " " + p.ni.sns.shankMap.toString();
+    }
+
+    if( p.im.enabled ) {
+
+        for( int ip = 0, np = p.im.get_nProbes(); ip < np; ++ip ) {
+
+            const CimCfg::AttrEach  &E = p.im.each[ip];
+
+            s += QString(" im%1 %2 %3 %4")
+                    .arg( ip ).arg( E.srate, 0, 'g', 12 )
+                    .arg( E.imCumTypCnt[CimCfg::imSumAP] )
+                    .arg( E.imCumTypCnt[CimCfg::imSumAll] );
+
+            if( E.roTbl )
+                s += QString(" %1").arg( E.roTbl->maxInt() );
+        }
+    }
+
+    if( p.ni.enabled ) {
+
+        s += QString(" ni %1 %2 %3")
+                .arg( p.ni.srate, 0, 'g', 12 )
+                .arg( p.ni.niCumTypCnt[CniCfg::niSumNeural] )
+                .arg( p.ni.niCumTypCnt[CniCfg::niSumAll] );
+    }
+
+    return s;
+}
+
+
+// Params that fix the graphs windows' views: stream shapes and
+// the maps and tables views are built from. Views read other
+// settings (save channels, trigger, filters) live from params.
+//
+QString Run::graphKey( const DAQ::Params &p )
+{
+    QString s = QString("%1 %2").arg( p.im.enabled ).arg( p.ni.enabled );
+
+    if( p.im.enabled ) {
+
+        for( int ip = 0, np = p.im.get_nProbes(); ip < np; ++ip ) {
+
+            const CimCfg::AttrEach  &E = p.im.each[ip];
+
+            s += QString("\nim%1 %2 %3 %4 %5")
+                    .arg( ip ).arg( E.srate, 0, 'g', 12 )
+                    .arg( E.imCumTypCnt[CimCfg::imSumAP] )
+                    .arg( E.imCumTypCnt[CimCfg::imSumNeural] )
+                    .arg( E.imCumTypCnt[CimCfg::imSumAll] );
+
+            if( E.roTbl )
+                s += "\n" + E.roTbl->toString();
+
+            s += "\n" + E.sns.shankMap.toString();
+            s += "\n" + E.sns.chanMap.toString();
+        }
+    }
+
+    if( p.ni.enabled ) {
+
+        s += QString("\nni %1").arg( p.ni.srate, 0, 'g', 12 );
+
+        for( int i = 0; i < CniCfg::niNTypes; ++i )
+            s += QString(" %1").arg( p.ni.niCumTypCnt[i] );
+
+        s += "\n" + p.ni.sns.shankMap.toString();
+        s += "\n" + p.ni.sns.chanMap.toString();
+    }
+
+    return s;
+}
+
+
@@ -4,6 +4,7 @@
 #include "KVParams.h"
 
 #include <QObject>
+#include <QMap>
 #include <QMutex>
 #include <QVector>
 
@@ -22,6 +23,12 @@ class NIReader;
 class Gate;
 class Trigger;
 class AIQ;
+class FltStream;
+class SpecStream;
+struct SpecSnap;
+class ErpStream;
+struct ErpParams;
+struct ErpSnap;
 
 class QFileInfo;
 
@@ -42,27 +49,59 @@ private:
         GWPair( const DAQ::Params &p, int igw );
 
         void createWindow( const DAQ::Params &p, int igw );
+        void reuseWindow( int igw );
         void setTitle( int igw );
+        void park();
         void kill();
         void startFetching( QMutex &runMtx );
         void stopFetching();
     };
 
+    // Pipeline of the last run, kept for the next run if its
+    // params give the same keys: queues and filter stages if
+    // qKey matches, graphs windows if gKey matches. Secs and
+    // spill are what the queues were made with.
+    struct Parked {
+        QVector<AIQ*>       imQ;
+        AIQ                 *niQ;
+        QVector<FltStream*> flts;
+        std::vector<GWPair> vGW;
+        QString             qKey,
+                            gKey;
+        QVector<double>     vSpill;
+        QVector<int>        vSecs;
+
+        Parked() : niQ(0)   {}
+
+        void killQueues();
+        void killGraphs();
+    };
+
 private:
     MainApp             *app;
     QVector<AIQ*>       imQ;            // guarded by runMtx
     AIQ*                niQ;            // guarded by runMtx
+    QVector<FltStream*> flts;           // guarded by runMtx
     std::vector<GWPair> vGW;            // guarded by runMtx
+    QMap<int,SpecStream*>   specs;      // guarded by specMtx
+    QMap<int,ErpStream*>    erps;       // guarded by erpMtx
     IMReader            *imReader;      // guarded by runMtx
     NIReader            *niReader;      // guarded by runMtx
     Gate                *gate;          // guarded by runMtx
     Trigger             *trg;           // guarded by runMtx
-    mutable QMutex      runMtx;
+    Parked              park;           // guarded by runMtx
+    QString             qKey,           // guarded by runMtx
+                        gKey;           // guarded by runMtx
+    mutable QMutex      runMtx,
+                        specMtx,
+                        erpMtx;
+    int                 erpNextId;      // guarded by erpMtx
     bool                running,        // guarded by runMtx
                         dumx[3];
 
 public:
     Run( MainApp *app );
+    virtual ~Run();
 
 // Owned GraphsWindow ops
     bool grfIsUsrOrder( int ip );
@@ -80,11 +119,26 @@ public:
 
 // Owned AIStream ops
     int streamSpanMax( const DAQ::Params &p, bool warn = true );
+    double trgSpillSecs( const DAQ::Params &p );
+    void streamCapacity(
+        QVector<int>        &vSecs,
+        QVector<double>     &vSpill,
+        const DAQ::Params   &p,
+        bool                report = false );
+    bool trgSpillFits( double &GB, const DAQ::Params &p );
     quint64 getScanCount( int ip ) const;
     const AIQ* getImQ( uint ip ) const;
     const AIQ* getNiQ() const;
     double getStreamTime() const;
 
+// Spectral stage ops
+    bool specSnapshot( SpecSnap &S, int ip, double updtSecs = 0 ) const;
+
+// Trial averaging stage ops
+    int erpStart( QString &err, int evIp, int ip, const ErpParams &P );
+    bool erpSnapshot( ErpSnap &S, int id, bool reset );
+    bool erpStop( int id );
+
 // Run control
     bool isRunning() const;
     bool startRun( QString &errTitle, QString &errMsg );
@@ -95,6 +149,7 @@ public:
 public slots:
 // GraphFetcher ops
     void grfSoftPause( bool pause, int igw );
+    void grfBkgndUpdate( int igw = -1 );
 
 // Owned Datafile ops
     bool dfIsSaving() const;
@@ -109,8 +164,9 @@ public slots:
     quint64 dfGetFileStart( int ip ) const;
 
 // Owned gate and trigger ops
-    void rgtSetGate( bool hi );
-    void rgtSetTrig( bool hi );
+    void rgtSetGate( bool hi, double t = -1 );
+    void rgtSetTrig( bool hi, double t = -1 );
+    bool rgtMapCt( double &t, double &now, int ip, quint64 ct ) const;
     void rgtSetMetaData( const KeyValMap &kvm );
 
 // Audio ops
@@ -125,6 +181,13 @@ private:
     void aoStartDev();
     bool aoStopDev();
     void createGraphsWindow( const DAQ::Params &p );
+    void specCreate( const DAQ::Params &p );
+    void specKill();
+    void erpKill();
+    static void streamBps( QVector<double> &vBps, const DAQ::Params &p );
+    static double trgContext( const DAQ::Params &p );
+    static QString queueKey( const DAQ::Params &p );
+    static QString graphKey( const DAQ::Params &p );
 };
 
 #endif  // RUN_H
@@ -0,0 +1,40 @@
+
+#include "SimPulser.h"
+
+
+/* ---------------------------------------------------------------- */
+/* SimPulser ------------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+// Jitter is clamped below a quarter period so edges keep order.
+//
+void SimPulser::init(
+    double  tZero,
+    double  srate,
+    double  ppm,
+    double  period,
+    double  jitterSecs,
+    quint64 key )
+{
+    t0          = tZero;
+    rate        = srate * (1.0 + 1e-6 * ppm);
+    half        = 0.5 * (period > 0 ? period : 1.0);
+    jit         = qBound( 0.0, jitterSecs, 0.5 * half );
+    this->key   = key;
+}
+
+
+// Offset of half-period edge h, in [-jit, jit].
+//
+double SimPulser::edgeJit( qint64 h ) const
+{
+    quint64 x = key + quint64(h) + 0x9E3779B97F4A7C15ULL;
+
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    x = x ^ (x >> 31);
+
+    return jit * (2.0 * (x >> 11) / double(1ULL << 53) - 1.0);
+}
+
+
@@ -0,0 +1,71 @@
+#ifndef SIMPULSER_H
+#define SIMPULSER_H
+
+#include <QtGlobal>
+
+#include <math.h>
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Sync pulser as seen by one simulated stream.
+//
+// A single square wave (period, 50% duty) runs on the shared
+// wall clock (getTime), as a real pulser would. Each stream
+// samples it through its own clock: sample s is taken at true
+// time tZero + s/rate, where rate is the nominal rate skewed by
+// the stream's drift (ppm). So streams drift apart exactly as
+// hardware would, and Sync/CalSRate have real work to do.
+//
+// Optional jitter offsets each edge independently by up to
+// +/- jitter seconds, pseudo-randomly but reproducibly (key).
+//
+class SimPulser
+{
+private:
+    double  t0,
+            rate,
+            half,
+            jit;
+    quint64 key;
+
+public:
+    SimPulser() : t0(0), rate(1), half(0.5), jit(0), key(0) {}
+
+    void init(
+        double  tZero,
+        double  srate,
+        double  ppm,
+        double  period,
+        double  jitterSecs,
+        quint64 key );
+
+    double clockRate() const    {return rate;}
+
+    // Pulser high at stream sample samp?
+    bool level( quint64 samp ) const
+    {
+        double  t = t0 + samp / rate;
+        qint64  h = qint64(floor( t / half ));
+
+        if( jit > 0 ) {
+
+            double  r = t - h * half;
+
+            if( r < jit && t < h * half + edgeJit( h ) )
+                --h;
+            else if( half - r < jit && t >= (h + 1) * half + edgeJit( h + 1 ) )
+                ++h;
+        }
+
+        return !(h & 1);
+    }
+
+private:
+    double edgeJit( qint64 h ) const;
+};
+
+#endif  // SIMPULSER_H
+
+
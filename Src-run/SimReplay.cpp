@@ -0,0 +1,200 @@
+
+#include "SimReplay.h"
+#include "Util.h"
+#include "DataFileIMAP.h"
+#include "DataFileNI.h"
+
+#include <QBitArray>
+#include <QThread>
+
+
+/* ---------------------------------------------------------------- */
+/* SimReplay ------------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+SimReplay::SimReplay()
+    :   QObject(0), df(0), thread(0), nextScan(0),
+        blkScans(0), nFile(0), nStrm(0), iHead(0), iTail(0),
+        nFull(0), taken(0), pleaseStop(false)
+{
+}
+
+
+// Lets any in-flight read finish, then joins.
+//
+SimReplay::~SimReplay()
+{
+    if( thread ) {
+
+        mtx.lock();
+            pleaseStop = true;
+            condFree.wakeAll();
+        mtx.unlock();
+
+        thread->wait();
+        delete thread;
+    }
+
+    if( df )
+        delete df;
+}
+
+
+// Open recording binPath (ip < 0 for nidq) to feed a stream
+// of nStreamChans at srate, and start prefetching.
+//
+// Return ok, else err.
+//
+bool SimReplay::open(
+    QString         &err,
+    const QString   &binPath,
+    int             ip,
+    int             nStreamChans,
+    double          srate )
+{
+    if( ip < 0 )
+        df = new DataFileNI;
+    else
+        df = new DataFileIMAP( ip );
+
+    if( !df->openForRead( binPath, err ) )
+        return false;
+
+    if( !df->scanCount() ) {
+        err = QString("Replay file '%1' is empty.").arg( binPath );
+        return false;
+    }
+
+// Map saved channels to their acquisition positions
+
+    const QVector<uint> &ids = df->channelIDs();
+
+    nFile   = df->numChans();
+    nStrm   = nStreamChans;
+
+    strm2file.fill( -1, nStrm );
+
+    for( int k = 0; k < nFile; ++k ) {
+
+        if( int(ids[k]) < nStrm )
+            strm2file[ids[k]] = k;
+    }
+
+    if( qAbs( df->samplingRateHz() - srate ) > 0.01 * srate ) {
+        Warning() <<
+            QString("Replay file rate %1 differs from stream rate %2.")
+            .arg( df->samplingRateHz(), 0, 'f', 2 )
+            .arg( srate, 0, 'f', 2 );
+    }
+
+    blkScans = qMax( 1, int(srate / 10) );
+
+    Log() << QString("Replaying '%1'.").arg( binPath );
+
+    thread = new QThread;
+    moveToThread( thread );
+    Connect( thread, SIGNAL(started()), this, SLOT(run()) );
+    thread->start();
+
+    return true;
+}
+
+
+// Copy up to maxScans scans into dst, in stream order.
+// Waits briefly only if nothing is ready.
+//
+// Return scan count.
+//
+int SimReplay::get( qint16 *dst, int maxScans )
+{
+    QMutexLocker    ml( &mtx );
+
+    int nGot = 0;
+
+    while( nGot < maxScans ) {
+
+        if( !nFull ) {
+
+            if( nGot )
+                break;
+
+            condFull.wait( &mtx, 100 );
+
+            if( !nFull )
+                break;
+        }
+
+        // Head block is ours until nFull decremented
+
+        Blk             &B  = blks[iHead];
+        const qint16    *src = &B.D[taken * nFile];
+        int             n    = qMin( B.nScans - taken, maxScans - nGot );
+
+        ml.unlock();
+
+            for( int s = 0; s < n; ++s, src += nFile, dst += nStrm ) {
+
+                for( int c = 0; c < nStrm; ++c ) {
+
+                    int k = strm2file[c];
+
+                    dst[c] = (k >= 0 ? src[k] : 0);
+                }
+            }
+
+        ml.relock();
+
+        taken   += n;
+        nGot    += n;
+
+        if( taken >= B.nScans ) {
+            taken   = 0;
+            iHead   = (iHead + 1) % NBLK;
+            --nFull;
+            condFree.wakeAll();
+        }
+    }
+
+    return nGot;
+}
+
+
+void SimReplay::run()
+{
+    QBitArray   keepAll;
+
+    mtx.lock();
+
+    for(;;) {
+
+        while( nFull >= NBLK && !pleaseStop )
+            condFree.wait( &mtx );
+
+        if( pleaseStop )
+            break;
+
+        Blk &B = blks[iTail];
+
+        mtx.unlock();
+            qint64  n = df->readScans( B.D, nextScan, blkScans, keepAll );
+        mtx.lock();
+
+        if( n <= 0 )
+            break;
+
+        nextScan += n;
+
+        if( nextScan >= df->scanCount() )
+            nextScan = 0;
+
+        B.nScans    = n;
+        iTail       = (iTail + 1) % NBLK;
+        ++nFull;
+        condFull.wakeAll();
+    }
+
+    mtx.unlock();
+    thread->quit();
+}
+
+
@@ -0,0 +1,76 @@
+#ifndef SIMREPLAY_H
+#define SIMREPLAY_H
+
+#include "SGLTypes.h"
+
+#include <QObject>
+#include <QMutex>
+#include <QWaitCondition>
+
+class DataFile;
+
+class QThread;
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// File-replay source for simulated streams.
+//
+// A reader thread prefetches scans from a recorded .bin
+// (DataFile::readScans) into a small ring of blocks; the
+// acquisition thread takes them with get(), remapped from
+// saved-channel order into full stream order. Stream channels
+// not in the file read as zero. Replay loops at end of file.
+//
+class SimReplay : public QObject
+{
+    Q_OBJECT
+
+private:
+    enum {
+        NBLK    = 8
+    };
+
+    struct Blk {
+        vec_i16 D;
+        int     nScans;
+    };
+
+    DataFile        *df;
+    QThread         *thread;
+    Blk             blks[NBLK];
+    QVector<int>    strm2file;  // stream chan -> file chan or -1
+    QMutex          mtx;
+    QWaitCondition  condFree,
+                    condFull;
+    quint64         nextScan;
+    int             blkScans,
+                    nFile,
+                    nStrm,
+                    iHead,      // next block to consume
+                    iTail,      // next block to fill
+                    nFull,      // guarded by mtx
+                    taken;      // scans used from head block
+    bool            pleaseStop; // guarded by mtx
+
+public:
+    SimReplay();
+    virtual ~SimReplay();
+
+    bool open(
+        QString         &err,
+        const QString   &binPath,
+        int             ip,
+        int             nStreamChans,
+        double          srate );
+
+    int get( qint16 *dst, int maxScans );
+
+public slots:
+    void run();
+};
+
+#endif  // SIMREPLAY_H
+
+
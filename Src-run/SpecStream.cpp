@@ -0,0 +1,313 @@
+#include "SpecStream.h"
+#include "Util.h"
+#include "AIQ.h"
+#include "Biquad.h"
+#include "Subset.h"
+
+#include <QThread>
+
+#include <math.h>
+
+
+#define SPEC_NFFT       1024
+#define SPEC_IDLESECS   5.0
+#define SPEC_MAXSECS    0.05    // src scans per fetch
+#define SPEC_GRPCHANS   32      // per pool job
+
+
+/* ---------------------------------------------------------------- */
+/* SpecSnap ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Power (uV^2) of chan ic in bins [loHz,hiHz].
+//
+double SpecSnap::bandPower( int ic, double loHz, double hiHz ) const
+{
+    if( ic < 0 || ic >= nCh || binHz <= 0 )
+        return 0;
+
+    const float *p  = chan( ic );
+    int         k0  = qMax( 0, int(ceil( loHz / binHz )) ),
+                kL  = qMin( nBins - 1, int(hiHz / binHz) );
+    double      sum = 0;
+
+    for( int k = k0; k <= kL; ++k )
+        sum += p[k];
+
+    return sum * binHz;
+}
+
+
+// Peak density within 2 Hz of line frequency hz, as dB above
+// the mean density 5 to 15 Hz either side of it.
+//
+double SpecSnap::lineDb( int ic, double hz ) const
+{
+    if( ic < 0 || ic >= nCh || binHz <= 0 )
+        return 0;
+
+    const float *p      = chan( ic );
+    double      pk      = 0,
+                ref     = 0;
+    int         nref    = 0;
+
+    for( int k = 1; k < nBins; ++k ) {
+
+        double  d = fabs( k * binHz - hz );
+
+        if( d <= 2 )
+            pk = qMax( pk, double(p[k]) );
+        else if( d >= 5 && d <= 15 ) {
+            ref += p[k];
+            ++nref;
+        }
+    }
+
+    if( !nref || ref <= 0 || pk <= 0 )
+        return 0;
+
+    return 10 * log10( pk * nref / ref );
+}
+
+/* ---------------------------------------------------------------- */
+/* SpecStream ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+SpecStream::SpecStream(
+    const AIQ                   *src,
+    int                         c0,
+    int                         cLim,
+    int                         dnsmp,
+    const std::vector<float>    &uvPerCnt )
+    :   QObject(0), src(src), thread(0),
+        W(SPEC_NFFT, src->sRate() / dnsmp),
+        dec(dnsmp, cLim - c0), uvPer(uvPerCnt),
+        tAcc(0), tReadUs(0), updtMs(1000),
+        c0(c0), cLim(cLim), nSeg(0), nFill(0), pleaseStop(false)
+{
+    int nC = cLim - c0;
+
+    seg.assign( nC * W.nFFT(), 0.0F );
+    acc.assign( nC * W.nBins(), 0.0 );
+
+    rdrId = src->readerId( "spectra" );
+
+    thread = new QThread;
+    moveToThread( thread );
+    Connect( thread, SIGNAL(started()), this, SLOT(run()) );
+    thread->start();
+}
+
+
+SpecStream::~SpecStream()
+{
+    pleaseStop = true;
+
+    thread->wait();
+    delete thread;
+}
+
+
+void SpecStream::setUpdtSecs( double secs )
+{
+    updtMs = qBound( 100, int(1000 * secs), 60000 );
+}
+
+
+// Copy latest spectra, returning false if none yet.
+// Reading keeps (or gets) the stage working.
+//
+bool SpecStream::snapshot( SpecSnap &S ) const
+{
+    tReadUs = quint64(1e6 * getTime());
+
+    QMutexLocker    ml( &snapMtx );
+
+    if( !snap.gen )
+        return false;
+
+    S = snap;
+    return true;
+}
+
+
+void SpecStream::run()
+{
+    vec_i16 data,
+            sub,
+            out;
+    quint64 nextCt  = 0;
+    int     nC      = src->nChans(),
+            nMax    = qMax( 1, int(SPEC_MAXSECS * src->sRate()) );
+    bool    active  = false;
+
+    while( !pleaseStop ) {
+
+        quint64 endCt = src->endCount();
+
+        if( 1e-6 * tReadUs.load() < getTime() - SPEC_IDLESECS ) {
+
+            if( active ) {
+                idle();
+                active = false;
+            }
+
+            nextCt = endCt;
+            src->readerAt( rdrId, nextCt );
+            QThread::usleep( 1000 * 50 );
+            continue;
+        }
+
+        if( !active ) {
+            nextCt  = endCt;
+            tAcc    = getTime();
+            active  = true;
+        }
+
+        if( endCt <= nextCt ) {
+            QThread::usleep( 1000 * 5 );
+            continue;
+        }
+
+        int n = int(qMin( endCt - nextCt, quint64(nMax) ));
+
+        data.clear();
+
+        if( 1 != src->getNScansFromCt( data, nextCt, n )
+            || (int)data.size() != n * nC ) {
+
+            // Lapped: restart segments at head
+
+            idle();
+            nextCt = endCt;
+            continue;
+        }
+
+        Subset::subsetBlock( sub, data, c0, cLim, nC );
+
+        int nOut = dec.apply( out, &sub[0], n );
+
+        if( nOut )
+            addScans( &out[0], nOut );
+
+        nextCt += n;
+        src->readerAt( rdrId, nextCt );
+
+        if( nSeg && getTime() - tAcc >= 0.001 * updtMs )
+            publish();
+    }
+
+    thread->quit();
+}
+
+
+// Append n decimated scans to the segment; transform each
+// time it fills, then slide it half a segment.
+//
+void SpecStream::addScans( const qint16 *d, int n )
+{
+    const int   nC  = cLim - c0,
+                N   = W.nFFT();
+    float       *S  = &seg[0];
+
+    for( int it = 0; it < n; ++it, d += nC ) {
+
+        for( int ic = 0; ic < nC; ++ic )
+            S[ic * N + nFill] = d[ic] * uvPer[ic];
+
+        if( ++nFill < N )
+            continue;
+
+        transform();
+
+        for( int ic = 0; ic < nC; ++ic )
+            memmove( &S[ic * N], &S[ic * N + N/2], N/2 * sizeof(float) );
+
+        nFill = N/2;
+    }
+}
+
+
+// Periodograms of the current segment, channel groups on
+// the pool; pairs of channels stay together (see WelchPSD).
+//
+void SpecStream::transform()
+{
+    const int   nC      = cLim - c0;
+    int         nThd    = qBound(
+                            1, nC / SPEC_GRPCHANS,
+                            BiquadPool::pool().nWorkers() + 1 );
+
+    if( nThd > 1 ) {
+
+        std::vector<BiquadJob>  jobs( nThd );
+        int                     remain = nThd;
+
+        for( int i = 0; i < nThd; ++i ) {
+
+            BiquadJob   &B = jobs[i];
+
+            B.fn        = segJob;
+            B.ctx       = this;
+            B.i0        = (i * nC / nThd) & ~1;
+            B.iLim      = (i + 1 < nThd ? ((i + 1) * nC / nThd) & ~1 : nC);
+            B.remain    = &remain;
+        }
+
+        BiquadPool::pool().runBatch( jobs );
+    }
+    else
+        W.addSegs( &acc[0], &seg[0], W.nFFT(), nC );
+
+    ++nSeg;
+}
+
+
+void SpecStream::segJob( const BiquadJob &J )
+{
+    SpecStream  *S = (SpecStream*)J.ctx;
+
+    S->W.addSegs(
+        &S->acc[J.i0 * S->W.nBins()],
+        &S->seg[J.i0 * S->W.nFFT()],
+        S->W.nFFT(), J.iLim - J.i0 );
+}
+
+
+void SpecStream::publish()
+{
+    double  d   = W.density( nSeg );
+    int     nB  = W.nBins();
+
+    snapMtx.lock();
+
+        snap.P.resize( acc.size() );
+
+        for( int i = 0, n = acc.size(); i < n; ++i )
+            snap.P[i] = float(d * acc[i]);
+
+        snap.binHz  = W.binHz();
+        snap.tUpdt  = getTime();
+        snap.nCh    = cLim - c0;
+        snap.nBins  = nB;
+        ++snap.gen;
+
+    snapMtx.unlock();
+
+    std::fill( acc.begin(), acc.end(), 0.0 );
+    nSeg    = 0;
+    tAcc    = snap.tUpdt;
+}
+
+
+// Drop partial work; the next segment starts fresh.
+//
+void SpecStream::idle()
+{
+    std::fill( acc.begin(), acc.end(), 0.0 );
+    dec.clearMem();
+    nSeg    = 0;
+    nFill   = 0;
+}
+
+
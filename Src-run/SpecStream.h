@@ -0,0 +1,102 @@
+#ifndef SPECSTREAM_H
+#define SPECSTREAM_H
+
+#include "Decimator.h"
+#include "WelchPSD.h"
+
+#include <QObject>
+#include <QMutex>
+
+#include <atomic>
+
+class AIQ;
+struct BiquadJob;
+
+class QThread;
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// A published set of spectra: nBins values per channel, uV^2/Hz.
+//
+struct SpecSnap {
+    std::vector<float>  P;
+    double              binHz,
+                        tUpdt;  // getTime() of publish
+    quint64             gen;    // bumped per publish
+    int                 nCh,
+                        nBins;
+
+    SpecSnap() : binHz(0), tUpdt(0), gen(0), nCh(0), nBins(0)  {}
+
+    const float *chan( int ic ) const   {return &P[ic * nBins];}
+    double bandPower( int ic, double loHz, double hiHz ) const;
+    double lineDb( int ic, double hz ) const;
+};
+
+
+// Live spectra of one stream.
+//
+// A worker follows source AIQ src from its head, decimates
+// channels [c0,cLim) by dnsmp (anti-aliased, see Decimator),
+// and computes Welch PSDs of all of them: Hann segments of
+// SPEC_NFFT decimated samples, half overlapped. Segments are
+// transformed in channel groups on the BiquadPool workers.
+// Every updtSecs the average so far is published: snapshot()
+// copies the latest.
+//
+// The stage only works while read: if no snapshot() is taken
+// for SPEC_IDLESECS it drops what it has and just keeps pace
+// with src until asked again.
+//
+class SpecStream : public QObject
+{
+    Q_OBJECT
+
+private:
+    const AIQ           *src;
+    QThread             *thread;
+    WelchPSD            W;
+    Decimator           dec;
+    std::vector<float>  uvPer,      // per chan uV per count
+                        seg;        // nCh * nfft, chan-major
+    std::vector<double> acc;        // nCh * nBins
+    SpecSnap            snap;
+    mutable QMutex      snapMtx;
+    double              tAcc;
+    mutable std::atomic<quint64>    tReadUs;
+    std::atomic<int>    updtMs;
+    const int           c0,
+                        cLim;
+    int                 rdrId,
+                        nSeg,
+                        nFill;
+    std::atomic<bool>   pleaseStop;
+
+public:
+    SpecStream(
+        const AIQ                   *src,
+        int                         c0,
+        int                         cLim,
+        int                         dnsmp,
+        const std::vector<float>    &uvPerCnt );
+    virtual ~SpecStream();
+
+    void setUpdtSecs( double secs );
+    bool snapshot( SpecSnap &S ) const;
+
+public slots:
+    void run();
+
+private:
+    void addScans( const qint16 *d, int n );
+    void transform();
+    void publish();
+    void idle();
+    static void segJob( const BiquadJob &J );
+};
+
+#endif  // SPECSTREAM_H
+
+
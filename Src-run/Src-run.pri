@@ -9,13 +9,20 @@ HEADERS += \
     $$PWD/CniAcq.h \
     $$PWD/CniAcqDmx.h \
     $$PWD/CniAcqSim.h \
+    $$PWD/ErpStream.h \
+    $$PWD/FltStream.h \
     $$PWD/IMBISTCtl.h \
     $$PWD/IMFirmCtl.h \
     $$PWD/IMHSTCtl.h \
     $$PWD/IMReader.h \
+    $$PWD/ImTelemetry.h \
     $$PWD/NIReader.h \
     $$PWD/Run.h \
-    $$PWD/Sync.h
+    $$PWD/SimPulser.h \
+    $$PWD/SimReplay.h \
+    $$PWD/SpecStream.h \
+    $$PWD/Sync.h \
+    $$PWD/ThdPlace.h
 
 SOURCES += \
     $$PWD/AIQ.cpp \
@@ -25,12 +32,19 @@ SOURCES += \
     $$PWD/CimAcqSim.cpp \
     $$PWD/CniAcqDmx.cpp \
     $$PWD/CniAcqSim.cpp \
+    $$PWD/ErpStream.cpp \
+    $$PWD/FltStream.cpp \
     $$PWD/IMBISTCtl.cpp \
     $$PWD/IMFirmCtl.cpp \
     $$PWD/IMHSTCtl.cpp \
     $$PWD/IMReader.cpp \
+    $$PWD/ImTelemetry.cpp \
     $$PWD/NIReader.cpp \
     $$PWD/Run.cpp \
-    $$PWD/Sync.cpp
+    $$PWD/SimPulser.cpp \
+    $$PWD/SimReplay.cpp \
+    $$PWD/SpecStream.cpp \
+    $$PWD/Sync.cpp \
+    $$PWD/ThdPlace.cpp
 
 
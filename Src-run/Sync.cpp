@@ -33,6 +33,16 @@ void SyncStream::init( const AIQ *Q, int ip, const DAQ::Params &p )
             thresh  = p.ni.vToInt16( p.sync.niThresh, chan );
         }
     }
+
+// Edge searches read contiguous tap rather than whole scans;
+// edges are also indexed as they arrive, so cross-stream
+// mapping is normally a table lookup.
+
+    if( p.sync.sourceIdx != DAQ::eSyncSourceNone ) {
+        Q->addTap( chan );
+        Q->enableSyncIndex(
+            chan, bit, (bit < 0 ? thresh : 0), p.sync.sourcePeriod );
+    }
 }
 
 
@@ -45,12 +55,42 @@ bool SyncStream::findEdge(
 
     fromCt -= (fromCt >= stepBack ? stepBack : fromCt);
 
+    if( Q->syncEdgeFrom( outCt, fromCt ) )
+        return true;
+
+// If the index spans fromCt, no edge has arrived yet,
+// and rescanning the data would find nothing more.
+
+    if( Q->syncIndexCovers( fromCt ) )
+        return false;
+
     if( bit < 0 )
         return Q->findRisingEdge( outCt, fromCt, chan, thresh, 100 );
     else
         return Q->findBitRisingEdge( outCt, fromCt, chan, bit, 100 );
 }
 
+// Latest edge at or before atCt, no more than 1.5 periods back.
+//
+bool SyncStream::findEdgeBefore(
+    quint64             &outCt,
+    quint64             atCt,
+    const DAQ::Params   &p ) const
+{
+    quint64 perCt = TRel2Ct( p.sync.sourcePeriod );
+
+    if( Q->syncEdgeBefore( outCt, atCt ) && atCt - outCt <= 1.5 * perCt )
+        return true;
+
+    if( !findEdge( outCt, atCt, p ) )
+        return false;
+
+    while( outCt > atCt )
+        outCt -= perCt;
+
+    return true;
+}
+
 /* ---------------------------------------------------------------- */
 /* Functions ------------------------------------------------------ */
 /* ---------------------------------------------------------------- */
@@ -68,7 +108,7 @@ double syncDstTAbs(
     src->tAbs = srcTAbs;
 
     if( p.sync.sourceIdx == DAQ::eSyncSourceNone
-        || !src->findEdge( srcEdge, srcCt, p )
+        || !src->findEdgeBefore( srcEdge, srcCt, p )
         || !dst->findEdge( dstEdge, dst->TAbs2Ct( srcTAbs ), p ) ) {
 
         dst->tAbs   = srcTAbs;
@@ -79,13 +119,6 @@ double syncDstTAbs(
 
     double dstTAbs, halfPer;
 
-    if( srcEdge > srcCt ) {
-        quint64 perCt = src->TRel2Ct( p.sync.sourcePeriod );
-        do {
-            srcEdge -= perCt;
-        } while( srcEdge > srcCt );
-    }
-
     dstTAbs = dst->Ct2TAbs( dstEdge ) + src->Ct2TRel( srcCt - srcEdge );
     halfPer = 0.5 * p.sync.sourcePeriod;
 
@@ -124,7 +157,7 @@ void syncDstTAbsMult(
         return;
 
     if( p.sync.sourceIdx == DAQ::eSyncSourceNone
-        || !src.findEdge( srcEdge, srcCt, p ) ) {
+        || !src.findEdgeBefore( srcEdge, srcCt, p ) ) {
 
         for( int is = 0; is < nS; ++is ) {
 
@@ -156,13 +189,6 @@ void syncDstTAbsMult(
 
             double dstTAbs, halfPer;
 
-            if( srcEdge > srcCt ) {
-                quint64 perCt = src.TRel2Ct( p.sync.sourcePeriod );
-                do {
-                    srcEdge -= perCt;
-                } while( srcEdge > srcCt );
-            }
-
             dstTAbs = dst.Ct2TAbs( dstEdge )
                         + src.Ct2TRel( srcCt - srcEdge );
             halfPer = 0.5 * p.sync.sourcePeriod;
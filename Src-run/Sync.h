@@ -40,6 +40,11 @@ struct SyncStream
         quint64             &outCt,
         quint64             fromCt,
         const DAQ::Params   &p ) const;
+
+    bool findEdgeBefore(
+        quint64             &outCt,
+        quint64             atCt,
+        const DAQ::Params   &p ) const;
 };
 
 /* ---------------------------------------------------------------- */
@@ -0,0 +1,235 @@
+
+#include "ThdPlace.h"
+#include "Util.h"
+#include "Trace.h"
+
+#include <QThread>
+
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+QMutex          ThdPlace::mtx;
+ThdPlace::Rule  ThdPlace::rules[ThdPlace::NROLE];
+int             ThdPlace::nInst[ThdPlace::NROLE];
+
+
+static const char *prioName[] = {
+    "idle", "lowest", "low", "normal", "high", "highest", "rt"
+};
+
+
+// Return QThread::Priority, or -1 if unknown.
+//
+static int str2Prio( const QString &s )
+{
+    if( s == "idle" )       return QThread::IdlePriority;
+    if( s == "low" )        return QThread::LowPriority;
+    if( s == "normal" )     return QThread::NormalPriority;
+    if( s == "high" )       return QThread::HighPriority;
+    if( s == "highest" )    return QThread::HighestPriority;
+    if( s == "rt" )         return QThread::TimeCriticalPriority;
+
+    return -1;
+}
+
+/* ---------------------------------------------------------------- */
+/* ThdPlace ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+const char *ThdPlace::roleName( int role )
+{
+    static const char *name[NROLE] = {
+        "imfetch", "ni", "trig", "trigwrk",
+        "write", "graph", "audio", "cmd"
+    };
+
+    return (role >= 0 && role < NROLE ? name[role] : "?");
+}
+
+
+// Call at run start, before pipeline threads start.
+//
+void ThdPlace::configure( const QString &policy )
+{
+    Rule    R[NROLE];
+    QString err;
+
+    if( !parse( err, R, policy ) )
+        Warning() << "Thread placement (strmThdPlace): " << err;
+
+    QMutexLocker    ml( &mtx );
+
+    for( int i = 0; i < NROLE; ++i ) {
+        rules[i] = R[i];
+        nInst[i] = 0;
+    }
+
+    if( !policy.trimmed().isEmpty() )
+        Log() << "Thread placement: " << metaStr( policy );
+}
+
+
+// Call from the starting thread. Name defaults to role
+// and instance number.
+//
+void ThdPlace::apply( Role role, const QString &name )
+{
+    mtx.lock();
+        int     inst    = nInst[role]++;
+        Rule    R       = rules[role];
+    mtx.unlock();
+
+    QString nm = (name.isEmpty() ?
+                    QString("%1 %2").arg( roleName( role ) ).arg( inst ) :
+                    name);
+
+    Trace::nameThread( nm );
+    QThread::currentThread()->setObjectName( nm );
+
+    if( !R.set )
+        return;
+
+    uint    mask = R.mask;
+
+    if( !mask && R.cores.size() ) {
+
+        int c = R.cores[inst % R.cores.size()];
+
+        if( c < 32 )
+            mask = 1u << c;
+    }
+
+    if( mask && !setCurrentThreadAffinityMask( mask ) ) {
+        Warning() <<
+            QString("Thread '%1' could not set affinity 0x%2.")
+            .arg( nm ).arg( mask, 0, 16 );
+    }
+
+    if( R.prio >= 0 )
+        QThread::currentThread()->setPriority( QThread::Priority(R.prio) );
+
+    Debug() <<
+        QString("Thread '%1' placed: %2.").arg( nm ).arg( ruleStr( R ) );
+}
+
+
+// Resolved policy, e.g. "trig=0x4/high;write=0xf0", or empty.
+//
+QString ThdPlace::metaStr( const QString &policy )
+{
+    Rule        R[NROLE];
+    QString     err;
+    QStringList sl;
+
+    parse( err, R, policy );
+
+    for( int i = 0; i < NROLE; ++i ) {
+
+        if( R[i].set )
+            sl.append( QString("%1=%2").arg( roleName( i ) ).arg( ruleStr( R[i] ) ) );
+    }
+
+    return sl.join( ";" );
+}
+
+
+// Parse what's valid; return false with err naming the
+// first bad entry.
+//
+bool ThdPlace::parse( QString &err, Rule *R, const QString &policy )
+{
+    QStringList entries = policy.split( ";", QString::SkipEmptyParts );
+
+    foreach( const QString &e, entries ) {
+
+        QStringList kv = e.trimmed().split( "=" );
+
+        if( kv.size() != 2 ) {
+            if( !e.trimmed().isEmpty() && err.isEmpty() )
+                err = QString("bad entry '%1'.").arg( e.trimmed() );
+            continue;
+        }
+
+        QString key = kv[0].trimmed().toLower();
+        int     role;
+
+        for( role = 0; role < NROLE; ++role ) {
+            if( key == roleName( role ) )
+                break;
+        }
+
+        if( role >= NROLE ) {
+            if( err.isEmpty() )
+                err = QString("unknown role '%1'.").arg( key );
+            continue;
+        }
+
+        QStringList cp  = kv[1].trimmed().toLower().split( "/" );
+        QString     cs  = cp[0].trimmed();
+        Rule        r;
+        bool        ok  = true;
+
+        if( cp.size() > 1 ) {
+            r.prio  = str2Prio( cp[1].trimmed() );
+            ok      = r.prio >= 0;
+        }
+
+        if( !ok || cs == "*" || cs.isEmpty() )
+            ;   // no affinity change
+        else if( cs.startsWith( "n" ) ) {
+            r.mask  = getNumaNodeMask( cs.mid( 1 ).toInt( &ok ) );
+            ok      = ok && r.mask;
+        }
+        else {
+
+            QStringList sl = cs.split( ",", QString::SkipEmptyParts );
+
+            foreach( const QString &s, sl ) {
+
+                QStringList ab = s.split( "-" );
+                bool        okA, okB = true;
+                int         a = ab[0].toInt( &okA ),
+                            b = (ab.size() > 1 ? ab[1].toInt( &okB ) : a);
+
+                if( !okA || !okB || a < 0 || b < a || b >= 32 ) {
+                    ok = false;
+                    break;
+                }
+
+                for( int c = a; c <= b; ++c )
+                    r.cores.push_back( c );
+            }
+        }
+
+        if( !ok ) {
+            if( err.isEmpty() )
+                err = QString("bad entry '%1'.").arg( e.trimmed() );
+            continue;
+        }
+
+        r.set   = true;
+        R[role] = r;
+    }
+
+    return err.isEmpty();
+}
+
+
+QString ThdPlace::ruleStr( const Rule &R )
+{
+    uint    mask = R.mask;
+
+    for( int i = 0, n = R.cores.size(); i < n; ++i )
+        mask |= 1u << R.cores[i];
+
+    QString s = (mask ? QString("0x%1").arg( mask, 0, 16 ) : "*");
+
+    if( R.prio >= 0 && R.prio < 7 )
+        s += QString("/%1").arg( prioName[R.prio] );
+
+    return s;
+}
+
+
@@ -0,0 +1,74 @@
+#ifndef THDPLACE_H
+#define THDPLACE_H
+
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Run thread placement policy, daq.ini strmThdPlace:
+//
+//     role=cores[/prio]; role=cores[/prio]; ...
+//
+// role:  imfetch, ni, trig, trigwrk, write, graph, audio, cmd.
+// cores: list and ranges "2,4-6", each instance of the role
+//        pinned to the next in turn; or "n1" = any core of NUMA
+//        node 1; or "*" = leave affinity.
+// prio:  idle, low, normal, high, highest, rt.
+//
+// Example: "imfetch=4-7/rt; trig=2/high; write=n1; cmd=*/low"
+//
+// configure() parses at run start and resets instance counts.
+// Each pipeline thread calls apply( role ) as it starts, which
+// names it (trace track, thread object) and places it if the
+// role has a rule. Roles without a rule keep their placement
+// (e.g. imfetch otherwise follows imThdCores/imThdRTPrio).
+// The resolved policy is recorded in file metadata as
+// thdPlacement.
+//
+class ThdPlace
+{
+public:
+    enum Role {
+        roleIMFetch = 0,
+        roleNI      = 1,
+        roleTrig    = 2,
+        roleTrigWrk = 3,
+        roleWrite   = 4,
+        roleGraph   = 5,
+        roleAudio   = 6,
+        roleCmd     = 7,
+        NROLE       = 8
+    };
+
+private:
+    struct Rule {
+        QVector<int>    cores;  // cycled per instance
+        uint            mask;   // else whole mask (NUMA node)
+        int             prio;   // QThread::Priority, -1=keep
+        bool            set;
+        Rule() : mask(0), prio(-1), set(false)  {}
+    };
+
+    static QMutex   mtx;
+    static Rule     rules[NROLE];
+    static int      nInst[NROLE];
+
+public:
+    static const char *roleName( int role );
+
+    static void configure( const QString &policy );
+    static void apply( Role role, const QString &name = QString() );
+    static QString metaStr( const QString &policy );
+
+private:
+    static bool parse( QString &err, Rule *R, const QString &policy );
+    static QString ruleStr( const Rule &R );
+};
+
+#endif  // THDPLACE_H
+
+
@@ -0,0 +1,324 @@
+
+#include "NiAlign.h"
+#include "AIQ.h"
+#include "Subset.h"
+#include "Util.h"
+
+#include <QFileInfo>
+#include <QRegExp>
+
+#include <limits.h>
+
+
+// Most fractional departure of a block's mapped ratio from
+// nominal before it's taken for a sync glitch.
+#define NIALIGN_MAXDEV  0.01
+
+// Spare output frames per converter call.
+#define NIALIGN_SLACK   16
+
+/* ---------------------------------------------------------------- */
+/* NiAlign -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+NiAlign::NiAlign( int ip )
+    :   df(0), niQ(0), imQ(0), srcA(0), srcD(0), nomRatio(1),
+        ip(ip), nSav(0), nA(0), nD(0), pendA(0), pendD(0), started(false)
+{
+}
+
+
+NiAlign::~NiAlign()
+{
+    close( KeyValMap(), false );
+
+    if( srcA )
+        src_delete( srcA );
+
+    if( srcD )
+        src_delete( srcD );
+}
+
+
+bool NiAlign::isEnabled( const DAQ::Params &p )
+{
+    return !p.sns.niAlignChans.trimmed().isEmpty();
+}
+
+
+// Companion takes those of p.sns.niAlignChans (acq ids) that
+// dfNi saves; dfNi must be open for write.
+//
+// Return false if none, or on error.
+//
+bool NiAlign::open(
+    const DAQ::Params   &p,
+    const DataFileNI    &dfNi,
+    const AIQ           *niQ,
+    const AIQ           *imQ )
+{
+    this->niQ   = niQ;
+    this->imQ   = imQ;
+
+// Channels
+
+    QVector<uint>   want,
+                    idx;
+    QBitArray       b;
+
+    if( !Subset::rngStr2Vec( want, p.sns.niAlignChans ) ) {
+        Warning()
+            << "Bad nidq align channel list ["
+            << p.sns.niAlignChans << "].";
+        return false;
+    }
+
+    Subset::vec2Bits( b, want );
+
+    const QVector<uint> &ids    = dfNi.channelIDs();
+    int                 dig0    = p.ni.niCumTypCnt[CniCfg::niSumAnalog];
+
+    for( int j = 0, n = ids.size(); j < n; ++j ) {
+
+        int id = ids[j];
+
+        if( id < b.size() && b.testBit( id ) ) {
+
+            idx.push_back( j );
+
+            if( id < dig0 ) {
+                acqA.push_back( id );
+                savA.push_back( j );
+            }
+            else {
+                acqD.push_back( id );
+                savD.push_back( j );
+            }
+        }
+    }
+
+    nSav    = ids.size();
+    nA      = acqA.size();
+    nD      = acqD.size();
+
+    if( !idx.size() ) {
+        Warning()
+            << "No saved nidq channels among align channels ["
+            << p.sns.niAlignChans << "].";
+        return false;
+    }
+
+// Converters
+
+    int err = 0;
+
+    nomRatio = imQ->sRate() / niQ->sRate();
+
+    if( nA )
+        srcA = src_new( SRC_SINC_FASTEST, nA, &err );
+
+    if( !err && nD )
+        srcD = src_new( SRC_ZERO_ORDER_HOLD, nD, &err );
+
+    if( err ) {
+        Warning() << "nidq align error: " << src_strerror( err );
+        return false;
+    }
+
+// File
+
+    QRegExp re("bin$");
+    re.setCaseSensitivity( Qt::CaseInsensitive );
+
+    QString name = QString(dfNi.binFileName())
+                    .replace( re, QString("imec%1.bin").arg( ip ) );
+
+    df = new DataFileNI;
+
+    if( !df->openForExport( dfNi, name, idx ) ) {
+        delete df;
+        df = 0;
+        return false;
+    }
+
+    df->setSampleRate( imQ->sRate() );
+    df->setParam( "niAlignStream", QString("imec%1").arg( ip ) );
+    df->setParam( "niAlignSrcFile", QFileInfo( dfNi.binFileName() ).fileName() );
+
+    return true;
+}
+
+
+// Resample a block of nidq scans starting at headCt, either
+// whole (acquired) or saved-channel scans. Blocks of one file
+// follow each other without gaps.
+//
+bool NiAlign::write( const vec_i16 &data, quint64 headCt, bool saved )
+{
+    const int   *cA     = (nA ? (saved ? &savA[0] : &acqA[0]) : 0),
+                *cD     = (nD ? (saved ? &savD[0] : &acqD[0]) : 0);
+    int         nC      = (saved ? nSav : niQ->nChans()),
+                ntpts   = data.size() / nC;
+
+    if( !df || !ntpts )
+        return true;
+
+// Ratio over block: mapped span / length
+
+    double  c0      = imCtAt( headCt ),
+            ratio   = (imCtAt( headCt + ntpts ) - c0) / ntpts;
+
+    if( !started ) {
+        df->setFirstSample( quint64(qMax( 0.0, c0 + 0.5 )) );
+        started = true;
+    }
+
+    if( qAbs( ratio / nomRatio - 1.0 ) > NIALIGN_MAXDEV )
+        ratio = nomRatio;
+
+// Gather columns
+
+    inA.resize( ntpts * nA );
+    inD.resize( ntpts * nD );
+
+    const qint16    *S = &data[0];
+    float           *A = (nA ? &inA[0] : 0),
+                    *D = (nD ? &inD[0] : 0);
+
+    for( int it = 0; it < ntpts; ++it, S += nC ) {
+
+        for( int j = 0; j < nA; ++j )
+            *A++ = S[cA[j]] / 32768.0F;
+
+        for( int j = 0; j < nD; ++j )
+            *D++ = S[cD[j]] / 32768.0F;
+    }
+
+// Convert
+
+    if( nA && !convert( srcA, inA, outA, pendA, nA, ntpts, ratio ) )
+        return false;
+
+    if( nD && !convert( srcD, inD, outD, pendD, nD, ntpts, ratio ) )
+        return false;
+
+    return putScans();
+}
+
+
+// Queued data aren't flushed through the converters; the file
+// ends with the last scan both have produced.
+//
+void NiAlign::close( const KeyValMap &kvm, bool async )
+{
+    if( !df )
+        return;
+
+    if( async )
+        df->closeAsync( kvm );
+    else {
+        df->setRemoteParams( kvm );
+        df->closeAndFinalize();
+        delete df;
+    }
+
+    df = 0;
+}
+
+
+// Drift-corrected probe count at nidq count niCt.
+//
+double NiAlign::imCtAt( quint64 niCt ) const
+{
+    double  t, ct;
+
+    niQ->mapCt2TimeSync( t, niCt );
+    imQ->mapTime2CtSync( ct, t );
+
+    return ct;
+}
+
+
+// Append converter output for in (ntpts frames) to out, which
+// holds pend frames. The converter keeps its filter history
+// across calls, so counts out vary a little by block.
+//
+bool NiAlign::convert(
+    SRC_STATE           *st,
+    std::vector<float>  &in,
+    std::vector<float>  &out,
+    int                 &pend,
+    int                 nC,
+    int                 ntpts,
+    double              ratio )
+{
+    SRC_DATA    D;
+    int         outMax = int(ntpts * ratio) + NIALIGN_SLACK;
+
+    D.data_in       = &in[0];
+    D.input_frames  = ntpts;
+    D.end_of_input  = 0;
+    D.src_ratio     = ratio;
+
+    while( D.input_frames > 0 ) {
+
+        out.resize( (pend + outMax) * nC );
+
+        D.data_out      = &out[pend * nC];
+        D.output_frames = outMax;
+
+        if( int err = src_process( st, &D ) ) {
+            Warning() << "nidq align error: " << src_strerror( err );
+            return false;
+        }
+
+        pend += D.output_frames_gen;
+
+        if( !D.input_frames_used && !D.output_frames_gen )
+            break;
+
+        D.data_in       += D.input_frames_used * nC;
+        D.input_frames  -= D.input_frames_used;
+    }
+
+    out.resize( pend * nC );
+    return true;
+}
+
+
+// Write scans for which both converters have output.
+//
+bool NiAlign::putScans()
+{
+    int n = (nA ? (nD ? qMin( pendA, pendD ) : pendA) : pendD);
+
+    if( !n )
+        return true;
+
+    blk.resize( n * (nA + nD) );
+
+    qint16      *B = &blk[0];
+    const float *A = (nA ? &outA[0] : 0),
+                *D = (nD ? &outD[0] : 0);
+
+    for( int it = 0; it < n; ++it ) {
+
+        for( int j = 0; j < nA; ++j )
+            *B++ = qBound( SHRT_MIN, qRound( 32768.0F * *A++ ), SHRT_MAX );
+
+        for( int j = 0; j < nD; ++j )
+            *B++ = qBound( SHRT_MIN, qRound( 32768.0F * *D++ ), SHRT_MAX );
+    }
+
+    if( nA ) {
+        outA.erase( outA.begin(), outA.begin() + n * nA );
+        pendA -= n;
+    }
+
+    if( nD ) {
+        outD.erase( outD.begin(), outD.begin() + n * nD );
+        pendD -= n;
+    }
+
+    return df->writeAndInvalScans( blk );
+}
@@ -0,0 +1,87 @@
+#ifndef NIALIGN_H
+#define NIALIGN_H
+
+#include "DataFileNI.h"
+
+#include "samplerate.h"
+
+class AIQ;
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Companion of a nidq file holding chosen nidq channels resampled
+// onto one probe's clock as they're written, so analysis needn't
+// read both files whole to align them offline.
+//
+// File <nidq name>.imec<ip>.bin (with meta) is a nidq-type file
+// of the chosen saved channels whose scans are that probe's
+// counts: firstSample and niSampRate are the probe's. Each nidq
+// block is mapped onto probe counts through the sync edge index
+// (nominal rates until sync edges arrive), and the ratio of the
+// mapped span to the block's length drives the converter, so
+// drift is followed block by block. Analog channels pass a sinc
+// converter, digital words a zero-order hold (values unchanged).
+//
+// Resampled blocks go to the file's async writer; close() hands
+// the file to DataFile's async closer (async) or finishes it.
+//
+class NiAlign
+{
+private:
+    DataFileNI          *df;
+    const AIQ           *niQ,
+                        *imQ;
+    SRC_STATE           *srcA,      // analog
+                        *srcD;      // digital
+    std::vector<int>    acqA,       // acq channel per column
+                        acqD,
+                        savA,       // nidq file channel per column
+                        savD;
+    std::vector<float>  inA,
+                        inD,
+                        outA,
+                        outD;
+    vec_i16             blk;
+    double              nomRatio;
+    int                 ip,
+                        nSav,       // nidq file channels
+                        nA,
+                        nD,
+                        pendA,      // scans held in outA
+                        pendD;
+    bool                started;
+
+public:
+    NiAlign( int ip );
+    virtual ~NiAlign();
+
+    static bool isEnabled( const DAQ::Params &p );
+
+    bool open(
+        const DAQ::Params   &p,
+        const DataFileNI    &dfNi,
+        const AIQ           *niQ,
+        const AIQ           *imQ );
+
+    int probe() const       {return ip;}
+    DataFile *file() const  {return df;}
+
+    bool write( const vec_i16 &data, quint64 headCt, bool saved );
+    void close( const KeyValMap &kvm, bool async );
+
+private:
+    double imCtAt( quint64 niCt ) const;
+    bool convert(
+        SRC_STATE           *st,
+        std::vector<float>  &in,
+        std::vector<float>  &out,
+        int                 &pend,
+        int                 nC,
+        int                 ntpts,
+        double              ratio );
+    bool putScans();
+};
+
+#endif  // NIALIGN_H
@@ -0,0 +1,267 @@
+
+#include "SpikeEvt.h"
+#include "AIQ.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EVT_SSE2
+#endif
+
+
+/* ---------------------------------------------------------------- */
+/* SpikeEvtDetect ------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// vT are per-chan thresholds in stream counts; band filters all
+// chans. An event needs nPre rows before it and max(nPost, peak
+// window) rows from it, so it's reported that much later.
+//
+SpikeEvtDetect::SpikeEvtDetect(
+    const std::vector<int>  &chans,
+    const std::vector<int>  &vT,
+    const BiquadBand        &band,
+    double                  srate,
+    int                     maxInt,
+    double                  refracSecs,
+    int                     nPre,
+    int                     nPost )
+    :   chans(chans), nPre(nPre), nPost(nPost), maxInt(maxInt)
+{
+    int nS = chans.size();
+
+    nPad    = (nS + 7) & ~7;
+    nPk     = qMax( 1, int(0.0005 * srate) );
+    nLag    = qMax( nPost, nPk );
+    refrac  = qBound( 1, int(refracSecs * srate), 32767 );
+
+    T.assign( nPad, -32768 );
+
+    for( int i = 0; i < nS; ++i )
+        T[i] = qBound( -32768, vT[i], 32767 );
+
+    flt.addBand( band, srate );
+
+    reset( 0 );
+}
+
+
+// Restart search at fromCt, after the filter transient.
+//
+void SpikeEvtDetect::reset( quint64 fromCt )
+{
+    armed.assign( nPad, 0 );
+    dead.assign( nPad, 0 );
+    buf.clear();
+    flt.clearMem();
+
+    bufCt   = fromCt;
+    nextCt  = fromCt;
+    detCt   = fromCt + qMax( nPre, int(BIQUAD_TRANS_WIDE) );
+    nzero   = BIQUAD_TRANS_WIDE;
+}
+
+
+// Read up to nMax new scans of Q, append SpikeEvtRec records
+// to evts and their snippets to snips.
+//
+// Return:
+// -1 = lapped; search resumes at queue head.
+// else number of events appended.
+//
+int SpikeEvtDetect::process(
+    QByteArray  &evts,
+    QByteArray  &snips,
+    const AIQ   *Q,
+    int         nMax )
+{
+    AIQ::View   V;
+
+    if( Q->getView( V, nextCt, nMax ) < 0 ) {
+        reset( Q->qHeadCt() );
+        return -1;
+    }
+
+    const int   nC  = Q->nChans(),
+                nS  = chans.size(),
+                n   = V.nScans();
+
+    if( !n )
+        return 0;
+
+// Gather set after held rows
+
+    int nOld = buf.size() / nPad;
+
+    buf.resize( (nOld + n) * nPad, 0 );
+
+    qint16  *dst = &buf[nOld * nPad];
+
+    for( int is = 0; is < 2; ++is ) {
+
+        const qint16    *src = V.span[is];
+
+        for( int it = 0; it < V.nspan[is]; ++it ) {
+
+            for( int i = 0; i < nS; ++i )
+                dst[i] = src[chans[i]];
+
+            src += nC;
+            dst += nPad;
+        }
+    }
+
+    if( !Q->isIntact( V ) ) {
+        reset( Q->qHeadCt() );
+        return -1;
+    }
+
+// Filter
+
+    flt.applyBlockwiseMem( &buf[nOld * nPad], maxInt, n, nPad, 0, nS );
+
+    if( nzero > 0 ) {
+
+        // overwrite with zeros
+
+        int nz = qMin( n, nzero );
+
+        for( int it = 0; it < nz; ++it )
+            memset( &buf[(nOld + it) * nPad], 0, nS*sizeof(qint16) );
+
+        nzero -= nz;
+    }
+
+    nextCt += n;
+
+// Threshold complete rows
+
+    qint16  *A      = &armed[0],
+            *D      = &dead[0];
+    int     r0      = int(detCt - bufCt),
+            rLim    = int(nextCt - bufCt) - nLag,
+            nEvt    = 0;
+
+#ifdef EVT_SSE2
+    const __m128i   vZero   = _mm_setzero_si128(),
+                    vOne    = _mm_set1_epi16( 1 ),
+                    vAll    = _mm_set1_epi16( -1 ),
+                    vRef    = _mm_set1_epi16( qint16(refrac) );
+#endif
+
+    for( int r = r0; r < rLim; ++r ) {
+
+        const qint16    *row = &buf[r * nPad];
+
+#ifdef EVT_SSE2
+        for( int i = 0; i < nPad; i += 8 ) {
+
+            __m128i lt      = _mm_cmplt_epi16(
+                                _mm_loadu_si128( (const __m128i*)&row[i] ),
+                                _mm_loadu_si128( (const __m128i*)&T[i] ) ),
+                    a       = _mm_loadu_si128( (const __m128i*)&A[i] ),
+                    d       = _mm_loadu_si128( (const __m128i*)&D[i] ),
+                    dz      = _mm_cmpeq_epi16( d, vZero ),
+                    fire    = _mm_and_si128( _mm_and_si128( lt, a ), dz );
+
+            a = _mm_andnot_si128( fire,
+                    _mm_or_si128( a,
+                        _mm_andnot_si128( lt, _mm_and_si128( dz, vAll ) ) ) );
+            d = _mm_or_si128(
+                    _mm_subs_epu16( d, vOne ),
+                    _mm_and_si128( fire, vRef ) );
+
+            _mm_storeu_si128( (__m128i*)&A[i], a );
+            _mm_storeu_si128( (__m128i*)&D[i], d );
+
+            int m = _mm_movemask_epi8( fire );
+
+            for( int k = 0; m; ++k, m >>= 2 ) {
+
+                if( m & 1 ) {
+                    emitEvt( evts, snips, r, i + k );
+                    ++nEvt;
+                }
+            }
+        }
+#else
+        for( int i = 0; i < nPad; ++i ) {
+
+            bool    lt      = row[i] < T[i],
+                    dz      = !D[i],
+                    fire    = lt && A[i] && dz;
+
+            if( fire ) {
+                A[i] = 0;
+                D[i] = refrac;
+                emitEvt( evts, snips, r, i );
+                ++nEvt;
+            }
+            else {
+
+                if( !lt && dz )
+                    A[i] = -1;
+
+                if( D[i] )
+                    --D[i];
+            }
+        }
+#endif
+    }
+
+    if( rLim > r0 )
+        detCt = bufCt + rLim;
+
+// Drop rows no snippet can reach
+
+    int drop = int(qint64(detCt - bufCt) - nPre);
+
+    if( drop > 0 ) {
+        buf.erase( buf.begin(), buf.begin() + drop * nPad );
+        bufCt += drop;
+    }
+
+    return nEvt;
+}
+
+
+void SpikeEvtDetect::emitEvt(
+    QByteArray  &evts,
+    QByteArray  &snips,
+    int         row,
+    int         i ) const
+{
+    SpikeEvtRec     E;
+    const qint16    *p  = &buf[row * nPad + i];
+    qint16          amp = *p;
+
+    for( int k = 1; k < nPk; ++k ) {
+
+        if( p[k * nPad] < amp )
+            amp = p[k * nPad];
+    }
+
+    E.ct    = bufCt + row;
+    E.ic    = chans[i];
+    E.amp   = amp;
+    E.rsv   = 0;
+
+    evts.append( (const char*)&E, sizeof(E) );
+
+    int nSnip = nPre + nPost;
+
+    if( nSnip ) {
+
+        qint16  S[SPIKEEVT_MAXSNIP];
+
+        p -= nPre * nPad;
+
+        for( int k = 0; k < nSnip; ++k, p += nPad )
+            S[k] = *p;
+
+        snips.append( (const char*)S, nSnip * sizeof(qint16) );
+    }
+}
+
+
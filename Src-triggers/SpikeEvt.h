@@ -0,0 +1,112 @@
+#ifndef SPIKEEVT_H
+#define SPIKEEVT_H
+
+#include "SGLTypes.h"
+#include "Biquad.h"
+
+#include <QByteArray>
+
+class AIQ;
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#define SPIKEEVT_MAGIC  0x504C4753  // 'SGLP'
+
+// Most snippet scans (nPre + nPost) per event.
+#define SPIKEEVT_MAXSNIP    1024
+
+// Spike event frame (little-endian):
+// - SpikeEvtHdr.
+// - SpikeEvtRec evt[nEvts].
+// - If nPre + nPost: qint16 snip[nEvts][nPre + nPost], filtered
+//   samples from ct - nPre.
+//
+// Detection is complete for all counts before doneCt. A jump
+// in doneCt beyond the previous frame's means the detector fell
+// off the ring and resumed at the oldest queued scan.
+//
+struct SpikeEvtHdr {
+    quint32 magic;  // SPIKEEVT_MAGIC
+    quint32 seq;    // frame number from 0
+    quint64 doneCt; // stream count searched through
+    quint32 nEvts;  // records following
+    quint16 nPre,   // snippet scans before ct
+            nPost;  // snippet scans from ct on
+    double  tEnq;   // app secs scan doneCt-1 enqueued
+};
+
+
+struct SpikeEvtRec {
+    quint64 ct;     // stream count of threshold crossing
+    quint16 ic;     // acquired channel index
+    qint16  amp;    // filtered trough within peak window
+    quint32 rsv;    // 0
+};
+
+
+// Per-channel threshold detector over a set of neural channels
+// of one stream, after TrigSpike's multi-channel detector: blocks
+// are read in place, the set gathered, filtered together by one
+// cascade, and thresholded a row at a time on SIMD lanes.
+//
+// A channel fires where it drops below its (negative) threshold
+// T, having been seen at or above T since its last event, and
+// is then dead for the refractory period. Its amplitude is the
+// trough over the following peak window (~0.5 ms). Rows are held
+// back until the peak window and snippet are complete.
+//
+class SpikeEvtDetect
+{
+private:
+    BiquadCascade       flt;
+    std::vector<int>    chans;
+    vec_i16             T,      // per chan
+                        armed,  // -1 once seen >= T
+                        dead,   // refractory rows left (unsigned)
+                        buf;    // filtered rows from bufCt
+    quint64             bufCt,
+                        nextCt, // next count to read
+                        detCt;  // next count to test
+    int                 nPad,
+                        nPre,
+                        nPost,
+                        nPk,
+                        nLag,   // rows held back
+                        refrac,
+                        maxInt,
+                        nzero;
+
+public:
+    SpikeEvtDetect(
+        const std::vector<int>  &chans,
+        const std::vector<int>  &vT,
+        const BiquadBand        &band,
+        double                  srate,
+        int                     maxInt,
+        double                  refracSecs,
+        int                     nPre,
+        int                     nPost );
+
+    void reset( quint64 fromCt );
+    quint64 readCt() const  {return nextCt;}
+    quint64 doneCt() const  {return detCt;}
+
+    int process(
+        QByteArray  &evts,
+        QByteArray  &snips,
+        const AIQ   *Q,
+        int         nMax );
+
+private:
+    void emitEvt(
+        QByteArray  &evts,
+        QByteArray  &snips,
+        int         row,
+        int         i ) const;
+};
+
+#endif  // SPIKEEVT_H
+
+
@@ -1,17 +1,23 @@
 
 HEADERS += \
+    $$PWD/NiAlign.h \
+    $$PWD/SpikeEvt.h \
     $$PWD/TrigBase.h \
     $$PWD/TrigImmed.h \
     $$PWD/TrigSpike.h \
     $$PWD/TrigTCP.h \
+    $$PWD/TrigTelemetry.h \
     $$PWD/TrigTimed.h \
     $$PWD/TrigTTL.h
 
 SOURCES += \
+    $$PWD/NiAlign.cpp \
+    $$PWD/SpikeEvt.cpp \
     $$PWD/TrigBase.cpp \
     $$PWD/TrigImmed.cpp \
     $$PWD/TrigSpike.cpp \
     $$PWD/TrigTCP.cpp \
+    $$PWD/TrigTelemetry.cpp \
     $$PWD/TrigTimed.cpp \
     $$PWD/TrigTTL.cpp
 
@@ -6,8 +6,13 @@
 #include "TrigTTL.h"
 #include "Util.h"
 #include "MainApp.h"
+#include "DFDiskMon.h"
 #include "GraphsWindow.h"
 #include "MetricsWindow.h"
+#include "NiAlign.h"
+#include "RunBench.h"
+#include "Subset.h"
+#include "Trace.h"
 
 #include <QDir>
 #include <QFileInfo>
@@ -20,6 +25,183 @@
 #endif
 
 
+// Write governor: warn when a file queue above MINFILL % is on
+// course to reach STOPFILL % (DataFile stops the run there)
+// within WARNSECS. Trends are smoothed over status updates
+// with weight ALPHA.
+#define GOV_MINFILL     10.0
+#define GOV_STOPFILL    95.0
+#define GOV_WARNSECS    30.0
+#define GOV_ALPHA       0.3
+
+// Files closed after at least this much sync time get the live
+// sync-calibrated sample rate in their metadata.
+#define SYNC_CALSECS    60.0
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Wall time any trigger last wrote bytes (see secsSinceWrite()).
+//
+static QMutex   wrTMtx;
+static double   wrT = 0;
+
+// Runs of file's saved channels (acq ids, ascending).
+//
+// Return count of channels.
+//
+static int chanRuns( QVector<uint> &runs, const QVector<uint> &ids )
+{
+    QBitArray   b;
+
+    Subset::vec2Bits( b, ids );
+    return Subset::bits2Runs( runs, b );
+}
+
+
+// Timepoint it of spans S holding N[0], N[1] timepoints.
+//
+static inline const qint16* tpAt(
+    const qint16* const S[2],
+    const int           N[2],
+    int                 it,
+    int                 nCh )
+{
+    return (it < N[0] ? S[0] + it*nCh : S[1] + (it - N[0])*nCh);
+}
+
+
+// Copy runs of one scan S to D; runs may overlap (in place).
+//
+// Return pointer past last D item written.
+//
+static qint16* gatherRuns(
+    qint16              *D,
+    const qint16        *S,
+    const QVector<uint> &runs )
+{
+    for( int ir = 0, nr = runs.size(); ir < nr; ir += 2 ) {
+
+        int nk = runs[ir+1];
+
+        memmove( D, &S[runs[ir]], nk * sizeof(qint16) );
+        D += nk;
+    }
+
+    return D;
+}
+
+
+// Scale file's rate by stream's calibrated/nominal ratio, so
+// derived (LF) files are corrected alike. Saves a separate
+// CalSRate pass over the recorded files.
+//
+static void syncCalibrate( DataFile *df, const AIQ *Q )
+{
+    double  rate, span;
+
+    if( !df || !Q->syncRate( rate, span ) || span < SYNC_CALSECS )
+        return;
+
+    df->setSampleRate( df->samplingRateHz() * rate / Q->sRate() );
+    df->setParam( "syncCalSecs", span );
+}
+
+
+static void epochSpan(
+    DFEpochSpan &S,
+    const AIQ   *Q,
+    quint64     firstCt,
+    quint64     nCt,
+    quint64     fileCt )
+{
+    S.firstCt   = firstCt;
+    S.limCt     = firstCt + nCt;
+    S.fileCt    = fileCt;
+    Q->mapCt2TimeSync( S.tFirst, S.firstCt );
+    Q->mapCt2TimeSync( S.tLim, S.limCt );
+}
+
+
+/* ---------------------------------------------------------------- */
+/* PreSet --------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Files still held were never used.
+//
+TrigBase::PreSet::~PreSet()
+{
+    for( int ip = 0, np = ap.size(); ip < np; ++ip ) {
+
+        if( ap[ip] ) {
+            ap[ip]->discardWrite();
+            delete ap[ip];
+        }
+
+        if( lf[ip] ) {
+            lf[ip]->discardWrite();
+            delete lf[ip];
+        }
+    }
+
+    if( ni ) {
+        ni->discardWrite();
+        delete ni;
+    }
+}
+
+
+// The work a trigger would do: create the DataFiles, open .bin
+// and preliminary .meta, reserve disk space and start writers.
+// Failures are quiet; the trigger then opens in its own thread
+// and reports.
+//
+void TrigBase::PreSet::run()
+{
+    const DAQ::Params   &p = tb->p;
+
+    ok = true;
+
+    for( int ip = 0; ip < tb->nImQ; ++ip ) {
+
+        ap.push_back(
+            p.im.each[ip].apSaveChanCount() ?
+            new DataFileIMAP( ip ) : 0 );
+
+        lf.push_back(
+            p.im.each[ip].lfIsSaving() ?
+            new DataFileIMLF( ip ) : 0 );
+    }
+
+    if( tb->niQ )
+        ni = new DataFileNI;
+
+    std::vector<DataFile*>  vF;
+
+    for( int ip = 0; ip < tb->nImQ; ++ip ) {
+        vF.push_back( ap[ip] );
+        vF.push_back( lf[ip] );
+    }
+
+    vF.push_back( ni );
+
+    for( int i = 0, n = vF.size(); ok && i < n; ++i ) {
+
+        DataFile    *df = vF[i];
+
+        if( !df )
+            continue;
+
+        ok = df->openForWrite( p, ig, it, QString::null );
+
+        if( ok ) {
+            tb->fileSetup( df, false );
+            df->startWriter();
+        }
+    }
+}
+
 /* ---------------------------------------------------------------- */
 /* TrigBase ------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -29,10 +211,12 @@ TrigBase::TrigBase(
     GraphsWindow        *gw,
     const QVector<AIQ*> &imQ,
     const AIQ           *niQ )
-    :   QObject(0), dfNi(0),
-        ovr(p), startT(-1), gateHiT(-1), gateLoT(-1), trigHiT(-1),
+    :   QObject(0), dfNi(0), epochs(0),
+        ovr(p), pre(0), preGate(-1), startT(-1), gateHiT(-1), gateLoT(-1), trigHiT(-1),
         firstCtNi(0), offHertz(0), offmsec(0), onHertz(0), onmsec(0),
-        iGate(-1), iTrig(-1), gateHi(false), pleaseStop(false),
+        wakeQ(0), wakeCt(0), iGate(-1), iTrig(-1),
+        epG(-1), epT(-1), epN(0), wakeBatch(0),
+        gateHi(false), pleaseStop(false),
         p(p), gw(gw), imQ(imQ), niQ(niQ), statusT(-1), nImQ(imQ.size())
 {
     if( nImQ ) {
@@ -48,6 +232,59 @@ TrigBase::TrigBase(
 
     tLastReport = getTime();
     tLastProf.assign( nImQ + 1, 0 );
+
+    // A starting run counts as writing until shown quiet
+
+    wrTMtx.lock();
+    wrT = tLastReport;
+    wrTMtx.unlock();
+
+    rdrId.assign( nImQ + 1, -1 );
+    bufPool.resize( nImQ + 1 );
+
+    for( int ip = 0; ip < nImQ; ++ip ) {
+        rdrId[ip+1]     = imQ[ip]->readerId( "trigger" );
+        bufPool[ip+1]   = QSharedPointer<SampleBufPool>( new SampleBufPool );
+    }
+
+    if( niQ ) {
+        rdrId[0]    = niQ->readerId( "trigger" );
+        bufPool[0]  = QSharedPointer<SampleBufPool>( new SampleBufPool );
+    }
+
+    DataFile::setMaxAsyncCloses( p.sns.maxCloses );
+
+    QVector<int>    ips;
+
+    for( int ip = 0; ip < nImQ; ++ip )
+        ips.push_back( ip );
+
+    if( niQ )
+        ips.push_back( -1 );
+
+    epochs = new DFEpochs(
+                DFEpochs::epochsName( mainApp()->dataDir(), p.sns.runName ),
+                ips );
+}
+
+
+TrigBase::~TrigBase()
+{
+    dropPre();
+
+    if( epochs )
+        delete epochs;
+}
+
+
+// Seconds since any trigger last wrote to its files, for
+// background disk jobs to stay out of the writers' way.
+//
+double TrigBase::secsSinceWrite()
+{
+    QMutexLocker    ml( &wrTMtx );
+
+    return getTime() - wrT;
 }
 
 
@@ -75,6 +312,15 @@ bool TrigBase::isInUse( const QFileInfo &fi ) const
     if( dfNi && fi == QFileInfo( dfNi->binFileName() ) )
         return true;
 
+    for( int i = 0, n = niAln.size(); i < n; ++i ) {
+
+        if( niAln[i]->file() && fi == QFileInfo( niAln[i]->file()->binFileName() ) )
+            return true;
+    }
+
+    if( !preStem.isEmpty() && fi.fileName().startsWith( preStem ) )
+        return true;
+
     return false;
 }
 
@@ -133,7 +379,9 @@ void TrigBase::setGateEnabled( bool enabled )
 }
 
 
-void TrigBase::setGate( bool hi )
+// Edge time t (stream time) or if t < 0, now.
+//
+void TrigBase::setGate( bool hi, double t )
 {
     QMutexLocker    ml( &runMtx );
 
@@ -155,7 +403,7 @@ void TrigBase::setGate( bool hi )
             return;
         }
 
-        gateHiT = nowCalibrated();
+        gateHiT = (t >= 0 ? t : nowCalibrated());
 
         if( ovr.forceGT ) {
 
@@ -172,9 +420,9 @@ void TrigBase::setGate( bool hi )
         }
     }
     else
-        gateLoT = nowCalibrated();
+        gateLoT = (t >= 0 ? t : nowCalibrated());
 
-    gateHi = hi;
+    gateHi.store( hi, std::memory_order_release );
 
     QMetaObject::invokeMethod(
         gw, "setGateLED",
@@ -191,6 +439,35 @@ void TrigBase::forceGTCounters( int g, int t )
 }
 
 
+// Map count ct of stream ip (-1=nidq) to stream time t, and
+// set now to current stream time. Works on copies of the sync
+// streams so remote threads don't touch the trigger's.
+// Return false if no such stream.
+//
+bool TrigBase::mapStreamCt( double &t, double &now, int ip, quint64 ct ) const
+{
+    for( int is = 0, ns = vS.size(); is < ns; ++is ) {
+
+        if( vS[is].ip != ip )
+            continue;
+
+        if( is ) {
+            SyncStream  src = vS[is],
+                        dst = vS[0];
+
+            t = syncDstTAbs( ct, &src, &dst, p );
+        }
+        else
+            t = vS[0].Ct2TAbs( ct );
+
+        now = nowCalibrated();
+        return true;
+    }
+
+    return false;
+}
+
+
 // Best estimator of time during run.
 //
 double TrigBase::nowCalibrated() const
@@ -204,13 +481,21 @@ double TrigBase::nowCalibrated() const
 void TrigBase::endTrig()
 {
     quint32 freq, msec;
+    bool    wasOpen;
 
     dfMtx.lock();
-        freq = offHertz;
-        msec = offmsec;
+        freq    = offHertz;
+        msec    = offmsec;
+        wasOpen = dfNi || !firstCtIm.empty();
+
+        epochAdd();
+        epT = -1;
 
         for( int ip = 0, np = firstCtIm.size(); ip < np; ++ip ) {
 
+            syncCalibrate( dfImAp[ip], imQ[ip] );
+            syncCalibrate( dfImLf[ip], imQ[ip] );
+
             if( dfImAp[ip] )
                 dfImAp[ip]->closeAsync( kvmRmt );
 
@@ -221,8 +506,12 @@ void TrigBase::endTrig()
         dfImLf.clear();
         firstCtIm.clear();
 
-        if( dfNi )
+        closeNiAlign( true );
+
+        if( dfNi ) {
+            syncCalibrate( dfNi, niQ );
             dfNi = (DataFileNI*)dfNi->closeAsync( kvmRmt );
+        }
         firstCtNi = 0;
     dfMtx.unlock();
 
@@ -238,6 +527,12 @@ void TrigBase::endTrig()
         if( freq > 0 )
             Beep( freq, msec );
     }
+
+// Inactive loops call here each pass; predict again only
+// if files closed or the gate changed since last time.
+
+    if( wasOpen || preGate != int(isGateHi()) )
+        prepNext();
 }
 
 
@@ -254,7 +549,7 @@ bool TrigBase::newTrig( int &ig, int &it, bool trigLED )
     if( forceName.isEmpty() ) {
 
         QString runDir = QString("%1/%2_g%3")
-                            .arg( mainApp()->dataDir() )
+                            .arg( mainApp()->dataDirs()[0] )
                             .arg( p.sns.runName )
                             .arg( ig );
 
@@ -265,13 +560,23 @@ bool TrigBase::newTrig( int &ig, int &it, bool trigLED )
         }
     }
 
-// Create files
+// Create files, or take those opened ahead
+
+    PreSet  *S = takePre( ig, it );
 
     dfMtx.lock();
         freq = onHertz;
         msec = onmsec;
 
-        if( nImQ ) {
+        if( S ) {
+            firstCtIm.assign( nImQ, 0 );
+            dfImAp.swap( S->ap );
+            dfImLf.swap( S->lf );
+            firstCtNi   = 0;
+            dfNi        = S->ni;
+            S->ni       = 0;
+        }
+        else if( nImQ ) {
             for( int ip = 0; ip < nImQ; ++ip ) {
 
                 firstCtIm.push_back( 0 );
@@ -285,10 +590,13 @@ bool TrigBase::newTrig( int &ig, int &it, bool trigLED )
                     new DataFileIMLF( ip ) : 0 );
             }
         }
-        if( niQ ) {
+        if( niQ && !S ) {
             firstCtNi   = 0;
             dfNi        = new DataFileNI;
         }
+
+        epCt.assign( nImQ + 1, 0 );
+        epFileCt.assign( nImQ + 1, 0 );
     dfMtx.unlock();
 
 // Open files
@@ -297,25 +605,39 @@ bool TrigBase::newTrig( int &ig, int &it, bool trigLED )
 
     for( int ip = 0; ip < nImQ; ++ip ) {
 
-        if( dfImAp[ip] && !openFile( dfImAp[ip], ig, it ) ) {
+        if( dfImAp[ip] && !openFile( dfImAp[ip], ig, it, forceName ) ) {
             ok = false;
             break;
         }
 
-        if( dfImLf[ip] && !openFile( dfImLf[ip], ig, it ) ) {
+        if( dfImLf[ip] && !openFile( dfImLf[ip], ig, it, forceName ) ) {
             ok = false;
             break;
         }
     }
 
     if( ok )
-        ok = openFile( dfNi, ig, it );
+        ok = openFile( dfNi, ig, it, forceName );
 
     forceName.clear();
 
+    if( S )
+        delete S;
+
     if( !ok )
         return false;
 
+    if( dfNi && NiAlign::isEnabled( p ) )
+        openNiAlign();
+
+// Epoch index entry written at endTrig or epochNext
+
+    if( ig != epG )
+        epN = 0;
+
+    epG = ig;
+    epT = it;
+
 // Reset state tracking
 
     trigHiT = nowCalibrated();
@@ -344,6 +666,8 @@ bool TrigBase::newTrig( int &ig, int &it, bool trigLED )
     if( freq > 0 )
         Beep( freq, msec );
 
+    prepNext();
+
     return true;
 }
 
@@ -364,9 +688,13 @@ void TrigBase::setSyncWriteMode()
 }
 
 
-// A positive nMax value is the number of samples to retrieve.
+// A positive nMax value is the most samples to retrieve.
 // A negative nMax is negative of LOOP_MS.
 //
+// Either way, nMax is only a cap; we size the fetch to the
+// actual backlog (endCount - fromCt), so buffers are reserved
+// for exactly what's there, and nothing when caught up.
+//
 // Return ok.
 //
 bool TrigBase::nScansFromCt(
@@ -378,6 +706,7 @@ bool TrigBase::nScansFromCt(
     double      pct,
                 tProf   = getTime();
     const AIQ   *Q      = (ip >= 0 ? imQ[ip] : niQ);
+    quint64     endCt   = Q->endCount();
     int         ret;
 
     if( nMax < 0 ) {
@@ -385,15 +714,61 @@ bool TrigBase::nScansFromCt(
         nMax = 4.0 * 0.001 * -nMax * Q->sRate();
     }
 
-    try {
-        data.reserve( nMax * Q->nChans() );
+    if( fromCt >= endCt )
+        nMax = 0;
+    else if( endCt - fromCt < quint64(nMax) )
+        nMax = int(endCt - fromCt);
+
+    if( nMax > 0 ) {
+
+        // Reuse a block the file writer is done with
+
+        if( !data.capacity() )
+            bufPool[ip+1]->get( data );
+
+        try {
+            data.reserve( nMax * Q->nChans() );
+        }
+        catch( const std::exception& ) {
+            Error() << "Trigger low mem";
+            return false;
+        }
     }
-    catch( const std::exception& ) {
-        Error() << "Trigger low mem";
-        return false;
+
+    {
+        TraceZone   tz( "trig fetch", ip );
+
+        ret = Q->getNScansFromCtProfile( pct, data, fromCt, nMax );
+    }
+
+    profileLag( pct, tProf, ip );
+
+    if( ret > 0 ) {
+        Q->readerAt( rdrId[ip+1], fromCt + data.size() / Q->nChans() );
+        return true;
     }
 
-    ret = Q->getNScansFromCtProfile( pct, data, fromCt, nMax );
+    if( ret < 0 ) {
+
+        double  lag = double(Q->qHeadCt() - fromCt) / Q->sRate();
+        QString who = (ip >= 0 ? QString("IM%1").arg( ip ) : "NI");
+
+        Error() <<
+            QString("%1 recording lagging %2 seconds.")
+            .arg( who )
+            .arg( lag, 0, 'f', 3 );
+    }
+
+    return false;
+}
+
+
+// Trace fetch position in queue {0=oldest,100=newest}, and
+// every 2 seconds post it to the Metrics window.
+//
+void TrigBase::profileLag( double pct, double tProf, int ip )
+{
+    Trace::counter( "trig fetch pct", pct, ip );
 
     if( tProf - tLastProf[ip+1] >= 2.0 ) {
 
@@ -406,22 +781,168 @@ bool TrigBase::nScansFromCt(
 
         tLastProf[ip+1] = tProf;
     }
+}
 
-    if( ret > 0 )
-        return true;
 
-    if( ret < 0 ) {
+// Continuous-save flavor of nScansFromCt + writeAndInvalData.
+// Each file's channels are gathered straight from a view of the
+// queue ring into that file's write block, so every saved byte
+// leaves the ring exactly once, already subset. Data that must
+// come from history, or that the producer laps while gathering,
+// go through the copying path instead.
+//
+// Save up to nMax scans (neg = loop ms as in nScansFromCt)
+// from nextCt, and advance nextCt past them.
+//
+// A view stops at a gap edge, and a gap's zero view holds at
+// most ZEROBLK scans, so views are taken until nMax scans or the
+// current end, else zero-filled gaps would drain slower than
+// the stream.
+//
+// Return true if no errors.
+//
+bool TrigBase::writeViewFromCt(
+    DstStream   dst,
+    uint        ip,
+    quint64     &nextCt,
+    int         nMax )
+{
+    const AIQ   *Q = (dst == DstImec ? imQ[ip] : niQ);
 
-        double  lag = double(Q->qHeadCt() - fromCt) / Q->sRate();
-        QString who = (ip >= 0 ? QString("IM%1").arg( ip ) : "NI");
+    if( nMax < 0 ) {
+        // 4X-overfetch * loop_sec * rate
+        nMax = 4.0 * 0.001 * -nMax * Q->sRate();
+    }
 
-        Error() <<
-            QString("%1 recording lagging %2 seconds.")
-            .arg( who )
-            .arg( lag, 0, 'f', 3 );
+    quint64 lim = qMin( nextCt + nMax, Q->endCount() );
+
+    while( nextCt < lim ) {
+
+        quint64 ct = nextCt;
+
+        if( !writeView( dst, ip, nextCt, int(lim - nextCt) ) )
+            return false;
+
+        if( nextCt == ct )
+            break;
     }
 
-    return false;
+    return true;
+}
+
+
+// One view's worth of writeViewFromCt.
+//
+bool TrigBase::writeView(
+    DstStream   dst,
+    uint        ip,
+    quint64     &nextCt,
+    int         nMax )
+{
+    int         iq      = (dst == DstImec ? int(ip) : -1);
+    const AIQ   *Q      = (iq >= 0 ? imQ[ip] : niQ);
+    double      tProf   = getTime();
+    quint64     headCt  = Q->qHeadCt(),
+                endCt   = Q->endCount();
+    AIQ::View   V;
+    int         ret;
+
+    {
+        TraceZone   tz( "trig fetch", iq );
+
+        ret = Q->getView( V, nextCt, nMax );
+    }
+
+    if( ret > 0 ) {
+
+        int nTp = V.nScans();
+
+        if( !nTp )
+            return true;
+
+        vec_i16 data,
+                lf;
+
+        bufPool[iq+1]->get( data );
+
+        if( dst == DstImec )
+            gatherIM( data, lf, V.span, V.nspan, nextCt, ip, false );
+        else if( dfNi ) {
+
+            const QVector<uint> &ids    = dfNi->channelIDs();
+            int                 nC      = Q->nChans(),
+                                nK      = ids.size();
+
+            data.resize( nTp * nK );
+
+            qint16  *D = &data[0];
+
+            for( int is = 0; is < 2; ++is ) {
+
+                if( !V.nspan[is] )
+                    continue;
+
+                if( nK == nC ) {
+                    memcpy( D, V.span[is], V.nspan[is] * nC * sizeof(qint16) );
+                    D += V.nspan[is] * nC;
+                }
+                else
+                    D = Subset::subset( D, V.span[is], V.nspan[is], ids, nC );
+            }
+        }
+
+        if( Q->isIntact( V ) ) {
+
+            quint64 fromCt = nextCt;
+
+            profileLag(
+                (endCt > headCt && fromCt > headCt ?
+                    100.0 * (fromCt - headCt) / (endCt - headCt) : 0),
+                tProf, iq );
+
+            nextCt += nTp;
+            Q->readerAt( rdrId[iq+1], nextCt );
+
+            if( dst == DstImec )
+                return putIM( data, lf, fromCt, nTp, ip );
+
+            if( !dfNi )
+                return true;
+
+            if( !epCt[nImQ] )
+                epCt[nImQ] = fromCt;
+
+            if( !firstCtNi ) {
+                firstCtNi = fromCt;
+                dfNi->setFirstSample( fromCt );
+            }
+
+            for( int i = 0, n = niAln.size(); i < n; ++i ) {
+
+                if( !niAln[i]->write( data, fromCt, true ) )
+                    return false;
+            }
+
+            return dfNi->writeAndInvalScans( data );
+        }
+
+        bufPool[iq+1]->put( data );
+    }
+
+// History, or lapped: copy out
+
+    vec_i16 data;
+    quint64 fromCt = nextCt;
+
+    if( !nScansFromCt( data, fromCt, nMax, iq ) )
+        return false;
+
+    if( data.empty() )
+        return true;
+
+    nextCt += data.size() / Q->nChans();
+
+    return writeAndInvalData( dst, ip, data, fromCt );
 }
 
 
@@ -474,19 +995,26 @@ void TrigBase::endRun( const QString &err )
         Qt::QueuedConnection,
         Q_ARG(bool, false) );
 
+    dropPre();
+
     dfMtx.lock();
         freq = offHertz;
         msec = offmsec;
 
+        epochAdd();
+        epT = -1;
+
         for( int ip = 0, np = firstCtIm.size(); ip < np; ++ip ) {
 
             if( dfImAp[ip] ) {
+                syncCalibrate( dfImAp[ip], imQ[ip] );
                 dfImAp[ip]->setRemoteParams( kvmRmt );
                 dfImAp[ip]->closeAndFinalize();
                 delete dfImAp[ip];
             }
 
             if( dfImLf[ip] ) {
+                syncCalibrate( dfImLf[ip], imQ[ip] );
                 dfImLf[ip]->setRemoteParams( kvmRmt );
                 dfImLf[ip]->closeAndFinalize();
                 delete dfImLf[ip];
@@ -496,7 +1024,10 @@ void TrigBase::endRun( const QString &err )
         dfImLf.clear();
         firstCtIm.clear();
 
+        closeNiAlign( false );
+
         if( dfNi ) {
+            syncCalibrate( dfNi, niQ );
             dfNi->setRemoteParams( kvmRmt );
             dfNi->closeAndFinalize();
             delete dfNi;
@@ -517,6 +1048,7 @@ void TrigBase::endRun( const QString &err )
     if( freq > 0 && trigHiT >= 0 )
         Beep( freq, msec );
 
+    RunBench::addCPU( RunBench::stgTrig );
     emit finished();
 }
 
@@ -708,6 +1240,11 @@ void TrigBase::statusOnSince( QString &s )
 }
 
 
+// Also runs the write governor on each file (see govern()).
+// If p.sns.wrShedLF, a probe whose AP or LF queue is headed for
+// overflow stops saving LF for the rest of the epoch. Called
+// between write passes, so no stream thread is using the files.
+//
 void TrigBase::statusWrPerf( QString &s )
 {
     double  tReport,
@@ -721,30 +1258,77 @@ void TrigBase::statusWrPerf( QString &s )
 
         tReport = getTime();
 
+        double  dt = qMax( 1e-3, tReport - tLastReport );
+
+        gov.resize( 1 + 2 * np );
+
         // report worst case values
 
         for( int ip = 0; ip < np; ++ip ) {
 
+            bool    late = false;
+
             if( dfImAp[ip] ) {
-                imFull   = qMax( imFull, dfImAp[ip]->percentFull() );
-                wbps    += dfImAp[ip]->writtenBytes();
+
+                double  f = dfImAp[ip]->percentFull(),
+                        w = dfImAp[ip]->writtenBytes();
+
+                DFDiskMon::addWritten( dfImAp[ip]->binFileName(), w );
+
+                imFull   = qMax( imFull, f );
+                wbps    += w;
                 rbps    += dfImAp[ip]->requiredBps();
+                late     = govern( gov[1+2*ip], dfImAp[ip], f, w / dt, dt );
             }
 
             if( dfImLf[ip] ) {
-                imFull  = qMax( imFull, dfImLf[ip]->percentFull() );
-                wbps   += dfImLf[ip]->writtenBytes();
+
+                double  f = dfImLf[ip]->percentFull(),
+                        w = dfImLf[ip]->writtenBytes();
+
+                DFDiskMon::addWritten( dfImLf[ip]->binFileName(), w );
+
+                imFull  = qMax( imFull, f );
+                wbps   += w;
                 rbps   += dfImLf[ip]->requiredBps();
+                late    = govern( gov[2+2*ip], dfImLf[ip], f, w / dt, dt )
+                            || late;
+
+                if( late && p.sns.wrShedLF && dfImAp[ip] ) {
+
+                    Warning()
+                        << "Write governor: stopping LF file for imec"
+                        << ip << " to relieve disk.";
+
+                    dfMtx.lock();
+                        syncCalibrate( dfImLf[ip], imQ[ip] );
+                        dfImLf[ip]->closeAsync( kvmRmt );
+                        dfImLf[ip] = 0;
+                    dfMtx.unlock();
+                }
             }
         }
 
         if( dfNi ) {
-            niFull  = dfNi->percentFull();
-            wbps   += dfNi->writtenBytes();
+
+            double  f = dfNi->percentFull(),
+                    w = dfNi->writtenBytes();
+
+            DFDiskMon::addWritten( dfNi->binFileName(), w );
+
+            niFull  = f;
+            wbps   += w;
             rbps   += dfNi->requiredBps();
+            govern( gov[0], dfNi, f, w / dt, dt );
         }
 
-        wbps /= (tReport - tLastReport);
+        if( wbps > 0 ) {
+            wrTMtx.lock();
+            wrT = tReport;
+            wrTMtx.unlock();
+        }
+
+        wbps /= dt;
         wbps /= 1024*1024;
         rbps /= 1024*1024;
         tLastReport = tReport;
@@ -778,12 +1362,35 @@ void TrigBase::setYieldPeriod_ms( int loopPeriod_ms )
 }
 
 
+// Wake yield() when minBatch_ms of new scans arrive in Q,
+// rather than sleeping out the loop period regardless.
+//
+void TrigBase::setYieldWake( const AIQ *Q, int minBatch_ms )
+{
+    wakeQ       = Q;
+    wakeCt      = Q->endCount();
+    wakeBatch   = qMax( 1, int(0.001 * minBatch_ms * Q->sRate()) );
+}
+
+
 void TrigBase::yield( double loopT )
 {
 // Loop no more often than every loopPeriod_us
 
     loopT = 1e6 * (getTime() - loopT);  // microsec
 
+// Or, wake as soon as a batch past the last wakeup is in,
+// still at least every loopPeriod_us for status and stop
+
+    if( wakeQ ) {
+
+        int ms = (loopT < loopPeriod_us ? (loopPeriod_us - loopT) / 1000 : 10);
+
+        wakeQ->waitForCt( wakeCt + wakeBatch, qMax( ms, 1 ) );
+        wakeCt = wakeQ->endCount();
+        return;
+    }
+
     if( loopT < loopPeriod_us )
         QThread::usleep( loopPeriod_us - loopT );
     else
@@ -791,14 +1398,130 @@ void TrigBase::yield( double loopT )
 }
 
 
-bool TrigBase::openFile( DataFile *df, int ig, int it )
+// Track queue fill trend and sustained write rate of one file.
+// Warn (once per file) if the queue is on course to reach the
+// overflow stop level within GOV_WARNSECS, that is, long before
+// SampleBufQ's own overflow warning.
+//
+// Return true if on course to overflow.
+//
+bool TrigBase::govern(
+    WrGov           &G,
+    const DataFile  *df,
+    double          fill,
+    double          bps,
+    double          dt )
+{
+    if( G.df != df ) {
+        G       = WrGov();
+        G.df    = df;
+        G.fill  = fill;
+        G.wbps  = bps;
+        return false;
+    }
+
+    G.slope = GOV_ALPHA * (fill - G.fill) / dt + (1 - GOV_ALPHA) * G.slope;
+    G.wbps  = GOV_ALPHA * bps + (1 - GOV_ALPHA) * G.wbps;
+    G.fill  = fill;
+
+    if( fill < GOV_MINFILL || G.slope <= 0 )
+        return false;
+
+    double  tOvr = (GOV_STOPFILL - fill) / G.slope;
+
+    if( tOvr > GOV_WARNSECS )
+        return false;
+
+    if( !G.warned ) {
+
+        Warning() <<
+            QString("Disk falling behind [%1]: queue %2%,"
+            " full in ~%3 s (writing %4 MB/s, need %5 MB/s).")
+            .arg( QFileInfo( df->binFileName() ).fileName() )
+            .arg( fill, 0, 'f', 1 )
+            .arg( qMax( 0.0, tOvr ), 0, 'f', 0 )
+            .arg( G.wbps / (1024*1024), 0, 'f', 1 )
+            .arg( df->requiredBps() / (1024*1024), 0, 'f', 1 );
+
+        G.warned = true;
+    }
+
+    return true;
+}
+
+
+// Close the open epoch and start the next in the same files.
+// Caller's writers must be idle.
+//
+void TrigBase::epochNext()
+{
+    QMutexLocker    ml( &dfMtx );
+
+    epochAdd();
+
+    for( int is = 0, ns = epCt.size(); is < ns; ++is ) {
+        epCt[is]        = 0;
+        epFileCt[is]    = epochFileCt( is );
+    }
+}
+
+
+// Return expected seconds per file, or 0 if open-ended.
+//
+double TrigBase::epochSecs() const
+{
+    switch( p.mode.mTrig ) {
+
+        case DAQ::eTrigTimed:
+            if( p.trgTim.isHInf )
+                return 0;
+            if( p.trgTim.oneFile )
+                return (p.trgTim.isNInf ? 0 : p.trgTim.tH * p.trgTim.nH);
+            return p.trgTim.tH;
+        case DAQ::eTrigTTL:
+            if( p.trgTTL.mode == DAQ::TrgTTLTimed )
+                return p.trgTTL.tH + 2 * p.trgTTL.marginSecs;
+            return 0;
+        case DAQ::eTrigSpike:
+            return 2 * p.trgSpike.periEvtSecs;
+        default:
+            return 0;
+    }
+}
+
+
+// A file opened ahead (PreSet) is already open under this ig,
+// it; it only needs its meta restamped and its space reserved.
+// The reservation waits for commit so an unused PreSet doesn't
+// tie up disk.
+//
+bool TrigBase::openFile(
+    DataFile        *df,
+    int             ig,
+    int             it,
+    const QString   &name )
 {
     if( !df )
         return true;
 
-    if( !df->openForWrite( p, ig, it, forceName ) ) {
+    if( df->isOpenForWrite() ) {
+
+        if( df->commitOpen() ) {
+            df->setPreallocation( epochSecs() );
+            return true;
+        }
+
+        Error()
+            << "Error writing meta: ["
+            << df->metaFileName()
+            << "].";
+
+        return false;
+    }
+
+    if( !df->openForWrite( p, ig, it, name ) ) {
 
-        if( forceName.isEmpty() ) {
+        if( name.isEmpty() ) {
             Error()
                 << QString("Error opening file: [%1_g%2_t%3.%4.bin].")
                     .arg( p.sns.runName )
@@ -809,22 +1532,268 @@ bool TrigBase::openFile( DataFile *df, int ig, int it )
         else {
             Error()
                 << QString("Error opening file: [%1.%2.bin].")
-                    .arg( forceName )
+                    .arg( name )
                     .arg( df->fileLblFromObj() );
         }
 
         return false;
     }
 
+    fileSetup( df );
+
     return true;
 }
 
 
-// Write LF samples on X12 boundaries (sample%12==0).
+void TrigBase::fileSetup( DataFile *df, bool prealloc )
+{
+// Blocks an AP or NI file writes came from nScansFromCt;
+// recycle them. LF blocks are mostly smaller copies, so
+// LF files just free theirs.
+
+    if( df->subtypeFromObj() == "nidq" )
+        df->setBufPool( bufPool[0] );
+    else if( df->subtypeFromObj() == "imec.ap" )
+        df->setBufPool( bufPool[df->probeNum()+1] );
+
+    double  MB = (df->subtypeFromObj() == "nidq" ?
+                    p.sns.niWrBlkMB : p.sns.imWrBlkMB);
+
+    df->setWriteBlockBytes( int(qBound( 0.0, MB, 256.0 ) * 1024*1024) );
+
+    if( prealloc )
+        df->setPreallocation( epochSecs() );
+}
+
+
+// Predict the next trigger's G/T: the next T of an open gate,
+// else T0 of the next gate. False if there is none (the mode's
+// count for this gate is used up), or unpredictable (a G/T
+// override pending, or gate disabled).
+//
+bool TrigBase::nextGT( int &ig, int &it ) const
+{
+    QMutexLocker    ml( &runMtx );
+
+    if( isGateHi() ) {
+
+        if( !moreTrigsInGate() )
+            return false;
+
+        ig = iGate;
+        it = iTrig + 1;
+    }
+    else if( ovr.forceGT || !ovr.gateEnab )
+        return false;
+    else {
+        ig = iGate + 1;
+        it = 0;
+    }
+
+    return ig >= 0;
+}
+
+
+// Keep a file set opening ahead of the next trigger, so all
+// newTrig does is restamp the meta. Forced names aren't known
+// ahead, so those triggers open as they come.
 //
-// - inplace true means data param will not be used
-// for AP, so we can write the X12 samples into it.
-// Otherwise we allocate an alternate dst.
+void TrigBase::prepNext()
+{
+    int     ig, it;
+    bool    name;
+
+    dfMtx.lock();
+        name = !forceName.isEmpty();
+    dfMtx.unlock();
+
+    preGate = isGateHi();
+
+    if( name || isStopped() || !nextGT( ig, it ) ) {
+        dropPre();
+        return;
+    }
+
+    if( pre && pre->ig == ig && pre->it == it )
+        return;
+
+    dropPre();
+
+    pre = new PreSet( this, ig, it );
+
+    dfMtx.lock();
+        preStem = QString("%1_g%2_t%3.")
+                    .arg( p.sns.runName ).arg( ig ).arg( it );
+    dfMtx.unlock();
+
+    TaskPool::submit( pre, TaskPool::Write, false );
+}
+
+
+// Return the set opened ahead if it's for this ig, it, else 0
+// (after deleting any other). If still queued, it's opened
+// here, no slower than opening without it.
+//
+TrigBase::PreSet *TrigBase::takePre( int ig, int it )
+{
+    if( !pre )
+        return 0;
+
+    pre->wait();
+
+    if( !forceName.isEmpty() || !pre->ok || pre->ig != ig || pre->it != it ) {
+        dropPre();
+        return 0;
+    }
+
+    PreSet  *S = pre;
+
+    pre = 0;
+
+    dfMtx.lock();
+        preStem.clear();
+    dfMtx.unlock();
+
+    return S;
+}
+
+
+void TrigBase::dropPre()
+{
+    if( !pre )
+        return;
+
+    pre->wait();
+    delete pre;
+    pre = 0;
+
+    dfMtx.lock();
+        preStem.clear();
+    dfMtx.unlock();
+}
+
+
+// Return samples in stream is's file (caller holds dfMtx).
+// LF-only probes count in AP samples.
+//
+// Companions of the new nidq file on each probe's clock;
+// one that can't open is skipped (warned).
+//
+void TrigBase::openNiAlign()
+{
+    QMutexLocker    ml( &dfMtx );
+
+    for( int ip = 0; ip < nImQ; ++ip ) {
+
+        NiAlign *A = new NiAlign( ip );
+
+        if( A->open( p, *dfNi, niQ, imQ[ip] ) )
+            niAln.push_back( A );
+        else
+            delete A;
+    }
+}
+
+
+// Caller holds dfMtx.
+//
+void TrigBase::closeNiAlign( bool async )
+{
+    for( int i = 0, n = niAln.size(); i < n; ++i ) {
+
+        NiAlign *A = niAln[i];
+
+        syncCalibrate( A->file(), imQ[A->probe()] );
+        A->close( kvmRmt, async );
+        delete A;
+    }
+
+    niAln.clear();
+}
+
+
+quint64 TrigBase::epochFileCt( int is ) const
+{
+    if( is < (int)firstCtIm.size() ) {
+
+        if( dfImAp[is] )
+            return dfImAp[is]->scanCount();
+        else if( dfImLf[is] )
+            return 12 * dfImLf[is]->scanCount();
+    }
+    else if( is == nImQ && dfNi )
+        return dfNi->scanCount();
+
+    return 0;
+}
+
+
+// Queue index record for the open epoch (caller holds dfMtx).
+// An epoch nothing was written to (gate closed before the
+// next H of a shared file) gets no record.
+//
+void TrigBase::epochAdd()
+{
+    if( epT < 0 )
+        return;
+
+    DFEpochRec  R;
+    bool        any = false;
+
+    R.S.resize( nImQ + (niQ ? 1 : 0) );
+
+    for( int is = 0, ns = R.S.size(); is < ns; ++is ) {
+
+        quint64 n = epochFileCt( is ) - epFileCt[is];
+
+        if( n && epCt[is] ) {
+            epochSpan(
+                R.S[is], (is < nImQ ? imQ[is] : niQ),
+                epCt[is], n, epFileCt[is] );
+            any = true;
+        }
+    }
+
+    if( !any )
+        return;
+
+    R.g     = epG;
+    R.t     = epT;
+    R.ep    = epN++;
+
+    epochs->add( R );
+}
+
+
+// Split the data into (AP+SY) and (LF+SY) components
+// in one pass over the block, directing each to the
+// appropriate data file.
+//
+// Here, all AP data are written, but only LF samples
+// on X12-boundary (sample%12==0) are written. The AP
+// subset is gathered in place, while each X12 scan is
+// at hand, its LF subset is gathered to its own buffer.
+//
+bool TrigBase::writeDataIM( vec_i16 &data, quint64 headCt, uint ip )
+{
+    const CimCfg::AttrEach  &E = p.im.each[ip];
+
+    vec_i16         lf;
+    int             nTp     = (int)data.size() / E.imCumTypCnt[CimCfg::imSumAll];
+    const qint16    *S[2]   = {(nTp ? &data[0] : 0), 0};
+    int             N[2]    = {nTp, 0};
+
+    if( nTp )
+        gatherIM( data, lf, S, N, headCt, ip, true );
+
+    return putIM( data, lf, headCt, nTp, ip );
+}
+
+
+// Gather AP and LF blocks of one probe from nTp = N[0]+N[1]
+// timepoints held in spans S (a queue view, or one block).
+// If inPlace, S[0] is &ap[0], and AP is compacted there;
+// else ap receives a copy (or subset) of the spans.
 //
 // - xtra true means that the first sample in the file
 // is not an X12, so we will need to construct the prior
@@ -832,127 +1801,185 @@ bool TrigBase::openFile( DataFile *df, int ig, int it )
 // X12 and the timepoint preceding it. The constructed
 // sync data are a copy of the first timepoint values.
 //
-bool TrigBase::writeDataLF(
-    vec_i16     &data,
-    quint64     headCt,
-    uint        ip,
-    bool        inplace,
-    bool        xtra )
-{
-    vec_i16 dstAlt;
-    vec_i16 *dst;
-    qint16  *D, *S;
-    int     R       = headCt % 12,
-            nCh     = p.im.each[ip].imCumTypCnt[CimCfg::imSumAll],
-            nAP     = p.im.each[ip].imCumTypCnt[CimCfg::imSumAP],
-            nLF     = p.im.each[ip].imCumTypCnt[CimCfg::imSumNeural] - nAP,
-            size    = (int)data.size(),
-            nTp     = size / nCh;
-
-// Set up dst = destination workspace
-// D points to first destination for X12 copies
-
-    if( inplace )
-        dst = &data;
-    else {
-        dstAlt.resize( ((xtra ? 2 : 1) + nTp) * nCh );
-        dst = &dstAlt;
+void TrigBase::gatherIM(
+    vec_i16             &ap,
+    vec_i16             &lf,
+    const qint16* const S[2],
+    const int           N[2],
+    quint64             headCt,
+    uint                ip,
+    bool                inPlace )
+{
+    uint    np      = firstCtIm.size();
+    bool    isAP    = (ip < np && dfImAp[ip]),
+            isLF    = (ip < np && dfImLf[ip]);
+
+    if( !(isAP || isLF) )
+        return;
+
+    const CimCfg::AttrEach  &E = p.im.each[ip];
+
+    int     nCh     = E.imCumTypCnt[CimCfg::imSumAll],
+            nTp     = N[0] + N[1],
+            R       = (12 - headCt % 12) % 12;  // first X12 timepoint
+    bool    xtra    = isLF && !firstCtIm[ip] && R && nTp > R;
+
+// Channel runs per file
+
+    QVector<uint>   apRuns,
+                    lfRuns;
+    int             nAP         = nCh;
+    bool            apGather    = false;
+
+    if( isAP ) {
+        nAP         = chanRuns( apRuns, dfImAp[ip]->channelIDs() );
+        apGather    = nAP < nCh;
     }
 
-    D = &dst->front();
+    if( isLF )
+        chanRuns( lfRuns, dfImLf[ip]->channelIDs() );
 
-// S points to first source timepoint
+    qint16  *A  = 0,
+            *L  = 0;
 
-    if( R )
-        R = 12 - R;
+    if( isAP ) {
 
-    S = &data[R*nCh];
+        if( !inPlace )
+            ap.resize( nTp * nAP );
 
-// Extrapolate extra first timepoint if needed
+        A = &ap[0];
+    }
+
+    if( isLF && R < nTp ) {
 
-    if( xtra ) {
+        const QVector<uint> &ids = dfImLf[ip]->channelIDs();
 
-        // Point p2 to the LF data for the first X12 timepoint.
-        // Point p1 to the LF data for the previous timepoint.
+        int nK  = ids.size(),
+            nNu = E.imCumTypCnt[CimCfg::imSumNeural];
 
-        qint16  *p2 = S  + nAP,
-                *p1 = p2 - nCh;
+        lf.resize( ((xtra ? 1 : 0) + (nTp - R + 11) / 12) * nK );
+        L = &lf[0];
 
-        D += nAP;   // D offset temporarily to LF channels
+        // Extrapolate extra first timepoint if needed.
+        // Point p2 to the first X12 timepoint.
+        // Point p1 to the previous timepoint.
 
-        for( int lf = 0; lf < nLF; ++lf )
-            D[lf] = p2[lf] - (p2[lf] - p1[lf]) * 12;
+        if( xtra ) {
 
-        D -= nAP;   // D normalized
+            const qint16    *p2 = tpAt( S, N, R, nCh ),
+                            *p1 = tpAt( S, N, R - 1, nCh ),
+                            *p0 = tpAt( S, N, 0, nCh );
 
-        // sync channels
+            for( int ik = 0; ik < nK; ++ik ) {
 
-        for( int is = nAP + nLF; is < nCh; ++is )
-            D[is] = data[is];
+                int c = ids[ik];
 
-        D += nCh;
+                if( c < nNu )
+                    *L++ = p2[c] - (p2[c] - p1[c]) * 12;
+                else
+                    *L++ = p0[c];   // sync
+            }
+        }
     }
 
-// S to D X12 copies
+// One pass: AP in place (or copied out), LF on X12 timepoints
 
-    for( int it = R; it < nTp; it += 12, D += nCh, S += 12*nCh )
-        memcpy( D + nAP, S + nAP, (nCh - nAP) * sizeof(qint16) );
+    if( isAP && (apGather || !inPlace) ) {
 
-    dst->resize( D - &dst->front() );
+        for( int is = 0, it = 0, iLF = R; is < 2; ++is ) {
 
-    if( dst->size() && !dfImLf[ip]->writeAndInvalSubset( p, *dst ) )
-        return false;
+            const qint16    *s = S[is];
 
-    return true;
+            if( !apGather && N[is] ) {
+                memcpy( A, s, N[is] * nCh * sizeof(qint16) );
+                A += N[is] * nCh;
+            }
+
+            if( !apGather && !L ) {
+                it += N[is];
+                continue;
+            }
+
+            for( int i = 0; i < N[is]; ++i, ++it, s += nCh ) {
+
+                if( L && it == iLF ) {
+                    L    = gatherRuns( L, s, lfRuns );
+                    iLF += 12;
+                }
+
+                if( apGather )
+                    A = gatherRuns( A, s, apRuns );
+            }
+        }
+
+        if( inPlace )
+            ap.resize( A - &ap[0] );
+    }
+    else if( L ) {
+
+        for( int it = R; it < nTp; it += 12 )
+            L = gatherRuns( L, tpAt( S, N, it, nCh ), lfRuns );
+    }
 }
 
 
-// Split the data into (AP+SY) and (LF+SY) components,
-// directing each to the appropriate data file.
+// Stamp first sample and epoch on first data, then write
+// gathered blocks. AP files also index the hardware stamps of
+// the fetch blocks written, by file scan.
 //
-// Here, all AP data are written, but only LF samples
-// on X12-boundary (sample%12==0) are written.
-//
-bool TrigBase::writeDataIM( vec_i16 &data, quint64 headCt, uint ip )
+bool TrigBase::putIM(
+    vec_i16     &ap,
+    vec_i16     &lf,
+    quint64     headCt,
+    int         nTp,
+    uint        ip )
 {
     uint    np      = firstCtIm.size();
     bool    isAP    = (ip < np && dfImAp[ip]),
-            isLF    = (ip < np && dfImLf[ip]),
-            xtra    = false;
+            isLF    = (ip < np && dfImLf[ip]);
 
     if( !(isAP || isLF) )
         return true;
 
-    int size = (int)data.size();
+    if( nTp && !epCt[ip] )
+        epCt[ip] = headCt;
 
-    if( size && !firstCtIm[ip] ) {
+    if( nTp && !firstCtIm[ip] ) {
 
         firstCtIm[ip] = headCt;
 
         if( isAP )
             dfImAp[ip]->setFirstSample( headCt );
 
-        if( isLF ) {
+        if( isLF )
+            dfImLf[ip]->setFirstSample( headCt / 12 );
+    }
 
-            if( headCt % 12 ) {
+    if( !nTp )
+        return true;
 
-                // need enough data to extrapolate
+// Write
 
-                int nCh = p.im.each[ip].imCumTypCnt[CimCfg::imSumAll];
+    if( lf.size() && !dfImLf[ip]->writeAndInvalScans( lf ) )
+        return false;
 
-                if( data.size() / nCh > 12 - (headCt % 12) )
-                    xtra = true;
-            }
+    if( isAP ) {
 
-            dfImLf[ip]->setFirstSample( headCt / 12 );
-        }
-    }
+        qint64  s0 = qint64(dfImAp[ip]->scanCount()) - qint64(headCt);
 
-    if( isLF && !writeDataLF( data, headCt, ip, !isAP, xtra ) )
-        return false;
+        vStamp.clear();
+        imQ[ip]->getStamps( vStamp, headCt, headCt + nTp );
 
-    if( isAP && !dfImAp[ip]->writeAndInvalSubset( p, data ) )
-        return false;
+        for( int i = 0, n = vStamp.size(); i < n; ++i ) {
+
+            const AIQ::Stamp    &S = vStamp[i];
+
+            dfImAp[ip]->addStamp( s0 + qint64(S.ct), S.hw, S.t );
+        }
+
+        if( !dfImAp[ip]->writeAndInvalScans( ap ) )
+            return false;
+    }
 
     return true;
 }
@@ -963,11 +1990,20 @@ bool TrigBase::writeDataNI( vec_i16 &data, quint64 headCt )
     if( !dfNi )
         return true;
 
+    if( !epCt[nImQ] && data.size() )
+        epCt[nImQ] = headCt;
+
     if( !firstCtNi && data.size() ) {
         firstCtNi = headCt;
         dfNi->setFirstSample( headCt );
     }
 
+    for( int i = 0, n = niAln.size(); i < n; ++i ) {
+
+        if( !niAln[i]->write( data, headCt, false ) )
+            return false;
+    }
+
     return dfNi->writeAndInvalSubset( p, data );
 }
 
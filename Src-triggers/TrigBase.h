@@ -4,9 +4,18 @@
 #include "DataFileIMAP.h"
 #include "DataFileIMLF.h"
 #include "DataFileNI.h"
+#include "DFEpochs.h"
 #include "Sync.h"
+#include "SampleBufQ.h"
+#include "TaskPool.h"
+
+#include <QSharedPointer>
+#include <QWaitCondition>
+
+#include <atomic>
 
 class GraphsWindow;
+class NiAlign;
 
 class QFileInfo;
 
@@ -14,6 +23,114 @@ class QFileInfo;
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
+// Writers take data in batches of this many ms.
+#define TRWR_BATCH_MS   25
+
+// Shared state of a trigger's imec writer threads.
+//
+// The trigger thread sets counts, then post()s. Each writer
+// then works its own probes, sleeping on their queues between
+// batches, and parks when they're caught up, independent of
+// the other writers. The trigger thread polls isIdle() rather
+// than waiting on writers each loop; while idle, writers don't
+// touch counts, so the trigger thread may read and reset them.
+// hold() parks writers early, e.g. at gate end.
+//
+struct TrWrShared {
+    QMutex          runMtx;
+    QWaitCondition  condWake,
+                    condIdle;
+    quint64         epoch;      // ++ per post()
+    int             nThd,
+                    nIdle,      // parked
+                    nCur,       // parked at current epoch
+                    errors;
+    bool            holding,
+                    stop;
+
+    TrWrShared()
+    :   epoch(0), nThd(0), nIdle(0), nCur(0), errors(0),
+        holding(false), stop(false) {}
+
+    // Writer: park until next post(); false if stopping.
+    bool park( quint64 &wrEpoch, bool ok )
+    {
+        bool    run;
+        runMtx.lock();
+            errors += !ok;
+            nCur   += (wrEpoch == epoch);
+            ++nIdle;
+            condIdle.wakeAll();
+            while( !stop && (holding || wrEpoch == epoch) )
+                condWake.wait( &runMtx );
+            --nIdle;
+            wrEpoch = epoch;
+            run     = !stop;
+        runMtx.unlock();
+        return run;
+    }
+
+    // Writer: wait for a batch past nextCt; false if held.
+    bool pace( const AIQ *Q, quint64 nextCt )
+    {
+        bool    run;
+        Q->waitForCt(
+            nextCt + quint64(0.001 * TRWR_BATCH_MS * Q->sRate()),
+            4 * TRWR_BATCH_MS );
+        runMtx.lock();
+            run = !stop && !holding;
+        runMtx.unlock();
+        return run;
+    }
+
+    void post()
+    {
+        runMtx.lock();
+            holding = false;
+            nCur    = 0;
+            ++epoch;
+        runMtx.unlock();
+        condWake.wakeAll();
+    }
+
+    void hold()
+    {
+        runMtx.lock();
+            holding = true;
+            while( nIdle < nThd )
+                condIdle.wait( &runMtx );
+            nCur = nThd;
+        runMtx.unlock();
+    }
+
+    bool isIdle()
+    {
+        bool    idle;
+        runMtx.lock();
+            idle = nCur >= nThd;
+        runMtx.unlock();
+        return idle;
+    }
+
+    bool isOK()
+    {
+        bool    ok;
+        runMtx.lock();
+            ok = !errors;
+        runMtx.unlock();
+        return ok;
+    }
+
+    void kill()
+    {
+        runMtx.lock();
+            stop = true;
+        runMtx.unlock();
+        condWake.wakeAll();
+    }
+};
+
+
 class TrigBase : public QObject
 {
     Q_OBJECT
@@ -22,7 +139,7 @@ private:
     struct ManOvr {
         int             usrG,
                         usrT;
-        volatile bool   forceGT,
+        bool            forceGT,    // guarded by runMtx
                         gateEnab;
 
         ManOvr( const DAQ::Params &p )
@@ -34,15 +151,50 @@ private:
         void get( int &g, int &t )  {g=usrG,  t=usrT-1, reset();}
     };
 
+    // Write governor state per open file
+    struct WrGov {
+        const DataFile  *df;
+        double          fill,       // last percentFull
+                        slope,      // smoothed fill %/s
+                        wbps;       // smoothed written B/s
+        bool            warned;
+
+        WrGov() : df(0), fill(0), slope(0), wbps(0), warned(false)  {}
+    };
+
+    // Next epoch's files, opened ahead as a pool task under the
+    // G/T the next trigger is expected to get. A trigger that gets
+    // them just restamps the meta; unused ones are deleted.
+    struct PreSet : public PoolTask {
+        TrigBase                    *tb;
+        std::vector<DataFileIMAP*>  ap;
+        std::vector<DataFileIMLF*>  lf;
+        DataFileNI                  *ni;
+        int                         ig,
+                                    it;
+        bool                        ok;
+
+        PreSet( TrigBase *tb, int ig, int it )
+        :   tb(tb), ni(0), ig(ig), it(it), ok(false)   {}
+        virtual ~PreSet();
+
+        void run();
+    };
+
 private:
     std::vector<DataFileIMAP*>  dfImAp;
     std::vector<DataFileIMLF*>  dfImLf;
     DataFileNI                  *dfNi;
+    std::vector<NiAlign*>       niAln;      // nidq on probe clocks
+    DFEpochs                    *epochs;
     ManOvr                      ovr;
+    PreSet                      *pre;       // trigger thread only
+    int                         preGate;    // gate state pre made for
     mutable QMutex              dfMtx;
     mutable QMutex              startTMtx;
     QString                     lastRunDir,
-                                forceName;
+                                forceName,
+                                preStem;    // names of pre's files
     KeyValMap                   kvmRmt;
     double                      startT,     // stream time
                                 gateHiT,    // stream time
@@ -50,16 +202,28 @@ private:
                                 trigHiT,    // stream time
                                 tLastReport;
     std::vector<double>         tLastProf;
+    std::vector<int>            rdrId;
+    std::vector<QSharedPointer<SampleBufPool> > bufPool;    // [ip+1]
+    std::vector<WrGov>          gov;        // [0]=ni, [1+2ip]=ap, [2+2ip]=lf
     std::vector<quint64>        firstCtIm;
+    std::vector<AIQ::Stamp>     vStamp;     // putIM scratch
     quint64                     firstCtNi;
+    std::vector<quint64>        epCt,       // [ip], [nImQ]=ni
+                                epFileCt;   // epoch start in file
     quint32                     offHertz,
                                 offmsec,
                                 onHertz,
                                 onmsec;
+    const AIQ                   *wakeQ;
+    quint64                     wakeCt;
     int                         iGate,
                                 iTrig,
-                                loopPeriod_us;
-    volatile bool               gateHi,
+                                epG,        // open epoch
+                                epT,
+                                epN,        // epochs this gate
+                                loopPeriod_us,
+                                wakeBatch;
+    std::atomic<bool>           gateHi,     // set under runMtx
                                 pleaseStop;
 
 protected:
@@ -84,7 +248,9 @@ public:
         GraphsWindow        *gw,
         const QVector<AIQ*> &imQ,
         const AIQ           *niQ );
-    virtual ~TrigBase() {}
+    virtual ~TrigBase();
+
+    static double secsSinceWrite();
 
     bool allFilesClosed() const;
     bool isInUse( const QFileInfo &fi ) const;
@@ -102,14 +268,19 @@ public:
 
     void setStartT();
     void setGateEnabled( bool enabled );
-    bool isGateHi() const   {QMutexLocker ml( &runMtx ); return gateHi;}
+    bool isGateHi() const
+        {return gateHi.load( std::memory_order_acquire );}
 
-    void stop()             {QMutexLocker ml( &runMtx ); pleaseStop = true;}
-    bool isStopped() const  {QMutexLocker ml( &runMtx ); return pleaseStop;}
+    void stop()
+        {pleaseStop.store( true, std::memory_order_release );}
+    bool isStopped() const
+        {return pleaseStop.load( std::memory_order_acquire );}
 
-    void setGate( bool hi );
+    void setGate( bool hi, double t = -1 );
     void forceGTCounters( int g, int t );
 
+    bool mapStreamCt( double &t, double &now, int ip, quint64 ct ) const;
+
 signals:
     void daqError( const QString &s );
     void finished();
@@ -137,8 +308,13 @@ protected:
             return ++iTrig;
         }
 
+    // False if the mode's trigger count in this gate is used up,
+    // counting the one in progress. Trigger thread only.
+    virtual bool moreTrigsInGate() const    {return true;}
+
     void endTrig();
     bool newTrig( int &ig, int &it, bool trigLED = true );
+    void epochNext();
     void setSyncWriteMode();
     bool nScansFromCt(
         vec_i16     &data,
@@ -150,22 +326,62 @@ protected:
         uint        ip,
         vec_i16     &data,
         quint64     headCt );
+    bool writeViewFromCt(
+        DstStream   dst,
+        uint        ip,
+        quint64     &nextCt,
+        int         nMax );
     quint64 scanCount( DstStream dst );
     void endRun( const QString &err );
     void statusOnSince( QString &s );
     void statusWrPerf( QString &s );
     void setYieldPeriod_ms( int loopPeriod_ms );
+    void setYieldWake( const AIQ *Q, int minBatch_ms );
     void yield( double loopT );
 
 private:
-    bool openFile( DataFile *df, int ig, int it );
-    bool writeDataLF(
-        vec_i16     &data,
-        quint64     headCt,
+    bool govern(
+        WrGov           &G,
+        const DataFile  *df,
+        double          fill,
+        double          bps,
+        double          dt );
+    double epochSecs() const;
+    bool openFile(
+        DataFile        *df,
+        int             ig,
+        int             it,
+        const QString   &name );
+    void fileSetup( DataFile *df, bool prealloc = true );
+    bool nextGT( int &ig, int &it ) const;
+    void prepNext();
+    PreSet *takePre( int ig, int it );
+    void dropPre();
+    void openNiAlign();
+    void closeNiAlign( bool async );
+    quint64 epochFileCt( int is ) const;
+    void epochAdd();
+    void profileLag( double pct, double tProf, int ip );
+    bool writeView(
+        DstStream   dst,
         uint        ip,
-        bool        inplace,
-        bool        xtra );
+        quint64     &nextCt,
+        int         nMax );
     bool writeDataIM( vec_i16 &data, quint64 headCt, uint ip );
+    void gatherIM(
+        vec_i16             &ap,
+        vec_i16             &lf,
+        const qint16* const S[2],
+        const int           N[2],
+        quint64             headCt,
+        uint                ip,
+        bool                inPlace );
+    bool putIM(
+        vec_i16     &ap,
+        vec_i16     &lf,
+        quint64     headCt,
+        int         nTp,
+        uint        ip );
     bool writeDataNI( vec_i16 &data, quint64 headCt );
 };
 
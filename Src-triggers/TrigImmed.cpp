@@ -2,11 +2,14 @@
 #include "TrigImmed.h"
 #include "Util.h"
 #include "DataFile.h"
+#include "RunBench.h"
+#include "ThdPlace.h"
 
 #include <QThread>
 
 
 #define LOOP_MS     100
+#define WAKE_MS     25      // write batch
 
 
 static TrigImmed    *ME;
@@ -18,6 +21,8 @@ static TrigImmed    *ME;
 
 void TrImmWorker::run()
 {
+    ThdPlace::apply( ThdPlace::roleTrigWrk );
+
     const int   nID = vID.size();
     bool        ok  = true;
 
@@ -33,26 +38,14 @@ void TrImmWorker::run()
         }
     }
 
+    RunBench::addCPU( RunBench::stgTrig );
     emit finished();
 }
 
 
 bool TrImmWorker::writeSomeIM( int ip )
 {
-    vec_i16 data;
-    quint64 headCt = shr.imNextCt[ip];
-
-    if( !ME->nScansFromCt( data, headCt, -LOOP_MS, ip ) )
-        return false;
-
-    uint    size = data.size();
-
-    if( !size )
-        return true;
-
-    shr.imNextCt[ip] += size / imQ[ip]->nChans();
-
-    return ME->writeAndInvalData( ME->DstImec, ip, data, headCt );
+    return ME->writeViewFromCt( ME->DstImec, ip, shr.imNextCt[ip], -LOOP_MS );
 }
 
 /* ---------------------------------------------------------------- */
@@ -97,6 +90,8 @@ TrImmThread::~TrImmThread()
 //
 void TrigImmed::run()
 {
+    ThdPlace::apply( ThdPlace::roleTrig );
+
     Debug() << "Trigger thread started.";
 
 // ---------
@@ -148,6 +143,7 @@ void TrigImmed::run()
 // -----
 
     setYieldPeriod_ms( LOOP_MS );
+    setYieldWake( vS[0].Q, WAKE_MS );
 
     while( !isStopped() ) {
 
@@ -261,20 +257,7 @@ bool TrigImmed::writeSomeNI( quint64 &nextCt )
     if( !niQ )
         return true;
 
-    vec_i16 data;
-    quint64 headCt = nextCt;
-
-    if( !nScansFromCt( data, headCt, -LOOP_MS, -1 ) )
-        return false;
-
-    uint    size = data.size();
-
-    if( !size )
-        return true;
-
-    nextCt += size / niQ->nChans();
-
-    return writeAndInvalData( DstNidq, 0, data, headCt );
+    return writeViewFromCt( DstNidq, 0, nextCt, -LOOP_MS );
 }
 
 
@@ -109,6 +109,9 @@ public slots:
     virtual void run();
 
 private:
+    // One file per gate
+    virtual bool moreTrigsInGate() const    {return false;}
+
     bool alignFiles(
         std::vector<quint64>    &imNextCt,
         quint64                 &niNextCt,
@@ -1,16 +1,28 @@
 
 #include "TrigSpike.h"
 #include "Util.h"
+#include "RunBench.h"
 #include "Biquad.h"
+#include "FltStream.h"
 #include "MainApp.h"
 #include "Run.h"
 #include "GraphsWindow.h"
+#include "Subset.h"
+#include "ThdPlace.h"
 
 #include <QTimer>
 #include <QThread>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SPK_SSE2
+#endif
+
 
 #define LOOP_MS     100
+#define WAKE_MS     5       // spike search batch
+#define MULTI_BLK   512     // scans per MultiDetect block
+#define EVQ_MAX     8       // edges found ahead of writing
 
 
 static TrigSpike    *ME;
@@ -20,23 +32,43 @@ static TrigSpike    *ME;
 /* TrSpkWorker ---------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
+// Each post() runs our probes until they're caught up,
+// pacing on the first one still busy.
+//
 void TrSpkWorker::run()
 {
-    const int   nID = vID.size();
-    bool        ok  = true;
+    ThdPlace::apply( ThdPlace::roleTrigWrk );
 
-    for(;;) {
+    const int   nID     = vID.size();
+    quint64     epoch   = 0;
+    bool        ok      = true;
 
-        if( !shr.wake( ok ) )
-            break;
+    while( shr.park( epoch, ok ) ) {
 
-        for( int iID = 0; iID < nID; ++iID ) {
+        for(;;) {
 
-            if( !(ok = writeSomeIM( vID[iID] )) )
+            int ipBusy = -1;
+
+            for( int iID = 0; iID < nID; ++iID ) {
+
+                int ip = vID[iID];
+
+                if( !(ok = writeSomeIM( ip )) )
+                    break;
+
+                if( ipBusy < 0 && isBusy( ip ) )
+                    ipBusy = ip;
+            }
+
+            if( !ok || ipBusy < 0 )
+                break;
+
+            if( !shr.pace( imQ[ipBusy], ME->imCnt.nextCt[ipBusy] ) )
                 break;
         }
     }
 
+    RunBench::addCPU( RunBench::stgTrig );
     emit finished();
 }
 
@@ -70,6 +102,14 @@ bool TrSpkWorker::writeSomeIM( int ip )
     return ME->writeAndInvalData( ME->DstImec, ip, data, headCt );
 }
 
+
+// Return true if probe has more to write this post.
+//
+bool TrSpkWorker::isBusy( int ip )
+{
+    return ME->imCnt.remCt[ip] > 0;
+}
+
 /* ---------------------------------------------------------------- */
 /* TrSpkThread ---------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -117,6 +157,9 @@ TrSpkThread::~TrSpkThread()
 // filter to reset its 'zero' counter to BIQUAD_TRANS_WIDE. We'll
 // have the filter zero that many leading data points.
 
+// The highpass is followed by the stream's configured line
+// notches, if any, so threshold crossings aren't driven by hum.
+//
 TrigSpike::HiPassFnctr::HiPassFnctr( const DAQ::Params &p )
 {
     fltbuf.resize( nmax = 256 );
@@ -128,7 +171,9 @@ TrigSpike::HiPassFnctr::HiPassFnctr( const DAQ::Params &p )
 
         if( chan < p.ni.niCumTypCnt[CniCfg::niSumNeural] ) {
 
-            flt     = new Biquad( bq_type_highpass, 300/p.ni.srate );
+            band    = BiquadBand( 300, 0, p.ni.fltNotchHz, p.ni.fltNotchN );
+            flt     = new BiquadCascade;
+            flt->addBand( band, p.ni.srate );
             maxInt  = 32768;
         }
     }
@@ -142,7 +187,11 @@ TrigSpike::HiPassFnctr::HiPassFnctr( const DAQ::Params &p )
 
         if( chan < E.imCumTypCnt[CimCfg::imSumAP] ) {
 
-            flt     = new Biquad( bq_type_highpass, 300/E.srate );
+            band    = BiquadBand(
+                        300, 0,
+                        p.im.all.fltNotchHz, p.im.all.fltNotchN );
+            flt     = new BiquadCascade;
+            flt->addBand( band, E.srate );
             maxInt  = E.roTbl->maxInt();
         }
     }
@@ -168,7 +217,7 @@ void TrigSpike::HiPassFnctr::operator()( int nflt )
 {
     if( flt ) {
 
-        flt->apply1BlockwiseMem1( &fltbuf[0], maxInt, nflt, 1, 0 );
+        flt->applyBlockwiseMem( &fltbuf[0], maxInt, nflt, 1, 0, 1 );
 
         if( nzero > 0 ) {
 
@@ -183,6 +232,262 @@ void TrigSpike::HiPassFnctr::operator()( int nflt )
     }
 }
 
+/* ---------------------------------------------------------------- */
+/* struct MultiDetect --------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Same band (and transient strategy) as HiPassFnctr, applied to
+// those chans in the filtered range; sorted chans makes those a
+// leading run [0,nFlt). Thresholds are per chan (gains differ).
+// Pad lanes get T = -32768, so are never below.
+//
+TrigSpike::MultiDetect::MultiDetect( const DAQ::Params &p )
+    :   flt(0), nextCt(0), nFlt(0)
+{
+    QVector<uint>   vc;
+    BiquadBand      band;
+    double          srate;
+    int             nS,
+                    nFltLim;
+
+    Subset::rngStr2Vec( vc, p.trgSpike.chans );
+    chans.assign( vc.begin(), vc.end() );
+
+    nS      = chans.size();
+    nPad    = (nS + 7) & ~7;
+
+    T.assign( nPad, -32768 );
+
+    if( p.trgSpike.stream == "nidq" ) {
+
+        band    = BiquadBand( 300, 0, p.ni.fltNotchHz, p.ni.fltNotchN );
+        srate   = p.ni.srate;
+        nFltLim = p.ni.niCumTypCnt[CniCfg::niSumNeural];
+        maxInt  = 32768;
+
+        for( int i = 0; i < nS; ++i ) {
+            T[i] = qBound( -32768,
+                    p.ni.vToInt16( p.trgSpike.T, chans[i] ), 32767 );
+        }
+    }
+    else {
+
+        const CimCfg::AttrEach  &E =
+                p.im.each[p.streamID( p.trgSpike.stream )];
+
+        band    = BiquadBand(
+                    300, 0,
+                    p.im.all.fltNotchHz, p.im.all.fltNotchN );
+        srate   = E.srate;
+        nFltLim = E.imCumTypCnt[CimCfg::imSumAP];
+        maxInt  = E.roTbl->maxInt();
+
+        for( int i = 0; i < nS; ++i ) {
+            T[i] = qBound( -32768,
+                    E.vToInt( p.trgSpike.T, chans[i] ), 32767 );
+        }
+    }
+
+    while( nFlt < nS && chans[nFlt] < nFltLim )
+        ++nFlt;
+
+    if( nFlt ) {
+        flt = new BiquadCascade;
+        flt->addBand( band, srate );
+    }
+
+    blk.assign( MULTI_BLK * nPad, 0 );
+    reset();
+}
+
+
+TrigSpike::MultiDetect::~MultiDetect()
+{
+    if( flt )
+        delete flt;
+}
+
+
+void TrigSpike::MultiDetect::reset()
+{
+    run.assign( nPad, 0 );
+    armed.assign( nPad, 0 );
+    nzero = BIQUAD_TRANS_WIDE;
+
+    if( flt )
+        flt->clearMem();
+}
+
+
+// Like AIQ::findFltFallingEdge(): each chan must first be seen
+// at or above T, then stay below T for inarow samples. State
+// carries across calls that resume at the returned outCt; any
+// other fromCt restarts the search (and filter transient).
+//
+// Return:
+// false = no edge; resume looking from outCt.
+// true  = edge @ outCt.
+//
+bool TrigSpike::MultiDetect::find(
+    quint64     &outCt,
+    quint64     fromCt,
+    const AIQ   *Q,
+    int         inarow )
+{
+    if( fromCt != nextCt ) {
+        reset();
+        nextCt = fromCt;
+    }
+
+    const int   nC = Q->nChans(),
+                nS = chans.size();
+
+    for(;;) {
+
+        AIQ::View   V;
+
+        if( Q->getView( V, nextCt, MULTI_BLK ) < 0 )
+            goto lapped;
+
+        int n = V.nScans();
+
+        if( !n )
+            break;
+
+        // Gather set
+
+        qint16  *dst = &blk[0];
+
+        for( int is = 0; is < 2; ++is ) {
+
+            const qint16    *src = V.span[is];
+
+            for( int it = 0; it < V.nspan[is]; ++it ) {
+
+                for( int i = 0; i < nS; ++i )
+                    dst[i] = src[chans[i]];
+
+                src += nC;
+                dst += nPad;
+            }
+        }
+
+        if( !Q->isIntact( V ) )
+            goto lapped;
+
+        // Filter
+
+        if( flt ) {
+
+            flt->applyBlockwiseMem( &blk[0], maxInt, n, nPad, 0, nFlt );
+
+            if( nzero > 0 ) {
+
+                // overwrite with zeros
+
+                int nz = qMin( n, nzero );
+
+                for( int it = 0; it < nz; ++it )
+                    memset( &blk[it*nPad], 0, nFlt*sizeof(qint16) );
+
+                nzero -= nz;
+            }
+        }
+
+        // Threshold
+
+        int it = thresh( n, inarow );
+
+        if( it >= 0 ) {
+            outCt = nextCt + it - (inarow - 1);
+            return true;
+        }
+
+        nextCt += n;
+    }
+
+    outCt = nextCt;
+    return false;
+
+lapped:
+    reset();
+    outCt = nextCt = Q->qHeadCt();
+    return false;
+}
+
+
+// Step run lengths over rows [0,n) of blk.
+//
+// Return first row at which any chan completes inarow
+// samples below T, else -1.
+//
+int TrigSpike::MultiDetect::thresh( int n, int inarow )
+{
+    const qint16    *row    = &blk[0],
+                    *vT     = &T[0];
+    qint16          *R      = &run[0],
+                    *A      = &armed[0],
+                    lim     = qint16(qMin( inarow, 32767 ));
+
+#ifdef SPK_SSE2
+    const __m128i   vOne    = _mm_set1_epi16( 1 ),
+                    vAll    = _mm_set1_epi16( -1 ),
+                    vLim    = _mm_set1_epi16( lim - 1 );
+#endif
+
+    for( int it = 0; it < n; ++it, row += nPad ) {
+
+#ifdef SPK_SSE2
+        __m128i vDone = _mm_setzero_si128();
+
+        for( int i = 0; i < nPad; i += 8 ) {
+
+            __m128i lt  = _mm_cmplt_epi16(
+                            _mm_loadu_si128( (const __m128i*)&row[i] ),
+                            _mm_loadu_si128( (const __m128i*)&vT[i] ) ),
+                    a   = _mm_or_si128(
+                            _mm_loadu_si128( (const __m128i*)&A[i] ),
+                            _mm_andnot_si128( lt, vAll ) ),
+                    r   = _mm_and_si128(
+                            _mm_add_epi16(
+                                _mm_loadu_si128( (const __m128i*)&R[i] ),
+                                vOne ),
+                            _mm_and_si128( lt, a ) );
+
+            _mm_storeu_si128( (__m128i*)&A[i], a );
+            _mm_storeu_si128( (__m128i*)&R[i], r );
+
+            vDone = _mm_or_si128( vDone, _mm_cmpgt_epi16( r, vLim ) );
+        }
+
+        if( _mm_movemask_epi8( vDone ) )
+            return it;
+#else
+        bool    done = false;
+
+        for( int i = 0; i < nPad; ++i ) {
+
+            if( row[i] < vT[i] ) {
+
+                R[i] = (A[i] ? R[i] + 1 : 0);
+
+                if( R[i] >= lim )
+                    done = true;
+            }
+            else {
+                A[i] = -1;
+                R[i] = 0;
+            }
+        }
+
+        if( done )
+            return it;
+#endif
+    }
+
+    return -1;
+}
+
 /* ---------------------------------------------------------------- */
 /* CountsIm ------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -218,6 +523,17 @@ void TrigSpike::CountsIm::setupWrite( const std::vector<quint64> &vEdge )
 }
 
 
+// Stretch current windows to end at vEdge's windows' ends.
+//
+void TrigSpike::CountsIm::extend( const std::vector<quint64> &vEdge )
+{
+    for( int ip = 0; ip < np; ++ip ) {
+        remCt[ip] = qint64(vEdge[offset+ip] + periEvtCt[ip] + 1)
+                    - qint64(nextCt[ip]);
+    }
+}
+
+
 quint64 TrigSpike::CountsIm::minCt( int ip )
 {
     return periEvtCt[ip] + latencyCt[ip];
@@ -257,6 +573,15 @@ void TrigSpike::CountsNi::setupWrite(
 }
 
 
+void TrigSpike::CountsNi::extend(
+    const std::vector<quint64>  &vEdge,
+    bool                        enabled )
+{
+    if( enabled )
+        remCt = qint64(vEdge[0] + periEvtCt + 1) - qint64(nextCt);
+}
+
+
 quint64 TrigSpike::CountsNi::minCt()
 {
     return periEvtCt + latencyCt;
@@ -273,12 +598,26 @@ TrigSpike::TrigSpike(
     const AIQ           *niQ )
     :   TrigBase( p, gw, imQ, niQ ),
         usrFlt(new HiPassFnctr( p )),
+        multi(p.trgSpike.chans.isEmpty() ? 0 : new MultiDetect( p )),
+        fltQ(0),
         imCnt( p ),
         niCnt( p ),
         spikesMax(p.trgSpike.isNInf ? UNSET64 : p.trgSpike.nS),
         aEdgeCtNext(0),
-        thresh(p.trigThreshAsInt())
+        thresh(p.trigThreshAsInt()),
+        iSrc(p.trgSpike.stream == "nidq" ? 0 :
+            (niQ ? 1 : 0) + p.streamID( p.trgSpike.stream ))
 {
+// If the run filters our stream in a shared stage, search that
+// rather than highpassing the trigger channel privately.
+
+    if( usrFlt->flt ) {
+
+        fltQ = FltStream::find(
+                (p.trgSpike.stream == "nidq" ?
+                    niQ : imQ[p.streamID( p.trgSpike.stream )]),
+                usrFlt->band );
+    }
 }
 
 
@@ -293,6 +632,8 @@ TrigSpike::TrigSpike(
 //
 void TrigSpike::run()
 {
+    ThdPlace::apply( ThdPlace::roleTrig );
+
     Debug() << "Trigger thread started.";
 
 // ---------
@@ -326,21 +667,20 @@ void TrigSpike::run()
         ++nThd;
     }
 
-// Wait for threads to reach ready (sleep) state
+// Wait for threads to reach ready (parked) state
 
-    shr.runMtx.lock();
-        while( shr.asleep < nThd ) {
-            shr.runMtx.unlock();
-                QThread::usleep( 10 );
-            shr.runMtx.lock();
-        }
-    shr.runMtx.unlock();
+    shr.nThd = nThd;
+    shr.hold();
 
 // -----
 // Start
 // -----
 
     setYieldPeriod_ms( LOOP_MS );
+    setYieldWake(
+        (p.trgSpike.stream == "nidq" ?
+        niQ : imQ[p.streamID( p.trgSpike.stream )]),
+        WAKE_MS );
 
     initState();
 
@@ -359,6 +699,7 @@ void TrigSpike::run()
 
         if( inactive ) {
 
+            shr.hold();
             initState();
             goto next_loop;
         }
@@ -369,22 +710,8 @@ void TrigSpike::run()
 
         if( ISSTATE_GetEdge ) {
 
-            if( p.trgSpike.stream == "nidq" ) {
-
-                if( !getEdge( 0 ) )
-                    goto next_loop;
-            }
-            else {
-
-                int iSrc = (niQ ? 1 : 0) + p.streamID( p.trgSpike.stream );
-
-                if( !getEdge( iSrc ) )
-                    goto next_loop;
-            }
-
-            QMetaObject::invokeMethod(
-                gw, "blinkTrigger",
-                Qt::QueuedConnection );
+            if( evQ.empty() && !seekEdge() )
+                goto next_loop;
 
             // ---------------
             // Start new files
@@ -413,30 +740,26 @@ void TrigSpike::run()
             if( !xferAll( shr, err ) )
                 break;
 
+            // Detection runs ahead of writing
+
+            if( nSpikes < spikesMax && evQ.size() < EVQ_MAX )
+                seekEdge();
+
+            if( p.trgSpike.merge && shr.isIdle() )
+                mergeQueued();
+
             // -----
             // Done?
             // -----
 
-            if( niCnt.remCt <= 0 && imCnt.remCtDone() ) {
+            if( niCnt.remCt <= 0 && shr.isIdle() && imCnt.remCtDone() ) {
 
                 endTrig();
 
-                if( ++nSpikes >= spikesMax )
+                if( nSpikes >= spikesMax && evQ.empty() )
                     SETSTATE_Done();
-                else {
-
-                    usrFlt->reset();
-
-                    for( int is = 0, ns = vS.size(); is < ns; ++is ) {
-
-                        if( vS[is].ip >= 0 )
-                            vEdge[is] += imCnt.refracCt[is];
-                        else
-                            vEdge[is] += niCnt.refracCt;
-                    }
-
+                else
                     SETSTATE_GetEdge();
-                }
             }
         }
 
@@ -479,17 +802,32 @@ next_loop:
 }
 
 
+// More spikes may be detected, or some are queued beyond the
+// one being written (still the queue front until Write starts).
+//
+bool TrigSpike::moreTrigsInGate() const
+{
+    if( ISSTATE_Done )
+        return false;
+
+    if( nSpikes < spikesMax )
+        return true;
+
+    return evQ.size() > (ISSTATE_GetEdge ? 1U : 0U);
+}
+
+
 void TrigSpike::SETSTATE_GetEdge()
 {
-    aEdgeCtNext = 0;
-    state       = 0;
+    state = 0;
 }
 
 
 void TrigSpike::SETSTATE_Write()
 {
-    imCnt.setupWrite( vEdge );
-    niCnt.setupWrite( vEdge, niQ != 0 );
+    imCnt.setupWrite( evQ.front() );
+    niCnt.setupWrite( evQ.front(), niQ != 0 );
+    evQ.pop_front();
 
     state = 1;
 }
@@ -506,7 +844,9 @@ void TrigSpike::initState()
 {
     usrFlt->reset();
     vEdge.clear();
-    nSpikes = 0;
+    evQ.clear();
+    aEdgeCtNext = 0;
+    nSpikes     = 0;
     SETSTATE_GetEdge();
 }
 
@@ -544,6 +884,31 @@ bool TrigSpike::getEdge( int iSrc )
 
     if( aEdgeCtNext )
         found = true;
+    else if( multi ) {
+        found = multi->find(
+                    aEdgeCtNext,
+                    vEdge[iSrc],
+                    vS[iSrc].Q,
+                    p.trgSpike.inarow );
+
+        if( !found ) {
+            vEdge[iSrc] = aEdgeCtNext;  // pick up search here
+            aEdgeCtNext = 0;
+        }
+    }
+    else if( fltQ ) {
+        found = fltQ->findFallingEdge(
+                    aEdgeCtNext,
+                    vEdge[iSrc],
+                    usrFlt->chan,
+                    thresh,
+                    p.trgSpike.inarow );
+
+        if( !found ) {
+            vEdge[iSrc] = aEdgeCtNext;  // pick up search here
+            aEdgeCtNext = 0;
+        }
+    }
     else {
         found = vS[iSrc].Q->findFltFallingEdge(
                     aEdgeCtNext,
@@ -583,6 +948,72 @@ bool TrigSpike::getEdge( int iSrc )
 }
 
 
+// Queue next edge, if found, and move the search cursor
+// past its refractory period.
+//
+// Return true if found.
+//
+bool TrigSpike::seekEdge()
+{
+    if( !getEdge( iSrc ) )
+        return false;
+
+    QMetaObject::invokeMethod(
+        gw, "blinkTrigger",
+        Qt::QueuedConnection );
+
+    evQ.push_back( vEdge );
+    ++nSpikes;
+
+    usrFlt->reset();
+
+    for( int is = 0, ns = vS.size(); is < ns; ++is ) {
+
+        if( vS[is].ip >= 0 )
+            vEdge[is] += imCnt.refracCt[vS[is].ip];
+        else
+            vEdge[is] += niCnt.refracCt;
+    }
+
+    aEdgeCtNext = 0;
+
+    return true;
+}
+
+
+// Extend the current write over queued edges whose windows
+// overlap or abut it, judged in the trigger stream. Counts
+// are set only while imec writers are idle.
+//
+void TrigSpike::mergeQueued()
+{
+    const SyncStream    &S = vS[iSrc];
+
+    while( !evQ.empty() ) {
+
+        const std::vector<quint64>  &E = evQ.front();
+        quint64                     start,
+                                    end;
+
+        if( S.ip >= 0 ) {
+            start   = E[iSrc] - imCnt.periEvtCt[S.ip];
+            end     = imCnt.nextCt[S.ip] + qMax( imCnt.remCt[S.ip], qint64(0) );
+        }
+        else {
+            start   = E[iSrc] - niCnt.periEvtCt;
+            end     = niCnt.nextCt + qMax( niCnt.remCt, qint64(0) );
+        }
+
+        if( start > end )
+            break;
+
+        imCnt.extend( E );
+        niCnt.extend( E, niQ != 0 );
+        evQ.pop_front();
+    }
+}
+
+
 bool TrigSpike::writeSomeNI()
 {
     if( !niQ )
@@ -615,37 +1046,26 @@ bool TrigSpike::writeSomeNI()
 }
 
 
+// Imec writers are posted new work only when all are idle and
+// counts say there's more to do; otherwise they carry on alone,
+// and we don't wait for them.
+//
 // Return true if no errors.
 //
 bool TrigSpike::xferAll( TrSpkShared &shr, QString &err )
 {
     bool    niOK;
 
-    shr.awake   = 0;
-    shr.asleep  = 0;
-    shr.errors  = 0;
+// Post imec threads
 
-// Wake all imec threads
-
-    shr.condWake.wakeAll();
+    if( shr.isIdle() && !imCnt.remCtDone() )
+        shr.post();
 
 // Do nidq locally
 
     niOK = writeSomeNI();
 
-// Wait all threads started, and all done
-
-    shr.runMtx.lock();
-        while( shr.awake  < nThd
-            || shr.asleep < nThd ) {
-
-            shr.runMtx.unlock();
-                QThread::msleep( LOOP_MS/8 );
-            shr.runMtx.lock();
-        }
-    shr.runMtx.unlock();
-
-    if( niOK && !shr.errors )
+    if( niOK && shr.isOK() )
         return true;
 
     err = "write failed";
@@ -2,47 +2,18 @@
 #define TRIGSPIKE_H
 
 #include "TrigBase.h"
+#include "Biquad.h"
 
-#include <QWaitCondition>
-
-class Biquad;
+#include <deque>
 
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
-struct TrSpkShared {
+struct TrSpkShared : public TrWrShared {
     const DAQ::Params   &p;
-    QMutex              runMtx;
-    QWaitCondition      condWake;
-    int                 awake,
-                        asleep,
-                        errors;
-    bool                stop;
-
-    TrSpkShared( const DAQ::Params &p )
-    :   p(p), awake(0), asleep(0), stop(false)  {}
-
-    bool wake( bool ok )
-    {
-        bool    run;
-        runMtx.lock();
-            errors += !ok;
-            ++asleep;
-            condWake.wait( &runMtx );
-            ++awake;
-            run = !stop;
-        runMtx.unlock();
-        return run;
-    }
-
-    void kill()
-    {
-        runMtx.lock();
-            stop = true;
-        runMtx.unlock();
-        condWake.wakeAll();
-    }
+
+    TrSpkShared( const DAQ::Params &p ) : TrWrShared(), p(p)    {}
 };
 
 
@@ -71,6 +42,7 @@ public slots:
 
 private:
     bool writeSomeIM( int ip );
+    bool isBusy( int ip );
 };
 
 
@@ -97,9 +69,10 @@ class TrigSpike : public TrigBase
 
 private:
     struct HiPassFnctr : public AIQ::T_AIQFilter {
-        Biquad  *flt;
-        int     maxInt,
-                nzero;
+        BiquadCascade   *flt;
+        BiquadBand      band;
+        int             maxInt,
+                        nzero;
         HiPassFnctr( const DAQ::Params &p );
         virtual ~HiPassFnctr();
 
@@ -107,6 +80,35 @@ private:
         void operator()( int nflt );
     };
 
+    // Detector over a channel set of the source stream: blocks
+    // are read in place, the set gathered, highpassed together
+    // and thresholded a row at a time, taking the earliest
+    // crossing on any channel. Rows are padded to nPad lanes.
+    struct MultiDetect {
+        BiquadCascade       *flt;
+        std::vector<int>    chans;
+        vec_i16             blk,
+                            T,      // per chan
+                            run,    // samples in a row < T
+                            armed;  // -1 once seen >= T
+        quint64             nextCt;
+        int                 nPad,
+                            nFlt,   // leading chans filtered
+                            maxInt,
+                            nzero;
+        MultiDetect( const DAQ::Params &p );
+        virtual ~MultiDetect();
+
+        void reset();
+        bool find(
+            quint64     &outCt,
+            quint64     fromCt,
+            const AIQ   *Q,
+            int         inarow );
+    private:
+        int thresh( int n, int inarow );
+    };
+
     struct CountsIm {
         // variable -------------------
         std::vector<quint64>    nextCt;
@@ -121,6 +123,7 @@ private:
         CountsIm( const DAQ::Params &p );
 
         void setupWrite( const std::vector<quint64> &vEdge );
+        void extend( const std::vector<quint64> &vEdge );
         quint64 minCt( int ip );
         bool remCtDone();
     };
@@ -139,18 +142,25 @@ private:
         void setupWrite(
             const std::vector<quint64>  &vEdge,
             bool                        enabled );
+        void extend(
+            const std::vector<quint64>  &vEdge,
+            bool                        enabled );
 
         quint64 minCt();
     };
 
 private:
     HiPassFnctr             *usrFlt;
+    MultiDetect             *multi; // if channel set, else 0
+    const AIQ               *fltQ;  // shared stage with our band, if any
     CountsIm                imCnt;
     CountsNi                niCnt;
-    std::vector<quint64>    vEdge;
+    std::vector<quint64>    vEdge;  // search cursor, then found edge
+    std::deque<std::vector<quint64> > evQ;  // found, not yet written
     const qint64            spikesMax;
     quint64                 aEdgeCtNext;
-    const int               thresh;
+    const int               thresh,
+                            iSrc;   // vS index of trigger stream
     int                     nThd,
                             nSpikes,
                             state;
@@ -161,18 +171,22 @@ public:
         GraphsWindow        *gw,
         const QVector<AIQ*> &imQ,
         const AIQ           *niQ );
-    virtual ~TrigSpike()    {delete usrFlt;}
+    virtual ~TrigSpike()    {delete usrFlt; delete multi;}
 
 public slots:
     virtual void run();
 
 private:
+    virtual bool moreTrigsInGate() const;
+
     void SETSTATE_GetEdge();
     void SETSTATE_Write();
     void SETSTATE_Done();
     void initState();
 
     bool getEdge( int iSrc );
+    bool seekEdge();
+    void mergeQueued();
 
     bool writeSomeNI();
 
@@ -1,11 +1,14 @@
 
 #include "TrigTCP.h"
 #include "Util.h"
+#include "RunBench.h"
+#include "ThdPlace.h"
 
 #include <QThread>
 
 
 #define LOOP_MS     100
+#define WAKE_MS     25      // write batch
 
 
 static TrigTCP      *ME;
@@ -17,6 +20,8 @@ static TrigTCP      *ME;
 
 void TrTCPWorker::run()
 {
+    ThdPlace::apply( ThdPlace::roleTrigWrk );
+
     const int   nID = vID.size();
     bool        ok  = true;
 
@@ -37,6 +42,7 @@ void TrTCPWorker::run()
         }
     }
 
+    RunBench::addCPU( RunBench::stgTrig );
     emit finished();
 }
 
@@ -79,9 +85,13 @@ bool TrTCPWorker::writeRemIM( int ip, double tlo )
     if( !ME->nScansFromCt( data, headCt, nMax, ip ) )
         return false;
 
-    if( !data.size() )
+    uint    size = data.size();
+
+    if( !size )
         return true;
 
+    shr.imNextCt[ip] += size / imQ[ip]->nChans();
+
     return ME->writeAndInvalData( ME->DstImec, ip, data, headCt );
 }
 
@@ -122,22 +132,33 @@ TrTCPThread::~TrTCPThread()
 /* TrigTCP -------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
-void TrigTCP::rgtSetTrig( bool hi )
+// Edge time t (stream time) or if t < 0, now.
+//
+// Each completed pulse is queued, so pulses shorter than the
+// write loop, or arriving before the previous one is closed,
+// each still get their own files.
+//
+void TrigTCP::rgtSetTrig( bool hi, double t )
 {
     runMtx.lock();
 
+    if( t < 0 )
+        t = nowCalibrated();
+
     if( hi ) {
 
         if( _trigHi )
             Error() << "SetTrig(HI) twice in a row...ignoring second.";
         else
-            _trigHiT = nowCalibrated();
+            _trigHiT = t;
     }
     else {
-        _trigLoT = nowCalibrated();
+        _trigLoT = t;
 
         if( !_trigHi )
             Error() << "SetTrig(LO) twice in a row.";
+        else
+            pulses.push_back( Pulse( _trigHiT, t ) );
     }
 
     _trigHi = hi;
@@ -150,6 +171,8 @@ void TrigTCP::rgtSetTrig( bool hi )
 //
 void TrigTCP::run()
 {
+    ThdPlace::apply( ThdPlace::roleTrig );
+
     Debug() << "Trigger thread started.";
 
 // ---------
@@ -200,6 +223,7 @@ void TrigTCP::run()
 // -----
 
     setYieldPeriod_ms( LOOP_MS );
+    setYieldWake( vS[0].Q, WAKE_MS );
 
     QString err;
 
@@ -211,15 +235,37 @@ void TrigTCP::run()
         // If finishing up
         // ---------------
 
-        if( !isGateHi() || !isTrigHi() ) {
+        if( !isGateHi() || isTrigEnding() ) {
+
+            bool    ready, done;
+
+            if( allFilesClosed() ) {
 
-            if( allFilesClosed() )
+                if( !isGateHi() ) {
+                    dropPulses();
+                    goto next_loop;
+                }
+
+                if( !hasPulse() )
+                    goto next_loop;
+            }
+
+            // Pulse may have ended before its files were open
+
+            if( !allOpenAlign( shr, niNextCt, ready, err ) )
+                break;
+
+            if( !ready )
                 goto next_loop;
 
-            if( !allFinalWrite( shr, niNextCt, err ) )
+            if( !allFinalWrite( shr, niNextCt, done, err ) )
                 break;
 
+            if( !done )
+                goto next_loop;
+
             endTrig();
+            popPulse();
             goto next_loop;
         }
 
@@ -356,15 +402,20 @@ bool TrigTCP::writeRemNI( quint64 &nextCt, double tlo )
         return true;
 
     vec_i16 data;
-    int     nMax = spnCt - curCt;
+    quint64 headCt  = nextCt;
+    int     nMax    = spnCt - curCt;
 
-    if( !nScansFromCt( data, nextCt, nMax, -1 ) )
+    if( !nScansFromCt( data, headCt, nMax, -1 ) )
         return false;
 
-    if( !data.size() )
+    uint    size = data.size();
+
+    if( !size )
         return true;
 
-    return writeAndInvalData( DstNidq, 0, data, nextCt );
+    nextCt += size / niQ->nChans();
+
+    return writeAndInvalData( DstNidq, 0, data, headCt );
 }
 
 
@@ -414,13 +465,19 @@ bool TrigTCP::xferAll(
 }
 
 
+// Open files if closed and seek common sync time.
+// Set ready true once aligned.
+//
 // Return true if no errors.
 //
-bool TrigTCP::allWriteSome(
+bool TrigTCP::allOpenAlign(
     TrTCPShared &shr,
     quint64     &niNextCt,
+    bool        &ready,
     QString     &err )
 {
+    ready = false;
+
 // -------------------
 // Open files together
 // -------------------
@@ -446,6 +503,26 @@ bool TrigTCP::allWriteSome(
     if( !alignFiles( shr.imNextCt, niNextCt, err ) )
         return err.isEmpty();
 
+    ready = true;
+    return true;
+}
+
+
+// Return true if no errors.
+//
+bool TrigTCP::allWriteSome(
+    TrTCPShared &shr,
+    quint64     &niNextCt,
+    QString     &err )
+{
+    bool    ready;
+
+    if( !allOpenAlign( shr, niNextCt, ready, err ) )
+        return false;
+
+    if( !ready )
+        return true;
+
 // ----------------------
 // Fetch from all streams
 // ----------------------
@@ -454,11 +531,16 @@ bool TrigTCP::allWriteSome(
 }
 
 
+// Set done true once streams have reached the
+// ending edge, which a count-stamped edge may
+// announce ahead of time.
+//
 // Return true if no errors.
 //
 bool TrigTCP::allFinalWrite(
     TrTCPShared &shr,
     quint64     &niNextCt,
+    bool        &done,
     QString     &err )
 {
 // Stopping due to gate or trigger going low.
@@ -481,6 +563,8 @@ bool TrigTCP::allFinalWrite(
     if( tlo > glo )
         tlo = glo;
 
+    done = (nowCalibrated() >= thi + tlo);
+
 // If our current count is short, fetch remainder.
 
     return xferAll( shr, niNextCt, tlo, err );
@@ -5,6 +5,8 @@
 
 #include <QWaitCondition>
 
+#include <deque>
+
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -97,10 +99,18 @@ class TrigTCP : public TrigBase
     friend class TrTCPWorker;
 
 private:
-    double          _trigHiT,
-                    _trigLoT;
-    volatile bool   _trigHi;
-    int             nThd;
+    struct Pulse {
+        double  hiT,
+                loT;
+        Pulse( double hiT, double loT ) : hiT(hiT), loT(loT)    {}
+    };
+
+private:
+    std::deque<Pulse>   pulses;     // ended, not yet closed
+    double              _trigHiT,
+                        _trigLoT;
+    bool                _trigHi;    // guarded by runMtx
+    int                 nThd;
 
 public:
     TrigTCP(
@@ -110,15 +120,30 @@ public:
         const AIQ           *niQ )
     :   TrigBase( p, gw, imQ, niQ ), _trigHiT(-1), _trigHi(false) {}
 
-    void rgtSetTrig( bool hi );
+    void rgtSetTrig( bool hi, double t = -1 );
 
 public slots:
     virtual void run();
 
 private:
-    bool isTrigHi() const       {QMutexLocker ml( &runMtx ); return _trigHi;}
-    double getTrigHiT() const   {QMutexLocker ml( &runMtx ); return _trigHiT;}
-    double getTrigLoT() const   {QMutexLocker ml( &runMtx ); return _trigLoT;}
+    bool isTrigEnding() const
+        {QMutexLocker ml( &runMtx ); return !_trigHi || !pulses.empty();}
+    bool hasPulse() const
+        {QMutexLocker ml( &runMtx ); return !pulses.empty();}
+    double getTrigHiT() const
+        {
+            QMutexLocker ml( &runMtx );
+            return (pulses.empty() ? _trigHiT : pulses.front().hiT);
+        }
+    double getTrigLoT() const
+        {
+            QMutexLocker ml( &runMtx );
+            return (pulses.empty() ? _trigLoT : pulses.front().loT);
+        }
+    void popPulse()
+        {QMutexLocker ml( &runMtx ); if( !pulses.empty() ) pulses.pop_front();}
+    void dropPulses()
+        {QMutexLocker ml( &runMtx ); pulses.clear();}
 
     bool alignFiles(
         std::vector<quint64>    &imNextCt,
@@ -133,6 +158,11 @@ private:
         quint64     &niNextCt,
         double      tRem,
         QString     &err );
+    bool allOpenAlign(
+        TrTCPShared &shr,
+        quint64     &niNextCt,
+        bool        &ready,
+        QString     &err );
     bool allWriteSome(
         TrTCPShared &shr,
         quint64     &niNextCt,
@@ -140,6 +170,7 @@ private:
     bool allFinalWrite(
         TrTCPShared &shr,
         quint64     &niNextCt,
+        bool        &done,
         QString     &err );
 };
 
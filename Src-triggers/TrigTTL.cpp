@@ -1,13 +1,17 @@
 
 #include "TrigTTL.h"
+#include "TrigTelemetry.h"
 #include "Util.h"
+#include "RunBench.h"
 #include "MainApp.h"
 #include "Run.h"
+#include "ThdPlace.h"
 
 #include <QThread>
 
 
 #define LOOP_MS     100
+#define WAKE_MS     5       // edge search batch
 
 
 static TrigTTL      *ME;
@@ -17,30 +21,50 @@ static TrigTTL      *ME;
 /* TrTTLWorker ---------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
+// Each post() runs our probes until they're caught up,
+// pacing on the first one still busy.
+//
 void TrTTLWorker::run()
 {
-    const int   nID = vID.size();
-    bool        ok  = true;
+    ThdPlace::apply( ThdPlace::roleTrigWrk );
 
-    for(;;) {
+    const int   nID     = vID.size();
+    quint64     epoch   = 0;
+    bool        ok      = true;
 
-        if( !shr.wake( ok ) )
-            break;
+    while( shr.park( epoch, ok ) ) {
 
-        for( int iID = 0; iID < nID; ++iID ) {
+        for(;;) {
 
-            if( shr.preMidPost == -1 )
-                ok = writePreMarginIm( vID[iID] );
-            else if( !shr.preMidPost )
-                ok = doSomeHIm( vID[iID] );
-            else
-                ok = writePostMarginIm( vID[iID] );
+            int ipBusy = -1;
+
+            for( int iID = 0; iID < nID; ++iID ) {
+
+                int ip = vID[iID];
+
+                if( shr.preMidPost == -1 )
+                    ok = writePreMarginIm( ip );
+                else if( !shr.preMidPost )
+                    ok = doSomeHIm( ip );
+                else
+                    ok = writePostMarginIm( ip );
+
+                if( !ok )
+                    break;
+
+                if( ipBusy < 0 && isBusy( ip ) )
+                    ipBusy = ip;
+            }
+
+            if( !ok || ipBusy < 0 )
+                break;
 
-            if( !ok )
+            if( !shr.pace( imQ[ipBusy], ME->imCnt.nextCt[ipBusy] ) )
                 break;
         }
     }
 
+    RunBench::addCPU( RunBench::stgTrig );
     emit finished();
 }
 
@@ -133,10 +157,19 @@ bool TrTTLWorker::doSomeHIm( int ip )
 
     if( shr.p.trgTTL.mode == DAQ::TrgTTLLatch )
         ok = ME->nScansFromCt( data, headCt, -LOOP_MS, ip );
-    else if( C.remCt[ip] <= 0 )
-        return true;
     else {
 
+        // Follower bound moves as fall edge is sought
+
+        if( shr.p.trgTTL.mode == DAQ::TrgTTLFollowV ) {
+            shr.runMtx.lock();
+                C.remCt[ip] = C.limCt[ip] - headCt;
+            shr.runMtx.unlock();
+        }
+
+        if( C.remCt[ip] <= 0 )
+            return true;
+
         int nMax = (C.remCt[ip] <= C.maxFetch[ip] ?
                     C.remCt[ip] : C.maxFetch[ip]);
 
@@ -161,6 +194,15 @@ bool TrTTLWorker::doSomeHIm( int ip )
     return ME->writeAndInvalData( ME->DstImec, ip, data, headCt );
 }
 
+
+// Return true if probe has more to write this post.
+//
+bool TrTTLWorker::isBusy( int ip )
+{
+    return (shr.preMidPost == 0 && shr.p.trgTTL.mode == DAQ::TrgTTLLatch)
+            || ME->imCnt.remCt[ip] > 0;
+}
+
 /* ---------------------------------------------------------------- */
 /* TrTTLThread ---------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -204,6 +246,7 @@ TrigTTL::CountsIm::CountsIm( const DAQ::Params &p )
 {
     edgeCt.resize( np );
     fallCt.resize( np );
+    limCt.resize( np );
     nextCt.resize( np );
     remCt.resize( np );
 
@@ -265,10 +308,12 @@ void TrigTTL::CountsIm::setH( DAQ::TrgTTLMode mode )
         }
         else {
 
-            // remCt must be set within H-writer which seeks
-            // and sets true fallCt. Here we must zero fallCt.
+            // remCt is set by H-writers from limCt, which is
+            // advanced as true fallCt is sought. Here we must
+            // zero fallCt.
 
             fallCt.assign( np, 0 );
+            limCt = edgeCt;
         }
     }
 }
@@ -456,9 +501,18 @@ TrigTTL::TrigTTL(
         highsMax(p.trgTTL.isNInf ? UNSET64 : p.trgTTL.nH),
         aEdgeCtNext(0),
         thresh(p.trigThreshAsInt()),
-        digChan(p.trgTTL.isAnalog ? -1 : p.trigChan())
+        digChan(p.trgTTL.isAnalog ? -1 : p.trigChan()),
+        doHi(false)
 {
     vEdge.resize( vS.size() );
+
+// Edge searches read contiguous tap rather than whole scans
+
+    const AIQ   *Q =
+        (p.trgTTL.stream == "nidq" ?
+        niQ : imQ[p.streamID( p.trgTTL.stream )]);
+
+    Q->addTap( digChan < 0 ? p.trgTTL.chan : digChan );
 }
 
 
@@ -470,7 +524,8 @@ TrigTTL::TrigTTL(
 #define ISSTATE_PostMarg    (state == 3)
 #define ISSTATE_Done        (state == 4)
 
-#define ZEROREM ((!niQ || niCnt.remCt <= 0) && imCnt.remCtDone())
+#define ZEROREM ((!niQ || niCnt.remCt <= 0) \
+                    && shr.isIdle() && imCnt.remCtDone())
 
 
 // TTL logic is driven by TrgTTLParams:
@@ -484,6 +539,8 @@ TrigTTL::TrigTTL(
 //
 void TrigTTL::run()
 {
+    ThdPlace::apply( ThdPlace::roleTrig );
+
     Debug() << "Trigger thread started.";
 
 // ---------
@@ -517,22 +574,28 @@ void TrigTTL::run()
         ++nThd;
     }
 
-// Wait for threads to reach ready (sleep) state
+// Wait for threads to reach ready (parked) state
 
-    shr.runMtx.lock();
-        while( shr.asleep < nThd ) {
-            shr.runMtx.unlock();
-                QThread::usleep( 10 );
-            shr.runMtx.lock();
-        }
-    shr.runMtx.unlock();
+    shr.nThd = nThd;
+    shr.hold();
 
 // -----
 // Start
 // -----
 
+// Low latency: seek edges as each block is enqueued,
+// preempting other run threads.
+
+    if( p.trgTTL.lowLat )
+        QThread::currentThread()->setPriority( QThread::TimeCriticalPriority );
+
     setYieldPeriod_ms( LOOP_MS );
+    setYieldWake(
+        (p.trgTTL.stream == "nidq" ?
+        niQ : imQ[p.streamID( p.trgTTL.stream )]),
+        (p.trgTTL.lowLat ? 0 : WAKE_MS) );
 
+    TrigTelemetry::reset();
     initState();
 
     QString err;
@@ -550,6 +613,8 @@ void TrigTTL::run()
 
         if( inactive ) {
 
+            mirrorDO( false );
+            shr.hold();
             endTrig();
             initState();
             goto next_loop;
@@ -564,6 +629,8 @@ void TrigTTL::run()
             if( !getRiseEdge() )
                 goto next_loop;
 
+            mirrorDO( true );
+
             if( p.trgTTL.marginSecs > TINYMARG )
                 SETSTATE_PreMarg();
             else
@@ -609,12 +676,12 @@ void TrigTTL::run()
                 if( p.trgTTL.stream == "nidq" ) {
 
                     if( !niCnt.fallCt )
-                        getFallEdge();
+                        getFallEdge( shr );
                 }
                 else {
 
                     if( !imCnt.fallCt[imCnt.iTrk] )
-                        getFallEdge();
+                        getFallEdge( shr );
                 }
             }
 
@@ -691,6 +758,7 @@ check_done:
                     SETSTATE_L();
                 }
 
+                mirrorDO( false );
                 endTrig();
             }
         }
@@ -722,6 +790,7 @@ next_loop:
 
 // Kill all threads
 
+    mirrorDO( false );
     shr.kill();
 
     for( int iThd = 0; iThd < nThd; ++iThd ) {
@@ -735,12 +804,24 @@ next_loop:
 }
 
 
+// Out of L, nHighs is the high in progress; in L it's the next.
+//
+bool TrigTTL::moreTrigsInGate() const
+{
+    if( ISSTATE_Done )
+        return false;
+
+    return (ISSTATE_L ? nHighs : nHighs + 1) < highsMax;
+}
+
+
 void TrigTTL::SETSTATE_L()
 {
     aEdgeCtNext = 0;
     aFallCtNext = 0;
 
     state = 0;
+    TrigTelemetry::setState( state );
 }
 
 
@@ -752,6 +833,7 @@ void TrigTTL::SETSTATE_PreMarg()
     niCnt.setPreMarg();
 
     state = 1;
+    TrigTelemetry::setState( state );
 }
 
 
@@ -763,6 +845,7 @@ void TrigTTL::SETSTATE_H()
     niCnt.setH( DAQ::TrgTTLMode(p.trgTTL.mode) );
 
     state = 2;
+    TrigTelemetry::setState( state );
 }
 
 
@@ -778,12 +861,14 @@ void TrigTTL::SETSTATE_PostMarg()
     }
 
     state = 3;
+    TrigTelemetry::setState( state );
 }
 
 
 void TrigTTL::SETSTATE_Done()
 {
     state = 4;
+    TrigTelemetry::setState( state );
     mainApp()->getRun()->dfSetRecordingEnabled( false, true );
 }
 
@@ -957,9 +1042,11 @@ bool TrigTTL::getRiseEdge()
 }
 
 
-// Set fallCt(s) if edge found, set remCt(s) whether found or not.
+// Set fallCt(s) if edge found, set remCt (limCt for imec)
+// whether found or not. Imec writers may be running, so the
+// new bounds are handed over under runMtx, then posted.
 //
-void TrigTTL::getFallEdge()
+void TrigTTL::getFallEdge( TrTTLShared &shr )
 {
     int     ip      = imCnt.iTrk,
             offset  = (niQ ? 1: 0);
@@ -977,18 +1064,21 @@ void TrigTTL::getFallEdge()
             niCnt.remCt  = niCnt.fallCt - niCnt.nextCt;
         }
 
-        for( int ip = 0; ip < nImQ; ++ip ) {
+        for( int ip = 0; ip < nImQ; ++ip )
             imCnt.fallCt[ip] = vEdge[offset+ip];
-            imCnt.remCt[ip]  = imCnt.fallCt[ip] - imCnt.nextCt[ip];
-        }
     }
-    else {
+    else if( niQ )
+        niCnt.remCt = vEdge[0] - niCnt.nextCt;
 
-        if( niQ )
-            niCnt.remCt = vEdge[0] - niCnt.nextCt;
+    if( nImQ ) {
 
-        for( int ip = 0; ip < nImQ; ++ip )
-            imCnt.remCt[ip] = vEdge[offset+ip] - imCnt.nextCt[ip];
+        shr.runMtx.lock();
+            shr.preMidPost = 0;
+            for( int ip = 0; ip < nImQ; ++ip )
+                imCnt.limCt[ip] = vEdge[offset+ip];
+        shr.runMtx.unlock();
+
+        shr.post();
     }
 }
 
@@ -1112,20 +1202,47 @@ bool TrigTTL::doSomeHNi()
 
 // Set preMidPost to {-1,0,1} to select {premargin, H, postmargin}.
 //
+// Imec writers are posted new work only when all are idle and
+// counts say there's more to do; otherwise they carry on alone,
+// and we don't wait for them.
+//
+// Telemetry records the call time, and the tracked stream's
+// lag behind its queue head; imec counts are read only while
+// the writers are idle.
+//
 // Return true if no errors.
 //
 bool TrigTTL::xferAll( TrTTLShared &shr, int preMidPost, QString &err )
 {
-    bool    niOK;
+    double  t0 = getTime();
+    bool    niOK,
+            idle = shr.isIdle();
+
+// Lag
+
+    if( p.trgTTL.stream == "nidq" ) {
 
-    shr.preMidPost  = preMidPost;
-    shr.awake       = 0;
-    shr.asleep      = 0;
-    shr.errors      = 0;
+        if( niCnt.nextCt ) {
+            TrigTelemetry::addLag(
+                qMax( qint64(niQ->endCount() - niCnt.nextCt), qint64(0) )
+                / niCnt.srate );
+        }
+    }
+    else if( idle && imCnt.nextCt[imCnt.iTrk] ) {
 
-// Wake all imec threads
+        int iTrk = imCnt.iTrk;
 
-    shr.condWake.wakeAll();
+        TrigTelemetry::addLag(
+            qMax( qint64(imQ[iTrk]->endCount() - imCnt.nextCt[iTrk]), qint64(0) )
+            / imCnt.srate[iTrk] );
+    }
+
+// Post imec threads
+
+    if( idle && !imCnt.remCtDone() ) {
+        shr.preMidPost = preMidPost;
+        shr.post();
+    }
 
 // Do nidq locally
 
@@ -1136,19 +1253,9 @@ bool TrigTTL::xferAll( TrTTLShared &shr, int preMidPost, QString &err )
     else
         niOK = writePostMarginNi();
 
-// Wait all threads started, and all done
-
-    shr.runMtx.lock();
-        while( shr.awake  < nThd
-            || shr.asleep < nThd ) {
-
-            shr.runMtx.unlock();
-                QThread::msleep( LOOP_MS/8 );
-            shr.runMtx.lock();
-        }
-    shr.runMtx.unlock();
+    TrigTelemetry::addXfer( getTime() - t0 );
 
-    if( niOK && !shr.errors )
+    if( niOK && shr.isOK() )
         return true;
 
     err = "write failed";
@@ -1156,6 +1263,20 @@ bool TrigTTL::xferAll( TrTTLShared &shr, int preMidPost, QString &err )
 }
 
 
+// Mirror high state to NI digital out line, if any.
+//
+void TrigTTL::mirrorDO( bool hi )
+{
+    if( hi == doHi || p.trgTTL.doLine.isEmpty() )
+        return;
+
+    if( !CniCfg::setDO( p.trgTTL.doLine, hi ).isEmpty() )
+        Warning() << "TTL trigger could not set DO " << p.trgTTL.doLine;
+
+    doHi = hi;
+}
+
+
 void TrigTTL::statusProcess( QString &sT, bool inactive )
 {
     bool trackNI = p.trgTTL.stream == "nidq";
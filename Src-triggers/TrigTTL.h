@@ -3,45 +3,16 @@
 
 #include "TrigBase.h"
 
-#include <QWaitCondition>
-
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
-struct TrTTLShared {
+struct TrTTLShared : public TrWrShared {
     const DAQ::Params   &p;
-    QMutex              runMtx;
-    QWaitCondition      condWake;
-    int                 preMidPost, // {-1,0,+1}
-                        awake,
-                        asleep,
-                        errors;
-    bool                stop;
+    int                 preMidPost; // {-1,0,+1}
 
     TrTTLShared( const DAQ::Params &p )
-    :   p(p), awake(0), asleep(0), stop(false)  {}
-
-    bool wake( bool ok )
-    {
-        bool    run;
-        runMtx.lock();
-            errors += !ok;
-            ++asleep;
-            condWake.wait( &runMtx );
-            ++awake;
-            run = !stop;
-        runMtx.unlock();
-        return run;
-    }
-
-    void kill()
-    {
-        runMtx.lock();
-            stop = true;
-        runMtx.unlock();
-        condWake.wakeAll();
-    }
+    :   TrWrShared(), p(p), preMidPost(0)   {}
 };
 
 
@@ -72,6 +43,7 @@ private:
     bool writePreMarginIm( int ip );
     bool writePostMarginIm( int ip );
     bool doSomeHIm( int ip );
+    bool isBusy( int ip );
 };
 
 
@@ -101,6 +73,7 @@ private:
         // variable -------------------
         std::vector<quint64>    edgeCt,
                                 fallCt,
+                                limCt,  // follower H bound
                                 nextCt;
         std::vector<qint64>     remCt;
         // const ----------------------
@@ -163,6 +136,7 @@ private:
     int                     nThd,
                             nHighs,
                             state;
+    bool                    doHi;
 
 public:
     TrigTTL(
@@ -175,6 +149,8 @@ public slots:
     virtual void run();
 
 private:
+    virtual bool moreTrigsInGate() const;
+
     void SETSTATE_L();
     void SETSTATE_PreMarg();
     void SETSTATE_H();
@@ -186,7 +162,7 @@ private:
     bool _getFallEdge( quint64 srcEdgeCt, int iSrc );
 
     bool getRiseEdge();
-    void getFallEdge();
+    void getFallEdge( TrTTLShared &shr );
 
     bool writePreMarginNi();
     bool writePostMarginNi();
@@ -194,6 +170,7 @@ private:
 
     bool xferAll( TrTTLShared &shr, int preMidPost, QString &err );
 
+    void mirrorDO( bool hi );
     void statusProcess( QString &sT, bool inactive );
 };
 
@@ -0,0 +1,229 @@
+
+#include "TrigTelemetry.h"
+#include "Util.h"
+
+
+std::atomic<quint64>    TrigTelemetry::stN[NSTATE];
+std::atomic<quint64>    TrigTelemetry::stUs[NSTATE];
+std::atomic<quint64>    TrigTelemetry::xfer[NXFER];
+std::atomic<quint64>    TrigTelemetry::lag[NLAG];
+std::atomic<quint64>    TrigTelemetry::tEnterUs( 0 );
+std::atomic<int>        TrigTelemetry::curState( -1 );
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Counters restart with the trigger, so a difference against
+// a snapshot from before reset() saturates at zero.
+//
+static quint64 sub( quint64 now, quint64 was )
+{
+    return (now > was ? now - was : 0);
+}
+
+
+static quint64 nowUs()
+{
+    return quint64(1e6 * getTime());
+}
+
+
+/* ---------------------------------------------------------------- */
+/* Snapshot ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void TrigTelemetry::Snapshot::diff(
+    const Snapshot  &now,
+    const Snapshot  &was )
+{
+    for( int i = 0; i < NSTATE; ++i ) {
+        stN[i]  = sub( now.stN[i], was.stN[i] );
+        stUs[i] = sub( now.stUs[i], was.stUs[i] );
+    }
+
+    for( int i = 0; i < NXFER; ++i )
+        xfer[i] = sub( now.xfer[i], was.xfer[i] );
+
+    for( int i = 0; i < NLAG; ++i )
+        lag[i] = sub( now.lag[i], was.lag[i] );
+
+    state = now.state;
+}
+
+
+quint64 TrigTelemetry::Snapshot::nXfer() const
+{
+    quint64 n = 0;
+
+    for( int i = 0; i < NXFER; ++i )
+        n += xfer[i];
+
+    return n;
+}
+
+
+quint64 TrigTelemetry::Snapshot::nLag() const
+{
+    quint64 n = 0;
+
+    for( int i = 0; i < NLAG; ++i )
+        n += lag[i];
+
+    return n;
+}
+
+
+// Share of dwell time spent in state st, %.
+//
+double TrigTelemetry::Snapshot::statePct( int st ) const
+{
+    quint64 T = 0;
+
+    for( int i = 0; i < NSTATE; ++i )
+        T += stUs[i];
+
+    return (T ? 100.0 * stUs[st] / T : 0);
+}
+
+
+double TrigTelemetry::Snapshot::xferPctile( double pct ) const
+{
+    return qoctPctile( xfer, NXFER, 16e-6, pct );
+}
+
+
+double TrigTelemetry::Snapshot::lagPctile( double pct ) const
+{
+    return qoctPctile( lag, NLAG, 1e-3, pct );
+}
+
+/* ---------------------------------------------------------------- */
+/* TrigTelemetry -------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+const char *TrigTelemetry::stateName( int st )
+{
+    static const char *name[NSTATE] = {"L", "PreMarg", "H", "PostMarg", "Done"};
+
+    return (st >= 0 && st < NSTATE ? name[st] : "X");
+}
+
+
+// Call at trigger thread start.
+//
+void TrigTelemetry::reset()
+{
+    curState.store( -1, std::memory_order_relaxed );
+
+    for( int i = 0; i < NSTATE; ++i ) {
+        stN[i].store( 0, std::memory_order_relaxed );
+        stUs[i].store( 0, std::memory_order_relaxed );
+    }
+
+    for( int i = 0; i < NXFER; ++i )
+        xfer[i].store( 0, std::memory_order_relaxed );
+
+    for( int i = 0; i < NLAG; ++i )
+        lag[i].store( 0, std::memory_order_relaxed );
+}
+
+
+// Close dwell in current state and enter st; an entry is
+// counted only if the state changes.
+//
+void TrigTelemetry::setState( int st )
+{
+    if( st < 0 || st >= NSTATE )
+        return;
+
+    quint64 t   = nowUs();
+    int     cur = curState.load( std::memory_order_relaxed );
+
+    if( cur >= 0 )
+        bump( stUs[cur], t - tEnterUs.load( std::memory_order_relaxed ) );
+
+    if( st != cur )
+        bump( stN[st] );
+
+    tEnterUs.store( t, std::memory_order_relaxed );
+    curState.store( st, std::memory_order_relaxed );
+}
+
+
+// Record one xferAll call time.
+//
+void TrigTelemetry::addXfer( double secs )
+{
+    bump( xfer[qoctBin( secs, 16e-6, NXFER )] );
+}
+
+
+// Record tracked stream lag behind its queue head.
+//
+void TrigTelemetry::addLag( double secs )
+{
+    bump( lag[qoctBin( secs, 1e-3, NLAG )] );
+}
+
+
+// Current state's dwell includes time spent in it so far.
+//
+void TrigTelemetry::snapshot( Snapshot &S )
+{
+    for( int i = 0; i < NSTATE; ++i ) {
+        S.stN[i]  = stN[i].load( std::memory_order_relaxed );
+        S.stUs[i] = stUs[i].load( std::memory_order_relaxed );
+    }
+
+    for( int i = 0; i < NXFER; ++i )
+        S.xfer[i] = xfer[i].load( std::memory_order_relaxed );
+
+    for( int i = 0; i < NLAG; ++i )
+        S.lag[i] = lag[i].load( std::memory_order_relaxed );
+
+    S.state = curState.load( std::memory_order_relaxed );
+
+    if( S.state >= 0 ) {
+
+        quint64 t   = nowUs(),
+                t0  = tEnterUs.load( std::memory_order_relaxed );
+
+        if( t > t0 )
+            S.stUs[S.state] += t - t0;
+    }
+}
+
+
+// Run totals as name=value lines for GETTRIGTELEMETRY.
+//
+QString TrigTelemetry::remoteStr()
+{
+    Snapshot    S;
+    QString     s;
+
+    snapshot( S );
+
+    s = QString("state=%1\n").arg( stateName( S.state ) );
+
+    for( int i = 0; i < NSTATE; ++i ) {
+        s += QString("state%1N=%2\n").arg( stateName( i ) ).arg( S.stN[i] );
+        s += QString("state%1Secs=%2\n")
+                .arg( stateName( i ) ).arg( 1e-6*S.stUs[i], 0, 'f', 3 );
+    }
+
+    s += QString("xferN=%1\n").arg( S.nXfer() );
+    s += QString("xferMsP50=%1\n").arg( 1000*S.xferPctile( 50 ), 0, 'f', 3 );
+    s += QString("xferMsP90=%1\n").arg( 1000*S.xferPctile( 90 ), 0, 'f', 3 );
+    s += QString("xferMsP99=%1\n").arg( 1000*S.xferPctile( 99 ), 0, 'f', 3 );
+    s += QString("xferMsMax=%1\n").arg( 1000*S.xferPctile( 100 ), 0, 'f', 3 );
+    s += QString("lagN=%1\n").arg( S.nLag() );
+    s += QString("lagMsP50=%1\n").arg( 1000*S.lagPctile( 50 ), 0, 'f', 1 );
+    s += QString("lagMsP90=%1\n").arg( 1000*S.lagPctile( 90 ), 0, 'f', 1 );
+    s += QString("lagMsP99=%1\n").arg( 1000*S.lagPctile( 99 ), 0, 'f', 1 );
+    s += QString("lagMsMax=%1\n").arg( 1000*S.lagPctile( 100 ), 0, 'f', 1 );
+
+    return s;
+}
+
+
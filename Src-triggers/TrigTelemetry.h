@@ -0,0 +1,77 @@
+#ifndef TRIGTELEMETRY_H
+#define TRIGTELEMETRY_H
+
+#include <QString>
+
+#include <atomic>
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Always-on TTL trigger telemetry.
+//
+// The trigger thread is the only writer, so updates are plain
+// relaxed load/store; readers (MetricsWindow, CmdServer) take
+// relaxed snapshots anytime. Counters accumulate over the run;
+// callers wanting recent figures difference two snapshots.
+//
+// - Per state: entry count and dwell time, the current state
+//   including time spent in it so far.
+// - Per xferAll: call time, and lag of the tracked stream's
+//   write position behind its queue head.
+//
+class TrigTelemetry
+{
+public:
+    enum {
+        NSTATE  = 5,    // L, PreMarg, H, PostMarg, Done
+        NXFER   = 48,   // quarter-octave bins from 16 us
+        NLAG    = 56    // quarter-octave bins from 1 ms
+    };
+
+    struct Snapshot {
+        quint64 stN[NSTATE],
+                stUs[NSTATE],
+                xfer[NXFER],
+                lag[NLAG];
+        int     state;
+
+        void diff( const Snapshot &now, const Snapshot &was );
+
+        quint64 nXfer() const;
+        quint64 nLag() const;
+        double statePct( int st ) const;
+        double xferPctile( double pct ) const;  // seconds
+        double lagPctile( double pct ) const;   // seconds
+    };
+
+private:
+    static std::atomic<quint64> stN[NSTATE],
+                                stUs[NSTATE],
+                                xfer[NXFER],
+                                lag[NLAG],
+                                tEnterUs;
+    static std::atomic<int>     curState;
+
+public:
+    static const char *stateName( int st );
+
+    static void reset();
+
+    static void setState( int st );
+    static void addXfer( double secs );
+    static void addLag( double secs );
+
+    static void snapshot( Snapshot &S );
+    static QString remoteStr();
+
+private:
+    static inline void bump( std::atomic<quint64> &c, quint64 n = 1 )
+        {c.store( c.load( std::memory_order_relaxed ) + n,
+            std::memory_order_relaxed );}
+};
+
+#endif  // TRIGTELEMETRY_H
+
+
@@ -1,13 +1,16 @@
 
 #include "TrigTimed.h"
 #include "Util.h"
+#include "RunBench.h"
 #include "MainApp.h"
 #include "Run.h"
+#include "ThdPlace.h"
 
 #include <QThread>
 
 
 #define LOOP_MS     100
+#define WAKE_MS     25      // write batch
 
 
 static TrigTimed    *ME;
@@ -17,23 +20,43 @@ static TrigTimed    *ME;
 /* TrTimWorker ---------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
+// Each post() runs our probes until they're caught up,
+// pacing on the first one still busy.
+//
 void TrTimWorker::run()
 {
-    const int   nID = vID.size();
-    bool        ok  = true;
+    ThdPlace::apply( ThdPlace::roleTrigWrk );
+
+    const int   nID     = vID.size();
+    quint64     epoch   = 0;
+    bool        ok      = true;
+
+    while( shr.park( epoch, ok ) ) {
+
+        for(;;) {
+
+            int ipBusy = -1;
 
-    for(;;) {
+            for( int iID = 0; iID < nID; ++iID ) {
 
-        if( !shr.wake( ok ) )
-            break;
+                int ip = vID[iID];
 
-        for( int iID = 0; iID < nID; ++iID ) {
+                if( !(ok = doSomeHIm( ip )) )
+                    break;
 
-            if( !(ok = doSomeHIm( vID[iID] )) )
+                if( ipBusy < 0 && isBusy( ip ) )
+                    ipBusy = ip;
+            }
+
+            if( !ok || ipBusy < 0 )
+                break;
+
+            if( !shr.pace( imQ[ipBusy], ME->imCnt.nextCt[ipBusy] ) )
                 break;
         }
     }
 
+    RunBench::addCPU( RunBench::stgTrig );
     emit finished();
 }
 
@@ -70,6 +93,14 @@ bool TrTimWorker::doSomeHIm( int ip )
     return ME->writeAndInvalData( ME->DstImec, ip, data, headCt );
 }
 
+
+// Return true if probe has more to write this post.
+//
+bool TrTimWorker::isBusy( int ip )
+{
+    return ME->imCnt.hiCtCur[ip] < ME->imCnt.hiCtMax[ip];
+}
+
 /* ---------------------------------------------------------------- */
 /* TrTimThread ---------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -222,6 +253,8 @@ TrigTimed::TrigTimed(
 //
 void TrigTimed::run()
 {
+    ThdPlace::apply( ThdPlace::roleTrig );
+
     Debug() << "Trigger thread started.";
 
 // ---------
@@ -255,21 +288,17 @@ void TrigTimed::run()
         ++nThd;
     }
 
-// Wait for threads to reach ready (sleep) state
+// Wait for threads to reach ready (parked) state
 
-    shr.runMtx.lock();
-        while( shr.asleep < nThd ) {
-            shr.runMtx.unlock();
-                QThread::usleep( 10 );
-            shr.runMtx.lock();
-        }
-    shr.runMtx.unlock();
+    shr.nThd = nThd;
+    shr.hold();
 
 // -----
 // Start
 // -----
 
     setYieldPeriod_ms( LOOP_MS );
+    setYieldWake( vS[0].Q, WAKE_MS );
 
     initState();
 
@@ -290,6 +319,7 @@ void TrigTimed::run()
 
         if( inactive ) {
 
+            shr.hold();
             endTrig();
             initState();
             goto next_loop;
@@ -319,18 +349,28 @@ void TrigTimed::run()
 
             // Done?
 
-            if( niCnt.hDone() && imCnt.hDone() ) {
+            if( niCnt.hDone() && shr.isIdle() && imCnt.hDone() ) {
 
                 if( ++nH >= nCycMax ) {
                     SETSTATE_Done();
                     inactive = true;
+                    endTrig();
                 }
                 else {
+
                     advanceNext();
                     SETSTATE_L;
-                }
 
-                endTrig();
+                    // Keep files open, next H is a new epoch
+
+                    if( p.trgTim.oneFile ) {
+                        imCnt.hiCtCur.assign( nImQ, 0 );
+                        niCnt.hiCtCur = 0;
+                        epochNext();
+                    }
+                    else
+                        endTrig();
+                }
             }
         }
 
@@ -401,6 +441,18 @@ next_loop:
 }
 
 
+// In H, nH is the cycle in progress; otherwise it's the next.
+// One-file runs never start another file within a gate.
+//
+bool TrigTimed::moreTrigsInGate() const
+{
+    if( ISSTATE_Done || p.trgTim.oneFile )
+        return false;
+
+    return (ISSTATE_H ? nH + 1 : nH) < nCycMax;
+}
+
+
 void TrigTimed::SETSTATE_Done()
 {
     state = 3;
@@ -566,37 +618,20 @@ bool TrigTimed::doSomeHNi()
 }
 
 
+// Imec writers are posted by allDoSomeH(); here we just
+// do nidq and collect errors, without waiting on imec.
+//
 // Return true if no errors.
 //
 bool TrigTimed::xferAll( TrTimShared &shr, QString &err )
 {
     bool    niOK;
 
-    shr.awake   = 0;
-    shr.asleep  = 0;
-    shr.errors  = 0;
-
-// Wake all imec threads
-
-    shr.condWake.wakeAll();
-
 // Do nidq locally
 
     niOK = doSomeHNi();
 
-// Wait all threads started, and all done
-
-    shr.runMtx.lock();
-        while( shr.awake  < nThd
-            || shr.asleep < nThd ) {
-
-            shr.runMtx.unlock();
-                QThread::msleep( LOOP_MS/8 );
-            shr.runMtx.lock();
-        }
-    shr.runMtx.unlock();
-
-    if( niOK && !shr.errors )
+    if( niOK && shr.isOK() )
         return true;
 
     err = "write failed";
@@ -604,10 +639,16 @@ bool TrigTimed::xferAll( TrTimShared &shr, QString &err )
 }
 
 
+// Imec counts are only read or set while the imec writers
+// are idle; once aligned, they're posted and run on their own.
+//
 // Return true if no errors.
 //
 bool TrigTimed::allDoSomeH( TrTimShared &shr, double gHiT, QString &err )
 {
+    if( !shr.isIdle() )
+        return xferAll( shr, err );
+
 // -------------------
 // Open files together
 // -------------------
@@ -637,6 +678,9 @@ bool TrigTimed::allDoSomeH( TrTimShared &shr, double gHiT, QString &err )
 // Fetch from all streams
 // ----------------------
 
+    if( !imCnt.hDone() )
+        shr.post();
+
     return xferAll( shr, err );
 }
 
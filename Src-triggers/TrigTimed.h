@@ -3,44 +3,14 @@
 
 #include "TrigBase.h"
 
-#include <QWaitCondition>
-
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
-struct TrTimShared {
+struct TrTimShared : public TrWrShared {
     const DAQ::Params   &p;
-    QMutex              runMtx;
-    QWaitCondition      condWake;
-    int                 awake,
-                        asleep,
-                        errors;
-    bool                stop;
-
-    TrTimShared( const DAQ::Params &p )
-    :   p(p), awake(0), asleep(0), stop(false)  {}
-
-    bool wake( bool ok )
-    {
-        bool    run;
-        runMtx.lock();
-            errors += !ok;
-            ++asleep;
-            condWake.wait( &runMtx );
-            ++awake;
-            run = !stop;
-        runMtx.unlock();
-        return run;
-    }
-
-    void kill()
-    {
-        runMtx.lock();
-            stop = true;
-        runMtx.unlock();
-        condWake.wakeAll();
-    }
+
+    TrTimShared( const DAQ::Params &p ) : TrWrShared(), p(p)    {}
 };
 
 
@@ -69,6 +39,7 @@ public slots:
 
 private:
     bool doSomeHIm( int ip );
+    bool isBusy( int ip );
 };
 
 
@@ -147,6 +118,8 @@ public slots:
     virtual void run();
 
 private:
+    virtual bool moreTrigsInGate() const;
+
     void SETSTATE_Done();
     void initState();
 
@@ -0,0 +1,526 @@
+
+#include "Par2Stream.h"
+#include "Util.h"
+#include "Version.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QtEndian>
+
+#include <string.h>
+
+
+// Bytes per kernel pass over all recovery slices, so the
+// input stays in cache while each slice takes its share.
+#define PAR2_PASSBYTES  (32*1024)
+
+/* ---------------------------------------------------------------- */
+/* GF(2^16) ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Multiply-accumulate dst ^= c * src over 16-bit words, from
+// per-c tables of c * (n << 4k) for each nibble n of word nibble
+// k: 4 tables of lo bytes and 4 of hi bytes, 16 entries each.
+// The SSSE3 kernel looks up 16 words' nibbles with one pshufb
+// per table; it's chosen once at startup if the CPU has it.
+
+#define PAR2_GFPOLY     0x1100B
+#define PAR2_GFLIM      65535
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define PAR2_X86
+#include <tmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define PAR2_SSSE3_FN
+#else
+#define PAR2_SSSE3_FN __attribute__((target("ssse3")))
+#endif
+#endif
+
+typedef void (*MulAccFn)( char *dst, const char *src, qint64 n, const char *T );
+
+
+static quint16  gfLog[PAR2_GFLIM + 1],
+                gfExp[PAR2_GFLIM + 1];
+static quint32  crcTable[8][256];    // slicing-by-8
+
+
+static bool initTables()
+{
+    quint32 b = 1;
+
+    for( int l = 0; l < PAR2_GFLIM; ++l ) {
+
+        gfLog[b] = quint16(l);
+        gfExp[l] = quint16(b);
+
+        b <<= 1;
+
+        if( b & 0x10000 )
+            b ^= PAR2_GFPOLY;
+    }
+
+    gfLog[0]            = PAR2_GFLIM;
+    gfExp[PAR2_GFLIM]   = 0;
+
+    for( int i = 0; i < 256; ++i ) {
+
+        quint32 c = i;
+
+        for( int k = 0; k < 8; ++k )
+            c = (c & 1 ? (c >> 1) ^ 0xEDB88320 : c >> 1);
+
+        crcTable[0][i] = c;
+    }
+
+    for( int i = 0; i < 256; ++i ) {
+
+        for( int t = 1; t < 8; ++t ) {
+
+            quint32 c = crcTable[t-1][i];
+
+            crcTable[t][i] = crcTable[0][c & 0xFF] ^ (c >> 8);
+        }
+    }
+
+    return true;
+}
+
+
+static quint16 gfMul( quint16 a, quint16 b )
+{
+    if( !a || !b )
+        return 0;
+
+    return gfExp[(gfLog[a] + gfLog[b]) % PAR2_GFLIM];
+}
+
+
+// Zip-standard CRC32, continuing from crc (0 to start),
+// eight bytes per step.
+//
+static quint32 crc32( quint32 crc, const char *p, qint64 n )
+{
+    quint32 c = ~crc;
+
+    for( ; n >= 8; n -= 8, p += 8 ) {
+
+        quint32 lo, hi;
+
+        memcpy( &lo, p, 4 );
+        memcpy( &hi, p + 4, 4 );
+
+        lo = qFromLittleEndian( lo ) ^ c;
+        hi = qFromLittleEndian( hi );
+
+        c = crcTable[7][lo & 0xFF] ^ crcTable[6][(lo >> 8) & 0xFF]
+            ^ crcTable[5][(lo >> 16) & 0xFF] ^ crcTable[4][lo >> 24]
+            ^ crcTable[3][hi & 0xFF] ^ crcTable[2][(hi >> 8) & 0xFF]
+            ^ crcTable[1][(hi >> 16) & 0xFF] ^ crcTable[0][hi >> 24];
+    }
+
+    for( ; n > 0; --n )
+        c = crcTable[0][(c ^ uchar(*p++)) & 0xFF] ^ (c >> 8);
+
+    return ~c;
+}
+
+
+static void buildTable( char *T, quint16 c )
+{
+    for( int k = 0; k < 4; ++k ) {
+
+        for( int n = 0; n < 16; ++n ) {
+
+            quint16 v = gfMul( c, quint16(n << (4*k)) );
+
+            T[32*k + n]         = char(v & 0xFF);
+            T[32*k + 16 + n]    = char(v >> 8);
+        }
+    }
+}
+
+
+static void mulAcc_scalar( char *dst, const char *src, qint64 n, const char *T )
+{
+    const uchar *t = (const uchar*)T;
+
+    for( qint64 i = 0; i + 2 <= n; i += 2 ) {
+
+        uint    w = uchar(src[i]) | uchar(src[i+1]) << 8,
+                lo = 0,
+                hi = 0;
+
+        for( int k = 0; k < 4; ++k, w >>= 4 ) {
+            lo ^= t[32*k + (w & 15)];
+            hi ^= t[32*k + 16 + (w & 15)];
+        }
+
+        dst[i]      ^= char(lo);
+        dst[i+1]    ^= char(hi);
+    }
+}
+
+
+#ifdef PAR2_X86
+
+PAR2_SSSE3_FN
+static void mulAcc_ssse3( char *dst, const char *src, qint64 n, const char *T )
+{
+    __m128i         t[8];
+    const __m128i   m8  = _mm_set1_epi16( 0x00FF ),
+                    m4  = _mm_set1_epi8( 0x0F );
+    qint64          i   = 0;
+
+    for( int k = 0; k < 8; ++k )
+        t[k] = _mm_loadu_si128( (const __m128i*)(T + 16*k) );
+
+    for( ; i + 32 <= n; i += 32 ) {
+
+        __m128i a   = _mm_loadu_si128( (const __m128i*)(src + i) ),
+                b   = _mm_loadu_si128( (const __m128i*)(src + i + 16) ),
+                lo  = _mm_packus_epi16(
+                        _mm_and_si128( a, m8 ), _mm_and_si128( b, m8 ) ),
+                hi  = _mm_packus_epi16(
+                        _mm_srli_epi16( a, 8 ), _mm_srli_epi16( b, 8 ) ),
+                n0  = _mm_and_si128( lo, m4 ),
+                n1  = _mm_and_si128( _mm_srli_epi16( lo, 4 ), m4 ),
+                n2  = _mm_and_si128( hi, m4 ),
+                n3  = _mm_and_si128( _mm_srli_epi16( hi, 4 ), m4 ),
+                rl, rh;
+
+        rl = _mm_xor_si128(
+                _mm_xor_si128(
+                    _mm_shuffle_epi8( t[0], n0 ),
+                    _mm_shuffle_epi8( t[2], n1 ) ),
+                _mm_xor_si128(
+                    _mm_shuffle_epi8( t[4], n2 ),
+                    _mm_shuffle_epi8( t[6], n3 ) ) );
+
+        rh = _mm_xor_si128(
+                _mm_xor_si128(
+                    _mm_shuffle_epi8( t[1], n0 ),
+                    _mm_shuffle_epi8( t[3], n1 ) ),
+                _mm_xor_si128(
+                    _mm_shuffle_epi8( t[5], n2 ),
+                    _mm_shuffle_epi8( t[7], n3 ) ) );
+
+        __m128i *d = (__m128i*)(dst + i);
+
+        _mm_storeu_si128( d,
+            _mm_xor_si128( _mm_loadu_si128( d ),
+                _mm_unpacklo_epi8( rl, rh ) ) );
+
+        _mm_storeu_si128( d + 1,
+            _mm_xor_si128( _mm_loadu_si128( d + 1 ),
+                _mm_unpackhi_epi8( rl, rh ) ) );
+    }
+
+    mulAcc_scalar( dst + i, src + i, n - i, T );
+}
+
+#endif  // PAR2_X86
+
+
+static MulAccFn pickMulAcc()
+{
+    initTables();
+
+#ifdef PAR2_X86
+    if( cpuHasSSSE3() )
+        return mulAcc_ssse3;
+#endif
+
+    return mulAcc_scalar;
+}
+
+
+static const MulAccFn   mulAcc = pickMulAcc();
+
+/* ---------------------------------------------------------------- */
+/* Packets -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+static QByteArray md5( const QByteArray &a )
+{
+    return QCryptographicHash::hash( a, QCryptographicHash::Md5 );
+}
+
+
+static QByteArray le32( quint32 v )
+{
+    v = qToLittleEndian( v );
+    return QByteArray( (const char*)&v, 4 );
+}
+
+
+static QByteArray le64( quint64 v )
+{
+    v = qToLittleEndian( v );
+    return QByteArray( (const char*)&v, 8 );
+}
+
+
+static QByteArray pad4( QByteArray a )
+{
+    while( a.size() & 3 )
+        a.append( char(0) );
+
+    return a;
+}
+
+
+// Header: magic, length, MD5 of the rest, set ID, type.
+//
+static QByteArray packetHdr(
+    qint64              bodyBytes,
+    const QByteArray    &md5,
+    const QByteArray    &setID,
+    const char          *type )
+{
+    return QByteArray( "PAR2\0PKT", 8 )
+            + le64( 64 + bodyBytes )
+            + md5
+            + setID
+            + QByteArray( type, 16 );
+}
+
+
+static QByteArray packet(
+    const QByteArray    &setID,
+    const char          *type,
+    const QByteArray    &body )
+{
+    QByteArray  tail = setID + QByteArray( type, 16 ) + body;
+
+    return packetHdr( body.size(), md5( tail ), setID, type ) + body;
+}
+
+/* ---------------------------------------------------------------- */
+/* Par2Stream ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+Par2Stream::Par2Stream( qint64 sliceBytes, int nRec )
+    :   fileMD5(QCryptographicHash::Md5),
+        sliceMD5(QCryptographicHash::Md5),
+        sliceBytes(sliceBytes), nBytes(0), inSlice(0),
+        sliceCRC(0), logBase(0), nSlices(0), ok(nRec > 0)
+{
+    if( !ok )
+        return;
+
+    try {
+        rec.assign( nRec, std::vector<char>( sliceBytes, 0 ) );
+        tabs.assign( nRec, std::vector<char>( 128 ) );
+    }
+    catch( ... ) {
+        rec.clear();
+        tabs.clear();
+        ok = false;
+    }
+}
+
+
+void Par2Stream::update( const void *src, qint64 bytes )
+{
+    if( !ok || bytes <= 0 )
+        return;
+
+    const char  *p = (const char*)src;
+
+    if( head.size() < 16384 )
+        head.append( p, int(qMin( bytes, qint64(16384 - head.size()) )) );
+
+    fileMD5.addData( p, int(bytes) );
+    nBytes += bytes;
+
+    while( bytes > 0 ) {
+
+        if( !inSlice ) {
+
+            if( nSlices >= PAR2_MAXSLICES ) {
+
+                std::vector<std::vector<char> >().swap( rec );
+                ok = false;
+                return;
+            }
+
+            beginSlice();
+        }
+
+        qint64  n = qMin( bytes, sliceBytes - inSlice );
+
+        sliceMD5.addData( p, int(n) );
+        sliceCRC = crc32( sliceCRC, p, n );
+
+        for( qint64 o = 0; o < n; o += PAR2_PASSBYTES ) {
+
+            qint64  m = qMin( n - o, qint64(PAR2_PASSBYTES) );
+
+            for( int e = 0, nRec = rec.size(); e < nRec; ++e )
+                mulAcc( &rec[e][inSlice + o], p + o, m, &tabs[e][0] );
+        }
+
+        inSlice += n;
+        p       += n;
+        bytes   -= n;
+
+        if( inSlice == sliceBytes )
+            endSlice();
+    }
+}
+
+
+// Write the recovery set beside filePath (the file just
+// written). An empty file needs no parity.
+//
+bool Par2Stream::finish( QString &err, const QString &filePath )
+{
+    if( !ok ) {
+        err = QString("PAR2 parity needs under %1 slices and %2 MB RAM.")
+                .arg( PAR2_MAXSLICES )
+                .arg( (tabs.size() * sliceBytes) >> 20 );
+        return false;
+    }
+
+    if( !nBytes )
+        return true;
+
+    if( inSlice )
+        endSlice();
+
+    QByteArray  name    = QFileInfo( filePath ).fileName().toUtf8(),
+                md5Head = md5( head ),
+                fileID  = md5( md5Head + le64( nBytes ) + name ),
+                body    = le64( sliceBytes ) + le32( 1 ) + fileID,
+                setID   = md5( body ),
+                crit;
+
+    crit = packet( setID, "PAR 2.0\0Main\0\0\0\0", body );
+
+    crit += packet( setID, "PAR 2.0\0FileDesc",
+                fileID + fileMD5.result() + md5Head
+                + le64( nBytes ) + pad4( name ) );
+
+    crit += packet( setID, "PAR 2.0\0IFSC\0\0\0\0",
+                fileID + QByteArray( &md5crc[0], int(md5crc.size()) ) );
+
+    crit += packet( setID, "PAR 2.0\0Creator\0",
+                pad4( QString("SpikeGLX %1")
+                        .arg( VERSION, 0, 16 ).toUtf8() ) );
+
+    int nRec    = rec.size(),
+        w       = QString::number( nRec ).size();
+
+    if( !writeFile( filePath + ".par2", crit, setID, 0, 0 )
+        || !writeFile(
+                QString("%1.vol%2+%3.par2")
+                .arg( filePath )
+                .arg( 0, w, 10, QChar('0') )
+                .arg( nRec, w, 10, QChar('0') ),
+                crit, setID, 0, nRec ) ) {
+
+        err = QString("Can't write PAR2 files for '%1'.")
+                .arg( QFileInfo( filePath ).fileName() );
+        return false;
+    }
+
+    return true;
+}
+
+
+// New input slice: next base whose log is coprime to 65535,
+// and the kernel tables for its rec-th powers.
+//
+void Par2Stream::beginSlice()
+{
+    while( !(logBase % 3) || !(logBase % 5)
+        || !(logBase % 17) || !(logBase % 257) ) {
+
+        ++logBase;
+    }
+
+    for( int e = 0, nRec = rec.size(); e < nRec; ++e ) {
+
+        buildTable(
+            &tabs[e][0],
+            gfExp[quint64(logBase) * e % PAR2_GFLIM] );
+    }
+
+    ++logBase;
+
+    sliceMD5.reset();
+    sliceCRC = 0;
+}
+
+
+// Checksums cover the slice zero-padded to full size.
+//
+void Par2Stream::endSlice()
+{
+    if( inSlice < sliceBytes ) {
+
+        std::vector<char>   z( PAR2_PASSBYTES, 0 );
+
+        for( qint64 n = sliceBytes - inSlice; n > 0; ) {
+
+            qint64  m = qMin( n, qint64(PAR2_PASSBYTES) );
+
+            sliceMD5.addData( &z[0], int(m) );
+            sliceCRC = crc32( sliceCRC, &z[0], m );
+            n -= m;
+        }
+    }
+
+    QByteArray  entry = sliceMD5.result() + le32( sliceCRC );
+
+    md5crc.insert( md5crc.end(), entry.constData(), entry.constData() + 20 );
+
+    ++nSlices;
+    inSlice = 0;
+}
+
+
+// Recovery packets for exponents [e0,eLim), then the
+// critical packets.
+//
+bool Par2Stream::writeFile(
+    const QString       &path,
+    const QByteArray    &critical,
+    const QByteArray    &setID,
+    int                 e0,
+    int                 eLim )
+{
+    QFile   f( path );
+
+    if( !f.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+        return false;
+
+    static const char   *type = "PAR 2.0\0RecvSlic";
+
+    for( int e = e0; e < eLim; ++e ) {
+
+        QCryptographicHash  h( QCryptographicHash::Md5 );
+        QByteArray          exp = le32( e );
+        const char          *data = &rec[e][0];
+
+        h.addData( setID );
+        h.addData( type, 16 );
+        h.addData( exp );
+        h.addData( data, int(sliceBytes) );
+
+        QByteArray  hdr = packetHdr( 4 + sliceBytes, h.result(), setID, type );
+
+        if( f.write( hdr ) != hdr.size()
+            || f.write( exp ) != 4
+            || f.write( data, sliceBytes ) != sliceBytes ) {
+
+            return false;
+        }
+    }
+
+    return f.write( critical ) == critical.size();
+}
+
+
@@ -0,0 +1,74 @@
+#ifndef PAR2STREAM_H
+#define PAR2STREAM_H
+
+#include <QCryptographicHash>
+#include <QString>
+
+#include <vector>
+
+// Slice (block) size for parity made while writing; PAR2
+// allows at most PAR2_MAXSLICES, so files up to 512 GB.
+#define PAR2_SLICEBYTES     (16*1024*1024)
+#define PAR2_MAXSLICES      32768
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// PAR2 (v2.0) recovery set for one file, computed from the
+// file's bytes as they're written, so parity is ready when the
+// file closes with no second read pass. The output is the same
+// pair par2cmdline makes, and Par2Window (par2.exe) can verify
+// and repair with it:
+//
+// - <file>.par2:               main, file, checksum and creator
+//                              packets.
+// - <file>.volNN+MM.par2:      MM recovery slices, exponents
+//                              0..MM-1, plus copies of the above.
+//
+// Each input slice i adds base(i)^e * slice into recovery slice
+// e, in GF(2^16) with PAR2's generator 0x1100B. All MM recovery
+// slices are held in RAM for the life of the file; MM of them can
+// repair up to MM damaged slices anywhere in the file.
+//
+// Bytes must be fed in file order, in whole 16-bit words.
+//
+class Par2Stream
+{
+private:
+    std::vector<std::vector<char> > rec;        // recovery slices
+    std::vector<std::vector<char> > tabs;       // per rec, kernel tables
+    std::vector<char>               md5crc;     // per slice, MD5+CRC32
+    QByteArray                      head;       // first 16 KB
+    QCryptographicHash              fileMD5,
+                                    sliceMD5;
+    qint64                          sliceBytes,
+                                    nBytes,
+                                    inSlice;
+    quint32                         sliceCRC,
+                                    logBase;
+    int                             nSlices;
+    bool                            ok;
+
+public:
+    Par2Stream( qint64 sliceBytes, int nRec );
+
+    bool isOK() const   {return ok;}
+
+    void update( const void *src, qint64 bytes );
+    bool finish( QString &err, const QString &filePath );
+
+private:
+    void beginSlice();
+    void endSlice();
+    bool writeFile(
+        const QString       &path,
+        const QByteArray    &critical,
+        const QByteArray    &setID,
+        int                 e0,
+        int                 eLim );
+};
+
+#endif  // PAR2STREAM_H
+
+
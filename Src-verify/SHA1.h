@@ -263,6 +263,26 @@ public:
 	// Get the raw message digest (20 bytes)
 	bool GetHash(UINT_8* pbDest20) const;
 
+	// Save or restore the running state (before Final), so that
+	// hashing can resume later from the same point in the data.
+	enum { STATE_BYTES = 92 };
+	void GetState(UINT_8* pbDest) const;
+	void SetState(const UINT_8* pbSrc);
+
+	// Block backend, picked at startup from the CPU: SHA extensions,
+	// else SSSE3, else portable. Benchmarks may force a lesser one
+	// while nothing else is hashing; SetBackend returns false if
+	// the CPU lacks it.
+	enum BACKEND
+	{
+		BACKEND_SCALAR = 0,
+		BACKEND_SSSE3 = 1,
+		BACKEND_NI = 2
+	};
+
+	static BACKEND GetBackend();
+	static bool SetBackend(BACKEND be);
+
 private:
 	// Private SHA-1 transformation
 	void Transform(UINT_32* pState, const UINT_8* pBuffer);
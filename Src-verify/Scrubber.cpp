@@ -0,0 +1,365 @@
+
+#include "Scrubber.h"
+#include "Sha1Verifier.h"
+#include "Util.h"
+#include "MainApp.h"
+#include "Run.h"
+
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QThread>
+
+
+// Files modified more recently than this aren't checked yet,
+// and once a pass ends the next starts this much later.
+#define SCRUB_SETTLESECS    60
+#define SCRUB_PASSSECS      600
+
+// Results kept for GETSCRUBREPORT.
+#define SCRUB_MAXREPORT     200
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+static QString stampPath()
+{
+    return QString("%1/_Configs/scrub.txt").arg( appPath() );
+}
+
+
+static const char *stateName( int st )
+{
+    static const char *name[] = {"off", "resting", "scanning", "verifying"};
+
+    return name[st];
+}
+
+/* ---------------------------------------------------------------- */
+/* ScrubWorker ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void ScrubWorker::stop()
+{
+    QMutexLocker    ml( &curMtx );
+
+    pleaseStop = true;
+
+    if( cur )
+        cur->stop();
+}
+
+
+void ScrubWorker::run()
+{
+    setThreadBkgndIO( true );
+
+    while( !pleaseStop ) {
+
+        QStringList bins;
+
+        S->setState( Scrubber::Scanning );
+        findDue( bins );
+
+        foreach( const QString &bin, bins ) {
+
+            if( pleaseStop )
+                break;
+
+            // Recheck; things change during a long pass
+
+            QFileInfo   fi( bin ),
+                        fm( QString("%1/%2.meta")
+                            .arg( fi.path() )
+                            .arg( fi.completeBaseName() ) );
+            KVParams    kvp;
+
+            if( !fi.exists()
+                || fi.lastModified().secsTo( QDateTime::currentDateTime() )
+                    < SCRUB_SETTLESECS
+                || !S->needsCheck( fi )
+                || !fm.exists()
+                || !kvp.fromMetaFile( fm.filePath() )
+                || !kvp.contains( "fileSHA1" )
+                || mainApp()->getRun()->dfIsInUse( fi ) ) {
+
+                continue;
+            }
+
+            Sha1Worker  W( bin, kvp, true );
+
+            curMtx.lock();
+                cur = &W;
+                if( pleaseStop )
+                    W.stop();
+            curMtx.unlock();
+
+            S->setState( Scrubber::Verifying, bin );
+
+            int r = W.verify();
+
+            curMtx.lock();
+                cur = 0;
+            curMtx.unlock();
+
+            if( r != Sha1Worker::Canceled )
+                S->addResult( fi, r == Sha1Worker::Success, W.extendedError );
+        }
+
+        if( pleaseStop )
+            break;
+
+        S->passDone();
+        S->setState( Scrubber::Resting );
+
+        rest( SCRUB_PASSSECS );
+    }
+
+    setThreadBkgndIO( false );
+
+    emit finished();
+}
+
+
+// Bin files in or below the data directories that may
+// need checking. Final tests are made just before each.
+//
+void ScrubWorker::findDue( QStringList &bins )
+{
+    foreach( const QString &dir, mainApp()->dataDirs() ) {
+
+        QDirIterator    it(
+                            dir,
+                            QStringList( "*.bin" ),
+                            QDir::Files,
+                            QDirIterator::Subdirectories );
+
+        while( !pleaseStop && it.hasNext() ) {
+
+            it.next();
+
+            if( S->needsCheck( it.fileInfo() ) )
+                bins.append( it.fileInfo().absoluteFilePath() );
+        }
+    }
+}
+
+
+// Sleep secs in short naps; false if stopped.
+//
+bool ScrubWorker::rest( double secs )
+{
+    double  tEnd = getTime() + secs;
+
+    while( !pleaseStop && getTime() < tEnd )
+        QThread::msleep( 500 );
+
+    return !pleaseStop;
+}
+
+/* ---------------------------------------------------------------- */
+/* Scrubber ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+Scrubber::Scrubber()
+    :   QObject(0), thread(0), worker(0),
+        state(Off), nOK(0), nBad(0), nPass(0)
+{
+    load();
+}
+
+
+Scrubber::~Scrubber()
+{
+    stop();
+}
+
+
+void Scrubber::start()
+{
+    if( thread )
+        return;
+
+    Log() << "Background data scrub started.";
+
+    thread  = new QThread;
+    worker  = new ScrubWorker( this );
+
+    worker->moveToThread( thread );
+
+    Connect( thread, SIGNAL(started()), worker, SLOT(run()) );
+    Connect( worker, SIGNAL(finished()), thread, SLOT(quit()), Qt::DirectConnection );
+
+    thread->start( QThread::LowestPriority );
+}
+
+
+// Worker deleted synchronously after wait().
+//
+void Scrubber::stop()
+{
+    if( !thread )
+        return;
+
+    if( thread->isRunning() ) {
+        worker->stop();
+        thread->wait();
+    }
+
+    delete thread;
+    delete worker;
+    thread = 0;
+    worker = 0;
+
+    setState( Off );
+
+    Log() << "Background data scrub stopped.";
+}
+
+
+// Status as name=value lines for GETSCRUBREPORT, then one
+// result=time<tab>OK|BAD<tab>path<tab>detail line per result
+// (newest last).
+//
+QString Scrubber::remoteStr() const
+{
+    QMutexLocker    ml( &repMtx );
+    QString         s;
+
+    s  = QString("state=%1\n").arg( stateName( state ) );
+    s += QString("paused=%1\n")
+            .arg( state == Verifying && Sha1Reader::isRunWriting() );
+    s += QString("file=%1\n").arg( curFile );
+    s += QString("nPass=%1\n").arg( nPass );
+    s += QString("lastPass=%1\n")
+            .arg( lastPass.isValid() ?
+                    lastPass.toString( Qt::ISODate ) : QString() );
+    s += QString("nChecked=%1\n").arg( checked.size() );
+    s += QString("nOK=%1\n").arg( nOK );
+    s += QString("nBad=%1\n").arg( nBad );
+
+    foreach( const QString &r, report )
+        s += QString("result=%1\n").arg( r );
+
+    return s;
+}
+
+
+void Scrubber::setState( int st, const QString &file )
+{
+    QMutexLocker    ml( &repMtx );
+
+    state   = st;
+    curFile = file;
+}
+
+
+// True if fi never checked, or changed since.
+//
+bool Scrubber::needsCheck( const QFileInfo &fi )
+{
+    QMutexLocker                        ml( &repMtx );
+    QMap<QString,Stamp>::const_iterator it =
+                                        checked.find( fi.absoluteFilePath() );
+
+    return it == checked.end()
+            || it->size != fi.size()
+            || it->mtime != fi.lastModified().toMSecsSinceEpoch();
+}
+
+
+// Stamp fi (as it was before checking), log and report it.
+//
+void Scrubber::addResult( const QFileInfo &fi, bool ok, const QString &err )
+{
+    QString path = fi.absoluteFilePath();
+
+    if( ok )
+        Log() << QString("Scrub: SHA1 verified '%1'.").arg( path );
+    else {
+        Warning() << QString("Scrub: SHA1 Verify Error [%1] '%2'")
+                        .arg( err )
+                        .arg( path );
+    }
+
+    repMtx.lock();
+
+        Stamp   &T = checked[path];
+        T.size  = fi.size();
+        T.mtime = fi.lastModified().toMSecsSinceEpoch();
+
+        report.append(
+            QString("%1\t%2\t%3\t%4")
+            .arg( QDateTime::currentDateTime().toString( Qt::ISODate ) )
+            .arg( ok ? "OK" : "BAD" )
+            .arg( path )
+            .arg( err ) );
+
+        while( report.size() > SCRUB_MAXREPORT )
+            report.removeFirst();
+
+        if( ok )
+            ++nOK;
+        else
+            ++nBad;
+
+    repMtx.unlock();
+
+    save();
+}
+
+
+void Scrubber::passDone()
+{
+    QMutexLocker    ml( &repMtx );
+
+    lastPass = QDateTime::currentDateTime();
+    ++nPass;
+}
+
+
+// Stamps of bin files that still exist.
+//
+void Scrubber::load()
+{
+    QFile   f( stampPath() );
+
+    if( !f.open( QIODevice::ReadOnly | QIODevice::Text ) )
+        return;
+
+    QTextStream ts( &f );
+
+    while( !ts.atEnd() ) {
+
+        QStringList sl = ts.readLine().split( "\t" );
+
+        if( sl.size() != 3 || !QFileInfo( sl[2] ).exists() )
+            continue;
+
+        Stamp   &T = checked[sl[2]];
+        T.size  = sl[0].toLongLong();
+        T.mtime = sl[1].toLongLong();
+    }
+}
+
+
+void Scrubber::save()
+{
+    QFile   f( stampPath() );
+
+    if( !f.open( QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text ) )
+        return;
+
+    QTextStream     ts( &f );
+    QMutexLocker    ml( &repMtx );
+
+    QMap<QString,Stamp>::const_iterator it  = checked.begin(),
+                                        end = checked.end();
+
+    for( ; it != end; ++it )
+        ts << it->size << "\t" << it->mtime << "\t" << it.key() << "\n";
+}
+
+
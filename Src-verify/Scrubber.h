@@ -0,0 +1,120 @@
+#ifndef SCRUBBER_H
+#define SCRUBBER_H
+
+#include <QDateTime>
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+
+#include <atomic>
+
+class Scrubber;
+class Sha1Worker;
+
+class QFileInfo;
+class QThread;
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Walks the data directories in passes, verifying each due
+// file with an idle mode Sha1Worker, then rests between passes.
+//
+class ScrubWorker : public QObject
+{
+    Q_OBJECT
+
+private:
+    Scrubber            *S;
+    Sha1Worker          *cur;       // guarded by curMtx
+    QMutex              curMtx;
+    std::atomic<bool>   pleaseStop;
+
+public:
+    ScrubWorker( Scrubber *S )
+    :   QObject(0), S(S), cur(0), pleaseStop(false)    {}
+
+    void stop();
+
+signals:
+    void finished();
+
+public slots:
+    void run();
+
+private:
+    void findDue( QStringList &bins );
+    bool rest( double secs );
+};
+
+
+// Background integrity scrubber.
+//
+// A low priority thread rechecks finished (bin,meta) pairs in
+// the data directories against their fileSHA1 tag (chunk sums
+// localize any mismatch), reading at background I/O priority
+// and holding off whenever a run is writing. A file is due if
+// it has a SHA1 tag, isn't in use, has settled SCRUB_SETTLESECS,
+// and its size or mtime differ from when it was last checked.
+//
+// Check stamps persist in _Configs/scrub.txt (size, mtime ms,
+// path per line), so restarts don't redo the whole tree.
+// Results go to the log and to the report for GETSCRUBREPORT.
+//
+class Scrubber : public QObject
+{
+    Q_OBJECT
+
+    friend class ScrubWorker;
+
+public:
+    enum State {
+        Off,
+        Resting,
+        Scanning,
+        Verifying
+    };
+
+private:
+    struct Stamp {
+        qint64  size;
+        qint64  mtime;  // ms since epoch
+    };
+
+private:
+    mutable QMutex          repMtx;
+    QMap<QString,Stamp>     checked;    // abs bin path -> stamp
+    QStringList             report;     // newest last
+    QString                 curFile;
+    QDateTime               lastPass;
+    QThread                 *thread;
+    ScrubWorker             *worker;
+    int                     state,
+                            nOK,
+                            nBad,
+                            nPass;
+
+public:
+    Scrubber();
+    virtual ~Scrubber();
+
+    bool isOn() const   {return thread != 0;}
+    void start();
+    void stop();
+
+    QString remoteStr() const;
+
+private:
+    void setState( int st, const QString &file = QString() );
+    bool needsCheck( const QFileInfo &fi );
+    void addResult( const QFileInfo &fi, bool ok, const QString &err );
+    void passDone();
+    void load();
+    void save();
+};
+
+#endif  // SCRUBBER_H
+
+
@@ -4,6 +4,10 @@
 #include "MainApp.h"
 #include "ConsoleWindow.h"
 #include "Run.h"
+#include "TrigBase.h"
+#include "DFCheckpoint.h"
+#include "DFChunkSum.h"
+#include "DFCompress.h"
 
 #include "SHA1.h"
 #undef TCHAR
@@ -14,22 +18,263 @@
 #include <QFileDialog>
 
 
+// Read block size and buffers per reader.
+#define SHA1_BLKBYTES   (4*1024*1024)
+#define SHA1_NBUF       4
+
+// Files verified at once, and their summed read rate (MB/s)
+// while a run is in progress, so the writer keeps the disk.
+#define SHA1_NPAR       2
+#define SHA1_RUNMBPS    200
+
+// Idle mode reads resume once a run hasn't written for this long.
+#define SHA1_QUIETSECS  10
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Reserve bytes of the shared read budget, sleeping until
+// it's our turn. Unlimited when no run is in progress.
+//
+static void throttle( qint64 bytes )
+{
+    static QMutex   thrMtx;
+    static double   tFree = 0;
+
+    if( !mainApp()->getRun()->isRunning() )
+        return;
+
+    double  tNow = getTime(),
+            t;
+
+    thrMtx.lock();
+        t       = qMax( tFree, tNow );
+        tFree   = t + bytes / (SHA1_RUNMBPS * 1024.0 * 1024.0);
+    thrMtx.unlock();
+
+    if( t > tNow )
+        QThread::usleep( qint64(1e6 * (t - tNow)) );
+}
+
+// After a SHA1 mismatch, use the chunk sidecar, if any, to say
+// which chunks are bad, or that a short (still copying) file is
+// good so far. Return empty if the sidecar can't tell more.
+//
+static QString chunkReport( const DFChunkSum &got, const QString &binName )
+{
+    DFChunkSum          ref;
+    std::vector<int>    bad;
+    int                 nCmp;
+
+    if( !ref.load( binName ) || !(nCmp = got.compare( bad, ref )) )
+        return QString();
+
+    if( bad.empty() ) {
+
+        if( got.dataBytes() >= ref.dataBytes() )
+            return QString();
+
+        return QString(
+                "Data file incomplete (%1 of %2 MB);"
+                " the %3 chunks present verify OK.")
+                .arg( got.dataBytes() >> 20 )
+                .arg( ref.dataBytes() >> 20 )
+                .arg( nCmp );
+    }
+
+    QStringList sl;
+
+    for( int i = 0, n = qMin( int(bad.size()), 16 ); i < n; ++i )
+        sl.append( QString::number( bad[i] ) );
+
+    if( bad.size() > 16 )
+        sl.append( "..." );
+
+    return QString(
+            "Computed SHA1 does not match that in meta file;"
+            " %1 of %2 checked %3 MB chunks corrupt [%4].")
+            .arg( bad.size() )
+            .arg( nCmp )
+            .arg( ref.chunkSize() >> 20 )
+            .arg( sl.join( "," ) );
+}
+
+/* ---------------------------------------------------------------- */
+/* Sha1Reader ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+Sha1Reader::Sha1Reader( const QString &fileName, bool idle )
+    :   QObject(0), fileName(fileName),
+        buf(SHA1_NBUF, std::vector<char>( SHA1_BLKBYTES )),
+        len(SHA1_NBUF, 0), iRead(0), iHash(0), nFull(0),
+        eof(false), idle(idle), pleaseStop(false)
+{
+}
+
+
+// True if a run is in progress and its trigger has written
+// to disk within SHA1_QUIETSECS.
+//
+bool Sha1Reader::isRunWriting()
+{
+    return mainApp()->getRun()->isRunning()
+            && TrigBase::secsSinceWrite() < SHA1_QUIETSECS;
+}
+
+
+// Block until a buffer is full: return it and its size,
+// or 0 at end of file, error or stop.
+//
+const char *Sha1Reader::next( qint64 &bytes )
+{
+    QMutexLocker    ml( &bufMtx );
+
+    while( !nFull && !eof && !pleaseStop )
+        condFull.wait( &bufMtx );
+
+    if( !nFull || pleaseStop )
+        return 0;
+
+    bytes = len[iHash];
+    return &buf[iHash][0];
+}
+
+
+// Hand back the buffer from next().
+//
+void Sha1Reader::release()
+{
+    QMutexLocker    ml( &bufMtx );
+
+    iHash = (iHash + 1) % SHA1_NBUF;
+    --nFull;
+    condFree.wakeAll();
+}
+
+
+void Sha1Reader::stop()
+{
+    QMutexLocker    ml( &bufMtx );
+
+    pleaseStop = true;
+    condFree.wakeAll();
+    condFull.wakeAll();
+}
+
+
+void Sha1Reader::run()
+{
+    QFile   f( fileName );
+
+    if( idle )
+        setThreadBkgndIO( true );
+
+    if( !f.open( QIODevice::ReadOnly | QIODevice::Unbuffered ) ) {
+
+        QMutexLocker    ml( &bufMtx );
+
+        error   = f.errorString();
+        eof     = true;
+        condFull.wakeAll();
+    }
+
+    while( !eof ) {
+
+        bufMtx.lock();
+
+            while( nFull == SHA1_NBUF && !pleaseStop )
+                condFree.wait( &bufMtx );
+
+            bool    stop = pleaseStop;
+
+        bufMtx.unlock();
+
+        if( stop )
+            break;
+
+        if( idle )
+            waitIdle();
+        else
+            throttle( SHA1_BLKBYTES );
+
+        qint64  bytes = f.read( &buf[iRead][0], SHA1_BLKBYTES );
+
+        QMutexLocker    ml( &bufMtx );
+
+        if( bytes > 0 ) {
+            len[iRead]  = bytes;
+            iRead       = (iRead + 1) % SHA1_NBUF;
+            ++nFull;
+        }
+        else {
+
+            if( bytes < 0 || !f.atEnd() )
+                error = f.errorString();
+
+            eof = true;
+        }
+
+        condFull.wakeAll();
+    }
+
+    if( idle )
+        setThreadBkgndIO( false );
+
+    emit finished();
+}
+
+
+// Poll until no run is writing, or stop.
+//
+void Sha1Reader::waitIdle()
+{
+    for(;;) {
+
+        bufMtx.lock();
+            bool    stop = pleaseStop;
+        bufMtx.unlock();
+
+        if( stop || !isRunWriting() )
+            return;
+
+        QThread::msleep( 500 );
+    }
+}
+
 /* ---------------------------------------------------------------- */
 /* Sha1Worker ----------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
 Sha1Worker::Sha1Worker(
     const QString   &dataFileName,
-    const KeyValMap &kvm )
+    const KeyValMap &kvm,
+    bool            idle )
     :   QObject(0),
-        dataFileName(dataFileName), kvm(kvm),
-        pleaseStop(false)
+        dataFileName(dataFileName), kvm(kvm), reader(0),
+        idle(idle), pleaseStop(false)
 {
     dataFileNameShort = QFileInfo( dataFileName ).fileName();
 }
 
 
-void Sha1Worker::run()
+// Also wakes our reader, which may be holding off for a run.
+//
+void Sha1Worker::stop()
+{
+    QMutexLocker    ml( &runMtx );
+
+    pleaseStop = true;
+
+    if( reader )
+        reader->stop();
+}
+
+
+// Hash the file, compare with meta, and describe any
+// failure in extendedError.
+//
+Sha1Worker::Result Sha1Worker::verify()
 {
     extendedError.clear();
     emit progress( 0 );
@@ -38,42 +283,59 @@ void Sha1Worker::run()
 
     QString sha1FromMeta = kvm["fileSHA1"].toString().trimmed();
 
+    // No tag: if its run crashed, finalize it from its checkpoint,
+    // hashing just the tail written since.
+
+    if( sha1FromMeta.isEmpty()
+        && QFile::exists( DFCheckpoint::sidecarName( dataFileName ) ) ) {
+
+        if( !DFCheckpoint::finalize( extendedError, dataFileName ) )
+            return Failure;
+
+        Log()
+            << "Finalized meta file of interrupted run for '"
+            << dataFileNameShort << "'.";
+
+        emit progress( 100 );
+        return Success;
+    }
+
     if( sha1FromMeta.isEmpty() ) {
         extendedError =
             QString("Missing SHA1 tag in meta file '%1'.")
             .arg( dataFileNameShort );
-        emit result( Failure );
-        return;
+        return Failure;
     }
 
 // Open file
 
-    const int bufSize = 64*1024;
-
-    std::vector<UINT_8> buf( bufSize );
-    QFile               f( dataFileName );
-    QFileInfo           fi( dataFileName );
-    CSHA1               sha1;
+    QFile       f( dataFileName );
+    QFileInfo   fi( dataFileName );
+    CSHA1       sha1;
+    DFChunkSum  csum;
 
     if( !f.open( QIODevice::ReadOnly ) ) {
         extendedError =
             QString("Can't open for reading '%1'.")
             .arg( dataFileNameShort );
-        emit result( Failure );
-        return;
+        return Failure;
     }
 
 // Check size
 
+    // Compressed: fileSizeBytes is the decoded size
+
+    bool    cmp     = kvm.contains( "fileCompression" );
+    QString key     = (cmp ? "fileCmpBytes" : "fileSizeBytes");
     qint64  size    = fi.size(),
             read    = 0,
             step    = qMax( 1LL, size/100 ),
             lastPct = 0;
 
-    if( size != kvm["fileSizeBytes"].toLongLong() ) {
+    if( size != kvm[key].toLongLong() ) {
         Warning()
             << "Wrong file size in meta file ["
-            << kvm["fileSizeBytes"].toString()
+            << kvm[key].toString()
             << "] vs actual ("
             << size
             << ") for data file '"
@@ -81,36 +343,101 @@ void Sha1Worker::run()
             << "'.";
     }
 
-// Hash
+// Hash decoded data, chunk by chunk
 
-    while( !isStopped() && !f.atEnd() ) {
+    if( cmp ) {
 
-//        qint64  bytes = readChunky( f, &buf[0], bufSize );
-        qint64  bytes = f.read( (char*)&buf[0], bufSize );
+        DFCmpReader R;
+        vec_i16     D;
 
-        if( bytes < 0 ) {
-            extendedError = f.errorString();
-            break;
+        if( !R.open( &f, kvm["nSavedChans"].toInt() ) ) {
+            extendedError =
+                QString("Bad compressed format '%1'.")
+                .arg( dataFileNameShort );
         }
-        else if( bytes > 0 ) {
 
-            qint64 pct = (read += bytes) / step;
+        for( int ic = 0, nc = R.nChunks(); ic < nc && !isStopped(); ++ic ) {
+
+            while( idle && !isStopped() && Sha1Reader::isRunWriting() )
+                QThread::msleep( 500 );
 
-            sha1.Update( &buf[0], bytes );
+            if( !R.chunk( D, ic ) ) {
+                extendedError =
+                    QString("Can't decode chunk %1 of '%2'.")
+                    .arg( ic )
+                    .arg( dataFileNameShort );
+                break;
+            }
+
+            sha1.Update(
+                (const UINT_8*)&D[0],
+                UINT_32(D.size() * sizeof(qint16)) );
+
+            csum.update( &D[0], D.size() * sizeof(qint16) );
+
+            qint64 pct = 100 * (ic + 1) / nc;
 
             if( pct >= lastPct + 5 ) {
                 emit progress( pct );
                 lastPct = pct;
-                QThread::usleep( 20 );  // allow event processing
             }
         }
-        else {
+    }
 
-            if( !f.atEnd() )
-                extendedError = f.errorString();
+// Hash blocks as the reader thread delivers them
 
-            break;
+    if( !cmp ) {
+
+        f.close();
+
+        QThread     *thread = new QThread;
+        const char  *p;
+        qint64      bytes;
+
+        runMtx.lock();
+            reader = new Sha1Reader( dataFileName, idle );
+            if( pleaseStop )
+                reader->stop();
+        runMtx.unlock();
+
+        reader->moveToThread( thread );
+
+        Connect( thread, SIGNAL(started()), reader, SLOT(run()) );
+        Connect( reader, SIGNAL(finished()), thread, SLOT(quit()), Qt::DirectConnection );
+
+        thread->start( idle ? QThread::IdlePriority : QThread::InheritPriority );
+
+        while( !isStopped() && (p = reader->next( bytes )) ) {
+
+            sha1.Update( (const UINT_8*)p, UINT_32(bytes) );
+            csum.update( p, bytes );
+            reader->release();
+
+            qint64 pct = (read += bytes) / step;
+
+            if( pct >= lastPct + 5 ) {
+                emit progress( pct );
+                lastPct = pct;
+            }
+        }
+
+        reader->stop();
+        thread->wait();
+
+        if( !reader->error.isEmpty() )
+            extendedError = reader->error;
+        else if( !isStopped() && read != size ) {
+            extendedError =
+                QString("Short read of '%1'.")
+                .arg( dataFileNameShort );
         }
+
+        delete thread;
+
+        runMtx.lock();
+            delete reader;
+            reader = 0;
+        runMtx.unlock();
     }
 
 // Report
@@ -119,7 +446,7 @@ void Sha1Worker::run()
 
     if( isStopped() )
         r = Canceled;
-    else if( f.atEnd() && extendedError.isEmpty() ) {
+    else if( extendedError.isEmpty() ) {
 
         sha1.Final();
 
@@ -129,9 +456,15 @@ void Sha1Worker::run()
         if( !sha1FromMeta.compare( hStr.c_str(), Qt::CaseInsensitive ) )
             r = Success;
         else {
-            extendedError =
-                "Computed SHA1 does not match that in meta file;"
-                " data file corrupt.";
+
+            extendedError = chunkReport( csum, dataFileName );
+
+            if( extendedError.isEmpty() ) {
+                extendedError =
+                    "Computed SHA1 does not match that in meta file;"
+                    " data file corrupt.";
+            }
+
             r = Failure;
         }
     }
@@ -139,7 +472,7 @@ void Sha1Worker::run()
     if( lastPct < 100 )
         emit progress( 100 );
 
-    emit result( r );
+    return r;
 }
 
 /* ---------------------------------------------------------------- */
@@ -147,23 +480,143 @@ void Sha1Worker::run()
 /* ---------------------------------------------------------------- */
 
 Sha1Verifier::Sha1Verifier()
-    :   QObject(0), cons(0), prog(0), thread(0), worker(0)
+    :   QObject(0), cons(0), prog(0),
+        nJobs(0), nDone(0), canceled(false)
 {
-// -----------
-// Pick a file
-// -----------
+// ------------
+// Pick file(s)
+// ------------
 
     cons = mainApp()->console();
 
-    QString dataFile =
-        QFileDialog::getOpenFileName(
+    QStringList files =
+        QFileDialog::getOpenFileNames(
             cons,
-            "Select data file for SHA1 verification",
+            "Select data file(s) for SHA1 verification",
             mainApp()->dataDir() );
 
-    if( dataFile.isEmpty() )
+    if( files.isEmpty() ) {
+        deleteLater();
+        return;
+    }
+
+    foreach( const QString &file, files ) {
+
+        QString err;
+
+        if( !addJob( err, file ) && !err.isEmpty() ) {
+
+            Warning() << QString("SHA1 Verify Error [%1]").arg( err );
+            errList.append( err );
+        }
+    }
+
+    if( !(nJobs = pending.size()) ) {
+        finish();
+        return;
+    }
+
+// -----
+// Begin
+// -----
+
+    prog = new QProgressDialog(
+                nJobs == 1 ?
+                    QString("Verifying SHA1 hash of '%1'...")
+                    .arg( QFileInfo( pending[0].dataFile ).fileName() )
+                :   QString("Verifying SHA1 hashes of %1 files...")
+                    .arg( nJobs ),
+                "Cancel",
+                0, 100,
+                cons );
+
+    prog->setWindowFlags( prog->windowFlags()
+        & ~(Qt::WindowContextHelpButtonHint
+            | Qt::WindowCloseButtonHint) );
+
+    Connect( prog, SIGNAL(canceled()), this, SLOT(cancel()) );
+
+    prog->show();
+
+    for( int i = 0; i < SHA1_NPAR && pending.size(); ++i )
+        startNext();
+}
+
+
+void Sha1Verifier::cancel()
+{
+    canceled = true;
+    pending.clear();
+
+    QMap<Sha1Worker*,int>::iterator it  = active.begin(),
+                                    end = active.end();
+
+    for( ; it != end; ++it )
+        it.key()->stop();
+}
+
+
+void Sha1Verifier::progress( int pct )
+{
+    Sha1Worker  *w = dynamic_cast<Sha1Worker*>(sender());
+
+    if( !w || !active.contains( w ) )
         return;
 
+    active[w] = pct;
+
+    int sum = 100 * nDone;
+
+    foreach( int p, active )
+        sum += p;
+
+    prog->setValue( sum / nJobs );
+}
+
+
+void Sha1Verifier::result( int res )
+{
+    Sha1Worker  *w = dynamic_cast<Sha1Worker*>(sender());
+
+    if( !w || !active.contains( w ) )
+        return;
+
+    QString &fn = w->dataFileNameShort;
+
+    if( res == Sha1Worker::Success ) {
+
+        Log() << QString("SHA1 verified '%1'.").arg( fn );
+        okList.append( fn );
+    }
+    else if( res == Sha1Worker::Failure ) {
+
+        QString &err = w->extendedError;
+
+        Warning() << QString("SHA1 Verify Error [%1] '%2'")
+                        .arg( err )
+                        .arg( fn );
+
+        errList.append( QString("%1: %2").arg( fn ).arg( err ) );
+    }
+    else
+        Log() << QString("SHA1 verify canceled '%1'.").arg( fn );
+
+    active.remove( w );
+    w->deleteLater();
+    ++nDone;
+
+    if( pending.size() )
+        startNext();
+    else if( active.isEmpty() )
+        finish();
+}
+
+
+// Queue dataFile (bin or meta member of the pair) if
+// verifiable, else set err.
+//
+bool Sha1Verifier::addJob( QString &err, QString dataFile )
+{
     QFileInfo   fi( dataFile );
     KVParams    kvp;
 
@@ -181,26 +634,16 @@ Sha1Verifier::Sha1Verifier()
             .arg( fi.completeBaseName() ) );
 
         if( !fi.exists() ) {
-
-            QMessageBox::critical(
-                cons,
-                "Missing Meta File",
-                QString("SHA1 needs a matching meta-file for\n'%1'.")
-                .arg( dataFile ) );
-
-            return;
+            err = QString("SHA1 needs a matching meta-file for '%1'.")
+                    .arg( QFileInfo( dataFile ).fileName() );
+            return false;
         }
     }
 
     if( !kvp.fromMetaFile( fi.filePath() ) ) {
-
-        QMessageBox::critical(
-            cons,
-            "Meta File Read Error.",
-            QString("SHA1 verifier could not read contents of\n'%1'.")
-            .arg( fi.fileName() ) );
-
-        return;
+        err = QString("SHA1 verifier could not read contents of '%1'.")
+                .arg( fi.fileName() );
+        return false;
     }
 
 // --------------------------------------
@@ -217,83 +660,85 @@ Sha1Verifier::Sha1Verifier()
     fi.setFile( dataFile );
 
     if( mainApp()->getRun()->dfIsInUse( fi ) ) {
+        err = QString("Cannot run SHA1 on the current data acquisition"
+                " file '%1'.").arg( fi.fileName() );
+        return false;
+    }
 
-        QMessageBox::critical(
-            cons,
-            "Selected File In Use",
-            "Cannot run SHA1 on the current data acquisition file." );
+// ------------------------------------
+// Skip duplicates (both members chosen)
+// ------------------------------------
 
-        return;
+    for( int i = 0, n = pending.size(); i < n; ++i ) {
+
+        if( pending[i].dataFile == dataFile )
+            return false;
     }
 
-// -----
-// Begin
-// -----
+    Job J;
+    J.dataFile  = dataFile;
+    J.kvm       = kvp;
+    pending.append( J );
 
-    prog = new QProgressDialog(
-                QString("Verifying SHA1 hash of '%1'...")
-                .arg( fi.fileName() ),
-                "Cancel",
-                0, 100,
-                cons );
+    return true;
+}
 
-    prog->setWindowFlags( prog->windowFlags()
-        & ~(Qt::WindowContextHelpButtonHint
-            | Qt::WindowCloseButtonHint) );
 
-    thread  = new QThread;
-    worker  = new Sha1Worker( dataFile, kvp );
+void Sha1Verifier::startNext()
+{
+    Job         J       = pending.takeFirst();
+    QThread     *thread = new QThread;
+    Sha1Worker  *worker = new Sha1Worker( J.dataFile, J.kvm );
 
     worker->moveToThread( thread );
+    active[worker] = 0;
 
     Connect( thread, SIGNAL(started()), worker, SLOT(run()) );
 
-    Connect( worker, SIGNAL(progress(int)), prog, SLOT(setValue(int)) );
-    Connect( prog, SIGNAL(canceled()), this, SLOT(cancel()) );
+    Connect( worker, SIGNAL(progress(int)), this, SLOT(progress(int)) );
     Connect( worker, SIGNAL(result(int)), this, SLOT(result(int)) );
 
     Connect( worker, SIGNAL(destroyed()), thread, SLOT(quit()), Qt::DirectConnection );
     Connect( thread, SIGNAL(finished()), thread, SLOT(deleteLater()) );
 
-    prog->show();
     thread->start();
 }
 
 
-void Sha1Verifier::result( int res )
+// Report all files at once, then self-delete.
+//
+void Sha1Verifier::finish()
 {
-    QString &fn = worker->dataFileNameShort;
+    if( prog ) {
+        delete prog;
+        prog = 0;
+    }
 
-    if( res == Sha1Worker::Success ) {
+    if( errList.size() ) {
 
-        QString str = QString("SHA1 verified '%1'.").arg( fn );
+        QString str = errList.join( "\n" );
 
-        Log() << str;
+        if( okList.size() )
+            str = QString("Verified %1 of %2 files.\n\n%3")
+                    .arg( okList.size() )
+                    .arg( okList.size() + errList.size() )
+                    .arg( str );
 
-        QMessageBox::information(
-            cons,
-            QString("SHA1 Verify '%1'").arg( fn ),
-            str );
+        QMessageBox::warning( cons, "SHA1 Verify Error", str );
     }
-    else if( res == Sha1Worker::Failure ) {
-
-        QString &err = worker->extendedError;
+    else if( okList.size() && !canceled ) {
 
-        Warning() << QString("SHA1 Verify Error [%1] '%2'")
-                        .arg( err )
-                        .arg( fn );
-
-        QMessageBox::warning(
+        QMessageBox::information(
             cons,
-            QString("SHA1 Verify Error '%1'").arg( fn ),
-            err );
+            "SHA1 Verify",
+            okList.size() == 1 ?
+                QString("SHA1 verified '%1'.").arg( okList[0] )
+            :   QString("SHA1 verified %1 files:\n%2")
+                .arg( okList.size() )
+                .arg( okList.join( "\n" ) ) );
     }
-    else
-        Log() << QString("SHA1 verify canceled '%1'.").arg( fn );
 
-    delete prog;
-    worker->deleteLater();
-    delete this;
+    deleteLater();
 }
 
 
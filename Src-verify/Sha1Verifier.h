@@ -2,7 +2,12 @@
 #define SHA1VERIFIER_H
 
 #include "KVParams.h"
+#include <QMap>
 #include <QMutex>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <vector>
 
 class QProgressDialog;
 class ConsoleWindow;
@@ -11,6 +16,53 @@ class ConsoleWindow;
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
+// Reads a file in large blocks into a small pool of buffers
+// on its own thread, so disk reads overlap the hashing.
+//
+// Idle mode (background scrub): reads use background I/O
+// priority and hold off entirely while a run is writing.
+//
+class Sha1Reader : public QObject
+{
+    Q_OBJECT
+
+private:
+    QString                         fileName;
+    std::vector<std::vector<char> > buf;
+    std::vector<qint64>             len;
+    QMutex                          bufMtx;
+    QWaitCondition                  condFull,
+                                    condFree;
+    int                             iRead,  // next to fill
+                                    iHash,  // next to hash
+                                    nFull;
+    bool                            eof,
+                                    idle,
+                                    pleaseStop;
+
+public:
+    QString                         error;
+
+public:
+    Sha1Reader( const QString &fileName, bool idle = false );
+
+    static bool isRunWriting();
+
+    const char *next( qint64 &bytes );
+    void release();
+    void stop();
+
+signals:
+    void finished();
+
+public slots:
+    void run();
+
+private:
+    void waitIdle();
+};
+
+
 class Sha1Worker : public QObject
 {
     Q_OBJECT
@@ -23,48 +75,71 @@ public:
     };
 
 public:
-    QString         dataFileName,
-                    dataFileNameShort,
-                    extendedError;
-    KeyValMap       kvm;
-    mutable QMutex  runMtx;
-    volatile bool   pleaseStop;
+    QString             dataFileName,
+                        dataFileNameShort,
+                        extendedError;
+    KeyValMap           kvm;
+    Sha1Reader          *reader;    // guarded by runMtx
+    mutable QMutex      runMtx;
+    bool                idle;
+    std::atomic<bool>   pleaseStop;
 
 public:
     Sha1Worker(
         const QString   &dataFileName,
-        const KeyValMap &kvm );
+        const KeyValMap &kvm,
+        bool            idle = false );
+
+    void stop();
+    bool isStopped() const
+        {return pleaseStop.load( std::memory_order_acquire );}
 
-    void stop()             {QMutexLocker ml( &runMtx ); pleaseStop = true;}
-    bool isStopped() const  {QMutexLocker ml( &runMtx ); return pleaseStop;}
+    Result verify();
 
 signals:
     void progress( int );
     void result( int res );
 
 public slots:
-    void run();
+    void run()              {emit result( verify() );}
 };
 
 
-// Self-deleting verify handler
+// Self-deleting verify handler. Verifies the chosen files,
+// up to SHA1_NPAR at a time, and reports them together.
 //
 class Sha1Verifier : public QObject
 {
     Q_OBJECT
 
 private:
-    ConsoleWindow   *cons;
-    QProgressDialog *prog;
-    QThread         *thread;
-    Sha1Worker      *worker;
+    struct Job {
+        QString     dataFile;
+        KeyValMap   kvm;
+    };
+
+    ConsoleWindow           *cons;
+    QProgressDialog         *prog;
+    QList<Job>              pending;
+    QMap<Sha1Worker*,int>   active;     // worker -> percent done
+    QStringList             okList,
+                            errList;
+    int                     nJobs,
+                            nDone;
+    bool                    canceled;
 
 public:
     Sha1Verifier();
 
 public slots:
-    void cancel()   {worker->stop();}
+    void cancel();
+    void progress( int pct );
     void result( int res );
+
+private:
+    bool addJob( QString &err, QString dataFile );
+    void startNext();
+    void finish();
 };
 
 #endif  // SHA1VERIFIER_H
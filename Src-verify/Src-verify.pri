@@ -1,11 +1,15 @@
 
 HEADERS += \
+    $$PWD/Par2Stream.h \
     $$PWD/Par2Window.h \
+    $$PWD/Scrubber.h \
     $$PWD/SHA1.h \
     $$PWD/Sha1Verifier.h
 
 SOURCES += \
+    $$PWD/Par2Stream.cpp \
     $$PWD/Par2Window.cpp \
+    $$PWD/Scrubber.cpp \
     $$PWD/SHA1.cpp \
     $$PWD/Sha1Verifier.cpp
 